@@ -46,11 +46,11 @@ include("kCompatibility.lua")
 -- Find and parse/prepare all karaoke template lines
 function parse_templates(meta, styles, subs)
 	local templates = { once = {}, line = {}, syl = {}, char = {}, furi = {}, styles = {} }
-	local i = 1
-	while i <= #subs do
-		aegisub.progress.set((i-1) / #subs * 100)
+	local old_fx = {}
+	local n = #subs
+	for i = 1, n do
+		aegisub.progress.set((i-1) / n * 100)
 		local l = subs[i]
-		i = i + 1
 		if l.class == "dialogue" and l.comment then
 			local fx, mods = string.headtail(l.effect)
 			fx = fx:lower()
@@ -62,10 +62,11 @@ function parse_templates(meta, styles, subs)
 			templates.styles[l.style] = true
 		elseif l.class == "dialogue" and l.effect == "fx" then
 			-- this is a previously generated effect line, remove it
-			i = i - 1
-			subs.delete(i)
+			table.insert(old_fx, i)
 		end
 	end
+	-- deleting them all at once is a single pass over the file
+	subs.delete(old_fx)
 	aegisub.progress.set(100)
 	return templates
 end
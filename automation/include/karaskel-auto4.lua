@@ -256,10 +256,6 @@ end
 -- Pre-calculate sizing information for the given line, no layouting is done
 -- Modifies the object passed for line
 function karaskel.preproc_line_size(meta, styles, line)
-	if not line.kara then
-		karaskel.preproc_line_text(meta, styles, line)
-	end
-	
 	-- Add style information
 	if styles[line.style] then
 		line.styleref = styles[line.style]
@@ -267,19 +263,43 @@ function karaskel.preproc_line_size(meta, styles, line)
 		aegisub.debug.out(2, "WARNING: Style not found: " .. line.style .. "\n")
 		line.styleref = styles[1]
 	end
+	local furistyle = styles[line.style .. "-furigana"] or false
+
+	-- If the text hasn't been preprocessed yet, do it all natively
+	if not line.kara and aegisub.karaskel_layout then
+		aegisub.karaskel_layout(line, line.styleref, furistyle, meta.video_x_correct_factor)
+		line.furistyle = furistyle
+		if not furistyle then
+			aegisub.debug.out(4, "No furigana style defined for style '%s'\n", line.style)
+		end
+		return
+	end
+
+	if not line.kara then
+		karaskel.preproc_line_text(meta, styles, line)
+	end
 	
 	-- Calculate whole line sizing
 	line.width, line.height, line.descent, line.extlead = aegisub.text_extents(line.styleref, line.text_stripped)
 	line.width = line.width * meta.video_x_correct_factor
 
-	-- Calculate syllable sizing
+	-- Calculate syllable sizing, measuring all of the syllables at once
+	local texts = {}
+	for s = 0, line.kara.n do
+		local syl = line.kara[s]
+		table.insert(texts, syl.text_spacestripped)
+		table.insert(texts, syl.prespace)
+		table.insert(texts, syl.postspace)
+	end
+	local extents = aegisub.text_extents_batch(line.styleref, texts)
 	for s = 0, line.kara.n do
 		local syl = line.kara[s]
+		local text, prespace, postspace = extents[s*3+1], extents[s*3+2], extents[s*3+3]
 		syl.style = line.styleref
-		syl.width, syl.height = aegisub.text_extents(syl.style, syl.text_spacestripped)
+		syl.width, syl.height = text.width, text.height
 		syl.width = syl.width * meta.video_x_correct_factor
-		syl.prespacewidth = aegisub.text_extents(syl.style, syl.prespace) * meta.video_x_correct_factor
-		syl.postspacewidth = aegisub.text_extents(syl.style, syl.postspace) * meta.video_x_correct_factor
+		syl.prespacewidth = prespace.width * meta.video_x_correct_factor
+		syl.postspacewidth = postspace.width * meta.video_x_correct_factor
 	end
 	
 	-- Calculate furigana sizing
@@ -21,6 +21,12 @@
 #include <boost/locale/boundary/index.hpp>
 #include <boost/locale/boundary/segment.hpp>
 #include <boost/locale/boundary/types.hpp>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AGI_DIALOGUE_LEXER_SSE2
+#include <emmintrin.h>
+#endif
 
 namespace {
 
@@ -99,6 +105,7 @@ public:
 class WordSplitter {
 	std::string const& text;
 	std::vector<DialogueToken> &tokens;
+	WordSplitCache *cache;
 	size_t pos = 0;
 
 	void SwitchTo(size_t &i, int type, size_t len) {
@@ -113,6 +120,18 @@ class WordSplitter {
 	}
 
 	void SplitText(size_t &i) {
+		std::string run;
+		const size_t first = i;
+		if (cache) {
+			run = text.substr(pos, tokens[i].length);
+			if (auto split = cache->Find(run)) {
+				tokens[i] = split->front();
+				tokens.insert(tokens.begin() + i + 1, split->begin() + 1, split->end());
+				i += split->size() - 1;
+				return;
+			}
+		}
+
 		using namespace boost::locale::boundary;
 		ssegment_index map(word, text.begin() + pos, text.begin() + pos + tokens[i].length);
 		for (auto const& segment : map) {
@@ -122,6 +141,9 @@ class WordSplitter {
 			else
 				SwitchTo(i, dt::TEXT, len);
 		}
+
+		if (cache)
+			cache->Add(std::move(run), std::vector<DialogueToken>(tokens.begin() + first, tokens.begin() + i + 1));
 	}
 
 	void SplitDrawing(size_t &i) {
@@ -183,9 +205,10 @@ class WordSplitter {
 	}
 
 public:
-	WordSplitter(std::string const& text, std::vector<DialogueToken> &tokens)
+	WordSplitter(std::string const& text, std::vector<DialogueToken> &tokens, WordSplitCache *cache)
 	: text(text)
 	, tokens(tokens)
+	, cache(cache)
 	{ }
 
 	void SplitWords() {
@@ -202,11 +225,260 @@ public:
 		}
 	}
 };
+
+/// Find the first occurrence of any of four bytes in str[pos, len), or len
+/// if there isn't one
+size_t find_any_of(const char *str, size_t pos, size_t len, char a, char b, char c, char d) {
+#ifdef AGI_DIALOGUE_LEXER_SSE2
+	const __m128i va = _mm_set1_epi8(a);
+	const __m128i vb = _mm_set1_epi8(b);
+	const __m128i vc = _mm_set1_epi8(c);
+	const __m128i vd = _mm_set1_epi8(d);
+	for (; pos + 16 <= len; pos += 16) {
+		__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(str + pos));
+		__m128i hits = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(bytes, va), _mm_cmpeq_epi8(bytes, vb)),
+			_mm_or_si128(_mm_cmpeq_epi8(bytes, vc), _mm_cmpeq_epi8(bytes, vd)));
+		if (int mask = _mm_movemask_epi8(hits)) {
+			while (!(mask & 1)) {
+				mask >>= 1;
+				++pos;
+			}
+			return pos;
+		}
+	}
+#endif
+	for (; pos < len; ++pos) {
+		char ch = str[pos];
+		if (ch == a || ch == b || ch == c || ch == d)
+			return pos;
+	}
+	return len;
+}
+
+bool is_space(char c) {
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+bool is_lower(char c) {
+	return c >= 'a' && c <= 'z';
+}
+
+bool is_variable_char(char c) {
+	return is_lower(c) || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+/// Hand-written state machine equivalent to the old lexertl grammar, with
+/// one state per lexer state of that grammar
+class DialogueLexer {
+	enum class State { INITIAL, OVR, ARG, TAGSTART, TAGNAME };
+
+	const char *str;
+	const size_t len;
+	const bool karaoke_templater;
+	State state = State::INITIAL;
+	int paren_depth = 0;
+	TokenVec tokens;
+
+	void Add(int type, size_t length) {
+		if (tokens.size() && tokens.back().type == type)
+			tokens.back().length += length;
+		else
+			tokens.push_back(DialogueToken{type, length});
+	}
+
+	/// Length of the karaoke template expression or variable at pos, or 0
+	/// if there isn't one
+	size_t Templater(size_t pos, int *type) const {
+		if (!karaoke_templater) return 0;
+		if (str[pos] == '!') {
+			auto end = static_cast<const char *>(memchr(str + pos + 1, '!', len - pos - 1));
+			if (!end) return 0;
+			*type = dt::KARAOKE_TEMPLATE;
+			return end - (str + pos) + 1;
+		}
+		if (str[pos] == '$') {
+			size_t end = pos + 1;
+			while (end < len && is_variable_char(str[end])) ++end;
+			if (end == pos + 1) return 0;
+			*type = dt::KARAOKE_VARIABLE;
+			return end - pos;
+		}
+		return 0;
+	}
+
+	/// Does a token other than a plain character start at pos in the
+	/// INITIAL state?
+	bool TextBoundary(size_t pos) const {
+		int type;
+		switch (str[pos]) {
+			case '{': return true;
+			case '\\':
+				return pos + 1 < len && (str[pos + 1] == 'n' || str[pos + 1] == 'N' || str[pos + 1] == 'h');
+			case '\1': return !karaoke_templater;
+			default: return Templater(pos, &type) != 0;
+		}
+	}
+
+	/// Length of the text run starting at pos, which may be an entire line
+	/// with no override blocks
+	size_t TextRun(size_t pos) const {
+		const char templater_a = karaoke_templater ? '!' : '\1';
+		const char templater_b = karaoke_templater ? '$' : '\1';
+		size_t end = pos + 1;
+		while ((end = find_any_of(str, end, len, '{', '\\', templater_a, templater_b)) < len) {
+			if (TextBoundary(end))
+				break;
+			++end;
+		}
+		return end - pos;
+	}
+
+	size_t SpaceRun(size_t pos) const {
+		size_t end = pos + 1;
+		while (end < len && is_space(str[end])) ++end;
+		return end - pos;
+	}
+
+	/// Length of the run of single-character tokens starting at pos which
+	/// ends at any of the given characters, whitespace or a templater token
+	template<typename Stop>
+	size_t Run(size_t pos, Stop stop) const {
+		size_t end = pos + 1;
+		int type;
+		while (end < len && !stop(str[end]) && !is_space(str[end]) && !Templater(end, &type))
+			++end;
+		return end - pos;
+	}
+
+	void SetState(State new_state, int type, size_t length, size_t &pos) {
+		state = new_state;
+		Add(type, length);
+		pos += length;
+	}
+
+	void Initial(size_t &pos) {
+		switch (str[pos]) {
+			case '{':
+				paren_depth = 0;
+				return SetState(State::OVR, dt::OVR_BEGIN, 1, pos);
+			case '\1':
+				if (!karaoke_templater)
+					return SetState(State::INITIAL, 1, 1, pos);
+				break;
+			case '\\':
+				if (TextBoundary(pos))
+					return SetState(State::INITIAL, dt::LINE_BREAK, 2, pos);
+				break;
+		}
+		SetState(State::INITIAL, dt::TEXT, TextRun(pos), pos);
+	}
+
+	void Override(size_t &pos) {
+		char c = str[pos];
+		if (c == '{') return SetState(State::OVR, dt::ERROR, 1, pos);
+		if (c == '}') return SetState(State::INITIAL, dt::OVR_END, 1, pos);
+		if (c == '\\') return SetState(State::TAGSTART, dt::TAG_START, 1, pos);
+		if (is_space(c)) return SetState(State::OVR, dt::WHITESPACE, SpaceRun(pos), pos);
+		if (c == '\1' && !karaoke_templater) return SetState(State::OVR, 1, 1, pos);
+
+		const bool kt = karaoke_templater;
+		SetState(State::OVR, dt::COMMENT, Run(pos, [=](char c) {
+			return c == '{' || c == '}' || c == '\\' || (c == '\1' && !kt);
+		}), pos);
+	}
+
+	void Argument(size_t &pos) {
+		switch (str[pos]) {
+			case '{': return SetState(State::ARG, dt::ERROR, 1, pos);
+			case '}': return SetState(State::INITIAL, dt::OVR_END, 1, pos);
+			case '(':
+				++paren_depth;
+				return SetState(State::ARG, dt::OPEN_PAREN, 1, pos);
+			case ')':
+				--paren_depth;
+				return SetState(paren_depth == 0 ? State::OVR : State::ARG, dt::CLOSE_PAREN, 1, pos);
+			case '\\': return SetState(State::TAGSTART, dt::TAG_START, 1, pos);
+			case ',': return SetState(State::ARG, dt::ARG_SEP, 1, pos);
+		}
+		if (is_space(str[pos]))
+			return SetState(State::ARG, dt::WHITESPACE, SpaceRun(pos), pos);
+
+		SetState(State::ARG, dt::ARG, Run(pos, [](char c) {
+			return c == '{' || c == '}' || c == '(' || c == ')' || c == '\\' || c == ',';
+		}), pos);
+	}
+
+	void TagStart(size_t &pos) {
+		char c = str[pos];
+		if (is_space(c)) return SetState(State::TAGSTART, dt::WHITESPACE, SpaceRun(pos), pos);
+		if (c == 'f' && pos + 1 < len && str[pos + 1] == 'n') return SetState(State::ARG, dt::TAG_NAME, 2, pos);
+		if (c == 'r') return SetState(State::ARG, dt::TAG_NAME, 1, pos);
+		if (c == '\\') return SetState(State::TAGSTART, dt::TAG_START, 1, pos);
+		if (c == '}') return SetState(State::INITIAL, dt::OVR_END, 1, pos);
+		if (is_lower(c) || (c >= '0' && c <= '9')) return SetState(State::TAGNAME, dt::TAG_NAME, 1, pos);
+		SetState(State::OVR, dt::COMMENT, 1, pos);
+	}
+
+	void TagName(size_t &pos) {
+		switch (str[pos]) {
+			case '(':
+				++paren_depth;
+				return SetState(State::ARG, dt::OPEN_PAREN, 1, pos);
+			case ')':
+				--paren_depth;
+				return SetState(paren_depth == 0 ? State::OVR : State::TAGNAME, dt::CLOSE_PAREN, 1, pos);
+			case '}': return SetState(State::INITIAL, dt::OVR_END, 1, pos);
+			case '\\': return SetState(State::TAGSTART, dt::TAG_START, 1, pos);
+		}
+		if (is_lower(str[pos])) {
+			size_t end = pos + 1;
+			while (end < len && is_lower(str[end])) ++end;
+			return SetState(State::ARG, dt::TAG_NAME, end - pos, pos);
+		}
+		SetState(State::ARG, dt::ARG, 1, pos);
+	}
+
+public:
+	DialogueLexer(std::string const& str, bool karaoke_templater)
+	: str(str.data())
+	, len(str.size())
+	, karaoke_templater(karaoke_templater)
+	{ }
+
+	TokenVec Tokenize() {
+		size_t pos = 0;
+		while (pos < len) {
+			// Template expressions and variables are always longer than one
+			// character and start with characters no other multi-character
+			// token can start with, so they win in every state
+			int type;
+			if (size_t length = Templater(pos, &type)) {
+				Add(type, length);
+				pos += length;
+				continue;
+			}
+
+			switch (state) {
+				case State::INITIAL:  Initial(pos);  break;
+				case State::OVR:      Override(pos); break;
+				case State::ARG:      Argument(pos); break;
+				case State::TAGSTART: TagStart(pos); break;
+				case State::TAGNAME:  TagName(pos);  break;
+			}
+		}
+		return std::move(tokens);
+	}
+};
 }
 
 namespace agi {
 namespace ass {
 
+std::vector<DialogueToken> TokenizeDialogueBody(std::string const& str, bool karaoke_templater) {
+	return DialogueLexer(str, karaoke_templater).Tokenize();
+}
+
 std::vector<DialogueToken> SyntaxHighlight(std::string const& text, std::vector<DialogueToken> const& tokens, SpellChecker *spellchecker) {
 	return SyntaxHighlighter(text, spellchecker).Highlight(tokens);
 }
@@ -318,9 +590,31 @@ tag_p:
 	}
 }
 
-void SplitWords(std::string const& str, std::vector<DialogueToken> &tokens) {
+void WordSplitCache::NextLine() {
+	previous.clear();
+	swap(current, previous);
+}
+
+WordSplitCache::Tokens const *WordSplitCache::Find(std::string const& text) {
+	auto it = current.find(text);
+	if (it != current.end())
+		return &it->second;
+
+	it = previous.find(text);
+	if (it == previous.end())
+		return nullptr;
+	return &current.emplace(text, std::move(it->second)).first->second;
+}
+
+void WordSplitCache::Add(std::string text, Tokens tokens) {
+	current.emplace(std::move(text), std::move(tokens));
+}
+
+void SplitWords(std::string const& str, std::vector<DialogueToken> &tokens, WordSplitCache *cache) {
 	MarkDrawings(str, tokens);
-	WordSplitter(str, tokens).SplitWords();
+	if (cache)
+		cache->NextLine();
+	WordSplitter(str, tokens, cache).SplitWords();
 }
 
 }
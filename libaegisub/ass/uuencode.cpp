@@ -17,6 +17,7 @@
 #include <libaegisub/ass/uuencode.h>
 
 #include <algorithm>
+#include <cstring>
 
 // Despite being called uuencoding by ass_specs.doc, the format is actually
 // somewhat different from real uuencoding.  Each 3-byte chunk is split into 4
@@ -26,60 +27,108 @@
 
 namespace agi { namespace ass {
 
+namespace {
+inline void EncodeGroup(const unsigned char *src, char *dst) {
+	dst[0] = static_cast<char>((src[0] >> 2) + 33);
+	dst[1] = static_cast<char>((((src[0] & 0x3) << 4) | (src[1] >> 4)) + 33);
+	dst[2] = static_cast<char>((((src[1] & 0xF) << 2) | (src[2] >> 6)) + 33);
+	dst[3] = static_cast<char>((src[2] & 0x3F) + 33);
+}
+
+/// Number of input bytes which fill exactly one 80 character output line
+const size_t bytes_per_line = 60;
+}
+
 std::string UUEncode(const char *begin, const char *end, bool insert_linebreaks) {
-	size_t size = std::distance(begin, end);
-	std::string ret;
-	ret.reserve((size * 4 + 2) / 3 + size / 80 * 2);
-
-	size_t written = 0;
-	for (size_t pos = 0; pos < size; pos += 3) {
-		unsigned char src[3] = { '\0', '\0', '\0' };
-		memcpy(src, begin + pos, std::min<size_t>(3u, size - pos));
-
-		unsigned char dst[4] = {
-			static_cast<unsigned char>(src[0] >> 2),
-			static_cast<unsigned char>(((src[0] & 0x3) << 4) | ((src[1] & 0xF0) >> 4)),
-			static_cast<unsigned char>(((src[1] & 0xF) << 2) | ((src[2] & 0xC0) >> 6)),
-			static_cast<unsigned char>(src[2] & 0x3F)
-		};
-
-		for (size_t i = 0; i < std::min<size_t>(size - pos + 1, 4u); ++i) {
-			ret += dst[i] + 33;
-
-			if (insert_linebreaks && ++written == 80 && pos + 3 < size) {
-				written = 0;
-				ret += "\r\n";
-			}
+	const size_t size = std::distance(begin, end);
+	const size_t full_groups = size / 3;
+	const size_t remainder = size % 3;
+	const size_t chars = full_groups * 4 + (remainder ? remainder + 1 : 0);
+	// Lines are only broken when there is more output after them
+	const size_t breaks = insert_linebreaks && chars > 0 ? (chars - 1) / 80 : 0;
+
+	std::string ret(chars + breaks * 2, '\0');
+	auto src = reinterpret_cast<const unsigned char *>(begin);
+	char *dst = &ret[0];
+
+	// Whole lines are encoded in a branch-free inner loop which the compiler
+	// can unroll and vectorize
+	size_t pos = 0;
+	for (; pos + bytes_per_line <= full_groups * 3; pos += bytes_per_line) {
+		for (size_t i = 0; i < bytes_per_line; i += 3, dst += 4)
+			EncodeGroup(src + pos + i, dst);
+		if (insert_linebreaks && pos + bytes_per_line < size) {
+			*dst++ = '\r';
+			*dst++ = '\n';
 		}
 	}
 
+	for (; pos < full_groups * 3; pos += 3, dst += 4)
+		EncodeGroup(src + pos, dst);
+
+	if (remainder) {
+		unsigned char last[3] = { '\0', '\0', '\0' };
+		memcpy(last, src + pos, remainder);
+		char group[4];
+		EncodeGroup(last, group);
+		memcpy(dst, group, remainder + 1);
+	}
+
 	return ret;
 }
 
 std::vector<char> UUDecode(const char *begin, const char *end) {
 	std::vector<char> ret;
-	size_t len = end - begin;
-	ret.reserve(len * 3 / 4);
-
-	for (size_t pos = 0; pos + 1 < len; ) {
-		size_t bytes = 0;
-		unsigned char src[4] = { '\0', '\0', '\0', '\0' };
-		for (size_t i = 0; i < 4 && pos < len; ++pos) {
-			char c = begin[pos];
-			if (c && c != '\n' && c != '\r') {
-				src[i++] = c - 33;
-				++bytes;
+	UUDecode(begin, end, ret);
+	return ret;
+}
+
+void UUDecode(const char *begin, const char *end, std::vector<char>& out) {
+	const size_t len = std::distance(begin, end);
+	out.resize(len * 3 / 4 + 3);
+	char *dst = out.data();
+
+	unsigned char src[4];
+	size_t count = 0;
+	for (size_t pos = 0; pos < len; ++pos) {
+		// Every run of four data characters on a line is decoded at once,
+		// which is everything but the line ends in normal data
+		if (count == 0) {
+			while (pos + 4 <= len) {
+				auto in = reinterpret_cast<const unsigned char *>(begin + pos);
+				if (!in[0] || in[0] == '\n' || in[0] == '\r' ||
+					!in[1] || in[1] == '\n' || in[1] == '\r' ||
+					!in[2] || in[2] == '\n' || in[2] == '\r' ||
+					!in[3] || in[3] == '\n' || in[3] == '\r')
+					break;
+				const unsigned char a = in[0] - 33, b = in[1] - 33, c = in[2] - 33, d = in[3] - 33;
+				dst[0] = static_cast<char>((a << 2) | (b >> 4));
+				dst[1] = static_cast<char>(((b & 0xF) << 4) | (c >> 2));
+				dst[2] = static_cast<char>(((c & 0x3) << 6) | d);
+				dst += 3;
+				pos += 4;
 			}
+			if (pos == len) break;
 		}
 
-		if (bytes > 1)
-			ret.push_back((src[0] << 2) | (src[1] >> 4));
-		if (bytes > 2)
-			ret.push_back(((src[1] & 0xF) << 4) | (src[2] >> 2));
-		if (bytes > 3)
-			ret.push_back(((src[2] & 0x3) << 6) | (src[3]));
+		const char c = begin[pos];
+		if (!c || c == '\n' || c == '\r') continue;
+		src[count++] = static_cast<unsigned char>(c - 33);
+		if (count == 4) {
+			dst[0] = static_cast<char>((src[0] << 2) | (src[1] >> 4));
+			dst[1] = static_cast<char>(((src[1] & 0xF) << 4) | (src[2] >> 2));
+			dst[2] = static_cast<char>(((src[2] & 0x3) << 6) | src[3]);
+			dst += 3;
+			count = 0;
+		}
 	}
 
-	return ret;
+	// A trailing partial group of n characters holds n - 1 bytes
+	if (count > 1)
+		*dst++ = static_cast<char>((src[0] << 2) | (src[1] >> 4));
+	if (count > 2)
+		*dst++ = static_cast<char>(((src[1] & 0xF) << 4) | (src[2] >> 2));
+
+	out.resize(dst - out.data());
 }
 } }
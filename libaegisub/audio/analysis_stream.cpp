@@ -0,0 +1,147 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include "libaegisub/audio/analysis_stream.h"
+
+#include "libaegisub/audio/provider.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+/// Get the largest factor which divides the rate exactly and leaves it at
+/// least min_rate, so that the output rate is exact
+int DecimationFactor(int rate, int min_rate) {
+	for (int factor = min_rate > 0 ? rate / min_rate : 1; factor > 1; --factor) {
+		if (rate % factor == 0)
+			return factor;
+	}
+	return 1;
+}
+}
+
+namespace agi {
+constexpr int64_t AudioAnalysisStream::ChunkSamples;
+
+AudioAnalysisStream::AudioAnalysisStream(AudioProvider const& source, int min_rate, bool cache)
+: source(source)
+, factor(DecimationFactor(source.GetSampleRate(), min_rate))
+, num_samples((source.GetNumSamples() + factor - 1) / factor)
+, half_taps(factor > 1 ? 16 * factor : 0)
+, cache(cache)
+{
+	if (cache)
+		chunks.resize((num_samples + ChunkSamples - 1) / ChunkSamples);
+	if (factor == 1) return;
+
+	// Windowed-sinc low-pass with its cutoff a little below the output's
+	// Nyquist frequency, so that the Blackman window's transition band ends
+	// before anything can alias
+	const double pi = 3.14159265358979323846;
+	const double cutoff = 0.4 / factor;
+	const int n = 2 * half_taps + 1;
+	taps.resize(n);
+	double sum = 0;
+	for (int i = 0; i < n; ++i) {
+		const int k = i - half_taps;
+		const double sinc = k == 0 ? 2 * cutoff : std::sin(2 * pi * cutoff * k) / (pi * k);
+		const double window = 0.42 - 0.5 * std::cos(2 * pi * i / (n - 1)) + 0.08 * std::cos(4 * pi * i / (n - 1));
+		taps[i] = float(sinc * window);
+		sum += taps[i];
+	}
+	for (auto& tap : taps)
+		tap = float(tap / sum);
+}
+
+AudioAnalysisStream::~AudioAnalysisStream() = default;
+
+int AudioAnalysisStream::GetSampleRate() const {
+	return source.GetSampleRate() / factor;
+}
+
+bool AudioAnalysisStream::IsPassthrough() const {
+	return factor == 1 && !source.AreSamplesFloat() && source.GetBytesPerSample() == 2 && source.GetChannels() == 1;
+}
+
+void AudioAnalysisStream::Compute(int16_t *buf, int64_t start, int64_t count) {
+	if (factor == 1) {
+		source.GetInt16MonoAudio(buf, start, count);
+		return;
+	}
+
+	const size_t n = taps.size();
+	input.resize((count - 1) * factor + n);
+	source.GetInt16MonoAudio(input.data(), start * factor - half_taps, input.size());
+
+	const float *t = taps.data();
+	for (int64_t i = 0; i < count; ++i) {
+		const int16_t *in = &input[i * factor];
+		float acc = 0;
+		for (size_t k = 0; k < n; ++k)
+			acc += t[k] * in[k];
+		buf[i] = (int16_t)std::min(32767.f, std::max(-32768.f, std::round(acc)));
+	}
+}
+
+void AudioAnalysisStream::GetAudio(int16_t *buf, int64_t start, int64_t count) {
+	if (start < 0) {
+		const int64_t zeros = std::min(-start, count);
+		memset(buf, 0, sizeof(int16_t) * zeros);
+		buf += zeros;
+		count -= zeros;
+		start = 0;
+	}
+	if (start + count > num_samples) {
+		const int64_t zeros = std::min(count, start + count - num_samples);
+		count -= zeros;
+		memset(buf + count, 0, sizeof(int16_t) * zeros);
+	}
+	if (count <= 0) return;
+
+	if (!cache || IsPassthrough()) {
+		Compute(buf, start, count);
+		return;
+	}
+
+	while (count > 0) {
+		const size_t index = start / ChunkSamples;
+		const int64_t chunk_start = index * ChunkSamples;
+		const int64_t chunk_count = std::min(ChunkSamples, num_samples - chunk_start);
+		const int64_t offset = start - chunk_start;
+		const int64_t len = std::min(count, chunk_count - offset);
+
+		std::unique_ptr<int16_t[]> uncached;
+		const int16_t *data = chunks[index].get();
+		if (!data) {
+			uncached.reset(new int16_t[chunk_count]);
+			Compute(uncached.get(), chunk_start, chunk_count);
+			data = uncached.get();
+
+			// Only keep chunks which won't change as more audio is decoded
+			const int64_t first = std::max<int64_t>(0, chunk_start * factor - half_taps);
+			const int64_t last = std::min(source.GetNumSamples(), (chunk_start + chunk_count) * factor + half_taps);
+			if (source.IsRangeDecoded(first, last - first)) {
+				memory.Add(sizeof(int16_t) * chunk_count);
+				chunks[index] = std::move(uncached);
+			}
+		}
+
+		memcpy(buf, data + offset, sizeof(int16_t) * len);
+		buf += len;
+		start += len;
+		count -= len;
+	}
+}
+}
@@ -0,0 +1,89 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include "block_scheduler.h"
+
+#include "libaegisub/audio/provider.h"
+
+#include <algorithm>
+
+namespace agi {
+AudioBlockScheduler::AudioBlockScheduler(int64_t num_samples, int64_t block_samples)
+: num_samples(num_samples)
+, block_samples(block_samples)
+, decoded((num_samples + block_samples - 1) / block_samples)
+, claimed(decoded.size(), false)
+{
+}
+
+AudioBlockScheduler::~AudioBlockScheduler() {
+	Stop();
+}
+
+void AudioBlockScheduler::Start(int worker_count, std::function<void (size_t)> decode) {
+	for (int i = 0; i < worker_count; ++i) {
+		workers.emplace_back([=] {
+			size_t block;
+			while (Claim(block))
+				decode(block);
+		});
+	}
+}
+
+int AudioBlockScheduler::WorkersFor(AudioProvider const& source) {
+	if (!source.SupportsConcurrentReads())
+		return 1;
+	return static_cast<int>(std::max(1u, std::min(4u, std::thread::hardware_concurrency())));
+}
+
+void AudioBlockScheduler::Stop() {
+	cancelled = true;
+	for (auto& worker : workers)
+		worker.join();
+	workers.clear();
+}
+
+void AudioBlockScheduler::Prioritize(int64_t sample) {
+	if (sample < 0 || sample >= num_samples) return;
+	std::lock_guard<std::mutex> lock(mutex);
+	next = static_cast<size_t>(sample / block_samples);
+}
+
+bool AudioBlockScheduler::IsRangeDecoded(int64_t start, int64_t count) const {
+	const int64_t end = std::min(start + count, num_samples);
+	start = std::max<int64_t>(start, 0);
+	for (int64_t block = start / block_samples; block * block_samples < end; ++block) {
+		if (!decoded[block])
+			return false;
+	}
+	return true;
+}
+
+bool AudioBlockScheduler::Claim(size_t& block) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (cancelled) return false;
+
+	const size_t count = claimed.size();
+	for (size_t i = 0; i < count; ++i) {
+		const size_t candidate = (next + i) % count;
+		if (!claimed[candidate]) {
+			claimed[candidate] = true;
+			next = candidate + 1;
+			block = candidate;
+			return true;
+		}
+	}
+	return false;
+}
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+/// @file block_scheduler.h
+/// @brief Background decoding of fixed-size audio cache blocks
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace agi {
+class AudioProvider;
+
+/// @class AudioBlockScheduler
+/// @brief Decodes the blocks of an audio cache on worker threads
+///
+/// Workers always pick the first block which has not been started at or
+/// after the most recently prioritized block, wrapping around to the start
+/// of the stream once everything after it is done, so that whatever the user
+/// is currently looking at or listening to is decoded first.
+class AudioBlockScheduler {
+	int64_t num_samples;
+	int64_t block_samples;
+
+	std::vector<std::atomic<bool>> decoded;
+	std::vector<bool> claimed;
+	size_t next = 0;
+	std::mutex mutex;
+
+	std::atomic<bool> cancelled{false};
+	std::vector<std::thread> workers;
+
+	bool Claim(size_t& block);
+
+public:
+	/// @param num_samples   Number of samples in the cache
+	/// @param block_samples Number of samples in each block
+	AudioBlockScheduler(int64_t num_samples, int64_t block_samples);
+	~AudioBlockScheduler();
+
+	/// Start decoding
+	/// @param worker_count Number of threads to decode with; decode must be
+	///                     safe to call concurrently for different blocks if
+	///                     this is more than one
+	/// @param decode Function which decodes the block with the given index
+	///               into the cache and then calls MarkDecoded() for it
+	void Start(int worker_count, std::function<void (size_t)> decode);
+
+	/// Get the number of workers to use for decoding from the given source
+	static int WorkersFor(AudioProvider const& source);
+
+	/// Stop decoding and wait for the workers to finish their current block
+	void Stop();
+
+	/// Decode the block containing the given sample and those after it next
+	void Prioritize(int64_t sample);
+
+	/// Flag a block as being readable from the cache
+	void MarkDecoded(size_t block) { decoded[block] = true; }
+
+	/// Has the given block been decoded?
+	bool IsDecoded(size_t block) const { return decoded[block]; }
+
+	/// Have all of the blocks overlapping the given range been decoded?
+	bool IsRangeDecoded(int64_t start, int64_t count) const;
+};
+}
@@ -0,0 +1,199 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include "libaegisub/audio/peak_pyramid.h"
+
+#include "libaegisub/audio/provider.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace agi {
+constexpr std::array<int, 3> AudioPeakPyramid::LevelBits;
+
+AudioPeakPyramid::AudioPeakPyramid(int64_t num_samples)
+: num_samples(num_samples)
+{
+	for (int i = 0; i < Levels; ++i) {
+		const size_t count = (num_samples + (int64_t(1) << LevelBits[i]) - 1) >> LevelBits[i];
+		levels[i].buckets.resize(count);
+		levels[i].valid = std::vector<std::atomic<bool>>(count);
+	}
+}
+
+void AudioPeakPyramid::Update(AudioProvider const& provider, int64_t start, int64_t end) {
+	const int64_t bucket_size = int64_t(1) << LevelBits[0];
+	start = std::max<int64_t>(start, 0);
+	end = std::min(end, num_samples);
+	if (start >= end) return;
+
+	// Extend the range out to whole buckets where the neighboring samples are
+	// already available, and shrink it to whole buckets otherwise
+	int64_t first = start & ~(bucket_size - 1);
+	if (first < start && !provider.IsRangeDecoded(first, start - first))
+		first += bucket_size;
+	int64_t last = std::min(num_samples, (end + bucket_size - 1) & ~(bucket_size - 1));
+	if (last > end && !provider.IsRangeDecoded(end, last - end))
+		last = end & ~(bucket_size - 1);
+	if (first >= last) return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	SummarizeSamples(provider, first, last);
+
+	int64_t first_bucket = first >> LevelBits[0];
+	int64_t last_bucket = (last - 1) >> LevelBits[0];
+	for (int level = 1; level < Levels; ++level) {
+		const int shift = LevelBits[level] - LevelBits[level - 1];
+		first_bucket >>= shift;
+		last_bucket >>= shift;
+		SummarizeParents(level, first_bucket, last_bucket);
+	}
+}
+
+void AudioPeakPyramid::SummarizeSamples(AudioProvider const& provider, int64_t start, int64_t end) {
+	const int64_t bucket_size = int64_t(1) << LevelBits[0];
+	const int64_t chunk = int64_t(1) << LevelBits[Levels - 1];
+	buffer.resize(chunk);
+
+	auto& level = levels[0];
+	while (start < end) {
+		const int64_t count = std::min(chunk, end - start);
+		provider.GetInt16MonoAudio(buffer.data(), start, count);
+
+		for (int64_t offset = 0; offset < count; offset += bucket_size) {
+			const int64_t index = (start + offset) >> LevelBits[0];
+			if (level.valid[index]) continue;
+
+			Bucket b{0, 0, 0, 0};
+			for (int64_t i = offset, bucket_end = std::min(count, offset + bucket_size); i < bucket_end; ++i) {
+				const int16_t sample = buffer[i];
+				if (sample > 0) {
+					b.max = std::max(b.max, sample);
+					b.pos_sum += sample;
+				}
+				else {
+					b.min = std::min(b.min, sample);
+					b.neg_sum += sample;
+				}
+			}
+
+			level.buckets[index] = b;
+			level.valid[index] = true;
+		}
+
+		start += count;
+	}
+}
+
+void AudioPeakPyramid::SummarizeParents(int level, int64_t first, int64_t last) {
+	auto& parents = levels[level];
+	auto const& children = levels[level - 1];
+	const int shift = LevelBits[level] - LevelBits[level - 1];
+
+	for (int64_t index = first; index <= last; ++index) {
+		if (parents.valid[index]) continue;
+
+		const size_t child_begin = index << shift;
+		const size_t child_end = std::min(children.buckets.size(), child_begin + (size_t(1) << shift));
+
+		Bucket b{0, 0, 0, 0};
+		bool complete = true;
+		for (size_t i = child_begin; i < child_end; ++i) {
+			// Unfilled buckets are all zero, so they can be folded in harmlessly
+			auto const& child = children.buckets[i];
+			complete = complete && children.valid[i];
+			b.min = std::min(b.min, child.min);
+			b.max = std::max(b.max, child.max);
+			b.pos_sum += child.pos_sum;
+			b.neg_sum += child.neg_sum;
+		}
+
+		parents.buckets[index] = b;
+		if (complete)
+			parents.valid[index] = true;
+	}
+}
+
+bool AudioPeakPyramid::Get(int64_t start, int64_t end, AudioPeak *out) const {
+	AudioPeak ret;
+
+	int64_t i = std::max<int64_t>(start, 0) >> LevelBits[0];
+	const int64_t last = end >= num_samples
+		? static_cast<int64_t>(levels[0].buckets.size())
+		: end >> LevelBits[0];
+
+	while (i < last) {
+		// Use the coarsest bucket which starts at i and fits in the range
+		int level = Levels - 1;
+		for (; level > 0; --level) {
+			const int64_t span = int64_t(1) << (LevelBits[level] - LevelBits[0]);
+			if ((i & (span - 1)) == 0 && i + span <= last)
+				break;
+		}
+
+		const int shift = LevelBits[level] - LevelBits[0];
+		const size_t index = i >> shift;
+		if (!levels[level].valid[index])
+			return false;
+
+		auto const& b = levels[level].buckets[index];
+		ret.min = std::min(ret.min, b.min);
+		ret.max = std::max(ret.max, b.max);
+		ret.pos_sum += b.pos_sum;
+		ret.neg_sum += b.neg_sum;
+		i += int64_t(1) << shift;
+	}
+
+	*out = ret;
+	return true;
+}
+
+constexpr int AudioLoudnessOverview::Floor;
+
+AudioLoudnessOverview::AudioLoudnessOverview(int64_t num_samples, size_t slices)
+: levels(num_samples > 0 ? slices : 0)
+, num_samples(num_samples)
+, remaining(levels.size())
+{
+}
+
+bool AudioLoudnessOverview::Update(AudioPeakPyramid const& peaks) {
+	if (!remaining) return false;
+
+	const int64_t bucket_size = int64_t(1) << AudioPeakPyramid::LevelBits[0];
+	const size_t slices = levels.size();
+	bool changed = false;
+	for (size_t i = 0; i < slices; ++i) {
+		if (levels[i]) continue;
+
+		// The pyramid works in whole buckets, so slices smaller than a
+		// bucket are widened to one
+		const int64_t start = (num_samples * int64_t(i) / int64_t(slices)) & ~(bucket_size - 1);
+		int64_t end = (num_samples * int64_t(i + 1) / int64_t(slices) + bucket_size - 1) & ~(bucket_size - 1);
+		end = std::max(end, start + bucket_size);
+
+		AudioPeak peak;
+		if (!peaks.Get(start, end, &peak)) continue;
+
+		const int64_t count = std::max<int64_t>(1, std::min(end, num_samples) - start);
+		const double average = double(peak.pos_sum - peak.neg_sum) / count;
+		const double db = average > 0 ? 20 * std::log10(average / 32768) : -Floor;
+		const double fraction = std::min(1.0, std::max(0.0, (db + Floor) / Floor));
+		levels[i] = static_cast<uint8_t>(1 + std::lround(fraction * 254));
+		--remaining;
+		changed = true;
+	}
+	return changed;
+}
+}
@@ -0,0 +1,137 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include "libaegisub/audio/playback_buffer.h"
+
+#include "libaegisub/audio/provider.h"
+#include "libaegisub/log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace agi {
+AudioPlaybackBuffer::AudioPlaybackBuffer(AudioProvider *provider, bool int16_mono, int latency_ms)
+: provider(provider)
+, int16_mono(int16_mono)
+, frame_size(int16_mono ? sizeof(int16_t) : provider->GetChannels() * provider->GetBytesPerSample())
+, silence(!int16_mono && provider->GetBytesPerSample() == 1 ? 128 : 0)
+, latency_frames(std::max<int64_t>(1, int64_t(provider->GetSampleRate()) * std::max(latency_ms, 1) / 1000))
+, chunk_frames(std::max<int64_t>(1, latency_frames / 4))
+{
+	// Twice the latency so that the feeder never has to wait for the reader
+	// to free up space
+	int64_t size = 1;
+	while (size < latency_frames * 2)
+		size <<= 1;
+	ring.resize(size * frame_size);
+	ring_mask = size - 1;
+}
+
+AudioPlaybackBuffer::~AudioPlaybackBuffer() {
+	Stop();
+}
+
+void AudioPlaybackBuffer::Start(int64_t start_pos, int64_t end_pos) {
+	Stop();
+
+	start = start_pos;
+	end = end_pos;
+	write_pos = 0;
+	read_pos = 0;
+	Fill();
+
+	feeder_quit = false;
+	feeder = std::thread([=] { FeederThread(); });
+}
+
+void AudioPlaybackBuffer::Stop() {
+	if (!feeder.joinable()) return;
+
+	{
+		std::lock_guard<std::mutex> lock(feeder_mutex);
+		feeder_quit = true;
+	}
+	feeder_cond.notify_all();
+	feeder.join();
+
+	if (underruns != reported_underruns) {
+		LOG_I("audio/player/buffer") << (underruns - reported_underruns)
+			<< " underruns during playback, " << underrun_frames << " frames of silence inserted in total";
+		reported_underruns = underruns;
+	}
+}
+
+bool AudioPlaybackBuffer::Fill() {
+	const int64_t read = read_pos.load(std::memory_order_acquire);
+	const int64_t target = std::min(read + latency_frames, end - start);
+
+	// Anything before the read position was skipped over by an underrun
+	int64_t pos = std::max(write_pos.load(std::memory_order_relaxed), read);
+	if (pos >= target) return false;
+
+	while (pos < target) {
+		const int64_t index = pos & ring_mask;
+		const int64_t count = std::min({target - pos, chunk_frames, ring_mask + 1 - index});
+		char *dst = &ring[index * frame_size];
+		if (int16_mono)
+			provider->GetInt16MonoAudioWithVolume(reinterpret_cast<int16_t *>(dst), start + pos, count, volume);
+		else
+			provider->GetAudioWithVolume(dst, start + pos, count, volume);
+
+		pos += count;
+		write_pos.store(pos, std::memory_order_release);
+	}
+	return true;
+}
+
+void AudioPlaybackBuffer::FeederThread() {
+	const auto poll = std::chrono::milliseconds(std::max<int64_t>(1,
+		chunk_frames * 1000 / std::max(provider->GetSampleRate(), 1)));
+
+	std::unique_lock<std::mutex> lock(feeder_mutex);
+	while (!feeder_quit) {
+		lock.unlock();
+		const bool filled = Fill();
+		lock.lock();
+		if (!filled && !feeder_quit)
+			feeder_cond.wait_for(lock, poll);
+	}
+}
+
+size_t AudioPlaybackBuffer::Read(void *buf, size_t frames) {
+	auto dst = static_cast<char *>(buf);
+	const int64_t read = read_pos.load(std::memory_order_relaxed);
+	const int64_t written = write_pos.load(std::memory_order_acquire);
+
+	const int64_t playable = std::max<int64_t>(0, std::min<int64_t>(frames, end - start - read));
+	const int64_t copied = std::max<int64_t>(0, std::min(playable, written - read));
+
+	for (int64_t done = 0; done < copied; ) {
+		const int64_t index = (read + done) & ring_mask;
+		const int64_t count = std::min(copied - done, ring_mask + 1 - index);
+		memcpy(dst + done * frame_size, &ring[index * frame_size], count * frame_size);
+		done += count;
+	}
+	memset(dst + copied * frame_size, silence, (frames - copied) * frame_size);
+
+	if (copied < playable) {
+		++underruns;
+		underrun_frames += playable - copied;
+	}
+
+	read_pos.store(read + frames, std::memory_order_release);
+	return copied;
+}
+}
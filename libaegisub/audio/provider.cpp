@@ -15,62 +15,20 @@
 // Aegisub Project http://www.aegisub.org/
 
 #include "libaegisub/audio/provider.h"
+#include "libaegisub/audio/clip_export.h"
 
+#include "sample_convert.h"
+
+#include "libaegisub/background_runner.h"
+#include "libaegisub/dispatch.h"
 #include "libaegisub/fs.h"
 #include "libaegisub/io.h"
 #include "libaegisub/log.h"
 #include "libaegisub/util.h"
 
-namespace {
-
-template<typename Source>
-class ConvertFloatToInt16 {
-	Source* src;
-public:
-	ConvertFloatToInt16(Source* src) :src(src) {}
-	int16_t operator[](size_t idx) const {
-		Source expanded = src[idx] * 32768;
-		return expanded < -32768 ? -32768 :
-			expanded > 32767 ? 32767 :
-			static_cast<int16_t>(expanded);
-	}
-};
-
-// 8 bits per sample is assumed to be unsigned with a bias of 128,
-// while everything else is assumed to be signed with zero bias
-class ConvertIntToInt16 {
-	void* src;
-	int bytes_per_sample;
-public:
-	ConvertIntToInt16(void* src, int bytes_per_sample) :src(src), bytes_per_sample(bytes_per_sample) {}
-	const int16_t& operator[](size_t idx) const {
-		return *reinterpret_cast<int16_t*>(reinterpret_cast<char*>(src) + (idx + 1) * bytes_per_sample - sizeof(int16_t));
-	}
-};
-class ConvertUInt8ToInt16 {
-	uint8_t* src;
-public:
-	ConvertUInt8ToInt16(uint8_t* src) :src(src) {}
-	int16_t operator[](size_t idx) const {
-		return int16_t(src[idx]-128) << 8;
-	}
-};
-
-template<typename Source>
-class DownmixToMono {
-	Source src;
-	int channels;
-public:
-	DownmixToMono(Source src, int channels) :src(src), channels(channels) {}
-	int16_t operator[](size_t idx) const {
-		int ret = 0;
-		// Just average the channels together
-		for (int i = 0; i < channels; ++i)
-			ret += src[idx * channels + i];
-		return ret / channels;
-	}
-};
-}
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 namespace agi {
 void AudioProvider::FillBufferInt16Mono(int16_t* buf, int64_t start, int64_t count) const {
@@ -78,44 +36,22 @@ void AudioProvider::FillBufferInt16Mono(int16_t* buf, int64_t start, int64_t cou
 		FillBuffer(buf, start, count);
 		return;
 	}
+
+	// Convert straight from the cache's memory where possible, rather than
+	// copying into a temporary buffer first
+	while (count > 0) {
+		auto span = GetAudioSpan(start, count);
+		if (!span) break;
+		ConvertToInt16Mono(span.data, buf, span.count, channels, bytes_per_sample, float_samples);
+		buf += span.count;
+		start += span.count;
+		count -= span.count;
+	}
+	if (count <= 0) return;
+
 	void* buff = malloc(bytes_per_sample * count * channels);
 	FillBuffer(buff, start, count);
-	if (channels == 1) {
-		if (float_samples) {
-			if (bytes_per_sample == sizeof(float))
-				for (int64_t i = 0; i < count; ++i)
-					buf[i] = ConvertFloatToInt16<float>(reinterpret_cast<float*>(buff))[i];
-			else if (bytes_per_sample == sizeof(double))
-				for (int64_t i = 0; i < count; ++i)
-					buf[i] = ConvertFloatToInt16<double>(reinterpret_cast<double*>(buff))[i];
-		}
-		else {
-			if (bytes_per_sample == sizeof(uint8_t))
-				for (int64_t i = 0; i < count; ++i)
-					buf[i] = ConvertUInt8ToInt16(reinterpret_cast<uint8_t*>(buff))[i];
-			else
-				for (int64_t i = 0; i < count; ++i)
-					buf[i] = ConvertIntToInt16(buff, bytes_per_sample)[i];
-		}
-	}
-	else {
-		if (float_samples) {
-			if (bytes_per_sample == sizeof(float))
-				for (int64_t i = 0; i < count; ++i)
-					buf[i] = DownmixToMono<ConvertFloatToInt16<float> >(ConvertFloatToInt16<float>(reinterpret_cast<float*>(buff)), channels)[i];
-			else if (bytes_per_sample == sizeof(double))
-				for (int64_t i = 0; i < count; ++i)
-					buf[i] = DownmixToMono<ConvertFloatToInt16<double> >(ConvertFloatToInt16<double>(reinterpret_cast<double*>(buff)), channels)[i];
-		}
-		else {
-			if (bytes_per_sample == sizeof(uint8_t))
-				for (int64_t i = 0; i < count; ++i)
-					buf[i] = DownmixToMono<ConvertUInt8ToInt16>(ConvertUInt8ToInt16(reinterpret_cast<uint8_t*>(buff)), channels)[i];
-			else
-				for (int64_t i = 0; i < count; ++i)
-					buf[i] = DownmixToMono<ConvertIntToInt16>(ConvertIntToInt16(buff, bytes_per_sample), channels)[i];
-		}
-	}
+	ConvertToInt16Mono(buff, buf, count, channels, bytes_per_sample, float_samples);
 	free(buff);
 }
 
@@ -266,9 +202,11 @@ public:
 		out.write(reinterpret_cast<char *>(&converted), sizeof(Dest));
 	}
 };
-}
 
-void SaveAudioClip(AudioProvider const& provider, fs::path const& path, int start_time, int end_time) {
+/// Write the given range of audio as a WAV file
+///
+/// @param read_mutex If non-null, held while reading from the provider
+void WriteAudioClip(AudioProvider const& provider, fs::path const& path, int start_time, int end_time, std::mutex *read_mutex) {
 	const auto max_samples = provider.GetNumSamples();
 	const auto start_sample = std::min(max_samples, ((int64_t)start_time * provider.GetSampleRate() + 999) / 1000);
 	const auto end_sample = util::mid(start_sample, ((int64_t)end_time * provider.GetSampleRate() + 999) / 1000, max_samples);
@@ -292,14 +230,52 @@ void SaveAudioClip(AudioProvider const& provider, fs::path const& path, int star
 	out.write("data");
 	out.write<int32_t>(bufsize);
 
-	// samples per read
-	size_t spr = 65536 / bytes_per_sample;
+	// Large reads and writes, as most clips fit in one
+	size_t spr = (4 << 20) / bytes_per_sample;
 	std::vector<char> buf;
 	for (int64_t i = start_sample; i < end_sample; i += spr) {
 		spr = std::min<size_t>(spr, end_sample - i);
 		buf.resize(spr * bytes_per_sample);
-		provider.GetAudio(&buf[0], i, spr);
+		{
+			std::unique_lock<std::mutex> lock;
+			if (read_mutex) lock = std::unique_lock<std::mutex>(*read_mutex);
+			provider.GetAudio(&buf[0], i, spr);
+		}
 		out.write(buf);
 	}
 }
 }
+
+void SaveAudioClip(AudioProvider const& provider, fs::path const& path, int start_time, int end_time) {
+	WriteAudioClip(provider, path, start_time, end_time, nullptr);
+}
+
+void SaveAudioClips(AudioProvider const& provider, std::vector<AudioClip> const& clips, ProgressSink *ps) {
+	if (clips.empty()) return;
+
+	// Writing the files overlaps even if reading from the provider doesn't
+	std::mutex read_mutex;
+	std::mutex *read_lock = provider.SupportsConcurrentReads() ? nullptr : &read_mutex;
+
+	const size_t workers = std::min<size_t>(clips.size(), std::max(2u, std::thread::hardware_concurrency()));
+	std::atomic<size_t> next{0};
+	std::atomic<size_t> done{0};
+	std::atomic<bool> cancelled{false};
+	std::mutex progress_mutex;
+
+	dispatch::Parallel(workers, [&](size_t) {
+		for (size_t i = next++; i < clips.size() && !cancelled; i = next++) {
+			WriteAudioClip(provider, clips[i].path, clips[i].start_time, clips[i].end_time, read_lock);
+
+			if (!ps) continue;
+			std::lock_guard<std::mutex> lock(progress_mutex);
+			ps->SetProgress(++done, clips.size());
+			if (ps->IsCancelled())
+				cancelled = true;
+		}
+	});
+
+	if (cancelled)
+		throw UserCancelException("Audio clip export cancelled");
+}
+}
@@ -16,10 +16,13 @@
 
 #include "libaegisub/audio/provider.h"
 
+#include "sample_convert.h"
+
 #include <libaegisub/log.h>
 #include <libaegisub/make_unique.h>
 
 #include <limits>
+#include <vector>
 
 using namespace agi;
 namespace {
@@ -34,7 +37,55 @@ public:
 	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
 		source->GetInt16MonoAudio(reinterpret_cast<int16_t*>(buf), start, count);
 	}
+
+	bool SupportsConcurrentReads() const override { return source->SupportsConcurrentReads(); }
+	std::string GetCacheIdentity() const override { return source->GetCacheIdentity(); }
 };
+/// Converts to int16 and downmixes anything with more than two channels to
+/// stereo, to make caching the audio cheaper while keeping it playable
+class CompactAudioProvider final : public AudioProviderWrapper {
+	template<typename Source>
+	void Downmix(Source src, int16_t *dst, int64_t count) const {
+		DownmixToStereo<Source> mixed(src, source->GetChannels());
+		for (int64_t i = 0; i < count * 2; ++i)
+			dst[i] = mixed[i];
+	}
+
+public:
+	CompactAudioProvider(std::unique_ptr<AudioProvider> src) : AudioProviderWrapper(std::move(src)) {
+		float_samples = false;
+		channels = std::min(channels, 2);
+		bytes_per_sample = sizeof(int16_t);
+	}
+
+	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
+		const int src_bytes = source->GetBytesPerSample();
+		std::vector<char> raw(count * source->GetChannels() * src_bytes);
+		source->GetAudio(raw.data(), start, count);
+
+		auto dst = static_cast<int16_t *>(buf);
+		if (source->GetChannels() <= 2) {
+			// Converting each channel separately is the same as converting mono
+			ConvertToInt16Mono(raw.data(), dst, count * channels, 1, src_bytes, source->AreSamplesFloat());
+			return;
+		}
+
+		if (source->AreSamplesFloat()) {
+			if (src_bytes == sizeof(float))
+				Downmix(ConvertFloatToInt16<float>(reinterpret_cast<float *>(raw.data())), dst, count);
+			else
+				Downmix(ConvertFloatToInt16<double>(reinterpret_cast<double *>(raw.data())), dst, count);
+		}
+		else if (src_bytes == sizeof(uint8_t))
+			Downmix(ConvertUInt8ToInt16(reinterpret_cast<uint8_t *>(raw.data())), dst, count);
+		else
+			Downmix(ConvertIntToInt16(raw.data(), src_bytes), dst, count);
+	}
+
+	bool SupportsConcurrentReads() const override { return source->SupportsConcurrentReads(); }
+	std::string GetCacheIdentity() const override { return source->GetCacheIdentity(); }
+};
+
 /// Sample doubler with linear interpolation for the samples provider
 /// Requires 16-bit mono input
 class SampleDoublingAudioProvider final : public AudioProviderWrapper {
@@ -45,6 +96,9 @@ public:
 		decoded_samples = decoded_samples * 2;
 	}
 
+	bool SupportsConcurrentReads() const override { return source->SupportsConcurrentReads(); }
+	std::string GetCacheIdentity() const override { return source->GetCacheIdentity(); }
+
 	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
 		int16_t *src, *dst = static_cast<int16_t *>(buf);
 
@@ -98,4 +152,13 @@ std::unique_ptr<AudioProvider> CreateConvertAudioProvider(std::unique_ptr<AudioP
 
 	return provider;
 }
+
+std::unique_ptr<AudioProvider> CreateCompactAudioProvider(std::unique_ptr<AudioProvider> provider) {
+	if (!provider->AreSamplesFloat() && provider->GetBytesPerSample() == 2 && provider->GetChannels() <= 2)
+		return provider;
+
+	LOG_D("audio_provider") << "Compacting " << provider->GetChannels() << " channels of "
+		<< provider->GetBytesPerSample() << " bytes per sample to S16 for caching";
+	return agi::make_unique<CompactAudioProvider>(std::move(provider));
+}
 }
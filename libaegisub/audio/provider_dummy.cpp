@@ -68,6 +68,8 @@ public:
 		float_samples = false;
 		decoded_samples = num_samples = (int64_t)5*30*60*1000 * sample_rate / 1000;
 	}
+
+	bool SupportsConcurrentReads() const override { return true; }
 };
 }
 
@@ -16,74 +16,191 @@
 
 #include "libaegisub/audio/provider.h"
 
+#include "block_scheduler.h"
+
+#include <libaegisub/audio/peak_pyramid.h>
+#include <libaegisub/audio/speech_detector.h>
 #include <libaegisub/file_mapping.h>
 #include <libaegisub/format.h>
 #include <libaegisub/fs.h>
 #include <libaegisub/path.h>
 #include <libaegisub/make_unique.h>
 
+#include <algorithm>
 #include <boost/filesystem/path.hpp>
 #include <boost/interprocess/detail/os_thread_functions.hpp>
 #include <ctime>
-#include <thread>
+#include <mutex>
 
 namespace {
 using namespace agi;
 
+/// Written after the samples in a persistent cache file once it's complete
+struct CacheTrailer {
+	char magic[8];
+	int64_t num_samples;
+	int32_t channels;
+	int32_t bytes_per_sample;
+	int32_t sample_rate;
+	int32_t float_samples;
+};
+
+const char trailer_magic[8] = {'A', 'E', 'G', 'I', 'P', 'C', 'M', '1'};
+
 class HDAudioProvider final : public AudioProviderWrapper {
+	/// Is the cache file kept after closing?
+	const bool persistent;
+	/// Does the cache file already contain all of the audio?
+	const bool reused;
+
 	mutable temp_file_mapping file;
-	std::atomic<bool> cancelled = {false};
-	std::thread decoder;
+	/// The file mapping keeps separate read and write windows, each of which
+	/// has to be used by only one thread at a time
+	mutable std::mutex read_mutex;
+	std::mutex write_mutex;
+
+	static constexpr int64_t block_samples = 65536;
+	AudioPeakPyramid peaks{num_samples};
+	AudioSpeechDetector speech{num_samples, sample_rate};
+	AudioBlockScheduler scheduler{num_samples, block_samples};
 
 	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
-		auto missing = std::min(count, start + count - decoded_samples);
-		if (missing > 0) {
-			memset(static_cast<int16_t*>(buf) + count - missing, 0, missing * bytes_per_sample * channels);
-			count -= missing;
+		const int64_t bps = bytes_per_sample * channels;
+		auto charbuf = static_cast<char *>(buf);
+
+		std::lock_guard<std::mutex> lock(read_mutex);
+		while (count > 0) {
+			const size_t block = start / block_samples;
+			const int64_t read_count = std::min<int64_t>(count, (block + 1) * block_samples - start);
+			if (scheduler.IsDecoded(block))
+				memcpy(charbuf, file.read(start * bps, read_count * bps), read_count * bps);
+			else
+				memset(charbuf, 0, read_count * bps);
+			charbuf += read_count * bps;
+			start += read_count;
+			count -= read_count;
 		}
+	}
 
-		if (count > 0) {
-			start *= bytes_per_sample * channels;
-			count *= bytes_per_sample * channels;
-			memcpy(buf, file.read(start, count), count);
+	uint64_t DataSize() const {
+		return (uint64_t)num_samples * bytes_per_sample * channels;
+	}
+
+	CacheTrailer MakeTrailer() const {
+		CacheTrailer trailer;
+		memcpy(trailer.magic, trailer_magic, sizeof(trailer_magic));
+		trailer.num_samples = num_samples;
+		trailer.channels = channels;
+		trailer.bytes_per_sample = bytes_per_sample;
+		trailer.sample_rate = sample_rate;
+		trailer.float_samples = float_samples;
+		return trailer;
+	}
+
+	bool IsCompleteCache(fs::path const& cache_file) const {
+		if (cache_file.empty() || !fs::FileExists(cache_file)) return false;
+		try {
+			read_file_mapping existing(cache_file);
+			if (existing.size() != DataSize() + sizeof(CacheTrailer)) return false;
+			const auto expected = MakeTrailer();
+			return memcmp(existing.read(DataSize(), sizeof(CacheTrailer)), &expected, sizeof(CacheTrailer)) == 0;
+		}
+		catch (agi::Exception const&) {
+			return false;
 		}
 	}
 
-	fs::path CacheFilename(fs::path const& dir) {
+	fs::path CacheFilename(fs::path const& dir, fs::path const& cache_file) {
+		if (reused) return cache_file;
+
 		// Check free space
-		if ((uint64_t)num_samples * bytes_per_sample * channels > fs::FreeSpace(dir))
+		if (DataSize() > fs::FreeSpace(dir))
 			throw AudioProviderError("Not enough free disk space in " + dir.string() + " to cache the audio");
 
-		return format("audio-%lld-%lld", time(nullptr),
-		              boost::interprocess::ipcdetail::get_current_process_id());
+		if (persistent) return cache_file;
+		return dir / format("audio-%lld-%lld", time(nullptr),
+		                    boost::interprocess::ipcdetail::get_current_process_id());
+	}
+
+	void WriteTrailer(CacheTrailer const& trailer) {
+		std::lock_guard<std::mutex> lock(write_mutex);
+		memcpy(file.write(DataSize(), sizeof(CacheTrailer)), &trailer, sizeof(CacheTrailer));
 	}
 
 public:
-	HDAudioProvider(std::unique_ptr<AudioProvider> src, agi::fs::path const& dir)
+	/// @param dir        Directory to create a temporary cache file in
+	/// @param cache_file Persistent cache file to use instead, if not empty
+	HDAudioProvider(std::unique_ptr<AudioProvider> src, agi::fs::path const& dir, agi::fs::path const& cache_file)
 	: AudioProviderWrapper(std::move(src))
-	, file(dir / CacheFilename(dir), num_samples * bytes_per_sample * channels)
+	, persistent(!cache_file.empty())
+	, reused(IsCompleteCache(cache_file))
+	, file(CacheFilename(dir, cache_file), DataSize() + (persistent ? sizeof(CacheTrailer) : 0), persistent)
 	{
 		decoded_samples = 0;
-		decoder = std::thread([&] {
-			int64_t block = 65536;
-			for (int64_t i = 0; i < num_samples; i += block) {
-				if (cancelled) break;
-				block = std::min(block, num_samples - i);
-				source->GetAudio(file.write(i * bytes_per_sample * channels, block * bytes_per_sample * channels), i, block);
-				decoded_samples += block;
+
+		// Don't let a previous trailer vouch for the file while it's being rewritten
+		if (persistent && !reused)
+			WriteTrailer(CacheTrailer{});
+
+		scheduler.Start(reused ? 1 : AudioBlockScheduler::WorkersFor(*source), [&](size_t i) {
+			const int64_t bps = bytes_per_sample * channels;
+			const int64_t start = i * block_samples;
+			const int64_t count = std::min(block_samples, num_samples - start);
+
+			if (!reused) {
+				std::vector<char> buffer(count * bps);
+				source->GetAudio(buffer.data(), start, count);
+				std::lock_guard<std::mutex> lock(write_mutex);
+				memcpy(file.write(start * bps, count * bps), buffer.data(), buffer.size());
 			}
+
+			scheduler.MarkDecoded(i);
+			peaks.Update(*this, start, start + count);
+			speech.Update(*this, start, start + count);
+			// Counted last so that fully decoded audio is also fully analyzed
+			if ((decoded_samples += count) == num_samples && persistent && !reused)
+				WriteTrailer(MakeTrailer());
 		});
 	}
 
 	~HDAudioProvider() {
-		cancelled = true;
-		decoder.join();
+		scheduler.Stop();
+	}
+
+	AudioSpan GetAudioSpan(int64_t start, int64_t count) const override {
+		AudioSpan span;
+		const size_t block = start / block_samples;
+		if (start < 0 || start >= num_samples || !scheduler.IsDecoded(block))
+			return span;
+
+		// The read window is only valid until the next read, so the span
+		// keeps other readers out until it's done with
+		const int64_t bps = bytes_per_sample * channels;
+		span.count = std::min({count, (int64_t)(block + 1) * block_samples - start, num_samples - start});
+		span.guard = std::unique_lock<std::mutex>(read_mutex);
+		span.data = file.read(start * bps, span.count * bps);
+		return span;
+	}
+
+	AudioPeakPyramid const* GetPeaks() const override { return &peaks; }
+	AudioSpeechDetector const* GetSpeech() const override { return &speech; }
+
+	bool IsRangeDecoded(int64_t start, int64_t count) const override {
+		return scheduler.IsRangeDecoded(start, count);
+	}
+
+	void PrioritizeDecoding(int64_t start) override {
+		scheduler.Prioritize(start);
 	}
 };
 }
 
 namespace agi {
 std::unique_ptr<AudioProvider> CreateHDAudioProvider(std::unique_ptr<AudioProvider> src, agi::fs::path const& dir) {
-	return agi::make_unique<HDAudioProvider>(std::move(src), dir);
+	return agi::make_unique<HDAudioProvider>(std::move(src), dir, fs::path());
+}
+
+std::unique_ptr<AudioProvider> CreatePersistentAudioProvider(std::unique_ptr<AudioProvider> src, agi::fs::path const& cache_file) {
+	return agi::make_unique<HDAudioProvider>(std::move(src), cache_file.parent_path(), cache_file);
 }
 }
@@ -0,0 +1,195 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include "libaegisub/audio/provider.h"
+
+#include "libaegisub/dispatch.h"
+#include "libaegisub/make_unique.h"
+#include "libaegisub/memory_usage.h"
+
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+using namespace agi;
+
+/// Blocks are much smaller than the RAM cache's, as each cache miss has to
+/// seek in and decode a whole block before anything can be returned
+const int BlockBytes = 1 << 20;
+/// Number of blocks decoded in the background after the one a read or a
+/// prioritized position falls in
+const size_t PrefetchBlocks = 2;
+
+class OnDemandAudioProvider final : public AudioProviderWrapper {
+	using Block = std::shared_ptr<const std::vector<char>>;
+
+	const int64_t samples_per_block = BlockBytes / bytes_per_sample / channels;
+	const size_t max_blocks;
+
+	/// Serializes reads from the source, if it can't handle concurrent ones
+	mutable std::mutex decode_mutex;
+
+	mutable std::mutex cache_mutex;
+	/// Block indices, most recently used first
+	mutable std::list<size_t> lru;
+	mutable std::unordered_map<size_t, std::pair<Block, std::list<size_t>::iterator>> blocks;
+	/// Blocks which have been queued for prefetching but not decoded yet
+	mutable std::unordered_set<size_t> pending;
+	mutable agi::memory::Counter memory;
+
+	std::unique_ptr<dispatch::Queue> prefetch_queue = dispatch::Create(dispatch::Priority::Prefetch);
+	/// Cancels queued prefetches when the wanted position moves elsewhere.
+	/// Guarded by cache_mutex.
+	dispatch::CancellationToken prefetch_token;
+
+	/// Get a block if it's cached, marking it as the most recently used
+	Block Find(size_t index) const {
+		std::lock_guard<std::mutex> lock(cache_mutex);
+		auto it = blocks.find(index);
+		if (it == blocks.end()) return nullptr;
+		lru.splice(lru.begin(), lru, it->second.second);
+		return it->second.first;
+	}
+
+	/// Get a block, decoding it if it isn't cached
+	Block Get(size_t index) const {
+		if (auto block = Find(index)) return block;
+
+		std::unique_lock<std::mutex> decode_lock(decode_mutex, std::defer_lock);
+		if (!source->SupportsConcurrentReads()) {
+			decode_lock.lock();
+			// Someone else may have decoded it while we waited
+			if (auto block = Find(index)) return block;
+		}
+
+		const int64_t start = index * samples_per_block;
+		const int64_t count = std::min<int64_t>(samples_per_block, num_samples - start);
+		auto data = std::make_shared<std::vector<char>>(count * bytes_per_sample * channels);
+		source->GetAudio(data->data(), start, count);
+
+		std::lock_guard<std::mutex> lock(cache_mutex);
+		auto it = blocks.find(index);
+		if (it != blocks.end()) return it->second.first;
+
+		lru.push_front(index);
+		blocks.emplace(index, std::make_pair(Block(data), lru.begin()));
+		memory.Add(data->size());
+		while (blocks.size() > max_blocks) {
+			auto evicted = blocks.find(lru.back());
+			memory.Remove(evicted->second.first->size());
+			blocks.erase(evicted);
+			lru.pop_back();
+		}
+		return data;
+	}
+
+	/// Decode the blocks from first onwards in the background
+	void Prefetch(size_t first, size_t count) const {
+		const size_t block_count = (num_samples + samples_per_block - 1) / samples_per_block;
+		std::lock_guard<std::mutex> lock(cache_mutex);
+		for (size_t i = first; i < std::min(block_count, first + count); ++i) {
+			if (blocks.count(i) || !pending.insert(i).second) continue;
+			prefetch_queue->Async([=] {
+				try {
+					Get(i);
+				}
+				catch (AudioProviderError const&) {
+					// Reported to whoever actually asks for this audio
+				}
+				std::lock_guard<std::mutex> lock(cache_mutex);
+				pending.erase(i);
+			}, prefetch_token);
+		}
+	}
+
+	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
+		auto out = static_cast<char *>(buf);
+		const int64_t frame_bytes = bytes_per_sample * channels;
+		size_t last_index = 0;
+		while (count > 0) {
+			const size_t index = start / samples_per_block;
+			const int64_t offset = start % samples_per_block;
+			const int64_t len = std::min(count, samples_per_block - offset);
+
+			auto block = Get(index);
+			memcpy(out, block->data() + offset * frame_bytes, len * frame_bytes);
+			out += len * frame_bytes;
+			start += len;
+			count -= len;
+			last_index = index;
+		}
+
+		// Reads are mostly sequential, so have the following blocks ready
+		// before they're asked for
+		Prefetch(last_index + 1, PrefetchBlocks);
+	}
+
+public:
+	OnDemandAudioProvider(std::unique_ptr<AudioProvider> src, size_t max_bytes)
+	: AudioProviderWrapper(std::move(src))
+	, max_blocks(std::max<size_t>(PrefetchBlocks + 2, max_bytes / BlockBytes))
+	, memory("Audio on-demand cache", max_blocks * BlockBytes)
+	{
+		// Any of the audio can be read at any time, at the cost of waiting
+		// for it to be decoded
+		decoded_samples = num_samples;
+	}
+
+	~OnDemandAudioProvider() {
+		{
+			std::lock_guard<std::mutex> lock(cache_mutex);
+			prefetch_token.Cancel();
+		}
+		prefetch_queue->Sync([] { });
+	}
+
+	bool SupportsConcurrentReads() const override { return true; }
+
+	AudioSpan GetAudioSpan(int64_t start, int64_t count) const override {
+		AudioSpan span;
+		if (start < 0 || start >= num_samples) return span;
+
+		// Only what's already cached, as this is for reading without waiting
+		auto block = Find(start / samples_per_block);
+		if (!block) return span;
+
+		const int64_t offset = start % samples_per_block;
+		span.data = block->data() + offset * bytes_per_sample * channels;
+		span.count = std::min(count, (int64_t)(block->size() / bytes_per_sample / channels) - offset);
+		span.owner = std::move(block);
+		return span;
+	}
+
+	void PrioritizeDecoding(int64_t start) override {
+		if (start < 0 || start >= num_samples) return;
+		{
+			std::lock_guard<std::mutex> lock(cache_mutex);
+			prefetch_token.Cancel();
+			prefetch_token = dispatch::CancellationToken();
+			// The cancelled prefetches will never run to clear their entries
+			pending.clear();
+		}
+		Prefetch(start / samples_per_block, PrefetchBlocks + 1);
+	}
+};
+}
+
+namespace agi {
+std::unique_ptr<AudioProvider> CreateOnDemandAudioProvider(std::unique_ptr<AudioProvider> src, size_t max_bytes) {
+	return agi::make_unique<OnDemandAudioProvider>(std::move(src), max_bytes);
+}
+}
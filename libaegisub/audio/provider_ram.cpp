@@ -16,11 +16,16 @@
 
 #include "libaegisub/audio/provider.h"
 
+#include "block_scheduler.h"
+#include "libaegisub/audio/peak_pyramid.h"
+#include "libaegisub/audio/speech_detector.h"
+
 #include "libaegisub/make_unique.h"
+#include "libaegisub/memory_usage.h"
 
+#include <algorithm>
 #include <array>
 #include <boost/container/stable_vector.hpp>
-#include <thread>
 
 namespace {
 using namespace agi;
@@ -34,8 +39,11 @@ class RAMAudioProvider final : public AudioProviderWrapper {
 #else
 	boost::container::stable_vector<std::array<char, CacheBlockSize>> blockcache;
 #endif
-	std::atomic<bool> cancelled = {false};
-	std::thread decoder;
+	const int64_t samples_per_block = CacheBlockSize / bytes_per_sample / channels;
+	AudioPeakPyramid peaks{num_samples};
+	AudioSpeechDetector speech{num_samples, sample_rate};
+	AudioBlockScheduler scheduler{num_samples, samples_per_block};
+	agi::memory::Counter memory{"Audio RAM cache"};
 
 	void FillBuffer(void *buf, int64_t start, int64_t count) const override;
 
@@ -46,44 +54,65 @@ public:
 		decoded_samples = 0;
 
 		try {
-			blockcache.resize((num_samples * bytes_per_sample * channels + CacheBlockSize - 1) >> CacheBits);
+			blockcache.resize((num_samples + samples_per_block - 1) / samples_per_block);
 		}
 		catch (std::bad_alloc const&) {
 			throw AudioProviderError("Not enough memory available to cache in RAM");
 		}
-
-		decoder = std::thread([&] {
-			int64_t readsize = CacheBlockSize / bytes_per_sample / channels;
-			for (size_t i = 0; i < blockcache.size(); i++) {
-				if (cancelled) break;
-				auto actual_read = std::min<int64_t>(readsize, num_samples - i * readsize);
-				source->GetAudio(&blockcache[i][0], i * readsize, actual_read);
-				decoded_samples += actual_read;
-			}
+		memory.Set(blockcache.size() * CacheBlockSize);
+
+		scheduler.Start(AudioBlockScheduler::WorkersFor(*source), [&](size_t i) {
+			const int64_t start = i * samples_per_block;
+			const int64_t count = std::min<int64_t>(samples_per_block, num_samples - start);
+			source->GetAudio(&blockcache[i][0], start, count);
+			scheduler.MarkDecoded(i);
+			peaks.Update(*this, start, start + count);
+			speech.Update(*this, start, start + count);
+			// Counted last so that fully decoded audio is also fully analyzed
+			decoded_samples += count;
 		});
 	}
 
 	~RAMAudioProvider() {
-		cancelled = true;
-		decoder.join();
+		scheduler.Stop();
+	}
+
+	AudioSpan GetAudioSpan(int64_t start, int64_t count) const override {
+		AudioSpan span;
+		const size_t i = start / samples_per_block;
+		if (start < 0 || start >= num_samples || !scheduler.IsDecoded(i))
+			return span;
+
+		// The blocks are never freed or written after being decoded
+		const int64_t offset = start % samples_per_block;
+		span.data = &blockcache[i][offset * bytes_per_sample * channels];
+		span.count = std::min({count, samples_per_block - offset, num_samples - start});
+		return span;
+	}
+
+	AudioPeakPyramid const* GetPeaks() const override { return &peaks; }
+	AudioSpeechDetector const* GetSpeech() const override { return &speech; }
+
+	bool IsRangeDecoded(int64_t start, int64_t count) const override {
+		return scheduler.IsRangeDecoded(start, count);
+	}
+
+	void PrioritizeDecoding(int64_t start) override {
+		scheduler.Prioritize(start);
 	}
 };
 
 void RAMAudioProvider::FillBuffer(void *buf, int64_t start, int64_t count) const {
 	auto charbuf = static_cast<char *>(buf);
 	for (int64_t bytes_remaining = count * bytes_per_sample * channels; bytes_remaining; ) {
-		if (start >= decoded_samples) {
-			memset(charbuf, 0, bytes_remaining);
-			break;
-		}
-
-		const int64_t samples_per_block = CacheBlockSize / bytes_per_sample / channels;
-
 		const size_t i = start / samples_per_block;
 		const int start_offset = (start % samples_per_block) * bytes_per_sample * channels;
 		const int read_size = std::min<int>(bytes_remaining, samples_per_block * bytes_per_sample * channels - start_offset);
 
-		memcpy(charbuf, &blockcache[i][start_offset], read_size);
+		if (scheduler.IsDecoded(i))
+			memcpy(charbuf, &blockcache[i][start_offset], read_size);
+		else
+			memset(charbuf, 0, read_size);
 		charbuf += read_size;
 		bytes_remaining -= read_size;
 		start += read_size / bytes_per_sample / channels;
@@ -95,4 +124,4 @@ namespace agi {
 std::unique_ptr<AudioProvider> CreateRAMAudioProvider(std::unique_ptr<AudioProvider> src) {
 	return agi::make_unique<RAMAudioProvider>(std::move(src));
 }
-}
\ No newline at end of file
+}
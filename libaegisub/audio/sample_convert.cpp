@@ -0,0 +1,183 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include "sample_convert.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AGI_AUDIO_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+using namespace agi;
+
+/// Convert samples [begin, count) one at a time
+template<typename Source>
+void ConvertScalar(Source src, int channels, int16_t *dst, size_t begin, size_t count) {
+	if (channels == 1) {
+		for (size_t i = begin; i < count; ++i)
+			dst[i] = src[i];
+	}
+	else {
+		DownmixToMono<Source> mixed(src, channels);
+		for (size_t i = begin; i < count; ++i)
+			dst[i] = mixed[i];
+	}
+}
+
+#ifdef AGI_AUDIO_SSE2
+// Each loader converts the eight samples starting at the given index to int16,
+// rounding and clamping exactly as the scalar accessors do
+
+struct LoadInt16 {
+	const int16_t *src;
+	__m128i operator()(size_t i) const {
+		return _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+	}
+};
+
+struct LoadInt32 {
+	const int32_t *src;
+	__m128i operator()(size_t i) const {
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 4));
+		// The high half of each sample, which always fits so packing can't saturate
+		return _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+	}
+};
+
+struct LoadUInt8 {
+	const uint8_t *src;
+	__m128i operator()(size_t i) const {
+		__m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + i));
+		__m128i words = _mm_unpacklo_epi8(bytes, _mm_setzero_si128());
+		return _mm_slli_epi16(_mm_sub_epi16(words, _mm_set1_epi16(128)), 8);
+	}
+};
+
+struct LoadFloat {
+	const float *src;
+	__m128i operator()(size_t i) const {
+		const __m128 scale = _mm_set1_ps(32768.f);
+		const __m128 lo = _mm_set1_ps(-32768.f);
+		const __m128 hi = _mm_set1_ps(32767.f);
+		__m128 a = _mm_mul_ps(_mm_loadu_ps(src + i), scale);
+		__m128 b = _mm_mul_ps(_mm_loadu_ps(src + i + 4), scale);
+		a = _mm_min_ps(_mm_max_ps(a, lo), hi);
+		b = _mm_min_ps(_mm_max_ps(b, lo), hi);
+		return _mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b));
+	}
+};
+
+struct LoadDouble {
+	const double *src;
+	__m128i Load4(size_t i) const {
+		const __m128d scale = _mm_set1_pd(32768.);
+		const __m128d lo = _mm_set1_pd(-32768.);
+		const __m128d hi = _mm_set1_pd(32767.);
+		__m128d a = _mm_mul_pd(_mm_loadu_pd(src + i), scale);
+		__m128d b = _mm_mul_pd(_mm_loadu_pd(src + i + 2), scale);
+		a = _mm_min_pd(_mm_max_pd(a, lo), hi);
+		b = _mm_min_pd(_mm_max_pd(b, lo), hi);
+		return _mm_unpacklo_epi64(_mm_cvttpd_epi32(a), _mm_cvttpd_epi32(b));
+	}
+	__m128i operator()(size_t i) const {
+		return _mm_packs_epi32(Load4(i), Load4(i + 4));
+	}
+};
+
+/// Convert as many whole groups of eight samples as possible
+/// @return Number of samples converted
+template<typename Load>
+size_t ConvertMono(Load load, int16_t *dst, size_t count) {
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), load(i));
+	return i;
+}
+
+/// Sum each pair of channels and halve the sum, rounding toward zero like
+/// integer division does
+inline __m128i AverageChannelPairs(__m128i samples) {
+	__m128i sum = _mm_madd_epi16(samples, _mm_set1_epi16(1));
+	return _mm_srai_epi32(_mm_add_epi32(sum, _mm_srli_epi32(sum, 31)), 1);
+}
+
+/// Downmix as many whole groups of eight stereo frames as possible
+/// @return Number of frames converted
+template<typename Load>
+size_t ConvertStereo(Load load, int16_t *dst, size_t count) {
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i a = AverageChannelPairs(load(i * 2));
+		__m128i b = AverageChannelPairs(load(i * 2 + 8));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi32(a, b));
+	}
+	return i;
+}
+
+template<typename Load>
+size_t ConvertVector(Load load, int channels, int16_t *dst, size_t count) {
+	if (channels == 1) return ConvertMono(load, dst, count);
+	if (channels == 2) return ConvertStereo(load, dst, count);
+	return 0;
+}
+#endif
+}
+
+namespace agi {
+void ConvertToInt16Mono(const void *src, int16_t *dst, size_t count, int channels, int bytes_per_sample, bool float_samples) {
+	auto raw = const_cast<void *>(src);
+	size_t done = 0;
+
+	if (float_samples) {
+		if (bytes_per_sample == sizeof(float)) {
+#ifdef AGI_AUDIO_SSE2
+			done = ConvertVector(LoadFloat{static_cast<const float *>(src)}, channels, dst, count);
+#endif
+			ConvertScalar(ConvertFloatToInt16<float>(static_cast<float *>(raw)), channels, dst, done, count);
+		}
+		else if (bytes_per_sample == sizeof(double)) {
+#ifdef AGI_AUDIO_SSE2
+			done = ConvertVector(LoadDouble{static_cast<const double *>(src)}, channels, dst, count);
+#endif
+			ConvertScalar(ConvertFloatToInt16<double>(static_cast<double *>(raw)), channels, dst, done, count);
+		}
+		return;
+	}
+
+	if (bytes_per_sample == sizeof(uint8_t)) {
+#ifdef AGI_AUDIO_SSE2
+		done = ConvertVector(LoadUInt8{static_cast<const uint8_t *>(src)}, channels, dst, count);
+#endif
+		ConvertScalar(ConvertUInt8ToInt16(static_cast<uint8_t *>(raw)), channels, dst, done, count);
+		return;
+	}
+
+	if (bytes_per_sample == sizeof(int16_t) && channels == 1) {
+		memcpy(dst, src, count * sizeof(int16_t));
+		return;
+	}
+
+#ifdef AGI_AUDIO_SSE2
+	if (bytes_per_sample == sizeof(int16_t))
+		done = ConvertVector(LoadInt16{static_cast<const int16_t *>(src)}, channels, dst, count);
+	else if (bytes_per_sample == sizeof(int32_t))
+		done = ConvertVector(LoadInt32{static_cast<const int32_t *>(src)}, channels, dst, count);
+#endif
+	ConvertScalar(ConvertIntToInt16(raw, bytes_per_sample), channels, dst, done, count);
+}
+}
@@ -0,0 +1,102 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+/// @file sample_convert.h
+/// @brief Accessors which read raw samples of any format as int16
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace agi {
+template<typename Source>
+class ConvertFloatToInt16 {
+	Source* src;
+public:
+	ConvertFloatToInt16(Source* src) :src(src) {}
+	int16_t operator[](size_t idx) const {
+		Source expanded = src[idx] * 32768;
+		return expanded < -32768 ? -32768 :
+			expanded > 32767 ? 32767 :
+			static_cast<int16_t>(expanded);
+	}
+};
+
+// 8 bits per sample is assumed to be unsigned with a bias of 128,
+// while everything else is assumed to be signed with zero bias
+class ConvertIntToInt16 {
+	void* src;
+	int bytes_per_sample;
+public:
+	ConvertIntToInt16(void* src, int bytes_per_sample) :src(src), bytes_per_sample(bytes_per_sample) {}
+	const int16_t& operator[](size_t idx) const {
+		return *reinterpret_cast<int16_t*>(reinterpret_cast<char*>(src) + (idx + 1) * bytes_per_sample - sizeof(int16_t));
+	}
+};
+class ConvertUInt8ToInt16 {
+	uint8_t* src;
+public:
+	ConvertUInt8ToInt16(uint8_t* src) :src(src) {}
+	int16_t operator[](size_t idx) const {
+		return int16_t(src[idx]-128) << 8;
+	}
+};
+
+template<typename Source>
+class DownmixToMono {
+	Source src;
+	int channels;
+public:
+	DownmixToMono(Source src, int channels) :src(src), channels(channels) {}
+	int16_t operator[](size_t idx) const {
+		int ret = 0;
+		// Just average the channels together
+		for (int i = 0; i < channels; ++i)
+			ret += src[idx * channels + i];
+		return ret / channels;
+	}
+};
+
+/// Downmix to stereo, assuming that the first two channels are front left and
+/// right as they are in both the WAVE and FFmpeg channel orders. Every other
+/// channel is mixed into both sides, as their layout isn't known.
+template<typename Source>
+class DownmixToStereo {
+	Source src;
+	int channels;
+public:
+	DownmixToStereo(Source src, int channels) :src(src), channels(channels) {}
+	int16_t operator[](size_t idx) const {
+		const size_t frame = idx / 2 * channels;
+		int ret = src[frame + idx % 2];
+		for (int i = 2; i < channels; ++i)
+			ret += src[frame + i];
+		return ret / (channels - 1);
+	}
+};
+
+/// Convert interleaved samples of any format supported by the providers to
+/// mono int16, averaging the channels together
+/// @param src              Interleaved source samples
+/// @param dst              Buffer to write count samples to
+/// @param count            Number of frames to convert
+/// @param channels         Number of channels in the source
+/// @param bytes_per_sample Size of each source sample
+/// @param float_samples    Are the source samples floating point?
+///
+/// This uses vector instructions where available for the common formats,
+/// and produces exactly the same output as the accessors above.
+void ConvertToInt16Mono(const void *src, int16_t *dst, size_t count, int channels, int bytes_per_sample, bool float_samples);
+}
@@ -0,0 +1,169 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include "libaegisub/audio/speech_detector.h"
+
+#include "libaegisub/audio/provider.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+/// Frames with at least this much of their energy in the high frequencies
+/// sound like hiss or noise rather than voice
+constexpr float HissHighBand = 0.8f;
+/// How much further above the threshold noisy frames have to be to count
+constexpr float HissMargin = 10.f;
+}
+
+namespace agi {
+constexpr int AudioSpeechDetector::FrameMs;
+
+AudioSpeechDetector::AudioSpeechDetector(int64_t num_samples, int sample_rate)
+: num_samples(num_samples)
+, sample_rate(std::max(1, sample_rate))
+, frame_samples(std::max<int64_t>(1, (int64_t)sample_rate * FrameMs / 1000))
+, frames((num_samples + frame_samples - 1) / frame_samples)
+, claimed(frames.size())
+, valid(frames.size())
+{
+	for (auto& bin : histogram)
+		bin = 0;
+}
+
+int64_t AudioSpeechDetector::FrameAtTime(int ms) const {
+	const int64_t frame = std::max<int64_t>(0, (int64_t)ms * sample_rate / 1000) / frame_samples;
+	return std::min<int64_t>(frame, frames.size());
+}
+
+int AudioSpeechDetector::TimeAtFrame(int64_t frame) const {
+	return static_cast<int>(std::min(frame * frame_samples, num_samples) * 1000 / sample_rate);
+}
+
+void AudioSpeechDetector::Update(AudioProvider const& provider, int64_t start, int64_t end) {
+	start = std::max<int64_t>(start, 0);
+	end = std::min(end, num_samples);
+	if (start >= end) return;
+
+	// Only analyze the frames on the edges once all of their samples are in
+	int64_t first = start / frame_samples;
+	if (first * frame_samples < start && !provider.IsRangeDecoded(first * frame_samples, start - first * frame_samples))
+		++first;
+	int64_t last = (end + frame_samples - 1) / frame_samples;
+	const int64_t last_end = std::min(num_samples, last * frame_samples);
+	if (last_end > end && !provider.IsRangeDecoded(end, last_end - end))
+		--last;
+	if (first >= last) return;
+
+	const int64_t buffer_start = first * frame_samples;
+	std::vector<int16_t> buffer(std::min(num_samples, last * frame_samples) - buffer_start);
+	provider.GetInt16MonoAudio(buffer.data(), buffer_start, buffer.size());
+
+	for (int64_t i = first; i < last; ++i) {
+		// Another thread may be finishing the neighboring range at the same time
+		if (valid[i] || claimed[i].exchange(true)) continue;
+
+		const int16_t *samples = &buffer[(i - first) * frame_samples];
+		const int64_t count = std::min<int64_t>(frame_samples, buffer.size() - (i - first) * frame_samples);
+
+		double power = 0, diff_power = 0;
+		int prev = samples[0];
+		for (int64_t j = 0; j < count; ++j) {
+			const int sample = samples[j];
+			const int diff = sample - prev;
+			power += sample * sample;
+			diff_power += diff * diff;
+			prev = sample;
+		}
+
+		Frame frame;
+		frame.energy = static_cast<float>(10. * std::log10(power / count / (32768. * 32768.) + 1e-10));
+		frame.high_band = power > 0 ? static_cast<float>(diff_power / (2. * power)) : 0.f;
+		frames[i] = frame;
+		valid[i] = true;
+
+		const int bin = std::min(HistogramBins - 1, std::max(0, static_cast<int>(-frame.energy)));
+		++histogram[bin];
+	}
+}
+
+double AudioSpeechDetector::NoiseFloor() const {
+	// Use the tenth percentile of the frames which aren't digital silence,
+	// which tends to land in the pauses between lines
+	int total = 0;
+	for (int i = 0; i < -SilenceLevel; ++i)
+		total += histogram[i];
+	if (total == 0) return SilenceLevel;
+
+	int seen = 0;
+	for (int i = -SilenceLevel - 1; i >= 0; --i) {
+		seen += histogram[i];
+		if (seen * 10 >= total)
+			return -i;
+	}
+	return 0;
+}
+
+bool AudioSpeechDetector::GetSegments(int start_ms, int end_ms, SpeechDetectionSettings const& settings, std::vector<SpeechSegment>& out) const {
+	const int64_t count = frames.size();
+	const int64_t first = FrameAtTime(start_ms);
+	const int64_t last = std::min(count, FrameAtTime(end_ms) + 1);
+	const int64_t gap_frames = std::max(1, (settings.min_gap + FrameMs - 1) / FrameMs);
+	const int64_t min_frames = std::max(1, (settings.min_length + FrameMs - 1) / FrameMs);
+
+	const float threshold = static_cast<float>(NoiseFloor() + settings.threshold);
+	auto is_speech = [&](int64_t i) -> bool {
+		if (!valid[i]) return false;
+		auto const& frame = frames[i];
+		if (frame.energy < threshold) return false;
+		return frame.high_band < HissHighBand || frame.energy >= threshold + HissMargin;
+	};
+
+	// Widen the scan until there's a gap which can't be bridged on each side
+	// so that segments overlapping the ends of the range are found whole
+	int64_t begin = first;
+	for (int64_t quiet = 0; begin > 0 && quiet < gap_frames; ) {
+		--begin;
+		quiet = is_speech(begin) ? 0 : quiet + 1;
+	}
+	int64_t end = last;
+	for (int64_t quiet = 0; end < count && quiet < gap_frames; ++end)
+		quiet = is_speech(end) ? 0 : quiet + 1;
+
+	int64_t run_start = -1, run_end = -1;
+	auto emit = [&] {
+		if (run_start < 0 || run_end - run_start < min_frames) return;
+		SpeechSegment segment{TimeAtFrame(run_start), TimeAtFrame(run_end)};
+		if (segment.end > start_ms && segment.start < end_ms)
+			out.push_back(segment);
+	};
+
+	bool complete = true;
+	for (int64_t i = begin; i < end; ++i) {
+		if (i >= first && i < last && !valid[i])
+			complete = false;
+		if (!is_speech(i)) continue;
+
+		if (run_start < 0 || i - run_end >= gap_frames) {
+			emit();
+			run_start = i;
+		}
+		run_end = i + 1;
+	}
+	emit();
+
+	return complete;
+}
+}
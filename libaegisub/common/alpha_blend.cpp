@@ -0,0 +1,262 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include "libaegisub/alpha_blend.h"
+
+#include "libaegisub/dispatch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AGI_BLEND_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+void BlendMaskPixel(uint8_t *dst, unsigned int mask, unsigned int opacity, const unsigned int *bgr, bool with_alpha) {
+	const unsigned int k = mask * opacity / 255;
+	const unsigned int ck = 255 - k;
+	dst[0] = (k * bgr[0] + ck * dst[0]) / 255;
+	dst[1] = (k * bgr[1] + ck * dst[1]) / 255;
+	dst[2] = (k * bgr[2] + ck * dst[2]) / 255;
+	dst[3] = with_alpha ? k + ck * dst[3] / 255 : 0;
+}
+
+template<bool Rgba>
+void BlendPremultipliedPixel(uint8_t *dst, const uint8_t *src, bool with_alpha) {
+	const unsigned int inv_alpha = 255 - src[3];
+	dst[0] = static_cast<uint8_t>(src[Rgba ? 2 : 0] + dst[0] * inv_alpha / 255);
+	dst[1] = static_cast<uint8_t>(src[1] + dst[1] * inv_alpha / 255);
+	dst[2] = static_cast<uint8_t>(src[Rgba ? 0 : 2] + dst[2] * inv_alpha / 255);
+	dst[3] = with_alpha ? static_cast<uint8_t>(src[3] + dst[3] * inv_alpha / 255) : 0;
+}
+
+#ifdef AGI_BLEND_SSE2
+/// Divide each 16-bit lane by 255, rounding down; exact for the products of
+/// two bytes
+inline __m128i Div255(__m128i v) {
+	return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(v, _mm_set1_epi16(1)), _mm_srli_epi16(v, 8)), 8);
+}
+
+/// Blend as many whole groups of four pixels of a row as possible
+/// @return Number of pixels blended
+int BlendMaskRow(uint8_t *dst, const uint8_t *mask, int width, __m128i opacity, __m128i color, __m128i keep) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i full = _mm_set1_epi16(255);
+
+	int x = 0;
+	for (; x + 4 <= width; x += 4) {
+		int32_t m4;
+		memcpy(&m4, mask + x, sizeof m4);
+		// Spread each mask byte over the four channels of its pixel
+		__m128i m = _mm_cvtsi32_si128(m4);
+		m = _mm_unpacklo_epi8(m, m);
+		m = _mm_unpacklo_epi16(m, m);
+
+		__m128i k_lo = Div255(_mm_mullo_epi16(_mm_unpacklo_epi8(m, zero), opacity));
+		__m128i k_hi = Div255(_mm_mullo_epi16(_mm_unpackhi_epi8(m, zero), opacity));
+
+		__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + x * 4));
+		__m128i d_lo = _mm_unpacklo_epi8(d, zero);
+		__m128i d_hi = _mm_unpackhi_epi8(d, zero);
+
+		d_lo = Div255(_mm_add_epi16(_mm_mullo_epi16(k_lo, color), _mm_mullo_epi16(_mm_sub_epi16(full, k_lo), d_lo)));
+		d_hi = Div255(_mm_add_epi16(_mm_mullo_epi16(k_hi, color), _mm_mullo_epi16(_mm_sub_epi16(full, k_hi), d_hi)));
+
+		d = _mm_and_si128(_mm_packus_epi16(d_lo, d_hi), keep);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4), d);
+	}
+	return x;
+}
+
+/// Blend two pixels held as 16-bit lanes
+template<bool Rgba>
+inline __m128i BlendPremultipliedPair(__m128i d, __m128i s) {
+	if (Rgba) {
+		s = _mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 0, 1, 2));
+		s = _mm_shufflehi_epi16(s, _MM_SHUFFLE(3, 0, 1, 2));
+	}
+	__m128i a = _mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3));
+	a = _mm_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+	d = Div255(_mm_mullo_epi16(d, _mm_sub_epi16(_mm_set1_epi16(255), a)));
+	// Wrap rather than saturate, as the scalar version does
+	return _mm_and_si128(_mm_add_epi16(d, s), _mm_set1_epi16(0xFF));
+}
+
+template<bool Rgba>
+int BlendPremultipliedRow(uint8_t *dst, const uint8_t *src, int width, __m128i keep) {
+	const __m128i zero = _mm_setzero_si128();
+
+	int x = 0;
+	for (; x + 4 <= width; x += 4) {
+		__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 4));
+		__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + x * 4));
+		__m128i lo = BlendPremultipliedPair<Rgba>(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero));
+		__m128i hi = BlendPremultipliedPair<Rgba>(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero));
+		d = _mm_and_si128(_mm_packus_epi16(lo, hi), keep);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4), d);
+	}
+	return x;
+}
+
+inline __m128i AlphaKeepMask(bool with_alpha) {
+	return with_alpha ? _mm_set1_epi32(-1) : _mm_set1_epi32(0x00FFFFFF);
+}
+#endif
+
+/// Rows per tile when blending in parallel
+const int tile_rows = 64;
+/// Blending fewer pixels than this isn't worth farming out
+const int64_t min_parallel_pixels = 256 * 1024;
+
+/// Work shared by the threads blending one batch of images. Jobs which start
+/// after every tile has been claimed touch nothing but this, so it is shared
+/// with them rather than living on the caller's stack.
+struct TileJob {
+	uint8_t *dst;
+	ptrdiff_t dst_pitch;
+	std::vector<agi::BlendImage> const* images;
+	std::vector<std::vector<size_t>> buckets;
+	bool with_alpha;
+
+	std::atomic<size_t> next_tile{0};
+	size_t tiles_done = 0;
+	std::mutex mutex;
+	std::condition_variable done;
+
+	void BlendTile(size_t tile);
+
+	/// Blend tiles until there are none left to claim
+	void Run() {
+		for (size_t tile; (tile = next_tile++) < buckets.size(); ) {
+			BlendTile(tile);
+			std::lock_guard<std::mutex> lock(mutex);
+			if (++tiles_done == buckets.size())
+				done.notify_all();
+		}
+	}
+};
+
+template<bool Rgba>
+void BlendPremultipliedRows(uint8_t *dst, ptrdiff_t dst_pitch, const uint8_t *src, ptrdiff_t src_pitch,
+                            int width, int height, bool with_alpha) {
+#ifdef AGI_BLEND_SSE2
+	const __m128i keep = AlphaKeepMask(with_alpha);
+#endif
+	for (int y = 0; y < height; ++y, dst += dst_pitch, src += src_pitch) {
+		int x = 0;
+#ifdef AGI_BLEND_SSE2
+		x = BlendPremultipliedRow<Rgba>(dst, src, width, keep);
+#endif
+		for (; x < width; ++x)
+			BlendPremultipliedPixel<Rgba>(dst + x * 4, src + x * 4, with_alpha);
+	}
+}
+
+void TileJob::BlendTile(size_t tile) {
+	const int top = static_cast<int>(tile) * tile_rows;
+	const int bottom = top + tile_rows;
+	for (size_t i : buckets[tile]) {
+		auto const& img = (*images)[i];
+		const int first = std::max(top, img.y);
+		const int last = std::min(bottom, img.y + img.height);
+		uint8_t *out = dst + first * dst_pitch + img.x * 4;
+		const uint8_t *in = img.data + (first - img.y) * img.stride;
+		if (img.type == agi::BlendImage::Mask)
+			agi::BlendMask(out, dst_pitch, in, img.stride, img.width, last - first, img.color, with_alpha);
+		else
+			agi::BlendPremultiplied(out, dst_pitch, in, img.stride, img.width, last - first, true, with_alpha);
+	}
+}
+}
+
+namespace agi {
+void BlendMask(uint8_t *dst, ptrdiff_t dst_pitch, const uint8_t *mask, ptrdiff_t mask_pitch,
+               int width, int height, uint32_t color, bool with_alpha) {
+	const unsigned int opacity = 255 - (color & 0xFF);
+	const unsigned int bgr[3] = {(color >> 8) & 0xFF, (color >> 16) & 0xFF, color >> 24};
+	if (!opacity && with_alpha) return;
+
+#ifdef AGI_BLEND_SSE2
+	const __m128i opacity16 = _mm_set1_epi16(opacity);
+	// Blending with 255 in the alpha lane gives k + (255 - k) * dst / 255
+	const __m128i color16 = _mm_setr_epi16(bgr[0], bgr[1], bgr[2], 255, bgr[0], bgr[1], bgr[2], 255);
+	const __m128i keep = AlphaKeepMask(with_alpha);
+#endif
+
+	for (int y = 0; y < height; ++y, dst += dst_pitch, mask += mask_pitch) {
+		int x = 0;
+#ifdef AGI_BLEND_SSE2
+		x = BlendMaskRow(dst, mask, width, opacity16, color16, keep);
+#endif
+		for (; x < width; ++x)
+			BlendMaskPixel(dst + x * 4, mask[x], opacity, bgr, with_alpha);
+	}
+}
+
+void BlendPremultiplied(uint8_t *dst, ptrdiff_t dst_pitch, const uint8_t *src, ptrdiff_t src_pitch,
+                        int width, int height, bool src_rgba, bool with_alpha) {
+	if (src_rgba)
+		BlendPremultipliedRows<true>(dst, dst_pitch, src, src_pitch, width, height, with_alpha);
+	else
+		BlendPremultipliedRows<false>(dst, dst_pitch, src, src_pitch, width, height, with_alpha);
+}
+
+void BlendImages(uint8_t *dst, ptrdiff_t dst_pitch, int height, std::vector<BlendImage> const& images, bool with_alpha) {
+	int64_t pixels = 0;
+	for (auto const& img : images)
+		pixels += int64_t(img.width) * img.height;
+
+	const size_t tiles = (height + tile_rows - 1) / tile_rows;
+	const size_t threads = std::min<size_t>(tiles, std::thread::hardware_concurrency());
+	if (pixels < min_parallel_pixels || threads < 2) {
+		for (auto const& img : images) {
+			if (img.type == BlendImage::Mask)
+				BlendMask(dst + img.y * dst_pitch + img.x * 4, dst_pitch, img.data, img.stride, img.width, img.height, img.color, with_alpha);
+			else
+				BlendPremultiplied(dst + img.y * dst_pitch + img.x * 4, dst_pitch, img.data, img.stride, img.width, img.height, true, with_alpha);
+		}
+		return;
+	}
+
+	auto job = std::make_shared<TileJob>();
+	job->dst = dst;
+	job->dst_pitch = dst_pitch;
+	job->images = &images;
+	job->with_alpha = with_alpha;
+	job->buckets.resize(tiles);
+	for (size_t i = 0; i < images.size(); ++i) {
+		auto const& img = images[i];
+		if (img.width <= 0 || img.height <= 0) continue;
+		const size_t last = std::min<size_t>(tiles - 1, (img.y + img.height - 1) / tile_rows);
+		for (size_t tile = img.y / tile_rows; tile <= last; ++tile)
+			job->buckets[tile].push_back(i);
+	}
+
+	// The calling thread blends tiles too, so this finishes even if every
+	// background thread is busy
+	for (size_t i = 1; i < threads; ++i)
+		dispatch::Background().Async([job] { job->Run(); });
+	job->Run();
+
+	std::unique_lock<std::mutex> lock(job->mutex);
+	job->done.wait(lock, [&] { return job->tiles_done == job->buckets.size(); });
+}
+}
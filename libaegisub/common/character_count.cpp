@@ -22,9 +22,16 @@
 #include <unicode/uchar.h>
 #include <unicode/utf8.h>
 
+#include <array>
+#include <limits>
 #include <mutex>
 #include <unicode/brkiter.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AGI_CHARACTER_COUNT_SSE2
+#include <emmintrin.h>
+#endif
+
 namespace {
 struct utext_deleter {
 	void operator()(UText *ut) { if (ut) utext_close(ut); }
@@ -52,40 +59,80 @@ icu::BreakIterator& get_break_iterator(const char *ptr, size_t len) {
 	return *bi;
 }
 
+/// Is the character one which is ignored when the given mask is, taking
+/// the ASS escapes which stand in for whitespace into account?
+/// @return 1 if it's counted, 0 if not, or -1 if it also uncounts the
+///         preceding backslash
+int count_character(UChar32 c, UChar32 prev, size_t pos, int mask) {
+	if (!mask) return 1;
+	if ((U_GET_GC_MASK(c) & mask) != 0) return 0;
+	if (!(mask & U_GC_Z_MASK) || pos == 0) return 1;
+	if (std::find(std::begin(ass_special_chars), std::end(ass_special_chars), c) == std::end(ass_special_chars))
+		return 1;
+	if (prev != (UChar32) '\\') return 1;
+	return mask & U_GC_P_MASK ? 0 : -1;
+}
+
+/// Count the characters in a string without a break iterator, which is
+/// possible when every code point is below U+0300 as nothing there other
+/// than CR LF can form a multi-codepoint grapheme cluster
+/// @return false if the string needs the break iterator
+bool count_simple(const char *str, size_t len, int mask, size_t& count) {
+	if (len > static_cast<size_t>(std::numeric_limits<int32_t>::max())) return false;
+
+	count = 0;
+	const int32_t length = static_cast<int32_t>(len);
+	int32_t i = 0;
+	UChar32 prev = 0;
+	while (i < length) {
+#ifdef AGI_CHARACTER_COUNT_SSE2
+		// Every byte of a run of plain ASCII without any CRs is a character
+		// of its own, so with nothing to ignore they can be counted in bulk
+		if (!mask && i + 16 <= length && prev != '\r') {
+			__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(str + i));
+			__m128i cr = _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\r'));
+			if (_mm_movemask_epi8(_mm_or_si128(bytes, cr)) == 0) {
+				count += 16;
+				i += 16;
+				prev = str[i - 1];
+				continue;
+			}
+		}
+#endif
+
+		const int32_t pos = i;
+		UChar32 c;
+		U8_NEXT(str, i, length, c);
+		if (c < 0 || c >= 0x300) return false;
+
+		if (c != '\n' || prev != '\r')
+			count += count_character(c, prev, pos, mask);
+		prev = c;
+	}
+	return true;
+}
+
 template <typename Iterator>
 size_t count_in_range(Iterator begin, Iterator end, int mask) {
 	if (begin == end) return 0;
 
+	size_t simple_count;
+	if (count_simple(&*begin, end - begin, mask, simple_count))
+		return simple_count;
+
 	auto& character_bi = get_break_iterator(&*begin, end - begin);
 
 	size_t count = 0;
 	auto pos = character_bi.first();
 	for (auto end = character_bi.next(); end != icu::BreakIterator::DONE; pos = end, end = character_bi.next()) {
-		if (!mask)
-			++count;
-		else {
-			UChar32 c;
-			int i = 0;
-			U8_NEXT_UNSAFE(begin + pos, i, c);
-			if ((U_GET_GC_MASK(c) & mask) == 0) {
-				if (mask & U_GC_Z_MASK && pos != 0) {
-					UChar32 *result = std::find(std::begin(ass_special_chars), std::end(ass_special_chars), c);
-					if (result != std::end(ass_special_chars)) {
-						UChar32 c2;
-						i = 0;
-						U8_PREV_UNSAFE(begin + pos, i, c2);
-						if (c2 != (UChar32) '\\')
-							++count;
-						else if (!(mask & U_GC_P_MASK))
-							--count;
-					}
-					else
-						++count;
-				}
-				else
-					++count;
-			}
+		UChar32 c, prev = 0;
+		int i = 0;
+		U8_NEXT_UNSAFE(begin + pos, i, c);
+		if (pos != 0) {
+			i = 0;
+			U8_PREV_UNSAFE(begin + pos, i, prev);
 		}
+		count += count_character(c, prev, pos, mask);
 	}
 	return count;
 }
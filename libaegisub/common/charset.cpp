@@ -19,71 +19,241 @@
 #include "libaegisub/charset.h"
 
 #include "libaegisub/file_mapping.h"
+#include "libaegisub/fs.h"
 #include "libaegisub/scoped_ptr.h"
 
 #ifdef WITH_UCHARDET
 #include <uchardet.h>
 #endif
 
+#include <algorithm>
+#include <boost/filesystem/path.hpp>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AGI_CHARSET_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+/// Number of evenly spaced chunks sampled from the part of the file after
+/// the prefix
+const uint64_t sample_chunks = 16;
+const uint64_t sample_chunk_size = 64 * 1024;
+
+inline bool IsBinaryish(unsigned char c) {
+	return c < 32 && c != '\r' && c != '\n' && c != '\t';
+}
+
+/// Length of the UTF-8 sequence starting at data, or 0 if it isn't valid
+size_t ValidSequenceLength(const unsigned char *data, size_t len) {
+	const unsigned char c = data[0];
+	size_t count;
+	unsigned char min_second = 0x80, max_second = 0xBF;
+	if (c >= 0xC2 && c <= 0xDF) count = 2;
+	else if (c >= 0xE0 && c <= 0xEF) {
+		count = 3;
+		// Reject overlong forms and UTF-16 surrogates
+		if (c == 0xE0) min_second = 0xA0;
+		if (c == 0xED) max_second = 0x9F;
+	}
+	else if (c >= 0xF0 && c <= 0xF4) {
+		count = 4;
+		// Reject overlong forms and anything past U+10FFFF
+		if (c == 0xF0) min_second = 0x90;
+		if (c == 0xF4) max_second = 0x8F;
+	}
+	else return 0;
+
+	if (len < count) return 0;
+	if (data[1] < min_second || data[1] > max_second) return 0;
+	for (size_t i = 2; i < count; ++i) {
+		if ((data[i] & 0xC0) != 0x80) return 0;
+	}
+	return count;
+}
+
+/// Check if a chunk of a file is valid UTF-8, counting the control
+/// characters which suggest that it's actually binary along the way
+/// @param partial The chunk may start and end in the middle of a sequence
+bool ValidateUtf8(const unsigned char *data, size_t len, bool partial, uint64_t& binaryish) {
+	size_t i = 0;
+	if (partial) {
+		// Skip the end of a sequence which started before the chunk
+		while (i < len && i < 3 && (data[i] & 0xC0) == 0x80) ++i;
+	}
+
+	bool valid = true;
+	while (i < len) {
+#ifdef AGI_CHARSET_SSE2
+		// Whole blocks of ASCII only need their control characters counted
+		if (i + 16 <= len) {
+			__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+			if (!_mm_movemask_epi8(block)) {
+				__m128i control = _mm_cmplt_epi8(block, _mm_set1_epi8(32));
+				__m128i space = _mm_or_si128(_mm_or_si128(
+					_mm_cmpeq_epi8(block, _mm_set1_epi8('\r')),
+					_mm_cmpeq_epi8(block, _mm_set1_epi8('\n'))),
+					_mm_cmpeq_epi8(block, _mm_set1_epi8('\t')));
+				int mask = _mm_movemask_epi8(_mm_andnot_si128(space, control));
+				for (; mask; mask &= mask - 1)
+					++binaryish;
+				i += 16;
+				continue;
+			}
+		}
+#endif
+
+		const unsigned char c = data[i];
+		if (c < 0x80) {
+			if (IsBinaryish(c)) ++binaryish;
+			++i;
+			continue;
+		}
+
+		if (size_t count = ValidSequenceLength(data + i, len - i)) {
+			i += count;
+			continue;
+		}
+
+		// A sequence cut off by the end of the chunk doesn't count as invalid
+		if (partial && len - i < 4 && c >= 0xC2) {
+			bool prefix = true;
+			for (size_t j = i + 1; j < len; ++j)
+				prefix = prefix && (data[j] & 0xC0) == 0x80;
+			if (prefix) break;
+		}
+
+		valid = false;
+		if (IsBinaryish(c)) ++binaryish;
+		++i;
+	}
+	return valid;
+}
+
+struct CacheKey {
+	std::string path;
+	uint64_t size;
+	time_t modified;
+	uint64_t sample_size;
+
+	bool operator<(CacheKey const& other) const {
+		return std::tie(path, size, modified, sample_size) < std::tie(other.path, other.size, other.modified, other.sample_size);
+	}
+};
+
+std::mutex cache_mutex;
+std::map<CacheKey, std::string> cache;
+const size_t max_cache_size = 64;
+}
+
 namespace agi { namespace charset {
+
 std::string Detect(agi::fs::path const& file) {
+	return Detect(file, 4 * 1024 * 1024);
+}
+
+std::string Detect(agi::fs::path const& file, uint64_t sample_size) {
 	agi::read_file_mapping fp(file);
 
 	// First check for known magic bytes which identify the file type
 	if (fp.size() >= 4) {
 		const char* header = fp.read(0, 4);
-		if (!strncmp(header, "\xef\xbb\xbf", 3))
+		if (!memcmp(header, "\xef\xbb\xbf", 3))
 			return "utf-8";
-		if (!strncmp(header, "\x00\x00\xfe\xff", 4))
+		if (!memcmp(header, "\x00\x00\xfe\xff", 4))
 			return "utf-32be";
-		if (!strncmp(header, "\xff\xfe\x00\x00", 4))
+		if (!memcmp(header, "\xff\xfe\x00\x00", 4))
 			return "utf-32le";
-		if (!strncmp(header, "\xfe\xff", 2))
+		if (!memcmp(header, "\xfe\xff", 2))
 			return "utf-16be";
-		if (!strncmp(header, "\xff\xfe", 2))
+		if (!memcmp(header, "\xff\xfe", 2))
 			return "utf-16le";
-		if (!strncmp(header, "\x1a\x45\xdf\xa3", 4))
+		if (!memcmp(header, "\x1a\x45\xdf\xa3", 4))
 			return "binary"; // Actually EBML/Matroska
 	}
 
-	// If it's over 100 MB it's either binary or big enough that we won't
-	// be able to do anything useful with it anyway
-	if (fp.size() > 100 * 1024 * 1024)
-		return "binary";
+	// Files get detected again every time they're reloaded, so remember the
+	// result for as long as the file is unchanged
+	CacheKey key{file.string(), fp.size(), 0, sample_size};
+	try {
+		key.modified = agi::fs::ModifiedTime(file);
+	}
+	catch (agi::fs::FileSystemError const&) {
+		key.path.clear();
+	}
+	if (!key.path.empty()) {
+		std::lock_guard<std::mutex> lock(cache_mutex);
+		auto it = cache.find(key);
+		if (it != cache.end())
+			return it->second;
+	}
 
-	uint64_t binaryish = 0;
+	// Look at the start of the file, and for a big file, evenly spaced chunks
+	// of the rest of it, on the assumption that text doesn't change encoding
+	// partway through
+	std::vector<std::pair<uint64_t, uint64_t>> samples;
+	const uint64_t prefix = std::min(fp.size(), sample_size);
+	samples.emplace_back(0, prefix);
+	if (prefix < fp.size()) {
+		const uint64_t rest = fp.size() - prefix;
+		const uint64_t chunk = std::min(sample_chunk_size, rest / sample_chunks);
+		for (uint64_t i = 0; chunk && i < sample_chunks; ++i)
+			samples.emplace_back(prefix + rest / sample_chunks * i + (rest / sample_chunks - chunk), chunk);
+	}
 
-#ifdef WITH_UCHARDET
-	agi::scoped_holder<uchardet_t> ud(uchardet_new(), uchardet_delete);
-	for (uint64_t offset = 0; offset < fp.size(); ) {
-		auto read = std::min<uint64_t>(4096, fp.size() - offset);
-		auto buf = fp.read(offset, read);
-		uchardet_handle_data(ud, buf, read);
-
-		offset += read;
-
-		// A dumb heuristic to detect binary files
-		for (size_t i = 0; i < read; ++i) {
-			if ((unsigned char)buf[i] < 32 && (buf[i] != '\r' && buf[i] != '\n' && buf[i] != '\t'))
-				++binaryish;
+	auto result = [&]() -> std::string {
+		uint64_t binaryish = 0;
+		uint64_t sampled = 0;
+		bool utf8 = true;
+		for (auto const& sample : samples) {
+			// Windows can't map more than a few hundred MB at once on 32-bit
+			for (uint64_t offset = 0; offset < sample.second; ) {
+				auto read = std::min<uint64_t>(1024 * 1024, sample.second - offset);
+				auto buf = reinterpret_cast<const unsigned char *>(fp.read(sample.first + offset, read));
+				const bool partial = sample.first + offset > 0 || sample.first + offset + read < fp.size();
+				utf8 = ValidateUtf8(buf, read, partial, binaryish) && utf8;
+
+				offset += read;
+				sampled += read;
+
+				// A dumb heuristic to detect binary files
+				if (binaryish > sampled / 8)
+					return "binary";
+			}
 		}
 
-		if (binaryish > offset / 8)
-			return "binary";
-	}
-	uchardet_data_end(ud);
-	return uchardet_get_charset(ud);
-#else
-	auto read = std::min<uint64_t>(4096, fp.size());
-	auto buf = fp.read(0, read);
-	for (size_t i = 0; i < read; ++i) {
-		if ((unsigned char)buf[i] < 32 && (buf[i] != '\r' && buf[i] != '\n' && buf[i] != '\t'))
-			++binaryish;
-	}
+		// Valid UTF-8 is very unlikely to be anything else, so there's no need
+		// to ask uchardet about it
+		if (utf8)
+			return "utf-8";
 
-	if (binaryish > read / 8)
-		return "binary";
-	return "utf-8";
+#ifdef WITH_UCHARDET
+		agi::scoped_holder<uchardet_t> ud(uchardet_new(), uchardet_delete);
+		for (auto const& sample : samples) {
+			for (uint64_t offset = 0; offset < sample.second; ) {
+				auto read = std::min<uint64_t>(4096, sample.second - offset);
+				uchardet_handle_data(ud, fp.read(sample.first + offset, read), read);
+				offset += read;
+			}
+		}
+		uchardet_data_end(ud);
+		return uchardet_get_charset(ud);
+#else
+		return "utf-8";
 #endif
+	}();
+
+	if (!key.path.empty()) {
+		std::lock_guard<std::mutex> lock(cache_mutex);
+		if (cache.size() >= max_cache_size)
+			cache.clear();
+		cache[key] = result;
+	}
+	return result;
 }
 } }
@@ -0,0 +1,106 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file deferred_save.cpp
+/// @brief Coalesced background writing of JSON config files
+/// @ingroup libaegisub io
+
+#include "libaegisub/deferred_save.h"
+
+#include "libaegisub/cajun/elements.h"
+#include "libaegisub/cajun/writer.h"
+#include "libaegisub/dispatch.h"
+#include "libaegisub/io.h"
+#include "libaegisub/log.h"
+#include "libaegisub/make_unique.h"
+
+#include <mutex>
+
+namespace agi { namespace io {
+
+struct DeferredSave::State {
+	const fs::path file;
+
+	/// Held for the duration of each write so that writes never overlap
+	std::mutex write_lock;
+
+	/// Protects pending and scheduled
+	std::mutex pending_lock;
+	/// Most recently queued document which has not started being written
+	std::unique_ptr<json::Object> pending;
+	/// Is there a background task which will pick up pending?
+	bool scheduled = false;
+
+	State(fs::path const& file) : file(file) { }
+
+	std::unique_ptr<json::Object> TakePending() {
+		std::lock_guard<std::mutex> lock(pending_lock);
+		scheduled = false;
+		return std::move(pending);
+	}
+
+	void WriteFile(json::Object const& document) {
+		JsonWriter::Write(document, Save(file).Get());
+	}
+
+	/// Write the pending document, if any, with the write lock held
+	void WritePending() {
+		std::lock_guard<std::mutex> lock(write_lock);
+		if (auto document = TakePending()) {
+			try {
+				WriteFile(*document);
+			}
+			catch (agi::Exception const& e) {
+				LOG_E("agi/io/deferred_save") << "Failed to write " << file << ": " << e.GetMessage();
+			}
+		}
+	}
+};
+
+DeferredSave::DeferredSave(fs::path const& file)
+: state(std::make_shared<State>(file))
+{
+}
+
+DeferredSave::~DeferredSave() {
+	Wait();
+}
+
+void DeferredSave::Queue(json::Object document) {
+	{
+		std::lock_guard<std::mutex> lock(state->pending_lock);
+		state->pending = agi::make_unique<json::Object>(std::move(document));
+		if (state->scheduled) return;
+		state->scheduled = true;
+	}
+
+	// The task holds its own reference since it may run after we're gone
+	auto state = this->state;
+	dispatch::Background(dispatch::Priority::Bulk).Async([=] {
+		state->WritePending();
+	});
+}
+
+void DeferredSave::Write(json::Object const& document) {
+	std::lock_guard<std::mutex> lock(state->write_lock);
+	state->TakePending();
+	state->WriteFile(document);
+}
+
+void DeferredSave::Wait() {
+	state->WritePending();
+}
+
+} }
@@ -0,0 +1,250 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+/// @file derived_store.cpp
+/// @brief On-disk cache of data derived from media files
+/// @ingroup libaegisub
+
+#include "libaegisub/derived_store.h"
+
+#include "libaegisub/fs.h"
+#include "libaegisub/io.h"
+#include "libaegisub/log.h"
+
+#include <algorithm>
+#include <boost/algorithm/string/predicate.hpp>
+#include <cstring>
+#include <istream>
+#include <iterator>
+#include <ostream>
+#include <vector>
+
+namespace {
+const char magic[] = "AGIDERIV";
+
+/// FNV-1a, as the names have to stay the same from one run to the next
+uint64_t hash(std::string const& str) {
+	uint64_t h = 14695981039346656037ULL;
+	for (unsigned char c : str) {
+		h ^= c;
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+std::string hex(uint64_t value) {
+	static const char digits[] = "0123456789abcdef";
+	std::string ret(16, '0');
+	for (int i = 15; i >= 0; --i, value >>= 4)
+		ret[i] = digits[value & 0xF];
+	return ret;
+}
+
+std::string identity_string(agi::SourceIdentity const& source) {
+	return source.path + '\0' + std::to_string(source.size) + '\0' + std::to_string(source.modified);
+}
+
+/// Everything in the key, with separators which can't appear in any part
+/// other than the parameters, which come last
+std::string key_string(agi::ArtifactKey const& key) {
+	return key.type + '\0' + std::to_string(key.version) + '\0' + identity_string(key.source) + '\0' + key.params;
+}
+
+std::string path_prefix(std::string const& path) {
+	return hex(hash(path)) + "_";
+}
+
+std::string identity_prefix(agi::SourceIdentity const& source) {
+	return path_prefix(source.path) + hex(hash(identity_string(source))) + "_";
+}
+}
+
+namespace agi {
+SourceIdentity SourceIdentity::Of(fs::path const& file) {
+	SourceIdentity id;
+	id.path = file.string();
+	id.size = fs::Size(file);
+	id.modified = fs::ModifiedTime(file);
+	return id;
+}
+
+DerivedStore::DerivedStore(fs::path directory, uint64_t max_size)
+: dir(std::move(directory))
+, max_size(max_size)
+{
+}
+
+fs::path DerivedStore::PathFor(ArtifactKey const& key) const {
+	return dir/(identity_prefix(key.source) + hex(hash(key_string(key))) + "." + key.type);
+}
+
+void DerivedStore::CountSize() {
+	if (total_size >= 0) return;
+	total_size = 0;
+	for (auto const& file : fs::DirectoryIterator(dir, "")) {
+		try {
+			total_size += fs::Size(dir/file);
+		}
+		catch (fs::FileSystemError const&) {
+			// Removed by another process, or a directory
+		}
+	}
+}
+
+bool DerivedStore::Get(ArtifactKey const& key, std::string &data) {
+	auto path = PathFor(key);
+	auto expected = key_string(key);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	try {
+		if (!fs::FileExists(path)) return false;
+
+		auto in = io::Open(path, true);
+		char file_magic[sizeof magic - 1];
+		uint32_t key_length = 0;
+		in->read(file_magic, sizeof file_magic);
+		in->read(reinterpret_cast<char *>(&key_length), sizeof key_length);
+		if (!*in || memcmp(file_magic, magic, sizeof file_magic) || key_length != expected.size())
+			return false;
+
+		std::string file_key(key_length, '\0');
+		in->read(&file_key[0], key_length);
+		if (!*in || file_key != expected)
+			return false;
+
+		data.assign(std::istreambuf_iterator<char>(*in), std::istreambuf_iterator<char>());
+		in.reset();
+
+		// The modification time is what eviction goes by
+		fs::Touch(path);
+		return true;
+	}
+	catch (agi::Exception const& e) {
+		LOG_E("derived_store") << "Failed to read " << path << ": " << e.GetMessage();
+		return false;
+	}
+}
+
+void DerivedStore::Put(ArtifactKey const& key, std::string const& data) {
+	auto path = PathFor(key);
+	auto key_str = key_string(key);
+	const uint32_t key_length = static_cast<uint32_t>(key_str.size());
+
+	std::lock_guard<std::mutex> lock(mutex);
+	try {
+		CountSize();
+		if (fs::FileExists(path))
+			total_size -= fs::Size(path);
+
+		fs::CreateDirectory(dir);
+		{
+			io::Save file(path, true);
+			auto& out = file.Get();
+			out.write(magic, sizeof magic - 1);
+			out.write(reinterpret_cast<const char *>(&key_length), sizeof key_length);
+			out.write(key_str.data(), key_str.size());
+			out.write(data.data(), data.size());
+		}
+		total_size += fs::Size(path);
+
+		// Anything derived from an older version of the file is never going
+		// to be looked up again
+		RemoveMatching(path_prefix(key.source.path), "." + key.type, identity_prefix(key.source));
+		TrimLocked(path);
+	}
+	catch (agi::Exception const& e) {
+		LOG_E("derived_store") << "Failed to write " << path << ": " << e.GetMessage();
+	}
+}
+
+void DerivedStore::RemoveMatching(std::string const& prefix, std::string const& suffix, std::string const& keep) {
+	std::vector<std::string> matches;
+	for (auto const& file : fs::DirectoryIterator(dir, "")) {
+		if (boost::starts_with(file, prefix) && boost::ends_with(file, suffix) && (keep.empty() || !boost::starts_with(file, keep)))
+			matches.push_back(file);
+	}
+
+	for (auto const& file : matches) {
+		try {
+			auto size = fs::Size(dir/file);
+			fs::Remove(dir/file);
+			if (total_size >= 0)
+				total_size -= size;
+			LOG_D("derived_store") << "Removed outdated " << file;
+		}
+		catch (agi::Exception const& e) {
+			LOG_D("derived_store") << "Failed to remove " << file << ": " << e.GetMessage();
+		}
+	}
+}
+
+void DerivedStore::TrimLocked(fs::path const& keep) {
+	if (total_size < 0 || static_cast<uint64_t>(total_size) <= max_size) return;
+
+	struct Entry {
+		time_t modified;
+		uintmax_t size;
+		fs::path path;
+	};
+	std::vector<Entry> entries;
+	for (auto const& file : fs::DirectoryIterator(dir, "")) {
+		try {
+			auto path = dir/file;
+			entries.push_back(Entry{fs::ModifiedTime(path), fs::Size(path), path});
+		}
+		catch (fs::FileSystemError const&) { }
+	}
+	sort(begin(entries), end(entries), [](Entry const& a, Entry const& b) {
+		return a.modified < b.modified;
+	});
+
+	// Recount while going, as other processes may share the directory
+	total_size = 0;
+	for (auto const& entry : entries)
+		total_size += entry.size;
+
+	size_t removed = 0;
+	for (auto const& entry : entries) {
+		if (static_cast<uint64_t>(total_size) <= max_size) break;
+		if (entry.path == keep) continue;
+		try {
+			fs::Remove(entry.path);
+			total_size -= entry.size;
+			++removed;
+		}
+		catch (agi::Exception const& e) {
+			LOG_D("derived_store") << "Failed to remove " << entry.path << ": " << e.GetMessage();
+		}
+	}
+	LOG_D("derived_store") << "Removed " << removed << " least recently used artifacts";
+}
+
+void DerivedStore::Invalidate(std::string const& source_path) {
+	std::lock_guard<std::mutex> lock(mutex);
+	RemoveMatching(path_prefix(source_path), "", "");
+}
+
+void DerivedStore::SetMaxSize(uint64_t new_max_size) {
+	std::lock_guard<std::mutex> lock(mutex);
+	max_size = new_max_size;
+	CountSize();
+	TrimLocked({});
+}
+
+uint64_t DerivedStore::Size() {
+	std::lock_guard<std::mutex> lock(mutex);
+	CountSize();
+	return total_size;
+}
+}
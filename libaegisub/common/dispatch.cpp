@@ -18,49 +18,173 @@
 
 #include "libaegisub/util.h"
 
+#include <algorithm>
+#include <array>
 #include <atomic>
-#include <boost/asio/executor_work_guard.hpp>
-#include <boost/asio/io_context.hpp>
-#include <boost/asio/strand.hpp>
 #include <condition_variable>
+#include <deque>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 namespace {
-	boost::asio::io_context *service;
-	std::function<void (agi::dispatch::Thunk)> invoke_main;
+	using agi::dispatch::Priority;
+	using agi::dispatch::Thunk;
+
+	std::function<void (Thunk)> invoke_main;
 	std::atomic<uint_fast32_t> threads_running;
 
-	class MainQueue final : public agi::dispatch::Queue {
-		void DoInvoke(agi::dispatch::Thunk&& thunk) override {
-			invoke_main(thunk);
-		}
+	const size_t priority_count = 3;
+
+	/// Queued thunks of each priority
+	struct TaskDeque {
+		std::mutex mutex;
+		std::array<std::deque<Thunk>, priority_count> tasks;
 	};
 
-	class BackgroundQueue final : public agi::dispatch::Queue {
-		void DoInvoke(agi::dispatch::Thunk&& thunk) override {
-			boost::asio::post(*service, std::move(thunk));
+	/// Index of the current thread in the pool, or -1 for other threads
+	thread_local int worker_index = -1;
+
+	/// Work-stealing thread pool
+	///
+	/// Each worker has its own deque, which thunks posted from that worker go
+	/// onto and which the worker takes from newest first; thunks posted from
+	/// other threads go onto a shared deque. Idle workers take the oldest
+	/// thunk from the shared deque or another worker's deque, always looking
+	/// for the most urgent priority first.
+	class ThreadPool {
+		std::vector<std::unique_ptr<TaskDeque>> local;
+		TaskDeque shared;
+		std::vector<std::thread> threads;
+
+		std::array<std::atomic<size_t>, priority_count> pending{};
+		/// Number of bulk thunks currently running, which is kept below the
+		/// number of workers
+		std::atomic<size_t> running_bulk{0};
+		size_t bulk_limit = 1;
+
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::atomic<int> sleeping{0};
+		std::atomic<bool> stopping{false};
+
+		bool TakeFrom(TaskDeque &deque, size_t priority, bool newest, Thunk &out) {
+			std::lock_guard<std::mutex> lock(deque.mutex);
+			auto &tasks = deque.tasks[priority];
+			if (tasks.empty()) return false;
+			if (newest) {
+				out = std::move(tasks.back());
+				tasks.pop_back();
+			}
+			else {
+				out = std::move(tasks.front());
+				tasks.pop_front();
+			}
+			return true;
 		}
-	};
 
-	class SerialQueue final : public agi::dispatch::Queue {
-		boost::asio::io_context::strand strand;
+		bool Find(size_t worker, size_t priority, Thunk &out) {
+			if (TakeFrom(*local[worker], priority, true, out)) return true;
+			if (TakeFrom(shared, priority, false, out)) return true;
+			for (size_t i = 1; i < local.size(); ++i) {
+				if (TakeFrom(*local[(worker + i) % local.size()], priority, false, out))
+					return true;
+			}
+			return false;
+		}
+
+		/// Take the most urgent runnable thunk
+		/// @return The thunk's priority, or -1 if there wasn't one
+		int Take(size_t worker, Thunk &out) {
+			for (size_t priority = 0; priority < priority_count; ++priority) {
+				if (!pending[priority]) continue;
+
+				const bool bulk = priority == static_cast<size_t>(Priority::Bulk);
+				if (bulk && ++running_bulk > bulk_limit) {
+					--running_bulk;
+					continue;
+				}
+
+				if (Find(worker, priority, out)) {
+					--pending[priority];
+					return static_cast<int>(priority);
+				}
+				if (bulk) --running_bulk;
+			}
+			return -1;
+		}
 
-		void DoInvoke(agi::dispatch::Thunk&& thunk) override {
-			boost::asio::post(strand, std::move(thunk));
+		bool HasRunnable() const {
+			return pending[0] || pending[1] || (pending[2] && running_bulk < bulk_limit);
 		}
+
+		void Wake() {
+			if (sleeping) {
+				{ std::lock_guard<std::mutex> lock(mutex); }
+				wake.notify_one();
+			}
+		}
+
+		void Work(size_t worker) {
+			worker_index = static_cast<int>(worker);
+			Thunk thunk;
+			while (true) {
+				const int priority = Take(worker, thunk);
+				if (priority >= 0) {
+					thunk();
+					thunk = nullptr;
+					if (priority == static_cast<int>(Priority::Bulk)) {
+						--running_bulk;
+						if (pending[priority]) Wake();
+					}
+					continue;
+				}
+
+				std::unique_lock<std::mutex> lock(mutex);
+				++sleeping;
+				wake.wait(lock, [&] { return stopping || HasRunnable(); });
+				--sleeping;
+				if (stopping && !HasRunnable()) return;
+			}
+		}
+
 	public:
-		SerialQueue() : strand(*service) { }
-	};
+		void Start(size_t count) {
+			if (!threads.empty()) return;
+			bulk_limit = std::max<size_t>(1, count - 1);
+			for (size_t i = 0; i < count; ++i)
+				local.push_back(std::unique_ptr<TaskDeque>(new TaskDeque));
 
-	struct IOServiceThreadPool {
-		boost::asio::io_context io_context;
-		boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work_guard;
-		std::vector<std::thread> threads;
+			threads.reserve(count);
+			for (size_t i = 0; i < count; ++i) {
+				threads.emplace_back([=]{
+					++threads_running;
+					agi::util::SetThreadName("Dispatch Worker");
+					Work(i);
+					--threads_running;
+				});
+			}
+		}
 
-		IOServiceThreadPool() : work_guard(boost::asio::make_work_guard(io_context)) { }
-		~IOServiceThreadPool() {
-			work_guard.reset();
+		void Post(Priority priority, Thunk&& thunk) {
+			const size_t p = static_cast<size_t>(priority);
+			auto &deque = worker_index >= 0 ? *local[worker_index] : shared;
+			// Counted first so that the count never goes negative; a worker
+			// which sees it before the push just looks again
+			++pending[p];
+			{
+				std::lock_guard<std::mutex> lock(deque.mutex);
+				deque.tasks[p].push_back(std::move(thunk));
+			}
+			Wake();
+		}
+
+		~ThreadPool() {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			wake.notify_all();
 #ifndef _WIN32
 			for (auto& thread : threads) thread.join();
 #else
@@ -71,24 +195,147 @@ namespace {
 #endif
 		}
 	};
+
+	ThreadPool *pool;
+
+	class MainQueue final : public agi::dispatch::Queue {
+		void DoInvoke(Thunk&& thunk) override {
+			invoke_main(thunk);
+		}
+	};
+
+	class BackgroundQueue final : public agi::dispatch::Queue {
+		Priority priority;
+
+		void DoInvoke(Thunk&& thunk) override {
+			pool->Post(priority, std::move(thunk));
+		}
+	public:
+		BackgroundQueue(Priority priority) : priority(priority) { }
+	};
+
+	class SerialQueue final : public agi::dispatch::Queue {
+		/// Shared with the queued drain thunk so that the queue can be
+		/// destroyed with work still pending
+		struct State {
+			Priority priority;
+			std::mutex mutex;
+			std::deque<Thunk> tasks;
+			bool scheduled = false;
+		};
+		std::shared_ptr<State> state;
+
+		/// Run the oldest thunk, then go to the back of the pool's queue if
+		/// there are more so that a busy serial queue doesn't hog a worker
+		static void RunNext(std::shared_ptr<State> const& state) {
+			Thunk thunk;
+			{
+				std::lock_guard<std::mutex> lock(state->mutex);
+				thunk = std::move(state->tasks.front());
+				state->tasks.pop_front();
+			}
+			thunk();
+
+			std::lock_guard<std::mutex> lock(state->mutex);
+			if (state->tasks.empty())
+				state->scheduled = false;
+			else
+				pool->Post(state->priority, [state] { RunNext(state); });
+		}
+
+		void DoInvoke(Thunk&& thunk) override {
+			std::lock_guard<std::mutex> lock(state->mutex);
+			state->tasks.push_back(std::move(thunk));
+			if (!state->scheduled) {
+				state->scheduled = true;
+				auto state = this->state;
+				pool->Post(state->priority, [state] { RunNext(state); });
+			}
+		}
+	public:
+		SerialQueue(Priority priority) : state(std::make_shared<State>()) {
+			state->priority = priority;
+		}
+	};
+
+	/// State shared by the threads running agi::dispatch::Parallel()
+	struct ParallelJob {
+		std::function<void (size_t)> const& func;
+		const size_t count;
+		std::atomic<size_t> next{0};
+		std::vector<std::exception_ptr> errors;
+
+		std::mutex mutex;
+		std::condition_variable done;
+		size_t finished = 0;
+
+		ParallelJob(std::function<void (size_t)> const& func, size_t count)
+		: func(func), count(count), errors(count) { }
+
+		void Run() {
+			// Threads which only start after everything is claimed return
+			// without touching func, which may no longer exist by then
+			for (size_t i; (i = next++) < count; ) {
+				try {
+					func(i);
+				}
+				catch (...) {
+					errors[i] = std::current_exception();
+				}
+
+				std::lock_guard<std::mutex> lock(mutex);
+				if (++finished == count)
+					done.notify_all();
+			}
+		}
+	};
 }
 
 namespace agi { namespace dispatch {
 
+struct TaskGroup::State {
+	std::mutex mutex;
+	std::condition_variable done;
+	std::deque<Thunk> queued;
+	size_t outstanding = 0;
+	std::exception_ptr error;
+	CancellationToken token;
+
+	/// Run one of the group's thunks which hasn't been started yet
+	/// @return Was there one?
+	bool RunOne() {
+		Thunk thunk;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (queued.empty()) return false;
+			thunk = std::move(queued.front());
+			queued.pop_front();
+		}
+
+		std::exception_ptr e;
+		if (!token.IsCancelled()) {
+			try {
+				thunk();
+			}
+			catch (...) {
+				e = std::current_exception();
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (e && !error) error = e;
+		if (--outstanding == 0)
+			done.notify_all();
+		return true;
+	}
+};
+
 void Init(std::function<void (Thunk)>&& invoke_main) {
-	static IOServiceThreadPool thread_pool;
-	::service = &thread_pool.io_context;
+	static ThreadPool thread_pool;
+	::pool = &thread_pool;
 	::invoke_main = invoke_main;
 
-	thread_pool.threads.reserve(std::max<unsigned>(4, std::thread::hardware_concurrency()));
-	for (size_t i = 0; i < thread_pool.threads.capacity(); ++i) {
-		thread_pool.threads.emplace_back([]{
-			++threads_running;
-			agi::util::SetThreadName("Dispatch Worker");
-			service->run();
-			--threads_running;
-		});
-	}
+	thread_pool.Start(std::max<unsigned>(4, std::thread::hardware_concurrency()));
 }
 
 void Queue::Async(Thunk&& thunk) {
@@ -103,6 +350,13 @@ void Queue::Async(Thunk&& thunk) {
 	});
 }
 
+void Queue::Async(Thunk&& thunk, CancellationToken const& token) {
+	Async([=] {
+		if (!token.IsCancelled())
+			thunk();
+	});
+}
+
 void Queue::Sync(Thunk&& thunk) {
 	std::mutex m;
 	std::condition_variable cv;
@@ -129,13 +383,78 @@ Queue& Main() {
 	return q;
 }
 
-Queue& Background() {
-	static BackgroundQueue q;
-	return q;
+Queue& Background(Priority priority) {
+	static BackgroundQueue queues[] = {
+		BackgroundQueue(Priority::Interactive),
+		BackgroundQueue(Priority::Prefetch),
+		BackgroundQueue(Priority::Bulk)
+	};
+	return queues[static_cast<size_t>(priority)];
+}
+
+std::unique_ptr<Queue> Create(Priority priority) {
+	return std::unique_ptr<Queue>(new SerialQueue(priority));
+}
+
+void Parallel(size_t count, std::function<void (size_t)> const& func) {
+	if (count == 0) return;
+
+	auto job = std::make_shared<ParallelJob>(func, count);
+	const size_t threads = std::min<size_t>(count, std::thread::hardware_concurrency());
+	for (size_t i = 1; i < threads; ++i)
+		pool->Post(Priority::Interactive, [job] { job->Run(); });
+
+	// The calling thread does its share too, so this finishes even if every
+	// background thread is busy
+	job->Run();
+	{
+		std::unique_lock<std::mutex> lock(job->mutex);
+		job->done.wait(lock, [&] { return job->finished == count; });
+	}
+
+	for (auto const& e : job->errors) {
+		if (e) std::rethrow_exception(e);
+	}
 }
 
-std::unique_ptr<Queue> Create() {
-	return std::unique_ptr<Queue>(new SerialQueue);
+TaskGroup::TaskGroup(Priority priority)
+: state(std::make_shared<State>())
+, priority(priority)
+{
+}
+
+TaskGroup::~TaskGroup() {
+	Cancel();
+	try {
+		Wait();
+	}
+	catch (...) { }
+}
+
+void TaskGroup::Run(Thunk&& thunk) {
+	{
+		std::lock_guard<std::mutex> lock(state->mutex);
+		state->queued.push_back(std::move(thunk));
+		++state->outstanding;
+	}
+	auto state = this->state;
+	pool->Post(priority, [state] { state->RunOne(); });
+}
+
+void TaskGroup::Cancel() {
+	state->token.Cancel();
+}
+
+void TaskGroup::Wait() {
+	while (state->RunOne()) ;
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->done.wait(lock, [&] { return state->outstanding == 0; });
+	if (state->error) {
+		auto e = state->error;
+		state->error = nullptr;
+		std::rethrow_exception(e);
+	}
 }
 
 } }
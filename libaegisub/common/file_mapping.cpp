@@ -118,12 +118,51 @@ file_mapping::~file_mapping() {
 	}
 }
 
-read_file_mapping::read_file_mapping(fs::path const& filename)
-: file(filename, false)
-{
+namespace {
+thread_local file_open_scope *innermost_scope = nullptr;
+
+uint64_t get_size(file_mapping const& file) {
 	offset_t size = 0;
 	ipcdetail::get_file_size(file.get_mapping_handle().handle, size);
-	file_size = static_cast<uint64_t>(size);
+	return static_cast<uint64_t>(size);
+}
+}
+
+file_open_scope::file_open_scope(fs::path const& path)
+: filename(path.string())
+, outer(innermost_scope)
+{
+	// Nested scopes for the same file share the outer one's handle too
+	for (auto scope = outer; scope; scope = scope->outer) {
+		if (scope->filename == filename) {
+			file = scope->file;
+			file_size = scope->file_size;
+			break;
+		}
+	}
+	if (!file) {
+		file = std::make_shared<file_mapping>(path, false);
+		file_size = get_size(*file);
+	}
+	innermost_scope = this;
+}
+
+file_open_scope::~file_open_scope() {
+	innermost_scope = outer;
+}
+
+read_file_mapping::read_file_mapping(fs::path const& filename) {
+	const auto name = filename.string();
+	for (auto scope = innermost_scope; scope; scope = scope->outer) {
+		if (scope->filename == name) {
+			file = scope->file;
+			file_size = scope->file_size;
+			return;
+		}
+	}
+
+	file = std::make_shared<file_mapping>(filename, false);
+	file_size = get_size(*file);
 }
 
 read_file_mapping::~read_file_mapping() { }
@@ -133,10 +172,10 @@ const char *read_file_mapping::read() {
 }
 
 const char *read_file_mapping::read(int64_t offset, uint64_t length) {
-	return map(offset, length, read_only, file_size, file, region, mapping_start);
+	return map(offset, length, read_only, file_size, *file, region, mapping_start);
 }
 
-temp_file_mapping::temp_file_mapping(fs::path const& filename, uint64_t size)
+temp_file_mapping::temp_file_mapping(fs::path const& filename, uint64_t size, bool keep)
 : file(filename, true)
 , file_size(size)
 {
@@ -147,7 +186,8 @@ temp_file_mapping::temp_file_mapping(fs::path const& filename, uint64_t size)
 	SetFilePointerEx(handle, li, nullptr, FILE_BEGIN);
 	SetEndOfFile(handle);
 #else
-	unlink(filename.string().c_str());
+	if (!keep)
+		unlink(filename.string().c_str());
 	if (ftruncate(handle, size) == -1) {
 		switch (errno) {
 		case EBADF:  throw InternalError("Error opening file " + filename.string() + " not handled");
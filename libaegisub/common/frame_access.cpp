@@ -0,0 +1,106 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include "libaegisub/frame_access.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+
+namespace agi { namespace frame_access {
+const Pattern AllPatterns[4] = {
+	Pattern::Sequential, Pattern::RandomSeek, Pattern::BackwardStep, Pattern::KeyframeJump
+};
+
+const char *PatternName(Pattern pattern) {
+	switch (pattern) {
+		case Pattern::Sequential:   return "sequential";
+		case Pattern::RandomSeek:   return "random_seek";
+		case Pattern::BackwardStep: return "backward_step";
+		case Pattern::KeyframeJump: return "keyframe_jump";
+	}
+	return "unknown";
+}
+
+std::vector<int> Generate(Pattern pattern, int frame_count, std::vector<int> const& keyframes, size_t count, uint32_t seed) {
+	std::vector<int> frames;
+	if (frame_count <= 0 || count == 0) return frames;
+
+	switch (pattern) {
+		case Pattern::Sequential:
+			count = std::min<size_t>(count, frame_count);
+			frames.resize(count);
+			std::iota(frames.begin(), frames.end(), 0);
+			break;
+
+		case Pattern::RandomSeek: {
+			std::mt19937 rng(seed);
+			std::uniform_int_distribution<int> dist(0, frame_count - 1);
+			frames.reserve(count);
+			for (size_t i = 0; i < count; ++i)
+				frames.push_back(dist(rng));
+			break;
+		}
+
+		case Pattern::BackwardStep:
+			// Step back from the end of a span of count frames rather than
+			// from the end of the video so that it covers the same frames
+			// as Sequential
+			count = std::min<size_t>(count, frame_count);
+			for (size_t i = count; i > 0; --i)
+				frames.push_back(static_cast<int>(i - 1));
+			break;
+
+		case Pattern::KeyframeJump:
+			for (int frame : keyframes) {
+				if (frames.size() == count) break;
+				if (frame >= 0 && frame < frame_count)
+					frames.push_back(frame);
+			}
+			if (frames.empty()) {
+				count = std::min<size_t>(count, frame_count);
+				for (size_t i = 0; i < count; ++i)
+					frames.push_back(static_cast<int>(i * frame_count / count));
+			}
+			break;
+	}
+
+	return frames;
+}
+
+LatencyStats Summarize(std::vector<double> latencies_ms) {
+	LatencyStats stats;
+	if (latencies_ms.empty()) return stats;
+
+	std::sort(latencies_ms.begin(), latencies_ms.end());
+	auto percentile = [&](double p) {
+		// Nearest-rank, so that every reported value is one actually seen
+		size_t rank = static_cast<size_t>(std::ceil(p * latencies_ms.size()));
+		return latencies_ms[std::max<size_t>(rank, 1) - 1];
+	};
+
+	stats.count = latencies_ms.size();
+	stats.total_ms = std::accumulate(latencies_ms.begin(), latencies_ms.end(), 0.0);
+	stats.mean_ms = stats.total_ms / stats.count;
+	stats.p50_ms = percentile(.5);
+	stats.p90_ms = percentile(.9);
+	stats.p99_ms = percentile(.99);
+	stats.max_ms = latencies_ms.back();
+	if (stats.total_ms > 0)
+		stats.fps = stats.count * 1000. / stats.total_ms;
+	return stats;
+}
+} }
@@ -16,7 +16,10 @@
 
 #include "libaegisub/kana_table.h"
 
-#include <boost/range/algorithm.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <unordered_map>
 
 namespace {
 agi::kana_pair kana_to_romaji[] = {
@@ -578,42 +581,73 @@ agi::kana_pair romaji_to_kana[] = {
 	{"\xE3\x83\x85", "zu"},              // ヅ
 };
 
-bool cmp_kana(agi::kana_pair const& kp, std::string const& kana) {
-	return strcmp(kp.kana, kana.c_str()) < 0;
+using kana_range = std::pair<const agi::kana_pair *, const agi::kana_pair *>;
+
+/// Pack a string of at most eight bytes into an integer for use as a key
+uint64_t make_key(const char *str, size_t len) {
+	uint64_t key = 0;
+	memcpy(&key, str, len);
+	return key ^ (uint64_t(len) << 59);
 }
 
-struct cmp_romaji {
-	bool operator()(agi::kana_pair const& kp, std::string const& romaji) const {
-		return strcmp(kp.romaji, romaji.c_str()) < 0;
-	}
-	bool operator()(std::string const& romaji, agi::kana_pair const& kp) const {
-		return strcmp(kp.romaji, romaji.c_str()) > 0;
+/// An index of one of the tables by one of its columns, so that looking
+/// something up is a single hash lookup rather than a binary search which
+/// constructs a string for every comparison
+///
+/// The entries for each key are contiguous in the tables, so each maps to
+/// the range of entries for it.
+struct table_index {
+	std::unordered_map<uint64_t, kana_range> ranges;
+	size_t max_length = 0;
+
+	template<size_t N>
+	table_index(agi::kana_pair (&table)[N], const char *agi::kana_pair::*column) {
+		ranges.reserve(N);
+		for (auto const& kp : table) {
+			const size_t len = strlen(kp.*column);
+			assert(len <= 8);
+			max_length = std::max(max_length, len);
+			auto& range = ranges[make_key(kp.*column, len)];
+			if (!range.first)
+				range = kana_range(&kp, &kp + 1);
+			else if (range.second == &kp)
+				++range.second;
+		}
 	}
 
-#ifdef _MSC_VER // debug iterator stuff needs this overload
-	bool operator()(agi::kana_pair const& a, agi::kana_pair const& b) const {
-		return strcmp(a.romaji, b.romaji) < 0;
+	kana_range find(const char *str, size_t len) const {
+		if (len > max_length) return kana_range(nullptr, nullptr);
+		auto it = ranges.find(make_key(str, len));
+		return it == ranges.end() ? kana_range(nullptr, nullptr) : it->second;
 	}
-#endif
 };
 
+table_index const& kana_index() {
+	static const table_index index(::kana_to_romaji, &agi::kana_pair::kana);
+	return index;
+}
+
+table_index const& romaji_index() {
+	static const table_index index(::romaji_to_kana, &agi::kana_pair::romaji);
+	return index;
+}
 }
 
 namespace agi {
 std::vector<const char *> kana_to_romaji(std::string const& kana) {
 	std::vector<const char *> ret;
-	for (auto pair = boost::lower_bound(::kana_to_romaji, kana, cmp_kana);
-		pair != std::end(::kana_to_romaji) && !strcmp(pair->kana, kana.c_str());
-		++pair)
+	auto range = kana_index().find(kana.data(), kana.size());
+	for (auto pair = range.first; pair != range.second; ++pair)
 		ret.push_back(pair->romaji);
 	return ret;
 }
 
 boost::iterator_range<const kana_pair *> romaji_to_kana(std::string const& romaji) {
-	for (size_t len = std::min<size_t>(3, romaji.size()); len > 0; --len) {
-		auto pair = boost::equal_range(::romaji_to_kana, romaji.substr(0, len).c_str(), cmp_romaji());
-		if (pair.first != pair.second)
-			return boost::make_iterator_range(pair.first, pair.second);
+	auto const& index = romaji_index();
+	for (size_t len = std::min(index.max_length, romaji.size()); len > 0; --len) {
+		auto range = index.find(romaji.data(), len);
+		if (range.first)
+			return boost::make_iterator_range(range.first, range.second);
 	}
 	return boost::make_iterator_range(::romaji_to_kana, ::romaji_to_kana);
 }
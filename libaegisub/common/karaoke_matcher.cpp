@@ -47,6 +47,23 @@ bool is_whitespace(std::string const& str) {
 	return true;
 }
 
+/// Get the first user-perceived character of a non-empty string
+///
+/// Only a short prefix of the string is segmented, as segmenting all of a
+/// long syllable every time a character is consumed from it made matching
+/// quadratic in the length of the syllable.
+std::string first_character(std::string const& str) {
+	using namespace boost::locale::boundary;
+	for (size_t window = 32; ; window *= 4) {
+		const size_t len = std::min(window, str.size());
+		ssegment_index characters(character, begin(str), begin(str) + len);
+		auto first = characters.begin()->str();
+		// A character which runs to the end of the window may continue past it
+		if (first.size() < len || len == str.size())
+			return first;
+	}
+}
+
 // strcmp but ignoring case and accents
 int compare(std::string const& a, std::string const& b) {
 	using namespace boost::locale;
@@ -102,7 +119,7 @@ karaoke_match_result auto_match_karaoke(std::vector<std::string> const& source_s
 	// character. If it does, match them and repeat.
 	while (!src.empty()) {
 		// First check for a basic match of the first character of the source and dest
-		auto first_src_char = ssegment_index(character, begin(src), end(src)).begin()->str();
+		auto first_src_char = first_character(src);
 		if (compare(first_src_char, dst->str()) == 0) {
 			++dst;
 			++result.destination_length;
@@ -137,7 +154,7 @@ karaoke_match_result auto_match_karaoke(std::vector<std::string> const& source_s
 	// Source and dest are now non-empty and start with non-whitespace.
 	// If there's only one character left in the dest, it obviously needs to
 	// match all of the source syllables left.
-	if (std::distance(dst, dst_end) == 1) {
+	if (std::next(dst) == dst_end) {
 		result.source_length = source_strings.size();
 		++result.destination_length;
 		return result;
@@ -160,6 +177,21 @@ karaoke_match_result auto_match_karaoke(std::vector<std::string> const& source_s
 	// skipping. Higher numbers probably increase false-positives.
 	static const int dst_lookahead_max = 3;
 
+	// The non-blank source syllables which the lookahead can reach, along
+	// with lowercase copies of them, worked out once rather than for each
+	// destination character tried
+	struct syllable {
+		std::string const *str;
+		std::string lower;
+	};
+	std::vector<syllable> lookahead_syllables;
+	for (auto const& syl : source_strings) {
+		if (lookahead_syllables.size() == static_cast<size_t>(dst_lookahead_max * max_character_length)) break;
+		// Don't count blank syllables in the max search distance
+		if (!is_whitespace(syl))
+			lookahead_syllables.push_back(syllable{&syl, boost::to_lower_copy(syl)});
+	}
+
 	for (size_t lookahead = 0; lookahead < dst_lookahead_max; ++lookahead) {
 		if (++dst == dst_end) break;
 
@@ -171,16 +203,12 @@ karaoke_match_result auto_match_karaoke(std::vector<std::string> const& source_s
 		boost::copy(kana_to_romaji(dst->str()), back_inserter(translit));
 
 		// Search for it and the transliterated version in the source
-		int src_lookahead_max = (lookahead + 1) * max_character_length;
-		int src_lookahead_pos = 0;
-		for (auto const& syl : source_strings) {
-			// Don't count blank syllables in the max search distance
-			if (is_whitespace(syl)) continue;
-			if (++src_lookahead_pos == 1) continue;
-			if (src_lookahead_pos > src_lookahead_max) break;
-
-			std::string lsyl = boost::to_lower_copy(syl);
-			if (!(starts_with(syl, dst->str()) || util::any_of(translit, [&](const char *str) { return starts_with(lsyl, str); })))
+		size_t src_lookahead_max = (lookahead + 1) * max_character_length;
+		auto dst_char = dst->str();
+		for (size_t i = 1; i < lookahead_syllables.size() && i < src_lookahead_max; ++i) {
+			auto const& syl = lookahead_syllables[i];
+			const size_t src_lookahead_pos = i + 1;
+			if (!(starts_with(*syl.str, dst_char) || util::any_of(translit, [&](const char *str) { return starts_with(syl.lower, str); })))
 				continue;
 
 			// The syllable immediately after the current one matched, so
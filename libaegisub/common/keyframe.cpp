@@ -19,29 +19,139 @@
 
 #include "libaegisub/keyframe.h"
 
-#include <sstream>
-
+#include "libaegisub/file_mapping.h"
 #include "libaegisub/io.h"
-#include "libaegisub/line_iterator.h"
 
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/interprocess/streams/bufferstream.hpp>
 #include <boost/range/algorithm/copy.hpp>
+#include <cctype>
+#include <climits>
+#include <cstring>
 
 namespace {
-std::vector<int> agi_keyframes(std::istream &file) {
-	double fps;
+/// @class line_reader
+/// @brief Reads lines from a memory-mapped file in place
+///
+/// Keyframe files are stats logs from a whole encode and can run to hundreds
+/// of megabytes, so rather than copying each line into a string, lines are
+/// handed out as ranges within a mapped window of the file which slides
+/// forward as it's consumed.
+class line_reader {
+	agi::read_file_mapping file;
+	/// Offset in the file of the start of the mapped window
+	uint64_t window_start = 0;
+	/// Number of bytes mapped, which is grown if a single line won't fit
+	uint64_t window_size = 16 * 1024 * 1024;
+	const char *data = nullptr;
+	size_t pos = 0;
+	size_t len = 0;
+
+	bool at_eof() const { return window_start + len == file.size(); }
+
+	void remap() {
+		if (pos == 0 && len != 0)
+			window_size *= 2;
+		window_start += pos;
+		len = static_cast<size_t>(std::min(window_size, file.size() - window_start));
+		data = file.read(window_start, len);
+		pos = 0;
+	}
+
+public:
+	line_reader(agi::fs::path const& filename) : file(filename) { }
+
+	/// @brief Get the next line, not including the line ending
+	/// @param[out] begin Start of the line
+	/// @param[out] end End of the line
+	/// @param strip_cr Drop a trailing carriage return
+	/// @return false once the end of the file has been reached
+	bool next(const char *&begin, const char *&end, bool strip_cr = true) {
+		for (;;) {
+			if (pos < len) {
+				auto nl = static_cast<const char *>(memchr(data + pos, '\n', len - pos));
+				if (nl || at_eof()) {
+					begin = data + pos;
+					end = nl ? nl : data + len;
+					pos = end - data + (nl ? 1 : 0);
+					if (strip_cr && end != begin && end[-1] == '\r')
+						--end;
+					return true;
+				}
+			}
+			else if (at_eof())
+				return false;
+			remap();
+		}
+	}
+
+	/// Get the unread part of the current window, mapping more if it's empty
+	std::pair<const char *, size_t> remaining() {
+		if (pos == len && !at_eof())
+			remap();
+		return {data + pos, len - pos};
+	}
+
+	/// Mark the first count bytes returned by remaining() as read
+	void skip(size_t count) { pos += count; }
+};
+
+bool is_space(char c) {
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/// @brief Parse a decimal integer the way operator>> does
+/// @param p Start of the text, which may have leading whitespace
+/// @param end End of the text
+/// @param[out] value Parsed value
+/// @return Pointer to just past the number, or nullptr if there wasn't a
+///         valid number in range for an int
+const char *parse_int(const char *p, const char *end, int &value) {
+	while (p != end && is_space(*p)) ++p;
+	if (p == end) return nullptr;
+
+	bool negative = *p == '-';
+	if (*p == '-' || *p == '+') ++p;
+	if (p == end || *p < '0' || *p > '9') return nullptr;
+
+	const long long limit = negative ? -static_cast<long long>(INT_MIN) : INT_MAX;
+	long long n = 0;
+	for (; p != end && *p >= '0' && *p <= '9'; ++p) {
+		n = n * 10 + (*p - '0');
+		if (n > limit) return nullptr;
+	}
+	value = static_cast<int>(negative ? -n : n);
+	return p;
+}
+
+std::vector<int> agi_keyframes(line_reader &file) {
+	// The header is followed by the fps, which isn't used for anything but
+	// has to be present
+	auto rest = file.remaining();
+	boost::interprocess::ibufferstream ss(rest.first, rest.second);
 	std::string fps_str;
-	file >> fps_str;
-	file >> fps;
+	double fps;
+	ss >> fps_str >> fps;
+	if (ss.fail()) return {};
+	auto consumed = ss.tellg();
+	file.skip(consumed < 0 ? rest.second : static_cast<size_t>(consumed));
 
-	return std::vector<int>(agi::line_iterator<int>(file), agi::line_iterator<int>());
+	std::vector<int> ret;
+	const char *begin, *end;
+	while (file.next(begin, end)) {
+		int frame;
+		if (parse_int(begin, end, frame))
+			ret.push_back(frame);
+	}
+	return ret;
 }
 
-std::vector<int> enumerated_keyframes(std::istream &file, char (*func)(std::string const&)) {
+std::vector<int> enumerated_keyframes(line_reader &file, char (*func)(const char *, const char *)) {
 	int count = 0;
 	std::vector<int> ret;
-	for (auto line : agi::line_iterator<std::string>(file)) {
-		char c = tolower(func(line));
+	const char *begin, *end;
+	while (file.next(begin, end)) {
+		char c = tolower(func(begin, end));
 		if (c == 'i')
 			ret.push_back(count++);
 		else if (c == 'p' || c == 'b')
@@ -50,46 +160,51 @@ std::vector<int> enumerated_keyframes(std::istream &file, char (*func)(std::stri
 	return ret;
 }
 
-std::vector<int> indexed_keyframes(std::istream &file, int (*func)(std::string const&)) {
+std::vector<int> indexed_keyframes(line_reader &file, int (*func)(const char *, const char *)) {
 	std::vector<int> ret;
-	for (auto line : agi::line_iterator<std::string>(file)) {
-		int frame_no = func(line);
+	const char *begin, *end;
+	while (file.next(begin, end)) {
+		int frame_no = func(begin, end);
 		if (frame_no >= 0)
 			ret.push_back(frame_no);
 	}
 	return ret;
 }
 
-char xvid(std::string const& line) {
-	return line.empty() ? 0 : line[0];
+char xvid(const char *begin, const char *end) {
+	return begin == end ? 0 : *begin;
 }
 
-char divx(std::string const& line) {
-	char chrs[] = "IPB";
-	for (int i = 0; i < 3; ++i) {
-		std::string::size_type pos = line.find(chrs[i]);
-		if (pos != line.npos)
-			return line[pos];
+char divx(const char *begin, const char *end) {
+	for (char chr : {'I', 'P', 'B'}) {
+		if (memchr(begin, chr, end - begin))
+			return chr;
 	}
 	return 0;
 }
 
-char x264(std::string const& line) {
-	std::string::size_type pos = line.find("type:");
-	if (pos == line.npos || pos + 5 >= line.size()) return 0;
-	return line[pos + 5];
+char x264(const char *begin, const char *end) {
+	static const char tag[] = "type:";
+	const size_t tag_len = sizeof(tag) - 1;
+	for (auto p = begin; end - p > static_cast<ptrdiff_t>(tag_len); ++p) {
+		p = static_cast<const char *>(memchr(p, 't', end - p - tag_len));
+		if (!p) break;
+		if (memcmp(p, tag, tag_len) == 0)
+			return p[tag_len];
+	}
+	return 0;
 }
 
-int wwxd(std::string const& line) {
-	if (line.empty() || line[0] == '#')
+int wwxd(const char *begin, const char *end) {
+	if (begin == end || *begin == '#')
 		return -1;
-	std::istringstream ss(line);
 	int frame_no;
-	char frame_type;
-	ss >> frame_no >> frame_type;
-	if (ss.fail())
+	auto p = parse_int(begin, end, frame_no);
+	if (p)
+		while (p != end && is_space(*p)) ++p;
+	if (!p || p == end)
 		throw agi::keyframe::KeyframeFormatParseError("WWXD keyframe file not in qpfile format");
-	if (frame_type == 'I')
+	if (*p == 'I')
 		return frame_no;
 	return -1;
 }
@@ -105,19 +220,19 @@ void Save(agi::fs::path const& filename, std::vector<int> const& keyframes) {
 }
 
 std::vector<int> Load(agi::fs::path const& filename) {
-	auto file = io::Open(filename);
-	std::istream &is(*file);
-
-	std::string header;
-	getline(is, header);
-
-	if (header == "# keyframe format v1") return agi_keyframes(is);
-	if (boost::starts_with(header, "# XviD 2pass stat file")) return enumerated_keyframes(is, xvid);
-	if (boost::starts_with(header, "# ffmpeg 2-pass log file, using xvid codec")) return enumerated_keyframes(is, xvid);
-	if (boost::starts_with(header, "# avconv 2-pass log file, using xvid codec")) return enumerated_keyframes(is, xvid);
-	if (boost::starts_with(header, "##map version")) return enumerated_keyframes(is, divx);
-	if (boost::starts_with(header, "#options:")) return enumerated_keyframes(is, x264);
-	if (boost::starts_with(header, "# WWXD log file, using qpfile format")) return indexed_keyframes(is, wwxd);
+	line_reader file(filename);
+
+	const char *begin = nullptr, *end = nullptr;
+	file.next(begin, end, false);
+	boost::iterator_range<const char *> header(begin, end);
+
+	if (boost::equals(header, "# keyframe format v1")) return agi_keyframes(file);
+	if (boost::starts_with(header, "# XviD 2pass stat file")) return enumerated_keyframes(file, xvid);
+	if (boost::starts_with(header, "# ffmpeg 2-pass log file, using xvid codec")) return enumerated_keyframes(file, xvid);
+	if (boost::starts_with(header, "# avconv 2-pass log file, using xvid codec")) return enumerated_keyframes(file, xvid);
+	if (boost::starts_with(header, "##map version")) return enumerated_keyframes(file, divx);
+	if (boost::starts_with(header, "#options:")) return enumerated_keyframes(file, x264);
+	if (boost::starts_with(header, "# WWXD log file, using qpfile format")) return indexed_keyframes(file, wwxd);
 
 	throw UnknownKeyframeFormatError("File header does not match any known formats");
 }
@@ -23,7 +23,10 @@
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/path.hpp>
 #include <boost/range/algorithm/remove_if.hpp>
+#include <atomic>
 #include <chrono>
+#include <cstddef>
+#include <string>
 
 namespace agi { namespace log {
 
@@ -34,26 +37,150 @@ LogSink *log;
 /// Keep this ordered the same as Severity
 const char *Severity_ID = "EAWID";
 
-LogSink::LogSink() : queue(dispatch::Create()) { }
+/// Bounded multi-producer queue of messages waiting to be delivered
+///
+/// Each slot's sequence number says whose turn it is: a producer may claim
+/// slot i % size when its sequence is i, and the consumer may read it once
+/// the producer has set it to i + 1.
+struct LogSink::Ring {
+	struct Slot {
+		std::atomic<size_t> sequence;
+		SinkMessage message;
+	};
+
+	static const size_t size = 1024;
+	Slot slots[size];
+	std::atomic<size_t> push_pos{0};
+	/// Only touched by the consumer, which is always the log queue
+	size_t pop_pos = 0;
+
+	/// Messages which didn't fit since the consumer last checked
+	std::atomic<size_t> dropped{0};
+	/// Has a drain been queued which hasn't yet emptied the ring?
+	std::atomic<bool> drain_queued{false};
+
+	Ring() {
+		for (size_t i = 0; i < size; ++i)
+			slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	bool Push(SinkMessage& sm) {
+		size_t pos = push_pos.load(std::memory_order_relaxed);
+		while (true) {
+			auto& slot = slots[pos % size];
+			const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+			const auto diff = static_cast<std::ptrdiff_t>(sequence - pos);
+			if (diff == 0) {
+				if (push_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+					slot.message = std::move(sm);
+					slot.sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+				return false;
+			else
+				pos = push_pos.load(std::memory_order_relaxed);
+		}
+	}
+
+	bool Empty() const {
+		return slots[pop_pos % size].sequence.load(std::memory_order_acquire) != pop_pos + 1;
+	}
+
+	bool Pop(SinkMessage& out) {
+		if (Empty()) return false;
+		auto& slot = slots[pop_pos % size];
+		out = std::move(slot.message);
+		slot.sequence.store(pop_pos + size, std::memory_order_release);
+		++pop_pos;
+		return true;
+	}
+};
+
+namespace {
+/// Messages from one source line allowed in each rate_window
+const int rate_limit = 20;
+const int64_t rate_window = 1000000000;
+}
+
+LogSink::LogSink() : ring(new Ring), queue(dispatch::Create()) { }
 
 LogSink::~LogSink() {
 	// The destructor for emitters may try to log messages, so disable all the
 	// emitters before destructing any
 	decltype(emitters) emitters_temp;
-	queue->Sync([&]{ swap(emitters_temp, emitters); });
+	queue->Sync([&]{
+		Drain();
+		swap(emitters_temp, emitters);
+	});
 }
 
-void LogSink::Log(SinkMessage const& sm) {
-	queue->Async([=] {
-		if (messages.size() < 250)
-			messages.push_back(sm);
-		else {
-			messages[next_idx] = sm;
-			if (++next_idx == 250)
-				next_idx = 0;
+void LogSink::Log(SinkMessage sm) {
+	if (!ring->Push(sm))
+		++ring->dropped;
+	// Pairs with the fence in Drain() so that either the drain sees this
+	// message or this sees that another drain is needed
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (!ring->drain_queued.exchange(true))
+		queue->Async([=] { Drain(); });
+}
+
+void LogSink::Drain() {
+	SinkMessage sm;
+	while (true) {
+		while (ring->Pop(sm))
+			Deliver(sm);
+
+		if (size_t dropped = ring->dropped.exchange(0)) {
+			sm = SinkMessage{};
+			sm.message = std::to_string(dropped) + " log messages were dropped because too many were logged at once";
+			sm.time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+			sm.section = "agi/log";
+			sm.file = __FILE__;
+			sm.func = __FUNCTION__;
+			sm.severity = Warning;
+			sm.line = __LINE__;
+			Emit(sm);
 		}
-		for (auto& em : emitters) em->log(sm);
-	});
+
+		// Messages pushed after the ring was seen to be empty but before the
+		// flag was cleared wouldn't have queued another drain
+		ring->drain_queued = false;
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (ring->Empty() || ring->drain_queued.exchange(true))
+			return;
+	}
+}
+
+void LogSink::Deliver(SinkMessage& sm) {
+	if (sm.severity != Exception && sm.severity != Assert) {
+		auto& rate = rates[std::make_pair(sm.file, sm.line)];
+		if (sm.time - rate.window_start >= rate_window) {
+			if (rate.suppressed) {
+				SinkMessage summary = sm;
+				summary.message = std::to_string(rate.suppressed) + " similar messages were suppressed";
+				Emit(summary);
+			}
+			rate = SourceRate{sm.time, 0, 0};
+		}
+		if (++rate.count > rate_limit) {
+			++rate.suppressed;
+			return;
+		}
+	}
+	Emit(sm);
+}
+
+void LogSink::Emit(SinkMessage const& sm) {
+	if (messages.size() < 250)
+		messages.push_back(sm);
+	else {
+		messages[next_idx] = sm;
+		if (++next_idx == 250)
+			next_idx = 0;
+	}
+	for (auto& em : emitters) em->log(sm);
 }
 
 void LogSink::Subscribe(std::unique_ptr<Emitter> em) {
@@ -95,7 +222,7 @@ Message::Message(const char *section, Severity severity, const char *file, const
 
 Message::~Message() {
 	sm.message = std::string(buffer, (std::string::size_type)msg.tellp());
-	agi::log::log->Log(sm);
+	agi::log::log->Log(std::move(sm));
 }
 
 JsonEmitter::JsonEmitter(fs::path const& directory)
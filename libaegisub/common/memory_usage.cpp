@@ -0,0 +1,181 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file memory_usage.cpp
+/// @brief Registry of the memory used by caches and other large subsystems
+/// @ingroup libaegisub
+
+#include "libaegisub/memory_usage.h"
+
+#include "libaegisub/log.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace {
+using agi::memory::Counter;
+using agi::memory::Trimmer;
+
+struct Registry {
+	std::mutex mutex;
+	std::vector<Counter *> counters;
+	/// Separate from mutex so that trimmers can update their counters, and
+	/// recursive so that they can unregister themselves or others
+	std::recursive_mutex trim_mutex;
+	std::vector<Trimmer *> trimmers;
+};
+
+Registry& registry() {
+	// Leaked so that counters in static objects can outlive it safely
+	static Registry *instance = new Registry;
+	return *instance;
+}
+
+std::atomic<size_t> budget{0};
+}
+
+namespace agi { namespace memory {
+
+Counter::Counter(std::string name, size_t limit)
+: name(std::move(name))
+, limit(limit)
+{
+	auto& reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	reg.counters.push_back(this);
+}
+
+Counter::~Counter() {
+	auto& reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	reg.counters.erase(std::remove(reg.counters.begin(), reg.counters.end(), this), reg.counters.end());
+}
+
+Trimmer::Trimmer(int priority, std::function<void (Pressure)> trim)
+: priority(priority)
+, trim(std::move(trim))
+{
+	auto& reg = registry();
+	std::lock_guard<std::recursive_mutex> lock(reg.trim_mutex);
+	reg.trimmers.push_back(this);
+}
+
+Trimmer::~Trimmer() {
+	auto& reg = registry();
+	std::lock_guard<std::recursive_mutex> lock(reg.trim_mutex);
+	reg.trimmers.erase(std::remove(reg.trimmers.begin(), reg.trimmers.end(), this), reg.trimmers.end());
+}
+
+size_t Trim(Pressure pressure) {
+	if (pressure == Pressure::None) return 0;
+
+	auto& reg = registry();
+	std::lock_guard<std::recursive_mutex> lock(reg.trim_mutex);
+	auto order = reg.trimmers;
+	std::stable_sort(order.begin(), order.end(), [](Trimmer *a, Trimmer *b) {
+		return a->GetPriority() < b->GetPriority();
+	});
+
+	const size_t start = TotalBytes();
+	const size_t target = budget ? size_t(budget) / 2 : start / 2;
+	size_t called = 0;
+	for (auto trimmer : order) {
+		if (pressure == Pressure::Moderate && called && TotalBytes() <= target)
+			break;
+		// Skip any which an earlier one destroyed
+		if (std::find(reg.trimmers.begin(), reg.trimmers.end(), trimmer) == reg.trimmers.end())
+			continue;
+		(*trimmer)(pressure);
+		++called;
+	}
+
+	LOG_I("memory") << "Trimmed " << called << " caches under " << (pressure == Pressure::Critical ? "critical" : "moderate")
+		<< " memory pressure: " << (start >> 10) << " KB to " << (TotalBytes() >> 10) << " KB";
+	return called;
+}
+
+std::vector<Usage> Snapshot() {
+	std::vector<Usage> ret;
+	std::vector<bool> unlimited;
+	{
+		auto& reg = registry();
+		std::lock_guard<std::mutex> lock(reg.mutex);
+		for (auto counter : reg.counters) {
+			auto it = std::lower_bound(ret.begin(), ret.end(), counter->GetName(),
+				[](Usage const& u, std::string const& name) { return u.name < name; });
+			if (it == ret.end() || it->name != counter->GetName()) {
+				unlimited.insert(unlimited.begin() + (it - ret.begin()), false);
+				it = ret.insert(it, Usage{counter->GetName()});
+			}
+
+			++it->instances;
+			it->bytes += counter->GetBytes();
+			const size_t limit = counter->GetLimit();
+			it->limit += limit;
+			if (!limit)
+				unlimited[it - ret.begin()] = true;
+		}
+	}
+
+	for (size_t i = 0; i < ret.size(); ++i) {
+		if (unlimited[i])
+			ret[i].limit = 0;
+	}
+	return ret;
+}
+
+size_t TotalBytes() {
+	auto& reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	size_t total = 0;
+	for (auto counter : reg.counters)
+		total += counter->GetBytes();
+	return total;
+}
+
+void SetBudget(size_t bytes) {
+	budget = bytes;
+}
+
+size_t GetBudget() {
+	return budget;
+}
+
+bool OverBudget() {
+	const size_t limit = budget;
+	return limit && TotalBytes() > limit;
+}
+
+void LogUsage() {
+	auto kb = [](size_t bytes) { return std::to_string(bytes >> 10) + " KB"; };
+
+	size_t total = 0;
+	for (auto const& usage : Snapshot()) {
+		total += usage.bytes;
+		std::string line = usage.name + ": " + kb(usage.bytes);
+		if (usage.instances > 1)
+			line += " in " + std::to_string(usage.instances) + " instances";
+		if (usage.limit)
+			line += " of " + kb(usage.limit);
+		LOG_I("memory") << line;
+	}
+
+	std::string line = "Total: " + kb(total);
+	if (const size_t limit = budget)
+		line += " of a " + kb(limit) + " budget";
+	LOG_I("memory") << line;
+}
+
+} }
@@ -14,9 +14,6 @@
 
 #include "libaegisub/mru.h"
 
-#include "libaegisub/cajun/writer.h"
-
-#include "libaegisub/io.h"
 #include "libaegisub/json.h"
 #include "libaegisub/log.h"
 #include "libaegisub/option.h"
@@ -63,6 +60,7 @@ namespace agi {
 MRUManager::MRUManager(agi::fs::path const& config, std::pair<const char *, size_t> default_config, agi::Options *options)
 : config_name(config)
 , options(options)
+, saver(config)
 {
 	LOG_D("agi/mru") << "Loading MRU List";
 
@@ -90,13 +88,16 @@ void MRUManager::Add(const char *key, agi::fs::path const& entry) {
 		Prune(key, map);
 	}
 
-	Flush();
+	saver.Queue(Serialize());
 }
 
 void MRUManager::Remove(const char *key, agi::fs::path const& entry) {
 	auto& map = Find(key);
-	map.erase(remove(begin(map), end(map), entry), end(map));
-	Flush();
+	auto it = remove(begin(map), end(map), entry);
+	if (it == end(map))
+		return;
+	map.erase(it, end(map));
+	saver.Queue(Serialize());
 }
 
 const MRUManager::MRUListMap* MRUManager::Get(const char *key) {
@@ -111,7 +112,7 @@ agi::fs::path const& MRUManager::GetEntry(const char *key, const size_t entry) {
 	return *next(map->begin(), entry);
 }
 
-void MRUManager::Flush() {
+json::Object MRUManager::Serialize() const {
 	json::Object out;
 
 	for (size_t i = 0; i < mru.size(); ++i) {
@@ -120,7 +121,11 @@ void MRUManager::Flush() {
 			array.push_back(p.string());
 	}
 
-	agi::JsonWriter::Write(out, io::Save(config_name).Get());
+	return out;
+}
+
+void MRUManager::Flush() {
+	saver.Write(Serialize());
 }
 
 void MRUManager::Prune(const char *key, MRUListMap& map) const {
@@ -23,6 +23,7 @@
 #include "libaegisub/cajun/elements.h"
 #include "libaegisub/cajun/visitor.h"
 
+#include "libaegisub/deferred_save.h"
 #include "libaegisub/exception.h"
 #include "libaegisub/fs.h"
 #include "libaegisub/io.h"
@@ -31,8 +32,8 @@
 #include "libaegisub/make_unique.h"
 
 #include <boost/algorithm/string/predicate.hpp>
-#include <boost/interprocess/streams/bufferstream.hpp>
 #include <cassert>
+#include <iterator>
 #include <memory>
 
 namespace {
@@ -187,12 +188,11 @@ Options::Options(agi::fs::path const& file, std::pair<const char *, size_t> defa
 , setting(setting)
 {
 	LOG_D("agi/options") << "New Options object";
-	boost::interprocess::ibufferstream stream(default_config.first, default_config.second);
-	LoadConfig(stream);
+	LoadConfig(default_config.first, default_config.second);
 }
 
 Options::~Options() {
-	if ((setting & FLUSH_SKIP) != FLUSH_SKIP)
+	if ((setting & FLUSH_SKIP) != FLUSH_SKIP && dirty)
 		Flush();
 }
 
@@ -203,13 +203,20 @@ void Options::ConfigUser() {
 	catch (fs::FileNotFound const&) {
 		return;
 	}
+	// Only values which were set after this point need to be written back
+	dirty = false;
 }
 
 void Options::LoadConfig(std::istream& stream, bool ignore_errors) {
+	std::string data{std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+	LoadConfig(data.data(), data.size(), ignore_errors);
+}
+
+void Options::LoadConfig(const char *data, size_t size, bool ignore_errors) {
 	json::UnknownElement config_root;
 
 	try {
-		json::Reader::Read(config_root, stream);
+		json::Reader::Read(config_root, data, size);
 	} catch (json::Reader::ParseException& e) {
 		LOG_E("option/load") << "json::ParseException: " << e.what() << ", Line/offset: " << e.m_locTokenBegin.m_nLine + 1 << '/' << e.m_locTokenBegin.m_nLineOffset + 1;
 		return;
@@ -228,6 +235,7 @@ void Options::LoadConfig(std::istream& stream, bool ignore_errors) {
 
 	if (values.empty()) {
 		values = std::move(new_values);
+		WatchValues();
 		return;
 	}
 
@@ -256,6 +264,15 @@ void Options::LoadConfig(std::istream& stream, bool ignore_errors) {
 			++dst_it;
 		}
 	}
+
+	WatchValues();
+}
+
+void Options::WatchValues() {
+	value_connections.clear();
+	value_connections.reserve(values.size());
+	for (auto& value : values)
+		value_connections.push_back(value->Subscribe([=](OptionValue const&) { dirty = true; }));
 }
 
 OptionValue *Options::Get(const char *name) {
@@ -272,10 +289,11 @@ bool Options::Remove(const char *name) {
 	if (index == end(values) || (*index)->GetName() != name)
 		return false;
 	values.erase(index);
+	dirty = true;
 	return true;
 }
 
-void Options::Flush() const {
+json::Object Options::Serialize() const {
 	json::Object obj_out;
 
 	for (auto const& ov : values) {
@@ -322,7 +340,24 @@ void Options::Flush() const {
 		}
 	}
 
-	agi::JsonWriter::Write(obj_out, io::Save(config_file).Get());
+	return obj_out;
+}
+
+void Options::Flush() const {
+	auto obj_out = Serialize();
+	if (saver)
+		saver->Write(obj_out);
+	else
+		agi::JsonWriter::Write(obj_out, io::Save(config_file).Get());
+	dirty = false;
+}
+
+void Options::FlushDeferred() {
+	if (!dirty) return;
+	if (!saver)
+		saver = agi::make_unique<io::DeferredSave>(config_file);
+	saver->Queue(Serialize());
+	dirty = false;
 }
 
 } // namespace agi
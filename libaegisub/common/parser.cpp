@@ -17,16 +17,13 @@
 #include "parser.h"
 
 #include "libaegisub/color.h"
-#include "libaegisub/ass/dialogue_parser.h"
 
 #include <boost/phoenix/core.hpp>
 #include <boost/phoenix/operator.hpp>
 #include <boost/phoenix/fusion.hpp>
-#include <boost/phoenix/statement.hpp>
 
 #include <boost/spirit/include/qi.hpp>
 #include <boost/fusion/include/adapt_struct.hpp>
-#include <boost/spirit/include/lex_lexertl.hpp>
 
 BOOST_FUSION_ADAPT_STRUCT(
 	agi::Color,
@@ -100,78 +97,6 @@ struct color_grammar : qi::grammar<Iterator, agi::Color()> {
 	}
 };
 
-template <typename Lexer>
-struct dialogue_tokens final : lex::lexer<Lexer> {
-	int paren_depth;
-
-	template<typename KT>
-	void init(KT &&kara_templater) {
-		using lex::_state;
-		using lex::char_;
-		using lex::string;
-		using namespace boost::phoenix;
-		using namespace agi::ass::DialogueTokenType;
-
-		this->self
-			= string("\\\\[nNh]", LINE_BREAK)
-			| char_('{', OVR_BEGIN)[ref(paren_depth) = 0, _state = "OVR"]
-			| kara_templater
-			| string(".", TEXT)
-			;
-
-		this->self("OVR")
-			= char_('{', ERROR)
-			| char_('}', OVR_END)[_state = "INITIAL"]
-			| char_('\\', TAG_START)[_state = "TAGSTART"]
-			| string("\\s+", WHITESPACE)
-			| kara_templater
-			| string(".", COMMENT)
-			;
-
-		this->self("ARG")
-			= char_('{', ERROR)
-			| char_('}', OVR_END)[_state = "INITIAL"]
-			| char_('(', OPEN_PAREN)[++ref(paren_depth)]
-			| char_(')', CLOSE_PAREN)[--ref(paren_depth), if_(ref(paren_depth) == 0)[_state = "OVR"]]
-			| char_('\\', TAG_START)[_state = "TAGSTART"]
-			| char_(',', ARG_SEP)
-			| string("\\s+", WHITESPACE)
-			| string(".", ARG)
-			| kara_templater
-			;
-
-		this->self("TAGSTART")
-			= string("\\s+", WHITESPACE)
-			| string("r|fn", TAG_NAME)[_state = "ARG"]
-			| char_('\\', TAG_START)
-			| char_('}', OVR_END)[_state = "INITIAL"]
-			| string("[a-z0-9]", TAG_NAME)[_state = "TAGNAME"]
-			| string(".", COMMENT)[_state = "OVR"]
-			| kara_templater
-			;
-
-		this->self("TAGNAME")
-			= string("[a-z]+", TAG_NAME)[_state = "ARG"]
-			| char_('(', OPEN_PAREN)[++ref(paren_depth), _state = "ARG"]
-			| char_(')', CLOSE_PAREN)[--ref(paren_depth), if_(ref(paren_depth) == 0)[_state = "OVR"]]
-			| char_('}', OVR_END)[_state = "INITIAL"]
-			| char_('\\', TAG_START)[_state = "TAGSTART"]
-			| string(".", ARG)[_state = "ARG"]
-			| kara_templater
-			;
-	}
-
-	dialogue_tokens(bool karaoke_templater) : paren_depth(0) {
-		using lex::string;
-		using namespace agi::ass::DialogueTokenType;
-
-		if (karaoke_templater)
-			init(string("![^!]*!", KARAOKE_TEMPLATE) | string("\\$[A-Za-z_]+", KARAOKE_VARIABLE));
-		else
-			init(lex::char_('\1'));
-	}
-};
-
 template<typename Parser, typename T>
 bool do_try_parse(std::string const& str, Parser parser, T *out) {
 	using namespace boost::spirit::qi;
@@ -198,31 +123,6 @@ namespace parser {
 	}
 }
 
-namespace ass {
-	std::vector<DialogueToken> TokenizeDialogueBody(std::string const& str, bool karaoke_templater) {
-		static const dialogue_tokens<lex::lexertl::actor_lexer<>> kt(true);
-		static const dialogue_tokens<lex::lexertl::actor_lexer<>> not_kt(false);
-		auto const& tokenizer = karaoke_templater ? kt : not_kt;
-
-		char const *first = str.c_str();
-		char const *last = first + str.size();
-		std::vector<DialogueToken> data;
-		auto it = tokenizer.begin(first, last), end = tokenizer.end();
-
-		for (; it != end && token_is_valid(*it); ++it) {
-			int id = it->id();
-			ptrdiff_t len = it->value().end() - it->value().begin();
-			assert(len > 0);
-			if (data.empty() || data.back().type != id)
-				data.push_back(DialogueToken{id, static_cast<size_t>(len)});
-			else
-				data.back().length += len;
-		}
-
-		return data;
-	}
-}
-
 namespace util {
 	// from util.h
 	bool try_parse(std::string const& str, double *out) {
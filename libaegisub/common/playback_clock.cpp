@@ -0,0 +1,45 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include "libaegisub/playback_clock.h"
+
+#include <cmath>
+
+namespace agi {
+PlaybackClock::PlaybackClock(int64_t start_ms, double speed, clock::time_point start_time)
+: start_time(start_time)
+, start_ms(start_ms)
+, speed(speed)
+{
+}
+
+int64_t PlaybackClock::MediaTime(clock::time_point t) const {
+	const double elapsed_ms = std::chrono::duration<double, std::milli>(t - start_time).count();
+	// Allow for rounding error so that WallTime() round trips
+	return start_ms + static_cast<int64_t>(std::floor(elapsed_ms * speed + 1e-6));
+}
+
+PlaybackClock::clock::time_point PlaybackClock::WallTime(int64_t media_ms) const {
+	const double elapsed_ms = (media_ms - start_ms) / speed;
+	// Round up so that the media time has been reached by the time returned
+	return start_time + std::chrono::ceil<clock::duration>(std::chrono::duration<double, std::milli>(elapsed_ms));
+}
+
+void PlaybackClock::SetSpeed(double new_speed, clock::time_point now) {
+	start_ms = MediaTime(now);
+	start_time = now;
+	speed = new_speed;
+}
+}
@@ -0,0 +1,91 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include "libaegisub/scene_change.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+/// Mean absolute difference between thumbnails, out of 255, above which a
+/// frame may be a scene change
+const int min_difference = 20;
+/// Fraction of the histogram which has to move between bins, in percent
+const int min_histogram_change = 30;
+}
+
+namespace agi {
+SceneChangeDetector::SceneChangeDetector(int min_scene_length)
+: min_scene_length(min_scene_length)
+{
+}
+
+void SceneChangeDetector::MakeThumbnail(const uint8_t *bgra, ptrdiff_t row_step, int width, int height) {
+	hist.fill(0);
+
+	for (int cy = 0; cy < ThumbSize; ++cy) {
+		const int y1 = cy * height / ThumbSize;
+		const int y2 = std::max(y1 + 1, (cy + 1) * height / ThumbSize);
+		for (int cx = 0; cx < ThumbSize; ++cx) {
+			const int x1 = cx * width / ThumbSize;
+			const int x2 = std::max(x1 + 1, (cx + 1) * width / ThumbSize);
+
+			// Every other pixel in each direction is plenty for an average
+			uint32_t sum = 0, count = 0;
+			for (int y = y1; y < y2; y += 2) {
+				const uint8_t *row = bgra + y * row_step;
+				for (int x = x1; x < x2; x += 2) {
+					const uint8_t *px = row + x * 4;
+					sum += (px[0] * 29 + px[1] * 150 + px[2] * 77) >> 8;
+					++count;
+				}
+			}
+
+			const uint8_t luma = static_cast<uint8_t>(sum / count);
+			thumb[cy * ThumbSize + cx] = luma;
+			++hist[luma * HistogramBins / 256];
+		}
+	}
+}
+
+bool SceneChangeDetector::AddFrame(const uint8_t *bgra, ptrdiff_t row_step, int width, int height) {
+	if (width <= 0 || height <= 0) return false;
+
+	MakeThumbnail(bgra, row_step, width, height);
+
+	bool change = !has_previous;
+	if (has_previous && ++frames_since_change >= min_scene_length) {
+		int difference = 0;
+		for (size_t i = 0; i < thumb.size(); ++i)
+			difference += std::abs(thumb[i] - prev_thumb[i]);
+
+		int moved = 0;
+		for (int i = 0; i < HistogramBins; ++i)
+			moved += std::abs(hist[i] - prev_hist[i]);
+
+		// Each cell which moves bins is counted once leaving and once arriving
+		const int cells = ThumbSize * ThumbSize;
+		change = difference >= min_difference * cells
+			&& moved * 100 >= min_histogram_change * cells * 2;
+	}
+
+	if (change)
+		frames_since_change = 0;
+	prev_thumb = thumb;
+	prev_hist = hist;
+	has_previous = true;
+	return change;
+}
+}
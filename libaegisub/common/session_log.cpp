@@ -0,0 +1,147 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+/// @file session_log.cpp
+/// @brief Serialization of recorded command sessions
+/// @ingroup libaegisub
+
+#include "libaegisub/session_log.h"
+
+#include "libaegisub/cajun/elements.h"
+#include "libaegisub/cajun/reader.h"
+#include "libaegisub/cajun/writer.h"
+#include "libaegisub/log.h"
+
+#include <sstream>
+
+namespace {
+/// Version written in the header line; logs with a newer version are rejected
+const int64_t session_log_version = 1;
+
+/// Selections are written as [first, last] row ranges, as they are usually
+/// a few contiguous blocks of lines
+json::Array write_ranges(std::vector<int> const& rows) {
+	json::Array ranges;
+	for (size_t i = 0; i < rows.size(); ) {
+		size_t end = i + 1;
+		while (end < rows.size() && rows[end] == rows[end - 1] + 1)
+			++end;
+		json::Array range;
+		range.emplace_back(rows[i]);
+		range.emplace_back(rows[end - 1]);
+		ranges.emplace_back(std::move(range));
+		i = end;
+	}
+	return ranges;
+}
+
+std::vector<int> read_ranges(json::Array const& ranges) {
+	std::vector<int> rows;
+	for (json::Array const& range : ranges) {
+		if (range.size() != 2) throw json::Exception("Bad selection range");
+		int first = static_cast<int>(static_cast<json::Integer const&>(range[0]));
+		int last = static_cast<int>(static_cast<json::Integer const&>(range[1]));
+		for (int row = first; row <= last; ++row)
+			rows.push_back(row);
+	}
+	return rows;
+}
+
+/// JsonWriter pretty-prints, but each entry has to fit on one line. Newlines
+/// and tabs inside strings are escaped, so any left in the output are just
+/// indentation and can be dropped.
+void write_line(std::ostream &out, json::Object const& obj) {
+	std::ostringstream stream;
+	agi::JsonWriter::Write(obj, stream);
+	for (char c : stream.str()) {
+		if (c != '\n' && c != '\t')
+			out << c;
+	}
+	out << '\n';
+	out.flush();
+}
+
+bool read_line(std::istream &in, json::Object &out) {
+	std::string line;
+	while (std::getline(in, line)) {
+		if (line.empty()) continue;
+		std::istringstream stream(line);
+		json::UnknownElement root;
+		json::Reader::Read(root, stream);
+		out = std::move(static_cast<json::Object&>(root));
+		return true;
+	}
+	return false;
+}
+}
+
+namespace agi {
+void WriteSessionHeader(std::ostream &out, SessionHeader const& header) {
+	json::Object obj;
+	obj["aegisub_session"] = session_log_version;
+	obj["subtitles"] = header.subtitles;
+	obj["video"] = header.video;
+	write_line(out, obj);
+}
+
+void WriteSessionEvent(std::ostream &out, SessionEvent const& event) {
+	json::Object obj;
+	obj["t"] = event.time;
+	obj["cmd"] = event.command;
+	obj["active"] = event.active_row;
+	obj["sel"] = write_ranges(event.selection);
+	obj["frame"] = event.video_frame;
+	write_line(out, obj);
+}
+
+SessionLog ReadSessionLog(std::istream &in) {
+	SessionLog log;
+
+	json::Object header;
+	try {
+		if (!read_line(in, header))
+			throw SessionLogError("Session recording is empty");
+		json::Integer version = header["aegisub_session"];
+		if (version < 1 || version > session_log_version)
+			throw SessionLogError("Unsupported session recording version");
+		log.header.subtitles = static_cast<json::String const&>(header["subtitles"]);
+		log.header.video = static_cast<json::String const&>(header["video"]);
+	}
+	catch (json::Exception const&) {
+		throw SessionLogError("Not a session recording");
+	}
+
+	size_t skipped = 0;
+	for (;;) {
+		json::Object obj;
+		try {
+			if (!read_line(in, obj)) break;
+			SessionEvent event;
+			event.time = obj["t"];
+			event.command = static_cast<json::String const&>(obj["cmd"]);
+			event.active_row = static_cast<int>(static_cast<json::Integer const&>(obj["active"]));
+			event.selection = read_ranges(obj["sel"]);
+			event.video_frame = static_cast<int>(static_cast<json::Integer const&>(obj["frame"]));
+			log.events.push_back(std::move(event));
+		}
+		catch (json::Exception const&) {
+			++skipped;
+		}
+	}
+
+	if (skipped)
+		LOG_W("session/read") << "Skipped " << skipped << " unreadable lines in session recording";
+	return log;
+}
+}
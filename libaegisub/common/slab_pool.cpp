@@ -0,0 +1,88 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include "libaegisub/slab_pool.h"
+
+#include <algorithm>
+
+namespace {
+/// Largest number of objects to allocate in a single slab
+const size_t max_slab_objects = 65536;
+}
+
+namespace agi {
+SlabPool::SlabPool(size_t object_size, size_t first_slab)
+: object_size(std::max(
+	(object_size + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t),
+	sizeof(FreeNode)))
+, next_slab_objects(std::max<size_t>(first_slab, 1))
+, first_slab_objects(next_slab_objects)
+{
+}
+
+void SlabPool::PushSlab(char *slab, size_t count) {
+	for (size_t i = count; i > 0; --i) {
+		auto node = reinterpret_cast<FreeNode *>(slab + (i - 1) * object_size);
+		node->next = free_list;
+		free_list = node;
+	}
+}
+
+void SlabPool::AddSlab() {
+	// operator new[] returns memory aligned for any fundamental type, and
+	// object_size is a multiple of that alignment
+	slabs.emplace_back(new char[object_size * next_slab_objects]);
+	PushSlab(slabs.back().get(), next_slab_objects);
+	next_slab_objects = std::min(next_slab_objects * 2, max_slab_objects);
+}
+
+void *SlabPool::Allocate() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!free_list)
+		AddSlab();
+	FreeNode *node = free_list;
+	free_list = node->next;
+	++live;
+	return node;
+}
+
+void SlabPool::Free(void *ptr) {
+	if (!ptr) return;
+	std::lock_guard<std::mutex> lock(mutex);
+	auto node = static_cast<FreeNode *>(ptr);
+	node->next = free_list;
+	free_list = node;
+
+	// Give the memory back once nothing is using it, so that closing a large
+	// file doesn't leave it all reserved, but keep the first slab around so
+	// that a pool with one object going in and out doesn't thrash
+	if (--live == 0 && slabs.size() > 1) {
+		slabs.resize(1);
+		free_list = nullptr;
+		PushSlab(slabs.front().get(), first_slab_objects);
+		next_slab_objects = std::min(first_slab_objects * 2, max_slab_objects);
+	}
+}
+
+size_t SlabPool::Live() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return live;
+}
+
+size_t SlabPool::SlabCount() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return slabs.size();
+}
+}
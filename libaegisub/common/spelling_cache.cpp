@@ -0,0 +1,56 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include "libaegisub/spelling_cache.h"
+
+namespace agi {
+bool SpellingCache::Check(std::string const& word, std::function<bool (std::string const&)> const& check) {
+	auto& shard = ShardFor(word);
+	{
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		auto it = shard.words.find(word);
+		if (it != shard.words.end())
+			return it->second;
+	}
+
+	const size_t checked_generation = generation;
+	const bool correct = check(word);
+
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	if (generation == checked_generation) {
+		if (shard.words.size() >= shard_capacity)
+			shard.words.clear();
+		shard.words.emplace(word, correct);
+	}
+	return correct;
+}
+
+void SpellingCache::Clear() {
+	++generation;
+	for (auto& shard : shards) {
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		shard.words.clear();
+	}
+}
+
+size_t SpellingCache::size() {
+	size_t count = 0;
+	for (auto& shard : shards) {
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		count += shard.words.size();
+	}
+	return count;
+}
+}
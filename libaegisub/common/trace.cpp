@@ -0,0 +1,196 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include "libaegisub/trace.h"
+
+#include "libaegisub/cajun/elements.h"
+#include "libaegisub/cajun/writer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+using namespace agi::trace;
+
+struct Event {
+	const char *category;
+	const char *name;
+	int64_t start; ///< Nanoseconds since the recording started
+	int64_t end;
+};
+
+/// Events are dropped once a thread has recorded this many in one recording
+const size_t events_per_thread = 1 << 15;
+
+/// Events recorded by a single thread
+///
+/// Only the owning thread writes events. Each event is written before
+/// `count` is incremented, so everything below `count` may be read by other
+/// threads at any time.
+struct ThreadBuffer {
+	std::unique_ptr<Event[]> events;
+	std::atomic<size_t> count{0};
+	/// Recording the events belong to; stale events are discarded lazily by
+	/// the owning thread
+	std::atomic<uint32_t> session{0};
+	std::atomic<size_t> dropped{0};
+	int tid;
+	std::string name;
+};
+
+std::mutex buffers_mutex;
+/// Buffers of all threads which have recorded anything, kept alive after the
+/// thread exits so that its events can still be written
+std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+int next_tid = 1;
+
+std::atomic<uint32_t> session{0};
+std::atomic<int64_t> session_start{0};
+
+thread_local std::shared_ptr<ThreadBuffer> local_buffer;
+
+ThreadBuffer &get_local_buffer() {
+	if (!local_buffer) {
+		auto buffer = std::make_shared<ThreadBuffer>();
+		std::lock_guard<std::mutex> lock(buffers_mutex);
+		buffer->tid = next_tid++;
+		buffers.push_back(buffer);
+		local_buffer = std::move(buffer);
+	}
+	return *local_buffer;
+}
+}
+
+namespace agi { namespace trace {
+namespace detail {
+std::atomic<bool> recording{false};
+
+int64_t Now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Record(const char *category, const char *name, int64_t start, int64_t end) {
+	auto &buffer = get_local_buffer();
+	const uint32_t current = ::session.load(std::memory_order_acquire);
+	if (buffer.session.load(std::memory_order_relaxed) != current) {
+		buffer.count.store(0, std::memory_order_relaxed);
+		buffer.dropped.store(0, std::memory_order_relaxed);
+		buffer.session.store(current, std::memory_order_release);
+	}
+
+	// Zones which began before the recording started are clipped to it
+	const int64_t origin = session_start.load(std::memory_order_relaxed);
+	if (end < origin) return;
+
+	const size_t index = buffer.count.load(std::memory_order_relaxed);
+	if (index >= events_per_thread) {
+		buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	if (!buffer.events)
+		buffer.events.reset(new Event[events_per_thread]);
+
+	buffer.events[index] = Event{category, name, std::max(start, origin) - origin, end - origin};
+	buffer.count.store(index + 1, std::memory_order_release);
+}
+}
+
+bool IsAvailable() {
+#ifdef AGI_NO_TRACE
+	return false;
+#else
+	return true;
+#endif
+}
+
+void Start() {
+	std::lock_guard<std::mutex> lock(buffers_mutex);
+
+	// Forget threads which have exited since the last recording
+	buffers.erase(remove_if(begin(buffers), end(buffers), [](std::shared_ptr<ThreadBuffer> const& buffer) {
+		return buffer.use_count() == 1;
+	}), end(buffers));
+
+	session_start = detail::Now();
+	++session;
+	detail::recording = true;
+}
+
+void Stop() {
+	detail::recording = false;
+}
+
+void SetThreadName(const char *name) {
+	auto &buffer = get_local_buffer();
+	std::lock_guard<std::mutex> lock(buffers_mutex);
+	buffer.name = name;
+}
+
+size_t Write(std::ostream &out) {
+	std::lock_guard<std::mutex> lock(buffers_mutex);
+	const uint32_t current = session.load();
+
+	size_t written = 0;
+	size_t dropped = 0;
+	json::Array events;
+	for (auto const& buffer : buffers) {
+		if (buffer->session.load(std::memory_order_acquire) != current) continue;
+
+		if (!buffer->name.empty()) {
+			json::Object args;
+			args["name"] = buffer->name;
+			json::Object meta;
+			meta["ph"] = std::string("M");
+			meta["name"] = std::string("thread_name");
+			meta["pid"] = static_cast<json::Integer>(1);
+			meta["tid"] = static_cast<json::Integer>(buffer->tid);
+			meta["args"] = std::move(args);
+			events.push_back(std::move(meta));
+		}
+
+		const size_t count = buffer->count.load(std::memory_order_acquire);
+		for (size_t i = 0; i < count; ++i) {
+			auto const& event = buffer->events[i];
+			json::Object obj;
+			obj["ph"] = std::string("X");
+			obj["cat"] = std::string(event.category);
+			obj["name"] = std::string(event.name);
+			obj["pid"] = static_cast<json::Integer>(1);
+			obj["tid"] = static_cast<json::Integer>(buffer->tid);
+			// The trace format's timestamps are in microseconds
+			obj["ts"] = event.start / 1000.0;
+			obj["dur"] = (event.end - event.start) / 1000.0;
+			events.push_back(std::move(obj));
+		}
+		written += count;
+		dropped += buffer->dropped.load(std::memory_order_relaxed);
+	}
+
+	json::Object root;
+	root["traceEvents"] = std::move(events);
+	root["displayTimeUnit"] = std::string("ms");
+	if (dropped) {
+		json::Object metadata;
+		metadata["dropped-events"] = static_cast<json::Integer>(dropped);
+		root["metadata"] = std::move(metadata);
+	}
+	JsonWriter::Write(root, out);
+	return written;
+}
+} }
@@ -52,6 +52,22 @@ std::pair<size_t, size_t> find_range(std::string const& haystack, std::string co
 	return {match_start, match_start + needle.size()};
 }
 
+bool is_ascii(std::string const& str) {
+	for (unsigned char c : str) {
+		if (c >= 0x80)
+			return false;
+	}
+	return true;
+}
+
+std::string ascii_lower(std::string str) {
+	for (char& c : str) {
+		if (c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+	}
+	return str;
+}
+
 void parse_blocks(std::vector<std::pair<size_t, size_t>>& blocks, std::string const& str) {
 	blocks.clear();
 
@@ -84,6 +100,11 @@ std::string strftime(const char *fmt, const tm *tmptr) {
 }
 
 std::pair<size_t, size_t> ifind(std::string const& haystack, std::string const& needle) {
+	// Case folding ASCII text only lowercases the letters, which doesn't need
+	// ICU and can't move any indices
+	if (is_ascii(haystack) && is_ascii(needle))
+		return find_range(ascii_lower(haystack), ascii_lower(needle));
+
 	const auto folded_hs = boost::locale::fold_case(haystack);
 	const auto folded_n = boost::locale::fold_case(needle);
 	auto match = find_range(folded_hs, folded_n);
@@ -24,9 +24,7 @@
 
 #include <algorithm>
 #include <boost/interprocess/streams/bufferstream.hpp>
-#include <boost/range/algorithm.hpp>
 #include <cmath>
-#include <functional>
 #include <iterator>
 
 namespace {
@@ -124,13 +122,116 @@ int64_t v1_parse(line_iterator<std::string> file, std::string line, std::vector<
 }
 
 namespace agi { namespace vfr {
+/// @class Framerate::Timecodes
+/// @brief Frame start times packed into blocks of 64 frames
+///
+/// Each block stores its first frame's time, and then the rest of the frames
+/// as whichever of these fits: a constant frame duration, which covers CFR
+/// stretches of VFR files at whole-millisecond rates and needs nothing per
+/// frame; 16-bit offsets from the first frame, which covers almost everything
+/// else; or full times, for blocks spanning more than a minute.
+class Framerate::Timecodes {
+	static constexpr size_t BlockBits = 6;
+	static constexpr size_t BlockSize = size_t(1) << BlockBits;
+	/// Block::step values for blocks which don't have a constant duration
+	static constexpr int Packed = -1;
+	static constexpr int Full = -2;
+
+	struct Block {
+		/// Time of the first frame in the block
+		int base;
+		/// Duration of every frame in the block, or Packed or Full
+		int step;
+		/// Index of the block's first frame in packed or full
+		uint32_t data;
+	};
+
+	std::vector<Block> blocks;
+	std::vector<uint16_t> packed;
+	std::vector<int> full;
+	size_t count;
+
+public:
+	/// @param times Frame times, which must be sorted
+	Timecodes(std::vector<int> const& times)
+	: count(times.size())
+	{
+		blocks.reserve((count + BlockSize - 1) / BlockSize);
+		for (size_t first = 0; first < count; first += BlockSize) {
+			const size_t last = std::min(count, first + BlockSize) - 1;
+			Block block{times[first], last > first ? times[first + 1] - times[first] : 0, 0};
+
+			for (size_t i = first + 1; i <= last && block.step >= 0; ++i) {
+				if (times[i] - times[i - 1] != block.step)
+					block.step = Packed;
+			}
+
+			if (block.step == Packed && times[last] - times[first] > UINT16_MAX)
+				block.step = Full;
+			if (block.step == Packed) {
+				block.data = static_cast<uint32_t>(packed.size());
+				for (size_t i = first; i <= last; ++i)
+					packed.push_back(static_cast<uint16_t>(times[i] - block.base));
+			}
+			else if (block.step == Full) {
+				block.data = static_cast<uint32_t>(full.size());
+				full.insert(full.end(), times.begin() + first, times.begin() + last + 1);
+			}
+			blocks.push_back(block);
+		}
+		packed.shrink_to_fit();
+		full.shrink_to_fit();
+	}
+
+	size_t size() const { return count; }
+	int front() const { return blocks.front().base; }
+	int back() const { return (*this)[count - 1]; }
+
+	int operator[](size_t i) const {
+		auto const& block = blocks[i >> BlockBits];
+		const size_t offset = i & (BlockSize - 1);
+		if (block.step >= 0)
+			return block.base + block.step * static_cast<int>(offset);
+		if (block.step == Packed)
+			return block.base + packed[block.data + offset];
+		return full[block.data + offset];
+	}
+
+	/// Get the index of the first frame in [lo, hi) which starts after ms, or
+	/// hi if there are none
+	size_t UpperBound(int ms, size_t lo, size_t hi) const {
+		if (lo >= hi) return lo;
+
+		// Narrow it down to one block using the block start times first, as
+		// they're next to each other in memory
+		const size_t first_block = lo >> BlockBits;
+		const size_t last_block = (hi - 1) >> BlockBits;
+		if (first_block != last_block) {
+			auto it = std::upper_bound(blocks.begin() + first_block + 1, blocks.begin() + last_block + 1, ms,
+				[](int ms, Block const& block) { return ms < block.base; });
+			const size_t block = it - blocks.begin() - 1;
+			lo = std::max(lo, block << BlockBits);
+			hi = std::min(hi, (block + 1) << BlockBits);
+		}
+
+		while (lo < hi) {
+			const size_t mid = lo + (hi - lo) / 2;
+			if ((*this)[mid] <= ms)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo;
+	}
+};
+
 Framerate::Framerate(double fps)
 : denominator(default_denominator)
 , numerator(int64_t(fps * denominator))
 {
 	if (fps < 0.) throw InvalidFramerate("FPS must be greater than zero");
 	if (fps > 1000.) throw InvalidFramerate("FPS must not be greater than 1000");
-	timecodes.push_back(0);
+	timecodes = std::make_shared<Timecodes>(std::vector<int>{0});
 }
 
 Framerate::Framerate(int64_t numerator, int64_t denominator, bool drop)
@@ -141,26 +242,27 @@ Framerate::Framerate(int64_t numerator, int64_t denominator, bool drop)
 	if (numerator <= 0 || denominator <= 0)
 		throw InvalidFramerate("Numerator and denominator must both be greater than zero");
 	if (numerator / denominator > 1000) throw InvalidFramerate("FPS must not be greater than 1000");
-	timecodes.push_back(0);
+	timecodes = std::make_shared<Timecodes>(std::vector<int>{0});
 }
 
-void Framerate::SetFromTimecodes() {
-	validate_timecodes(timecodes);
+void Framerate::SetFromTimecodes(std::vector<int> const& times) {
+	validate_timecodes(times);
 	denominator = default_denominator;
-	numerator = (timecodes.size() - 1) * denominator * 1000 / (timecodes.back() - timecodes.front());
-	last = (timecodes.size() - 1) * denominator * 1000;
+	numerator = (times.size() - 1) * denominator * 1000 / (times.back() - times.front());
+	last = (times.size() - 1) * denominator * 1000;
+	timecodes = std::make_shared<Timecodes>(times);
 }
 
-Framerate::Framerate(std::vector<int> timecodes)
-: timecodes(std::move(timecodes))
-{
-	SetFromTimecodes();
+Framerate::Framerate(std::vector<int> timecodes) {
+	SetFromTimecodes(timecodes);
 }
 
-Framerate::Framerate(std::initializer_list<int> timecodes)
-: timecodes(timecodes)
-{
-	SetFromTimecodes();
+Framerate::Framerate(std::initializer_list<int> timecodes) {
+	SetFromTimecodes(timecodes);
+}
+
+bool Framerate::IsVFR() const {
+	return timecodes->size() > 1;
 }
 
 Framerate::Framerate(fs::path const& filename)
@@ -169,15 +271,17 @@ Framerate::Framerate(fs::path const& filename)
 	auto file = agi::io::Open(filename);
 	auto encoding = agi::charset::Detect(filename);
 	auto line = *line_iterator<std::string>(*file, encoding);
+	std::vector<int> times;
 	if (line == "# timecode format v2") {
-		copy(line_iterator<int>(*file, encoding), line_iterator<int>(), back_inserter(timecodes));
-		SetFromTimecodes();
+		copy(line_iterator<int>(*file, encoding), line_iterator<int>(), back_inserter(times));
+		SetFromTimecodes(times);
 		return;
 	}
 	if (line == "# timecode format v1" || line.substr(0, 7) == "Assume ") {
 		if (line[0] == '#')
 			line = *line_iterator<std::string>(*file, encoding);
-		numerator = v1_parse(line_iterator<std::string>(*file, encoding), line, timecodes, last);
+		numerator = v1_parse(line_iterator<std::string>(*file, encoding), line, times, last);
+		timecodes = std::make_shared<Timecodes>(times);
 		return;
 	}
 
@@ -189,8 +293,9 @@ void Framerate::Save(fs::path const& filename, int length) const {
 	auto &out = file.Get();
 
 	out << "# timecode format v2\n";
-	boost::copy(timecodes, std::ostream_iterator<int>(out, "\n"));
-	for (int written = (int)timecodes.size(); written < length; ++written)
+	for (size_t i = 0; i < timecodes->size(); ++i)
+		out << (*timecodes)[i] << '\n';
+	for (int written = (int)timecodes->size(); written < length; ++written)
 		out << TimeAtFrame(written) << std::endl;
 }
 
@@ -213,13 +318,59 @@ int Framerate::FrameAtTime(int ms, Time type) const {
 	if (type == END)
 		return FrameAtTime(ms - 1);
 
-	if (ms < timecodes.front())
-		return int(((ms - timecodes.front()) * numerator / denominator - 999) / 1000);
+	if (ms < timecodes->front())
+		return int(((ms - timecodes->front()) * numerator / denominator - 999) / 1000);
 
-	if (ms > timecodes.back())
-		return int((ms * numerator - numerator / 2 - last + numerator - 1) / denominator / 1000) + (int)timecodes.size() - 1;
+	if (ms > timecodes->back())
+		return int((ms * numerator - numerator / 2 - last + numerator - 1) / denominator / 1000) + (int)timecodes->size() - 1;
+
+	// The last frame which starts at or before ms
+	return (int)timecodes->UpperBound(ms, 0, timecodes->size()) - 1;
+}
+
+int Framerate::FrameAtTime(int ms, Time type, size_t& hint) const {
+	if (type == START)
+		return FrameAtTime(ms - 1, EXACT, hint) + 1;
+	if (type == END)
+		return FrameAtTime(ms - 1, EXACT, hint);
+
+	auto const& times = *timecodes;
+	if (ms < times.front() || ms > times.back())
+		return FrameAtTime(ms);
+
+	// Bracket the last frame starting at or before ms by galloping away from
+	// the hint, so that nearby times only need a few comparisons. Afterwards
+	// times[lo] <= ms and hi is either the end or times[hi] > ms.
+	const size_t size = times.size();
+	size_t lo = std::min(hint, size - 1);
+	size_t hi;
+	if (times[lo] <= ms) {
+		hi = lo + 1;
+		for (size_t step = 1; hi < size && times[hi] <= ms; step *= 2) {
+			lo = hi;
+			hi = std::min(size, lo + step);
+		}
+	}
+	else {
+		// times.front() <= ms, so this stops by the first frame
+		hi = lo;
+		for (size_t step = 1; times[lo] > ms; step *= 2) {
+			hi = lo;
+			lo = lo > step ? lo - step : 0;
+		}
+	}
+
+	hint = times.UpperBound(ms, lo, hi) - 1;
+	return (int)hint;
+}
 
-	return (int)distance(lower_bound(timecodes.rbegin(), timecodes.rend(), ms, std::greater<int>()), timecodes.rend()) - 1;
+std::vector<int> Framerate::FramesAtTimes(std::vector<int> const& times, Time type) const {
+	std::vector<int> frames;
+	frames.reserve(times.size());
+	size_t hint = 0;
+	for (int ms : times)
+		frames.push_back(FrameAtTime(ms, type, hint));
+	return frames;
 }
 
 int Framerate::TimeAtFrame(int frame, Time type) const {
@@ -237,14 +388,14 @@ int Framerate::TimeAtFrame(int frame, Time type) const {
 	}
 
 	if (frame < 0)
-		return (int)(frame * denominator * 1000 / numerator) + timecodes.front();
+		return (int)(frame * denominator * 1000 / numerator) + timecodes->front();
 
-	if (frame >= (signed)timecodes.size()) {
-		int64_t frames_past_end = frame - (int)timecodes.size() + 1;
+	if (frame >= (signed)timecodes->size()) {
+		int64_t frames_past_end = frame - (int)timecodes->size() + 1;
 		return int((frames_past_end * 1000 * denominator + last + numerator / 2) / numerator);
 	}
 
-	return timecodes[frame];
+	return (*timecodes)[frame];
 }
 
 void Framerate::SmpteAtFrame(int frame, int *h, int *m, int *s, int *f) const {
@@ -0,0 +1,73 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+/// @file alpha_blend.h
+/// @brief Blending of rendered subtitle images onto BGRA buffers
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace agi {
+/// @brief Blend a solid color through a coverage mask onto BGRA pixels
+/// @param dst        First destination pixel
+/// @param dst_pitch  Bytes between destination rows; may be negative
+/// @param mask       First mask byte
+/// @param mask_pitch Bytes between mask rows
+/// @param color      RRGGBBAA, with AA being transparency as in libass
+/// @param with_alpha Composite into the destination's alpha channel, as for
+///                   premultiplied overlays, rather than zeroing it as for
+///                   video frames
+///
+/// Each pixel becomes (k * color + (255 - k) * dst) / 255, where k is the
+/// mask value scaled by the color's opacity, rounded down at each step.
+void BlendMask(uint8_t *dst, ptrdiff_t dst_pitch, const uint8_t *mask, ptrdiff_t mask_pitch,
+               int width, int height, uint32_t color, bool with_alpha);
+
+/// @brief Blend premultiplied pixels over BGRA pixels
+/// @param src_rgba   Source is in RGBA byte order rather than BGRA
+/// @param with_alpha Composite into the destination's alpha channel rather
+///                   than zeroing it
+///
+/// Each channel becomes src + dst * (255 - src alpha) / 255, rounded down and
+/// wrapped to eight bits for sources which aren't properly premultiplied.
+void BlendPremultiplied(uint8_t *dst, ptrdiff_t dst_pitch, const uint8_t *src, ptrdiff_t src_pitch,
+                        int width, int height, bool src_rgba, bool with_alpha);
+
+/// A rendered subtitle image to be blended with BlendImages()
+struct BlendImage {
+	enum Type { Mask, PremultipliedRGBA };
+	Type type;
+	const uint8_t *data;
+	ptrdiff_t stride;
+	int x, y, width, height;
+	/// Color of Mask images, in the format BlendMask() takes
+	uint32_t color;
+};
+
+/// @brief Blend a list of images onto BGRA pixels in order
+/// @param dst        Top-left destination pixel
+/// @param dst_pitch  Bytes between destination rows; may be negative
+/// @param height     Number of rows in the destination
+/// @param images     Images to blend, bottom-most first
+/// @param with_alpha As for BlendMask()
+///
+/// Large batches are split into horizontal tiles which are blended in
+/// parallel on the background dispatch queue. Each tile blends every image
+/// which overlaps it in list order, so the result is identical to blending
+/// the images one after another.
+void BlendImages(uint8_t *dst, ptrdiff_t dst_pitch, int height, std::vector<BlendImage> const& images, bool with_alpha);
+}
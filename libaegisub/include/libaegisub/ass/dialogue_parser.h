@@ -15,6 +15,7 @@
 // Aegisub Project http://www.aegisub.org/
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #undef ERROR
@@ -77,6 +78,29 @@ namespace agi {
 			size_t length;
 		};
 
+		/// @class WordSplitCache
+		/// @brief The words found in each run of text when splitting a line
+		///
+		/// Splitting text into words is by far the slowest part of tokenizing a
+		/// line, so when successive versions of a line are split with the same
+		/// cache only the runs of text which were edited have to be split again.
+		/// Runs which were not seen while splitting the most recent version are
+		/// forgotten.
+		class WordSplitCache {
+			using Tokens = std::vector<DialogueToken>;
+			std::unordered_map<std::string, Tokens> current, previous;
+
+		public:
+			/// Start splitting a new version of the line
+			void NextLine();
+
+			/// Get the tokens a run of text was split into, if known
+			Tokens const *Find(std::string const& text);
+
+			/// Remember the tokens a run of text was split into
+			void Add(std::string text, Tokens tokens);
+		};
+
 		/// Tokenize the passed string as the body of a dialogue line
 		std::vector<DialogueToken> TokenizeDialogueBody(std::string const& str, bool karaoke_templater=false);
 
@@ -85,7 +109,8 @@ namespace agi {
 
 		/// Split the words in the TEXT tokens of the lexed line into their
 		/// own tokens and convert the body of drawings to DRAWING tokens
-		void SplitWords(std::string const& str, std::vector<DialogueToken> &tokens);
+		/// @param cache If not null, the word splits to reuse and update
+		void SplitWords(std::string const& str, std::vector<DialogueToken> &tokens, WordSplitCache *cache = nullptr);
 
 		std::vector<DialogueToken> SyntaxHighlight(std::string const& text, std::vector<DialogueToken> const& tokens, SpellChecker *spellchecker);
 	}
@@ -23,4 +23,8 @@ std::string UUEncode(const char *begin, const char *end, bool insert_linebreaks=
 
 /// Decode an ASS uuencoded string
 std::vector<char> UUDecode(const char *begin, const char *end);
+
+/// Decode an ASS uuencoded string into an existing buffer, replacing its
+/// contents, so that the buffer's allocation can be reused
+void UUDecode(const char *begin, const char *end, std::vector<char>& out);
 } }
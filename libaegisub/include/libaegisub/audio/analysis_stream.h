@@ -0,0 +1,78 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+/// @file analysis_stream.h
+/// @brief Downsampled mono copy of an audio stream for display
+
+#pragma once
+
+#include <libaegisub/memory_usage.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace agi {
+class AudioProvider;
+
+/// @class AudioAnalysisStream
+/// @brief Low-pass filtered, decimated int16 mono view of a provider
+///
+/// The audio renderers rarely need the source's full rate and channel
+/// count, so this gives them a stream at the lowest integer fraction of the
+/// source's rate which is still at least the rate asked for. With caching
+/// enabled, chunks whose source audio has been fully decoded are kept, so
+/// repeated renders only touch the much smaller downsampled data.
+///
+/// Not thread-safe; each renderer owns its own stream.
+class AudioAnalysisStream {
+	AudioProvider const& source;
+	const int factor;
+	const int64_t num_samples;
+	/// Filter taps on each side of the centre one
+	const int half_taps;
+	std::vector<float> taps;
+
+	const bool cache;
+	std::vector<std::unique_ptr<int16_t[]>> chunks;
+	agi::memory::Counter memory{"Audio analysis stream"};
+
+	/// Scratch buffer for reading from the source
+	std::vector<int16_t> input;
+
+	void Compute(int16_t *buf, int64_t start, int64_t count);
+
+public:
+	/// Number of output samples in each cached chunk
+	static constexpr int64_t ChunkSamples = 1 << 15;
+
+	/// @param source Provider to read from, which must outlive this
+	/// @param min_rate Lowest acceptable output sample rate
+	/// @param cache Keep the output for fully decoded chunks of the source
+	AudioAnalysisStream(AudioProvider const& source, int min_rate, bool cache);
+	~AudioAnalysisStream();
+
+	/// Source samples per output sample
+	int GetFactor() const { return factor; }
+	int GetSampleRate() const;
+	int64_t GetNumSamples() const { return num_samples; }
+
+	/// Would this stream return exactly what the source's GetInt16MonoAudio
+	/// does? If so there's no point in using it uncached.
+	bool IsPassthrough() const;
+
+	/// Get output samples, with zeros for any outside of the stream
+	void GetAudio(int16_t *buf, int64_t start, int64_t count);
+};
+}
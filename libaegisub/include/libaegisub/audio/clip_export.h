@@ -0,0 +1,44 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+/// @file clip_export.h
+/// @brief Saving many ranges of audio as WAV files at once
+
+#pragma once
+
+#include <libaegisub/fs.h>
+
+#include <vector>
+
+namespace agi {
+class AudioProvider;
+class ProgressSink;
+
+/// A time range of audio to be saved as a WAV file
+struct AudioClip {
+	fs::path path;
+	/// Start time in milliseconds
+	int start_time;
+	/// End time in milliseconds
+	int end_time;
+};
+
+/// Save each of the clips, reading from the provider and writing the files on
+/// several threads at once
+///
+/// @param ps Progress sink to report to after each clip, or nullptr. Throws
+///           UserCancelException if it's cancelled, leaving the clips which
+///           have already been written.
+void SaveAudioClips(AudioProvider const& provider, std::vector<AudioClip> const& clips, ProgressSink *ps = nullptr);
+}
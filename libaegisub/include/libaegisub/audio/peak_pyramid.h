@@ -0,0 +1,134 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+/// @file peak_pyramid.h
+/// @brief Multi-resolution min/max/average summary of an audio stream
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace agi {
+class AudioProvider;
+
+/// Summary of a range of downmixed int16 samples
+struct AudioPeak {
+	int16_t min = 0;
+	int16_t max = 0;
+	/// Sum of all positive samples in the range
+	int64_t pos_sum = 0;
+	/// Sum of all negative samples in the range
+	int64_t neg_sum = 0;
+};
+
+/// @class AudioPeakPyramid
+/// @brief Peak summaries at 256, 4096 and 65536 samples per bucket
+///
+/// The pyramid is filled by the decoder threads of an audio cache via
+/// Update() as blocks of audio are decoded, in any order, and may be read
+/// concurrently by any number of readers.
+class AudioPeakPyramid {
+public:
+	/// log2 of the number of samples per bucket on each level
+	static constexpr std::array<int, 3> LevelBits{{8, 12, 16}};
+	static constexpr int Levels = 3;
+
+private:
+	struct Bucket {
+		int16_t min;
+		int16_t max;
+		// Fits even for 65536 samples of -32768
+		int32_t pos_sum;
+		int32_t neg_sum;
+	};
+
+	struct Level {
+		std::vector<Bucket> buckets;
+		/// Has each bucket been filled in? Set only after the bucket is written.
+		std::vector<std::atomic<bool>> valid;
+	};
+
+	std::array<Level, Levels> levels;
+	int64_t num_samples;
+
+	/// Serializes writers
+	std::mutex mutex;
+	/// Scratch buffer for reading from the provider
+	std::vector<int16_t> buffer;
+
+	void SummarizeSamples(AudioProvider const& provider, int64_t start, int64_t end);
+	void SummarizeParents(int level, int64_t first, int64_t last);
+
+public:
+	/// @param num_samples Total number of samples in the stream to summarize
+	AudioPeakPyramid(int64_t num_samples);
+
+	/// Summarize a newly decoded range of samples
+	/// @param provider Provider to read downmixed samples from
+	/// @param start    First decoded sample
+	/// @param end      One past the last decoded sample
+	///
+	/// Buckets which straddle the ends of the range are summarized only if the
+	/// provider reports the rest of them as decoded, and are otherwise left
+	/// for the update of the neighboring range.
+	void Update(AudioProvider const& provider, int64_t start, int64_t end);
+
+	/// Get the summary of a range of samples
+	/// @param start    First sample, rounded down to a multiple of 256
+	/// @param end      One past the last sample, rounded down to a multiple of 256
+	/// @param[out] out Summary of the range
+	/// @return Is the entire range summarized? out is undefined if not.
+	bool Get(int64_t start, int64_t end, AudioPeak *out) const;
+};
+
+/// @class AudioLoudnessOverview
+/// @brief Loudness of a whole stream at a small, fixed number of points
+///
+/// Each slice of the stream is filled in from a peak pyramid once all of its
+/// audio has been decoded, and is never looked at again after that, so the
+/// overview can be updated as often as wanted while the audio loads.
+/// Loudness is the average absolute sample value in decibels relative to
+/// full scale, which unlike the peaks separates speech from quiet backgrounds.
+class AudioLoudnessOverview {
+	std::vector<uint8_t> levels;
+	int64_t num_samples = 0;
+	size_t remaining = 0;
+
+public:
+	/// Decibels below full scale which are shown as silence
+	static constexpr int Floor = 60;
+
+	AudioLoudnessOverview() = default;
+	/// @param num_samples Total number of samples in the stream
+	/// @param slices      Number of equal slices to divide the stream into
+	AudioLoudnessOverview(int64_t num_samples, size_t slices);
+
+	/// Fill in the slices which have finished decoding since the last update
+	/// @return Did any slices change?
+	bool Update(AudioPeakPyramid const& peaks);
+
+	/// Has every slice been filled in?
+	bool IsComplete() const { return remaining == 0; }
+
+	size_t size() const { return levels.size(); }
+
+	/// Loudness of a slice, from 1 for silence to 255 for full scale, or 0
+	/// if its audio hasn't been decoded yet
+	uint8_t operator[](size_t slice) const { return levels[slice]; }
+};
+}
@@ -0,0 +1,128 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+/// @file playback_buffer.h
+/// @brief Ring buffer between an audio provider and an audio output device
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace agi {
+class AudioProvider;
+
+/// @class AudioPlaybackBuffer
+/// @brief Reads audio ahead of an audio player into a ring buffer
+///
+/// A feeder thread keeps the buffer filled with audio from the provider up to
+/// the target latency ahead of the read position, and the player's device
+/// thread or callback drains it with Read(). The feeder is the only writer
+/// and the device the only reader, so reading never blocks on a lock or on
+/// the provider.
+///
+/// Reads which find less audio buffered than they asked for are underruns:
+/// the missing audio is replaced with silence and skipped over so that the
+/// read position keeps following the device's clock.
+class AudioPlaybackBuffer {
+	AudioProvider *provider;
+	/// Read int16 mono audio from the provider rather than its native format
+	bool int16_mono;
+	size_t frame_size;
+	/// Byte value of silence in the buffered format
+	int silence;
+	int64_t latency_frames;
+	/// Frames of audio read from the provider at once
+	int64_t chunk_frames;
+
+	std::vector<char> ring;
+	/// Number of frames in the ring minus one; the size is a power of two
+	int64_t ring_mask = 0;
+
+	/// Stream position of the start of playback
+	int64_t start = 0;
+	/// Frames written and read since the start of playback
+	std::atomic<int64_t> write_pos{0};
+	std::atomic<int64_t> read_pos{0};
+	/// Stream position to stop at
+	std::atomic<int64_t> end{0};
+	std::atomic<double> volume{1.0};
+
+	std::atomic<uint64_t> underruns{0};
+	std::atomic<uint64_t> underrun_frames{0};
+	/// Number of underruns already reported when playback last stopped
+	uint64_t reported_underruns = 0;
+
+	std::mutex feeder_mutex;
+	std::condition_variable feeder_cond;
+	bool feeder_quit = false;
+	std::thread feeder;
+
+	/// Fill the buffer up to the target latency
+	/// @return Was anything read from the provider?
+	bool Fill();
+	void FeederThread();
+
+public:
+	/// @param provider   Audio provider to play from
+	/// @param int16_mono Buffer int16 mono audio instead of the provider's format
+	/// @param latency_ms How far ahead of the read position to buffer audio
+	AudioPlaybackBuffer(AudioProvider *provider, bool int16_mono, int latency_ms);
+	~AudioPlaybackBuffer();
+
+	/// @brief Start buffering the range [start_pos, end_pos)
+	///
+	/// The first target latency's worth of audio is read before this returns,
+	/// so playback can start immediately. Must not be called concurrently
+	/// with Read().
+	void Start(int64_t start_pos, int64_t end_pos);
+
+	/// Stop the feeder thread; must not be called concurrently with Read()
+	void Stop();
+
+	/// @brief Copy the next frames to the device
+	/// @param buf    Buffer to fill with frames frames of audio
+	/// @param frames Number of frames to read
+	/// @return Number of frames of audio copied before the end of playback
+	///
+	/// Anything which isn't buffered is filled with silence, and the read
+	/// position always advances by frames.
+	size_t Read(void *buf, size_t frames);
+
+	/// Change the position playback stops at
+	void SetEnd(int64_t end_pos) { end = end_pos; }
+	int64_t GetEnd() const { return end; }
+
+	/// Set the volume applied to audio as it's read from the provider
+	void SetVolume(double vol) { volume = vol; }
+
+	/// Stream position of the next frame Read() will return
+	int64_t GetPosition() const { return start + read_pos; }
+	/// Has everything up to the end position been read?
+	bool AtEnd() const { return GetPosition() >= end; }
+
+	/// Size in bytes of each frame in the buffer
+	size_t GetFrameSize() const { return frame_size; }
+
+	/// Number of reads which were short of audio since the buffer was created
+	uint64_t GetUnderruns() const { return underruns; }
+	/// Number of frames of silence inserted due to underruns
+	uint64_t GetUnderrunFrames() const { return underrun_frames; }
+};
+}
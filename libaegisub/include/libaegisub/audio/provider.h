@@ -20,17 +20,41 @@
 #include <libaegisub/fs_fwd.h>
 
 #include <atomic>
-#include <vector>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 namespace agi {
+class AudioPeakPyramid;
+class AudioSpeechDetector;
+
+/// Samples which a provider holds in memory, to be read in place
+///
+/// The samples are in the provider's own format and stay valid for as long
+/// as the span exists. Some providers hold a lock until then, so spans
+/// should be dropped as soon as the samples have been read.
+struct AudioSpan {
+	/// First sample, or nullptr if the audio can't be read in place
+	const void *data = nullptr;
+	/// Number of samples (per channel) available at data
+	int64_t count = 0;
+	/// Keeps other threads from invalidating data, for providers which need to
+	std::unique_lock<std::mutex> guard;
+	/// Keeps data alive, for providers which may evict it
+	std::shared_ptr<const void> owner;
+
+	explicit operator bool() const { return data != nullptr; }
+};
+
 class AudioProvider {
 protected:
 	int channels = 0;
 	/// Total number of samples per channel
 	int64_t num_samples = 0;
-	/// Samples per channel which have been decoded and can be fetched with FillBuffer
-	/// Only applicable for the cache providers
+	/// Number of samples per channel which have been decoded and can be fetched
+	/// with FillBuffer. Only applicable for the cache providers, which may not
+	/// decode them in order; see IsRangeDecoded().
 	std::atomic<int64_t> decoded_samples{0};
 	int sample_rate = 0;
 	int bytes_per_sample = 0;
@@ -58,6 +82,49 @@ public:
 
 	/// Does this provider benefit from external caching?
 	virtual bool NeedsCache() const { return false; }
+
+	/// Is it safe to get audio from this provider from several threads at once?
+	virtual bool SupportsConcurrentReads() const { return false; }
+
+	/// Have all of the samples in the given range been decoded?
+	///
+	/// The cache providers decode out of order, so this may be true for
+	/// ranges past GetDecodedSamples().
+	virtual bool IsRangeDecoded(int64_t start, int64_t count) const {
+		return start + count <= decoded_samples;
+	}
+
+	/// Get a string which identifies the decoded audio beyond the source file
+	///
+	/// This should include the track and any settings which affect decoding.
+	/// An empty string means that the provider's output can't safely be
+	/// cached across sessions.
+	virtual std::string GetCacheIdentity() const { return ""; }
+
+	/// Hint that the audio starting at the given sample is wanted soon
+	///
+	/// Providers which decode in the background should decode from here next.
+	virtual void PrioritizeDecoding(int64_t start) { }
+
+	/// Get the audio starting at the given sample without copying it
+	///
+	/// Only the cache providers hold audio in memory, and only once it's
+	/// been decoded. The span may be shorter than asked for if the range
+	/// crosses one of the cache's blocks, and is empty if any of the first
+	/// block isn't available, in which case use GetAudio() instead.
+	virtual AudioSpan GetAudioSpan(int64_t start, int64_t count) const { return AudioSpan(); }
+
+	/// Get the precomputed peak summaries of the downmixed audio, if any
+	///
+	/// Only the cache providers build these, as they're filled in alongside
+	/// the decoding of the audio.
+	virtual AudioPeakPyramid const* GetPeaks() const { return nullptr; }
+
+	/// Get the speech detected in the audio so far, if any
+	///
+	/// As with the peaks, only the cache providers analyze the audio for
+	/// speech, as they do so while decoding it.
+	virtual AudioSpeechDetector const* GetSpeech() const { return nullptr; }
 };
 
 /// Helper base class for an audio provider which wraps another provider
@@ -95,5 +162,21 @@ std::unique_ptr<AudioProvider> CreateLockAudioProvider(std::unique_ptr<AudioProv
 std::unique_ptr<AudioProvider> CreateHDAudioProvider(std::unique_ptr<AudioProvider> source_provider, fs::path const& dir);
 std::unique_ptr<AudioProvider> CreateRAMAudioProvider(std::unique_ptr<AudioProvider> source_provider);
 
+/// Wrap a provider so that it produces int16 samples with at most two
+/// channels, downmixing to stereo if needed. Returns the provider itself if it
+/// already does.
+std::unique_ptr<AudioProvider> CreateCompactAudioProvider(std::unique_ptr<AudioProvider> source_provider);
+
+/// Create a disk cache which is kept in the given file after the audio has been
+/// fully decoded, and which reuses the file rather than decoding anything if it
+/// already holds complete audio in the source's format
+std::unique_ptr<AudioProvider> CreatePersistentAudioProvider(std::unique_ptr<AudioProvider> source_provider, fs::path const& cache_file);
+
+/// Create a cache which decodes blocks of audio only when they're read or are
+/// near the prioritized position, keeping at most max_bytes of the most
+/// recently used ones. Nothing is decoded up front, so the audio is usable
+/// immediately, but the source has to be able to seek cheaply.
+std::unique_ptr<AudioProvider> CreateOnDemandAudioProvider(std::unique_ptr<AudioProvider> source_provider, size_t max_bytes);
+
 void SaveAudioClip(AudioProvider const& provider, fs::path const& path, int start_time, int end_time);
 }
@@ -0,0 +1,120 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file speech_detector.h
+/// @brief Voice activity detection on decoded audio
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace agi {
+class AudioProvider;
+
+/// A range of audio which appears to contain speech
+struct SpeechSegment {
+	/// Start time in milliseconds
+	int start;
+	/// End time in milliseconds
+	int end;
+};
+
+/// Tunables for grouping analyzed frames into speech segments
+struct SpeechDetectionSettings {
+	/// How far above the noise floor a frame has to be to count as speech, in dB
+	double threshold = 12.;
+	/// Gaps shorter than this between two runs of speech are bridged, in ms
+	int min_gap = 200;
+	/// Runs of speech shorter than this are ignored, in ms
+	int min_length = 100;
+};
+
+/// @class AudioSpeechDetector
+/// @brief Per-frame speech features of an audio stream
+///
+/// Like AudioPeakPyramid, this is filled in by the decoder threads of an
+/// audio cache through Update() as blocks are decoded, in any order, and can
+/// be queried concurrently while that's happening. Each 10 ms frame stores
+/// its energy and how much of that energy is in the high frequencies; frames
+/// which are loud relative to the noise floor of the whole stream and aren't
+/// just hiss count as speech.
+class AudioSpeechDetector {
+public:
+	/// Length of each analyzed frame in milliseconds
+	static constexpr int FrameMs = 10;
+
+private:
+	struct Frame {
+		/// Mean power in dB relative to full scale
+		float energy;
+		/// Power of the first difference of the samples relative to that of
+		/// the samples; about 1 for white noise and near 0 for voiced speech
+		float high_band;
+	};
+
+	/// Frames quieter than this are treated as digital silence when
+	/// estimating the noise floor
+	static constexpr int SilenceLevel = -90;
+	static constexpr int HistogramBins = 101;
+
+	int64_t num_samples;
+	int sample_rate;
+	int64_t frame_samples;
+
+	std::vector<Frame> frames;
+	/// Has an Update() call taken responsibility for analyzing each frame?
+	std::vector<std::atomic<bool>> claimed;
+	/// Has each frame been analyzed? Set only after the frame is written.
+	std::vector<std::atomic<bool>> valid;
+	/// Number of analyzed frames with each whole dB of energy, from 0 down to
+	/// -100 dB, for estimating the noise floor
+	std::array<std::atomic<int>, HistogramBins> histogram;
+
+	int64_t FrameAtTime(int ms) const;
+	int TimeAtFrame(int64_t frame) const;
+
+public:
+	/// @param num_samples Total number of samples in the stream
+	/// @param sample_rate Sample rate of the stream
+	AudioSpeechDetector(int64_t num_samples, int sample_rate);
+
+	/// Analyze a newly decoded range of samples
+	/// @param provider Provider to read downmixed samples from
+	/// @param start    First decoded sample
+	/// @param end      One past the last decoded sample
+	///
+	/// Frames which straddle the ends of the range are analyzed only if the
+	/// provider reports the rest of them as decoded.
+	void Update(AudioProvider const& provider, int64_t start, int64_t end);
+
+	/// Estimate the level of the background noise from the frames analyzed
+	/// so far
+	/// @return Noise floor in dB relative to full scale
+	double NoiseFloor() const;
+
+	/// Find the speech in a range of time
+	/// @param start_ms Start of the range
+	/// @param end_ms   End of the range
+	/// @param settings How to group frames into segments
+	/// @param[out] out Speech segments overlapping the range, in order,
+	///                 including the parts of them outside of the range
+	/// @return Has the entire range been analyzed? Segments are still found
+	///         in the parts which have been if not.
+	bool GetSegments(int start_ms, int end_ms, SpeechDetectionSettings const& settings, std::vector<SpeechSegment>& out) const;
+};
+}
@@ -51,6 +51,7 @@ public:
 	};
 
 	static void Read(UnknownElement& elementRoot, std::istream& istr);
+	static void Read(UnknownElement& elementRoot, const char *data, size_t size);
 
 private:
 	struct Token {
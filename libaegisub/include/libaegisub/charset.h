@@ -18,6 +18,7 @@
 
 #include <libaegisub/fs_fwd.h>
 
+#include <cstdint>
 #include <string>
 
 namespace agi {
@@ -29,5 +30,16 @@ namespace agi {
 /// @return Detected character set.
 std::string Detect(agi::fs::path const& file);
 
+/// @brief Returns the character set with the highest confidence
+///
+/// Only the first sample_size bytes of the file and a few evenly spaced
+/// chunks of the rest of it are looked at. Files which are valid UTF-8 are
+/// detected as such without involving the full detector, and results are
+/// remembered until the file is modified.
+/// @param file        File to check
+/// @param sample_size Number of bytes to read from the start of the file
+/// @return Detected character set.
+std::string Detect(agi::fs::path const& file, uint64_t sample_size);
+
 	} // namespace util
 } // namespace agi
@@ -0,0 +1,68 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file deferred_save.h
+/// @brief Coalesced background writing of JSON config files
+/// @ingroup libaegisub io
+
+#pragma once
+
+#include <libaegisub/fs_fwd.h>
+
+#include <boost/filesystem/path.hpp>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace json {
+	class UnknownElement;
+	typedef std::map<std::string, UnknownElement> Object;
+}
+
+namespace agi { namespace io {
+
+/// @class DeferredSave
+/// @brief Writes snapshots of a JSON document to a file on a background thread
+///
+/// Documents are serialized into a json::Object by the owner on its own
+/// thread, so no locking of the source data is needed, and then handed off to
+/// be written with io::Save (and thus atomically replace the old file). If a
+/// new document is queued before the previous one has been written only the
+/// newest one is written, so frequent updates cost at most one write at a
+/// time. Write errors on the background thread are logged rather than thrown.
+class DeferredSave {
+	struct State;
+	std::shared_ptr<State> state;
+
+public:
+	/// @param file File to write to
+	DeferredSave(fs::path const& file);
+
+	/// Writes any still-queued document before returning
+	~DeferredSave();
+
+	/// Queue a document to be written in the background, replacing any
+	/// queued document which has not been written yet
+	void Queue(json::Object document);
+
+	/// Write a document immediately, discarding any queued document
+	/// @throws agi::fs::FileSystemError or io::IOError on failure
+	void Write(json::Object const& document);
+
+	/// Block until the most recently queued document has been written
+	void Wait();
+};
+
+} }
@@ -0,0 +1,111 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+/// @file derived_store.h
+/// @brief On-disk cache of data derived from media files
+/// @ingroup libaegisub
+
+#pragma once
+
+#include <libaegisub/fs_fwd.h>
+
+#include <boost/filesystem/path.hpp>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <string>
+
+namespace agi {
+/// The version of a source file which an artifact was derived from
+struct SourceIdentity {
+	std::string path;
+	uintmax_t size = 0;
+	time_t modified = 0;
+
+	/// Get the identity of a file as it is now
+	/// @throws agi::fs::FileSystemError if the file can't be read
+	static SourceIdentity Of(fs::path const& file);
+};
+
+/// Everything which determines the contents of an artifact
+struct ArtifactKey {
+	/// Short name of the kind of artifact, such as "keyframes", which is used
+	/// as the extension of its files
+	std::string type;
+	/// Version of the artifact's format and of the code producing it; bump it
+	/// to ignore everything stored by older versions
+	int version = 1;
+	/// File the artifact was derived from
+	SourceIdentity source;
+	/// Any settings which affect the result
+	std::string params;
+};
+
+/// @class DerivedStore
+/// @brief Shared cache for expensive results computed from media files
+///
+/// Each artifact is stored in its own file named after hashes of its source
+/// file's path and of its whole key, and the full key is stored in the file
+/// to rule out hash collisions. Storing an artifact removes the artifacts of
+/// the same type derived from earlier versions of the same source file, and
+/// once the store is over its size limit the least recently used artifacts
+/// of every type are removed.
+///
+/// All member functions may be called from any thread. Failures to read or
+/// write the store are logged and otherwise treated as cache misses, as
+/// everything in it can be recomputed.
+class DerivedStore {
+	fs::path dir;
+	std::mutex mutex;
+	uint64_t max_size;
+	/// Total size of the stored files, or -1 if it hasn't been counted yet
+	int64_t total_size = -1;
+
+	/// Count the size of the store if it hasn't been counted yet
+	void CountSize();
+	/// Remove the least recently used files other than keep until under the
+	/// size limit; must be called with the lock held
+	void TrimLocked(fs::path const& keep);
+	/// Remove the files whose names start with prefix and end with suffix,
+	/// other than those which start with keep; must be called with the lock
+	/// held
+	void RemoveMatching(std::string const& prefix, std::string const& suffix, std::string const& keep);
+
+public:
+	/// @param directory Directory to store artifacts in; created when needed
+	/// @param max_size  Maximum total size of the stored artifacts in bytes
+	DerivedStore(fs::path directory, uint64_t max_size);
+
+	/// Path of the file an artifact is stored in
+	fs::path PathFor(ArtifactKey const& key) const;
+
+	/// Read an artifact
+	/// @param key       Artifact to read
+	/// @param[out] data Contents of the artifact if it was found
+	/// @return Was the artifact found?
+	bool Get(ArtifactKey const& key, std::string &data);
+
+	/// Store an artifact, replacing any previous version of it
+	void Put(ArtifactKey const& key, std::string const& data);
+
+	/// Remove every artifact derived from a file
+	void Invalidate(std::string const& source_path);
+
+	/// Change the size limit, removing artifacts if it's now exceeded
+	void SetMaxSize(uint64_t max_size);
+
+	/// Total size in bytes of the stored artifacts
+	uint64_t Size();
+};
+}
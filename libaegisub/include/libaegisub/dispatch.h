@@ -14,6 +14,10 @@
 //
 // Aegisub Project http://www.aegisub.org/
 
+#pragma once
+
+#include <atomic>
+#include <cstddef>
 #include <functional>
 #include <memory>
 
@@ -21,6 +25,29 @@ namespace agi {
 	namespace dispatch {
 		typedef std::function<void()> Thunk;
 
+		/// Scheduling class of background work
+		///
+		/// Idle workers always take the most urgent work available. Bulk work
+		/// is never given every worker at once, so that a long job can't hold
+		/// up work which the user is waiting on.
+		enum class Priority {
+			Interactive, ///< Work which the user is waiting for
+			Prefetch,    ///< Work which will probably be wanted soon
+			Bulk         ///< Long-running jobs such as indexing and collection
+		};
+
+		/// A flag which can be shared with queued work to tell it to not start
+		///
+		/// Copies share the flag, so cancelling any of them cancels all.
+		class CancellationToken {
+			std::shared_ptr<std::atomic<bool>> cancelled;
+		public:
+			CancellationToken() : cancelled(std::make_shared<std::atomic<bool>>(false)) { }
+
+			void Cancel() const { *cancelled = true; }
+			bool IsCancelled() const { return *cancelled; }
+		};
+
 		class Queue {
 			virtual void DoInvoke(Thunk&& thunk)=0;
 		public:
@@ -29,6 +56,11 @@ namespace agi {
 			/// Invoke the thunk on this processing queue, returning immediately
 			void Async(Thunk&& thunk);
 
+			/// Invoke the thunk on this processing queue, returning
+			/// immediately, unless the token has been cancelled by the time
+			/// it would start
+			void Async(Thunk&& thunk, CancellationToken const& token);
+
 			/// Invoke the thunk on this processing queue, returning only when
 			/// it's complete
 			void Sync(Thunk&& thunk);
@@ -42,9 +74,46 @@ namespace agi {
 		Queue& Main();
 
 		/// Get the generic background queue, which runs thunks in parallel
-		Queue& Background();
+		Queue& Background(Priority priority = Priority::Interactive);
+
+		/// Create a new serial queue whose thunks run at the given priority
+		std::unique_ptr<Queue> Create(Priority priority = Priority::Interactive);
 
-		/// Create a new serial queue
-		std::unique_ptr<Queue> Create();
+		/// Call func for each index in [0, count) in parallel, on the
+		/// background queue and the calling thread, returning once every
+		/// call has finished
+		///
+		/// Every index is run even if some throw, after which the exception
+		/// from the lowest index which threw is rethrown.
+		void Parallel(size_t count, std::function<void (size_t)> const& func);
+
+		/// A set of background thunks which can be waited on together
+		///
+		/// Thunks which haven't started when Wait() is called are run on the
+		/// waiting thread, so waiting from a background thread can't deadlock
+		/// on the pool.
+		class TaskGroup {
+			struct State;
+			std::shared_ptr<State> state;
+			Priority priority;
+
+		public:
+			explicit TaskGroup(Priority priority = Priority::Interactive);
+			/// Cancels anything which hasn't started and waits for the rest
+			~TaskGroup();
+
+			TaskGroup(TaskGroup const&) = delete;
+			TaskGroup& operator=(TaskGroup const&) = delete;
+
+			/// Queue a thunk to be run as part of this group
+			void Run(Thunk&& thunk);
+
+			/// Skip every thunk in the group which hasn't started yet
+			void Cancel();
+
+			/// Wait for every thunk in the group to finish, then rethrow the
+			/// first exception thrown by any of them
+			void Wait();
+		};
 	}
 }
@@ -18,6 +18,8 @@
 
 #include <boost/interprocess/detail/os_file_functions.hpp>
 #include <cstdint>
+#include <memory>
+#include <string>
 
 namespace agi {
 	// boost::interprocess::file_mapping is awesome and uses CreateFileA on Windows
@@ -33,7 +35,7 @@ namespace agi {
 	};
 
 	class read_file_mapping {
-		file_mapping file;
+		std::shared_ptr<file_mapping> file;
 		std::unique_ptr<boost::interprocess::mapped_region> region;
 		uint64_t mapping_start = 0;
 		uint64_t file_size = 0;
@@ -47,6 +49,31 @@ namespace agi {
 		const char *read(); // Map the entire file
 	};
 
+	/// @class file_open_scope
+	/// @brief Keeps a file open for reading for as long as it exists
+	///
+	/// Every read_file_mapping of the file created on the same thread while a
+	/// scope for it exists shares the scope's handle rather than opening the
+	/// file again, so that a file which is sniffed, checked for its encoding
+	/// and then parsed by different bits of code is only opened once. This
+	/// matters on network shares, where each open is a round trip.
+	class file_open_scope {
+		friend class read_file_mapping;
+
+		std::string filename;
+		std::shared_ptr<file_mapping> file;
+		uint64_t file_size = 0;
+		/// Scope which was innermost on this thread when this one was created
+		file_open_scope *outer;
+
+	public:
+		file_open_scope(fs::path const& filename);
+		~file_open_scope();
+
+		file_open_scope(file_open_scope const&) = delete;
+		file_open_scope& operator=(file_open_scope const&) = delete;
+	};
+
 	class temp_file_mapping {
 		file_mapping file;
 		uint64_t file_size = 0;
@@ -57,7 +84,8 @@ namespace agi {
 		uint64_t write_mapping_start = 0;
 
 	public:
-		temp_file_mapping(fs::path const& filename, uint64_t size);
+		/// @param keep Leave the file on disk rather than deleting it once it's closed
+		temp_file_mapping(fs::path const& filename, uint64_t size, bool keep = false);
 		~temp_file_mapping();
 
 		const char *read(int64_t offset, uint64_t length);
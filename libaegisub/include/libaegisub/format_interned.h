@@ -16,19 +16,19 @@
 
 #include <libaegisub/fs_fwd.h>
 
-#include <boost/flyweight.hpp>
+#include <libaegisub/interned.h>
 
 namespace agi {
 template<>
-struct writer<char, boost::flyweight<std::string>> {
-	static void write(std::basic_ostream<char>& out, int max_len, boost::flyweight<std::string> const& value) {
+struct writer<char, agi::Interned<std::string>> {
+	static void write(std::basic_ostream<char>& out, int max_len, agi::Interned<std::string> const& value) {
 		writer<char, std::string>::write(out, max_len, value.get());
 	}
 };
 
 template<>
-struct writer<wchar_t, boost::flyweight<std::string>> {
-	static void write(std::basic_ostream<wchar_t>& out, int max_len, boost::flyweight<std::string> const& value) {
+struct writer<wchar_t, agi::Interned<std::string>> {
+	static void write(std::basic_ostream<wchar_t>& out, int max_len, agi::Interned<std::string> const& value) {
 		writer<wchar_t, std::string>::write(out, max_len, value.get());
 	}
 };
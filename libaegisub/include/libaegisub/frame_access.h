@@ -0,0 +1,68 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file frame_access.h
+/// @brief Standard frame access patterns for measuring video sources
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace agi { namespace frame_access {
+/// Ways in which frames are typically requested while editing
+enum class Pattern {
+	/// Every frame in order, as when playing
+	Sequential,
+	/// Frames picked at random, as when clicking around the seek bar
+	RandomSeek,
+	/// Every frame in reverse order, as when stepping backwards
+	BackwardStep,
+	/// Keyframes in order, as when jumping between keyframes
+	KeyframeJump
+};
+
+/// All of the patterns, in the order they're usually run in
+extern const Pattern AllPatterns[4];
+
+/// Get a short identifier for a pattern, suitable as a JSON key
+const char *PatternName(Pattern pattern);
+
+/// @brief Get the frames to request for a pattern
+/// @param pattern     The pattern
+/// @param frame_count Number of frames in the video
+/// @param keyframes   Keyframes of the video; evenly spaced frames are used
+///                    for KeyframeJump if this is empty
+/// @param count       Maximum number of frames to return
+/// @param seed        Seed for RandomSeek, so that runs are repeatable
+std::vector<int> Generate(Pattern pattern, int frame_count, std::vector<int> const& keyframes, size_t count, uint32_t seed = 0);
+
+/// Summary of how long a set of frame requests took
+struct LatencyStats {
+	size_t count = 0;
+	double total_ms = 0;
+	double mean_ms = 0;
+	double p50_ms = 0;
+	double p90_ms = 0;
+	double p99_ms = 0;
+	double max_ms = 0;
+	/// Frames per second over the whole run
+	double fps = 0;
+};
+
+/// Summarize the time taken by each frame request, in milliseconds
+LatencyStats Summarize(std::vector<double> latencies_ms);
+} }
@@ -95,6 +95,13 @@ namespace agi {
 		/// Check for amount of free space on a path
 		uintmax_t FreeSpace(path const& dir_path);
 
+		/// Is the file or directory at path on network storage?
+		///
+		/// Only looks at the filesystem type, so this is false for paths which
+		/// don't exist and for network filesystems which the OS doesn't
+		/// report as such.
+		bool IsNetworkPath(path const& p);
+
 		/// Get the size in bytes of the file at path
 		///
 		/// @throws agi::FileNotFound if path does not exist
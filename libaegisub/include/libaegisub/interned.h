@@ -0,0 +1,286 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file interned.h
+/// @brief Shared immutable values deduplicated through a sharded table
+
+#pragma once
+
+#include <boost/functional/hash.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace agi {
+namespace detail {
+template<typename T>
+struct InternNode {
+	T value;
+	const size_t hash;
+	std::atomic<size_t> refs{1};
+	/// Next node in the same bucket of the table
+	InternNode *next = nullptr;
+
+	InternNode(T&& value, size_t hash) : value(std::move(value)), hash(hash) { }
+};
+
+/// Table of all of the live values of a type
+///
+/// The table is split into shards by hash so that threads interning
+/// different values rarely contend for a lock, and only interning a value
+/// and releasing the last reference to one ever take a lock at all. Each
+/// shard is an intrusively chained hash table, so a value costs a single
+/// allocation and is removed without hashing or comparing it again.
+template<typename T>
+class InternTable {
+	using Node = InternNode<T>;
+
+	struct Shard {
+		std::mutex mutex;
+		std::vector<Node *> buckets = std::vector<Node *>(64);
+		size_t count = 0;
+
+		Node *&Bucket(size_t hash) { return buckets[hash & (buckets.size() - 1)]; }
+
+		void Grow() {
+			std::vector<Node *> old(buckets.size() * 2);
+			swap(old, buckets);
+			for (Node *node : old) {
+				while (node) {
+					Node *next = node->next;
+					Node *&bucket = Bucket(node->hash);
+					node->next = bucket;
+					bucket = node;
+					node = next;
+				}
+			}
+		}
+	};
+
+	static const size_t shard_count = 16;
+	Shard shards[shard_count];
+
+	/// Buckets are picked with the low bits of the hash, so use high ones here
+	Shard& ShardFor(size_t hash) { return shards[(hash >> (sizeof(size_t) * 8 - 4)) % shard_count]; }
+
+public:
+	/// Get the node for a value, creating it if needed
+	/// @return A node with a reference owned by the caller
+	Node *Intern(T&& value, size_t hash) {
+		auto& shard = ShardFor(hash);
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		for (Node *node = shard.Bucket(hash); node; node = node->next) {
+			if (node->hash == hash && node->value == value) {
+				node->refs.fetch_add(1, std::memory_order_relaxed);
+				return node;
+			}
+		}
+
+		if (++shard.count > shard.buckets.size())
+			shard.Grow();
+		auto node = new Node(std::move(value), hash);
+		Node *&bucket = shard.Bucket(hash);
+		node->next = bucket;
+		bucket = node;
+		return node;
+	}
+
+	/// Get the node for a value equal to key, constructing the value from
+	/// key only if there isn't one already
+	/// @return A node with a reference owned by the caller
+	template<typename Key>
+	Node *InternKey(Key const& key, size_t hash) {
+		auto& shard = ShardFor(hash);
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		for (Node *node = shard.Bucket(hash); node; node = node->next) {
+			if (node->hash == hash && node->value == key) {
+				node->refs.fetch_add(1, std::memory_order_relaxed);
+				return node;
+			}
+		}
+
+		if (++shard.count > shard.buckets.size())
+			shard.Grow();
+		auto node = new Node(T(key), hash);
+		Node *&bucket = shard.Bucket(hash);
+		node->next = bucket;
+		bucket = node;
+		return node;
+	}
+
+	void Release(Node *node) {
+		// Dropping a reference other than the last needs no lock, as the node
+		// can't be found again by Intern while it stays at zero
+		size_t refs = node->refs.load(std::memory_order_relaxed);
+		while (refs > 1) {
+			if (node->refs.compare_exchange_weak(refs, refs - 1, std::memory_order_release, std::memory_order_relaxed))
+				return;
+		}
+
+		auto& shard = ShardFor(node->hash);
+		{
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			if (node->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+				return;
+			Node **link = &shard.Bucket(node->hash);
+			while (*link != node)
+				link = &(*link)->next;
+			*link = node->next;
+			--shard.count;
+		}
+		delete node;
+	}
+
+	/// Number of distinct live values
+	size_t size() {
+		size_t count = 0;
+		for (auto& shard : shards) {
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			count += shard.count;
+		}
+		return count;
+	}
+
+	static InternTable& Instance() {
+		// Leaked so that values in static objects can outlive it safely
+		static InternTable *table = new InternTable;
+		return *table;
+	}
+};
+}
+
+/// @class Interned
+/// @brief An immutable value shared by every Interned with an equal value
+///
+/// Copying, comparing for equality, hashing and reading the value never lock
+/// or look at the value itself, so lines can be copied freely from any
+/// thread. Only constructing one from a value goes through the table. The
+/// default-constructed value isn't stored in the table at all.
+template<typename T>
+class Interned {
+	using Table = detail::InternTable<T>;
+	detail::InternNode<T> *node = nullptr;
+
+	static T const& Empty() {
+		static const T *empty = new T();
+		return *empty;
+	}
+
+	void Set(T&& value) {
+		if (value == Empty()) return;
+		const size_t hash = boost::hash<T>()(value);
+		node = Table::Instance().Intern(std::move(value), hash);
+	}
+
+	void Release() {
+		if (node) Table::Instance().Release(node);
+	}
+
+public:
+	using value_type = T;
+
+	Interned() = default;
+	Interned(T const& value) { Set(T(value)); }
+	Interned(T&& value) { Set(std::move(value)); }
+
+	/// Construct directly from anything T can be constructed from
+	template<typename U, typename = typename std::enable_if<
+		!std::is_same<typename std::decay<U>::type, Interned>::value &&
+		!std::is_same<typename std::decay<U>::type, T>::value &&
+		std::is_constructible<T, U&&>::value>::type>
+	Interned(U&& value) { Set(T(std::forward<U>(value))); }
+
+	/// @brief Get the value equal to a key such as a std::string_view
+	///
+	/// Unlike constructing a T from the key first, this only makes a copy
+	/// of it when no equal value is interned already. Key must compare equal
+	/// to T and hash the same as it with boost::hash, as std::string_view
+	/// does with std::string.
+	template<typename Key>
+	static Interned FromKey(Key const& key) {
+		Interned ret;
+		if (!(Empty() == key))
+			ret.node = Table::Instance().InternKey(key, boost::hash<Key>()(key));
+		return ret;
+	}
+
+	Interned(Interned const& other) noexcept : node(other.node) {
+		if (node) node->refs.fetch_add(1, std::memory_order_relaxed);
+	}
+	Interned(Interned&& other) noexcept : node(other.node) { other.node = nullptr; }
+
+	~Interned() { Release(); }
+
+	Interned& operator=(Interned const& other) noexcept {
+		if (other.node) other.node->refs.fetch_add(1, std::memory_order_relaxed);
+		Release();
+		node = other.node;
+		return *this;
+	}
+
+	Interned& operator=(Interned&& other) noexcept {
+		std::swap(node, other.node);
+		return *this;
+	}
+
+	T const& get() const { return node ? node->value : Empty(); }
+	operator T const&() const { return get(); }
+
+	/// Hash of the value, computed once when it was interned
+	size_t hash() const { return node ? node->hash : boost::hash<T>()(Empty()); }
+
+	friend bool operator==(Interned const& a, Interned const& b) { return a.node == b.node; }
+	friend bool operator!=(Interned const& a, Interned const& b) { return a.node != b.node; }
+	friend bool operator<(Interned const& a, Interned const& b) { return a.get() < b.get(); }
+	friend bool operator>(Interned const& a, Interned const& b) { return b.get() < a.get(); }
+	friend bool operator<=(Interned const& a, Interned const& b) { return !(b.get() < a.get()); }
+	friend bool operator>=(Interned const& a, Interned const& b) { return !(a.get() < b.get()); }
+
+	/// Number of distinct non-default values of this type currently alive
+	static size_t LiveCount() { return Table::Instance().size(); }
+};
+
+// Comparisons with plain values compare the contents
+template<typename T, typename U>
+typename std::enable_if<!std::is_same<U, Interned<T>>::value, bool>::type
+operator==(Interned<T> const& a, U const& b) { return a.get() == b; }
+template<typename T, typename U>
+typename std::enable_if<!std::is_same<U, Interned<T>>::value, bool>::type
+operator==(U const& a, Interned<T> const& b) { return a == b.get(); }
+template<typename T, typename U>
+typename std::enable_if<!std::is_same<U, Interned<T>>::value, bool>::type
+operator!=(Interned<T> const& a, U const& b) { return a.get() != b; }
+template<typename T, typename U>
+typename std::enable_if<!std::is_same<U, Interned<T>>::value, bool>::type
+operator!=(U const& a, Interned<T> const& b) { return a != b.get(); }
+
+template<typename Char, typename Traits, typename T>
+std::basic_ostream<Char, Traits>& operator<<(std::basic_ostream<Char, Traits>& out, Interned<T> const& value) {
+	return out << value.get();
+}
+}
+
+namespace std {
+	template<typename T>
+	struct hash<agi::Interned<T>> {
+		size_t operator()(agi::Interned<T> const& value) const { return value.hash(); }
+	};
+}
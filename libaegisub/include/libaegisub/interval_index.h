@@ -0,0 +1,151 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file interval_index.h
+/// @brief Index of time intervals for finding those covering a time
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace agi {
+/// @class IntervalIndex
+/// @brief Index of half-open [start, end) intervals, each tagged with a value
+///
+/// Empty intervals are stored but never overlap anything.
+/// The intervals are kept sorted by start time in an implicit balanced binary
+/// tree, where each node additionally stores the latest end time within its
+/// subtree. Finding the k intervals which overlap a range is O(log n + k) for
+/// typical subtitle timing, while changing a single interval is a memmove and
+/// a linear pass over the node maxima rather than a full sort.
+template<typename T>
+class IntervalIndex {
+public:
+	struct Entry {
+		int start;
+		int end;
+		T value;
+	};
+
+private:
+	std::vector<Entry> entries;
+	/// Latest end time in the subtree rooted at each entry
+	std::vector<int> max_end;
+
+	static bool StartsBefore(Entry const& a, Entry const& b) { return a.start < b.start; }
+
+	int Augment(size_t lo, size_t hi) {
+		if (lo >= hi) return 0;
+		const size_t mid = lo + (hi - lo) / 2;
+		int end = std::max({entries[mid].end, Augment(lo, mid), Augment(mid + 1, hi)});
+		max_end[mid] = end;
+		return end;
+	}
+
+	void Augment() {
+		max_end.resize(entries.size());
+		Augment(0, entries.size());
+	}
+
+	template<typename Func>
+	void Query(size_t lo, size_t hi, int start, int end, Func& func) const {
+		while (lo < hi) {
+			const size_t mid = lo + (hi - lo) / 2;
+			// Nothing in this subtree extends past the start of the range
+			if (max_end[mid] <= start) return;
+			Query(lo, mid, start, end, func);
+			// Everything from here on begins at or after the end of the range
+			if (entries[mid].start >= end) return;
+			if (entries[mid].end > start && entries[mid].end > entries[mid].start)
+				func(entries[mid].value);
+			lo = mid + 1;
+		}
+	}
+
+	void Insert(Entry entry) {
+		auto it = std::upper_bound(entries.begin(), entries.end(), entry, StartsBefore);
+		entries.insert(it, std::move(entry));
+	}
+
+	bool Erase(T const& value) {
+		auto it = std::find_if(entries.begin(), entries.end(), [&](Entry const& e) { return e.value == value; });
+		if (it == entries.end()) return false;
+		entries.erase(it);
+		return true;
+	}
+
+public:
+	/// Remove all intervals
+	void Clear() {
+		entries.clear();
+		max_end.clear();
+	}
+
+	/// Replace the contents of the index, in O(n log n)
+	void Assign(std::vector<Entry> new_entries) {
+		entries = std::move(new_entries);
+		std::stable_sort(entries.begin(), entries.end(), StartsBefore);
+		Augment();
+	}
+
+	/// Add an interval
+	void Add(T value, int start, int end) {
+		Insert(Entry{start, end, std::move(value)});
+		Augment();
+	}
+
+	/// Remove the interval tagged with the given value
+	/// @return Was there such an interval?
+	bool Remove(T const& value) {
+		if (!Erase(value)) return false;
+		Augment();
+		return true;
+	}
+
+	/// Change the interval tagged with the given value, adding it if needed
+	void Update(T value, int start, int end) {
+		Erase(value);
+		Add(std::move(value), start, end);
+	}
+
+	/// Number of intervals in the index
+	size_t size() const { return entries.size(); }
+	bool empty() const { return entries.empty(); }
+
+	/// Call func with the value of each interval overlapping [start, end),
+	/// in order of start time
+	template<typename Func>
+	void ForEachOverlapping(int start, int end, Func&& func) const {
+		if (start < end)
+			Query(0, entries.size(), start, end, func);
+	}
+
+	/// Get the values of the intervals overlapping [start, end), in order of
+	/// start time
+	std::vector<T> Overlapping(int start, int end) const {
+		std::vector<T> ret;
+		ForEachOverlapping(start, end, [&](T const& value) { ret.push_back(value); });
+		return ret;
+	}
+
+	/// Get the values of the intervals containing the given time, in order of
+	/// start time
+	std::vector<T> At(int time) const {
+		return Overlapping(time, time + 1);
+	}
+};
+}
@@ -16,7 +16,9 @@
 
 #include <boost/interprocess/streams/bufferstream.hpp>
 #include <cstdint>
+#include <map>
 #include <memory>
+#include <utility>
 #include <vector>
 
 // These macros below aren't a perm solution, it will depend on how annoying they are through
@@ -68,20 +70,43 @@ struct SinkMessage {
 class Emitter;
 
 /// Log sink, single destination for all messages
+///
+/// Messages are put into a fixed-size lock-free ring buffer by the thread
+/// logging them, and are stored and passed to the emitters by a background
+/// queue. Messages logged while the ring is full are dropped, and messages
+/// from a single source line beyond a few per second are counted rather than
+/// emitted.
 class LogSink {
+	struct Ring;
+	std::unique_ptr<Ring> ring;
+
 	std::vector<SinkMessage> messages;
 	size_t next_idx = 0;
 	std::unique_ptr<dispatch::Queue> queue;
 
+	/// Recent messages from each source line, for rate limiting
+	struct SourceRate {
+		int64_t window_start = 0;
+		int count = 0;
+		int suppressed = 0;
+	};
+	std::map<std::pair<const char *, int>, SourceRate> rates;
+
 	/// List of pointers to emitters
 	std::vector<std::unique_ptr<Emitter>> emitters;
 
+	/// Pass everything in the ring to the emitters; runs on the queue
+	void Drain();
+	/// Store and emit one message, subject to rate limiting
+	void Deliver(SinkMessage& sm);
+	void Emit(SinkMessage const& sm);
+
 public:
 	LogSink();
 	~LogSink();
 
 	/// Insert a message into the sink.
-	void Log(SinkMessage const& sm);
+	void Log(SinkMessage sm);
 
 	/// @brief Subscribe an emitter
 	/// @param em Emitter to add
@@ -23,6 +23,10 @@ struct lua_State;
 namespace agi { namespace lua {
 	/// Load a Lua or Moonscript file at the given path
 	bool LoadFile(lua_State *L, agi::fs::path const& filename);
+	/// Set the directory to cache compiled scripts in, so that loading an
+	/// unchanged script again skips compiling it
+	/// @param dir Cache directory, or an empty path to disable caching
+	void SetCacheDirectory(agi::fs::path const& dir);
 	/// Install our module loader and add include_path to the module search
 	/// path of the given lua state
 	bool Install(lua_State *L, std::vector<fs::path> const& include_path);
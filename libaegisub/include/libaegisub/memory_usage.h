@@ -0,0 +1,148 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file memory_usage.h
+/// @brief Registry of the memory used by caches and other large subsystems
+/// @ingroup libaegisub
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace agi { namespace memory {
+
+/// Memory used by everything registered under one name
+struct Usage {
+	/// Name of the subsystem
+	std::string name;
+	/// Number of live counters with this name
+	size_t instances = 0;
+	/// Bytes currently in use
+	size_t bytes = 0;
+	/// Sum of the configured limits in bytes, or 0 if any are unlimited
+	size_t limit = 0;
+};
+
+/// @class Counter
+/// @brief A number of bytes used by something, reported through the registry
+///
+/// Counters register themselves on construction and unregister on
+/// destruction. Several counters may share a name, in which case they are
+/// reported together. Updating a counter is a single atomic operation, so
+/// they can be updated from any thread.
+class Counter {
+	const std::string name;
+	std::atomic<size_t> bytes{0};
+	std::atomic<size_t> limit;
+
+public:
+	/// @param name  Name to report the usage under
+	/// @param limit Configured maximum size in bytes, or 0 for none
+	Counter(std::string name, size_t limit = 0);
+	~Counter();
+
+	Counter(Counter const&) = delete;
+	Counter& operator=(Counter const&) = delete;
+
+	void Set(size_t new_bytes) { bytes.store(new_bytes, std::memory_order_relaxed); }
+	void Add(size_t amount) { bytes.fetch_add(amount, std::memory_order_relaxed); }
+	void Remove(size_t amount) { bytes.fetch_sub(amount, std::memory_order_relaxed); }
+	void SetLimit(size_t new_limit) { limit.store(new_limit, std::memory_order_relaxed); }
+
+	std::string const& GetName() const { return name; }
+	size_t GetBytes() const { return bytes.load(std::memory_order_relaxed); }
+	size_t GetLimit() const { return limit.load(std::memory_order_relaxed); }
+};
+
+/// How urgently memory should be given back
+enum class Pressure {
+	/// Nothing needs to be given back
+	None,
+	/// Memory is getting short, so caches should shrink
+	Moderate,
+	/// The process is about to be killed or pushed into swap, so everything
+	/// which can be rebuilt should be dropped
+	Critical
+};
+
+/// @class Trimmer
+/// @brief Something which can give memory back when asked, such as a cache
+///
+/// Trimmers register themselves on construction and unregister on
+/// destruction. They're called by Trim() on the thread which called it, so
+/// a trimmer for something owned by another thread should hand the work
+/// over to that thread rather than doing it directly.
+class Trimmer {
+	const int priority;
+	const std::function<void (Pressure)> trim;
+
+public:
+	/// @param priority Order to trim in; lower priorities are asked first, so
+	///                 caches which are cheap to refill should use low numbers
+	/// @param trim     Called with how much should be given back
+	Trimmer(int priority, std::function<void (Pressure)> trim);
+	~Trimmer();
+
+	Trimmer(Trimmer const&) = delete;
+	Trimmer& operator=(Trimmer const&) = delete;
+
+	int GetPriority() const { return priority; }
+	void operator()(Pressure pressure) const { trim(pressure); }
+};
+
+/// @brief Ask the trimmers to give memory back, lowest priority first
+/// @return Number of trimmers which were called
+///
+/// Under moderate pressure this stops once the counters are under half of
+/// the budget, or when there is no budget, once half of what they were
+/// using has been given back, but always calls at least the first trimmer
+/// as the pressure may be coming from memory which isn't counted. Under
+/// critical pressure every trimmer is called.
+size_t Trim(Pressure pressure);
+
+/// @brief Check how short of memory the system or the process's own limit is
+///
+/// Uses the operating system's low memory notifications where it has them,
+/// and on Linux the pressure stall information and cgroup limits. This is
+/// cheap enough to poll every few seconds.
+Pressure SystemPressure();
+
+/// Get the current usage of each name, sorted by name
+std::vector<Usage> Snapshot();
+
+/// Get the total bytes used by all counters
+size_t TotalBytes();
+
+/// @brief Set the total number of bytes all counters should try to stay under
+/// @param bytes Budget in bytes, or 0 for no budget
+void SetBudget(size_t bytes);
+
+/// Get the current budget in bytes, or 0 if there is none
+size_t GetBudget();
+
+/// @brief Are the counters over budget?
+///
+/// Caches should check this when deciding whether to grow and discard
+/// entries rather than allocating new ones while it is true.
+bool OverBudget();
+
+/// Write the current usage to the log
+void LogUsage();
+
+} }
@@ -16,6 +16,7 @@
 #include <boost/filesystem/path.hpp>
 #include <vector>
 
+#include <libaegisub/deferred_save.h>
 #include <libaegisub/exception.h>
 #include <libaegisub/fs_fwd.h>
 
@@ -36,6 +37,9 @@ DEFINE_EXCEPTION(MRUError, Exception);
 /// entry or update it if it already exists.
 ///
 /// If a file fails to open, Remove() should be called.
+///
+/// Changes are written to disk in the background; anything not yet written
+/// when the manager is destroyed is written by the destructor.
 class MRUManager {
 public:
 	/// @brief Map for time->value pairs.
@@ -72,7 +76,7 @@ public:
 	/// @exception MRUError thrown when an invalid key is used.
 	agi::fs::path const& GetEntry(const char *key, const size_t entry);
 
-	/// Write MRU lists to disk.
+	/// Write MRU lists to disk immediately.
 	void Flush();
 
 private:
@@ -85,6 +89,12 @@ private:
 	/// Internal MRUMap values.
 	std::array<MRUListMap, 7> mru;
 
+	/// Background writer for the config file
+	io::DeferredSave saver;
+
+	/// Build the JSON document written to the config file
+	json::Object Serialize() const;
+
 	/// @brief Load MRU Lists.
 	/// @param key List name.
 	/// @param array json::Array of values.
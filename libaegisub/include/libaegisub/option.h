@@ -25,6 +25,7 @@
 #include <vector>
 
 #include <libaegisub/fs_fwd.h>
+#include <libaegisub/signal.h>
 
 namespace json {
 	class UnknownElement;
@@ -33,6 +34,7 @@ namespace json {
 
 namespace agi {
 class OptionValue;
+namespace io { class DeferredSave; }
 
 class Options {
 public:
@@ -51,10 +53,26 @@ private:
 	/// Settings.
 	const OptionSetting setting;
 
+	/// Have any values changed since the config file was last read or written?
+	mutable bool dirty = true;
+
+	/// Change listeners on each value which set dirty
+	std::vector<agi::signal::Connection> value_connections;
+
+	/// Background writer used by FlushDeferred()
+	std::unique_ptr<io::DeferredSave> saver;
+
 	/// @brief Load a config file into the Options object.
 	/// @param config Config to load.
 	/// @param ignore_errors Log invalid entires in the option file and continue rather than throwing an exception
 	void LoadConfig(std::istream& stream, bool ignore_errors = false);
+	void LoadConfig(const char *data, size_t size, bool ignore_errors = false);
+
+	/// Subscribe to changes to all current values to track when a write is needed
+	void WatchValues();
+
+	/// Build the JSON document which is written to the user config file
+	json::Object Serialize() const;
 
 public:
 	/// @brief Constructor
@@ -94,6 +112,13 @@ public:
 
 	/// Write the user configuration to disk, throws an exception if something goes wrong.
 	void Flush() const;
+
+	/// @brief Write the user configuration to disk on a background thread
+	///
+	/// Does nothing if no options have changed since the last write. The
+	/// values are read on the calling thread, so the options may be modified
+	/// again as soon as this returns. Errors are logged rather than thrown.
+	void FlushDeferred();
 };
 
 } // namespace agi
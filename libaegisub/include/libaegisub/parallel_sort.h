@@ -0,0 +1,67 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file parallel_sort.h
+/// @brief Stable sorting on the background threads
+
+#pragma once
+
+#include <libaegisub/dispatch.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace agi {
+/// Stable sort a range, splitting it into chunks which are sorted on the
+/// background threads and then merged pairwise
+/// @param chunks Number of chunks to split the range into, or 0 to pick one
+///               based on the size of the range and the number of cores
+template<typename RandomIt, typename Compare>
+void ParallelStableSort(RandomIt begin, RandomIt end, Compare comp, size_t chunks = 0) {
+	const size_t size = end - begin;
+	if (chunks == 0) {
+		// Small chunks aren't worth handing to another thread
+		const size_t min_chunk = 16384;
+		chunks = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), size / min_chunk);
+	}
+	chunks = std::min(chunks, size);
+	if (chunks < 2) {
+		std::stable_sort(begin, end, comp);
+		return;
+	}
+
+	std::vector<size_t> bounds(chunks + 1);
+	for (size_t i = 0; i <= chunks; ++i)
+		bounds[i] = size * i / chunks;
+
+	dispatch::Parallel(chunks, [&](size_t i) {
+		std::stable_sort(begin + bounds[i], begin + bounds[i + 1], comp);
+	});
+
+	// inplace_merge keeps elements of the first range ahead of equal ones in
+	// the second, so merging neighbors preserves stability
+	for (size_t width = 1; width < chunks; width *= 2) {
+		dispatch::Parallel((chunks + width * 2 - 1) / (width * 2), [&](size_t i) {
+			const size_t lo = i * width * 2;
+			const size_t mid = std::min(lo + width, chunks);
+			const size_t hi = std::min(lo + width * 2, chunks);
+			if (mid < hi)
+				std::inplace_merge(begin + bounds[lo], begin + bounds[mid], begin + bounds[hi], comp);
+		});
+	}
+}
+}
@@ -0,0 +1,69 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file playback_clock.h
+/// @brief Mapping between wall clock time and media time during playback
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace agi {
+/// @class PlaybackClock
+/// @brief The media time being played at each point in wall clock time
+///
+/// Playback at any speed is a straight line from the point where it started,
+/// so the position can always be recomputed from the wall clock rather than
+/// accumulated from timer ticks, which would drift.
+class PlaybackClock {
+public:
+	using clock = std::chrono::steady_clock;
+
+private:
+	clock::time_point start_time;
+	int64_t start_ms = 0;
+	double speed = 1.0;
+
+public:
+	PlaybackClock() = default;
+
+	/// @param start_ms   Media time at which playback started
+	/// @param speed      Playback speed multiplier; must be positive
+	/// @param start_time Wall clock time at which playback started
+	PlaybackClock(int64_t start_ms, double speed, clock::time_point start_time);
+
+	/// Get the media time in milliseconds being played at the given time
+	int64_t MediaTime(clock::time_point t) const;
+
+	/// Get the wall clock time at which the given media time is played
+	clock::time_point WallTime(int64_t media_ms) const;
+
+	/// Continue from the position at the given time at a new speed
+	void SetSpeed(double new_speed, clock::time_point now);
+
+	double GetSpeed() const { return speed; }
+};
+
+/// Counts of how well frames kept up with the clock during playback
+struct PlaybackStats {
+	/// Frames which were shown
+	uint64_t presented = 0;
+	/// Frames which were skipped over because playback fell behind
+	uint64_t dropped = 0;
+	/// Frames which were shown after they should have been replaced
+	uint64_t late = 0;
+};
+}
@@ -0,0 +1,60 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file scene_change.h
+/// @brief Scene change detection for generating keyframes from video
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace agi {
+/// @class SceneChangeDetector
+/// @brief Finds the frames which start a new scene in a sequence of frames
+///
+/// Each frame is reduced to a small luma thumbnail and compared with the
+/// previous one. A frame starts a new scene when both the thumbnails and
+/// their luma histograms differ by a lot, so that motion within a scene,
+/// which changes the thumbnail but barely moves the histogram, is ignored.
+class SceneChangeDetector {
+public:
+	/// Width and height of the thumbnails in cells
+	static const int ThumbSize = 32;
+	/// Number of luma histogram bins
+	static const int HistogramBins = 16;
+
+private:
+	std::array<uint8_t, ThumbSize * ThumbSize> thumb, prev_thumb;
+	std::array<int, HistogramBins> hist, prev_hist;
+	bool has_previous = false;
+	int min_scene_length;
+	int frames_since_change = 0;
+
+	void MakeThumbnail(const uint8_t *bgra, ptrdiff_t row_step, int width, int height);
+
+public:
+	/// @param min_scene_length Minimum number of frames between scene changes
+	SceneChangeDetector(int min_scene_length = 4);
+
+	/// @brief Add the next frame
+	/// @param bgra     Top left pixel of the frame
+	/// @param row_step Bytes from one row to the row below; may be negative
+	/// @return Whether this frame starts a new scene, which is always true
+	///         for the first frame
+	bool AddFrame(const uint8_t *bgra, ptrdiff_t row_step, int width, int height);
+};
+}
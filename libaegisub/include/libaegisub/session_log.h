@@ -0,0 +1,75 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+/// @file session_log.h
+/// @brief Serialization of recorded command sessions
+/// @ingroup libaegisub
+
+#pragma once
+
+#include <libaegisub/exception.h>
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace agi {
+DEFINE_EXCEPTION(SessionLogError, Exception);
+
+/// One command run during a recorded session, along with the state it was
+/// run against
+struct SessionEvent {
+	/// Milliseconds since the recording was started
+	int64_t time = 0;
+	/// Name of the command
+	std::string command;
+	/// Row of the active line, or -1 if there was none
+	int active_row = -1;
+	/// Rows of the selected lines, in ascending order
+	std::vector<int> selection;
+	/// Video frame which was displayed, or -1 if no video was open
+	int video_frame = -1;
+};
+
+/// Information about what a session was recorded against
+struct SessionHeader {
+	/// Subtitle file which was open when recording started
+	std::string subtitles;
+	/// Video file which was open when recording started
+	std::string video;
+};
+
+/// A recorded session
+struct SessionLog {
+	SessionHeader header;
+	std::vector<SessionEvent> events;
+};
+
+/// Write the header line of a session log
+void WriteSessionHeader(std::ostream &out, SessionHeader const& header);
+
+/// Write a single event as one line of a session log
+///
+/// Events are written one per line and flushed immediately so that a session
+/// which ends in a crash is still replayable up to the crash.
+void WriteSessionEvent(std::ostream &out, SessionEvent const& event);
+
+/// Read a session log written by WriteSessionHeader and WriteSessionEvent
+///
+/// Throws SessionLogError if the header is missing or invalid. Event lines
+/// which cannot be parsed, such as a partially written final line, are
+/// skipped.
+SessionLog ReadSessionLog(std::istream &in);
+}
@@ -0,0 +1,72 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file slab_pool.h
+/// @brief Allocator for large numbers of same-sized objects
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace agi {
+/// @class SlabPool
+/// @brief Thread-safe allocator for objects of a single size
+///
+/// Memory is taken from the system in slabs holding many objects at once,
+/// which double in size as the pool grows, and freed objects are kept on a
+/// free list for reuse. This makes allocating and freeing the objects
+/// little more than a pointer swap, and keeps objects created together
+/// next to each other in memory. All but the first slab are returned to the
+/// system once every object in the pool has been freed.
+class SlabPool {
+	struct FreeNode {
+		FreeNode *next;
+	};
+
+	size_t object_size;
+	size_t next_slab_objects;
+
+	std::mutex mutex;
+	FreeNode *free_list = nullptr;
+	std::vector<std::unique_ptr<char[]>> slabs;
+	/// Number of objects in the first slab
+	size_t first_slab_objects;
+	size_t live = 0;
+
+	/// Add every object in a slab to the free list
+	void PushSlab(char *slab, size_t count);
+	void AddSlab();
+
+public:
+	/// @param object_size Size of each object in bytes
+	/// @param first_slab  Number of objects in the first slab
+	explicit SlabPool(size_t object_size, size_t first_slab = 256);
+	SlabPool(SlabPool const&) = delete;
+	SlabPool& operator=(SlabPool const&) = delete;
+
+	/// Allocate memory for one object, suitably aligned for any type
+	void *Allocate();
+	/// Return memory from Allocate() to the pool
+	void Free(void *ptr);
+
+	/// Number of objects currently allocated
+	size_t Live();
+	/// Number of slabs currently held
+	size_t SlabCount();
+};
+}
@@ -0,0 +1,71 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file spelling_cache.h
+/// @brief Thread-safe memoization of spellchecker results
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace agi {
+/// @class SpellingCache
+/// @brief Remembers whether or not each word checked is spelled correctly
+///
+/// Lookups may happen from any number of threads at once. The words are
+/// split between several independently locked maps so that threads checking
+/// different words rarely wait on each other, and no lock is held while
+/// the actual check runs.
+class SpellingCache {
+	struct Shard {
+		std::mutex mutex;
+		std::unordered_map<std::string, bool> words;
+	};
+	std::array<Shard, 16> shards;
+
+	/// Incremented by Clear() so that checks which were already running when
+	/// it was called don't add a possibly outdated result
+	std::atomic<size_t> generation{0};
+
+	/// Maximum number of words to remember per shard
+	size_t shard_capacity;
+
+	Shard& ShardFor(std::string const& word) {
+		return shards[std::hash<std::string>()(word) % shards.size()];
+	}
+
+public:
+	/// @param capacity Roughly how many words to remember before starting over
+	SpellingCache(size_t capacity = 1 << 16) : shard_capacity(capacity / 16 + 1) { }
+
+	/// Look up the spelling of a word, calling check if it isn't known
+	/// @param word Word to check
+	/// @param check Function which checks a word which isn't in the cache
+	/// @return Is the word spelled correctly?
+	bool Check(std::string const& word, std::function<bool (std::string const&)> const& check);
+
+	/// Forget all results, such as after the dictionary has changed
+	void Clear();
+
+	/// Number of words currently remembered
+	size_t size();
+};
+}
@@ -0,0 +1,92 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file trace.h
+/// @brief Scoped timing zones which can be recorded and saved as a Chrome trace
+///
+/// Put AGI_TRACE_ZONE("category", "Name") at the top of a scope to record how
+/// long the scope takes while a recording is in progress. When nothing is
+/// being recorded a zone costs a single relaxed atomic load, and building
+/// with AGI_NO_TRACE defined removes them entirely.
+///
+/// The category and name must be string literals or otherwise outlive the
+/// recording, as only the pointers are stored.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+
+namespace agi {
+namespace trace {
+namespace detail {
+extern std::atomic<bool> recording;
+int64_t Now();
+void Record(const char *category, const char *name, int64_t start, int64_t end);
+}
+
+/// Is a recording in progress?
+inline bool IsRecording() { return detail::recording.load(std::memory_order_relaxed); }
+
+/// Is tracing compiled in?
+bool IsAvailable();
+
+/// Discard any previous recording and start a new one
+void Start();
+
+/// Stop recording; the recorded events are kept until the next Start()
+void Stop();
+
+/// Name the calling thread in written traces
+void SetThreadName(const char *name);
+
+/// Write the events from the last recording in the Chrome trace event
+/// format, which can be opened in chrome://tracing or ui.perfetto.dev
+/// @return Number of events written
+size_t Write(std::ostream &out);
+
+/// Records the lifetime of the object as a zone; use AGI_TRACE_ZONE
+class Zone {
+	const char *category;
+	const char *name = nullptr;
+	int64_t start;
+
+public:
+	Zone(const char *category, const char *name) : category(category) {
+		if (IsRecording()) {
+			this->name = name;
+			start = detail::Now();
+		}
+	}
+
+	~Zone() {
+		if (name)
+			detail::Record(category, name, start, detail::Now());
+	}
+
+	Zone(Zone const&) = delete;
+	Zone& operator=(Zone const&) = delete;
+};
+}
+}
+
+#ifdef AGI_NO_TRACE
+#define AGI_TRACE_ZONE(category, name) static_cast<void>(0)
+#else
+#define AGI_TRACE_CONCAT_(a, b) a##b
+#define AGI_TRACE_CONCAT(a, b) AGI_TRACE_CONCAT_(a, b)
+#define AGI_TRACE_ZONE(category, name) agi::trace::Zone AGI_TRACE_CONCAT(agi_trace_zone_, __LINE__)(category, name)
+#endif
@@ -15,6 +15,7 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 #include <vector>
 
 #include <libaegisub/exception.h>
@@ -67,14 +68,25 @@ class Framerate {
 	/// rounding past the end of the final override range.
 	int64_t last = 0;
 
+	/// Compactly stored list of frame start times
+	class Timecodes;
+
 	/// Start time in milliseconds of each frame
-	std::vector<int> timecodes;
+	///
+	/// This is never modified after construction, so copies of a Framerate
+	/// share it rather than copying every frame's time.
+	std::shared_ptr<const Timecodes> timecodes;
 
 	/// Does this frame rate need drop frames and have them enabled?
 	bool drop = false;
 
-	/// Set FPS properties from the timecodes vector
-	void SetFromTimecodes();
+	/// Set the timecodes and FPS properties from a list of frame times
+	void SetFromTimecodes(std::vector<int> const& times);
+
+	/// FrameAtTime() which searches for the frame outwards from a guess
+	/// @param hint Index of the frame to start searching from, updated to
+	///             the frame found if it is within the timecodes
+	int FrameAtTime(int ms, Time type, size_t& hint) const;
 public:
 	Framerate(Framerate const&) = default;
 	Framerate& operator=(Framerate const&) = default;
@@ -117,6 +129,16 @@ public:
 	/// start/end time would first/last be visible
 	int FrameAtTime(int ms, Time type = EXACT) const;
 
+	/// @brief Get the frame visible at each of several times
+	/// @param times Times in milliseconds
+	/// @param type Time mode
+	/// @return The frame for each time, as FrameAtTime() would give
+	///
+	/// Each search starts from the frame found for the previous time, so this
+	/// is much faster than calling FrameAtTime() for each time when the times
+	/// are sorted or nearly so. Any order gives correct results.
+	std::vector<int> FramesAtTimes(std::vector<int> const& times, Time type = EXACT) const;
+
 	/// @brief Get the time at a given frame
 	/// @param frame Frame number
 	/// @param type Time mode
@@ -193,7 +215,7 @@ public:
 	void Save(fs::path const& file, int length = -1) const;
 
 	/// Is this frame rate possibly variable?
-	bool IsVFR() const {return timecodes.size() > 1; }
+	bool IsVFR() const;
 
 	/// Does this represent a valid frame rate?
 	bool IsLoaded() const { return numerator > 0; }
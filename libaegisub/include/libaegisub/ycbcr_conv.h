@@ -81,6 +81,11 @@ public:
 		return to_uint8_t(prod(from_ycbcr, add(input, shift_from)));
 	}
 
+	/// Matrix and offsets ycbcr_to_rgb() uses, for converting whole frames
+	/// with something faster than doing it a pixel at a time
+	std::array<double, 9> const& ycbcr_to_rgb_matrix() const { return from_ycbcr; }
+	std::array<double, 3> const& ycbcr_to_rgb_shift() const { return shift_from; }
+
 	/// Convert rgb to ycbcr using src_mat and then back using dst_mat
 	std::array<uint8_t, 3> rgb_to_rgb(std::array<uint8_t, 3> input) const {
 		return to_uint8_t(prod(from_ycbcr,
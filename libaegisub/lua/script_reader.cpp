@@ -17,14 +17,163 @@
 #include "libaegisub/lua/script_reader.h"
 
 #include "libaegisub/file_mapping.h"
+#include "libaegisub/fs.h"
+#include "libaegisub/io.h"
 #include "libaegisub/log.h"
 #include "libaegisub/lua/utils.h"
 #include "libaegisub/split.h"
 
 #include <boost/algorithm/string/replace.hpp>
+#include <cstddef>
+#include <cstring>
+#include <istream>
+#include <iterator>
 #include <lauxlib.h>
+#include <luajit.h>
+#include <ostream>
+#include <xxhash.h>
+
+namespace {
+	using namespace agi::lua;
+
+	/// Directory compiled scripts are cached in, or empty if caching is disabled
+	agi::fs::path cache_dir;
+
+	const char cache_magic[8] = {'A', 'G', 'I', 'L', 'U', 'A', 'C', '1'};
+
+	/// Header of a cached compiled script, followed by the MoonScript line
+	/// table entries and then the bytecode
+	struct CacheHeader {
+		char magic[8];
+		uint32_t luajit_version;
+		uint32_t pointer_size;
+		uint64_t source_hash;
+		int64_t source_mtime;
+		uint64_t source_size;
+		uint32_t line_count;
+	};
+
+	struct LineEntry {
+		int32_t lua_line;
+		int32_t moon_pos;
+	};
+
+	CacheHeader MakeHeader(const char *buff, size_t size, agi::fs::path const& filename) {
+		CacheHeader header;
+		memset(&header, 0, sizeof header);
+		memcpy(header.magic, cache_magic, sizeof cache_magic);
+		header.luajit_version = LUAJIT_VERSION_NUM;
+		header.pointer_size = sizeof(void *);
+		header.source_hash = XXH3_64bits(buff, size);
+		header.source_mtime = agi::fs::ModifiedTime(filename);
+		header.source_size = size;
+		return header;
+	}
+
+	agi::fs::path CachePath(agi::fs::path const& filename) {
+		auto const& str = filename.string();
+		return cache_dir/(std::to_string(XXH3_64bits(str.data(), str.size())) + ".luac");
+	}
+
+	/// Push moonscript's table mapping Lua line numbers to source offsets
+	bool PushLineTables(lua_State *L) {
+		if (luaL_dostring(L, "return require 'moonscript.line_tables'")) {
+			lua_pop(L, 1);
+			return false;
+		}
+		return true;
+	}
+
+	int DumpWriter(lua_State *, const void *p, size_t sz, void *ud) {
+		static_cast<std::string *>(ud)->append(static_cast<const char *>(p), sz);
+		return 0;
+	}
+
+	/// Try to load the cached compiled version of a script
+	/// @return Was a valid cached version found and loaded
+	bool LoadCached(lua_State *L, CacheHeader const& expected, agi::fs::path const& filename, bool is_moon) {
+		std::string data;
+		try {
+			auto stream = agi::io::Open(CachePath(filename), true);
+			data.assign(std::istreambuf_iterator<char>(*stream), std::istreambuf_iterator<char>());
+		}
+		catch (agi::Exception const&) {
+			return false;
+		}
+
+		CacheHeader header;
+		if (data.size() < sizeof header) return false;
+		memcpy(&header, data.data(), sizeof header);
+		if (memcmp(&header, &expected, offsetof(CacheHeader, line_count)) != 0)
+			return false;
+
+		size_t bytecode_pos = sizeof header + header.line_count * sizeof(LineEntry);
+		if (data.size() <= bytecode_pos) return false;
+
+		// If the bytecode was written by an incompatible build of LuaJIT this
+		// fails and the script is just compiled again
+		if (luaL_loadbuffer(L, &data[bytecode_pos], data.size() - bytecode_pos, filename.string().c_str())) {
+			lua_pop(L, 1);
+			return false;
+		}
+
+		if (is_moon && PushLineTables(L)) {
+			push_value(L, filename);
+			lua_createtable(L, header.line_count, 0);
+			for (uint32_t i = 0; i < header.line_count; ++i) {
+				LineEntry entry;
+				memcpy(&entry, &data[sizeof header + i * sizeof entry], sizeof entry);
+				push_value(L, entry.moon_pos);
+				lua_rawseti(L, -2, entry.lua_line);
+			}
+			lua_rawset(L, -3);
+			lua_pop(L, 1);
+		}
+		return true;
+	}
+
+	/// Write the compiled function on the top of the stack to the cache
+	void StoreCached(lua_State *L, CacheHeader header, agi::fs::path const& filename, bool is_moon) {
+		std::string bytecode;
+		if (lua_dump(L, DumpWriter, &bytecode) || bytecode.empty())
+			return;
+
+		std::vector<LineEntry> lines;
+		if (is_moon && PushLineTables(L)) {
+			push_value(L, filename);
+			lua_rawget(L, -2);
+			if (lua_istable(L, -1)) {
+				lua_pushnil(L);
+				while (lua_next(L, -2)) {
+					if (lua_type(L, -2) == LUA_TNUMBER && lua_type(L, -1) == LUA_TNUMBER)
+						lines.push_back({static_cast<int32_t>(lua_tointeger(L, -2)), static_cast<int32_t>(lua_tointeger(L, -1))});
+					lua_pop(L, 1);
+				}
+			}
+			lua_pop(L, 2);
+		}
+		header.line_count = static_cast<uint32_t>(lines.size());
+
+		try {
+			agi::fs::CreateDirectory(cache_dir);
+			agi::io::Save file(CachePath(filename), true);
+			auto& out = file.Get();
+			out.write(reinterpret_cast<const char *>(&header), sizeof header);
+			if (!lines.empty())
+				out.write(reinterpret_cast<const char *>(lines.data()), lines.size() * sizeof(LineEntry));
+			out.write(bytecode.data(), bytecode.size());
+		}
+		catch (agi::Exception const& e) {
+			LOG_W("auto4/lua/cache") << "Failed to cache compiled script " << filename << ": " << e.GetMessage();
+		}
+	}
+}
 
 namespace agi { namespace lua {
+	void SetCacheDirectory(agi::fs::path const& dir) {
+		cache_dir = dir;
+	}
+
 	bool LoadFile(lua_State *L, agi::fs::path const& raw_filename) {
 		auto filename = raw_filename;
 		try {
@@ -44,8 +193,31 @@ namespace agi { namespace lua {
 			size -= 3;
 		}
 
-		if (!agi::fs::HasExtension(filename, "moon"))
-			return luaL_loadbuffer(L, buff, size, filename.string().c_str()) == 0;
+		const bool is_moon = agi::fs::HasExtension(filename, "moon");
+
+		// Each cache entry depends only on the file's own contents, as
+		// anything it requires is loaded and cached separately when the
+		// compiled chunk runs
+		CacheHeader header{};
+		const bool use_cache = !cache_dir.empty();
+		if (use_cache) {
+			header = MakeHeader(buff, size, filename);
+			if (LoadCached(L, header, filename, is_moon)) {
+				if (is_moon) {
+					lua_pushlstring(L, buff, size);
+					lua_setfield(L, LUA_REGISTRYINDEX, ("raw moonscript: " + filename.string()).c_str());
+				}
+				return true;
+			}
+		}
+
+		if (!is_moon) {
+			if (luaL_loadbuffer(L, buff, size, filename.string().c_str()))
+				return false;
+			if (use_cache)
+				StoreCached(L, header, filename, false);
+			return true;
+		}
 
 		// We have a MoonScript file, so we need to load it with that
 		// It might be nice to have a dedicated lua state for compiling
@@ -69,6 +241,8 @@ namespace agi { namespace lua {
 		}
 
 		lua_pop(L, 1); // Remove the extra nil for the stackchecker
+		if (use_cache)
+			StoreCached(L, header, filename, true);
 		return true;
 	}
 
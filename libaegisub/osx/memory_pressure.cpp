@@ -0,0 +1,57 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+/// @file memory_pressure.cpp
+/// @brief Memory pressure on macOS, from dispatch memory pressure events
+/// @ingroup libaegisub osx
+
+#include "libaegisub/memory_usage.h"
+
+#include <dispatch/dispatch.h>
+
+namespace {
+using agi::memory::Pressure;
+
+/// Most recent level reported by the dispatch source
+std::atomic<Pressure> level{Pressure::None};
+
+void on_memory_pressure(void *context) {
+	const auto flags = dispatch_source_get_data(static_cast<dispatch_source_t>(context));
+	if (flags & DISPATCH_MEMORYPRESSURE_CRITICAL)
+		level = Pressure::Critical;
+	else if (flags & DISPATCH_MEMORYPRESSURE_WARN)
+		level = Pressure::Moderate;
+	else
+		level = Pressure::None;
+}
+}
+
+namespace agi { namespace memory {
+Pressure SystemPressure() {
+	// The system only says when the level changes, so the source is set
+	// up the first time anything asks and kept for as long as the app runs
+	static dispatch_source_t source = [] {
+		auto source = dispatch_source_create(DISPATCH_SOURCE_TYPE_MEMORYPRESSURE, 0,
+			DISPATCH_MEMORYPRESSURE_NORMAL | DISPATCH_MEMORYPRESSURE_WARN | DISPATCH_MEMORYPRESSURE_CRITICAL,
+			dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0));
+		if (source) {
+			dispatch_set_context(source, source);
+			dispatch_source_set_event_handler_f(source, on_memory_pressure);
+			dispatch_resume(source);
+		}
+		return source;
+	}();
+	return source ? level.load() : Pressure::None;
+}
+} }
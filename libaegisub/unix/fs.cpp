@@ -16,15 +16,22 @@
 
 #include "libaegisub/access.h"
 #include "libaegisub/fs.h"
-#include "libaegisub/io.h"
 
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/path.hpp>
+#include <boost/version.hpp>
 #include <fcntl.h>
 #include <fnmatch.h>
 #include <istream>
 #include <sys/time.h>
 
+#ifdef __linux__
+#include <sys/vfs.h>
+#else
+#include <sys/mount.h>
+#include <sys/param.h>
+#endif
+
 namespace bfs = boost::filesystem;
 
 namespace agi { namespace fs {
@@ -42,13 +49,46 @@ void Touch(path const& file) {
 	}
 }
 
+bool IsNetworkPath(path const& p) {
+	struct statfs info;
+	if (statfs(p.c_str(), &info))
+		return false;
+#ifdef __linux__
+	switch (static_cast<unsigned long>(info.f_type)) {
+		case 0x6969:     // NFS
+		case 0x517B:     // SMB
+		case 0xFF534D42: // CIFS
+		case 0xFE534D42: // SMB2
+		case 0x564C:     // NCP
+		case 0x5346414F: // AFS
+		case 0x73757245: // Coda
+		case 0x00C36400: // Ceph
+			return true;
+		default:
+			return false;
+	}
+#else
+	return !(info.f_flags & MNT_LOCAL);
+#endif
+}
+
 void Copy(fs::path const& from, fs::path const& to) {
 	acs::CheckFileRead(from);
 	CreateDirectory(to.parent_path());
 	acs::CheckDirWrite(to.parent_path());
 
-	auto in = io::Open(from, true);
-	io::Save(to).Get() << in->rdbuf();
+	// boost hands the copy to the kernel where it can (copy_file_range or
+	// sendfile on Linux), which skips bouncing the data through a userspace
+	// buffer and lets filesystems which support it clone the file or do a
+	// server-side copy
+	boost::system::error_code ec;
+#if BOOST_VERSION >= 107400
+	bfs::copy_file(from, to, bfs::copy_options::overwrite_existing, ec);
+#else
+	bfs::copy_file(from, to, bfs::copy_option::overwrite_if_exists, ec);
+#endif
+	if (ec)
+		throw FileSystemUnknownError(ec.message());
 }
 
 struct DirectoryIterator::PrivData {
@@ -0,0 +1,157 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+/// @file memory_pressure.cpp
+/// @brief Memory pressure on Linux, from pressure stall information and cgroup limits
+/// @ingroup libaegisub unix
+
+#include <libaegisub/memory_usage.h>
+
+#ifdef __linux__
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace {
+using agi::memory::Pressure;
+
+std::string read_file(std::string const& path) {
+	std::ifstream file(path);
+	if (!file) return {};
+	std::stringstream ss;
+	ss << file.rdbuf();
+	return ss.str();
+}
+
+/// Get the value of a "key value" line, such as in memory.stat or
+/// /proc/meminfo, or -1 if it isn't there
+long long read_field(std::string const& contents, std::string const& key) {
+	std::istringstream lines(contents);
+	std::string line;
+	while (getline(lines, line)) {
+		if (line.compare(0, key.size(), key) == 0 && line.size() > key.size() && (line[key.size()] == ' ' || line[key.size()] == ':'))
+			return std::strtoll(line.c_str() + key.size() + 1, nullptr, 10);
+	}
+	return -1;
+}
+
+/// @brief Pressure from a pressure stall information file
+///
+/// "some" is the share of the last ten seconds in which at least one task
+/// was waiting on memory, and "full" the share in which all of them were.
+Pressure stall_pressure(std::string const& psi) {
+	Pressure ret = Pressure::None;
+	std::istringstream lines(psi);
+	std::string kind, avg10;
+	while (lines >> kind >> avg10) {
+		lines.ignore(256, '\n');
+		if (avg10.compare(0, 6, "avg10=") != 0) continue;
+		const double stalled = std::strtod(avg10.c_str() + 6, nullptr);
+		if (kind == "full" && stalled >= 10.)
+			ret = Pressure::Critical;
+		else if (kind == "some" && stalled >= 10. && ret == Pressure::None)
+			ret = Pressure::Moderate;
+	}
+	return ret;
+}
+
+Pressure usage_pressure(double used, double limit) {
+	if (limit <= 0) return Pressure::None;
+	if (used >= limit * .95) return Pressure::Critical;
+	if (used >= limit * .85) return Pressure::Moderate;
+	return Pressure::None;
+}
+
+/// Where a version of cgroups keeps the memory controller's files
+struct CgroupLayout {
+	const char *root, *limit, *usage, *inactive;
+	/// Prefix of the process's line in /proc/self/cgroup
+	const char *prefix;
+};
+const CgroupLayout cgroup_v2{"/sys/fs/cgroup", "memory.max", "memory.current", "inactive_file", "0::"};
+const CgroupLayout cgroup_v1{"/sys/fs/cgroup/memory", "memory.limit_in_bytes", "memory.usage_in_bytes", "total_inactive_file", ":memory:"};
+
+/// Directory of the process's cgroup using the given layout, or empty if it
+/// isn't in one
+std::string cgroup_dir(CgroupLayout const& layout) {
+	std::istringstream lines(read_file("/proc/self/cgroup"));
+	std::string line;
+	while (getline(lines, line)) {
+		// v1 lines start with the hierarchy's number, which varies
+		const size_t pos = line.find(layout.prefix);
+		if (pos == 0 || (pos != std::string::npos && layout.prefix[0] == ':'))
+			return layout.root + line.substr(pos + strlen(layout.prefix));
+	}
+	return {};
+}
+
+/// @brief Pressure from how close the cgroup and its parents are to their limits
+///
+/// Reclaimable page cache counts towards the usage but is dropped before
+/// anything is killed, so it's left out. cgroups v1 reports no limit as a
+/// huge number rather than "max", which is always far from the usage.
+Pressure cgroup_pressure(CgroupLayout const& layout, std::string dir) {
+	Pressure ret = Pressure::None;
+	for (; dir.size() > strlen(layout.root); dir.erase(dir.rfind('/'))) {
+		const std::string max = read_file(dir + "/" + layout.limit);
+		if (max.empty() || max.compare(0, 3, "max") == 0) continue;
+
+		const long long limit = std::strtoll(max.c_str(), nullptr, 10);
+		long long used = std::strtoll(read_file(dir + "/" + layout.usage).c_str(), nullptr, 10);
+		const long long inactive = read_field(read_file(dir + "/memory.stat"), layout.inactive);
+		if (inactive > 0)
+			used -= std::min(used, inactive);
+		ret = std::max(ret, usage_pressure(static_cast<double>(used), static_cast<double>(limit)));
+	}
+	return ret;
+}
+}
+
+namespace agi { namespace memory {
+Pressure SystemPressure() {
+	static const std::string cgroup = cgroup_dir(cgroup_v2);
+	static const std::string cgroup_memory = cgroup_dir(cgroup_v1);
+
+	Pressure ret = Pressure::None;
+	if (!cgroup.empty())
+		ret = std::max(cgroup_pressure(cgroup_v2, cgroup), stall_pressure(read_file(cgroup + "/memory.pressure")));
+	if (!cgroup_memory.empty())
+		ret = std::max(ret, cgroup_pressure(cgroup_v1, cgroup_memory));
+
+	// Kernels without pressure stall information only have the amount
+	// available to go on
+	const std::string psi = read_file("/proc/pressure/memory");
+	if (!psi.empty())
+		return std::max(ret, stall_pressure(psi));
+
+	const std::string meminfo = read_file("/proc/meminfo");
+	const long long total = read_field(meminfo, "MemTotal");
+	const long long available = read_field(meminfo, "MemAvailable");
+	if (total > 0 && available >= 0) {
+		const Pressure left = available < total / 20 ? Pressure::Critical
+			: available < total / 10 ? Pressure::Moderate
+			: Pressure::None;
+		ret = std::max(ret, left);
+	}
+	return ret;
+}
+} }
+#else
+namespace agi { namespace memory {
+Pressure SystemPressure() { return Pressure::None; }
+} }
+#endif
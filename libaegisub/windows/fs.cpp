@@ -63,6 +63,20 @@ void Touch(path const& file) {
 		throw EnvironmentError("SetFileTime failed with error: " + util::ErrorString(GetLastError()));
 }
 
+bool IsNetworkPath(path const& p) {
+	auto str = p.wstring();
+	// UNC paths, either \\server\share or \\?\UNC\server\share
+	if (str.size() >= 2 && str[0] == L'\\' && str[1] == L'\\' && str.compare(0, 4, L"\\\\?\\") != 0)
+		return true;
+	if (str.compare(0, 8, L"\\\\?\\UNC\\") == 0)
+		return true;
+
+	wchar_t root[MAX_PATH];
+	if (!GetVolumePathNameW(str.c_str(), root, MAX_PATH))
+		return false;
+	return GetDriveTypeW(root) == DRIVE_REMOTE;
+}
+
 void Copy(fs::path const& from, fs::path const& to) {
 	CreateDirectory(to.parent_path());
 
@@ -0,0 +1,40 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+/// @file memory_pressure.cpp
+/// @brief Memory pressure on Windows, from memory resource notifications
+/// @ingroup libaegisub windows
+
+#include "libaegisub/memory_usage.h"
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+namespace agi { namespace memory {
+Pressure SystemPressure() {
+	// Signalled by the memory manager when the system is low on physical
+	// memory; never closed as it's needed for as long as the app runs
+	static HANDLE low_memory = CreateMemoryResourceNotification(LowMemoryResourceNotification);
+
+	BOOL low = FALSE;
+	if (low_memory && QueryMemoryResourceNotification(low_memory, &low) && low)
+		return Pressure::Critical;
+
+	MEMORYSTATUSEX status;
+	status.dwLength = sizeof(status);
+	if (GlobalMemoryStatusEx(&status) && status.dwMemoryLoad >= 90)
+		return Pressure::Moderate;
+	return Pressure::None;
+}
+} }
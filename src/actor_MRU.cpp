@@ -1,8 +1,7 @@
 // [actor_MRU] BEGIN
 #include "actor_MRU.h"
 
-#include "ass_dialogue.h"
-#include "ass_file.h"
+#include "actor_index.h"
 #include "compat.h"
 #include "subs_edit_box.h"
 #include "utils.h"
@@ -254,7 +253,7 @@ void ActorMRUManager::SetFastModeEnabled(bool enabled) {
 	UpdateWindowVisibility();
 }
 
-void ActorMRUManager::OnActorCommitted(wxString const& new_actor, wxString const& old_actor, AssFile *subs) {
+void ActorMRUManager::OnActorCommitted(wxString const& new_actor, wxString const& old_actor, ActorIndex const *actors) {
 	if (!fast_mode_enabled_)
 		return;
 
@@ -264,7 +263,7 @@ void ActorMRUManager::OnActorCommitted(wxString const& new_actor, wxString const
 		ResetSelection();
 	}
 	else {
-		RemoveIfUnused(old_actor, subs);
+		RemoveIfUnused(old_actor, actors);
 	}
 	RefreshWindow();
 	ShowWindow();
@@ -509,16 +508,13 @@ void ActorMRUManager::PromoteName(wxString const& name) {
 	TrimList();
 }
 
-void ActorMRUManager::RemoveIfUnused(wxString const& actor, AssFile *subs) {
+void ActorMRUManager::RemoveIfUnused(wxString const& actor, ActorIndex const *actors) {
 	wxString normalized = Normalize(actor);
-	if (normalized.empty() || !subs)
+	if (normalized.empty() || !actors)
 		return;
 
-	for (auto const& entry : subs->Events) {
-		wxString candidate = Normalize(to_wx(entry.Actor));
-		if (candidate == normalized)
-			return;
-	}
+	if (actors->IsUsed(from_wx(normalized)))
+		return;
 
 	auto it = std::remove_if(names_.begin(), names_.end(), [&](wxString const& entry) {
 		return Normalize(entry) == normalized;
@@ -16,7 +16,7 @@
 #include <wx/window.h>
 #include <wx/string.h>
 
-class AssFile;
+class ActorIndex;
 class SubsEditBox;
 class wxButton;
 class wxComboBox;
@@ -38,7 +38,7 @@ public:
 	bool IsWindowVisible() const { return window_visible_; }
 
 	/// Update MRU data when a line is committed in fast mode.
-	void OnActorCommitted(wxString const& new_actor, wxString const& old_actor, AssFile *subs);
+	void OnActorCommitted(wxString const& new_actor, wxString const& old_actor, ActorIndex const *actors);
 
 	void OnActorFocusChanged(bool has_focus);
 	void UpdateWindowVisibility();
@@ -74,7 +74,7 @@ private:
 	wxString GetSelectedName() const;
 	wxString Normalize(wxString const& value) const;
 	void PromoteName(wxString const& name);
-	void RemoveIfUnused(wxString const& actor, AssFile *subs);
+	void RemoveIfUnused(wxString const& actor, ActorIndex const *actors);
 	void TrimList();
 	void ResetSelection();
 
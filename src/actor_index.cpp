@@ -0,0 +1,120 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include "actor_index.h"
+
+#include "ass_dialogue.h"
+#include "ass_file.h"
+#include "include/aegisub/context.h"
+
+#include <libaegisub/trace.h>
+
+#include <algorithm>
+
+ActorIndex::ActorIndex(agi::Context *c)
+: context(c)
+, pre_commit_listener(c->ass->AddPreCommitListener(&ActorIndex::OnPreCommit, this))
+{
+	UpdateAll();
+}
+
+std::string ActorIndex::Trim(std::string const& actor) {
+	// The same characters as wxString::Trim()
+	const char *whitespace = " \t\n\r\v\f";
+	size_t start = actor.find_first_not_of(whitespace);
+	if (start == std::string::npos) return "";
+	return actor.substr(start, actor.find_last_not_of(whitespace) - start + 1);
+}
+
+void ActorIndex::OnPreCommit(int type, const AssDialogue *single_line) {
+	AGI_TRACE_ZONE("commit", "ActorIndex");
+	if (type != AssFile::COMMIT_NEW && !(type & (AssFile::COMMIT_DIAG_ADDREM | AssFile::COMMIT_DIAG_META)))
+		return;
+
+	if (single_line && type != AssFile::COMMIT_NEW && !(type & AssFile::COMMIT_DIAG_ADDREM))
+		Update(*single_line);
+	else
+		UpdateAll();
+}
+
+void ActorIndex::Add(agi::Interned<std::string> const& actor, int count, int uncommented) {
+	auto it = raw.find(actor);
+	if (it == raw.end()) {
+		if (count < 0) return;
+		it = raw.emplace(actor, RawUsage{}).first;
+		it->second.trimmed = &trimmed[Trim(actor)];
+	}
+
+	auto& usage = it->second;
+	const bool was_named = usage.trimmed->uncommented > 0;
+	usage.usage.lines += count;
+	usage.usage.uncommented += uncommented;
+	usage.trimmed->lines += count;
+	usage.trimmed->uncommented += uncommented;
+	if (was_named != (usage.trimmed->uncommented > 0))
+		++version;
+
+	if (usage.usage.lines == 0) {
+		if (usage.trimmed->lines == 0)
+			trimmed.erase(Trim(actor));
+		raw.erase(it);
+	}
+}
+
+void ActorIndex::Update(AssDialogue const& line) {
+	auto& counted = lines[line.Id];
+	counted.generation = generation;
+	if (counted.actor == line.Actor && counted.comment == line.Comment)
+		return;
+
+	if (!counted.actor.get().empty())
+		Add(counted.actor, -1, counted.comment ? 0 : -1);
+	counted.actor = line.Actor;
+	counted.comment = line.Comment;
+	if (!counted.actor.get().empty())
+		Add(counted.actor, 1, counted.comment ? 0 : 1);
+}
+
+void ActorIndex::UpdateAll() {
+	++generation;
+	for (auto const& line : context->ass->Events)
+		Update(line);
+
+	// Lines which weren't seen have been deleted
+	for (auto it = lines.begin(); it != lines.end(); ) {
+		if (it->second.generation == generation)
+			++it;
+		else {
+			if (!it->second.actor.get().empty())
+				Add(it->second.actor, -1, it->second.comment ? 0 : -1);
+			it = lines.erase(it);
+		}
+	}
+}
+
+bool ActorIndex::IsUsed(std::string const& actor) const {
+	auto it = trimmed.find(Trim(actor));
+	return it != trimmed.end() && it->second.lines > 0;
+}
+
+std::vector<std::string> ActorIndex::Names() const {
+	std::vector<std::string> names;
+	for (auto const& usage : trimmed) {
+		if (usage.second.uncommented > 0 && !usage.first.empty())
+			names.push_back(usage.first);
+	}
+	sort(begin(names), end(names));
+	return names;
+}
@@ -0,0 +1,92 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file actor_index.h
+/// @brief Count of the lines using each actor name
+
+#pragma once
+
+#include <libaegisub/interned.h>
+#include <libaegisub/signal.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class AssDialogue;
+namespace agi { struct Context; }
+
+/// @class ActorIndex
+/// @brief Knows how many lines use each actor name
+///
+/// Names are compared with surrounding whitespace trimmed. The counts are
+/// updated before each commit is announced, from just the committed line
+/// when only one line changed, so anything listening for commits can look
+/// actors up without going over every line of the file.
+class ActorIndex {
+	struct Usage {
+		/// Number of lines with this actor
+		int lines = 0;
+		/// Number of those lines which aren't comments
+		int uncommented = 0;
+	};
+
+	/// Usage of each distinct actor as written, which points at the usage of
+	/// its trimmed form so that only new actors have to be trimmed
+	struct RawUsage {
+		Usage usage;
+		Usage *trimmed = nullptr;
+	};
+
+	/// What each line was counted as, by line ID
+	struct Counted {
+		agi::Interned<std::string> actor;
+		bool comment = false;
+		/// Pass over the whole file which last saw the line
+		size_t generation = 0;
+	};
+
+	agi::Context *context;
+	std::unordered_map<int, Counted> lines;
+	std::unordered_map<agi::Interned<std::string>, RawUsage> raw;
+	std::unordered_map<std::string, Usage> trimmed;
+	size_t generation = 0;
+	/// Incremented whenever the result of Names() may have changed
+	size_t version = 0;
+	agi::signal::Connection pre_commit_listener;
+
+	void OnPreCommit(int type, const AssDialogue *single_line);
+	/// Count a line, or update its count if it changed
+	void Update(AssDialogue const& line);
+	void Add(agi::Interned<std::string> const& actor, int lines, int uncommented);
+	/// Check every line of the file
+	void UpdateAll();
+
+public:
+	ActorIndex(agi::Context *c);
+
+	/// Trim surrounding whitespace from an actor name
+	static std::string Trim(std::string const& actor);
+
+	/// Is the actor used by any line, including comments?
+	/// @param actor Actor name, with surrounding whitespace ignored
+	bool IsUsed(std::string const& actor) const;
+
+	/// Get the trimmed names of the actors used by lines which aren't comments
+	std::vector<std::string> Names() const;
+
+	/// Get a number which changes whenever the result of Names() does
+	size_t Version() const { return version; }
+};
@@ -17,10 +17,16 @@
 #include "ass_attachment.h"
 
 #include <libaegisub/ass/uuencode.h>
+#include <libaegisub/background_runner.h>
+#include <libaegisub/dispatch.h>
 #include <libaegisub/file_mapping.h>
 #include <libaegisub/io.h>
+#include <libaegisub/make_unique.h>
 
+#include <atomic>
+#include <boost/algorithm/string/case_conv.hpp>
 #include <boost/algorithm/string/predicate.hpp>
+#include <string_view>
 
 // Out-of-line to anchor vtable
 AssEntryGroup AssAttachment::Group() const { return group; }
@@ -32,6 +38,14 @@ AssAttachment::AssAttachment(std::string const& header, AssEntryGroup group)
 {
 }
 
+AssAttachment::AssAttachment(agi::Interned<std::string> entry_data, AssEntryGroup group)
+: entry_data(std::move(entry_data))
+, group(group)
+{
+	auto const& data = this->entry_data.get();
+	filename = data.substr(10, data.find("\r\n") - 10);
+}
+
 AssAttachment::AssAttachment(agi::fs::path const& name, AssEntryGroup group)
 : filename(name.filename().string())
 , group(group)
@@ -47,15 +61,48 @@ AssAttachment::AssAttachment(agi::fs::path const& name, AssEntryGroup group)
 	entry_data = entry_data.get() + agi::ass::UUEncode(buff, buff + file.size());
 }
 
+void AssAttachment::AddData(std::string const& data) {
+	if (pending_data.empty())
+		pending_data = entry_data;
+	pending_data += data;
+	pending_data += "\r\n";
+}
+
+void AssAttachment::FinishData() {
+	if (pending_data.empty()) return;
+	entry_data = std::move(pending_data);
+	pending_data.clear();
+	pending_data.shrink_to_fit();
+}
+
 size_t AssAttachment::GetSize() const {
 	auto header_end = entry_data.get().find('\n');
 	return entry_data.get().size() - header_end - 1;
 }
 
+size_t AssAttachment::ContentHash() const {
+	auto const& data = entry_data.get();
+	auto header_end = data.find('\n');
+	return std::hash<std::string_view>()(std::string_view(data).substr(header_end + 1));
+}
+
+AssEntryGroup AssAttachment::GroupForFile(agi::fs::path const& filename) {
+	auto ext = boost::to_lower_copy(filename.extension().string());
+	if (ext == ".ttf" || ext == ".ttc" || ext == ".pfb")
+		return AssEntryGroup::FONT;
+	return AssEntryGroup::GRAPHIC;
+}
+
+void AssAttachment::Decode(std::vector<char>& out) const {
+	auto const& data = entry_data.get();
+	auto header_end = data.find('\n');
+	agi::ass::UUDecode(data.c_str() + header_end + 1, data.c_str() + data.size(), out);
+}
+
 void AssAttachment::Extract(agi::fs::path const& filename) const {
-	auto header_end = entry_data.get().find('\n');
-	auto decoded = agi::ass::UUDecode(entry_data.get().c_str() + header_end + 1, &entry_data.get().back() + 1);
-	agi::io::Save(filename, true).Get().write(&decoded[0], decoded.size());
+	std::vector<char> decoded;
+	Decode(decoded);
+	agi::io::Save(filename, true).Get().write(decoded.data(), decoded.size());
 }
 
 std::string AssAttachment::GetFileName(bool raw) const {
@@ -68,3 +115,34 @@ std::string AssAttachment::GetFileName(bool raw) const {
 
 	return filename.get().substr(0, last_under) + ".ttf";
 }
+
+std::vector<AttachmentFile> ReadAttachmentFiles(std::vector<agi::fs::path> const& paths, agi::ProgressSink *ps) {
+	std::vector<AttachmentFile> files(paths.size());
+	std::atomic<size_t> done{0};
+
+	// Each file is read and encoded independently, and encoding a large font
+	// takes long enough that doing them one at a time is noticeable
+	agi::dispatch::Parallel(paths.size(), [&](size_t i) {
+		auto& file = files[i];
+		file.path = paths[i];
+		if (ps && ps->IsCancelled()) {
+			file.error = "Cancelled";
+			return;
+		}
+
+		try {
+			file.attachment = agi::make_unique<AssAttachment>(file.path, AssAttachment::GroupForFile(file.path));
+		}
+		catch (agi::Exception const& e) {
+			file.error = e.GetMessage();
+		}
+		catch (std::exception const& e) {
+			file.error = e.what();
+		}
+
+		if (ps)
+			ps->SetProgress(++done, paths.size());
+	});
+
+	return files;
+}
@@ -14,28 +14,48 @@
 //
 // Aegisub Project http://www.aegisub.org/
 
+#pragma once
+
 #include "ass_entry.h"
 
 #include <libaegisub/fs_fwd.h>
 
-#include <boost/flyweight.hpp>
+#include <libaegisub/interned.h>
+
+#include <boost/filesystem/path.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace agi { class ProgressSink; }
 
 /// @class AssAttachment
 class AssAttachment final : public AssEntry {
 	/// ASS uuencoded entry data, including header.
-	boost::flyweight<std::string> entry_data;
+	agi::Interned<std::string> entry_data;
 
 	/// Name of the attached file, with SSA font mangling if it is a ttf
-	boost::flyweight<std::string> filename;
+	agi::Interned<std::string> filename;
 
 	AssEntryGroup group;
 
+	/// Entry data being read from a file, which is only interned once
+	/// complete so that adding each line doesn't copy everything before it
+	std::string pending_data;
+
 public:
 	/// Get the size of the attached file in bytes
 	size_t GetSize() const;
 
 	/// Add a line of data (without newline) read from a subtitle file
-	void AddData(std::string const& data) { entry_data = entry_data.get() + data + "\r\n"; }
+	void AddData(std::string const& data);
+
+	/// Finish reading the data added with AddData
+	void FinishData();
+
+	/// Decode the contents of this attachment
+	/// @param out Buffer to decode into, replacing its contents
+	void Decode(std::vector<char>& out) const;
 
 	/// Extract the contents of this attachment to a file
 	/// @param filename Path to save the attachment to
@@ -45,10 +65,41 @@ public:
 	/// @param raw If false, remove the SSA filename mangling
 	std::string GetFileName(bool raw=false) const;
 
+	/// Hash of the encoded contents, without the header, for finding
+	/// attachments of identical files
+	size_t ContentHash() const;
+
+	/// Get the group a file should be attached to based on its extension
+	static AssEntryGroup GroupForFile(agi::fs::path const& filename);
+
 	std::string const& GetEntryData() const { return entry_data; }
+	/// Get the entry data as an interned string, which is cheap to keep and compare
+	agi::Interned<std::string> const& GetSharedEntryData() const { return entry_data; }
 	AssEntryGroup Group() const override;
 
 	AssAttachment(AssAttachment const& rgt) = default;
 	AssAttachment(std::string const& header, AssEntryGroup group);
 	AssAttachment(agi::fs::path const& name, AssEntryGroup group);
+	/// Recreate an attachment from the entry data of an existing one
+	AssAttachment(agi::Interned<std::string> entry_data, AssEntryGroup group);
 };
+
+/// A file read by ReadAttachmentFiles
+struct AttachmentFile {
+	agi::fs::path path;
+	/// The encoded attachment, or null if the file couldn't be read
+	std::unique_ptr<AssAttachment> attachment;
+	/// Why the file couldn't be read
+	std::string error;
+	/// Was it left out by AssFile::InsertAttachments as a copy of another?
+	bool duplicate = false;
+};
+
+/// Read and encode files as attachments, several at once
+/// @param paths Files to read
+/// @param ps Progress sink to report to and check for cancellation, or null
+///
+/// This may be called from any thread. Files which can't be read are
+/// returned with an error message rather than throwing, as are any left
+/// unread when cancelled.
+std::vector<AttachmentFile> ReadAttachmentFiles(std::vector<agi::fs::path> const& paths, agi::ProgressSink *ps);
@@ -36,34 +36,59 @@
 #include "utils.h"
 
 #include <libaegisub/of_type_adaptor.h>
+#include <libaegisub/slab_pool.h>
 #include <libaegisub/split.h>
 #include <libaegisub/make_unique.h>
 
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string/trim.hpp>
-#include <boost/lexical_cast.hpp>
-#include <boost/regex.hpp>
 #include <boost/spirit/include/karma_generate.hpp>
 #include <boost/spirit/include/karma_int.hpp>
 
+#include <atomic>
+#include <charconv>
+#include <string_view>
+
 using namespace boost::adaptors;
 
-static int next_id = 0;
+// Lines are created on multiple threads when loading large files
+static std::atomic<int> next_id{0};
 
 AssDialogue::AssDialogue() {
 	Id = ++next_id;
 }
 
+/// A serialized line along with the fields it was serialized from
+struct AssDialogue::EntryData {
+	AssDialogueBase fields;
+	std::string data;
+};
+
 AssDialogue::AssDialogue(AssDialogue const& that)
 : AssDialogueBase(that)
 , AssEntryListHook(that)
+, entry_data(that.entry_data)
 {
 	Id = ++next_id;
 }
 
 AssDialogue::AssDialogue(AssDialogueBase const& that) : AssDialogueBase(that) { }
 
+bool SameContents(AssDialogueBase const& a, AssDialogueBase const& b) {
+	// The string fields are all interned, so these are pointer comparisons
+	return a.Comment == b.Comment
+		&& a.Layer == b.Layer
+		&& a.Margin == b.Margin
+		&& a.Start == b.Start
+		&& a.End == b.End
+		&& a.Style == b.Style
+		&& a.Actor == b.Actor
+		&& a.Effect == b.Effect
+		&& a.ExtradataIds == b.ExtradataIds
+		&& a.Text == b.Text;
+}
+
 AssDialogue::AssDialogue(std::string const& data) {
 	Id = ++next_id;
 	Parse(data);
@@ -71,12 +96,40 @@ AssDialogue::AssDialogue(std::string const& data) {
 
 AssDialogue::~AssDialogue () { }
 
+static agi::SlabPool& dialogue_pool() {
+	// Intentionally never destroyed, as lines held by other statics may
+	// outlive it
+	static auto pool = new agi::SlabPool(sizeof(AssDialogue), 1024);
+	return *pool;
+}
+
+void *AssDialogue::operator new(size_t size) {
+	assert(size == sizeof(AssDialogue));
+	return dialogue_pool().Allocate();
+}
+
+void AssDialogue::operator delete(void *ptr) {
+	dialogue_pool().Free(ptr);
+}
+
 class tokenizer {
 	agi::StringRange str;
 	agi::split_iterator<agi::StringRange::const_iterator> pos;
+	const char *data;
 
 public:
-	tokenizer(agi::StringRange const& str) : str(str) , pos(agi::Split(str, ',')) { }
+	tokenizer(agi::StringRange const& str)
+	: str(str), pos(agi::Split(str, ',')), data(str.empty() ? nullptr : &*str.begin()) { }
+
+	/// Get a view of part of the line
+	std::string_view view(agi::StringRange const& range) const {
+		return std::string_view(data + (range.begin() - str.begin()), range.size());
+	}
+
+	/// Get a view of the rest of the line, starting at the next field
+	std::string_view rest() {
+		return view(agi::StringRange(next_tok().begin(), str.end()));
+	}
 
 	agi::StringRange next_tok() {
 		if (pos.eof())
@@ -84,8 +137,25 @@ public:
 		return *pos++;
 	}
 
-	std::string next_str() { return agi::str(next_tok()); }
 	std::string next_str_trim() { return agi::str(boost::trim_copy(next_tok())); }
+
+	/// Get the next field without copying it
+	std::string_view next_view_trim() { return view(boost::trim_copy(next_tok())); }
+
+	int next_int() { return parse_int<int>(view(next_tok())); }
+
+	/// Parse an entire string as an integer, as lexical_cast would but
+	/// without going through a stream
+	template<typename Int>
+	Int parse_int(std::string_view view) {
+		if (!view.empty() && view[0] == '+')
+			view.remove_prefix(1);
+		Int value;
+		auto res = std::from_chars(view.data(), view.data() + view.size(), value);
+		if (view.empty() || res.ec != std::errc() || res.ptr != view.data() + view.size())
+			throw SubtitleFormatParseError("Failed parsing line: " + std::string(str.begin(), str.end()));
+		return value;
+	}
 };
 
 void AssDialogue::Parse(std::string const& raw) {
@@ -104,46 +174,46 @@ void AssDialogue::Parse(std::string const& raw) {
 	tokenizer tkn(str);
 
 	// Get first token and see if it has "Marked=" in it
-	auto tmp = tkn.next_str_trim();
+	auto tmp = tkn.next_view_trim();
 	bool ssa = boost::istarts_with(tmp, "marked=");
 
 	// Get layer number
 	if (ssa)
 		Layer = 0;
 	else
-		Layer = boost::lexical_cast<int>(tmp);
+		Layer = tkn.parse_int<int>(tmp);
 
+	// The string fields are interned straight from the line, so only values
+	// which aren't already used by another line are ever copied
 	Start = tkn.next_str_trim();
 	End = tkn.next_str_trim();
-	Style = tkn.next_str_trim();
-	Actor = tkn.next_str_trim();
+	Style = agi::Interned<std::string>::FromKey(tkn.next_view_trim());
+	Actor = agi::Interned<std::string>::FromKey(tkn.next_view_trim());
 	for (int& margin : Margin)
-		margin = mid(-9999, boost::lexical_cast<int>(tkn.next_str()), 99999);
-	Effect = tkn.next_str_trim();
+		margin = mid(-9999, tkn.next_int(), 99999);
+	Effect = agi::Interned<std::string>::FromKey(tkn.next_view_trim());
 
-	std::string text{tkn.next_tok().begin(), str.end()};
+	std::string_view text = tkn.rest();
 
+	// Extradata ids are stored as {=1=2=3} at the start of the text
 	if (text.size() > 1 && text[0] == '{' && text[1] == '=') {
-		static const boost::regex extradata_test("^\\{(=\\d+)+\\}");
-		boost::match_results<std::string::iterator> rematch;
-		if (boost::regex_search(text.begin(), text.end(), rematch, extradata_test)) {
-			std::string extradata_str = rematch.str(0);
-			text = rematch.suffix().str();
-
-			static const boost::regex idmatcher("=(\\d+)");
-			auto start = extradata_str.begin();
-			auto end = extradata_str.end();
-			std::vector<uint32_t> ids;
-			while (boost::regex_search(start, end, rematch, idmatcher)) {
-				auto id = boost::lexical_cast<uint32_t>(rematch.str(1));
-				ids.push_back(id);
-				start = rematch.suffix().first;
-			}
-			ExtradataIds = ids;
+		std::vector<uint32_t> ids;
+		size_t pos = 1;
+		while (pos < text.size() && text[pos] == '=') {
+			size_t digits_end = pos + 1;
+			while (digits_end < text.size() && text[digits_end] >= '0' && text[digits_end] <= '9')
+				++digits_end;
+			if (digits_end == pos + 1) break;
+			ids.push_back(tkn.parse_int<uint32_t>(text.substr(pos + 1, digits_end - pos - 1)));
+			pos = digits_end;
+		}
+		if (pos < text.size() && text[pos] == '}' && !ids.empty()) {
+			ExtradataIds = std::move(ids);
+			text.remove_prefix(pos + 1);
 		}
 	}
 
-	Text = text;
+	Text = agi::Interned<std::string>::FromKey(text);
 }
 
 static void append_int(std::string &str, int v) {
@@ -166,7 +236,12 @@ static void append_unsafe_str(std::string &out, std::string const& str) {
 	out += ',';
 }
 
-std::string AssDialogue::GetEntryData() const {
+std::string const& AssDialogue::GetEntryData() const {
+	// The fields are compared rather than tracked as they're set, as
+	// everything assigns to them directly
+	if (entry_data && SameContents(entry_data->fields, *this))
+		return entry_data->data;
+
 	std::string str = Comment ? "Comment: " : "Dialogue: ";
 	str.reserve(51 + Style.get().size() + Actor.get().size() + Effect.get().size() + Text.get().size());
 
@@ -193,52 +268,55 @@ std::string AssDialogue::GetEntryData() const {
 			str += c;
 	}
 
-	return str;
+	entry_data = std::make_shared<const EntryData>(EntryData{*this, std::move(str)});
+	return entry_data->data;
 }
 
-std::vector<std::unique_ptr<AssDialogueBlock>> AssDialogue::ParseTags() const {
-	std::vector<std::unique_ptr<AssDialogueBlock>> Blocks;
+AssParsedText::AssParsedText(agi::Interned<std::string> text)
+: source(std::move(text))
+{
+	std::string_view str(source.get());
 
 	// Empty line, make an empty block
-	if (Text.get().empty()) {
-		Blocks.push_back(agi::make_unique<AssDialogueBlockPlain>());
-		return Blocks;
+	if (str.empty()) {
+		blocks.push_back({AssBlockType::PLAIN, str, 0, 0, 0});
+		return;
 	}
 
 	int drawingLevel = 0;
-	std::string const& text(Text.get());
-
-	for (size_t len = text.size(), cur = 0; cur < len; ) {
+	for (size_t len = str.size(), cur = 0; cur < len; ) {
 		// Overrides block
-		if (text[cur] == '{') {
-			size_t end = text.find('}', cur);
+		if (str[cur] == '{') {
+			size_t end = str.find('}', cur);
 
 			// VSFilter requires that override blocks be closed, while libass
 			// does not. We match VSFilter here.
-			if (end == std::string::npos)
+			if (end == std::string_view::npos)
 				goto plain;
 
-			++cur;
-			// Get contents of block
-			std::string work = text.substr(cur, end - cur);
+			auto whole = str.substr(cur, end + 1 - cur);
+			auto work = whole.substr(1, whole.size() - 2);
 			cur = end + 1;
 
-			if (work.size() && work.find('\\') == std::string::npos) {
+			if (work.size() && work.find('\\') == std::string_view::npos) {
 				//We've found an override block with no backslashes
 				//We're going to assume it's a comment and not consider it an override block
-				Blocks.push_back(agi::make_unique<AssDialogueBlockComment>(work));
+				blocks.push_back({AssBlockType::COMMENT, whole, 0, 0, 0});
 			}
 			else {
-				// Create block
-				auto block = agi::make_unique<AssDialogueBlockOverride>(work);
-				block->ParseTags();
+				AssDialogueBlockOverride block{std::string(work)};
+				block.ParseTags();
 
 				// Look for \p in block
-				for (auto const& tag : block->Tags) {
+				for (auto const& tag : block.Tags) {
 					if (tag.Name == "\\p")
 						drawingLevel = tag.Params[0].Get<int>(0);
 				}
-				Blocks.push_back(std::move(block));
+
+				auto first = static_cast<uint32_t>(tags.size());
+				auto count = static_cast<uint32_t>(block.Tags.size());
+				blocks.push_back({AssBlockType::OVERRIDE, whole, 0, first, count});
+				std::move(block.Tags.begin(), block.Tags.end(), back_inserter(tags));
 			}
 
 			continue;
@@ -246,21 +324,71 @@ std::vector<std::unique_ptr<AssDialogueBlock>> AssDialogue::ParseTags() const {
 
 		// Plain-text/drawing block
 plain:
-		std::string work;
-		size_t end = text.find('{', cur + 1);
-		if (end == std::string::npos) {
-			work = text.substr(cur);
-			cur = len;
-		}
-		else {
-			work = text.substr(cur, end - cur);
-			cur = end;
-		}
+		size_t end = str.find('{', cur + 1);
+		if (end == std::string_view::npos)
+			end = len;
+		auto work = str.substr(cur, end - cur);
+		cur = end;
 
 		if (drawingLevel == 0)
-			Blocks.push_back(agi::make_unique<AssDialogueBlockPlain>(work));
+			blocks.push_back({AssBlockType::PLAIN, work, 0, 0, 0});
 		else
-			Blocks.push_back(agi::make_unique<AssDialogueBlockDrawing>(work, drawingLevel));
+			blocks.push_back({AssBlockType::DRAWING, work, drawingLevel, 0, 0});
+	}
+}
+
+AssParsedText::TagRange AssParsedText::Tags(Block const& block) const {
+	auto first = tags.data() + block.first_tag;
+	return {first, first + block.tag_count};
+}
+
+const AssOverrideTag *AssParsedText::FindTag(std::string const& name) const {
+	for (auto const& tag : tags) {
+		if (tag.Name == name)
+			return &tag;
+	}
+	return nullptr;
+}
+
+std::string AssParsedText::StrippedText() const {
+	std::string str;
+	for (auto const& block : blocks) {
+		if (block.type == AssBlockType::PLAIN)
+			str += block.text;
+	}
+	return str;
+}
+
+AssParsedText const& AssDialogue::Parsed() const {
+	if (!parsed || !parsed->IsFor(Text))
+		parsed = std::make_shared<const AssParsedText>(Text);
+	return *parsed;
+}
+
+std::vector<std::unique_ptr<AssDialogueBlock>> AssDialogue::ParseTags() const {
+	std::vector<std::unique_ptr<AssDialogueBlock>> Blocks;
+
+	// Build modifiable copies of the shared blocks rather than re-splitting
+	// the text
+	for (auto const& block : Parsed().Blocks()) {
+		std::string text(block.text);
+		switch (block.type) {
+		case AssBlockType::PLAIN:
+			Blocks.push_back(agi::make_unique<AssDialogueBlockPlain>(text));
+			break;
+		case AssBlockType::DRAWING:
+			Blocks.push_back(agi::make_unique<AssDialogueBlockDrawing>(text, block.scale));
+			break;
+		case AssBlockType::COMMENT:
+			Blocks.push_back(agi::make_unique<AssDialogueBlockComment>(text.substr(1, text.size() - 2)));
+			break;
+		case AssBlockType::OVERRIDE: {
+			auto ovr = agi::make_unique<AssDialogueBlockOverride>(text.substr(1, text.size() - 2));
+			ovr->ParseTags();
+			Blocks.push_back(std::move(ovr));
+			break;
+		}
+		}
 	}
 
 	return Blocks;
@@ -281,8 +409,6 @@ bool AssDialogue::CollidesWith(const AssDialogue *target) const {
 	return ((Start < target->Start) ? (target->Start < End) : (Start < target->End));
 }
 
-static std::string get_text_p(AssDialogueBlock *d) { return d->GetText(); }
 std::string AssDialogue::GetStrippedText() const {
-	auto blocks = ParseTags();
-	return join(blocks | agi::of_type<AssDialogueBlockPlain>() | transformed(get_text_p), "");
+	return Parsed().StrippedText();
 }
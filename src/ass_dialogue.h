@@ -35,7 +35,10 @@
 #include <libaegisub/ass/time.h>
 
 #include <array>
-#include <boost/flyweight.hpp>
+#include <libaegisub/interned.h>
+#include <boost/range/iterator_range.hpp>
+#include <memory>
+#include <string_view>
 #include <vector>
 
 enum class AssBlockType {
@@ -118,6 +121,54 @@ public:
 	void ProcessParameters(ProcessParametersCallback callback, void *userData);
 };
 
+/// @class AssParsedText
+/// @brief Read-only parse of a line's text
+///
+/// Unlike AssDialogue::ParseTags(), which gives each caller its own blocks to
+/// modify, this is built once per version of a line's text and then shared by
+/// everything which only needs to look at the blocks and tags. All of the
+/// blocks are kept in one vector and all of the tags in another, with the
+/// block text referring directly into the line's text.
+class AssParsedText {
+public:
+	struct Block {
+		AssBlockType type;
+		/// The block's characters in the line, including any braces
+		std::string_view text;
+		/// Drawing scale for drawing blocks, or 0
+		int scale;
+		/// Index of the block's first tag in the tag list
+		uint32_t first_tag;
+		/// Number of tags in the block
+		uint32_t tag_count;
+	};
+
+	using TagRange = boost::iterator_range<const AssOverrideTag *>;
+
+private:
+	/// The text which was parsed, held to keep the block text alive
+	agi::Interned<std::string> source;
+	std::vector<Block> blocks;
+	std::vector<AssOverrideTag> tags;
+
+public:
+	explicit AssParsedText(agi::Interned<std::string> text);
+
+	/// Is this a parse of the given text?
+	bool IsFor(agi::Interned<std::string> const& text) const { return source == text; }
+
+	std::vector<Block> const& Blocks() const { return blocks; }
+
+	/// Get the tags of an override block
+	TagRange Tags(Block const& block) const;
+
+	/// Get the first tag with the given name in any override block, or nullptr
+	const AssOverrideTag *FindTag(std::string const& name) const;
+
+	/// Get the text of all of the plain blocks
+	std::string StrippedText() const;
+};
+
 struct AssDialogueBase {
 	/// Unique ID of this line. Copies of the line for Undo/Redo purposes
 	/// preserve the unique ID, so that the equivalent lines can be found in
@@ -140,27 +191,43 @@ struct AssDialogueBase {
 	/// Ending time
 	agi::Time End = 5000;
 	/// Style name
-	boost::flyweight<std::string> Style = boost::flyweight<std::string>("Default");
+	agi::Interned<std::string> Style = agi::Interned<std::string>("Default");
 	/// Actor name
-	boost::flyweight<std::string> Actor;
+	agi::Interned<std::string> Actor;
 	/// Effect name
-	boost::flyweight<std::string> Effect;
+	agi::Interned<std::string> Effect;
 	/// IDs of extradata entries for line
-	boost::flyweight<std::vector<uint32_t>> ExtradataIds;
+	agi::Interned<std::vector<uint32_t>> ExtradataIds;
 	/// Raw text data
-	boost::flyweight<std::string> Text;
+	agi::Interned<std::string> Text;
 };
 
+/// Do two lines have the same contents, regardless of which line each is?
+bool SameContents(AssDialogueBase const& a, AssDialogueBase const& b);
+
 class AssDialogue final : public AssEntry, public AssDialogueBase, public AssEntryListHook {
 	/// @brief Parse raw ASS data into everything else
 	/// @param data ASS line
 	void Parse(std::string const& data);
+
+	/// Parse of the most recent text Parsed() was called for
+	mutable std::shared_ptr<const AssParsedText> parsed;
+
+	struct EntryData;
+	/// Serialized line as of the last call to GetEntryData(), which is
+	/// shared with copies of the line
+	mutable std::shared_ptr<const EntryData> entry_data;
 public:
 	AssEntryGroup Group() const override { return AssEntryGroup::DIALOGUE; }
 
 	/// Parse text as ASS and return block information
 	std::vector<std::unique_ptr<AssDialogueBlock>> ParseTags() const;
 
+	/// Get the shared read-only parse of the text, parsing it only if the
+	/// text has changed since the last call. The returned reference is
+	/// invalidated by the next call after the text changes.
+	AssParsedText const& Parsed() const;
+
 	/// Strip all ASS tags from the text
 	void StripTags();
 	/// Strip a specific ASS tag from the text
@@ -169,7 +236,11 @@ public:
 
 	/// Update the text of the line from parsed blocks
 	void UpdateText(std::vector<std::unique_ptr<AssDialogueBlock>>& blocks);
-	std::string GetEntryData() const;
+
+	/// Get the line as it appears in a file, serializing it only if any
+	/// field has changed since the last call. The returned reference is
+	/// invalidated by the next call after a field changes.
+	std::string const& GetEntryData() const;
 
 	/// Does this line collide with the passed line?
 	bool CollidesWith(const AssDialogue *target) const;
@@ -179,5 +250,10 @@ public:
 	AssDialogue(AssDialogueBase const&);
 	AssDialogue(std::string const& data);
 	~AssDialogue();
+
+	/// Lines are allocated from a pool, as files can contain a great many
+	/// of them which are all created and destroyed together
+	static void *operator new(size_t size);
+	static void operator delete(void *ptr);
 };
 
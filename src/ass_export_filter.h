@@ -35,9 +35,11 @@
 #pragma once
 
 #include <boost/intrusive/list.hpp>
+#include <functional>
 #include <memory>
 #include <string>
 
+class AssDialogue;
 class AssFile;
 class AssExportFilterChain;
 class wxWindow;
@@ -71,6 +73,21 @@ public:
 	///                      to open a progress dialog
 	virtual void ProcessSubs(AssFile *subs, wxWindow *parent_window=nullptr)=0;
 
+	/// Get a function which processes a single dialogue line, for filters
+	/// where the result for each line depends only on that line
+	///
+	/// When a filter provides one, the exporter runs it over chunks of lines
+	/// in parallel, in the same pass as any neighboring filters which also
+	/// provide one, instead of calling ProcessSubs. The function is called
+	/// concurrently for different lines, so it must not modify anything
+	/// other than the line it is passed. It may read the file's headers and
+	/// styles, but not the other dialogue lines, as earlier filters in the
+	/// same pass may not have processed them yet.
+	/// @param subs File which will be processed
+	/// @return Line processor, or an empty function if the filter has to
+	///         process the whole file at once
+	virtual std::function<void (AssDialogue&)> GetLineProcessor(AssFile const& subs) { return nullptr; }
+
 	/// Draw setup controls
 	/// @param parent Parent window to add controls to
 	/// @param c Project context
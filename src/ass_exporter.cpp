@@ -34,6 +34,7 @@
 
 #include "ass_exporter.h"
 
+#include "ass_dialogue.h"
 #include "ass_export_filter.h"
 #include "ass_file.h"
 #include "compat.h"
@@ -41,9 +42,40 @@
 #include "project.h"
 #include "subtitle_format.h"
 
+#include <libaegisub/dispatch.h>
+
+#include <algorithm>
 #include <memory>
 #include <wx/sizer.h>
 
+namespace {
+typedef std::function<void (AssDialogue&)> LineProcessor;
+
+/// Number of lines given to each worker when running line processors
+const size_t lines_per_chunk = 1000;
+
+/// Run each of the processors over every line in one parallel pass, then
+/// clear the list
+void run_line_processors(AssFile &subs, std::vector<LineProcessor> &processors) {
+	if (processors.empty()) return;
+
+	std::vector<AssDialogue *> lines;
+	for (auto& line : subs.Events)
+		lines.push_back(&line);
+
+	const size_t chunks = (lines.size() + lines_per_chunk - 1) / lines_per_chunk;
+	agi::dispatch::Parallel(chunks, [&](size_t chunk) {
+		const size_t end = std::min(lines.size(), (chunk + 1) * lines_per_chunk);
+		for (size_t i = chunk * lines_per_chunk; i < end; ++i) {
+			for (auto const& process : processors)
+				process(*lines[i]);
+		}
+	});
+
+	processors.clear();
+}
+}
+
 AssExporter::AssExporter(agi::Context *c) : c(c) { }
 
 void AssExporter::DrawSettings(wxWindow *parent, wxSizer *target_sizer) {
@@ -82,10 +114,20 @@ std::vector<std::string> AssExporter::GetAllFilterNames() const {
 void AssExporter::Export(agi::fs::path const& filename, std::string const& charset, wxWindow *export_dialog) {
 	AssFile subs(*c->ass);
 
+	// Consecutive filters which work line-by-line are fused into a single
+	// pass over the file, which is run when a whole-file filter is reached
+	std::vector<LineProcessor> line_processors;
 	for (auto filter : filters) {
 		filter->LoadSettings(is_default, c);
+		if (auto process = filter->GetLineProcessor(subs)) {
+			line_processors.push_back(std::move(process));
+			continue;
+		}
+
+		run_line_processors(subs, line_processors);
 		filter->ProcessSubs(&subs, export_dialog);
 	}
+	run_line_processors(subs, line_processors);
 
 	const SubtitleFormat *writer = SubtitleFormat::GetWriter(filename);
 	if (!writer)
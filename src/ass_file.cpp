@@ -26,6 +26,10 @@
 #include "project.h"
 #include "include/aegisub/context.h"
 
+#include <libaegisub/dispatch.h>
+#include <libaegisub/parallel_sort.h>
+#include <libaegisub/trace.h>
+
 #include <algorithm>
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/algorithm/string/predicate.hpp>
@@ -90,6 +94,11 @@ void AssFile::swap(AssFile& from) throw() {
 	std::swap(Properties, from.Properties);
 	std::swap(Filename, from.Filename);
 	std::swap(next_extradata_id, from.next_extradata_id);
+	std::swap(time_index, from.time_index);
+	std::swap(time_index_stale, from.time_index_stale);
+	style_index.swap(from.style_index);
+	std::swap(style_index_stale, from.style_index_stale);
+	committed_ids.swap(from.committed_ids);
 }
 
 AssFile& AssFile::operator=(AssFile from) {
@@ -103,14 +112,43 @@ EntryList<AssDialogue>::iterator AssFile::iterator_to(AssDialogue& line) {
 	return in_list ? Events.iterator_to(line) : Events.end();
 }
 
-void AssFile::InsertAttachment(agi::fs::path const& filename) {
-	AssEntryGroup group = AssEntryGroup::GRAPHIC;
+std::vector<AssDialogue *> AssFile::EventsOverlapping(int start, int end) {
+	if (time_index_stale) {
+		std::vector<agi::IntervalIndex<AssDialogue *>::Entry> entries;
+		entries.reserve(Events.size());
+		for (auto& line : Events)
+			entries.push_back({(int)line.Start, (int)line.End, &line});
+		time_index.Assign(std::move(entries));
+		time_index_stale = false;
+	}
+
+	auto lines = time_index.Overlapping(start, end);
+	sort(lines.begin(), lines.end(), [](AssDialogue *a, AssDialogue *b) { return a->Row < b->Row; });
+	return lines;
+}
 
-	auto ext = boost::to_lower_copy(filename.extension().string());
-	if (ext == ".ttf" || ext == ".ttc" || ext == ".pfb")
-		group = AssEntryGroup::FONT;
+void AssFile::InsertAttachment(agi::fs::path const& filename) {
+	Attachments.emplace_back(filename, AssAttachment::GroupForFile(filename));
+}
 
-	Attachments.emplace_back(filename, group);
+size_t AssFile::InsertAttachments(std::vector<AttachmentFile>& files) {
+	std::vector<size_t> existing(Attachments.size());
+	agi::dispatch::Parallel(Attachments.size(), [&](size_t i) {
+		existing[i] = Attachments[i].ContentHash();
+	});
+	std::unordered_set<size_t> seen(existing.begin(), existing.end());
+
+	size_t added = 0;
+	for (auto& file : files) {
+		if (!file.attachment) continue;
+		if (!seen.insert(file.attachment->ContentHash()).second) {
+			file.duplicate = true;
+			continue;
+		}
+		Attachments.push_back(*file.attachment);
+		++added;
+	}
+	return added;
 }
 
 std::string AssFile::GetScriptInfo(std::string const& key) const {
@@ -183,29 +221,96 @@ std::vector<std::string> AssFile::GetStyles() const {
 }
 
 AssStyle *AssFile::GetStyle(std::string const& name) {
+	if (style_index_stale) {
+		style_index.clear();
+		for (auto& style : Styles)
+			style_index.emplace(boost::to_lower_copy(style.name), &style);
+		style_index_stale = false;
+	}
+
+	auto it = style_index.find(boost::to_lower_copy(name));
+	if (it != style_index.end() && boost::iequals(it->second->name, name))
+		return it->second;
+
+	// Not indexed yet, or renamed since the index was built
 	for (auto& style : Styles) {
-		if (boost::iequals(style.name, name))
+		if (boost::iequals(style.name, name)) {
+			style_index_stale = true;
 			return &style;
+		}
 	}
 	return nullptr;
 }
 
 int AssFile::Commit(wxString const& desc, int type, int amend_id, AssDialogue *single_line) {
-	if (type == COMMIT_NEW || (type & COMMIT_DIAG_ADDREM) || (type & COMMIT_ORDER)) {
+	AGI_TRACE_ZONE("subtitles", "Commit");
+	// Sort already renumbered the lines if it's the only thing which changed
+	const bool renumbered = type == COMMIT_ORDER && rows_current;
+	rows_current = false;
+	if (!renumbered && (type == COMMIT_NEW || (type & COMMIT_DIAG_ADDREM) || (type & COMMIT_ORDER))) {
 		int i = 0;
 		for (auto& event : Events)
 			event.Row = i++;
 	}
 
+	if (type == COMMIT_NEW || (type & COMMIT_STYLES))
+		style_index_stale = true;
+
+	// Keep the time index up to date incrementally when just one line was
+	// retimed, and otherwise rebuild it the next time it's needed
+	if (type == COMMIT_NEW || (type & COMMIT_DIAG_ADDREM))
+		time_index_stale = true;
+	else if ((type & COMMIT_DIAG_TIME) && !time_index_stale) {
+		if (single_line)
+			time_index.Update(single_line, single_line->Start, single_line->End);
+		else
+			time_index_stale = true;
+	}
+
 	AnnouncePreCommit(type, single_line);
 
-	PushState({desc, &amend_id, single_line});
+	PushState({desc, &amend_id, single_line, type});
 
 	AnnounceCommit(type, single_line);
 
+	AnnounceChanges(GetChanges(type, single_line));
+
 	return amend_id;
 }
 
+AssFileChanges AssFile::GetChanges(int type, const AssDialogue *single_line) {
+	AssFileChanges changes;
+	changes.type = type;
+
+	if (single_line && type != COMMIT_NEW && !(type & COMMIT_DIAG_ADDREM)) {
+		changes.modified.push_back(single_line);
+		changes.modified_known = true;
+	}
+	else if (type != COMMIT_NEW && !(type & COMMIT_DIAG_FULL))
+		changes.modified_known = true;
+
+	if (type != COMMIT_NEW && !(type & COMMIT_DIAG_ADDREM))
+		return changes;
+
+	std::vector<int> ids;
+	ids.reserve(Events.size());
+	for (auto const& line : Events)
+		ids.push_back(line.Id);
+	sort(begin(ids), end(ids));
+
+	// Everything is new after COMMIT_NEW, so there's nothing to compare with
+	if (type != COMMIT_NEW) {
+		set_difference(begin(committed_ids), end(committed_ids), begin(ids), end(ids), back_inserter(changes.removed));
+		for (auto const& line : Events) {
+			if (!binary_search(begin(committed_ids), end(committed_ids), line.Id))
+				changes.added.push_back(&line);
+		}
+	}
+
+	committed_ids = std::move(ids);
+	return changes;
+}
+
 bool AssFile::CompStart(AssDialogue const& lft, AssDialogue const& rgt) {
 	return lft.Start < rgt.Start;
 }
@@ -231,29 +336,44 @@ bool AssFile::CompTextStripped(AssDialogue const& lft, AssDialogue const& rgt) {
 	return lft.GetStrippedText() < rgt.GetStrippedText();
 }
 
-void AssFile::Sort(CompFunc comp, std::set<AssDialogue*> const& limit) {
+void AssFile::Sort(CompFunc comp, Selection const& limit) {
 	Sort(Events, comp, limit);
-}
-
-void AssFile::Sort(EntryList<AssDialogue> &lst, CompFunc comp, std::set<AssDialogue*> const& limit) {
-	if (limit.empty()) {
-		lst.sort(comp);
-		return;
+	rows_current = true;
+}
+
+void AssFile::Sort(EntryList<AssDialogue> &lst, CompFunc comp, Selection const& limit) {
+	// Sort an array of pointers rather than the list itself, as that can be
+	// done in parallel and relinking the list afterwards is cheap
+	std::vector<AssDialogue *> lines;
+	for (auto& line : lst)
+		lines.push_back(&line);
+
+	auto by_comp = [=](const AssDialogue *lft, const AssDialogue *rgt) { return comp(*lft, *rgt); };
+	if (limit.empty())
+		agi::ParallelStableSort(lines.begin(), lines.end(), by_comp);
+	else {
+		// Sort each selected block separately, leaving everything else untouched
+		std::vector<bool> selected(lines.size());
+		for (size_t i = 0; i < lines.size(); ++i)
+			selected[i] = limit.count(lines[i]) > 0;
+
+		for (size_t begin = 0; begin < lines.size(); ) {
+			if (!selected[begin]) {
+				++begin;
+				continue;
+			}
+			size_t end = begin + 1;
+			while (end < lines.size() && selected[end]) ++end;
+			agi::ParallelStableSort(lines.begin() + begin, lines.begin() + end, by_comp);
+			begin = end;
+		}
 	}
 
-	// Sort each selected block separately, leaving everything else untouched
-	for (auto begin = lst.begin(); begin != lst.end(); ++begin) {
-		if (!limit.count(&*begin)) continue;
-		auto end = begin;
-		while (end != lst.end() && limit.count(&*end)) ++end;
-
-		// sort doesn't support only sorting a sublist, so move them to a temp list
-		EntryList<AssDialogue> tmp;
-		tmp.splice(tmp.begin(), lst, begin, end);
-		tmp.sort(comp);
-		lst.splice(end, tmp);
-
-		begin = --end;
+	lst.clear();
+	int row = 0;
+	for (auto line : lines) {
+		line->Row = row++;
+		lst.push_back(*line);
 	}
 }
 
@@ -335,6 +455,15 @@ std::vector<ExtradataEntry> AssFile::GetExtradata(std::vector<uint32_t> const& i
 	return result;
 }
 
+ExtradataEntry const *AssFile::FindExtradata(std::vector<uint32_t> const& id_list, std::string const& key) const {
+	ExtradataEntry const *found = nullptr;
+	enumerate_extradata(Extradata, id_list, [&](ExtradataEntry const& e) {
+		if (!found && e.key == key)
+			found = &e;
+	});
+	return found;
+}
+
 void AssFile::CleanExtradata() {
 	if (Extradata.empty()) return;
 
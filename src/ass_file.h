@@ -30,14 +30,17 @@
 #pragma once
 
 #include "ass_entry.h"
+#include "selection.h"
 
 #include <libaegisub/fs_fwd.h>
+#include <libaegisub/interval_index.h>
 #include <libaegisub/signal.h>
 
 #include <boost/filesystem/path.hpp>
 #include <boost/intrusive/list.hpp>
 #include <map>
 #include <set>
+#include <unordered_map>
 #include <vector>
 
 class AssAttachment;
@@ -45,6 +48,7 @@ class AssDialogue;
 class AssInfo;
 class AssStyle;
 class wxString;
+struct AttachmentFile;
 namespace agi { struct Context; }
 
 template<typename T>
@@ -61,6 +65,26 @@ struct AssFileCommit {
 	wxString const& message;
 	int *commit_id;
 	AssDialogue *single_line;
+	/// AssFile::CommitType of the changes
+	int type;
+};
+
+/// What changed in a commit, for listeners which update incrementally
+struct AssFileChanges {
+	/// AssFile::CommitType of the changes
+	int type = 0;
+	/// Lines added by the commit, in file order
+	std::vector<const AssDialogue *> added;
+	/// Ids of the lines removed by the commit
+	std::vector<int> removed;
+	/// Existing lines whose fields changed, if modified_known is set
+	std::vector<const AssDialogue *> modified;
+	/// Are the lines in modified the only ones which may have changed? If
+	/// not, any line may have changed.
+	bool modified_known = false;
+
+	/// Should everything derived from the file be rebuilt?
+	bool Everything() const { return type == 0; }
 };
 
 struct ProjectProperties {
@@ -81,6 +105,9 @@ struct ProjectProperties {
 	int active_row = 0;
 	int ar_mode = 0;
 	int video_position = 0;
+
+	/// Decode the video on the CPU even if hardware decoding is enabled
+	int disable_hw_decoding = 0;
 };
 
 class AssFile {
@@ -88,8 +115,28 @@ class AssFile {
 	agi::signal::Signal<int, const AssDialogue*> AnnounceCommit;
 	agi::signal::Signal<int, const AssDialogue*> AnnouncePreCommit;
 	agi::signal::Signal<AssFileCommit> PushState;
+	/// The same commits as AnnounceCommit, with the lines which changed
+	agi::signal::Signal<AssFileChanges const&> AnnounceChanges;
+
+	/// Ids of the lines as of the last commit which added or removed lines,
+	/// sorted, for working out which lines a commit added and removed
+	std::vector<int> committed_ids;
+
+	/// Index of the dialogue lines by time as of the most recent commit
+	agi::IntervalIndex<AssDialogue *> time_index;
+	/// Does the time index need to be rebuilt before it is next used?
+	bool time_index_stale = true;
+	/// Were the lines renumbered by Sort since the last commit?
+	bool rows_current = false;
+
+	/// Styles by lowercased name as of the most recent commit
+	std::unordered_map<std::string, AssStyle *> style_index;
+	/// Does the style index need to be rebuilt before it is next used?
+	bool style_index_stale = true;
 
 	void SetExtradataValue(AssDialogue& line, std::string const& key, std::string const& value, bool del);
+	/// Work out what a commit changed and update committed_ids
+	AssFileChanges GetChanges(int type, const AssDialogue *single_line);
 public:
 	/// The lines in the file
 	std::vector<AssInfo> Info;
@@ -110,17 +157,34 @@ public:
 
 	EntryList<AssDialogue>::iterator iterator_to(AssDialogue& line);
 
+	/// Get the dialogue lines, including comments, whose times overlap the
+	/// half-open range [start, end), in file order
+	///
+	/// Only changes which have been committed are seen by this.
+	std::vector<AssDialogue *> EventsOverlapping(int start, int end);
+	/// Get the dialogue lines, including comments, shown at the given time
+	std::vector<AssDialogue *> EventsAt(int time) { return EventsOverlapping(time, time + 1); }
+
 	/// @brief Load default file
 	/// @param defline Add a blank line to the file
 	/// @param style_catalog Style catalog name to fill styles from, blank to use default style
 	void LoadDefault(bool defline = true, std::string const& style_catalog = std::string());
 	/// Attach a file to the ass file
 	void InsertAttachment(agi::fs::path const& filename);
+	/// Attach files read with ReadAttachmentFiles, skipping any which are
+	/// identical to an existing attachment or to an earlier file
+	/// @param files Files to attach; duplicates are flagged as such
+	/// @return Number of files attached
+	size_t InsertAttachments(std::vector<AttachmentFile>& files);
 	/// Get the names of all of the styles available
 	std::vector<std::string> GetStyles() const;
 	/// @brief Get a style by name
 	/// @param name Style name
 	/// @return Pointer to style or nullptr
+	///
+	/// Styles are looked up in an index which is rebuilt after commits
+	/// which change the styles. Styles added or renamed since then are still
+	/// found, but styles deleted since then must not be looked up.
 	AssStyle *GetStyle(std::string const& name);
 
 	void swap(AssFile &) throw();
@@ -151,6 +215,9 @@ public:
 	uint32_t AddExtradata(std::string const& key, std::string const& value);
 	/// Fetch all extradata entries from a list of IDs
 	std::vector<ExtradataEntry> GetExtradata(std::vector<uint32_t> const& id_list) const;
+	/// Find the entry for a key from a list of IDs without copying it
+	/// @return The first entry with the key, or nullptr if there is none
+	ExtradataEntry const *FindExtradata(std::vector<uint32_t> const& id_list, std::string const& key) const;
 	/// Set an extradata kex:value pair for a dialogue line, clearing previous values for this key if necessary
 	void SetExtradataValue(AssDialogue& line, std::string const& key, std::string const& value) { SetExtradataValue(line, key, value, false); };
 	/// Delete any extradata values for the given key
@@ -195,6 +262,7 @@ public:
 	DEFINE_SIGNAL_ADDERS(AnnouncePreCommit, AddPreCommitListener)
 	DEFINE_SIGNAL_ADDERS(AnnounceCommit, AddCommitListener)
 	DEFINE_SIGNAL_ADDERS(PushState, AddUndoManager)
+	DEFINE_SIGNAL_ADDERS(AnnounceChanges, AddChangesListener)
 
 	/// @brief Flag the file as modified and push a copy onto the undo stack
 	/// @param desc        Undo description
@@ -227,9 +295,12 @@ public:
 	/// @brief Sort the dialogue lines in this file
 	/// @param comp Comparison function to use. Defaults to sorting by start time.
 	/// @param limit If non-empty, only lines in this set are sorted
-	void Sort(CompFunc comp = CompStart, std::set<AssDialogue*> const& limit = std::set<AssDialogue*>());
+	void Sort(CompFunc comp = CompStart, Selection const& limit = Selection());
 	/// @brief Sort the dialogue lines in the given list
+	///
+	/// The sort is stable, and the Row of each line is updated to its new
+	/// position in the list.
 	/// @param comp Comparison function to use. Defaults to sorting by start time.
 	/// @param limit If non-empty, only lines in this set are sorted
-	static void Sort(EntryList<AssDialogue>& lst, CompFunc comp = CompStart, std::set<AssDialogue*> const& limit = std::set<AssDialogue*>());
+	static void Sort(EntryList<AssDialogue>& lst, CompFunc comp = CompStart, Selection const& limit = Selection());
 };
@@ -23,6 +23,7 @@
 #include "subtitle_format.h"
 
 #include <libaegisub/ass/uuencode.h>
+#include <libaegisub/dispatch.h>
 #include <libaegisub/make_unique.h>
 #include <libaegisub/util.h>
 
@@ -33,7 +34,16 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/regex.hpp>
 #include <boost/variant.hpp>
+#include <exception>
 #include <unordered_map>
+#include <vector>
+
+namespace {
+/// Number of event lines to buffer before parsing them
+const size_t event_batch_size = 65536;
+/// Number of event lines parsed by a worker at a time
+const size_t event_chunk_size = 4096;
+}
 
 class AssParser::HeaderToProperty {
 	using field = boost::variant<
@@ -61,6 +71,7 @@ public:
 		{"Video Position", &ProjectProperties::video_position},
 		{"Video AR Mode", &ProjectProperties::ar_mode},
 		{"Video AR Value", &ProjectProperties::ar_value},
+		{"Disable Hardware Decoding", &ProjectProperties::disable_hw_decoding},
 		{"Aegisub Video Zoom Percent", &ProjectProperties::video_zoom},
 		{"Aegisub Scroll Position", &ProjectProperties::scroll_position},
 		{"Aegisub Active Line", &ProjectProperties::active_row},
@@ -118,6 +129,7 @@ void AssParser::ParseAttachmentLine(std::string const& data) {
 
 	// Data is over, add attachment to the file
 	if (!valid_data || is_filename) {
+		attach->FinishData();
 		target->Attachments.push_back(*attach.release());
 		AddLine(data);
 	}
@@ -125,8 +137,10 @@ void AssParser::ParseAttachmentLine(std::string const& data) {
 		attach->AddData(data);
 
 		// Done building
-		if (data.size() < 80)
+		if (data.size() < 80) {
+			attach->FinishData();
 			target->Attachments.push_back(*attach.release());
+		}
 	}
 }
 
@@ -177,8 +191,47 @@ void AssParser::ParseMetadataLine(std::string const& data) {
 }
 
 void AssParser::ParseEventLine(std::string const& data) {
-	if (boost::starts_with(data, "Dialogue:") || boost::starts_with(data, "Comment:"))
-		target->Events.push_back(*new AssDialogue(data));
+	if (boost::starts_with(data, "Dialogue:") || boost::starts_with(data, "Comment:")) {
+		pending_events.push_back(data);
+		if (pending_events.size() >= event_batch_size)
+			ParsePendingEvents();
+	}
+}
+
+void AssParser::ParsePendingEvents() {
+	auto lines = std::move(pending_events);
+	pending_events.clear();
+
+	// Parse each chunk of lines into its own list, then splice the lists
+	// together in order so that the result is the same as parsing them one
+	// at a time. Flyweight interning and line allocation are thread-safe.
+	const size_t count = (lines.size() + event_chunk_size - 1) / event_chunk_size;
+	std::vector<EntryList<AssDialogue>> chunks(count);
+	std::vector<std::exception_ptr> errors(count);
+	agi::dispatch::Parallel(count, [&](size_t i) {
+		try {
+			const size_t end = std::min(lines.size(), (i + 1) * event_chunk_size);
+			for (size_t j = i * event_chunk_size; j < end; ++j)
+				chunks[i].push_back(*new AssDialogue(lines[j]));
+		}
+		catch (...) {
+			errors[i] = std::current_exception();
+		}
+	});
+
+	// Keep the lines before the first bad one, as parsing sequentially would
+	for (size_t i = 0; i < count; ++i) {
+		target->Events.splice(target->Events.end(), chunks[i]);
+		if (errors[i]) {
+			for (auto& chunk : chunks)
+				chunk.clear_and_dispose([](AssDialogue *e) { delete e; });
+			std::rethrow_exception(errors[i]);
+		}
+	}
+}
+
+void AssParser::Finish() {
+	ParsePendingEvents();
 }
 
 void AssParser::ParseStyleLine(std::string const& data) {
@@ -13,6 +13,8 @@
 // OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
 #include <memory>
+#include <string>
+#include <vector>
 
 class AssAttachment;
 class AssFile;
@@ -26,6 +28,11 @@ class AssParser {
 	std::unique_ptr<AssAttachment> attach;
 	void (AssParser::*state)(std::string const&);
 
+	/// Event lines which have been read but not yet parsed
+	std::vector<std::string> pending_events;
+	/// Parse the pending event lines, in parallel if there are many of them
+	void ParsePendingEvents();
+
 	void ParseAttachmentLine(std::string const& data);
 	void ParseEventLine(std::string const& data);
 	void ParseStyleLine(std::string const& data);
@@ -40,4 +47,8 @@ public:
 	~AssParser();
 
 	void AddLine(std::string const& data);
+
+	/// Parse any lines which are still buffered. Must be called after the
+	/// last line has been added.
+	void Finish();
 };
@@ -0,0 +1,395 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file ass_sidecar.cpp
+/// @brief Binary cache of parsed ASS files
+/// @ingroup subtitle_io
+
+#include "ass_sidecar.h"
+
+#include "ass_attachment.h"
+#include "ass_dialogue.h"
+#include "ass_file.h"
+#include "ass_info.h"
+#include "ass_style.h"
+#include "options.h"
+#include "utils.h"
+
+#include <libaegisub/dispatch.h>
+#include <libaegisub/file_mapping.h>
+#include <libaegisub/fs.h>
+#include <libaegisub/io.h>
+#include <libaegisub/log.h>
+#include <libaegisub/make_unique.h>
+#include <libaegisub/path.h>
+
+#include <boost/crc.hpp>
+#include <cstring>
+
+namespace {
+DEFINE_EXCEPTION(SidecarError, agi::Exception);
+
+const char magic[8] = {'A', 'G', 'I', 'S', 'C', 'A', 'S', 'S'};
+/// Bump whenever the layout below changes so that old caches are ignored
+const uint32_t format_version = 1;
+/// Files smaller than this parse quickly enough that caching them isn't worthwhile
+const uint64_t min_source_size = 1 << 20;
+
+/// Hash the contents of a file, reading it a window at a time
+uint64_t HashFile(agi::fs::path const& path) {
+	agi::read_file_mapping file(path);
+	const uint64_t size = file.size();
+	const uint64_t window = 16 << 20;
+
+	uint64_t hash = 0xcbf29ce484222325 ^ size;
+	for (uint64_t offset = 0; offset < size; offset += window) {
+		const uint64_t length = std::min(window, size - offset);
+		const char *data = file.read(offset, length);
+
+		uint64_t i = 0;
+		for (; i + 8 <= length; i += 8) {
+			uint64_t word;
+			memcpy(&word, data + i, sizeof word);
+			hash = (hash ^ word) * 0x100000001b3;
+			hash ^= hash >> 29;
+		}
+		for (; i < length; ++i)
+			hash = (hash ^ static_cast<unsigned char>(data[i])) * 0x100000001b3;
+	}
+	return hash;
+}
+
+/// Appends values to the cache in their in-memory representation
+struct Writer {
+	std::string out;
+
+	template<typename T>
+	void Int(T value) {
+		out.append(reinterpret_cast<const char *>(&value), sizeof value);
+	}
+
+	void String(std::string const& str) {
+		Int<uint32_t>(str.size());
+		out += str;
+	}
+
+	void Color(agi::Color const& color) {
+		Int(color.r); Int(color.g); Int(color.b); Int(color.a);
+	}
+};
+
+/// Reads values written by Writer directly out of the mapped cache
+struct Reader {
+	const char *pos;
+	const char *end;
+
+	void Need(uint64_t bytes) {
+		if (static_cast<uint64_t>(end - pos) < bytes)
+			throw SidecarError("Subtitle cache file is truncated");
+	}
+
+	template<typename T>
+	T Int() {
+		Need(sizeof(T));
+		T value;
+		memcpy(&value, pos, sizeof value);
+		pos += sizeof value;
+		return value;
+	}
+
+	std::string String() {
+		auto size = Int<uint32_t>();
+		Need(size);
+		std::string str(pos, size);
+		pos += size;
+		return str;
+	}
+
+	agi::Color Color() {
+		agi::Color color;
+		color.r = Int<unsigned char>();
+		color.g = Int<unsigned char>();
+		color.b = Int<unsigned char>();
+		color.a = Int<unsigned char>();
+		return color;
+	}
+
+	/// Read an element count, which must fit in what is left of the file
+	/// as every element takes at least a byte
+	uint32_t Count() {
+		auto count = Int<uint32_t>();
+		Need(count);
+		return count;
+	}
+};
+
+void WriteStyle(Writer& w, AssStyle const& style) {
+	w.String(style.name);
+	w.String(style.font);
+	w.Int(style.fontsize);
+	w.Color(style.primary);
+	w.Color(style.secondary);
+	w.Color(style.outline);
+	w.Color(style.shadow);
+	w.Int<uint8_t>(style.bold | style.italic << 1 | style.underline << 2 | style.strikeout << 3);
+	w.Int(style.scalex);
+	w.Int(style.scaley);
+	w.Int(style.spacing);
+	w.Int(style.angle);
+	w.Int<int32_t>(style.borderstyle);
+	w.Int(style.outline_w);
+	w.Int(style.shadow_w);
+	w.Int<int32_t>(style.alignment);
+	for (int margin : style.Margin)
+		w.Int<int32_t>(margin);
+	w.Int<int32_t>(style.encoding);
+}
+
+AssStyle *ReadStyle(Reader& r) {
+	auto style = agi::make_unique<AssStyle>();
+	style->name = r.String();
+	style->font = r.String();
+	style->fontsize = r.Int<double>();
+	style->primary = r.Color();
+	style->secondary = r.Color();
+	style->outline = r.Color();
+	style->shadow = r.Color();
+	auto flags = r.Int<uint8_t>();
+	style->bold = !!(flags & 1);
+	style->italic = !!(flags & 2);
+	style->underline = !!(flags & 4);
+	style->strikeout = !!(flags & 8);
+	style->scalex = r.Int<double>();
+	style->scaley = r.Int<double>();
+	style->spacing = r.Int<double>();
+	style->angle = r.Int<double>();
+	style->borderstyle = r.Int<int32_t>();
+	style->outline_w = r.Int<double>();
+	style->shadow_w = r.Int<double>();
+	style->alignment = r.Int<int32_t>();
+	for (int& margin : style->Margin)
+		margin = r.Int<int32_t>();
+	style->encoding = r.Int<int32_t>();
+	style->UpdateData();
+	return style.release();
+}
+
+void WriteEvent(Writer& w, AssDialogue const& line) {
+	w.Int<uint8_t>(line.Comment);
+	w.Int<int32_t>(line.Layer);
+	w.Int<int32_t>(line.Start);
+	w.Int<int32_t>(line.End);
+	for (int margin : line.Margin)
+		w.Int<int32_t>(margin);
+	w.String(line.Style);
+	w.String(line.Actor);
+	w.String(line.Effect);
+	w.String(line.Text);
+	auto const& ids = line.ExtradataIds.get();
+	w.Int<uint32_t>(ids.size());
+	for (uint32_t id : ids)
+		w.Int(id);
+}
+
+AssDialogue *ReadEvent(Reader& r) {
+	auto line = agi::make_unique<AssDialogue>();
+	line->Comment = !!r.Int<uint8_t>();
+	line->Layer = r.Int<int32_t>();
+	line->Start = r.Int<int32_t>();
+	line->End = r.Int<int32_t>();
+	for (int& margin : line->Margin)
+		margin = r.Int<int32_t>();
+	line->Style = r.String();
+	line->Actor = r.String();
+	line->Effect = r.String();
+	line->Text = r.String();
+	auto count = r.Count();
+	if (count) {
+		std::vector<uint32_t> ids(count);
+		for (auto& id : ids)
+			id = r.Int<uint32_t>();
+		line->ExtradataIds = std::move(ids);
+	}
+	return line.release();
+}
+
+void WriteProperties(Writer& w, ProjectProperties const& p) {
+	for (auto str : {&p.automation_scripts, &p.export_filters, &p.export_encoding,
+	                 &p.style_storage, &p.audio_file, &p.video_file,
+	                 &p.timecodes_file, &p.keyframes_file})
+		w.String(*str);
+	w.Int<uint32_t>(p.automation_settings.size());
+	for (auto const& setting : p.automation_settings) {
+		w.String(setting.first);
+		w.String(setting.second);
+	}
+	w.Int(p.video_zoom);
+	w.Int(p.ar_value);
+	for (int value : {p.scroll_position, p.active_row, p.ar_mode, p.video_position, p.disable_hw_decoding})
+		w.Int<int32_t>(value);
+}
+
+void ReadProperties(Reader& r, ProjectProperties& p) {
+	for (auto str : {&p.automation_scripts, &p.export_filters, &p.export_encoding,
+	                 &p.style_storage, &p.audio_file, &p.video_file,
+	                 &p.timecodes_file, &p.keyframes_file})
+		*str = r.String();
+	for (auto count = r.Count(); count; --count) {
+		auto key = r.String();
+		p.automation_settings[key] = r.String();
+	}
+	p.video_zoom = r.Int<double>();
+	p.ar_value = r.Int<double>();
+	for (auto value : {&p.scroll_position, &p.active_row, &p.ar_mode, &p.video_position, &p.disable_hw_decoding})
+		*value = r.Int<int32_t>();
+}
+}
+
+AssSidecar::AssSidecar(agi::fs::path const& source, std::string const& encoding, int version)
+: source(source)
+, encoding(encoding)
+, version(version)
+{
+	if (!OPT_GET("Subtitle Format/ASS/Sidecar Cache/Enabled")->GetBool())
+		return;
+
+	try {
+		source_size = agi::fs::Size(source);
+		if (source_size < min_source_size)
+			return;
+		source_time = agi::fs::ModifiedTime(source);
+		source_hash = HashFile(source);
+	}
+	catch (agi::Exception const& e) {
+		LOG_D("ass/sidecar") << "not caching " << source << ": " << e.GetMessage();
+		return;
+	}
+
+	boost::crc_32_type hash;
+	auto const& name = source.string();
+	hash.process_bytes(name.c_str(), name.size());
+	cache = config::path->Decode("?local/subcache/" + std::to_string(hash.checksum()) + ".agisc");
+	enabled = true;
+}
+
+bool AssSidecar::Load(AssFile *target) const {
+	if (!enabled || !agi::fs::FileExists(cache)) return false;
+
+	try {
+		agi::read_file_mapping file(cache);
+		Reader r{file.read(), nullptr};
+		r.end = r.pos + file.size();
+
+		r.Need(sizeof magic);
+		if (memcmp(r.pos, magic, sizeof magic)) return false;
+		r.pos += sizeof magic;
+		if (r.Int<uint32_t>() != format_version) return false;
+		if (r.Int<int32_t>() != version) return false;
+		if (r.Int<uint64_t>() != source_size) return false;
+		if (r.Int<int64_t>() != source_time) return false;
+		if (r.Int<uint64_t>() != source_hash) return false;
+		if (r.String() != encoding) return false;
+
+		// Fill a scratch file so that a bad cache can't leave the target half loaded
+		AssFile loaded;
+		for (auto count = r.Count(); count; --count) {
+			auto key = r.String();
+			loaded.Info.emplace_back(std::move(key), r.String());
+		}
+		for (auto count = r.Count(); count; --count)
+			loaded.Styles.push_back(*ReadStyle(r));
+		for (auto count = r.Count(); count; --count)
+			loaded.Events.push_back(*ReadEvent(r));
+		for (auto count = r.Count(); count; --count) {
+			auto group = static_cast<AssEntryGroup>(r.Int<uint8_t>());
+			loaded.Attachments.emplace_back(agi::Interned<std::string>(r.String()), group);
+		}
+		for (auto count = r.Count(); count; --count) {
+			auto id = r.Int<uint32_t>();
+			auto key = r.String();
+			loaded.Extradata.push_back(ExtradataEntry{id, 0, std::move(key), r.String()});
+		}
+		loaded.next_extradata_id = r.Int<uint32_t>();
+		ReadProperties(r, loaded.Properties);
+		if (r.pos != r.end) return false;
+
+		loaded.Filename = target->Filename;
+		target->swap(loaded);
+		LOG_D("ass/sidecar") << "loaded " << source << " from " << cache;
+		return true;
+	}
+	catch (agi::Exception const& e) {
+		LOG_D("ass/sidecar") << "ignoring " << cache << ": " << e.GetMessage();
+	}
+	catch (std::exception const& e) {
+		LOG_D("ass/sidecar") << "ignoring " << cache << ": " << e.what();
+	}
+	return false;
+}
+
+void AssSidecar::Store(AssFile const& file) const {
+	if (!enabled) return;
+
+	Writer w;
+	w.out.append(magic, sizeof magic);
+	w.Int(format_version);
+	w.Int<int32_t>(version);
+	w.Int(source_size);
+	w.Int(source_time);
+	w.Int(source_hash);
+	w.String(encoding);
+
+	w.Int<uint32_t>(file.Info.size());
+	for (auto const& info : file.Info) {
+		w.String(info.Key());
+		w.String(info.Value());
+	}
+	w.Int<uint32_t>(std::distance(file.Styles.begin(), file.Styles.end()));
+	for (auto const& style : file.Styles)
+		WriteStyle(w, style);
+	w.Int<uint32_t>(std::distance(file.Events.begin(), file.Events.end()));
+	for (auto const& line : file.Events)
+		WriteEvent(w, line);
+	w.Int<uint32_t>(file.Attachments.size());
+	for (auto const& attach : file.Attachments) {
+		w.Int<uint8_t>(static_cast<uint8_t>(attach.Group()));
+		w.String(attach.GetEntryData());
+	}
+	w.Int<uint32_t>(file.Extradata.size());
+	for (auto const& entry : file.Extradata) {
+		w.Int(entry.id);
+		w.String(entry.key);
+		w.String(entry.value);
+	}
+	w.Int(file.next_extradata_id);
+	WriteProperties(w, file.Properties);
+
+	agi::dispatch::Background(agi::dispatch::Priority::Bulk).Async([cache = cache, data = std::move(w.out)] {
+		try {
+			agi::fs::CreateDirectory(cache.parent_path());
+			agi::io::Save(cache, true).Get().write(data.data(), data.size());
+		}
+		catch (agi::Exception const& e) {
+			LOG_E("ass/sidecar") << "failed to write " << cache << ": " << e.GetMessage();
+			return;
+		}
+
+		agi::dispatch::Main().Async([=] {
+			CleanCache(cache.parent_path(), "*.agisc",
+				OPT_GET("Subtitle Format/ASS/Sidecar Cache/Size")->GetInt(),
+				OPT_GET("Subtitle Format/ASS/Sidecar Cache/Files")->GetInt());
+		});
+	});
+}
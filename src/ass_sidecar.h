@@ -0,0 +1,62 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file ass_sidecar.h
+/// @brief Binary cache of parsed ASS files
+/// @ingroup subtitle_io
+
+#pragma once
+
+#include <libaegisub/fs_fwd.h>
+
+#include <boost/filesystem/path.hpp>
+#include <cstdint>
+#include <string>
+
+class AssFile;
+
+/// @class AssSidecar
+/// @brief Cache of the parsed contents of a large ASS file
+///
+/// Parsing a file with hundreds of thousands of lines takes a noticeable
+/// amount of time, so after a large file is parsed its contents are saved in
+/// a binary form which can be read back far faster than the text can be
+/// parsed. The cache is only used if the size, modification time and a hash
+/// of the contents of the subtitle file all still match, so the subtitle file
+/// remains the only source of truth and a stale cache is simply ignored.
+class AssSidecar {
+	agi::fs::path source;
+	agi::fs::path cache;
+	std::string encoding;
+	int version;
+
+	bool enabled = false;
+	uint64_t source_size = 0;
+	int64_t source_time = 0;
+	uint64_t source_hash = 0;
+
+public:
+	/// @param source   Subtitle file being read
+	/// @param encoding Character set the file is being read with
+	/// @param version  ASS version the file is being parsed as
+	AssSidecar(agi::fs::path const& source, std::string const& encoding, int version);
+
+	/// Fill the given empty file from the cache, if there is a valid one
+	/// @return Was the file loaded?
+	bool Load(AssFile *target) const;
+
+	/// Save the parsed contents of the source file to the cache in the background
+	void Store(AssFile const& file) const;
+};
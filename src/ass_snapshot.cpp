@@ -0,0 +1,91 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include "ass_snapshot.h"
+
+#include <libaegisub/make_unique.h>
+
+#include <unordered_map>
+
+std::shared_ptr<const AssSnapshot> AssSnapshot::Create(AssFile const& file, AssSnapshot const *previous) {
+	auto header = std::make_shared<Header>();
+	header->Info = file.Info;
+	header->Styles.assign(file.Styles.begin(), file.Styles.end());
+	header->Attachments = file.Attachments;
+	header->Extradata = file.Extradata;
+	header->Filename = file.Filename;
+	header->next_extradata_id = file.next_extradata_id;
+
+	auto snapshot = std::make_shared<AssSnapshot>();
+	snapshot->header = std::move(header);
+	snapshot->events.reserve(file.Events.size());
+
+	// Rows only shift when lines are added or removed, so the line at the
+	// same row is almost always the previous version of the line, and the
+	// index by Id is needed only for the lines after an insertion
+	std::unordered_map<int, size_t> previous_rows;
+	auto find_previous = [&](AssDialogue const& line, size_t row) -> std::shared_ptr<const AssDialogue> const * {
+		if (!previous) return nullptr;
+		auto const& events = previous->events;
+		if (row < events.size() && events[row]->Id == line.Id)
+			return &events[row];
+		if (previous_rows.empty()) {
+			previous_rows.reserve(events.size());
+			for (size_t i = 0; i < events.size(); ++i)
+				previous_rows[events[i]->Id] = i;
+		}
+		auto it = previous_rows.find(line.Id);
+		return it == previous_rows.end() ? nullptr : &events[it->second];
+	};
+
+	for (auto const& line : file.Events) {
+		const size_t row = snapshot->events.size();
+		auto old = find_previous(line, row);
+		if (old && SameContents(**old, line) && (*old)->Row == line.Row)
+			snapshot->events.push_back(*old);
+		else {
+			// Copied as the base so that the copy keeps the line's Id, and
+			// serialized now as the renderers read it from other threads
+			auto copy = std::make_shared<AssDialogue>(static_cast<AssDialogueBase const&>(line));
+			copy->GetEntryData();
+			snapshot->events.push_back(std::move(copy));
+		}
+	}
+
+	return snapshot;
+}
+
+void AssSnapshot::ReplaceLine(std::shared_ptr<const AssSnapshot>& snapshot, std::shared_ptr<const AssDialogue> line) {
+	// Something else may be reading the snapshot if there is any other
+	// reference to it, but if not no one else can get one
+	if (snapshot.use_count() != 1)
+		snapshot = std::make_shared<AssSnapshot>(*snapshot);
+	line->GetEntryData();
+	const_cast<AssSnapshot&>(*snapshot).events[line->Row] = std::move(line);
+}
+
+std::unique_ptr<AssFile> AssSnapshot::ToFile() const {
+	auto file = agi::make_unique<AssFile>();
+	file->Info = header->Info;
+	for (auto const& style : header->Styles)
+		file->Styles.push_back(*new AssStyle(style));
+	file->Attachments = header->Attachments;
+	file->Extradata = header->Extradata;
+	file->Filename = header->Filename;
+	file->next_extradata_id = header->next_extradata_id;
+	for (auto const& line : events)
+		file->Events.push_back(*new AssDialogue(*line));
+	return file;
+}
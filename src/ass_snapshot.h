@@ -0,0 +1,68 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file ass_snapshot.h
+/// @brief Immutable copies of subtitle files for use on other threads
+/// @ingroup subs_storage
+
+#pragma once
+
+#include "ass_attachment.h"
+#include "ass_dialogue.h"
+#include "ass_file.h"
+#include "ass_info.h"
+#include "ass_style.h"
+
+#include <memory>
+#include <vector>
+
+/// @class AssSnapshot
+/// @brief A read-only copy of a subtitle file at one point in time
+///
+/// Lines are reference counted and shared with the snapshot a new one is
+/// made from if they haven't changed, so making a snapshot after an edit
+/// only copies the lines which were edited and everything else is a
+/// pointer copy. Nothing in a snapshot is ever modified once it has been
+/// shared, so snapshots can be read from any thread without locking.
+class AssSnapshot {
+public:
+	/// Everything other than the dialogue lines
+	struct Header {
+		std::vector<AssInfo> Info;
+		std::vector<AssStyle> Styles;
+		std::vector<AssAttachment> Attachments;
+		std::vector<ExtradataEntry> Extradata;
+		agi::fs::path Filename;
+		uint32_t next_extradata_id = 0;
+	};
+
+	std::shared_ptr<const Header> header;
+	/// The dialogue lines, indexed by row
+	std::vector<std::shared_ptr<const AssDialogue>> events;
+
+	/// @brief Make a snapshot of a file
+	/// @param file File to copy
+	/// @param previous Earlier snapshot of the same file to share unchanged lines with
+	static std::shared_ptr<const AssSnapshot> Create(AssFile const& file, AssSnapshot const *previous = nullptr);
+
+	/// @brief Replace the line at the same row as the given line
+	/// @param snapshot Snapshot to modify, which is copied first unless it's
+	///                 the only reference to it
+	/// @param line New version of the line
+	static void ReplaceLine(std::shared_ptr<const AssSnapshot>& snapshot, std::shared_ptr<const AssDialogue> line);
+
+	/// Make a modifiable copy of the file the snapshot was made from
+	std::unique_ptr<AssFile> ToFile() const;
+};
@@ -38,12 +38,29 @@
 #include "utils.h"
 
 #include <libaegisub/format.h>
+#include <libaegisub/slab_pool.h>
 #include <libaegisub/split.h>
 
 #include <boost/algorithm/string/trim.hpp>
 #include <boost/lexical_cast.hpp>
 #include <wx/intl.h>
 
+static agi::SlabPool& style_pool() {
+	// Intentionally never destroyed, as styles held by other statics may
+	// outlive it
+	static auto pool = new agi::SlabPool(sizeof(AssStyle), 64);
+	return *pool;
+}
+
+void *AssStyle::operator new(size_t size) {
+	assert(size == sizeof(AssStyle));
+	return style_pool().Allocate();
+}
+
+void AssStyle::operator delete(void *ptr) {
+	style_pool().Free(ptr);
+}
+
 AssStyle::AssStyle() {
 	std::fill(Margin.begin(), Margin.end(), 10);
 
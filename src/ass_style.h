@@ -27,6 +27,8 @@
 //
 // Aegisub Project http://www.aegisub.org/
 
+#pragma once
+
 #include "ass_entry.h"
 
 #include <libaegisub/color.h>
@@ -73,6 +75,10 @@ public:
 	AssStyle();
 	AssStyle(std::string const& data, int version=1);
 
+	/// Styles are allocated from a pool along with dialogue lines
+	static void *operator new(size_t size);
+	static void operator delete(void *ptr);
+
 	std::string const& GetEntryData() const { return data; }
 	AssEntryGroup Group() const override;
 
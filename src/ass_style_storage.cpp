@@ -44,10 +44,49 @@
 #include <libaegisub/make_unique.h>
 #include <libaegisub/path.h>
 
+#include <boost/algorithm/string/case_conv.hpp>
 #include <boost/algorithm/string/predicate.hpp>
+#include <map>
+
+namespace {
+/// A catalog file as it was when it was last read or written
+struct CachedCatalog {
+	time_t modified;
+	uintmax_t size;
+	std::vector<std::unique_ptr<AssStyle>> styles;
+};
+
+/// Parsed catalogs, so that switching back and forth between catalogs (or
+/// creating lots of new files with one) doesn't reparse unchanged files.
+/// Only used from the main thread.
+std::map<agi::fs::path, CachedCatalog>& catalog_cache() {
+	static std::map<agi::fs::path, CachedCatalog> cache;
+	return cache;
+}
+
+std::vector<std::unique_ptr<AssStyle>> copy_styles(std::vector<std::unique_ptr<AssStyle>> const& styles) {
+	std::vector<std::unique_ptr<AssStyle>> copy;
+	copy.reserve(styles.size());
+	for (auto const& style : styles)
+		copy.push_back(agi::make_unique<AssStyle>(*style));
+	return copy;
+}
+
+void update_cache(agi::fs::path const& file, std::vector<std::unique_ptr<AssStyle>> const& styles) {
+	try {
+		auto& cached = catalog_cache()[file];
+		cached.modified = agi::fs::ModifiedTime(file);
+		cached.size = agi::fs::Size(file);
+		cached.styles = copy_styles(styles);
+	}
+	catch (agi::fs::FileSystemError const&) {
+		catalog_cache().erase(file);
+	}
+}
+}
 
 AssStyleStorage::~AssStyleStorage() { }
-void AssStyleStorage::clear() { style.clear(); }
+void AssStyleStorage::clear() { style.clear(); index.clear(); }
 void AssStyleStorage::push_back(std::unique_ptr<AssStyle> new_style) { style.emplace_back(std::move(new_style)); }
 
 void AssStyleStorage::Save() const {
@@ -55,17 +94,33 @@ void AssStyleStorage::Save() const {
 
 	agi::fs::CreateDirectory(file.parent_path());
 
-	agi::io::Save out(file);
-	out.Get() << "\xEF\xBB\xBF";
+	{
+		agi::io::Save out(file);
+		out.Get() << "\xEF\xBB\xBF";
 
-	for (auto const& cur : style)
-		out.Get() << cur->GetEntryData() << std::endl;
+		for (auto const& cur : style)
+			out.Get() << cur->GetEntryData() << std::endl;
+	}
+
+	update_cache(file, style);
 }
 
 void AssStyleStorage::Load(agi::fs::path const& filename) {
 	file = filename;
 	clear();
 
+	auto it = catalog_cache().find(file);
+	if (it != catalog_cache().end()) {
+		try {
+			if (agi::fs::ModifiedTime(file) == it->second.modified && agi::fs::Size(file) == it->second.size) {
+				style = copy_styles(it->second.styles);
+				return;
+			}
+		}
+		catch (agi::fs::FileSystemError const&) { }
+		catalog_cache().erase(it);
+	}
+
 	try {
 		auto in = agi::io::Open(file);
 		for (auto const& line : agi::line_iterator<std::string>(*in)) {
@@ -78,7 +133,10 @@ void AssStyleStorage::Load(agi::fs::path const& filename) {
 	}
 	catch (agi::fs::FileNotAccessible const&) {
 		// Just treat a missing file as an empty file
+		return;
 	}
+
+	update_cache(file, style);
 }
 
 void AssStyleStorage::LoadCatalog(std::string const& catalogname) {
@@ -98,11 +156,20 @@ std::vector<std::string> AssStyleStorage::GetNames() {
 }
 
 AssStyle *AssStyleStorage::GetStyle(std::string const& name) {
-	for (auto& cur : style) {
-		if (boost::iequals(cur->name, name))
-			return cur.get();
-	}
-	return nullptr;
+	auto key = boost::to_lower_copy(name);
+
+	// Styles can be renamed, added and removed behind the index's back, so
+	// check that what it finds is still right and rebuild it if not
+	auto it = index.find(key);
+	if (it != index.end() && it->second < style.size() && boost::iequals(style[it->second]->name, name))
+		return style[it->second].get();
+
+	index.clear();
+	for (size_t i = 0; i < style.size(); ++i)
+		index.emplace(boost::to_lower_copy(style[i]->name), i);
+
+	it = index.find(key);
+	return it == index.end() ? nullptr : style[it->second].get();
 }
 
 std::vector<std::string> AssStyleStorage::GetCatalogs() {
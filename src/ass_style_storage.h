@@ -37,6 +37,7 @@
 #include <boost/filesystem/path.hpp>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 class AssFile;
@@ -45,6 +46,8 @@ class AssStyle;
 class AssStyleStorage {
 	agi::fs::path file;
 	std::vector<std::unique_ptr<AssStyle>> style;
+	/// Lowercased style names to their index in style, possibly outdated
+	std::unordered_map<std::string, size_t> index;
 
 public:
 	~AssStyleStorage();
@@ -18,12 +18,28 @@
 
 #include "ass_dialogue.h"
 #include "ass_file.h"
-#include "export_fixstyle.h"
+#include "ass_snapshot.h"
 #include "include/aegisub/subtitles_provider.h"
+#include "options.h"
 #include "video_frame.h"
 #include "video_provider_manager.h"
 
+#include <libaegisub/background_runner.h>
 #include <libaegisub/dispatch.h>
+#include <libaegisub/log.h>
+#include <libaegisub/make_unique.h>
+#include <libaegisub/memory_usage.h>
+#include <libaegisub/trace.h>
+
+#include <algorithm>
+#include <boost/functional/hash.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <thread>
 
 #if BOOST_VERSION >= 106900
 #include <boost/gil.hpp>
@@ -36,28 +52,130 @@ enum {
 	SUBS_FILE_ALREADY_LOADED = -2
 };
 
-std::shared_ptr<VideoFrame> AsyncVideoProvider::ProcFrame(int frame_number, double time, bool raw) {
-	// Find an unused buffer to use or allocate a new one if needed
-	std::shared_ptr<VideoFrame> frame;
-	for (auto& buffer : buffers) {
-		if (buffer.use_count() == 1) {
-			frame = buffer;
-			break;
+namespace {
+/// Maximum number of subtitle overlays to keep around
+const size_t max_overlays = 256;
+/// Maximum total size of the subtitle overlays to keep around
+const size_t max_overlay_bytes = 64 * 1024 * 1024;
+/// Maximum total size of the overlays rendered ahead of playing a range
+const size_t max_prerendered_bytes = 256 * 1024 * 1024;
+/// How long after the last sequential request playback is assumed to have
+/// stopped, so that a jump can be read with the playback decoder
+const auto playback_timeout = std::chrono::milliseconds(500);
+
+/// Overlays rendered by every provider, keyed by time and a hash of
+/// everything which went into rendering them, so that they survive edits
+/// which are undone, switching subtitles provider and reopening the video
+class OverlayCache {
+	struct Entry {
+		double time;
+		size_t content;
+		std::shared_ptr<SubtitlesOverlay> overlay;
+	};
+	std::mutex mutex;
+	/// Most recently used first
+	std::list<Entry> entries;
+	/// Total size in bytes of the overlays
+	size_t bytes = 0;
+
+public:
+	std::shared_ptr<SubtitlesOverlay> Get(double time, size_t content) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = find_if(begin(entries), end(entries), [=](Entry const& e) {
+			return e.time == time && e.content == content;
+		});
+		if (it == end(entries)) return nullptr;
+		entries.splice(begin(entries), entries, it);
+		return it->overlay;
+	}
+
+	void Add(double time, size_t content, std::shared_ptr<SubtitlesOverlay> overlay) {
+		std::lock_guard<std::mutex> lock(mutex);
+		bytes += overlay->size();
+		entries.push_front(Entry{time, content, std::move(overlay)});
+		while (entries.size() > max_overlays || (bytes > max_overlay_bytes && entries.size() > 1)) {
+			bytes -= entries.back().overlay->size();
+			entries.pop_back();
 		}
 	}
 
-	if (!frame) {
-		frame = std::make_shared<VideoFrame>();
-		buffers.push_back(frame);
+	/// Drop the least recently used half of the overlays, or all of them
+	void Trim(bool all) {
+		std::lock_guard<std::mutex> lock(mutex);
+		const size_t keep = all ? 0 : bytes / 2;
+		while (bytes > keep && !entries.empty()) {
+			bytes -= entries.back().overlay->size();
+			entries.pop_back();
+		}
 	}
+};
+
+OverlayCache& overlay_cache() {
+	static OverlayCache cache;
+	return cache;
+}
 
+/// @brief Render the subtitles at a time into a new overlay of the given size
+/// @param last Overlay the provider returned last, which is returned again
+///             if the provider says nothing has changed since then
+/// @return The overlay, and false if rendering was cancelled
+std::pair<std::shared_ptr<SubtitlesOverlay>, bool> render_overlay(SubtitlesProvider &provider,
+	std::shared_ptr<SubtitlesOverlay> const& last, int frame_width, int frame_height, int width, int height, double time)
+{
+	auto overlay = std::make_shared<SubtitlesOverlay>();
+	overlay->scale_x = static_cast<float>(frame_width) / width;
+	overlay->scale_y = static_cast<float>(frame_height) / height;
 	try {
-		source_provider->GetFrame(frame_number, *frame);
+		AGI_TRACE_ZONE("subtitles", "DrawOverlay");
+		// The provider reports when nothing has changed since the last
+		// overlay, which is common when stepping through frames
+		if (!provider.DrawOverlay(*overlay, width, height, time / 1000.) && last)
+			overlay = last;
 	}
-	catch (VideoProviderError const& err) { throw VideoProviderErrorEvent(err); }
+	catch (agi::UserCancelException const&) {
+		return {overlay, false};
+	}
+	return {overlay, true};
+}
 
-	if (raw || !subs_provider || !subs) return frame;
+size_t hash_header(AssSnapshot::Header const& header) {
+	size_t hash = 0;
+	for (auto const& info : header.Info)
+		boost::hash_combine(hash, info.GetEntryData());
+	for (auto const& style : header.Styles)
+		boost::hash_combine(hash, style.GetEntryData());
+	for (auto const& attachment : header.Attachments) {
+		boost::hash_combine(hash, attachment.GetFileName());
+		boost::hash_combine(hash, attachment.GetSize());
+	}
+	return hash;
+}
+}
+
+VideoProvider &AsyncVideoProvider::Decoder() {
+	// Providers which can't give up part way through a decode at least
+	// don't start one for a frame which is already stale
+	if (Interrupted())
+		throw VideoDecodeCancelled("Frame " + std::to_string(frame_number) + " is no longer wanted");
+	return seeking ? *seek_provider : *source_provider;
+}
 
+std::shared_ptr<VideoFrame> AsyncVideoProvider::GetBuffer() {
+	// Find an unused buffer to use or allocate a new one if needed
+	for (auto& buffer : buffers) {
+		if (buffer.use_count() == 1) {
+			// Providers which only make BGRA frames don't set it
+			buffer->format = VideoFrame::Format::BGRA;
+			return buffer;
+		}
+	}
+
+	auto frame = std::make_shared<VideoFrame>();
+	buffers.push_back(frame);
+	return frame;
+}
+
+void AsyncVideoProvider::PrepareSubtitles(int frame_number, double time) {
 	try {
 		if (single_frame != frame_number && single_frame != SUBS_FILE_ALREADY_LOADED) {
 			// Generally edits and seeks come in groups; if the last thing done
@@ -67,19 +185,153 @@ std::shared_ptr<VideoFrame> AsyncVideoProvider::ProcFrame(int frame_number, doub
 			// other lines will probably not be viewed before the file changes
 			// again), and if it's a different frame, export the entire file.
 			if (single_frame != NEW_SUBS_FILE) {
-				subs_provider->LoadSubtitles(subs.get());
+				subs_provider->LoadSubtitles(*subs);
 				single_frame = SUBS_FILE_ALREADY_LOADED;
 			}
 			else {
-				AssFixStylesFilter::ProcessSubs(subs.get());
 				single_frame = frame_number;
-				subs_provider->LoadSubtitles(subs.get(), time);
+				subs_provider->LoadSubtitles(*subs, time);
 			}
 		}
 	}
 	catch (agi::Exception const& err) { throw SubtitlesProviderErrorEvent(err.GetMessage()); }
+}
 
+size_t AsyncVideoProvider::OverlayKey(double time, int width, int height) const {
+	size_t hash = subs_header_hash;
+	boost::hash_combine(hash, subs_provider_name);
+	boost::hash_combine(hash, FrameWidth());
+	boost::hash_combine(hash, FrameHeight());
+	boost::hash_combine(hash, width);
+	boost::hash_combine(hash, height);
+
+	// Lines are hashed in file order, which is also the order which decides
+	// how they collide with each other
+	auto rows = subs_time_index.At(static_cast<int>(std::floor(time)));
+	std::sort(begin(rows), end(rows));
+	for (size_t row : rows) {
+		auto const& line = *subs->events[row];
+		boost::hash_combine(hash, line.Layer);
+		boost::hash_combine(hash, static_cast<int>(line.Start));
+		boost::hash_combine(hash, static_cast<int>(line.End));
+		boost::hash_combine(hash, line.Style.hash());
+		boost::hash_combine(hash, line.Margin[0]);
+		boost::hash_combine(hash, line.Margin[1]);
+		boost::hash_combine(hash, line.Margin[2]);
+		boost::hash_combine(hash, line.Effect.hash());
+		boost::hash_combine(hash, line.Text.hash());
+	}
+	return hash;
+}
+
+void AsyncVideoProvider::ClearPrerendered() {
+	prerendered.clear();
+	prerendered_bytes = 0;
+}
+
+void AsyncVideoProvider::Trim(bool all) {
+	source_provider->TrimCache(all);
+	if (seek_provider)
+		seek_provider->TrimCache(all);
+	overlay_cache().Trim(all);
+
+	// What's been prerendered is about to be played, so it's only dropped
+	// when everything has to go
+	if (all)
+		ClearPrerendered();
+	buffers.erase(remove_if(begin(buffers), end(buffers),
+		[](std::shared_ptr<VideoFrame> const& buffer) { return buffer.use_count() == 1; }),
+		end(buffers));
+}
+
+void AsyncVideoProvider::InvalidatePrerendered(AssDialogue const& line) {
+	auto first = prerendered.lower_bound(static_cast<int>(line.Start));
+	auto last = prerendered.lower_bound(static_cast<int>(line.End));
+	for (auto it = first; it != last; ++it)
+		prerendered_bytes -= it->second->size();
+	prerendered.erase(first, last);
+}
+
+void AsyncVideoProvider::InvalidatePrerendered(AssSnapshot const& new_subs) {
+	if (prerendered.empty()) return;
+	if (!subs || subs->header != new_subs.header || subs->events.size() != new_subs.events.size()) {
+		ClearPrerendered();
+		return;
+	}
+
+	// Unchanged lines are shared between snapshots, so only the rows where
+	// the pointers differ can look different
+	for (size_t row = 0; row < new_subs.events.size(); ++row) {
+		if (subs->events[row] == new_subs.events[row]) continue;
+		InvalidatePrerendered(*subs->events[row]);
+		InvalidatePrerendered(*new_subs.events[row]);
+	}
+}
+
+std::shared_ptr<SubtitlesOverlay> AsyncVideoProvider::GetOverlay(int frame_number, double time) {
+	auto pre = prerendered.find(time);
+	if (pre != prerendered.end())
+		return pre->second;
+
+	const int width = ProxyDimension(FrameWidth(), subtitle_divisor);
+	const int height = ProxyDimension(FrameHeight(), subtitle_divisor);
+	const size_t key = OverlayKey(time, width, height);
+	if (auto cached = overlay_cache().Get(time, key))
+		return cached;
+
+	PrepareSubtitles(frame_number, time);
+
+	auto result = render_overlay(*subs_provider, last_overlay, FrameWidth(), FrameHeight(), width, height, time);
+	auto& overlay = result.first;
+	// Don't cache the blank overlay if cancelled so that it'll be retried
+	if (!result.second)
+		return overlay;
+	last_overlay = overlay;
+	overlay_cache().Add(time, key, overlay);
+	return overlay;
+}
+
+std::shared_ptr<const VideoFrame> AsyncVideoProvider::ProcFrame(int frame_number, double time, bool raw) {
+	AGI_TRACE_ZONE("video", "ProcFrame");
+	const bool draw_subs = !raw && subs_provider && subs;
+
+	std::shared_ptr<SubtitlesOverlay> overlay;
+	if (draw_subs && subs_provider->CanDrawOverlay()) {
+		overlay = GetOverlay(frame_number, time);
+		// Neither the video nor the subtitles have changed, so the last
+		// frame can simply be sent again
+		if (last_frame && frame_number == last_frame_number && overlay == last_frame_overlay)
+			return last_frame;
+
+		if (last_frame && frame_number == last_frame_number && last_frame_overlay) {
+			if (auto frame = RecompositeFrame(frame_number, overlay))
+				return frame;
+		}
+	}
+
+	auto frame = GetBuffer();
 	try {
+		AGI_TRACE_ZONE("video", "GetFrame");
+		// Frames which nothing will be drawn onto can be shared with the
+		// cache rather than copied out of it
+		if (!draw_subs || (overlay && overlay->empty()))
+			return Decoder().GetSharedFrame(frame_number, std::move(frame));
+		Decoder().GetFrame(frame_number, *frame);
+	}
+	catch (VideoProviderError const& err) { throw VideoProviderErrorEvent(err); }
+
+	if (overlay) {
+		overlay->Composite(*frame);
+		last_frame = frame;
+		last_frame_number = frame_number;
+		last_frame_overlay = std::move(overlay);
+		return frame;
+	}
+
+	PrepareSubtitles(frame_number, time);
+
+	try {
+		AGI_TRACE_ZONE("subtitles", "DrawSubtitles");
 		subs_provider->DrawSubtitles(*frame, time / 1000.);
 	}
 	catch (agi::UserCancelException const&) { }
@@ -87,6 +339,135 @@ std::shared_ptr<VideoFrame> AsyncVideoProvider::ProcFrame(int frame_number, doub
 	return frame;
 }
 
+std::shared_ptr<const VideoFrame> AsyncVideoProvider::RecompositeFrame(int frame_number, std::shared_ptr<SubtitlesOverlay> const& overlay) {
+	// The changed area is in overlay pixels, which only match the frame's
+	// at full size
+	if (overlay->scaled() || last_frame_overlay->scaled())
+		return nullptr;
+
+	const FrameRect area = overlay->ChangedArea(*last_frame_overlay);
+	if (area.empty()) {
+		last_frame_overlay = overlay;
+		return last_frame;
+	}
+
+	// Redrawing most of the frame is no cheaper than starting over
+	if (static_cast<size_t>(area.width) * area.height * 2 > last_frame->width * last_frame->height)
+		return nullptr;
+
+	std::shared_ptr<const VideoFrame> raw_frame;
+	try {
+		raw_frame = Decoder().GetSharedFrame(frame_number, GetBuffer());
+	}
+	catch (VideoProviderError const& err) { throw VideoProviderErrorEvent(err); }
+	if (raw_frame->width != last_frame->width || raw_frame->height != last_frame->height)
+		return nullptr;
+
+	// Copy the last frame, put back the video under the part which changed
+	// and draw just that part of the new subtitles over it
+	auto frame = GetBuffer();
+	*frame = *last_frame;
+	const int x1 = std::max(area.x, 0), y1 = std::max(area.y, 0);
+	const int x2 = std::min<int>(area.x + area.width, frame->width);
+	const int y2 = std::min<int>(area.y + area.height, frame->height);
+	for (int row = y1; x1 < x2 && row < y2; ++row)
+		memcpy(frame->PixelAt(x1, row), raw_frame->PixelAt(x1, row), (x2 - x1) * 4);
+	overlay->Composite(*frame, area);
+
+	last_frame = frame;
+	last_frame_overlay = overlay;
+	return frame;
+}
+
+bool AsyncVideoProvider::PreviewBackgroundCurrent(double time) const {
+	if (!preview_background_subs || time != preview_background_time) return false;
+
+	// Unchanged lines are shared between snapshots, so anything other than
+	// the preview rows having been edited shows up as a different pointer
+	auto const& old_events = preview_background_subs->events;
+	if (old_events.size() != subs->events.size() || preview_background_subs->header != subs->header)
+		return false;
+	for (size_t row = 0; row < old_events.size(); ++row) {
+		if (old_events[row] != subs->events[row] && !binary_search(begin(preview_rows), end(preview_rows), row))
+			return false;
+	}
+	return true;
+}
+
+std::shared_ptr<const VideoFrame> AsyncVideoProvider::ProcPreviewFrame(int frame_number, double time) {
+	const int render_time = static_cast<int>(time);
+	try {
+		if (!PreviewBackgroundCurrent(time)) {
+			AssSnapshot rest;
+			rest.header = subs->header;
+			for (size_t row = 0; row < subs->events.size(); ++row) {
+				if (!binary_search(begin(preview_rows), end(preview_rows), row))
+					rest.events.push_back(subs->events[row]);
+			}
+			subs_provider->LoadSubtitles(rest, render_time);
+
+			preview_background = std::make_shared<SubtitlesOverlay>();
+			preview_background_subs.reset();
+			try {
+				subs_provider->DrawOverlay(*preview_background, FrameWidth(), FrameHeight(), time / 1000.);
+				preview_background_time = time;
+				preview_background_subs = subs;
+			}
+			catch (agi::UserCancelException const&) {
+				// Left blank for this frame and retried on the next one
+			}
+		}
+
+		AssSnapshot lines;
+		lines.header = subs->header;
+		for (size_t row : preview_rows) {
+			if (row < subs->events.size())
+				lines.events.push_back(subs->events[row]);
+		}
+		subs_provider->LoadSubtitles(lines, render_time);
+	}
+	catch (agi::Exception const& err) { throw SubtitlesProviderErrorEvent(err.GetMessage()); }
+	// Whatever's loaded now isn't the file
+	single_frame = NEW_SUBS_FILE;
+
+	SubtitlesOverlay layer;
+	try {
+		subs_provider->DrawOverlay(layer, FrameWidth(), FrameHeight(), time / 1000.);
+	}
+	catch (agi::UserCancelException const&) { }
+
+	auto frame = GetBuffer();
+	try {
+		Decoder().GetFrame(frame_number, *frame);
+	}
+	catch (VideoProviderError const& err) { throw VideoProviderErrorEvent(err); }
+	preview_background->Composite(*frame);
+	layer.Composite(*frame);
+	return frame;
+}
+
+std::shared_ptr<const VideoFrame> AsyncVideoProvider::ProcRawFrame(int frame_number) {
+	if (last_raw_frame && frame_number == last_raw_frame_number)
+		return last_raw_frame;
+
+	if (high_depth) {
+		auto frame = GetBuffer();
+		try {
+			high_depth = Decoder().GetHighDepthFrame(frame_number, *frame);
+		}
+		catch (VideoProviderError const& err) { throw VideoProviderErrorEvent(err); }
+		if (high_depth) {
+			last_raw_frame = frame;
+			last_raw_frame_number = frame_number;
+			return last_raw_frame;
+		}
+	}
+
+	last_raw_frame = ProcFrame(frame_number, 0, true);
+	last_raw_frame_number = frame_number;
+	return last_raw_frame;
+}
+
 VideoFrame AsyncVideoProvider::GetBlankFrame(bool white) {
 	VideoFrame result;
 	result.width = GetWidth();
@@ -98,16 +479,28 @@ VideoFrame AsyncVideoProvider::GetBlankFrame(bool white) {
 }
 
 VideoFrame AsyncVideoProvider::GetSubtitles(double time) {
-	// We want to combine all transparent subtitle layers onto one layer.
-	// Instead of alpha blending them all together, which can be messy and cause
-	// rounding errors, we draw them once on a black frame and once on a white frame,
-	// and solve for the color and alpha. This has the benefit of being independent
-	// of the subtitle provider, as long as the provider works by alpha blending.
 	VideoFrame frame_black = GetBlankFrame(false);
 	if (!subs) return frame_black;
-	VideoFrame frame_white = GetBlankFrame(true);
 
-	subs_provider->LoadSubtitles(subs.get());
+	subs_provider->LoadSubtitles(*subs);
+
+	// Providers which can draw onto a transparent overlay already combine
+	// all of the layers into one premultiplied image in a single pass
+	if (subs_provider->CanDrawOverlay()) {
+		auto overlay = std::make_shared<SubtitlesOverlay>();
+		if (!subs_provider->DrawOverlay(*overlay, GetWidth(), GetHeight(), time / 1000.) && last_overlay)
+			overlay = last_overlay;
+		last_overlay = overlay;
+		overlay->CopyUnpremultiplied(frame_black);
+		return frame_black;
+	}
+
+	// Otherwise, instead of alpha blending them all together, which can be
+	// messy and cause rounding errors, we draw them once on a black frame and
+	// once on a white frame, and solve for the color and alpha. This has the
+	// benefit of being independent of the subtitle provider, as long as the
+	// provider works by alpha blending.
+	VideoFrame frame_white = GetBlankFrame(true);
 	subs_provider->DrawSubtitles(frame_black, time / 1000.);
 	subs_provider->DrawSubtitles(frame_white, time / 1000.);
 
@@ -146,62 +539,343 @@ static std::unique_ptr<SubtitlesProvider> get_subs_provider(wxEvtHandler *evt_ha
 	}
 }
 
-AsyncVideoProvider::AsyncVideoProvider(agi::fs::path const& video_filename, std::string const& colormatrix, wxEvtHandler *parent, agi::BackgroundRunner *br)
+AsyncVideoProvider::AsyncVideoProvider(agi::fs::path const& video_filename, std::string const& colormatrix, bool hw_decode, wxEvtHandler *parent, agi::BackgroundRunner *br)
 : worker(agi::dispatch::Create())
 , subs_provider(get_subs_provider(parent, br))
-, source_provider(VideoProviderFactory::GetProvider(video_filename, colormatrix, br))
+, source_provider(VideoProviderFactory::GetProvider(video_filename, colormatrix, hw_decode, br))
 , parent(parent)
 {
+	// Leave at least as much room in the cache for the frames behind the
+	// current one as for those ahead of it
+	read_ahead = std::min<int>(OPT_GET("Provider/Video/Cache/Read Ahead")->GetInt(),
+		source_provider->GetCachedFrameLimit() / 2);
+	gpu_compositing = OPT_GET("Video/GPU Subtitle Compositing")->GetBool();
+	open_seek_provider = OPT_GET("Provider/Video/Seek Decoder")->GetBool();
+	high_depth = gpu_compositing && OPT_GET("Video/High Bit Depth Preview")->GetBool();
+	subs_provider_name = OPT_GET("Subtitle/Provider")->GetString();
+	keyframes = source_provider->GetKeyFrames();
+	std::sort(keyframes.begin(), keyframes.end());
+	source_provider->SetInterruptCheck([this] { return Interrupted(); });
+	// The caches are only touched from the worker, so trimming them is too.
+	// It waits for it so that the memory is given back before the trimmers
+	// after it are asked, which may not have to be.
+	trimmer = agi::make_unique<agi::memory::Trimmer>(30, [this](agi::memory::Pressure pressure) {
+		const bool all = pressure == agi::memory::Pressure::Critical;
+		worker->Sync([=] { Trim(all); });
+	});
+
+	// The renderers are made now rather than when first needed so that
+	// they've finished setting up by the time anything is prerendered
+	if (subs_provider && subs_provider->CanDrawOverlay()) {
+		const int renderers = std::min<int>(OPT_GET("Subtitle/Prerender Renderers")->GetInt(),
+			std::max(1u, std::thread::hardware_concurrency()));
+		for (int i = 1; i < renderers; ++i) {
+			auto provider = get_subs_provider(parent, br);
+			if (!provider || !provider->CanDrawOverlay()) break;
+			render_pool.push_back(PooledRenderer{std::move(provider)});
+		}
+	}
 }
 
 AsyncVideoProvider::~AsyncVideoProvider() {
+	trimmer.reset();
 	// Block until all currently queued jobs are complete
 	worker->Sync([]{});
 }
 
-void AsyncVideoProvider::LoadSubtitles(const AssFile *new_subs) throw() {
+void AsyncVideoProvider::LoadSubtitles(std::shared_ptr<const AssSnapshot> new_subs) throw() {
 	uint_fast32_t req_version = ++version;
+	const auto requested = std::chrono::steady_clock::now();
 
-	auto copy = new AssFile(*new_subs);
 	worker->Async([=]{
-		subs.reset(copy);
+		InvalidatePrerendered(*new_subs);
+		if (!subs || subs->header != new_subs->header)
+			subs_header_hash = hash_header(*new_subs->header);
+		subs = new_subs;
+		++subs_revision;
+		IndexSubtitles();
 		single_frame = NEW_SUBS_FILE;
-		ProcAsync(req_version, false);
+		ProcAsync(req_version, false, requested);
 	});
 }
 
-void AsyncVideoProvider::UpdateSubtitles(const AssFile *new_subs, const AssDialogue *changed) throw() {
+void AsyncVideoProvider::UpdateSubtitles(const AssDialogue *changed) throw() {
 	uint_fast32_t req_version = ++version;
+	const auto requested = std::chrono::steady_clock::now();
 
-	// Copy just the line which were changed, then replace the line at the
-	// same index in the worker's copy of the file with the new entry
-	auto copy = new AssDialogue(*changed);
+	// Copy just the line which was changed, then replace the line at the
+	// same row in the worker's snapshot of the file with the new entry. It's
+	// copied as the base so that it keeps its Id like every other line of
+	// the snapshot.
+	std::shared_ptr<const AssDialogue> copy = std::make_shared<AssDialogue>(static_cast<AssDialogueBase const&>(*changed));
 	worker->Async([=]{
-		int i = 0;
-		auto it = subs->Events.begin();
-		std::advance(it, copy->Row - i);
-		i = copy->Row;
-		subs->Events.insert(it, *copy);
-		delete &*it--;
+		const bool was_comment = subs->events[copy->Row]->Comment;
+		InvalidatePrerendered(*subs->events[copy->Row]);
+		InvalidatePrerendered(*copy);
+		AssSnapshot::ReplaceLine(subs, copy);
+		++subs_revision;
+		if (was_comment == copy->Comment && !copy->Comment)
+			subs_time_index.Update(copy->Row, copy->Start, copy->End);
 
-		single_frame = NEW_SUBS_FILE;
-		ProcAsync(req_version, true);
+		// If the provider has the entire file loaded, patch just the changed
+		// line into it rather than reloading everything
+		bool patched = false;
+		if (was_comment != copy->Comment)
+			IndexSubtitles();
+		else if (subs_provider && single_frame == SUBS_FILE_ALREADY_LOADED) {
+			if (copy->Comment)
+				patched = true;
+			else
+				patched = subs_provider->UpdateEvent(subs_event_index[copy->Row], *copy);
+		}
+		if (!patched)
+			single_frame = NEW_SUBS_FILE;
+		ProcAsync(req_version, true, requested);
+	});
+}
+
+void AsyncVideoProvider::IndexSubtitles() {
+	subs_event_index.clear();
+	subs_event_index.reserve(subs->events.size());
+
+	std::vector<agi::IntervalIndex<size_t>::Entry> times;
+	int events = 0;
+	for (auto const& line : subs->events) {
+		subs_event_index.push_back(events);
+		if (!line->Comment) {
+			times.push_back({(int)line->Start, (int)line->End, subs_event_index.size() - 1});
+			++events;
+		}
+	}
+	subs_time_index.Assign(std::move(times));
+}
+
+void AsyncVideoProvider::BeginPreview(std::vector<size_t> rows) throw() {
+	sort(begin(rows), end(rows));
+	rows.erase(unique(begin(rows), end(rows)), end(rows));
+	worker->Async([=]{
+		preview_rows = rows;
+		preview_background.reset();
+		preview_background_subs.reset();
+	});
+}
+
+void AsyncVideoProvider::EndPreview() throw() {
+	uint_fast32_t req_version = ++version;
+	const auto requested = std::chrono::steady_clock::now();
+
+	worker->Async([=]{
+		if (preview_rows.empty()) return;
+		preview_rows.clear();
+		preview_background.reset();
+		preview_background_subs.reset();
+		ProcAsync(req_version, false, requested);
 	});
 }
 
 void AsyncVideoProvider::RequestFrame(int new_frame, double new_time) throw() {
 	uint_fast32_t req_version = ++version;
+	const auto requested = std::chrono::steady_clock::now();
 
 	worker->Async([=]{
+		const int step = RouteRequest(new_frame);
 		time = new_time;
 		frame_number = new_frame;
-		ProcAsync(req_version, false);
+		ProcAsync(req_version, false, requested);
+
+		// Playback and stepping through frames request frames in one
+		// direction, with playback skipping some if it falls behind
+		if (read_ahead > 0 && !seeking && !high_depth && step != 0 && std::abs(step) <= 2) {
+			if (step > 0 || !ReadBehind(req_version, new_frame))
+				ReadAhead(req_version, new_frame + step / std::abs(step), step / std::abs(step), read_ahead);
+		}
+	});
+}
+
+void AsyncVideoProvider::PrefetchFrame(int frame, double time) throw() {
+	uint_fast32_t req_version = version;
+
+	worker->Async([=]{
+		if (req_version < version) return;
+		if (frame < 0 || frame >= source_provider->GetFrameCount()) return;
+
+		try {
+			source_provider->PrefetchFrame(frame);
+			if (subs && subs_provider && subs_provider->CanDrawOverlay() && preview_rows.empty())
+				GetOverlay(frame, time);
+		}
+		// Reported if the frame is actually requested
+		catch (VideoProviderError const&) { }
+		catch (wxEvent const&) { }
+	});
+}
+
+int AsyncVideoProvider::RouteRequest(int frame) {
+	const auto now = std::chrono::steady_clock::now();
+
+	// Playback carries on from where source_provider was even if something
+	// else was looked at in the meantime
+	int step = frame - frame_number;
+	if (playback_frame >= 0 && std::abs(frame - playback_frame) <= 2)
+		step = frame - playback_frame;
+
+	// Jumps made while playing go to the other decoder. Otherwise the jump
+	// is most likely where playback is about to start from.
+	seeking = std::abs(step) > 2 && playback_frame >= 0 && now - last_sequential < playback_timeout;
+	if (seeking && open_seek_provider) {
+		open_seek_provider = false;
+		try {
+			seek_provider = source_provider->OpenSeekDecoder();
+			if (seek_provider)
+				seek_provider->SetInterruptCheck([this] { return Interrupted(); });
+		}
+		catch (VideoProviderError const& err) {
+			LOG_W("video/async") << "Could not open a second decoder for seeking: " << err.GetMessage();
+		}
+	}
+	seeking = seeking && seek_provider;
+	if (seeking)
+		return step;
+
+	if (step != 0 && std::abs(step) <= 2)
+		last_sequential = now;
+	playback_frame = frame;
+	return step;
+}
+
+bool AsyncVideoProvider::ReadBehind(uint_fast32_t req_version, int frame) {
+	const int previous = frame - 1;
+	if (previous < 0) return true;
+
+	auto it = std::upper_bound(keyframes.begin(), keyframes.end(), previous);
+	if (it == keyframes.begin()) return false;
+	const int keyframe = *prev(it);
+
+	const int window = std::max(1, source_provider->GetCachedFrameLimit() / 2);
+	const int first = keyframe + (previous - keyframe) / window * window;
+	ReadAhead(req_version, first, 1, previous - first + 1);
+	return true;
+}
+
+void AsyncVideoProvider::ReadAhead(uint_fast32_t req_version, int frame, int step, int remaining) {
+	if (req_version < version || remaining <= 0) return;
+	if (frame < 0 || frame >= source_provider->GetFrameCount()) return;
+
+	bool read = true;
+	decoding_version = req_version;
+	try {
+		source_provider->PrefetchFrame(frame);
+	}
+	// Reported if the frame is actually requested
+	catch (VideoProviderError const&) { read = false; }
+	catch (VideoDecodeCancelled const&) { read = false; }
+	decoding_version = 0;
+	if (!read) return;
+
+	worker->Async([=]{ ReadAhead(req_version, frame + step, step, remaining - 1); });
+}
+
+void AsyncVideoProvider::ScanFrames(int first, int budget, std::function<void (int, VideoFrame const&)> fn, std::function<void (int)> done) throw() {
+	ScanSequence(std::max(first, 0), source_provider->GetFrameCount(), [](int i) { return i; }, budget, std::move(fn), std::move(done));
+}
+
+void AsyncVideoProvider::ReadFrames(std::vector<int> frames, int budget, std::function<void (int, VideoFrame const&)> fn, std::function<void (int)> done) throw() {
+	auto list = std::make_shared<std::vector<int>>(std::move(frames));
+	ScanSequence(0, static_cast<int>(list->size()), [=](int i) { return (*list)[i]; }, budget, std::move(fn), std::move(done));
+}
+
+void AsyncVideoProvider::ScanSequence(int first, int count, std::function<int (int)> frame_at, int budget,
+	std::function<void (int, VideoFrame const&)> fn, std::function<void (int)> done)
+{
+	uint_fast32_t req_version = version;
+
+	worker->Async([=]{
+		if (!scan_frame)
+			scan_frame = agi::make_unique<VideoFrame>();
+
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(budget);
+		int i = first;
+		try {
+			for (; i < count && req_version == version; ++i) {
+				if (i > first && std::chrono::steady_clock::now() >= deadline) break;
+				source_provider->GetFrameUncached(frame_at(i), *scan_frame);
+				fn(i, *scan_frame);
+			}
+		}
+		catch (VideoProviderError const&) {
+			i = -1;
+		}
+		done(i);
+	});
+}
+
+void AsyncVideoProvider::ProfileLines(double time, std::function<void (std::vector<LineRenderCost>)> done) throw() {
+	worker->Async([=]{
+		std::vector<LineRenderCost> costs;
+		if (!subs || !subs_provider) {
+			done(std::move(costs));
+			return;
+		}
+
+		const int render_time = static_cast<int>(time);
+		auto rows = subs_time_index.At(static_cast<int>(std::floor(time)));
+		sort(begin(rows), end(rows));
+
+		// Providers which can't draw an overlay draw onto a blank frame which
+		// is reset for each line
+		const bool overlay = subs_provider->CanDrawOverlay();
+		VideoFrame blank, frame;
+		if (!overlay)
+			blank = GetBlankFrame(false);
+
+		subs_provider->SetProfiling(true);
+		try {
+			// Render nothing once first so that whatever the caches held from
+			// rendering the frame normally is discarded
+			AssSnapshot empty;
+			empty.header = subs->header;
+			subs_provider->LoadSubtitles(empty, render_time);
+			SubtitlesOverlay discarded;
+			if (overlay)
+				subs_provider->DrawOverlay(discarded, FrameWidth(), FrameHeight(), time / 1000.);
+
+			for (size_t row : rows) {
+				AssSnapshot line;
+				line.header = subs->header;
+				line.events.push_back(subs->events[row]);
+				subs_provider->LoadSubtitles(line, render_time);
+
+				SubtitlesOverlay layer;
+				if (!overlay)
+					frame = blank;
+				auto start = std::chrono::steady_clock::now();
+				if (overlay)
+					subs_provider->DrawOverlay(layer, FrameWidth(), FrameHeight(), time / 1000.);
+				else
+					subs_provider->DrawSubtitles(frame, time / 1000.);
+				std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+				costs.push_back({row, elapsed.count()});
+			}
+		}
+		catch (agi::UserCancelException const&) {
+			costs.clear();
+		}
+		catch (agi::Exception const& err) {
+			costs.clear();
+			parent->AddPendingEvent(SubtitlesProviderErrorEvent(err.GetMessage()));
+		}
+		subs_provider->SetProfiling(false);
+
+		// Whatever's loaded now isn't the file
+		single_frame = NEW_SUBS_FILE;
+		last_rendered = -1;
+		done(std::move(costs));
 	});
 }
 
 bool AsyncVideoProvider::NeedUpdate(std::vector<AssDialogueBase const*> const& visible_lines) {
 	// Always need to render after a seek
-	if (single_frame != NEW_SUBS_FILE || frame_number != last_rendered)
+	if (frame_number != last_rendered)
 		return true;
 
 	// Obviously need to render if the number of visible lines has changed
@@ -228,15 +902,16 @@ bool AsyncVideoProvider::NeedUpdate(std::vector<AssDialogueBase const*> const& v
 	return false;
 }
 
-void AsyncVideoProvider::ProcAsync(uint_fast32_t req_version, bool check_updated) {
+void AsyncVideoProvider::ProcAsync(uint_fast32_t req_version, bool check_updated, std::chrono::steady_clock::time_point requested) {
 	// Only actually produce the frame if there's no queued changes waiting
 	if (req_version < version || frame_number < 0) return;
 
+	auto rows = subs_time_index.At(static_cast<int>(std::floor(time)));
+	sort(begin(rows), end(rows));
 	std::vector<AssDialogueBase const*> visible_lines;
-	for (auto const& line : subs->Events) {
-		if (!line.Comment && !(line.Start > time || line.End <= time))
-			visible_lines.push_back(&line);
-	}
+	visible_lines.reserve(rows.size());
+	for (size_t row : rows)
+		visible_lines.push_back(subs->events[row].get());
 
 	if (check_updated && !NeedUpdate(visible_lines)) return;
 
@@ -245,26 +920,230 @@ void AsyncVideoProvider::ProcAsync(uint_fast32_t req_version, bool check_updated
 	for (auto line : visible_lines)
 		last_lines.push_back(*line);
 	last_rendered = frame_number;
+	decoding_version = req_version;
 
 	try {
-		FrameReadyEvent *evt = new FrameReadyEvent(ProcFrame(frame_number, time), time);
+		FrameReadyEvent *evt;
+		if (!preview_rows.empty() && subs && subs_provider && subs_provider->CanDrawOverlay())
+			evt = new FrameReadyEvent(ProcPreviewFrame(frame_number, time), time);
+		else if (gpu_compositing && subs_provider && subs_provider->CanDrawOverlay()) {
+			auto overlay = GetOverlay(frame_number, time);
+			evt = new FrameReadyEvent(ProcRawFrame(frame_number), time, std::move(overlay));
+		}
+		else
+			evt = new FrameReadyEvent(ProcFrame(frame_number, time), time);
+		evt->requested = requested;
 		evt->SetEventType(EVT_FRAME_READY);
 		parent->QueueEvent(evt);
 	}
+	catch (VideoDecodeCancelled const&) {
+		// The newer request produces a frame instead, and has to render it
+		// even if it's for the same frame with no visible changes
+		last_rendered = -1;
+	}
 	catch (wxEvent const& err) {
 		// Pass error back to parent thread
 		parent->QueueEvent(err.Clone());
 	}
+	decoding_version = 0;
 }
 
-std::shared_ptr<VideoFrame> AsyncVideoProvider::GetFrame(int frame, double time, bool raw) {
-	std::shared_ptr<VideoFrame> ret;
+bool AsyncVideoProvider::Prerender(std::vector<PrerenderFrame> const& frames, agi::ProgressSink *ps) {
+	// Only one range is kept, so that the limit is spent on what's about to
+	// be played rather than on something played earlier
+	worker->Sync([&]{
+		std::set<double> times;
+		for (auto const& frame : frames)
+			times.insert(frame.second);
+		for (auto it = prerendered.begin(); it != prerendered.end(); ) {
+			if (times.count(it->first))
+				++it;
+			else {
+				prerendered_bytes -= it->second->size();
+				it = prerendered.erase(it);
+			}
+		}
+	});
+
+	size_t count = frames.size();
+	const int frame_limit = source_provider->GetCachedFrameLimit();
+	if (frame_limit > 0)
+		count = std::min<size_t>(count, frame_limit);
+
+	// Each batch has a frame for every renderer, and is a separate job on
+	// the worker so that other requests can get in between
+	const size_t batch = render_pool.size() + 1;
+	for (size_t first = 0; first < count; first += batch) {
+		if (ps) {
+			if (ps->IsCancelled()) return false;
+			ps->SetProgress(first, frames.size());
+		}
+
+		bool full = false;
+		worker->Sync([&]{
+			try {
+				full = PrerenderBatch(frames, first, std::min(count, first + batch));
+			}
+			catch (wxEvent const& err) {
+				parent->QueueEvent(err.Clone());
+			}
+		});
+		if (full) break;
+	}
+	return true;
+}
+
+bool AsyncVideoProvider::PrerenderBatch(std::vector<PrerenderFrame> const& frames, size_t first, size_t last) {
+	const bool draw_subs = subs && subs_provider && subs_provider->CanDrawOverlay();
+	const int frame_width = FrameWidth();
+	const int frame_height = FrameHeight();
+	const int width = ProxyDimension(frame_width, subtitle_divisor);
+	const int height = ProxyDimension(frame_height, subtitle_divisor);
+
+	struct Job {
+		int frame;
+		double time;
+		size_t key;
+		std::shared_ptr<SubtitlesOverlay> overlay;
+	};
+	std::vector<Job> jobs;
+	bool full = false;
+	for (size_t i = first; i < last; ++i) {
+		const int frame = frames[i].first;
+		const double time = frames[i].second;
+		try {
+			source_provider->PrefetchFrame(frame);
+		}
+		catch (VideoProviderError const&) {
+			// Reported if the frame is actually requested
+		}
+		if (!draw_subs || full || prerendered.count(time)) continue;
+
+		if (prerendered_bytes >= max_prerendered_bytes) {
+			full = true;
+			continue;
+		}
+
+		const size_t key = OverlayKey(time, width, height);
+		if (auto cached = overlay_cache().Get(time, key)) {
+			prerendered[time] = cached;
+			prerendered_bytes += cached->size();
+			continue;
+		}
+		jobs.push_back(Job{frame, time, key, nullptr});
+	}
+	if (jobs.empty()) return full;
+
+	// Loading isn't done in parallel, as the providers may add the file's
+	// fonts to a library they share
+	PrepareSubtitles(jobs[0].frame, jobs[0].time);
+	for (size_t i = 1; i < jobs.size(); ++i) {
+		auto& renderer = render_pool[i - 1];
+		if (renderer.revision == subs_revision) continue;
+		try {
+			renderer.provider->LoadSubtitles(*subs);
+		}
+		catch (agi::Exception const& err) { throw SubtitlesProviderErrorEvent(err.GetMessage()); }
+		renderer.revision = subs_revision;
+		renderer.last_overlay.reset();
+	}
+
+	agi::dispatch::Parallel(jobs.size(), [&](size_t i) {
+		auto& provider = i == 0 ? *subs_provider : *render_pool[i - 1].provider;
+		auto& last = i == 0 ? last_overlay : render_pool[i - 1].last_overlay;
+		auto result = render_overlay(provider, last, frame_width, frame_height, width, height, jobs[i].time);
+		// Cancelled renders aren't kept
+		if (!result.second) return;
+		last = result.first;
+		jobs[i].overlay = result.first;
+	});
+
+	for (auto const& job : jobs) {
+		if (!job.overlay) continue;
+		overlay_cache().Add(job.time, job.key, job.overlay);
+		prerendered[job.time] = job.overlay;
+		prerendered_bytes += job.overlay->size();
+	}
+	return full || prerendered_bytes >= max_prerendered_bytes;
+}
+
+bool AsyncVideoProvider::IsPrerendered(std::vector<PrerenderFrame> const& frames) {
+	bool all = true;
+	worker->Sync([&]{
+		if (!subs || !subs_provider || !subs_provider->CanDrawOverlay()) {
+			all = false;
+			return;
+		}
+
+		// Frames past the limits wouldn't be prerendered anyway, so a range
+		// which filled them up is as done as it can be
+		const int frame_limit = source_provider->GetCachedFrameLimit();
+		size_t found = 0;
+		for (size_t i = 0; i < frames.size(); ++i) {
+			if (frame_limit > 0 && static_cast<int>(i) >= frame_limit) break;
+			if (prerendered.count(frames[i].second))
+				++found;
+			else
+				all = false;
+		}
+		if (!all && found == prerendered.size() && prerendered_bytes >= max_prerendered_bytes)
+			all = true;
+	});
+	return all;
+}
+
+std::shared_ptr<const VideoFrame> AsyncVideoProvider::GetFrame(int frame, double time, bool raw) {
+	std::shared_ptr<const VideoFrame> ret;
 	worker->Sync([&]{ ret = ProcFrame(frame, time, raw); });
 	return ret;
 }
 
+void AsyncVideoProvider::SetProxyScale(int divisor) throw() {
+	worker->Async([=] {
+		int scale = divisor;
+		try {
+			if (!source_provider->SetProxyScale(scale))
+				scale = 1;
+			if (seek_provider)
+				seek_provider->SetProxyScale(scale);
+		}
+		catch (VideoProviderError const& err) {
+			parent->QueueEvent(new VideoProviderErrorEvent(err));
+			return;
+		}
+		if (scale == proxy_divisor) return;
+
+		// Nothing rendered at the old size can be reused
+		proxy_divisor = scale;
+		ClearPrerendered();
+		preview_background_subs.reset();
+		last_frame.reset();
+		last_raw_frame.reset();
+	});
+}
+
+void AsyncVideoProvider::SetSubtitleScale(int divisor) throw() {
+	worker->Async([=] {
+		if (divisor == subtitle_divisor) return;
+		subtitle_divisor = divisor;
+		last_frame.reset();
+	});
+}
+
 void AsyncVideoProvider::SetColorSpace(std::string const& matrix) {
-	worker->Async([=] { source_provider->SetColorSpace(matrix); });
+	worker->Async([=] {
+		source_provider->SetColorSpace(matrix);
+		if (seek_provider)
+			seek_provider->SetColorSpace(matrix);
+		last_frame.reset();
+		last_raw_frame.reset();
+	});
+}
+
+VideoFrameCacheStats AsyncVideoProvider::GetCacheStats() {
+	VideoFrameCacheStats ret;
+	worker->Sync([&]{ ret = source_provider->GetCacheStats(); });
+	return ret;
 }
 
 wxDEFINE_EVENT(EVT_FRAME_READY, FrameReadyEvent);
@@ -18,22 +18,29 @@
 
 #include <libaegisub/exception.h>
 #include <libaegisub/fs_fwd.h>
+#include <libaegisub/interval_index.h>
 
 #include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
 #include <memory>
 #include <set>
 #include <wx/event.h>
 
 class AssDialogue;
-class AssFile;
+class AssSnapshot;
 class SubtitlesProvider;
 class VideoProvider;
 class VideoProviderError;
 struct AssDialogueBase;
+struct SubtitlesOverlay;
 struct VideoFrame;
 namespace agi {
 	class BackgroundRunner;
+	class ProgressSink;
 	namespace dispatch { class Queue; }
+	namespace memory { class Trimmer; }
 }
 
 /// An asynchronous video decoding and subtitle rendering wrapper
@@ -43,16 +50,60 @@ class AsyncVideoProvider {
 
 	/// Subtitles provider
 	std::unique_ptr<SubtitlesProvider> subs_provider;
+	/// Extra copies of the subtitles provider which Prerender() renders
+	/// frames on in parallel with subs_provider
+	struct PooledRenderer {
+		std::unique_ptr<SubtitlesProvider> provider;
+		/// Value of subs_revision when the subtitles were last loaded into it
+		uint_fast32_t revision = 0;
+		/// The overlay it most recently returned
+		std::shared_ptr<SubtitlesOverlay> last_overlay;
+	};
+	std::vector<PooledRenderer> render_pool;
 	/// Video provider
 	std::unique_ptr<VideoProvider> source_provider;
+	/// Second decoder for the same video which jumps elsewhere while
+	/// source_provider is playing, so that playback doesn't have to seek
+	/// back afterwards. Opened the first time it's needed.
+	std::unique_ptr<VideoProvider> seek_provider;
+	/// Should seek_provider be opened when needed? Cleared once it's tried.
+	bool open_seek_provider = false;
+	/// Is the current frame being read with seek_provider?
+	bool seeking = false;
+	/// Last frame requested from source_provider, and when it was last
+	/// requested as the next frame of playback or stepping
+	int playback_frame = -1;
+	std::chrono::steady_clock::time_point last_sequential;
+
+	/// @brief Pick the decoder for a newly requested frame
+	/// @return Distance from the frame the chosen decoder last read
+	int RouteRequest(int frame);
+
+	/// @brief Decoder to read the current frame with
+	/// @throws VideoDecodeCancelled if the frame is no longer wanted
+	VideoProvider &Decoder();
+	/// Version of the request the frame being decoded is for, or 0 if the
+	/// current decode shouldn't be interrupted
+	uint_fast32_t decoding_version = 0;
+	/// Has a newer request been made than the one being decoded for?
+	bool Interrupted() const { return decoding_version && decoding_version < version; }
 	/// Event handler to send FrameReady events to
 	wxEvtHandler *parent;
 
 	int frame_number = -1; ///< Last frame number requested
 	double time = -1.; ///< Time of the frame to pass to the subtitle renderer
 
-	/// Copy of the subtitles file to avoid having to touch the project context
-	std::unique_ptr<AssFile> subs;
+	/// Snapshot of the subtitles file to avoid having to touch the project context
+	std::shared_ptr<const AssSnapshot> subs;
+	/// Incremented every time subs changes
+	uint_fast32_t subs_revision = 0;
+	/// For each row, the number of non-comment lines before it, which is the
+	/// line's index in the subtitles provider's copy of the file
+	std::vector<int> subs_event_index;
+	/// Rows of the non-comment lines in subs, indexed by time
+	agi::IntervalIndex<size_t> subs_time_index;
+	/// Rebuild subs_event_index and subs_time_index from subs
+	void IndexSubtitles();
 
 	/// If >= 0, the subtitles provider current has just the lines visible on
 	/// that frame loaded. If -1, the entire file is loaded. If -2, the
@@ -67,10 +118,122 @@ class AsyncVideoProvider {
 	/// lines have actually changed
 	bool NeedUpdate(std::vector<AssDialogueBase const*> const& visible_lines);
 
-	std::shared_ptr<VideoFrame> ProcFrame(int frame, double time, bool raw = false);
+	/// Hash of the header of subs, which is only recomputed when it changes
+	size_t subs_header_hash = 0;
+	/// Name of the subtitles provider which was asked for
+	std::string subs_provider_name;
+	/// @brief Key for the overlays cache
+	/// @return A hash of everything the overlay rendered for a time at the
+	///         given size depends on
+	size_t OverlayKey(double time, int width, int height) const;
+
+	/// The overlay most recently returned by the subtitles provider
+	std::shared_ptr<SubtitlesOverlay> last_overlay;
+
+	/// Most recently composited frame, and the frame number and overlay it was
+	/// made from
+	std::shared_ptr<const VideoFrame> last_frame;
+	int last_frame_number = -1;
+	std::shared_ptr<SubtitlesOverlay> last_frame_overlay;
+	/// @brief Update last_frame for a new overlay by redrawing only what changed
+	/// @return The new frame, or null if it has to be composited from scratch
+	std::shared_ptr<const VideoFrame> RecompositeFrame(int frame, std::shared_ptr<SubtitlesOverlay> const& overlay);
+
+	/// Send the display frames without subtitles along with the overlay to
+	/// draw over them, rather than compositing them here
+	bool gpu_compositing = false;
+	/// Most recent frame sent to the display without subtitles, and its
+	/// frame number
+	std::shared_ptr<const VideoFrame> last_raw_frame;
+	int last_raw_frame_number = -1;
+	/// Send the display 16-bit YUV frames to convert and tone map itself,
+	/// for high bit depth video. Cleared if the provider can't make them.
+	/// They skip the frame cache, so nothing is read ahead while this is set.
+	bool high_depth = false;
+
+	/// Rows being edited interactively, sorted, which are rendered on their
+	/// own over a cached rendering of everything else while non-empty
+	std::vector<size_t> preview_rows;
+	/// Everything other than preview_rows rendered at preview_background_time
+	std::shared_ptr<SubtitlesOverlay> preview_background;
+	double preview_background_time = -1.;
+	/// Snapshot preview_background was rendered from
+	std::shared_ptr<const AssSnapshot> preview_background_subs;
+	/// Is preview_background still what the lines other than preview_rows
+	/// look like at the given time?
+	bool PreviewBackgroundCurrent(double time) const;
+	/// Render a frame with the preview rows drawn over the cached background
+	std::shared_ptr<const VideoFrame> ProcPreviewFrame(int frame, double time);
+
+	/// Divisor frames are currently decoded at, or 1 for full size
+	int proxy_divisor = 1;
+	/// Size of the frames currently being decoded, for rendering subtitles to
+	int FrameWidth() const { return ProxyDimension(GetWidth(), proxy_divisor); }
+	int FrameHeight() const { return ProxyDimension(GetHeight(), proxy_divisor); }
+	/// Divisor subtitle overlays are currently rendered at relative to the
+	/// frames, or 1 for full quality
+	int subtitle_divisor = 1;
+
+	/// Overlays rendered by Prerender(), by time, which are kept until the
+	/// lines visible at their time change rather than on every edit
+	std::map<double, std::shared_ptr<SubtitlesOverlay>> prerendered;
+	/// Total size in bytes of the prerendered overlays
+	size_t prerendered_bytes = 0;
+	/// @brief Prefetch frames [first, last) and render their subtitles, in
+	///        parallel across subs_provider and render_pool
+	/// @return Is there no more room for prerendered overlays?
+	bool PrerenderBatch(std::vector<std::pair<int, double>> const& frames, size_t first, size_t last);
+	/// Discard the prerendered overlays for times a line was or is visible at
+	void InvalidatePrerendered(AssDialogue const& line);
+	/// Discard the prerendered overlays which may look different in a new
+	/// snapshot of the file
+	void InvalidatePrerendered(AssSnapshot const& new_subs);
+	void ClearPrerendered();
+
+	/// Load the subtitles into the subtitles provider if needed to render the
+	/// given frame
+	void PrepareSubtitles(int frame, double time);
+
+	/// Get the subtitles overlay for a time, from the cache if possible
+	std::shared_ptr<SubtitlesOverlay> GetOverlay(int frame, double time);
+
+	/// Get a buffer which isn't currently in use outside of this class
+	std::shared_ptr<VideoFrame> GetBuffer();
+
+	std::shared_ptr<const VideoFrame> ProcFrame(int frame, double time, bool raw = false);
+
+	/// Get a frame without subtitles for the display, reusing the last one
+	/// if it's the same frame so that the display can skip uploading it
+	std::shared_ptr<const VideoFrame> ProcRawFrame(int frame);
 
 	/// Produce a frame if req_version is still the current version
-	void ProcAsync(uint_fast32_t req_version, bool check_updated);
+	/// @param requested When the request which led to this was made
+	void ProcAsync(uint_fast32_t req_version, bool check_updated, std::chrono::steady_clock::time_point requested);
+
+	/// Number of frames to decode ahead of playback or stepping
+	int read_ahead = 0;
+
+	/// @brief Decode a frame into the cache if req_version is still current
+	/// @param frame     Frame to decode
+	/// @param step      Direction frames are being requested in
+	/// @param remaining Number of frames left to read ahead after this one
+	///
+	/// Each frame is decoded as a separate job so that a new request never
+	/// has to wait for more than one frame of read-ahead.
+	void ReadAhead(uint_fast32_t req_version, int frame, int step, int remaining);
+
+	/// Keyframes of the video, sorted
+	std::vector<int> keyframes;
+
+	/// @brief Decode the frames before frame ahead of stepping backwards
+	/// @return false if the keyframe before it isn't known
+	///
+	/// Each step back in a long GOP would otherwise seek to the keyframe and
+	/// decode forward from it again. GOPs are split into windows of half the
+	/// frame cache starting at the keyframe, and the window holding the
+	/// previous frame is decoded in one forward pass, so each window is only
+	/// decoded once however it's stepped through.
+	bool ReadBehind(uint_fast32_t req_version, int frame);
 
 	/// Monotonic counter used to drop frames when changes arrive faster than
 	/// they can be rendered
@@ -78,24 +241,82 @@ class AsyncVideoProvider {
 
 	std::vector<std::shared_ptr<VideoFrame>> buffers;
 
+	/// Hands requests to give back memory over to the worker
+	std::unique_ptr<agi::memory::Trimmer> trimmer;
+	/// @brief Give back memory from the frame and overlay caches
+	/// @param all Drop everything which can be remade, rather than half
+	void Trim(bool all);
+
+	/// Buffer for ScanFrames() to decode into
+	std::unique_ptr<VideoFrame> scan_frame;
+
+	/// Shared implementation of ScanFrames() and ReadFrames(), which reads
+	/// frame_at(i) for i from first until count or the budget runs out
+	void ScanSequence(int first, int count, std::function<int (int)> frame_at, int budget,
+		std::function<void (int, VideoFrame const&)> fn, std::function<void (int)> done);
+
 	// Returns a monochromatic frame with the current dimensions
 	VideoFrame GetBlankFrame(bool white);
 
 public:
 	/// @brief Load the passed subtitle file
-	/// @param subs File to load
-	///
-	/// This function blocks until is it is safe for the calling thread to
-	/// modify subs
-	void LoadSubtitles(const AssFile *subs) throw();
+	/// @param subs Snapshot of the file to load
+	void LoadSubtitles(std::shared_ptr<const AssSnapshot> subs) throw();
 
 	/// @brief Update a previously loaded subtitle file
-	/// @param subs Subtitle file which was last passed to LoadSubtitles
-	/// @param changes Set of lines which have changed
+	/// @param changes Line which has changed
 	///
 	/// This function only supports changes to existing lines, and not
 	/// insertions or deletions.
-	void UpdateSubtitles(const AssFile *subs, const AssDialogue *changes) throw();
+	void UpdateSubtitles(const AssDialogue *changes) throw();
+
+	/// @brief Render some lines separately from the rest until EndPreview()
+	/// @param rows Rows of the lines which are about to be edited repeatedly
+	///
+	/// Everything else on the frame is rendered once and reused, so that
+	/// each edit to these lines only has to render them. The result is only
+	/// approximate, as the lines are always drawn on top and don't take part
+	/// in collision detection with the others.
+	void BeginPreview(std::vector<size_t> rows) throw();
+
+	/// Go back to rendering all of the lines together, and render the
+	/// current frame that way
+	void EndPreview() throw();
+
+	/// Time taken to render a line on its own
+	struct LineRenderCost {
+		size_t row;  ///< Row of the line in the loaded subtitles
+		double ms;   ///< Milliseconds its render took
+	};
+
+	/// @brief Measure how long each line visible at a time takes to render
+	/// @param time Time in milliseconds of the frame to profile
+	/// @param done Called on the worker thread with the cost of each line,
+	///             which is empty if nothing could be measured
+	///
+	/// Each line is rendered by itself with the subtitles provider's caches
+	/// kept as small as possible, so the result is roughly what the line costs
+	/// the first time it appears rather than on repeated renders. Lines
+	/// which collide with each other are laid out differently on their own.
+	void ProfileLines(double time, std::function<void (std::vector<LineRenderCost>)> done) throw();
+
+	/// A frame to prerender and the start time of it in milliseconds
+	typedef std::pair<int, double> PrerenderFrame;
+
+	/// @brief Decode frames and render their subtitles ahead of playing them
+	/// @param frames Frames to render
+	/// @param ps     Progress sink to report to and check for cancelling, if any
+	/// @return false if cancelled
+	///
+	/// Each frame is rendered as a separate job on the worker, so this blocks
+	/// the calling thread until they're all done. The decoded frames go in
+	/// the frame cache and the subtitles are kept until any of the lines
+	/// visible on them change. Frames past what fits in the frame cache or
+	/// the limit on prerendered subtitles are left to be rendered when played.
+	bool Prerender(std::vector<PrerenderFrame> const& frames, agi::ProgressSink *ps);
+
+	/// Have all of the given frames' subtitles been prerendered?
+	bool IsPrerendered(std::vector<PrerenderFrame> const& frames);
 
 	/// @brief Queue a request for a frame
 	/// @brief frame Frame number
@@ -105,11 +326,20 @@ public:
 	/// is no guarantee that the requested frame will ever actually be produced
 	void RequestFrame(int frame, double time) throw();
 
+	/// @brief Decode a frame and render its subtitles ahead of it being requested
+	/// @brief frame Frame number
+	/// @brief time  Exact start time of the frame in seconds
+	///
+	/// The frame goes in the frame cache and the subtitles in the overlay
+	/// cache, so that requesting it afterwards only has to combine them. It's
+	/// dropped if anything else is requested before the worker gets to it.
+	void PrefetchFrame(int frame, double time) throw();
+
 	/// @brief Synchronously get a frame
 	/// @brief frame Frame number
 	/// @brief time  Exact start time of the frame in seconds
 	/// @brief raw   Get raw frame without subtitles
-	std::shared_ptr<VideoFrame> GetFrame(int frame, double time, bool raw = false);
+	std::shared_ptr<const VideoFrame> GetFrame(int frame, double time, bool raw = false);
 
 	/// @brief Synchronously get the subtitles with transparent background
 	/// @brief time  Exact start time of the frame in seconds
@@ -120,9 +350,46 @@ public:
 	/// purposes like copying the current subtitles to the clipboard.
 	VideoFrame GetSubtitles(double time);
 
+	/// @brief Read through the video in the background
+	/// @param first  First frame to read
+	/// @param budget Milliseconds to keep the worker busy for at most
+	/// @param fn     Called on the worker thread with each frame in order
+	/// @param done   Called on the worker thread with the first frame which
+	///               wasn't read, or -1 if decoding failed
+	///
+	/// Reading stops early as soon as anything else is requested, so that
+	/// scanning never delays seeking by more than a frame. The frames read
+	/// aren't added to the frame cache.
+	void ScanFrames(int first, int budget, std::function<void (int, VideoFrame const&)> fn, std::function<void (int)> done) throw();
+
+	/// @brief Read the given frames in the background, in the same way as ScanFrames()
+	/// @param fn   Called with the index in frames and the frame
+	/// @param done Called with the index of the first frame which wasn't
+	///             read, or -1 if decoding failed
+	void ReadFrames(std::vector<int> frames, int budget, std::function<void (int, VideoFrame const&)> fn, std::function<void (int)> done) throw();
+
+	/// @brief Decode frames at a reduced size, for scrubbing
+	/// @param divisor Amount to divide each dimension by, or 1 for full size
+	///
+	/// This applies to frames requested after this call, and is ignored by
+	/// providers which can't do it. Subtitles are rendered at the reduced
+	/// size too, rather than scaled.
+	void SetProxyScale(int divisor) throw();
+
+	/// @brief Render subtitles at a reduced size, for playback
+	/// @param divisor Amount to divide each dimension by, or 1 for full size
+	///
+	/// The overlays are scaled back up to the size of the frame when they're
+	/// drawn, so this trades sharpness for render time. Subtitles drawn
+	/// directly onto frames by providers without overlays are unaffected.
+	void SetSubtitleScale(int divisor) throw();
+
 	/// Ask the video provider to change YCbCr matricies
 	void SetColorSpace(std::string const& matrix);
 
+	/// Get the usage counters of the video frame cache
+	VideoFrameCacheStats GetCacheStats();
+
 	int GetFrameCount() const             { return source_provider->GetFrameCount(); }
 	int GetWidth() const                  { return source_provider->GetWidth(); }
 	int GetHeight() const                 { return source_provider->GetHeight(); }
@@ -139,19 +406,23 @@ public:
 	/// @brief Constructor
 	/// @param videoFileName File to open
 	/// @param parent Event handler to send FrameReady events to
-	AsyncVideoProvider(agi::fs::path const& filename, std::string const& colormatrix, wxEvtHandler *parent, agi::BackgroundRunner *br);
+	AsyncVideoProvider(agi::fs::path const& filename, std::string const& colormatrix, bool hw_decode, wxEvtHandler *parent, agi::BackgroundRunner *br);
 	~AsyncVideoProvider();
 };
 
 /// Event which signals that a requested frame is ready
 struct FrameReadyEvent final : public wxEvent {
 	/// Frame which is ready
-	std::shared_ptr<VideoFrame> frame;
+	std::shared_ptr<const VideoFrame> frame;
 	/// Time which was used for subtitle rendering
 	double time;
+	/// Subtitles to draw over the frame, if they haven't been drawn onto it
+	std::shared_ptr<SubtitlesOverlay> overlay;
+	/// When the request which produced the frame was made
+	std::chrono::steady_clock::time_point requested;
 	wxEvent *Clone() const override { return new FrameReadyEvent(*this); };
-	FrameReadyEvent(std::shared_ptr<VideoFrame> frame, double time)
-	: frame(std::move(frame)), time(time) { }
+	FrameReadyEvent(std::shared_ptr<const VideoFrame> frame, double time, std::shared_ptr<SubtitlesOverlay> overlay = nullptr)
+	: frame(std::move(frame)), time(time), overlay(std::move(overlay)) { }
 };
 
 // These exceptions are wxEvents so that they can be passed directly back to
@@ -34,15 +34,21 @@
 #include "include/aegisub/context.h"
 #include "options.h"
 #include "project.h"
+#include "video_controller.h"
 
 #include <libaegisub/audio/provider.h>
+#include <libaegisub/audio/speech_detector.h>
+#include <libaegisub/dispatch.h>
 #include <libaegisub/log.h>
 
 #include <algorithm>
 #include <atomic>
 #include <cmath>
+#include <condition_variable>
+#include <cstring>
 #include <mutex>
 #include <memory>
+#include <thread>
 #include <vector>
 
 #ifdef WITH_SOUNDTOUCH
@@ -81,14 +87,39 @@ class AudioController::SpeedProvider final : public agi::AudioProvider {
 	mutable SoundTouchTimeStretch stretch;
 #endif
 
-	mutable std::mutex stretch_mutex;
-	mutable int64_t stream_output_pos = 0;
-	mutable int64_t stream_source_pos = 0;
-	mutable bool stream_flushed = false;
-
-	mutable std::vector<float> float_buffer;
-	mutable std::vector<float> stretch_output;
-	mutable std::vector<int16_t> int_buffer;
+	// State of the time-stretch stream, owned by the look-ahead thread
+	int64_t stream_source_pos = 0;
+	bool stream_flushed = false;
+
+	std::vector<float> float_buffer;
+	std::vector<float> stretch_output;
+	std::vector<int16_t> int_buffer;
+	std::vector<char> chunk_buffer;
+
+	// Look-ahead ring buffer of stretched audio, guarded by ring_mutex. The
+	// buffered frames are [ring_start, ring_end) in output sample positions.
+	mutable std::mutex ring_mutex;
+	mutable std::condition_variable producer_cond;
+	mutable std::condition_variable data_cond;
+	std::vector<char> ring;
+	int64_t ring_capacity = 0;
+	mutable int64_t ring_start = 0;
+	mutable int64_t ring_end = 0;
+	mutable int64_t read_pos = 0;
+	int64_t lookahead = 0;
+	int frame_bytes = 0;
+
+	// Restart requests from the player or the controller, applied by the
+	// look-ahead thread before it produces anything else
+	mutable bool reset_pending = false;
+	mutable uint64_t generation = 0;
+	mutable int64_t reset_start = 0;
+	mutable double reset_speed = 1.0;
+	mutable double reset_offset = 0.0;
+	mutable bool stretch_active = false;
+
+	bool producer_quit = false;
+	std::thread producer;
 
 	static std::atomic<bool> warned_soundtouch_missing;
 
@@ -106,8 +137,7 @@ class AudioController::SpeedProvider final : public agi::AudioProvider {
 
 	static constexpr int kChunkFrames = 2048;
 
-	void ResetStreamLocked(double cur_speed, double cur_offset, int64_t start) const {
-		stream_output_pos = start;
+	void ResetStretch(double cur_speed, double cur_offset, int64_t start) {
 		double start_pos = std::isfinite(cur_offset) ? cur_offset + start * cur_speed : 0.0;
 		if (!std::isfinite(start_pos))
 			start_pos = 0.0;
@@ -119,6 +149,96 @@ class AudioController::SpeedProvider final : public agi::AudioProvider {
 #endif
 	}
 
+	/// Restart the ring buffer at the given output position; ring_mutex must be held
+	void RequestResetLocked(int64_t start, double cur_speed, double cur_offset) const {
+		reset_pending = true;
+		++generation;
+		reset_start = start;
+		reset_speed = cur_speed;
+		reset_offset = cur_offset;
+		ring_start = ring_end = read_pos = start;
+		producer_cond.notify_all();
+	}
+
+	/// Append stretched frames to the ring, dropping already played frames
+	/// from the front to make room; ring_mutex must be held
+	void AppendLocked(const char *data, int64_t frames) {
+		frames = std::min(frames, ring_capacity);
+		ring_start = std::max(ring_start, ring_end + frames - ring_capacity);
+		for (int64_t done = 0; done < frames; ) {
+			const int64_t index = (ring_end + done) % ring_capacity;
+			const int64_t n = std::min(frames - done, ring_capacity - index);
+			memcpy(&ring[static_cast<size_t>(index * frame_bytes)], data + done * frame_bytes, static_cast<size_t>(n * frame_bytes));
+			done += n;
+		}
+		ring_end += frames;
+	}
+
+	/// Copy buffered frames starting at output position pos; ring_mutex must be held
+	void CopyOutLocked(char *dst, int64_t pos, int64_t frames) const {
+		for (int64_t done = 0; done < frames; ) {
+			const int64_t index = (pos + done) % ring_capacity;
+			const int64_t n = std::min(frames - done, ring_capacity - index);
+			memcpy(dst + done * frame_bytes, &ring[static_cast<size_t>(index * frame_bytes)], static_cast<size_t>(n * frame_bytes));
+			done += n;
+		}
+	}
+
+	/// Body of the look-ahead thread: keep the ring filled up to lookahead
+	/// frames past the player's read position
+	void ProducerLoop() {
+		std::unique_lock<std::mutex> lock(ring_mutex);
+		double cur_speed = 1.0;
+		while (!producer_quit) {
+			if (reset_pending) {
+				reset_pending = false;
+				cur_speed = reset_speed;
+				const double cur_offset = reset_offset;
+				const int64_t start = reset_start;
+				lock.unlock();
+				ResetStretch(cur_speed, cur_offset, start);
+				lock.lock();
+				continue;
+			}
+
+			if (!stretch_active || ring_end - read_pos >= lookahead || ring_end >= num_samples) {
+				producer_cond.wait(lock);
+				continue;
+			}
+
+			const uint64_t gen = generation;
+			const int64_t frames = std::min<int64_t>(kChunkFrames, num_samples - ring_end);
+			lock.unlock();
+			ProduceStretched(chunk_buffer.data(), frames, cur_speed);
+			lock.lock();
+
+			// Discard the chunk if the stream was restarted while producing it
+			if (gen != generation) continue;
+			AppendLocked(chunk_buffer.data(), frames);
+			data_cond.notify_all();
+		}
+	}
+
+	void StartProducer() {
+		frame_bytes = channels * bytes_per_sample;
+		lookahead = std::max<int64_t>(sample_rate, kChunkFrames);
+		ring_capacity = lookahead * 2;
+		ring.assign(static_cast<size_t>(ring_capacity * frame_bytes), 0);
+		chunk_buffer.resize(static_cast<size_t>(kChunkFrames * frame_bytes));
+		producer_quit = false;
+		producer = std::thread([this] { ProducerLoop(); });
+	}
+
+	void StopProducer() {
+		if (!producer.joinable()) return;
+		{
+			std::lock_guard<std::mutex> lock(ring_mutex);
+			producer_quit = true;
+		}
+		producer_cond.notify_all();
+		producer.join();
+	}
+
 	void FillLegacy(void *buf, int64_t start, int64_t count, double cur_speed, double cur_offset) const {
 		if (channels <= 0 || count <= 0) {
 			ZeroFill(buf, count);
@@ -187,19 +307,10 @@ class AudioController::SpeedProvider final : public agi::AudioProvider {
 		}
 	}
 
-	int64_t FillWithSoundTouch(void *buf, int64_t start, int64_t count, double cur_speed, double cur_offset) const {
+	/// Produce the next count frames of the time-stretch stream; only called
+	/// from the look-ahead thread
+	void ProduceStretched(void *buf, int64_t count, double cur_speed) {
 #ifdef WITH_SOUNDTOUCH
-		if (channels <= 0) {
-			ZeroFill(buf, count);
-			return 0;
-		}
-
-		std::lock_guard<std::mutex> lock(stretch_mutex);
-		stretch.Configure(sample_rate, channels, cur_speed);
-
-		if (start != stream_output_pos)
-			ResetStreamLocked(cur_speed, cur_offset, start);
-
 		int64_t produced = 0;
 		const int64_t source_limit = source ? source->GetNumSamples() : 0;
 
@@ -267,15 +378,45 @@ class AudioController::SpeedProvider final : public agi::AudioProvider {
 			stretch.Put(float_buffer.data(), frames_to_read);
 			stream_source_pos += frames_to_read;
 		}
-
-		stream_output_pos = start + produced;
-		return produced;
 #else
 		ZeroFill(buf, count);
-		return 0;
+		(void)cur_speed;
 #endif
 	}
 
+	/// Copy time-stretched audio out of the look-ahead buffer, restarting it
+	/// if the player jumped somewhere that isn't buffered
+	void FillStretched(void *buf, int64_t start, int64_t count, double cur_speed, double cur_offset) const {
+		if (channels <= 0 || !producer.joinable()) {
+			ZeroFill(buf, count);
+			return;
+		}
+
+		auto *dst = static_cast<char *>(buf);
+		std::unique_lock<std::mutex> lock(ring_mutex);
+		stretch_active = true;
+		int64_t done = 0;
+		while (done < count) {
+			const int64_t pos = start + done;
+			if (pos < ring_start || pos > ring_end)
+				RequestResetLocked(pos, cur_speed, cur_offset);
+
+			read_pos = pos;
+			if (pos == ring_end) {
+				producer_cond.notify_all();
+				data_cond.wait(lock);
+				continue;
+			}
+
+			const int64_t n = std::min(count - done, ring_end - pos);
+			CopyOutLocked(dst + done * frame_bytes, pos, n);
+			done += n;
+		}
+
+		read_pos = start + count;
+		producer_cond.notify_all();
+	}
+
 	bool UseSoundTouch(double cur_speed) const {
 #ifdef WITH_SOUNDTOUCH
 		return keep_pitch.load(std::memory_order_relaxed) && std::abs(cur_speed - 1.0) >= 1e-9;
@@ -290,7 +431,12 @@ public:
 		SetSource(src);
 	}
 
+	~SpeedProvider() {
+		StopProducer();
+	}
+
 	void SetSource(agi::AudioProvider *src) {
+		StopProducer();
 		source = src;
 		if (source) {
 			channels = source->GetChannels();
@@ -309,6 +455,9 @@ public:
 		decoded_samples = num_samples;
 		speed.store(1.0, std::memory_order_relaxed);
 		sample_offset.store(0.0, std::memory_order_relaxed);
+#ifdef WITH_SOUNDTOUCH
+		StartProducer();
+#endif
 		ResetStream();
 	}
 
@@ -325,6 +474,7 @@ public:
 		if (slowdown < 1.0)
 			required = static_cast<int64_t>(std::ceil(source->GetNumSamples() / slowdown));
 
+		std::lock_guard<std::mutex> lock(ring_mutex);
 		if (required > num_samples)
 			num_samples = required;
 		decoded_samples = num_samples;
@@ -345,11 +495,14 @@ public:
 #endif
 	}
 
+	/// Restart the stream at the beginning with the current settings, and
+	/// start stretching it in the background so that it's ready to play
 	void ResetStream() {
-		std::lock_guard<std::mutex> lock(stretch_mutex);
+		std::lock_guard<std::mutex> lock(ring_mutex);
 		const double cur_speed = speed.load(std::memory_order_relaxed);
 		const double cur_offset = sample_offset.load(std::memory_order_relaxed);
-		ResetStreamLocked(cur_speed, cur_offset, 0);
+		stretch_active = UseSoundTouch(cur_speed);
+		RequestResetLocked(0, cur_speed, cur_offset);
 	}
 
 protected:
@@ -368,7 +521,7 @@ protected:
 		}
 
 		if (UseSoundTouch(cur_speed)) {
-			FillWithSoundTouch(buf, start, count, cur_speed, cur_offset);
+			FillStretched(buf, start, count, cur_speed, cur_offset);
 			return;
 		}
 
@@ -424,6 +577,8 @@ AudioController::AudioController(agi::Context *context)
 : context(context)
 , playback_timer(this)
 , provider_connection(context->project->AddAudioProviderListener(&AudioController::OnAudioProvider, this))
+, preroll_queue(agi::dispatch::Create(agi::dispatch::Priority::Prefetch))
+, video_seek_connection(context->videoController->AddSeekListener([=](int) { Preroll(); }))
 {
 	Bind(wxEVT_TIMER, &AudioController::OnPlaybackTimer, this, playback_timer.GetId());
 
@@ -438,6 +593,46 @@ AudioController::AudioController(agi::Context *context)
 AudioController::~AudioController()
 {
 	Stop();
+	CancelPreroll();
+}
+
+void AudioController::Preroll()
+{
+	if (!provider || IsPlaying() || context->videoController->IsPlaying()) return;
+
+	// Most of the play commands start at one of the ends of the selection
+	// or half a second before one of them
+	std::vector<int64_t> starts;
+	if (timing_controller) {
+		auto range = GetPrimaryPlaybackRange();
+		for (int ms : {range.begin(), range.end(), range.begin() - 500, range.end() - 500})
+			starts.push_back(SamplesFromMilliseconds(std::max(ms, 0)));
+	}
+	if (context->project->VideoProvider())
+		starts.push_back(SamplesFromMilliseconds(context->videoController->TimeAtFrame(context->videoController->GetFrameN())));
+
+	// About what the players ask for in their first few buffers
+	const int64_t count = SamplesFromMilliseconds(250);
+	auto source = provider;
+	size_t generation = ++preroll_generation;
+	preroll_queue->Async([=] {
+		std::vector<char> buffer;
+		for (int64_t start : starts) {
+			if (preroll_generation != generation) return;
+
+			int64_t length = std::min(count, source->GetNumSamples() - start);
+			if (length <= 0 || source->IsRangeDecoded(start, length)) continue;
+
+			buffer.resize(length * source->GetBytesPerSample() * source->GetChannels());
+			source->GetAudio(buffer.data(), start, length);
+		}
+	});
+}
+
+void AudioController::CancelPreroll()
+{
+	++preroll_generation;
+	preroll_queue->Sync([] { });
 }
 
 void AudioController::OnPlaybackTimer(wxTimerEvent &)
@@ -494,6 +689,7 @@ void AudioController::OnAudioPlayerChanged()
 
 void AudioController::OnAudioProvider(agi::AudioProvider *new_provider)
 {
+	CancelPreroll();
 	provider = new_provider;
 	Stop();
 	player.reset();
@@ -509,12 +705,14 @@ void AudioController::SetTimingController(std::unique_ptr<AudioTimingController>
 		timing_controller->AddUpdatedPrimaryRangeListener(&AudioController::OnTimingControllerUpdatedPrimaryRange, this);
 
 	AnnounceTimingControllerChanged();
+	Preroll();
 }
 
 void AudioController::OnTimingControllerUpdatedPrimaryRange()
 {
 	if (playback_mode == PM_PrimaryRange)
 		player->SetEndPosition(SamplesFromMilliseconds(timing_controller->GetPrimaryPlaybackRange().end()));
+	Preroll();
 }
 
 void AudioController::PlayRange(const TimeRange &range)
@@ -525,6 +723,7 @@ void AudioController::PlayRange(const TimeRange &range)
 	playback_speed = 1.0;
 	playback_sample_offset = 0.0;
 
+	provider->PrioritizeDecoding(SamplesFromMilliseconds(range.begin()));
 	player->Play(SamplesFromMilliseconds(range.begin()), SamplesFromMilliseconds(range.length()));
 	playback_mode = PM_Range;
 	playback_timer.Start(20);
@@ -550,6 +749,7 @@ void AudioController::PlayRange(const TimeRange &range, double speed)
 
 	const bool keep_pitch = OPT_GET("Audio/Keep Pitch When Changing Speed")->GetBool();
 
+	provider->PrioritizeDecoding(start_sample);
 	playback_speed = speed;
 	playback_sample_offset = static_cast<double>(start_sample);
 	speed_provider->SetSpeed(speed);
@@ -588,6 +788,7 @@ void AudioController::PlayToEnd(int start_ms)
 	playback_sample_offset = 0.0;
 
 	int64_t start_sample = SamplesFromMilliseconds(start_ms);
+	provider->PrioritizeDecoding(start_sample);
 	player->Play(start_sample, provider->GetNumSamples()-start_sample);
 	playback_mode = PM_ToEnd;
 	playback_timer.Start(20);
@@ -613,6 +814,7 @@ void AudioController::PlayToEnd(int start_ms, double speed)
 
 	const bool keep_pitch = OPT_GET("Audio/Keep Pitch When Changing Speed")->GetBool();
 
+	provider->PrioritizeDecoding(start_sample);
 	playback_speed = speed;
 	playback_sample_offset = static_cast<double>(start_sample);
 	speed_provider->SetSpeed(speed);
@@ -659,6 +861,18 @@ int AudioController::GetDuration() const
 	return (provider->GetNumSamples() * 1000 + provider->GetSampleRate() - 1) / provider->GetSampleRate();
 }
 
+bool AudioController::GetSpeechSegments(TimeRange const& range, std::vector<agi::SpeechSegment> &out) const
+{
+	auto speech = provider ? provider->GetSpeech() : nullptr;
+	if (!speech) return false;
+
+	agi::SpeechDetectionSettings settings;
+	settings.threshold = OPT_GET("Audio/Speech Detection/Threshold")->GetInt();
+	settings.min_gap = OPT_GET("Audio/Speech Detection/Min Gap")->GetInt();
+	settings.min_length = OPT_GET("Audio/Speech Detection/Min Length")->GetInt();
+	return speech->GetSegments(range.begin(), range.end(), settings, out);
+}
+
 TimeRange AudioController::GetPrimaryPlaybackRange() const
 {
 	if (timing_controller)
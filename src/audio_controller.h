@@ -30,7 +30,10 @@
 #include <libaegisub/exception.h>
 #include <libaegisub/signal.h>
 
+#include <atomic>
 #include <cstdint>
+#include <memory>
+#include <vector>
 #include <wx/event.h>
 #include <wx/power.h>
 #include <wx/timer.h>
@@ -38,8 +41,9 @@
 class AudioPlayer;
 class AudioTimingController;
 class TimeRange;
-namespace agi { class AudioProvider; }
+namespace agi { class AudioProvider; struct SpeechSegment; }
 namespace agi { struct Context; }
+namespace agi { namespace dispatch { class Queue; } }
 
 /// @class AudioController
 /// @brief Manage playback of an open audio stream
@@ -96,6 +100,22 @@ class AudioController final : public wxEvtHandler {
 
 	void EnsureAudioPlayerForSpeed(double speed);
 
+	/// Worker which reads the audio at the places playback is likely to be
+	/// started from next, so that starting playback doesn't wait on decoding
+	std::unique_ptr<agi::dispatch::Queue> preroll_queue;
+	/// Incremented to make queued prerolls which are no longer wanted skip
+	/// their reads
+	std::atomic<size_t> preroll_generation{0};
+	agi::signal::Connection video_seek_connection;
+
+	/// Make sure the first buffers for the likely play targets are decoded:
+	/// the starts of the primary range, the bits just before and after it,
+	/// and the video position
+	void Preroll();
+
+	/// Cancel any outstanding preroll and wait for it to stop reading
+	void CancelPreroll();
+
 	void OnAudioProvider(agi::AudioProvider *new_provider);
 
 	/// Event handler for the playback timer
@@ -183,6 +203,15 @@ public:
 	/// @return An immutable TimeRange object
 	TimeRange GetPrimaryPlaybackRange() const;
 
+	/// @brief Get the speech detected in a range of the audio
+	/// @param range Range of times to look for speech in
+	/// @param[out] out Speech overlapping the range, in order
+	/// @return Has the entire range been analyzed? False if no audio is open,
+	///         the audio isn't cached or it hasn't been decoded there yet.
+	///
+	/// The detection settings are taken from the Audio/Speech Detection options.
+	bool GetSpeechSegments(TimeRange const& range, std::vector<agi::SpeechSegment> &out) const;
+
 	/// @brief Set the playback audio volume
 	/// @param volume The new amplification factor for the audio
 	void SetVolume(double volume);
@@ -30,6 +30,8 @@
 
 #include "audio_display.h"
 
+#include "ass_dialogue.h"
+#include "ass_file.h"
 #include "audio_controller.h"
 #include "audio_renderer.h"
 #include "audio_renderer_spectrum.h"
@@ -41,14 +43,18 @@
 #include "include/aegisub/hotkey.h"
 #include "options.h"
 #include "project.h"
+#include "selection_controller.h"
 #include "utils.h"
 #include "video_controller.h"
 
 #include <libaegisub/ass/time.h>
+#include <libaegisub/audio/peak_pyramid.h>
 #include <libaegisub/audio/provider.h>
+#include <libaegisub/log.h>
 #include <libaegisub/make_unique.h>
 
 #include <algorithm>
+#include <cstdlib>
 
 #include <wx/dcbuffer.h>
 #include <wx/mousestate.h>
@@ -150,6 +156,38 @@ class AudioDisplayScrollbar final : public AudioDisplayInteractionObject {
 	/// Containing display to send scroll events to
 	AudioDisplay *display;
 
+	/// Peaks of the open audio, or nullptr if the provider doesn't have any
+	agi::AudioPeakPyramid const* peaks = nullptr;
+	int64_t num_samples = 0;
+	/// Loudness of the whole file at one point per pixel of the scrollbar
+	agi::AudioLoudnessOverview overview;
+
+	int duration = 1; ///< Total duration in ms
+	/// Start and end times of every visible line
+	std::vector<std::pair<int, int>> lines;
+	/// Pixel spans of the scrollbar covered by lines
+	std::vector<std::pair<int, int>> line_spans;
+
+	void RecalculateOverview()
+	{
+		overview = agi::AudioLoudnessOverview(peaks ? num_samples : 0, std::max(0, bounds.width));
+		UpdateOverview();
+	}
+
+	void RecalculateLineSpans()
+	{
+		line_spans.clear();
+		for (auto const& line : lines)
+		{
+			const int left = int((int64_t)bounds.width * line.first / duration);
+			const int right = std::max(left + 1, int((int64_t)bounds.width * line.second / duration));
+			if (!line_spans.empty() && left <= line_spans.back().second)
+				line_spans.back().second = std::max(line_spans.back().second, right);
+			else
+				line_spans.emplace_back(left, right);
+		}
+	}
+
 	// Recalculate thumb bounds from position and length data
 	void RecalculateThumb()
 	{
@@ -175,6 +213,36 @@ public:
 		page_length = display_size.x;
 
 		RecalculateThumb();
+		if (overview.size() != (size_t)std::max(0, bounds.width))
+		{
+			RecalculateOverview();
+			RecalculateLineSpans();
+		}
+	}
+
+	/// Set the audio to show the loudness of
+	void SetAudio(agi::AudioProvider *provider)
+	{
+		peaks = provider ? provider->GetPeaks() : nullptr;
+		num_samples = provider ? provider->GetNumSamples() : 0;
+		RecalculateOverview();
+	}
+
+	/// Fill in the loudness of any newly decoded audio
+	/// @return Does the scrollbar need to be redrawn?
+	bool UpdateOverview()
+	{
+		return peaks && overview.Update(*peaks);
+	}
+
+	/// Set the lines to mark on the scrollbar
+	/// @param new_lines    Start and end times of the lines, sorted by start time
+	/// @param new_duration Duration of the audio in ms
+	void SetLines(std::vector<std::pair<int, int>> new_lines, int new_duration)
+	{
+		lines = std::move(new_lines);
+		duration = std::max(1, new_duration);
+		RecalculateLineSpans();
 	}
 
 	void SetColourScheme(std::string const& name)
@@ -242,6 +310,25 @@ public:
 		dc.SetBrush(wxBrush(colours.Dark()));
 		dc.DrawRectangle(bounds);
 
+		// Loudness of the whole file, as bars rising from the bottom in a
+		// colour halfway between the background and the thumb
+		const wxColour light = colours.Light(), dark = colours.Dark();
+		dc.SetPen(wxPen(wxColour((light.Red() + dark.Red()) / 2, (light.Green() + dark.Green()) / 2, (light.Blue() + dark.Blue()) / 2)));
+		const int bar_height = bounds.height - 2;
+		for (size_t x = 0; x < overview.size(); ++x)
+		{
+			const int level = overview[x];
+			if (level <= 1) continue;
+			const int h = (level * bar_height + 254) / 255;
+			dc.DrawLine(bounds.x + x, bounds.GetBottom() - h, bounds.x + x, bounds.GetBottom());
+		}
+
+		// Strip along the top edge showing where there are lines
+		dc.SetPen(*wxTRANSPARENT_PEN);
+		dc.SetBrush(wxBrush(light));
+		for (auto const& span : line_spans)
+			dc.DrawRectangle(bounds.x + span.first, bounds.y + 1, span.second - span.first, 2);
+
 		if (sel_length > 0 && sel_start >= 0)
 		{
 			dc.SetPen(wxPen(colours.Selection()));
@@ -541,6 +628,8 @@ class AudioMarkerInteractionObject final : public AudioDisplayInteractionObject
 	bool default_snap = OPT_GET("Audio/Snap/Enable")->GetBool();
 	// Range in pixels to snap at
 	int snap_range = OPT_GET("Audio/Snap/Distance")->GetInt();
+	// Has the timing controller been told that the drag is over?
+	bool finished = false;
 
 public:
 	AudioMarkerInteractionObject(std::vector<AudioMarker*> markers, AudioTimingController *timing_controller, AudioDisplay *display, wxMouseButton button_used)
@@ -562,7 +651,21 @@ public:
 		}
 
 		// We lose the marker drag if the button used to initiate it goes up
-		return !event.ButtonUp(button_used);
+		if (event.ButtonUp(button_used))
+		{
+			Finish();
+			return false;
+		}
+		return true;
+	}
+
+	/// Tell the timing controller that the drag is over, if it hasn't been
+	/// told already
+	void Finish()
+	{
+		if (!finished)
+			timing_controller->OnMarkerDragEnd();
+		finished = true;
 	}
 
 	/// Get the position in milliseconds of this group of markers
@@ -607,6 +710,25 @@ AudioDisplay::AudioDisplay(wxWindow *parent, AudioController *controller, agi::C
 
 AudioDisplay::~AudioDisplay()
 {
+	LogCacheStats();
+}
+
+void AudioDisplay::LogCacheStats() const
+{
+	auto log = [](const char *name, DataBlockCacheStats const& stats) {
+		const uint64_t requests = stats.hits + stats.misses;
+		if (!requests) return;
+		LOG_I("audio/display/cache") << name
+			<< ": hits=" << stats.hits
+			<< " misses=" << stats.misses
+			<< " hit rate=" << (stats.hits * 100 / requests) << "%"
+			<< " evictions=" << stats.evictions
+			<< " blocks=" << stats.blocks
+			<< " bytes=" << stats.bytes;
+	};
+
+	log("bitmaps", audio_renderer->GetBitmapCacheStats());
+	log("renderer", audio_renderer->GetRendererCacheStats());
 }
 
 void AudioDisplay::ScrollBy(int pixel_amount)
@@ -623,10 +745,39 @@ void AudioDisplay::ScrollPixelToLeft(int pixel_position)
 	if (pixel_position < 0)
 		pixel_position = 0;
 
+	const int dx = scroll_left - pixel_position;
 	scroll_left = pixel_position;
 	scrollbar->SetPosition(scroll_left);
 	timeline->SetPosition(scroll_left);
-	Refresh();
+
+	// Have the audio cache decode what's now visible first
+	if (provider)
+		provider->PrioritizeDecoding((int64_t)TimeFromAbsoluteX(scroll_left) * provider->GetSampleRate() / 1000);
+
+	if (dx == 0) return;
+	if (std::abs(dx) >= client_width / 2)
+	{
+		Refresh();
+		return;
+	}
+
+	// Everything drawn over the audio other than the track cursor's label is
+	// anchored to a time, so move what's on screen and paint only the newly
+	// exposed columns. Pending repaints are done first so that what's moved
+	// is up to date.
+	Update();
+	const wxRect audio_rect(0, audio_top, client_width, audio_height);
+	ScrollWindow(dx, 0, &audio_rect);
+
+	if (track_cursor_pos >= 0 && !track_cursor_label.empty())
+	{
+		wxRect moved_label = track_cursor_label_rect;
+		moved_label.Offset(dx, 0);
+		RefreshRect(track_cursor_label_rect, false);
+		RefreshRect(moved_label, false);
+	}
+	RefreshRect(scrollbar->GetBounds(), false);
+	RefreshRect(timeline->GetBounds(), false);
 }
 
 void AudioDisplay::ScrollTimeRangeInView(const TimeRange &range)
@@ -802,10 +953,10 @@ void AudioDisplay::OnLoadTimer(wxTimerEvent&)
 		if (new_pos > audio_load_position)
 			audio_load_position = new_pos;
 
-		const double left = last_sample_decoded * 1000.0 / provider->GetSampleRate() / ms_per_pixel;
-		const double right = new_decoded_count * 1000.0 / provider->GetSampleRate() / ms_per_pixel;
-
-		if (left < scroll_left + pixel_audio_width && right >= scroll_left)
+		// Blocks are decoded starting from wherever the user last looked, so
+		// newly decoded audio may be anywhere rather than just past the old end
+		scrollbar->UpdateOverview();
+		if (new_decoded_count != last_sample_decoded)
 			Refresh();
 		else
 			RefreshRect(scrollbar->GetBounds());
@@ -815,6 +966,10 @@ void AudioDisplay::OnLoadTimer(wxTimerEvent&)
 	if (!provider || last_sample_decoded == provider->GetNumSamples()) {
 		load_timer.Stop();
 		audio_load_position = -1;
+		// The peaks of the last blocks may have been summarized after the
+		// final check above
+		if (scrollbar->UpdateOverview())
+			RefreshRect(scrollbar->GetBounds(), false);
 	}
 }
 
@@ -921,9 +1076,14 @@ void AudioDisplay::PaintLabels(wxDC &dc, TimeRange updtime)
 	font.SetWeight(wxFONTWEIGHT_BOLD);
 	fc.Set(font);
 	dc.SetTextForeground(*wxWHITE);
+	if (label_extents.size() > 4096)
+		label_extents.clear();
 	for (auto const& label : labels)
 	{
-		wxSize extent = dc.GetTextExtent(label.text);
+		auto it = label_extents.find(label.text);
+		if (it == label_extents.end())
+			it = label_extents.emplace(label.text, dc.GetTextExtent(label.text)).first;
+		wxSize extent = it->second;
 		int left = RelativeXFromTime(label.range.begin());
 		int width = AbsoluteXFromTime(label.range.length());
 
@@ -995,8 +1155,12 @@ void AudioDisplay::SetDraggedObject(AudioDisplayInteractionObject *new_obj)
 	else if (!dragged_object && HasCapture())
 		ReleaseMouse();
 
-	if (!dragged_object)
+	if (!dragged_object && audio_marker)
+	{
+		// The drag may have been lost without the button being released
+		audio_marker->Finish();
 		audio_marker.reset();
+	}
 }
 
 void AudioDisplay::SetTrackCursor(int new_pos, bool show_time)
@@ -1210,6 +1374,8 @@ int AudioDisplay::GetDuration() const
 
 void AudioDisplay::OnAudioOpen(agi::AudioProvider *provider)
 {
+	if (this->provider)
+		LogCacheStats();
 	this->provider = provider;
 
 	if (!audio_renderer_provider)
@@ -1219,6 +1385,7 @@ void AudioDisplay::OnAudioOpen(agi::AudioProvider *provider)
 	audio_renderer->SetCacheMaxSize(OPT_GET("Audio/Renderer/Spectrum/Memory Max")->GetInt() * 1024 * 1024);
 
 	timeline->ChangeAudio(GetDuration());
+	scrollbar->SetAudio(provider);
 
 	ms_per_pixel = 0;
 	SetZoomLevel(zoom_level);
@@ -1233,15 +1400,19 @@ void AudioDisplay::OnAudioOpen(agi::AudioProvider *provider)
 				controller->AddPlaybackPositionListener(&AudioDisplay::OnPlaybackPosition, this),
 				controller->AddPlaybackStopListener(&AudioDisplay::RemoveTrackCursor, this),
 				controller->AddTimingControllerListener(&AudioDisplay::OnTimingController, this),
+				audio_renderer->AddBitmapsRenderedListener(&AudioDisplay::OnBitmapsRendered, this),
 				OPT_SUB("Audio/Spectrum", &AudioDisplay::ReloadRenderingSettings, this),
 				OPT_SUB("Audio/Display/Waveform Style", &AudioDisplay::ReloadRenderingSettings, this),
 				OPT_SUB("Colour/Audio Display/Spectrum", &AudioDisplay::ReloadRenderingSettings, this),
 				OPT_SUB("Colour/Audio Display/Waveform", &AudioDisplay::ReloadRenderingSettings, this),
 				OPT_SUB("Audio/Renderer/Spectrum/Quality", &AudioDisplay::ReloadRenderingSettings, this),
 				OPT_SUB("Audio/Renderer/Spectrum/FreqCurve", &AudioDisplay::ReloadRenderingSettings, this),
+				context->ass->AddCommitListener(&AudioDisplay::OnSubtitlesCommit, this),
+				context->selectionController->AddActiveLineListener(&AudioDisplay::OnActiveLineChanged, this),
 			});
 			OnTimingController();
 		}
+		UpdateScrollbarLines();
 
 		last_sample_decoded = provider->GetDecodedSamples();
 		audio_load_position = -1;
@@ -1258,6 +1429,19 @@ void AudioDisplay::OnAudioOpen(agi::AudioProvider *provider)
 
 void AudioDisplay::OnTimingController()
 {
+	// The markers of any drag in progress belonged to the old controller
+	if (audio_marker)
+	{
+		if (dragged_object == audio_marker.get())
+		{
+			dragged_object = nullptr;
+			if (HasCapture())
+				ReleaseMouse();
+		}
+		audio_marker.reset();
+	}
+	label_extents.clear();
+
 	AudioTimingController *timing_controller = controller->GetTimingController();
 	if (timing_controller)
 	{
@@ -1351,7 +1535,58 @@ void AudioDisplay::OnStyleRangesChanged()
 	RefreshRect(wxRect(0, audio_top, GetClientSize().GetWidth(), audio_height), false);
 }
 
+void AudioDisplay::OnSubtitlesCommit(int type, const AssDialogue *)
+{
+	if (type == AssFile::COMMIT_NEW || type & (AssFile::COMMIT_DIAG_ADDREM | AssFile::COMMIT_DIAG_TIME | AssFile::COMMIT_DIAG_META))
+		UpdateScrollbarLines();
+}
+
+void AudioDisplay::OnActiveLineChanged(AssDialogue *line)
+{
+	if (!line || !provider || !OPT_GET("Audio/Auto/Scroll")->GetBool()) return;
+
+	auto next = context->ass->iterator_to(*line);
+	if (++next == context->ass->Events.end()) return;
+
+	// Where ScrollTimeRangeInView() would put the line, roughly
+	const int client_width = GetClientRect().GetWidth();
+	const int line_begin = AbsoluteXFromTime(next->Start);
+	const int line_end = AbsoluteXFromTime(next->End);
+	const int view_begin = line_end - line_begin < client_width
+		? line_begin - (client_width - (line_end - line_begin)) / 2
+		: line_begin - client_width / 20;
+
+	const int current_begin = std::max(view_begin, AbsoluteXFromTime(line->Start));
+	const int current_end = std::min(view_begin + client_width, AbsoluteXFromTime(line->End));
+
+	// The next line becomes the primary range, and the current line is
+	// usually still there as an inactive line
+	audio_renderer->Prefetch({
+		{line_begin, std::min(line_end, view_begin + client_width) - line_begin, AudioStyle_Primary},
+		{current_begin, current_end - current_begin, AudioStyle_Inactive},
+		{view_begin, client_width, AudioStyle_Normal},
+	});
+}
+
+void AudioDisplay::UpdateScrollbarLines()
+{
+	std::vector<std::pair<int, int>> lines;
+	for (auto const& line : context->ass->Events)
+	{
+		if (!line.Comment)
+			lines.emplace_back(line.Start, line.End);
+	}
+	sort(begin(lines), end(lines));
+	scrollbar->SetLines(std::move(lines), GetDuration());
+	RefreshRect(scrollbar->GetBounds(), false);
+}
+
 void AudioDisplay::OnMarkerMoved()
 {
 	RefreshRect(wxRect(0, audio_top, GetClientSize().GetWidth(), audio_height), false);
 }
+
+void AudioDisplay::OnBitmapsRendered()
+{
+	RefreshRect(wxRect(0, audio_top, GetClientSize().GetWidth(), audio_height), false);
+}
@@ -32,6 +32,7 @@
 
 #include <chrono>
 #include <cstdint>
+#include <map>
 #include <memory>
 
 #include <wx/gdicmn.h>
@@ -42,6 +43,7 @@
 namespace agi { class AudioProvider; }
 namespace agi { struct Context; }
 
+class AssDialogue;
 class AudioController;
 class AudioRenderer;
 class AudioRendererBitmapProvider;
@@ -94,6 +96,10 @@ class AudioDisplay: public wxWindow {
 	void SetDraggedObject(AudioDisplayInteractionObject *new_obj);
 
 
+	/// Cached extents of the syllable labels' text, as measuring every label
+	/// on every repaint while a marker is dragged adds up on long lines
+	std::map<wxString, wxSize> label_extents;
+
 	/// Timer for scrolling when markers are dragged out of the displayed area
 	wxTimer scroll_timer;
 
@@ -152,6 +158,9 @@ class AudioDisplay: public wxWindow {
 	/// in Options and need to be reloaded to take effect.
 	void ReloadRenderingSettings();
 
+	/// Write the renderer's cache usage counters to the log
+	void LogCacheStats() const;
+
 	/// Paint the audio data for a time range
 	/// @param dc DC to paint to
 	/// @param updtime Time range to repaint
@@ -205,6 +214,13 @@ class AudioDisplay: public wxWindow {
 	void OnStyleRangesChanged();
 	void OnTimingController();
 	void OnMarkerMoved();
+	void OnBitmapsRendered();
+	void OnSubtitlesCommit(int type, const AssDialogue *);
+	/// Render the audio around the line after the new active line, which
+	/// moving on to the next line will scroll to
+	void OnActiveLineChanged(AssDialogue *line);
+	/// Mark where the lines of the file are on the scrollbar
+	void UpdateScrollbarLines();
 
 public:
 	AudioDisplay(wxWindow *parent, AudioController *controller, agi::Context *context);
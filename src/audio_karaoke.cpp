@@ -37,6 +37,7 @@
 #include "utils.h"
 
 #include <libaegisub/make_unique.h>
+#include <libaegisub/trace.h>
 
 #include <algorithm>
 #include <boost/locale/boundary.hpp>
@@ -49,6 +50,11 @@
 #include <wx/settings.h>
 #include <wx/sizer.h>
 
+namespace {
+/// Number of lines whose layouts are kept
+const size_t max_cached_layouts = 16;
+}
+
 template<class Container, class Value>
 static inline size_t last_lt_or_eq(Container const& c, Value const& v) {
 	auto it = lower_bound(c.begin(), c.end(), v);
@@ -114,6 +120,7 @@ void AudioKaraoke::OnActiveLineChanged(AssDialogue *new_line) {
 }
 
 void AudioKaraoke::OnFileChanged(int type, const AssDialogue *changed) {
+	AGI_TRACE_ZONE("commit", "AudioKaraoke");
 	if (enabled && (type & AssFile::COMMIT_DIAG_FULL) && (!changed || changed == active_line)) {
 		LoadFromLine();
 		split_area->Refresh(false);
@@ -203,8 +210,9 @@ void AudioKaraoke::RenderText() {
 	if (line_width > bmp_size.GetWidth())
 		bmp_size.SetWidth(line_width);
 
-	if (!rendered_line.IsOk() || bmp_size != rendered_line.GetSize())
-		rendered_line = wxBitmap(bmp_size);
+	// Always drawn into a new bitmap, as the old one may be shared with a
+	// cached layout
+	rendered_line = wxBitmap(bmp_size);
 
 	wxMemoryDC dc(rendered_line);
 
@@ -225,6 +233,11 @@ void AudioKaraoke::RenderText() {
 	dc.SetPen(wxSystemSettings::GetColour(wxSYS_COLOUR_HIGHLIGHT));
 	for (auto syl_line : syl_lines)
 		dc.DrawLine(syl_line, 0, syl_line, bmp_size.GetHeight());
+
+	if (!layouts.empty()) {
+		layouts.front().rendered_line = rendered_line;
+		layouts.front().rendered_char_height = char_height;
+	}
 }
 
 void AudioKaraoke::AddMenuItem(wxMenu &menu, std::string const& tag, wxString const& help, std::string const& selected) {
@@ -352,9 +365,41 @@ void AudioKaraoke::LoadFromLine() {
 	cancel_button->Enable(false);
 }
 
+bool AudioKaraoke::ApplyLayout(Layout const& layout) {
+	spaced_text = layout.spaced_text;
+	syl_start_points = layout.syl_start_points;
+	syl_lines = layout.syl_lines;
+	char_x = layout.char_x;
+	char_to_byte = layout.char_to_byte;
+	char_width = layout.char_width;
+
+	wxSize bmp_size = split_area->GetClientSize();
+	bmp_size.SetWidth(std::max<int>(bmp_size.GetWidth(), spaced_text.size() * char_width + 5));
+	if (!layout.rendered_line.IsOk() || layout.rendered_line.GetSize() != bmp_size || layout.rendered_char_height != char_height)
+		return false;
+	rendered_line = layout.rendered_line;
+	return true;
+}
+
 void AudioKaraoke::SetDisplayText() {
 	using namespace boost::locale::boundary;
 
+	std::string key;
+	for (auto const& syl : *kara) {
+		key += syl.text;
+		key += '\0';
+	}
+
+	auto cached = find_if(begin(layouts), end(layouts), [&](Layout const& l) { return l.key == key; });
+	if (cached != end(layouts)) {
+		Layout layout = std::move(*cached);
+		layouts.erase(cached);
+		layouts.push_front(std::move(layout));
+		if (!ApplyLayout(layouts.front()))
+			RenderText();
+		return;
+	}
+
 	wxMemoryDC dc;
 	dc.SetFont(split_font);
 
@@ -418,6 +463,11 @@ void AudioKaraoke::SetDisplayText() {
 	for (size_t i = 1; i < syl_start_points.size(); ++i)
 		syl_lines[i - 1] = syl_start_points[i] * char_width + char_width / 2;
 
+	layouts.push_front(Layout{std::move(key), spaced_text, syl_start_points,
+		syl_lines, char_x, char_to_byte, char_width, wxBitmap(), 0});
+	if (layouts.size() > max_cached_layouts)
+		layouts.pop_back();
+
 	RenderText();
 }
 
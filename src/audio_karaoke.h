@@ -94,6 +94,25 @@ class AudioKaraoke final : public wxWindow {
 	/// Cached width of characters from GetTextExtent
 	std::unordered_map<std::string, int> char_widths;
 
+	/// Measured positions of a line's characters and syllable splits, and
+	/// the last rendering of them
+	struct Layout {
+		std::string key; ///< Text of each syllable, nul-separated
+		std::vector<wxString> spaced_text;
+		std::vector<int> syl_start_points;
+		std::vector<int> syl_lines;
+		std::vector<int> char_x;
+		std::vector<size_t> char_to_byte;
+		int char_width;
+		wxBitmap rendered_line;
+		int rendered_char_height; ///< char_height when rendered_line was drawn
+	};
+
+	/// Layouts of the most recently displayed lines, most recent first, so
+	/// that stepping back and forth between lines doesn't have to split and
+	/// measure each one again
+	std::deque<Layout> layouts;
+
 	int scroll_x = 0; ///< Distance the display has been shifted to the left in pixels
 	int scroll_dir = 0; ///< Direction the display will be scrolled on scroll_timer ticks (+/- 1)
 	wxTimer scroll_timer; ///< Timer to scroll every 50ms when user holds down scroll button
@@ -116,6 +135,9 @@ class AudioKaraoke final : public wxWindow {
 	void LoadFromLine();
 	/// Cache presentational data from the loaded syllable data
 	void SetDisplayText();
+	/// Make a cached layout the current one
+	/// @return Could the layout's rendering be reused?
+	bool ApplyLayout(Layout const& layout);
 
 	/// Helper function for context menu creation
 	void AddMenuItem(wxMenu &menu, std::string const& tag, wxString const& help, std::string const& selected);
@@ -21,12 +21,14 @@
 
 #include "audio_marker.h"
 
+#include "audio_controller.h"
 #include "include/aegisub/context.h"
 #include "options.h"
 #include "pen.h"
 #include "project.h"
 #include "video_controller.h"
 
+#include <libaegisub/audio/speech_detector.h>
 #include <libaegisub/make_unique.h>
 
 #include <algorithm>
@@ -156,3 +158,35 @@ void SecondsMarkerProvider::GetMarkers(TimeRange const& range, AudioMarkerVector
 wxPen SecondsMarkerProvider::Marker::GetStyle() const {
 	return *style;
 }
+
+SpeechMarkerProvider::SpeechMarkerProvider(agi::Context *c, const char *opt_name)
+: controller(c->audioController.get())
+, pen(agi::make_unique<Pen>("Colour/Audio Display/Speech Boundary", 1, wxPENSTYLE_SHORT_DASH))
+, enabled(OPT_GET(opt_name))
+, enabled_opt_changed(OPT_SUB(opt_name, [=] { AnnounceMarkerMoved(); }))
+{
+}
+
+SpeechMarkerProvider::~SpeechMarkerProvider() { }
+
+void SpeechMarkerProvider::GetMarkers(TimeRange const& range, AudioMarkerVector &out) const {
+	if (!enabled->GetBool()) return;
+
+	std::vector<agi::SpeechSegment> segments;
+	controller->GetSpeechSegments(range, segments);
+
+	markers.clear();
+	for (auto const& segment : segments) {
+		if (range.contains(segment.start))
+			markers.emplace_back(pen.get(), segment.start, AudioMarker::Feet_Right);
+		if (range.contains(segment.end))
+			markers.emplace_back(pen.get(), segment.end, AudioMarker::Feet_Left);
+	}
+
+	for (auto const& marker : markers)
+		out.push_back(&marker);
+}
+
+wxPen SpeechMarkerProvider::Marker::GetStyle() const {
+	return *style;
+}
@@ -24,6 +24,7 @@
 #include <vector>
 #include <wx/string.h>
 
+class AudioController;
 class AudioMarkerKeyframe;
 class Pen;
 class Project;
@@ -188,3 +189,43 @@ public:
 	SecondsMarkerProvider();
 	void GetMarkers(TimeRange const& range, AudioMarkerVector &out) const override;
 };
+
+/// Marker provider for the starts and ends of the speech detected in the audio
+class SpeechMarkerProvider final : public AudioMarkerProvider {
+	struct Marker final : public AudioMarker {
+		Pen *style;
+		int position;
+		FeetStyle feet;
+
+		Marker(Pen *style, int position, FeetStyle feet) : style(style), position(position), feet(feet) { }
+		int GetPosition() const override { return position; }
+		FeetStyle GetFeet() const override { return feet; }
+		wxPen GetStyle() const override;
+		operator int() const { return position; }
+	};
+
+	AudioController *controller;
+
+	/// Pen used by all speech markers, here for performance
+	std::unique_ptr<Pen> pen;
+
+	/// Markers returned from last call to GetMarkers
+	mutable std::vector<Marker> markers;
+
+	/// Option which decides whether or not this provider is enabled
+	const agi::OptionValue *enabled;
+
+	agi::signal::Connection enabled_opt_changed;
+
+public:
+	/// @param c Project context; must have the audio controller initialized
+	/// @param opt_name Name of the option to use to decide whether or not this provider is enabled
+	SpeechMarkerProvider(agi::Context *c, const char *opt_name);
+	~SpeechMarkerProvider();
+
+	/// Get markers for the speech boundaries within a range
+	///
+	/// Speech is only found in audio which has been decoded, so this gets more
+	/// markers as decoding progresses.
+	void GetMarkers(TimeRange const& range, AudioMarkerVector &out) const override;
+};
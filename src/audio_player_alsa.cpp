@@ -40,6 +40,7 @@
 #include "frame_main.h"
 #include "options.h"
 
+#include <libaegisub/audio/playback_buffer.h>
 #include <libaegisub/audio/provider.h>
 #include <libaegisub/log.h>
 #include <libaegisub/make_unique.h>
@@ -76,7 +77,6 @@ class AlsaPlayer final : public AudioPlayer {
 	Message message = Message::None;
 
 	std::atomic<bool> playing{false};
-	std::atomic<double> volume{1.0};
 	int64_t start_position = 0;
 	std::atomic<int64_t> end_position{0};
 	bool fallback_mono16 = false;	// whether to convert to 16 bit mono. FIXME: more flexible conversion
@@ -87,10 +87,15 @@ class AlsaPlayer final : public AudioPlayer {
 
 	std::vector<char> decode_buffer;
 
+	/// Audio read ahead of the device
+	std::unique_ptr<agi::AudioPlaybackBuffer> buffer;
+
 	std::thread thread;
 
 	snd_pcm_format_t GetPCMFormat(const agi::AudioProvider *provider);
 
+	std::unique_ptr<agi::AudioPlaybackBuffer> CreateBuffer();
+
 	void PlaybackThread();
 
 	void UpdatePlaybackPosition(snd_pcm_t *pcm, int64_t position)
@@ -112,7 +117,7 @@ public:
 	void Stop() override;
 	bool IsPlaying() override { return playing; }
 
-	void SetVolume(double vol) override { volume = vol; }
+	void SetVolume(double vol) override { buffer->SetVolume(vol); }
 	int64_t GetEndPosition() override { return end_position; }
 	int64_t GetCurrentPosition() override;
 	void SetEndPosition(int64_t pos) override;
@@ -148,6 +153,13 @@ snd_pcm_format_t AlsaPlayer::GetPCMFormat(const agi::AudioProvider *provider) {
 	}
 }
 
+std::unique_ptr<agi::AudioPlaybackBuffer> AlsaPlayer::CreateBuffer()
+{
+	GetPCMFormat(provider);
+	return agi::make_unique<agi::AudioPlaybackBuffer>(provider, fallback_mono16,
+		OPT_GET("Player/Audio/Buffer Latency")->GetInt());
+}
+
 void AlsaPlayer::PlaybackThread()
 {
 	std::unique_lock<std::mutex> lock(mutex);
@@ -190,16 +202,14 @@ do_setup:
 
 		LOG_D("audio/player/alsa") << "starting playback";
 		int64_t position = start_position;
+		buffer->Start(start_position, end_position);
+		BOOST_SCOPE_EXIT_ALL(&) { buffer->Stop(); };
 
 		// Initial buffer-fill
 		{
 			auto avail = std::min(snd_pcm_avail(pcm), (snd_pcm_sframes_t)(end_position-position));
 			decode_buffer.resize(avail * framesize);
-			if (fallback_mono16) {
-				provider->GetInt16MonoAudioWithVolume(reinterpret_cast<int16_t*>(decode_buffer.data()), position, avail, volume);
-			} else {
-				provider->GetAudioWithVolume(decode_buffer.data(), position, avail, volume);
-			}
+			buffer->Read(decode_buffer.data(), avail);
 
 			snd_pcm_sframes_t written = 0;
 			while (written <= 0)
@@ -259,11 +269,7 @@ do_setup:
 
 			{
 				decode_buffer.resize(avail * framesize);
-				if (fallback_mono16) {
-					provider->GetInt16MonoAudioWithVolume(reinterpret_cast<int16_t*>(decode_buffer.data()), position, avail, volume);
-				} else {
-					provider->GetAudioWithVolume(decode_buffer.data(), position, avail, volume);
-				}
+				buffer->Read(decode_buffer.data(), avail);
 				snd_pcm_sframes_t written = 0;
 				while (written <= 0)
 				{
@@ -319,6 +325,7 @@ do_setup:
 
 AlsaPlayer::AlsaPlayer(agi::AudioProvider *provider) try
 : AudioPlayer(provider)
+, buffer(CreateBuffer())
 , thread(&AlsaPlayer::PlaybackThread, this)
 {
 }
@@ -357,6 +364,7 @@ void AlsaPlayer::SetEndPosition(int64_t pos)
 {
 	std::unique_lock<std::mutex> lock(mutex);
 	end_position = pos;
+	buffer->SetEnd(pos);
 }
 
 int64_t AlsaPlayer::GetCurrentPosition()
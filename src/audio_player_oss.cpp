@@ -38,6 +38,7 @@
 #include "options.h"
 #include "utils.h"
 
+#include <libaegisub/audio/playback_buffer.h>
 #include <libaegisub/audio/provider.h>
 #include <libaegisub/log.h>
 #include <libaegisub/make_unique.h>
@@ -68,21 +69,18 @@ class OSSPlayer final : public AudioPlayer {
     /// Is the player currently playing?
     volatile bool playing = false;
 
-    /// Current volume level
-    volatile float volume = 1.f;
-
     /// first frame of playback
     volatile unsigned long start_frame = 0;
 
     /// last written frame + 1
     volatile unsigned long cur_frame = 0;
 
-    /// last frame to play
-    volatile unsigned long end_frame = 0;
-
     /// bytes per frame
     unsigned long bpf = 0;
 
+    /// Audio read ahead of the device
+    std::unique_ptr<agi::AudioPlaybackBuffer> buffer;
+
     /// OSS audio device handle
     volatile int dspdev = 0;
 
@@ -104,12 +102,12 @@ public:
     void Stop();
     bool IsPlaying() { return playing; }
 
-    int64_t GetEndPosition() { return end_frame; }
+    int64_t GetEndPosition() { return buffer->GetEnd(); }
     void SetEndPosition(int64_t pos);
 
     int64_t GetCurrentPosition();
 
-    void SetVolume(double vol) { volume = vol; }
+    void SetVolume(double vol) { buffer->SetVolume(vol); }
 };
 
 /// Worker thread to asynchronously write audio data to the output device
@@ -127,17 +125,21 @@ public:
         // Use small enough writes for good timing accuracy with all
         // timing methods.
         const unsigned long wsize = parent->rate / 25;
-        void *buf = malloc(wsize * parent->bpf);
-
-        while (!TestDestroy() && parent->cur_frame < parent->end_frame) {
-            int rsize = std::min(wsize, parent->end_frame - parent->cur_frame);
-            parent->provider->GetInt16MonoAudioWithVolume(reinterpret_cast<int16_t*>(buf), parent->cur_frame,
-                                                 rsize, parent->volume);
-            int written = ::write(parent->dspdev, buf, rsize * parent->bpf);
-            parent->cur_frame += written / parent->bpf;
+        std::vector<char> buf(wsize * parent->bpf);
+        auto& buffer = *parent->buffer;
+
+        while (!TestDestroy() && !buffer.AtEnd()) {
+            const int64_t rsize = std::min<int64_t>(wsize, buffer.GetEnd() - buffer.GetPosition());
+            buffer.Read(buf.data(), rsize);
+
+            for (int64_t offset = 0; offset < rsize * (int64_t)parent->bpf && !TestDestroy(); ) {
+                int written = ::write(parent->dspdev, &buf[offset], rsize * parent->bpf - offset);
+                if (written <= 0) break;
+                offset += written;
+                parent->cur_frame += written / parent->bpf;
+            }
         }
-        free(buf);
-        parent->cur_frame = parent->end_frame;
+        parent->cur_frame = buffer.GetEnd();
 
         LOG_D("player/audio/oss") << "Thread dead";
         return 0;
@@ -189,6 +191,9 @@ void OSSPlayer::OpenStream()
     if (ioctl(dspdev, SNDCTL_DSP_SPEED, &rate) < 0) {
         throw AudioPlayerOpenError("OSS player: setting samplerate failed");
     }
+
+    buffer = agi::make_unique<agi::AudioPlaybackBuffer>(provider, true,
+        OPT_GET("Player/Audio/Buffer Latency")->GetInt());
 }
 
 void OSSPlayer::Play(int64_t start, int64_t count)
@@ -196,7 +201,7 @@ void OSSPlayer::Play(int64_t start, int64_t count)
     Stop();
 
     start_frame = cur_frame = start;
-    end_frame = start + count;
+    buffer->Start(start, start + count);
 
     thread = agi::make_unique<OSSPlayerThread>(this);
     thread->Create();
@@ -217,6 +222,7 @@ void OSSPlayer::Stop()
         thread->Wait();
         thread.reset();
     }
+    buffer->Stop();
 
     // errors can be ignored here
     ioctl(dspdev, SNDCTL_DSP_RESET, nullptr);
@@ -225,12 +231,12 @@ void OSSPlayer::Stop()
     playing = false;
     start_frame = 0;
     cur_frame = 0;
-    end_frame = 0;
+    buffer->SetEnd(0);
 }
 
 void OSSPlayer::SetEndPosition(int64_t pos)
 {
-    end_frame = pos;
+    buffer->SetEnd(pos);
 
     if (pos <= GetCurrentPosition()) {
         ioctl(dspdev, SNDCTL_DSP_RESET, nullptr);
@@ -267,7 +273,7 @@ int64_t OSSPlayer::GetCurrentPosition()
 
         LOG_D("player/audio/oss") << "cur_frame: " << cur_frame << " delay " << delay;
         // delay can jitter a bit at the end, detect that
-        if (cur_frame == end_frame && delay < rate / 20) {
+        if ((int64_t)cur_frame == buffer->GetEnd() && delay < rate / 20) {
             return cur_frame;
         }
         return MAX(0, (long) cur_frame - delay);
@@ -36,8 +36,10 @@
 #include "include/aegisub/audio_player.h"
 
 #include "audio_controller.h"
+#include "options.h"
 #include "utils.h"
 
+#include <libaegisub/audio/playback_buffer.h>
 #include <libaegisub/audio/provider.h>
 #include <libaegisub/log.h>
 #include <libaegisub/make_unique.h>
@@ -52,12 +54,13 @@ class PulseAudioPlayer final : public AudioPlayer {
 	bool is_playing = false;
 
 	volatile unsigned long start_frame = 0;
-	volatile unsigned long cur_frame = 0;
-	volatile unsigned long end_frame = 0;
 
 	unsigned long bpf = 0; // bytes per frame
 	bool fallback_mono16 = false;	// whether to convert to 16 bit mono. FIXME: more flexible conversion
 
+	/// Audio read ahead of the stream's write requests
+	std::unique_ptr<agi::AudioPlaybackBuffer> buffer;
+
 	wxSemaphore context_notify{0, 1};
 	wxSemaphore stream_notify{0, 1};
 	wxSemaphore stream_success{0, 1};
@@ -94,7 +97,7 @@ public:
 	void Stop();
 	bool IsPlaying() { return is_playing; }
 
-	int64_t GetEndPosition() { return end_frame; }
+	int64_t GetEndPosition() { return buffer->GetEnd(); }
 	int64_t GetCurrentPosition();
 	void SetEndPosition(int64_t pos);
 
@@ -172,6 +175,9 @@ PulseAudioPlayer::PulseAudioPlayer(agi::AudioProvider *provider) : AudioPlayer(p
 	pa_channel_map_init_auto(&map, ss.channels, PA_CHANNEL_MAP_DEFAULT);
 	pa_cvolume_init(&volume);
 
+	buffer = agi::make_unique<agi::AudioPlaybackBuffer>(provider, fallback_mono16,
+		OPT_GET("Player/Audio/Buffer Latency")->GetInt());
+
 	stream = pa_stream_new(context, "Sound", &ss, &map);
 	if (!stream) {
 		// argh!
@@ -233,8 +239,7 @@ void PulseAudioPlayer::Play(int64_t start,int64_t count)
 	}
 
 	start_frame = start;
-	cur_frame = start;
-	end_frame = start + count;
+	buffer->Start(start, start + count);
 
 	is_playing = true;
 
@@ -265,8 +270,6 @@ void PulseAudioPlayer::Stop()
 	is_playing = false;
 
 	start_frame = 0;
-	cur_frame = 0;
-	end_frame = 0;
 
 	// Flush the stream of data
 	pa_threaded_mainloop_lock(mainloop);
@@ -278,11 +281,14 @@ void PulseAudioPlayer::Stop()
 		paerror = pa_context_errno(context);
 		LOG_E("audio/player/pulse") << "Error flushing stream: " << pa_strerror(paerror) << "(" << paerror << ")";
 	}
+
+	buffer->Stop();
+	buffer->SetEnd(0);
 }
 
 void PulseAudioPlayer::SetEndPosition(int64_t pos)
 {
-	end_frame = pos;
+	buffer->SetEnd(pos);
 }
 
 int64_t PulseAudioPlayer::GetCurrentPosition()
@@ -324,33 +330,21 @@ void PulseAudioPlayer::pa_stream_write(pa_stream *p, size_t length, PulseAudioPl
 {
 	if (!thread->is_playing) return;
 
-	if (thread->cur_frame >= thread->end_frame + thread->provider->GetSampleRate()) {
+	auto& buffer = *thread->buffer;
+	if (buffer.GetPosition() >= buffer.GetEnd() + thread->provider->GetSampleRate()) {
 		// More than a second past end of stream
 		thread->is_playing = false;
 		pa_operation *op = pa_stream_drain(p, nullptr, nullptr);
 		pa_operation_unref(op);
 		return;
-
-	} else if (thread->cur_frame >= thread->end_frame) {
-		// Past end of stream, but not a full second, add some silence
-		void *buf = calloc(length, 1);
-		::pa_stream_write(p, buf, length, free, 0, PA_SEEK_RELATIVE);
-		thread->cur_frame += length / thread->bpf;
-		return;
 	}
 
+	// Past the end of the stream the buffer pads the data with silence
 	unsigned long bpf = thread->bpf;
-	unsigned long frames = length / thread->bpf;
-	unsigned long maxframes = thread->end_frame - thread->cur_frame;
-	if (frames > maxframes) frames = maxframes;
+	unsigned long frames = length / bpf;
 	void *buf = malloc(frames * bpf);
-	if (thread->fallback_mono16) {
-		thread->provider->GetInt16MonoAudio(reinterpret_cast<int16_t *>(buf), thread->cur_frame, frames);
-	} else {
-		thread->provider->GetAudio(buf, thread->cur_frame, frames);
-	}
+	buffer.Read(buf, frames);
 	::pa_stream_write(p, buf, frames*bpf, free, 0, PA_SEEK_RELATIVE);
-	thread->cur_frame += frames;
 }
 
 /// @brief Called by PA to notify about other stuff
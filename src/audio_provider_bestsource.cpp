@@ -41,12 +41,14 @@ class BSAudioProvider final : public agi::AudioProvider {
 	std::map<std::string, std::string> bsopts;
 	std::unique_ptr<BestAudioSource> bs;
 	BSAudioProperties properties;
+	int track;
 
 	void FillBuffer(void *Buf, int64_t Start, int64_t Count) const override;
 public:
 	BSAudioProvider(agi::fs::path const& filename, agi::BackgroundRunner *br);
 
 	bool NeedsCache() const override { return OPT_GET("Provider/Audio/BestSource/Aegisub Cache")->GetBool(); }
+	std::string GetCacheIdentity() const override { return "BestSource:" + std::to_string(track); }
 };
 
 /// @brief Constructor
@@ -55,19 +57,20 @@ BSAudioProvider::BSAudioProvider(agi::fs::path const& filename, agi::BackgroundR
 : bsopts()
 {
 	provider_bs::CleanBSCache();
-	auto track = provider_bs::SelectTrack(filename, true).first;
+	auto selection = provider_bs::SelectTrack(filename, true).first;
 
-	if (track == provider_bs::TrackSelection::NoTracks)
+	if (selection == provider_bs::TrackSelection::NoTracks)
 		throw agi::AudioDataNotFound("no audio tracks found");
-	else if (track == provider_bs::TrackSelection::None)
+	else if (selection == provider_bs::TrackSelection::None)
 		throw agi::UserCancelException("audio loading cancelled by user");
+	track = static_cast<int>(selection);
 
 	bool cancelled = false;
 	br->Run([&](agi::ProgressSink *ps) {
 		ps->SetTitle(from_wx(_("Indexing")));
 		ps->SetMessage(from_wx(_("Indexing file... This will take a while!")));
 		try {
-			bs = agi::make_unique<BestAudioSource>(filename.string(), static_cast<int>(track), -1, false, 0, 1, provider_bs::GetCacheFile(filename), &bsopts, 0, [=](int Track, int64_t Current, int64_t Total) {
+			bs = agi::make_unique<BestAudioSource>(filename.string(), track, -1, false, 0, 1, provider_bs::GetCacheFile(filename), &bsopts, 0, [=](int Track, int64_t Current, int64_t Total) {
 				ps->SetProgress(Current, Total);
 				return !ps->IsCancelled();
 			});
@@ -28,6 +28,7 @@
 #include <libaegisub/path.h>
 
 #include <boost/range/iterator_range.hpp>
+#include <xxhash.h>
 
 using namespace agi;
 
@@ -139,6 +140,35 @@ std::unique_ptr<agi::AudioProvider> SelectAudioProvider(fs::path const& filename
 	return provider;
 }
 
+namespace {
+/// Get the name of the persistent cache file for the given audio track and
+/// clean up the least recently used old ones
+fs::path PersistentCacheFilename(fs::path const& filename, std::string const& identity, Path const& path_helper) {
+	auto name = filename.string();
+	auto size = fs::Size(filename);
+	auto mtime = fs::ModifiedTime(filename);
+
+	XXH3_state_t *state = XXH3_createState();
+	XXH3_64bits_reset(state);
+	XXH3_64bits_update(state, name.data(), name.size());
+	XXH3_64bits_update(state, &size, sizeof(size));
+	XXH3_64bits_update(state, &mtime, sizeof(mtime));
+	XXH3_64bits_update(state, identity.data(), identity.size());
+	auto hash = XXH3_64bits_digest(state);
+	XXH3_freeState(state);
+
+	auto dir = path_helper.MakeAbsolute(path_helper.Decode(OPT_GET("Audio/Cache/Persistent/Location")->GetString()), "?local");
+	fs::CreateDirectory(dir);
+
+	auto result = dir / agi::format("%016llx.pcmcache", (unsigned long long)hash);
+	if (fs::FileExists(result))
+		fs::Touch(result);
+
+	CleanCache(dir, "*.pcmcache", OPT_GET("Audio/Cache/Persistent/Max Size")->GetInt());
+	return result;
+}
+}
+
 std::unique_ptr<agi::AudioProvider> GetAudioProvider(fs::path const& filename,
                                                      Path const& path_helper,
                                                      BackgroundRunner *br) {
@@ -155,6 +185,22 @@ std::unique_ptr<agi::AudioProvider> GetAudioProvider(fs::path const& filename,
 	if (!cache || !needs_cache)
 		return CreateLockAudioProvider(std::move(provider));
 
+	// Store int16 with at most two channels rather than the source's format
+	if (OPT_GET("Audio/Cache/Compact")->GetBool())
+		provider = CreateCompactAudioProvider(std::move(provider));
+
+	// Decode only what's actually read, so there's no up-front decode to
+	// persist between sessions
+	if (cache == 3)
+		return CreateOnDemandAudioProvider(std::move(provider), (size_t)OPT_GET("Audio/Cache/On Demand/Max Size")->GetInt() << 20);
+
+	// Reuse the decoded audio from a previous session if possible
+	if (OPT_GET("Audio/Cache/Persistent/Enable")->GetBool()) {
+		auto identity = provider->GetCacheIdentity();
+		if (!identity.empty())
+			return CreatePersistentAudioProvider(std::move(provider), PersistentCacheFilename(filename, identity, path_helper));
+	}
+
 	// Convert to RAM
 	if (cache == 1) return CreateRAMAudioProvider(std::move(provider));
 
@@ -52,6 +52,8 @@ class FFmpegSourceAudioProvider final : public agi::AudioProvider, FFmpegSourceP
 	mutable char FFMSErrMsg[1024];			///< FFMS error message
 	mutable FFMS_ErrorInfo ErrInfo;			///< FFMS error codes/messages
 
+	std::string CacheIdentity;				///< Track and options the audio was decoded with
+
 	void LoadAudio(agi::fs::path const& filename);
 	void FillBuffer(void *Buf, int64_t Start, int64_t Count) const override {
 		if (FFMS_GetAudio(AudioSource, Buf, Start, Count, &ErrInfo))
@@ -62,6 +64,7 @@ public:
 	FFmpegSourceAudioProvider(agi::fs::path const& filename, agi::BackgroundRunner *br);
 
 	bool NeedsCache() const override { return true; }
+	std::string GetCacheIdentity() const override { return CacheIdentity; }
 };
 
 /// @brief Constructor
@@ -169,7 +172,10 @@ void FFmpegSourceAudioProvider::LoadAudio(agi::fs::path const& filename) {
 			throw agi::AudioProviderError("unknown or unsupported sample format");
 	}
 
-	if (OPT_GET("Provider/Audio/FFmpegSource/Downmix")->GetBool()) {
+	bool Downmix = OPT_GET("Provider/Audio/FFmpegSource/Downmix")->GetBool();
+	CacheIdentity = "FFmpegSource:" + std::to_string(TrackNumber) + ":" + std::to_string(ErrorHandling) + ":" + std::to_string(Downmix);
+
+	if (Downmix) {
 		if (channels > 2 || bytes_per_sample != 2 || float_samples) {
 			std::unique_ptr<FFMS_ResampleOptions, decltype(&FFMS_DestroyResampleOptions)>
 				opt(FFMS_CreateResampleOptions(AudioSource), FFMS_DestroyResampleOptions);
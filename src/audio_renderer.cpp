@@ -34,9 +34,12 @@
 #include "audio_renderer.h"
 
 #include <libaegisub/audio/provider.h>
+#include <libaegisub/dispatch.h>
 #include <libaegisub/make_unique.h>
+#include <libaegisub/trace.h>
 
 #include <algorithm>
+#include <chrono>
 #include <wx/dc.h>
 
 namespace {
@@ -66,25 +69,62 @@ size_t AudioRendererBitmapCacheBitmapFactory::GetBlockSize() const
 }
 
 AudioRenderer::AudioRenderer()
+: self(std::make_shared<AudioRenderer *>(this))
 {
-	bitmaps.reserve(AudioStyle_MAX);
-	for (int i = 0; i < AudioStyle_MAX; ++i)
-		bitmaps.emplace_back(256, AudioRendererBitmapCacheBitmapFactory(this));
+	bitmaps = CreateBitmapCaches();
 
 	// Make sure there's *some* values for those fields, and in the caches
 	SetMillisecondsPerPixel(1);
 	SetHeight(1);
 }
 
+std::vector<AudioRendererBitmapCache> AudioRenderer::CreateBitmapCaches()
+{
+	std::vector<AudioRendererBitmapCache> caches;
+	caches.reserve(AudioStyle_MAX);
+	for (int i = 0; i < AudioStyle_MAX; ++i)
+		caches.emplace_back(256, AudioRendererBitmapCacheBitmapFactory(this));
+	return caches;
+}
+
 void AudioRenderer::SetMillisecondsPerPixel(const double new_pixel_ms)
 {
-	if (compare_and_set(pixel_ms, new_pixel_ms))
+	if (pixel_ms == new_pixel_ms) return;
+
+	auto retained = find_if(begin(retained_zooms), end(retained_zooms),
+		[&](RetainedZoom const& zoom) { return zoom.pixel_ms == new_pixel_ms; });
+	std::vector<AudioRendererBitmapCache> restored;
+	if (retained != end(retained_zooms))
 	{
-		if (renderer)
-			renderer->SetMillisecondsPerPixel(pixel_ms);
+		restored = std::move(retained->bitmaps);
+		retained_zooms.erase(retained);
+	}
 
+	// Keep the current level's bitmaps with a share of the budget
+	if (provider && GetBitmapCacheStats().bytes > 0)
+	{
+		for (auto& bmp : bitmaps) bmp.Age(cache_bitmap_maxsize / 2 / max_retained_zooms);
+		retained_zooms.insert(begin(retained_zooms), RetainedZoom{pixel_ms, std::move(bitmaps)});
+		if (retained_zooms.size() > max_retained_zooms)
+			retained_zooms.pop_back();
+	}
+
+	pixel_ms = new_pixel_ms;
+	if (renderer)
+		renderer->SetMillisecondsPerPixel(pixel_ms);
+
+	if (restored.empty())
+	{
+		bitmaps = CreateBitmapCaches();
 		ResetBlockCount();
 	}
+	else
+	{
+		// Already sized for this zoom level
+		bitmaps = std::move(restored);
+		pending.clear();
+		UpdateMemoryUsage();
+	}
 }
 
 void AudioRenderer::SetHeight(const int _pixel_height)
@@ -141,6 +181,9 @@ void AudioRenderer::SetCacheMaxSize(const size_t max_size)
 	cache_bitmap_maxsize = std::min<size_t>(max_size/8, 0x1000000);
 	// The renderer gets whatever is left.
 	cache_renderer_maxsize = max_size - 4*cache_bitmap_maxsize;
+
+	bitmap_memory.SetLimit(cache_bitmap_maxsize * bitmaps.size() * 3 / 2);
+	renderer_memory.SetLimit(cache_renderer_maxsize);
 }
 
 void AudioRenderer::ResetBlockCount()
@@ -149,7 +192,9 @@ void AudioRenderer::ResetBlockCount()
 	{
 		const size_t total_blocks = NumBlocks(provider->GetNumSamples());
 		for (auto& bmp : bitmaps) bmp.SetBlockCount(total_blocks);
+		UpdateMemoryUsage();
 	}
+	pending.clear();
 }
 
 size_t AudioRenderer::NumBlocks(const int64_t samples) const
@@ -158,25 +203,138 @@ size_t AudioRenderer::NumBlocks(const int64_t samples) const
 	return static_cast<size_t>(duration / pixel_ms / cache_bitmap_width);
 }
 
-wxBitmap const& AudioRenderer::GetCachedBitmap(const int i, const AudioRenderingStyle style)
+bool AudioRenderer::RequestBitmap(const int i, const AudioRenderingStyle style)
 {
-	assert(provider);
-	assert(renderer);
+	if (bitmaps[style].IsCached(i))
+		return true;
+
+	// The cache providers decode out of order, so wait for each bitmap's
+	// audio to be available before rendering (and caching) it
+	const double pixel_samples = pixel_ms * provider->GetSampleRate() / 1000.0;
+	const auto first_sample = static_cast<int64_t>(i * cache_bitmap_width * pixel_samples);
+	const auto end_sample = static_cast<int64_t>((i + 1) * cache_bitmap_width * pixel_samples);
+	if (!provider->IsRangeDecoded(first_sample, end_sample - first_sample))
+		return false;
+
+	const auto block = std::make_pair(i, style);
+	if (find(begin(pending), end(pending), block) == end(pending))
+		pending.push_back(block);
+	return false;
+}
+
+void AudioRenderer::QueueRender()
+{
+	if (render_queued) return;
+	render_queued = true;
+
+	std::weak_ptr<AudioRenderer *> weak_self = self;
+	agi::dispatch::Main().Async([weak_self] {
+		if (auto self = weak_self.lock())
+			(*self)->RenderPending();
+	});
+}
+
+void AudioRenderer::RenderPending()
+{
+	AGI_TRACE_ZONE("audio", "RenderPending");
+	using namespace std::chrono;
 
-	bool created = false;
-	auto& bmp = bitmaps[style].Get(i, &created);
-	if (created)
+	render_queued = false;
+	if (!provider || !renderer)
 	{
-		renderer->Render(bmp, i*cache_bitmap_width, style);
+		pending.clear();
+		prefetch.clear();
+		return;
+	}
+
+	// Start a new view if anything was drawn since the last time slice
+	if (view_last >= view_first)
+	{
+		if (view_first != shown_first)
+			scroll_direction = view_first > shown_first ? 1 : -1;
+		shown_first = view_first;
+		shown_last = view_last;
+		view_first = 0;
+		view_last = -1;
+
+		const int num_blocks = static_cast<int>(NumBlocks(provider->GetNumSamples()));
+		keep_first = std::max(0, shown_first - prefetch_bitmaps);
+		keep_last = std::min(num_blocks - 1, shown_last + prefetch_bitmaps);
+
+		// Nothing is known about the styles outside of the view, so assume
+		// they're the same as most of the audio is
+		if (scroll_direction > 0)
+		{
+			for (int i = shown_last + 1; i <= keep_last; ++i)
+				RequestBitmap(i, AudioStyle_Normal);
+		}
+		else
+		{
+			for (int i = shown_first - 1; i >= keep_first; --i)
+				RequestBitmap(i, AudioStyle_Normal);
+		}
+
+		// Prefetching may have queued bitmaps before the view was drawn
+		std::stable_partition(begin(pending), end(pending), [&](std::pair<int, AudioRenderingStyle> const& block) {
+			return block.first >= shown_first && block.first <= shown_last;
+		});
+	}
+
+	// Render for a short time slice at a time so that input events are
+	// handled in between
+	const auto deadline = steady_clock::now() + milliseconds(10);
+	bool shown_rendered = false;
+	size_t done = 0;
+	while (done < pending.size() && steady_clock::now() < deadline)
+	{
+		const auto block = pending[done++];
+		if ((block.first < keep_first || block.first > keep_last) &&
+			(block.first < prefetch_first || block.first > prefetch_last))
+			continue;
+
+		bool created = false;
+		auto& bmp = bitmaps[block.second].Get(block.first, &created);
+		if (!created) continue;
+
+		renderer->Render(bmp, block.first * cache_bitmap_width, block.second);
+		assert(bmp.IsOk());
 		needs_age = true;
+		shown_rendered |= block.first >= shown_first && block.first <= shown_last;
 	}
+	pending.erase(begin(pending), begin(pending) + done);
 
-	assert(bmp.IsOk());
-	return bmp;
+	// Prefetched bitmaps are only started on once everything the view needs
+	// has been rendered
+	if (pending.empty() && !prefetch.empty())
+	{
+		for (auto const& block : prefetch)
+			RequestBitmap(block.first, block.second);
+		prefetch.clear();
+	}
+
+	if (needs_age)
+	{
+		// Give back half of the cache while everything together is over the
+		// memory budget
+		const size_t divisor = agi::memory::OverBudget() ? 2 : 1;
+		if (divisor > 1)
+			retained_zooms.clear();
+		for (auto& bmp : bitmaps) bmp.Age(cache_bitmap_maxsize / divisor);
+		renderer->AgeCache(cache_renderer_maxsize / divisor);
+		needs_age = false;
+		UpdateMemoryUsage();
+	}
+
+	if (!pending.empty())
+		QueueRender();
+
+	if (shown_rendered)
+		AnnounceBitmapsRendered();
 }
 
 void AudioRenderer::Render(wxDC &dc, wxPoint origin, const int start, const int length, const AudioRenderingStyle style)
 {
+	AGI_TRACE_ZONE("audio", "Render");
 	assert(start >= 0);
 
 	if (!provider) return;
@@ -192,7 +350,7 @@ void AudioRenderer::Render(wxDC &dc, wxPoint origin, const int start, const int
 	// And the offset in it to start its use at
 	const int firstbitmapoffset = start % cache_bitmap_width;
 	// The last bitmap required
-	const int lastbitmap = std::min<int>(end / cache_bitmap_width, NumBlocks(provider->GetDecodedSamples()) - 1);
+	const int lastbitmap = std::min<int>(end / cache_bitmap_width, NumBlocks(provider->GetNumSamples()) - 1);
 
 	// Set a clipping region so that the first and last bitmaps don't draw
 	// outside the requested range
@@ -201,26 +359,112 @@ void AudioRenderer::Render(wxDC &dc, wxPoint origin, const int start, const int
 
 	for (int i = firstbitmap; i <= lastbitmap; ++i)
 	{
-		dc.DrawBitmap(GetCachedBitmap(i, style), origin);
+		if (RequestBitmap(i, style))
+			dc.DrawBitmap(bitmaps[style].Get(i), origin);
+		else
+			renderer->RenderBlank(dc, wxRect(origin.x, origin.y, cache_bitmap_width, pixel_height), style);
 		origin.x += cache_bitmap_width;
 	}
 
+	if (firstbitmap <= lastbitmap)
+	{
+		if (view_last < view_first)
+		{
+			view_first = firstbitmap;
+			view_last = lastbitmap;
+		}
+		else
+		{
+			view_first = std::min(view_first, firstbitmap);
+			view_last = std::max(view_last, lastbitmap);
+		}
+	}
+
 	// Now render blank audio from origin to end
 	if (origin.x < lastx)
 		renderer->RenderBlank(dc, wxRect(origin.x-1, origin.y, lastx-origin.x+1, pixel_height), style);
 
-	if (needs_age)
+	// Prefetching happens even when everything visible was cached
+	if (firstbitmap <= lastbitmap)
+		QueueRender();
+}
+
+void AudioRenderer::Prefetch(std::vector<PrefetchRange> const& ranges)
+{
+	prefetch.clear();
+	prefetch_first = 0;
+	prefetch_last = -1;
+	if (!provider || !renderer) return;
+
+	const int num_blocks = static_cast<int>(NumBlocks(provider->GetNumSamples()));
+	for (auto const& range : ranges)
 	{
-		bitmaps[style].Age(cache_bitmap_maxsize);
-		renderer->AgeCache(cache_renderer_maxsize);
-		needs_age = false;
+		if (range.length <= 0) continue;
+		const int first = std::max(0, range.start / cache_bitmap_width);
+		const int last = std::min(num_blocks - 1, (range.start + range.length) / cache_bitmap_width);
+		if (first > last) continue;
+
+		if (prefetch_last < prefetch_first)
+		{
+			prefetch_first = first;
+			prefetch_last = last;
+		}
+		else
+		{
+			prefetch_first = std::min(prefetch_first, first);
+			prefetch_last = std::max(prefetch_last, last);
+		}
+
+		for (int i = first; i <= last; ++i)
+			prefetch.emplace_back(i, range.style);
+	}
+
+	if (!prefetch.empty())
+		QueueRender();
+}
+
+DataBlockCacheStats AudioRenderer::GetBitmapCacheStats() const
+{
+	DataBlockCacheStats stats;
+	for (auto const& bmp : bitmaps)
+		stats += bmp.GetStats();
+	for (auto const& zoom : retained_zooms)
+	{
+		for (auto const& bmp : zoom.bitmaps)
+			stats += bmp.GetStats();
 	}
+	return stats;
+}
+
+DataBlockCacheStats AudioRenderer::GetRendererCacheStats() const
+{
+	return renderer ? renderer->GetCacheStats() : DataBlockCacheStats();
 }
 
 void AudioRenderer::Invalidate()
 {
 	for (auto& bmp : bitmaps) bmp.Age(0);
+	retained_zooms.clear();
 	needs_age = false;
+	pending.clear();
+	UpdateMemoryUsage();
+}
+
+void AudioRenderer::Trim(agi::memory::Pressure pressure)
+{
+	const bool all = pressure == agi::memory::Pressure::Critical;
+	retained_zooms.clear();
+	for (auto& bmp : bitmaps)
+		bmp.Age(all ? 0 : bmp.GetStats().bytes / 2);
+	if (renderer)
+		renderer->AgeCache(all ? 0 : GetRendererCacheStats().bytes / 2);
+	UpdateMemoryUsage();
+}
+
+void AudioRenderer::UpdateMemoryUsage()
+{
+	bitmap_memory.Set(GetBitmapCacheStats().bytes);
+	renderer_memory.Set(GetRendererCacheStats().bytes);
 }
 
 void AudioRendererBitmapProvider::SetProvider(agi::AudioProvider *const _provider)
@@ -30,8 +30,12 @@
 #pragma once
 
 #include <memory>
+#include <utility>
 #include <vector>
 
+#include <libaegisub/memory_usage.h>
+#include <libaegisub/signal.h>
+
 #include <wx/gdicmn.h>
 
 #include "audio_rendering_style.h"
@@ -91,6 +95,17 @@ class AudioRenderer {
 
 	/// Cached bitmaps for audio ranges
 	std::vector<AudioRendererBitmapCache> bitmaps;
+
+	/// Bitmap caches for a zoom level other than the current one
+	struct RetainedZoom {
+		double pixel_ms;
+		std::vector<AudioRendererBitmapCache> bitmaps;
+	};
+	/// Caches for the most recently used other zoom levels, newest first, so
+	/// that switching back and forth between zoom levels doesn't re-render
+	std::vector<RetainedZoom> retained_zooms;
+	/// Number of other zoom levels to keep the bitmaps of
+	const size_t max_retained_zooms = 2;
 	/// The maximum allowed size of each bitmap cache, in bytes
 	size_t cache_bitmap_maxsize = 0;
 	/// The maximum allowed size of the renderer's cache, in bytes
@@ -104,14 +119,53 @@ class AudioRenderer {
 	/// Audio provider to use as source
 	agi::AudioProvider *provider = nullptr;
 
-	/// @brief Make sure bitmap index i is in cache
-	/// @param i     Index of bitmap to get into cache
-	/// @param style Rendering style required for bitmap
-	/// @return The requested bitmap
+	/// Bitmaps which were needed but not cached, in the order they should be
+	/// rendered in
+	std::vector<std::pair<int, AudioRenderingStyle>> pending;
+	/// First and last bitmap drawn since pending bitmaps were last rendered
+	int view_first = 0, view_last = -1;
+	/// Range of bitmaps pending bitmaps are still rendered for
+	int keep_first = 0, keep_last = -1;
+	/// Range of bitmaps a repaint is needed for when they are rendered
+	int shown_first = 0, shown_last = -1;
+	/// Direction the view last moved in, 1 for forwards or -1 for backwards
+	int scroll_direction = 1;
+	/// Has rendering the pending bitmaps been queued on the main thread?
+	bool render_queued = false;
+	/// Handle for queued rendering to check if the renderer still exists
+	std::shared_ptr<AudioRenderer *> self;
+
+	/// Number of bitmaps to prefetch past the drawn ones in the scroll direction
+	const int prefetch_bitmaps = 8;
+	/// Bitmaps asked for by Prefetch() which haven't been queued yet. They're
+	/// only queued once nothing else is pending.
+	std::vector<std::pair<int, AudioRenderingStyle>> prefetch;
+	/// Range of bitmaps asked for by Prefetch(), which pending bitmaps are
+	/// also still rendered for
+	int prefetch_first = 0, prefetch_last = -1;
+
+	/// Reported sizes of the bitmap caches and the renderer's cache
+	agi::memory::Counter bitmap_memory{"Audio display bitmaps"};
+	agi::memory::Counter renderer_memory{"Audio renderer cache"};
+	/// Gives back the bitmaps when memory is short, as they're the cheapest
+	/// thing to remake
+	agi::memory::Trimmer trimmer{10, [this](agi::memory::Pressure pressure) { Trim(pressure); }};
+
+	/// Announced when pending bitmaps visible in the last view have been rendered
+	agi::signal::Signal<> AnnounceBitmapsRendered;
+
+	/// @brief Queue bitmap i for rendering if it isn't cached
+	/// @return Is the bitmap ready to be drawn?
+	bool RequestBitmap(int i, AudioRenderingStyle style);
+
+	/// Queue rendering the pending bitmaps on the main thread
+	void QueueRender();
+
+	/// @brief Render pending bitmaps until the time slice runs out
 	///
-	/// Will attempt retrieving the requested bitmap from the cache, creating it
-	/// if the cache doesn't have it.
-	wxBitmap const& GetCachedBitmap(int i, AudioRenderingStyle style);
+	/// Runs from the main thread's event queue, so that painting only ever
+	/// draws what is already cached and input is handled between slices.
+	void RenderPending();
 
 	/// @brief Update the block count in the bitmap caches
 	///
@@ -120,9 +174,19 @@ class AudioRenderer {
 	/// has changed.
 	void ResetBlockCount();
 
+	/// Create an empty bitmap cache for each style
+	std::vector<AudioRendererBitmapCache> CreateBitmapCaches();
+
 	/// Calculate the number of cache blocks needed for a given number of samples
 	size_t NumBlocks(int64_t samples) const;
 
+	/// Report the current sizes of the caches to the memory counters
+	void UpdateMemoryUsage();
+
+	/// Drop half of the cached bitmaps and renderer data, or all of it under
+	/// critical pressure
+	void Trim(agi::memory::Pressure pressure);
+
 public:
 	/// @brief Constructor
 	///
@@ -133,7 +197,8 @@ public:
 	/// @brief Set horizontal zoom
 	/// @param pixel_ms Milliseconds per pixel to render audio at
 	///
-	/// Changing the zoom level invalidates all cached bitmaps.
+	/// The bitmaps for the previous zoom level are kept, so that switching
+	/// back to it soon after doesn't have to render them again.
 	void SetMillisecondsPerPixel(double pixel_ms);
 
 	/// @brief Set rendering height
@@ -202,8 +267,38 @@ public:
 	///
 	/// The first audio sample rendered is start*pixel_samples, and the number
 	/// of audio samples rendered is length*pixel_samples.
+	///
+	/// Bitmaps which are not cached are drawn as blank audio and rendered
+	/// later from the main thread's event queue, along with a few just past
+	/// the rendered range in the direction the view last moved. A
+	/// BitmapsRendered announcement is made when they are ready to be drawn.
 	void Render(wxDC &dc, wxPoint origin, int start, int length, AudioRenderingStyle style);
 
+	/// A range of pixels to render ahead of it being shown
+	struct PrefetchRange {
+		/// First pixel from beginning of the audio stream
+		int start;
+		/// Number of pixels
+		int length;
+		AudioRenderingStyle style;
+	};
+
+	/// @brief Render bitmaps which are about to be shown in the background
+	/// @param ranges Ranges to render, replacing any earlier prefetched ones
+	///
+	/// The bitmaps are rendered from the main thread's event queue in the
+	/// same time slices as the ones Render() couldn't draw, once those are
+	/// all done.
+	void Prefetch(std::vector<PrefetchRange> const& ranges);
+
+	DEFINE_SIGNAL_ADDERS(AnnounceBitmapsRendered, AddBitmapsRenderedListener)
+
+	/// @brief Get the combined usage counters of the bitmap caches
+	DataBlockCacheStats GetBitmapCacheStats() const;
+
+	/// @brief Get the usage counters of the current bitmap provider's caches
+	DataBlockCacheStats GetRendererCacheStats() const;
+
 	/// @brief Invalidate all cached data
 	///
 	/// Invalidates all cached bitmaps for another reason, usually as a signal that
@@ -287,4 +382,7 @@ public:
 	/// Deriving classes should override this method if they implement any
 	/// kind of caching.
 	virtual void AgeCache(size_t max_size) { }
+
+	/// @brief Get the usage counters of any caches the renderer might keep
+	virtual DataBlockCacheStats GetCacheStats() const { return {}; }
 };
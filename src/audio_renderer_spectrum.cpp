@@ -39,10 +39,16 @@
 #include "fft.h"
 #endif
 
+#include <libaegisub/audio/analysis_stream.h>
 #include <libaegisub/audio/provider.h>
+#include <libaegisub/dispatch.h>
 #include <libaegisub/make_unique.h>
 
 #include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
 
 #include <wx/image.h>
 #include <wx/dcmemory.h>
@@ -74,6 +80,71 @@ struct AudioSpectrumCacheBlockFactory {
 	}
 };
 
+/// Scratch space for deriving spectrum blocks on one thread
+struct AudioSpectrumWorker {
+	/// Raw audio data for a single block
+	std::vector<int16_t> audio;
+
+	/// Squared magnitude of each bin
+	std::vector<float> power;
+
+#ifdef WITH_FFTW3
+	/// Input array for FFTW
+	double *dft_input;
+	/// Output array for FFTW
+	fftw_complex *dft_output;
+
+	AudioSpectrumWorker(size_t derivation_size)
+	: audio(2 << derivation_size)
+	, power(1 << derivation_size)
+	, dft_input(fftw_alloc_real(2 << derivation_size))
+	, dft_output(fftw_alloc_complex(2 << derivation_size))
+	{
+	}
+
+	~AudioSpectrumWorker()
+	{
+		fftw_free(dft_input);
+		fftw_free(dft_output);
+	}
+#else
+	/// FFT with its twiddle tables for the derivation size
+	FFT fft;
+	/// Input samples for the FFT
+	std::vector<float> fft_input;
+	/// Real part of the output
+	std::vector<float> fft_real;
+	/// Imaginary part of the output
+	std::vector<float> fft_imag;
+
+	AudioSpectrumWorker(size_t derivation_size)
+	: audio(2 << derivation_size)
+	, power(1 << derivation_size)
+	, fft_input(2 << derivation_size)
+	, fft_real(1 << derivation_size)
+	, fft_imag(1 << derivation_size)
+	{
+	}
+#endif
+
+	AudioSpectrumWorker(AudioSpectrumWorker const&) = delete;
+	AudioSpectrumWorker& operator=(AudioSpectrumWorker const&) = delete;
+};
+
+namespace {
+/// The bins which one row of the rendered spectrum shows
+struct SpectrumRow {
+	/// First bin to read
+	int first;
+	/// Bin to interpolate towards, or one past the last bin to take the
+	/// maximum of
+	int last;
+	/// Interpolation position between first and last, or negative to take
+	/// the maximum of the range
+	float frac;
+};
+}
+
 /// @brief Cache for audio spectrum frequency-power data
 class AudioSpectrumCache
 : public DataBlockCache<float, 10, AudioSpectrumCacheBlockFactory> {
@@ -95,6 +166,7 @@ AudioSpectrumRenderer::~AudioSpectrumRenderer()
 {
 	// This sequence will clean up
 	provider = nullptr;
+	analysis.reset();
 	RecreateCache();
 }
 
@@ -106,40 +178,39 @@ void AudioSpectrumRenderer::RecreateCache()
 	if (dft_plan)
 	{
 		fftw_destroy_plan(dft_plan);
-		fftw_free(dft_input);
-		fftw_free(dft_output);
 		dft_plan = nullptr;
-		dft_input = nullptr;
-		dft_output = nullptr;
 	}
 #endif
+	workers.clear();
 
-	if (provider)
+	if (analysis)
 	{
-		size_t block_count = (size_t)((provider->GetNumSamples() + ((size_t)1<<derivation_dist) - 1) >> derivation_dist);
+		size_t block_count = (size_t)((analysis->GetNumSamples() + ((size_t)1<<derivation_dist) - 1) >> derivation_dist);
 		cache = agi::make_unique<AudioSpectrumCache>(block_count, this);
 
+		const size_t worker_count = std::max(1u, std::thread::hardware_concurrency());
+		for (size_t i = 0; i < worker_count; ++i)
+			workers.push_back(agi::make_unique<AudioSpectrumWorker>(derivation_size));
+
 #ifdef WITH_FFTW3
-		dft_input = fftw_alloc_real(2<<derivation_size);
-		dft_output = fftw_alloc_complex(2<<derivation_size);
+		// All of the workers' arrays come from fftw_alloc and so have the
+		// alignment the plan was made for
 		dft_plan = fftw_plan_dft_r2c_1d(
 			2<<derivation_size,
-			dft_input,
-			dft_output,
+			workers[0]->dft_input,
+			workers[0]->dft_output,
 			FFTW_MEASURE);
-#else
-		// Allocate scratch for 6x the derivation size:
-		// 2x for the input sample data
-		// 2x for the real part of the output
-		// 2x for the imaginary part of the output
-		fft_scratch.resize(6 << derivation_size);
 #endif
-		audio_scratch.resize(2 << derivation_size);
 	}
 }
 
 void AudioSpectrumRenderer::OnSetProvider()
 {
+	// Everything up to max_freq has to pass the stream's low-pass filter,
+	// which cuts off at 80% of its Nyquist frequency
+	analysis.reset();
+	if (provider)
+		analysis = agi::make_unique<agi::AudioAnalysisStream>(*provider, int(max_freq * 2.5f), false);
 	RecreateCache();
 }
 
@@ -168,14 +239,6 @@ void AudioSpectrumRenderer::set_reference_frequency_position (float pos_fref_)
 }
 
 
-template<class T>
-void AudioSpectrumRenderer::ConvertToFloat(size_t count, T *dest) {
-	for (size_t si = 0; si < count; ++si)
-	{
-		dest[si] = (T)(audio_scratch[si]) / 32768.0;
-	}
-}
-
 void AudioSpectrumRenderer::update_derivation_values ()
 {
 	// Below this sampling rate (Hz), the derivation values are identical to
@@ -189,9 +252,9 @@ void AudioSpectrumRenderer::update_derivation_values ()
 	derivation_dist = derivation_dist_user;
 	derivation_size = derivation_size_user;
 
-	if (provider != nullptr)
+	if (analysis)
 	{
-		const int sample_rate = provider->GetSampleRate ();
+		const int sample_rate = analysis->GetSampleRate ();
 		float mult = float (sample_rate) / sample_rate_ref;
 		while (mult > 1)
 		{
@@ -207,9 +270,18 @@ void AudioSpectrumRenderer::FillBlock(size_t block_index, float *block)
 	assert(cache);
 	assert(block);
 
+	auto& worker = *workers[0];
 	int64_t first_sample = (((int64_t)block_index) << derivation_dist) - ((int64_t)1 << derivation_size);
-	provider->GetInt16MonoAudio(audio_scratch.data(), first_sample, 2 << derivation_size);
-	
+	analysis->GetAudio(worker.audio.data(), first_sample, 2 << derivation_size);
+	DeriveBlock(worker, worker.audio.data(), block);
+}
+
+void AudioSpectrumRenderer::DeriveBlock(AudioSpectrumWorker &worker, const int16_t *audio, float *block) const
+{
+	const size_t n_samples = 2 << derivation_size;
+	const size_t n_bins = 1 << derivation_size;
+	float *power = worker.power.data();
+
 	// Because the FFTs used here are unnormalized DFTs, we have to compensate
 	// the possible length difference between derivation_size used in the
 	// calculations and its user-provided counterpart. Thus, the display is
@@ -217,40 +289,124 @@ void AudioSpectrumRenderer::FillBlock(size_t block_index, float *block)
 	const float scale_fix =
 		1.f / sqrtf (float (1 << (derivation_size - derivation_size_user)));
 
+	// The conversion and power loops below are kept free of anything but
+	// arithmetic on plain arrays so that the compiler can vectorize them
+
 #ifdef WITH_FFTW3
-	ConvertToFloat(2 << derivation_size, dft_input);
+	double *input = worker.dft_input;
+	for (size_t si = 0; si < n_samples; ++si)
+		input[si] = audio[si] / 32768.0;
 
-	fftw_execute(dft_plan);
+	fftw_execute_dft_r2c(dft_plan, worker.dft_input, worker.dft_output);
 
-	double scale_factor = scale_fix * 9 / sqrt(2 << (derivation_size + 1));
+	const float scale_factor = scale_fix * 9 / sqrt(2 << (derivation_size + 1));
 
-	fftw_complex *o = dft_output;
-	for (size_t si = (size_t)1<<derivation_size; si > 0; --si)
+	const fftw_complex *o = worker.dft_output;
+	for (size_t si = 0; si < n_bins; ++si)
+		power[si] = float(o[si][0] * o[si][0] + o[si][1] * o[si][1]);
+#else
+	float *input = worker.fft_input.data();
+	for (size_t si = 0; si < n_samples; ++si)
+		input[si] = audio[si] / 32768.f;
+
+	float *fft_real = worker.fft_real.data();
+	float *fft_imag = worker.fft_imag.data();
+	worker.fft.TransformReal(n_samples, input, fft_real, fft_imag);
+
+	const float scale_factor = scale_fix * 9 / sqrt(2 * (float)n_samples);
+
+	for (size_t si = 0; si < n_bins; ++si)
+		power[si] = fft_real[si] * fft_real[si] + fft_imag[si] * fft_imag[si];
+#endif
+
+	// With x in range [0;1], log10(x*9+1) will also be in range [0;1],
+	// although the FFT output can apparently get greater magnitudes than 1
+	// despite the input being limited to [-1;+1).
+	for (size_t si = 0; si < n_bins; ++si)
+		block[si] = log10f(sqrtf(power[si]) * scale_factor + 1.f);
+}
+
+void AudioSpectrumRenderer::PrepareBlocks(std::vector<size_t> const& needed)
+{
+	// Not worth handing off to other threads below this many blocks
+	const size_t min_blocks_per_job = 8;
+	// Bounds the memory used for the audio data of the blocks in flight
+	const size_t max_blocks_per_job = 64;
+
+	std::vector<size_t> missing;
+	for (size_t i : needed)
 	{
-		*block++ = log10( sqrt(o[0][0] * o[0][0] + o[0][1] * o[0][1]) * scale_factor + 1 );
-		o++;
+		if (!cache->IsCached(i))
+			missing.push_back(i);
 	}
-#else
-	ConvertToFloat(2 << derivation_size, &fft_scratch[0]);
 
-	float *fft_input = &fft_scratch[0];
-	float *fft_real = &fft_scratch[0] + (2 << derivation_size);
-	float *fft_imag = &fft_scratch[0] + (4 << derivation_size);
+	if (missing.size() / min_blocks_per_job < 2 || workers.size() < 2)
+		return;
 
-	FFT fft;
-	fft.Transform(2<<derivation_size, fft_input, fft_real, fft_imag);
+	const size_t block_samples = 2 << derivation_size;
+	const size_t bin_count = 1 << derivation_size;
+	const size_t batch_size = workers.size() * max_blocks_per_job;
 
-	float scale_factor = scale_fix * 9 / sqrt(2 * (float)(2<<derivation_size));
+	std::vector<AudioSpectrumCacheBlockFactory::BlockType> blocks(std::min(batch_size, missing.size()));
+	std::vector<int16_t> audio(blocks.size() * block_samples);
 
-	for (size_t si = 1<<derivation_size; si > 0; --si)
+	for (size_t batch = 0; batch < missing.size(); batch += batch_size)
 	{
-		// With x in range [0;1], log10(x*9+1) will also be in range [0;1],
-		// although the FFT output can apparently get greater magnitudes than 1
-		// despite the input being limited to [-1;+1).
-		*block++ = log10( sqrt(*fft_real * *fft_real + *fft_imag * *fft_imag) * scale_factor + 1 );
-		fft_real++; fft_imag++;
+		const size_t count = std::min(batch_size, missing.size() - batch);
+		const size_t job_count = std::max<size_t>(1, std::min(workers.size(), count / min_blocks_per_job));
+
+		// Read all of the audio on this thread, as the provider might not be
+		// safe to read from several at once
+		for (size_t i = 0; i < count; ++i)
+		{
+			int64_t first_sample = (((int64_t)missing[batch + i]) << derivation_dist) - ((int64_t)1 << derivation_size);
+			analysis->GetAudio(&audio[i * block_samples], first_sample, block_samples);
+		}
+
+		std::mutex mutex;
+		std::condition_variable cv;
+		size_t remaining = job_count;
+		std::exception_ptr error;
+
+		// The jobs refer to this stack frame, so wait for all of them to
+		// finish even if one fails
+		auto run_job = [&](size_t j)
+		{
+			std::exception_ptr e;
+			try
+			{
+				for (size_t i = count * j / job_count; i < count * (j + 1) / job_count; ++i)
+				{
+					blocks[i].reset(new float[bin_count]);
+					DeriveBlock(*workers[j], &audio[i * block_samples], blocks[i].get());
+				}
+			}
+			catch (...)
+			{
+				e = std::current_exception();
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (e)
+				error = e;
+			if (--remaining == 0)
+				cv.notify_one();
+		};
+
+		for (size_t j = 1; j < job_count; ++j)
+			agi::dispatch::Background().Async([&, j] { run_job(j); });
+		run_job(0);
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cv.wait(lock, [&] { return remaining == 0; });
+		}
+		if (error)
+			std::rethrow_exception(error);
+
+		for (size_t i = 0; i < count; ++i)
+			cache->Store(missing[batch + i], std::move(blocks[i]));
 	}
-#endif
 }
 
 void AudioSpectrumRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle style)
@@ -280,7 +436,7 @@ void AudioSpectrumRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle
 	const AudioColorScheme *pal = &colors[style];
 
 	// Sampling rate, in Hz.
-	const float sample_rate = float (provider->GetSampleRate ());
+	const float sample_rate = float (analysis->GetSampleRate ());
 
 	// Number of FFT bins, excluding the "Nyquist" one
 	const int nbr_bins = 1 << derivation_size;
@@ -308,16 +464,21 @@ void AudioSpectrumRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle
 	float log_ratio_calc = (b_fref - clin) / (clog - clin);
 	log_ratio_calc       = mid (0.f, log_ratio_calc, 1.f);
 
-	// ax = absolute x, absolute to the virtual spectrum bitmap
+	auto block_at = [&](int ax) { return (size_t)(ax * pixel_ms * analysis->GetSampleRate() / 1000) >> derivation_dist; };
+
+	std::vector<size_t> needed;
 	for (int ax = start; ax < end; ++ax)
 	{
-		// Derived audio data
-		size_t block_index = (size_t)(ax * pixel_ms * provider->GetSampleRate() / 1000) >> derivation_dist;
-		float *power = &cache->Get(block_index);
-
-		// Prepare bitmap writing
-		unsigned char *px = imgdata + (imgheight-1) * stride + (ax - start) * 3;
+		size_t block_index = block_at(ax);
+		if (needed.empty() || needed.back() != block_index)
+			needed.push_back(block_index);
+	}
+	PrepareBlocks(needed);
 
+	// The bins shown on each row are the same for every column, so work
+	// them out once and leave only the lookups for the per-pixel loop
+	std::vector<SpectrumRow> rows(imgheight);
+	{
 		float bin_prv = minband;
 		float bin_cur = minband;
 		for (int y = 0; y < imgheight; ++y)
@@ -334,38 +495,53 @@ void AudioSpectrumRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle
 				bin_nxt = b_lin + log_ratio_calc * (b_log - b_lin);
 			}
 
-			float val = 0;
+			auto& row = rows[y];
 
 			// Interpolate between consecutive bins
 			if (bin_nxt - bin_prv < 2)
 			{
-				const int   bin_0 = floor_int (bin_cur);
-				const int   bin_1 = std::min (bin_0 + 1, nbr_bins - 1);
-				const float frac  = bin_cur - float (bin_0);
-				const float v0    = power [bin_0];
-				const float v1    = power [bin_1];
-				val = v0 + frac * (v1 - v0);
+				row.first = floor_int (bin_cur);
+				row.last  = std::min (row.first + 1, nbr_bins - 1);
+				row.frac  = bin_cur - float (row.first);
 			}
 
 			// Pick the greatest bin on the interval
 			else
 			{
-				int bin_inf = floor_int ((bin_prv + bin_cur) * 0.5f);
-				int bin_sup = floor_int ((bin_cur + bin_nxt) * 0.5f);
-				bin_inf = std::min (bin_inf, nbr_bins - 2);
-				bin_sup = std::min (bin_sup, nbr_bins - 1);
-				assert (bin_inf < bin_sup);
-				val = *std::max_element (&power [bin_inf], &power [bin_sup]);
+				row.first = std::min (floor_int ((bin_prv + bin_cur) * 0.5f), nbr_bins - 2);
+				row.last  = std::min (floor_int ((bin_cur + bin_nxt) * 0.5f), nbr_bins - 1);
+				row.frac  = -1.f;
+				assert (row.first < row.last);
 			}
 
-			pal->map (val * amplitude_scale, px);
-
-			px     -= stride;
 			bin_prv = bin_cur;
 			bin_cur = bin_nxt;
 		}
 	}
 
+	// ax = absolute x, absolute to the virtual spectrum bitmap
+	for (int ax = start; ax < end; ++ax)
+	{
+		// Derived audio data
+		size_t block_index = block_at(ax);
+		float *power = &cache->Get(block_index);
+
+		// Prepare bitmap writing
+		unsigned char *px = imgdata + (imgheight-1) * stride + (ax - start) * 3;
+
+		for (auto const& row : rows)
+		{
+			float val;
+			if (row.frac >= 0)
+				val = power [row.first] + row.frac * (power [row.last] - power [row.first]);
+			else
+				val = *std::max_element (&power [row.first], &power [row.last]);
+
+			pal->map (val * amplitude_scale, px);
+			px -= stride;
+		}
+	}
+
 	wxBitmap tmpbmp(img);
 	wxMemoryDC targetdc(bmp);
 	targetdc.DrawBitmap(tmpbmp, 0, 0);
@@ -385,3 +561,8 @@ void AudioSpectrumRenderer::AgeCache(size_t max_size)
 	if (cache)
 		cache->Age(max_size);
 }
+
+DataBlockCacheStats AudioSpectrumRenderer::GetCacheStats() const
+{
+	return cache ? cache->GetStats() : DataBlockCacheStats();
+}
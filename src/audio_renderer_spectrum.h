@@ -43,9 +43,11 @@
 #include <fftw3.h>
 #endif
 
+namespace agi { class AudioAnalysisStream; }
 class AudioColorScheme;
 class AudioSpectrumCache;
 struct AudioSpectrumCacheBlockFactory;
+struct AudioSpectrumWorker;
 
 /// @class AudioSpectrumRenderer
 /// @brief Render frequency-power spectrum graphs for audio data.
@@ -58,6 +60,10 @@ class AudioSpectrumRenderer final : public AudioRendererBitmapProvider {
 	/// Internal cache management for the spectrum
 	std::unique_ptr<AudioSpectrumCache> cache;
 
+	/// The audio to derive from, downsampled if the source's rate is well
+	/// above what's needed to display up to max_freq
+	std::unique_ptr<agi::AudioAnalysisStream> analysis;
+
 	/// Colour tables used for rendering
 	std::vector<AudioColorScheme> colors;
 
@@ -108,29 +114,32 @@ class AudioSpectrumRenderer final : public AudioRendererBitmapProvider {
 	/// @param[out] block       Address to write the data to
 	void FillBlock(size_t block_index, float *block);
 
-	/// @brief Convert audio data to float range [-1;+1)
-	/// @param count Samples to convert
-	/// @param dest Buffer to fill
-	template<class T>
-	void ConvertToFloat(size_t count, T *dest);
+	/// @brief Calculate the frequency-power data for a block
+	/// @param      worker Scratch space to use, which must not be in use by another thread
+	/// @param      audio  2^(derivation_size+1) samples of audio for the block
+	/// @param[out] block  Address to write the data to
+	///
+	/// Safe to call from any thread, as it only reads the derivation settings.
+	void DeriveBlock(AudioSpectrumWorker &worker, const int16_t *audio, float *block) const;
+
+	/// @brief Calculate all of the given blocks which aren't cached in parallel
+	/// @param needed Indices of the blocks which are about to be rendered
+	///
+	/// Blocks are otherwise produced one at a time on demand while rendering,
+	/// which is far too slow at high quality settings on wide displays.
+	void PrepareBlocks(std::vector<size_t> const& needed);
 
 	/// @brief Updates the derivation_* after a derivation_*_user change.
 	void update_derivation_values ();
 
 #ifdef WITH_FFTW3
-	/// FFTW plan data
+	/// FFTW plan data, shared by the workers using the new-array execute functions
 	fftw_plan dft_plan = nullptr;
-	/// Pre-allocated input array for FFTW
-	double *dft_input = nullptr;
-	/// Pre-allocated output array for FFTW
-	fftw_complex *dft_output = nullptr;
-#else
-	/// Pre-allocated scratch area for doing FFT derivations
-	std::vector<float> fft_scratch;
 #endif
 
-	/// Pre-allocated scratch area for storing raw audio data
-	std::vector<int16_t> audio_scratch;
+	/// Per-thread scratch space for deriving blocks; the first one is used by
+	/// the rendering thread itself
+	std::vector<std::unique_ptr<AudioSpectrumWorker>> workers;
 
 public:
 	/// @brief Constructor
@@ -169,4 +178,6 @@ public:
 	/// @brief Cleans up the cache
 	/// @param max_size Maximum size in bytes for the cache
 	void AgeCache(size_t max_size) override;
+
+	DataBlockCacheStats GetCacheStats() const override;
 };
@@ -32,10 +32,32 @@
 #include "audio_colorscheme.h"
 #include "options.h"
 
+#include <libaegisub/audio/analysis_stream.h>
+#include <libaegisub/audio/peak_pyramid.h>
 #include <libaegisub/audio/provider.h>
+#include <libaegisub/make_unique.h>
 
 #include <algorithm>
+#include <cstring>
+#include <vector>
 #include <wx/dcmemory.h>
+#include <wx/image.h>
+
+namespace {
+/// Sample rate of the audio read when zoomed out. Columns covering enough
+/// samples at this rate look the same as ones drawn from the full-rate audio.
+const int analysis_rate = 16000;
+/// Fewest analysis samples per column at which they're used
+const int min_analysis_samples = 32;
+
+/// Half-open range of rows
+struct Span {
+	int first = 0;
+	int last = 0;
+
+	bool Contains(int y) const { return y >= first && y < last; }
+};
+}
 
 enum {
 	/// Only render the peaks
@@ -55,20 +77,36 @@ AudioWaveformRenderer::AudioWaveformRenderer(std::string const& color_scheme_nam
 
 AudioWaveformRenderer::~AudioWaveformRenderer() { }
 
-void AudioWaveformRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle style)
+void AudioWaveformRenderer::OnSetProvider()
 {
-	wxMemoryDC dc(bmp);
-	wxRect rect(wxPoint(0, 0), bmp.GetSize());
-	int midpoint = rect.height / 2;
+	audio_buffer.reset();
+	ClearColumns();
+	analysis.reset();
+	if (!provider) return;
 
-	const AudioColorScheme *pal = &colors[style];
+	analysis = agi::make_unique<agi::AudioAnalysisStream>(*provider, analysis_rate, true);
+	if (analysis->IsPassthrough())
+		analysis.reset();
+}
 
-	double pixel_samples = pixel_ms * provider->GetSampleRate() / 1000.0;
+void AudioWaveformRenderer::ClearColumns()
+{
+	columns.clear();
+	columns_order.clear();
+	column_stats.blocks = column_stats.bytes = 0;
+}
 
-	// Fill the background
-	dc.SetBrush(wxBrush(pal->get(0.0f)));
-	dc.SetPen(*wxTRANSPARENT_PEN);
-	dc.DrawRectangle(rect);
+std::vector<AudioWaveformRenderer::Column> const& AudioWaveformRenderer::GetColumns(int start, int width)
+{
+	auto it = columns.find(start);
+	if (it != columns.end() && (int)it->second.size() == width)
+	{
+		++column_stats.hits;
+		return it->second;
+	}
+	++column_stats.misses;
+
+	double pixel_samples = pixel_ms * provider->GetSampleRate() / 1000.0;
 
 	// Make sure we've got a buffer to fill with audio data
 	if (!audio_buffer)
@@ -80,52 +118,160 @@ void AudioWaveformRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle
 
 	double cur_sample = start * pixel_samples;
 
-	wxPen pen_peaks(wxPen(pal->get(0.4f)));
-	wxPen pen_avgs(wxPen(pal->get(0.7f)));
+	// When zoomed out far enough that each column covers many of the finest
+	// peak buckets, read the precomputed summaries rather than the samples
+	auto peaks = provider->GetPeaks();
+	const int64_t min_peak_samples = int64_t(16) << agi::AudioPeakPyramid::LevelBits[0];
+	if (pixel_samples < min_peak_samples)
+		peaks = nullptr;
 
-	for (int x = 0; x < rect.width; ++x)
-	{
-		provider->GetInt16MonoAudio(reinterpret_cast<int16_t*>(audio_buffer.get()), (int64_t)cur_sample, (int64_t)pixel_samples);
-		cur_sample += pixel_samples;
+	// Otherwise, read the downsampled audio when each column covers enough
+	// of it to look the same
+	const int factor = analysis ? analysis->GetFactor() : 1;
+	const bool use_analysis = analysis && !peaks && pixel_samples / factor >= min_analysis_samples;
 
-		int peak_min = 0, peak_max = 0;
-		int64_t avg_min_accum = 0, avg_max_accum = 0;
-		auto aud = reinterpret_cast<const int16_t *>(audio_buffer.get());
-		for (int si = pixel_samples; si > 0; --si, ++aud)
+	std::vector<Column> result(width);
+	for (auto& col : result)
+	{
+		const int64_t col_start = (int64_t)cur_sample;
+		agi::AudioPeak peak;
+		if (peaks && peaks->Get(col_start, (int64_t)(cur_sample + pixel_samples), &peak))
+		{
+			col.peak_min = peak.min;
+			col.peak_max = peak.max;
+			col.avg_min_accum = peak.neg_sum;
+			col.avg_max_accum = peak.pos_sum;
+		}
+		else
 		{
-			if (*aud > 0)
+			auto aud = reinterpret_cast<int16_t *>(audio_buffer.get());
+			int64_t count = (int64_t)pixel_samples;
+			if (use_analysis)
 			{
-				peak_max = std::max(peak_max, (int)*aud);
-				avg_max_accum += *aud;
+				count = (int64_t)(cur_sample + pixel_samples) / factor - col_start / factor;
+				analysis->GetAudio(aud, col_start / factor, count);
 			}
 			else
+				provider->GetInt16MonoAudio(aud, col_start, count);
+
+			for (int64_t si = count; si > 0; --si, ++aud)
 			{
-				peak_min = std::min(peak_min, (int)*aud);
-				avg_min_accum += *aud;
+				if (*aud > 0)
+				{
+					col.peak_max = std::max(col.peak_max, (int)*aud);
+					col.avg_max_accum += *aud;
+				}
+				else
+				{
+					col.peak_min = std::min(col.peak_min, (int)*aud);
+					col.avg_min_accum += *aud;
+				}
+			}
+
+			// The averages are over the full-rate samples the column covers
+			if (use_analysis)
+			{
+				col.avg_max_accum = col.avg_max_accum * pixel_samples / std::max<int64_t>(count, 1);
+				col.avg_min_accum = col.avg_min_accum * pixel_samples / std::max<int64_t>(count, 1);
 			}
 		}
+		cur_sample += pixel_samples;
+	}
+
+	if (it == columns.end())
+	{
+		columns_order.push_back(start);
+		++column_stats.blocks;
+	}
+	else
+		column_stats.bytes -= it->second.size() * sizeof(Column);
+	column_stats.bytes += result.size() * sizeof(Column);
+
+	auto& cached = columns[start];
+	cached = std::move(result);
+	return cached;
+}
+
+void AudioWaveformRenderer::Render(wxBitmap &bmp, int start, AudioRenderingStyle style)
+{
+	wxRect rect(wxPoint(0, 0), bmp.GetSize());
+	int midpoint = rect.height / 2;
+
+	const AudioColorScheme *pal = &colors[style];
+
+	double pixel_samples = pixel_ms * provider->GetSampleRate() / 1000.0;
+
+	// Rows covered by the peaks and averages of each column, as half-open
+	// ranges. Drawn into the image once they're all known.
+	std::vector<Span> peak_rows(rect.width), avg_rows(rect.width);
+
+	auto const& cols = GetColumns(start, rect.width);
+	for (int x = 0; x < rect.width; ++x)
+	{
+		auto const& col = cols[x];
 
 		// midpoint is half height
-		peak_min = std::max((int)(peak_min * amplitude_scale * midpoint) / 0x8000, -midpoint);
-		peak_max = std::min((int)(peak_max * amplitude_scale * midpoint) / 0x8000, midpoint);
-		int avg_min = std::max((int)(avg_min_accum * amplitude_scale * midpoint / pixel_samples) / 0x8000, -midpoint);
-		int avg_max = std::min((int)(avg_max_accum * amplitude_scale * midpoint / pixel_samples) / 0x8000, midpoint);
-
-		dc.SetPen(pen_peaks);
-		dc.DrawLine(x, midpoint - peak_max, x, midpoint - peak_min);
-		if (render_averages) {
-			dc.SetPen(pen_avgs);
-			dc.DrawLine(x, midpoint - avg_max, x, midpoint - avg_min);
+		int peak_min = std::max((int)(col.peak_min * amplitude_scale * midpoint) / 0x8000, -midpoint);
+		int peak_max = std::min((int)(col.peak_max * amplitude_scale * midpoint) / 0x8000, midpoint);
+		int avg_min = std::max((int)(col.avg_min_accum * amplitude_scale * midpoint / pixel_samples) / 0x8000, -midpoint);
+		int avg_max = std::min((int)(col.avg_max_accum * amplitude_scale * midpoint / pixel_samples) / 0x8000, midpoint);
+
+		peak_rows[x] = Span{midpoint - peak_max, midpoint - peak_min};
+		if (render_averages)
+			avg_rows[x] = Span{midpoint - avg_max, midpoint - avg_min};
+	}
+
+	// Rasterize straight into an image rather than drawing a line per column
+	// through the DC, which is slow on some platforms. Each row is written
+	// in order with a colour picked per pixel, which the compiler can turn
+	// into a branchless loop.
+	unsigned char colors_rgb[4][3];
+	pal->map(0.0f, colors_rgb[0]); // Background
+	pal->map(0.4f, colors_rgb[1]); // Peaks
+	pal->map(0.7f, colors_rgb[2]); // Averages
+	pal->map(render_averages ? 1.0f : 0.4f, colors_rgb[3]); // Zero line
+
+	wxImage img(rect.width, rect.height, false);
+	unsigned char *px = img.GetData();
+	for (int y = 0; y < rect.height; ++y)
+	{
+		if (y == midpoint)
+		{
+			for (int x = 0; x < rect.width; ++x, px += 3)
+				memcpy(px, colors_rgb[3], 3);
+			continue;
+		}
+
+		for (int x = 0; x < rect.width; ++x, px += 3)
+		{
+			const int color = avg_rows[x].Contains(y) ? 2 : peak_rows[x].Contains(y) ? 1 : 0;
+			px[0] = colors_rgb[color][0];
+			px[1] = colors_rgb[color][1];
+			px[2] = colors_rgb[color][2];
 		}
 	}
 
-	// Horizontal zero-point line
-	if (render_averages)
-		dc.SetPen(wxPen(pal->get(1.0f)));
-	else
-		dc.SetPen(pen_peaks);
+	wxBitmap tmpbmp(img);
+	wxMemoryDC targetdc(bmp);
+	targetdc.DrawBitmap(tmpbmp, 0, 0);
+}
+
+void AudioWaveformRenderer::AgeCache(size_t max_size)
+{
+	while (column_stats.bytes > max_size && !columns_order.empty())
+	{
+		auto it = columns.find(columns_order.front());
+		columns_order.pop_front();
+		column_stats.bytes -= it->second.size() * sizeof(Column);
+		--column_stats.blocks;
+		++column_stats.evictions;
+		columns.erase(it);
+	}
+}
 
-	dc.DrawLine(0, midpoint, rect.width, midpoint);
+DataBlockCacheStats AudioWaveformRenderer::GetCacheStats() const
+{
+	return column_stats;
 }
 
 void AudioWaveformRenderer::RenderBlank(wxDC &dc, const wxRect &rect, AudioRenderingStyle style)
@@ -29,11 +29,14 @@
 
 #include "audio_renderer.h"
 
+#include <deque>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 class AudioColorScheme;
 class wxArrayString;
+namespace agi { class AudioAnalysisStream; }
 
 /// Render a waveform display of PCM audio data
 class AudioWaveformRenderer final : public AudioRendererBitmapProvider {
@@ -43,11 +46,39 @@ class AudioWaveformRenderer final : public AudioRendererBitmapProvider {
 	/// Pre-allocated buffer for audio fetched from provider
 	std::unique_ptr<char[]> audio_buffer;
 
+	/// Downsampled copy of the audio to read when zoomed out, or nullptr if
+	/// it wouldn't be any cheaper than the provider
+	std::unique_ptr<agi::AudioAnalysisStream> analysis;
+
 	/// Whether to render max+avg or just max
 	bool render_averages;
 
-	void OnSetProvider() override { audio_buffer.reset(); }
-	void OnSetMillisecondsPerPixel() override { audio_buffer.reset(); }
+	/// The audio summarized for one column, before scaling to the display
+	struct Column {
+		int peak_min = 0;
+		int peak_max = 0;
+		/// Sums of the negative and positive samples
+		int64_t avg_min_accum = 0;
+		int64_t avg_max_accum = 0;
+	};
+
+	/// Columns which have been summarized, by the first column of the
+	/// bitmap they were rendered for. These don't depend on the style,
+	/// height or amplitude scale, so rendering the same audio in another
+	/// style (i.e. when the selection changes) only recolours it.
+	std::unordered_map<int, std::vector<Column>> columns;
+	/// Keys of columns in the order they were added, for aging the cache
+	std::deque<int> columns_order;
+	DataBlockCacheStats column_stats;
+
+	/// Get the summaries of the columns of a bitmap, summarizing the audio
+	/// if they're not cached
+	std::vector<Column> const& GetColumns(int start, int width);
+
+	void ClearColumns();
+
+	void OnSetProvider() override;
+	void OnSetMillisecondsPerPixel() override { audio_buffer.reset(); ClearColumns(); }
 
 public:
 	/// @brief Constructor
@@ -68,9 +99,10 @@ public:
 
 	/// @brief Cleans up the cache
 	/// @param max_size Maximum size in bytes for the cache
-	///
-	/// Does nothing for waveform renderer, since it does not have a backend cache
-	void AgeCache(size_t max_size) override { }
+	void AgeCache(size_t max_size) override;
+
+	/// Get the usage counters of the column cache
+	DataBlockCacheStats GetCacheStats() const override;
 
 	/// Get a list of waveform rendering modes
 	static wxArrayString GetWaveformStyles();
@@ -41,8 +41,11 @@
 
 #include <libaegisub/ass/time.h>
 #include <libaegisub/make_unique.h>
+#include <libaegisub/trace.h>
 
 #include <boost/range/algorithm.hpp>
+#include <unordered_map>
+#include <unordered_set>
 #include <wx/pen.h>
 
 namespace {
@@ -305,6 +308,17 @@ class AudioTimingControllerDialogue final : public AudioTimingController {
 	/// All audio markers for active and inactive lines, sorted by position
 	std::vector<DialogueTimingMarker*> markers;
 
+	/// The entry in inactive_lines for each line, when all inactive lines are
+	/// shown, so that changing the selection only has to update the lines
+	/// which were or have become selected
+	std::unordered_map<AssDialogue*, std::list<TimeableLine>::iterator> inactive_line_index;
+	/// The active and selected lines when inactive_lines was last updated
+	Selection excluded_lines;
+	/// Can inactive_lines be updated incrementally? Only true when showing
+	/// all inactive lines and the lines in the file haven't changed since
+	/// inactive_lines was built.
+	bool inactive_lines_current = false;
+
 	/// Marker provider for video keyframes
 	AudioMarkerProviderKeyframes keyframes_provider;
 
@@ -314,6 +328,12 @@ class AudioTimingControllerDialogue final : public AudioTimingController {
 	/// Marker provider for seconds lines
 	SecondsMarkerProvider seconds_provider;
 
+	/// Marker provider for the speech boundaries which are drawn
+	SpeechMarkerProvider speech_provider;
+
+	/// Marker provider for the speech boundaries which markers snap to
+	SpeechMarkerProvider speech_snap_provider;
+
 	/// The set of lines which have been modified and need to have their
 	/// changes applied on commit
 	std::set<TimeableLine*> modified_lines;
@@ -349,12 +369,26 @@ class AudioTimingControllerDialogue final : public AudioTimingController {
 	/// Regenerate the list of timeable selected lines
 	void RegenerateSelectedLines();
 
+	/// Update the list of timeable inactive lines when all inactive lines are
+	/// shown and only the active line and selection have changed
+	void UpdateAllInactiveLines();
+
 	/// Add a line to the list of timeable inactive lines
-	void AddInactiveLine(Selection const& sel, AssDialogue *diag);
+	/// @return The new timeable line, or nullptr if the line is selected
+	TimeableLine *AddInactiveLine(Selection const& sel, AssDialogue *diag);
 
 	/// Regenerate the list of active and inactive line markers
 	void RegenerateMarkers();
 
+	/// Remove the markers of the given lines from the list of markers
+	void RemoveMarkers(std::unordered_set<const TimeableLine*> const& lines);
+
+	/// Add markers to the list of markers, keeping it sorted
+	void AddMarkers(std::vector<DialogueTimingMarker*> new_markers);
+
+	/// Move a line's markers to the right place after its times have changed
+	void ResortMarkers(TimeableLine const& line);
+
 	/// Get the start markers for the active line and all selected lines
 	std::vector<AudioMarker*> GetLeftMarkers();
 
@@ -370,6 +404,8 @@ class AudioTimingControllerDialogue final : public AudioTimingController {
 	/// @param snap_range Maximum distance to snap in milliseconds
 	/// @param active     Markers which should be snapped
 	/// @return The distance the markers were shifted by
+	///
+	/// Must only be called while the list of markers is sorted.
 	int SnapMarkers(int snap_range, std::vector<AudioMarker*> const& markers) const;
 
 	/// Commit all pending changes to the file
@@ -416,16 +452,19 @@ AudioTimingControllerDialogue::AudioTimingControllerDialogue(agi::Context *c)
 : active_line(AudioStyle_Primary, &style_left, &style_right)
 , keyframes_provider(c, "Audio/Display/Draw/Keyframes in Dialogue Mode")
 , video_position_provider(c)
+, speech_provider(c, "Audio/Display/Draw/Speech Boundaries")
+, speech_snap_provider(c, "Audio/Speech Detection/Snap")
 , context(c)
 , commit_connection(c->ass->AddCommitListener(&AudioTimingControllerDialogue::OnFileChanged, this))
-, inactive_line_mode_connection(OPT_SUB("Audio/Inactive Lines Display Mode", &AudioTimingControllerDialogue::RegenerateInactiveLines, this))
-, inactive_line_comment_connection(OPT_SUB("Audio/Display/Draw/Inactive Comments", &AudioTimingControllerDialogue::RegenerateInactiveLines, this))
+, inactive_line_mode_connection(OPT_SUB("Audio/Inactive Lines Display Mode", [=] { inactive_lines_current = false; RegenerateInactiveLines(); }))
+, inactive_line_comment_connection(OPT_SUB("Audio/Display/Draw/Inactive Comments", [=] { inactive_lines_current = false; RegenerateInactiveLines(); }))
 , active_line_connection(c->selectionController->AddActiveLineListener(&AudioTimingControllerDialogue::Revert, this))
 , selection_connection(c->selectionController->AddSelectionListener(&AudioTimingControllerDialogue::OnSelectedSetChanged, this))
 {
 	keyframes_provider.AddMarkerMovedListener([=]{ AnnounceMarkerMoved(); });
 	video_position_provider.AddMarkerMovedListener([=]{ AnnounceMarkerMoved(); });
 	seconds_provider.AddMarkerMovedListener([=]{ AnnounceMarkerMoved(); });
+	speech_provider.AddMarkerMovedListener([=]{ AnnounceMarkerMoved(); });
 
 	Revert();
 }
@@ -436,6 +475,7 @@ void AudioTimingControllerDialogue::GetMarkers(const TimeRange &range, AudioMark
 	// markers, so the markers that we want to end up on top need to appear last
 
 	seconds_provider.GetMarkers(range, out_markers);
+	speech_provider.GetMarkers(range, out_markers);
 
 	// Copy inactive line markers in the range
 	copy(
@@ -454,6 +494,11 @@ void AudioTimingControllerDialogue::OnSelectedSetChanged()
 }
 
 void AudioTimingControllerDialogue::OnFileChanged(int type) {
+	AGI_TRACE_ZONE("commit", "AudioTimingControllerDialogue");
+	// Lines may have been added, removed, replaced, retimed or commented out
+	if (type == AssFile::COMMIT_NEW || type & (AssFile::COMMIT_DIAG_ADDREM | AssFile::COMMIT_DIAG_META | AssFile::COMMIT_DIAG_TIME))
+		inactive_lines_current = false;
+
 	if (type & AssFile::COMMIT_DIAG_TIME)
 		Revert();
 	else if (type & AssFile::COMMIT_DIAG_ADDREM)
@@ -540,6 +585,7 @@ void AudioTimingControllerDialogue::Revert()
 		{
 			modified_lines.insert(&active_line);
 		}
+		ResortMarkers(active_line);
 	}
 
 	RegenerateInactiveLines();
@@ -677,8 +723,9 @@ void AudioTimingControllerDialogue::SetMarkers(std::vector<AudioMarker*> const&
 		}
 	}
 
-	auto begin = boost::lower_bound(markers, min_ms, marker_ptr_cmp());
-	auto end = upper_bound(begin, markers.end(), max_ms, marker_ptr_cmp());
+	// Snapping can move the markers a further snap_range in either direction
+	auto begin = boost::lower_bound(markers, min_ms - snap_range, marker_ptr_cmp());
+	auto end = upper_bound(begin, markers.end(), max_ms + snap_range, marker_ptr_cmp());
 
 	// Update the markers
 	for (auto upd_marker : upd_markers)
@@ -688,12 +735,14 @@ void AudioTimingControllerDialogue::SetMarkers(std::vector<AudioMarker*> const&
 		modified_lines.insert(marker->GetLine());
 	}
 
+	// Snapping searches the sorted markers, so resort the range both before
+	// and after it
+	sort(begin, end, marker_ptr_cmp());
 	int snap = SnapMarkers(snap_range, upd_markers);
 	if (clicked_ms != INT_MIN)
 		clicked_ms += snap;
-
-	// Resort the range
-	sort(begin, end, marker_ptr_cmp());
+	if (snap)
+		sort(begin, end, marker_ptr_cmp());
 
 	if (auto_commit->GetBool()) DoCommit(false);
 	UpdateSelection();
@@ -708,8 +757,16 @@ void AudioTimingControllerDialogue::RegenerateInactiveLines()
 		? static_cast<pred>([](AssDialogue const&) { return true; })
 		: static_cast<pred>([](AssDialogue const& d) { return !d.Comment; });
 
+	if (inactive_lines_current && inactive_line_mode->GetInt() == 3)
+	{
+		UpdateAllInactiveLines();
+		return;
+	}
+
 	bool was_empty = inactive_lines.empty();
 	inactive_lines.clear();
+	inactive_line_index.clear();
+	inactive_lines_current = false;
 
 	auto const& sel = context->selectionController->GetSelectedSet();
 
@@ -742,11 +799,17 @@ void AudioTimingControllerDialogue::RegenerateInactiveLines()
 	case 3: // All inactive lines
 	{
 		AssDialogue *active_line = context->selectionController->GetActiveLine();
+		inactive_line_index.reserve(context->ass->Events.size());
 		for (auto& line : context->ass->Events)
 		{
-			if (&line != active_line && predicate(line))
-				AddInactiveLine(sel, &line);
+			if (&line != active_line && predicate(line) && AddInactiveLine(sel, &line))
+				inactive_line_index[&line] = std::prev(inactive_lines.end());
 		}
+
+		excluded_lines = sel;
+		if (active_line)
+			excluded_lines.insert(active_line);
+		inactive_lines_current = true;
 		break;
 	}
 	default:
@@ -762,19 +825,82 @@ void AudioTimingControllerDialogue::RegenerateInactiveLines()
 	RegenerateMarkers();
 }
 
-void AudioTimingControllerDialogue::AddInactiveLine(Selection const& sel, AssDialogue *diag)
+void AudioTimingControllerDialogue::UpdateAllInactiveLines()
 {
-	if (sel.count(diag)) return;
+	auto const& sel = context->selectionController->GetSelectedSet();
+	Selection excluded = sel;
+	if (AssDialogue *active = context->selectionController->GetActiveLine())
+		excluded.insert(active);
+
+	// Lines which have become active or selected stop being inactive lines
+	std::vector<AssDialogue*> removed;
+	std::unordered_set<const TimeableLine*> removed_lines;
+	for (auto line : excluded)
+	{
+		if (excluded_lines.count(line)) continue;
+		auto it = inactive_line_index.find(line);
+		if (it == inactive_line_index.end()) continue;
+		removed.push_back(line);
+		removed_lines.insert(&*it->second);
+	}
+
+	// And lines which no longer are become inactive lines again
+	std::vector<AssDialogue*> added;
+	for (auto line : excluded_lines)
+	{
+		if (!excluded.count(line))
+			added.push_back(line);
+	}
+
+	excluded_lines = std::move(excluded);
+	if (removed.empty() && added.empty()) return;
+
+	RemoveMarkers(removed_lines);
+	for (auto line : removed)
+	{
+		inactive_lines.erase(inactive_line_index[line]);
+		inactive_line_index.erase(line);
+	}
+
+	bool show_comments = inactive_line_comments->GetBool();
+	std::vector<DialogueTimingMarker*> new_markers;
+	for (auto line : added)
+	{
+		if (!show_comments && line->Comment) continue;
+		if (TimeableLine *timeable = AddInactiveLine(sel, line))
+		{
+			inactive_line_index[line] = std::prev(inactive_lines.end());
+			timeable->GetMarkers(&new_markers);
+		}
+	}
+	AddMarkers(std::move(new_markers));
+
+	AnnounceUpdatedStyleRanges();
+	AnnounceMarkerMoved();
+}
+
+TimeableLine *AudioTimingControllerDialogue::AddInactiveLine(Selection const& sel, AssDialogue *diag)
+{
+	if (sel.count(diag)) return nullptr;
 
 	inactive_lines.emplace_back(AudioStyle_Inactive, &style_inactive, &style_inactive);
 	inactive_lines.back().SetLine(diag);
+	return &inactive_lines.back();
 }
 
 void AudioTimingControllerDialogue::RegenerateSelectedLines()
 {
 	bool was_empty = selected_lines.empty();
-	selected_lines.clear();
+	if (!was_empty)
+	{
+		std::unordered_set<const TimeableLine*> old_lines;
+		for (auto const& line : selected_lines)
+			old_lines.insert(&line);
+		RemoveMarkers(old_lines);
+		selected_lines.clear();
+	}
 
+	std::vector<DialogueTimingMarker*> new_markers;
 	AssDialogue *active = context->selectionController->GetActiveLine();
 	for (auto line : context->selectionController->GetSelectedSet())
 	{
@@ -782,12 +908,14 @@ void AudioTimingControllerDialogue::RegenerateSelectedLines()
 
 		selected_lines.emplace_back(AudioStyle_Selected, &style_inactive, &style_inactive);
 		selected_lines.back().SetLine(line);
+		selected_lines.back().GetMarkers(&new_markers);
 	}
 
 	if (!selected_lines.empty() || !was_empty)
 	{
+		AddMarkers(std::move(new_markers));
 		AnnounceUpdatedStyleRanges();
-		RegenerateMarkers();
+		AnnounceMarkerMoved();
 	}
 }
 
@@ -805,6 +933,33 @@ void AudioTimingControllerDialogue::RegenerateMarkers()
 	AnnounceMarkerMoved();
 }
 
+void AudioTimingControllerDialogue::RemoveMarkers(std::unordered_set<const TimeableLine*> const& lines)
+{
+	if (lines.empty()) return;
+	markers.erase(std::remove_if(markers.begin(), markers.end(),
+		[&](const DialogueTimingMarker *m) { return lines.count(m->GetLine()) != 0; }),
+		markers.end());
+}
+
+void AudioTimingControllerDialogue::AddMarkers(std::vector<DialogueTimingMarker*> new_markers)
+{
+	if (new_markers.empty()) return;
+
+	// Merging a few new markers in is far cheaper than resorting everything
+	boost::sort(new_markers, marker_ptr_cmp());
+	auto mid = static_cast<ptrdiff_t>(markers.size());
+	markers.insert(markers.end(), new_markers.begin(), new_markers.end());
+	std::inplace_merge(markers.begin(), markers.begin() + mid, markers.end(), marker_ptr_cmp());
+}
+
+void AudioTimingControllerDialogue::ResortMarkers(TimeableLine const& line)
+{
+	RemoveMarkers({&line});
+	std::vector<DialogueTimingMarker*> line_markers;
+	line.GetMarkers(&line_markers);
+	AddMarkers(std::move(line_markers));
+}
+
 std::vector<AudioMarker*> AudioTimingControllerDialogue::GetLeftMarkers()
 {
 	std::vector<AudioMarker*> ret;
@@ -829,54 +984,17 @@ int AudioTimingControllerDialogue::SnapMarkers(int snap_range, std::vector<Audio
 {
 	if (snap_range <= 0 || active.empty()) return 0;
 
-	auto marker_range = [&] {
-		int front = active.front()->GetPosition();
-		int min = front;
-		int max = front;
-		for (auto m : active)
-		{
-			auto pos = m->GetPosition();
-			if (pos < min) min = pos;
-			if (pos > max) max = pos;
-		}
-		return TimeRange{min - snap_range, max + snap_range};
-	}();
-
-	std::vector<int> inactive_markers;
-	inactive_markers.reserve(inactive_lines.size() * 2 + selected_lines.size() * 2 + 2 - active.size());
-
-	// Add a marker to the set to check for snaps if it's in the right time
-	// range, isn't at the same place as a marker already in the set, and isn't
-	// one of the markers being moved
-	auto add_inactive = [&](const DialogueTimingMarker *m, bool check)
-	{
-		if (!marker_range.contains(*m)) return;
-		if (!inactive_markers.empty() && inactive_markers.back() == *m) return;
-		if (check && boost::find(active, m) != end(active)) return;
-		inactive_markers.push_back(*m);
-	};
-
-	bool moving_entire_selection = clicked_ms != INT_MIN;
-	for (auto const& line : inactive_lines)
-	{
-		// If we're alt-dragging the entire selection, there can't be any
-		// markers from inactive lines in the active set, so no need to check
-		// for them
-		add_inactive(line.GetLeftMarker(), !moving_entire_selection);
-		add_inactive(line.GetRightMarker(), !moving_entire_selection);
-	}
+	// The markers being moved can't be snapped to
+	std::vector<const AudioMarker*> moving(active.begin(), active.end());
+	boost::sort(moving);
+	auto is_moving = [&](const AudioMarker *m) { return boost::binary_search(moving, m); };
 
-	// And similarly, there can't be any inactive markers from selected lines
-	if (!moving_entire_selection)
-	{
-		for (auto const& line : selected_lines)
-		{
-			add_inactive(line.GetLeftMarker(), true);
-			add_inactive(line.GetRightMarker(), true);
-		}
-		add_inactive(active_line.GetLeftMarker(), true);
-		add_inactive(active_line.GetRightMarker(), true);
-	}
+	std::vector<int> positions;
+	positions.reserve(active.size());
+	for (auto m : active)
+		positions.push_back(m->GetPosition());
+	boost::sort(positions);
+	positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
 
 	int snap_distance = INT_MAX;
 	auto check = [&](int marker, int pos)
@@ -886,17 +1004,14 @@ int AudioTimingControllerDialogue::SnapMarkers(int snap_range, std::vector<Audio
 			snap_distance = dist;
 	};
 
-	int prev = -1;
 	AudioMarkerVector snap_markers;
-	for (const auto active_marker : active)
+	for (int pos : positions)
 	{
-		auto pos = active_marker->GetPosition();
-		if (pos == prev) continue;
-
 		snap_markers.clear();
 		TimeRange range(pos - snap_range, pos + snap_range);
 		keyframes_provider.GetMarkers(range, snap_markers);
 		video_position_provider.GetMarkers(range, snap_markers);
+		speech_snap_provider.GetMarkers(range, snap_markers);
 
 		for (const auto marker : snap_markers)
 		{
@@ -904,12 +1019,26 @@ int AudioTimingControllerDialogue::SnapMarkers(int snap_range, std::vector<Audio
 			if (snap_distance == 0) return 0;
 		}
 
-		for (auto it = boost::lower_bound(inactive_markers, range.begin()); it != end(inactive_markers); ++it)
+		// The line markers are kept sorted, so the only ones which can be the
+		// closest are the first ones on either side which aren't being moved
+		auto it = boost::lower_bound(markers, pos, marker_ptr_cmp());
+		for (auto prev = it; prev != markers.begin() && **(prev - 1) >= range.begin(); --prev)
 		{
-			check(*it, pos);
-			if (snap_distance == 0) return 0;
-			if (*it > pos) break;
+			if (!is_moving(*(prev - 1)))
+			{
+				check(**(prev - 1), pos);
+				break;
+			}
+		}
+		for (auto next = it; next != markers.end() && **next <= range.end(); ++next)
+		{
+			if (!is_moving(*next))
+			{
+				check(**next, pos);
+				break;
+			}
 		}
+		if (snap_distance == 0) return 0;
 	}
 
 	if (tabs(snap_distance) > snap_range)
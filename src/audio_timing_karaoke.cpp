@@ -35,6 +35,7 @@
 #include <boost/range/algorithm/copy.hpp>
 #include <boost/range/adaptor/filtered.hpp>
 #include <boost/range/adaptor/sliced.hpp>
+#include <boost/range/iterator_range.hpp>
 #include <wx/intl.h>
 
 /// @class KaraokeMarker
@@ -109,7 +110,14 @@ class AudioTimingControllerKaraoke final : public AudioTimingController {
 	int commit_id = -1;   ///< Last commit id used for an autocommit
 	bool pending_changes; ///< Are there any pending changes to be committed?
 
+	/// Is a marker being dragged? The line's text is only rebuilt and
+	/// committed once the drag ends, as doing so for every mouse movement
+	/// makes dragging on lines with many syllables choppy.
+	bool dragging = false;
+	bool drag_changes = false; ///< Did the current drag move anything?
+
 	void DoCommit();
+	void ChangesMade();
 	void ApplyLead(bool announce_primary);
 	int MoveMarker(KaraokeMarker *marker, int new_position);
 	void AnnounceChanges(int syl);
@@ -135,6 +143,7 @@ public:
 	std::vector<AudioMarker*> OnLeftClick(int ms, bool, bool, int sensitivity, int) override;
 	std::vector<AudioMarker*> OnRightClick(int ms, bool, int, int) override;
 	void OnMarkerDrag(std::vector<AudioMarker*> const& marker, int new_position, int) override;
+	void OnMarkerDragEnd() override;
 
 	AudioTimingControllerKaraoke(agi::Context *c, AssKaraoke *kara, agi::signal::Connection& file_changed);
 };
@@ -223,10 +232,9 @@ TimeRange AudioTimingControllerKaraoke::GetIdealVisibleTimeRange() const {
 }
 
 void AudioTimingControllerKaraoke::GetMarkers(TimeRange const& range, AudioMarkerVector &out) const {
-	size_t i;
-	for (i = 0; i < markers.size() && markers[i] < range.begin(); ++i) ;
-	for (; i < markers.size() && markers[i] < range.end(); ++i)
-		out.push_back(&markers[i]);
+	auto it = lower_bound(markers.begin(), markers.end(), range.begin());
+	for (; it != markers.end() && *it < range.end(); ++it)
+		out.push_back(&*it);
 
 	if (range.contains(start_marker)) out.push_back(&start_marker);
 	if (range.contains(end_marker)) out.push_back(&end_marker);
@@ -254,6 +262,7 @@ void AudioTimingControllerKaraoke::Revert() {
 	cur_syl = 0;
 	commit_id = -1;
 	pending_changes = false;
+	drag_changes = false;
 
 	start_marker.Move(active_line->Start);
 	end_marker.Move(active_line->End);
@@ -397,6 +406,13 @@ void AudioTimingControllerKaraoke::AnnounceChanges(int syl) {
 	AnnounceMarkerMoved();
 	AnnounceLabelChanged();
 
+	if (dragging)
+		drag_changes = true;
+	else
+		ChangesMade();
+}
+
+void AudioTimingControllerKaraoke::ChangesMade() {
 	if (auto_commit)
 		DoCommit();
 	else {
@@ -406,6 +422,7 @@ void AudioTimingControllerKaraoke::AnnounceChanges(int syl) {
 }
 
 void AudioTimingControllerKaraoke::OnMarkerDrag(std::vector<AudioMarker*> const& m, int new_position, int) {
+	dragging = true;
 	int old_position = m[0]->GetPosition();
 	int syl = MoveMarker(static_cast<KaraokeMarker *>(m[0]), new_position);
 	if (syl < 0) return;
@@ -420,8 +437,21 @@ void AudioTimingControllerKaraoke::OnMarkerDrag(std::vector<AudioMarker*> const&
 	AnnounceChanges(syl);
 }
 
+void AudioTimingControllerKaraoke::OnMarkerDragEnd() {
+	dragging = false;
+	if (drag_changes) {
+		drag_changes = false;
+		ChangesMade();
+	}
+}
+
 void AudioTimingControllerKaraoke::GetLabels(TimeRange const& range, std::vector<AudioLabel> &out) const {
-	copy(labels | boost::adaptors::filtered([&](AudioLabel const& l) {
+	// Labels are in time order, so skip straight to the first one which can
+	// overlap rather than testing every syllable of the line
+	auto it = partition_point(labels.begin(), labels.end(), [&](AudioLabel const& l) {
+		return l.range.end() < range.begin();
+	});
+	copy(boost::make_iterator_range(it, labels.end()) | boost::adaptors::filtered([&](AudioLabel const& l) {
 		return range.overlaps(l.range);
 	}), back_inserter(out));
 }
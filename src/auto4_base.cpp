@@ -47,9 +47,11 @@
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/trim.hpp>
-#include <future>
+#include <mutex>
+#include <unordered_map>
 
 #include <wx/dcmemory.h>
+#include <wx/evtloop.h>
 #include <wx/log.h>
 #include <wx/sizer.h>
 
@@ -60,84 +62,134 @@
 #include <libaegisub/charset_conv_win.h>
 #endif
 
-namespace Automation4 {
-	bool CalculateTextExtents(AssStyle *style, std::string const& text, double &width, double &height, double &descent, double &extlead)
-	{
-		width = height = descent = extlead = 0;
+namespace {
+	using Automation4::TextExtents;
+
+	/// Measures strings in a single style, so that the font only has to be
+	/// created once for all of them
+	class TextMeasurer {
+		double fontsize;
+		double spacing;
+#ifdef WIN32
+		HDC dc = nullptr;
+		HFONT font = nullptr;
+		HGDIOBJ old_font = nullptr;
+#else
+		wxMemoryDC dc;
+#endif
+
+	public:
+		TextMeasurer(AssStyle const& style);
+		~TextMeasurer();
+
+		/// Was the font successfully created?
+		bool IsValid() const;
 
-		double fontsize = style->fontsize * 64;
-		double spacing = style->spacing * 64;
+		/// Measure a string, without compensating for the style's scaling
+		void Measure(std::string const& text, TextExtents &extents);
+	};
 
 #ifdef WIN32
+	TextMeasurer::TextMeasurer(AssStyle const& style)
+	: fontsize(style.fontsize * 64)
+	, spacing(style.spacing * 64)
+	{
 		// This is almost copypasta from TextSub
-		auto dc = CreateCompatibleDC(nullptr);
-		if (!dc) return false;
+		dc = CreateCompatibleDC(nullptr);
+		if (!dc) return;
 
 		SetMapMode(dc, MM_TEXT);
 
 		LOGFONTW lf = {0};
 		lf.lfHeight = (LONG)fontsize;
-		lf.lfWeight = style->bold ? FW_BOLD : FW_NORMAL;
-		lf.lfItalic = style->italic;
-		lf.lfUnderline = style->underline;
-		lf.lfStrikeOut = style->strikeout;
-		lf.lfCharSet = style->encoding;
+		lf.lfWeight = style.bold ? FW_BOLD : FW_NORMAL;
+		lf.lfItalic = style.italic;
+		lf.lfUnderline = style.underline;
+		lf.lfStrikeOut = style.strikeout;
+		lf.lfCharSet = style.encoding;
 		lf.lfOutPrecision = OUT_TT_PRECIS;
 		lf.lfClipPrecision = CLIP_DEFAULT_PRECIS;
 		lf.lfQuality = ANTIALIASED_QUALITY;
 		lf.lfPitchAndFamily = DEFAULT_PITCH|FF_DONTCARE;
-		wcsncpy(lf.lfFaceName, agi::charset::ConvertW(style->font).c_str(), 31);
+		wcsncpy(lf.lfFaceName, agi::charset::ConvertW(style.font).c_str(), 31);
 
-		auto font = CreateFontIndirect(&lf);
-		if (!font) return false;
+		font = CreateFontIndirect(&lf);
+		if (font)
+			old_font = SelectObject(dc, font);
+	}
 
-		auto old_font = SelectObject(dc, font);
+	TextMeasurer::~TextMeasurer()
+	{
+		if (font) {
+			SelectObject(dc, old_font);
+			DeleteObject(font);
+		}
+		if (dc)
+			DeleteObject(dc);
+	}
+
+	bool TextMeasurer::IsValid() const
+	{
+		return dc && font;
+	}
+
+	void TextMeasurer::Measure(std::string const& text, TextExtents &extents)
+	{
+		extents = TextExtents();
 
 		std::wstring wtext(agi::charset::ConvertW(text));
 		if (spacing != 0 ) {
-			width = 0;
 			for (auto c : wtext) {
 				SIZE sz;
 				GetTextExtentPoint32(dc, &c, 1, &sz);
-				width += sz.cx + spacing;
-				height = sz.cy;
+				extents.width += sz.cx + spacing;
+				extents.height = sz.cy;
 			}
 		}
 		else {
 			SIZE sz;
 			GetTextExtentPoint32(dc, &wtext[0], (int)wtext.size(), &sz);
-			width = sz.cx;
-			height = sz.cy;
+			extents.width = sz.cx;
+			extents.height = sz.cy;
 		}
 
 		TEXTMETRIC tm;
 		GetTextMetrics(dc, &tm);
-		descent = tm.tmDescent;
-		extlead = tm.tmExternalLeading;
-
-		SelectObject(dc, old_font);
-		DeleteObject(font);
-		DeleteObject(dc);
+		extents.descent = tm.tmDescent;
+		extents.extlead = tm.tmExternalLeading;
+	}
 
 #else // not WIN32
-		wxMemoryDC thedc;
-
+	TextMeasurer::TextMeasurer(AssStyle const& style)
+	: fontsize(style.fontsize * 64)
+	, spacing(style.spacing * 64)
+	{
 		// fix fontsize to be 72 DPI
-		//fontsize = -FT_MulDiv((int)(fontsize+0.5), 72, thedc.GetPPI().y);
+		//fontsize = -FT_MulDiv((int)(fontsize+0.5), 72, dc.GetPPI().y);
 
-		// now try to get a font!
-		// use the font list to get some caching... (chance is the script will need the same font very often)
 		// USING wxTheFontList SEEMS TO CAUSE BAD LEAKS!
 		//wxFont *thefont = wxTheFontList->FindOrCreateFont(
 		wxFont thefont(
 			(int)fontsize,
 			wxFONTFAMILY_DEFAULT,
-			style->italic ? wxFONTSTYLE_ITALIC : wxFONTSTYLE_NORMAL,
-			style->bold ? wxFONTWEIGHT_BOLD : wxFONTWEIGHT_NORMAL,
-			style->underline,
-			to_wx(style->font),
+			style.italic ? wxFONTSTYLE_ITALIC : wxFONTSTYLE_NORMAL,
+			style.bold ? wxFONTWEIGHT_BOLD : wxFONTWEIGHT_NORMAL,
+			style.underline,
+			to_wx(style.font),
 			wxFONTENCODING_SYSTEM); // FIXME! make sure to get the right encoding here, make some translation table between windows and wx encodings
-		thedc.SetFont(thefont);
+		dc.SetFont(thefont);
+	}
+
+	TextMeasurer::~TextMeasurer() { }
+
+	bool TextMeasurer::IsValid() const
+	{
+		return true;
+	}
+
+	void TextMeasurer::Measure(std::string const& text, TextExtents &extents)
+	{
+		extents = TextExtents();
 
 		wxString wtext(to_wx(text));
 		if (spacing) {
@@ -145,27 +197,135 @@ namespace Automation4 {
 			// NOTE: Is kerning actually done either way?!
 			for (auto const& wc : wtext) {
 				int a, b, c, d;
-				thedc.GetTextExtent(wc, &a, &b, &c, &d);
+				dc.GetTextExtent(wc, &a, &b, &c, &d);
 				double scaling = fontsize / (double)(b > 0 ? b : 1); // semi-workaround for missing OS/2 table data for scaling
-				width += (a + spacing)*scaling;
-				height = b > height ? b*scaling : height;
-				descent = c > descent ? c*scaling : descent;
-				extlead = d > extlead ? d*scaling : extlead;
+				extents.width += (a + spacing)*scaling;
+				extents.height = b > extents.height ? b*scaling : extents.height;
+				extents.descent = c > extents.descent ? c*scaling : extents.descent;
+				extents.extlead = d > extents.extlead ? d*scaling : extents.extlead;
 			}
 		} else {
 			// If the inter-character spacing should be zero, kerning info can (and must) be used, so calculate everything in one go
 			wxCoord lwidth, lheight, ldescent, lextlead;
-			thedc.GetTextExtent(wtext, &lwidth, &lheight, &ldescent, &lextlead);
+			dc.GetTextExtent(wtext, &lwidth, &lheight, &ldescent, &lextlead);
 			double scaling = fontsize / (double)(lheight > 0 ? lheight : 1); // semi-workaround for missing OS/2 table data for scaling
-			width = lwidth*scaling; height = lheight*scaling; descent = ldescent*scaling; extlead = lextlead*scaling;
+			extents.width = lwidth*scaling;
+			extents.height = lheight*scaling;
+			extents.descent = ldescent*scaling;
+			extents.extlead = lextlead*scaling;
 		}
+	}
 #endif
 
+	/// Unscaled measurements of strings, by the style properties which
+	/// affect them and then by the string, as karaoke templates measure the
+	/// same syllables over and over. Scaling is applied after the lookup so
+	/// that styles which differ only in scale share entries.
+	struct TextExtentsCache {
+		std::mutex mutex;
+		std::unordered_map<std::string, std::unordered_map<std::string, TextExtents>> fonts;
+		size_t size = 0;
+	} text_extents_cache;
+
+	/// Upper bound on the number of entries in the cache before it's emptied
+	const size_t text_extents_cache_limit = 100000;
+
+	std::string text_extents_key(AssStyle const& style)
+	{
+		return agi::format("%s\x1f%g\x1f%g\x1f%d%d%d%d\x1f%d",
+			style.font, style.fontsize, style.spacing,
+			style.bold, style.italic, style.underline, style.strikeout,
+			style.encoding);
+	}
+
+	bool headless = false;
+
+	/// Progress sink for running scripts without a UI, which writes everything
+	/// the script logs to stderr
+	class ConsoleProgressSink final : public agi::ProgressSink {
+		std::string title;
+		bool at_line_start = true;
+
+	public:
+		ConsoleProgressSink(std::string title) : title(std::move(title)) { }
+
+		void SetIndeterminate() override { }
+		void SetTitle(std::string const&) override { }
+		void SetMessage(std::string const&) override { }
+		void SetProgress(int64_t, int64_t) override { }
+		void SetStayOpen(bool) override { }
+		bool IsCancelled() override { return false; }
+
+		void Log(std::string const& str) override {
+			std::string out;
+			for (char c : str) {
+				if (at_line_start)
+					out += title + ": ";
+				out += c;
+				at_line_start = c == '\n';
+			}
+			fputs(out.c_str(), stderr);
+		}
+	};
+}
+
+namespace Automation4 {
+	bool CalculateTextExtents(AssStyle *style, std::string const& text, double &width, double &height, double &descent, double &extlead)
+	{
+		std::vector<TextExtents> extents;
+		bool ok = CalculateTextExtents(style, std::vector<std::string>{text}, extents);
+		width = extents[0].width;
+		height = extents[0].height;
+		descent = extents[0].descent;
+		extlead = extents[0].extlead;
+		return ok;
+	}
+
+	bool CalculateTextExtents(AssStyle *style, std::vector<std::string> const& texts, std::vector<TextExtents> &extents)
+	{
+		extents.assign(texts.size(), TextExtents());
+
+		auto& cache = text_extents_cache;
+		const std::string key = text_extents_key(*style);
+		std::vector<size_t> misses;
+		{
+			std::lock_guard<std::mutex> lock(cache.mutex);
+			auto const& font = cache.fonts[key];
+			for (size_t i = 0; i < texts.size(); ++i) {
+				auto it = font.find(texts[i]);
+				if (it != font.end())
+					extents[i] = it->second;
+				else
+					misses.push_back(i);
+			}
+		}
+
+		if (!misses.empty()) {
+			TextMeasurer measurer(*style);
+			if (!measurer.IsValid()) {
+				extents.assign(texts.size(), TextExtents());
+				return false;
+			}
+			for (size_t i : misses)
+				measurer.Measure(texts[i], extents[i]);
+
+			std::lock_guard<std::mutex> lock(cache.mutex);
+			if (cache.size + misses.size() > text_extents_cache_limit) {
+				cache.fonts.clear();
+				cache.size = 0;
+			}
+			auto& font = cache.fonts[key];
+			for (size_t i : misses)
+				cache.size += font.emplace(texts[i], extents[i]).second;
+		}
+
 		// Compensate for scaling
-		width = style->scalex / 100 * width / 64;
-		height = style->scaley / 100 * height / 64;
-		descent = style->scaley / 100 * descent / 64;
-		extlead = style->scaley / 100 * extlead / 64;
+		for (auto& e : extents) {
+			e.width = style->scalex / 100 * e.width / 64;
+			e.height = style->scaley / 100 * e.height / 64;
+			e.descent = style->scaley / 100 * e.descent / 64;
+			e.extlead = style->scaley / 100 * e.extlead / 64;
+		}
 
 		return true;
 	}
@@ -208,6 +368,10 @@ namespace Automation4 {
 
 	void ProgressSink::ShowDialog(ScriptDialog *config_dialog)
 	{
+		// Without a UI the dialog is left as if it had been cancelled
+		if (BackgroundScriptRunner::IsHeadless())
+			return;
+
 		agi::dispatch::Main().Sync([=] {
 			wxDialog w; // container dialog box
 			w.SetExtraStyle(wxWS_EX_VALIDATE_RECURSIVELY);
@@ -223,8 +387,10 @@ namespace Automation4 {
 	}
 
 	BackgroundScriptRunner::BackgroundScriptRunner(wxWindow *parent, std::string const& title)
-	: impl(new DialogProgress(parent, to_wx(title)))
+	: title(title)
 	{
+		if (!headless)
+			impl = agi::make_unique<DialogProgress>(parent, to_wx(title));
 	}
 
 	BackgroundScriptRunner::~BackgroundScriptRunner()
@@ -233,10 +399,34 @@ namespace Automation4 {
 
 	void BackgroundScriptRunner::Run(std::function<void (ProgressSink*)> task)
 	{
-		impl->Run([&](agi::ProgressSink *ps) {
-			ProgressSink aps(ps, this);
-			task(&aps);
+		if (impl) {
+			impl->Run([&](agi::ProgressSink *ps) {
+				ProgressSink aps(ps, this);
+				task(&aps);
+			});
+			return;
+		}
+
+		// The task still has to run on a worker thread, as scripts use
+		// dispatch::Main().Sync() for things like the clipboard, so spin an
+		// event loop until it finishes
+		wxGUIEventLoop loop;
+		std::exception_ptr error;
+		agi::dispatch::Background().Async([&] {
+			try {
+				ConsoleProgressSink console(title);
+				ProgressSink aps(&console, this);
+				task(&aps);
+			}
+			catch (...) {
+				error = std::current_exception();
+			}
+			agi::dispatch::Main().Async([&] { loop.Exit(); });
 		});
+		loop.Run();
+
+		if (error)
+			std::rethrow_exception(error);
 	}
 
 	wxWindow *BackgroundScriptRunner::GetParentWindow() const
@@ -246,7 +436,17 @@ namespace Automation4 {
 
 	std::string BackgroundScriptRunner::GetTitle() const
 	{
-		return from_wx(impl->GetTitle());
+		return title;
+	}
+
+	void BackgroundScriptRunner::SetHeadless(bool enable)
+	{
+		headless = enable;
+	}
+
+	bool BackgroundScriptRunner::IsHeadless()
+	{
+		return headless;
 	}
 
 	// Script
@@ -314,7 +514,7 @@ namespace Automation4 {
 	{
 		scripts.clear();
 
-		std::vector<std::future<std::unique_ptr<Script>>> script_futures;
+		std::vector<agi::fs::path> filenames;
 
 		std::set<agi::fs::path> dirnames;
 		for (auto tok : agi::Split(path, '|')) {
@@ -325,15 +525,21 @@ namespace Automation4 {
 			dirnames.insert(dirname);
 
 			for (auto filename : agi::fs::DirectoryIterator(dirname, "*.*"))
-				script_futures.emplace_back(std::async(std::launch::async, [=] {
-					return ScriptFactory::CreateFromFile(dirname/filename, false, false);
-				}));
+				filenames.push_back(dirname/filename);
 		}
 
+		// Each script gets its own interpreter, so they can all be loaded at
+		// once, but their features are registered here in directory order so
+		// that name clashes are always resolved the same way
+		std::vector<std::unique_ptr<Script>> loaded(filenames.size());
+		agi::dispatch::Parallel(filenames.size(), [&](size_t i) {
+			loaded[i] = ScriptFactory::LoadFromFile(filenames[i], false, false);
+		});
+
 		int error_count = 0;
-		for (auto& future : script_futures) {
-			auto s = future.get();
+		for (auto& s : loaded) {
 			if (s) {
+				s->RegisterFeatures();
 				if (!s->GetLoadedState()) ++error_count;
 				scripts.emplace_back(std::move(s));
 			}
@@ -447,6 +653,14 @@ namespace Automation4 {
 	}
 
 	std::unique_ptr<Script> ScriptFactory::CreateFromFile(agi::fs::path const& filename, bool complain_about_unrecognised, bool create_unknown)
+	{
+		auto s = LoadFromFile(filename, complain_about_unrecognised, create_unknown);
+		if (s)
+			s->RegisterFeatures();
+		return s;
+	}
+
+	std::unique_ptr<Script> ScriptFactory::LoadFromFile(agi::fs::path const& filename, bool complain_about_unrecognised, bool create_unknown)
 	{
 		for (auto& factory : Factories()) {
 			auto s = factory->Produce(filename);
@@ -58,8 +58,20 @@ namespace Automation4 {
 	DEFINE_EXCEPTION(ScriptLoadError, AutomationError);
 	DEFINE_EXCEPTION(MacroRunError, AutomationError);
 
+	/// Rendered size of a string
+	struct TextExtents {
+		double width = 0;
+		double height = 0;
+		double descent = 0;
+		double extlead = 0;
+	};
+
 	// Calculate the extents of a text string given a style
 	bool CalculateTextExtents(AssStyle *style, std::string const& text, double &width, double &height, double &descent, double &extlead);
+	/// Calculate the extents of several strings in the same style, which
+	/// only needs to set up the font once for all of the strings which
+	/// haven't already been measured
+	bool CalculateTextExtents(AssStyle *style, std::vector<std::string> const& texts, std::vector<TextExtents> &extents);
 
 	class ScriptDialog;
 
@@ -104,6 +116,7 @@ namespace Automation4 {
 
 	class BackgroundScriptRunner {
 		std::unique_ptr<DialogProgress> impl;
+		std::string title;
 
 	public:
 		wxWindow *GetParentWindow() const;
@@ -111,6 +124,12 @@ namespace Automation4 {
 
 		void Run(std::function<void(ProgressSink*)> task);
 
+		/// Run scripts without any UI from now on. Their log output is
+		/// written to stderr, and any dialogs they open are treated as if
+		/// they were cancelled.
+		static void SetHeadless(bool headless);
+		static bool IsHeadless();
+
 		BackgroundScriptRunner(wxWindow *parent, std::string const& title);
 		~BackgroundScriptRunner();
 	};
@@ -148,6 +167,8 @@ namespace Automation4 {
 		/// The automation include path, consisting of the user-specified paths
 		/// along with the script's path
 		std::vector<agi::fs::path> include_path;
+		/// How long the most recent load of the script took, in milliseconds
+		int64_t load_time = 0;
 		Script(agi::fs::path const& filename);
 
 	public:
@@ -170,11 +191,23 @@ namespace Automation4 {
 		virtual std::string GetVersion() const=0;
 		/// Did the script load correctly?
 		virtual bool GetLoadedState() const=0;
+		/// How long the most recent load of the script took, in milliseconds
+		int64_t GetLoadTime() const { return load_time; }
+
+		/// Register the macros and export filters the script provides. This
+		/// is separate from loading so that scripts can be loaded on worker
+		/// threads and still have their features registered on the main
+		/// thread in a consistent order.
+		virtual void RegisterFeatures() { }
 
 		/// Get a list of commands provided by this script
 		virtual std::vector<cmd::Command*> GetMacros() const=0;
 		/// Get a list of export filters provided by this script
 		virtual std::vector<ExportFilter*> GetFilters() const=0;
+		/// Get a description of where the script's macros have spent their
+		/// time while being profiled, or an empty string if there's nothing
+		/// to report
+		virtual std::string GetProfileReport() const { return ""; }
 	};
 
 	/// A manager of loaded automation scripts
@@ -262,12 +295,17 @@ namespace Automation4 {
 		/// Get the full wildcard string for all loaded engines
 		static std::string GetWildcardStr();
 
-		/// Load a script from a file
+		/// Load a script from a file and register its features
 		/// @param filename Script to load
 		/// @param complain_about_unrecognised Should an error be displayed for files that aren't automation scripts?
 		/// @param create_unknown Create a placeholder rather than returning nullptr if no script engine supports the file
 		static std::unique_ptr<Script> CreateFromFile(agi::fs::path const& filename, bool complain_about_unrecognised, bool create_unknown=true);
 
+		/// Load a script from a file without registering its features, which
+		/// is safe to do on any thread. Script::RegisterFeatures must be
+		/// called on the main thread before the script is used.
+		static std::unique_ptr<Script> LoadFromFile(agi::fs::path const& filename, bool complain_about_unrecognised, bool create_unknown=true);
+
 		static const std::vector<std::unique_ptr<ScriptFactory>>& GetFactories();
 	};
 
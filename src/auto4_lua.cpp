@@ -57,12 +57,15 @@
 
 #include <libaegisub/dispatch.h>
 #include <libaegisub/format.h>
+#include <libaegisub/log.h>
 #include <libaegisub/lua/ffi.h>
 #include <libaegisub/lua/modules.h>
 #include <libaegisub/lua/script_reader.h>
 #include <libaegisub/lua/utils.h>
 #include <libaegisub/make_unique.h>
+#include <libaegisub/memory_usage.h>
 #include <libaegisub/path.h>
+#include <libaegisub/trace.h>
 
 #include <algorithm>
 #include <boost/algorithm/string/case_conv.hpp>
@@ -70,7 +73,7 @@
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/scope_exit.hpp>
 #include <cassert>
-#include <mutex>
+#include <chrono>
 #include <wx/clipbrd.h>
 #include <wx/log.h>
 #include <wx/msgdlg.h>
@@ -198,25 +201,25 @@ namespace {
 		}
 	}
 
-	std::shared_ptr<VideoFrame> *check_VideoFrame(lua_State *L) {
-		auto framePtr = static_cast<std::shared_ptr<VideoFrame>*>(luaL_checkudata(L, 1, "VideoFrame"));
+	std::shared_ptr<const VideoFrame> *check_VideoFrame(lua_State *L) {
+		auto framePtr = static_cast<std::shared_ptr<const VideoFrame>*>(luaL_checkudata(L, 1, "VideoFrame"));
 		return framePtr;
 	}
 
 	int FrameWidth(lua_State *L) {
-		std::shared_ptr<VideoFrame> frame = *check_VideoFrame(L);
+		std::shared_ptr<const VideoFrame> frame = *check_VideoFrame(L);
 		push_value(L, frame->width);
 		return 1;
 	}
 
 	int FrameHeight(lua_State *L) {
-		std::shared_ptr<VideoFrame> frame = *check_VideoFrame(L);
+		std::shared_ptr<const VideoFrame> frame = *check_VideoFrame(L);
 		push_value(L, frame->height);
 		return 1;
 	}
 
 	int FramePixel(lua_State *L) {
-		std::shared_ptr<VideoFrame> frame = *check_VideoFrame(L);
+		std::shared_ptr<const VideoFrame> frame = *check_VideoFrame(L);
 		size_t x = lua_tointeger(L, -2);
 		size_t y = lua_tointeger(L, -1);
 		lua_pop(L, 2);
@@ -237,7 +240,7 @@ namespace {
 	}
 
 	int FramePixelFormatted(lua_State *L) {
-		std::shared_ptr<VideoFrame> frame = *check_VideoFrame(L);
+		std::shared_ptr<const VideoFrame> frame = *check_VideoFrame(L);
 		size_t x = lua_tointeger(L, -2);
 		size_t y = lua_tointeger(L, -1);
 		lua_pop(L, 2);
@@ -257,7 +260,7 @@ namespace {
 	}
 
 	int FrameData(lua_State *L) {
-		std::shared_ptr<VideoFrame> frame = *check_VideoFrame(L);
+		std::shared_ptr<const VideoFrame> frame = *check_VideoFrame(L);
 
 		push_value(L, frame->data.data());
 		push_value(L, frame->pitch);
@@ -267,8 +270,8 @@ namespace {
 	}
 
 	int FrameDestroy(lua_State *L) {
-		std::shared_ptr<VideoFrame> *frame = check_VideoFrame(L);
-		frame->~shared_ptr<VideoFrame>();
+		std::shared_ptr<const VideoFrame> *frame = check_VideoFrame(L);
+		frame->~shared_ptr<const VideoFrame>();
 		return 0;
 	}
 
@@ -306,11 +309,11 @@ namespace {
 		}
 
 		if (c && c->project->Timecodes().IsLoaded()) {
-			std::shared_ptr<VideoFrame> frame = c->videoController->GetFrame(frameNumber, !withSubtitles);
+			std::shared_ptr<const VideoFrame> frame = c->videoController->GetFrame(frameNumber, !withSubtitles);
 
-			void *userData = lua_newuserdata(L, sizeof(std::shared_ptr<VideoFrame>));
+			void *userData = lua_newuserdata(L, sizeof(std::shared_ptr<const VideoFrame>));
 
-			new(userData) std::shared_ptr<VideoFrame>(frame);
+			new(userData) std::shared_ptr<const VideoFrame>(frame);
 
 			luaL_getmetatable(L, "VideoFrame");
 			lua_setmetatable(L, -2);
@@ -346,27 +349,35 @@ namespace {
 		throw error_tag();
 	}
 
-	int lua_text_textents(lua_State *L)
+	/// Check that the argument at the index is a style table and convert it
+	std::unique_ptr<AssEntry> check_style(lua_State *L, int idx)
 	{
-		argcheck(L, !!lua_istable(L, 1), 1, "");
-		argcheck(L, !!lua_isstring(L, 2), 2, "");
+		argcheck(L, !!lua_istable(L, idx), idx, "");
 
 		// have to check that it looks like a style table before actually converting
 		// if it's a dialogue table then an active AssFile object is required
 		{
-			lua_getfield(L, 1, "class");
+			lua_getfield(L, idx, "class");
 			std::string actual_class{lua_tostring(L, -1)};
 			boost::to_lower(actual_class);
 			if (actual_class != "style")
-				return error(L, "Not a style entry");
+				error(L, "Not a style entry");
 			lua_pop(L, 1);
 		}
 
-		lua_pushvalue(L, 1);
+		lua_pushvalue(L, idx);
 		std::unique_ptr<AssEntry> et(Automation4::LuaAssFile::LuaToAssEntry(L));
 		lua_pop(L, 1);
 		if (typeid(*et) != typeid(AssStyle))
-			return error(L, "Not a style entry");
+			error(L, "Not a style entry");
+		return et;
+	}
+
+	int lua_text_textents(lua_State *L)
+	{
+		Automation4::LuaProfile::Scope timer(L, Automation4::LuaProfile::TEXT_EXTENTS);
+		auto et = check_style(L, 1);
+		argcheck(L, !!lua_isstring(L, 2), 2, "");
 
 		double width, height, descent, extlead;
 		if (!Automation4::CalculateTextExtents(static_cast<AssStyle*>(et.get()),
@@ -380,6 +391,37 @@ namespace {
 		return 4;
 	}
 
+	int lua_text_textents_batch(lua_State *L)
+	{
+		Automation4::LuaProfile::Scope timer(L, Automation4::LuaProfile::TEXT_EXTENTS);
+		auto et = check_style(L, 1);
+		argcheck(L, !!lua_istable(L, 2), 2, "");
+
+		std::vector<std::string> texts(lua_objlen(L, 2));
+		for (size_t i = 0; i < texts.size(); ++i) {
+			lua_rawgeti(L, 2, i + 1);
+			if (!lua_isstring(L, -1))
+				return error(L, "Text %d is not a string", (int)i + 1);
+			texts[i] = get_string(L, -1);
+			lua_pop(L, 1);
+		}
+
+		std::vector<Automation4::TextExtents> extents;
+		if (!Automation4::CalculateTextExtents(static_cast<AssStyle*>(et.get()), texts, extents))
+			return error(L, "Some internal error occurred calculating text_extents");
+
+		lua_createtable(L, extents.size(), 0);
+		for (size_t i = 0; i < extents.size(); ++i) {
+			lua_createtable(L, 0, 4);
+			set_field(L, "width", extents[i].width);
+			set_field(L, "height", extents[i].height);
+			set_field(L, "descent", extents[i].descent);
+			set_field(L, "extlead", extents[i].extlead);
+			lua_rawseti(L, -2, i + 1);
+		}
+		return 1;
+	}
+
 	int lua_get_audio_selection(lua_State *L)
 	{
 		const agi::Context *c = get_context(L);
@@ -451,7 +493,7 @@ namespace {
 		if (!c)
 			lua_pushnil(L);
 		else {
-			lua_createtable(L, 0, 14);
+			lua_createtable(L, 0, 15);
 #define PUSH_FIELD(name) set_field(L, #name, c->ass->Properties.name)
 			PUSH_FIELD(automation_scripts);
 			PUSH_FIELD(export_filters);
@@ -463,6 +505,7 @@ namespace {
 			PUSH_FIELD(active_row);
 			PUSH_FIELD(ar_mode);
 			PUSH_FIELD(video_position);
+			PUSH_FIELD(disable_hw_decoding);
 #undef PUSH_FIELD
 			set_field(L, "audio_file", c->path->MakeAbsolute(c->ass->Properties.audio_file, "?script"));
 			set_field(L, "video_file", c->path->MakeAbsolute(c->ass->Properties.video_file, "?script"));
@@ -472,6 +515,91 @@ namespace {
 		return 1;
 	}
 
+	/// Profiles a single run of a macro for as long as it's alive, if
+	/// profiling is enabled
+	class LuaProfiledRun {
+		lua_State *L;
+		LuaProfile *totals;
+		LuaProfile profile;
+		LuaProfile::clock::time_point start;
+		/// Registry reference to the function which stops the sampling
+		/// profiler, or LUA_NOREF if it isn't running
+		int stop_sampling = LUA_NOREF;
+
+		void StartSampling();
+		void StopSampling();
+
+	public:
+		LuaProfiledRun(lua_State *L, LuaProfile &totals);
+		~LuaProfiledRun();
+	};
+
+	LuaProfiledRun::LuaProfiledRun(lua_State *L, LuaProfile &totals)
+	: L(L)
+	, totals(OPT_GET("Automation/Profile/Enabled")->GetBool() ? &totals : nullptr)
+	{
+		if (!this->totals) return;
+		LuaProfile::Set(L, &profile);
+		if (OPT_GET("Automation/Profile/Sampling")->GetBool())
+			StartSampling();
+		start = LuaProfile::clock::now();
+	}
+
+	LuaProfiledRun::~LuaProfiledRun()
+	{
+		if (!totals) return;
+		profile.total = LuaProfile::clock::now() - start;
+		profile.runs = 1;
+		StopSampling();
+		LuaProfile::Set(L, nullptr);
+		totals->Add(profile);
+	}
+
+	void LuaProfiledRun::StartSampling()
+	{
+		// jit.profile only exists in LuaJIT 2.1, so quietly skip sampling
+		// if it isn't there
+		static const char sampler[] =
+			"local ok, profile = pcall(require, 'jit.profile')\n"
+			"if not ok then return nil end\n"
+			"local counts = {}\n"
+			"profile.start('li1', function(thread, samples)\n"
+			"  local stack = profile.dumpstack(thread, 'pl', 1)\n"
+			"  counts[stack] = (counts[stack] or 0) + samples\n"
+			"end)\n"
+			"return function() profile.stop() return counts end\n";
+
+		if (luaL_loadstring(L, sampler) || lua_pcall(L, 0, 1, 0)) {
+			LOG_W("automation/lua/profile") << "Failed to start sampling profiler: " << get_string_or_default(L, -1);
+			lua_pop(L, 1);
+			return;
+		}
+		if (lua_isfunction(L, -1))
+			stop_sampling = luaL_ref(L, LUA_REGISTRYINDEX);
+		else
+			lua_pop(L, 1);
+	}
+
+	void LuaProfiledRun::StopSampling()
+	{
+		if (stop_sampling == LUA_NOREF) return;
+
+		lua_rawgeti(L, LUA_REGISTRYINDEX, stop_sampling);
+		luaL_unref(L, LUA_REGISTRYINDEX, stop_sampling);
+		if (lua_pcall(L, 0, 1, 0)) {
+			lua_pop(L, 1);
+			return;
+		}
+
+		lua_pushnil(L);
+		while (lua_next(L, -2)) {
+			if (lua_type(L, -2) == LUA_TSTRING)
+				profile.samples[lua_tostring(L, -2)] += lua_tointeger(L, -1);
+			lua_pop(L, 1);
+		}
+		lua_pop(L, 1);
+	}
+
 	class LuaFeature {
 		int myid = 0;
 	protected:
@@ -501,6 +629,9 @@ namespace {
 		wxString help;
 		int cmd_type;
 
+		/// Totals of all of the profiled runs of this macro
+		LuaProfile profile;
+
 	public:
 		LuaCommand(lua_State *L);
 		~LuaCommand();
@@ -517,6 +648,8 @@ namespace {
 		virtual bool IsActive(const agi::Context *c) override;
 
 		static int LuaRegister(lua_State *L);
+
+		LuaProfile const& GetProfile() const { return profile; }
 	};
 
 	class LuaExportFilter final : public ExportFilter, private LuaFeature {
@@ -543,6 +676,15 @@ namespace {
 		std::vector<cmd::Command*> macros;
 		std::vector<std::unique_ptr<ExportFilter>> filters;
 
+		/// Macros created since the last call to RegisterFeatures
+		std::vector<std::unique_ptr<LuaCommand>> pending_macros;
+		/// Export filters created since the last call to RegisterFeatures,
+		/// which are owned by filters
+		std::vector<LuaExportFilter *> pending_filters;
+
+		/// Size of the Lua heap as of the last time it was checked
+		agi::memory::Counter memory{"Automation scripts"};
+
 		/// load script and create internal structures etc.
 		void Create();
 		/// destroy internal structures, unreg features and delete environment
@@ -558,10 +700,20 @@ namespace {
 		void UnregisterCommand(LuaCommand *command);
 		void RegisterFilter(LuaExportFilter *filter);
 
+		/// Queue a feature to be registered by RegisterFeatures
+		void AddPending(std::unique_ptr<LuaCommand> command) { pending_macros.push_back(std::move(command)); }
+		void AddPending(LuaExportFilter *filter) { pending_filters.push_back(filter); }
+
 		static LuaScript* GetScriptObject(lua_State *L);
 
+		/// Report the current size of the Lua heap
+		void UpdateMemoryUsage() {
+			memory.Set(L ? (size_t(lua_gc(L, LUA_GCCOUNT, 0)) << 10) + lua_gc(L, LUA_GCCOUNTB, 0) : 0);
+		}
+
 		// Script implementation
-		void Reload() override { Create(); }
+		void Reload() override { Create(); RegisterFeatures(); }
+		void RegisterFeatures() override;
 
 		std::string GetName() const override { return name; }
 		std::string GetDescription() const override { return description; }
@@ -571,6 +723,7 @@ namespace {
 
 		std::vector<cmd::Command*> GetMacros() const override { return macros; }
 		std::vector<ExportFilter*> GetFilters() const override;
+		std::string GetProfileReport() const override;
 	};
 
 	LuaScript::LuaScript(agi::fs::path const& filename)
@@ -585,6 +738,11 @@ namespace {
 
 		name = GetPrettyFilename().string();
 
+		auto start = std::chrono::steady_clock::now();
+		BOOST_SCOPE_EXIT_ALL(&) {
+			load_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+		};
+
 		// create lua environment
 		L = luaL_newstate();
 		if (!L) {
@@ -631,11 +789,13 @@ namespace {
 
 		// make "aegisub" table
 		lua_pushstring(L, "aegisub");
-		lua_createtable(L, 0, 13);
+		lua_createtable(L, 0, 15);
 
 		set_field<LuaCommand::LuaRegister>(L, "register_macro");
 		set_field<LuaExportFilter::LuaRegister>(L, "register_filter");
 		set_field<lua_text_textents>(L, "text_extents");
+		set_field<lua_text_textents_batch>(L, "text_extents_batch");
+		set_field<LuaKaraskelLayout>(L, "karaskel_layout");
 		set_field<frame_from_ms>(L, "frame_from_ms");
 		set_field<ms_from_frame>(L, "ms_from_frame");
 		set_field<video_size>(L, "video_size");
@@ -705,6 +865,7 @@ namespace {
 		stackcheck.check_stack(0);
 		// if we got this far, the script should be ready
 		loaded = true;
+		UpdateMemoryUsage();
 	}
 
 	void LuaScript::Destroy()
@@ -712,6 +873,11 @@ namespace {
 		// Assume the script object is clean if there's no Lua state
 		if (!L) return;
 
+		// Unregistered macros are just deleted, which removes them from
+		// macros and leaves only the ones which are registered
+		pending_macros.clear();
+		pending_filters.clear();
+
 		// loops backwards because commands remove themselves from macros when
 		// they're unregistered
 		for (int i = macros.size() - 1; i >= 0; --i)
@@ -721,6 +887,7 @@ namespace {
 
 		lua_close(L);
 		L = nullptr;
+		UpdateMemoryUsage();
 	}
 
 	std::vector<ExportFilter*> LuaScript::GetFilters() const
@@ -731,6 +898,20 @@ namespace {
 		return ret;
 	}
 
+	std::string LuaScript::GetProfileReport() const
+	{
+		LuaProfile script_total;
+		std::string macro_reports;
+		for (auto macro : macros) {
+			auto const& profile = static_cast<LuaCommand *>(macro)->GetProfile();
+			if (!profile.runs) continue;
+			script_total.Add(profile);
+			macro_reports += agi::format("\nMacro %s: %s", macro->name(), profile.Report());
+		}
+		if (!script_total.runs) return "";
+		return "All macros: " + script_total.Report() + macro_reports;
+	}
+
 	void LuaScript::RegisterCommand(LuaCommand *command)
 	{
 		for (auto macro : macros) {
@@ -752,6 +933,17 @@ namespace {
 		filters.emplace_back(filter);
 	}
 
+	void LuaScript::RegisterFeatures()
+	{
+		for (auto& command : pending_macros)
+			cmd::reg(std::move(command));
+		pending_macros.clear();
+
+		for (auto filter : pending_filters)
+			AssExportFilterChain::Register(std::unique_ptr<AssExportFilter>(filter));
+		pending_filters.clear();
+	}
+
 	LuaScript* LuaScript::GetScriptObject(lua_State *L)
 	{
 		lua_getfield(L, LUA_REGISTRYINDEX, "aegisub");
@@ -815,6 +1007,7 @@ namespace {
 					lua_remove(L, -nresults - 1);
 
 				lua_gc(L, LUA_GCCOLLECT, 0);
+				LuaScript::GetScriptObject(L)->UpdateMemoryUsage();
 			});
 		} catch (agi::UserCancelException const&) {
 			if (!failed)
@@ -851,12 +1044,8 @@ namespace {
 	// LuaFeatureMacro
 	int LuaCommand::LuaRegister(lua_State *L)
 	{
-		static std::mutex mutex;
 		auto command = agi::make_unique<LuaCommand>(L);
-		{
-			std::lock_guard<std::mutex> lock(mutex);
-			cmd::reg(std::move(command));
-		}
+		LuaScript::GetScriptObject(L)->AddPending(std::move(command));
 		return 0;
 	}
 
@@ -962,11 +1151,14 @@ namespace {
 
 	void LuaCommand::operator()(agi::Context *c)
 	{
+		AGI_TRACE_ZONE("automation", "Run macro");
 		c->textSelectionController->DropStagedChanges();
 		LuaStackcheck stackcheck(L);
 		set_context(L, c);
 		stackcheck.check_stack(0);
 
+		LuaProfiledRun profiled_run(L, profile);
+
 		GetFeatureFunction("run");
 		auto subsobj = new LuaAssFile(L, c->ass.get(), true, true);
 
@@ -1007,7 +1199,7 @@ namespace {
 
 		// top of stack will be selected lines array, if any was returned
 		if (lua_istable(L, -1)) {
-			std::set<AssDialogue*> sel;
+			Selection sel;
 			lua_for_each(L, [&] {
 				if (!lua_isnumber(L, -1))
 					return;
@@ -1126,17 +1318,14 @@ namespace {
 
 	int LuaExportFilter::LuaRegister(lua_State *L)
 	{
-		static std::mutex mutex;
-		auto filter = agi::make_unique<LuaExportFilter>(L);
-		{
-			std::lock_guard<std::mutex> lock(mutex);
-			AssExportFilterChain::Register(std::move(filter));
-		}
+		// The filter is owned by the script, which it adds itself to
+		LuaScript::GetScriptObject(L)->AddPending(new LuaExportFilter(L));
 		return 0;
 	}
 
 	void LuaExportFilter::ProcessSubs(AssFile *subs, wxWindow *export_dialog)
 	{
+		AGI_TRACE_ZONE("automation", "Run export filter");
 		LuaStackcheck stackcheck(L);
 
 		GetFeatureFunction("run");
@@ -1203,9 +1392,114 @@ namespace {
 }
 
 namespace Automation4 {
+	LuaProfile::Scope::Scope(LuaProfile *profile, Api api)
+	: profile(profile)
+	, counter(profile && profile->depth == 0 ? &profile->apis[api] : nullptr)
+	{
+		if (profile) ++profile->depth;
+		if (counter) start = clock::now();
+	}
+
+	LuaProfile::Scope::~Scope()
+	{
+		if (counter) {
+			++counter->calls;
+			counter->time += clock::now() - start;
+		}
+		if (profile) --profile->depth;
+	}
+
+	void LuaProfile::Add(LuaProfile const& other)
+	{
+		runs += other.runs;
+		total += other.total;
+		for (size_t i = 0; i < apis.size(); ++i) {
+			apis[i].calls += other.apis[i].calls;
+			apis[i].time += other.apis[i].time;
+		}
+		for (auto const& sample : other.samples)
+			samples[sample.first] += sample.second;
+	}
+
+	std::string LuaProfile::Report() const
+	{
+		static const char *api_names[] = {
+			"subtitles read",
+			"subtitles write",
+			"text_extents",
+			"parse_karaoke_data",
+			"karaskel_layout",
+			"progress/debug",
+			"commit",
+		};
+		static_assert(sizeof(api_names) / sizeof(*api_names) == API_COUNT, "Missing API name");
+
+		auto ms = [](clock::duration d) {
+			return (long long)std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+		};
+
+		if (!runs) return "";
+
+		std::string ret = agi::format("%d runs, %d ms total\n", runs, ms(total));
+		auto in_lua = total;
+		for (size_t i = 0; i < apis.size(); ++i) {
+			in_lua -= apis[i].time;
+			if (apis[i].calls)
+				ret += agi::format("    %s: %d calls, %d ms\n", api_names[i], apis[i].calls, ms(apis[i].time));
+		}
+		ret += agi::format("    Lua code: %d ms\n", ms(in_lua));
+
+		if (!samples.empty()) {
+			std::vector<std::pair<uint64_t, std::string>> hottest;
+			uint64_t sample_count = 0;
+			for (auto const& sample : samples) {
+				hottest.emplace_back(sample.second, sample.first);
+				sample_count += sample.second;
+			}
+			auto shown = std::min<size_t>(hottest.size(), 10);
+			std::partial_sort(hottest.begin(), hottest.begin() + shown, hottest.end(),
+				[](std::pair<uint64_t, std::string> const& a, std::pair<uint64_t, std::string> const& b) {
+					return a.first > b.first;
+				});
+
+			ret += agi::format("    Hottest of %d samples:\n", sample_count);
+			for (size_t i = 0; i < shown; ++i)
+				ret += agi::format("        %d%%  %s\n", hottest[i].first * 100 / sample_count, hottest[i].second);
+		}
+
+		return ret;
+	}
+
+	LuaProfile *LuaProfile::Get(lua_State *L)
+	{
+		lua_getfield(L, LUA_REGISTRYINDEX, "aegisub profile");
+		auto profile = static_cast<LuaProfile *>(lua_touserdata(L, -1));
+		lua_pop(L, 1);
+		return profile;
+	}
+
+	void LuaProfile::Set(lua_State *L, LuaProfile *profile)
+	{
+		if (profile)
+			lua_pushlightuserdata(L, profile);
+		else
+			lua_pushnil(L);
+		lua_setfield(L, LUA_REGISTRYINDEX, "aegisub profile");
+	}
+
 	LuaScriptFactory::LuaScriptFactory()
 	: ScriptFactory("Lua", "*.lua,*.moon")
+	, cache_option(OPT_SUB("Automation/Cache Compiled Scripts", &LuaScriptFactory::UpdateCacheDirectory, this))
+	{
+		UpdateCacheDirectory();
+	}
+
+	void LuaScriptFactory::UpdateCacheDirectory()
 	{
+		// Set here rather than when loading scripts as they're loaded in parallel
+		SetCacheDirectory(OPT_GET("Automation/Cache Compiled Scripts")->GetBool()
+			? config::path->Decode("?local/automation_cache/")
+			: agi::fs::path());
 	}
 
 	std::unique_ptr<Script> LuaScriptFactory::Produce(agi::fs::path const& filename) const
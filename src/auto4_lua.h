@@ -29,16 +29,92 @@
 
 #include "auto4_base.h"
 
+#include <array>
+#include <chrono>
 #include <deque>
+#include <map>
+#include <unordered_map>
 #include <vector>
 #include <wx/string.h>
 
+class AssDialogue;
 class AssEntry;
 class wxControl;
 class wxWindow;
 struct lua_State;
 
 namespace Automation4 {
+	/// @class LuaProfile
+	/// @brief Time spent in and calls made to the parts of the API which
+	///        cross from Lua into Aegisub while running a macro
+	///
+	/// While profiling is enabled the profile for the current run is stored
+	/// in the Lua registry, and the API functions time themselves against it.
+	class LuaProfile {
+	public:
+		enum Api {
+			SUBS_READ,     ///< Reading lines from the subtitles object
+			SUBS_WRITE,    ///< Assigning, inserting, appending and deleting lines
+			TEXT_EXTENTS,  ///< aegisub.text_extents
+			PARSE_KARAOKE, ///< aegisub.parse_karaoke_data
+			KARASKEL,      ///< aegisub.karaskel_layout
+			PROGRESS,      ///< aegisub.progress and aegisub.debug
+			COMMIT,        ///< Applying the changes to the file after the macro finishes
+			API_COUNT
+		};
+
+		typedef std::chrono::steady_clock clock;
+
+		struct Counter {
+			uint64_t calls = 0;
+			clock::duration time = clock::duration::zero();
+		};
+
+		/// Times a single call to an API for as long as it's alive
+		class Scope {
+			LuaProfile *profile;
+			Counter *counter;
+			clock::time_point start;
+		public:
+			/// @param profile Profile to record to; does nothing if null
+			Scope(LuaProfile *profile, Api api);
+			/// Record to the profile of the macro running in the given state
+			Scope(lua_State *L, Api api) : Scope(Get(L), api) { }
+			~Scope();
+		};
+
+		/// Number of runs included
+		int runs = 0;
+		/// Wall-clock time of the runs, including the time spent in the APIs
+		clock::duration total = clock::duration::zero();
+		std::array<Counter, API_COUNT> apis;
+		/// Number of samples taken at each stack by the sampling profiler
+		std::map<std::string, uint64_t> samples;
+
+		/// Number of Scopes currently alive; only the outermost is recorded
+		/// so that APIs implemented in terms of each other aren't counted twice
+		int depth = 0;
+
+		/// Add another profile's numbers to this one
+		void Add(LuaProfile const& other);
+
+		/// Get a description of the profile for showing to the user
+		std::string Report() const;
+
+		/// Get the profile of the macro running in the given state, or
+		/// nullptr if the macro isn't being profiled
+		static LuaProfile *Get(lua_State *L);
+		/// Set the profile which API calls should be recorded to
+		static void Set(lua_State *L, LuaProfile *profile);
+	};
+
+	/// Lua function aegisub.karaskel_layout(line, style, furistyle, x_correct_factor)
+	///
+	/// Does everything karaskel.preproc_line_text and preproc_line_size do to
+	/// a line in one call, measuring all of the text in a single batch per
+	/// style. furistyle may be false if the line has no furigana style.
+	int LuaKaraskelLayout(lua_State *L);
+
 	/// @class LuaAssFile
 	/// @brief Object wrapping an AssFile object for modification through Lua
 	class LuaAssFile {
@@ -54,6 +130,9 @@ namespace Automation4 {
 		/// Lua state the object exists in
 		lua_State *L;
 
+		/// Profile which calls to the object are recorded to, if any
+		LuaProfile *profile;
+
 		/// Is the feature this object is created for read-only?
 		bool can_modify;
 		/// Is the feature allowed to set undo points?
@@ -80,12 +159,23 @@ namespace Automation4 {
 		std::vector<std::unique_ptr<AssEntry>> lines_to_delete;
 		/// Lines that were allocated here and need to be deleted if the script is cancelled.
 		std::vector<AssEntry *> allocated_lines;
+		/// Copies of dialogue lines made by ObjectSetColumns, mapped to the line
+		/// they stand in for. Only the timing, layer and style of a copy
+		/// differ from that line, and committing copies them back into it
+		/// rather than replacing it, so the commit is just a change to the
+		/// lines' fields.
+		std::unordered_map<const AssEntry *, AssDialogue *> retimed_lines;
+		/// Owner of the copies in retimed_lines
+		std::vector<std::unique_ptr<AssDialogue>> retimed_copies;
 
 		/// Create copies of all of the lines in the script info section if it
 		/// hasn't already happened. This is done lazily, since it only needs
 		/// to happen when the user modifies the headers in some way, which
 		/// most runs of a script will not do.
 		void InitScriptInfoIfNeeded();
+		/// Get the line which the entry in lines stands in for, which is the
+		/// entry itself unless it's a copy made by ObjectSetColumns
+		AssEntry *SourceLine(AssEntry *e) const;
 		/// Add the line at the given index to the list of lines to be deleted
 		/// when the script completes, unless it's an AssInfo, since those are
 		/// owned by the container.
@@ -93,6 +183,11 @@ namespace Automation4 {
 		/// Set the line at the index to the given value
 		void AssignLine(size_t idx, std::unique_ptr<AssEntry> e);
 		void InsertLine(std::vector<AssEntry *> &vec, size_t idx, std::unique_ptr<AssEntry> e);
+		/// Replace the lines in [first, last) with the given lines in a
+		/// single pass over the file
+		void ReplaceLines(size_t first, size_t last, std::vector<AssEntry *> const& new_entries);
+		/// Convert the array of lines at the given stack index
+		std::vector<AssEntry *> ReadLineArray(lua_State *L, int idx);
 
 		int ObjectIndexRead(lua_State *L);
 		void ObjectIndexWrite(lua_State *L);
@@ -101,10 +196,35 @@ namespace Automation4 {
 		void ObjectDeleteRange(lua_State *L);
 		void ObjectAppend(lua_State *L);
 		void ObjectInsert(lua_State *L);
+		void ObjectInsertRange(lua_State *L);
+		void ObjectReplaceRange(lua_State *L);
 		void ObjectGarbageCollect(lua_State *L);
 		int ObjectIPairs(lua_State *L);
 		int IterNext(lua_State *L);
 
+		/// Push a proxy for a dialogue line which reads fields from the line
+		/// as they're used rather than copying them all up front, for
+		/// scripts which only look at a few fields of each line. Assigning
+		/// the proxy back to the file only reads the fields which were
+		/// assigned to.
+		int ObjectGetProxy(lua_State *L);
+		static int ProxyIndex(lua_State *L);
+		static int ProxyNewIndex(lua_State *L);
+
+		/// Push a buffer with the index, start time, end time, layer and
+		/// style of every dialogue line in contiguous arrays, followed by the
+		/// number of dialogue lines and a table of style names which the
+		/// style indices refer to. aegisub.columns wraps this in FFI arrays.
+		int ObjectGetColumns(lua_State *L);
+		/// Apply the changes made to a buffer from ObjectGetColumns to the
+		/// lines, as a change to just their timing, layer and style
+		void ObjectSetColumns(lua_State *L);
+
+		/// Push a table of the extradata of a line
+		void PushExtradata(lua_State *L, const AssDialogue *dia);
+		/// Read the extradata field of the table on the top of the stack into a line
+		static void ReadExtradata(lua_State *L, AssFile *ass, AssDialogue *dia);
+
 		int LuaParseKaraokeData(lua_State *L);
 		int LuaGetScriptResolution(lua_State *L);
 
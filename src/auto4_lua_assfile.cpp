@@ -128,6 +128,68 @@ namespace {
 	const T *check_cast_constptr(const U *value) {
 		return typeid(const T) == typeid(*value) ? static_cast<const T *>(value) : nullptr;
 	}
+
+	/// Name of the metatable shared by all line proxies
+	const char *line_proxy_type = "aegisub.LineProxy";
+
+	/// Contents of a line proxy userdata. The userdata's environment table
+	/// holds the subtitles object at index 1, which keeps the line alive,
+	/// and every field which has been assigned to by the script.
+	struct LineProxy {
+		const AssDialogue *line;
+	};
+
+	const char *columns_type = "aegisub.Columns";
+
+	/// Size of each line's part of a columns buffer. The buffer starts with
+	/// the lines' entries, so that the lines can be checked for having been
+	/// replaced when it's applied, followed by an int32_t array per column.
+	const size_t column_row_size = sizeof(AssEntry *) + 5 * sizeof(int32_t);
+
+	/// Get the line proxy at the given stack index, or nullptr if the value
+	/// there isn't one
+	LineProxy *test_line_proxy(lua_State *L, int idx)
+	{
+		if (lua_type(L, idx) != LUA_TUSERDATA || !lua_getmetatable(L, idx))
+			return nullptr;
+		luaL_getmetatable(L, line_proxy_type);
+		bool is_proxy = !!lua_rawequal(L, -1, -2);
+		lua_pop(L, 2);
+		return is_proxy ? static_cast<LineProxy *>(lua_touserdata(L, idx)) : nullptr;
+	}
+
+	/// Push the named field of a dialogue line, with the same values as the
+	/// table representation has
+	/// @return Was there a field with that name
+	bool push_dialogue_field(lua_State *L, const AssDialogue *dia, const char *name)
+	{
+		if (!strcmp(name, "text"))            push_value(L, std::string(dia->Text));
+		else if (!strcmp(name, "start_time")) push_value(L, dia->Start);
+		else if (!strcmp(name, "end_time"))   push_value(L, dia->End);
+		else if (!strcmp(name, "style"))      push_value(L, std::string(dia->Style));
+		else if (!strcmp(name, "actor"))      push_value(L, std::string(dia->Actor));
+		else if (!strcmp(name, "effect"))     push_value(L, std::string(dia->Effect));
+		else if (!strcmp(name, "comment"))    push_value(L, dia->Comment);
+		else if (!strcmp(name, "layer"))      push_value(L, dia->Layer);
+		else if (!strcmp(name, "margin_l"))   push_value(L, dia->Margin[0]);
+		else if (!strcmp(name, "margin_r"))   push_value(L, dia->Margin[1]);
+		else if (!strcmp(name, "margin_t"))   push_value(L, dia->Margin[2]);
+		else if (!strcmp(name, "margin_b"))   push_value(L, dia->Margin[2]);
+		else if (!strcmp(name, "class"))      push_value(L, "dialogue");
+		else if (!strcmp(name, "section"))    push_value(L, dia->GroupHeader());
+		else if (!strcmp(name, "raw"))        push_value(L, dia->GetEntryData());
+		else return false;
+		return true;
+	}
+
+	/// Is the named field present in the table on the top of the stack?
+	bool has_field(lua_State *L, const char *name)
+	{
+		lua_getfield(L, -1, name);
+		bool present = !lua_isnil(L, -1);
+		lua_pop(L, 1);
+		return present;
+	}
 }
 
 namespace Automation4 {
@@ -181,13 +243,7 @@ namespace Automation4 {
 
 			set_field(L, "text", std::string(dia->Text));
 
-			// create extradata table
-			lua_newtable(L);
-			for (auto const& ed : ass->GetExtradata(dia->ExtradataIds)) {
-				push_value(L, ed.key);
-				push_value(L, ed.value);
-				lua_settable(L, -3);
-			}
+			PushExtradata(L, dia);
 			lua_setfield(L, -2, "extra");
 
 			set_field(L, "class", "dialogue");
@@ -243,6 +299,29 @@ namespace Automation4 {
 		// assume an assentry table is on the top of the stack
 		// convert it to a real AssEntry object, and pop the table from the stack
 
+		if (auto proxy = test_line_proxy(L, -1)) {
+			// Start from the proxied line and read back only the fields
+			// which the script has assigned to
+			assert(ass != 0);
+			auto dia = new AssDialogue(*proxy->line);
+			std::unique_ptr<AssEntry> result(dia);
+			lua_getfenv(L, -1);
+			if (has_field(L, "comment"))    dia->Comment = get_bool_field(L, "comment", "dialogue");
+			if (has_field(L, "layer"))      dia->Layer = get_int_field(L, "layer", "dialogue");
+			if (has_field(L, "start_time")) dia->Start = get_int_field(L, "start_time", "dialogue");
+			if (has_field(L, "end_time"))   dia->End = get_int_field(L, "end_time", "dialogue");
+			if (has_field(L, "style"))      dia->Style = get_string_field(L, "style", "dialogue");
+			if (has_field(L, "actor"))      dia->Actor = get_string_field(L, "actor", "dialogue");
+			if (has_field(L, "margin_l"))   dia->Margin[0] = get_int_field(L, "margin_l", "dialogue");
+			if (has_field(L, "margin_r"))   dia->Margin[1] = get_int_field(L, "margin_r", "dialogue");
+			if (has_field(L, "margin_t"))   dia->Margin[2] = get_int_field(L, "margin_t", "dialogue");
+			if (has_field(L, "effect"))     dia->Effect = get_string_field(L, "effect", "dialogue");
+			if (has_field(L, "text"))       dia->Text = get_string_field(L, "text", "dialogue");
+			if (has_field(L, "extra"))      ReadExtradata(L, ass, dia);
+			lua_pop(L, 1);
+			return result;
+		}
+
 		if (!lua_istable(L, -1))
 			error(L, "Can't convert a non-table value to AssEntry");
 
@@ -301,24 +380,7 @@ namespace Automation4 {
 			dia->Margin[2] = get_int_field(L, "margin_t", "dialogue");
 			dia->Effect = get_string_field(L, "effect", "dialogue");
 			dia->Text = get_string_field(L, "text", "dialogue");
-
-			std::vector<uint32_t> new_ids;
-
-			lua_getfield(L, -1, "extra");
-			auto type = lua_type(L, -1);
-			if (type == LUA_TTABLE) {
-				lua_for_each(L, [&] {
-					if (lua_type(L, -2) != LUA_TSTRING) return;
-					new_ids.push_back(ass->AddExtradata(
-						get_string_or_default(L, -2),
-						get_string_or_default(L, -1)));
-				});
-				std::sort(begin(new_ids), end(new_ids));
-				dia->ExtradataIds = std::move(new_ids);
-			}
-			else if (type != LUA_TNIL) {
-				error(L, "dialogue extradata must be a table");
-			}
+			ReadExtradata(L, ass, dia);
 		}
 		else {
 			error(L, "Found line with unknown class: %s", lclass.c_str());
@@ -328,6 +390,224 @@ namespace Automation4 {
 		return result;
 	}
 
+	void LuaAssFile::ReadExtradata(lua_State *L, AssFile *ass, AssDialogue *dia)
+	{
+		std::vector<uint32_t> new_ids;
+
+		lua_getfield(L, -1, "extra");
+		auto type = lua_type(L, -1);
+		if (type == LUA_TTABLE) {
+			lua_for_each(L, [&] {
+				if (lua_type(L, -2) != LUA_TSTRING) return;
+				new_ids.push_back(ass->AddExtradata(
+					get_string_or_default(L, -2),
+					get_string_or_default(L, -1)));
+			});
+			std::sort(begin(new_ids), end(new_ids));
+			dia->ExtradataIds = std::move(new_ids);
+		}
+		else if (type != LUA_TNIL) {
+			error(L, "dialogue extradata must be a table");
+		}
+		else
+			lua_pop(L, 1);
+	}
+
+	void LuaAssFile::PushExtradata(lua_State *L, const AssDialogue *dia)
+	{
+		lua_newtable(L);
+		for (auto const& ed : ass->GetExtradata(dia->ExtradataIds)) {
+			push_value(L, ed.key);
+			push_value(L, ed.value);
+			lua_settable(L, -3);
+		}
+	}
+
+	int LuaAssFile::ObjectGetProxy(lua_State *L)
+	{
+		LuaProfile::Scope timer(profile, LuaProfile::SUBS_READ);
+		int idx = check_int(L, 1);
+		CheckBounds(idx);
+
+		// Only dialogue lines are worth proxying, so everything else just
+		// gets the normal table
+		const AssEntry *e = lines[idx - 1];
+		auto dia = e ? check_cast_constptr<AssDialogue>(e) : nullptr;
+		if (!dia) {
+			AssEntryToLua(L, idx - 1);
+			return 1;
+		}
+
+		static_cast<LineProxy *>(lua_newuserdata(L, sizeof(LineProxy)))->line = dia;
+
+		if (luaL_newmetatable(L, line_proxy_type)) {
+			set_field<ProxyIndex>(L, "__index");
+			set_field<ProxyNewIndex>(L, "__newindex");
+		}
+		lua_setmetatable(L, -2);
+
+		lua_createtable(L, 1, 0);
+		lua_pushvalue(L, lua_upvalueindex(1));
+		lua_rawseti(L, -2, 1);
+		lua_setfenv(L, -2);
+		return 1;
+	}
+
+	int LuaAssFile::ProxyIndex(lua_State *L)
+	{
+		auto proxy = static_cast<LineProxy *>(lua_touserdata(L, 1));
+		lua_getfenv(L, 1);
+		lua_rawgeti(L, -1, 1);
+		auto laf = GetObjPointer(L, -1, false);
+		lua_pop(L, 1);
+
+		if (lua_type(L, 2) != LUA_TSTRING)
+			return error(L, "Attempt to index a subtitle line with value of type '%s'.", lua_typename(L, lua_type(L, 2)));
+
+		// Fields which have been assigned to take priority over the line
+		lua_pushvalue(L, 2);
+		lua_rawget(L, -2);
+		if (!lua_isnil(L, -1))
+			return 1;
+		lua_pop(L, 1);
+
+		const char *name = lua_tostring(L, 2);
+		if (push_dialogue_field(L, proxy->line, name))
+			return 1;
+
+		if (!strcmp(name, "extra")) {
+			// The script may modify the table in place, so it's stored like
+			// an assigned field to be read back from
+			laf->PushExtradata(L, proxy->line);
+			lua_pushvalue(L, -1);
+			lua_setfield(L, -3, "extra");
+			return 1;
+		}
+
+		lua_pushnil(L);
+		return 1;
+	}
+
+	int LuaAssFile::ProxyNewIndex(lua_State *L)
+	{
+		lua_getfenv(L, 1);
+		lua_rawgeti(L, -1, 1);
+		GetObjPointer(L, -1, false);
+		lua_pop(L, 1);
+
+		if (lua_type(L, 2) != LUA_TSTRING)
+			return error(L, "Attempt to index a subtitle line with value of type '%s'.", lua_typename(L, lua_type(L, 2)));
+
+		lua_pushvalue(L, 2);
+		lua_pushvalue(L, 3);
+		lua_rawset(L, -3);
+		return 0;
+	}
+
+	int LuaAssFile::ObjectGetColumns(lua_State *L)
+	{
+		LuaProfile::Scope timer(profile, LuaProfile::SUBS_READ);
+
+		// Styles are numbered in file order, followed by any names used by
+		// lines which don't have a style
+		std::vector<agi::Interned<std::string>> styles;
+		std::unordered_map<std::string, int32_t> style_ids;
+		auto style_id = [&](agi::Interned<std::string> const& name) {
+			auto it = style_ids.emplace(name.get(), (int32_t)styles.size() + 1);
+			if (it.second)
+				styles.push_back(name);
+			return it.first->second;
+		};
+
+		std::vector<size_t> rows;
+		for (size_t i = 0; i < lines.size(); ++i) {
+			if (!lines[i]) continue;
+			if (auto style = check_cast_constptr<AssStyle>(lines[i]))
+				style_id(agi::Interned<std::string>(style->name));
+			else if (check_cast_constptr<AssDialogue>(lines[i]))
+				rows.push_back(i);
+		}
+
+		const size_t n = rows.size();
+		auto entries = static_cast<AssEntry **>(lua_newuserdata(L, n * column_row_size));
+		auto columns = reinterpret_cast<int32_t *>(entries + n);
+		for (size_t i = 0; i < n; ++i) {
+			auto dia = static_cast<AssDialogue *>(lines[rows[i]]);
+			entries[i] = dia;
+			columns[i] = rows[i] + 1;
+			columns[n + i] = dia->Start;
+			columns[2 * n + i] = dia->End;
+			columns[3 * n + i] = dia->Layer;
+			columns[4 * n + i] = style_id(dia->Style);
+		}
+
+		luaL_newmetatable(L, columns_type);
+		lua_setmetatable(L, -2);
+
+		push_value(L, n);
+
+		lua_createtable(L, styles.size(), 0);
+		for (size_t i = 0; i < styles.size(); ++i) {
+			push_value(L, styles[i].get());
+			lua_rawseti(L, -2, i + 1);
+		}
+		return 3;
+	}
+
+	void LuaAssFile::ObjectSetColumns(lua_State *L)
+	{
+		LuaProfile::Scope timer(profile, LuaProfile::SUBS_WRITE);
+		CheckAllowModify();
+
+		auto entries = static_cast<AssEntry **>(check_udata(L, 1, columns_type));
+		const size_t n = lua_objlen(L, 1) / column_row_size;
+		auto columns = reinterpret_cast<int32_t *>(entries + n);
+
+		argcheck(L, lua_istable(L, 2), 2, "must be a table of style names");
+		std::vector<agi::Interned<std::string>> styles;
+		for (size_t i = 1, count = lua_objlen(L, 2); i <= count; ++i) {
+			lua_rawgeti(L, 2, i);
+			argcheck(L, lua_isstring(L, -1), 2, "style names must be strings");
+			styles.emplace_back(std::string(lua_tostring(L, -1)));
+			lua_pop(L, 1);
+		}
+
+		// Check everything before changing anything so that an error doesn't
+		// leave half of the changes applied
+		for (size_t i = 0; i < n; ++i) {
+			size_t row = columns[i];
+			if (row < 1 || row > lines.size() || lines[row - 1] != entries[i])
+				error(L, "The subtitles have been changed since the columns were read");
+			size_t style = columns[4 * n + i];
+			argcheck(L, style >= 1 && style <= styles.size(), 2, "Out of range style index");
+		}
+
+		for (size_t i = 0; i < n; ++i) {
+			auto dia = static_cast<AssDialogue *>(entries[i]);
+			const int start = columns[n + i], end = columns[2 * n + i], layer = columns[3 * n + i];
+			auto const& style = styles[columns[4 * n + i] - 1];
+
+			const bool time_changed = start != dia->Start || end != dia->End;
+			const bool meta_changed = layer != dia->Layer || style != dia->Style;
+			if (!time_changed && !meta_changed) continue;
+
+			// Copying the base keeps the line's Id, so the copy is the same
+			// line as far as the commit is concerned
+			auto copy = agi::make_unique<AssDialogue>(static_cast<AssDialogueBase const&>(*dia));
+			copy->Start = start;
+			copy->End = end;
+			copy->Layer = layer;
+			copy->Style = style;
+
+			retimed_lines[copy.get()] = static_cast<AssDialogue *>(SourceLine(dia));
+			entries[i] = lines[columns[i] - 1] = copy.get();
+			retimed_copies.push_back(std::move(copy));
+
+			if (time_changed) modification_type |= AssFile::COMMIT_DIAG_TIME;
+			if (meta_changed) modification_type |= AssFile::COMMIT_DIAG_META;
+		}
+	}
+
 	std::unique_ptr<AssEntry> LuaAssFile::LuaToTrackedAssEntry(lua_State *L) {
 		std::unique_ptr<AssEntry> e = LuaToAssEntry(L, ass);
 		allocated_lines.push_back(e.get());
@@ -340,6 +620,7 @@ namespace Automation4 {
 			case LUA_TNUMBER:
 			{
 				// read an indexed AssEntry
+				LuaProfile::Scope timer(profile, LuaProfile::SUBS_READ);
 				int idx = lua_tointeger(L, 2);
 				CheckBounds(idx);
 				AssEntryToLua(L, idx - 1);
@@ -364,8 +645,18 @@ namespace Automation4 {
 					lua_pushcclosure(L, closure_wrapper_v<&LuaAssFile::ObjectDeleteRange, false>, 1);
 				else if (strcmp(idx, "insert") == 0)
 					lua_pushcclosure(L, closure_wrapper_v<&LuaAssFile::ObjectInsert, false>, 1);
+				else if (strcmp(idx, "insertrange") == 0)
+					lua_pushcclosure(L, closure_wrapper_v<&LuaAssFile::ObjectInsertRange, false>, 1);
+				else if (strcmp(idx, "replacerange") == 0)
+					lua_pushcclosure(L, closure_wrapper_v<&LuaAssFile::ObjectReplaceRange, false>, 1);
 				else if (strcmp(idx, "append") == 0)
 					lua_pushcclosure(L, closure_wrapper_v<&LuaAssFile::ObjectAppend, false>, 1);
+				else if (strcmp(idx, "proxy") == 0)
+					lua_pushcclosure(L, closure_wrapper<&LuaAssFile::ObjectGetProxy>, 1);
+				else if (strcmp(idx, "columns") == 0)
+					lua_pushcclosure(L, closure_wrapper<&LuaAssFile::ObjectGetColumns>, 1);
+				else if (strcmp(idx, "set_columns") == 0)
+					lua_pushcclosure(L, closure_wrapper_v<&LuaAssFile::ObjectSetColumns, false>, 1);
 				else if (strcmp(idx, "script_resolution") == 0)
 					lua_pushcclosure(L, closure_wrapper<&LuaAssFile::LuaGetScriptResolution>, 1);
 				else {
@@ -400,12 +691,18 @@ namespace Automation4 {
 		script_info_copied = true;
 	}
 
+	AssEntry *LuaAssFile::SourceLine(AssEntry *e) const
+	{
+		auto it = retimed_lines.find(e);
+		return it == retimed_lines.end() ? e : it->second;
+	}
+
 	void LuaAssFile::QueueLineForDeletion(size_t idx)
 	{
 		if (!lines[idx] || lines[idx]->Group() == AssEntryGroup::INFO)
 			InitScriptInfoIfNeeded();
 		else
-			lines_to_delete.emplace_back(lines[idx]);
+			lines_to_delete.emplace_back(SourceLine(lines[idx]));
 	}
 
 	void LuaAssFile::AssignLine(size_t idx, std::unique_ptr<AssEntry> e)
@@ -434,6 +731,7 @@ namespace Automation4 {
 
 	void LuaAssFile::ObjectIndexWrite(lua_State *L)
 	{
+		LuaProfile::Scope timer(profile, LuaProfile::SUBS_WRITE);
 		// instead of implementing everything twice, just call the other modification-functions from here
 		// after modifying the stack to match their expectations
 
@@ -481,6 +779,7 @@ namespace Automation4 {
 
 	void LuaAssFile::ObjectDelete(lua_State *L)
 	{
+		LuaProfile::Scope timer(profile, LuaProfile::SUBS_WRITE);
 		CheckAllowModify();
 
 		// get number of items to delete
@@ -507,6 +806,7 @@ namespace Automation4 {
 		}
 
 		sort(ids.begin(), ids.end());
+		ids.erase(unique(ids.begin(), ids.end()), ids.end());
 
 		size_t id_idx = 0, out = 0;
 		for (size_t i = 0; i < lines.size(); ++i) {
@@ -525,6 +825,7 @@ namespace Automation4 {
 
 	void LuaAssFile::ObjectDeleteRange(lua_State *L)
 	{
+		LuaProfile::Scope timer(profile, LuaProfile::SUBS_WRITE);
 		CheckAllowModify();
 
 		size_t a = std::max<size_t>(check_uint(L, 1), 1) - 1;
@@ -532,16 +833,86 @@ namespace Automation4 {
 
 		if (a >= b) return;
 
-		for (size_t i = a; i < b; ++i) {
+		ReplaceLines(a, b, {});
+	}
+
+	void LuaAssFile::ReplaceLines(size_t first, size_t last, std::vector<AssEntry *> const& new_entries)
+	{
+		for (size_t i = first; i < last; ++i) {
 			modification_type |= modification_mask(lines[i]);
 			QueueLineForDeletion(i);
 		}
 
-		lines.erase(lines.begin() + a, lines.begin() + b);
+		// Overwrite the lines being replaced in place, so that the tail of
+		// the file only has to be shifted once to open or close the gap
+		const size_t overlap = std::min(last - first, new_entries.size());
+		std::copy(new_entries.begin(), new_entries.begin() + overlap, lines.begin() + first);
+		if (overlap < last - first)
+			lines.erase(lines.begin() + first + overlap, lines.begin() + last);
+		else
+			lines.insert(lines.begin() + last, new_entries.begin() + overlap, new_entries.end());
+	}
+
+	std::vector<AssEntry *> LuaAssFile::ReadLineArray(lua_State *L, int idx)
+	{
+		if (!lua_istable(L, idx))
+			error(L, "Expected a table of subtitle lines");
+
+		std::vector<AssEntry *> new_entries;
+		const size_t count = lua_objlen(L, idx);
+		new_entries.reserve(count);
+		for (size_t i = 1; i <= count; ++i) {
+			lua_rawgeti(L, idx, i);
+			auto e = LuaToTrackedAssEntry(L);
+			modification_type |= modification_mask(e.get());
+			InsertLine(new_entries, new_entries.size(), std::move(e));
+			lua_pop(L, 1);
+		}
+		return new_entries;
+	}
+
+	void LuaAssFile::ObjectInsertRange(lua_State *L)
+	{
+		LuaProfile::Scope timer(profile, LuaProfile::SUBS_WRITE);
+		CheckAllowModify();
+
+		size_t before = check_uint(L, 1);
+		argcheck(L, before > 0 && before <= lines.size() + 1, 1,
+			"Out of range line index");
+
+		if (before == lines.size() + 1) {
+			// Match insert(), which appends each line to its section
+			if (!lua_istable(L, 2))
+				error(L, "Expected a table of subtitle lines");
+			const int count = lua_objlen(L, 2);
+			lua_settop(L, 2);
+			for (int i = 1; i <= count; ++i)
+				lua_rawgeti(L, 2, i);
+			lua_remove(L, 1);
+			lua_remove(L, 1);
+			ObjectAppend(L);
+			return;
+		}
+
+		ReplaceLines(before - 1, before - 1, ReadLineArray(L, 2));
+	}
+
+	void LuaAssFile::ObjectReplaceRange(lua_State *L)
+	{
+		LuaProfile::Scope timer(profile, LuaProfile::SUBS_WRITE);
+		CheckAllowModify();
+
+		size_t a = std::max<size_t>(check_uint(L, 1), 1) - 1;
+		size_t b = std::min<size_t>(check_uint(L, 2), lines.size());
+		argcheck(L, a <= lines.size(), 1, "Out of range line index");
+		b = std::max(a, b);
+
+		ReplaceLines(a, b, ReadLineArray(L, 3));
 	}
 
 	void LuaAssFile::ObjectAppend(lua_State *L)
 	{
+		LuaProfile::Scope timer(profile, LuaProfile::SUBS_WRITE);
 		CheckAllowModify();
 
 		int n = lua_gettop(L);
@@ -573,6 +944,7 @@ namespace Automation4 {
 
 	void LuaAssFile::ObjectInsert(lua_State *L)
 	{
+		LuaProfile::Scope timer(profile, LuaProfile::SUBS_WRITE);
 		CheckAllowModify();
 
 		size_t before = check_uint(L, 1);
@@ -597,7 +969,7 @@ namespace Automation4 {
 			InsertLine(new_entries, i - 2, std::move(e));
 			lua_pop(L, 1);
 		}
-		lines.insert(lines.begin() + before - 1, new_entries.begin(), new_entries.end());
+		ReplaceLines(before - 1, before - 1, new_entries);
 	}
 
 	void LuaAssFile::ObjectGarbageCollect(lua_State *L)
@@ -618,6 +990,7 @@ namespace Automation4 {
 
 	int LuaAssFile::IterNext(lua_State *L)
 	{
+		LuaProfile::Scope timer(profile, LuaProfile::SUBS_READ);
 		size_t i = check_uint(L, 2);
 		if (i >= lines.size()) {
 			lua_pushnil(L);
@@ -631,6 +1004,7 @@ namespace Automation4 {
 
 	int LuaAssFile::LuaParseKaraokeData(lua_State *L)
 	{
+		LuaProfile::Scope timer(profile, LuaProfile::PARSE_KARAOKE);
 		auto e = LuaToAssEntry(L, ass);
 		auto dia = check_cast_constptr<AssDialogue>(e.get());
 		argcheck(L, !!dia, 1, "Subtitle line must be a dialogue line");
@@ -701,6 +1075,20 @@ namespace Automation4 {
 
 	std::vector<AssEntry *> LuaAssFile::ProcessingComplete(wxString const& undo_description)
 	{
+		LuaProfile::Scope timer(profile, LuaProfile::COMMIT);
+		// Copy the fields which may differ from a retimed copy into the line
+		// it stands in for, so the file keeps the same line objects
+		auto file_line = [&](AssEntry *line) -> AssDialogue& {
+			auto dia = static_cast<AssDialogue *>(line);
+			auto it = retimed_lines.find(line);
+			if (it == retimed_lines.end())
+				return *dia;
+			it->second->Start = dia->Start;
+			it->second->End = dia->End;
+			it->second->Layer = dia->Layer;
+			it->second->Style = dia->Style;
+			return *it->second;
+		};
 		auto apply_lines = [&](std::vector<AssEntry *> const& lines) {
 			if (script_info_copied)
 				ass->Info.clear();
@@ -712,7 +1100,7 @@ namespace Automation4 {
 				switch (line->Group()) {
 					case AssEntryGroup::INFO:     ass->Info.push_back(*static_cast<AssInfo *>(line)); break;
 					case AssEntryGroup::STYLE:    ass->Styles.push_back(*static_cast<AssStyle *>(line)); break;
-					case AssEntryGroup::DIALOGUE: ass->Events.push_back(*static_cast<AssDialogue *>(line)); break;
+					case AssEntryGroup::DIALOGUE: ass->Events.push_back(file_line(line)); break;
 					default: break;
 				}
 			}
@@ -732,6 +1120,12 @@ namespace Automation4 {
 		lines_to_delete.clear();
 
 		auto ret = std::move(lines);
+		for (auto& line : ret) {
+			if (line)
+				line = SourceLine(line);
+		}
+		retimed_lines.clear();
+		retimed_copies.clear();
 		references--;
 		if (!references) delete this;
 		return ret;
@@ -748,6 +1142,7 @@ namespace Automation4 {
 	LuaAssFile::LuaAssFile(lua_State *L, AssFile *ass, bool can_modify, bool can_set_undo)
 	: ass(ass)
 	, L(L)
+	, profile(LuaProfile::Get(L))
 	, can_modify(can_modify)
 	, can_set_undo(can_set_undo)
 	{
@@ -36,7 +36,10 @@
 
 namespace Automation4 {
 	class LuaScriptFactory final : public ScriptFactory {
+		agi::signal::Connection cache_option;
+
 		std::unique_ptr<Script> Produce(agi::fs::path const& filename) const override;
+		void UpdateCacheDirectory();
 	public:
 		LuaScriptFactory();
 	};
@@ -0,0 +1,405 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file auto4_lua_karaskel.cpp
+/// @brief Native implementation of karaskel's line preprocessing
+/// @ingroup scripting
+///
+
+#include "auto4_lua.h"
+
+#include "ass_dialogue.h"
+#include "ass_karaoke.h"
+#include "ass_style.h"
+
+#include <libaegisub/lua/utils.h>
+
+#include <algorithm>
+#include <boost/algorithm/string/replace.hpp>
+#include <typeinfo>
+
+using namespace agi::lua;
+
+namespace {
+	struct Highlight {
+		int start_time;
+		int end_time;
+		int duration;
+	};
+
+	/// A furigana part, as set up by karaskel.preproc_line_text
+	struct Furigana {
+		size_t syl; ///< Index of the syllable this is attached to
+		size_t highlight; ///< Index of this part's highlight in the syllable
+		Highlight hl;
+		std::string tag;
+		std::string text;
+		std::string inline_fx;
+		bool isbreak;
+		bool spillback;
+		Automation4::TextExtents extents;
+	};
+
+	/// An output syllable, which may be made up of several highlights
+	struct Syllable {
+		bool has_text = false;
+		std::string text;
+		std::string tag;
+		std::string text_stripped;
+		std::string text_spacestripped;
+		std::string prespace;
+		std::string postspace;
+		std::string inline_fx;
+		int start_time = 0;
+		int end_time = 0;
+		int duration = 0;
+		double kdur = 0;
+		std::vector<Highlight> highlights;
+		std::vector<size_t> furi;
+		Automation4::TextExtents extents;
+		double prespacewidth = 0;
+		double postspacewidth = 0;
+	};
+
+	/// Number of bytes in the UTF-8 character at the start of str, matching
+	/// unicode.charwidth
+	size_t char_width(std::string const& str) {
+		const unsigned char b = str.empty() ? 0 : str[0];
+		if (b < 128) return 1;
+		if (b < 224) return 2;
+		if (b < 240) return 3;
+		return 4;
+	}
+
+	std::string first_char(std::string const& str) {
+		return str.substr(0, char_width(str));
+	}
+
+	/// The last inline-fx name in the syllable text, as matched by the Lua
+	/// pattern "%{.*\\%-([^}\\]+)"
+	bool find_inline_fx(std::string const& text, std::string &fx) {
+		const size_t brace = text.find('{');
+		if (brace == std::string::npos) return false;
+		for (size_t i = text.size(); i > brace + 1; --i) {
+			const size_t pos = i - 1;
+			if (pos + 2 >= text.size() || text[pos] != '\\' || text[pos + 1] != '-') continue;
+			const size_t end = text.find_first_of("}\\", pos + 2);
+			if (end == pos + 2) continue;
+			fx = text.substr(pos + 2, end == std::string::npos ? std::string::npos : end - pos - 2);
+			return true;
+		}
+		return false;
+	}
+
+	/// Split leading and trailing spaces and tabs off of text
+	void split_spaces(std::string const& text, std::string &prespace, std::string &syltext, std::string &postspace) {
+		const size_t first = text.find_first_not_of(" \t");
+		if (first == std::string::npos) {
+			prespace = text;
+			syltext.clear();
+			postspace.clear();
+			return;
+		}
+		const size_t last = text.find_last_not_of(" \t");
+		prespace = text.substr(0, first);
+		syltext = text.substr(first, last - first + 1);
+		postspace = text.substr(last + 1);
+	}
+
+	std::unique_ptr<AssStyle> check_style(lua_State *L, int idx) {
+		argcheck(L, !!lua_istable(L, idx), idx, "Expected a style table");
+		lua_pushvalue(L, idx);
+		std::unique_ptr<AssEntry> e(Automation4::LuaAssFile::LuaToAssEntry(L));
+		lua_pop(L, 1);
+		if (typeid(*e) != typeid(AssStyle))
+			error(L, "Not a style entry");
+		return std::unique_ptr<AssStyle>(static_cast<AssStyle *>(e.release()));
+	}
+
+	int get_int(lua_State *L, int idx, const char *name) {
+		lua_getfield(L, idx, name);
+		if (!lua_isnumber(L, -1))
+			error(L, "Invalid or missing field '%s' in 'dialogue' class subtitle line (expected number)", name);
+		int value = lua_tointeger(L, -1);
+		lua_pop(L, 1);
+		return value;
+	}
+
+	void push_highlight(lua_State *L, Highlight const& hl) {
+		lua_createtable(L, 0, 3);
+		set_field(L, "start_time", hl.start_time);
+		set_field(L, "end_time", hl.end_time);
+		set_field(L, "duration", hl.duration);
+	}
+
+	/// Push a new array table with an n field giving its length
+	void push_counted_table(lua_State *L, size_t count) {
+		lua_createtable(L, (int)count, 1);
+		set_field(L, "n", (int)count);
+	}
+
+	/// Run the syllable grouping and furigana splitting of
+	/// karaskel.preproc_line_text on a parsed line
+	void group_syllables(AssKaraoke const& kara, int line_start, std::vector<Syllable> &syls, std::vector<Furigana> &furis, std::string &text_stripped) {
+		// 2.1.x stored everything before the first syllable at index zero,
+		// just like parse_karaoke_data
+		std::vector<AssKaraoke::Syllable> input(1);
+		input[0].start_time = line_start;
+		input[0].duration = 0;
+		input.insert(input.end(), kara.begin(), kara.end());
+
+		Syllable worksyl;
+		std::string cur_inline_fx;
+		for (size_t i = 0; i < input.size(); ++i) {
+			auto const& syl = input[i];
+			const std::string text = i == 0 ? std::string() : syl.GetText(false);
+			const Highlight hl{syl.start_time - line_start, syl.start_time + syl.duration - line_start, syl.duration};
+
+			std::string inline_fx;
+			if (find_inline_fx(text, inline_fx))
+				cur_inline_fx = inline_fx;
+
+			std::string prespace, syltext, postspace;
+			split_spaces(syl.text, prespace, syltext, postspace);
+
+			// A syllable not starting with # breaks a multi-highlight stretch
+			const std::string prefix = first_char(syltext);
+			const bool multi_highlight = prefix == "#" || prefix == "\xEF\xBC\x83";
+			if (!multi_highlight && i > 0) {
+				syls.push_back(std::move(worksyl));
+				worksyl = Syllable();
+			}
+
+			worksyl.highlights.push_back(hl);
+
+			if (syltext.find('|') != std::string::npos || syltext.find("\xEF\xBD\x9C") != std::string::npos) {
+				boost::replace_all(syltext, "\xEF\xBD\x9C", "|");
+				const size_t pipe = syltext.find('|');
+				std::string furitext = syltext.substr(pipe + 1);
+				syltext.erase(pipe);
+
+				Furigana furi;
+				furi.syl = syls.size();
+				furi.highlight = worksyl.highlights.size() - 1;
+				furi.hl = hl;
+				furi.tag = syl.tag_type;
+				furi.inline_fx = cur_inline_fx;
+
+				const std::string furi_prefix = first_char(furitext);
+				furi.isbreak = furi_prefix == "!" || furi_prefix == "\xEF\xBC\x81"
+					|| furi_prefix == "<" || furi_prefix == "\xEF\xBC\x9C";
+				furi.spillback = furi_prefix == "<" || furi_prefix == "\xEF\xBC\x9C";
+				if (furi.isbreak)
+					furitext.erase(0, char_width(furitext));
+				furi.text = furitext;
+
+				worksyl.furi.push_back(furis.size());
+				furis.push_back(std::move(furi));
+			}
+
+			if (!worksyl.has_text || !multi_highlight) {
+				text_stripped += prespace + syltext + postspace;
+				worksyl.has_text = true;
+				worksyl.text = text;
+				worksyl.duration = syl.duration;
+				worksyl.kdur = syl.duration / 10.0;
+				worksyl.start_time = hl.start_time;
+				worksyl.end_time = hl.end_time;
+				worksyl.tag = syl.tag_type;
+				worksyl.text_stripped = prespace + syltext + postspace;
+				worksyl.inline_fx = cur_inline_fx;
+				worksyl.text_spacestripped = syltext;
+				worksyl.prespace = prespace;
+				worksyl.postspace = postspace;
+			}
+			else {
+				// This is just an extra highlight
+				worksyl.duration += syl.duration;
+				worksyl.kdur += syl.duration / 10.0;
+				worksyl.end_time = hl.end_time;
+			}
+		}
+
+		syls.push_back(std::move(worksyl));
+	}
+}
+
+namespace Automation4 {
+	int LuaKaraskelLayout(lua_State *L)
+	{
+		LuaProfile::Scope timer(L, LuaProfile::KARASKEL);
+
+		argcheck(L, lua_istable(L, 1) || lua_isuserdata(L, 1), 1, "Expected a dialogue line");
+		auto style = check_style(L, 2);
+		std::unique_ptr<AssStyle> furistyle;
+		if (lua_toboolean(L, 3))
+			furistyle = check_style(L, 3);
+		const double x_factor = lua_isnoneornil(L, 4) ? 1.0 : lua_tonumber(L, 4);
+
+		AssDialogue dia;
+		lua_getfield(L, 1, "text");
+		if (!lua_isstring(L, -1))
+			error(L, "Invalid or missing field 'text' in 'dialogue' class subtitle line (expected string)");
+		dia.Text = get_string(L, -1);
+		lua_pop(L, 1);
+		dia.Start = get_int(L, 1, "start_time");
+		dia.End = get_int(L, 1, "end_time");
+
+		std::vector<Syllable> syls;
+		std::vector<Furigana> furis;
+		std::string text_stripped;
+		group_syllables(AssKaraoke(&dia, false, false), dia.Start, syls, furis, text_stripped);
+
+		// Measure everything in one batch per style
+		std::vector<std::string> texts;
+		texts.reserve(syls.size() * 3 + 1);
+		texts.push_back(text_stripped);
+		for (auto const& syl : syls) {
+			texts.push_back(syl.text_spacestripped);
+			texts.push_back(syl.prespace);
+			texts.push_back(syl.postspace);
+		}
+		std::vector<TextExtents> extents;
+		if (!CalculateTextExtents(style.get(), texts, extents))
+			return error(L, "Some internal error occurred calculating text_extents");
+		for (size_t i = 0; i < syls.size(); ++i) {
+			syls[i].extents = extents[i * 3 + 1];
+			syls[i].prespacewidth = extents[i * 3 + 2].width * x_factor;
+			syls[i].postspacewidth = extents[i * 3 + 3].width * x_factor;
+		}
+		const TextExtents line_extents = extents[0];
+
+		if (furistyle && !furis.empty()) {
+			texts.clear();
+			for (auto const& furi : furis)
+				texts.push_back(furi.text);
+			if (!CalculateTextExtents(furistyle.get(), texts, extents))
+				return error(L, "Some internal error occurred calculating text_extents");
+			for (size_t i = 0; i < furis.size(); ++i)
+				furis[i].extents = extents[i];
+		}
+
+		// Build the tables karaskel.preproc_line_text and preproc_line_size
+		// would have built
+		lua_settop(L, 4);
+		lua_pushvalue(L, 1);
+		set_field(L, "duration", dia.End - dia.Start);
+		set_field(L, "text_stripped", text_stripped);
+		set_field(L, "width", line_extents.width * x_factor);
+		set_field(L, "height", line_extents.height);
+		set_field(L, "descent", line_extents.descent);
+		set_field(L, "extlead", line_extents.extlead);
+
+		// line.kara, with n being the highest index rather than the count
+		lua_createtable(L, (int)syls.size(), 1);
+		set_field(L, "n", (int)syls.size() - 1);
+		for (size_t i = 0; i < syls.size(); ++i) {
+			auto const& syl = syls[i];
+			lua_createtable(L, 0, 20);
+			set_field(L, "text", syl.text);
+			set_field(L, "duration", syl.duration);
+			set_field(L, "kdur", syl.kdur);
+			set_field(L, "start_time", syl.start_time);
+			set_field(L, "end_time", syl.end_time);
+			set_field(L, "tag", syl.tag);
+			set_field(L, "i", (int)i);
+			set_field(L, "text_stripped", syl.text_stripped);
+			set_field(L, "inline_fx", syl.inline_fx);
+			set_field(L, "text_spacestripped", syl.text_spacestripped);
+			set_field(L, "prespace", syl.prespace);
+			set_field(L, "postspace", syl.postspace);
+			set_field(L, "width", syl.extents.width * x_factor);
+			set_field(L, "height", syl.extents.height);
+			set_field(L, "prespacewidth", syl.prespacewidth);
+			set_field(L, "postspacewidth", syl.postspacewidth);
+			lua_pushvalue(L, 1);
+			lua_setfield(L, -2, "line");
+			lua_pushvalue(L, 2);
+			lua_setfield(L, -2, "style");
+
+			push_counted_table(L, syl.highlights.size());
+			for (size_t j = 0; j < syl.highlights.size(); ++j) {
+				push_highlight(L, syl.highlights[j]);
+				lua_rawseti(L, -2, (int)j + 1);
+			}
+			lua_setfield(L, -2, "highlights");
+
+			// Filled in along with line.furi
+			push_counted_table(L, syl.furi.size());
+			lua_setfield(L, -2, "furi");
+
+			lua_rawseti(L, -2, (int)i);
+		}
+		const int kara_idx = lua_gettop(L);
+
+		push_counted_table(L, furis.size());
+		for (size_t i = 0; i < furis.size(); ++i) {
+			auto const& furi = furis[i];
+			lua_createtable(L, 0, 22);
+			set_field(L, "start_time", furi.hl.start_time);
+			set_field(L, "end_time", furi.hl.end_time);
+			set_field(L, "duration", furi.hl.duration);
+			set_field(L, "kdur", furi.hl.duration / 10.0);
+			set_field(L, "text", furi.text);
+			set_field(L, "text_stripped", furi.text);
+			set_field(L, "text_spacestripped", furi.text);
+			set_field(L, "tag", furi.tag);
+			set_field(L, "inline_fx", furi.inline_fx);
+			set_field(L, "i", (int)furi.syl);
+			set_field(L, "prespace", "");
+			set_field(L, "postspace", "");
+			set_field(L, "isfuri", true);
+			set_field(L, "isbreak", furi.isbreak);
+			set_field(L, "spillback", furi.spillback);
+			lua_pushvalue(L, 1);
+			lua_setfield(L, -2, "line");
+			if (furistyle) {
+				set_field(L, "width", furi.extents.width * x_factor);
+				set_field(L, "height", furi.extents.height);
+				set_field(L, "prespacewidth", 0);
+				set_field(L, "postspacewidth", 0);
+				lua_pushvalue(L, 3);
+				lua_setfield(L, -2, "style");
+			}
+
+			// The syllable and highlight are shared with line.kara
+			lua_rawgeti(L, kara_idx, (int)furi.syl);
+			lua_pushvalue(L, -1);
+			lua_setfield(L, -3, "syl");
+
+			push_counted_table(L, 1);
+			lua_getfield(L, -2, "highlights");
+			lua_rawgeti(L, -1, (int)furi.highlight + 1);
+			lua_rawseti(L, -3, 1);
+			lua_pop(L, 1);
+			lua_setfield(L, -3, "highlights");
+
+			// Add to syl.furi, at the position it has in the syllable's list
+			auto const& syl_furi = syls[furi.syl].furi;
+			const auto pos = std::find(syl_furi.begin(), syl_furi.end(), i) - syl_furi.begin();
+			lua_getfield(L, -1, "furi");
+			lua_pushvalue(L, -3);
+			lua_rawseti(L, -2, (int)pos + 1);
+			lua_pop(L, 2);
+
+			lua_rawseti(L, -2, (int)i + 1);
+		}
+		lua_setfield(L, 5, "furi");
+		lua_setfield(L, 5, "kara");
+
+		lua_settop(L, 0);
+		return 0;
+	}
+}
@@ -124,30 +124,35 @@ namespace Automation4 {
 
 	int LuaProgressSink::LuaSetProgress(lua_State *L)
 	{
+		LuaProfile::Scope timer(L, LuaProfile::PROGRESS);
 		GetObjPointer(L, lua_upvalueindex(1))->SetProgress(lua_tonumber(L, 1), 100);
 		return 0;
 	}
 
 	int LuaProgressSink::LuaSetTask(lua_State *L)
 	{
+		LuaProfile::Scope timer(L, LuaProfile::PROGRESS);
 		GetObjPointer(L, lua_upvalueindex(1))->SetMessage(check_string(L, 1));
 		return 0;
 	}
 
 	int LuaProgressSink::LuaSetTitle(lua_State *L)
 	{
+		LuaProfile::Scope timer(L, LuaProfile::PROGRESS);
 		GetObjPointer(L, lua_upvalueindex(1))->SetTitle(check_string(L, 1));
 		return 0;
 	}
 
 	int LuaProgressSink::LuaGetCancelled(lua_State *L)
 	{
+		LuaProfile::Scope timer(L, LuaProfile::PROGRESS);
 		lua_pushboolean(L, GetObjPointer(L, lua_upvalueindex(1))->IsCancelled());
 		return 1;
 	}
 
 	int LuaProgressSink::LuaDebugOut(lua_State *L)
 	{
+		LuaProfile::Scope timer(L, LuaProfile::PROGRESS);
 		ProgressSink *ps = GetObjPointer(L, lua_upvalueindex(1));
 
 		// Check trace level
@@ -211,6 +216,11 @@ namespace Automation4 {
 		if (must_exist)
 			flags |= wxFD_FILE_MUST_EXIST;
 
+		if (BackgroundScriptRunner::IsHeadless()) {
+			lua_pushnil(L);
+			return 1;
+		}
+
 		agi::dispatch::Main().Sync([&] {
 			wxFileDialog diag(nullptr, message, dir, file, wildcard, flags);
 			if (diag.ShowModal() == wxID_CANCEL) {
@@ -245,6 +255,11 @@ namespace Automation4 {
 		if (prompt_overwrite)
 			flags |= wxFD_OVERWRITE_PROMPT;
 
+		if (BackgroundScriptRunner::IsHeadless()) {
+			lua_pushnil(L);
+			return 1;
+		}
+
 		agi::dispatch::Main().Sync([&] {
 			wxFileDialog diag(ps->GetParentWindow(), message, dir, file, wildcard, flags);
 			if (diag.ShowModal() == wxID_CANCEL) {
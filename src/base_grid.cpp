@@ -36,20 +36,26 @@
 #include "ass_dialogue.h"
 #include "ass_file.h"
 #include "audio_box.h"
+#include "collision_index.h"
 #include "compat.h"
 #include "fold_controller.h"
 #include "grid_column.h"
+#include "grid_filter.h"
 #include "options.h"
 #include "project.h"
 #include "utils.h"
 #include "selection_controller.h"
+#include "render_profile.h"
+#include "spelling_index.h"
 #include "subs_controller.h"
 #include "video_controller.h"
 
 #include <libaegisub/make_unique.h>
+#include <libaegisub/trace.h>
 #include <libaegisub/util.h>
 
 #include <algorithm>
+#include <iterator>
 
 #include <wx/dcbuffer.h>
 #include <wx/menu.h>
@@ -92,7 +98,25 @@ BaseGrid::BaseGrid(wxWindow* parent, agi::Context *context)
 		context->ass->AddCommitListener(&BaseGrid::OnSubtitlesCommit, this),
 
 		context->selectionController->AddActiveLineListener(&BaseGrid::OnActiveLineChanged, this),
-		context->selectionController->AddSelectionListener([&]{ Refresh(false); }),
+		context->selectionController->AddSelectionListener(&BaseGrid::OnSelectionChanged, this),
+
+		context->spelling->AddChangeListener([&] {
+			SetColumnWidths(true);
+			Refresh(false);
+		}),
+		context->renderProfile->AddChangeListener([&] {
+			SetColumnWidths(true);
+			Refresh(false);
+		}),
+		context->collisions->AddChangeListener([&] {
+			SetColumnWidths(true);
+			Refresh(false);
+		}),
+		context->gridFilter->AddChangeListener([&] {
+			UpdateMaps(AssFile::COMMIT_FOLD);
+			if (active_row >= 0)
+				MakeRowVisible(active_row);
+		}),
 
 		OPT_SUB("Subtitle/Grid/Font Face", &BaseGrid::UpdateStyle, this),
 		OPT_SUB("Subtitle/Grid/Font Size", &BaseGrid::UpdateStyle, this),
@@ -112,7 +136,7 @@ BaseGrid::BaseGrid(wxWindow* parent, agi::Context *context)
 		OPT_SUB("Colour/Subtitle Grid/Standard", &BaseGrid::UpdateStyle, this),
 
 		OPT_SUB("Subtitle/Grid/Highlight Subtitles in Frame", &BaseGrid::OnHighlightVisibleChange, this),
-		OPT_SUB("Subtitle/Grid/Hide Overrides", [&](agi::OptionValue const&) { Refresh(false); }),
+		OPT_SUB("Subtitle/Grid/Hide Overrides", [&](agi::OptionValue const&) { ClearColumnCaches(); Refresh(false); }),
 	});
 
 	Bind(wxEVT_CONTEXT_MENU, &BaseGrid::OnContextMenu, this);
@@ -130,16 +154,58 @@ BEGIN_EVENT_TABLE(BaseGrid,wxWindow)
 	EVT_MENU_RANGE(MENU_SHOW_COL,MENU_SHOW_COL+15,BaseGrid::OnShowColMenu)
 END_EVENT_TABLE()
 
-void BaseGrid::OnSubtitlesCommit(int type) {
-	if (type == AssFile::COMMIT_NEW || type & AssFile::COMMIT_ORDER || type & AssFile::COMMIT_DIAG_ADDREM || type & AssFile::COMMIT_FOLD)
-		UpdateMaps();
-
-	if (type & AssFile::COMMIT_DIAG_META || type & AssFile::COMMIT_DIAG_TIME) {
+void BaseGrid::OnSubtitlesCommit(int type, const AssDialogue *single_line) {
+	AGI_TRACE_ZONE("commit", "BaseGrid");
+	// When just one line's fields changed only it has to be formatted again
+	const bool one_line = single_line && type != AssFile::COMMIT_NEW && !(type & ~AssFile::COMMIT_DIAG_FULL);
+	if (one_line) {
+		for (auto& column : columns)
+			column->ClearCache(single_line);
+	}
+	else
+		ClearColumnCaches();
+
+	const bool restructured = type == AssFile::COMMIT_NEW || type & AssFile::COMMIT_ORDER || type & AssFile::COMMIT_DIAG_ADDREM || type & AssFile::COMMIT_FOLD
+		|| context->gridFilter->ChangedByLastCommit();
+	const bool fields_changed = type & AssFile::COMMIT_DIAG_META || type & AssFile::COMMIT_DIAG_TIME;
+	if (restructured)
+		UpdateMaps(type);
+
+	// Reordering and folding don't change any lines' contents, so when the
+	// fields of at most one line have changed the widths can be updated
+	// from just that line
+	if (type == AssFile::COMMIT_NEW || type & AssFile::COMMIT_DIAG_ADDREM || (fields_changed && !one_line)) {
 		SetColumnWidths();
-		Refresh(false);
-	} else if (type & AssFile::COMMIT_DIAG_TEXT) {
-		for (auto const& rect : text_refresh_rects)
+		if (fields_changed)
+			Refresh(false);
+	}
+	else if (restructured || fields_changed) {
+		std::vector<int> old_widths;
+		for (auto const& column : columns)
+			old_widths.push_back(column->Width());
+		SetColumnWidths(true, one_line ? single_line : nullptr);
+
+		bool widths_changed = false;
+		for (size_t i = 0; i < columns.size(); ++i)
+			widths_changed = widths_changed || columns[i]->Width() != old_widths[i];
+
+		// Retiming the active line can change which other lines collide with it
+		if (widths_changed || !one_line || single_line == context->selectionController->GetActiveLine())
+			Refresh(false);
+		else
+			RefreshLine(single_line);
+	}
+
+	if (!fields_changed && type & AssFile::COMMIT_DIAG_TEXT) {
+		const int row = one_line ? single_line->Fold.getVisibleRow() : -1;
+		for (auto rect : text_refresh_rects) {
+			if (one_line) {
+				if (row < yPos) continue;
+				rect.y = (row - yPos + 1) * lineHeight;
+				rect.height = lineHeight + 1;
+			}
 			RefreshRect(rect, false);
+		}
 	}
 }
 
@@ -158,10 +224,12 @@ void BaseGrid::OnShowColMenu(wxCommandEvent &event) {
 }
 
 void BaseGrid::OnHighlightVisibleChange(agi::OptionValue const& opt) {
-	if (opt.GetBool())
+	highlight_visible = opt.GetBool();
+	if (highlight_visible)
 		seek_listener.Unblock();
 	else
 		seek_listener.Block();
+	Refresh(false);
 }
 
 void BaseGrid::UpdateStyle() {
@@ -188,8 +256,15 @@ void BaseGrid::UpdateStyle() {
 	row_colors.FoldClosed.SetColour(to_wx(OPT_GET("Colour/Subtitle Grid/Background/Closed Fold")->GetColor()));
 	row_colors.LeftCol.SetColour(to_wx(OPT_GET("Colour/Subtitle Grid/Left Column")->GetColor()));
 
+	text_colors.Standard = to_wx(OPT_GET("Colour/Subtitle Grid/Standard")->GetColor());
+	text_colors.Selection = to_wx(OPT_GET("Colour/Subtitle Grid/Selection")->GetColor());
+	text_colors.Collision = to_wx(OPT_GET("Colour/Subtitle Grid/Collision")->GetColor());
+	text_colors.Lines = to_wx(OPT_GET("Colour/Subtitle Grid/Lines")->GetColor());
+	text_colors.ActiveBorder = to_wx(OPT_GET("Colour/Subtitle Grid/Active Border")->GetColor());
+
 	if (width_helper)
 		width_helper->ClearCache();
+	ClearColumnCaches();
 
 	SetColumnWidths();
 
@@ -197,17 +272,27 @@ void BaseGrid::UpdateStyle() {
 	Refresh(false);
 }
 
-void BaseGrid::UpdateMaps() {
-	index_line_map.clear();
-	vis_index_line_map.clear();
+void BaseGrid::UpdateMaps(int type) {
+	// Folding only changes which lines are visible
+	if (type != AssFile::COMMIT_FOLD) {
+		index_line_map.clear();
+		for (auto& curdiag : context->ass->Events)
+			index_line_map.push_back(&curdiag);
+	}
 
-	for (auto& curdiag : context->ass->Events)
-		index_line_map.push_back(&curdiag);
+	// The grid filter may have hidden the first line
+	AssDialogue *first = nullptr;
+	for (auto& curdiag : context->ass->Events) {
+		if (curdiag.Fold.isVisible()) {
+			first = &curdiag;
+			break;
+		}
+	}
 
-	for (AssDialogue *curdiag = &*context->ass->Events.begin(); curdiag != nullptr; curdiag = curdiag->Fold.getNextVisible())
+	vis_index_line_map.clear();
+	for (AssDialogue *curdiag = first; curdiag != nullptr; curdiag = curdiag->Fold.getNextVisible())
 		vis_index_line_map.push_back(&*curdiag);
 
-	SetColumnWidths();
 	AdjustScrollbar();
 	Refresh(false);
 }
@@ -217,12 +302,48 @@ void BaseGrid::OnActiveLineChanged(AssDialogue *new_active) {
 		if (new_active->Row != active_row)
 			MakeRowVisible(new_active->Row);
 		extendRow = active_row = new_active->Row;
-		Refresh(false);
+
+		// Repaint the rows which gain or lose the active line border or the
+		// collision color
+		RefreshVisRow(painted_active_row);
+		RefreshVisRow(new_active->Fold.getVisibleRow());
+		for (int row : collision_rows)
+			RefreshVisRow(row);
+
+		int lines = GetClientSize().GetHeight() / lineHeight + 1;
+		lines = mid(0, lines, GetVisRows() - yPos);
+		for (int i : boost::irange(yPos, yPos + lines)) {
+			auto line = vis_index_line_map[i];
+			if (line != new_active && line->CollidesWith(new_active))
+				RefreshVisRow(i);
+		}
 	}
 	else
 		active_row = -1;
 }
 
+void BaseGrid::OnSelectionChanged() {
+	// Anything which moved the rows around since the last paint will already
+	// have refreshed everything
+	auto const& selection = context->selectionController->GetSelectedSet();
+	for (size_t i = 0; i < painted_selected.size() && yPos + (int)i < GetVisRows(); ++i) {
+		if (!!selection.count(vis_index_line_map[yPos + i]) != !!painted_selected[i])
+			RefreshVisRow(yPos + i);
+	}
+}
+
+void BaseGrid::RefreshVisRow(int row) {
+	int w, h;
+	GetClientSize(&w, &h);
+	const int y = (row - yPos + 1) * lineHeight;
+	if (row < yPos || y > h) return;
+	RefreshRect(wxRect(0, y, w, lineHeight + 1), false);
+}
+
+void BaseGrid::RefreshLine(const AssDialogue *line) {
+	RefreshVisRow(line->Fold.getVisibleRow());
+}
+
 void BaseGrid::MakeRowVisible(int row) {
 	MakeVisRowVisible(GetDialogue(row)->Fold.getVisibleRow());
 }
@@ -261,18 +382,20 @@ void BaseGrid::OnSeek() {
 	int lines = GetClientSize().GetHeight() / lineHeight + 1;
 	lines = mid(0, lines, GetVisRows() - yPos);
 
-	auto it = begin(visible_rows);
-	for (int i : boost::irange(yPos, yPos + lines)) {
-		if (IsDisplayed(vis_index_line_map[i])) {
-			if (it == end(visible_rows) || *it != i) {
-				Refresh(false);
-				return;
-			}
-			++it;
-		}
+	std::vector<int> new_visible_rows;
+	auto displayed = DisplayedRows(yPos, lines);
+	for (int i : boost::irange(0, lines)) {
+		if (displayed[i])
+			new_visible_rows.push_back(yPos + i);
 	}
-	if (it != end(visible_rows))
-		Refresh(false);
+
+	// Only repaint the rows which were or now are visible on video, but not both
+	std::vector<int> changed;
+	std::set_symmetric_difference(begin(visible_rows), end(visible_rows),
+		begin(new_visible_rows), end(new_visible_rows), back_inserter(changed));
+	for (int row : changed)
+		RefreshVisRow(row);
+	visible_rows = std::move(new_visible_rows);
 }
 
 void BaseGrid::OnPaint(wxPaintEvent &) {
@@ -300,6 +423,10 @@ void BaseGrid::OnPaint(wxPaintEvent &) {
 	GetClientSize(&w,&h);
 	w -= scrollBar->GetSize().GetWidth();
 
+	// Rows outside of this aren't being repainted, so don't spend time
+	// formatting them
+	const wxRect update = GetUpdateRegion().GetBox();
+
 	wxAutoBufferedPaintDC dc(this);
 	dc.SetFont(font);
 
@@ -311,13 +438,8 @@ void BaseGrid::OnPaint(wxPaintEvent &) {
 	dc.SetBrush(row_colors.LeftCol);
 	dc.DrawRectangle(0, lineHeight, columns[0]->Width(), h-lineHeight);
 
-	// Row colors
-	wxColour text_standard(to_wx(OPT_GET("Colour/Subtitle Grid/Standard")->GetColor()));
-	wxColour text_selection(to_wx(OPT_GET("Colour/Subtitle Grid/Selection")->GetColor()));
-	wxColour text_collision(to_wx(OPT_GET("Colour/Subtitle Grid/Collision")->GetColor()));
-
 	// First grid row
-	wxPen grid_pen(to_wx(OPT_GET("Colour/Subtitle Grid/Lines")->GetColor()));
+	wxPen grid_pen(text_colors.Lines);
 	dc.SetPen(grid_pen);
 	dc.DrawLine(0, 0, w, 0);
 	dc.SetPen(*wxTRANSPARENT_PEN);
@@ -334,7 +456,7 @@ void BaseGrid::OnPaint(wxPaintEvent &) {
 
 	// Paint header
 	{
-		dc.SetTextForeground(text_standard);
+		dc.SetTextForeground(text_colors.Standard);
 		dc.SetBrush(row_colors.Header);
 		dc.DrawRectangle(0, 0, w, lineHeight);
 
@@ -357,12 +479,29 @@ void BaseGrid::OnPaint(wxPaintEvent &) {
 	const auto active_line = context->selectionController->GetActiveLine();
 	auto const& selection = context->selectionController->GetSelectedSet();
 	visible_rows.clear();
+	collision_rows.clear();
+	painted_selected.assign(nDraw, false);
+	const auto displayed_rows = highlight_visible ? DisplayedRows(yPos, nDraw) : std::vector<bool>(nDraw, false);
 
 	for (int i : agi::util::range(nDraw)) {
 		wxBrush color = row_colors.Default;
 		AssDialogue *curDiag = vis_index_line_map[i + yPos];
+		const int y = (i + 1) * lineHeight;
+
+		// The visible, colliding and selected rows are tracked even for rows
+		// which aren't being repainted so that later changes can be found
+		const bool displayed = displayed_rows[i];
+		if (displayed)
+			visible_rows.push_back(i + yPos);
+		const bool collides = active_line != curDiag && curDiag->CollidesWith(active_line);
+		if (collides)
+			collision_rows.push_back(i + yPos);
+		const bool inSel = !!selection.count(curDiag);
+		painted_selected[i] = inSel;
+
+		if (y > update.GetBottom() || y + lineHeight < update.GetTop())
+			continue;
 
-		bool inSel = !!selection.count(curDiag);
 		if (inSel && curDiag->Comment)
 			color = row_colors.SelectedComment;
 		else if (inSel)
@@ -370,11 +509,8 @@ void BaseGrid::OnPaint(wxPaintEvent &) {
 		else if (curDiag->Comment)
 			color = row_colors.Comment;
 
-		if (OPT_GET("Subtitle/Grid/Highlight Subtitles in Frame")->GetBool() && IsDisplayed(curDiag)) {
-			if (color == row_colors.Default)
-				color = row_colors.Visible;
-			visible_rows.push_back(i + yPos);
-		}
+		if (displayed && color == row_colors.Default)
+			color = row_colors.Visible;
 
 		if (curDiag->Fold.hasFold() && !inSel) {
 			color = curDiag->Fold.isFolded() ? row_colors.FoldClosed : row_colors.FoldOpen;
@@ -388,16 +524,15 @@ void BaseGrid::OnPaint(wxPaintEvent &) {
 			dc.DrawRectangle(grid_x, (i + 1) * lineHeight + 1, w, lineHeight);
 		}
 
-		if (active_line != curDiag && curDiag->CollidesWith(active_line))
-			dc.SetTextForeground(text_collision);
+		if (collides)
+			dc.SetTextForeground(text_colors.Collision);
 		else if (inSel)
-			dc.SetTextForeground(text_selection);
+			dc.SetTextForeground(text_colors.Selection);
 		else
-			dc.SetTextForeground(text_standard);
+			dc.SetTextForeground(text_colors.Standard);
 
 		// Draw text
 		int x = 0;
-		int y = (i + 1) * lineHeight;
 		for (size_t j : agi::util::range(columns.size())) {
 			if (paint_columns[j])
 				columns[j]->Paint(dc, x, y, curDiag, context);
@@ -424,8 +559,10 @@ void BaseGrid::OnPaint(wxPaintEvent &) {
 		dc.DrawLine(w, 0, w, maxH);
 	}
 
+	painted_active_row = -1;
 	if (active_line && active_line->Fold.getVisibleRow() >= yPos && active_line->Fold.getVisibleRow() < yPos + nDraw) {
-		dc.SetPen(wxPen(to_wx(OPT_GET("Colour/Subtitle Grid/Active Border")->GetColor())));
+		painted_active_row = active_line->Fold.getVisibleRow();
+		dc.SetPen(wxPen(text_colors.ActiveBorder));
 		dc.SetBrush(*wxTRANSPARENT_BRUSH);
 		dc.DrawRectangle(0, (active_line->Fold.getVisibleRow() - yPos + 1) * lineHeight, w, lineHeight + 1);
 	}
@@ -624,7 +761,7 @@ void BaseGrid::AdjustScrollbar() {
 	scrollBar->Thaw();
 }
 
-void BaseGrid::SetColumnWidths() {
+void BaseGrid::SetColumnWidths(bool incremental, const AssDialogue *changed_line) {
 	int w, h;
 	GetClientSize(&w, &h);
 
@@ -640,12 +777,23 @@ void BaseGrid::SetColumnWidths() {
 	width_helper->SetDC(&dc);
 
 	for (auto const& column : columns) {
-		column->UpdateWidth(context, *width_helper);
+		if (incremental)
+			column->UpdateWidth(context, *width_helper, changed_line);
+		else
+			column->UpdateWidth(context, *width_helper);
 		if (column->Width() && column->RefreshOnTextChange())
 			text_refresh_rects.emplace_back(x, 0, column->Width(), h);
 		x += column->Width();
 	}
-	width_helper->Age();
+
+	// Widths of lines which weren't looked at are still needed
+	if (!incremental)
+		width_helper->Age();
+}
+
+void BaseGrid::ClearColumnCaches() {
+	for (auto& column : columns)
+		column->ClearCache();
 }
 
 AssDialogue *BaseGrid::GetDialogue(int n) const {
@@ -663,11 +811,27 @@ int BaseGrid::VisRowToRow(int n) const {
 	return d != nullptr ? d->Row : GetRows() - 1;
 }
 
-bool BaseGrid::IsDisplayed(const AssDialogue *line) const {
-	if (!context->project->VideoProvider()) return false;
-	int frame = context->videoController->GetFrameN();
-	return context->project->Timecodes().FrameAtTime(line->Start, agi::vfr::START) <= frame
-		&& context->project->Timecodes().FrameAtTime(line->End, agi::vfr::END) >= frame;
+std::vector<bool> BaseGrid::DisplayedRows(int first, int count) const {
+	std::vector<bool> ret(std::max(count, 0), false);
+	if (!context->project->VideoProvider() || count <= 0) return ret;
+
+	// Rows are usually close to sorted by time, so batch converting their
+	// times is cheaper than searching the timecodes for each one
+	std::vector<int> starts, ends;
+	starts.reserve(count);
+	ends.reserve(count);
+	for (int i = first; i < first + count; ++i) {
+		starts.push_back(vis_index_line_map[i]->Start);
+		ends.push_back(vis_index_line_map[i]->End);
+	}
+
+	auto const& fps = context->project->Timecodes();
+	auto start_frames = fps.FramesAtTimes(starts, agi::vfr::START);
+	auto end_frames = fps.FramesAtTimes(ends, agi::vfr::END);
+	const int frame = context->videoController->GetFrameN();
+	for (int i = 0; i < count; ++i)
+		ret[i] = start_frames[i] <= frame && end_frames[i] >= frame;
+	return ret;
 }
 
 void BaseGrid::OnCharHook(wxKeyEvent &event) {
@@ -763,6 +927,7 @@ void BaseGrid::SetByFrame(bool state) {
 	byFrame = state;
 	for (auto& column : columns)
 		column->SetByFrame(byFrame);
+	ClearColumnCaches();
 	SetColumnWidths();
 	Refresh(false);
 }
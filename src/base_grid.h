@@ -59,11 +59,19 @@ class BaseGrid final : public wxWindow {
 	int yPos = 0;
 
 	int active_row = -1;
+	/// Displayed row which the active line border was last painted on
+	int painted_active_row = -1;
 
 	std::unique_ptr<WidthHelper> width_helper;
 
 	/// Rows which are visible on the current video frame
 	std::vector<int> visible_rows;
+	/// Rows painted in the collision color as of the last paint
+	std::vector<int> collision_rows;
+	/// Which on-screen rows were selected as of the last paint
+	std::vector<char> painted_selected;
+	/// Should lines visible on the current video frame be highlighted?
+	bool highlight_visible = false;
 
 	agi::Context *context; ///< Associated project context
 
@@ -85,6 +93,15 @@ class BaseGrid final : public wxWindow {
 		wxBrush FoldClosed;
 	} row_colors;
 
+	/// Cached colors used for row text and the grid lines
+	struct {
+		wxColour Standard;
+		wxColour Selection;
+		wxColour Collision;
+		wxColour Lines;
+		wxColour ActiveBorder;
+	} text_colors;
+
 	std::vector<AssDialogue*> index_line_map;  ///< Row number -> dialogue line
 	std::vector<AssDialogue*> vis_index_line_map;  ///< Visible Row number -> dialogue line
 
@@ -104,16 +121,31 @@ class BaseGrid final : public wxWindow {
 	void OnScroll(wxScrollEvent &event);
 	void OnShowColMenu(wxCommandEvent &event);
 	void OnSize(wxSizeEvent &event);
-	void OnSubtitlesCommit(int type);
+	void OnSubtitlesCommit(int type, const AssDialogue *single_line);
 	void OnActiveLineChanged(AssDialogue *);
+	void OnSelectionChanged();
 	void OnSeek();
 
 	void AdjustScrollbar();
-	void SetColumnWidths();
-
-	bool IsDisplayed(const AssDialogue *line) const;
-
-	void UpdateMaps();
+	/// Recalculate the widths of the columns
+	/// @param incremental  Only changed_line has changed since the widths were
+	///                     last calculated, or nothing but the line order and
+	///                     folds if it's null
+	/// @param changed_line Line whose fields changed
+	void SetColumnWidths(bool incremental = false, const AssDialogue *changed_line = nullptr);
+	void ClearColumnCaches();
+
+	/// Repaint a single displayed row, if it's on screen
+	void RefreshVisRow(int row);
+	/// Repaint the row showing a line, if it's on screen
+	void RefreshLine(const AssDialogue *line);
+
+	/// Which of the lines in a range of visible rows are displayed on the
+	/// current video frame?
+	std::vector<bool> DisplayedRows(int first, int count) const;
+
+	/// Rebuild the row maps after a commit of the given type
+	void UpdateMaps(int type);
 	void UpdateStyle();
 
 	void SelectRow(int row, bool addToSelected = false, bool select=true);
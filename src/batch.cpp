@@ -0,0 +1,289 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include "batch.h"
+
+#include "ass_dialogue.h"
+#include "ass_export_filter.h"
+#include "ass_exporter.h"
+#include "ass_file.h"
+#include "auto4_base.h"
+#include "command/command.h"
+#include "compat.h"
+#include "include/aegisub/context.h"
+#include "selection_controller.h"
+#include "subtitle_format.h"
+
+#include <libaegisub/charset.h>
+#include <libaegisub/dispatch.h>
+#include <libaegisub/file_mapping.h>
+#include <libaegisub/format.h>
+#include <libaegisub/fs.h>
+#include <libaegisub/log.h>
+#include <libaegisub/vfr.h>
+
+#include <algorithm>
+#include <boost/algorithm/string/predicate.hpp>
+#include <chrono>
+#include <cstdio>
+#include <wx/log.h>
+
+namespace {
+using clock = std::chrono::steady_clock;
+
+long long ms(clock::duration d) {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+}
+
+const char usage[] =
+	"Usage: aegisub --batch [options] FILE...\n"
+	"\n"
+	"  --script FILE         Load an Automation script in addition to the autoload ones\n"
+	"  --macro NAME          Run a macro on every line of each file, by its command or\n"
+	"                        display name; may be repeated and runs in the given order\n"
+	"  --export-filter NAME  Run an export filter when writing; may be repeated\n"
+	"  --output-dir DIR      Directory to write the processed files to (required)\n"
+	"  --format EXT          Format to write, by file extension, instead of keeping\n"
+	"                        the format of the input file\n"
+	"  --input-charset NAME  Character set of the input files, instead of detecting it\n"
+	"  --charset NAME        Character set to write (default UTF-8)\n";
+
+struct Options {
+	std::vector<agi::fs::path> scripts;
+	std::vector<std::string> macros;
+	std::vector<std::string> filters;
+	agi::fs::path output_dir;
+	std::string format;
+	std::string input_charset;
+	std::string charset = "UTF-8";
+	std::vector<agi::fs::path> files;
+};
+
+bool ParseArgs(std::vector<std::string> const& args, Options& opt) {
+	for (size_t i = 0; i < args.size(); ++i) {
+		auto const& arg = args[i];
+		if (arg == "--batch") continue;
+		if (!boost::starts_with(arg, "--")) {
+			opt.files.emplace_back(arg);
+			continue;
+		}
+
+		if (i + 1 == args.size()) {
+			fprintf(stderr, "Missing value for %s\n", arg.c_str());
+			return false;
+		}
+		auto const& value = args[++i];
+		if (arg == "--script")
+			opt.scripts.emplace_back(value);
+		else if (arg == "--macro")
+			opt.macros.push_back(value);
+		else if (arg == "--export-filter")
+			opt.filters.push_back(value);
+		else if (arg == "--output-dir")
+			opt.output_dir = value;
+		else if (arg == "--format")
+			opt.format = value[0] == '.' ? value : "." + value;
+		else if (arg == "--input-charset")
+			opt.input_charset = value;
+		else if (arg == "--charset")
+			opt.charset = value;
+		else {
+			fprintf(stderr, "Unknown option %s\n", arg.c_str());
+			return false;
+		}
+	}
+
+	if (opt.output_dir.empty() || opt.files.empty()) {
+		fputs("An output directory and at least one file are required\n", stderr);
+		return false;
+	}
+	return true;
+}
+
+/// Look up a macro by its command name or its display name
+cmd::Command *FindMacro(std::string const& name) {
+	for (auto const& cmd_name : cmd::get_registered_commands()) {
+		if (!boost::starts_with(cmd_name, "automation/")) continue;
+		auto command = cmd::get(cmd_name);
+		if (cmd_name == name || from_wx(command->StrDisplay(nullptr)) == name)
+			return command;
+	}
+	return nullptr;
+}
+
+struct FileResult {
+	AssFile subs;
+	std::string error;
+	clock::duration load{0};
+	clock::duration macros{0};
+	clock::duration save{0};
+};
+
+void ReadFile(agi::fs::path const& path, std::string charset, FileResult& result) {
+	auto start = clock::now();
+	try {
+		agi::file_open_scope open_file(path);
+		if (charset.empty())
+			charset = agi::charset::Detect(path);
+		if (charset.empty())
+			throw agi::InvalidInputException("Could not detect the character set; use --input-charset");
+		auto reader = SubtitleFormat::GetReader(path, charset);
+		reader->ReadFile(&result.subs, path, agi::vfr::Framerate(), charset);
+	}
+	catch (agi::Exception const& e) {
+		result.error = e.GetMessage();
+	}
+	catch (std::exception const& e) {
+		result.error = e.what();
+	}
+	result.load = clock::now() - start;
+}
+
+void ProcessFile(agi::Context& c, Options const& opt, std::vector<cmd::Command *> const& macros, agi::fs::path const& path, FileResult& result) {
+	c.ass->swap(result.subs);
+	c.ass->Commit("", AssFile::COMMIT_NEW);
+
+	auto start = clock::now();
+	for (auto macro : macros) {
+		// Macros act on the whole file, as if every line had been selected
+		Selection sel;
+		for (auto& line : c.ass->Events)
+			sel.insert(&line);
+		auto active = c.ass->Events.empty() ? nullptr : &c.ass->Events.front();
+		c.selectionController->SetSelectionAndActive(std::move(sel), active);
+
+		if (macro->Validate(&c))
+			(*macro)(&c);
+		else
+			fprintf(stderr, "%s: skipped macro %s, which cannot run on this file\n",
+				path.string().c_str(), macro->name());
+	}
+	result.macros = clock::now() - start;
+
+	start = clock::now();
+	auto out = opt.output_dir/path.filename();
+	if (!opt.format.empty())
+		out.replace_extension(opt.format);
+
+	AssExporter exporter(&c);
+	for (auto const& filter : opt.filters)
+		exporter.AddFilter(filter);
+	exporter.Export(out, opt.charset);
+	result.save = clock::now() - start;
+
+	// Free whatever was left in the context by the previous file
+	AssFile().swap(result.subs);
+}
+}
+
+namespace batch {
+bool Requested(std::vector<std::string> const& args) {
+	return std::find(begin(args), end(args), "--batch") != end(args);
+}
+
+int Run(std::vector<std::string> const& args) {
+	Options opt;
+	if (!ParseArgs(args, opt)) {
+		fputs(usage, stderr);
+		return 2;
+	}
+
+	// Nothing is shown, so send any errors which would normally pop up a
+	// message box to stderr instead
+	delete wxLog::SetActiveTarget(new wxLogStderr);
+	Automation4::BackgroundScriptRunner::SetHeadless(true);
+
+	std::vector<std::unique_ptr<Automation4::Script>> scripts;
+	for (auto const& path : opt.scripts) {
+		auto script = Automation4::ScriptFactory::CreateFromFile(path, true, false);
+		if (!script || !script->GetLoadedState()) {
+			fprintf(stderr, "Failed to load Automation script %s\n", path.string().c_str());
+			return 1;
+		}
+		scripts.push_back(std::move(script));
+	}
+
+	std::vector<cmd::Command *> macros;
+	for (auto const& name : opt.macros) {
+		auto macro = FindMacro(name);
+		if (!macro) {
+			fprintf(stderr, "No macro named %s\n", name.c_str());
+			return 1;
+		}
+		macros.push_back(macro);
+	}
+
+	for (auto const& name : opt.filters) {
+		if (!AssExportFilterChain::GetFilter(name)) {
+			fprintf(stderr, "No export filter named %s\n", name.c_str());
+			return 1;
+		}
+	}
+
+	try {
+		agi::fs::CreateDirectory(opt.output_dir);
+	}
+	catch (agi::Exception const& e) {
+		fprintf(stderr, "%s\n", e.GetMessage().c_str());
+		return 1;
+	}
+
+	auto start = clock::now();
+
+	// Parsing doesn't touch anything shared so all of the files can be read
+	// at once, but macros need the project context and the Lua states, which
+	// belong to the main thread, so the rest is done one file at a time.
+	// Export filters which work line-by-line are run in parallel within each
+	// file by the exporter.
+	std::vector<FileResult> results(opt.files.size());
+	agi::dispatch::Parallel(opt.files.size(), [&](size_t i) {
+		ReadFile(opt.files[i], opt.input_charset, results[i]);
+	});
+
+	agi::Context c;
+	int failed = 0;
+	for (size_t i = 0; i < opt.files.size(); ++i) {
+		auto const& path = opt.files[i];
+		auto& result = results[i];
+		if (result.error.empty()) {
+			try {
+				ProcessFile(c, opt, macros, path, result);
+			}
+			catch (agi::Exception const& e) {
+				result.error = e.GetMessage();
+			}
+			catch (std::exception const& e) {
+				result.error = e.what();
+			}
+		}
+
+		if (!result.error.empty()) {
+			++failed;
+			printf("%s: failed: %s\n", path.string().c_str(), result.error.c_str());
+		}
+		else {
+			printf("%s: load %lld ms, macros %lld ms, export %lld ms, total %lld ms\n",
+				path.string().c_str(), ms(result.load), ms(result.macros), ms(result.save),
+				ms(result.load + result.macros + result.save));
+		}
+		fflush(stdout);
+	}
+
+	printf("Processed %d of %d files in %lld ms\n",
+		static_cast<int>(opt.files.size()) - failed, static_cast<int>(opt.files.size()),
+		ms(clock::now() - start));
+	LOG_I("batch") << "Processed " << opt.files.size() << " files, " << failed << " failed";
+	return failed ? 1 : 0;
+}
+}
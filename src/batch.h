@@ -0,0 +1,36 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file batch.h
+/// @brief Processing of subtitle files from the command line without a UI
+/// @ingroup main
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace batch {
+	/// Does the command line ask for batch mode rather than opening the UI?
+	/// @param args Command line arguments, not including the program name
+	bool Requested(std::vector<std::string> const& args);
+
+	/// Load each of the files named on the command line, run the requested
+	/// Automation macros and export filters on them, and write the results
+	/// to the output directory, reporting how long each file took on stdout
+	/// @param args Command line arguments, not including the program name
+	/// @return Process exit code
+	int Run(std::vector<std::string> const& args);
+}
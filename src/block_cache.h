@@ -34,9 +34,33 @@
 #pragma once
 
 #include <algorithm>
-#include <list>
+#include <cstdint>
 #include <vector>
 
+/// @brief Usage counters for a DataBlockCache
+struct DataBlockCacheStats {
+	/// Number of requests for blocks which were already in the cache
+	uint64_t hits = 0;
+	/// Number of blocks which had to be produced
+	uint64_t misses = 0;
+	/// Number of blocks discarded to stay under the size limit
+	uint64_t evictions = 0;
+	/// Number of blocks currently in the cache
+	size_t blocks = 0;
+	/// Current size of the cache in bytes
+	size_t bytes = 0;
+
+	DataBlockCacheStats& operator+=(DataBlockCacheStats const& other)
+	{
+		hits += other.hits;
+		misses += other.misses;
+		evictions += other.evictions;
+		blocks += other.blocks;
+		bytes += other.bytes;
+		return *this;
+	}
+};
+
 /// @class DataBlockCache
 /// @brief Cache for blocks of data in a stream or similar
 /// @tparam BlockT             Type of blocks to store
@@ -48,11 +72,16 @@ class DataBlockCache {
 	typedef std::vector<typename BlockFactoryT::BlockType> BlockArray;
 
 	struct MacroBlock {
-		/// This macroblock's position in the age list
-		/// Is valid iff blocks.size() > 0
-		typename std::list<MacroBlock*>::iterator position;
+		/// The next more recently used macroblock in the age list
+		MacroBlock *newer = nullptr;
+		/// The next less recently used macroblock in the age list
+		MacroBlock *older = nullptr;
+
+		/// Number of non-null entries in blocks
+		size_t filled = 0;
 
 		/// The blocks contained in the macroblock
+		/// The macroblock is in the age list iff this is non-empty
 		BlockArray blocks;
 	};
 
@@ -62,11 +91,12 @@ class DataBlockCache {
 	/// The data in the cache
 	MacroBlockArray data;
 
-	/// Type of a list of macro blocks
-	typedef std::list<MacroBlock*> AgeList;
+	/// Most recently used end of the age list, which is linked through the
+	/// macroblocks themselves so that touching and evicting are constant time
+	MacroBlock *newest = nullptr;
 
-	/// The data sorted by how long it's been since they were used
-	AgeList age;
+	/// Least recently used end of the age list
+	MacroBlock *oldest = nullptr;
 
 	/// Number of blocks per macroblock
 	size_t macroblock_size;
@@ -77,21 +107,66 @@ class DataBlockCache {
 	/// Current size of the cache in bytes
 	size_t size = 0;
 
+	/// Usage counters; blocks and bytes are filled in on request
+	DataBlockCacheStats stats;
+
 	/// Factory object for blocks
 	BlockFactoryT factory;
 
+	/// @brief Remove a macroblock from the age list
+	void Unlink(MacroBlock &mb)
+	{
+		(mb.newer ? mb.newer->older : newest) = mb.older;
+		(mb.older ? mb.older->newer : oldest) = mb.newer;
+		mb.newer = mb.older = nullptr;
+	}
+
+	/// @brief Insert a macroblock at the most recently used end of the age list
+	void LinkNewest(MacroBlock &mb)
+	{
+		mb.older = newest;
+		mb.newer = nullptr;
+		(newest ? newest->newer : oldest) = &mb;
+		newest = &mb;
+	}
+
 	/// @brief Dispose of all blocks in a macroblock and mark it empty
-	/// @param mb_index Index of macroblock to clear
+	/// @param mb Macroblock to clear
 	void KillMacroBlock(MacroBlock &mb)
 	{
 		if (mb.blocks.empty())
 			return;
 
-		auto& ba = mb.blocks;
-		size -= (ba.size() - std::count(ba.begin(), ba.end(), nullptr)) * factory.GetBlockSize();
+		size -= mb.filled * factory.GetBlockSize();
+		stats.evictions += mb.filled;
+
+		mb.blocks.clear();
+		mb.filled = 0;
+		Unlink(mb);
+	}
+
+	/// @brief Get the macroblock holding a block and mark it as most recently used
+	/// @param i Index of the block
+	MacroBlock &Touch(size_t i)
+	{
+		size_t mbi = i >> MacroblockExponent;
+		assert(mbi < data.size());
+
+		auto &mb = data[mbi];
+
+		// Move this macroblock to the front of the age list
+		if (mb.blocks.empty())
+		{
+			mb.blocks.resize(macroblock_size);
+			LinkNewest(mb);
+		}
+		else if (newest != &mb)
+		{
+			Unlink(mb);
+			LinkNewest(mb);
+		}
 
-		ba.clear();
-		age.erase(mb.position);
+		return mb;
 	}
 
 public:
@@ -144,39 +219,66 @@ public:
 			size_t block_count = data.size();
 			data.clear();
 			data.resize(block_count);
-			age.clear();
+			newest = oldest = nullptr;
 			size = 0;
 			return;
 		}
 
 		// Remove old entries until we're under the max size
-		for (auto it = age.rbegin(); size > max_size && it != age.rend(); it++)
-			KillMacroBlock(**it);
+		while (size > max_size && oldest)
+			KillMacroBlock(*oldest);
 	}
 
-	/// @brief Obtain a data block from the cache
-	/// @param      i       Index of the block to retrieve
-	/// @param[out] created On return, tells whether the returned block was created during the operation
-	/// @return A pointer to the block in cache
-	///
-	/// It is legal to pass 0 (null) for created, in this case nothing is returned in it.
-	BlockT& Get(size_t i, bool *created = nullptr)
+	/// @brief Get the usage counters of the cache
+	DataBlockCacheStats GetStats() const
+	{
+		DataBlockCacheStats ret = stats;
+		ret.bytes = size;
+		for (auto mb = newest; mb; mb = mb->older)
+			ret.blocks += mb->filled;
+		return ret;
+	}
+
+	/// @brief Check if a block is in the cache without producing it
+	/// @param i Index of the block to check
+	/// @return Would Get() return the block without creating it?
+	bool IsCached(size_t i) const
 	{
 		size_t mbi = i >> MacroblockExponent;
 		assert(mbi < data.size());
 
-		auto &mb = data[mbi];
+		auto const& mb = data[mbi];
+		return !mb.blocks.empty() && mb.blocks[i & macroblock_index_mask] != nullptr;
+	}
 
-		// Move this macroblock to the front of the age list
-		if (mb.blocks.empty())
+	/// @brief Insert a block which was produced outside of the cache
+	/// @param i     Index of the block
+	/// @param block Block data, which replaces any block already in the cache
+	///
+	/// This lets the blocks be produced on other threads, as the cache itself
+	/// must only be used from one thread at a time. Counts as a miss.
+	void Store(size_t i, typename BlockFactoryT::BlockType block)
+	{
+		auto &mb = Touch(i);
+		auto &slot = mb.blocks[i & macroblock_index_mask];
+		if (!slot)
 		{
-			mb.blocks.resize(macroblock_size);
-			age.push_front(&mb);
+			size += factory.GetBlockSize();
+			++mb.filled;
 		}
-		else if (mb.position != begin(age))
-			age.splice(begin(age), age, mb.position);
+		slot = std::move(block);
+		++stats.misses;
+	}
 
-		mb.position = age.begin();
+	/// @brief Obtain a data block from the cache
+	/// @param      i       Index of the block to retrieve
+	/// @param[out] created On return, tells whether the returned block was created during the operation
+	/// @return A pointer to the block in cache
+	///
+	/// It is legal to pass 0 (null) for created, in this case nothing is returned in it.
+	BlockT& Get(size_t i, bool *created = nullptr)
+	{
+		auto &mb = Touch(i);
 
 		size_t block_index = i & macroblock_index_mask;
 		assert(block_index < mb.blocks.size());
@@ -189,11 +291,16 @@ public:
 			b = mb.blocks[block_index].get();
 			assert(b != nullptr);
 			size += factory.GetBlockSize();
+			++mb.filled;
+			++stats.misses;
 
 			if (created) *created = true;
 		}
 		else
+		{
+			++stats.hits;
 			if (created) *created = false;
+		}
 
 		return *b;
 	}
@@ -0,0 +1,248 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include "collision_index.h"
+
+#include "ass_dialogue.h"
+#include "ass_file.h"
+#include "ass_style.h"
+#include "include/aegisub/context.h"
+#include "options.h"
+#include "project.h"
+
+#include <libaegisub/trace.h>
+#include <libaegisub/vfr.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+int style_alignment(AssFile &ass, agi::Interned<std::string> const& name) {
+	auto style = ass.GetStyle(name);
+	return style ? style->alignment : 2;
+}
+
+/// Get the alignment of a line, which is set by the first \an or \a in its
+/// override blocks if there is one
+int line_alignment(AssDialogue const& line, int style_alignment) {
+	std::string const& text = line.Text;
+	for (size_t start = text.find('{'); start != std::string::npos; start = text.find('{', start + 1)) {
+		const size_t end = std::min(text.find('}', start), text.size());
+		for (size_t tag = text.find("\\a", start); tag < end; tag = text.find("\\a", tag + 2)) {
+			const char *value = text.c_str() + tag + 2;
+			if (value[0] == 'n' && value[1] >= '1' && value[1] <= '9')
+				return value[1] - '0';
+			// Anything else starting with \a other than \alpha
+			if (value[0] >= '1' && value[0] <= '9')
+				return AssStyle::SsaToAss(atoi(value));
+		}
+	}
+	return style_alignment;
+}
+
+/// Are the two lines placed in the same part of the screen?
+bool same_place(AssFile &ass, AssDialogue const& a, AssDialogue const& b) {
+	if (a.Style != b.Style || a.Layer != b.Layer) return false;
+	const int alignment = style_alignment(ass, a.Style);
+	return line_alignment(a, alignment) == line_alignment(b, alignment);
+}
+
+/// A line which can collide, with what it's grouped by
+struct Placed {
+	AssDialogue const *line;
+	agi::Interned<std::string> style;
+	int layer;
+	int alignment;
+	int start;
+	int end;
+
+	bool SamePlace(Placed const& other) const {
+		return style == other.style && layer == other.layer && alignment == other.alignment;
+	}
+};
+}
+
+CollisionIndex::CollisionIndex(agi::Context *c)
+: context(c)
+, by_frame(OPT_GET("Subtitle/Grid/Collisions By Frame"))
+, pre_commit_listener(c->ass->AddPreCommitListener(&CollisionIndex::OnPreCommit, this))
+, timecodes_listener(c->project->AddTimecodesListener([=](agi::vfr::Framerate const&) {
+	if (by_frame->GetBool())
+		UpdateAll();
+}))
+, by_frame_listener(OPT_SUB("Subtitle/Grid/Collisions By Frame", &CollisionIndex::UpdateAll, this))
+{
+	UpdateAll();
+}
+
+void CollisionIndex::OnPreCommit(int type, const AssDialogue *single_line) {
+	AGI_TRACE_ZONE("commit", "CollisionIndex");
+	if (type == AssFile::COMMIT_NEW || type & (AssFile::COMMIT_DIAG_ADDREM | AssFile::COMMIT_STYLES))
+		UpdateAll();
+	else if (!(type & AssFile::COMMIT_DIAG_FULL))
+		return;
+	else if (single_line)
+		UpdateAround(*single_line);
+	else
+		UpdateAll();
+}
+
+std::pair<int, int> CollisionIndex::Span(AssDialogue const& line) const {
+	if (line.Comment || line.End <= line.Start)
+		return {0, 0};
+
+	auto const& timecodes = context->project->Timecodes();
+	if (by_frame->GetBool() && timecodes.IsLoaded())
+		return {timecodes.FrameAtTime(line.Start, agi::vfr::START), timecodes.FrameAtTime(line.End, agi::vfr::END) + 1};
+	return {line.Start, line.End};
+}
+
+bool CollisionIndex::Check(AssDialogue const& line) const {
+	const auto span = Span(line);
+	if (span.first >= span.second) return false;
+
+	// Lines which share a frame always overlap in time too, so the time
+	// index finds every candidate in either mode
+	for (auto other : context->ass->EventsOverlapping(line.Start, line.End)) {
+		if (other == &line) continue;
+		const auto other_span = Span(*other);
+		if (other_span.first < span.second && span.first < other_span.second && same_place(*context->ass, line, *other))
+			return true;
+	}
+	return false;
+}
+
+bool CollisionIndex::Set(AssDialogue const& line, bool collides) {
+	auto& entry = lines.emplace(line.Id, Line{line.Start, line.End, false}).first->second;
+	entry.start = line.Start;
+	entry.end = line.End;
+	if (entry.collides == collides)
+		return false;
+
+	entry.collides = collides;
+	if (collides)
+		++count;
+	else
+		--count;
+	return true;
+}
+
+void CollisionIndex::UpdateAround(AssDialogue const& line) {
+	// Lines which the line overlapped before it was retimed may no longer
+	// collide, and the ones it overlaps now may have started to
+	std::vector<AssDialogue *> affected;
+	auto it = lines.find(line.Id);
+	if (it != lines.end() && (it->second.start != line.Start || it->second.end != line.End))
+		affected = context->ass->EventsOverlapping(it->second.start, it->second.end);
+	auto overlapping = context->ass->EventsOverlapping(line.Start, line.End);
+	affected.insert(affected.end(), overlapping.begin(), overlapping.end());
+
+	bool changed = Set(line, Check(line));
+	for (auto other : affected) {
+		if (other != &line)
+			changed = Set(*other, Check(*other)) || changed;
+	}
+
+	if (changed)
+		Changed();
+}
+
+void CollisionIndex::UpdateAll() {
+	AssFile &ass = *context->ass;
+
+	std::vector<Placed> placed;
+	std::unordered_map<agi::Interned<std::string>, int> alignments;
+	for (auto const& line : ass.Events) {
+		const auto span = Span(line);
+		if (span.first >= span.second) continue;
+
+		auto alignment = alignments.find(line.Style);
+		if (alignment == alignments.end())
+			alignment = alignments.emplace(line.Style, style_alignment(ass, line.Style)).first;
+		placed.push_back(Placed{&line, line.Style, line.Layer, line_alignment(line, alignment->second), span.first, span.second});
+	}
+
+	std::sort(placed.begin(), placed.end(), [](Placed const& a, Placed const& b) {
+		if (a.style != b.style) return a.style < b.style;
+		if (a.layer != b.layer) return a.layer < b.layer;
+		if (a.alignment != b.alignment) return a.alignment < b.alignment;
+		return a.start < b.start;
+	});
+
+	// Sweep over each group in start order, remembering the line which
+	// reaches furthest. Any line starting before that one ends overlaps it.
+	std::vector<bool> collides(placed.size());
+	size_t reach = 0;
+	for (size_t i = 0; i < placed.size(); ++i) {
+		if (i == 0 || !placed[reach].SamePlace(placed[i])) {
+			reach = i;
+			continue;
+		}
+		if (placed[i].start < placed[reach].end)
+			collides[i] = collides[reach] = true;
+		if (placed[i].end > placed[reach].end)
+			reach = i;
+	}
+
+	std::unordered_map<int, Line> new_lines;
+	new_lines.reserve(ass.Events.size());
+	for (auto const& line : ass.Events)
+		new_lines.emplace(line.Id, Line{line.Start, line.End, false});
+
+	size_t new_count = 0;
+	for (size_t i = 0; i < placed.size(); ++i) {
+		if (!collides[i]) continue;
+		new_lines[placed[i].line->Id].collides = true;
+		++new_count;
+	}
+
+	bool changed = new_count != count;
+	for (auto const& line : new_lines) {
+		if (changed) break;
+		auto old = lines.find(line.first);
+		changed = (old == lines.end() ? false : old->second.collides) != line.second.collides;
+	}
+
+	lines = std::move(new_lines);
+	count = new_count;
+	if (changed)
+		Changed();
+}
+
+bool CollisionIndex::Collides(const AssDialogue *line) const {
+	auto it = lines.find(line->Id);
+	return it != lines.end() && it->second.collides;
+}
+
+AssDialogue *CollisionIndex::Next(AssDialogue *line) const {
+	auto& events = context->ass->Events;
+	auto it = line ? ++context->ass->iterator_to(*line) : events.begin();
+	for (; it != events.end(); ++it) {
+		if (Collides(&*it))
+			return &*it;
+	}
+	return nullptr;
+}
+
+AssDialogue *CollisionIndex::Prev(AssDialogue *line) const {
+	auto& events = context->ass->Events;
+	auto it = line ? context->ass->iterator_to(*line) : events.end();
+	while (it != events.begin()) {
+		--it;
+		if (Collides(&*it))
+			return &*it;
+	}
+	return nullptr;
+}
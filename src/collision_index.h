@@ -0,0 +1,98 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+/// @file collision_index.h
+/// @brief Which lines are shown at the same time in the same place as another
+
+#pragma once
+
+#include <libaegisub/signal.h>
+
+#include <unordered_map>
+#include <utility>
+
+class AssDialogue;
+namespace agi {
+	struct Context;
+	class OptionValue;
+}
+
+/// @class CollisionIndex
+/// @brief Knows which lines of the file collide with another line
+///
+/// Two lines collide when they are shown at once with the same style, layer
+/// and alignment, so that the renderer has to move one of them out of the
+/// other's way. Comments and lines with no duration never collide. When the
+/// "Subtitle/Grid/Collisions By Frame" option is set and timecodes are
+/// loaded, lines only collide if they're shown on the same frame, so that
+/// overlaps of less than a frame aren't reported.
+///
+/// After commits which may have changed many lines the whole file is checked
+/// with a sweep over each group of lines in start time order. When just one
+/// line changed only the lines around its old and new times are checked
+/// again, using the file's time index.
+class CollisionIndex {
+	struct Line {
+		/// Time of the line when it was last checked, for finding the lines
+		/// which it used to overlap when it's retimed
+		int start;
+		int end;
+		bool collides;
+	};
+
+	agi::Context *context;
+	const agi::OptionValue *by_frame;
+	/// Every line which has been checked, by line ID
+	std::unordered_map<int, Line> lines;
+	/// Number of lines which collide
+	size_t count = 0;
+
+	agi::signal::Signal<> Changed;
+	agi::signal::Connection pre_commit_listener;
+	agi::signal::Connection timecodes_listener;
+	agi::signal::Connection by_frame_listener;
+
+	void OnPreCommit(int type, const AssDialogue *single_line);
+	/// Span of the line in the units collisions are found in, which is
+	/// empty if the line can't collide with anything
+	std::pair<int, int> Span(AssDialogue const& line) const;
+	/// Check a line against the lines overlapping it in the time index
+	bool Check(AssDialogue const& line) const;
+	/// Record whether a line collides
+	/// @return Did that change?
+	bool Set(AssDialogue const& line, bool collides);
+	/// Check the lines around a line which has changed
+	void UpdateAround(AssDialogue const& line);
+	/// Check every line of the file
+	void UpdateAll();
+
+public:
+	CollisionIndex(agi::Context *c);
+
+	/// Does the line collide with any other line?
+	bool Collides(const AssDialogue *line) const;
+	/// Number of lines which collide with another line
+	size_t Count() const { return count; }
+
+	/// Get the next colliding line after the given line in file order
+	/// @param line Line to start from, or nullptr to start at the beginning
+	/// @return The line, or nullptr if there are no more
+	AssDialogue *Next(AssDialogue *line) const;
+	/// Get the last colliding line before the given line in file order
+	/// @param line Line to start from, or nullptr to start at the end
+	/// @return The line, or nullptr if there are none before it
+	AssDialogue *Prev(AssDialogue *line) const;
+
+	DEFINE_SIGNAL_ADDERS(Changed, AddChangeListener)
+};
@@ -33,21 +33,30 @@
 
 #include "command.h"
 
+#include <libaegisub/dispatch.h>
+#include <libaegisub/io.h>
 #include <libaegisub/log.h>
 #include <libaegisub/make_unique.h>
+#include <libaegisub/trace.h>
 
 #include "../compat.h"
 #include "../dialog_detached_video.h"
 #include "../dialog_manager.h"
 #include "../dialogs.h"
+#include "../format.h"
 #include "../frame_main.h"
 #include "../include/aegisub/context.h"
 #include "../libresrc/libresrc.h"
 #include "../main.h"
 #include "../options.h"
 #include "../project.h"
+#include "../session_recorder.h"
 #include "../utils.h"
 
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
 namespace {
 	using cmd::Command;
 
@@ -187,6 +196,17 @@ struct app_log final : public Command {
 	}
 };
 
+struct app_memory_usage final : public Command {
+	CMD_NAME("app/memory_usage")
+	STR_MENU("&Memory usage")
+	STR_DISP("Memory usage")
+	STR_HELP("View how much memory each of the caches is using")
+
+	void operator()(agi::Context *c) override {
+		ShowMemoryUsageDialog(c);
+	}
+};
+
 struct app_new_window final : public Command {
 	CMD_NAME("app/new_window")
 	CMD_ICON(new_window_menu)
@@ -215,6 +235,106 @@ struct app_options final : public Command {
 	}
 };
 
+struct app_record_trace final : public Command {
+	CMD_NAME("app/record_trace")
+	STR_MENU("Record &Performance Trace...")
+	STR_DISP("Record Performance Trace")
+	STR_HELP("Record what Aegisub spends its time on for a few seconds and save it as a trace for chrome://tracing or Perfetto")
+	CMD_TYPE(COMMAND_VALIDATE)
+
+	bool Validate(const agi::Context *) override {
+		return agi::trace::IsAvailable() && !agi::trace::IsRecording();
+	}
+
+	void operator()(agi::Context *c) override {
+		auto filename = SaveFileSelector(_("Save performance trace"), "", "aegisub-trace.json", "json", "Chrome trace files (*.json)|*.json", c->parent);
+		if (filename.empty()) return;
+
+		const int seconds = std::max<int>(1, OPT_GET("App/Trace Seconds")->GetInt());
+		agi::trace::SetThreadName("Main");
+		agi::trace::Start();
+		c->frame->StatusTimeout(fmt_tl("Recording a performance trace for %d seconds...", seconds), seconds * 1000);
+
+		FrameMain *frame = c->frame;
+		agi::dispatch::Background(agi::dispatch::Priority::Bulk).Async([=] {
+			std::this_thread::sleep_for(std::chrono::seconds(seconds));
+			agi::dispatch::Main().Async([=] {
+				agi::trace::Stop();
+				try {
+					size_t events = agi::trace::Write(agi::io::Save(filename).Get());
+					LOG_I("trace") << "Wrote " << events << " trace events to " << filename;
+					// The window may have been closed while recording
+					auto const& frames = wxGetApp().frames;
+					if (find(begin(frames), end(frames), frame) != end(frames))
+						frame->StatusTimeout(fmt_tl("Saved performance trace to %s", filename.string()));
+				}
+				catch (agi::Exception const& e) {
+					wxMessageBox(to_wx(e.GetMessage()), _("Error saving performance trace"), wxOK | wxICON_ERROR | wxCENTER);
+				}
+			});
+		});
+	}
+};
+
+struct app_session_record final : public Command {
+	CMD_NAME("app/session/record")
+	STR_MENU("Record &Session...")
+	STR_DISP("Record Session")
+	STR_HELP("Save every command run from now on, along with the selection and video position, so that the session can be replayed for profiling")
+	CMD_TYPE(COMMAND_VALIDATE | COMMAND_TOGGLE)
+
+	bool Validate(const agi::Context *c) override {
+		return !session_recorder::IsBusy() || session_recorder::IsRecording(c);
+	}
+
+	bool IsActive(const agi::Context *c) override {
+		return session_recorder::IsRecording(c);
+	}
+
+	void operator()(agi::Context *c) override {
+		if (session_recorder::IsRecording(c)) {
+			session_recorder::StopRecording();
+			c->frame->StatusTimeout(_("Stopped recording session"));
+			return;
+		}
+
+		auto filename = SaveFileSelector(_("Save session recording"), "", "aegisub-session.jsonl", "jsonl", "Session recordings (*.jsonl)|*.jsonl", c->parent);
+		if (filename.empty()) return;
+
+		try {
+			session_recorder::StartRecording(c, filename);
+			c->frame->StatusTimeout(_("Recording session; run Record Session again to stop"));
+		}
+		catch (agi::Exception const& e) {
+			wxMessageBox(to_wx(e.GetMessage()), _("Error recording session"), wxOK | wxICON_ERROR | wxCENTER);
+		}
+	}
+};
+
+struct app_session_replay final : public Command {
+	CMD_NAME("app/session/replay")
+	STR_MENU("Re&play Session...")
+	STR_DISP("Replay Session")
+	STR_HELP("Run the commands from a session recording against the open project, timing each of them")
+	CMD_TYPE(COMMAND_VALIDATE)
+
+	bool Validate(const agi::Context *) override {
+		return !session_recorder::IsBusy();
+	}
+
+	void operator()(agi::Context *c) override {
+		auto filename = OpenFileSelector(_("Open session recording"), "", "", "jsonl", "Session recordings (*.jsonl)|*.jsonl", c->parent);
+		if (filename.empty()) return;
+
+		try {
+			session_recorder::Replay(c, filename);
+		}
+		catch (agi::Exception const& e) {
+			wxMessageBox(to_wx(e.GetMessage()), _("Error replaying session"), wxOK | wxICON_ERROR | wxCENTER);
+		}
+	}
+};
+
 struct app_toggle_global_hotkeys final : public Command {
 	CMD_NAME("app/toggle/global_hotkeys")
 	CMD_ICON(toggle_audio_medusa)
@@ -312,8 +432,12 @@ namespace cmd {
 		reg(agi::make_unique<app_exit>());
 		reg(agi::make_unique<app_language>());
 		reg(agi::make_unique<app_log>());
+		reg(agi::make_unique<app_memory_usage>());
 		reg(agi::make_unique<app_new_window>());
 		reg(agi::make_unique<app_options>());
+		reg(agi::make_unique<app_record_trace>());
+		reg(agi::make_unique<app_session_record>());
+		reg(agi::make_unique<app_session_replay>());
 		reg(agi::make_unique<app_toggle_global_hotkeys>());
 		reg(agi::make_unique<app_toggle_toolbar>());
 #ifdef __WXMAC__
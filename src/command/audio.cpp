@@ -32,12 +32,14 @@
 #include "command.h"
 
 #include "../ass_dialogue.h"
+#include "../ass_file.h"
 #include "../async_video_provider.h"
 #include "../audio_box.h"
 #include "../audio_controller.h"
 #include "../audio_karaoke.h"
 #include "../audio_timing.h"
 #include "../compat.h"
+#include "../dialog_progress.h"
 #include "../include/aegisub/context.h"
 #include "../libresrc/libresrc.h"
 #include "../options.h"
@@ -46,13 +48,62 @@
 #include "../utils.h"
 #include "../video_controller.h"
 
+#include <libaegisub/audio/clip_export.h>
 #include <libaegisub/audio/provider.h>
+#include <libaegisub/format.h>
 #include <libaegisub/make_unique.h>
 #include <libaegisub/io.h>
 
+#include <boost/algorithm/string/replace.hpp>
+#include <cstring>
+#include <unordered_set>
+#include <wx/dirdlg.h>
+#include <wx/textdlg.h>
+
 namespace {
 	using cmd::Command;
 
+	/// Make a string safe to use as part of a filename
+	std::string clip_name_safe(std::string str) {
+		for (auto& c : str) {
+			if ((unsigned char)c < 32 || strchr("\\/:*?\"<>|", c))
+				c = '_';
+		}
+		return str;
+	}
+
+	/// Get the filename for a clip by filling in the fields in the template
+	std::string clip_name(std::string name, size_t index, size_t count, size_t row, AssDialogue const& line) {
+		auto time = [](agi::Time t) {
+			auto str = t.GetSrtFormatted();
+			std::replace(str.begin(), str.end(), ':', '-');
+			std::replace(str.begin(), str.end(), ',', '-');
+			return str;
+		};
+
+		// Keep the start of the text, without cutting a UTF-8 sequence in half
+		auto text = line.GetStrippedText();
+		boost::replace_all(text, "\\N", " ");
+		boost::replace_all(text, "\\n", " ");
+		size_t chars = 0, len = 0;
+		for (; len < text.size(); ++len) {
+			if (((unsigned char)text[len] & 0xC0) != 0x80 && ++chars > 32)
+				break;
+		}
+		text.resize(len);
+
+		const int width = (int)std::to_string(count).size();
+		boost::replace_all(name, "{n}", agi::format("%0*d", width, index + 1));
+		boost::replace_all(name, "{line}", std::to_string(row + 1));
+		boost::replace_all(name, "{start}", time(line.Start));
+		boost::replace_all(name, "{end}", time(line.End));
+		boost::replace_all(name, "{actor}", clip_name_safe(line.Actor));
+		boost::replace_all(name, "{style}", clip_name_safe(line.Style));
+		boost::replace_all(name, "{effect}", clip_name_safe(line.Effect));
+		boost::replace_all(name, "{text}", clip_name_safe(text));
+		return clip_name_safe(name);
+	}
+
 	struct validate_audio_open : public Command {
 		CMD_TYPE(COMMAND_VALIDATE)
 		bool Validate(const agi::Context *c) override {
@@ -199,6 +250,60 @@ struct audio_save_clip final : public Command {
 	}
 };
 
+struct audio_save_clips final : public Command {
+	CMD_NAME("audio/save/clips")
+	STR_MENU("Export audio clips of selected lines...")
+	STR_DISP("Export audio clips of selected lines")
+	STR_HELP("Save each of the selected lines' audio as a separate WAV file")
+	CMD_TYPE(COMMAND_VALIDATE)
+
+	bool Validate(const agi::Context *c) override {
+		return c->project->AudioProvider() && !c->selectionController->GetSelectedSet().empty();
+	}
+
+	void operator()(agi::Context *c) override {
+		auto const& sel = c->selectionController->GetSelectedSet();
+		if (sel.empty()) return;
+
+		auto dir = wxDirSelector(_("Select the folder to save the clips in"), to_wx(OPT_GET("Path/Last/Audio Clips")->GetString()), 0, wxDefaultPosition, c->parent);
+		if (dir.empty()) return;
+		OPT_SET("Path/Last/Audio Clips")->SetString(from_wx(dir));
+
+		auto name_template = wxGetTextFromUser(
+			_("Name for each clip, where {n} is its number, {line} its line number, and {start}, {end}, {actor}, {style}, {effect} and {text} are the line's fields:"),
+			_("Export audio clips"),
+			to_wx(OPT_GET("Audio/Clip Export/Name Template")->GetString()), c->parent);
+		if (name_template.empty()) return;
+		OPT_SET("Audio/Clip Export/Name Template")->SetString(from_wx(name_template));
+
+		// In file order rather than the order they were selected in
+		std::vector<std::pair<size_t, AssDialogue *>> lines;
+		size_t row = 0;
+		for (auto& line : c->ass->Events) {
+			if (sel.count(&line))
+				lines.emplace_back(row, &line);
+			++row;
+		}
+
+		std::vector<agi::AudioClip> clips;
+		std::unordered_set<std::string> used;
+		agi::fs::path dir_path = from_wx(dir);
+		for (size_t i = 0; i < lines.size(); ++i) {
+			auto name = clip_name(from_wx(name_template), i, lines.size(), lines[i].first, *lines[i].second);
+			// Templates without {n} or {line} can give several lines the same name
+			auto unique = name;
+			for (int n = 2; !used.insert(unique).second; ++n)
+				unique = agi::format("%s_%d", name, n);
+			clips.push_back({dir_path / (unique + ".wav"), (int)lines[i].second->Start, (int)lines[i].second->End});
+		}
+
+		DialogProgress progress(c->parent, _("Export audio clips"), _("Saving the audio of the selected lines"));
+		progress.Run([&](agi::ProgressSink *ps) {
+			agi::SaveAudioClips(*c->project->AudioProvider(), clips, ps);
+		});
+	}
+};
+
 struct audio_play_current_selection final : public validate_audio_open {
 	CMD_NAME("audio/play/current")
 	STR_MENU("Play current audio selection")
@@ -571,6 +676,7 @@ namespace cmd {
 		reg(agi::make_unique<audio_play_to_end>());
 		reg(agi::make_unique<audio_play_toggle>());
 		reg(agi::make_unique<audio_save_clip>());
+		reg(agi::make_unique<audio_save_clips>());
 		reg(agi::make_unique<audio_scroll_left>());
 		reg(agi::make_unique<audio_scroll_right>());
 		reg(agi::make_unique<audio_stop>());
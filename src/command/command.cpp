@@ -18,15 +18,30 @@
 #include "../format.h"
 
 #include <libaegisub/log.h>
+#include <libaegisub/trace.h>
 
 #include <boost/algorithm/string/join.hpp>
+#include <boost/scope_exit.hpp>
 #include "include/aegisub/hotkey.h"
 
+#include <set>
 #include <wx/intl.h>
 
 namespace cmd {
 	static std::map<std::string, std::unique_ptr<Command>> cmd_map;
 	typedef std::map<std::string, std::unique_ptr<Command>>::iterator iterator;
+	static std::function<void (Command *, agi::Context *)> call_observer;
+	/// Number of calls to call() currently on the stack
+	static int call_depth = 0;
+
+	/// Names of commands which have appeared in a trace. Automation macros
+	/// can be unregistered while a trace still refers to their names, so
+	/// traces point at these copies instead.
+	static std::set<std::string> traced_names;
+
+	static const char *trace_name(Command const& cmd) {
+		return traced_names.insert(cmd.name()).first->c_str();
+	}
 
 	static iterator find_command(std::string const& name) {
 		auto it = cmd_map.find(name);
@@ -59,8 +74,19 @@ namespace cmd {
 
 	void call(std::string const& name, agi::Context*c) {
 		Command &cmd = *find_command(name)->second;
-		if (cmd.Validate(c))
-			cmd(c);
+		if (!cmd.Validate(c)) return;
+
+		if (call_depth == 0 && call_observer)
+			call_observer(&cmd, c);
+
+		++call_depth;
+		BOOST_SCOPE_EXIT_ALL(&) { --call_depth; };
+		AGI_TRACE_ZONE("command", agi::trace::IsRecording() ? trace_name(cmd) : nullptr);
+		cmd(c);
+	}
+
+	void set_call_observer(std::function<void (Command *, agi::Context *)> observer) {
+		call_observer = std::move(observer);
 	}
 
 	std::vector<std::string> get_registered_commands() {
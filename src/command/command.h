@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include <functional>
 #include <map>
 #include <string>
 #include <vector>
@@ -160,6 +161,13 @@ DEFINE_EXCEPTION(CommandNotFound, CommandError);
 	/// @param c  Current Context.
 	void call(std::string const& name, agi::Context *c);
 
+	/// Set a function to be called just before each command run by call()
+	/// @param observer Function to call, or an empty function to stop observing
+	///
+	/// Only commands which pass validation are reported, and commands run by
+	/// other commands are not reported separately.
+	void set_call_observer(std::function<void (Command *, agi::Context *)> observer);
+
 	/// Retrieve a Command object.
 	/// @param Command object.
 	Command* get(std::string const& name);
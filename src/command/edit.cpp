@@ -38,6 +38,7 @@
 #include "../compat.h"
 #include "../dialog_search_replace.h"
 #include "../dialogs.h"
+#include "../dialogue_batch.h"
 #include "../vcva_tag_gui.h"
 #include "../format.h"
 #include "../include/aegisub/context.h"
@@ -52,12 +53,13 @@
 #include "../utils.h"
 #include "../video_controller.h"
 
-#include <libaegisub/address_of_adaptor.h>
+#include <libaegisub/dispatch.h>
 #include <libaegisub/of_type_adaptor.h>
 #include <libaegisub/make_unique.h>
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <boost/algorithm/string.hpp>
 #include <boost/range/algorithm.hpp>
 #include <boost/range/adaptor/filtered.hpp>
@@ -77,6 +79,7 @@
 #include <wx/clipbrd.h>
 #include <wx/fontdlg.h>
 #include <wx/textentry.h>
+#include <wx/timer.h>
 
 namespace {
 	using namespace boost::adaptors;
@@ -556,31 +559,76 @@ AssDialogue *get_dialogue(String data) {
 	}
 }
 
-template<typename Paster>
-void paste_lines(agi::Context *c, bool paste_over, Paster&& paste_line) {
-	std::string data = GetClipboard();
-	if (data.empty()) return;
-
-	AssDialogue *first = nullptr;
-	Selection newsel;
+/// Number of clipboard lines parsed by each worker
+const size_t paste_lines_per_chunk = 1000;
 
+/// Parse each line of the clipboard, in parallel as pasting from another
+/// script can be tens of thousands of lines
+/// @param strict Give up and return nothing if any line isn't an ASS line,
+///               rather than pasting it as plain text
+std::vector<std::unique_ptr<AssDialogue>> parse_clipboard_lines(std::string const& data, bool strict) {
+	std::vector<std::string> strs;
 	boost::char_separator<char> sep("\r\n");
-	for (auto curdata : boost::tokenizer<boost::char_separator<char>>(data, sep)) {
-		AssDialogue *inserted = paste_line(get_dialogue(curdata));
-		if (!inserted)
-			break;
+	for (auto curdata : boost::tokenizer<boost::char_separator<char>>(data, sep))
+		strs.push_back(std::move(curdata));
+
+	std::vector<std::unique_ptr<AssDialogue>> lines(strs.size());
+	std::atomic<bool> failed{false};
+	const size_t chunks = (strs.size() + paste_lines_per_chunk - 1) / paste_lines_per_chunk;
+	agi::dispatch::Parallel(chunks, [&](size_t chunk) {
+		const size_t end = std::min(strs.size(), (chunk + 1) * paste_lines_per_chunk);
+		for (size_t i = chunk * paste_lines_per_chunk; i < end && !failed; ++i) {
+			if (!strict) {
+				lines[i].reset(get_dialogue(std::move(strs[i])));
+				continue;
+			}
+			boost::trim(strs[i]);
+			try {
+				lines[i] = agi::make_unique<AssDialogue>(strs[i]);
+			}
+			catch (...) {
+				failed = true;
+			}
+		}
+	});
+
+	if (failed) lines.clear();
+	return lines;
+}
 
-		newsel.insert(inserted);
-		if (!first)
-			first = inserted;
+/// Insert parsed lines before the given position with one splice, then
+/// commit once and select them all
+void insert_pasted_lines(agi::Context *c, EntryList<AssDialogue>::iterator pos, std::vector<std::unique_ptr<AssDialogue>> lines) {
+	if (lines.empty()) return;
+
+	EntryList<AssDialogue> pasted;
+	Selection new_selection;
+	new_selection.reserve(lines.size());
+	for (auto& line : lines) {
+		new_selection.insert(line.get());
+		pasted.push_back(*line.release());
 	}
 
-	if (first) {
-		c->ass->Commit(_("paste"), paste_over ? AssFile::COMMIT_DIAG_FULL : AssFile::COMMIT_DIAG_ADDREM);
+	AssDialogue *new_active = &*pasted.begin();
+	c->ass->Events.splice(pos, pasted, pasted.begin(), pasted.end());
+	c->ass->Commit(_("paste"), AssFile::COMMIT_DIAG_ADDREM);
+	c->selectionController->SetSelectionAndActive(std::move(new_selection), new_active);
+}
+
+template<typename Paster>
+void paste_lines_over(agi::Context *c, Paster&& paste_line) {
+	std::string data = GetClipboard();
+	if (data.empty()) return;
 
-		if (!paste_over)
-			c->selectionController->SetSelectionAndActive(std::move(newsel), first);
+	bool pasted = false;
+	for (auto& line : parse_clipboard_lines(data, false)) {
+		if (!paste_line(line.get()))
+			break;
+		pasted = true;
 	}
+
+	if (pasted)
+		c->ass->Commit(_("paste"), AssFile::COMMIT_DIAG_FULL);
 }
 
 AssDialogue *paste_over(wxWindow *parent, std::vector<bool>& pasteOverOptions, AssDialogue *new_line, AssDialogue *old_line) {
@@ -807,7 +855,13 @@ void update_lines(const agi::Context *c, wxString const& undo_msg, Func&& f) {
 		c->textSelectionController->SetSelection(sel_start + active_sel_shift, sel_end + active_sel_shift);
 }
 
+/// Number of lines transformed by each worker in update_lines_mapped
+const size_t update_lines_per_chunk = 256;
+
 // Manual test (Better View): enable Better View, use a long line with \N and Burmese text, apply BIUS or font changes at a caret and across a selection spanning a displayed newline; tags must align with the visual caret/selection.
+/// Run f over each selected line and commit the result. The lines are
+/// independent of each other, so all but the active line are run in parallel
+/// chunks; f is given each line's style as AssFile's lookup isn't thread-safe.
 template<typename Func>
 void update_lines_mapped(const agi::Context *c, wxString const& undo_msg, int sel_start, int sel_end, bool better_view, Func&& f) {
 	const auto active_line = c->selectionController->GetActiveLine();
@@ -817,13 +871,30 @@ void update_lines_mapped(const agi::Context *c, wxString const& undo_msg, int se
 	const int norm_sel_end = normalize_pos(active_line->Text, sel_end);
 	int active_sel_shift = 0;
 
-	for (const auto line : c->selectionController->GetSelectedSet()) {
-		int shift = f(line, sel_start, sel_end, norm_sel_start, norm_sel_end);
+	// The active line is done on this thread first, which also sets up
+	// anything the tag parser initializes on first use before the workers
+	// start using it
+	auto const& sel = c->selectionController->GetSelectedSet();
+	std::vector<AssDialogue *> lines;
+	std::vector<const AssStyle *> styles;
+	lines.reserve(sel.size());
+	styles.reserve(sel.size());
+	for (const auto line : sel) {
 		if (line == active_line)
-			active_sel_shift = shift;
+			active_sel_shift = f(line, c->ass->GetStyle(line->Style), sel_start, sel_end, norm_sel_start, norm_sel_end);
+		else {
+			lines.push_back(line);
+			styles.push_back(c->ass->GetStyle(line->Style));
+		}
 	}
 
-	auto const& sel = c->selectionController->GetSelectedSet();
+	const size_t chunks = (lines.size() + update_lines_per_chunk - 1) / update_lines_per_chunk;
+	agi::dispatch::Parallel(chunks, [&](size_t chunk) {
+		const size_t end = std::min(lines.size(), (chunk + 1) * update_lines_per_chunk);
+		for (size_t i = chunk * update_lines_per_chunk; i < end; ++i)
+			f(lines[i], styles[i], sel_start, sel_end, norm_sel_start, norm_sel_end);
+	});
+
 	c->ass->Commit(undo_msg, AssFile::COMMIT_DIAG_TEXT, -1, sel.size() == 1 ? *sel.begin() : nullptr);
 
 	int new_start = sel_start + active_sel_shift;
@@ -858,8 +929,7 @@ void toggle_override_tag(const agi::Context *c, bool (AssStyle::*field), const c
 			sel_start = sel_end = smart;
 	}
 
-	update_lines_mapped(c, undo_msg, sel_start, sel_end, better_view, [&](AssDialogue *line, int sel_start_raw, int sel_end_raw, int norm_sel_start, int norm_sel_end) {
-		AssStyle const* const style = c->ass->GetStyle(line->Style);
+	update_lines_mapped(c, undo_msg, sel_start, sel_end, better_view, [&](AssDialogue *line, const AssStyle *style, int sel_start_raw, int sel_end_raw, int norm_sel_start, int norm_sel_end) {
 		bool state = style ? style->*field : AssStyle().*field;
 
 		parsed_line parsed(line);
@@ -1401,35 +1471,6 @@ static std::string FormatAlphaValue(int value) {
 	return agi::format("&H%02X&", value);
 }
 
-static bool IsWholeLineSelection(const std::string& text, int sel_start, int sel_end) {
-	bool in_block = false;
-	int first_visible = -1;
-	int last_visible = -1;
-
-	for (int i = 0; i < static_cast<int>(text.size()); ++i) {
-		char ch = text[i];
-		if (ch == '{') {
-			in_block = true;
-			continue;
-		}
-		if (ch == '}') {
-			in_block = false;
-			continue;
-		}
-		if (in_block)
-			continue;
-
-		if (first_visible == -1)
-			first_visible = i;
-		last_visible = i;
-	}
-
-	if (first_visible == -1)
-		return true;
-
-	return sel_start <= first_visible && sel_end >= last_visible + 1;
-}
-
 static std::optional<int> ParseAlphaValue(const std::string& value) {
 	auto pos = value.find("&H");
 	if (pos == std::string::npos)
@@ -1453,7 +1494,7 @@ static std::optional<int> ParseAlphaValue(const std::string& value) {
 	}
 }
 
-static std::string ExtractTagValue(const std::string& text, int start, int limit) {
+static std::string ExtractTagValue(const std::string& text, int start, int limit, int *end = nullptr) {
 	int value_start = start;
 	while (value_start < limit && std::isspace(static_cast<unsigned char>(text[value_start])))
 		++value_start;
@@ -1482,6 +1523,8 @@ static std::string ExtractTagValue(const std::string& text, int start, int limit
 			++value_end;
 	}
 
+	if (end)
+		*end = value_end;
 	std::string value = text.substr(value_start, value_end - value_start);
 	boost::trim(value);
 	return value;
@@ -1498,15 +1541,142 @@ static int GetChannelFromName(const std::string& name, const std::string& base)
 	return 0;
 }
 
-static SelectionContext ScanSelectionContext(const std::string& text, int sel_start) {
-	SelectionContext ctx;
-	bool in_override = false;
+static void ApplyContextTag(SelectionContext& ctx, int channel, bool alpha_tag, bool gradient_tag, const std::string& name, const std::string& value) {
+	if (alpha_tag) {
+		auto& state = ctx.alphas[channel - 1];
+		state.has = true;
+		state.gradient = gradient_tag;
+		state.name = name;
+		state.value = value;
+		state.simple_value = -1;
+		if (!gradient_tag) {
+			if (auto parsed = ParseAlphaValue(value))
+				state.simple_value = *parsed;
+		}
+	}
+	else {
+		auto& state = ctx.channels[channel - 1];
+		state.type = gradient_tag ? ChannelTagType::TagGradient : ChannelTagType::TagColor;
+		state.name = name;
+		state.value = value;
+	}
+}
+
+class TagSpanIndex;
+
+/// Scan text[start, limit) for the color and alpha tags in effect at limit,
+/// starting outside or just inside an override block, and record what was
+/// seen in index if it isn't null
+static void ScanSelectionContextRange(const std::string& text, int start, int limit, bool in_override, SelectionContext& ctx, TagSpanIndex *index);
+
+/// @class TagSpanIndex
+/// @brief The override blocks and top-level color and alpha tags of a line
+///
+/// Applying a color to a selection needs the blocks of the line and the tags
+/// in effect at both ends of the selection, for every selected line and for
+/// every preview while the color is being picked. The text being applied to
+/// is the same each time, so it is scanned once when the picker is opened and
+/// the results are looked up from here.
+class TagSpanIndex {
+	friend void ScanSelectionContextRange(const std::string&, int, int, bool, SelectionContext&, TagSpanIndex *);
+
+	/// A color or alpha tag outside of \t
+	struct ContextTag {
+		int channel;
+		bool alpha;
+		bool gradient;
+		std::string name;
+		/// Where the search for the value started and where it ended
+		int value_start;
+		int value_end;
+		std::string value;
+	};
+
+	/// A position at which the context scanner is between tags and outside
+	/// of \t, so that it can be resumed from there
+	struct ResumePoint {
+		int pos;
+		bool in_override;
+		/// Number of tags before pos
+		size_t tags;
+	};
+
+	std::vector<OverrideBlockRange> blocks;
+	std::vector<ContextTag> tags;
+	std::vector<ResumePoint> resume_points;
+	int first_visible = -1;
+	int last_visible = -1;
+
+public:
+	explicit TagSpanIndex(const std::string& text)
+	: blocks(FindOverrideBlocks(text))
+	{
+		bool in_block = false;
+		for (int i = 0; i < static_cast<int>(text.size()); ++i) {
+			char ch = text[i];
+			if (ch == '{' || ch == '}')
+				in_block = ch == '{';
+			else if (!in_block) {
+				if (first_visible == -1)
+					first_visible = i;
+				last_visible = i;
+			}
+		}
+
+		SelectionContext ctx;
+		ScanSelectionContextRange(text, 0, static_cast<int>(text.size()), false, ctx, this);
+	}
+
+	const std::vector<OverrideBlockRange>& Blocks() const { return blocks; }
+
+	/// Does the selection cover all of the line's visible text?
+	bool IsWholeLine(int sel_start, int sel_end) const {
+		if (first_visible == -1)
+			return true;
+		return sel_start <= first_visible && sel_end >= last_visible + 1;
+	}
+
+	/// Get the color and alpha tags in effect at pos in the text the index
+	/// was built from
+	SelectionContext ContextAt(const std::string& text, int pos) const {
+		int limit = std::clamp(pos, 0, static_cast<int>(text.size()));
+		auto resume = std::partition_point(resume_points.begin(), resume_points.end(),
+			[=](ResumePoint const& point) { return point.pos < limit; });
+
+		int start = 0;
+		bool in_override = false;
+		size_t tag_count = 0;
+		if (resume != resume_points.begin()) {
+			--resume;
+			start = resume->pos;
+			in_override = resume->in_override;
+			tag_count = resume->tags;
+		}
+
+		SelectionContext ctx;
+		for (size_t i = 0; i < tag_count; ++i) {
+			auto const& tag = tags[i];
+			// A parenthesized value can run past the following tags, and
+			// the scan would have stopped it at the limit
+			if (tag.value_end > limit)
+				ApplyContextTag(ctx, tag.channel, tag.alpha, tag.gradient, tag.name, ExtractTagValue(text, tag.value_start, limit));
+			else
+				ApplyContextTag(ctx, tag.channel, tag.alpha, tag.gradient, tag.name, tag.value);
+		}
+		ScanSelectionContextRange(text, start, limit, in_override, ctx, nullptr);
+		return ctx;
+	}
+};
+
+static void ScanSelectionContextRange(const std::string& text, int start, int limit, bool in_override, SelectionContext& ctx, TagSpanIndex *index) {
 	bool in_transform = false;
 	int paren_depth = 0;
-	int limit = std::clamp(sel_start, 0, static_cast<int>(text.size()));
 
-	for (int i = 0; i < limit; ++i) {
+	for (int i = start; i < limit; ++i) {
 		char ch = text[i];
+		if (index && !in_transform && (ch == '\\' ? in_override : ch == '{' && !in_override))
+			index->resume_points.push_back({i, in_override, index->tags.size()});
+
 		if (ch == '{') {
 			in_override = true;
 			continue;
@@ -1576,28 +1746,12 @@ static SelectionContext ScanSelectionContext(const std::string& text, int sel_st
 			continue;
 		}
 
-		std::string value = ExtractTagValue(text, tag_end, limit);
-		if (alpha_tag) {
-			auto& state = ctx.alphas[channel - 1];
-			state.has = true;
-			state.gradient = gradient_tag;
-			state.name = name;
-			state.value = value;
-			state.simple_value = -1;
-			if (!gradient_tag) {
-				if (auto parsed = ParseAlphaValue(value))
-					state.simple_value = *parsed;
-			}
-		}
-		else {
-			auto& state = ctx.channels[channel - 1];
-			state.type = gradient_tag ? ChannelTagType::TagGradient : ChannelTagType::TagColor;
-			state.name = name;
-			state.value = value;
-		}
+		int value_end;
+		std::string value = ExtractTagValue(text, tag_end, limit, &value_end);
+		if (index)
+			index->tags.push_back({channel, alpha_tag, gradient_tag, name, tag_end, value_end, value});
+		ApplyContextTag(ctx, channel, alpha_tag, gradient_tag, name, value);
 	}
-
-	return ctx;
 }
 
 static SelectionApplyResult InsertBoundaryTags(
@@ -1652,6 +1806,7 @@ static SelectionApplyResult InsertBoundaryTags(
 
 static SelectionApplyResult ApplyColorOrGradientToRange(
 	const std::string& text,
+	const TagSpanIndex& index,
 	int sel_start,
 	int sel_end,
 	const SelectionApplyOptions& opts)
@@ -1674,7 +1829,7 @@ static SelectionApplyResult ApplyColorOrGradientToRange(
 	const int original_start = selection_start;
 	const int original_end = selection_end;
 
-	std::vector<OverrideBlockRange> spans = FindOverrideBlocks(text);
+	auto const& spans = index.Blocks();
 	int apply_start = selection_start;
 	int apply_end = selection_end;
 	if (selection_start < selection_end) {
@@ -1683,10 +1838,10 @@ static SelectionApplyResult ApplyColorOrGradientToRange(
 		apply_end = std::max(apply_end, apply_start);
 	}
 
-	const bool whole_line = IsWholeLineSelection(text, original_start, original_end);
+	const bool whole_line = index.IsWholeLine(original_start, original_end);
 
-	SelectionContext start_ctx = ScanSelectionContext(text, apply_start);
-	SelectionContext end_ctx = ScanSelectionContext(text, apply_end);
+	SelectionContext start_ctx = index.ContextAt(text, apply_start);
+	SelectionContext end_ctx = index.ContextAt(text, apply_end);
 	ChannelTagState start_prev_color = start_ctx.channels[params.channel - 1];
 	AlphaTagState start_prev_alpha = start_ctx.alphas[params.channel - 1];
 	ChannelTagState restore_prev_color = end_ctx.channels[params.channel - 1];
@@ -1834,6 +1989,51 @@ static SelectionApplyResult ApplyColorOrGradientToRange(
 	return wrapped;
 }
 
+/// Milliseconds between previews of a color being picked, which is about
+/// as often as the display can show them anyway
+const int color_preview_interval = 16;
+
+/// @class PreviewThrottle
+/// @brief Applies only the latest of a stream of preview values
+///
+/// The color pickers report every mouse event while a slider or the spectrum
+/// is being dragged, and rewriting the tags of every selected line for each
+/// of them can't keep up. Values are held until the timer fires, and anything
+/// newer which arrives in the meantime replaces them.
+template<class T>
+class PreviewThrottle {
+	std::function<void (T const&)> apply;
+	wxTimer timer;
+	T pending{};
+	bool has_pending = false;
+
+public:
+	PreviewThrottle(std::function<void (T const&)> apply) : apply(std::move(apply)) {
+		timer.Bind(wxEVT_TIMER, [this](wxTimerEvent&) { Flush(); });
+	}
+
+	void operator()(T const& value) {
+		pending = value;
+		has_pending = true;
+		if (!timer.IsRunning())
+			timer.StartOnce(color_preview_interval);
+	}
+
+	/// Apply the pending value now, if there is one
+	void Flush() {
+		timer.Stop();
+		if (!has_pending) return;
+		has_pending = false;
+		apply(pending);
+	}
+
+	/// Drop the pending value
+	void Cancel() {
+		timer.Stop();
+		has_pending = false;
+	}
+};
+
 void show_color_picker(const agi::Context *c, agi::Color (AssStyle::*field), const char *tag, const char *alt, const char *alpha, ColorPickerInvoker picker = GetColorFromUser) {
 	agi::Color initial_color;
 	const auto active_line = c->selectionController->GetActiveLine();
@@ -1908,6 +2108,7 @@ void show_color_picker(const agi::Context *c, agi::Color (AssStyle::*field), con
 	ColorRestoreInfo restore;
 	ColorWrapResult wrap_result;
 	std::string original_text;
+	std::optional<TagSpanIndex> tag_index;
 
 	line_info(agi::Color c, parsed_line&& p, ColorRestoreInfo r, std::string original)
 	: color(c)
@@ -1938,6 +2139,8 @@ void show_color_picker(const agi::Context *c, agi::Color (AssStyle::*field), con
 			restore_info = FindColorRestoreInfo(line->Text, sel_start, channel);
 
 		lines.emplace_back(color, std::move(parsed), restore_info, line->Text.get());
+		if (use_selection_wrap)
+			lines.back().tag_index.emplace(lines.back().original_text);
 	}
 
 	auto restore_original_texts = [&]() {
@@ -1956,7 +2159,27 @@ void show_color_picker(const agi::Context *c, agi::Color (AssStyle::*field), con
 	};
 
 	int active_shift = 0;
-	int commit_id = -1;
+	AssDialogue *single_line = sel.size() == 1 ? *sel.begin() : nullptr;
+
+	// Previews are committed without an undo message, which updates the
+	// displays without adding undo entries, and the result is committed for
+	// real once the picker is closed
+	bool previewed = false;
+	auto commit_preview = [&] {
+		c->ass->Commit("", AssFile::COMMIT_DIAG_TEXT, -1, single_line);
+		previewed = true;
+	};
+	auto finish_preview = [&](bool ok, wxString const& message) {
+		if (!previewed) return;
+		if (ok)
+			c->ass->Commit(message, AssFile::COMMIT_DIAG_TEXT, -1, single_line);
+		else {
+			restore_original_texts();
+			c->ass->Commit("", AssFile::COMMIT_DIAG_TEXT, -1, single_line);
+			reset_selection();
+		}
+		previewed = false;
+	};
 
 	const std::string color_tag_str = tag ? std::string(tag) : std::string();
 	const std::string color_tag_alt_str = alt ? std::string(alt) : std::string();
@@ -1975,7 +2198,7 @@ void show_color_picker(const agi::Context *c, agi::Color (AssStyle::*field), con
 		const std::string gradient_tag_alt = channel == 1 ? "\\vc" : std::string();
 		const std::string gradient_alpha_tag_alt = channel == 1 ? "\\va" : std::string();
 
-		gradient_handler = [=, &lines, &sel, &gradient_used, &commit_id](wxWindow *owner) mutable {
+		gradient_handler = [=, &lines, &gradient_used, &previewed](wxWindow *owner) mutable {
 			if (!owner || !active_line) return;
 			gradient_used = true;
 
@@ -2021,8 +2244,8 @@ void show_color_picker(const agi::Context *c, agi::Color (AssStyle::*field), con
 			}
 			gradient_state.alpha_touched = false;
 
-			int gradient_commit_id = -1;
-			auto apply_state = [&](bool use_color, bool use_alpha, const std::array<agi::Color, 4>& colors, const std::array<uint8_t, 4>& alphas) {
+			bool gradient_previewed = false;
+			auto apply_state = [&](bool use_color, bool use_alpha, const std::array<agi::Color, 4>& colors, const std::array<uint8_t, 4>& alphas, bool final) {
 				// Gradient currently ignores selection wrapping to avoid crashes; apply at caret only.
 				int local_active_shift = 0;
 				for (size_t idx = 0; idx < lines.size(); ++idx) {
@@ -2058,30 +2281,41 @@ void show_color_picker(const agi::Context *c, agi::Color (AssStyle::*field), con
 				}
 
 				if (!lines_are_valid_utf8()) {
-					if (gradient_commit_id != -1)
-						c->subsController->Undo();
-					restore_original_texts();
-					gradient_commit_id = -1;
+					for (size_t idx = 0; idx < lines.size(); ++idx) {
+						lines[idx].parsed.line->Text = original_texts[idx];
+						lines[idx].parsed = parsed_line(lines[idx].parsed.line);
+					}
+					if (gradient_previewed)
+						c->ass->Commit("", AssFile::COMMIT_DIAG_TEXT, -1, single_line);
+					gradient_previewed = false;
 					return;
 				}
 
-				gradient_commit_id = c->ass->Commit(_("set gradient color"), AssFile::COMMIT_DIAG_TEXT, gradient_commit_id, sel.size() == 1 ? *sel.begin() : nullptr);
+				// Only the final state gets an undo entry
+				c->ass->Commit(final ? _("set gradient color") : wxString(), AssFile::COMMIT_DIAG_TEXT, -1, single_line);
+				gradient_previewed = !final;
 				if (local_active_shift)
 					set_selection_display(sel_start + local_active_shift, sel_start + local_active_shift, active_line->Text.get());
 			};
 
+			PreviewThrottle<VcVaGradientState> preview([&](VcVaGradientState const& state) {
+				apply_state(true, state.alpha_touched, state.colors, state.alphas, false);
+			});
+
 			auto revert_preview = [&]() {
-				if (gradient_commit_id != -1) {
-					c->subsController->Undo();
-					gradient_commit_id = -1;
-					for (auto& entry : lines)
-						entry.parsed = parsed_line(entry.parsed.line);
-					reset_selection();
+				preview.Cancel();
+				if (!gradient_previewed) return;
+				gradient_previewed = false;
+				for (size_t idx = 0; idx < lines.size(); ++idx) {
+					lines[idx].parsed.line->Text = original_texts[idx];
+					lines[idx].parsed = parsed_line(lines[idx].parsed.line);
 				}
+				c->ass->Commit("", AssFile::COMMIT_DIAG_TEXT, -1, single_line);
+				reset_selection();
 			};
 
 			auto preview_cb = [&](const VcVaGradientState& state) {
-				apply_state(true, state.alpha_touched, state.colors, state.alphas);
+				preview(state);
 			};
 
 			auto result = ShowVcVaGradientDialog(owner, gradient_state, preview_cb, revert_preview);
@@ -2094,8 +2328,10 @@ void show_color_picker(const agi::Context *c, agi::Color (AssStyle::*field), con
 				return;
 			}
 
-			apply_state(result.has_color, result.has_alpha, result.colors, result.alphas);
-			gradient_commit_id = -1;
+			preview.Cancel();
+			apply_state(result.has_color, result.has_alpha, result.colors, result.alphas, true);
+			// The picker this was opened from has nothing left to undo
+			previewed = false;
 		};
 		SetShinGradientHandler(gradient_handler);
 	}
@@ -2103,7 +2339,7 @@ void show_color_picker(const agi::Context *c, agi::Color (AssStyle::*field), con
 		SetShinGradientHandler({});
 
 	if (!use_selection_wrap) {
-		bool ok = effective_picker(c->parent, initial_color, true, [&](agi::Color new_color) {
+		PreviewThrottle<agi::Color> preview([&](agi::Color const& new_color) {
 			for (auto& line : lines) {
 				std::string raw_text = line.parsed.line->Text.get();
 				ScopeInfo scope = ComputeScope(raw_text, sel_start);
@@ -2187,60 +2423,72 @@ void show_color_picker(const agi::Context *c, agi::Color (AssStyle::*field), con
 				return;
 			}
 
-			commit_id = c->ass->Commit(_("set color"), AssFile::COMMIT_DIAG_TEXT, commit_id, sel.size() == 1 ? *sel.begin() : nullptr);
+			commit_preview();
 			if (active_shift)
 				set_selection_display(sel_start + active_shift, sel_start + active_shift, active_line->Text.get());
 		});
 
-		if (!ok && commit_id != -1) {
-			c->subsController->Undo();
-			reset_selection();
-		}
+		bool ok = effective_picker(c->parent, initial_color, true, [&](agi::Color new_color) {
+			preview(new_color);
+		});
+
+		if (ok)
+			preview.Flush();
+		else
+			preview.Cancel();
+		finish_preview(ok, _("set color"));
 		return;
 	}
 
 	auto apply_selection_color = [&](const agi::Color& new_color) {
 		int start_shift = 0;
 		int end_shift = 0;
-		for (auto& line : lines) {
-			SelectionApplyOptions options;
-			options.channel = channel;
-			options.use_gradient = false;
-			options.add_color_tag = true;
-			options.apply_alpha_gradient = false;
-			options.new_color_value = new_color.GetAssOverrideFormatted();
-			options.color_tag_name = color_tag_name;
-			options.gradient_tag_name = gradient_tag_name;
-			options.alpha_tag_name = alpha_tag_name;
-			options.alpha_gradient_tag_name = gradient_alpha_tag_name;
-
-			SelectionApplyResult res = ApplyColorOrGradientToRange(line.original_text, sel_start, sel_end, options);
-			line.parsed.line->Text = res.text;
-			if (line.parsed.line == active_line) {
-				start_shift = res.shift.start;
-				end_shift = res.shift.end;
+		SelectionApplyOptions options;
+		options.channel = channel;
+		options.use_gradient = false;
+		options.add_color_tag = true;
+		options.apply_alpha_gradient = false;
+		options.new_color_value = new_color.GetAssOverrideFormatted();
+		options.color_tag_name = color_tag_name;
+		options.gradient_tag_name = gradient_tag_name;
+		options.alpha_tag_name = alpha_tag_name;
+		options.alpha_gradient_tag_name = gradient_alpha_tag_name;
+
+		// Each line is rewritten from its own original text only
+		const size_t chunks = (lines.size() + update_lines_per_chunk - 1) / update_lines_per_chunk;
+		agi::dispatch::Parallel(chunks, [&](size_t chunk) {
+			const size_t end = std::min(lines.size(), (chunk + 1) * update_lines_per_chunk);
+			for (size_t i = chunk * update_lines_per_chunk; i < end; ++i) {
+				auto& line = lines[i];
+				SelectionApplyResult res = ApplyColorOrGradientToRange(line.original_text, *line.tag_index, sel_start, sel_end, options);
+				line.parsed.line->Text = res.text;
+				if (line.parsed.line == active_line) {
+					start_shift = res.shift.start;
+					end_shift = res.shift.end;
+				}
 			}
-		}
+		});
 
 		if (!lines_are_valid_utf8()) {
 			restore_original_texts();
 			return;
 		}
 
-		commit_id = c->ass->Commit(_("set color"), AssFile::COMMIT_DIAG_TEXT, commit_id, sel.size() == 1 ? *sel.begin() : nullptr);
+		commit_preview();
 		if (start_shift || end_shift)
 			set_selection_display(sel_start + start_shift, sel_end + end_shift, active_line->Text.get());
 	};
 
+	PreviewThrottle<agi::Color> preview(apply_selection_color);
 	bool ok = effective_picker(c->parent, initial_color, true, [&](agi::Color new_color) {
-		apply_selection_color(new_color);
+		preview(new_color);
 	});
 
-	if (!ok && commit_id != -1) {
-		c->subsController->Undo();
-		reset_selection();
-		return;
-	}
+	if (ok)
+		preview.Flush();
+	else
+		preview.Cancel();
+	finish_preview(ok, _("set color"));
 
 	if (gradient_used)
 		return;
@@ -2395,24 +2643,36 @@ struct edit_font final : public Command {
 			return;
 		}
 
-		update_lines_mapped(c, _("set font"), sel_start, sel_end, better_view, [&](AssDialogue *line, int sel_start_raw, int sel_end_raw, int norm_sel_start, int norm_sel_end) {
+		// Lines are transformed off the GUI thread, where wxFont can't be
+		// used, so they're compared against the chosen font's values
+		const std::string face = from_wx(font.GetFaceName());
+		const int point_size = font.GetPointSize();
+		const bool bold = font.GetWeight() == wxFONTWEIGHT_BOLD;
+		const bool italic = font.GetStyle() == wxFONTSTYLE_ITALIC;
+		const bool underlined = font.GetUnderlined();
+
+		update_lines_mapped(c, _("set font"), sel_start, sel_end, better_view, [&](AssDialogue *line, const AssStyle *style, int sel_start_raw, int sel_end_raw, int norm_sel_start, int norm_sel_end) {
 			parsed_line parsed(line);
-			const wxFont startfont = font_for_line(parsed);
+			const int blockn = parsed.block_at_pos(insertion_point);
+			const AssStyle default_style;
+			if (!style)
+				style = &default_style;
+
 			int shift = 0;
 			auto do_set_tag = [&](const char *tag_name, std::string const& value) {
 				shift += parsed.set_tag(tag_name, value, norm_sel_start, sel_start_raw + shift);
 			};
 
-			if (font.GetFaceName() != startfont.GetFaceName())
-				do_set_tag("\\fn", from_wx(font.GetFaceName()));
-			if (font.GetPointSize() != startfont.GetPointSize())
-				do_set_tag("\\fs", std::to_string(font.GetPointSize()));
-			if (font.GetWeight() != startfont.GetWeight())
-				do_set_tag("\\b", std::to_string(font.GetWeight() == wxFONTWEIGHT_BOLD));
-			if (font.GetStyle() != startfont.GetStyle())
-				do_set_tag("\\i", std::to_string(font.GetStyle() == wxFONTSTYLE_ITALIC));
-			if (font.GetUnderlined() != startfont.GetUnderlined())
-				do_set_tag("\\i", std::to_string(font.GetUnderlined()));
+			if (face != parsed.get_value(blockn, style->font, "\\fn"))
+				do_set_tag("\\fn", face);
+			if (point_size != parsed.get_value(blockn, (int)style->fontsize, "\\fs"))
+				do_set_tag("\\fs", std::to_string(point_size));
+			if (bold != parsed.get_value(blockn, style->bold, "\\b"))
+				do_set_tag("\\b", std::to_string(bold));
+			if (italic != parsed.get_value(blockn, style->italic, "\\i"))
+				do_set_tag("\\i", std::to_string(italic));
+			if (underlined != parsed.get_value(blockn, style->underline, "\\u"))
+				do_set_tag("\\i", std::to_string(underlined));
 
 			return shift;
 		});
@@ -2457,16 +2717,13 @@ static void delete_lines(agi::Context *c, wxString const& commit_message) {
 			pre_sel = &diag;
 	}
 
-	// Remove the selected lines, but defer the deletion until after we select
-	// different lines. We can't just change the selection first because we may
-	// need to create a new dialogue line for it, and we can't select dialogue
-	// lines until after they're committed.
-	std::vector<std::unique_ptr<AssDialogue>> to_delete;
-	c->ass->Events.remove_and_dispose_if([&sel](AssDialogue const& e) {
-		return sel.count(const_cast<AssDialogue *>(&e));
-	}, [&](AssDialogue *e) {
-		to_delete.emplace_back(e);
-	});
+	// The batch defers deleting the lines until after we select different
+	// lines. We can't just change the selection first because we may need to
+	// create a new dialogue line for it, and we can't select dialogue lines
+	// until after they're committed.
+	DialogueBatch batch(c);
+	for (auto line : sel)
+		batch.Remove(line);
 
 	AssDialogue *new_active = post_sel;
 	if (!new_active)
@@ -2478,8 +2735,7 @@ static void delete_lines(agi::Context *c, wxString const& commit_message) {
 		c->ass->Events.push_back(*new_active);
 	}
 
-	c->ass->Commit(commit_message, AssFile::COMMIT_DIAG_ADDREM);
-	c->selectionController->SetSelectionAndActive({ new_active }, new_active);
+	batch.Commit(commit_message, AssFile::COMMIT_DIAG_ADDREM, { new_active }, new_active);
 }
 
 struct edit_line_copy final : public validate_sel_nonempty {
@@ -2601,8 +2857,10 @@ static void duplicate_lines(agi::Context *c, int shift) {
 	auto const& sel = c->selectionController->GetSelectedSet();
 	auto in_selection = [&](AssDialogue const& d) { return sel.count(const_cast<AssDialogue *>(&d)); };
 
+	DialogueBatch batch(c);
 	Selection new_sel;
 	AssDialogue *new_active = nullptr;
+	const int cur_frame = shift ? c->videoController->GetFrameN() : 0;
 
 	auto start = c->ass->Events.begin();
 	auto end = c->ass->Events.end();
@@ -2612,22 +2870,20 @@ static void duplicate_lines(agi::Context *c, int shift) {
 		if (start == end) break;
 
 		// And the last line in this contiguous selection
-		auto insert_pos = std::find_if_not(start, end, in_selection);
-		auto last = std::prev(insert_pos);
+		auto block_end = std::find_if_not(start, end, in_selection);
+		auto last = &*std::prev(block_end);
 
 		// Duplicate each of the selected lines, inserting them in a block
 		// after the selected block
-		do {
+		for (; start != block_end; ++start) {
 			auto old_diag = &*start;
-			auto new_diag = new AssDialogue(*old_diag);
+			auto new_diag = batch.InsertAfter(last, agi::make_unique<AssDialogue>(*old_diag));
 
-			c->ass->Events.insert(insert_pos, *new_diag);
 			new_sel.insert(new_diag);
 			if (!new_active)
 				new_active = new_diag;
 
 			if (shift) {
-				int cur_frame = c->videoController->GetFrameN();
 				int old_start = c->videoController->FrameAtTime(new_diag->Start, agi::vfr::START);
 				int old_end = c->videoController->FrameAtTime(new_diag->End, agi::vfr::END);
 
@@ -2650,17 +2906,12 @@ static void duplicate_lines(agi::Context *c, int shift) {
 
 				/// @todo also split \t and \move?
 			}
-		} while (start++ != last);
-
-		// Skip over the lines we just made
-		start = insert_pos;
+		}
 	}
 
-	if (new_sel.empty()) return;
-
-	c->ass->Commit(shift ? _("split") : _("duplicate lines"), AssFile::COMMIT_DIAG_ADDREM);
+	if (batch.empty()) return;
 
-	c->selectionController->SetSelectionAndActive(std::move(new_sel), new_active);
+	batch.Commit(shift ? _("split") : _("duplicate lines"), AssFile::COMMIT_DIAG_ADDREM, std::move(new_sel), new_active);
 }
 
 struct edit_line_duplicate final : public validate_sel_nonempty {
@@ -2698,35 +2949,52 @@ struct edit_line_duplicate_shift_back final : public validate_video_and_sel_none
 	}
 };
 
-static void combine_lines(agi::Context *c, void (*combiner)(AssDialogue *, AssDialogue *), wxString const& message) {
+/// Combine the selected lines into the first of them
+/// @param combiner Function which appends the text of the second line to the
+///                 text being built up, or initializes it from the first line
+///                 if the second line is null
+static void combine_lines(agi::Context *c, void (*combiner)(std::string&, AssDialogue *, AssDialogue *), wxString const& message) {
 	auto sel = c->selectionController->GetSortedSelection();
 
+	// Build the text up separately rather than assigning each step to the
+	// line, as every intermediate value would be interned
 	AssDialogue *first = sel[0];
-	combiner(first, nullptr);
+	std::string text;
+	combiner(text, first, nullptr);
+
+	DialogueBatch batch(c);
 	for (size_t i = 1; i < sel.size(); ++i) {
-		combiner(first, sel[i]);
+		combiner(text, first, sel[i]);
 		first->End = std::max(first->End, sel[i]->End);
-		delete sel[i];
+		batch.Remove(sel[i]);
 	}
+	first->Text = text;
 
-	c->selectionController->SetSelectionAndActive({first}, first);
-
-	c->ass->Commit(message, AssFile::COMMIT_DIAG_ADDREM | AssFile::COMMIT_DIAG_FULL);
+	batch.Commit(message, AssFile::COMMIT_DIAG_ADDREM | AssFile::COMMIT_DIAG_FULL, {first}, first);
 }
 
-static void combine_karaoke(AssDialogue *first, AssDialogue *second) {
-	if (second)
-		first->Text = first->Text.get() + "{\\k" + std::to_string((second->End - second->Start) / 10) + "}" + second->Text.get();
+static void combine_karaoke(std::string& text, AssDialogue *first, AssDialogue *second) {
+	if (second) {
+		text += "{\\k" + std::to_string((second->End - second->Start) / 10) + "}";
+		text += second->Text.get();
+	}
 	else
-		first->Text = "{\\k" + std::to_string((first->End - first->Start) / 10) + "}" + first->Text.get();
+		text = "{\\k" + std::to_string((first->End - first->Start) / 10) + "}" + first->Text.get();
 }
 
-static void combine_concat(AssDialogue *first, AssDialogue *second) {
-	if (second)
-		first->Text = first->Text.get() + " " + second->Text.get();
+static void combine_concat(std::string& text, AssDialogue *first, AssDialogue *second) {
+	if (second) {
+		text += ' ';
+		text += second->Text.get();
+	}
+	else
+		text = first->Text;
 }
 
-static void combine_drop(AssDialogue *, AssDialogue *) { }
+static void combine_drop(std::string& text, AssDialogue *first, AssDialogue *second) {
+	if (!second)
+		text = first->Text;
+}
 
 static AssDialogue *get_adjacent_line(agi::Context const *c, AssDialogue *line, int step) {
 	if (!line || step == 0) return line;
@@ -2956,29 +3224,10 @@ static bool try_paste_lines(agi::Context *c) {
 	boost::trim_left(data);
 	if (!boost::starts_with(data, "Dialogue:")) return false;
 
-	EntryList<AssDialogue> parsed;
-	boost::char_separator<char> sep("\r\n");
-	for (auto curdata : boost::tokenizer<boost::char_separator<char>>(data, sep)) {
-		boost::trim(curdata);
-		try {
-			parsed.push_back(*new AssDialogue(curdata));
-		}
-		catch (...) {
-			parsed.clear_and_dispose([](AssDialogue *e) { delete e; });
-			return false;
-		}
-	}
-
-	AssDialogue *new_active = &*parsed.begin();
-	Selection new_selection;
-	for (auto& line : parsed)
-		new_selection.insert(&line);
-
-	auto pos = c->ass->iterator_to(*c->selectionController->GetActiveLine());
-	c->ass->Events.splice(pos, parsed, parsed.begin(), parsed.end());
-	c->ass->Commit(_("paste"), AssFile::COMMIT_DIAG_ADDREM);
-	c->selectionController->SetSelectionAndActive(std::move(new_selection), new_active);
+	auto lines = parse_clipboard_lines(data, true);
+	if (lines.empty()) return false;
 
+	insert_pasted_lines(c, c->ass->iterator_to(*c->selectionController->GetActiveLine()), std::move(lines));
 	return true;
 }
 
@@ -3005,11 +3254,10 @@ struct edit_line_paste final : public Command {
 				ctrl->Paste();
 		}
 		else {
-			auto pos = c->ass->iterator_to(*c->selectionController->GetActiveLine());
-			paste_lines(c, false, [=](AssDialogue *new_line) -> AssDialogue * {
-				c->ass->Events.insert(pos, *new_line);
-				return new_line;
-			});
+			std::string data = GetClipboard();
+			if (data.empty()) return;
+			insert_pasted_lines(c, c->ass->iterator_to(*c->selectionController->GetActiveLine()),
+				parse_clipboard_lines(data, false));
 		}
 	}
 };
@@ -3038,8 +3286,7 @@ struct edit_line_paste_over final : public Command {
 		if (sel.size() < 2) {
 			auto pos = c->ass->iterator_to(*c->selectionController->GetActiveLine());
 
-			paste_lines(c, true, [&](AssDialogue *new_line) -> AssDialogue * {
-				std::unique_ptr<AssDialogue> deleter(new_line);
+			paste_lines_over(c, [&](AssDialogue *new_line) -> AssDialogue * {
 				if (pos == c->ass->Events.end()) return nullptr;
 
 				AssDialogue *ret = paste_over(c->parent, pasteOverOptions, new_line, &*pos);
@@ -3052,8 +3299,7 @@ struct edit_line_paste_over final : public Command {
 			// Multiple lines selected, so paste over the selection
 			auto sorted_selection = c->selectionController->GetSortedSelection();
 			auto pos = begin(sorted_selection);
-			paste_lines(c, true, [&](AssDialogue *new_line) -> AssDialogue * {
-				std::unique_ptr<AssDialogue> deleter(new_line);
+			paste_lines_over(c, [&](AssDialogue *new_line) -> AssDialogue * {
 				if (pos == end(sorted_selection)) return nullptr;
 
 				AssDialogue *ret = paste_over(c->parent, pasteOverOptions, new_line, *pos);
@@ -3161,12 +3407,14 @@ struct edit_line_recombine final : public validate_sel_multiple {
 		}
 
 		// Remove now non-existent lines from the selection
-		Selection lines, new_sel;
-		boost::copy(c->ass->Events | agi::address_of, inserter(lines, lines.begin()));
-		boost::set_intersection(lines, sel_set, inserter(new_sel, new_sel.begin()));
+		Selection new_sel;
+		for (auto& line : c->ass->Events) {
+			if (sel_set.count(&line))
+				new_sel.insert(&line);
+		}
 
 		if (new_sel.empty())
-			new_sel.insert(*lines.begin());
+			new_sel.insert(&c->ass->Events.front());
 
 		// Restore selection
 		if (!new_sel.count(active_line))
@@ -3190,7 +3438,7 @@ struct edit_line_split_by_karaoke final : public validate_sel_nonempty {
 		Selection new_sel;
 		AssKaraoke kara;
 
-		std::vector<std::unique_ptr<AssDialogue>> to_delete;
+		DialogueBatch batch(c);
 		for (auto line : sel) {
 			kara.SetLine(line);
 
@@ -3198,29 +3446,24 @@ struct edit_line_split_by_karaoke final : public validate_sel_nonempty {
 			if (kara.size() < 2) continue;
 
 			for (auto const& syl : kara) {
-				auto new_line = new AssDialogue(*line);
+				auto new_line = batch.InsertAfter(line, agi::make_unique<AssDialogue>(*line));
 
 				new_line->Start = syl.start_time;
 				new_line->End = syl.start_time + syl.duration;
 				new_line->Text = syl.GetText(false);
 
-				c->ass->Events.insert(c->ass->iterator_to(*line), *new_line);
-
 				new_sel.insert(new_line);
 			}
 
-			c->ass->Events.erase(c->ass->iterator_to(*line));
-			to_delete.emplace_back(line);
+			batch.Remove(line);
 		}
 
-		if (to_delete.empty()) return;
-
-		c->ass->Commit(_("splitting"), AssFile::COMMIT_DIAG_ADDREM | AssFile::COMMIT_DIAG_FULL);
+		if (batch.empty()) return;
 
 		AssDialogue *new_active = c->selectionController->GetActiveLine();
 		if (!new_sel.count(c->selectionController->GetActiveLine()))
 			new_active = *new_sel.begin();
-		c->selectionController->SetSelectionAndActive(std::move(new_sel), new_active);
+		batch.Commit(_("splitting"), AssFile::COMMIT_DIAG_ADDREM | AssFile::COMMIT_DIAG_FULL, std::move(new_sel), new_active);
 	}
 };
 
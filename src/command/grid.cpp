@@ -35,8 +35,11 @@
 #include "../ass_file.h"
 #include "../audio_controller.h"
 #include "../audio_timing.h"
+#include "../collision_index.h"
 #include "../fold_controller.h"
+#include "../format.h"
 #include "../frame_main.h"
+#include "../grid_filter.h"
 #include "../include/aegisub/context.h"
 #include "../libresrc/libresrc.h"
 #include "../options.h"
@@ -44,6 +47,9 @@
 
 #include <libaegisub/make_unique.h>
 
+#include <algorithm>
+#include <climits>
+
 namespace {
 	using cmd::Command;
 
@@ -86,6 +92,23 @@ struct grid_line_next_create final : public Command {
 	}
 };
 
+struct grid_line_next_collision final : public Command {
+	CMD_NAME("grid/line/next/collision")
+	STR_MENU("Next Collision")
+	STR_DISP("Next Collision")
+	STR_HELP("Move to the next line which collides with another line")
+	CMD_TYPE(COMMAND_VALIDATE)
+
+	bool Validate(const agi::Context *c) override {
+		return c->collisions->Count() > 0;
+	}
+
+	void operator()(agi::Context *c) override {
+		if (auto line = c->collisions->Next(c->selectionController->GetActiveLine()))
+			c->selectionController->SetSelectionAndActive({ line }, line);
+	}
+};
+
 struct grid_line_prev final : public Command {
 	CMD_NAME("grid/line/prev")
 	STR_MENU("Previous Line")
@@ -97,6 +120,23 @@ struct grid_line_prev final : public Command {
 	}
 };
 
+struct grid_line_prev_collision final : public Command {
+	CMD_NAME("grid/line/prev/collision")
+	STR_MENU("Previous Collision")
+	STR_DISP("Previous Collision")
+	STR_HELP("Move to the previous line which collides with another line")
+	CMD_TYPE(COMMAND_VALIDATE)
+
+	bool Validate(const agi::Context *c) override {
+		return c->collisions->Count() > 0;
+	}
+
+	void operator()(agi::Context *c) override {
+		if (auto line = c->collisions->Prev(c->selectionController->GetActiveLine()))
+			c->selectionController->SetSelectionAndActive({ line }, line);
+	}
+};
+
 struct grid_sort_actor final : public Command {
 	CMD_NAME("grid/sort/actor")
 	STR_MENU("&Actor Name")
@@ -564,13 +604,122 @@ struct grid_fold_clear_all final : public Command {
 	}
 };
 
+/// Limit the grid to the lines which also meet a condition
+void add_filter(agi::Context *c, GridFilterCondition const& cond) {
+	c->gridFilter->Add(cond);
+	const size_t total = c->ass->Events.size();
+	c->frame->StatusTimeout(fmt_tl("Showing %d of %d lines", total - c->gridFilter->HiddenCount(), total));
+}
+
+/// Show only the lines whose field exactly matches the active line's
+void add_field_filter(agi::Context *c, SearchReplaceSettings::Field field, std::string const& value) {
+	GridFilterCondition cond;
+	cond.search.find = value;
+	cond.search.field = field;
+	cond.search.limit_to = SearchReplaceSettings::Limit::ALL;
+	cond.search.match_case = true;
+	cond.search.use_regex = false;
+	cond.search.ignore_comments = false;
+	cond.search.skip_tags = false;
+	cond.search.exact_match = true;
+	add_filter(c, cond);
+}
+
+struct validate_active_line : public Command {
+	CMD_TYPE(COMMAND_VALIDATE)
+	bool Validate(const agi::Context *c) override {
+		return c->selectionController->GetActiveLine() != nullptr;
+	}
+};
+
+struct grid_filter_actor final : public validate_active_line {
+	CMD_NAME("grid/filter/actor")
+	STR_MENU("Show Only This &Actor")
+	STR_DISP("Show Only This Actor")
+	STR_HELP("Hide the lines whose actor differs from the active line's")
+
+	void operator()(agi::Context *c) override {
+		add_field_filter(c, SearchReplaceSettings::Field::ACTOR, c->selectionController->GetActiveLine()->Actor);
+	}
+};
+
+struct grid_filter_style final : public validate_active_line {
+	CMD_NAME("grid/filter/style")
+	STR_MENU("Show Only This &Style")
+	STR_DISP("Show Only This Style")
+	STR_HELP("Hide the lines whose style differs from the active line's")
+
+	void operator()(agi::Context *c) override {
+		add_field_filter(c, SearchReplaceSettings::Field::STYLE, c->selectionController->GetActiveLine()->Style);
+	}
+};
+
+struct grid_filter_layer final : public validate_active_line {
+	CMD_NAME("grid/filter/layer")
+	STR_MENU("Show Only This &Layer")
+	STR_DISP("Show Only This Layer")
+	STR_HELP("Hide the lines on other layers than the active line")
+
+	void operator()(agi::Context *c) override {
+		GridFilterCondition cond;
+		cond.type = GridFilterCondition::Type::LAYER;
+		cond.min = cond.max = c->selectionController->GetActiveLine()->Layer;
+		add_filter(c, cond);
+	}
+};
+
+struct grid_filter_time final : public Command {
+	CMD_NAME("grid/filter/time")
+	STR_MENU("Show Only Overlapping &Lines")
+	STR_DISP("Show Only Overlapping Lines")
+	STR_HELP("Hide the lines which aren't displayed at any point during the selected lines")
+	CMD_TYPE(COMMAND_VALIDATE)
+
+	bool Validate(const agi::Context *c) override {
+		return !c->selectionController->GetSelectedSet().empty();
+	}
+
+	void operator()(agi::Context *c) override {
+		auto const& sel = c->selectionController->GetSelectedSet();
+		if (sel.empty()) return;
+
+		GridFilterCondition cond;
+		cond.type = GridFilterCondition::Type::TIME;
+		cond.min = INT_MAX;
+		cond.max = INT_MIN;
+		for (auto line : sel) {
+			cond.min = std::min<int>(cond.min, line->Start);
+			cond.max = std::max<int>(cond.max, line->End);
+		}
+		add_filter(c, cond);
+	}
+};
+
+struct grid_filter_clear final : public Command {
+	CMD_NAME("grid/filter/clear")
+	STR_MENU("Show &All Lines")
+	STR_DISP("Show All Lines")
+	STR_HELP("Show the lines hidden by the grid filter again")
+	CMD_TYPE(COMMAND_VALIDATE)
+
+	bool Validate(const agi::Context *c) override {
+		return c->gridFilter->IsActive();
+	}
+
+	void operator()(agi::Context *c) override {
+		c->gridFilter->Clear();
+	}
+};
+
 }
 
 namespace cmd {
 	void init_grid() {
 		reg(agi::make_unique<grid_line_next>());
+		reg(agi::make_unique<grid_line_next_collision>());
 		reg(agi::make_unique<grid_line_next_create>());
 		reg(agi::make_unique<grid_line_prev>());
+		reg(agi::make_unique<grid_line_prev_collision>());
 		reg(agi::make_unique<grid_sort_actor>());
 		reg(agi::make_unique<grid_sort_effect>());
 		reg(agi::make_unique<grid_sort_end>());
@@ -598,6 +747,11 @@ namespace cmd {
 		reg(agi::make_unique<grid_fold_open_all>());
 		reg(agi::make_unique<grid_fold_close_all>());
 		reg(agi::make_unique<grid_fold_clear_all>());
+		reg(agi::make_unique<grid_filter_actor>());
+		reg(agi::make_unique<grid_filter_style>());
+		reg(agi::make_unique<grid_filter_layer>());
+		reg(agi::make_unique<grid_filter_time>());
+		reg(agi::make_unique<grid_filter_clear>());
 		reg(agi::make_unique<grid_tag_cycle_hiding>());
 		reg(agi::make_unique<grid_tags_hide>());
 		reg(agi::make_unique<grid_tags_show>());
@@ -49,11 +49,9 @@
 #include "../utils.h"
 #include "../video_controller.h"
 
-#include <libaegisub/address_of_adaptor.h>
 #include <libaegisub/charset_conv.h>
 #include <libaegisub/make_unique.h>
 
-#include <boost/range/algorithm/copy.hpp>
 #include <wx/msgdlg.h>
 #include <wx/choicdlg.h>
 #include <wx/filedlg.h>
@@ -495,7 +493,9 @@ struct subtitle_select_all final : public Command {
 
 	void operator()(agi::Context *c) override {
 		Selection sel;
-		boost::copy(c->ass->Events | agi::address_of, inserter(sel, sel.end()));
+		sel.reserve(c->ass->Events.size());
+		for (auto& line : c->ass->Events)
+			sel.insert(&line);
 		c->selectionController->SetSelectedSet(std::move(sel));
 	}
 };
@@ -514,13 +514,17 @@ struct subtitle_select_visible final : public Command {
 		Selection new_selection;
 		int frame = c->videoController->GetFrameN();
 
-		for (auto& diag : c->ass->Events) {
-			if (c->videoController->FrameAtTime(diag.Start, agi::vfr::START) <= frame &&
-				c->videoController->FrameAtTime(diag.End, agi::vfr::END) >= frame)
+		// Anything visible on the frame overlaps the frames on either side of
+		// it, so only those lines need the exact check
+		int start = c->videoController->TimeAtFrame(frame - 1);
+		int end = c->videoController->TimeAtFrame(frame + 2);
+		for (auto diag : c->ass->EventsOverlapping(start, end)) {
+			if (c->videoController->FrameAtTime(diag->Start, agi::vfr::START) <= frame &&
+				c->videoController->FrameAtTime(diag->End, agi::vfr::END) >= frame)
 			{
 				if (new_selection.empty())
-					c->selectionController->SetActiveLine(&diag);
-				new_selection.insert(&diag);
+					c->selectionController->SetActiveLine(diag);
+				new_selection.insert(diag);
 			}
 		}
 
@@ -39,10 +39,13 @@
 #include "../dialogs.h"
 #include "../include/aegisub/context.h"
 #include "../libresrc/libresrc.h"
+#include "../options.h"
 #include "../project.h"
 #include "../selection_controller.h"
 #include "../video_controller.h"
 
+#include <libaegisub/audio/provider.h>
+#include <libaegisub/audio/speech_detector.h>
 #include <libaegisub/make_unique.h>
 
 #include <algorithm>
@@ -235,6 +238,47 @@ struct time_snap_scene final : public validate_video_loaded {
 	}
 };
 
+struct time_speech final : public Command {
+	CMD_NAME("time/speech")
+	STR_MENU("Snap to S&peech")
+	STR_DISP("Snap to Speech")
+	STR_HELP("Set start and end of the selected subtitles to the speech detected in the audio around them")
+	CMD_TYPE(COMMAND_VALIDATE)
+
+	bool Validate(const agi::Context *c) override {
+		auto provider = c->project->AudioProvider();
+		return provider && provider->GetSpeech() && !c->selectionController->GetSelectedSet().empty();
+	}
+
+	void operator()(agi::Context *c) override {
+		const int search_range = OPT_GET("Audio/Speech Detection/Search Range")->GetInt();
+
+		bool changed = false;
+		std::vector<agi::SpeechSegment> segments;
+		for (auto line : c->selectionController->GetSelectedSet()) {
+			segments.clear();
+			c->audioController->GetSpeechSegments(TimeRange(line->Start, line->End), segments);
+			if (segments.empty()) continue;
+
+			// Each end is left alone if the speech there runs on too far
+			// beyond the line to plausibly be part of it
+			const int start = segments.front().start;
+			const int end = segments.back().end;
+			if (std::abs(start - line->Start) <= search_range && start != line->Start) {
+				line->Start = start;
+				changed = true;
+			}
+			if (std::abs(end - line->End) <= search_range && end != line->End) {
+				line->End = end;
+				changed = true;
+			}
+		}
+
+		if (changed)
+			c->ass->Commit(_("snap to speech"), AssFile::COMMIT_DIAG_TIME);
+	}
+};
+
 struct time_align_subtitle_to_point final : public validate_video_loaded {
 	CMD_NAME("time/align")
 	CMD_ICON(button_align)
@@ -405,6 +449,7 @@ namespace cmd {
 		reg(agi::make_unique<time_snap_end_video>());
 		reg(agi::make_unique<time_snap_scene>());
 		reg(agi::make_unique<time_snap_start_video>());
+		reg(agi::make_unique<time_speech>());
 		reg(agi::make_unique<time_align_subtitle_to_point>());
 		reg(agi::make_unique<time_start_decrease>());
 		reg(agi::make_unique<time_start_increase>());
@@ -32,10 +32,12 @@
 #include "command.h"
 
 #include "../ass_dialogue.h"
+#include "../ass_file.h"
 #include "../async_video_provider.h"
 #include "../compat.h"
 #include "../dialog_detached_video.h"
 #include "../dialog_manager.h"
+#include "../dialog_progress.h"
 #include "../dialogs.h"
 #include "../format.h"
 #include "../frame_main.h"
@@ -44,22 +46,28 @@
 #include "../libresrc/libresrc.h"
 #include "../options.h"
 #include "../project.h"
+#include "../render_profile.h"
 #include "../selection_controller.h"
 #include "../utils.h"
+#include "../video_benchmark.h"
 #include "../video_controller.h"
 #include "../video_display.h"
 #include "../video_frame.h"
 
 #include <libaegisub/ass/time.h>
+#include <libaegisub/dispatch.h>
 #include <libaegisub/fs.h>
 #include <libaegisub/path.h>
 #include <libaegisub/make_unique.h>
 #include <libaegisub/util.h>
 
+#include <algorithm>
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/split.hpp>
 #include <cmath>
+#include <set>
+#include <thread>
 #include <vector>
 #include <wx/msgdlg.h>
 #include <wx/textdlg.h>
@@ -316,6 +324,29 @@ struct video_detach final : public validator_video_loaded {
 	}
 };
 
+struct video_benchmark final : public validator_video_loaded {
+	CMD_NAME("video/benchmark")
+	STR_MENU("&Benchmark Video Providers...")
+	STR_DISP("Benchmark Video Providers")
+	STR_HELP("Time how quickly each video provider can seek and decode the open video, and save the results as JSON")
+
+	void operator()(agi::Context *c) override {
+		c->videoController->Stop();
+		auto filename = SaveFileSelector(_("Save benchmark results"), "", "", "json", "JSON files (*.json)|*.json", c->parent);
+		if (filename.empty()) return;
+
+		try {
+			DialogProgress progress(c->parent);
+			agi::io::Save file(filename);
+			BenchmarkVideoProviders(c->project->VideoName(), VideoProviderFactory::GetClasses(), file.Get(), &progress);
+		}
+		catch (agi::UserCancelException const&) { }
+		catch (agi::Exception const& e) {
+			wxMessageBox(to_wx(e.GetMessage()), _("Benchmark failed"), wxOK | wxICON_ERROR | wxCENTER);
+		}
+	}
+};
+
 struct video_details final : public validator_video_loaded {
 	CMD_NAME("video/details")
 	CMD_ICON(show_video_details_menu)
@@ -329,6 +360,19 @@ struct video_details final : public validator_video_loaded {
 	}
 };
 
+struct video_profile_frame final : public validator_video_loaded {
+	CMD_NAME("video/profile_frame")
+	STR_MENU("&Profile Frame Rendering...")
+	STR_DISP("Profile Frame Rendering")
+	STR_HELP("Measure how long each line on the current frame takes to render")
+
+	void operator()(agi::Context *c) override {
+		c->videoController->Stop();
+		ShowRenderProfileDialog(c);
+		c->renderProfile->Run();
+	}
+};
+
 struct video_focus_seek final : public validator_video_loaded {
 	CMD_NAME("video/focus_seek")
 	STR_MENU("Toggle video slider focus")
@@ -347,13 +391,16 @@ struct video_focus_seek final : public validator_video_loaded {
 	}
 };
 
-wxImage get_image(agi::Context *c, bool raw, bool subsonly = false) {
+std::shared_ptr<const VideoFrame> get_frame(agi::Context *c, bool raw, bool subsonly = false) {
 	auto frame = c->videoController->GetFrameN();
-    if (subsonly) {
-        return GetImageWithAlpha(c->project->VideoProvider()->GetSubtitles(c->project->Timecodes().TimeAtFrame(frame)));
-    } else {
-        return GetImage(*c->project->VideoProvider()->GetFrame(frame, c->project->Timecodes().TimeAtFrame(frame), raw));
-    }
+	if (subsonly)
+		return std::make_shared<VideoFrame>(c->project->VideoProvider()->GetSubtitles(c->project->Timecodes().TimeAtFrame(frame)));
+	return c->project->VideoProvider()->GetFrame(frame, c->project->Timecodes().TimeAtFrame(frame), raw);
+}
+
+wxImage get_image(agi::Context *c, bool raw, bool subsonly = false) {
+	auto frame = get_frame(c, raw, subsonly);
+	return subsonly ? GetImageWithAlpha(*frame) : GetImage(*frame);
 }
 
 struct video_frame_copy final : public validator_video_loaded {
@@ -531,7 +578,9 @@ struct video_frame_prev_large final : public validator_video_loaded {
 	}
 };
 
-static void save_snapshot(agi::Context *c, bool raw, bool subsonly = false) {
+/// Get the path snapshots of the open video are saved to, without the
+/// number and extension
+static agi::fs::path snapshot_base(agi::Context *c) {
 	auto option = OPT_GET("Path/Screenshot")->GetString();
 	agi::fs::path basepath;
 
@@ -558,15 +607,39 @@ static void save_snapshot(agi::Context *c, bool raw, bool subsonly = false) {
 		basepath = c->path->MakeAbsolute(option, "?user/");
 
 	basepath /= is_dummy ? "dummy" : videoname.stem();
+	return basepath;
+}
 
-	// Get full path
+/// Snapshots which haven't finished being written yet, so that another one
+/// taken in the meantime doesn't pick the same name
+static std::set<std::string> pending_snapshots;
+
+/// Pick an unused filename for a snapshot of a frame and reserve it until
+/// release_snapshot_path() is called
+static std::string reserve_snapshot_path(agi::fs::path const& basepath, int frame) {
 	int session_shot_count = 1;
 	std::string path;
 	do {
-		path = agi::format("%s_%03d_%d.png", basepath.string(), session_shot_count++, c->videoController->GetFrameN());
-	} while (agi::fs::FileExists(path));
+		path = agi::format("%s_%03d_%d.png", basepath.string(), session_shot_count++, frame);
+	} while (pending_snapshots.count(path) || agi::fs::FileExists(path));
+	pending_snapshots.insert(path);
+	return path;
+}
 
-	get_image(c, raw, subsonly).SaveFile(to_wx(path), wxBITMAP_TYPE_PNG);
+static void release_snapshot_path(std::string const& path) {
+	pending_snapshots.erase(path);
+}
+
+static void save_snapshot(agi::Context *c, bool raw, bool subsonly = false) {
+	auto path = reserve_snapshot_path(snapshot_base(c), c->videoController->GetFrameN());
+	auto frame = get_frame(c, raw, subsonly);
+
+	// Encoding the PNG takes far longer than getting the frame, so do it in
+	// the background rather than blocking the UI until it's written
+	agi::dispatch::Background().Async([=] {
+		(subsonly ? GetImageWithAlpha(*frame) : GetImage(*frame)).SaveFile(to_wx(path), wxBITMAP_TYPE_PNG);
+		agi::dispatch::Main().Async([=] { release_snapshot_path(path); });
+	});
 }
 
 struct video_frame_save final : public validator_video_loaded {
@@ -602,6 +675,52 @@ struct video_frame_save_subs final : public validator_video_loaded {
 	}
 };
 
+struct video_frame_save_lines final : public validator_video_loaded {
+	CMD_NAME("video/frame/save/lines")
+	STR_MENU("Save PNG snapshots of selected lines")
+	STR_DISP("Save PNG snapshots of selected lines")
+	STR_HELP("Save the first frame of each selected line to a PNG file in the video's directory")
+
+	void operator()(agi::Context *c) override {
+		c->videoController->Stop();
+
+		std::vector<int> frames;
+		for (auto line : c->selectionController->GetSelectedSet())
+			frames.push_back(c->videoController->FrameAtTime(line->Start, agi::vfr::START));
+		std::sort(begin(frames), end(frames));
+		frames.erase(std::unique(begin(frames), end(frames)), end(frames));
+		if (frames.empty()) return;
+
+		auto basepath = snapshot_base(c);
+		std::vector<std::string> paths;
+		for (int frame : frames)
+			paths.push_back(reserve_snapshot_path(basepath, frame));
+
+		auto provider = c->project->VideoProvider();
+		auto const& timecodes = c->project->Timecodes();
+		DialogProgress progress(c->parent, _("Save snapshots"), _("Saving the first frame of each selected line"));
+		progress.Run([&](agi::ProgressSink *ps) {
+			// Frames are decoded in order a batch at a time, and each batch is
+			// encoded in parallel while keeping only that many frames around
+			const size_t batch = std::max(1u, std::thread::hardware_concurrency());
+			std::vector<std::shared_ptr<const VideoFrame>> decoded;
+			for (size_t first = 0; first < frames.size() && !ps->IsCancelled(); first += batch) {
+				ps->SetProgress(first, frames.size());
+				const size_t count = std::min(batch, frames.size() - first);
+				decoded.clear();
+				for (size_t i = first; i < first + count; ++i)
+					decoded.push_back(provider->GetFrame(frames[i], timecodes.TimeAtFrame(frames[i])));
+				agi::dispatch::Parallel(count, [&](size_t i) {
+					GetImage(*decoded[i]).SaveFile(to_wx(paths[first + i]), wxBITMAP_TYPE_PNG);
+				});
+			}
+		});
+
+		for (auto const& path : paths)
+			release_snapshot_path(path);
+	}
+};
+
 struct video_jump final : public validator_video_loaded {
 	CMD_NAME("video/jump")
 	CMD_ICON(jumpto_button)
@@ -679,7 +798,7 @@ struct video_reload final : public Command {
 	STR_HELP("Reload the current video file")
 
 	void operator()(agi::Context *c) override {
-		c->project->ReloadVideo();
+		c->project->ReloadVideoIfChanged();
 	}
 };
 
@@ -700,6 +819,23 @@ struct video_opt_autoscroll final : public Command {
 	}
 };
 
+struct video_opt_hardware_decoding final : public Command {
+	CMD_NAME("video/opt/hardware_decoding")
+	STR_MENU("Use &Hardware Decoding")
+	STR_DISP("Use Hardware Decoding")
+	STR_HELP("Toggle decoding this project's video on the GPU, if hardware decoding is enabled in the preferences")
+	CMD_TYPE(COMMAND_TOGGLE)
+
+	bool IsActive(const agi::Context *c) override {
+		return !c->ass->Properties.disable_hw_decoding;
+	}
+
+	void operator()(agi::Context *c) override {
+		c->ass->Properties.disable_hw_decoding = !c->ass->Properties.disable_hw_decoding;
+		c->project->ReloadVideo();
+	}
+};
+
 struct video_pan_reset final : public validator_video_loaded {
 	CMD_NAME("video/pan_reset")
 	STR_MENU("Reset Video Pan")
@@ -914,6 +1050,7 @@ namespace cmd {
 		reg(agi::make_unique<video_aspect_default>());
 		reg(agi::make_unique<video_aspect_full>());
 		reg(agi::make_unique<video_aspect_wide>());
+		reg(agi::make_unique<video_benchmark>());
 		reg(agi::make_unique<video_close>());
 		reg(agi::make_unique<video_copy_coordinates>());
 		reg(agi::make_unique<video_cycle_subtitles_provider>());
@@ -935,6 +1072,7 @@ namespace cmd {
 		reg(agi::make_unique<video_frame_save>());
 		reg(agi::make_unique<video_frame_save_raw>());
 		reg(agi::make_unique<video_frame_save_subs>());
+		reg(agi::make_unique<video_frame_save_lines>());
 		reg(agi::make_unique<video_jump>());
 		reg(agi::make_unique<video_jump_end>());
 		reg(agi::make_unique<video_jump_start>());
@@ -942,9 +1080,11 @@ namespace cmd {
 		reg(agi::make_unique<video_open_dummy>());
 		reg(agi::make_unique<video_reload>());
 		reg(agi::make_unique<video_opt_autoscroll>());
+		reg(agi::make_unique<video_opt_hardware_decoding>());
 		reg(agi::make_unique<video_pan_reset>());
 		reg(agi::make_unique<video_play>());
 		reg(agi::make_unique<video_play_line>());
+		reg(agi::make_unique<video_profile_frame>());
 		reg(agi::make_unique<video_playback_speed_increase>());
 		reg(agi::make_unique<video_playback_speed_decrease>());
 		reg(agi::make_unique<video_playback_speed_reset>());
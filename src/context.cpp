@@ -16,16 +16,23 @@
 
 #include "include/aegisub/context.h"
 
+#include "ass_dialogue.h"
 #include "ass_file.h"
+#include "actor_index.h"
 #include "audio_controller.h"
 #include "auto4_base.h"
+#include "collision_index.h"
 #include "dialog_manager.h"
+#include "field_index.h"
 #include "fold_controller.h"
+#include "grid_filter.h"
 #include "initial_line_state.h"
 #include "options.h"
 #include "project.h"
+#include "render_profile.h"
 #include "search_replace_engine.h"
 #include "selection_controller.h"
+#include "spelling_index.h"
 #include "subs_controller.h"
 #include "text_selection_controller.h"
 #include "video_controller.h"
@@ -42,10 +49,16 @@ Context::Context()
 , local_scripts(make_unique<Automation4::LocalScriptManager>(this))
 , selectionController(make_unique<SelectionController>(this))
 , foldController(make_unique<FoldController>(this))
+, gridFilter(make_unique<GridFilter>(this))
 , videoController(make_unique<VideoController>(this))
 , audioController(make_unique<AudioController>(this))
 , initialLineState(make_unique<InitialLineState>(this))
 , search(make_unique<SearchReplaceEngine>(this))
+, spelling(make_unique<SpellingIndex>(this))
+, actors(make_unique<ActorIndex>(this))
+, collisions(make_unique<CollisionIndex>(this))
+, effects(agi::make_unique<FieldIndex>(this, &AssDialogue::Effect))
+, renderProfile(make_unique<RenderProfile>(this))
 , path(make_unique<Path>(*config::path))
 , dialog(make_unique<DialogManager>())
 {
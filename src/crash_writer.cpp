@@ -25,6 +25,20 @@
 #include <wx/string.h>
 #include <wx/stackwalk.h>
 
+#if __has_include(<execinfo.h>)
+#define HAVE_BACKTRACE
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <execinfo.h>
+#include <mutex>
+#include <pthread.h>
+#include <signal.h>
+#include <thread>
+#endif
+
 using namespace agi;
 
 namespace {
@@ -63,11 +77,75 @@ public:
 	}
 };
 #endif
+
+#ifdef HAVE_BACKTRACE
+/// Signal sent to the main thread to make it record its own stack. SIGPROF
+/// is left alone as profilers use it.
+const int sample_signal = SIGUSR2;
+const int max_sample_depth = 128;
+
+pthread_t main_thread;
+bool sampling_installed = false;
+/// Only one sample is taken at a time, as the handler has a single buffer
+std::mutex sample_mutex;
+void *sample_frames[max_sample_depth];
+std::atomic<int> sample_depth{-1};
+
+void OnSampleSignal(int) {
+	const int saved_errno = errno;
+	sample_depth.store(backtrace(sample_frames, max_sample_depth), std::memory_order_release);
+	errno = saved_errno;
+}
+
+/// Turn a line from backtrace_symbols(), which is "module(symbol+offset)
+/// [address]" with glibc, into "function (module)". The offset is dropped
+/// so that samples taken at different points in the same function match.
+std::string Describe(const char *symbol) {
+	std::string line(symbol);
+	const auto open = line.find('(');
+	const auto plus = line.find('+', open);
+	const auto close = line.find(')', open);
+	if (open == std::string::npos || close == std::string::npos)
+		return line;
+
+	auto module = line.substr(0, open);
+	module.erase(0, module.find_last_of('/') + 1);
+	if (plus > close)
+		return module;
+	if (plus == open + 1)
+		return module + line.substr(plus, close - plus);
+
+	auto name = line.substr(open + 1, plus - open - 1);
+	int status = 0;
+	char *demangled = abi::__cxa_demangle(name.c_str(), nullptr, nullptr, &status);
+	if (demangled && status == 0)
+		name = demangled;
+	free(demangled);
+	return name + " (" + module + ")";
+}
+#endif
 }
 
 namespace crash_writer {
 void Initialize(fs::path const& path) {
 	crashlog_path = path / "crashlog.txt";
+
+#ifdef HAVE_BACKTRACE
+	if (!sampling_installed) {
+		main_thread = pthread_self();
+
+		// The first call to backtrace() loads libgcc, which can't safely
+		// be done from within a signal handler
+		void *warm_up[1];
+		backtrace(warm_up, 1);
+
+		struct sigaction action{};
+		action.sa_handler = OnSampleSignal;
+		action.sa_flags = SA_RESTART;
+		sigemptyset(&action.sa_mask);
+		sampling_installed = sigaction(sample_signal, &action, nullptr) == 0;
+	}
+#endif
 }
 
 void Cleanup() { }
@@ -89,4 +167,40 @@ void Write(std::string const& error) {
 		file.close();
 	}
 }
+
+std::vector<void *> SampleMainThread() {
+#ifdef HAVE_BACKTRACE
+	if (!sampling_installed) return {};
+
+	std::lock_guard<std::mutex> lock(sample_mutex);
+	sample_depth.store(-1, std::memory_order_relaxed);
+	if (pthread_kill(main_thread, sample_signal) != 0) return {};
+
+	// The handler normally runs within microseconds; give up rather than
+	// wait forever on a thread which has the signal blocked
+	int depth = -1;
+	for (int i = 0; i < 100 && (depth = sample_depth.load(std::memory_order_acquire)) < 0; ++i)
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+	if (depth <= 0) return {};
+
+	// Skip the handler and the signal trampoline which called it
+	const int skip = std::min(depth, 2);
+	return std::vector<void *>(sample_frames + skip, sample_frames + depth);
+#else
+	return {};
+#endif
+}
+
+std::vector<std::string> Symbolize(std::vector<void *> const& stack) {
+	std::vector<std::string> names;
+#ifdef HAVE_BACKTRACE
+	if (stack.empty()) return names;
+	char **symbols = backtrace_symbols(stack.data(), static_cast<int>(stack.size()));
+	if (!symbols) return names;
+	for (size_t i = 0; i < stack.size(); ++i)
+		names.push_back(Describe(symbols[i]));
+	free(symbols);
+#endif
+	return names;
+}
 }
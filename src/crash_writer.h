@@ -17,6 +17,7 @@
 #include <libaegisub/fs_fwd.h>
 
 #include <string>
+#include <vector>
 
 namespace crash_writer {
 	void Initialize(agi::fs::path const& path);
@@ -24,4 +25,15 @@ namespace crash_writer {
 
 	void Write();
 	void Write(std::string const& error);
+
+	/// Capture the call stack of the thread which called Initialize(),
+	/// while it keeps running, from any other thread
+	/// @return Return addresses, innermost first; empty if the stack could
+	///         not be sampled on this platform
+	std::vector<void *> SampleMainThread();
+
+	/// Get the name of the function at each of the addresses in a sampled
+	/// stack, without the offset into it so that samples from different
+	/// points in the same function match
+	std::vector<std::string> Symbolize(std::vector<void *> const& stack);
 }
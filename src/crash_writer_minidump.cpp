@@ -99,6 +99,43 @@ struct dump_thread_state {
 };
 
 std::unique_ptr<dump_thread_state> dump_thread;
+
+HANDLE main_thread = nullptr;
+const size_t max_sample_depth = 128;
+
+/// The parts of dbghelp needed to walk another thread's stack, which is
+/// loaded when first needed in the same way as MiniDumpWriteDump
+struct stack_walker {
+	using SymInitializeFn = BOOL(WINAPI *)(HANDLE, PCSTR, BOOL);
+	using StackWalk64Fn = BOOL(WINAPI *)(DWORD, HANDLE, HANDLE, LPSTACKFRAME64, PVOID,
+		PREAD_PROCESS_MEMORY_ROUTINE64, PFUNCTION_TABLE_ACCESS_ROUTINE64,
+		PGET_MODULE_BASE_ROUTINE64, PTRANSLATE_ADDRESS_ROUTINE64);
+	using SymFromAddrFn = BOOL(WINAPI *)(HANDLE, DWORD64, PDWORD64, PSYMBOL_INFO);
+
+	StackWalk64Fn walk = nullptr;
+	PFUNCTION_TABLE_ACCESS_ROUTINE64 function_table = nullptr;
+	PGET_MODULE_BASE_ROUTINE64 module_base = nullptr;
+	SymFromAddrFn from_addr = nullptr;
+	/// dbghelp isn't thread-safe
+	std::mutex mutex;
+
+	stack_walker() {
+		auto module = LoadLibrary(L"dbghelp.dll");
+		if (!module) return;
+
+		auto init = reinterpret_cast<SymInitializeFn>(GetProcAddress(module, "SymInitialize"));
+		function_table = reinterpret_cast<PFUNCTION_TABLE_ACCESS_ROUTINE64>(GetProcAddress(module, "SymFunctionTableAccess64"));
+		module_base = reinterpret_cast<PGET_MODULE_BASE_ROUTINE64>(GetProcAddress(module, "SymGetModuleBase64"));
+		from_addr = reinterpret_cast<SymFromAddrFn>(GetProcAddress(module, "SymFromAddr"));
+		if (init && function_table && module_base && init(GetCurrentProcess(), nullptr, TRUE))
+			walk = reinterpret_cast<StackWalk64Fn>(GetProcAddress(module, "StackWalk64"));
+	}
+};
+
+stack_walker& get_stack_walker() {
+	static stack_walker walker;
+	return walker;
+}
 }
 
 namespace crash_writer {
@@ -122,6 +159,10 @@ void Initialize(agi::fs::path const& path) {
 
 	if (!dump_thread)
 		dump_thread = agi::make_unique<dump_thread_state>();
+
+	if (!main_thread)
+		DuplicateHandle(GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(),
+			&main_thread, 0, FALSE, DUPLICATE_SAME_ACCESS);
 }
 
 void Cleanup() {
@@ -148,4 +189,74 @@ void Write(std::string const& error) {
 		file << "----------------------------------------\n\n";
 	}
 }
+
+std::vector<void *> SampleMainThread() {
+	std::vector<void *> stack;
+	if (!main_thread) return stack;
+
+	auto& walker = get_stack_walker();
+	if (!walker.walk) return stack;
+	std::lock_guard<std::mutex> lock(walker.mutex);
+
+	// Nothing may be allocated while the thread is suspended, as it could
+	// be holding the heap lock
+	stack.reserve(max_sample_depth);
+	if (SuspendThread(main_thread) == static_cast<DWORD>(-1)) return stack;
+
+	CONTEXT context{};
+	context.ContextFlags = CONTEXT_FULL;
+	if (GetThreadContext(main_thread, &context)) {
+		STACKFRAME64 frame{};
+#if defined(_M_X64)
+		const DWORD machine = IMAGE_FILE_MACHINE_AMD64;
+		frame.AddrPC.Offset = context.Rip;
+		frame.AddrFrame.Offset = context.Rbp;
+		frame.AddrStack.Offset = context.Rsp;
+#elif defined(_M_ARM64)
+		const DWORD machine = IMAGE_FILE_MACHINE_ARM64;
+		frame.AddrPC.Offset = context.Pc;
+		frame.AddrFrame.Offset = context.Fp;
+		frame.AddrStack.Offset = context.Sp;
+#else
+		const DWORD machine = IMAGE_FILE_MACHINE_I386;
+		frame.AddrPC.Offset = context.Eip;
+		frame.AddrFrame.Offset = context.Ebp;
+		frame.AddrStack.Offset = context.Esp;
+#endif
+		frame.AddrPC.Mode = AddrModeFlat;
+		frame.AddrFrame.Mode = AddrModeFlat;
+		frame.AddrStack.Mode = AddrModeFlat;
+
+		while (stack.size() < max_sample_depth
+			&& walker.walk(machine, GetCurrentProcess(), main_thread, &frame, &context,
+				nullptr, walker.function_table, walker.module_base, nullptr)
+			&& frame.AddrPC.Offset)
+			stack.push_back(reinterpret_cast<void *>(frame.AddrPC.Offset));
+	}
+
+	ResumeThread(main_thread);
+	return stack;
+}
+
+std::vector<std::string> Symbolize(std::vector<void *> const& stack) {
+	std::vector<std::string> names;
+	auto& walker = get_stack_walker();
+	std::lock_guard<std::mutex> lock(walker.mutex);
+
+	char buffer[sizeof(SYMBOL_INFO) + MAX_SYM_NAME];
+	auto info = reinterpret_cast<SYMBOL_INFO *>(buffer);
+	for (auto address : stack) {
+		const auto addr = reinterpret_cast<DWORD64>(address);
+		memset(buffer, 0, sizeof(buffer));
+		info->SizeOfStruct = sizeof(SYMBOL_INFO);
+		info->MaxNameLen = MAX_SYM_NAME;
+
+		DWORD64 displacement = 0;
+		std::string name = walker.from_addr && walker.from_addr(GetCurrentProcess(), addr, &displacement, info)
+			? std::string(info->Name)
+			: agi::format("%p", address);
+		names.push_back(std::move(name));
+	}
+	return names;
+}
 }
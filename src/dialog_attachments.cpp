@@ -30,6 +30,8 @@
 #include "ass_attachment.h"
 #include "ass_file.h"
 #include "compat.h"
+#include "dialog_progress.h"
+#include "format.h"
 #include "help_button.h"
 #include "libresrc/libresrc.h"
 #include "options.h"
@@ -40,6 +42,7 @@
 #include <wx/filedlg.h>
 #include <wx/dirdlg.h>
 #include <wx/listctrl.h>
+#include <wx/msgdlg.h>
 #include <wx/sizer.h>
 
 namespace {
@@ -125,12 +128,44 @@ void DialogAttachments::AttachFile(wxFileDialog &diag, wxString const& commit_ms
 	wxArrayString paths;
 	diag.GetPaths(paths);
 
+	std::vector<agi::fs::path> filenames;
 	for (auto const& fn : paths)
-		ass->InsertAttachment(agi::fs::path(fn.wx_str()));
+		filenames.emplace_back(fn.wx_str());
 
-	ass->Commit(commit_msg, AssFile::COMMIT_ATTACHMENT);
+	// Fonts can be large and slow to encode, so read several at once, off
+	// the main thread
+	std::vector<AttachmentFile> files;
+	if (filenames.size() == 1)
+		files = ReadAttachmentFiles(filenames, nullptr);
+	else {
+		try {
+			DialogProgress progress(&d, _("Attach files"), _("Reading the files to attach..."));
+			progress.Run([&](agi::ProgressSink *ps) {
+				files = ReadAttachmentFiles(filenames, ps);
+			});
+		}
+		catch (agi::UserCancelException const&) {
+			return;
+		}
+	}
+
+	if (ass->InsertAttachments(files))
+		ass->Commit(commit_msg, AssFile::COMMIT_ATTACHMENT);
 
 	UpdateList();
+
+	wxString problems;
+	size_t duplicates = 0;
+	for (auto const& file : files) {
+		if (file.duplicate)
+			++duplicates;
+		else if (!file.attachment)
+			problems += fmt_tl("Could not read %s: %s\n", file.path.filename().string(), file.error);
+	}
+	if (duplicates)
+		problems += fmt_plural(duplicates, "%d file was skipped as it is identical to a file which is already attached.", "%d files were skipped as they are identical to files which are already attached.", duplicates);
+	if (!problems.empty())
+		wxMessageBox(problems, _("Attach files"), wxOK | wxICON_INFORMATION | wxCENTER, &d);
 }
 
 void DialogAttachments::OnAttachFont(wxCommandEvent &) {
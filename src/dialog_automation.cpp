@@ -134,6 +134,7 @@ DialogAutomation::DialogAutomation(agi::Context *c)
 	list->InsertColumn(1, _("Name"), wxLIST_FORMAT_LEFT, 140);
 	list->InsertColumn(2, _("Filename"), wxLIST_FORMAT_LEFT, 90);
 	list->InsertColumn(3, _("Description"), wxLIST_FORMAT_LEFT, 330);
+	list->InsertColumn(4, _("Load time"), wxLIST_FORMAT_RIGHT, 70);
 
 	// button layout
 	wxSizer *button_box = new wxBoxSizer(wxHORIZONTAL);
@@ -182,6 +183,7 @@ void DialogAutomation::SetScriptInfo(int i, Automation4::Script *script)
 	list->SetItem(i, 1, to_wx(script->GetName()));
 	list->SetItem(i, 2, script->GetPrettyFilename().wstring());
 	list->SetItem(i, 3, to_wx(script->GetDescription()));
+	list->SetItem(i, 4, fmt_tl("%d ms", script->GetLoadTime()));
 	if (!script->GetLoadedState())
 		list->SetItemBackgroundColour(i, wxColour(255,128,128));
 	else
@@ -286,13 +288,14 @@ void DialogAutomation::OnInfo(wxCommandEvent &)
 		});
 
 	if (ei) {
-		info.push_back(fmt_tl("\nScript info:\nName: %s\nDescription: %s\nAuthor: %s\nVersion: %s\nFull path: %s\nState: %s\n\nFeatures provided by script:",
+		info.push_back(fmt_tl("\nScript info:\nName: %s\nDescription: %s\nAuthor: %s\nVersion: %s\nFull path: %s\nState: %s\nLoad time: %d ms\n\nFeatures provided by script:",
 			ei->script->GetName(),
 			ei->script->GetDescription(),
 			ei->script->GetAuthor(),
 			ei->script->GetVersion(),
 			ei->script->GetFilename().wstring(),
-			ei->script->GetLoadedState() ? _("Correctly loaded") : _("Failed to load")));
+			ei->script->GetLoadedState() ? _("Correctly loaded") : _("Failed to load"),
+			ei->script->GetLoadTime()));
 
 		boost::transform(ei->script->GetMacros(), append_info, [=](const cmd::Command *f) {
 			return fmt_tl("    Macro: %s (%s)", f->StrDisplay(context), f->name());
@@ -300,6 +303,12 @@ void DialogAutomation::OnInfo(wxCommandEvent &)
 		boost::transform(ei->script->GetFilters(), append_info, [](const Automation4::ExportFilter* f) {
 			return fmt_tl("    Export filter: %s", f->GetName());
 		});
+
+		auto profile = ei->script->GetProfileReport();
+		if (!profile.empty()) {
+			info.push_back(_("\nProfile:"));
+			info.push_back(to_wx(profile));
+		}
 	}
 
 	wxMessageBox(wxJoin(info, '\n', 0), _("Automation Script Info"));
@@ -27,17 +27,24 @@
 #include "value_event.h"
 
 #include <libaegisub/dispatch.h>
+#include <libaegisub/file_mapping.h>
 #include <libaegisub/format_path.h>
 #include <libaegisub/fs.h>
 #include <libaegisub/path.h>
 #include <libaegisub/make_unique.h>
 
+#include <atomic>
+#include <map>
+#include <set>
+#include <string_view>
+
 #include <wx/button.h>
 #include <wx/dialog.h>
 #include <wx/dirdlg.h>
 #include <wx/filedlg.h>
 #include <wx/filename.h>
 #include <wx/msgdlg.h>
+#include <wx/mstream.h>
 #include <wx/radiobox.h>
 #include <wx/sizer.h>
 #include <wx/statbox.h>
@@ -88,8 +95,65 @@ using color_str_pair = std::pair<int, wxString>;
 wxDEFINE_EVENT(EVT_ADD_TEXT, ValueEvent<color_str_pair>);
 wxDEFINE_EVENT(EVT_COLLECTION_DONE, wxThreadEvent);
 
+/// Number of fonts compressed at once when writing to a zip archive
+const size_t zip_batch_size = 16;
+
+uintmax_t file_size(agi::fs::path const& path) {
+	try {
+		return agi::fs::Size(path);
+	}
+	catch (agi::fs::FileSystemError const&) {
+		return 0;
+	}
+}
+
+/// Find fonts which are byte-for-byte copies of a font earlier in the list,
+/// such as the same font installed in both the system and user font folders
+///
+/// Only fonts which are the same size as another font are read.
+/// @return For each font, the index of the font it duplicates or -1
+std::vector<int> find_duplicates(std::vector<agi::fs::path> const& paths, std::vector<uintmax_t> const& sizes) {
+	std::vector<int> duplicates(paths.size(), -1);
+
+	std::map<uintmax_t, size_t> size_count;
+	for (auto size : sizes) {
+		if (size)
+			++size_count[size];
+	}
+
+	std::vector<size_t> to_hash;
+	for (size_t i = 0; i < paths.size(); ++i) {
+		if (sizes[i] && size_count[sizes[i]] > 1)
+			to_hash.push_back(i);
+	}
+	if (to_hash.empty()) return duplicates;
+
+	std::vector<size_t> hashes(paths.size(), 0);
+	std::vector<char> hashed(paths.size(), 0);
+	agi::dispatch::Parallel(to_hash.size(), [&](size_t j) {
+		size_t i = to_hash[j];
+		try {
+			agi::read_file_mapping file(paths[i]);
+			hashes[i] = std::hash<std::string_view>()(std::string_view(file.read(), file.size()));
+			hashed[i] = 1;
+		}
+		catch (...) {
+			// Unreadable fonts are reported when copying them fails
+		}
+	});
+
+	std::map<std::pair<uintmax_t, size_t>, int> first_seen;
+	for (size_t i : to_hash) {
+		if (!hashed[i]) continue;
+		auto it = first_seen.emplace(std::make_pair(sizes[i], hashes[i]), static_cast<int>(i)).first;
+		if (it->second != static_cast<int>(i))
+			duplicates[i] = it->second;
+	}
+	return duplicates;
+}
+
 void FontsCollectorThread(AssFile *subs, agi::fs::path const& destination, FcMode oper, wxEvtHandler *collector) {
-	agi::dispatch::Background().Async([=]{
+	agi::dispatch::Background(agi::dispatch::Priority::Bulk).Async([=]{
 		auto AppendText = [&](wxString text, int colour) {
 			collector->AddPendingEvent(ValueEvent<color_str_pair>(EVT_ADD_TEXT, -1, {colour, text.Clone()}));
 		};
@@ -149,31 +213,74 @@ void FontsCollectorThread(AssFile *subs, agi::fs::path const& destination, FcMod
 			}
 		}
 
-		int64_t total_size = 0;
-		bool allOk = true;
-		for (auto path : paths) {
+		std::vector<uintmax_t> sizes;
+		for (auto& path : paths) {
 			path.make_preferred();
+			sizes.push_back(file_size(path));
+		}
+
+		auto duplicates = find_duplicates(paths, sizes);
+
+		int64_t total_size = 0;
+		std::atomic<bool> allOk{true};
+		auto report = [&](size_t i, int ret) {
+			auto const& path = paths[i];
+			if (ret == 1)
+				AppendText(fmt_tl("* Copied %s.\n", path), 1);
+			else if (ret == 2)
+				AppendText(fmt_tl("* %s already exists on destination.\n", path.filename()), 3);
+			else if (ret == 3)
+				AppendText(fmt_tl("* Symlinked %s.\n", path), 1);
+			else {
+				AppendText(fmt_tl("* Failed to copy %s.\n", path), 2);
+				allOk = false;
+			}
+		};
+
+		// Fonts are copied in the order they were found, but several at once,
+		// so work out up front which ones actually need copying
+		std::vector<size_t> to_copy;
+		std::vector<int> results(paths.size(), 0);
+		std::set<agi::fs::path> names;
+		for (size_t i = 0; i < paths.size(); ++i) {
+			if (duplicates[i] >= 0) {
+				AppendText(fmt_tl("* Skipped %s, which is identical to %s.\n", paths[i], paths[duplicates[i]]), 3);
+				continue;
+			}
 
-			int ret = 0;
-			total_size += agi::fs::Size(path);
+			total_size += sizes[i];
+			if (oper == FcMode::CopyToZip)
+				to_copy.push_back(i);
+			// Two different fonts with the same file name: only the first can
+			// be copied
+			else if (!names.insert(paths[i].filename()).second || agi::fs::FileExists(destination/paths[i].filename()))
+				report(i, 2);
+			else
+				to_copy.push_back(i);
+		}
 
-			switch (oper) {
-				case FcMode::SymlinkToFolder:
-				case FcMode::CopyToScriptFolder:
-				case FcMode::CopyToFolder: {
+		switch (oper) {
+			case FcMode::SymlinkToFolder:
+			case FcMode::CopyToScriptFolder:
+			case FcMode::CopyToFolder:
+				// Copying is mostly waiting on the disk or network, so keep
+				// several copies in flight rather than doing them one by one
+				agi::dispatch::Parallel(to_copy.size(), [&](size_t j) {
+					size_t i = to_copy[j];
+					auto const& path = paths[i];
 					auto dest = destination/path.filename();
-					if (agi::fs::FileExists(dest))
-						ret = 2;
+					int ret = 0;
 #ifndef _WIN32
-					else if (oper == FcMode::SymlinkToFolder) {
+					if (oper == FcMode::SymlinkToFolder) {
 						// returns 0 on success, -1 on error...
 						if (symlink(path.c_str(), dest.c_str()))
 							ret = 0;
 						else
 							ret = 3;
 					}
+					else
 #endif
-					else {
+					{
 						try {
 							agi::fs::Copy(path, dest);
 							ret = true;
@@ -182,31 +289,44 @@ void FontsCollectorThread(AssFile *subs, agi::fs::path const& destination, FcMod
 							ret = false;
 						}
 					}
-				}
+					report(i, ret);
+				});
 				break;
 
-				case FcMode::CopyToZip: {
-					wxFFileInputStream in(path.wstring());
-					if (!in.IsOk())
-						ret = false;
-					else {
-						ret = zip->PutNextEntry(path.filename().wstring());
-						zip->Write(in);
+			case FcMode::CopyToZip:
+				// Entries are compressed in parallel into separate in-memory
+				// archives, then copied into the real one without being
+				// recompressed. This is done a batch at a time to bound the
+				// memory used for the compressed data.
+				for (size_t batch = 0; batch < to_copy.size(); batch += zip_batch_size) {
+					const size_t count = std::min(zip_batch_size, to_copy.size() - batch);
+					std::vector<std::unique_ptr<wxMemoryOutputStream>> compressed(count);
+					agi::dispatch::Parallel(count, [&](size_t j) {
+						auto const& path = paths[to_copy[batch + j]];
+						wxFFileInputStream in(path.wstring());
+						if (!in.IsOk()) return;
+
+						auto mem = agi::make_unique<wxMemoryOutputStream>();
+						wxZipOutputStream entry_zip(*mem);
+						if (entry_zip.PutNextEntry(path.filename().wstring()) && entry_zip.Write(in).IsOk() && entry_zip.Close())
+							compressed[j] = std::move(mem);
+					});
+
+					for (size_t j = 0; j < count; ++j) {
+						bool ret = false;
+						if (compressed[j]) {
+							wxMemoryInputStream mem(*compressed[j]);
+							wxZipInputStream in(mem);
+							// CopyEntry takes ownership of the entry
+							if (wxZipEntry *entry = in.GetNextEntry())
+								ret = zip->CopyEntry(entry, in);
+						}
+						report(to_copy[batch + j], ret);
 					}
 				}
-				default: break;
-			}
+				break;
 
-			if (ret == 1)
-				AppendText(fmt_tl("* Copied %s.\n", path), 1);
-			else if (ret == 2)
-				AppendText(fmt_tl("* %s already exists on destination.\n", path.filename()), 3);
-			else if (ret == 3)
-				AppendText(fmt_tl("* Symlinked %s.\n", path), 1);
-			else {
-				AppendText(fmt_tl("* Failed to copy %s.\n", path), 2);
-				allOk = false;
-			}
+			default: break;
 		}
 
 		if (allOk)
@@ -0,0 +1,111 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file dialog_memory_usage.cpp
+/// @brief Memory used by each of the caches and other large subsystems
+
+#include "compat.h"
+#include "dialog_manager.h"
+#include "format.h"
+#include "include/aegisub/context.h"
+
+#include <libaegisub/memory_usage.h>
+
+#include <wx/button.h>
+#include <wx/dialog.h>
+#include <wx/listctrl.h>
+#include <wx/sizer.h>
+#include <wx/stattext.h>
+#include <wx/timer.h>
+
+namespace {
+wxString format_size(size_t bytes) {
+	if (bytes >= 10 << 20)
+		return fmt_tl("%d MB", bytes >> 20);
+	return fmt_tl("%d KB", (bytes + 1023) >> 10);
+}
+
+class DialogMemoryUsage final : public wxDialog {
+	wxStaticText *total;
+	wxListView *list;
+	wxTimer refresh_timer;
+
+	void UpdateList();
+
+public:
+	DialogMemoryUsage(agi::Context *c);
+};
+
+DialogMemoryUsage::DialogMemoryUsage(agi::Context *c)
+: wxDialog(c->parent, -1, _("Memory Usage"), wxDefaultPosition, wxDefaultSize, wxCAPTION | wxCLOSE_BOX | wxRESIZE_BORDER)
+{
+	total = new wxStaticText(this, -1, "");
+	list = new wxListView(this, -1, wxDefaultPosition, wxSize(450, 250), wxLC_REPORT | wxLC_SINGLE_SEL);
+	list->InsertColumn(0, _("Subsystem"), wxLIST_FORMAT_LEFT, 200);
+	list->InsertColumn(1, _("Instances"), wxLIST_FORMAT_RIGHT, 70);
+	list->InsertColumn(2, _("Used"), wxLIST_FORMAT_RIGHT, 80);
+	list->InsertColumn(3, _("Limit"), wxLIST_FORMAT_RIGHT, 80);
+
+	auto log_button = new wxButton(this, -1, _("&Write to log"));
+
+	auto button_sizer = new wxBoxSizer(wxHORIZONTAL);
+	button_sizer->Add(log_button, wxSizerFlags());
+	button_sizer->AddStretchSpacer();
+	button_sizer->Add(new wxButton(this, wxID_CANCEL, _("&Close")), wxSizerFlags());
+
+	auto sizer = new wxBoxSizer(wxVERTICAL);
+	sizer->Add(total, wxSizerFlags().Expand().Border());
+	sizer->Add(list, wxSizerFlags(1).Expand().Border(wxLEFT | wxRIGHT));
+	sizer->Add(button_sizer, wxSizerFlags().Expand().Border());
+	SetSizerAndFit(sizer);
+	CenterOnParent();
+
+	log_button->Bind(wxEVT_BUTTON, [](wxCommandEvent&) { agi::memory::LogUsage(); });
+	refresh_timer.Bind(wxEVT_TIMER, [=](wxTimerEvent&) { UpdateList(); });
+	refresh_timer.Start(1000);
+
+	UpdateList();
+}
+
+void DialogMemoryUsage::UpdateList() {
+	auto usage = agi::memory::Snapshot();
+
+	// Update the rows in place so that the selection and scroll position
+	// survive refreshing
+	while (list->GetItemCount() > (int)usage.size())
+		list->DeleteItem(list->GetItemCount() - 1);
+
+	size_t bytes = 0;
+	for (size_t i = 0; i < usage.size(); ++i) {
+		auto const& u = usage[i];
+		if ((int)i >= list->GetItemCount())
+			list->InsertItem(i, "");
+		list->SetItem(i, 0, to_wx(u.name));
+		list->SetItem(i, 1, std::to_wstring(u.instances));
+		list->SetItem(i, 2, format_size(u.bytes));
+		list->SetItem(i, 3, u.limit ? format_size(u.limit) : wxString(_("None")));
+		bytes += u.bytes;
+	}
+
+	if (size_t budget = agi::memory::GetBudget())
+		total->SetLabel(fmt_tl("Total: %s of a %s budget", format_size(bytes), format_size(budget)));
+	else
+		total->SetLabel(fmt_tl("Total: %s", format_size(bytes)));
+}
+}
+
+void ShowMemoryUsageDialog(agi::Context *c) {
+	c->dialog->Show<DialogMemoryUsage>(c);
+}
@@ -28,6 +28,7 @@
 #include <libaegisub/util_osx.h>
 
 #include <atomic>
+#include <mutex>
 #include <wx/button.h>
 #include <wx/gauge.h>
 #include <wx/sizer.h>
@@ -75,35 +76,49 @@ class DialogProgressSink final : public agi::ProgressSink {
 	DialogProgress *dialog;
 	std::atomic<bool> cancelled{false};
 	std::atomic<bool> stayopen{true};
+
+	/// Updates made by the task since they were last shown. Rather than
+	/// posting an event for every call, which can flood the main thread when
+	/// a task reports progress for every line, these are applied to the
+	/// dialog at a fixed rate by ApplyUpdates().
+	std::mutex mutex;
+	std::string title;
+	std::string message;
+	std::string log;
 	int progress = 0;
+	bool title_changed = false;
+	bool message_changed = false;
+	bool progress_changed = false;
+	bool indeterminate = false;
 
 public:
 	DialogProgressSink(DialogProgress *dialog) : dialog(dialog) { }
 
 	void SetTitle(std::string const& title) override {
-		Main().Async([=]{ dialog->title->SetLabelText(to_wx(title)); });
+		std::lock_guard<std::mutex> lock(mutex);
+		this->title = title;
+		title_changed = true;
 	}
 
 	void SetMessage(std::string const& msg) override {
-		Main().Async([=]{
-			dialog->text->SetLabelText(to_wx(msg));
-			dialog->text->Wrap(dialog->GetMinWidth());
-			dialog->text->CenterOnParent();
-			dialog->Fit();
-			dialog->Layout();
-		});
+		std::lock_guard<std::mutex> lock(mutex);
+		message = msg;
+		message_changed = true;
 	}
 
 	void SetProgress(int64_t cur, int64_t max) override {
 		int new_progress = mid<int>(0, double(cur) / max * 300, 300);
-		if (new_progress != progress) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (new_progress != progress || indeterminate) {
 			progress = new_progress;
-			Main().Async([=]{ dialog->SetProgress(new_progress); });
+			progress_changed = true;
+			indeterminate = false;
 		}
 	}
 
 	void Log(std::string const& str) override {
-		Main().Async([=]{ dialog->pending_log += to_wx(str); });
+		std::lock_guard<std::mutex> lock(mutex);
+		log += str;
 	}
 
 	void SetStayOpen(bool b) override {
@@ -123,13 +138,46 @@ public:
 	}
 
 	void SetIndeterminate() override {
-		Main().Async([=]{ dialog->pulse_timer.Start(1000); });
+		std::lock_guard<std::mutex> lock(mutex);
+		indeterminate = true;
+		progress_changed = false;
+	}
+
+	/// Show everything reported since the last call. Must be called on the
+	/// main thread.
+	void ApplyUpdates() {
+		std::unique_lock<std::mutex> lock(mutex);
+		const bool new_title = title_changed, new_message = message_changed;
+		const bool new_progress = progress_changed, new_indeterminate = indeterminate;
+		title_changed = message_changed = progress_changed = indeterminate = false;
+		const std::string current_title = title, current_message = message;
+		const int current_progress = progress;
+		std::string new_log;
+		new_log.swap(log);
+		lock.unlock();
+
+		if (new_title)
+			dialog->title->SetLabelText(to_wx(current_title));
+		if (new_message) {
+			dialog->text->SetLabelText(to_wx(current_message));
+			dialog->text->Wrap(dialog->GetMinWidth());
+			dialog->text->CenterOnParent();
+			dialog->Fit();
+			dialog->Layout();
+		}
+		if (new_progress)
+			dialog->SetProgress(current_progress);
+		if (new_indeterminate)
+			dialog->pulse_timer.Start(1000);
+		if (!new_log.empty())
+			dialog->pending_log += to_wx(new_log);
 	}
 };
 
 DialogProgress::DialogProgress(wxWindow *parent, wxString const& title_text, wxString const& message)
 : wxDialog(parent, -1, title_text, wxDefaultPosition, wxDefaultSize, (OPT_GET("App/Dark Mode")->GetBool() ? wxBORDER_SIMPLE : wxBORDER_RAISED))
 , pulse_timer(GetEventHandler())
+, update_timer(GetEventHandler())
 {
 	title = new wxStaticText(this, -1, title_text, wxDefaultPosition, wxDefaultSize, wxALIGN_CENTRE | wxST_NO_AUTORESIZE);
 	gauge = new wxGauge(this, -1, 300, wxDefaultPosition, wxSize(300,20));
@@ -156,7 +204,8 @@ DialogProgress::DialogProgress(wxWindow *parent, wxString const& title_text, wxS
 	CenterOnParent();
 
 	Bind(wxEVT_SHOW, &DialogProgress::OnShow, this);
-	Bind(wxEVT_TIMER, [=](wxTimerEvent&) { gauge->Pulse(); });
+	Bind(wxEVT_TIMER, [=](wxTimerEvent&) { gauge->Pulse(); }, pulse_timer.GetId());
+	Bind(wxEVT_TIMER, [=](wxTimerEvent&) { ps->ApplyUpdates(); }, update_timer.GetId());
 }
 
 void DialogProgress::Run(std::function<void(agi::ProgressSink*)> task) {
@@ -164,6 +213,7 @@ void DialogProgress::Run(std::function<void(agi::ProgressSink*)> task) {
 	this->ps = &ps;
 
 	auto current_title = from_wx(title->GetLabelText());
+	update_timer.Start(1000 / 30);
 	agi::dispatch::Background().Async([=]{
 		agi::osx::AppNapDisabler app_nap_disabler(current_title);
 		try {
@@ -174,6 +224,8 @@ void DialogProgress::Run(std::function<void(agi::ProgressSink*)> task) {
 		}
 
 		Main().Async([this]{
+			update_timer.Stop();
+			this->ps->ApplyUpdates();
 			pulse_timer.Stop();
 			Unbind(wxEVT_IDLE, &DialogProgress::OnIdle, this);
 
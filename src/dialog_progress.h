@@ -42,6 +42,8 @@ class DialogProgress final : public wxDialog, public agi::BackgroundRunner {
 	wxTextCtrl *log_output;
 
 	wxTimer pulse_timer;
+	/// Timer which shows the updates reported by the task at a fixed rate
+	wxTimer update_timer;
 
 	wxString pending_log;
 	int progress_anim_start_value = 0;
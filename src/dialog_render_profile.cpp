@@ -0,0 +1,124 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file dialog_render_profile.cpp
+/// @brief List of the most expensive lines to render on a frame
+
+#include "ass_dialogue.h"
+#include "ass_file.h"
+#include "compat.h"
+#include "dialog_manager.h"
+#include "format.h"
+#include "include/aegisub/context.h"
+#include "render_profile.h"
+#include "selection_controller.h"
+
+#include <libaegisub/signal.h>
+
+#include <wx/button.h>
+#include <wx/dialog.h>
+#include <wx/listctrl.h>
+#include <wx/sizer.h>
+#include <wx/stattext.h>
+
+namespace {
+class DialogRenderProfile final : public wxDialog {
+	agi::Context *c;
+	wxStaticText *status;
+	wxListView *list;
+	wxButton *profile_button;
+	/// Lines in the list, in the same order
+	std::vector<AssDialogue *> lines;
+	agi::signal::Connection profile_changed;
+
+	void UpdateList();
+	void OnActivate(wxListEvent &event);
+
+public:
+	DialogRenderProfile(agi::Context *c);
+};
+
+DialogRenderProfile::DialogRenderProfile(agi::Context *c)
+: wxDialog(c->parent, -1, _("Render Profile"), wxDefaultPosition, wxDefaultSize, wxCAPTION | wxCLOSE_BOX | wxRESIZE_BORDER)
+, c(c)
+, profile_changed(c->renderProfile->AddChangeListener(&DialogRenderProfile::UpdateList, this))
+{
+	status = new wxStaticText(this, -1, "");
+	list = new wxListView(this, -1, wxDefaultPosition, wxSize(600, 250), wxLC_REPORT | wxLC_SINGLE_SEL);
+	list->InsertColumn(0, _("Line"), wxLIST_FORMAT_RIGHT, 50);
+	list->InsertColumn(1, _("Time (ms)"), wxLIST_FORMAT_RIGHT, 80);
+	list->InsertColumn(2, _("Style"), wxLIST_FORMAT_LEFT, 100);
+	list->InsertColumn(3, _("Text"), wxLIST_FORMAT_LEFT, 350);
+
+	profile_button = new wxButton(this, -1, _("&Profile current frame"));
+
+	auto button_sizer = new wxBoxSizer(wxHORIZONTAL);
+	button_sizer->Add(profile_button, wxSizerFlags());
+	button_sizer->AddStretchSpacer();
+	button_sizer->Add(new wxButton(this, wxID_CANCEL, _("&Close")), wxSizerFlags());
+
+	auto sizer = new wxBoxSizer(wxVERTICAL);
+	sizer->Add(status, wxSizerFlags().Expand().Border());
+	sizer->Add(list, wxSizerFlags(1).Expand().Border(wxLEFT | wxRIGHT));
+	sizer->Add(button_sizer, wxSizerFlags().Expand().Border());
+	SetSizerAndFit(sizer);
+	CenterOnParent();
+
+	profile_button->Bind(wxEVT_BUTTON, [=](wxCommandEvent&) { c->renderProfile->Run(); });
+	list->Bind(wxEVT_LIST_ITEM_ACTIVATED, &DialogRenderProfile::OnActivate, this);
+
+	UpdateList();
+}
+
+void DialogRenderProfile::UpdateList() {
+	auto profile = c->renderProfile.get();
+	profile_button->Enable(!profile->Running());
+
+	list->DeleteAllItems();
+	lines.clear();
+
+	if (profile->Running()) {
+		status->SetLabel(_("Rendering each line on the current frame..."));
+		return;
+	}
+	if (profile->Frame() < 0) {
+		status->SetLabel(_("No frame has been profiled."));
+		return;
+	}
+
+	double total = 0;
+	for (auto const& entry : profile->Lines()) {
+		AssDialogue *line = entry.first;
+		int item = list->GetItemCount();
+		list->InsertItem(item, std::to_wstring(line->Row + 1));
+		list->SetItem(item, 1, fmt_wx("%.1f", entry.second));
+		list->SetItem(item, 2, to_wx(line->Style));
+		list->SetItem(item, 3, to_wx(line->Text));
+		lines.push_back(line);
+		total += entry.second;
+	}
+	status->SetLabel(fmt_tl("Frame %d: %d lines, %.1f ms in total", profile->Frame(), (int)lines.size(), total));
+}
+
+void DialogRenderProfile::OnActivate(wxListEvent &event) {
+	long item = event.GetIndex();
+	if (item < 0 || static_cast<size_t>(item) >= lines.size()) return;
+	c->selectionController->SetSelectionAndActive({lines[item]}, lines[item]);
+}
+}
+
+void ShowRenderProfileDialog(agi::Context *c) {
+	c->dialog->Show<DialogRenderProfile>(c);
+}
@@ -92,12 +92,14 @@ DialogSearchReplace<has_replace>::DialogSearchReplace(agi::Context* c)
 	limit_sizer->Add(new wxRadioBox(this, -1, _("Limit to"), wxDefaultPosition, wxDefaultSize, countof(affect), affect, 0, wxRA_SPECIFY_COLS, MakeEnumBinder(&settings->limit_to)));
 
 	auto find_next = new wxButton(this, -1, _("&Find next"));
+	auto find_all = new wxButton(this, -1, _("Fin&d all"));
 	auto replace_next = new wxButton(this, -1, _("Replace &next"));
 	auto replace_all = new wxButton(this, -1, _("Replace &all"));
 	find_next->SetDefault();
 
 	auto button_sizer = new wxBoxSizer(wxVERTICAL);
 	button_sizer->Add(find_next, wxSizerFlags().Border(wxBOTTOM));
+	button_sizer->Add(find_all, wxSizerFlags().Border(wxBOTTOM));
 	button_sizer->Add(replace_next, wxSizerFlags().Border(wxBOTTOM));
 	button_sizer->Add(replace_all, wxSizerFlags().Border(wxBOTTOM));
 	button_sizer->Add(new wxButton(this, wxID_CANCEL));
@@ -125,6 +127,7 @@ DialogSearchReplace<has_replace>::DialogSearchReplace(agi::Context* c)
 	if (has_replace)
 	  replace_edit->Bind(wxEVT_TEXT_ENTER, std::bind(&DialogSearchReplace::FindReplace, this, &SearchReplaceEngine::ReplaceNext));
 	find_next->Bind(wxEVT_BUTTON, std::bind(&DialogSearchReplace::FindReplace, this, &SearchReplaceEngine::FindNext));
+	find_all->Bind(wxEVT_BUTTON, std::bind(&DialogSearchReplace::FindReplace, this, &SearchReplaceEngine::FindAll));
 	replace_next->Bind(wxEVT_BUTTON, std::bind(&DialogSearchReplace::FindReplace, this, &SearchReplaceEngine::ReplaceNext));
 	replace_all->Bind(wxEVT_BUTTON, std::bind(&DialogSearchReplace::FindReplace, this, &SearchReplaceEngine::ReplaceAll));
 }
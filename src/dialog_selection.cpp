@@ -20,6 +20,7 @@
 #include "dialog_manager.h"
 #include "format.h"
 #include "frame_main.h"
+#include "grid_filter.h"
 #include "help_button.h"
 #include "include/aegisub/context.h"
 #include "libresrc/libresrc.h"
@@ -27,8 +28,6 @@
 #include "search_replace_engine.h"
 #include "selection_controller.h"
 
-#include <boost/range/algorithm/set_algorithm.hpp>
-
 #include <wx/checkbox.h>
 #include <wx/combobox.h>
 #include <wx/dialog.h>
@@ -66,7 +65,8 @@ enum class Action {
 	SET = 0,
 	ADD,
 	SUB,
-	INTERSECT
+	INTERSECT,
+	FILTER
 };
 
 enum Mode {
@@ -75,8 +75,8 @@ enum Mode {
 	REGEXP
 };
 
-std::set<AssDialogue*> process(std::string const& match_text, bool match_case, Mode mode, bool invert, bool comments, bool dialogue, int field_n, AssFile *ass) {
-	SearchReplaceSettings settings = {
+SearchReplaceSettings search_settings(std::string const& match_text, bool match_case, Mode mode, int field_n) {
+	return SearchReplaceSettings{
 		match_text,
 		std::string(),
 		static_cast<SearchReplaceSettings::Field>(field_n),
@@ -87,10 +87,12 @@ std::set<AssDialogue*> process(std::string const& match_text, bool match_case, M
 		false,
 		mode == Mode::EXACT
 	};
+}
 
-	auto predicate = SearchReplaceEngine::GetMatcher(settings);
+Selection process(std::string const& match_text, bool match_case, Mode mode, bool invert, bool comments, bool dialogue, int field_n, AssFile *ass) {
+	auto predicate = SearchReplaceEngine::GetMatcher(search_settings(match_text, match_case, mode, field_n));
 
-	std::set<AssDialogue*> matches;
+	Selection matches;
 	for (auto& diag : ass->Events) {
 		if (diag.Comment && !comments) continue;
 		if (!diag.Comment && !dialogue) continue;
@@ -146,8 +148,8 @@ wxDialog (c->parent, -1, _("Select"), wxDefaultPosition, wxDefaultSize, wxCAPTIO
 	}
 
 	{
-		wxString actions[] = { _("Set se&lection"), _("&Add to selection"), _("S&ubtract from selection"), _("Intersect &with selection") };
-		main_sizer->Add(selection_change_type = new wxRadioBox(this, -1, _("Action"), wxDefaultPosition, wxDefaultSize, 4, actions, 1), main_flags);
+		wxString actions[] = { _("Set se&lection"), _("&Add to selection"), _("S&ubtract from selection"), _("Intersect &with selection"), _("S&how only matching lines") };
+		main_sizer->Add(selection_change_type = new wxRadioBox(this, -1, _("Action"), wxDefaultPosition, wxDefaultSize, 5, actions, 1), main_flags);
 	}
 
 	main_sizer->Add(CreateButtonSizer(wxOK | wxCANCEL | wxAPPLY | wxHELP), main_flags);
@@ -183,7 +185,30 @@ DialogSelection::~DialogSelection() {
 }
 
 void DialogSelection::Process(wxCommandEvent& event) {
-	std::set<AssDialogue*> matches;
+	auto action = static_cast<Action>(selection_change_type->GetSelection());
+	if (action == Action::FILTER) {
+		GridFilterCondition cond;
+		cond.search = search_settings(from_wx(match_text->GetValue()), case_sensitive->IsChecked(),
+			static_cast<Mode>(match_mode->GetSelection()), dialogue_field->GetSelection());
+		cond.invert = select_unmatching_lines->GetValue();
+		cond.dialogue = apply_to_dialogue->IsChecked();
+		cond.comments = apply_to_comments->IsChecked();
+
+		try {
+			con->gridFilter->Add(cond);
+		}
+		catch (agi::Exception const&) {
+			if (event.GetId() == wxID_OK) Close();
+			return;
+		}
+
+		const size_t total = con->ass->Events.size();
+		con->frame->StatusTimeout(fmt_tl("Showing %d of %d lines", total - con->gridFilter->HiddenCount(), total));
+		if (event.GetId() == wxID_OK) Close();
+		return;
+	}
+
+	Selection matches;
 
 	try {
 		matches = process(
@@ -197,11 +222,9 @@ void DialogSelection::Process(wxCommandEvent& event) {
 		return;
 	}
 
-	auto action = static_cast<Action>(selection_change_type->GetSelection());
-
 	Selection old_sel, new_sel;
 	if (action != Action::SET)
-		old_sel = con->selectionController->GetSelectedSet();
+		new_sel = old_sel = con->selectionController->GetSelectedSet();
 
 	wxString message;
 	size_t count = 0;
@@ -214,18 +237,18 @@ void DialogSelection::Process(wxCommandEvent& event) {
 			break;
 
 		case Action::ADD:
-			boost::set_union(old_sel, matches, inserter(new_sel, new_sel.begin()));
+			new_sel.Add(matches);
 			message = (count = new_sel.size() - old_sel.size())
 				? fmt_plural(count, "One line was added to selection", "%u lines were added to selection", count)
 				: _("No lines were added to selection");
 			break;
 
 		case Action::SUB:
-			boost::set_difference(old_sel, matches, inserter(new_sel, new_sel.begin()));
+			new_sel.Remove(matches);
 			goto sub_message;
 
 		case Action::INTERSECT:
-			boost::set_intersection(old_sel, matches, inserter(new_sel, new_sel.begin()));
+			new_sel.Intersect(matches);
 			sub_message:
 			message = (count = old_sel.size() - new_sel.size())
 				? fmt_plural(count, "One line was removed from selection", "%u lines were removed from selection", count)
@@ -71,7 +71,6 @@ class DialogShiftTimes final : public wxDialog {
 	void SaveHistory(json::Array shifted_blocks);
 	void LoadHistory();
 	void Process(wxCommandEvent&);
-	int Shift(int initial_time, int shift, bool by_time, agi::vfr::Time type);
 
 	void OnClear(wxCommandEvent&);
 	void OnByTime(wxCommandEvent&);
@@ -386,6 +385,7 @@ void DialogShiftTimes::Process(wxCommandEvent &) {
 	// Track which rows were shifted for the log
 	int block_start = 0;
 	json::Array shifted_blocks;
+	std::vector<AssDialogue *> lines;
 
 	for (auto& line : context->ass->Events) {
 		if (!sel.count(&line)) {
@@ -402,10 +402,34 @@ void DialogShiftTimes::Process(wxCommandEvent &) {
 		else if (!block_start)
 			block_start = line.Row + 1;
 
+		lines.push_back(&line);
+	}
+
+	if (by_time) {
+		for (auto line : lines) {
+			if (start)
+				line->Start = line->Start + shift;
+			if (end)
+				line->End = line->End + shift;
+		}
+	}
+	else {
+		// The lines are mostly in time order, so converting all of their times
+		// at once is much cheaper than searching the timecodes for each
+		std::vector<int> times;
+		times.reserve(lines.size());
+		auto shift_field = [&](agi::vfr::Time type, agi::Time AssDialogue::*field) {
+			times.clear();
+			for (auto line : lines)
+				times.push_back(line->*field);
+			auto frames = fps.FramesAtTimes(times, type);
+			for (size_t i = 0; i < lines.size(); ++i)
+				lines[i]->*field = fps.TimeAtFrame(frames[i] + shift, type);
+		};
 		if (start)
-			line.Start = Shift(line.Start, shift, by_time, agi::vfr::START);
+			shift_field(agi::vfr::START, &AssDialogue::Start);
 		if (end)
-			line.End = Shift(line.End, shift, by_time, agi::vfr::END);
+			shift_field(agi::vfr::END, &AssDialogue::End);
 	}
 
 	context->ass->Commit(_("shifting"), AssFile::COMMIT_DIAG_TIME);
@@ -420,13 +444,6 @@ void DialogShiftTimes::Process(wxCommandEvent &) {
 	SaveHistory(std::move(shifted_blocks));
 	Close();
 }
-
-int DialogShiftTimes::Shift(int initial_time, int shift, bool by_time, agi::vfr::Time type) {
-	if (by_time)
-		return initial_time + shift;
-	else
-		return fps.TimeAtFrame(shift + fps.FrameAtTime(initial_time, type), type);
-}
 }
 
 void ShowShiftTimesDialog(agi::Context *c) {
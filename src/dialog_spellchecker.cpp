@@ -24,6 +24,7 @@
 #include "libresrc/libresrc.h"
 #include "options.h"
 #include "selection_controller.h"
+#include "spelling_index.h"
 #include "text_selection_controller.h"
 
 #include <libaegisub/ass/dialogue_parser.h>
@@ -289,6 +290,8 @@ bool DialogSpellChecker::FindNext() {
 
 bool DialogSpellChecker::CheckLine(AssDialogue *active_line, int start_pos, int *commit_id) {
 	if (active_line->Comment && OPT_GET("Tool/Spell Checker/Skip Comments")->GetBool()) return false;
+	// Skip the lines which the background check has already found to be clean
+	if (context->spelling->Errors(active_line) == 0) return false;
 
 	std::string text = active_line->Text;
 	auto tokens = agi::ass::TokenizeDialogueBody(text);
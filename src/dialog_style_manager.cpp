@@ -29,6 +29,7 @@
 
 #include "ass_dialogue.h"
 #include "ass_file.h"
+#include "ass_parser.h"
 #include "ass_style.h"
 #include "ass_style_storage.h"
 #include "charset_detect.h"
@@ -44,6 +45,7 @@
 #include "persist_location.h"
 #include "selection_controller.h"
 #include "subtitle_format.h"
+#include "text_file_reader.h"
 
 #include <libaegisub/fs.h>
 #include <libaegisub/make_unique.h>
@@ -53,6 +55,7 @@
 #include <libaegisub/vfr.h>
 
 #include <algorithm>
+#include <boost/algorithm/string/case_conv.hpp>
 #include <boost/algorithm/string/trim.hpp>
 #include <functional>
 #include <future>
@@ -143,6 +146,8 @@ class DialogStyleManager final : public wxDialog {
 
 	/// Save the storage and update the view after a change
 	void UpdateStorage();
+	/// Update the storage list from Store without saving it
+	void RefreshStorageList();
 
 	void OnChangeCatalog();
 	void OnCatalogNew();
@@ -250,6 +255,31 @@ int confirm_delete(int n, wxWindow *parent, wxString const& title) {
 		title, wxYES_NO | wxICON_EXCLAMATION, parent);
 }
 
+/// Read just the script info and styles from an ASS or SSA file, as importing
+/// styles needs nothing else and the events are most of the file
+void read_styles(AssFile *target, agi::fs::path const& filename, std::string const& charset) {
+	TextFileReader file(filename, charset);
+	AssParser parser(target, !agi::fs::HasExtension(filename, "ssa"));
+
+	bool wanted = false;
+	bool seen_styles = false;
+	while (file.HasMoreLines()) {
+		auto line = file.ReadLineFromFile();
+		if (!line.empty() && line[0] == '[' && line.back() == ']') {
+			auto low = boost::to_lower_copy(line);
+			bool styles = low == "[v4+ styles]" || low == "[v4 styles]";
+			// The styles nearly always come before the events, so once both
+			// have been reached the rest of the file can be skipped
+			if (seen_styles && low == "[events]") break;
+			seen_styles = seen_styles || styles;
+			wanted = styles || low == "[script info]";
+		}
+		if (wanted)
+			parser.AddLine(line);
+	}
+	parser.Finish();
+}
+
 int get_single_sel(wxListBox *lb) {
 	wxArrayInt selections;
 	int n = lb->GetSelections(selections);
@@ -410,9 +440,18 @@ void DialogStyleManager::OnActiveLineChanged(AssDialogue *new_line) {
 
 void DialogStyleManager::UpdateStorage() {
 	Store.Save();
+	RefreshStorageList();
+}
 
-	StorageList->Clear();
-	StorageList->Append(to_wx(Store.GetNames()));
+void DialogStyleManager::RefreshStorageList() {
+	auto names = to_wx(Store.GetNames());
+	if (names == StorageList->GetStrings())
+		StorageList->DeselectAll();
+	else {
+		StorageList->Freeze();
+		StorageList->Set(names);
+		StorageList->Thaw();
+	}
 
 	UpdateButtons();
 }
@@ -421,7 +460,11 @@ void DialogStyleManager::OnChangeCatalog() {
 	std::string catalog(from_wx(CatalogList->GetStringSelection()));
 	c->ass->Properties.style_storage = catalog;
 	Store.LoadCatalog(catalog);
-	UpdateStorage();
+	// Only a newly created catalog has anything to write out
+	if (AssStyleStorage::CatalogExists(catalog))
+		RefreshStorageList();
+	else
+		UpdateStorage();
 }
 
 void DialogStyleManager::LoadCatalog() {
@@ -680,7 +723,9 @@ void DialogStyleManager::OnCurrentImport() {
 	AssFile temp;
 	try {
 		auto reader = SubtitleFormat::GetReader(filename, charset);
-		if (!reader)
+		if (agi::fs::HasExtension(filename, "ass") || agi::fs::HasExtension(filename, "ssa"))
+			read_styles(&temp, filename, charset);
+		else if (!reader)
 			wxMessageBox("Unsupported subtitle format", "Error", wxOK | wxICON_ERROR | wxCENTER, this);
 		else
 			reader->ReadFile(&temp, filename, 0, charset);
@@ -164,8 +164,10 @@ void DialogStyling::OnActiveLineChanged(AssDialogue *new_line) {
 
 	style_list->SetStringSelection(to_wx(active_line->Style));
 
-	if (auto_seek->IsChecked() && IsActive())
+	if (auto_seek->IsChecked() && IsActive()) {
 		c->videoController->JumpToTime(active_line->Start);
+		c->videoController->PrefetchLineAfter(active_line);
+	}
 }
 
 void DialogStyling::Commit(bool next) {
@@ -185,8 +187,10 @@ void DialogStyling::OnActivate(wxActivateEvent &) {
 
 	style_list->Set(to_wx(c->ass->GetStyles()));
 
-	if (auto_seek->IsChecked())
+	if (auto_seek->IsChecked()) {
 		c->videoController->JumpToTime(active_line->Start);
+		c->videoController->PrefetchLineAfter(active_line);
+	}
 
 	style_name->SetFocus();
 }
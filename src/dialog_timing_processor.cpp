@@ -48,6 +48,8 @@
 #include <boost/range/algorithm.hpp>
 #include <boost/range/algorithm_ext/push_back.hpp>
 #include <functional>
+#include <limits>
+#include <queue>
 #include <vector>
 #include <wx/button.h>
 #include <wx/checkbox.h>
@@ -64,6 +66,22 @@
 using namespace boost::adaptors;
 
 namespace {
+/// Times of a line being processed, which are only written back to the line
+/// once every step has been run so that the steps can also be previewed
+struct LineTimes {
+	AssDialogue *line;
+	int start;
+	int end;
+};
+
+/// Number of lines changed by each processing step
+struct ChangeCounts {
+	size_t lead_in = 0;
+	size_t lead_out = 0;
+	size_t adjacent = 0;
+	size_t keyframes = 0;
+};
+
 /// @class DialogTimingProcessor
 /// @brief Automatic postprocessor for correcting common timing issues
 struct DialogTimingProcessor {
@@ -87,6 +105,7 @@ struct DialogTimingProcessor {
 	wxSlider *adjacentBias;    ///< Bias between shifting start and end times when snapping adjacent lines
 	wxCheckListBox *StyleList; ///< List of styles to process
 	wxButton *ApplyButton;     ///< Button to apply the processing
+	wxStaticText *PreviewText; ///< Number of lines each step would change
 
 	void OnApply(wxCommandEvent &event);
 
@@ -96,9 +115,16 @@ struct DialogTimingProcessor {
 	/// Enable and disable text boxes based on which checkboxes are checked
 	void UpdateControls();
 
+	/// Work out the new times of the given lines
+	/// @return Number of lines changed by each step
+	ChangeCounts Calculate(std::vector<LineTimes>& lines);
+
 	/// Process the file
 	void Process();
 
+	/// Show how many lines each step would change without changing anything
+	void Preview();
+
 	/// Get a list of dialogue lines in the file sorted by start time
 	std::vector<AssDialogue*> SortDialogues();
 
@@ -248,12 +274,22 @@ DialogTimingProcessor::DialogTimingProcessor(agi::Context *c)
 	ApplyButton = ButtonSizer->GetAffirmativeButton();
 	ButtonSizer->GetHelpButton()->Bind(wxEVT_BUTTON, bind(&HelpButton::OpenPage, "Timing Processor"));
 
+	// Preview sizer
+	auto preview = new wxButton(&d, -1, _("&Preview"));
+	preview->SetToolTip(_("Count the lines each step would change without changing them"));
+	PreviewText = new wxStaticText(&d, -1, "");
+
+	auto PreviewSizer = new wxBoxSizer(wxHORIZONTAL);
+	PreviewSizer->Add(preview, wxSizerFlags().Center().Border(wxRIGHT));
+	PreviewSizer->Add(PreviewText, wxSizerFlags(1).Center());
+
 	// Right Sizer
 	auto RightSizer = new wxBoxSizer(wxVERTICAL);
 	RightSizer->Add(optionsSizer,0,wxBOTTOM|wxEXPAND,5);
 	RightSizer->Add(LeadSizer,0,wxBOTTOM|wxEXPAND,5);
 	RightSizer->Add(AdjacentSizer,0,wxBOTTOM|wxEXPAND,5);
 	RightSizer->Add(KeyframesSizer,0,wxBOTTOM|wxEXPAND,5);
+	RightSizer->Add(PreviewSizer,0,wxBOTTOM|wxEXPAND,5);
 	RightSizer->AddStretchSpacer(1);
 	RightSizer->Add(ButtonSizer,0,wxLEFT|wxRIGHT|wxBOTTOM|wxEXPAND,0);
 
@@ -282,6 +318,7 @@ DialogTimingProcessor::DialogTimingProcessor(agi::Context *c)
 	d.Bind(wxEVT_BUTTON, &DialogTimingProcessor::OnApply, this, wxID_OK);
 	all->Bind(wxEVT_BUTTON, bind(&DialogTimingProcessor::CheckAll, this, true));
 	none->Bind(wxEVT_BUTTON, bind(&DialogTimingProcessor::CheckAll, this, false));
+	preview->Bind(wxEVT_BUTTON, bind(&DialogTimingProcessor::Preview, this));
 
 	CheckAll(true);
 }
@@ -325,10 +362,10 @@ void DialogTimingProcessor::OnApply(wxCommandEvent &) {
 }
 
 std::vector<AssDialogue*> DialogTimingProcessor::SortDialogues() {
-	std::set<boost::flyweight<std::string>> styles;
+	std::set<agi::Interned<std::string>> styles;
 	for (size_t i = 0; i < StyleList->GetCount(); ++i) {
 		if (StyleList->IsChecked(i))
-			styles.insert(boost::flyweight<std::string>(from_wx(StyleList->GetString(i))));
+			styles.insert(agi::Interned<std::string>(from_wx(StyleList->GetString(i))));
 	}
 
 	std::vector<AssDialogue*> sorted;
@@ -360,61 +397,139 @@ std::vector<AssDialogue*> DialogTimingProcessor::SortDialogues() {
 	return sorted;
 }
 
-static int get_closest_kf(std::vector<int> const& kf, int frame) {
-	const auto pos = boost::upper_bound(kf, frame);
-	// Return last keyframe if this is after the last one
-	if (pos == end(kf)) return kf.back();
-	// *pos is greater than frame, and *(pos - 1) is less than or equal to frame
-	return (pos == begin(kf) || *pos - frame < frame - *(pos - 1)) ? *pos : *(pos - 1);
-}
+/// Add lead-in to each line, stopping at the end of any earlier line which
+/// ends before the line starts
+///
+/// The lines are sorted by start time and adding lead-in never moves a start
+/// past the original start of a later line, so every earlier end which
+/// limits one line also limits all of the lines after it. This makes it
+/// possible to keep a running maximum of the ends which have been passed,
+/// rather than checking every earlier line for each line.
+static size_t add_lead_in(std::vector<LineTimes>& lines, int lead_in) {
+	std::priority_queue<int, std::vector<int>, std::greater<int>> pending_ends;
+	int limit = std::numeric_limits<int>::min();
+	size_t changed = 0;
+
+	for (size_t i = 0; i < lines.size(); ++i) {
+		if (i > 0)
+			pending_ends.push(lines[i - 1].end);
+		while (!pending_ends.empty() && pending_ends.top() <= lines[i].start) {
+			limit = std::max(limit, pending_ends.top());
+			pending_ends.pop();
+		}
 
-template<class Iter, class Field>
-static int safe_time(Iter begin, Iter end, AssDialogue *comp, int initial, Field field, int const& (*cmp)(int const&, int const&)) {
-	// Compare to every previous line (yay for O(n^2)!) to see if it's OK to add lead-in
-	for (; begin != end; ++begin) {
-		// If the line doesn't already collide with this line, extend it only
-		// to the edge of the line
-		if (!comp->CollidesWith(*begin))
-			initial = cmp(initial, (*begin)->*field);
+		int start = std::max(lines[i].start - lead_in, limit);
+		if (start != lines[i].start) {
+			lines[i].start = start;
+			++changed;
+		}
 	}
-	return initial;
+	return changed;
 }
 
-void DialogTimingProcessor::Process() {
-	std::vector<AssDialogue*> sorted = SortDialogues();
-	if (sorted.empty()) return;
-
-	// Add lead-in/out
-	if (hasLeadIn->IsChecked() && leadIn) {
-		for (size_t i = 0; i < sorted.size(); ++i)
-			sorted[i]->Start = safe_time(sorted.rend() - i, sorted.rend(),
-				sorted[i], sorted[i]->Start - leadIn,
-				&AssDialogue::End, &std::max<int>);
+/// Add lead-out to each line, stopping at the start of any later line which
+/// starts after the line ends
+///
+/// Start times are still sorted after adding lead-in, so the nearest such
+/// start is found with a binary search rather than checking every later line.
+static size_t add_lead_out(std::vector<LineTimes>& lines, int lead_out) {
+	// A zero-length line doesn't collide with a line starting at the same
+	// time, so one which comes later in the list limits the end of the
+	// earlier line to its start
+	std::vector<bool> empty_line_after(lines.size());
+	for (size_t i = lines.size() - 1; i-- > 0; ) {
+		auto const& next = lines[i + 1];
+		if (next.start == lines[i].start)
+			empty_line_after[i] = empty_line_after[i + 1] || next.start == next.end;
 	}
 
-	if (hasLeadOut->IsChecked() && leadOut) {
-		for (size_t i = 0; i < sorted.size(); ++i)
-			sorted[i]->End = safe_time(sorted.begin() + i + 1, sorted.end(),
-				sorted[i], sorted[i]->End + leadOut,
-				&AssDialogue::Start, &std::min<int>);
+	size_t changed = 0;
+	for (size_t i = 0; i < lines.size(); ++i) {
+		// Later lines with the same start collide with this line unless
+		// they're zero-length, which was handled above
+		const int threshold = std::max(lines[i].end, lines[i].start + 1);
+		auto next = std::lower_bound(lines.begin() + i + 1, lines.end(), threshold,
+			[](LineTimes const& line, int time) { return line.start < time; });
+
+		int end = lines[i].end + lead_out;
+		if (next != lines.end())
+			end = std::min(end, next->start);
+		if (empty_line_after[i])
+			end = std::min(end, lines[i].start);
+
+		if (end != lines[i].end) {
+			lines[i].end = end;
+			++changed;
+		}
 	}
+	return changed;
+}
 
-	// Make adjacent
-	if (adjsEnable->IsChecked()) {
-		double bias = adjacentBias->GetValue() / 100.0;
-
-		for (size_t i = 1; i < sorted.size(); ++i) {
-			AssDialogue *prev = sorted[i - 1];
-			AssDialogue *cur = sorted[i];
+/// Make lines which are close to each other continuous
+static size_t make_adjacent(std::vector<LineTimes>& lines, int gap, int overlap, double bias) {
+	std::vector<bool> line_changed(lines.size());
+	for (size_t i = 1; i < lines.size(); ++i) {
+		auto& prev = lines[i - 1];
+		auto& cur = lines[i];
+
+		int dist = cur.start - prev.end;
+		if ((dist < 0 && -dist <= overlap) || (dist > 0 && dist <= gap)) {
+			int setPos = prev.end + int(dist * bias);
+			line_changed[i - 1] = line_changed[i - 1] || prev.end != setPos;
+			line_changed[i] = line_changed[i] || cur.start != setPos;
+			cur.start = setPos;
+			prev.end = setPos;
+		}
+	}
+	return boost::count(line_changed, true);
+}
 
-			int dist = cur->Start - prev->End;
-			if ((dist < 0 && -dist <= adjOverlap) || (dist > 0 && dist <= adjGap)) {
-				int setPos = prev->End + int(dist * bias);
-				cur->Start = setPos;
-				prev->End = setPos;
+/// @class ClosestKeyframe
+/// @brief Finds the keyframe closest to each of a series of frames
+///
+/// Nearly all of the frames looked up are in increasing order, so this walks
+/// forward through the keyframes from the previous lookup and only falls
+/// back to a binary search when a frame is far ahead of or behind the last.
+class ClosestKeyframe {
+	std::vector<int> const& kf;
+	/// Index of the first keyframe after the most recently looked up frame
+	size_t next = 0;
+
+public:
+	ClosestKeyframe(std::vector<int> const& kf) : kf(kf) { }
+
+	/// Get the index of the keyframe closest to the frame
+	size_t operator()(int frame) {
+		if (next > 0 && kf[next - 1] > frame)
+			next = boost::upper_bound(kf, frame) - kf.begin();
+		else {
+			for (int steps = 0; next < kf.size() && kf[next] <= frame; ++next) {
+				if (++steps == 8) {
+					next = std::upper_bound(kf.begin() + next, kf.end(), frame) - kf.begin();
+					break;
+				}
 			}
 		}
+
+		// Return last keyframe if this is after the last one
+		if (next == kf.size()) return next - 1;
+		// kf[next] is greater than frame, and kf[next - 1] is less than or equal to frame
+		return (next == 0 || kf[next] - frame < frame - kf[next - 1]) ? next : next - 1;
 	}
+};
+
+ChangeCounts DialogTimingProcessor::Calculate(std::vector<LineTimes>& lines) {
+	ChangeCounts counts;
+	if (lines.empty()) return counts;
+
+	if (hasLeadIn->IsChecked() && leadIn)
+		counts.lead_in = add_lead_in(lines, leadIn);
+
+	if (hasLeadOut->IsChecked() && leadOut)
+		counts.lead_out = add_lead_out(lines, leadOut);
+
+	if (adjsEnable->IsChecked())
+		counts.adjacent = make_adjacent(lines, adjGap, adjOverlap, adjacentBias->GetValue() / 100.0);
 
 	// Keyframe snapping
 	if (keysEnable->IsChecked()) {
@@ -423,27 +538,92 @@ void DialogTimingProcessor::Process() {
 		if (auto provider = c->project->VideoProvider())
 			kf.push_back(provider->GetFrameCount() - 1);
 
-		for (AssDialogue *cur : sorted) {
-			// Get start/end frames
-			int startF = fps.FrameAtTime(cur->Start, agi::vfr::START);
-			int endF = fps.FrameAtTime(cur->End, agi::vfr::END);
+		// Times lines can be snapped to, which are the same for every line
+		std::vector<int> start_times, end_times;
+		start_times.reserve(kf.size());
+		end_times.reserve(kf.size());
+		for (int frame : kf) {
+			start_times.push_back(fps.TimeAtFrame(frame, agi::vfr::START));
+			end_times.push_back(fps.TimeAtFrame(frame - 1, agi::vfr::END));
+		}
+
+		// Get start/end frames, converting them all at once as the lines are
+		// sorted by time
+		std::vector<int> start_frames, end_frames;
+		{
+			std::vector<int> times;
+			times.reserve(lines.size());
+			for (auto const& cur : lines)
+				times.push_back(cur.start);
+			start_frames = fps.FramesAtTimes(times, agi::vfr::START);
+			times.clear();
+			for (auto const& cur : lines)
+				times.push_back(cur.end);
+			end_frames = fps.FramesAtTimes(times, agi::vfr::END);
+		}
+
+		ClosestKeyframe closest_start(kf), closest_end(kf);
+		for (size_t j = 0; j < lines.size(); ++j) {
+			auto& cur = lines[j];
+			const int startF = start_frames[j];
+			const int endF = end_frames[j];
+			bool changed = false;
 
 			// Get closest for start
-			int closest = get_closest_kf(kf, startF);
-			int time = fps.TimeAtFrame(closest, agi::vfr::START);
-			if ((closest > startF && time - cur->Start <= beforeStart) || (closest < startF && cur->Start - time <= afterStart))
-				cur->Start = time;
+			size_t i = closest_start(startF);
+			int closest = kf[i];
+			int time = start_times[i];
+			if ((closest > startF && time - cur.start <= beforeStart) || (closest < startF && cur.start - time <= afterStart)) {
+				changed = cur.start != time;
+				cur.start = time;
+			}
 
 			// Get closest for end
-			closest = get_closest_kf(kf, endF) - 1;
-			time = fps.TimeAtFrame(closest, agi::vfr::END);
-			if ((closest > endF && time - cur->End <= beforeEnd) || (closest < endF && cur->End - time <= afterEnd))
-				cur->End = time;
+			i = closest_end(endF);
+			closest = kf[i] - 1;
+			time = end_times[i];
+			if ((closest > endF && time - cur.end <= beforeEnd) || (closest < endF && cur.end - time <= afterEnd)) {
+				changed = changed || cur.end != time;
+				cur.end = time;
+			}
+
+			if (changed)
+				++counts.keyframes;
 		}
 	}
 
+	return counts;
+}
+
+static std::vector<LineTimes> get_times(std::vector<AssDialogue*> const& sorted) {
+	std::vector<LineTimes> lines;
+	lines.reserve(sorted.size());
+	for (auto line : sorted)
+		lines.push_back(LineTimes{line, line->Start, line->End});
+	return lines;
+}
+
+void DialogTimingProcessor::Process() {
+	auto lines = get_times(SortDialogues());
+	if (lines.empty()) return;
+
+	Calculate(lines);
+	for (auto const& times : lines) {
+		times.line->Start = times.start;
+		times.line->End = times.end;
+	}
+
 	c->ass->Commit(_("timing processor"), AssFile::COMMIT_DIAG_TIME);
 }
+
+void DialogTimingProcessor::Preview() {
+	d.TransferDataFromWindow();
+	auto lines = get_times(SortDialogues());
+	auto counts = Calculate(lines);
+	PreviewText->SetLabel(fmt_tl("Lines changed: %d lead-in, %d lead-out, %d adjacent, %d keyframe",
+		counts.lead_in, counts.lead_out, counts.adjacent, counts.keyframes));
+	d.Layout();
+}
 }
 
 void ShowTimingProcessorDialog(agi::Context *c) {
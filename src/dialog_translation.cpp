@@ -39,6 +39,7 @@
 #include "video_controller.h"
 
 #include <libaegisub/make_unique.h>
+#include <libaegisub/trace.h>
 
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/predicate.hpp>
@@ -188,6 +189,7 @@ void DialogTranslation::OnActiveLineChanged(AssDialogue *new_line) {
 }
 
 void DialogTranslation::OnExternalCommit(int commit_type) {
+	AGI_TRACE_ZONE("commit", "DialogTranslation");
 	if (commit_type == AssFile::COMMIT_NEW || commit_type & AssFile::COMMIT_DIAG_ADDREM) {
 		line_count = c->ass->Events.size();
 		line_number_display->SetLabel(fmt_tl("Current line: %d/%d", active_line->Row + 1, line_count));
@@ -266,7 +268,10 @@ void DialogTranslation::UpdateDisplay() {
 
 	original_text->SetReadOnly(true);
 
-	if (seek_video->IsChecked()) c->videoController->JumpToTime(active_line->Start);
+	if (seek_video->IsChecked()) {
+		c->videoController->JumpToTime(active_line->Start);
+		c->videoController->PrefetchLineAfter(active_line);
+	}
 
 	translated_text->ClearAll();
 	translated_text->SetFocus();
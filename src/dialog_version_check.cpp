@@ -352,7 +352,7 @@ void DoCheck(bool interactive) {
 }
 
 void PerformVersionCheck(bool interactive) {
-	agi::dispatch::Background().Async([=]{
+	agi::dispatch::Background(agi::dispatch::Priority::Bulk).Async([=]{
 		if (!interactive) {
 			// Automatic checking enabled?
 			if (!OPT_GET("App/Auto/Check For Updates")->GetBool())
@@ -32,6 +32,7 @@
 #include "format.h"
 #include "include/aegisub/context.h"
 #include "project.h"
+#include "video_controller.h"
 
 #include <libaegisub/ass/time.h>
 
@@ -63,6 +64,18 @@ void ShowVideoDetailsDialog(agi::Context *c) {
 		framecount, agi::Time(fps.TimeAtFrame(framecount - 1)).GetAssFormatted(true)));
 	make_field(_("Decoder:"), to_wx(provider->GetDecoderName()));
 
+	auto cache = provider->GetCacheStats();
+	if (cache.hits + cache.misses) {
+		make_field(_("Frame cache:"), fmt_tl("%d frames, %d MB, %d%% hit rate",
+			cache.frames, cache.bytes >> 20, cache.hits * 100 / (cache.hits + cache.misses)));
+	}
+
+	auto const& latency = c->videoController->GetSeekLatency();
+	if (latency.frames) {
+		make_field(_("Seek latency:"), fmt_tl("%d ms average, %d ms worst over %d frames",
+			static_cast<int>(latency.total_ms / latency.frames), static_cast<int>(latency.max_ms), latency.frames));
+	}
+
 	auto video_sizer = new wxStaticBoxSizer(wxVERTICAL, &d, _("Video"));
 	video_sizer->Add(fg);
 
@@ -68,8 +68,10 @@ void ShowFontsCollectorDialog(agi::Context *c);
 void ShowJumpToDialog(agi::Context *c);
 void ShowKanjiTimerDialog(agi::Context *c);
 void ShowLogWindow(agi::Context *c);
+void ShowMemoryUsageDialog(agi::Context *c);
 void ShowPreferences(wxWindow *parent);
 void ShowPropertiesDialog(agi::Context *c);
+void ShowRenderProfileDialog(agi::Context *c);
 void ShowSearchReplaceDialog(agi::Context *c, bool replace);
 void ShowSelectLinesDialog(agi::Context *c);
 void ShowShiftTimesDialog(agi::Context *c);
@@ -0,0 +1,60 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include "dialogue_batch.h"
+
+#include "ass_dialogue.h"
+#include "ass_file.h"
+#include "include/aegisub/context.h"
+#include "selection_controller.h"
+
+DialogueBatch::DialogueBatch(agi::Context *c) : c(c) { }
+DialogueBatch::~DialogueBatch() = default;
+
+void DialogueBatch::Remove(AssDialogue *line) {
+	removed.insert(line);
+}
+
+AssDialogue *DialogueBatch::InsertAfter(AssDialogue *line, std::unique_ptr<AssDialogue> new_line) {
+	auto ret = new_line.get();
+	inserted[line].push_back(std::move(new_line));
+	return ret;
+}
+
+void DialogueBatch::Commit(wxString const& desc, int type, Selection new_sel, AssDialogue *new_active) {
+	std::vector<std::unique_ptr<AssDialogue>> to_delete;
+	to_delete.reserve(removed.size());
+
+	auto& events = c->ass->Events;
+	for (auto it = events.begin(); it != events.end(); ) {
+		auto& line = *it++;
+
+		auto new_lines = inserted.find(&line);
+		if (new_lines != inserted.end()) {
+			for (auto& new_line : new_lines->second)
+				events.insert(it, *new_line.release());
+		}
+
+		if (removed.count(&line)) {
+			events.erase(events.iterator_to(line));
+			to_delete.emplace_back(&line);
+		}
+	}
+	removed.clear();
+	inserted.clear();
+
+	c->ass->Commit(desc, type);
+	c->selectionController->SetSelectionAndActive(std::move(new_sel), new_active);
+}
@@ -0,0 +1,66 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file dialogue_batch.h
+/// @brief Structural edits to many dialogue lines at once
+
+#pragma once
+
+#include "selection.h"
+
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace agi { struct Context; }
+class AssDialogue;
+class wxString;
+
+/// @class DialogueBatch
+/// @brief Removals and insertions of dialogue lines which are applied together
+///
+/// All of the queued changes are made in a single pass over the file, and are
+/// then followed by one commit and one selection change, so that editing tens
+/// of thousands of selected lines doesn't do any per-line work in the grid or
+/// the selection controller.
+class DialogueBatch {
+	agi::Context *c;
+	std::unordered_set<const AssDialogue *> removed;
+	std::unordered_map<const AssDialogue *, std::vector<std::unique_ptr<AssDialogue>>> inserted;
+
+public:
+	DialogueBatch(agi::Context *c);
+	~DialogueBatch();
+
+	/// Queue a line for removal from the file
+	void Remove(AssDialogue *line);
+
+	/// Queue a new line to be inserted after an existing one
+	///
+	/// Lines inserted after the same line end up in the order they were added
+	/// in, and it's fine for that line to also be removed.
+	/// @return The new line, which isn't in the file until Commit
+	AssDialogue *InsertAfter(AssDialogue *line, std::unique_ptr<AssDialogue> new_line);
+
+	/// Have any changes been queued?
+	bool empty() const { return removed.empty() && inserted.empty(); }
+
+	/// Apply the queued changes, commit them and then select the given lines
+	///
+	/// The removed lines are only deleted once nothing can be referring to them
+	/// any more.
+	void Commit(wxString const& desc, int type, Selection new_sel, AssDialogue *new_active);
+};
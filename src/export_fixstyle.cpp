@@ -39,7 +39,7 @@
 #include "compat.h"
 
 #include <algorithm>
-#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/algorithm/string/predicate.hpp>
 #include <wx/intl.h>
 
 AssFixStylesFilter::AssFixStylesFilter()
@@ -47,13 +47,31 @@ AssFixStylesFilter::AssFixStylesFilter()
 {
 }
 
-void AssFixStylesFilter::ProcessSubs(AssFile *subs) {
-	auto styles = subs->GetStyles();
-	for (auto& str : styles) boost::to_lower(str);
-	sort(begin(styles), end(styles));
+namespace {
+/// Get a function which replaces the style of a line with Default if it
+/// isn't one of the file's styles
+std::function<void (AssDialogue&)> style_fixer(AssFile const& subs) {
+	// Sorted and searched case-insensitively in place rather than by
+	// lowercased copies so that checking a line doesn't allocate
+	auto iless = [](std::string const& a, std::string const& b) {
+		return boost::ilexicographical_compare(a, b);
+	};
+	auto styles = subs.GetStyles();
+	sort(begin(styles), end(styles), iless);
 
-	for (auto& diag : subs->Events) {
-		if (!binary_search(begin(styles), end(styles), boost::to_lower_copy(diag.Style.get())))
+	return [=](AssDialogue& diag) {
+		if (!binary_search(begin(styles), end(styles), diag.Style.get(), iless))
 			diag.Style = "Default";
-	}
+	};
+}
+}
+
+void AssFixStylesFilter::ProcessSubs(AssFile *subs) {
+	auto fix_style = style_fixer(*subs);
+	for (auto& diag : subs->Events)
+		fix_style(diag);
+}
+
+std::function<void (AssDialogue&)> AssFixStylesFilter::GetLineProcessor(AssFile const& subs) {
+	return style_fixer(subs);
 }
@@ -37,8 +37,10 @@
 #include "include/aegisub/context.h"
 #include "project.h"
 
+#include <libaegisub/dispatch.h>
 #include <libaegisub/of_type_adaptor.h>
 
+#include <algorithm>
 #include <utility>
 #include <wx/button.h>
 #include <wx/checkbox.h>
@@ -55,10 +57,26 @@ AssTransformFramerateFilter::AssTransformFramerateFilter()
 {
 }
 
+/// Kept separate from the filter so that lines can be transformed concurrently
+struct AssTransformFramerateFilter::LineState {
+	const AssTransformFramerateFilter *filter;
+	AssDialogue *line;
+	int newStart;
+	int newEnd;
+	int newK;
+	int oldK;
+};
+
 void AssTransformFramerateFilter::ProcessSubs(AssFile *subs, wxWindow *) {
 	TransformFrameRate(subs);
 }
 
+std::function<void (AssDialogue&)> AssTransformFramerateFilter::GetLineProcessor(AssFile const&) {
+	if (!Input.IsLoaded() || !Output.IsLoaded())
+		return [](AssDialogue&) { };
+	return [this](AssDialogue& line) { TransformLine(line); };
+}
+
 wxWindow *AssTransformFramerateFilter::GetConfigDialogWindow(wxWindow *parent, agi::Context *c) {
 	LoadSettings(true, c);
 
@@ -152,18 +170,33 @@ static int trunc_cs(int time) {
 	return (time / 10) * 10;
 }
 
+/// Might the text have override tags with times in them (\t, \move, \fad,
+/// \fade and the karaoke tags)? Lines without them only need their start
+/// and end times converted, and aren't parsed at all.
+static bool has_time_tags(std::string const& text) {
+	if (text.find('{') == std::string::npos) return false;
+	for (size_t pos = text.find('\\'); pos != std::string::npos; pos = text.find('\\', pos + 1)) {
+		const char next = pos + 1 < text.size() ? text[pos + 1] : 0;
+		if (next == 't' || next == 'k' || next == 'K')
+			return true;
+		if (text.compare(pos + 1, 3, "fad") == 0 || text.compare(pos + 1, 4, "move") == 0)
+			return true;
+	}
+	return false;
+}
+
 void AssTransformFramerateFilter::TransformTimeTags(std::string const& name, AssOverrideParameter *curParam, void *curData) {
 	VariableDataType type = curParam->GetType();
 	if (type != VariableDataType::INT && type != VariableDataType::FLOAT) return;
 
-	AssTransformFramerateFilter *instance = static_cast<AssTransformFramerateFilter*>(curData);
+	LineState *instance = static_cast<LineState*>(curData);
 	AssDialogue *curDiag = instance->line;
 
 	int parVal = curParam->Get<int>();
 
 	switch (curParam->classification) {
 		case AssParameterClass::RELATIVE_TIME_START: {
-			int value = instance->ConvertTime(trunc_cs(curDiag->Start) + parVal) - instance->newStart;
+			int value = instance->filter->ConvertTime(trunc_cs(curDiag->Start) + parVal) - instance->newStart;
 
 			// An end time of 0 is actually the end time of the line, so ensure
 			// nonzero is never converted to 0
@@ -175,11 +208,11 @@ void AssTransformFramerateFilter::TransformTimeTags(std::string const& name, Ass
 			break;
 		}
 		case AssParameterClass::RELATIVE_TIME_END:
-			curParam->Set(instance->newEnd - instance->ConvertTime(trunc_cs(curDiag->End) - parVal));
+			curParam->Set(instance->newEnd - instance->filter->ConvertTime(trunc_cs(curDiag->End) - parVal));
 			break;
 		case AssParameterClass::KARAOKE: {
 			int start = curDiag->Start / 10 + instance->oldK + parVal;
-			int value = (instance->ConvertTime(start * 10) - instance->newStart) / 10 - instance->newK;
+			int value = (instance->filter->ConvertTime(start * 10) - instance->newStart) / 10 - instance->newK;
 			instance->oldK += parVal;
 			instance->newK += value;
 			curParam->Set(value);
@@ -192,24 +225,43 @@ void AssTransformFramerateFilter::TransformTimeTags(std::string const& name, Ass
 
 void AssTransformFramerateFilter::TransformFrameRate(AssFile *subs) {
 	if (!Input.IsLoaded() || !Output.IsLoaded()) return;
-	for (auto& curDialogue : subs->Events) {
-		line = &curDialogue;
-		newK = 0;
-		oldK = 0;
-		newStart = trunc_cs(ConvertTime(curDialogue.Start));
-		newEnd = trunc_cs(ConvertTime(curDialogue.End) + 9);
-
-		// Process stuff
-		auto blocks = line->ParseTags();
-		for (auto block : blocks | agi::of_type<AssDialogueBlockOverride>())
-			block->ProcessParameters(TransformTimeTags, this);
-		curDialogue.Start = newStart;
-		curDialogue.End = newEnd;
-		curDialogue.UpdateText(blocks);
+
+	std::vector<AssDialogue *> lines;
+	for (auto& line : subs->Events)
+		lines.push_back(&line);
+
+	// Lines are transformed independently and the framerates are only read
+	const size_t lines_per_chunk = 1000;
+	const size_t chunks = (lines.size() + lines_per_chunk - 1) / lines_per_chunk;
+	agi::dispatch::Parallel(chunks, [&](size_t chunk) {
+		const size_t end = std::min(lines.size(), (chunk + 1) * lines_per_chunk);
+		for (size_t i = chunk * lines_per_chunk; i < end; ++i)
+			TransformLine(*lines[i]);
+	});
+}
+
+void AssTransformFramerateFilter::TransformLine(AssDialogue &line) const {
+	LineState state{this, &line,
+		trunc_cs(ConvertTime(line.Start)),
+		trunc_cs(ConvertTime(line.End) + 9),
+		0, 0};
+
+	if (!has_time_tags(line.Text.get())) {
+		line.Start = state.newStart;
+		line.End = state.newEnd;
+		return;
 	}
+
+	// Process stuff
+	auto blocks = line.ParseTags();
+	for (auto block : blocks | agi::of_type<AssDialogueBlockOverride>())
+		block->ProcessParameters(TransformTimeTags, &state);
+	line.Start = state.newStart;
+	line.End = state.newEnd;
+	line.UpdateText(blocks);
 }
 
-int AssTransformFramerateFilter::ConvertTime(int time) {
+int AssTransformFramerateFilter::ConvertTime(int time) const {
 	int frame = Output.FrameAtTime(time);
 	int frameStart = Output.TimeAtFrame(frame);
 	int frameEnd = Output.TimeAtFrame(frame + 1);
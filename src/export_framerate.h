@@ -41,11 +41,9 @@ class wxTextCtrl;
 /// @brief Transform subtitle times, including those in override tags, from an input framerate to an output framerate
 class AssTransformFramerateFilter final : public AssExportFilter {
 	agi::Context *c = nullptr;
-	AssDialogue *line = nullptr;
-	int newStart = 0;
-	int newEnd = 0;
-	int newK = 0;
-	int oldK = 0;
+
+	/// Per-line state used while transforming a line's override tags
+	struct LineState;
 
 	// Yes, these are backwards. It sort of makes sense if you think about what it's doing.
 	agi::vfr::Framerate Input;  ///< Destination frame rate
@@ -62,10 +60,13 @@ class AssTransformFramerateFilter final : public AssExportFilter {
 	/// @brief Apply the transformation to a file
 	/// @param subs File to process
 	void TransformFrameRate(AssFile *subs);
+	/// @brief Apply the transformation to a single line
+	/// @param line Line to transform
+	void TransformLine(AssDialogue &line) const;
 	/// @brief Transform a single tag
 	/// @param name Name of the tag
 	/// @param curParam Current parameter being processed
-	/// @param userdata Filter instance
+	/// @param userdata LineState for the line being transformed
 	static void TransformTimeTags(std::string const& name, AssOverrideParameter *curParam, void *userdata);
 
 	/// @brief Convert a time from the input frame rate to the output frame rate
@@ -76,10 +77,11 @@ class AssTransformFramerateFilter final : public AssExportFilter {
 	///   1. The frame number
 	///   2. The relative distance between the beginning of the frame which time
 	///      is in and the beginning of the next frame
-	int ConvertTime(int time);
+	int ConvertTime(int time) const;
 public:
 	AssTransformFramerateFilter();
 	void ProcessSubs(AssFile *subs, wxWindow *) override;
+	std::function<void (AssDialogue&)> GetLineProcessor(AssFile const& subs) override;
 	wxWindow *GetConfigDialogWindow(wxWindow *parent, agi::Context *c) override;
 	void LoadSettings(bool is_default, agi::Context *c) override;
 };
@@ -39,23 +39,38 @@
 #include "format.h"
 #include "options.h"
 #include "utils.h"
+#include "video_provider_manager.h"
 
 #include <libaegisub/background_runner.h>
+#include <libaegisub/dispatch.h>
 #include <libaegisub/fs.h>
+#include <libaegisub/make_unique.h>
 #include <libaegisub/path.h>
 
 #include <boost/algorithm/string/case_conv.hpp>
-#include <boost/crc.hpp>
 #include <boost/filesystem/path.hpp>
 #include <wx/intl.h>
 #include <wx/choicdlg.h>
 
+#include <atomic>
+
 FFmpegSourceProvider::FFmpegSourceProvider(agi::BackgroundRunner *br)
 : br(br)
 {
 	FFMS_Init(0, 0);
 }
 
+FFMS_Index *FFmpegSourceProvider::RunIndexer(FFMS_Indexer *Indexer, TrackSelection Track, FFMS_IndexErrorHandling IndexEH,
+	                                         TIndexCallback Callback, void *Private, FFMS_ErrorInfo *ErrInfo) {
+	if (Track == TrackSelection::All)
+		FFMS_TrackTypeIndexSettings(Indexer, FFMS_TYPE_AUDIO, 1, 0);
+	else if (Track != TrackSelection::None)
+		FFMS_TrackIndexSettings(Indexer, static_cast<int>(Track), 1, 0);
+	FFMS_TrackTypeIndexSettings(Indexer, FFMS_TYPE_VIDEO, 1, 0);
+	FFMS_SetProgressCallback(Indexer, Callback, Private);
+	return FFMS_DoIndexing2(Indexer, IndexEH, ErrInfo);
+}
+
 /// @brief Does indexing of a source file
 /// @param Indexer		A pointer to the indexer object representing the file to be indexed
 /// @param CacheName    The filename of the output index file
@@ -81,13 +96,7 @@ FFMS_Index *FFmpegSourceProvider::DoIndexing(FFMS_Indexer *Indexer,
 			ps->SetProgress(Current, Total);
 			return ps->IsCancelled();
 		};
-		if (Track == TrackSelection::All)
-			FFMS_TrackTypeIndexSettings(Indexer, FFMS_TYPE_AUDIO, 1, 0);
-		else if (Track != TrackSelection::None)
-			FFMS_TrackIndexSettings(Indexer, static_cast<int>(Track), 1, 0);
-		FFMS_TrackTypeIndexSettings(Indexer, FFMS_TYPE_VIDEO, 1, 0);
-		FFMS_SetProgressCallback(Indexer, callback, ps);
-		Index = FFMS_DoIndexing2(Indexer, IndexEH, &ErrInfo);
+		Index = RunIndexer(Indexer, Track, IndexEH, callback, ps, &ErrInfo);
 	});
 
 	if (Index == nullptr)
@@ -179,15 +188,7 @@ FFMS_IndexErrorHandling FFmpegSourceProvider::GetErrorHandlingMode() {
 /// @param filename	The name of the source file
 /// @return			Returns the generated filename.
 agi::fs::path FFmpegSourceProvider::GetCacheFilename(agi::fs::path const& filename) {
-	// Get the size of the file to be hashed
-	uintmax_t len = agi::fs::Size(filename);
-
-	// Get the hash of the filename
-	boost::crc_32_type hash;
-	hash.process_bytes(filename.string().c_str(), filename.string().size());
-
-	// Generate the filename
-	auto result = config::path->Decode("?local/ffms2cache/" + std::to_string(hash.checksum()) + "_" + std::to_string(len) + "_" + std::to_string(agi::fs::ModifiedTime(filename)) + ".ffindex");
+	auto result = GetVideoCacheFilename(filename, ".ffindex");
 
 	// Ensure that folder exists
 	agi::fs::CreateDirectory(result.parent_path());
@@ -202,4 +203,95 @@ void FFmpegSourceProvider::CleanCache() {
 		OPT_GET("Provider/FFmpegSource/Cache/Files")->GetInt());
 }
 
+namespace {
+class FFmpegSourceIndexJob final : public VideoIndexJob {
+public:
+	/// Set on the main thread when the job is destroyed; callbacks to the
+	/// main thread check it and the indexer stops when it sees it
+	std::shared_ptr<std::atomic<bool>> cancelled = std::make_shared<std::atomic<bool>>(false);
+	~FFmpegSourceIndexJob() { *cancelled = true; }
+};
+}
+
+std::unique_ptr<VideoIndexJob> CreateFFmpegSourceIndexJob(agi::fs::path const& filename,
+	std::function<void (int)> progress, std::function<void (std::string const&)> done) {
+	FFmpegSourceProvider ffms(nullptr);
+	auto CacheName = ffms.GetCacheFilename(filename);
+
+	char FFMSErrMsg[1024];
+	FFMS_ErrorInfo ErrInfo;
+	ErrInfo.Buffer		= FFMSErrMsg;
+	ErrInfo.BufferSize	= sizeof(FFMSErrMsg);
+	ErrInfo.ErrorType	= FFMS_ERROR_SUCCESS;
+	ErrInfo.SubType		= FFMS_ERROR_SUCCESS;
+
+	// Same check as the video provider makes before indexing
+	agi::scoped_holder<FFMS_Index*, void (FFMS_CC*)(FFMS_Index*)>
+		Index(FFMS_ReadIndex(CacheName.string().c_str(), &ErrInfo), FFMS_DestroyIndex);
+	if (Index && !FFMS_IndexBelongsToFile(Index, filename.string().c_str(), &ErrInfo)
+		&& FFMS_GetFirstIndexedTrackOfType(Index, FFMS_TYPE_VIDEO, &ErrInfo) >= 0)
+		return nullptr;
+
+	// Index the audio too when it'll be opened next so that it doesn't need
+	// a second pass over the file
+	auto Track = TrackSelection::None;
+	if (OPT_GET("Provider/FFmpegSource/Index All Tracks")->GetBool() || OPT_GET("Video/Open Audio")->GetBool())
+		Track = TrackSelection::All;
+	auto IndexEH = ffms.GetErrorHandlingMode();
+	ffms.SetLogLevel();
+
+	auto job = agi::make_unique<FFmpegSourceIndexJob>();
+	auto cancelled = job->cancelled;
+	agi::dispatch::Background(agi::dispatch::Priority::Bulk).Async([=] {
+		char FFMSErrMsg[1024];
+		FFMS_ErrorInfo ErrInfo;
+		ErrInfo.Buffer		= FFMSErrMsg;
+		ErrInfo.BufferSize	= sizeof(FFMSErrMsg);
+		ErrInfo.ErrorType	= FFMS_ERROR_SUCCESS;
+		ErrInfo.SubType		= FFMS_ERROR_SUCCESS;
+
+		auto finish = [=](std::string const& error) {
+			agi::dispatch::Main().Async([=] {
+				if (!*cancelled) done(error);
+			});
+		};
+
+		FFMS_Indexer *Indexer = FFMS_CreateIndexer(filename.string().c_str(), &ErrInfo);
+		if (!Indexer)
+			return finish(std::string("Failed to open file: ") + ErrInfo.Buffer);
+
+		struct Progress {
+			std::shared_ptr<std::atomic<bool>> cancelled;
+			std::function<void (int)> progress;
+			int last_percent;
+		} state{cancelled, progress, -1};
+
+		TIndexCallback callback = [](int64_t Current, int64_t Total, void *Private) -> int {
+			auto state = static_cast<Progress *>(Private);
+			const int percent = Total > 0 ? static_cast<int>(Current * 100 / Total) : 0;
+			if (percent != state->last_percent) {
+				state->last_percent = percent;
+				auto cancelled = state->cancelled;
+				auto progress = state->progress;
+				agi::dispatch::Main().Async([=] {
+					if (!*cancelled) progress(percent);
+				});
+			}
+			return *state->cancelled;
+		};
+
+		agi::scoped_holder<FFMS_Index*, void (FFMS_CC*)(FFMS_Index*)>
+			Index(FFmpegSourceProvider::RunIndexer(Indexer, Track, IndexEH, callback, &state, &ErrInfo), FFMS_DestroyIndex);
+		if (*cancelled) return;
+		if (!Index)
+			return finish(std::string("Failed to index: ") + ErrInfo.Buffer);
+
+		if (FFMS_WriteIndex(CacheName.string().c_str(), Index, &ErrInfo))
+			return finish(std::string("Failed to write index: ") + ErrInfo.Buffer);
+		finish("");
+	});
+
+	return std::move(job);
+}
+
 #endif // WITH_FFMS2
@@ -61,6 +61,11 @@ public:
 
 	void CleanCache();
 
+	/// @brief Index the given tracks and the video tracks
+	/// @return The index, or null with the reason in ErrInfo
+	static FFMS_Index *RunIndexer(FFMS_Indexer *Indexer, TrackSelection Track, FFMS_IndexErrorHandling IndexEH,
+		                          TIndexCallback Callback, void *Private, FFMS_ErrorInfo *ErrInfo);
+
 	FFMS_Index *DoIndexing(FFMS_Indexer *Indexer, agi::fs::path const& Cachename,
 		                   TrackSelection Track,
 		                   FFMS_IndexErrorHandling IndexEH);
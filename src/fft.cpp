@@ -41,83 +41,113 @@
 
 #include <cmath>
 
+void FFT::PrepareTables(size_t n_twiddle, size_t n_complex) {
+	if (twiddle_size != n_twiddle) {
+		twiddle_size = n_twiddle;
+		cos_table.resize(n_twiddle / 2);
+		sin_table.resize(n_twiddle / 2);
+		for (size_t k = 0; k < n_twiddle / 2; ++k) {
+			double angle = 2.0 * 3.1415926535897932384626433832795 * k / n_twiddle;
+			cos_table[k] = (float)cos(angle);
+			sin_table[k] = (float)sin(angle);
+		}
+	}
+
+	if (bit_reverse.size() != n_complex) {
+		unsigned int NumBits = NumberOfBitsNeeded(n_complex);
+		bit_reverse.resize(n_complex);
+		for (size_t i = 0; i < n_complex; ++i)
+			bit_reverse[i] = ReverseBits(i, NumBits);
+	}
+}
+
+void FFT::Butterflies(size_t n_samples, float *output_r, float *output_i, bool inverse) {
+	const float sign = inverse ? 1.0f : -1.0f;
+
+	for (size_t BlockSize = 2; BlockSize <= n_samples; BlockSize <<= 1) {
+		const size_t BlockEnd = BlockSize / 2;
+		const size_t step = twiddle_size / BlockSize;
+
+		for (size_t i = 0; i < n_samples; i += BlockSize) {
+			float *re0 = output_r + i, *im0 = output_i + i;
+			float *re1 = re0 + BlockEnd, *im1 = im0 + BlockEnd;
+
+			for (size_t n = 0; n < BlockEnd; ++n) {
+				const float ar = cos_table[n * step];
+				const float ai = sign * sin_table[n * step];
+
+				const float tr = ar*re1[n] - ai*im1[n];
+				const float ti = ar*im1[n] + ai*re1[n];
+
+				re1[n] = re0[n] - tr;
+				im1[n] = im0[n] - ti;
+
+				re0[n] += tr;
+				im0[n] += ti;
+			}
+		}
+	}
+}
+
 void FFT::DoTransform (size_t n_samples,float *input,float *output_r,float *output_i,bool inverse) {
 	if (!IsPowerOfTwo(n_samples))
 		throw agi::InternalError("FFT requires power of two input.");
 
-	// Inverse transform
-	float angle_num = 2.0f * 3.1415926535897932384626433832795f;
-	if (inverse) angle_num = -angle_num;
-
-	// Variables
-	unsigned int i, j, k, n;
-	float tr, ti;
-
-	// Calculate needed bits
-	unsigned int NumBits;
-	NumBits = NumberOfBitsNeeded(n_samples);
+	PrepareTables(n_samples, n_samples);
 
 	// Copy samples to output buffers
-	for (i=0;i<n_samples;i++) {
-		j = ReverseBits (i,NumBits);
+	for (size_t i = 0; i < n_samples; i++) {
+		unsigned int j = bit_reverse[i];
 		output_r[j] = input[i];
 		output_i[j] = 0.0f;
 	}
 
-	unsigned int BlockEnd = 1;
-	unsigned int BlockSize;
-	for (BlockSize = 2;BlockSize<=n_samples;BlockSize<<=1) {
-		// Calculate variables for this iteration
-		float delta_angle = angle_num / (float)BlockSize;
-		float sm2 = sin (-2 * delta_angle);
-		float sm1 = sin (-delta_angle);
-		float cm2 = cos (-2 * delta_angle);
-		float cm1 = cos (-delta_angle);
-		float w = 2 * cm1;
-		float ar0, ar1, ar2, ai0, ai1, ai2;
-
-		// Apply for every sample
-		for(i=0;i<n_samples;i+=BlockSize) {
-			ar1 = cm1;
-			ar2 = cm2;
-			ai1 = sm1;
-			ai2 = sm2;
-
-			for (j=i,n=0;n<BlockEnd;j++,n++) {
-				k = j + BlockEnd;
-
-				ar0 = w*ar1 - ar2;
-				ai0 = w*ai1 - ai2;
-				ar2 = ar1;
-				ai2 = ai1;
-				ar1 = ar0;
-				ai1 = ai0;
-
-				tr = ar0*output_r[k] - ai0*output_i[k];
-				ti = ar0*output_i[k] + ai0*output_r[k];
-
-				output_r[k] = output_r[j] - tr;
-				output_i[k] = output_i[j] - ti;
-
-				output_r[j] += tr;
-				output_i[j] += ti;
-			}
-		}
-
-		// Set next block end to current size
-		BlockEnd = BlockSize;
-	}
+	Butterflies(n_samples, output_r, output_i, inverse);
 
 	// Divide everything by number of samples if it's an inverse transform
 	if (inverse) {
 		float denom = 1.0f/(float)n_samples;
-		for (i=0;i<n_samples;i++) {
+		for (size_t i = 0; i < n_samples; i++) {
 			output_r[i] *= denom;
 			output_i[i] *= denom;
 		}
 	}
 }
 
+void FFT::TransformReal(size_t n_samples,const float *input,float *output_r,float *output_i) {
+	if (!IsPowerOfTwo(n_samples))
+		throw agi::InternalError("FFT requires power of two input.");
+
+	// Transform the even samples as the real part and the odd samples as the
+	// imaginary part of a half-length complex signal, then separate the two
+	const size_t half = n_samples / 2;
+	PrepareTables(n_samples, half);
+	work_r.resize(half);
+	work_i.resize(half);
+
+	for (size_t i = 0; i < half; i++) {
+		unsigned int j = bit_reverse[i];
+		work_r[j] = input[2 * i];
+		work_i[j] = input[2 * i + 1];
+	}
+
+	Butterflies(half, work_r.data(), work_i.data(), false);
+
+	for (size_t k = 0; k < half; k++) {
+		const size_t mk = (half - k) & (half - 1);
+		const float ar = work_r[k], ai = work_i[k];
+		const float br = work_r[mk], bi = work_i[mk];
+
+		// Spectra of the even and odd samples
+		const float er = (ar + br) * 0.5f, ei = (ai - bi) * 0.5f;
+		const float odr = (ai + bi) * 0.5f, odi = (br - ar) * 0.5f;
+
+		const float c = cos_table[k], s = sin_table[k];
+		output_r[k] = er + c*odr + s*odi;
+		output_i[k] = ei + c*odi - s*odr;
+	}
+}
+
 void FFT::Transform(size_t n_samples,float *input,float *output_r,float *output_i) {
 	DoTransform(n_samples,input,output_r,output_i,false);
 }
@@ -28,13 +28,38 @@
 // Aegisub Project http://www.aegisub.org/
 
 #include <cstdlib>
+#include <vector>
 
 class FFT {
+	/// Transform size the twiddle tables were built for
+	size_t twiddle_size = 0;
+	/// cos(2*pi*k/twiddle_size) for k < twiddle_size / 2
+	std::vector<float> cos_table;
+	/// sin(2*pi*k/twiddle_size) for k < twiddle_size / 2
+	std::vector<float> sin_table;
+	/// Bit-reversed index of each sample of the last complex transform size
+	std::vector<unsigned int> bit_reverse;
+	/// Scratch space for the half-length transform in TransformReal
+	std::vector<float> work_r, work_i;
+
+	void PrepareTables(size_t twiddle_size, size_t n_complex);
+	void Butterflies(size_t n_samples, float *output_r, float *output_i, bool inverse);
 	void DoTransform(size_t n_samples,float *input,float *output_r,float *output_i,bool inverse);
 
 public:
 	void Transform(size_t n_samples,float *input,float *output_r,float *output_i);
 	void InverseTransform(size_t n_samples,float *input,float *output_r,float *output_i);
+
+	/// @brief Forward transform of real input, producing only the first half of the spectrum
+	/// @param n_samples Number of input samples, which must be a power of two
+	/// @param input     Real input samples
+	/// @param output_r  Receives the real parts of the first n_samples / 2 bins
+	/// @param output_i  Receives the imaginary parts of the first n_samples / 2 bins
+	///
+	/// The bins are the same as those produced by Transform(), but are
+	/// calculated with a single transform of half the length.
+	void TransformReal(size_t n_samples,const float *input,float *output_r,float *output_i);
+
 	bool IsPowerOfTwo(unsigned int x);
 	unsigned int NumberOfBitsNeeded(unsigned int n_samples);
 	unsigned int ReverseBits(unsigned int index, unsigned int bits);
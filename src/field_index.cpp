@@ -0,0 +1,95 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include "field_index.h"
+
+#include "ass_dialogue.h"
+#include "ass_file.h"
+#include "include/aegisub/context.h"
+
+#include <libaegisub/trace.h>
+
+#include <algorithm>
+
+FieldIndex::FieldIndex(agi::Context *c, agi::Interned<std::string> AssDialogue::*field)
+: context(c)
+, field(field)
+, pre_commit_listener(c->ass->AddPreCommitListener(&FieldIndex::OnPreCommit, this))
+{
+	UpdateAll();
+}
+
+void FieldIndex::OnPreCommit(int type, const AssDialogue *single_line) {
+	AGI_TRACE_ZONE("commit", "FieldIndex");
+	if (type != AssFile::COMMIT_NEW && !(type & (AssFile::COMMIT_DIAG_ADDREM | AssFile::COMMIT_DIAG_META)))
+		return;
+
+	if (single_line && type != AssFile::COMMIT_NEW && !(type & AssFile::COMMIT_DIAG_ADDREM))
+		Update(*single_line);
+	else
+		UpdateAll();
+}
+
+void FieldIndex::Add(agi::Interned<std::string> const& value, int count) {
+	if (value.get().empty()) return;
+
+	auto it = counts.find(value);
+	if (it == counts.end()) {
+		if (count < 0) return;
+		it = counts.emplace(value, 0).first;
+		++version;
+	}
+
+	it->second += count;
+	if (it->second <= 0) {
+		counts.erase(it);
+		++version;
+	}
+}
+
+void FieldIndex::Update(AssDialogue const& line) {
+	auto& counted = lines[line.Id];
+	counted.generation = generation;
+	if (counted.value == line.*field)
+		return;
+
+	Add(counted.value, -1);
+	counted.value = line.*field;
+	Add(counted.value, 1);
+}
+
+void FieldIndex::UpdateAll() {
+	++generation;
+	for (auto const& line : context->ass->Events)
+		Update(line);
+
+	// Lines which weren't seen have been deleted
+	for (auto it = lines.begin(); it != lines.end(); ) {
+		if (it->second.generation == generation)
+			++it;
+		else {
+			Add(it->second.value, -1);
+			it = lines.erase(it);
+		}
+	}
+}
+
+std::vector<std::string> FieldIndex::Values() const {
+	std::vector<std::string> values;
+	values.reserve(counts.size());
+	for (auto const& count : counts)
+		values.push_back(count.first);
+	sort(begin(values), end(values));
+	return values;
+}
@@ -0,0 +1,71 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+/// @file field_index.h
+/// @brief Count of the lines using each value of a dialogue field
+
+#pragma once
+
+#include <libaegisub/interned.h>
+#include <libaegisub/signal.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class AssDialogue;
+namespace agi { struct Context; }
+
+/// @class FieldIndex
+/// @brief Knows how many lines use each value of one of the lines' fields
+///
+/// The counts are updated before each commit is announced, from just the
+/// committed line when only one line changed, so that lists of the values in
+/// use don't have to be rebuilt by going over every line of the file.
+class FieldIndex {
+	/// What each line was counted as, by line ID
+	struct Counted {
+		agi::Interned<std::string> value;
+		/// Pass over the whole file which last saw the line
+		size_t generation = 0;
+	};
+
+	agi::Context *context;
+	agi::Interned<std::string> AssDialogue::*field;
+	std::unordered_map<int, Counted> lines;
+	/// Number of lines using each non-empty value
+	std::unordered_map<agi::Interned<std::string>, int> counts;
+	size_t generation = 0;
+	/// Incremented whenever a value starts or stops being used
+	size_t version = 0;
+	agi::signal::Connection pre_commit_listener;
+
+	void OnPreCommit(int type, const AssDialogue *single_line);
+	/// Count a line, or update its count if it changed
+	void Update(AssDialogue const& line);
+	void Add(agi::Interned<std::string> const& value, int count);
+	/// Check every line of the file
+	void UpdateAll();
+
+public:
+	/// @param c Project context
+	/// @param field Field to count the values of
+	FieldIndex(agi::Context *c, agi::Interned<std::string> AssDialogue::*field);
+
+	/// Get the non-empty values used by any line, sorted
+	std::vector<std::string> Values() const;
+
+	/// Get a number which changes whenever the result of Values() does
+	size_t Version() const { return version; }
+};
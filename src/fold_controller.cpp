@@ -19,13 +19,16 @@
 #include "ass_file.h"
 #include "include/aegisub/context.h"
 #include "format.h"
+#include "grid_filter.h"
 #include "subs_controller.h"
 
 #include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
 #include <unordered_map>
 
-#include <libaegisub/split.h>
-#include <libaegisub/util.h>
+#include <libaegisub/trace.h>
 
 const char *folds_key = "_aegi_folddata";
 
@@ -62,6 +65,7 @@ void FoldController::UpdateLineExtradata(AssDialogue &line) {
 		context->ass->SetExtradataValue(line, folds_key, agi::format("%d;%d;%d", int(line.Fold.side), int(line.Fold.collapsed), int(line.Fold.id)));
 	else
 		context->ass->DeleteExtradataValue(line, folds_key);
+	line.Fold.parsedIds = line.ExtradataIds;
 }
 
 void FoldController::InvalidateLineFold(AssDialogue &line) {
@@ -89,9 +93,17 @@ void FoldController::DoForAllFolds(std::function<void(AssDialogue&)> action) {
 }
 
 void FoldController::FixFoldsPreCommit(int type, const AssDialogue *single_line) {
+	AGI_TRACE_ZONE("commit", "FoldController");
+	const bool filter_changed = context->gridFilter->OnPreCommit(type, single_line);
 	if ((type & (AssFile::COMMIT_FOLD | AssFile::COMMIT_DIAG_ADDREM | AssFile::COMMIT_ORDER)) || type == AssFile::COMMIT_NEW) {
-		UpdateFoldInfo();
+		UpdateFoldInfo(type == AssFile::COMMIT_NEW);
 	}
+	else if (filter_changed)
+		LinkFolds();
+}
+
+void FoldController::UpdateVisibility() {
+	LinkFolds();
 }
 
 // For each line in lines, applies action() to the opening delimiter of the innermost fold containing this line.
@@ -113,39 +125,54 @@ void FoldController::DoForFoldsAt(std::vector<AssDialogue *> const& lines, std::
 	}
 }
 
-void FoldController::UpdateFoldInfo() {
-	ReadFromExtradata();
+void FoldController::UpdateFoldInfo(bool all) {
+	ReadFromExtradata(all);
 	FixFolds();
 	LinkFolds();
 }
 
-void FoldController::ReadFromExtradata() {
+namespace {
+/// Parse a fold descriptor of the form <direction>;<collapsed>;<id>
+bool parse_fold(std::string const& value, int *side, int *collapsed, int *id) {
+	int *fields[] = {side, collapsed, id};
+	const char *pos = value.c_str();
+	for (size_t i = 0; i < 3; ++i) {
+		char *end;
+		errno = 0;
+		long field = strtol(pos, &end, 10);
+		if (end == pos || errno || field < INT_MIN || field > INT_MAX)
+			return false;
+		if (*end != (i < 2 ? ';' : '\0'))
+			return false;
+		*fields[i] = int(field);
+		pos = end + 1;
+	}
+	return true;
+}
+}
+
+void FoldController::ReadFromExtradata(bool all) {
 	max_fold_id = 0;
 
-	for (auto line = context->ass->Events.begin(); line != context->ass->Events.end(); line++) {
-		line->Fold.extraExists = false;
-
-		for (auto const& extra : context->ass->GetExtradata(line->ExtradataIds)) {
-			if (extra.key == folds_key) {
-				std::vector<std::string> fields;
-				agi::Split(fields, extra.value, ';');
-				if (fields.size() != 3)
-					break;
-
-				int side;
-				int collapsed;
-				if (!agi::util::try_parse(fields[0], &side)) break;
-				if (!agi::util::try_parse(fields[1], &collapsed)) break;
-				if (!agi::util::try_parse(fields[2], &line->Fold.id)) break;
-				line->Fold.side = side;
-				line->Fold.collapsed = collapsed;
-
-				line->Fold.extraExists = true;
-				max_fold_id = std::max(max_fold_id, line->Fold.id);
-				break;
+	for (auto& line : context->ass->Events) {
+		auto& fold = line.Fold;
+		if (all || fold.parsedIds != line.ExtradataIds) {
+			fold.extraExists = false;
+			fold.parsedIds = line.ExtradataIds;
+
+			int side, collapsed, id;
+			auto extra = context->ass->FindExtradata(line.ExtradataIds, folds_key);
+			if (extra && parse_fold(extra->value, &side, &collapsed, &id)) {
+				fold.side = side;
+				fold.collapsed = collapsed;
+				fold.id = id;
+				fold.extraExists = true;
 			}
 		}
-		line->Fold.valid = line->Fold.extraExists;
+
+		if (fold.extraExists)
+			max_fold_id = std::max(max_fold_id, fold.id);
+		fold.valid = fold.extraExists;
 	}
 }
 
@@ -254,10 +281,11 @@ void FoldController::LinkFolds() {
 
 	int visibleRow = 0;
 	int highestFolded = 1;
+	auto const& filter = *context->gridFilter;
 	for (auto line = context->ass->Events.begin(); line != context->ass->Events.end(); line++) {
 		line->Fold.parent = foldStack.empty() ? nullptr : foldStack.back();
 		line->Fold.nextVisible = nullptr;
-		line->Fold.visible = highestFolded > (int) foldStack.size();
+		line->Fold.visible = highestFolded > (int) foldStack.size() && !filter.IsHidden(*line);
 		line->Fold.visibleRow = visibleRow;
 
 		if (line->Fold.visible) {
@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <libaegisub/interned.h>
 #include <libaegisub/signal.h>
 #include "ass_file.h"
 
@@ -55,6 +56,10 @@ class FoldInfo {
 	bool collapsed = false;
 	/// False if a fold is started here, true otherwise.
 	bool side = false;
+	/// The extradata ids the fields above were read from. Extradata entries
+	/// are never modified once added, so they only need to be parsed again
+	/// if the line's ids have changed.
+	agi::Interned<std::vector<uint32_t>> parsedIds;
 
 	/// Whether the line is currently visible
 	bool visible = true;
@@ -87,6 +92,7 @@ public:
 	// The following functions are only valid directly after a commit.
 	// Their behaviour is undefined as soon as any uncommitted change is made to the Events.
 	AssDialogue *getFoldOpener() const { return parent; }
+	bool isVisible() const { return visible; }
 	AssDialogue *getNextVisible() const { return nextVisible; }
 	int getVisibleRow() const { return visibleRow; }
 };
@@ -117,17 +123,18 @@ class FoldController {
 
 	/// After lines have been added or deleted, this ensures consistency again. Run with every relevant commit.
 	/// Performs the three actions below in order.
-	void UpdateFoldInfo();
+	void UpdateFoldInfo(bool all);
 
-	/// Parses the extradata of all lines and sets the respective lines in the FoldInfo.
-	/// Also deduplicates extradata entries and mangles fold id's when necessary.
-	void ReadFromExtradata();
+	/// Parses the extradata of lines whose extradata has changed and sets the respective lines in the FoldInfo.
+	/// @param all Parse every line, as the ids may refer to a different set of entries than they were parsed from
+	void ReadFromExtradata(bool all);
 
 	/// Ensures consistency by making sure every fold has two delimiters and folds are properly nested.
 	/// Cleans up extradata entries if they've been invalid for long enough.
 	void FixFolds();
 
 	/// Once the fold base data is valid, sets up all the cached links in the FoldData.
+	/// Lines hidden by the grid filter are linked as if they were folded away.
 	void LinkFolds();
 
 public:
@@ -135,6 +142,9 @@ public:
 
 	int GetMaxDepth();
 
+	/// Link up the visible lines again after the grid filter changed
+	void UpdateVisibility();
+
 	// All of the following functions are only valid directly after a commit.
 	// Their behaviour is undefined as soon as any uncommitted change is made to the Events.
 
@@ -21,11 +21,23 @@
 #include "ass_style.h"
 #include "compat.h"
 #include "format.h"
+#include "options.h"
 
-#include <libaegisub/format_flyweight.h>
+#include <libaegisub/cajun/elements.h>
+#include <libaegisub/cajun/reader.h>
+#include <libaegisub/cajun/writer.h>
+#include <libaegisub/dispatch.h>
+#include <libaegisub/format_interned.h>
 #include <libaegisub/format_path.h>
+#include <libaegisub/fs.h>
+#include <libaegisub/io.h>
+#include <libaegisub/log.h>
+#include <libaegisub/make_unique.h>
+#include <libaegisub/path.h>
 
 #include <algorithm>
+#include <iterator>
+#include <mutex>
 #include <tuple>
 #include <unicode/uchar.h>
 #include <wx/intl.h>
@@ -51,21 +63,188 @@ wxString format_missing(wxString const& str) {
 
 	return printable + unprintable;
 }
+
+/// A font file as it was when a font was found in it
+struct FontFileStamp {
+	agi::fs::path path;
+	time_t modified;
+	uintmax_t size;
+};
+
+/// A font found by an earlier lookup, along with the characters which have
+/// been checked against it so far
+struct CachedFont {
+	CollectionResult result;
+	/// Sorted characters which have been checked for
+	std::vector<int> checked;
+	/// Sorted characters from checked which the font does not have
+	std::vector<int> missing;
+	/// The files the font was found in, for telling if the index is stale
+	std::vector<FontFileStamp> files;
+};
+
+/// Fonts found by previous collections, by face name, weight and italic.
+/// Fonts which weren't found aren't cached, so that installing one and
+/// collecting again works.
+///
+/// This is saved to disk after each collection and loaded by the first one
+/// in a session, so that later sessions only have to ask the system about
+/// fonts whose files have changed and characters which haven't been
+/// checked before.
+std::mutex font_cache_mutex;
+std::map<std::tuple<std::string, int, bool>, CachedFont> font_cache;
+bool font_cache_loaded = false;
+bool font_cache_dirty = false;
+
+/// Bump when the format of the saved index changes
+const int font_index_version = 1;
+
+agi::fs::path font_index_path() {
+	return config::path->Decode("?local/font_index.json");
+}
+
+bool stamp_file(agi::fs::path const& path, FontFileStamp& stamp) {
+	try {
+		stamp.path = path;
+		stamp.modified = agi::fs::ModifiedTime(path);
+		stamp.size = agi::fs::Size(path);
+		return true;
+	}
+	catch (agi::fs::FileSystemError const&) {
+		return false;
+	}
+}
+
+/// Store a sorted list of characters as pairs of the first character and
+/// the length of each run of consecutive characters
+json::Array encode_chars(std::vector<int> const& chars) {
+	json::Array ret;
+	for (size_t i = 0; i < chars.size(); ) {
+		size_t j = i + 1;
+		while (j < chars.size() && chars[j] == chars[j - 1] + 1) ++j;
+		ret.push_back(chars[i]);
+		ret.push_back(static_cast<int>(j - i));
+		i = j;
+	}
+	return ret;
+}
+
+std::vector<int> decode_chars(json::Array const& runs) {
+	std::vector<int> ret;
+	for (size_t i = 0; i + 1 < runs.size(); i += 2) {
+		const auto first = static_cast<json::Integer const&>(runs[i]);
+		const auto count = static_cast<json::Integer const&>(runs[i + 1]);
+		for (json::Integer c = first; c < first + count; ++c)
+			ret.push_back(static_cast<int>(c));
+	}
+	return ret;
+}
+
+void load_font_index() {
+	font_cache_loaded = true;
+	try {
+		json::UnknownElement root;
+		json::Reader::Read(root, *agi::io::Open(font_index_path()));
+		json::Object const& index = root;
+		if (static_cast<json::Integer const&>(index.at("version")) != font_index_version)
+			return;
+
+		for (json::Object const& font : static_cast<json::Array const&>(index.at("fonts"))) {
+			CachedFont cached;
+			bool stale = false;
+			for (json::Object const& file : static_cast<json::Array const&>(font.at("files"))) {
+				FontFileStamp stamp;
+				if (!stamp_file(static_cast<json::String const&>(file.at("path")), stamp)
+					|| stamp.modified != static_cast<json::Integer const&>(file.at("modified"))
+					|| stamp.size != static_cast<uintmax_t>(static_cast<json::Integer const&>(file.at("size"))))
+					stale = true;
+				cached.result.paths.push_back(stamp.path);
+				cached.files.push_back(std::move(stamp));
+			}
+
+			// Fonts which have been changed or removed will be looked up again
+			if (stale || cached.files.empty()) {
+				font_cache_dirty = true;
+				continue;
+			}
+
+			cached.result.fake_bold = static_cast<json::Boolean const&>(font.at("fake bold"));
+			cached.result.fake_italic = static_cast<json::Boolean const&>(font.at("fake italic"));
+			cached.checked = decode_chars(font.at("checked"));
+			cached.missing = decode_chars(font.at("missing"));
+
+			auto key = std::make_tuple(
+				static_cast<json::String const&>(font.at("face")),
+				static_cast<int>(static_cast<json::Integer const&>(font.at("bold"))),
+				static_cast<json::Boolean const&>(font.at("italic")));
+			font_cache[key] = std::move(cached);
+		}
+	}
+	catch (agi::fs::FileSystemError const& e) {
+		LOG_D("font_collector/index") << "Cannot load font index: " << e.GetMessage();
+	}
+	catch (std::exception const& e) {
+		LOG_W("font_collector/index") << "Discarding invalid font index: " << e.what();
+		font_cache.clear();
+		font_cache_dirty = true;
+	}
+}
+
+void save_font_index() {
+	if (!font_cache_dirty) return;
+	font_cache_dirty = false;
+
+	json::Array fonts;
+	for (auto const& entry : font_cache) {
+		json::Array files;
+		for (auto const& stamp : entry.second.files) {
+			json::Object file;
+			file["path"] = stamp.path.string();
+			file["modified"] = static_cast<int64_t>(stamp.modified);
+			file["size"] = static_cast<int64_t>(stamp.size);
+			files.push_back(std::move(file));
+		}
+
+		json::Object font;
+		font["face"] = std::get<0>(entry.first);
+		font["bold"] = std::get<1>(entry.first);
+		font["italic"] = std::get<2>(entry.first);
+		font["files"] = std::move(files);
+		font["fake bold"] = entry.second.result.fake_bold;
+		font["fake italic"] = entry.second.result.fake_italic;
+		font["checked"] = encode_chars(entry.second.checked);
+		font["missing"] = encode_chars(entry.second.missing);
+		fonts.push_back(std::move(font));
+	}
+
+	json::Object index;
+	index["version"] = font_index_version;
+	index["fonts"] = std::move(fonts);
+
+	try {
+		agi::JsonWriter::Write(index, agi::io::Save(font_index_path()).Get());
+	}
+	catch (agi::fs::FileSystemError const& e) {
+		LOG_E("font_collector/index") << "Cannot save font index: " << e.GetMessage();
+	}
+}
+
+/// Number of lines scanned by each task when gathering the used styles
+const size_t lines_per_scan = 500;
 }
 
 FontCollector::FontCollector(FontCollectorStatusCallback status_callback)
 : status_callback(std::move(status_callback))
-, lister(this->status_callback)
 {
 }
 
-void FontCollector::ProcessDialogueLine(const AssDialogue *line, int index) {
+void FontCollector::ProcessDialogueLine(const AssDialogue *line, int index, ScanResult& result) const {
 	if (line->Comment) return;
 
 	auto style_it = styles.find(line->Style);
 	if (style_it == end(styles)) {
-		status_callback(fmt_tl("Style '%s' does not exist\n", line->Style), 2);
-		++missing;
+		result.errors.push_back(fmt_tl("Style '%s' does not exist\n", line->Style));
+		++result.missing;
 		return;
 	}
 
@@ -74,12 +253,14 @@ void FontCollector::ProcessDialogueLine(const AssDialogue *line, int index) {
 
 	bool overriden = false;
 
-	for (auto& block : line->ParseTags()) {
-		switch (block->GetType()) {
+	auto const& parsed = line->Parsed();
+	for (auto const& block : parsed.Blocks()) {
+		switch (block.type) {
 		case AssBlockType::OVERRIDE:
-			for (auto const& tag : static_cast<AssDialogueBlockOverride&>(*block).Tags) {
+			for (auto const& tag : parsed.Tags(block)) {
 				if (tag.Name == "\\r") {
-					style = styles[tag.Params[0].Get(line->Style.get())];
+					auto reset = styles.find(tag.Params[0].Get(line->Style.get()));
+					style = reset == end(styles) ? StyleInfo() : reset->second;
 					overriden = false;
 				}
 				else if (tag.Name == "\\b") {
@@ -97,12 +278,12 @@ void FontCollector::ProcessDialogueLine(const AssDialogue *line, int index) {
 			}
 			break;
 		case AssBlockType::PLAIN: {
-			auto text = block->GetText();
+			auto text = block.text;
 
 			if (text.empty())
 				continue;
 
-			auto& usage = used_styles[style];
+			auto& usage = result.used_styles[style];
 
 			if (overriden) {
 				auto& lines = usage.lines;
@@ -133,13 +314,10 @@ void FontCollector::ProcessDialogueLine(const AssDialogue *line, int index) {
 				U8_NEXT(&text[0], i, size, c);
 				chars.push_back(c);
 			}
-
-			sort(begin(chars), end(chars));
-			chars.erase(unique(chars.begin(), chars.end()), chars.end());
 			break;
 		}
 		case AssBlockType::DRAWING:
-			used_styles[style].drawing = true;
+			result.used_styles[style].drawing = true;
 			break;
 		case AssBlockType::COMMENT:
 			break;
@@ -147,6 +325,84 @@ void FontCollector::ProcessDialogueLine(const AssDialogue *line, int index) {
 	}
 }
 
+void FontCollector::MergeScan(ScanResult& scan) {
+	for (auto const& error : scan.errors)
+		status_callback(error, 2);
+	missing += scan.missing;
+
+	for (auto& style : scan.used_styles) {
+		auto& usage = used_styles[style.first];
+		auto& src = style.second;
+
+		// Ranges are merged in order, so the lines stay sorted
+		usage.lines.insert(usage.lines.end(), src.lines.begin(), src.lines.end());
+		usage.drawing = usage.drawing || src.drawing;
+
+		auto& chars = usage.chars;
+		chars.insert(chars.end(), src.chars.begin(), src.chars.end());
+		sort(begin(chars), end(chars));
+		chars.erase(unique(chars.begin(), chars.end()), chars.end());
+	}
+}
+
+CollectionResult FontCollector::FindFont(StyleInfo const& style, std::vector<int> const& chars) {
+	std::lock_guard<std::mutex> lock(font_cache_mutex);
+	if (!font_cache_loaded)
+		load_font_index();
+
+	auto key = std::make_tuple(style.facename, style.bold, style.italic);
+	auto it = font_cache.find(key);
+
+	std::vector<int> unchecked;
+	if (it == end(font_cache))
+		unchecked = chars;
+	else
+		std::set_difference(begin(chars), end(chars), begin(it->second.checked), end(it->second.checked), std::back_inserter(unchecked));
+
+	if (it == end(font_cache) || !unchecked.empty()) {
+		if (!lister)
+			lister = agi::make_unique<FontFileLister>(status_callback);
+
+		auto res = lister->GetFontPaths(style.facename, style.bold, style.italic, unchecked);
+		if (res.paths.empty()) {
+			if (it != end(font_cache)) {
+				font_cache.erase(it);
+				font_cache_dirty = true;
+			}
+			return res;
+		}
+
+		if (it == end(font_cache)) {
+			it = font_cache.emplace(key, CachedFont{}).first;
+			it->second.result = res;
+			it->second.result.missing.clear();
+			for (auto const& path : res.paths) {
+				FontFileStamp stamp;
+				if (stamp_file(path, stamp))
+					it->second.files.push_back(std::move(stamp));
+			}
+		}
+		font_cache_dirty = true;
+
+		auto& cached = it->second;
+		for (wxUniChar c : res.missing)
+			cached.missing.push_back(c.GetValue());
+		sort(begin(cached.missing), end(cached.missing));
+
+		std::vector<int> checked;
+		std::set_union(begin(cached.checked), end(cached.checked), begin(unchecked), end(unchecked), std::back_inserter(checked));
+		cached.checked = std::move(checked);
+	}
+
+	auto const& cached = it->second;
+	CollectionResult ret = cached.result;
+	for (int chr : chars) {
+		if (std::binary_search(begin(cached.missing), end(cached.missing), chr))
+			ret.missing += chr;
+	}
+	return ret;
+}
+
 void FontCollector::ProcessChunk(std::pair<StyleInfo, UsageData> const& style) {
 	if (style.second.chars.empty() && !style.second.drawing) return;
 
@@ -154,7 +410,7 @@ void FontCollector::ProcessChunk(std::pair<StyleInfo, UsageData> const& style) {
 		status_callback(fmt_tl("Font '%s' is used in a drawing, but not in any text.\n", style.first.facename), 3);
 	}
 
-	auto res = lister.GetFontPaths(style.first.facename, style.first.bold, style.first.italic, style.second.chars);
+	auto res = FindFont(style.first, style.second.chars);
 
 	if (res.paths.empty()) {
 		status_callback(fmt_tl("Could not find font '%s'\n", style.first.facename), 2);
@@ -218,14 +474,37 @@ std::vector<agi::fs::path> FontCollector::GetFontPaths(const AssFile *file) {
 		used_styles[info].styles.push_back(style.name);
 	}
 
-	int index = 0;
+	std::vector<const AssDialogue *> lines;
 	for (auto const& diag : file->Events)
-		ProcessDialogueLine(&diag, ++index);
+		lines.push_back(&diag);
+
+	std::vector<ScanResult> scans((lines.size() + lines_per_scan - 1) / lines_per_scan);
+	agi::dispatch::Parallel(scans.size(), [&](size_t i) {
+		auto& scan = scans[i];
+		const size_t start = i * lines_per_scan;
+		const size_t stop = std::min(lines.size(), start + lines_per_scan);
+		for (size_t j = start; j < stop; ++j)
+			ProcessDialogueLine(lines[j], static_cast<int>(j) + 1, scan);
+
+		for (auto& style : scan.used_styles) {
+			auto& chars = style.second.chars;
+			sort(begin(chars), end(chars));
+			chars.erase(unique(chars.begin(), chars.end()), chars.end());
+		}
+	});
+
+	for (auto& scan : scans)
+		MergeScan(scan);
 
 	status_callback(_("Searching for font files\n"), 0);
 	for (auto const& style : used_styles) ProcessChunk(style);
 	status_callback(_("Done\n\n"), 0);
 
+	{
+		std::lock_guard<std::mutex> lock(font_cache_mutex);
+		save_font_index();
+	}
+
 	std::vector<agi::fs::path> paths;
 	paths.reserve(results.size());
 	paths.insert(paths.end(), results.begin(), results.end());
@@ -20,6 +20,7 @@
 #include <boost/filesystem/path.hpp>
 #include <functional>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -132,10 +133,21 @@ class FontCollector {
 		std::vector<std::string> styles; ///< ASS styles which use this style
 	};
 
+	/// Where the styles are used in a range of lines, so that separate
+	/// ranges can be scanned on separate threads and then merged
+	struct ScanResult {
+		std::map<StyleInfo, UsageData> used_styles;
+		/// Messages about lines with styles which don't exist, in line order
+		std::vector<wxString> errors;
+		int missing = 0;
+	};
+
 	/// Message callback provider by caller
 	FontCollectorStatusCallback status_callback;
 
-	FontFileLister lister;
+	/// Only created once a font isn't found in the results of the lookups
+	/// done by earlier collections, as creating it can be slow
+	std::unique_ptr<FontFileLister> lister;
 
 	/// The set of all glyphs used in the file
 	std::map<StyleInfo, UsageData> used_styles;
@@ -149,7 +161,14 @@ class FontCollector {
 	int missing_glyphs = 0;
 
 	/// Gather all of the unique styles with text on a line
-	void ProcessDialogueLine(const AssDialogue *line, int index);
+	void ProcessDialogueLine(const AssDialogue *line, int index, ScanResult& result) const;
+
+	/// Merge the usage found in a range of lines into used_styles
+	void MergeScan(ScanResult& scan);
+
+	/// Get the font files for a style, reusing the results of earlier
+	/// lookups of the same style during this session where possible
+	CollectionResult FindFont(StyleInfo const& style, std::vector<int> const& chars);
 
 	/// Get the font for a single style
 	void ProcessChunk(std::pair<StyleInfo, UsageData> const& style);
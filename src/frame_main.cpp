@@ -35,6 +35,7 @@
 
 #include "include/aegisub/context.h"
 #include "include/aegisub/menu.h"
+#include "include/aegisub/subtitles_provider.h"
 #include "include/aegisub/toolbar.h"
 #include "include/aegisub/hotkey.h"
 
@@ -51,6 +52,7 @@
 #include "main.h"
 #include "options.h"
 #include "project.h"
+#include "startup_log.h"
 #include "subs_controller.h"
 #include "subs_edit_box.h"
 #include "utils.h"
@@ -62,12 +64,14 @@
 #include <libaegisub/dispatch.h>
 #include <libaegisub/log.h>
 #include <libaegisub/make_unique.h>
+#include <libaegisub/trace.h>
 
 #include <wx/dnd.h>
 #include <wx/msgdlg.h>
 #include <wx/sizer.h>
 #include <wx/statline.h>
 #include <wx/sysopt.h>
+#include <wx/weakref.h>
 
 enum {
 	ID_APP_TIMER_STATUSCLEAR = 12002
@@ -76,7 +80,7 @@ enum {
 #ifdef WITH_STARTUPLOG
 #define StartupLog(a) MessageBox(0, a, "Aegisub startup log", 0)
 #else
-#define StartupLog(a) LOG_I("frame_main/init") << a
+#define StartupLog(a) startup_log::Phase("frame_main/init", a)
 #endif
 
 /// Handle files drag and dropped onto Aegisub
@@ -133,6 +137,12 @@ FrameMain::FrameMain()
 	StartupLog("Create status bar");
 	CreateStatusBar(2);
 
+	// Opening video before the fonts have been scanned waits on the scan, so
+	// say that it's happening
+	wxWeakRef<FrameMain> self(this);
+	if (SubtitlesProviderFactory::WhenFontsReady([=] { if (self) self->StatusTimeout(_("Font cache updated"), 3000); }))
+		SetStatusText(_("Updating font cache..."), 1);
+
 	StartupLog("Set icon");
 #ifdef _WIN32
 	SetIcon(wxICON(wxicon));
@@ -247,6 +257,7 @@ void FrameMain::SetDisplayMode(int video, int audio) {
 }
 
 void FrameMain::UpdateTitle() {
+	AGI_TRACE_ZONE("commit", "FrameMain");
 	wxString newTitle;
 	if (context->subsController->IsModified()) newTitle << "* ";
 	newTitle << context->subsController->Filename().filename().wstring();
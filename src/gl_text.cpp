@@ -78,31 +78,21 @@ struct OpenGLTextGlyph {
 		dc.GetTextExtent(str, &w, &h, &desc, &lead);
 	}
 
-	void Draw(float x, float y) const {
-		glBindTexture(GL_TEXTURE_2D, tex);
-		glEnableClientState(GL_VERTEX_ARRAY);
-		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-
-		float tex_coords[] = {
+	/// Append the quad which draws this glyph at the given position
+	void AddQuad(std::vector<float> &vertices, std::vector<float> &tex_coords, float x, float y) const {
+		tex_coords.insert(tex_coords.end(), {
 			x1, y1,
 			x1, y2,
 			x2, y2,
 			x2, y1
-		};
+		});
 
-		float vert_coords[] = {
+		vertices.insert(vertices.end(), {
 			x, y,
 			x, y + h,
 			x + w, y + h,
 			x + w, y
-		};
-
-		glVertexPointer(2, GL_FLOAT, 0, vert_coords);
-		glTexCoordPointer(2, GL_FLOAT, 0, tex_coords);
-		glDrawArrays(GL_QUADS, 0, 4);
-
-		glDisableClientState(GL_VERTEX_ARRAY);
-		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+		});
 	}
 };
 
@@ -238,6 +228,7 @@ void OpenGLText::SetFont(std::string const& face, int size, bool bold, bool ital
 	// Delete all old data
 	textures.clear();
 	glyphs.clear();
+	batches.clear();
 }
 
 void OpenGLText::SetColour(agi::Color col) {
@@ -251,6 +242,8 @@ void OpenGLText::Print(const std::string &text, int x, int y) {
 	glEnable(GL_BLEND);
 	glEnable(GL_TEXTURE_2D);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 
 	// Draw border
 	glColor4f(0.0f, 0.0f, 0.0f, 1.0f);
@@ -264,16 +257,40 @@ void OpenGLText::Print(const std::string &text, int x, int y) {
 	DrawString(text, x, y);
 
 	// Disable blend
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
 	glDisable(GL_TEXTURE_2D);
 	glDisable(GL_BLEND);
 }
 
 void OpenGLText::DrawString(const std::string &text, int x, int y) {
+	// Collect the quads for each texture so that the whole string is drawn
+	// with one call per texture rather than one per character
+	for (auto& batch : batches) {
+		batch.vertices.clear();
+		batch.tex_coords.clear();
+	}
+
 	for (char curChar : text) {
 		OpenGLTextGlyph const& glyph = GetGlyph(curChar);
-		glyph.Draw(x, y);
+		auto batch = std::find_if(batches.begin(), batches.end(),
+			[&](GlyphBatch const& b) { return b.tex == glyph.tex; });
+		if (batch == batches.end()) {
+			batches.emplace_back();
+			batch = batches.end() - 1;
+			batch->tex = glyph.tex;
+		}
+		glyph.AddQuad(batch->vertices, batch->tex_coords, x, y);
 		x += glyph.w;
 	}
+
+	for (auto const& batch : batches) {
+		if (batch.vertices.empty()) continue;
+		glBindTexture(GL_TEXTURE_2D, batch.tex);
+		glVertexPointer(2, GL_FLOAT, 0, batch.vertices.data());
+		glTexCoordPointer(2, GL_FLOAT, 0, batch.tex_coords.data());
+		glDrawArrays(GL_QUADS, 0, batch.vertices.size() / 2);
+	}
 }
 
 void OpenGLText::GetExtent(std::string const& text, int &w, int &h) {
@@ -56,6 +56,16 @@ class OpenGLText {
 
 	std::vector<OpenGLTextTexture> textures;
 
+	/// Quads to draw from a single glyph texture
+	struct GlyphBatch {
+		int tex = 0;
+		std::vector<float> vertices;
+		std::vector<float> tex_coords;
+	};
+	/// Scratch buffers for DrawString, kept to avoid reallocating them for
+	/// every string
+	std::vector<GlyphBatch> batches;
+
 	OpenGLText(OpenGLText const&) = delete;
 	OpenGLText& operator=(OpenGLText const&) = delete;
 
@@ -21,6 +21,12 @@
 
 #include "gl_wrap.h"
 
+#include <libaegisub/make_unique.h>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
 #include <wx/colour.h>
 
 #ifdef HAVE_OPENGL_GL_H
@@ -82,6 +88,9 @@ public:
 		data[i * dim + 1] = p.Y();
 	}
 
+	size_t Size() const { return data.size() / dim; }
+	const float *Vertex(size_t i) const { return &data[i * dim]; }
+
 	void Draw(GLenum mode, bool clear = true) {
 		glEnableClientState(GL_VERTEX_ARRAY);
 		glVertexPointer(dim, GL_FLOAT, 0, &data[0]);
@@ -92,6 +101,44 @@ public:
 	}
 };
 
+/// @class OpenGLWrapper::Batch
+/// @brief Primitives collected between BeginBatch() and EndBatch()
+///
+/// Everything is stored as independent triangles and line segments with a
+/// color per vertex so that each kind can be drawn with a single call no
+/// matter how many shapes went into it.
+struct OpenGLWrapper::Batch {
+	/// Interleaved x, y, r, g, b, a for each vertex of the filled triangles
+	std::vector<float> triangles;
+	/// Line segment vertices in the same layout, split by line width
+	std::map<int, std::vector<float>> lines;
+
+	static void Add(std::vector<float> &out, const float *vertex, float r, float g, float b, float a) {
+		out.insert(out.end(), {vertex[0], vertex[1], r, g, b, a});
+	}
+
+	static void Draw(GLenum mode, std::vector<float> const& vertices) {
+		if (vertices.empty()) return;
+		glVertexPointer(2, GL_FLOAT, 6 * sizeof(float), &vertices[0]);
+		glColorPointer(4, GL_FLOAT, 6 * sizeof(float), &vertices[2]);
+		glDrawArrays(mode, 0, vertices.size() / 6);
+	}
+
+	bool Empty() const {
+		return triangles.empty() && std::all_of(lines.begin(), lines.end(),
+			[](std::pair<const int, std::vector<float>> const& l) { return l.second.empty(); });
+	}
+
+	/// Clear the collected primitives while keeping the allocated storage
+	void Clear() {
+		triangles.clear();
+		for (auto& l : lines)
+			l.second.clear();
+	}
+};
+
+OpenGLWrapper::~OpenGLWrapper() { }
+
 OpenGLWrapper::OpenGLWrapper() {
 	line_r = line_g = line_b = line_a = 1.f;
 	fill_r = fill_g = fill_b = fill_a = 1.f;
@@ -100,12 +147,116 @@ OpenGLWrapper::OpenGLWrapper() {
 	smooth = true;
 }
 
+void OpenGLWrapper::BeginBatch() {
+	if (!batch)
+		batch = agi::make_unique<Batch>();
+	batching = true;
+}
+
+void OpenGLWrapper::EndBatch() {
+	FlushBatch();
+	batching = false;
+}
+
+void OpenGLWrapper::FlushBatch() const {
+	if (!batching || batch->Empty()) return;
+
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glShadeModel(GL_SMOOTH);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+
+	Batch::Draw(GL_TRIANGLES, batch->triangles);
+
+	if (smooth)
+		glEnable(GL_LINE_SMOOTH);
+	else
+		glDisable(GL_LINE_SMOOTH);
+	for (auto const& l : batch->lines) {
+		if (l.second.empty()) continue;
+		glLineWidth(l.first);
+		Batch::Draw(GL_LINES, l.second);
+	}
+
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glShadeModel(GL_FLAT);
+
+	batch->Clear();
+}
+
+void OpenGLWrapper::Submit(VertexArray &buf, GLenum mode, bool fill, bool clear) const {
+	if (!batching) {
+		if (fill)
+			SetModeFill();
+		else
+			SetModeLine();
+		buf.Draw(mode, clear);
+		return;
+	}
+
+	const size_t n = buf.Size();
+	auto vertex = [&](size_t i) { return buf.Vertex(i % n); };
+
+	if (fill) {
+		auto& out = batch->triangles;
+		auto add = [&](size_t i) { Batch::Add(out, vertex(i), fill_r, fill_g, fill_b, fill_a); };
+		switch (mode) {
+			case GL_TRIANGLES:
+				for (size_t i = 0; i + 2 < n; i += 3) {
+					add(i); add(i + 1); add(i + 2);
+				}
+				break;
+			case GL_QUADS:
+				for (size_t i = 0; i + 3 < n; i += 4) {
+					add(i); add(i + 1); add(i + 2);
+					add(i); add(i + 2); add(i + 3);
+				}
+				break;
+			case GL_QUAD_STRIP:
+				for (size_t i = 0; i + 3 < n; i += 2) {
+					add(i); add(i + 1); add(i + 3);
+					add(i); add(i + 3); add(i + 2);
+				}
+				break;
+			case GL_POLYGON:
+				for (size_t i = 1; i + 1 < n; ++i) {
+					add(0); add(i); add(i + 1);
+				}
+				break;
+		}
+	}
+	else {
+		auto& out = batch->lines[line_width];
+		auto add = [&](size_t i) { Batch::Add(out, vertex(i), line_r, line_g, line_b, line_a); };
+		switch (mode) {
+			case GL_LINES:
+				for (size_t i = 0; i + 1 < n; i += 2) {
+					add(i); add(i + 1);
+				}
+				break;
+			case GL_LINE_STRIP:
+			case GL_LINE_LOOP:
+				for (size_t i = 0; i + 1 < n; ++i) {
+					add(i); add(i + 1);
+				}
+				if (mode == GL_LINE_LOOP && n > 2) {
+					add(n - 1); add(n);
+				}
+				break;
+		}
+	}
+
+	if (clear)
+		buf.SetSize(2, 0);
+}
+
 void OpenGLWrapper::DrawLine(Vector2D p1, Vector2D p2) const {
-	SetModeLine();
 	VertexArray buf(2, 2);
 	buf.Set(0, p1);
 	buf.Set(1, p2);
-	buf.Draw(GL_LINES);
+	Submit(buf, GL_LINES, false);
 }
 
 static inline Vector2D interp(Vector2D p1, Vector2D p2, float t) {
@@ -114,9 +265,17 @@ static inline Vector2D interp(Vector2D p1, Vector2D p2, float t) {
 
 void OpenGLWrapper::DrawDashedLine(Vector2D p1, Vector2D p2, float step) const {
 	step /= (p2 - p1).Len();
-	for (float t = 0; t < 1.f; t += 2 * step) {
-		DrawLine(interp(p1, p2, t), interp(p1, p2, t + step));
+	if (!std::isfinite(step) || step <= 0.f) return;
+
+	// All of the dashes go into a single draw
+	VertexArray buf(2, 2 * (size_t(std::ceil(0.5f / step)) + 1));
+	size_t i = 0;
+	for (float t = 0; t < 1.f && i + 1 < buf.Size(); t += 2 * step) {
+		buf.Set(i++, interp(p1, p2, t));
+		buf.Set(i++, interp(p1, p2, t + step));
 	}
+	buf.SetSize(2, i);
+	Submit(buf, GL_LINES, false);
 }
 
 void OpenGLWrapper::DrawEllipse(Vector2D center, Vector2D radius) const {
@@ -131,15 +290,11 @@ void OpenGLWrapper::DrawRectangle(Vector2D p1, Vector2D p2) const {
 	buf.Set(3, Vector2D(p1, p2));
 
 	// Fill
-	if (fill_a != 0.f) {
-		SetModeFill();
-		buf.Draw(GL_QUADS, false);
-	}
+	if (fill_a != 0.f)
+		Submit(buf, GL_QUADS, true, false);
 	// Outline
-	if (line_a != 0.f) {
-		SetModeLine();
-		buf.Draw(GL_LINE_LOOP);
-	}
+	if (line_a != 0.f)
+		Submit(buf, GL_LINE_LOOP, false);
 }
 
 void OpenGLWrapper::DrawTriangle(Vector2D p1, Vector2D p2, Vector2D p3) const {
@@ -149,15 +304,11 @@ void OpenGLWrapper::DrawTriangle(Vector2D p1, Vector2D p2, Vector2D p3) const {
 	buf.Set(2, p3);
 
 	// Fill
-	if (fill_a != 0.f) {
-		SetModeFill();
-		buf.Draw(GL_TRIANGLES, false);
-	}
+	if (fill_a != 0.f)
+		Submit(buf, GL_TRIANGLES, true, false);
 	// Outline
-	if (line_a != 0.f) {
-		SetModeLine();
-		buf.Draw(GL_LINE_LOOP);
-	}
+	if (line_a != 0.f)
+		Submit(buf, GL_LINE_LOOP, false);
 }
 
 void OpenGLWrapper::DrawRing(Vector2D center, float r1, float r2, float ar, float arc_start, float arc_end) const {
@@ -184,8 +335,6 @@ void OpenGLWrapper::DrawRing(Vector2D center, float r1, float r2, float ar, floa
 	Vector2D scale_outer = Vector2D(ar, 1) * r2;
 
 	if (fill_a != 0.f) {
-		SetModeFill();
-
 		// Annulus
 		if (r1 != r2) {
 			buf.SetSize(2, (steps + 1) * 2);
@@ -195,7 +344,7 @@ void OpenGLWrapper::DrawRing(Vector2D center, float r1, float r2, float ar, floa
 				buf.Set(i * 2 + 1, center + offset * scale_outer);
 				cur_angle += step;
 			}
-			buf.Draw(GL_QUAD_STRIP);
+			Submit(buf, GL_QUAD_STRIP, true);
 		}
 		// Circle
 		else {
@@ -204,7 +353,7 @@ void OpenGLWrapper::DrawRing(Vector2D center, float r1, float r2, float ar, floa
 				buf.Set(i, center + Vector2D::FromAngle(cur_angle) * scale_inner);
 				cur_angle += step;
 			}
-			buf.Draw(GL_POLYGON);
+			Submit(buf, GL_POLYGON, true);
 		}
 
 		cur_angle = arc_start;
@@ -216,12 +365,11 @@ void OpenGLWrapper::DrawRing(Vector2D center, float r1, float r2, float ar, floa
 	steps++;
 	buf.SetSize(2, steps);
 
-	SetModeLine();
 	for (int i = 0; i < steps; i++) {
 		buf.Set(i, center + Vector2D::FromAngle(cur_angle) * scale_outer);
 		cur_angle += step;
 	}
-	buf.Draw(GL_LINE_STRIP);
+	Submit(buf, GL_LINE_STRIP, false);
 
 	// Inner
 	if (r1 == r2) return;
@@ -232,7 +380,7 @@ void OpenGLWrapper::DrawRing(Vector2D center, float r1, float r2, float ar, floa
 		buf.Set(i, center + Vector2D::FromAngle(cur_angle) * scale_inner);
 		cur_angle += step;
 	}
-	buf.Draw(GL_LINE_STRIP);
+	Submit(buf, GL_LINE_STRIP, false);
 
 	if (!needs_end_caps) return;
 
@@ -241,7 +389,7 @@ void OpenGLWrapper::DrawRing(Vector2D center, float r1, float r2, float ar, floa
 	buf.Set(1, center + Vector2D::FromAngle(arc_start) * scale_outer);
 	buf.Set(2, center + Vector2D::FromAngle(arc_end) * scale_inner);
 	buf.Set(3, center + Vector2D::FromAngle(arc_end) * scale_outer);
-	buf.Draw(GL_LINES);
+	Submit(buf, GL_LINES, false);
 }
 
 void OpenGLWrapper::SetLineColour(wxColour col, float alpha, int width) {
@@ -280,6 +428,7 @@ void OpenGLWrapper::SetModeFill() const {
 }
 
 void OpenGLWrapper::SetInvert() {
+	FlushBatch();
 	glEnable(GL_COLOR_LOGIC_OP);
 	glLogicOp(GL_INVERT);
 
@@ -288,6 +437,7 @@ void OpenGLWrapper::SetInvert() {
 }
 
 void OpenGLWrapper::ClearInvert() {
+	FlushBatch();
 	glDisable(GL_COLOR_LOGIC_OP);
 	smooth = true;
 }
@@ -302,6 +452,7 @@ void OpenGLWrapper::DrawLines(size_t dim, std::vector<float> const& lines) {
 }
 
 void OpenGLWrapper::DrawLines(size_t dim, std::vector<float> const& lines, size_t c_dim, std::vector<float> const& colors) {
+	FlushBatch();
 	glShadeModel(GL_SMOOTH);
 	glEnableClientState(GL_COLOR_ARRAY);
 	glColorPointer(c_dim, GL_FLOAT, 0, &colors[0]);
@@ -311,6 +462,7 @@ void OpenGLWrapper::DrawLines(size_t dim, std::vector<float> const& lines, size_
 }
 
 void OpenGLWrapper::DrawLines(size_t dim, const float *lines, size_t n) {
+	FlushBatch();
 	SetModeLine();
 	glEnableClientState(GL_VERTEX_ARRAY);
 	glVertexPointer(dim, GL_FLOAT, 0, lines);
@@ -319,6 +471,7 @@ void OpenGLWrapper::DrawLines(size_t dim, const float *lines, size_t n) {
 }
 
 void OpenGLWrapper::DrawLineStrip(size_t dim, std::vector<float> const& lines) {
+	FlushBatch();
 	SetModeLine();
 	glEnableClientState(GL_VERTEX_ARRAY);
 	glVertexPointer(dim, GL_FLOAT, 0, &lines[0]);
@@ -339,6 +492,11 @@ static void APIENTRY glMultiDrawArraysFallback(GLenum mode, const GLint *first,
 void OpenGLWrapper::DrawMultiPolygon(std::vector<float> const& points, std::vector<int> &start, std::vector<int> &count, Vector2D video_pos, Vector2D video_size, bool invert) {
 	GL_EXT(PFNGLMULTIDRAWARRAYSPROC, glMultiDrawArrays);
 
+	// The stencil passes have to be drawn immediately
+	FlushBatch();
+	bool was_batching = batching;
+	batching = false;
+
 	float real_line_a = line_a;
 	line_a = 0;
 
@@ -389,6 +547,7 @@ void OpenGLWrapper::DrawMultiPolygon(std::vector<float> const& points, std::vect
 	glMultiDrawArrays(GL_LINE_LOOP, &start[0], &count[0], start.size());
 
 	glDisableClientState(GL_VERTEX_ARRAY);
+	batching = was_batching;
 }
 
 void OpenGLWrapper::SetOrigin(Vector2D origin) {
@@ -423,6 +582,7 @@ void OpenGLWrapper::SetShear(float x, float y) {
 }
 
 void OpenGLWrapper::PrepareTransform() {
+	FlushBatch();
 	if (!transform_pushed) {
 		glMatrixMode(GL_MODELVIEW);
 		glPushMatrix();
@@ -432,6 +592,7 @@ void OpenGLWrapper::PrepareTransform() {
 }
 
 void OpenGLWrapper::ResetTransform() {
+	FlushBatch();
 	if (transform_pushed) {
 		glPopMatrix();
 		transform_pushed = false;
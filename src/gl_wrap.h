@@ -21,9 +21,12 @@
 
 #include "vector2d.h"
 
+#include <memory>
 #include <vector>
 
+class VertexArray;
 class wxColour;
+typedef unsigned int GLenum;
 
 class OpenGLWrapper {
 	float line_r, line_g, line_b, line_a;
@@ -35,8 +38,29 @@ class OpenGLWrapper {
 	bool transform_pushed;
 	void PrepareTransform();
 
+	struct Batch;
+	std::unique_ptr<Batch> batch;
+	bool batching = false;
+
+	/// Draw the primitives in buf with the current fill or line settings, or
+	/// add them to the batch if one is open
+	void Submit(VertexArray &buf, GLenum mode, bool fill, bool clear = true) const;
+	/// Draw everything collected in the current batch
+	void FlushBatch() const;
+
 public:
 	OpenGLWrapper();
+	~OpenGLWrapper();
+
+	/// @brief Start collecting shapes rather than drawing them immediately
+	///
+	/// Shapes drawn until EndBatch() are drawn in two calls per line width:
+	/// first every fill, then every outline. Anything else which touches the
+	/// GL state (transforms, inverting, polygons and the DrawLines family)
+	/// draws what has been collected so far first.
+	void BeginBatch();
+	/// Draw the collected shapes and go back to drawing immediately
+	void EndBatch();
 
 	void SetLineColour(wxColour col, float alpha = 1.0f, int width = 1);
 	void SetFillColour(wxColour col, float alpha = 1.0f);
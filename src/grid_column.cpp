@@ -18,14 +18,20 @@
 
 #include "ass_dialogue.h"
 #include "ass_file.h"
+#include "collision_index.h"
 #include "compat.h"
 #include "include/aegisub/context.h"
+#include "format.h"
 #include "options.h"
+#include "render_profile.h"
+#include "spelling_index.h"
 #include "video_controller.h"
 #include "fold_controller.h"
 
 #include <libaegisub/character_count.h>
 
+#include <map>
+
 #include <wx/dc.h>
 
 void WidthHelper::Age() {
@@ -38,7 +44,7 @@ void WidthHelper::Age() {
 	++age;
 }
 
-int WidthHelper::operator()(boost::flyweight<std::string> const& str) {
+int WidthHelper::operator()(agi::Interned<std::string> const& str) {
 	if (str.get().empty()) return 0;
 	auto it = widths.find(str);
 	if (it != end(widths)) {
@@ -82,16 +88,42 @@ void GridColumn::UpdateWidth(const agi::Context *c, WidthHelper &helper) {
 		return;
 	}
 
-	width = Width(c, helper);
+	SetWidth(Width(c, helper), helper);
+}
+
+void GridColumn::SetWidth(int content_width, WidthHelper &helper) {
+	width = content_width;
 	if (width) // 10 is an arbitrary amount of padding
 		width = 10 + std::max(width, helper(Header()));
 }
 
 void GridColumn::Paint(wxDC &dc, int x, int y, const AssDialogue *d, const agi::Context *c) const {
-	wxString str = Value(d, c);
+	if (!CacheValue()) {
+		wxString str = Value(d, c);
+		if (Centered())
+			x += (width - 6 - dc.GetTextExtent(str).GetWidth()) / 2;
+		dc.DrawText(str, x + 4, y + 2);
+		return;
+	}
+
+	auto it = value_cache.find(d->Id);
+	if (it == value_cache.end()) {
+		// Only a few screens worth of lines are painted between most commits,
+		// so just start over if scrolling through a huge file fills the cache
+		if (value_cache.size() > 8192)
+			value_cache.clear();
+		wxString str = Value(d, c);
+		int extent = Centered() ? dc.GetTextExtent(str).GetWidth() : 0;
+		it = value_cache.emplace(d->Id, CachedValue{std::move(str), extent}).first;
+	}
+
 	if (Centered())
-		x += (width - 6 - dc.GetTextExtent(str).GetWidth()) / 2;
-	dc.DrawText(str, x + 4, y + 2);
+		x += (width - 6 - it->second.extent) / 2;
+	dc.DrawText(it->second.str, x + 4, y + 2);
+}
+
+void GridColumn::ClearCache(const AssDialogue *d) {
+	value_cache.erase(d->Id);
 }
 
 namespace {
@@ -102,6 +134,75 @@ namespace {
 	private: const wxString description = value; \
 	public: wxString const& Description() const override { return description; }
 
+/// A column which is as wide as its widest line
+///
+/// Each line maps to a key whose ordering matches the widths of their values,
+/// such as the value itself for numbers. After a full update the key of every
+/// line is remembered, so that changing a single line only has to replace
+/// its key rather than look at every line in the file again.
+struct GridColumnWidest : GridColumn {
+	/// Key of each line, by line ID, if the index has been built
+	std::unordered_map<int, int64_t> line_keys;
+	/// Number of lines with each key
+	std::map<int64_t, size_t> key_counts;
+	bool index_valid = false;
+
+	/// Get the key for a line
+	virtual int64_t Key(const AssDialogue *d, WidthHelper &helper) const = 0;
+	/// Get the width of the value of a line with the given key
+	virtual int KeyWidth(int64_t key, const agi::Context *c, WidthHelper &helper) const = 0;
+
+	int Width(const agi::Context *c, WidthHelper &helper) const override {
+		int64_t max = 0;
+		for (AssDialogue const& line : c->ass->Events)
+			max = std::max(max, Key(&line, helper));
+		return KeyWidth(max, c, helper);
+	}
+
+	void UpdateWidth(const agi::Context *c, WidthHelper &helper) override {
+		// Building the index is only worth it once single lines are changed,
+		// so just drop it and find the widest line the quick way
+		index_valid = false;
+		line_keys.clear();
+		key_counts.clear();
+		GridColumn::UpdateWidth(c, helper);
+	}
+
+	void UpdateWidth(const agi::Context *c, WidthHelper &helper, const AssDialogue *line) override {
+		if (!visible) {
+			width = 0;
+			return;
+		}
+
+		if (!line) {
+			// Nothing which affects the width changed
+			if (!index_valid) return;
+		}
+		else if (!index_valid) {
+			for (AssDialogue const& event : c->ass->Events) {
+				int64_t key = Key(&event, helper);
+				line_keys[event.Id] = key;
+				++key_counts[key];
+			}
+			index_valid = true;
+		}
+		else {
+			auto it = line_keys.find(line->Id);
+			if (it != line_keys.end()) {
+				auto count = key_counts.find(it->second);
+				if (--count->second == 0)
+					key_counts.erase(count);
+			}
+			int64_t key = Key(line, helper);
+			line_keys[line->Id] = key;
+			++key_counts[key];
+		}
+
+		int64_t max = key_counts.empty() ? 0 : std::max<int64_t>(0, key_counts.rbegin()->first);
+		SetWidth(KeyWidth(max, c, helper), helper);
+	}
+};
+
 struct GridColumnLineNumber final : GridColumn {
 	COLUMN_HEADER(_("#"))
 	COLUMN_DESCRIPTION(_("Line Number"))
@@ -111,21 +212,14 @@ struct GridColumnLineNumber final : GridColumn {
 		return std::to_wstring(d->Row + 1);
 	}
 
+	// Rows only change in commits, which clear the cache
+	bool CacheValue() const override { return true; }
+
 	int Width(const agi::Context *c, WidthHelper &helper) const override {
 		return helper(Value(&c->ass->Events.back()));
 	}
 };
 
-template<typename T>
-T max_value(T AssDialogueBase::*field, EntryList<AssDialogue> const& lines) {
-	T value = 0;
-	for (AssDialogue const& line : lines) {
-		if (line.*field > value)
-			value = line.*field;
-	}
-	return value;
-}
-
 struct GridColumnFolds final : GridColumn {
 	COLUMN_HEADER(_(" >"))
 	COLUMN_DESCRIPTION(_("Folds"))
@@ -171,7 +265,7 @@ struct GridColumnFolds final : GridColumn {
 	}
 };
 
-struct GridColumnLayer final : GridColumn {
+struct GridColumnLayer final : GridColumnWidest {
 	COLUMN_HEADER(_("L"))
 	COLUMN_DESCRIPTION(_("Layer"))
 	bool Centered() const override { return true; }
@@ -180,17 +274,25 @@ struct GridColumnLayer final : GridColumn {
 		return d->Layer ? wxString(std::to_wstring(d->Layer)) : wxString();
 	}
 
-	int Width(const agi::Context *c, WidthHelper &helper) const override {
-		int max_layer = max_value(&AssDialogue::Layer, c->ass->Events);
-		return max_layer == 0 ? 0 : helper(std::to_wstring(max_layer));
+	bool CacheValue() const override { return true; }
+
+	int64_t Key(const AssDialogue *d, WidthHelper &) const override {
+		return d->Layer;
+	}
+
+	int KeyWidth(int64_t max_layer, const agi::Context *, WidthHelper &helper) const override {
+		return max_layer <= 0 ? 0 : helper(std::to_wstring(max_layer));
 	}
 };
 
-struct GridColumnTime : GridColumn {
+struct GridColumnTime : GridColumnWidest {
 	bool by_frame = false;
 
 	bool Centered() const override { return true; }
 	void SetByFrame(bool by_frame) override { this->by_frame = by_frame; }
+
+	// Frame numbers depend on the timecodes, which can change at any time
+	bool CacheValue() const override { return !by_frame; }
 };
 
 struct GridColumnStartTime final : GridColumnTime {
@@ -203,8 +305,12 @@ struct GridColumnStartTime final : GridColumnTime {
 		return to_wx(d->Start.GetAssFormatted());
 	}
 
-	int Width(const agi::Context *c, WidthHelper &helper) const override {
-		agi::Time max_time = max_value(&AssDialogue::Start, c->ass->Events);
+	int64_t Key(const AssDialogue *d, WidthHelper &) const override {
+		return static_cast<int>(d->Start);
+	}
+
+	int KeyWidth(int64_t key, const agi::Context *c, WidthHelper &helper) const override {
+		agi::Time max_time(static_cast<int>(key));
 		std::string value = by_frame ? std::to_string(c->videoController->FrameAtTime(max_time, agi::vfr::START)) : max_time.GetAssFormatted();
 
 		for (char &c : value) {
@@ -226,8 +332,12 @@ struct GridColumnEndTime final : GridColumnTime {
 		return to_wx(d->End.GetAssFormatted());
 	}
 
-	int Width(const agi::Context *c, WidthHelper &helper) const override {
-		agi::Time max_time = max_value(&AssDialogue::End, c->ass->Events);
+	int64_t Key(const AssDialogue *d, WidthHelper &) const override {
+		return static_cast<int>(d->End);
+	}
+
+	int KeyWidth(int64_t key, const agi::Context *c, WidthHelper &helper) const override {
+		agi::Time max_time(static_cast<int>(key));
 		std::string value = by_frame ? std::to_string(c->videoController->FrameAtTime(max_time, agi::vfr::END)) : max_time.GetAssFormatted();
 
 		for (char &c : value) {
@@ -239,20 +349,7 @@ struct GridColumnEndTime final : GridColumnTime {
 	}
 };
 
-template<typename T>
-int max_width(T AssDialogueBase::*field, EntryList<AssDialogue> const& lines, WidthHelper &helper) {
-	int w = 0;
-	for (AssDialogue const& line : lines) {
-		auto const& v = line.*field;
-		if (v.get().empty()) continue;
-		int width = helper(v);
-		if (width > w)
-			w = width;
-	}
-	return w;
-}
-
-struct GridColumnStyle final : GridColumn {
+struct GridColumnStyle final : GridColumnWidest {
 	COLUMN_HEADER(_("Style"))
 	COLUMN_DESCRIPTION(_("Style"))
 	bool Centered() const override { return false; }
@@ -261,12 +358,18 @@ struct GridColumnStyle final : GridColumn {
 		return to_wx(d->Style);
 	}
 
-	int Width(const agi::Context *c, WidthHelper &helper) const override {
-		return max_width(&AssDialogue::Style, c->ass->Events, helper);
+	bool CacheValue() const override { return true; }
+
+	int64_t Key(const AssDialogue *d, WidthHelper &helper) const override {
+		return helper(d->Style);
+	}
+
+	int KeyWidth(int64_t width, const agi::Context *, WidthHelper &) const override {
+		return static_cast<int>(width);
 	}
 };
 
-struct GridColumnEffect final : GridColumn {
+struct GridColumnEffect final : GridColumnWidest {
 	COLUMN_HEADER(_("Effect"))
 	COLUMN_DESCRIPTION(_("Effect"))
 	bool Centered() const override { return false; }
@@ -275,12 +378,18 @@ struct GridColumnEffect final : GridColumn {
 		return to_wx(d->Effect);
 	}
 
-	int Width(const agi::Context *c, WidthHelper &helper) const override {
-		return max_width(&AssDialogue::Effect, c->ass->Events, helper);
+	bool CacheValue() const override { return true; }
+
+	int64_t Key(const AssDialogue *d, WidthHelper &helper) const override {
+		return helper(d->Effect);
+	}
+
+	int KeyWidth(int64_t width, const agi::Context *, WidthHelper &) const override {
+		return static_cast<int>(width);
 	}
 };
 
-struct GridColumnActor final : GridColumn {
+struct GridColumnActor final : GridColumnWidest {
 	COLUMN_HEADER(_("Actor"))
 	COLUMN_DESCRIPTION(_("Actor"))
 	bool Centered() const override { return false; }
@@ -289,12 +398,18 @@ struct GridColumnActor final : GridColumn {
 		return to_wx(d->Actor);
 	}
 
-	int Width(const agi::Context *c, WidthHelper &helper) const override {
-		return max_width(&AssDialogue::Actor, c->ass->Events, helper);
+	bool CacheValue() const override { return true; }
+
+	int64_t Key(const AssDialogue *d, WidthHelper &helper) const override {
+		return helper(d->Actor);
+	}
+
+	int KeyWidth(int64_t width, const agi::Context *, WidthHelper &) const override {
+		return static_cast<int>(width);
 	}
 };
 
-struct GridColumnMargin : GridColumn {
+struct GridColumnMargin : GridColumnWidest {
 	int index;
 	GridColumnMargin(int index) : index(index) { }
 
@@ -304,13 +419,14 @@ struct GridColumnMargin : GridColumn {
 		return d->Margin[index] ? wxString(std::to_wstring(d->Margin[index])) : wxString();
 	}
 
-	int Width(const agi::Context *c, WidthHelper &helper) const override {
-		int max = 0;
-		for (AssDialogue const& line : c->ass->Events) {
-			if (line.Margin[index] > max)
-				max = line.Margin[index];
-		}
-		return max == 0 ? 0 : helper(std::to_wstring(max));
+	bool CacheValue() const override { return true; }
+
+	int64_t Key(const AssDialogue *d, WidthHelper &) const override {
+		return d->Margin[index];
+	}
+
+	int KeyWidth(int64_t max, const agi::Context *, WidthHelper &helper) const override {
+		return max <= 0 ? 0 : helper(std::to_wstring(max));
 	}
 };
 
@@ -346,6 +462,30 @@ class GridColumnCPS final : public GridColumn {
 	const agi::OptionValue *cps_error = OPT_GET("Subtitle/Character Counter/CPS Error Threshold");
 	const agi::OptionValue *bg_color = OPT_GET("Colour/Subtitle Grid/CPS Error");
 
+	struct CachedCount {
+		agi::Interned<std::string> text;
+		int ignore;
+		size_t count;
+	};
+	/// Character counts of the lines painted so far, by line ID
+	mutable std::unordered_map<int, CachedCount> counts;
+
+	size_t CharacterCount(const AssDialogue *d, int ignore) const {
+		auto it = counts.find(d->Id);
+		if (it != counts.end() && it->second.text == d->Text && it->second.ignore == ignore)
+			return it->second.count;
+
+		size_t count = agi::CharacterCount(d->Text.get(), ignore);
+		if (it != counts.end())
+			it->second = CachedCount{d->Text, ignore, count};
+		else {
+			if (counts.size() > 8192)
+				counts.clear();
+			counts.emplace(d->Id, CachedCount{d->Text, ignore, count});
+		}
+		return count;
+	}
+
 public:
 	COLUMN_HEADER(_("CPS"))
 	COLUMN_DESCRIPTION(_("Characters Per Second"))
@@ -369,7 +509,7 @@ public:
 		if (ignore_punctuation->GetBool())
 			ignore |= agi::IGNORE_PUNCTUATION;
 
-		return agi::CharacterCount(text, ignore) * 1000 / duration;
+		return CharacterCount(d, ignore) * 1000 / duration;
 	}
 
 	int Width(const agi::Context *c, WidthHelper &helper) const override {
@@ -400,6 +540,54 @@ public:
 	}
 };
 
+struct GridColumnSpelling final : GridColumn {
+	COLUMN_HEADER(_("Spell"))
+	COLUMN_DESCRIPTION(_("Spelling Errors"))
+	bool Centered() const override { return true; }
+
+	wxString Value(const AssDialogue *d, const agi::Context *c) const override {
+		int errors = c->spelling->Errors(d);
+		return errors > 0 ? wxString(std::to_wstring(errors)) : wxString();
+	}
+
+	int Width(const agi::Context *c, WidthHelper &helper) const override {
+		int max_errors = 0;
+		for (AssDialogue const& line : c->ass->Events)
+			max_errors = std::max(max_errors, c->spelling->Errors(&line));
+		return max_errors == 0 ? 0 : helper(std::to_wstring(max_errors));
+	}
+};
+
+struct GridColumnRenderTime final : GridColumn {
+	COLUMN_HEADER(_("ms"))
+	COLUMN_DESCRIPTION(_("Render Time"))
+	bool Centered() const override { return true; }
+
+	wxString Value(const AssDialogue *d, const agi::Context *c) const override {
+		double cost = c->renderProfile->Cost(d);
+		return cost >= 0 ? fmt_wx("%.1f", cost) : wxString();
+	}
+
+	int Width(const agi::Context *c, WidthHelper &helper) const override {
+		auto lines = c->renderProfile->Lines();
+		return lines.empty() ? 0 : helper(fmt_wx("%.1f", lines.front().second));
+	}
+};
+
+struct GridColumnCollisions final : GridColumn {
+	COLUMN_HEADER(_("Coll"))
+	COLUMN_DESCRIPTION(_("Collisions"))
+	bool Centered() const override { return true; }
+
+	wxString Value(const AssDialogue *d, const agi::Context *c) const override {
+		return c->collisions->Collides(d) ? wxS("*") : wxString();
+	}
+
+	int Width(const agi::Context *c, WidthHelper &helper) const override {
+		return c->collisions->Count() ? helper(wxS("*")) : 0;
+	}
+};
+
 class GridColumnText final : public GridColumn {
 	const agi::OptionValue *override_mode;
 	wxString replace_char;
@@ -411,7 +599,7 @@ public:
 	: override_mode(OPT_GET("Subtitle/Grid/Hide Overrides"))
 	, replace_char(to_wx(OPT_GET("Subtitle/Grid/Hide Overrides Char")->GetString()))
 	, replace_char_connection(OPT_SUB("Subtitle/Grid/Hide Overrides Char",
-		[&](agi::OptionValue const& v) { replace_char = to_wx(v.GetString()); }))
+		[&](agi::OptionValue const& v) { replace_char = to_wx(v.GetString()); ClearCache(); }))
 	{
 	}
 
@@ -450,6 +638,10 @@ public:
 		return str;
 	}
 
+	// The override mode is also an input, but the grid clears every column's
+	// cache when it changes
+	bool CacheValue() const override { return true; }
+
 	int Width(const agi::Context *c, WidthHelper &helper) const override {
 		return 5000;
 	}
@@ -476,6 +668,9 @@ std::vector<std::unique_ptr<GridColumn>> GetGridColumns() {
 	ret.push_back(make<GridColumnMarginLeft>());
 	ret.push_back(make<GridColumnMarginRight>());
 	ret.push_back(make<GridColumnMarginVert>());
+	ret.push_back(make<GridColumnSpelling>());
+	ret.push_back(make<GridColumnRenderTime>());
+	ret.push_back(make<GridColumnCollisions>());
 	ret.push_back(make<GridColumnText>());
 	return ret;
 }
@@ -14,8 +14,10 @@
 //
 // Aegisub Project http://www.aegisub.org/
 
-#include "flyweight_hash.h"
+#include <libaegisub/interned.h>
+
 #include "wx/event.h"
+#include "wx/string.h"
 
 #include <memory>
 #include <string>
@@ -34,7 +36,7 @@ class WidthHelper {
 	};
 	int age = 0;
 	wxDC *dc = nullptr;
-	std::unordered_map<boost::flyweight<std::string>, Entry> widths;
+	std::unordered_map<agi::Interned<std::string>, Entry> widths;
 #ifdef _WIN32
 	wxString scratch;
 #endif
@@ -44,7 +46,7 @@ public:
 	void Age();
 	void ClearCache() { widths.clear(); };
 
-	int operator()(boost::flyweight<std::string> const& str);
+	int operator()(agi::Interned<std::string> const& str);
 	int operator()(std::string const& str);
 	int operator()(wxString const& str);
 	int operator()(const char *str);
@@ -52,6 +54,13 @@ public:
 };
 
 class GridColumn {
+	struct CachedValue {
+		wxString str;
+		int extent; ///< Width of str, if the column is centered
+	};
+	/// Formatted values of the lines painted so far, by line ID
+	mutable std::unordered_map<int, CachedValue> value_cache;
+
 protected:
 	int width = 0;
 	bool visible = true;
@@ -59,6 +68,14 @@ protected:
 	virtual int Width(const agi::Context *c, WidthHelper &helper) const = 0;
 	virtual wxString Value(const AssDialogue *d, const agi::Context *c) const = 0;
 
+	/// Does Value depend on nothing but the line itself, so that it can be
+	/// reused until the line is next changed?
+	virtual bool CacheValue() const { return false; }
+
+	/// Set the width from the width of the widest value, adding padding and
+	/// making room for the header
+	void SetWidth(int content_width, WidthHelper &helper);
+
 public:
 	virtual ~GridColumn() = default;
 
@@ -77,8 +94,16 @@ public:
 	bool Visible() const { return visible; }
 
 	virtual void UpdateWidth(const agi::Context *c, WidthHelper &helper);
+	/// Update the width after a change to just the given line, or after the
+	/// lines were only reordered or folded if it's null
+	virtual void UpdateWidth(const agi::Context *c, WidthHelper &helper, const AssDialogue *) { UpdateWidth(c, helper); }
 	virtual void SetByFrame(bool /* by_frame */) { }
 	void SetVisible(bool new_value) { visible = new_value; }
+
+	/// Discard the cached values of all lines
+	void ClearCache() { value_cache.clear(); }
+	/// Discard the cached value of a line which has changed
+	void ClearCache(const AssDialogue *d);
 };
 
 std::vector<std::unique_ptr<GridColumn>> GetGridColumns();
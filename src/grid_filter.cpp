@@ -0,0 +1,168 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include "grid_filter.h"
+
+#include "ass_dialogue.h"
+#include "ass_file.h"
+#include "fold_controller.h"
+#include "include/aegisub/context.h"
+#include "selection_controller.h"
+
+#include <libaegisub/dispatch.h>
+#include <libaegisub/trace.h>
+
+#include <algorithm>
+
+namespace {
+/// Number of lines checked by each worker when checking every line
+const size_t lines_per_chunk = 1000;
+
+bool meets_all(std::vector<std::function<bool (AssDialogue const&)>> const& predicates, AssDialogue const& line) {
+	for (auto const& predicate : predicates) {
+		if (!predicate(line))
+			return false;
+	}
+	return true;
+}
+}
+
+GridFilter::GridFilter(agi::Context *c)
+: context(c)
+, active_line_listener(c->selectionController->AddActiveLineListener(&GridFilter::OnActiveLineChanged, this))
+{
+}
+
+std::vector<GridFilter::Predicate> GridFilter::Compile() const {
+	std::vector<Predicate> compiled;
+	compiled.reserve(conditions.size());
+	for (auto const& cond : conditions) {
+		Predicate test;
+		switch (cond.type) {
+			case GridFilterCondition::Type::FIELD:
+				test = [matches = SearchReplaceEngine::GetMatcher(cond.search)](AssDialogue const& line) {
+					return bool(matches(&line, 0));
+				};
+				break;
+			case GridFilterCondition::Type::LAYER:
+				test = [min = cond.min, max = cond.max](AssDialogue const& line) {
+					return line.Layer >= min && line.Layer <= max;
+				};
+				break;
+			case GridFilterCondition::Type::TIME:
+				test = [min = cond.min, max = cond.max](AssDialogue const& line) {
+					return int(line.Start) < max && int(line.End) > min;
+				};
+				break;
+		}
+
+		const bool invert = cond.invert, dialogue = cond.dialogue, comments = cond.comments;
+		compiled.push_back([=](AssDialogue const& line) {
+			if (line.Comment ? !comments : !dialogue) return false;
+			return invert != test(line);
+		});
+	}
+	return compiled;
+}
+
+bool GridFilter::IsHidden(AssDialogue const& line) const {
+	return !hidden.empty() && line.Id != active_id && hidden.count(line.Id);
+}
+
+void GridFilter::OnActiveLineChanged(AssDialogue *new_active) {
+	const int old_id = active_id;
+	active_id = new_active ? new_active->Id : -1;
+	if (hidden.count(old_id) || hidden.count(active_id))
+		Announce();
+}
+
+void GridFilter::UpdateAll() {
+	AGI_TRACE_ZONE("filter", "GridFilter");
+	std::vector<const AssDialogue *> lines;
+	for (auto const& line : context->ass->Events)
+		lines.push_back(&line);
+
+	std::vector<char> shown(lines.size());
+	const size_t chunks = (lines.size() + lines_per_chunk - 1) / lines_per_chunk;
+	agi::dispatch::Parallel(chunks, [&](size_t chunk) {
+		const auto chunk_predicates = Compile();
+		const size_t end = std::min(lines.size(), (chunk + 1) * lines_per_chunk);
+		for (size_t i = chunk * lines_per_chunk; i < end; ++i)
+			shown[i] = meets_all(chunk_predicates, *lines[i]);
+	});
+
+	std::unordered_set<int> new_hidden;
+	for (size_t i = 0; i < lines.size(); ++i) {
+		if (!shown[i])
+			new_hidden.insert(lines[i]->Id);
+	}
+
+	changed = new_hidden != hidden;
+	hidden = std::move(new_hidden);
+}
+
+void GridFilter::Announce() {
+	context->foldController->UpdateVisibility();
+	Changed();
+}
+
+void GridFilter::Add(GridFilterCondition const& condition) {
+	conditions.push_back(condition);
+	try {
+		predicates = Compile();
+	}
+	catch (...) {
+		conditions.pop_back();
+		throw;
+	}
+
+	UpdateAll();
+	Announce();
+}
+
+void GridFilter::Clear() {
+	if (conditions.empty()) return;
+	conditions.clear();
+	predicates.clear();
+	hidden.clear();
+	Announce();
+}
+
+bool GridFilter::OnPreCommit(int type, const AssDialogue *single_line) {
+	changed = false;
+	if (conditions.empty())
+		return false;
+
+	// A different file was opened, which the conditions weren't written for
+	if (type == AssFile::COMMIT_NEW) {
+		conditions.clear();
+		predicates.clear();
+		hidden.clear();
+		return changed = true;
+	}
+
+	if (!(type & (AssFile::COMMIT_DIAG_ADDREM | AssFile::COMMIT_DIAG_FULL)))
+		return false;
+
+	if (single_line && !(type & AssFile::COMMIT_DIAG_ADDREM)) {
+		if (meets_all(predicates, *single_line))
+			changed = hidden.erase(single_line->Id) > 0;
+		else
+			changed = hidden.insert(single_line->Id).second;
+	}
+	else
+		UpdateAll();
+	return changed;
+}
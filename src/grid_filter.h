@@ -0,0 +1,115 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file grid_filter.h
+/// @brief Conditions limiting which lines the subtitle grid shows
+
+#pragma once
+
+#include "search_replace_engine.h"
+
+#include <libaegisub/signal.h>
+
+#include <functional>
+#include <unordered_set>
+#include <vector>
+
+class AssDialogue;
+namespace agi { struct Context; }
+
+/// A condition which lines have to meet to be shown in the grid
+struct GridFilterCondition {
+	enum class Type {
+		/// The field described by search matches it
+		FIELD,
+		/// The layer is between min and max, inclusive
+		LAYER,
+		/// The line is displayed at some point between min and max in ms
+		TIME
+	};
+
+	Type type = Type::FIELD;
+	SearchReplaceSettings search;
+	int min = 0;
+	int max = 0;
+	/// Show the lines which don't meet the condition instead
+	bool invert = false;
+	/// Can uncommented lines meet the condition?
+	bool dialogue = true;
+	/// Can commented lines meet the condition?
+	bool comments = true;
+};
+
+/// @class GridFilter
+/// @brief Which lines are hidden from the grid for not meeting the conditions
+///
+/// Each condition is compiled into a predicate once, and the whole file is
+/// checked in parallel when the conditions change or many lines were
+/// committed at once. Commits of a single line only check that line again.
+/// The hidden lines are then skipped by the FoldController when it works
+/// out which lines are visible. The active line is always shown, so that a
+/// line doesn't vanish while it's being edited and the grid never ends up
+/// with no rows at all.
+class GridFilter {
+	typedef std::function<bool (AssDialogue const&)> Predicate;
+
+	agi::Context *context;
+	std::vector<GridFilterCondition> conditions;
+	/// Compiled conditions for checking single lines. The matchers aren't
+	/// thread-safe, so each worker compiles its own when checking every line.
+	std::vector<Predicate> predicates;
+	/// IDs of the lines which don't meet all of the conditions
+	std::unordered_set<int> hidden;
+	/// ID of the active line, which is shown even if it doesn't meet the conditions
+	int active_id = -1;
+	/// Did the last commit change which lines are hidden?
+	bool changed = false;
+
+	agi::signal::Signal<> Changed;
+	agi::signal::Connection active_line_listener;
+
+	std::vector<Predicate> Compile() const;
+	/// Check every line of the file
+	void UpdateAll();
+	/// Let the rest of the program know about new conditions
+	void Announce();
+	void OnActiveLineChanged(AssDialogue *new_active);
+
+public:
+	GridFilter(agi::Context *c);
+
+	/// Are any lines filtered out?
+	bool IsActive() const { return !conditions.empty(); }
+	/// Is the line hidden by the filter? Never true for the active line.
+	bool IsHidden(AssDialogue const& line) const;
+	/// Number of lines hidden by the filter
+	size_t HiddenCount() const { return hidden.size(); }
+
+	/// Only show the lines which also meet a new condition
+	/// Throws if the condition's search is an invalid regular expression
+	void Add(GridFilterCondition const& condition);
+	/// Show every line again
+	void Clear();
+
+	/// Check the lines touched by a commit again. Called by the
+	/// FoldController before the commit is announced so that the visible
+	/// lines can be linked up in the same pass as the folds.
+	/// @return Did which lines are hidden change?
+	bool OnPreCommit(int type, const AssDialogue *single_line);
+	/// Did the last commit change which lines are hidden?
+	bool ChangedByLastCommit() const { return changed; }
+
+	DEFINE_SIGNAL_ADDERS(Changed, AddChangeListener)
+};
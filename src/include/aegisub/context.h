@@ -17,17 +17,23 @@
 #include <memory>
 
 class AssFile;
+class ActorIndex;
 class AudioBox;
 class AudioController;
 class AssDialogue;
 class AudioKaraoke;
+class CollisionIndex;
 class DialogManager;
+class FieldIndex;
 class FrameMain;
 class Project;
+class RenderProfile;
 class SearchReplaceEngine;
 class InitialLineState;
 class SelectionController;
+class SpellingIndex;
 class FoldController;
+class GridFilter;
 class SubsController;
 class SubsEditBox;
 class BaseGrid;
@@ -50,10 +56,16 @@ struct Context {
 	std::unique_ptr<Automation4::ScriptManager> local_scripts;
 	std::unique_ptr<SelectionController> selectionController;
 	std::unique_ptr<FoldController> foldController;
+	std::unique_ptr<GridFilter> gridFilter;
 	std::unique_ptr<VideoController> videoController;
 	std::unique_ptr<AudioController> audioController;
 	std::unique_ptr<InitialLineState> initialLineState;
 	std::unique_ptr<SearchReplaceEngine> search;
+	std::unique_ptr<SpellingIndex> spelling;
+	std::unique_ptr<ActorIndex> actors;
+	std::unique_ptr<CollisionIndex> collisions;
+	std::unique_ptr<FieldIndex> effects;
+	std::unique_ptr<RenderProfile> renderProfile;
 	std::unique_ptr<Path> path;
 
 	// Things that should probably be in some sort of UI-context-model
@@ -34,23 +34,78 @@
 
 #pragma once
 
+#include <libaegisub/interned.h>
+#include <functional>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
-class AssFile;
+class AssAttachment;
+class AssDialogue;
+class AssSnapshot;
+struct SubtitlesOverlay;
 struct VideoFrame;
 
 class SubtitlesProvider {
 	std::vector<char> buffer;
+	/// Font attachments sent with the last load, if KeepsEmbeddedFonts()
+	std::vector<agi::Interned<std::string>> loaded_fonts;
+	/// Header which known_styles was last checked against
+	std::shared_ptr<const void> styles_header;
+	/// Names of the styles which known_styles was built for
+	std::vector<std::string> style_names;
+	/// Whether each style name used by a line loaded since the styles last
+	/// changed names one of the file's styles
+	std::unordered_map<agi::Interned<std::string>, bool> known_styles;
+	bool IsKnownStyle(AssSnapshot const& subs, agi::Interned<std::string> const& style);
 	virtual void LoadSubtitles(const char *data, size_t len)=0;
-	virtual void PrepareSubtitles(AssFile *, int) { }
+	virtual void PrepareSubtitles(AssSnapshot const&, int) { }
+	/// Do embedded fonts stay available after loading different subtitles?
+	/// If so, fonts are only sent when the attachments have changed.
+	virtual bool KeepsEmbeddedFonts() const { return false; }
+	/// Hand an embedded font directly to the renderer rather than sending it
+	/// uuencoded as part of the script, which the renderer would then have to
+	/// find and decode again
+	/// @return false if the font should be sent with the script instead
+	virtual bool AddEmbeddedFont(AssAttachment const&) { return false; }
 
 public:
 	virtual ~SubtitlesProvider() = default;
-	void LoadSubtitles(AssFile *subs, int time = -1);
+	/// @brief Load subtitles to render
+	/// @param subs Subtitles to load
+	/// @param time If not -1, load only the lines visible at this time, with
+	///             any missing styles replaced by Default
+	void LoadSubtitles(AssSnapshot const& subs, int time = -1);
 	virtual void DrawSubtitles(VideoFrame &dst, double time)=0;
+
+	/// @brief Replace a single event of the loaded subtitles
+	/// @param index Index of the event among the non-comment lines of the
+	///              file; only valid if the entire file was loaded
+	/// @param line  New version of the line
+	/// @return false if the subtitles need to be reloaded instead
+	virtual bool UpdateEvent(size_t index, AssDialogue const& line) { return false; }
+
+	/// Does this provider implement DrawOverlay()?
+	virtual bool CanDrawOverlay() const { return false; }
+
+	/// @brief Render the subtitles onto a transparent overlay rather than a frame
+	/// @param dst    Overlay to render into
+	/// @param width  Width of the video frame the overlay will be drawn on
+	/// @param height Height of the video frame the overlay will be drawn on
+	/// @param time   Time in seconds
+	/// @return false if the renderer determined that the subtitles look
+	///         exactly the same as in the overlay from the previous call, in
+	///         which case dst has not been touched
+	virtual bool DrawOverlay(SubtitlesOverlay &dst, int width, int height, double time) { return true; }
 	virtual void Reinitialize() { }
+
+	/// @brief Turn off reusing work from earlier renders
+	///
+	/// While profiling, each render should cost what it would the first time
+	/// the lines are drawn, so renderers which cache glyphs or bitmaps between
+	/// frames should keep as little cached as possible.
+	virtual void SetProfiling(bool /* profiling */) { }
 };
 
 namespace agi { class BackgroundRunner; }
@@ -58,4 +113,11 @@ namespace agi { class BackgroundRunner; }
 struct SubtitlesProviderFactory {
 	static std::unique_ptr<SubtitlesProvider> GetProvider(agi::BackgroundRunner *br);
 	static std::vector<std::string> GetClasses();
+	/// Start discovering the available providers on a background thread
+	static void Preload();
+	/// Call a function on the main thread once the preferred provider has
+	/// finished scanning the installed fonts at startup, after which creating
+	/// a provider won't have to wait for it
+	/// @return false without calling it if there's nothing to wait for
+	static bool WhenFontsReady(std::function<void ()> callback);
 };
@@ -37,10 +37,25 @@
 #include <libaegisub/exception.h>
 #include <libaegisub/vfr.h>
 
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
 
+struct PlanarFrame;
 struct VideoFrame;
 
+/// Usage counters of a video frame cache
+struct VideoFrameCacheStats {
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t evictions = 0;
+	/// Number of frames currently cached
+	size_t frames = 0;
+	/// Size of the cached frame data in bytes
+	size_t bytes = 0;
+};
+
 /// Color matrix constants matching the constants in ffmpeg
 /// (specifically libavutil's AVColorSpace) and/or H.273.
 typedef enum AGI_ColorSpaces {
@@ -80,6 +95,14 @@ void override_colormatrix(int &CS, int &CR, std::string matrix, int Width, int H
 
 }
 
+/// Size of one dimension of a frame decoded with SetProxyScale(divisor)
+inline int ProxyDimension(int size, int divisor) {
+	if (divisor <= 1) return size;
+	// Keep it even for the sake of chroma subsampled scalers
+	const int scaled = (size / divisor) & ~1;
+	return scaled < 2 ? 2 : scaled;
+}
+
 class VideoProvider {
 public:
 	virtual ~VideoProvider() = default;
@@ -87,6 +110,93 @@ public:
 	/// Override this method to actually get frames
 	virtual void GetFrame(int n, VideoFrame &frame)=0;
 
+	/// @brief Get a frame which may be shared with the provider's cache
+	/// @param buffer Unused frame to decode into if the frame isn't cached
+	///
+	/// Unlike GetFrame() this doesn't need to copy cached frames, but the
+	/// result may be kept by the cache and so can't be drawn onto.
+	virtual std::shared_ptr<const VideoFrame> GetSharedFrame(int n, std::shared_ptr<VideoFrame> buffer) {
+		GetFrame(n, *buffer);
+		return buffer;
+	}
+
+	/// @brief Decode a frame without converting it to BGRA
+	/// @return false if this provider only produces BGRA frames
+	///
+	/// The frame cache stores frames in this much more compact form when
+	/// possible, and converts them with ConvertFrame() when they're needed.
+	virtual bool GetPlanarFrame(int n, PlanarFrame &frame) { return false; }
+
+	/// Convert a frame from GetPlanarFrame() to BGRA with the current matrix
+	virtual void ConvertFrame(PlanarFrame const& src, VideoFrame &dst) { }
+
+	/// @brief Decode a frame of a high bit depth video as 16-bit YUV
+	/// @return false if the video isn't more than 8 bits per sample or the
+	///         provider can't do this
+	///
+	/// The frame is in VideoFrame::Format::YUV420P16, tagged with the
+	/// current matrix, for the video display to convert to RGB and tone
+	/// map. It isn't cached.
+	virtual bool GetHighDepthFrame(int n, VideoFrame &frame) { return false; }
+
+	/// @brief Get a frame without adding it to the frame cache
+	///
+	/// Used for reading through the whole video in the background, which
+	/// would otherwise push out the frames which are actually being viewed.
+	virtual void GetFrameUncached(int n, VideoFrame &frame) { GetFrame(n, frame); }
+
+	/// @brief Decode frame n ahead of it being requested
+	///
+	/// Only providers which cache frames do anything with this.
+	virtual void PrefetchFrame(int n) { }
+
+	/// @brief Decode frames at a reduced size from now on
+	/// @param divisor Amount to divide the width and height by, or 1 for
+	///                full size; see ProxyDimension() for the exact sizes
+	/// @return Whether the provider can do this; if not, frames stay full size
+	///
+	/// Used to keep up with scrubbing through large videos. Providers scale
+	/// in the same step as their conversion to BGRA, so this costs nothing
+	/// extra and saves on everything after decoding.
+	virtual bool SetProxyScale(int divisor) { return divisor == 1; }
+
+	/// @brief Open a second decoder for the same video, for random access
+	/// @return The new decoder, or null if this provider can't do that cheaply
+	///
+	/// The new decoder reuses whatever was indexed when opening this one and
+	/// has its own position in the video, so seeking with it leaves this
+	/// one where it was. It doesn't cache frames.
+	virtual std::unique_ptr<VideoProvider> OpenSeekDecoder() { return nullptr; }
+
+	/// @brief Set a function which says whether the frame being decoded is
+	///        still wanted
+	///
+	/// Providers which can give up on a decode part way through, such as a
+	/// long seek back to a distant keyframe, call it while they wait and
+	/// throw VideoDecodeCancelled once it returns true. It's only ever
+	/// called on the thread which is decoding.
+	virtual void SetInterruptCheck(std::function<bool ()> interrupted) { }
+
+	/// Get the number of frames which fit in the frame cache, if this
+	/// provider is one
+	virtual int GetCachedFrameLimit() const { return 0; }
+
+	/// @brief Give back memory held by cached frames
+	/// @param all Drop everything cached rather than just the older half
+	///
+	/// Used when the system is running low on memory.
+	virtual void TrimCache(bool all) { }
+
+	/// Get the size in bytes of the provider's own cache of decoded frames,
+	/// or 0 if it doesn't have one
+	virtual size_t GetInternalCacheSize() const { return 0; }
+
+	/// @brief Resize the provider's own cache of decoded frames
+	///
+	/// Used to give the frame cache a share of the memory the provider was
+	/// told to use, rather than holding the same frames twice on top of it.
+	virtual void SetInternalCacheSize(size_t) { }
+
 	/// Set the YCbCr matrix to the specified one
 	///
 	/// Providers are free to disregard this, and should if the requested
@@ -117,6 +227,9 @@ public:
 	/// @return Returns true if caching is desired, false otherwise.
 	virtual bool WantsCaching() const { return false; }
 
+	/// Get the usage counters of the frame cache, if this provider is one
+	virtual VideoFrameCacheStats GetCacheStats() const { return {}; }
+
 	/// Should the video properties in the script be set to this video's property if they already have values?
 	virtual bool ShouldSetVideoProperties() const { return true; }
 
@@ -132,3 +245,6 @@ DEFINE_EXCEPTION(VideoOpenError, VideoProviderError);
 
 /// Error of some sort occurred while decoding a frame
 DEFINE_EXCEPTION(VideoDecodeError, VideoProviderError);
+
+/// Decoding a frame was given up on because a newer one was requested
+DEFINE_EXCEPTION(VideoDecodeCancelled, agi::UserCancelException);
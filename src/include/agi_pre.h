@@ -97,7 +97,6 @@
 
 // Boost
 #include <boost/container/list.hpp>
-#include <boost/flyweight.hpp>
 #include <boost/io/ios_state.hpp>
 #include <boost/range/adaptor/filtered.hpp>
 #include <boost/range/adaptor/transformed.hpp>
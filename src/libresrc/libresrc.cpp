@@ -14,7 +14,9 @@
 
 #include "libresrc.h"
 
+#include <map>
 #include <string_view>
+#include <tuple>
 #include <unordered_map>
 
 #include <wx/bitmap.h>
@@ -57,6 +59,28 @@ BitmapResourceView GetDarkBitmap(std::string_view name) {
 	return {};
 }
 #endif
+
+/// Decoded bitmaps, as the same command icons are requested by every menu
+/// and toolbar which shows them. Only ever touched from the GUI thread.
+using BitmapKey = std::tuple<const unsigned char *, double, int>;
+std::map<BitmapKey, wxBitmap>& BitmapCache() {
+	static std::map<BitmapKey, wxBitmap> cache;
+	return cache;
+}
+
+wxBitmap DecodeImage(const unsigned char *data, size_t size, double scale, int dir) {
+	wxMemoryInputStream mem(data, size);
+	if (dir != wxLayout_RightToLeft)
+#if wxCHECK_VERSION(3, 1, 0)
+	// Since wxWidgets 3.1.0, there is an undocumented third parameter in the ctor of wxBitmap from wxImage
+	// This "scale" parameter sets the logical scale factor of the created wxBitmap
+		return wxBitmap(wxImage(mem), wxBITMAP_SCREEN_DEPTH, scale);
+	return wxBitmap(wxImage(mem).Mirror(), wxBITMAP_SCREEN_DEPTH, scale);
+#else
+		return wxBitmap(wxImage(mem));
+	return wxBitmap(wxImage(mem).Mirror());
+#endif
+}
 } // namespace
 
 void libresrc_set_dark_icons_enabled(bool enabled) {
@@ -79,17 +103,12 @@ wxBitmap libresrc_getimage([[maybe_unused]] const char *name, const unsigned cha
 	(void)name;
 #endif
 
-	wxMemoryInputStream mem(selected, selected_size);
-	if (dir != wxLayout_RightToLeft)
-#if wxCHECK_VERSION(3, 1, 0)
-	// Since wxWidgets 3.1.0, there is an undocumented third parameter in the ctor of wxBitmap from wxImage
-	// This "scale" parameter sets the logical scale factor of the created wxBitmap
-		return wxBitmap(wxImage(mem), wxBITMAP_SCREEN_DEPTH, scale);
-	return wxBitmap(wxImage(mem).Mirror(), wxBITMAP_SCREEN_DEPTH, scale);
-#else
-		return wxBitmap(wxImage(mem));
-	return wxBitmap(wxImage(mem).Mirror());
-#endif
+	// wxBitmap is reference counted and copy-on-write, so handing out copies
+	// of the cached bitmap is cheap and safe even if a caller modifies it
+	auto& cached = BitmapCache()[BitmapKey{selected, scale, dir}];
+	if (!cached.IsOk())
+		cached = DecodeImage(selected, selected_size, scale, dir);
+	return cached;
 }
 
 wxIcon libresrc_geticon(const unsigned char *buff, size_t size) {
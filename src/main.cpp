@@ -36,9 +36,11 @@
 
 #include "command/command.h"
 #include "include/aegisub/hotkey.h"
+#include "include/aegisub/subtitles_provider.h"
 
 #include "auto4_base.h"
 #include "auto4_lua_factory.h"
+#include "batch.h"
 #include "compat.h"
 #include "crash_writer.h"
 #include "dialogs.h"
@@ -48,8 +50,12 @@
 #include "frame_main.h"
 #include "include/aegisub/context.h"
 #include "libresrc/libresrc.h"
+#include "memory_governor.h"
 #include "options.h"
 #include "project.h"
+#include "render_frames.h"
+#include "stall_watchdog.h"
+#include "startup_log.h"
 #include "subs_controller.h"
 #include "subtitles_provider_libass.h"
 #include "subtitles_provider_libassmod.h"
@@ -57,12 +63,14 @@
 #include "value_event.h"
 #include "version.h"
 
+#include <libaegisub/derived_store.h>
 #include <libaegisub/dispatch.h>
 #include <libaegisub/format_path.h>
 #include <libaegisub/fs.h>
 #include <libaegisub/io.h>
 #include <libaegisub/log.h>
 #include <libaegisub/make_unique.h>
+#include <libaegisub/memory_usage.h>
 #include <libaegisub/path.h>
 #include <libaegisub/util.h>
 
@@ -78,6 +86,7 @@ namespace config {
 	agi::Options *opt = nullptr;
 	agi::MRUManager *mru = nullptr;
 	agi::Path *path = nullptr;
+	agi::DerivedStore *derived = nullptr;
 	Automation4::AutoloadScriptManager *global_scripts;
 }
 
@@ -88,7 +97,7 @@ static const char *LastStartupState = nullptr;
 #ifdef WITH_STARTUPLOG
 #define StartupLog(a) MessageBox(0, L ## a, L"Aegisub startup log", 0)
 #else
-#define StartupLog(a) LastStartupState = a
+#define StartupLog(a) (LastStartupState = a, startup_log::Phase("main/init", a))
 #endif
 
 void AegisubApp::OnAssertFailure(const wxChar *file, int line, const wxChar *func, const wxChar *cond, const wxChar *msg) {
@@ -227,6 +236,16 @@ bool AegisubApp::OnInit() {
 	}
 #endif
 
+	auto set_memory_budget = [] { agi::memory::SetBudget(OPT_GET("App/Memory Budget")->GetInt() << 20); };
+	set_memory_budget();
+	OPT_SUB("App/Memory Budget", set_memory_budget);
+
+	config::derived = new agi::DerivedStore(config::path->Decode("?local/derived"),
+		static_cast<uint64_t>(OPT_GET("App/Derived Data Cache Size")->GetInt()) << 20);
+	OPT_SUB("App/Derived Data Cache Size", [](agi::OptionValue const& opt) {
+		config::derived->SetMaxSize(static_cast<uint64_t>(opt.GetInt()) << 20);
+	});
+
 #if defined(__WXMSW__) && wxVERSION_NUMBER >= 3300
 	bool dark_mode = OPT_GET("App/Dark Mode")->GetBool();
 	libresrc_set_dark_icons_enabled(dark_mode);
@@ -287,9 +306,13 @@ bool AegisubApp::OnInit() {
 		exception_message = _("Oops, Aegisub has crashed!\n\nAn attempt has been made to save a copy of your file to:\n\n%s\n\nAegisub will now close.");
 
 		// Load plugins
+		StartupLog("Register Automation engines");
 		Automation4::ScriptFactory::Register(agi::make_unique<Automation4::LuaScriptFactory>());
+
+		StartupLog("Start font cache and subtitle provider discovery");
 		libass::CacheFonts();
 		libassmod::CacheFonts();
+		SubtitlesProviderFactory::Preload();
 
 		// Load Automation scripts
 		StartupLog("Load global Automation scripts");
@@ -303,6 +326,23 @@ bool AegisubApp::OnInit() {
 		StartupLog("Install PNG handler");
 		wxImage::AddHandler(new wxPNGHandler);
 
+		// Batch and render modes run from OnRun instead of the main loop,
+		// without ever creating a window
+		std::vector<std::string> cmdline;
+		for (auto const& arg : argv.GetArguments())
+			cmdline.push_back(from_wx(arg));
+		if (!cmdline.empty())
+			cmdline.erase(cmdline.begin());
+		if (batch::Requested(cmdline))
+			headless_run = batch::Run;
+		else if (render_frames::Requested(cmdline))
+			headless_run = render_frames::Run;
+		if (headless_run) {
+			headless_args = std::move(cmdline);
+			StartupLog("Initialization complete");
+			return true;
+		}
+
 		// Open main frame
 		StartupLog("Create main window");
 		NewProjectContext();
@@ -351,11 +391,18 @@ bool AegisubApp::OnInit() {
 	StartupLog("Clean old autosave files");
 	CleanCache(config::path->Decode(OPT_GET("Path/Auto/Save")->GetString()), "*.AUTOSAVE.ass", 100, 1000);
 
+	StartupLog("Start stall watchdog");
+	stall_watchdog::Start(config::path->Decode("?user/stalls"));
+	memory_governor::Start();
+
 	StartupLog("Initialization complete");
 	return true;
 }
 
 int AegisubApp::OnExit() {
+	memory_governor::Stop();
+	stall_watchdog::Stop();
+
 	for (auto frame : frames)
 		delete frame;
 	frames.clear();
@@ -367,6 +414,7 @@ int AegisubApp::OnExit() {
 
 	delete config::opt;
 	delete config::mru;
+	delete config::derived;
 	hotkey::clear();
 	cmd::clear();
 
@@ -470,6 +518,8 @@ int AegisubApp::OnRun() {
 	std::string error;
 
 	try {
+		if (headless_run)
+			return headless_run(headless_args);
 		return MainLoop();
 	}
 	catch (const std::exception &e) { error = std::string("std::exception: ") + e.what(); }
@@ -27,6 +27,8 @@
 //
 // Aegisub Project http://www.aegisub.org/
 
+#include <string>
+#include <vector>
 #include <wx/app.h>
 
 #include "aegisublocale.h"
@@ -58,6 +60,12 @@ class AegisubApp : public wxApp {
 	void OpenFiles(wxArrayStringsAdapter filenames);
 
 	std::vector<FrameMain *> frames;
+
+	/// Command line arguments when running in batch or render mode, or
+	/// empty to show the UI
+	std::vector<std::string> headless_args;
+	/// Entry point of the mode to run headless_args with
+	int (*headless_run)(std::vector<std::string> const&) = nullptr;
 public:
 	AegisubApp();
 	AegisubLocale locale;
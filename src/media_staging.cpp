@@ -0,0 +1,197 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+/// @file media_staging.cpp
+/// @brief Local copies of media files on network storage
+
+#include "media_staging.h"
+
+#include "options.h"
+
+#include <libaegisub/dispatch.h>
+#include <libaegisub/format.h>
+#include <libaegisub/fs.h>
+#include <libaegisub/io.h>
+#include <libaegisub/log.h>
+#include <libaegisub/path.h>
+
+#include <boost/filesystem/fstream.hpp>
+#include <istream>
+#include <set>
+#include <vector>
+#include <xxhash.h>
+
+namespace {
+/// Size of each read from the original file
+const size_t copy_block_size = 8 << 20;
+
+/// Copies are made one at a time, as ones made in parallel would just
+/// compete for the same network link
+agi::dispatch::Queue& staging_queue() {
+	static auto queue = agi::dispatch::Create(agi::dispatch::Priority::Bulk);
+	return *queue;
+}
+
+/// Local copies currently being made. Only used on the main thread.
+std::set<agi::fs::path>& in_progress() {
+	static std::set<agi::fs::path> files;
+	return files;
+}
+
+agi::signal::Signal<agi::fs::path const&>& staged_signal() {
+	static agi::signal::Signal<agi::fs::path const&> signal;
+	return signal;
+}
+
+/// Copy a file with large sequential reads, via a temporary file so that an
+/// interrupted copy is never mistaken for a complete one
+void copy_sequential(agi::fs::path const& from, agi::fs::path const& to) {
+	auto part = to;
+	part += ".part";
+	{
+		auto in = agi::io::Open(from, true);
+		boost::filesystem::ofstream out(part, std::ios::binary);
+		if (!out)
+			throw agi::fs::WriteDenied(part);
+
+		std::vector<char> buffer(copy_block_size);
+		while (*in) {
+			in->read(buffer.data(), buffer.size());
+			out.write(buffer.data(), in->gcount());
+		}
+		if (in->bad() || !out) {
+			out.close();
+			agi::fs::Remove(part);
+			throw agi::io::IOError("Failed to copy " + from.string());
+		}
+	}
+	agi::fs::Rename(part, to);
+}
+
+/// Delete the least recently used local copies until the rest fit in
+/// max_size bytes
+///
+/// Each copy is named "<key>-<original name>" and has a "<key>.used" marker
+/// whose modification time is when it was last opened. The copies
+/// themselves aren't touched as the index caches are keyed on their times.
+void trim_staging(agi::fs::path const& dir, uintmax_t max_size) {
+	// Left over from copies which were interrupted by Aegisub exiting
+	for (auto const& file : agi::fs::DirectoryIterator(dir, "*.part"))
+		agi::fs::Remove(dir/file);
+
+	struct entry {
+		time_t used;
+		std::string key;
+		uintmax_t size = 0;
+	};
+	std::vector<entry> entries;
+	uintmax_t total_size = 0;
+	for (auto const& marker : agi::fs::DirectoryIterator(dir, "*.used")) {
+		entry e{agi::fs::ModifiedTime(dir/marker), marker.substr(0, marker.size() - 5)};
+		for (auto const& file : agi::fs::DirectoryIterator(dir, e.key + "-*"))
+			e.size += agi::fs::Size(dir/file);
+		total_size += e.size;
+		entries.push_back(std::move(e));
+	}
+
+	sort(begin(entries), end(entries), [](entry const& a, entry const& b) {
+		return a.used < b.used;
+	});
+
+	for (auto const& e : entries) {
+		if (total_size <= max_size) break;
+		for (auto const& file : agi::fs::DirectoryIterator(dir, e.key + "-*"))
+			agi::fs::Remove(dir/file);
+		agi::fs::Remove(dir/(e.key + ".used"));
+		total_size -= e.size;
+		LOG_D("media_staging") << "dropped local copy " << e.key;
+	}
+}
+}
+
+agi::fs::path StagedMediaPath(agi::fs::path const& path) {
+	if (!OPT_GET("Provider/Staging/Enabled")->GetBool() || !agi::fs::IsNetworkPath(path))
+		return path;
+
+	uintmax_t size;
+	time_t mtime;
+	try {
+		size = agi::fs::Size(path);
+		mtime = agi::fs::ModifiedTime(path);
+	}
+	catch (agi::fs::FileSystemError const&) {
+		// Leave it to the provider to report whatever's wrong with the file
+		return path;
+	}
+
+	// The key changes if the original is modified, so outdated copies are
+	// never used and just age out of the cache
+	auto name = path.string();
+	XXH3_state_t *state = XXH3_createState();
+	XXH3_64bits_reset(state);
+	XXH3_64bits_update(state, name.data(), name.size());
+	XXH3_64bits_update(state, &size, sizeof(size));
+	XXH3_64bits_update(state, &mtime, sizeof(mtime));
+	auto key = agi::format("%016llx", (unsigned long long)XXH3_64bits_digest(state));
+	XXH3_freeState(state);
+
+	auto dir = config::path->Decode("?local/staging/");
+	// Keep the original name so that anything looking at the extension
+	// still sees the right one
+	auto local = dir/(key + "-" + path.filename().string());
+	auto marker = dir/(key + ".used");
+
+	if (agi::fs::FileExists(local)) {
+		try {
+			agi::fs::Touch(marker);
+		}
+		catch (agi::Exception const&) { }
+		return local;
+	}
+
+	const uintmax_t max_size = static_cast<uintmax_t>(OPT_GET("Provider/Staging/Max Size")->GetInt()) << 20;
+	if (size > max_size || !in_progress().insert(local).second)
+		return path;
+
+	LOG_D("media_staging") << "making local copy of " << path;
+	staging_queue().Async([=] {
+		bool copied = false;
+		try {
+			agi::fs::CreateDirectory(dir);
+			trim_staging(dir, max_size - size);
+			if (agi::fs::FreeSpace(dir) > size) {
+				copy_sequential(path, local);
+				agi::fs::Touch(marker);
+				copied = true;
+			}
+			else
+				LOG_D("media_staging") << "not enough free space to copy " << path;
+		}
+		catch (agi::Exception const& e) {
+			LOG_E("media_staging") << "failed to copy " << path << ": " << e.GetMessage();
+		}
+
+		agi::dispatch::Main().Async([=] {
+			in_progress().erase(local);
+			if (copied)
+				staged_signal()(path);
+		});
+	});
+
+	return path;
+}
+
+agi::signal::UnscopedConnection AddMediaStagedListener(std::function<void (agi::fs::path const&)> listener) {
+	return staged_signal().Connect(listener);
+}
@@ -0,0 +1,41 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+/// @file media_staging.h
+/// @brief Local copies of media files on network storage
+
+#pragma once
+
+#include <libaegisub/fs_fwd.h>
+#include <libaegisub/signal.h>
+
+#include <boost/filesystem/path.hpp>
+#include <functional>
+
+/// Get the file which providers should read the given media file from
+/// @param path Media file the user opened
+/// @return The local copy of path if there is a complete one, otherwise path
+///
+/// When Provider/Staging/Enabled is set and path is on network storage, this
+/// copies the file to local disk in the background with large sequential
+/// reads, which are much faster over a network than the random reads
+/// indexing and seeking make. The copy is only used once it's complete, so
+/// the file opened now is read over the network; the next open of it uses
+/// the local copy. Local copies are kept under Provider/Staging/Max Size,
+/// dropping the least recently used ones first.
+agi::fs::path StagedMediaPath(agi::fs::path const& path);
+
+/// Add a listener for local copies being completed, which is called on the
+/// main thread with the path of the original file
+agi::signal::UnscopedConnection AddMediaStagedListener(std::function<void (agi::fs::path const&)> listener);
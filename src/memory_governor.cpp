@@ -0,0 +1,89 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+/// @file memory_governor.cpp
+/// @brief Giving back cached memory when the system runs low
+/// @ingroup main
+
+#include "memory_governor.h"
+
+#include "options.h"
+
+#include <libaegisub/log.h>
+#include <libaegisub/make_unique.h>
+#include <libaegisub/memory_usage.h>
+
+#include <chrono>
+#include <memory>
+#include <wx/timer.h>
+
+namespace {
+using agi::memory::Pressure;
+using clock = std::chrono::steady_clock;
+
+/// How often the system's memory pressure is checked
+const int poll_interval_ms = 2000;
+/// How long to wait before trimming again while the pressure stays at the
+/// same level, so that the system has a chance to show whether it helped
+const auto retrim_interval = std::chrono::seconds(30);
+
+const char *describe(Pressure pressure) {
+	switch (pressure) {
+		case Pressure::None: return "none";
+		case Pressure::Moderate: return "moderate";
+		case Pressure::Critical: return "critical";
+	}
+	return "unknown";
+}
+
+class Governor {
+	wxTimer timer;
+	/// Pressure as of the last check
+	Pressure last = Pressure::None;
+	clock::time_point last_trim;
+
+	void Poll() {
+		if (!OPT_GET("App/Trim on Memory Pressure")->GetBool()) return;
+
+		const Pressure pressure = agi::memory::SystemPressure();
+		if (pressure != last)
+			LOG_I("memory") << "System memory pressure is now " << describe(pressure);
+
+		const auto now = clock::now();
+		if (pressure != Pressure::None && (pressure > last || now - last_trim >= retrim_interval)) {
+			agi::memory::Trim(pressure);
+			last_trim = now;
+		}
+		last = pressure;
+	}
+
+public:
+	Governor() {
+		timer.Bind(wxEVT_TIMER, [this](wxTimerEvent&) { Poll(); });
+		timer.Start(poll_interval_ms);
+	}
+};
+
+std::unique_ptr<Governor> governor;
+}
+
+namespace memory_governor {
+void Start() {
+	governor = agi::make_unique<Governor>();
+}
+
+void Stop() {
+	governor.reset();
+}
+}
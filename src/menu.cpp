@@ -41,6 +41,7 @@
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/range/algorithm_ext/push_back.hpp>
 #include <boost/locale/collator.hpp>
+#include <limits>
 #include <vector>
 #include <wx/frame.h>
 #include <wx/menu.h>
@@ -129,6 +130,10 @@ class CommandManager {
 	std::vector<std::string> items;
 	/// MRU menus which need to be updated on menu open
 	std::vector<MruMenu*> mru;
+	/// Top-level menus which have been appended but not yet filled in
+	std::vector<std::pair<std::string, wxMenu*>> pending;
+	/// Window whose idle events are used to fill in the pending menus
+	wxWindow *idle_window = nullptr;
 
 	/// Project context
 	agi::Context *context;
@@ -236,7 +241,35 @@ public:
 		parent->AppendSubMenu(mru.back(), _("&Recent"));
 	}
 
+	/// Register a menu to be filled in with the contents of the named menu
+	/// once the window goes idle, or when any menu is opened if that happens
+	/// first
+	void AddPending(std::string const& name, wxMenu *menu, wxWindow *window) {
+		pending.emplace_back(name, menu);
+		if (!idle_window) {
+			idle_window = window;
+			window->Bind(wxEVT_IDLE, &CommandManager::OnIdle, this);
+		}
+	}
+
+	/// Fill in the pending menus
+	/// @param limit Maximum number of menus to build
+	void BuildPending(size_t limit = std::numeric_limits<size_t>::max());
+
+	void OnIdle(wxIdleEvent &evt) {
+		evt.Skip();
+		// One menu per idle event so that input isn't held up behind all of them
+		BuildPending(1);
+		if (pending.empty()) {
+			idle_window->Unbind(wxEVT_IDLE, &CommandManager::OnIdle, this);
+			idle_window = nullptr;
+		}
+		else
+			evt.RequestMore();
+	}
+
 	void OnMenuOpen(wxMenuEvent &) {
+		BuildPending();
 		if (!context)
 			return;
 		for (auto const& item : dynamic_items) UpdateItem(item);
@@ -404,6 +437,13 @@ wxMenu *build_menu(std::string const& name, agi::Context *c, CommandManager *cm,
 	return menu;
 }
 
+void CommandManager::BuildPending(size_t limit) {
+	size_t count = std::min(limit, pending.size());
+	for (size_t i = 0; i < count; ++i)
+		build_menu(pending[i].first, context, this, pending[i].second);
+	pending.erase(pending.begin(), pending.begin() + count);
+}
+
 class AutomationMenu final : public wxMenu {
 	agi::Context *c;
 	CommandManager *cm;
@@ -523,7 +563,16 @@ namespace menu {
 			read_entry(item, "submenu", &submenu);
 			read_entry(item, "text", &disp);
 			if (!submenu.empty()) {
+#ifdef __WXMAC__
 				menu->Append(build_menu(submenu, c, &menu->cm), wxGetTranslation(to_wx(disp)));
+#else
+				// Only the titles are needed to show the menu bar, so defer
+				// creating the several hundred items in the menus until
+				// after startup has finished
+				auto top = new wxMenu;
+				menu->Append(top, wxGetTranslation(to_wx(disp)));
+				menu->cm.AddPending(submenu, top, window);
+#endif
 			}
 			else {
 				read_entry(item, "special", &submenu);
@@ -42,16 +42,19 @@
 #include "options.h"
 
 #include <libaegisub/ass/time.h>
+#include <libaegisub/dispatch.h>
 #include <libaegisub/file_mapping.h>
 #include <libaegisub/format.h>
 #include <libaegisub/scoped_ptr.h>
 
 #include <algorithm>
+#include <atomic>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/range/irange.hpp>
 #include <boost/tokenizer.hpp>
 #include <iterator>
+#include <zlib.h>
 
 #include <wx/choicdlg.h> // Keep this last so wxUSE_CHOICEDLG is set.
 
@@ -82,12 +85,18 @@ struct MkvStdIO final : InputStream {
 	static int64_t Scan(InputStream *st, uint64_t start, unsigned signature) {
 		auto *self = static_cast<MkvStdIO*>(st);
 		try {
+			// Search a window at a time rather than reading each byte
+			// separately, carrying the last few bytes over between windows
+			const uint64_t window = 1024 * 1024;
 			unsigned cmp = 0;
-			for (auto i : boost::irange(start, self->file.size())) {
-				int c = *self->file.read(i, 1);
-				cmp = ((cmp << 8) | c) & 0xffffffff;
-				if (cmp == signature)
-					return i - 4;
+			for (uint64_t pos = start; pos < self->file.size(); pos += window) {
+				auto len = std::min(window, self->file.size() - pos);
+				auto data = reinterpret_cast<const unsigned char *>(self->file.read(pos, len));
+				for (uint64_t i = 0; i < len; ++i) {
+					cmp = ((cmp << 8) | data[i]) & 0xffffffff;
+					if (cmp == signature)
+						return pos + i - 4;
+				}
 			}
 		}
 		catch (agi::Exception const& e) {
@@ -114,91 +123,134 @@ struct MkvStdIO final : InputStream {
 	}
 };
 
-static bool read_subtitles(agi::ProgressSink *ps, MatroskaFile *file, MkvStdIO *input, bool srt, double totalTime, AssParser *parser, CompressedStream *cs) {
-	std::vector<std::pair<int, std::string>> subList;
+namespace {
+/// A subtitle block read from the file, which is converted to a line once
+/// all of them have been found
+struct SubtitleFrame {
+	uint64_t start;
+	uint64_t end;
+	std::string data;
+};
+
+/// Number of frames converted by each task when converting them in parallel
+const size_t frames_per_task = 256;
+
+bool inflate_frame(std::string const& compressed, std::string& out) {
+	z_stream zs;
+	memset(&zs, 0, sizeof(zs));
+	if (inflateInit(&zs) != Z_OK) return false;
+
+	zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(compressed.data()));
+	zs.avail_in = static_cast<uInt>(compressed.size());
+
+	char buffer[4096];
+	int code;
+	do {
+		zs.next_out = reinterpret_cast<Bytef *>(buffer);
+		zs.avail_out = sizeof(buffer);
+		code = inflate(&zs, Z_NO_FLUSH);
+		out.append(buffer, sizeof(buffer) - zs.avail_out);
+	} while (code == Z_OK);
+
+	inflateEnd(&zs);
+	return code == Z_STREAM_END;
+}
+
+/// Convert a frame to a dialogue line and the position it should be sorted to
+/// @return false if the frame isn't a valid line
+bool frame_to_line(SubtitleFrame const& frame, bool srt, int index, std::pair<int, std::string>& out) {
+	// Get start and end times
+	int64_t timecodeScaleLow = 1000000;
+	agi::Time subStart = frame.start / timecodeScaleLow;
+	agi::Time subEnd = frame.end / timecodeScaleLow;
+
+	using str_range = boost::iterator_range<const char *>;
+	const char *readBuf = frame.data.data();
+	const char *readBufEnd = readBuf + frame.data.size();
+
+	// Process SSA/ASS
+	if (!srt) {
+		auto first = std::find(readBuf, readBufEnd, ',');
+		if (first == readBufEnd) return false;
+		auto second = std::find(first + 1, readBufEnd, ',');
+		if (second == readBufEnd) return false;
+
+		out.first = boost::lexical_cast<int>(str_range(readBuf, first));
+		out.second = agi::format("Dialogue: %d,%s,%s,%s"
+			, boost::lexical_cast<int>(str_range(first + 1, second))
+			, subStart.GetAssFormatted()
+			, subEnd.GetAssFormatted()
+			, str_range(second + 1, readBufEnd));
+	}
+	// Process SRT
+	else {
+		out.first = index;
+		out.second = agi::format("Dialogue: 0,%s,%s,Default,,0,0,0,,%s"
+			, subStart.GetAssFormatted()
+			, subEnd.GetAssFormatted()
+			, str_range(readBuf, readBufEnd));
+		boost::replace_all(out.second, "\r\n", "\\N");
+		boost::replace_all(out.second, "\r", "\\N");
+		boost::replace_all(out.second, "\n", "\\N");
+	}
+	return true;
+}
+}
 
-	// Load blocks
+static bool read_subtitles(agi::ProgressSink *ps, MatroskaFile *file, MkvStdIO *input, bool srt, bool compressed, double totalTime, AssParser *parser) {
+	// Only the subtitle track is unmasked, so the parser skips over the
+	// blocks of every other track without reading them. The blocks found are
+	// just copied out here, as everything else can be done in parallel.
+	std::vector<SubtitleFrame> frames;
 	uint64_t startTime, endTime, filePos;
 	unsigned int rt, frameSize, frameFlags;
 
-	std::vector<char> uncompBuf(cs ? 256 : 0);
-
 	while (mkv_ReadFrame(file, 0, &rt, &startTime, &endTime, &filePos, &frameSize, &frameFlags) == 0) {
 		if (ps->IsCancelled()) return true;
 		if (frameSize == 0) continue;
 
-		const char *readBuf;
-		const char *readBufEnd;
-
-		if (cs) {
-			cs_NextFrame(cs, filePos, frameSize);
-			int bytesRead = 0;
-
-			int res;
-			do {
-				res = cs_ReadData(cs, &uncompBuf[bytesRead], uncompBuf.size() - bytesRead);
-				if (res == -1) {
-					const char *err = cs_GetLastError(cs);
-					if (!err) err = "Unknown error";
-					ps->Log("Failed to decompress subtitles: " + std::string(err));
-					ps->SetStayOpen(true);
-					return false;
-				}
-
-				bytesRead += res;
+		const char *readBuf = input->file.read(filePos, frameSize);
+		frames.push_back(SubtitleFrame{startTime, endTime, std::string(readBuf, frameSize)});
 
-				if (bytesRead >= uncompBuf.size())
-					uncompBuf.resize(2 * uncompBuf.size());
-			} while (res != 0);
+		ps->SetProgress(startTime / 1000000, totalTime);
+	}
 
-			readBuf = &uncompBuf[0];
-			readBufEnd = readBuf + bytesRead;
-		} else {
-			readBuf = input->file.read(filePos, frameSize);
-			readBufEnd = readBuf + frameSize;
+	std::vector<std::pair<int, std::string>> subList(frames.size());
+	std::vector<char> valid(frames.size(), 0);
+	std::atomic<bool> decompress_failed{false};
+
+	const size_t tasks = (frames.size() + frames_per_task - 1) / frames_per_task;
+	agi::dispatch::Parallel(tasks, [&](size_t task) {
+		const size_t end = std::min(frames.size(), (task + 1) * frames_per_task);
+		for (size_t i = task * frames_per_task; i < end; ++i) {
+			if (compressed) {
+				std::string decompressed;
+				if (!inflate_frame(frames[i].data, decompressed)) {
+					decompress_failed = true;
+					return;
+				}
+				frames[i].data = std::move(decompressed);
+			}
+			valid[i] = frame_to_line(frames[i], srt, static_cast<int>(i), subList[i]);
 		}
+	});
 
-		// Get start and end times
-		int64_t timecodeScaleLow = 1000000;
-		agi::Time subStart = startTime / timecodeScaleLow;
-		agi::Time subEnd = endTime / timecodeScaleLow;
-
-		using str_range = boost::iterator_range<const char *>;
-
-		// Process SSA/ASS
-		if (!srt) {
-			auto first = std::find(readBuf, readBufEnd, ',');
-			if (first == readBufEnd) continue;
-			auto second = std::find(first + 1, readBufEnd, ',');
-			if (second == readBufEnd) continue;
-
-			subList.emplace_back(
-				boost::lexical_cast<int>(str_range(readBuf, first)),
-				agi::format("Dialogue: %d,%s,%s,%s"
-					, boost::lexical_cast<int>(str_range(first + 1, second))
-					, subStart.GetAssFormatted()
-					, subEnd.GetAssFormatted()
-					, str_range(second + 1, readBufEnd)));
-		}
-		// Process SRT
-		else {
-			auto line = agi::format("Dialogue: 0,%s,%s,Default,,0,0,0,,%s"
-				, subStart.GetAssFormatted()
-				, subEnd.GetAssFormatted()
-				, str_range(readBuf, readBufEnd));
-			boost::replace_all(line, "\r\n", "\\N");
-			boost::replace_all(line, "\r", "\\N");
-			boost::replace_all(line, "\n", "\\N");
-
-			subList.emplace_back(subList.size(), std::move(line));
-		}
+	if (decompress_failed) {
+		ps->Log("Failed to decompress subtitles: ZLib error.");
+		ps->SetStayOpen(true);
+		return false;
+	}
 
-		ps->SetProgress(startTime / timecodeScaleLow, totalTime);
+	size_t count = 0;
+	for (size_t i = 0; i < subList.size(); ++i) {
+		if (valid[i])
+			subList[count++] = std::move(subList[i]);
 	}
+	subList.resize(count);
 
 	// Insert into file
 	sort(begin(subList), end(subList));
-	for (auto order_value_pair : subList)
+	for (auto const& order_value_pair : subList)
 		parser->AddLine(order_value_pair.second);
 	return true;
 }
@@ -273,12 +325,8 @@ void MatroskaWrapper::GetSubtitles(agi::fs::path const& filename, AssFile *targe
 
 	parser.AddLine("[Events]");
 
-	agi::scoped_holder<CompressedStream *, decltype(&cs_Destroy)> cs(nullptr, cs_Destroy);
-	if (trackInfo->CompEnabled) {
-		cs = cs_Create(file, trackToRead, err, sizeof(err));
-		if (!cs)
-			throw MatroskaException(err);
-	}
+	if (trackInfo->CompEnabled && trackInfo->CompMethod != COMP_ZLIB)
+		throw MatroskaException("Unsupported compression method.");
 
 	// Read timecode scale
 	auto segInfo = mkv_GetFileInfo(file);
@@ -288,29 +336,39 @@ void MatroskaWrapper::GetSubtitles(agi::fs::path const& filename, AssFile *targe
 	auto totalTime = double(segInfo->Duration) / timecodeScale;
 	DialogProgress progress(nullptr, _("Parsing Matroska"), _("Reading subtitles from Matroska file."));
 	bool result;
-	progress.Run([&](agi::ProgressSink *ps) { result = read_subtitles(ps, file, &input, srt, totalTime, &parser, cs); });
+	progress.Run([&](agi::ProgressSink *ps) { result = read_subtitles(ps, file, &input, srt, trackInfo->CompEnabled, totalTime, &parser); });
 
 	if (!result)
 		throw MatroskaException("Failed to read subtitles");
+	parser.Finish();
 }
 
 bool MatroskaWrapper::HasSubtitles(agi::fs::path const& filename) {
 	char err[2048];
 	try {
 		MkvStdIO input(filename);
-		agi::scoped_holder<MatroskaFile*, decltype(&mkv_Close)> file(mkv_Open(&input, err, sizeof(err)), mkv_Close);
-		if (!file) return false;
-
-		// Find tracks
-		auto tracks = mkv_GetNumTracks(file);
-		for (auto track : boost::irange(0u, tracks)) {
-			auto trackInfo = mkv_GetTrackInfo(file, track);
-
-			if (trackInfo->Type == 0x11) {
-				std::string CodecID(trackInfo->CodecID);
-				if (CodecID == "S_TEXT/SSA" || CodecID == "S_TEXT/ASS" || CodecID == "S_TEXT/UTF8")
-					return true;
+
+		// Only the track headers are needed, and they come before the first
+		// cluster in any sensibly muxed file, so first try reading just the
+		// start of the file rather than following the seek head to the cues,
+		// tags and attachments and reading the end to find the duration
+		for (unsigned flags : {MKVF_AVOID_SEEKS, 0}) {
+			agi::scoped_holder<MatroskaFile*, decltype(&mkv_Close)> file(mkv_OpenEx(&input, 0, flags, err, sizeof(err)), mkv_Close);
+			if (!file) continue;
+
+			// Find tracks
+			auto tracks = mkv_GetNumTracks(file);
+			if (tracks == 0) continue;
+			for (auto track : boost::irange(0u, tracks)) {
+				auto trackInfo = mkv_GetTrackInfo(file, track);
+
+				if (trackInfo->Type == 0x11) {
+					std::string CodecID(trackInfo->CodecID);
+					if (CodecID == "S_TEXT/SSA" || CodecID == "S_TEXT/ASS" || CodecID == "S_TEXT/UTF8")
+						return true;
+				}
 			}
+			return false;
 		}
 	}
 	catch (...) {
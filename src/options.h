@@ -20,7 +20,7 @@
 #include <libaegisub/option.h>
 #include <libaegisub/option_value.h>
 
-namespace agi { class Path; }
+namespace agi { class DerivedStore; class Path; }
 namespace Automation4 { class AutoloadScriptManager; }
 
 /// For holding all configuration-related objects and values.
@@ -28,6 +28,7 @@ namespace config {
 	extern agi::Options *opt;    ///< Options
 	extern agi::MRUManager *mru; ///< Most Recently Used
 	extern agi::Path *path;
+	extern agi::DerivedStore *derived; ///< Cache of data derived from media files
 	extern Automation4::AutoloadScriptManager *global_scripts;
 }
 
@@ -49,6 +49,7 @@
 
 #include <libaegisub/hotkey.h>
 
+#include <iterator>
 #include <unordered_set>
 
 #include <wx/checkbox.h>
@@ -76,7 +77,7 @@ void General(wxTreebook *book, Preferences *parent) {
 	p->OptionAdd(general, _("Check for updates on startup"), "App/Auto/Check For Updates");
 	p->OptionAdd(general, _("Show main toolbar"), "App/Show Toolbar");
 	p->OptionAdd(general, _("Save UI state in subtitles files"), "App/Save UI State");
-	p->CellSkip(general);
+	p->OptionAdd(general, _("Cache large subtitle files for faster reopening"), "Subtitle Format/ASS/Sidecar Cache/Enabled");
 
 	p->OptionAdd(general, _("Toolbar Icon Size"), "App/Toolbar Icon Size");
 	wxString autoload_modes[] = { _("Never"), _("Always"), _("Ask") };
@@ -231,9 +232,17 @@ void Audio(wxTreebook *book, Preferences *parent) {
 	p->OptionAdd(display, _("Cursor time"), "Audio/Display/Draw/Cursor Time");
 	p->OptionAdd(display, _("Video position"), "Audio/Display/Draw/Video Position");
 	p->OptionAdd(display, _("Seconds boundaries"), "Audio/Display/Draw/Seconds");
-	p->CellSkip(display);
+	p->OptionAdd(display, _("Speech boundaries"), "Audio/Display/Draw/Speech Boundaries");
 	p->OptionChoice(display, _("Waveform Style"), AudioWaveformRenderer::GetWaveformStyles(), "Audio/Display/Waveform Style");
 
+	auto speech = p->PageSizer(_("Speech Detection"));
+	p->OptionAdd(speech, _("Snap markers to speech"), "Audio/Speech Detection/Snap");
+	p->CellSkip(speech);
+	p->OptionAdd(speech, _("Level above noise floor (dB)"), "Audio/Speech Detection/Threshold", 0, 60);
+	p->OptionAdd(speech, _("Longest pause to bridge (ms)"), "Audio/Speech Detection/Min Gap", 0, 2000);
+	p->OptionAdd(speech, _("Shortest speech (ms)"), "Audio/Speech Detection/Min Length", 0, 2000);
+	p->OptionAdd(speech, _("Furthest to move lines (ms)"), "Audio/Speech Detection/Search Range", 0, 10000);
+
 	auto label = p->PageSizer(_("Audio labels"));
 	p->OptionAdd(label, _("Preserve existing timings when cutting/splitting"), "Audio/Karaoke/Preserve Timings on Cut");
 	p->OptionFont(label, "Audio/Karaoke/");
@@ -247,7 +256,7 @@ void Video(wxTreebook *book, Preferences *parent) {
 
 	auto general = p->PageSizer(_("Options"));
 	p->OptionAdd(general, _("Show keyframes in slider"), "Video/Slider/Show Keyframes");
-	p->CellSkip(general);
+	p->OptionAdd(general, _("Show thumbnails when hovering over slider"), "Video/Slider/Show Thumbnails");
 	p->OptionAdd(general, _("Only show visual tools when mouse is over video"), "Tool/Visual/Autohide");
 	p->CellSkip(general);
 	p->OptionAdd(general, _("Seek video to line start on selection change"), "Video/Subtitle Sync");
@@ -258,6 +267,22 @@ void Video(wxTreebook *book, Preferences *parent) {
 	p->OptionAdd(general, _("Disable zooming with scroll bar"), "Video/Disable Scroll Zoom")
 		->SetToolTip("Makes the scroll bar not zoom the video. Useful when using a track pad that often scrolls accidentally.");
 	p->OptionAdd(general, _("Reverse zoom direction"), "Video/Reverse Zoom");
+	p->OptionAdd(general, _("Show individual pixels when zoomed in"), "Video/Pixelated Zoom")
+		->SetToolTip("Draws the video without smoothing when it is shown larger than its actual size, which makes it easier to line things up with single pixels.");
+	p->OptionAdd(general, _("Render the whole line before playing it"), "Video/Prerender Play Line")
+		->SetToolTip("Decodes the frames and renders the subtitles of the current line before Play Line starts, so that heavy signs play smoothly the first time. The rendered subtitles are reused until the lines on those frames change.");
+
+	auto scenes = p->PageSizer(_("Scene detection"));
+	p->OptionAdd(scenes, _("Detect keyframes from scene changes"), "Video/Scene Detection/Enabled")
+		->SetToolTip("Reads through the video while it is idle to find scene changes, and uses them as the keyframes when no keyframes file is loaded. The results are cached for the next time the video is opened.");
+	p->OptionAdd(scenes, _("Minimum scene length (frames)"), "Video/Scene Detection/Minimum Length", 1, 1000);
+
+	auto proxy = p->PageSizer(_("Scrubbing"));
+	p->OptionAdd(proxy, _("Decode at reduced size while scrubbing"), "Video/Scrub Proxy/Enabled")
+		->SetToolTip("Decodes smaller frames while the video slider is being dragged or the video is playing faster than normal speed, and full size frames once it stops. Supported by FFmpegSource, BestSource and VapourSynth.");
+	p->OptionAdd(proxy, _("Size divisor"), "Video/Scrub Proxy/Divisor", 2, 8);
+	p->OptionAdd(proxy, _("Render subtitles at half size during playback"), "Video/Reduced Playback Subtitles")
+		->SetToolTip("Renders the subtitles at half the size of the frame and scales them up while the video is playing, which keeps heavy typesetting closer to real time at the cost of looking softer. Full quality subtitles are drawn as soon as playback stops.");
 
 	auto relative = p->PageSizer(_("Relative time readouts"));
 	p->OptionAdd(relative, _("Disable the popup message for copy/inserting the relative time"), "Video/Disable Click Popup");
@@ -318,6 +343,7 @@ void Interface(wxTreebook *book, Preferences *parent) {
 	auto grid = p->PageSizer(_("Grid"));
 	p->OptionAdd(grid, _("Focus grid on click"), "Subtitle/Grid/Focus Allow");
 	p->OptionAdd(grid, _("Highlight visible subtitles"), "Subtitle/Grid/Highlight Subtitles in Frame");
+	p->OptionAdd(grid, _("Only report collisions on the same video frame"), "Subtitle/Grid/Collisions By Frame");
 	p->OptionAdd(grid, _("Hide overrides symbol"), "Subtitle/Grid/Hide Overrides Char");
 	p->OptionFont(grid, "Subtitle/Grid/");
 
@@ -415,6 +441,7 @@ void Interface_Colours(wxTreebook *book, Preferences *parent) {
 	register_opt(p->OptionAdd(audio, _("Line boundary inactive line"), "Colour/Audio Display/Line Boundary Inactive Line"), "Colour/Audio Display/Line Boundary Inactive Line");
 	register_opt(p->OptionAdd(audio, _("Syllable boundaries"), "Colour/Audio Display/Syllable Boundaries"), "Colour/Audio Display/Syllable Boundaries");
 	register_opt(p->OptionAdd(audio, _("Seconds boundaries"), "Colour/Audio Display/Seconds Line"), "Colour/Audio Display/Seconds Line");
+	register_opt(p->OptionAdd(audio, _("Speech boundaries"), "Colour/Audio Display/Speech Boundary"), "Colour/Audio Display/Speech Boundary");
 
 	auto syntax = p->PageSizer(_("Syntax Highlighting"));
 	register_opt(p->OptionAdd(syntax, _("Background"), "Colour/Subtitle/Background"), "Colour/Subtitle/Background");
@@ -485,6 +512,7 @@ void Backup(wxTreebook *book, Preferences *parent) {
 	p->CellSkip(save);
 	p->EnableIfChecked(cb,
 		p->OptionAdd(save, _("Interval in seconds"), "App/Auto/Save Every Seconds", 1));
+	p->OptionAdd(save, _("Autosaves to keep per file (0 for all)"), "App/Auto/Save Keep Count");
 	p->OptionBrowse(save, _("Path"), "Path/Auto/Save", cb, true);
 	p->OptionAdd(save, _("Autosave after every change"), "App/Auto/Save on Every Change");
 
@@ -514,6 +542,12 @@ void Automation(wxTreebook *book, Preferences *parent) {
 	wxArrayString ar_choice(4, ar_arr);
 	p->OptionChoice(general, _("Autoreload on Export"), ar_choice, "Automation/Autoreload Mode");
 
+	p->OptionAdd(general, _("Cache compiled scripts"), "Automation/Cache Compiled Scripts");
+
+	auto profile = p->PageSizer(_("Profiling"));
+	p->OptionAdd(profile, _("Profile macros"), "Automation/Profile/Enabled");
+	p->OptionAdd(profile, _("Sample call stacks while profiling"), "Automation/Profile/Sampling");
+
 	p->SetSizerAndFit(p->sizer);
 }
 
@@ -529,6 +563,20 @@ void Advanced(wxTreebook *book, Preferences *parent) {
 	warning->Wrap(400);
 	general->Add(warning, 0, wxALL, 5);
 
+	auto memory = p->PageSizer(_("Memory"));
+	p->OptionAdd(memory, _("Cache memory budget (MB, 0 for none)"), "App/Memory Budget", 0, 1000000);
+	p->OptionAdd(memory, _("Shrink caches when the system is low on memory"), "App/Trim on Memory Pressure");
+
+	auto derived = p->PageSizer(_("Disk Cache"));
+	p->OptionAdd(derived, _("Keyframe and thumbnail cache size (MB)"), "App/Derived Data Cache Size", 0, 1000000);
+
+	auto staging = p->PageSizer(_("Network Storage"));
+	p->OptionAdd(staging, _("Copy media on network storage to local disk"), "Provider/Staging/Enabled");
+	p->OptionAdd(staging, _("Local copy budget (MB)"), "Provider/Staging/Max Size", 0, 10000000);
+
+	auto diagnostics = p->PageSizer(_("Diagnostics"));
+	p->OptionAdd(diagnostics, _("Report stalls longer than (ms, 0 for never)"), "App/Stall Report Threshold", 0, 600000);
+
 	p->SetSizerAndFit(p->sizer);
 }
 
@@ -543,12 +591,18 @@ void Advanced_Audio(wxTreebook *book, Preferences *parent) {
 
 	wxArrayString apl_choice = to_wx(AudioPlayerFactory::GetClasses());
 	p->OptionChoice(expert, _("Audio player"), apl_choice, "Audio/Player");
+	p->OptionAdd(expert, _("Player buffer latency (ms)"), "Player/Audio/Buffer Latency", 10, 1000);
 
 	auto cache = p->PageSizer(_("Cache"));
-	const wxString ct_arr[3] = { _("None (NOT RECOMMENDED)"), _("RAM"), _("Hard Disk") };
-	wxArrayString ct_choice(3, ct_arr);
+	const wxString ct_arr[4] = { _("None (NOT RECOMMENDED)"), _("RAM"), _("Hard Disk"), _("On demand") };
+	wxArrayString ct_choice(4, ct_arr);
 	p->OptionChoice(cache, _("Cache type"), ct_choice, "Audio/Cache/Type");
 	p->OptionBrowse(cache, _("Path"), "Audio/Cache/HD/Location");
+	p->OptionAdd(cache, _("On-demand cache size (MB)"), "Audio/Cache/On Demand/Max Size", 16, 16384);
+	p->OptionAdd(cache, _("Cache as 16-bit stereo"), "Audio/Cache/Compact");
+	p->OptionAdd(cache, _("Keep decoded audio between sessions"), "Audio/Cache/Persistent/Enable");
+	p->OptionBrowse(cache, _("Persistent cache path"), "Audio/Cache/Persistent/Location");
+	p->OptionAdd(cache, _("Persistent cache size (MB)"), "Audio/Cache/Persistent/Max Size", 0, 1000000);
 
 	auto spectrum = p->PageSizer(_("Spectrum"));
 
@@ -578,6 +632,8 @@ void Advanced_Audio(wxTreebook *book, Preferences *parent) {
 	p->OptionChoice(ffms, _("Audio indexing error handling mode"), error_modes_choice, "Provider/Audio/FFmpegSource/Decode Error Handling");
 
 	p->OptionAdd(ffms, _("Always index all audio tracks"), "Provider/FFmpegSource/Index All Tracks");
+	p->OptionAdd(ffms, _("Index video in the background"), "Provider/FFmpegSource/Background Indexing")
+		->SetToolTip("Lets you keep working on the subtitles and audio while a newly opened video is indexed, and opens the video once it's done. Videos opened along with a subtitles file are still indexed before loading continues.");
 	wxControl* stereo = p->OptionAdd(ffms, _("Downmix to stereo"), "Provider/Audio/FFmpegSource/Downmix");
 	stereo->SetToolTip("Reduces memory usage on surround audio, but may cause audio tracks to sound blank in specific circumstances. This will not affect audio with two channels or less.");
 #endif
@@ -619,11 +675,25 @@ void Advanced_Video(wxTreebook *book, Preferences *parent) {
 
 	wxArrayString sp_choice = to_wx(SubtitlesProviderFactory::GetClasses());
 	p->OptionChoice(expert, _("Subtitles provider"), sp_choice, "Subtitle/Provider");
+	p->OptionAdd(expert, _("Subtitle renderers for prerendering"), "Subtitle/Prerender Renderers", 1, 32)
+		->SetToolTip(_("Number of copies of the subtitles provider to render frames with at once when a range is rendered ahead of playing it. Each one keeps its own caches, so more use more memory."));
+	p->OptionAdd(expert, _("Frames to read ahead"), "Provider/Video/Cache/Read Ahead", 0, 256);
+	p->OptionAdd(expert, _("Cache frames before color conversion"), "Provider/Video/Cache/Planar")
+		->SetToolTip(_("Fits several times as many frames in the video cache, but has to convert each frame again every time it is shown. Only supported by some video providers."));
+	p->OptionAdd(expert, _("Seek with a second decoder during playback"), "Provider/Video/Seek Decoder")
+		->SetToolTip(_("Opens the video a second time to show lines jumped to while playing, so that playback doesn't have to find its place again afterwards. Only supported by some video providers."));
+	p->OptionAdd(expert, _("Draw subtitles with the graphics card"), "Video/GPU Subtitle Compositing");
+	p->OptionAdd(expert, _("Convert high bit depth video with the graphics card"), "Video/High Bit Depth Preview")
+		->SetToolTip(_("Shows 10-bit and 12-bit video without reducing it to 8 bits first, tone mapping HDR video for an SDR display. Requires drawing subtitles with the graphics card. Only supported by some video providers."));
+	p->OptionAdd(expert, _("Render only the edited lines while dragging"), "Video/Drag Preview")
+		->SetToolTip(_("While a visual tool is being dragged, renders the other subtitles once and redraws just the lines being edited over them. Much faster on busy frames, but the edited lines are always drawn on top and don't collide with the others until the drag ends."));
 
 
 #ifdef WITH_AVISYNTH
 	auto avisynth = p->PageSizer("Avisynth");
 	p->OptionAdd(avisynth, _("Avisynth memory limit"), "Provider/Avisynth/Memory Max");
+	p->OptionAdd(avisynth, _("Prefetch threads (AviSynth+ only)"), "Provider/Avisynth/Prefetch Threads", 0, 64)
+		->SetToolTip(_("Runs scripts with AviSynth+'s multithreading by adding Prefetch() to them with this many threads. 0 disables it, which is required for scripts which call Prefetch() themselves."));
 #endif
 
 #ifdef WITH_FFMS2
@@ -643,6 +713,19 @@ void Advanced_Video(wxTreebook *book, Preferences *parent) {
 	p->OptionAdd(bs, _("Decoder Threads (0 to autodetect)"), "Provider/Video/BestSource/Threads");
 	p->OptionAdd(bs, _("Seek preroll (Frames)"), "Provider/Video/BestSource/Seek Preroll");
 	p->OptionAdd(bs, _("Apply RFF"), "Provider/Video/BestSource/Apply RFF");
+	const wxString hw_devices[] = {
+		"none",
+#if defined(__WXMSW__)
+		"d3d11va", "dxva2",
+#elif defined(__WXOSX__)
+		"videotoolbox",
+#else
+		"vaapi",
+#endif
+		"cuda", "vulkan"
+	};
+	p->OptionChoice(bs, _("Hardware decoding"), wxArrayString(std::size(hw_devices), hw_devices), "Provider/Video/BestSource/Hardware Device")
+		->SetToolTip("Decode on the GPU with the given device type, falling back to the CPU if the video can't be opened with it. Can be turned off for individual projects from the Video menu.");
 #endif
 
 	p->SetSizerAndFit(p->sizer);
@@ -658,6 +741,8 @@ void VapourSynth(wxTreebook *book, Preferences *parent) {
 	p->OptionChoice(general, _("Log level"), log_levels_choice, "Provider/Video/VapourSynth/Log Level");
 	p->CellSkip(general);
 	p->OptionAdd(general, _("Load user plugins"), "Provider/VapourSynth/Autoload User Plugins");
+	p->OptionAdd(general, _("Frames to request ahead"), "Provider/Video/VapourSynth/Prefetch Frames", 0, 64)
+		->SetToolTip(_("Requests this many frames after the current one in parallel, so that VapourSynth can process them on several threads at once. Takes effect the next time a video is opened."));
 
 	auto video = p->PageSizer(_("Default Video Script"));
 
@@ -1230,7 +1315,7 @@ void Preferences::OnApply(wxCommandEvent &) {
 	pending_callbacks.clear();
 
 	applyButton->Enable(false);
-	config::opt->Flush();
+	config::opt->FlushDeferred();
 }
 
 void Preferences::OnResetDefault(wxCommandEvent&) {
@@ -1242,7 +1327,7 @@ void Preferences::OnResetDefault(wxCommandEvent&) {
 		if (!opt->IsDefault())
 			opt->Reset();
 	}
-	config::opt->Flush();
+	config::opt->FlushDeferred();
 
 	agi::hotkey::Hotkey def_hotkeys("", GET_DEFAULT_CONFIG(default_hotkey));
 	hotkey::inst->SetHotkeyMap(def_hotkeys.GetHotkeyMap());
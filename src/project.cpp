@@ -27,17 +27,24 @@
 #include "dialog_progress.h"
 #include "dialogs.h"
 #include "format.h"
+#include "frame_main.h"
 #include "include/aegisub/context.h"
 #include "include/aegisub/video_provider.h"
+#include "media_staging.h"
 #include "mkv_wrap.h"
 #include "options.h"
+#include "scene_index.h"
 #include "selection_controller.h"
 #include "subs_controller.h"
 #include "utils.h"
 #include "video_controller.h"
 #include "video_display.h"
+#include "video_frame.h"
+#include "video_provider_manager.h"
 
 #include <libaegisub/audio/provider.h>
+#include <libaegisub/dispatch.h>
+#include <libaegisub/file_mapping.h>
 #include <libaegisub/format_path.h>
 #include <libaegisub/fs.h>
 #include <libaegisub/keyframe.h>
@@ -47,10 +54,54 @@
 
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/filesystem/operations.hpp>
+#include <set>
 #include <wx/msgdlg.h>
 
+struct Project::KeyframesLoad {
+	Project *project;
+	agi::fs::path path;
+};
+
+namespace {
+/// Does the file run a script to make the video, rather than being a video?
+bool is_video_script(agi::fs::path const& path) {
+	return agi::fs::HasExtension(path, "avs") || agi::fs::HasExtension(path, "vpy") || agi::fs::HasExtension(path, "py");
+}
+
+/// Do two videos have the same properties, and the same frames at the start,
+/// middle and end and at the given frame?
+bool same_output(AsyncVideoProvider &a, AsyncVideoProvider &b, int current) {
+	if (a.GetFrameCount() != b.GetFrameCount() || a.GetWidth() != b.GetWidth() ||
+		a.GetHeight() != b.GetHeight() || a.GetDAR() != b.GetDAR() ||
+		a.GetColorSpace() != b.GetColorSpace() || a.GetKeyFrames() != b.GetKeyFrames())
+		return false;
+
+	auto fps_a = a.GetFPS(), fps_b = b.GetFPS();
+	const int count = a.GetFrameCount();
+	if (fps_a.IsVFR() != fps_b.IsVFR() || fps_a.TimeAtFrame(count - 1) != fps_b.TimeAtFrame(count - 1))
+		return false;
+
+	std::set<int> samples{0, count / 2, count - 1, mid(0, current, count - 1)};
+	try {
+		for (int frame : samples) {
+			auto frame_a = a.GetFrame(frame, 0, true);
+			auto frame_b = b.GetFrame(frame, 0, true);
+			if (!frame_a || !frame_b || frame_a->width != frame_b->width ||
+				frame_a->height != frame_b->height || frame_a->data != frame_b->data)
+				return false;
+		}
+	}
+	catch (...) {
+		return false;
+	}
+	return true;
+}
+}
+
 Project::Project(agi::Context *c) : context(c) {
 	OPT_SUB("Audio/Cache/Type", &Project::ReloadAudio, this);
+	OPT_SUB("Audio/Cache/Compact", &Project::ReloadAudio, this);
+	OPT_SUB("Audio/Cache/Persistent/Enable", &Project::ReloadAudio, this);
 	OPT_SUB("Audio/Provider", &Project::ReloadAudio, this);
 	OPT_SUB("Provider/Audio/FFmpegSource/Decode Error Handling", &Project::ReloadAudio, this);
 	OPT_SUB("Provider/Audio/FFmpegSource/Downmix", &Project::ReloadAudio, this);
@@ -64,6 +115,10 @@ Project::Project(agi::Context *c) : context(c) {
 			return;
 		context->ass->Properties.video_zoom = context->videoDisplay->GetZoom();
 	});
+	media_staged_connection = AddMediaStagedListener([this](agi::fs::path const& path) {
+		if (path == video_file || path == audio_file)
+			context->frame->StatusTimeout(fmt_tl("A local copy of %s has been made and will be used the next time it is opened", path.filename()));
+	});
 }
 
 Project::~Project() { }
@@ -87,6 +142,29 @@ void Project::ReloadVideo() {
 	}
 }
 
+void Project::ReloadVideoIfChanged() {
+	if (!video_provider) return;
+	if (!is_video_script(video_file)) {
+		ReloadVideo();
+		return;
+	}
+
+	// Sources the script indexes are normally cached by the script, so most
+	// of opening it again is running its filters
+	context->videoController->Stop();
+	auto provider = OpenVideo(video_file);
+	if (!provider) return;
+
+	const int frame = context->videoController->GetFrameN();
+	if (same_output(*video_provider, *provider, frame)) {
+		context->frame->StatusTimeout(_("The video script's output hasn't changed"));
+		return;
+	}
+
+	SetVideoProvider(video_file, std::move(provider));
+	context->videoController->JumpToFrame(frame);
+}
+
 void Project::ShowError(wxString const& message) {
 	wxMessageBox(message, "Error loading file", wxOK | wxICON_ERROR | wxCENTER, context->parent);
 }
@@ -105,7 +183,11 @@ void Project::SetPath(agi::fs::path& var, const char *token, const char *mru, ag
 }
 
 bool Project::DoLoadSubtitles(agi::fs::path const& path, std::string encoding, ProjectProperties &properties) {
+	// Detecting the encoding, sniffing the format and reading the file all
+	// open it, so keep it open for all of them
+	std::unique_ptr<agi::file_open_scope> open_file;
 	try {
+		open_file = agi::make_unique<agi::file_open_scope>(path);
 		if (encoding.empty())
 			encoding = CharSetDetect::GetEncoding(path);
 	}
@@ -186,7 +268,10 @@ void Project::LoadUnloadFiles(ProjectProperties properties) {
 	auto timecodes = context->path->MakeAbsolute(properties.timecodes_file, "?script");
 	auto keyframes = context->path->MakeAbsolute(properties.keyframes_file, "?script");
 
-	if (video == video_file && audio == audio_file && keyframes == keyframes_file && timecodes == timecodes_file)
+	// A video still being indexed counts as open, as it will be soon
+	auto current_video = video_index_job ? indexing_video_file : video_file;
+	auto current_keyframes = keyframes_load ? keyframes_load->path : keyframes_file;
+	if (video == current_video && audio == audio_file && keyframes == current_keyframes && timecodes == timecodes_file)
 		return;
 
 	if (load_linked == 2) {
@@ -202,11 +287,11 @@ void Project::LoadUnloadFiles(ProjectProperties properties) {
 
 		if (audio != audio_file)
 			append_file(audio, _("Unload audio"), _("Load audio file: %s"));
-		if (video != video_file)
+		if (video != current_video)
 			append_file(video, _("Unload video"), _("Load video file: %s"));
 		if (timecodes != timecodes_file)
 			append_file(timecodes, _("Unload timecodes"), _("Load timecodes file: %s"));
-		if (keyframes != keyframes_file)
+		if (keyframes != current_keyframes)
 			append_file(keyframes, _("Unload keyframes"), _("Load keyframes file: %s"));
 
 		wxMessageDialog linked_files_dialog(
@@ -219,48 +304,75 @@ void Project::LoadUnloadFiles(ProjectProperties properties) {
 			return;
 	}
 
-	bool loaded_video = false;
-	if (video != video_file) {
-		if (video.empty())
-			CloseVideo();
-		else if ((loaded_video = DoLoadVideo(video))) {
-			auto vc = context->videoController.get();
-			vc->JumpToFrame(properties.video_position);
+	// Everything which doesn't depend on the video is loaded straight away.
+	// If the video has to be indexed first, that's done in the background so
+	// that the subtitles can be worked on in the meantime, and whatever does
+	// depend on it is loaded once it's done.
+	if (video != current_video && video.empty())
+		CloseVideo();
 
-			auto ar_mode = static_cast<AspectRatio>(properties.ar_mode);
-			if (ar_mode == AspectRatio::Custom)
-				vc->SetAspectRatio(properties.ar_value);
-			else
-				vc->SetAspectRatio(ar_mode);
-			bool force_default_zoom = OPT_GET("Video/Force Default Zoom")->GetBool();
-			double zoom = properties.video_zoom;
-			if (force_default_zoom)
-				zoom = OPT_GET("Video/Default Zoom")->GetInt() * .125 + .125;
-			// Preserve any existing pan offsets when forcing default zoom; only zoom should change.
-			context->videoDisplay->SetWindowZoom(zoom, !force_default_zoom);
-		}
+	bool timecodes_loaded = false;
+	if (!timecodes.empty()) {
+		LoadTimecodes(timecodes);
+		timecodes_loaded = timecodes_file == timecodes;
 	}
+	// Keyframe logs from long encodes can be big, so they're read off the
+	// main thread
+	if (!keyframes.empty() && keyframes != current_keyframes)
+		LoadKeyframesInBackground(keyframes);
 
-	if (!timecodes.empty()) LoadTimecodes(timecodes);
-	if (!keyframes.empty()) LoadKeyframes(keyframes);
-
-	if (audio != audio_file) {
+	const bool audio_from_video = audio == audio_file;
+	if (!audio_from_video) {
 		if (audio.empty())
 			CloseAudio();
 		else
 			DoLoadAudio(audio, false);
 	}
-	else if (loaded_video && OPT_GET("Video/Open Audio")->GetBool() && audio_file != video_file && video_provider->HasAudio())
-		DoLoadAudio(video, true);
+
+	if (video == current_video || video.empty())
+		return;
+
+	auto load_video = [=] {
+		// If the keyframes are still being read they'll replace the video's
+		// once they're done, so only ones already loaded need reloading
+		const bool keyframes_loaded = !keyframes.empty() && keyframes_file == keyframes;
+		if (!DoLoadVideo(video)) return;
+
+		auto vc = context->videoController.get();
+		vc->JumpToFrame(properties.video_position);
+
+		auto ar_mode = static_cast<AspectRatio>(properties.ar_mode);
+		if (ar_mode == AspectRatio::Custom)
+			vc->SetAspectRatio(properties.ar_value);
+		else
+			vc->SetAspectRatio(ar_mode);
+		bool force_default_zoom = OPT_GET("Video/Force Default Zoom")->GetBool();
+		double zoom = properties.video_zoom;
+		if (force_default_zoom)
+			zoom = OPT_GET("Video/Default Zoom")->GetInt() * .125 + .125;
+		// Preserve any existing pan offsets when forcing default zoom; only zoom should change.
+		context->videoDisplay->SetWindowZoom(zoom, !force_default_zoom);
+
+		// Opening the video replaced these with its own
+		if (timecodes_loaded) LoadTimecodes(timecodes);
+		if (keyframes_loaded) LoadKeyframesInBackground(keyframes);
+
+		if (audio_from_video && OPT_GET("Video/Open Audio")->GetBool() && audio_file != video_file && video_provider->HasAudio())
+			DoLoadAudio(video, true);
+	};
+
+	if (!IndexVideoInBackground(video, load_video))
+		load_video();
 }
 
 void Project::DoLoadAudio(agi::fs::path const& path, bool quiet) {
 	if (!progress)
 		progress = new DialogProgress(context->parent);
 
+	std::unique_ptr<agi::AudioProvider> new_provider;
 	try {
 		try {
-			audio_provider = GetAudioProvider(path, *context->path, progress);
+			new_provider = GetAudioProvider(StagedMediaPath(path), *context->path, progress);
 		}
 		catch (agi::UserCancelException const&) { return; }
 		catch (...) {
@@ -286,6 +398,11 @@ void Project::DoLoadAudio(agi::fs::path const& path, bool quiet) {
 		return ShowError(e.GetMessage());
 	}
 
+	// Keep the old provider alive until everything has been told about the
+	// new one, as some listeners may still be reading from it on other threads
+	auto old_provider = std::move(audio_provider);
+	audio_provider = std::move(new_provider);
+
 	SetPath(audio_file, "?audio", "Audio", path);
 	AnnounceAudioProviderModified(audio_provider.get());
 	context->videoController->ResetPlaybackSpeedToDefault();
@@ -302,28 +419,44 @@ void Project::CloseAudio() {
 }
 
 bool Project::DoLoadVideo(agi::fs::path const& path) {
+	auto provider = OpenVideo(path);
+	if (!provider) return false;
+	SetVideoProvider(path, std::move(provider));
+	return true;
+}
+
+std::unique_ptr<AsyncVideoProvider> Project::OpenVideo(agi::fs::path const& path) {
 	if (!progress)
 		progress = new DialogProgress(context->parent);
 
+	video_index_job.reset();
+
 	try {
 		auto old_matrix = context->ass->GetScriptInfo("YCbCr Matrix");
-		video_provider = agi::make_unique<AsyncVideoProvider>(path, old_matrix, context->videoController.get(), progress);
+		bool hw_decode = !context->ass->Properties.disable_hw_decoding;
+		return agi::make_unique<AsyncVideoProvider>(StagedMediaPath(path), old_matrix, hw_decode, context->videoController.get(), progress);
 	}
-	catch (agi::UserCancelException const&) { return false; }
+	catch (agi::UserCancelException const&) { }
 	catch (agi::fs::FileSystemError const& err) {
 		config::mru->Remove("Video", path);
 		ShowError(to_wx(err.GetMessage()));
-		return false;
 	}
 	catch (VideoProviderError const& err) {
 		ShowError(to_wx(err.GetMessage()));
-		return false;
 	}
+	return nullptr;
+}
+
+void Project::SetVideoProvider(agi::fs::path const& path, std::unique_ptr<AsyncVideoProvider> provider) {
+	// The index reads from the current provider, so it can't outlive it
+	scene_index.reset();
+	scene_keyframes.clear();
 
+	video_provider = std::move(provider);
 	AnnounceVideoProviderModified(video_provider.get());
 
 	UpdateVideoProperties(context->ass.get(), video_provider.get(), context->parent);
-	video_provider->LoadSubtitles(context->ass.get());
+	video_provider->LoadSubtitles(context->subsController->Snapshot());
 
 	timecodes = video_provider->GetFPS();
 	keyframes = video_provider->GetKeyFrames();
@@ -342,11 +475,43 @@ bool Project::DoLoadVideo(agi::fs::path const& path) {
 
 	AnnounceKeyframesModified(keyframes);
 	AnnounceTimecodesModified(timecodes);
+
+	if (OPT_GET("Video/Scene Detection/Enabled")->GetBool())
+		scene_index = agi::make_unique<SceneIndex>(context, video_provider.get(), path,
+			[=](std::vector<int> const& found) { ApplySceneKeyframes(found); });
+}
+
+bool Project::IndexVideoInBackground(agi::fs::path const& path, std::function<void ()> loaded) {
+	video_index_job.reset();
+	try {
+		video_index_job = VideoProviderFactory::IndexInBackground(StagedMediaPath(path),
+			[=](int percent) {
+				context->frame->StatusTimeout(fmt_tl("Indexing %s: %d%%", path.filename(), percent));
+			},
+			[=](std::string const& error) {
+				video_index_job.reset();
+				if (!error.empty()) {
+					ShowError(error);
+					return;
+				}
+				context->frame->StatusTimeout(fmt_tl("Finished indexing %s", path.filename()));
+				loaded();
+			});
+	}
+	catch (agi::Exception const& e) {
+		// Leave it to the provider to report whatever's wrong with the file
+		LOG_D("project/video") << "Not indexing in the background: " << e.GetMessage();
+		return false;
+	}
+	if (!video_index_job) return false;
+	indexing_video_file = path;
 	return true;
 }
 
 void Project::LoadVideo(agi::fs::path path) {
 	if (path.empty()) return;
+	// Files which need indexing first are opened once that's finished
+	if (IndexVideoInBackground(path, [=] { LoadVideo(path); })) return;
 	if (!DoLoadVideo(path)) return;
 	if (OPT_GET("Video/Open Audio")->GetBool() && audio_file != video_file && video_provider->HasAudio())
 		DoLoadAudio(video_file, true);
@@ -361,7 +526,10 @@ void Project::LoadVideo(agi::fs::path path) {
 }
 
 void Project::CloseVideo() {
+	video_index_job.reset();
 	AnnounceVideoProviderModified(nullptr);
+	scene_index.reset();
+	scene_keyframes.clear();
 	video_provider.reset();
 	SetPath(video_file, "?video", "", "");
 	video_has_subtitles = false;
@@ -398,14 +566,55 @@ void Project::CloseTimecodes() {
 
 void Project::DoLoadKeyframes(agi::fs::path const& path) {
 	keyframes = agi::keyframe::Load(path);
+	keyframes_load.reset();
 	SetPath(keyframes_file, "", "Keyframes", path);
 	AnnounceKeyframesModified(keyframes);
 }
 
+void Project::LoadKeyframesInBackground(agi::fs::path const& path) {
+	keyframes_load = std::make_shared<KeyframesLoad>(KeyframesLoad{this, path});
+	std::weak_ptr<KeyframesLoad> weak = keyframes_load;
+	agi::dispatch::Background(agi::dispatch::Priority::Bulk).Async([=] {
+		std::vector<int> found;
+		std::exception_ptr error;
+		try {
+			found = agi::keyframe::Load(path);
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+
+		agi::dispatch::Main().Async([=] {
+			// Gone if the project has been closed or something else has been
+			// loaded since
+			auto job = weak.lock();
+			if (!job) return;
+			auto self = job->project;
+			self->keyframes_load.reset();
+			if (error) {
+				self->ReportKeyframesError(error, path);
+				return;
+			}
+			self->keyframes = found;
+			self->SetPath(self->keyframes_file, "", "Keyframes", path);
+			self->AnnounceKeyframesModified(self->keyframes);
+		});
+	});
+}
+
 void Project::LoadKeyframes(agi::fs::path path) {
 	try {
 		DoLoadKeyframes(path);
 	}
+	catch (...) {
+		ReportKeyframesError(std::current_exception(), path);
+	}
+}
+
+void Project::ReportKeyframesError(std::exception_ptr error, agi::fs::path const& path) {
+	try {
+		std::rethrow_exception(error);
+	}
 	catch (agi::fs::FileSystemError const& e) {
 		ShowError(e.GetMessage());
 		config::mru->Remove("Keyframes", path);
@@ -420,8 +629,20 @@ void Project::LoadKeyframes(agi::fs::path path) {
 	}
 }
 
+void Project::ApplySceneKeyframes(std::vector<int> const& found) {
+	scene_keyframes = found;
+	// Keyframes loaded from a file take priority
+	if (!keyframes_file.empty()) return;
+	keyframes = scene_keyframes;
+	AnnounceKeyframesModified(keyframes);
+}
+
 void Project::CloseKeyframes() {
-	keyframes = video_provider ? video_provider->GetKeyFrames() : std::vector<int>{};
+	keyframes_load.reset();
+	if (!scene_keyframes.empty())
+		keyframes = scene_keyframes;
+	else
+		keyframes = video_provider ? video_provider->GetKeyFrames() : std::vector<int>{};
 	SetPath(keyframes_file, "", "", "");
 	AnnounceKeyframesModified(keyframes);
 }
@@ -532,7 +753,11 @@ void Project::LoadList(std::vector<agi::fs::path> const& files) {
 			subs.clear();
 	}
 
-	if (!video.empty() && DoLoadVideo(video)) {
+	// The video is indexed in the background if needed, with what depends
+	// on it loaded once it's open
+	auto load_video = [=] {
+		if (!DoLoadVideo(video)) return;
+
 		double dar = video_provider->GetDAR();
 		if (dar > 0)
 			context->videoController->SetAspectRatio(dar);
@@ -547,13 +772,19 @@ void Project::LoadList(std::vector<agi::fs::path> const& files) {
 			LoadTimecodes(timecodes);
 		if (!keyframes.empty())
 			LoadKeyframes(keyframes);
-	}
+
+		if (audio.empty() && OPT_GET("Video/Open Audio")->GetBool() && audio_file != video_file)
+			DoLoadAudio(video_file, true);
+	};
 
 	if (!audio.empty())
 		DoLoadAudio(audio, false);
-	else if (OPT_GET("Video/Open Audio")->GetBool() && audio_file != video_file)
+	else if (video.empty() && OPT_GET("Video/Open Audio")->GetBool() && audio_file != video_file)
 		DoLoadAudio(video_file, true);
 
+	if (!video.empty() && !IndexVideoInBackground(video, load_video))
+		load_video();
+
 	if (!subs.empty())
 		LoadUnloadFiles(properties);
 }
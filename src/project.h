@@ -19,11 +19,15 @@
 #include <libaegisub/vfr.h>
 
 #include <boost/filesystem/path.hpp>
+#include <exception>
+#include <functional>
 #include <memory>
 #include <vector>
 
 class AsyncVideoProvider;
 class DialogProgress;
+class SceneIndex;
+struct VideoIndexJob;
 class wxString;
 namespace agi { class AudioProvider; }
 namespace agi { struct Context; }
@@ -32,13 +36,26 @@ struct ProjectProperties;
 class Project {
 	std::unique_ptr<agi::AudioProvider> audio_provider;
 	std::unique_ptr<AsyncVideoProvider> video_provider;
+	/// Index being built for the video which will be opened once it's done
+	std::unique_ptr<VideoIndexJob> video_index_job;
+	/// Video which video_index_job is indexing
+	agi::fs::path indexing_video_file;
 	agi::vfr::Framerate timecodes;
 	std::vector<int> keyframes;
+	/// Builds scene_keyframes for the current video, if enabled
+	std::unique_ptr<SceneIndex> scene_index;
+	/// Keyframes found from scene changes, used in place of the video's own
+	/// keyframes when no keyframes file is loaded
+	std::vector<int> scene_keyframes;
 
 	agi::fs::path audio_file;
 	agi::fs::path video_file;
 	agi::fs::path timecodes_file;
 	agi::fs::path keyframes_file;
+	/// Keyframes file being read in the background, which is abandoned if
+	/// this is reset before it's done
+	struct KeyframesLoad;
+	std::shared_ptr<KeyframesLoad> keyframes_load;
 
 	agi::signal::Signal<agi::AudioProvider *> AnnounceAudioProviderModified;
 	agi::signal::Signal<AsyncVideoProvider *> AnnounceVideoProviderModified;
@@ -49,6 +66,7 @@ class Project {
 	DialogProgress *progress = nullptr;
 	agi::Context *context = nullptr;
 	agi::signal::Connection update_properties_connection;
+	agi::signal::Connection media_staged_connection;
 
 	void ShowError(wxString const& message);
 	void ShowError(std::string const& message);
@@ -56,8 +74,21 @@ class Project {
 	bool DoLoadSubtitles(agi::fs::path const& path, std::string encoding, ProjectProperties &properties);
 	void DoLoadAudio(agi::fs::path const& path, bool quiet);
 	bool DoLoadVideo(agi::fs::path const& path);
+	/// Open a video, reporting why it couldn't be opened if it can't
+	std::unique_ptr<AsyncVideoProvider> OpenVideo(agi::fs::path const& path);
+	/// Switch to a newly opened video
+	void SetVideoProvider(agi::fs::path const& path, std::unique_ptr<AsyncVideoProvider> provider);
+	/// @brief Start indexing a video in the background if it needs it
+	/// @param loaded Called once indexing has finished successfully
+	/// @return Was indexing started?
+	bool IndexVideoInBackground(agi::fs::path const& path, std::function<void ()> loaded);
 	void DoLoadTimecodes(agi::fs::path const& path);
 	void DoLoadKeyframes(agi::fs::path const& path);
+	/// Read a keyframes file on a worker thread and use it once it's done
+	void LoadKeyframesInBackground(agi::fs::path const& path);
+	/// Tell the user why a keyframes file couldn't be loaded
+	void ReportKeyframesError(std::exception_ptr error, agi::fs::path const& path);
+	void ApplySceneKeyframes(std::vector<int> const& keyframes);
 
 	void LoadUnloadFiles(ProjectProperties properties);
 	void UpdateRelativePaths();
@@ -80,6 +111,12 @@ public:
 
 	void LoadVideo(agi::fs::path path);
 	void ReloadVideo();
+	/// @brief Reload the video for the user
+	///
+	/// Scripts are opened again alongside the current video, which is kept
+	/// along with everything cached from it if the script still makes the
+	/// same frames.
+	void ReloadVideoIfChanged();
 	void CloseVideo();
 	AsyncVideoProvider *VideoProvider() const { return video_provider.get(); }
 	agi::fs::path const& VideoName() const { return video_file; }
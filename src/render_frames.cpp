@@ -0,0 +1,812 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include "render_frames.h"
+
+#include "ass_file.h"
+#include "ass_snapshot.h"
+#include "compat.h"
+#include "include/aegisub/subtitles_provider.h"
+#include "include/aegisub/video_provider.h"
+#include "subtitle_format.h"
+#include "video_frame.h"
+#include "video_provider_manager.h"
+
+#include <libaegisub/ass/time.h>
+#include <libaegisub/background_runner.h>
+#include <libaegisub/charset.h>
+#include <libaegisub/dispatch.h>
+#include <libaegisub/exception.h>
+#include <libaegisub/file_mapping.h>
+#include <libaegisub/format.h>
+#include <libaegisub/fs.h>
+#include <libaegisub/log.h>
+#include <libaegisub/make_unique.h>
+#include <libaegisub/split.h>
+#include <libaegisub/util.h>
+#include <libaegisub/vfr.h>
+
+#include <algorithm>
+#include <boost/algorithm/string/predicate.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+#include <thread>
+#include <wx/image.h>
+#include <wx/log.h>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace {
+using clock = std::chrono::steady_clock;
+
+long long ms(clock::duration d) {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+}
+
+const char usage[] =
+	"Usage: aegisub --render [options] [SUBTITLES]\n"
+	"\n"
+	"  --video FILE          Video to render onto, instead of the one the subtitles\n"
+	"                        were last used with\n"
+	"  --frames LIST         Frames to render, as a comma-separated list of frame\n"
+	"                        numbers and FIRST-LAST ranges; a range may be followed by\n"
+	"                        /STEP to take every STEPth frame\n"
+	"  --times LIST          Times to render the frames at, as a comma-separated list\n"
+	"                        of H:MM:SS.cc\n"
+	"  --output-dir DIR      Directory to write a PNG of each frame to\n"
+	"  --contact-sheet FILE  Write every frame scaled down into a single PNG\n"
+	"  --columns N           Frames per row of the contact sheet (default 4)\n"
+	"  --thumb-width N       Width of each frame in the contact sheet (default 320)\n"
+	"  --y4m FILE            Write the frames as a YUV4MPEG2 stream, or to stdout\n"
+	"                        if FILE is -; every frame is written if none are given\n"
+	"  --encoder COMMAND     Pipe the YUV4MPEG2 stream to COMMAND, e.g.\n"
+	"                        \"ffmpeg -i - -c:v libx264 out.mp4\"\n"
+	"  --jobs N              Number of video and subtitle renderers to run at once\n"
+	"                        (default one per core)\n";
+
+struct Options {
+	agi::fs::path subtitles;
+	agi::fs::path video;
+	std::vector<std::string> frames;
+	std::vector<std::string> times;
+	agi::fs::path output_dir;
+	agi::fs::path contact_sheet;
+	std::string y4m;
+	std::string encoder;
+	int columns = 4;
+	int thumb_width = 320;
+	int jobs = 0;
+};
+
+bool ParseInt(std::string const& str, int& out) {
+	return agi::util::try_parse(str, &out) && out >= 0;
+}
+
+bool ParseArgs(std::vector<std::string> const& args, Options& opt) {
+	for (size_t i = 0; i < args.size(); ++i) {
+		auto const& arg = args[i];
+		if (arg == "--render") continue;
+		if (!boost::starts_with(arg, "--")) {
+			if (!opt.subtitles.empty()) {
+				fputs("Only one subtitle file can be rendered at a time\n", stderr);
+				return false;
+			}
+			opt.subtitles = arg;
+			continue;
+		}
+
+		if (i + 1 == args.size()) {
+			fprintf(stderr, "Missing value for %s\n", arg.c_str());
+			return false;
+		}
+		auto const& value = args[++i];
+		bool valid = true;
+		if (arg == "--video")
+			opt.video = value;
+		else if (arg == "--frames")
+			opt.frames.push_back(value);
+		else if (arg == "--times")
+			opt.times.push_back(value);
+		else if (arg == "--output-dir")
+			opt.output_dir = value;
+		else if (arg == "--contact-sheet")
+			opt.contact_sheet = value;
+		else if (arg == "--y4m")
+			opt.y4m = value;
+		else if (arg == "--encoder")
+			opt.encoder = value;
+		else if (arg == "--columns")
+			valid = ParseInt(value, opt.columns) && opt.columns > 0;
+		else if (arg == "--thumb-width")
+			valid = ParseInt(value, opt.thumb_width) && opt.thumb_width > 0;
+		else if (arg == "--jobs")
+			valid = ParseInt(value, opt.jobs) && opt.jobs > 0;
+		else {
+			fprintf(stderr, "Unknown option %s\n", arg.c_str());
+			return false;
+		}
+
+		if (!valid) {
+			fprintf(stderr, "Invalid value for %s: %s\n", arg.c_str(), value.c_str());
+			return false;
+		}
+	}
+
+	if (opt.subtitles.empty() && opt.video.empty()) {
+		fputs("A subtitle file or a video is required\n", stderr);
+		return false;
+	}
+	const bool stream = !opt.y4m.empty() || !opt.encoder.empty();
+	if (stream) {
+		if (!opt.y4m.empty() && !opt.encoder.empty()) {
+			fputs("Only one of --y4m and --encoder can be used\n", stderr);
+			return false;
+		}
+		if (!opt.output_dir.empty() || !opt.contact_sheet.empty()) {
+			fputs("A video stream can't be written along with images\n", stderr);
+			return false;
+		}
+		return true;
+	}
+	if (opt.frames.empty() && opt.times.empty()) {
+		fputs("At least one frame or time to render is required\n", stderr);
+		return false;
+	}
+	if (opt.output_dir.empty() && opt.contact_sheet.empty()) {
+		fputs("An output directory, a contact sheet or a video stream is required\n", stderr);
+		return false;
+	}
+	return true;
+}
+
+/// Add the frames named by a --frames argument to frames
+bool ParseFrames(std::string const& list, int frame_count, std::vector<int>& frames) {
+	for (auto range : agi::Split(list, ',')) {
+		std::string item(range.begin(), range.end());
+		int step = 1;
+		auto slash = item.find('/');
+		if (slash != std::string::npos) {
+			if (!ParseInt(item.substr(slash + 1), step) || step == 0)
+				return false;
+			item.erase(slash);
+		}
+
+		int first, last;
+		auto dash = item.find('-');
+		if (dash == std::string::npos) {
+			if (!ParseInt(item, first))
+				return false;
+			last = first;
+		}
+		else if (!ParseInt(item.substr(0, dash), first) || !ParseInt(item.substr(dash + 1), last) || last < first)
+			return false;
+
+		last = std::min(last, frame_count - 1);
+		for (int frame = first; frame <= last; frame += step)
+			frames.push_back(frame);
+	}
+	return true;
+}
+
+/// Runs tasks on the calling thread, writing their progress to stderr
+class ConsoleRunner final : public agi::BackgroundRunner, agi::ProgressSink {
+	int last_percent = -1;
+
+	void SetIndeterminate() override { }
+	void SetTitle(std::string const& title) override {
+		fprintf(stderr, "%s\n", title.c_str());
+	}
+	void SetMessage(std::string const& msg) override {
+		fprintf(stderr, "%s\n", msg.c_str());
+	}
+	void SetProgress(int64_t cur, int64_t max) override {
+		if (max <= 0) return;
+		int percent = static_cast<int>(cur * 100 / max);
+		if (percent / 10 == last_percent / 10) return;
+		last_percent = percent;
+		fprintf(stderr, "%d%%\n", percent);
+	}
+	void Log(std::string const& str) override { fputs(str.c_str(), stderr); }
+	void SetStayOpen(bool) override { }
+	bool IsCancelled() override { return false; }
+
+public:
+	void Run(std::function<void(agi::ProgressSink *)> task) override {
+		last_percent = -1;
+		task(this);
+	}
+};
+
+/// The video and subtitle renderers used by one worker
+struct Renderer {
+	std::unique_ptr<VideoProvider> video;
+	std::unique_ptr<SubtitlesProvider> subs;
+};
+
+void OpenRenderer(Renderer& r, agi::fs::path const& video, std::string const& matrix,
+	bool hw_decode, AssSnapshot const *subs, agi::BackgroundRunner *br) {
+	r.video = VideoProviderFactory::GetProvider(video, matrix, hw_decode, br);
+	if (subs) {
+		r.subs = SubtitlesProviderFactory::GetProvider(br);
+		r.subs->LoadSubtitles(*subs);
+	}
+}
+
+/// Time spent on each stage by one worker
+struct Timing {
+	clock::duration decode{0};
+	clock::duration subtitles{0};
+	clock::duration write{0};
+	size_t frames = 0;
+};
+
+/// Coefficients for converting RGB to Y'CbCr
+struct YCbCrMatrix {
+	float kr = 0.299f;
+	float kb = 0.114f;
+	bool full_range = false;
+};
+
+/// Get the matrix which the video provider used to convert the video to
+/// RGB, so that converting back gives the original values
+YCbCrMatrix GetMatrix(std::string const& colorspace, int width, int height) {
+	YCbCrMatrix m;
+	m.full_range = boost::starts_with(colorspace, "PC.");
+	if (boost::ends_with(colorspace, ".709") || (!boost::ends_with(colorspace, ".601") && (width > 1024 || height >= 600))) {
+		m.kr = 0.2126f;
+		m.kb = 0.0722f;
+	}
+	if (boost::ends_with(colorspace, ".FCC")) {
+		m.kr = 0.30f;
+		m.kb = 0.11f;
+	}
+	else if (boost::ends_with(colorspace, ".240M")) {
+		m.kr = 0.212f;
+		m.kb = 0.087f;
+	}
+	return m;
+}
+
+unsigned char Clamp(float value) {
+	return static_cast<unsigned char>(std::min(255.f, std::max(0.f, value + 0.5f)));
+}
+
+/// Size of a frame in 4:2:0 with each chroma sample centered between four
+/// luma samples
+size_t YUV420Size(size_t width, size_t height) {
+	return width * height + 2 * ((width + 1) / 2) * ((height + 1) / 2);
+}
+
+void ConvertToYUV420(VideoFrame const& src, YCbCrMatrix const& m, unsigned char *dst) {
+	const size_t w = src.width, h = src.height;
+	const size_t cw = (w + 1) / 2, ch = (h + 1) / 2;
+	unsigned char *y_plane = dst;
+	unsigned char *cb_plane = y_plane + w * h;
+	unsigned char *cr_plane = cb_plane + cw * ch;
+
+	const float kg = 1.f - m.kr - m.kb;
+	const float y_scale = (m.full_range ? 255.f : 219.f) / 255.f;
+	const float y_offset = m.full_range ? 0.f : 16.f;
+	const float c_scale = (m.full_range ? 255.f : 224.f) / 255.f;
+	const float cb_scale = c_scale / (2.f * (1.f - m.kb));
+	const float cr_scale = c_scale / (2.f * (1.f - m.kr));
+
+	for (size_t y = 0; y < h; ++y) {
+		const unsigned char *p = src.PixelAt(0, y);
+		unsigned char *out = y_plane + y * w;
+		for (size_t x = 0; x < w; ++x, p += 4)
+			out[x] = Clamp(y_offset + (m.kr * p[2] + kg * p[1] + m.kb * p[0]) * y_scale);
+	}
+
+	for (size_t cy = 0; cy < ch; ++cy) {
+		const unsigned char *row0 = src.PixelAt(0, cy * 2);
+		const unsigned char *row1 = src.PixelAt(0, std::min(cy * 2 + 1, h - 1));
+		for (size_t cx = 0; cx < cw; ++cx) {
+			const size_t x0 = cx * 8, x1 = std::min(cx * 2 + 1, w - 1) * 4;
+			const float b = (row0[x0] + row0[x1] + row1[x0] + row1[x1]) / 4.f;
+			const float g = (row0[x0 + 1] + row0[x1 + 1] + row1[x0 + 1] + row1[x1 + 1]) / 4.f;
+			const float r = (row0[x0 + 2] + row0[x1 + 2] + row1[x0 + 2] + row1[x1 + 2]) / 4.f;
+			const float luma = m.kr * r + kg * g + m.kb * b;
+			cb_plane[cy * cw + cx] = Clamp(128.f + (b - luma) * cb_scale);
+			cr_plane[cy * cw + cx] = Clamp(128.f + (r - luma) * cr_scale);
+		}
+	}
+}
+
+/// Express a frame rate as the ratio YUV4MPEG2 headers want
+std::pair<int64_t, int64_t> FrameRateRatio(double fps) {
+	// Nearly everything is either a whole number or NTSC-style n/1001
+	for (int64_t den : {1, 1001}) {
+		const int64_t num = std::llround(fps * den);
+		if (std::abs(double(num) / den - fps) < 1e-6 * fps)
+			return {num, den};
+	}
+	const int64_t num = std::llround(fps * 1000);
+	const int64_t div = std::gcd<int64_t>(num, 1000);
+	return {num / div, 1000 / div};
+}
+
+/// Where the YUV4MPEG2 stream goes
+class StreamOutput {
+	FILE *file = nullptr;
+	bool is_pipe = false;
+
+public:
+	StreamOutput(Options const& opt) {
+		if (!opt.encoder.empty()) {
+#ifdef _WIN32
+			file = _popen(opt.encoder.c_str(), "wb");
+#else
+			file = popen(opt.encoder.c_str(), "w");
+#endif
+			is_pipe = true;
+			if (!file)
+				throw agi::InvalidInputException("Could not run encoder: " + opt.encoder);
+		}
+		else if (opt.y4m == "-") {
+#ifdef _WIN32
+			_setmode(_fileno(stdout), _O_BINARY);
+#endif
+			file = stdout;
+		}
+		else {
+#ifdef _WIN32
+			file = _wfopen(agi::fs::path(opt.y4m).c_str(), L"wb");
+#else
+			file = fopen(opt.y4m.c_str(), "wb");
+#endif
+			if (!file)
+				throw agi::fs::WriteDenied(opt.y4m);
+		}
+	}
+
+	~StreamOutput() {
+		if (file) Close();
+	}
+
+	void Write(const void *data, size_t len) {
+		if (fwrite(data, 1, len, file) != len)
+			throw agi::InvalidInputException(is_pipe ? "The encoder stopped reading frames" : "Could not write the video");
+	}
+
+	/// @return Did the encoder exit successfully?
+	bool Close() {
+		FILE *f = file;
+		file = nullptr;
+		if (f == stdout)
+			return fflush(f) == 0;
+#ifdef _WIN32
+		return is_pipe ? _pclose(f) == 0 : fclose(f) == 0;
+#else
+		return is_pipe ? pclose(f) == 0 : fclose(f) == 0;
+#endif
+	}
+};
+
+/// Decode the frames in order, draw the subtitles onto them and convert them
+/// to Y'CbCr in parallel, and write them out as a YUV4MPEG2 stream
+///
+/// Seeking is far slower than decoding forwards, so a single video provider
+/// decodes every frame and only the subtitle rendering and conversion, which
+/// are normally the slowest parts, are split between the workers, each of
+/// which has its own subtitle renderer. Decoding the next batch of frames
+/// and writing the previous one happen while the current one is rendered.
+int EncodeVideo(Options const& opt, VideoProvider& video, std::vector<std::unique_ptr<SubtitlesProvider>>& subs,
+	size_t jobs, std::vector<int> const& frames, clock::time_point start) {
+	// Reports can't go to stdout when the video does
+	FILE *report = opt.y4m == "-" ? stderr : stdout;
+
+	const auto fps = video.GetFPS();
+	if (fps.IsVFR())
+		fputs("The video has a variable frame rate, which YUV4MPEG2 can't store; "
+			"the average frame rate will be used\n", stderr);
+
+	const int width = video.GetWidth();
+	const int height = video.GetHeight();
+	const auto matrix = GetMatrix(video.GetColorSpace(), width, height);
+	const auto rate = FrameRateRatio(fps.FPS());
+
+	// Pixel aspect ratio from the display aspect ratio, if it's known
+	int64_t sar_num = 0, sar_den = 0;
+	if (video.GetDAR() > 0) {
+		sar_num = std::llround(video.GetDAR() * height * 1000);
+		sar_den = int64_t(width) * 1000;
+		const int64_t div = std::gcd(sar_num, sar_den);
+		sar_num /= div;
+		sar_den /= div;
+	}
+
+	const size_t frame_size = YUV420Size(width, height);
+	const size_t batch_size = jobs * 2;
+	const size_t batch_count = (frames.size() + batch_size - 1) / batch_size;
+
+	struct Batch {
+		std::vector<VideoFrame> decoded;
+		std::vector<unsigned char> encoded;
+		size_t first = 0;
+		size_t count = 0;
+	};
+	// A batch is decoded, rendered and written in successive steps, so one
+	// of each is in flight at a time
+	Batch batches[3];
+	for (auto& batch : batches) {
+		batch.decoded.resize(batch_size);
+		batch.encoded.resize(batch_size * frame_size);
+	}
+
+	clock::duration decode_time{0}, write_time{0};
+	auto decode = [&](size_t index) {
+		auto stage = clock::now();
+		auto& batch = batches[index % 3];
+		batch.first = index * batch_size;
+		batch.count = std::min(batch_size, frames.size() - batch.first);
+		for (size_t i = 0; i < batch.count; ++i)
+			video.GetFrame(frames[batch.first + i], batch.decoded[i]);
+		decode_time += clock::now() - stage;
+	};
+
+	std::unique_ptr<StreamOutput> out;
+	try {
+		out = agi::make_unique<StreamOutput>(opt);
+	}
+	catch (agi::Exception const& e) {
+		fprintf(stderr, "%s\n", e.GetMessage().c_str());
+		return 1;
+	}
+
+	auto write = [&](size_t index) {
+		auto stage = clock::now();
+		auto const& batch = batches[index % 3];
+		static const char frame_header[] = "FRAME\n";
+		for (size_t i = 0; i < batch.count; ++i) {
+			out->Write(frame_header, sizeof(frame_header) - 1);
+			out->Write(&batch.encoded[i * frame_size], frame_size);
+		}
+		write_time += clock::now() - stage;
+	};
+
+	std::vector<clock::duration> render_time(jobs, clock::duration{0});
+	auto render = [&](size_t index) {
+		auto& batch = batches[index % 3];
+		agi::dispatch::Parallel(jobs, [&](size_t job) {
+			auto stage = clock::now();
+			for (size_t i = job; i < batch.count; i += jobs) {
+				auto& frame = batch.decoded[i];
+				if (!subs.empty())
+					subs[job]->DrawSubtitles(frame, fps.TimeAtFrame(frames[batch.first + i]) / 1000.);
+				ConvertToYUV420(frame, matrix, &batch.encoded[i * frame_size]);
+			}
+			render_time[job] += clock::now() - stage;
+		});
+	};
+
+	auto render_start = clock::now();
+	try {
+		std::string header = agi::format("YUV4MPEG2 W%d H%d F%d:%d Ip A%d:%d C420jpeg XCOLORRANGE=%s\n",
+			width, height, rate.first, rate.second, sar_num, sar_den, matrix.full_range ? "FULL" : "LIMITED");
+		out->Write(header.data(), header.size());
+
+		decode(0);
+		for (size_t index = 0; index <= batch_count; ++index) {
+			agi::dispatch::TaskGroup group(agi::dispatch::Priority::Bulk);
+			if (index + 1 < batch_count)
+				group.Run([&, index] { decode(index + 1); });
+			if (index > 0)
+				group.Run([&, index] { write(index - 1); });
+			if (index < batch_count)
+				render(index);
+			group.Wait();
+		}
+	}
+	catch (agi::Exception const& e) {
+		fprintf(stderr, "%s\n", e.GetMessage().c_str());
+		out->Close();
+		return 1;
+	}
+	catch (std::exception const& e) {
+		fprintf(stderr, "%s\n", e.what());
+		out->Close();
+		return 1;
+	}
+
+	if (!out->Close()) {
+		fputs(opt.encoder.empty() ? "Could not write the video\n" : "The encoder failed\n", stderr);
+		return 1;
+	}
+
+	auto now = clock::now();
+	for (size_t job = 0; job < jobs; ++job)
+		fprintf(report, "worker %d: subtitles and conversion %lld ms\n", static_cast<int>(job), ms(render_time[job]));
+	const double seconds = std::max(1ll, ms(now - render_start)) / 1000.;
+	fprintf(report, "Encoded %d frames with %d workers in %lld ms (decode %lld ms, write %lld ms): %.1f frames/s\n",
+		static_cast<int>(frames.size()), static_cast<int>(jobs), ms(now - start),
+		ms(decode_time), ms(write_time), frames.size() / seconds);
+	fflush(report);
+	LOG_I("render") << "Encoded " << frames.size() << " frames";
+	return 0;
+}
+}
+
+namespace render_frames {
+bool Requested(std::vector<std::string> const& args) {
+	return std::find(begin(args), end(args), "--render") != end(args);
+}
+
+int Run(std::vector<std::string> const& args) {
+	Options opt;
+	if (!ParseArgs(args, opt)) {
+		fputs(usage, stderr);
+		return 2;
+	}
+
+	// Nothing is shown, so send any errors which would normally pop up a
+	// message box to stderr instead
+	delete wxLog::SetActiveTarget(new wxLogStderr);
+
+	auto start = clock::now();
+
+	AssFile subs;
+	std::shared_ptr<const AssSnapshot> snapshot;
+	if (!opt.subtitles.empty()) {
+		try {
+			agi::file_open_scope open_file(opt.subtitles);
+			auto charset = agi::charset::Detect(opt.subtitles);
+			auto reader = SubtitleFormat::GetReader(opt.subtitles, charset);
+			reader->ReadFile(&subs, opt.subtitles, agi::vfr::Framerate(), charset);
+		}
+		catch (agi::Exception const& e) {
+			fprintf(stderr, "%s: %s\n", opt.subtitles.string().c_str(), e.GetMessage().c_str());
+			return 1;
+		}
+		snapshot = AssSnapshot::Create(subs);
+
+		// Use the video the subtitles were last worked on with, which is
+		// stored relative to the subtitle file
+		if (opt.video.empty() && !subs.Properties.video_file.empty()) {
+			opt.video = agi::fs::path(subs.Properties.video_file).make_preferred();
+			if (opt.video.is_relative())
+				opt.video = opt.subtitles.parent_path()/opt.video;
+		}
+	}
+	if (opt.video.empty()) {
+		fputs("The subtitles do not name a video file; use --video\n", stderr);
+		return 1;
+	}
+
+	const auto matrix = subs.GetScriptInfo("YCbCr Matrix");
+	const bool hw_decode = !subs.Properties.disable_hw_decoding;
+
+	// The first renderer is opened by itself so that the video is indexed
+	// (and the index cached) just once, and fonts are only scanned once,
+	// before the rest are opened in parallel
+	ConsoleRunner runner;
+	std::vector<Renderer> renderers(1);
+	try {
+		OpenRenderer(renderers[0], opt.video, matrix, hw_decode, snapshot.get(), &runner);
+	}
+	catch (agi::Exception const& e) {
+		fprintf(stderr, "%s: %s\n", opt.video.string().c_str(), e.GetMessage().c_str());
+		return 1;
+	}
+
+	auto const& video = *renderers[0].video;
+	const auto fps = video.GetFPS();
+	const int frame_count = video.GetFrameCount();
+
+	std::vector<int> frames;
+	for (auto const& list : opt.frames) {
+		if (!ParseFrames(list, frame_count, frames)) {
+			fprintf(stderr, "Invalid frame list: %s\n", list.c_str());
+			return 2;
+		}
+	}
+	for (auto const& list : opt.times) {
+		for (auto time : agi::Split(list, ','))
+			frames.push_back(fps.FrameAtTime(agi::Time(std::string(time.begin(), time.end()))));
+	}
+
+	// Render in frame order so that each worker decodes a contiguous run of
+	// the video rather than seeking back and forth
+	frames.erase(std::remove_if(begin(frames), end(frames), [&](int f) { return f < 0 || f >= frame_count; }), end(frames));
+	std::sort(begin(frames), end(frames));
+	frames.erase(std::unique(begin(frames), end(frames)), end(frames));
+	if (frames.empty() && opt.frames.empty() && opt.times.empty()) {
+		frames.resize(frame_count);
+		std::iota(begin(frames), end(frames), 0);
+	}
+	if (frames.empty()) {
+		fputs("None of the requested frames are in the video\n", stderr);
+		return 1;
+	}
+
+	size_t jobs = opt.jobs ? opt.jobs : std::max(1u, std::thread::hardware_concurrency());
+	jobs = std::min(jobs, frames.size());
+
+	if (!opt.y4m.empty() || !opt.encoder.empty()) {
+		// Only one video provider is needed, but each worker gets its
+		// own subtitle renderer
+		std::vector<std::unique_ptr<SubtitlesProvider>> subs;
+		if (snapshot) {
+			subs.resize(jobs);
+			subs[0] = std::move(renderers[0].subs);
+			std::vector<std::string> errors(jobs);
+			agi::dispatch::Parallel(jobs - 1, [&](size_t i) {
+				ConsoleRunner br;
+				try {
+					subs[i + 1] = SubtitlesProviderFactory::GetProvider(&br);
+					subs[i + 1]->LoadSubtitles(*snapshot);
+				}
+				catch (agi::Exception const& e) {
+					errors[i + 1] = e.GetMessage();
+				}
+			});
+			for (auto const& err : errors) {
+				if (!err.empty()) {
+					fprintf(stderr, "%s\n", err.c_str());
+					return 1;
+				}
+			}
+		}
+		return EncodeVideo(opt, *renderers[0].video, subs, jobs, frames, start);
+	}
+
+	try {
+		if (!opt.output_dir.empty())
+			agi::fs::CreateDirectory(opt.output_dir);
+	}
+	catch (agi::Exception const& e) {
+		fprintf(stderr, "%s\n", e.GetMessage().c_str());
+		return 1;
+	}
+
+	renderers.resize(jobs);
+
+	auto open_start = clock::now();
+	std::vector<std::string> open_errors(jobs);
+	agi::dispatch::Parallel(jobs - 1, [&](size_t i) {
+		// Indexing and font scanning have already been done, so nothing
+		// should need to report progress
+		ConsoleRunner br;
+		try {
+			OpenRenderer(renderers[i + 1], opt.video, matrix, hw_decode, snapshot.get(), &br);
+		}
+		catch (agi::Exception const& e) {
+			open_errors[i + 1] = e.GetMessage();
+		}
+	});
+	for (auto const& err : open_errors) {
+		if (!err.empty()) {
+			fprintf(stderr, "%s: %s\n", opt.video.string().c_str(), err.c_str());
+			return 1;
+		}
+	}
+	auto open_time = clock::now() - open_start;
+
+	const int width = video.GetWidth();
+	const int height = video.GetHeight();
+	const double dar = video.GetDAR() > 0 ? video.GetDAR() : double(width) / height;
+	const int thumb_height = std::max(1, static_cast<int>(opt.thumb_width / dar + 0.5));
+	const int columns = std::min<int>(opt.columns, frames.size());
+	const int rows = (frames.size() + columns - 1) / columns;
+
+	// Each worker copies its thumbnails into its own cells of the sheet, so
+	// no locking is needed
+	wxImage sheet;
+	unsigned char *sheet_data = nullptr;
+	if (!opt.contact_sheet.empty()) {
+		sheet.Create(columns * opt.thumb_width, rows * thumb_height, true);
+		sheet_data = sheet.GetData();
+	}
+
+	std::vector<Timing> timing(jobs);
+	std::vector<std::string> errors(jobs);
+	auto render_start = clock::now();
+	agi::dispatch::Parallel(jobs, [&](size_t job) {
+		auto& r = renderers[job];
+		auto& t = timing[job];
+		const size_t first = frames.size() * job / jobs;
+		const size_t last = frames.size() * (job + 1) / jobs;
+
+		VideoFrame frame;
+		try {
+			for (size_t i = first; i < last; ++i) {
+				const int n = frames[i];
+
+				auto stage = clock::now();
+				r.video->GetFrame(n, frame);
+				auto now = clock::now();
+				t.decode += now - stage;
+				stage = now;
+
+				if (r.subs)
+					r.subs->DrawSubtitles(frame, fps.TimeAtFrame(n) / 1000.);
+				now = clock::now();
+				t.subtitles += now - stage;
+				stage = now;
+
+				auto img = GetImage(frame);
+				if (!opt.output_dir.empty()) {
+					// PNG encoding is usually the slowest stage, and the files
+					// are only for checking, so favor speed over size
+					img.SetOption(wxIMAGE_OPTION_PNG_COMPRESSION_LEVEL, 1);
+					auto path = opt.output_dir/agi::format("frame_%06d.png", n);
+					if (!img.SaveFile(to_wx(path.string()), wxBITMAP_TYPE_PNG))
+						throw agi::fs::WriteDenied(path);
+				}
+				if (sheet_data) {
+					auto thumb = img.Scale(opt.thumb_width, thumb_height, wxIMAGE_QUALITY_BILINEAR);
+					const size_t row_bytes = opt.thumb_width * 3;
+					const size_t sheet_pitch = columns * row_bytes;
+					unsigned char *dst = sheet_data + (i / columns) * thumb_height * sheet_pitch + (i % columns) * row_bytes;
+					const unsigned char *src = thumb.GetData();
+					for (int y = 0; y < thumb_height; ++y)
+						memcpy(dst + y * sheet_pitch, src + y * row_bytes, row_bytes);
+				}
+				t.write += clock::now() - stage;
+				++t.frames;
+			}
+		}
+		catch (agi::Exception const& e) {
+			errors[job] = e.GetMessage();
+		}
+		catch (std::exception const& e) {
+			errors[job] = e.what();
+		}
+	});
+	auto render_time = clock::now() - render_start;
+
+	int failed = 0;
+	Timing total;
+	for (size_t job = 0; job < jobs; ++job) {
+		auto const& t = timing[job];
+		printf("worker %d: %d frames, decode %lld ms, subtitles %lld ms, write %lld ms\n",
+			static_cast<int>(job), static_cast<int>(t.frames), ms(t.decode), ms(t.subtitles), ms(t.write));
+		if (!errors[job].empty()) {
+			++failed;
+			printf("worker %d: failed: %s\n", static_cast<int>(job), errors[job].c_str());
+		}
+		total.frames += t.frames;
+		total.decode += t.decode;
+		total.subtitles += t.subtitles;
+		total.write += t.write;
+	}
+
+	if (sheet_data) {
+		printf("Contact sheet %s: %d columns, %d rows, in frame order:", opt.contact_sheet.string().c_str(), columns, rows);
+		for (int n : frames)
+			printf(" %d", n);
+		printf("\n");
+		sheet.SetOption(wxIMAGE_OPTION_PNG_COMPRESSION_LEVEL, 6);
+		if (!sheet.SaveFile(to_wx(opt.contact_sheet.string()), wxBITMAP_TYPE_PNG)) {
+			fprintf(stderr, "Could not write %s\n", opt.contact_sheet.string().c_str());
+			++failed;
+		}
+	}
+
+	const double render_seconds = std::max(1ll, ms(render_time)) / 1000.;
+	const double busy_seconds = std::max(1ll, ms(total.decode + total.subtitles + total.write)) / 1000.;
+	printf("Rendered %d of %d frames with %d workers in %lld ms (%lld ms opening): %.1f frames/s, %.1f frames/s per worker\n",
+		static_cast<int>(total.frames), static_cast<int>(frames.size()), static_cast<int>(jobs),
+		ms(clock::now() - start), ms(open_time), total.frames / render_seconds, total.frames / busy_seconds);
+	fflush(stdout);
+	LOG_I("render") << "Rendered " << total.frames << " frames of " << opt.video;
+	return failed ? 1 : 0;
+}
+}
@@ -0,0 +1,37 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file render_frames.h
+/// @brief Rendering of subtitled video frames from the command line without a UI
+/// @ingroup main
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace render_frames {
+	/// Does the command line ask for frames to be rendered rather than
+	/// opening the UI?
+	/// @param args Command line arguments, not including the program name
+	bool Requested(std::vector<std::string> const& args);
+
+	/// Open the video and subtitles named on the command line, draw the
+	/// subtitles onto each of the requested frames, and write them out as
+	/// PNG files and/or a contact sheet, reporting the throughput on stdout
+	/// @param args Command line arguments, not including the program name
+	/// @return Process exit code
+	int Run(std::vector<std::string> const& args);
+}
@@ -0,0 +1,141 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include "render_profile.h"
+
+#include "ass_dialogue.h"
+#include "ass_file.h"
+#include "async_video_provider.h"
+#include "include/aegisub/context.h"
+#include "project.h"
+#include "video_controller.h"
+
+#include <libaegisub/dispatch.h>
+#include <libaegisub/trace.h>
+
+#include <algorithm>
+
+struct RenderProfile::State {
+	/// Set to null when the profile is destroyed
+	RenderProfile *profile = nullptr;
+	/// Incremented whenever results which are being measured are no longer
+	/// wanted
+	size_t generation = 0;
+};
+
+RenderProfile::RenderProfile(agi::Context *c)
+: state(std::make_shared<State>())
+, context(c)
+{
+	state->profile = this;
+	connections = agi::signal::make_vector({
+		c->ass->AddChangesListener(&RenderProfile::OnCommit, this),
+	});
+}
+
+RenderProfile::~RenderProfile() {
+	state->profile = nullptr;
+}
+
+void RenderProfile::OnCommit(AssFileChanges const& changes) {
+	AGI_TRACE_ZONE("commit", "RenderProfile");
+	if (frame < 0 && !running) return;
+
+	// Results are by line ID, so lines moving around doesn't matter, but
+	// anything which may have changed how the lines look does
+	const int type = changes.type;
+	const int global = AssFile::COMMIT_STYLES | AssFile::COMMIT_SCRIPTINFO;
+	// The results being measured are for the old version of the lines
+	const bool edited = (type & AssFile::COMMIT_DIAG_FULL) && (running || !changes.modified_known);
+	if (changes.Everything() || (type & global) || edited) {
+		Reset();
+		return;
+	}
+
+	// Still let the list of lines be rebuilt if any were moved or deleted
+	bool changed = (type & AssFile::COMMIT_ORDER) != 0;
+	for (int id : changes.removed)
+		changed = costs.erase(id) || changed;
+	for (auto line : changes.modified)
+		changed = costs.erase(line->Id) || changed;
+	if (changed)
+		Changed();
+}
+
+void RenderProfile::Reset() {
+	++state->generation;
+	costs.clear();
+	frame = -1;
+	running = false;
+	Changed();
+}
+
+void RenderProfile::Run() {
+	auto provider = context->project->VideoProvider();
+	if (!provider) return;
+
+	Reset();
+
+	// The rows the provider reports are those of the file as it is now, as
+	// anything committed later is loaded into it after profiling
+	std::vector<int> row_ids;
+	for (auto const& line : context->ass->Events) {
+		if (static_cast<size_t>(line.Row) >= row_ids.size())
+			row_ids.resize(line.Row + 1, -1);
+		row_ids[line.Row] = line.Id;
+	}
+
+	const int profiled_frame = context->videoController->GetFrameN();
+	const size_t generation = state->generation;
+	running = true;
+	Changed();
+
+	auto state = this->state;
+	provider->ProfileLines(context->videoController->TimeAtFrame(profiled_frame),
+		[=](std::vector<AsyncVideoProvider::LineRenderCost> results) {
+			agi::dispatch::Main().Async([=] {
+				auto profile = state->profile;
+				if (!profile || state->generation != generation) return;
+
+				for (auto const& result : results) {
+					if (result.row < row_ids.size() && row_ids[result.row] >= 0)
+						profile->costs[row_ids[result.row]] = result.ms;
+				}
+				profile->frame = profiled_frame;
+				profile->running = false;
+				profile->Changed();
+			});
+		});
+}
+
+double RenderProfile::Cost(const AssDialogue *line) const {
+	auto it = costs.find(line->Id);
+	return it == costs.end() ? -1. : it->second;
+}
+
+std::vector<std::pair<AssDialogue *, double>> RenderProfile::Lines() const {
+	std::vector<std::pair<AssDialogue *, double>> lines;
+	if (costs.empty()) return lines;
+
+	for (auto& line : context->ass->Events) {
+		auto it = costs.find(line.Id);
+		if (it != costs.end())
+			lines.emplace_back(&line, it->second);
+	}
+	std::stable_sort(lines.begin(), lines.end(), [](std::pair<AssDialogue *, double> const& a, std::pair<AssDialogue *, double> const& b) {
+		return a.second > b.second;
+	});
+	return lines;
+}
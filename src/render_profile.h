@@ -0,0 +1,79 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file render_profile.h
+/// @brief Per-line subtitle rendering costs of a frame
+
+#pragma once
+
+#include <libaegisub/signal.h>
+
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class AssDialogue;
+struct AssFileChanges;
+namespace agi { struct Context; }
+
+/// @class RenderProfile
+/// @brief How long each line visible on a profiled frame took to render
+///
+/// Profiling renders each line on the frame by itself on the video worker
+/// thread, so that the lines responsible for a slow frame can be found. The
+/// results last until the profiled lines are edited.
+class RenderProfile {
+	/// State shared with the profiling job
+	struct State;
+	std::shared_ptr<State> state;
+
+	agi::Context *context;
+
+	/// Milliseconds each line took to render, by line ID
+	std::unordered_map<int, double> costs;
+	/// Frame the results are for, or -1 if there are none
+	int frame = -1;
+	/// Is a frame being profiled?
+	bool running = false;
+
+	agi::signal::Signal<> Changed;
+	std::vector<agi::signal::Connection> connections;
+
+	void OnCommit(AssFileChanges const& changes);
+	/// Forget all of the results, including those still being measured
+	void Reset();
+
+public:
+	RenderProfile(agi::Context *c);
+	~RenderProfile();
+
+	/// Start profiling the frame currently shown, replacing any earlier results
+	void Run();
+
+	/// Is profiling in progress?
+	bool Running() const { return running; }
+	/// Frame the current results are for, or -1 if there are none
+	int Frame() const { return frame; }
+
+	/// Get the time in milliseconds a line took to render, or a negative
+	/// number if it wasn't profiled or has changed since
+	double Cost(const AssDialogue *line) const;
+
+	/// Get the profiled lines and their costs, most expensive first
+	std::vector<std::pair<AssDialogue *, double>> Lines() const;
+
+	DEFINE_SIGNAL_ADDERS(Changed, AddChangeListener)
+};
@@ -21,6 +21,7 @@
 #include "ass_style.h"
 #include "utils.h"
 
+#include <libaegisub/dispatch.h>
 #include <libaegisub/exception.h>
 #include <libaegisub/of_type_adaptor.h>
 #include <libaegisub/split.h>
@@ -156,10 +157,24 @@ namespace {
 			cur->Set<int>((cur->Get<int>() + shift) * resizer + 0.5);
 	}
 
+	void resample_margins(resample_state *state, AssDialogue &diag) {
+		for (size_t i = 0; i < 3; ++i) {
+			if (diag.Margin[i])
+				diag.Margin[i] = int((diag.Margin[i] + state->margin[i]) * (i < 2 ? state->rx : state->ry) + 0.5);
+		}
+	}
+
 	void resample_line(resample_state *state, AssDialogue &diag) {
 		if (diag.Comment && (boost::starts_with(diag.Effect.get(), "template") || boost::starts_with(diag.Effect.get(), "code")))
 			return;
 
+		// Without override blocks there's nothing in the text to rewrite, as
+		// drawings can only be turned on by a tag
+		if (diag.Text.get().find('{') == std::string::npos) {
+			resample_margins(state, diag);
+			return;
+		}
+
 		auto blocks = diag.ParseTags();
 
 		for (auto block : blocks | agi::of_type<AssDialogueBlockOverride>())
@@ -168,11 +183,7 @@ namespace {
 		for (auto drawing : blocks | agi::of_type<AssDialogueBlockDrawing>())
 			drawing->text = transform_drawing(drawing->text, 0, 0, state->rx / state->ar, state->ry);
 
-		for (size_t i = 0; i < 3; ++i) {
-			if (diag.Margin[i])
-				diag.Margin[i] = int((diag.Margin[i] + state->margin[i]) * (i < 2 ? state->rx : state->ry) + 0.5);
-		}
-
+		resample_margins(state, diag);
 		diag.UpdateText(blocks);
 	}
 
@@ -193,6 +204,8 @@ namespace {
 		style.UpdateData();
 	}
 
+	const size_t lines_per_chunk = 1000;
+
 	agi::ycbcr_matrix matrix(YCbCrMatrix mat) {
 		switch (mat) {
 			case YCbCrMatrix::rgb: return agi::ycbcr_matrix::bt601;
@@ -278,8 +291,19 @@ void ResampleResolution(AssFile *ass, ResampleSettings settings) {
 
 	for (auto& line : ass->Styles)
 		resample_style(&state, line);
+
+	// Lines don't depend on each other, so resample them in parallel chunks
+	std::vector<AssDialogue *> lines;
+	lines.reserve(ass->Events.size());
 	for (auto& line : ass->Events)
-		resample_line(&state, line);
+		lines.push_back(&line);
+
+	const size_t chunks = (lines.size() + lines_per_chunk - 1) / lines_per_chunk;
+	agi::dispatch::Parallel(chunks, [&](size_t chunk) {
+		const size_t end = std::min(lines.size(), (chunk + 1) * lines_per_chunk);
+		for (size_t i = chunk * lines_per_chunk; i < end; ++i)
+			resample_line(&state, *lines[i]);
+	});
 
 	ass->SetScriptInfo("PlayResX", std::to_string(settings.dest_x));
 	ass->SetScriptInfo("PlayResY", std::to_string(settings.dest_y));
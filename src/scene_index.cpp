@@ -0,0 +1,164 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include "scene_index.h"
+
+#include "async_video_provider.h"
+#include "include/aegisub/context.h"
+#include "options.h"
+#include "utils.h"
+#include "video_controller.h"
+#include "video_frame.h"
+
+#include <libaegisub/dispatch.h>
+#include <libaegisub/fs.h>
+#include <libaegisub/keyframe.h>
+#include <libaegisub/log.h>
+#include <libaegisub/scene_change.h>
+
+#include <cstring>
+
+namespace {
+/// How often to check whether the video is idle
+const int poll_interval = 250;
+/// Milliseconds to read for before giving the worker a chance to do other work
+const int chunk_budget = 100;
+
+std::string encode(std::vector<int> const& keyframes) {
+	std::string data(keyframes.size() * sizeof(int32_t), '\0');
+	for (size_t i = 0; i < keyframes.size(); ++i) {
+		int32_t frame = keyframes[i];
+		memcpy(&data[i * sizeof frame], &frame, sizeof frame);
+	}
+	return data;
+}
+
+std::vector<int> decode(std::string const& data) {
+	std::vector<int> keyframes(data.size() / sizeof(int32_t));
+	for (size_t i = 0; i < keyframes.size(); ++i) {
+		int32_t frame;
+		memcpy(&frame, &data[i * sizeof frame], sizeof frame);
+		keyframes[i] = frame;
+	}
+	return keyframes;
+}
+}
+
+struct SceneIndex::State {
+	/// Owner of this state, or null once it's been destroyed
+	SceneIndex *index;
+	agi::SceneChangeDetector detector;
+	std::vector<int> keyframes;
+
+	State(SceneIndex *index, int min_scene_length)
+	: index(index), detector(min_scene_length) { }
+};
+
+SceneIndex::SceneIndex(agi::Context *c, AsyncVideoProvider *provider, agi::fs::path const& video, std::function<void (std::vector<int> const&)> finished)
+: state(std::make_shared<State>(this, OPT_GET("Video/Scene Detection/Minimum Length")->GetInt()))
+, context(c)
+, provider(provider)
+, finished(std::move(finished))
+{
+	std::vector<int> keyframes;
+	if (LoadCached(video, keyframes)) {
+		// Report on the next iteration of the event loop so that the
+		// caller doesn't get called back from inside the constructor
+		auto s = state;
+		agi::dispatch::Main().Async([=] {
+			if (s->index) s->index->finished(keyframes);
+		});
+		return;
+	}
+
+	timer.Bind(wxEVT_TIMER, [=](wxTimerEvent&) { Step(); });
+	timer.Start(poll_interval);
+}
+
+bool SceneIndex::LoadCached(agi::fs::path const& video, std::vector<int> &keyframes) {
+	try {
+		cache_key.source = agi::SourceIdentity::Of(video);
+		cache_key.type = "keyframes";
+		cache_key.params = "min_length=" + std::to_string(OPT_GET("Video/Scene Detection/Minimum Length")->GetInt());
+
+		std::string data;
+		if (config::derived->Get(cache_key, data)) {
+			keyframes = decode(data);
+			return true;
+		}
+
+		// Older versions cached the scene changes next to the FFMS2 indexes
+		auto legacy_file = GetVideoCacheFilename(video, ".keyframes");
+		if (agi::fs::FileExists(legacy_file)) {
+			keyframes = agi::keyframe::Load(legacy_file);
+			config::derived->Put(cache_key, encode(keyframes));
+			agi::fs::Remove(legacy_file);
+			return true;
+		}
+	}
+	catch (agi::Exception const& e) {
+		LOG_E("scene_index") << "Failed to read cached scene changes: " << e.GetMessage();
+	}
+	return false;
+}
+
+SceneIndex::~SceneIndex() {
+	// Jobs which are still queued hold a reference to the state and check
+	// this before calling back
+	state->index = nullptr;
+}
+
+void SceneIndex::Step() {
+	if (scanning || context->videoController->IsBusy()) return;
+
+	scanning = true;
+	auto s = state;
+	provider->ScanFrames(next_frame, chunk_budget,
+		[=](int frame, VideoFrame const& img) {
+			const uint8_t *top = img.data.data() + (img.flipped ? (img.height - 1) * img.pitch : 0);
+			if (s->detector.AddFrame(top, img.RowStep(), img.width, img.height))
+				s->keyframes.push_back(frame);
+		},
+		[=](int next) {
+			agi::dispatch::Main().Async([=] {
+				if (s->index) s->index->ChunkDone(next);
+			});
+		});
+}
+
+void SceneIndex::ChunkDone(int next) {
+	scanning = false;
+
+	if (next < 0) {
+		LOG_E("scene_index") << "Decoding failed; giving up on finding scene changes";
+		timer.Stop();
+		return;
+	}
+
+	next_frame = next;
+	if (next_frame < provider->GetFrameCount()) {
+		// Keep going right away unless something else wants the video
+		Step();
+		return;
+	}
+
+	timer.Stop();
+	LOG_I("scene_index") << "Found " << state->keyframes.size() << " scene changes";
+
+	if (!cache_key.type.empty())
+		config::derived->Put(cache_key, encode(state->keyframes));
+
+	finished(state->keyframes);
+}
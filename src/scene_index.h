@@ -0,0 +1,75 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file scene_index.h
+/// @brief Background generation of keyframes from scene changes
+
+#pragma once
+
+#include <libaegisub/derived_store.h>
+#include <libaegisub/fs_fwd.h>
+
+#include <boost/filesystem/path.hpp>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <wx/timer.h>
+
+class AsyncVideoProvider;
+namespace agi { struct Context; }
+
+/// @class SceneIndex
+/// @brief Finds the scene changes in the open video while it's idle
+///
+/// The video is read through a chunk at a time on the video provider's
+/// worker whenever it isn't playing and hasn't been seeked recently, so
+/// that it never competes with what the user is looking at. The result is
+/// kept in the derived data store so that it only has to be built once.
+class SceneIndex {
+	/// State shared with the jobs on the video worker
+	struct State;
+	std::shared_ptr<State> state;
+
+	agi::Context *context;
+	AsyncVideoProvider *provider;
+	/// Key of the result in the derived data store, with an empty type if
+	/// the video's identity couldn't be determined
+	agi::ArtifactKey cache_key;
+	/// Called with the keyframes once they're all found
+	std::function<void (std::vector<int> const&)> finished;
+
+	wxTimer timer;
+
+	/// Is a chunk currently being read?
+	bool scanning = false;
+	/// First frame which hasn't been read yet
+	int next_frame = 0;
+
+	/// Read the next chunk of the video if nothing else is going on
+	void Step();
+	/// Handle a chunk having been read up to next
+	void ChunkDone(int next);
+	/// Look for the result of an earlier scan
+	bool LoadCached(agi::fs::path const& video, std::vector<int> &keyframes);
+
+public:
+	/// @param c        Project context, used to watch playback and seeking
+	/// @param provider Video to read
+	/// @param video    Filename of the video, used to name the cache file
+	/// @param finished Called on the main thread once the scene changes are
+	///                 known, which may be immediately if they're cached
+	SceneIndex(agi::Context *c, AsyncVideoProvider *provider, agi::fs::path const& video, std::function<void (std::vector<int> const&)> finished);
+	~SceneIndex();
+};
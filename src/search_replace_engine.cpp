@@ -19,14 +19,20 @@
 #include "ass_dialogue.h"
 #include "ass_file.h"
 #include "format.h"
+#include "frame_main.h"
 #include "include/aegisub/context.h"
 #include "selection_controller.h"
 #include "text_selection_controller.h"
 
+#include <libaegisub/dispatch.h>
 #include <libaegisub/exception.h>
 #include <libaegisub/util.h>
 
+#include <algorithm>
 #include <boost/locale/conversion.hpp>
+#include <deque>
+#include <memory>
+#include <mutex>
 
 #include <wx/msgdlg.h>
 
@@ -34,6 +40,9 @@ namespace {
 static const size_t bad_pos = -1;
 static const MatchState bad_match{nullptr, 0, bad_pos};
 
+/// Number of lines searched by each job when searching all lines at once
+static const size_t lines_per_chunk = 1024;
+
 auto get_dialogue_field(SearchReplaceSettings::Field field) -> decltype(&AssDialogueBase::Text) {
 	switch (field) {
 		case SearchReplaceSettings::Field::TEXT: return &AssDialogueBase::Text;
@@ -44,8 +53,19 @@ auto get_dialogue_field(SearchReplaceSettings::Field field) -> decltype(&AssDial
 	throw agi::InternalError("Bad field for search");
 }
 
+bool is_ascii(std::string const& str) {
+	for (unsigned char c : str) {
+		if (c >= 0x80)
+			return false;
+	}
+	return true;
+}
+
 std::string const& get_normalized(const AssDialogue *diag, decltype(&AssDialogueBase::Text) field) {
 	auto& value = const_cast<AssDialogue*>(diag)->*field;
+	// ASCII text is always already normalized
+	if (is_ascii(value.get()))
+		return value.get();
 	auto normalized = boost::locale::normalize(value.get());
 	if (normalized != value)
 		value = normalized;
@@ -54,8 +74,34 @@ std::string const& get_normalized(const AssDialogue *diag, decltype(&AssDialogue
 
 typedef std::function<MatchState (const AssDialogue*, size_t)> matcher;
 
+/// Compile a regular expression, or reuse it if it was compiled recently
+///
+/// Compiled regexes are only read while matching, so one copy can be shared
+/// by all of the threads searching at once.
+std::shared_ptr<boost::u32regex> compile_regex(std::string const& pattern, int flags) {
+	static std::mutex mutex;
+	static std::deque<std::pair<std::pair<std::string, int>, std::shared_ptr<boost::u32regex>>> recent;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto key = std::make_pair(pattern, flags);
+	for (auto it = recent.begin(); it != recent.end(); ++it) {
+		if (it->first == key) {
+			auto regex = it->second;
+			recent.erase(it);
+			recent.emplace_front(std::move(key), regex);
+			return regex;
+		}
+	}
+
+	auto regex = std::make_shared<boost::u32regex>(boost::make_u32regex(pattern, flags));
+	recent.emplace_front(std::move(key), regex);
+	if (recent.size() > 8)
+		recent.pop_back();
+	return regex;
+}
+
 class noop_accessor {
-	boost::flyweight<std::string> AssDialogueBase::*field;
+	agi::Interned<std::string> AssDialogueBase::*field;
 	size_t start = 0;
 
 public:
@@ -72,7 +118,7 @@ public:
 };
 
 class skip_tags_accessor {
-	boost::flyweight<std::string> AssDialogueBase::*field;
+	agi::Interned<std::string> AssDialogueBase::*field;
 	agi::util::tagless_find_helper helper;
 
 public:
@@ -95,14 +141,14 @@ matcher get_matcher(SearchReplaceSettings const& settings, Accessor&& a) {
 		if (!settings.match_case)
 			flags |= boost::u32regex::icase;
 
-		auto regex = boost::make_u32regex(settings.find, flags);
+		auto regex = compile_regex(settings.find, flags);
 
 		return [=](const AssDialogue *diag, size_t start) mutable -> MatchState {
 			boost::smatch result;
 			auto const& str = a.get(diag, start);
-			if (!u32regex_search(str, result, regex, start > 0 ? boost::match_not_bol : boost::match_default))
+			if (!u32regex_search(str, result, *regex, start > 0 ? boost::match_not_bol : boost::match_default))
 				return bad_match;
-			return a.make_match_state(result.position(), result.position() + result.length(), &regex);
+			return a.make_match_state(result.position(), result.position() + result.length(), regex.get());
 		};
 	}
 
@@ -136,6 +182,18 @@ Iterator circular_next(Iterator it, Container& c) {
 	return it;
 }
 
+/// Call func for each chunk of lines in parallel, with a matcher for each
+/// chunk as the accessors aren't thread-safe
+/// @return Number of chunks
+size_t for_each_chunk(std::vector<AssDialogue *> const& lines, SearchReplaceSettings const& settings, std::function<void (size_t, size_t, size_t, matcher&)> const& func) {
+	const size_t chunks = (lines.size() + lines_per_chunk - 1) / lines_per_chunk;
+	agi::dispatch::Parallel(chunks, [&](size_t chunk) {
+		auto matches = SearchReplaceEngine::GetMatcher(settings);
+		func(chunk, chunk * lines_per_chunk, std::min(lines.size(), (chunk + 1) * lines_per_chunk), matches);
+	});
+	return chunks;
+}
+
 }
 
 std::function<MatchState (const AssDialogue*, size_t)> SearchReplaceEngine::GetMatcher(SearchReplaceSettings const& settings) {
@@ -234,40 +292,86 @@ bool SearchReplaceEngine::FindReplace(bool replace) {
 	return true;
 }
 
-bool SearchReplaceEngine::ReplaceAll() {
-	if (!initialized)
-		return false;
-
-	size_t count = 0;
-
-	auto matches = GetMatcher(settings);
-
+std::vector<AssDialogue *> SearchReplaceEngine::LinesToSearch() const {
 	auto const& sel = context->selectionController->GetSelectedSet();
 	bool selection_only = settings.limit_to == SearchReplaceSettings::Limit::SELECTED;
 
+	std::vector<AssDialogue *> lines;
 	for (auto& diag : context->ass->Events) {
 		if (selection_only && !sel.count(&diag)) continue;
 		if (settings.ignore_comments && diag.Comment) continue;
+		lines.push_back(&diag);
+	}
+	return lines;
+}
+
+bool SearchReplaceEngine::FindAll() {
+	if (!initialized)
+		return false;
+
+	auto lines = LinesToSearch();
+	std::vector<char> matched(lines.size());
+	for_each_chunk(lines, settings, [&](size_t, size_t first, size_t last, matcher& matches) {
+		for (size_t i = first; i < last; ++i)
+			matched[i] = !!matches(lines[i], 0);
+	});
+
+	Selection sel;
+	AssDialogue *first_match = nullptr;
+	for (size_t i = 0; i < lines.size(); ++i) {
+		if (!matched[i]) continue;
+		sel.insert(lines[i]);
+		if (!first_match) first_match = lines[i];
+	}
 
-		if (settings.use_regex) {
-			if (MatchState ms = matches(&diag, 0)) {
-				auto& diag_field = diag.*get_dialogue_field(settings.field);
-				std::string const& text = diag_field.get();
-				count += std::distance(
-					boost::u32regex_iterator<std::string::const_iterator>(begin(text), end(text), *ms.re),
-					boost::u32regex_iterator<std::string::const_iterator>());
-				diag_field = u32regex_replace(text, *ms.re, settings.replace_with);
+	if (sel.empty()) {
+		wxMessageBox(_("No matches found."));
+		return true;
+	}
+
+	const size_t count = sel.size();
+	context->selectionController->SetSelectionAndActive(std::move(sel), first_match);
+	context->frame->StatusTimeout(fmt_plural(count, "One line matched.", "%d lines matched.", (int)count));
+	return true;
+}
+
+bool SearchReplaceEngine::ReplaceAll() {
+	if (!initialized)
+		return false;
+
+	// Each chunk only touches its own lines, so they can be edited in place
+	auto lines = LinesToSearch();
+	std::vector<size_t> counts((lines.size() + lines_per_chunk - 1) / lines_per_chunk);
+	for_each_chunk(lines, settings, [&](size_t chunk, size_t first, size_t last, matcher& matches) {
+		size_t count = 0;
+		for (size_t i = first; i < last; ++i) {
+			AssDialogue *diag = lines[i];
+
+			if (settings.use_regex) {
+				if (MatchState ms = matches(diag, 0)) {
+					auto& diag_field = diag->*get_dialogue_field(settings.field);
+					std::string const& text = diag_field.get();
+					count += std::distance(
+						boost::u32regex_iterator<std::string::const_iterator>(begin(text), end(text), *ms.re),
+						boost::u32regex_iterator<std::string::const_iterator>());
+					diag_field = u32regex_replace(text, *ms.re, settings.replace_with);
+				}
+				continue;
 			}
-			continue;
-		}
 
-		size_t pos = 0;
-		while (MatchState ms = matches(&diag, pos)) {
-			++count;
-			Replace(&diag, ms);
-			pos = ms.end;
+			size_t pos = 0;
+			while (MatchState ms = matches(diag, pos)) {
+				++count;
+				Replace(diag, ms);
+				pos = ms.end;
+			}
 		}
-	}
+		counts[chunk] = count;
+	});
+
+	size_t count = 0;
+	for (size_t chunk_count : counts)
+		count += chunk_count;
 
 	if (count > 0) {
 		context->ass->Commit(_("replace"), AssFile::COMMIT_DIAG_TEXT);
@@ -14,9 +14,12 @@
 //
 // Aegisub Project http://www.aegisub.org/
 
+#pragma once
+
 #include <functional>
 #include <boost/regex/icu.hpp>
 #include <string>
+#include <vector>
 
 namespace agi { struct Context; }
 class AssDialogue;
@@ -62,9 +65,14 @@ class SearchReplaceEngine {
 	bool FindReplace(bool replace);
 	void Replace(AssDialogue *line, MatchState &ms);
 
+	/// Get the lines which the current settings limit searching to
+	std::vector<AssDialogue *> LinesToSearch() const;
+
 public:
 	bool FindNext() { return FindReplace(false); }
 	bool ReplaceNext() { return FindReplace(true); }
+	/// Select every line with a match
+	bool FindAll();
 	bool ReplaceAll();
 
 	void Configure(SearchReplaceSettings const& new_settings);
@@ -0,0 +1,109 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include "selection.h"
+
+#include "ass_dialogue.h"
+
+#include <algorithm>
+
+Selection::Selection(std::initializer_list<AssDialogue *> init) {
+	lines.reserve(init.size());
+	for (auto line : init)
+		insert(line);
+}
+
+bool Selection::Test(int id) const {
+	const size_t word = static_cast<size_t>(id) / 64;
+	if (word < first_word || word >= first_word + bits.size()) return false;
+	return (bits[word - first_word] >> (id % 64)) & 1;
+}
+
+bool Selection::Set(int id) {
+	const size_t word = static_cast<size_t>(id) / 64;
+	if (bits.empty())
+		first_word = word;
+	if (word < first_word) {
+		bits.insert(bits.begin(), first_word - word, 0);
+		first_word = word;
+	}
+	if (word >= first_word + bits.size())
+		bits.resize(word - first_word + 1, 0);
+
+	auto& w = bits[word - first_word];
+	const uint64_t bit = uint64_t(1) << (id % 64);
+	if (w & bit) return false;
+	w |= bit;
+	return true;
+}
+
+void Selection::Reset(int id) {
+	const size_t word = static_cast<size_t>(id) / 64;
+	if (word >= first_word && word < first_word + bits.size())
+		bits[word - first_word] &= ~(uint64_t(1) << (id % 64));
+}
+
+size_t Selection::count(const AssDialogue *line) const {
+	return line && Test(line->Id);
+}
+
+std::pair<Selection::const_iterator, bool> Selection::insert(AssDialogue *line) {
+	if (!line) return {lines.end(), false};
+	if (!Set(line->Id))
+		return {std::find(lines.begin(), lines.end(), line), false};
+	lines.push_back(line);
+	return {lines.end() - 1, true};
+}
+
+size_t Selection::erase(const AssDialogue *line) {
+	if (!count(line)) return 0;
+	Reset(line->Id);
+	lines.erase(std::find(lines.begin(), lines.end(), line));
+	return 1;
+}
+
+void Selection::clear() {
+	lines.clear();
+	bits.clear();
+	first_word = 0;
+}
+
+void Selection::Add(Selection const& other) {
+	lines.reserve(lines.size() + other.size());
+	for (auto line : other)
+		insert(line);
+}
+
+void Selection::Remove(Selection const& other) {
+	if (other.empty()) return;
+	lines.erase(std::remove_if(lines.begin(), lines.end(), [&](AssDialogue *line) {
+		if (!other.Test(line->Id)) return false;
+		Reset(line->Id);
+		return true;
+	}), lines.end());
+}
+
+void Selection::Intersect(Selection const& other) {
+	lines.erase(std::remove_if(lines.begin(), lines.end(), [&](AssDialogue *line) {
+		if (other.Test(line->Id)) return false;
+		Reset(line->Id);
+		return true;
+	}), lines.end());
+}
+
+bool operator==(Selection const& a, Selection const& b) {
+	return a.size() == b.size()
+		&& std::all_of(a.begin(), a.end(), [&](AssDialogue *line) { return b.Test(line->Id); });
+}
@@ -0,0 +1,97 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file selection.h
+/// @brief A set of dialogue lines
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+class AssDialogue;
+
+/// @class Selection
+/// @brief A set of dialogue lines, such as the lines selected in the grid
+///
+/// Membership is tracked with a bitset indexed by line ID, so checking whether
+/// a line is in the set is a single bit test. The lines themselves are kept in
+/// a vector in the order they were added, which is file order for every set
+/// built by walking through the file, so a set of every line in the file costs
+/// two allocations rather than a tree node per line.
+///
+/// The interface is the subset of std::set's used for selections, along with
+/// set operations which work directly on the bitsets.
+class Selection {
+	std::vector<AssDialogue *> lines;
+	/// Bit i of word w is set if the line with ID (first_word + w) * 64 + i is
+	/// in the set
+	std::vector<uint64_t> bits;
+	size_t first_word = 0;
+
+	bool Test(int id) const;
+	/// Set the bit for an ID
+	/// @return Was the bit previously unset?
+	bool Set(int id);
+	void Reset(int id);
+
+public:
+	using value_type = AssDialogue *;
+	using const_iterator = std::vector<AssDialogue *>::const_iterator;
+	using iterator = const_iterator;
+	using const_reverse_iterator = std::vector<AssDialogue *>::const_reverse_iterator;
+
+	Selection() = default;
+	Selection(std::initializer_list<AssDialogue *> init);
+	template<typename Iterator>
+	Selection(Iterator begin, Iterator end) {
+		for (; begin != end; ++begin)
+			insert(*begin);
+	}
+
+	const_iterator begin() const { return lines.begin(); }
+	const_iterator end() const { return lines.end(); }
+	const_reverse_iterator rbegin() const { return lines.rbegin(); }
+	const_reverse_iterator rend() const { return lines.rend(); }
+	size_t size() const { return lines.size(); }
+	bool empty() const { return lines.empty(); }
+
+	/// @return 1 if the line is in the set, 0 if not or if it's null
+	size_t count(const AssDialogue *line) const;
+
+	/// Add a line to the set if it isn't already in it
+	/// @return The line's position in the set, and whether it was added
+	std::pair<const_iterator, bool> insert(AssDialogue *line);
+
+	/// Remove a line from the set
+	/// @return Number of lines removed
+	size_t erase(const AssDialogue *line);
+
+	void clear();
+	void reserve(size_t count) { lines.reserve(count); }
+
+	/// Add every line in other to this set
+	void Add(Selection const& other);
+	/// Remove every line in other from this set
+	void Remove(Selection const& other);
+	/// Remove every line not in other from this set
+	void Intersect(Selection const& other);
+
+	friend bool operator==(Selection const& a, Selection const& b);
+	friend bool operator!=(Selection const& a, Selection const& b) { return !(a == b); }
+};
@@ -53,7 +53,10 @@ void SelectionController::SetSelectionAndActive(Selection new_selection, AssDial
 
 std::vector<AssDialogue *> SelectionController::GetSortedSelection() const {
 	std::vector<AssDialogue *> ret(selection.begin(), selection.end());
-	sort(begin(ret), end(ret), [](AssDialogue *a, AssDialogue *b) { return a->Row < b->Row; });
+	// Selections are usually built in file order already
+	auto by_row = [](AssDialogue *a, AssDialogue *b) { return a->Row < b->Row; };
+	if (!is_sorted(begin(ret), end(ret), by_row))
+		sort(begin(ret), end(ret), by_row);
 	return ret;
 }
 
@@ -27,14 +27,12 @@
 //
 // Aegisub Project http://www.aegisub.org/
 
+#include "selection.h"
+
 #include <libaegisub/signal.h>
 
-#include <set>
 #include <vector>
 
-class AssDialogue;
-typedef std::set<AssDialogue *> Selection;
-
 namespace agi { struct Context; }
 
 class SelectionController {
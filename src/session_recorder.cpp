@@ -0,0 +1,345 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+/// @file session_recorder.cpp
+/// @brief Recording the commands run in a session and replaying them
+/// @ingroup main
+
+#include "session_recorder.h"
+
+#include "ass_dialogue.h"
+#include "ass_file.h"
+#include "command/command.h"
+#include "compat.h"
+#include "format.h"
+#include "frame_main.h"
+#include "include/aegisub/context.h"
+#include "main.h"
+#include "options.h"
+#include "project.h"
+#include "selection_controller.h"
+#include "subs_controller.h"
+#include "video_controller.h"
+
+#include <libaegisub/dispatch.h>
+#include <libaegisub/io.h>
+#include <libaegisub/log.h>
+#include <libaegisub/make_unique.h>
+#include <libaegisub/session_log.h>
+#include <libaegisub/signal.h>
+#include <libaegisub/trace.h>
+
+#include <algorithm>
+#include <boost/filesystem/fstream.hpp>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <wx/msgdlg.h>
+#include <wx/timer.h>
+
+namespace {
+using clock = std::chrono::steady_clock;
+
+/// Commands which are neither recorded nor replayed: the recorder's own
+/// commands, and exiting, which would end the replay
+bool is_unrecorded(std::string const& name) {
+	return name == "app/exit" || name.compare(0, 12, "app/session/") == 0;
+}
+
+bool frame_exists(FrameMain *frame) {
+	auto const& frames = wxGetApp().frames;
+	return find(begin(frames), end(frames), frame) != end(frames);
+}
+
+agi::SessionEvent current_state(agi::Context *c) {
+	agi::SessionEvent event;
+	if (auto line = c->selectionController->GetActiveLine())
+		event.active_row = line->Row;
+	for (auto line : c->selectionController->GetSelectedSet())
+		event.selection.push_back(line->Row);
+	sort(begin(event.selection), end(event.selection));
+	if (c->project->VideoProvider())
+		event.video_frame = c->videoController->GetFrameN();
+	return event;
+}
+
+class Recorder {
+	/// Only compared against, as the context may be destroyed before
+	/// recording is stopped
+	const agi::Context *c;
+	boost::filesystem::ofstream out;
+	clock::time_point start = clock::now();
+
+public:
+	Recorder(agi::Context *c, agi::fs::path const& filename)
+	: c(c)
+	, out(filename, std::ios::binary)
+	{
+		if (!out)
+			throw agi::io::IOError("Could not open " + filename.string() + " for writing");
+		agi::WriteSessionHeader(out, {
+			c->subsController->Filename().string(),
+			c->project->VideoName().string()
+		});
+	}
+
+	bool Records(const agi::Context *context) const { return context == c; }
+
+	void Record(cmd::Command *cmd, agi::Context *context) {
+		if (context != c || is_unrecorded(cmd->name())) return;
+
+		auto event = current_state(context);
+		event.time = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start).count();
+		event.command = cmd->name();
+		agi::WriteSessionEvent(out, event);
+	}
+};
+
+class Replayer {
+	struct Timing {
+		size_t count = 0;
+		double total_ms = 0;
+		double max_ms = 0;
+	};
+
+	agi::Context *c;
+	/// Checked before touching the context, which goes away with its frame
+	FrameMain *frame;
+	agi::fs::path filename;
+	agi::SessionLog log;
+	size_t next = 0;
+	/// Wait until each command's recorded time rather than running them as
+	/// quickly as possible
+	bool recorded_speed = OPT_GET("App/Replay at Recorded Speed")->GetBool();
+	bool owns_trace = false;
+	clock::time_point start = clock::now();
+	wxTimer timer;
+	std::map<std::string, Timing> timings;
+	size_t skipped = 0;
+
+	/// Lines by row, rebuilt after each commit which may have changed them
+	std::vector<AssDialogue *> rows;
+	agi::signal::Connection commit_connection;
+
+	AssDialogue *LineAt(int row) {
+		if (rows.empty()) {
+			for (auto& line : c->ass->Events)
+				rows.push_back(&line);
+		}
+		return row >= 0 && static_cast<size_t>(row) < rows.size() ? rows[row] : nullptr;
+	}
+
+	/// Put the selection and video position back to what they were when the
+	/// command was recorded
+	void Restore(agi::SessionEvent const& event) {
+		auto current = current_state(c);
+		if (current.selection != event.selection || current.active_row != event.active_row) {
+			Selection sel;
+			sel.reserve(event.selection.size());
+			for (int row : event.selection) {
+				if (auto line = LineAt(row))
+					sel.insert(line);
+			}
+			c->selectionController->SetSelectionAndActive(std::move(sel), LineAt(event.active_row));
+		}
+
+		if (event.video_frame >= 0 && current.video_frame >= 0 && current.video_frame != event.video_frame)
+			c->videoController->JumpToFrame(event.video_frame);
+	}
+
+	void Run(agi::SessionEvent const& event) {
+		if (is_unrecorded(event.command)) return;
+
+		cmd::Command *command;
+		try {
+			command = cmd::get(event.command);
+		}
+		catch (cmd::CommandNotFound const&) {
+			LOG_W("session/replay") << "Skipping unknown command " << event.command;
+			++skipped;
+			return;
+		}
+
+		Restore(event);
+		if (!command->Validate(c)) {
+			LOG_W("session/replay") << "Skipping " << event.command << " as it can't be run now";
+			++skipped;
+			return;
+		}
+
+		auto before = clock::now();
+		try {
+			cmd::call(event.command, c);
+		}
+		catch (agi::Exception const& e) {
+			LOG_E("session/replay") << event.command << " failed: " << e.GetMessage();
+		}
+		double ms = std::chrono::duration<double, std::milli>(clock::now() - before).count();
+
+		auto& timing = timings[event.command];
+		++timing.count;
+		timing.total_ms += ms;
+		timing.max_ms = std::max(timing.max_ms, ms);
+	}
+
+	void Schedule() {
+		if (next == log.events.size()) return Finish();
+
+		int delay = 0;
+		if (recorded_speed) {
+			auto due = start + std::chrono::milliseconds(log.events[next].time);
+			delay = std::max<int>(0, std::chrono::duration_cast<std::chrono::milliseconds>(due - clock::now()).count());
+		}
+		// Even with no delay, going through the timer lets whatever the last
+		// command queued run first
+		timer.StartOnce(std::max(delay, 1));
+	}
+
+	void Step() {
+		if (!frame_exists(frame)) {
+			LOG_W("session/replay") << "Window closed; abandoning replay";
+			return Done();
+		}
+
+		Run(log.events[next++]);
+		Schedule();
+	}
+
+	void WriteResults() {
+		auto base = filename;
+		base.replace_extension();
+
+		if (owns_trace) {
+			auto trace_file = base.string() + ".trace.json";
+			try {
+				size_t events = agi::trace::Write(agi::io::Save(trace_file).Get());
+				LOG_I("session/replay") << "Wrote " << events << " trace events to " << trace_file;
+			}
+			catch (agi::Exception const& e) {
+				LOG_E("session/replay") << "Could not write trace: " << e.GetMessage();
+			}
+		}
+
+		std::vector<std::pair<std::string, Timing>> sorted(begin(timings), end(timings));
+		sort(begin(sorted), end(sorted), [](auto const& a, auto const& b) {
+			return a.second.total_ms > b.second.total_ms;
+		});
+
+		auto timing_file = base.string() + ".timing.tsv";
+		try {
+			agi::io::Save save(timing_file);
+			auto& out = save.Get();
+			out << "command\tcount\ttotal_ms\tmean_ms\tmax_ms\n";
+			for (auto const& entry : sorted) {
+				auto const& t = entry.second;
+				out << entry.first << '\t' << t.count << '\t' << t.total_ms << '\t'
+				    << t.total_ms / t.count << '\t' << t.max_ms << '\n';
+			}
+		}
+		catch (agi::Exception const& e) {
+			LOG_E("session/replay") << "Could not write timings: " << e.GetMessage();
+		}
+	}
+
+	void Finish() {
+		if (owns_trace)
+			agi::trace::Stop();
+
+		double total = 0;
+		for (auto const& entry : timings)
+			total += entry.second.total_ms;
+		LOG_I("session/replay") << "Replayed " << log.events.size() - skipped << " commands in "
+			<< std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start).count()
+			<< " ms (" << total << " ms in commands), skipped " << skipped;
+
+		WriteResults();
+		frame->StatusTimeout(fmt_tl("Replayed %d commands; results saved next to %s", log.events.size() - skipped, filename.filename().string()));
+		Done();
+	}
+
+	void Done();
+
+public:
+	Replayer(agi::Context *c, agi::fs::path const& filename, agi::SessionLog log)
+	: c(c)
+	, frame(c->frame)
+	, filename(filename)
+	, log(std::move(log))
+	, commit_connection(c->ass->AddCommitListener([=](int, const AssDialogue *) { rows.clear(); }))
+	{
+		if (agi::trace::IsAvailable() && !agi::trace::IsRecording()) {
+			agi::trace::SetThreadName("Main");
+			agi::trace::Start();
+			owns_trace = true;
+		}
+		timer.Bind(wxEVT_TIMER, [this](wxTimerEvent&) { Step(); });
+		Schedule();
+	}
+
+	~Replayer() {
+		if (owns_trace && agi::trace::IsRecording())
+			agi::trace::Stop();
+	}
+};
+
+std::unique_ptr<Recorder> recorder;
+std::unique_ptr<Replayer> replayer;
+
+void Replayer::Done() {
+	timer.Stop();
+	commit_connection.Disconnect();
+	// Called from the timer's handler, so destroying it has to wait
+	agi::dispatch::Main().Async([] { replayer.reset(); });
+}
+}
+
+namespace session_recorder {
+void StartRecording(agi::Context *c, agi::fs::path const& filename) {
+	recorder = agi::make_unique<Recorder>(c, filename);
+	cmd::set_call_observer([](cmd::Command *cmd, agi::Context *c) {
+		recorder->Record(cmd, c);
+	});
+	LOG_I("session/record") << "Recording session to " << filename;
+}
+
+void StopRecording() {
+	cmd::set_call_observer(nullptr);
+	recorder.reset();
+	LOG_I("session/record") << "Stopped recording session";
+}
+
+bool IsRecording(const agi::Context *c) {
+	return recorder && recorder->Records(c);
+}
+
+bool IsBusy() {
+	return recorder || replayer;
+}
+
+void Replay(agi::Context *c, agi::fs::path const& filename) {
+	auto log = agi::ReadSessionLog(*agi::io::Open(filename));
+	if (log.events.empty())
+		throw agi::SessionLogError("Session recording contains no commands");
+
+	auto subtitles = c->subsController->Filename().string();
+	if (log.header.subtitles != subtitles) {
+		auto msg = fmt_tl("This session was recorded with %s open, but %s is open now. Replay it anyway?",
+			log.header.subtitles, subtitles);
+		if (wxMessageBox(msg, _("Replay session"), wxYES_NO | wxICON_QUESTION, c->parent) != wxYES)
+			return;
+	}
+
+	replayer = agi::make_unique<Replayer>(c, filename, std::move(log));
+}
+}
@@ -0,0 +1,48 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+/// @file session_recorder.h
+/// @brief Recording the commands run in a session and replaying them
+/// @ingroup main
+
+#pragma once
+
+#include <libaegisub/fs_fwd.h>
+
+#include <boost/filesystem/path.hpp>
+
+namespace agi { struct Context; }
+
+namespace session_recorder {
+	/// Start writing every command run in the context to a file, along with
+	/// the active line, selection and video frame each was run with
+	void StartRecording(agi::Context *c, agi::fs::path const& filename);
+
+	/// Stop recording and close the file
+	void StopRecording();
+
+	/// Is the given context's session being recorded?
+	bool IsRecording(const agi::Context *c);
+
+	/// Is a session being recorded or replayed in any context?
+	bool IsBusy();
+
+	/// Run the commands from a recording against the given context, timing
+	/// each of them and recording a performance trace if tracing is
+	/// available, then write the results next to the recording
+	///
+	/// The replay runs from the event loop so that the work each command
+	/// queues happens between commands, and returns immediately.
+	void Replay(agi::Context *c, agi::fs::path const& filename);
+}
@@ -27,11 +27,84 @@
 #include <libaegisub/path.h>
 #include <libaegisub/make_unique.h>
 
+#include <libaegisub/dispatch.h>
+
+#include <boost/filesystem/path.hpp>
 #include <boost/range/algorithm.hpp>
+#include <map>
+#include <set>
 
 #undef near
 #include <hunspell.hxx>
 
+struct HunspellSpellChecker::Dictionary {
+	/// Guards everything below, as Hunspell isn't thread-safe
+	std::mutex mutex;
+
+	/// Hunspell instance; null until loading has finished
+	std::unique_ptr<Hunspell> hunspell;
+
+	/// Conversions between the dictionary charset and utf-8
+	std::unique_ptr<agi::charset::IconvWrapper> conv;
+	std::unique_ptr<agi::charset::IconvWrapper> rconv;
+
+	/// Path to user-local dictionary.
+	agi::fs::path userDicPath;
+
+	/// Words in the custom user dictionary
+	std::set<std::string> customWords;
+
+	void Load(agi::fs::path const& aff, agi::fs::path const& dic, std::string const& language);
+	void ReadUserDictionary();
+};
+
+void HunspellSpellChecker::Dictionary::Load(agi::fs::path const& aff, agi::fs::path const& dic, std::string const& language) {
+	LOG_I("dictionary/file") << dic;
+
+	// Parsing the dictionary is the slow part, so do it without the lock
+#ifdef _WIN32
+	// The prefix makes hunspell assume the paths are UTF-8 and use _wfopen
+	auto loaded = agi::make_unique<Hunspell>(("\\\\?\\" + aff.string()).c_str(), ("\\\\?\\" + dic.string()).c_str());
+#else
+	auto loaded = agi::make_unique<Hunspell>(aff.string().c_str(), dic.string().c_str());
+#endif
+
+	std::lock_guard<std::mutex> lock(mutex);
+	conv = agi::make_unique<agi::charset::IconvWrapper>("utf-8", loaded->get_dic_encoding());
+	rconv = agi::make_unique<agi::charset::IconvWrapper>(loaded->get_dic_encoding(), "utf-8");
+
+	userDicPath = config::path->Decode("?user/dictionaries")/agi::format("user_%s.dic", language);
+	ReadUserDictionary();
+
+	for (auto const& word : customWords) {
+		try {
+			loaded->add(conv->Convert(word).c_str());
+		}
+		catch (agi::charset::ConvError const&) {
+			// Normally this shouldn't happen, but some versions of Aegisub
+			// wrote words in the wrong charset
+		}
+	}
+
+	hunspell = std::move(loaded);
+}
+
+void HunspellSpellChecker::Dictionary::ReadUserDictionary() {
+	customWords.clear();
+
+	// Read the old contents of the user's dictionary
+	try {
+		auto stream = agi::io::Open(userDicPath);
+		copy_if(
+			++agi::line_iterator<std::string>(*stream), agi::line_iterator<std::string>(),
+			inserter(customWords, customWords.end()),
+			[](std::string const& str) { return !str.empty(); });
+	}
+	catch (agi::fs::FileNotFound const&) {
+		// Not an error; user dictionary just doesn't exist
+	}
+}
+
 HunspellSpellChecker::HunspellSpellChecker()
 : lang_listener(OPT_SUB("Tool/Spell Checker/Language", &HunspellSpellChecker::OnLanguageChanged, this))
 , dict_path_listener(OPT_SUB("Path/Dictionary", &HunspellSpellChecker::OnPathChanged, this))
@@ -42,10 +115,24 @@ HunspellSpellChecker::HunspellSpellChecker()
 HunspellSpellChecker::~HunspellSpellChecker() {
 }
 
+std::shared_ptr<HunspellSpellChecker::Dictionary> HunspellSpellChecker::GetLoadedDictionary() {
+	std::shared_ptr<Dictionary> dict;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		dict = dictionary;
+	}
+	if (!dict) return nullptr;
+
+	std::lock_guard<std::mutex> lock(dict->mutex);
+	return dict->hunspell ? dict : nullptr;
+}
+
 bool HunspellSpellChecker::CanAddWord(std::string const& word) {
-	if (!hunspell) return false;
+	auto dict = GetLoadedDictionary();
+	if (!dict) return false;
+	std::lock_guard<std::mutex> lock(dict->mutex);
 	try {
-		conv->Convert(word);
+		dict->conv->Convert(word);
 		return true;
 	}
 	catch (agi::charset::ConvError const&) {
@@ -54,90 +141,94 @@ bool HunspellSpellChecker::CanAddWord(std::string const& word) {
 }
 
 bool HunspellSpellChecker::CanRemoveWord(std::string const& word) {
-	return !!customWords.count(word);
+	auto dict = GetLoadedDictionary();
+	if (!dict) return false;
+	std::lock_guard<std::mutex> lock(dict->mutex);
+	return !!dict->customWords.count(word);
 }
 
 void HunspellSpellChecker::AddWord(std::string const& word) {
-	if (!hunspell) return;
+	auto dict = GetLoadedDictionary();
+	if (!dict) return;
+	{
+		std::lock_guard<std::mutex> lock(dict->mutex);
 
-	// Add it to the in-memory dictionary
-	hunspell->add(conv->Convert(word).c_str());
+		// Add it to the in-memory dictionary
+		dict->hunspell->add(dict->conv->Convert(word).c_str());
+		checked_words.Clear();
 
-	// Add the word
-	if (customWords.insert(word).second)
-		WriteUserDictionary();
+		// Add the word
+		if (!dict->customWords.insert(word).second) return;
+	}
+	WriteUserDictionary(*dict);
 }
 
 void HunspellSpellChecker::RemoveWord(std::string const& word) {
-	if (!hunspell) return;
-
-	// Remove it from the in-memory dictionary
-	hunspell->remove(conv->Convert(word).c_str());
+	auto dict = GetLoadedDictionary();
+	if (!dict) return;
+	{
+		std::lock_guard<std::mutex> lock(dict->mutex);
 
-	auto word_iter = customWords.find(word);
-	if (word_iter != customWords.end()) {
-		customWords.erase(word_iter);
+		// Remove it from the in-memory dictionary
+		dict->hunspell->remove(dict->conv->Convert(word).c_str());
+		checked_words.Clear();
 
-		WriteUserDictionary();
+		if (!dict->customWords.erase(word)) return;
 	}
+	WriteUserDictionary(*dict);
 }
 
-void HunspellSpellChecker::ReadUserDictionary() {
-	customWords.clear();
-
-	// Read the old contents of the user's dictionary
-	try {
-		auto stream = agi::io::Open(userDicPath);
-		copy_if(
-			++agi::line_iterator<std::string>(*stream), agi::line_iterator<std::string>(),
-			inserter(customWords, customWords.end()),
-			[](std::string const& str) { return !str.empty(); });
-	}
-	catch (agi::fs::FileNotFound const&) {
-		// Not an error; user dictionary just doesn't exist
-	}
-}
+void HunspellSpellChecker::WriteUserDictionary(Dictionary &dict) {
+	{
+		std::lock_guard<std::mutex> lock(dict.mutex);
 
-void HunspellSpellChecker::WriteUserDictionary() {
-	// Ensure that the path exists
-	agi::fs::CreateDirectory(userDicPath.parent_path());
+		// Ensure that the path exists
+		agi::fs::CreateDirectory(dict.userDicPath.parent_path());
 
-	// Write the new dictionary
-	{
-		agi::io::Save writer(userDicPath);
-		writer.Get() << customWords.size() << "\n";
-		copy(customWords.begin(), customWords.end(), std::ostream_iterator<std::string>(writer.Get(), "\n"));
+		// Write the new dictionary
+		agi::io::Save writer(dict.userDicPath);
+		writer.Get() << dict.customWords.size() << "\n";
+		copy(dict.customWords.begin(), dict.customWords.end(), std::ostream_iterator<std::string>(writer.Get(), "\n"));
 	}
 
-	// Announce a language change so that any other spellcheckers reload the
-	// current dictionary to get the addition/removal
+	// Announce a language change so that any other spellcheckers forget
+	// what they've already checked. They share the dictionary, so it
+	// already has the addition/removal.
 	lang_listener.Block();
 	OPT_SET("Tool/Spell Checker/Language")->SetString(OPT_GET("Tool/Spell Checker/Language")->GetString());
 	lang_listener.Unblock();
 }
 
 bool HunspellSpellChecker::CheckWord(std::string const& word) {
-	if (!hunspell) return true;
-	try {
-		return hunspell->spell(conv->Convert(word).c_str()) == 1;
-	}
-	catch (agi::charset::ConvError const&) {
-		return false;
-	}
+	// Don't remember anything while the dictionary is loading
+	auto dict = GetLoadedDictionary();
+	if (!dict) return true;
+
+	return checked_words.Check(word, [&](std::string const& word) {
+		std::lock_guard<std::mutex> lock(dict->mutex);
+		try {
+			return dict->hunspell->spell(dict->conv->Convert(word).c_str()) == 1;
+		}
+		catch (agi::charset::ConvError const&) {
+			return false;
+		}
+	});
 }
 
 std::vector<std::string> HunspellSpellChecker::GetSuggestions(std::string const& word) {
 	std::vector<std::string> suggestions;
-	if (!hunspell) return suggestions;
+	auto dict = GetLoadedDictionary();
+	if (!dict) return suggestions;
 
+	std::lock_guard<std::mutex> lock(dict->mutex);
 	char **results;
-	int n = hunspell->suggest(&results, conv->Convert(word).c_str());
+	int n = dict->hunspell->suggest(&results, dict->conv->Convert(word).c_str());
 
 	suggestions.reserve(n);
 	// Convert suggestions to UTF-8
 	for (int i = 0; i < n; ++i) {
 		try {
-			suggestions.push_back(rconv->Convert(results[i]));
+			suggestions.push_back(dict->rconv->Convert(results[i]));
 		}
 		catch (agi::charset::ConvError const&) {
 			// Shouldn't ever actually happen...
@@ -168,6 +259,7 @@ static std::vector<std::string> langs(const char *filter) {
 }
 
 std::vector<std::string> HunspellSpellChecker::GetLanguageList() {
+	std::lock_guard<std::mutex> lock(mutex);
 	if (languages.empty())
 		boost::set_intersection(langs("*.dic"), langs("*.aff"), back_inserter(languages));
 	return languages;
@@ -180,7 +272,11 @@ static bool check_path(agi::fs::path const& path, std::string const& language, a
 }
 
 void HunspellSpellChecker::OnLanguageChanged() {
-	hunspell.reset();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		dictionary.reset();
+	}
+	checked_words.Clear();
 
 	auto language = OPT_GET("Tool/Spell Checker/Language")->GetString();
 	if (language.empty()) return;
@@ -193,34 +289,48 @@ void HunspellSpellChecker::OnLanguageChanged() {
 			return;
 	}
 
-	LOG_I("dictionary/file") << dic;
+	// Dictionaries which have been loaded or are loading, by .aff file
+	static std::mutex dictionaries_mutex;
+	static std::map<agi::fs::path, std::shared_ptr<Dictionary>> dictionaries;
 
-#ifdef _WIN32
-	// The prefix makes hunspell assume the paths are UTF-8 and use _wfopen
-	hunspell = agi::make_unique<Hunspell>(("\\\\?\\" + aff.string()).c_str(), ("\\\\?\\" + dic.string()).c_str());
-#else
-	hunspell = agi::make_unique<Hunspell>(aff.string().c_str(), dic.string().c_str());
-#endif
-	if (!hunspell) return;
+	std::shared_ptr<Dictionary> dict;
+	bool load = false;
+	{
+		std::lock_guard<std::mutex> lock(dictionaries_mutex);
+		auto& cached = dictionaries[aff];
+		if (!cached) {
+			cached = std::make_shared<Dictionary>();
+			load = true;
+		}
+		dict = cached;
+	}
 
-	conv = agi::make_unique<agi::charset::IconvWrapper>("utf-8", hunspell->get_dic_encoding());
-	rconv = agi::make_unique<agi::charset::IconvWrapper>(hunspell->get_dic_encoding(), "utf-8");
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		dictionary = dict;
+	}
 
-	userDicPath = config::path->Decode("?user/dictionaries")/agi::format("user_%s.dic", language);
-	ReadUserDictionary();
+	if (!load) return;
 
-	for (auto const& word : customWords) {
+	agi::dispatch::Background(agi::dispatch::Priority::Interactive).Async([=] {
 		try {
-			hunspell->add(conv->Convert(word).c_str());
+			dict->Load(aff, dic, language);
 		}
-		catch (agi::charset::ConvError const&) {
-			// Normally this shouldn't happen, but some versions of Aegisub
-			// wrote words in the wrong charset
+		catch (agi::Exception const& e) {
+			LOG_E("dictionary/file") << "Failed to load " << dic << ": " << e.GetMessage();
+			return;
 		}
-	}
+
+		// Announce the language change again so that everything using this
+		// dictionary rechecks the words it treated as correct while loading
+		agi::dispatch::Main().Async([] {
+			OPT_SET("Tool/Spell Checker/Language")->SetString(OPT_GET("Tool/Spell Checker/Language")->GetString());
+		});
+	});
 }
 
 void HunspellSpellChecker::OnPathChanged() {
+	std::lock_guard<std::mutex> lock(mutex);
 	languages.clear();
 }
 
@@ -22,33 +22,33 @@
 #ifdef WITH_HUNSPELL
 #include <libaegisub/spellchecker.h>
 
-#include <libaegisub/fs_fwd.h>
 #include <libaegisub/signal.h>
+#include <libaegisub/spelling_cache.h>
 
-#include <boost/filesystem/path.hpp>
 #include <memory>
-#include <set>
-
-namespace agi { namespace charset { class IconvWrapper; } }
-class Hunspell;
+#include <mutex>
 
 /// @brief Hunspell-based spell checker implementation
+///
+/// Safe to use from multiple threads. The dictionaries are loaded in the
+/// background and shared by all of the spell checkers using them, and stay
+/// loaded for the rest of the session once they've been used. Words are
+/// treated as correct until the dictionary is ready, at which point the
+/// language change is announced again so that everything rechecks them.
 class HunspellSpellChecker final : public agi::SpellChecker {
-	/// Hunspell instance
-	std::unique_ptr<Hunspell> hunspell;
+	struct Dictionary;
 
-	/// Conversions between the dictionary charset and utf-8
-	std::unique_ptr<agi::charset::IconvWrapper> conv;
-	std::unique_ptr<agi::charset::IconvWrapper> rconv;
+	/// Guards dictionary and languages
+	std::mutex mutex;
 
-	/// Languages which we have dictionaries for
-	std::vector<std::string> languages;
+	/// The dictionary for the current language, which may still be loading
+	std::shared_ptr<Dictionary> dictionary;
 
-	/// Path to user-local dictionary.
-	agi::fs::path userDicPath;
+	/// Results of CheckWord() for the current dictionary
+	agi::SpellingCache checked_words;
 
-	/// Words in the custom user dictionary
-	std::set<std::string> customWords;
+	/// Languages which we have dictionaries for
+	std::vector<std::string> languages;
 
 	/// Dictionary language change connection
 	agi::signal::Connection lang_listener;
@@ -60,10 +60,12 @@ class HunspellSpellChecker final : public agi::SpellChecker {
 	/// Dictionary path change handler
 	void OnPathChanged();
 
-	/// Load words from custom dictionary
-	void ReadUserDictionary();
-	/// Save words to custom dictionary
-	void WriteUserDictionary();
+	/// Get the current dictionary, if it has finished loading
+	std::shared_ptr<Dictionary> GetLoadedDictionary();
+
+	/// Save the words added to the dictionary and tell the other spell
+	/// checkers about them
+	void WriteUserDictionary(Dictionary &dict);
 
 public:
 	HunspellSpellChecker();
@@ -0,0 +1,202 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include "spelling_index.h"
+
+#include "ass_dialogue.h"
+#include "ass_file.h"
+#include "include/aegisub/context.h"
+#include "include/aegisub/spellchecker.h"
+#include "options.h"
+
+#include <libaegisub/ass/dialogue_parser.h>
+#include <libaegisub/dispatch.h>
+#include <libaegisub/spellchecker.h>
+#include <libaegisub/trace.h>
+
+#include <atomic>
+#include <boost/locale/conversion.hpp>
+
+namespace {
+/// Number of lines to check in each job on the worker queue
+const size_t batch_size = 100;
+
+int CountErrors(agi::SpellChecker &spellchecker, std::string const& text, bool ignore_uppercase) {
+	auto tokens = agi::ass::TokenizeDialogueBody(text);
+	agi::ass::SplitWords(text, tokens);
+
+	// Words are skipped by the same rules as in the spell checker dialog
+	int errors = 0;
+	size_t pos = 0;
+	for (auto const& tok : tokens) {
+		if (tok.type == agi::ass::DialogueTokenType::WORD) {
+			std::string word = text.substr(pos, tok.length);
+			if (!spellchecker.CheckWord(word) && !(ignore_uppercase && word == boost::locale::to_upper(word)))
+				++errors;
+		}
+		pos += tok.length;
+	}
+	return errors;
+}
+}
+
+struct SpellingIndex::State {
+	/// Spellchecker used only by the jobs on the worker queue
+	std::unique_ptr<agi::SpellChecker> spellchecker;
+	/// Set to null when the index is destroyed
+	SpellingIndex *index = nullptr;
+	/// Incremented whenever the results of jobs already queued are no longer
+	/// wanted, so that they can stop early
+	std::atomic<size_t> generation{0};
+};
+
+SpellingIndex::SpellingIndex(agi::Context *c)
+: state(std::make_shared<State>())
+, context(c)
+, queue(agi::dispatch::Create(agi::dispatch::Priority::Bulk))
+, skip_comments(OPT_GET("Tool/Spell Checker/Skip Comments"))
+{
+	state->index = this;
+
+	connections = agi::signal::make_vector({
+		c->ass->AddChangesListener(&SpellingIndex::OnCommit, this),
+		// Adding or removing a word from the user dictionary also announces
+		// itself as a language change
+		OPT_SUB("Tool/Spell Checker/Language", &SpellingIndex::Reset, this),
+		OPT_SUB("Tool/Spell Checker/Skip Uppercase", &SpellingIndex::Reset, this),
+	});
+}
+
+SpellingIndex::~SpellingIndex() {
+	// Jobs which are still queued hold a reference to the state and check
+	// these before doing anything
+	state->index = nullptr;
+	++state->generation;
+	// The spellchecker has to be destroyed on the main thread
+	queue->Sync([]{});
+}
+
+void SpellingIndex::OnCommit(AssFileChanges const& changes) {
+	AGI_TRACE_ZONE("commit", "SpellingIndex");
+	if (changes.Everything()) {
+		++state->generation;
+		results.clear();
+		pending.clear();
+		Changed();
+		CheckChanged();
+	}
+	else if (changes.type & (AssFile::COMMIT_DIAG_ADDREM | AssFile::COMMIT_DIAG_TEXT)) {
+		if (!changes.modified_known) {
+			CheckChanged();
+			return;
+		}
+
+		for (int id : changes.removed) {
+			results.erase(id);
+			pending.erase(id);
+		}
+		auto lines = changes.added;
+		lines.insert(lines.end(), changes.modified.begin(), changes.modified.end());
+		Check(lines);
+	}
+}
+
+void SpellingIndex::Reset() {
+	++state->generation;
+	results.clear();
+	pending.clear();
+	Changed();
+
+	// The worker's spellchecker reloads its dictionary from the same option
+	// change, which may not have happened yet
+	auto s = state;
+	agi::dispatch::Main().Async([=] {
+		if (s->index) s->index->CheckChanged();
+	});
+}
+
+void SpellingIndex::CheckChanged() {
+	std::vector<const AssDialogue *> lines;
+	std::unordered_map<int, Result> current;
+	for (auto const& line : context->ass->Events) {
+		auto it = results.find(line.Id);
+		if (it != results.end() && it->second.text == line.Text)
+			current.insert(std::move(*it));
+		else
+			lines.push_back(&line);
+	}
+	// Drop the results for deleted lines
+	results = std::move(current);
+
+	Check(lines);
+}
+
+void SpellingIndex::Check(std::vector<const AssDialogue *> const& lines) {
+	if (!state->spellchecker) {
+		state->spellchecker = SpellCheckerFactory::GetSpellChecker();
+		if (!state->spellchecker) return;
+	}
+
+	const bool ignore_uppercase = OPT_GET("Tool/Spell Checker/Skip Uppercase")->GetBool();
+	const size_t generation = state->generation;
+
+	std::vector<std::pair<int, Result>> batch;
+	auto queue_batch = [&] {
+		auto s = state;
+		queue->Async([=]() mutable {
+			for (auto& entry : batch) {
+				if (s->generation != generation) return;
+				entry.second.errors = CountErrors(*s->spellchecker, entry.second.text, ignore_uppercase);
+			}
+			agi::dispatch::Main().Async([=] {
+				if (s->index) s->index->BatchDone(generation, batch);
+			});
+		});
+		batch.clear();
+	};
+
+	for (auto line : lines) {
+		auto it = pending.find(line->Id);
+		if (it != pending.end() && it->second == line->Text) continue;
+
+		pending[line->Id] = line->Text;
+		batch.push_back({line->Id, Result{line->Text, 0}});
+		if (batch.size() == batch_size)
+			queue_batch();
+	}
+	if (!batch.empty())
+		queue_batch();
+}
+
+void SpellingIndex::BatchDone(size_t generation, std::vector<std::pair<int, Result>> batch) {
+	if (generation != state->generation) return;
+
+	for (auto& entry : batch) {
+		auto it = pending.find(entry.first);
+		if (it != pending.end() && it->second == entry.second.text)
+			pending.erase(it);
+		results[entry.first] = std::move(entry.second);
+	}
+	Changed();
+}
+
+int SpellingIndex::Errors(const AssDialogue *line) const {
+	if (line->Comment && skip_comments->GetBool()) return 0;
+
+	auto it = results.find(line->Id);
+	if (it == results.end() || it->second.text != line->Text)
+		return -1;
+	return it->second.errors;
+}
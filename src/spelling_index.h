@@ -0,0 +1,87 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file spelling_index.h
+/// @brief Background spellchecking of every line in the file
+
+#pragma once
+
+#include <libaegisub/interned.h>
+#include <libaegisub/signal.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class AssDialogue;
+struct AssFileChanges;
+namespace agi {
+	struct Context;
+	class OptionValue;
+	namespace dispatch { class Queue; }
+}
+
+/// @class SpellingIndex
+/// @brief Knows how many misspelled words each line of the file has
+///
+/// Lines are checked on a worker queue with a spellchecker of their own
+/// whenever their text changes, so that every spelling error in the file can
+/// be shown at once without stepping through them in the spell checker.
+class SpellingIndex {
+	/// State shared with the jobs on the worker queue
+	struct State;
+	std::shared_ptr<State> state;
+
+	agi::Context *context;
+	std::unique_ptr<agi::dispatch::Queue> queue;
+
+	struct Result {
+		/// The text which was checked
+		agi::Interned<std::string> text;
+		/// Number of misspelled words in it
+		int errors;
+	};
+	/// Results for each line, by line ID
+	std::unordered_map<int, Result> results;
+	/// Text of each line which has been queued to be checked but not finished
+	std::unordered_map<int, agi::Interned<std::string>> pending;
+
+	const agi::OptionValue *skip_comments;
+
+	agi::signal::Signal<> Changed;
+	std::vector<agi::signal::Connection> connections;
+
+	void OnCommit(AssFileChanges const& changes);
+	/// Forget all results and check every line again
+	void Reset();
+	/// Check the lines whose current text hasn't been checked
+	void CheckChanged();
+	/// Queue the given lines to be checked
+	void Check(std::vector<const AssDialogue *> const& lines);
+	/// Handle a batch of lines having been checked
+	void BatchDone(size_t generation, std::vector<std::pair<int, Result>> batch);
+
+public:
+	SpellingIndex(agi::Context *c);
+	~SpellingIndex();
+
+	/// Get the number of misspelled words in a line
+	/// @return Number of misspelled words, or -1 if the current text of the
+	///         line hasn't been checked yet
+	int Errors(const AssDialogue *line) const;
+
+	DEFINE_SIGNAL_ADDERS(Changed, AddChangeListener)
+};
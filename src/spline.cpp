@@ -39,8 +39,28 @@
 #include <libaegisub/split.h>
 #include <libaegisub/util.h>
 
+#include <algorithm>
 #include <limits>
 
+namespace {
+/// Squared distance from a point to the bounding box of a curve's control
+/// points, which the curve lies entirely within
+float box_square_distance(SplineCurve const& curve, Vector2D ref) {
+	Vector2D lo = curve.p1, hi = curve.p1;
+	if (curve.type != SplineCurve::POINT) {
+		lo = lo.Min(curve.p2);
+		hi = hi.Max(curve.p2);
+	}
+	if (curve.type == SplineCurve::BICUBIC) {
+		lo = lo.Min(curve.p3).Min(curve.p4);
+		hi = hi.Max(curve.p3).Max(curve.p4);
+	}
+	float dx = std::max({lo.X() - ref.X(), 0.f, ref.X() - hi.X()});
+	float dy = std::max({lo.Y() - ref.Y(), 0.f, ref.Y() - hi.Y()});
+	return dx * dx + dy * dy;
+}
+}
+
 Spline::Spline(const VisualToolBase *tl)
 : coord_translator(tl)
 {
@@ -242,14 +262,27 @@ void Spline::GetClosestParametricPoint(Vector2D reference, iterator &curve, floa
 	// Close the shape
 	emplace_back(back().EndPoint(), front().p1);
 
+	// Finding the closest point on a bicubic curve means sampling it, so
+	// the curves are checked in order of how close their bounding boxes
+	// are, stopping once no box is closer than the closest point so far.
+	// Ties go to the first curve, as if they were all checked in order.
+	std::vector<std::pair<float, size_t>> by_distance;
+	by_distance.reserve(size());
+	for (size_t i = 0; i < size(); ++i)
+		by_distance.emplace_back(box_square_distance((*this)[i], reference), i);
+	std::sort(by_distance.begin(), by_distance.end());
+
 	float closest = std::numeric_limits<float>::infinity();
 	size_t idx = 0;
-	for (size_t i = 0; i < size(); ++i) {
+	for (auto const& candidate : by_distance) {
+		if (candidate.first > closest) break;
+
+		const size_t i = candidate.second;
 		auto& cur = (*this)[i];
 		float param = cur.GetClosestParam(reference);
 		Vector2D p1 = cur.GetPoint(param);
 		float dist = (p1-reference).SquareLen();
-		if (dist < closest) {
+		if (dist < closest || (dist == closest && i < idx)) {
 			closest = dist;
 			t = param;
 			idx = i;
@@ -0,0 +1,256 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include "stall_watchdog.h"
+
+#include "crash_writer.h"
+#include "options.h"
+#include "utils.h"
+#include "version.h"
+
+#include <libaegisub/dispatch.h>
+#include <libaegisub/format.h>
+#include <libaegisub/fs.h>
+#include <libaegisub/io.h>
+#include <libaegisub/log.h>
+#include <libaegisub/make_unique.h>
+#include <libaegisub/trace.h>
+#include <libaegisub/util.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace {
+using clock = std::chrono::steady_clock;
+
+/// How often the main thread's stack is sampled during a stall
+const auto sample_interval = std::chrono::milliseconds(50);
+/// A report is written after this many samples even if the main thread
+/// still hasn't recovered, in case it never does
+const size_t max_samples = 400;
+/// Number of distinct stacks and calls listed in a report
+const size_t reported_stacks = 5;
+const size_t reported_functions = 20;
+const size_t reported_depth = 40;
+
+/// Number of the last ping the main thread has handled. This is outside the
+/// watchdog so that pings still queued when it's destroyed are harmless.
+std::atomic<uint64_t> last_pong{0};
+
+long long ms(clock::duration d) {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+}
+
+class Watchdog {
+	agi::fs::path directory;
+	std::atomic<int> threshold{0};
+	agi::signal::Connection threshold_changed;
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool exit = false;
+	uint64_t last_ping = 0;
+
+	// Must be last so everything else is initialized before it
+	std::thread thread;
+
+	/// Wait for the given time or until asked to exit
+	/// @return false if the watchdog is exiting
+	bool Sleep(std::unique_lock<std::mutex>& lock, clock::duration time) {
+		return !cv.wait_for(lock, time, [&] { return exit; });
+	}
+
+	void Main();
+	void Report(std::vector<std::vector<void *>> const& samples, clock::duration duration, bool recovered, bool traced);
+
+public:
+	Watchdog(agi::fs::path const& directory)
+	: directory(directory)
+	, threshold(OPT_GET("App/Stall Report Threshold")->GetInt())
+	, threshold_changed(OPT_SUB("App/Stall Report Threshold", [=](agi::OptionValue const& opt) {
+		threshold = static_cast<int>(opt.GetInt());
+		cv.notify_all();
+	}))
+	, thread([=] { Main(); })
+	{
+	}
+
+	~Watchdog() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			exit = true;
+		}
+		cv.notify_all();
+		thread.join();
+	}
+};
+
+void Watchdog::Main() {
+	agi::util::SetThreadName("Stall Watchdog");
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!exit) {
+		const int threshold_ms = threshold;
+		if (threshold_ms <= 0) {
+			cv.wait(lock, [&] { return exit || threshold > 0; });
+			continue;
+		}
+
+		// Ask the main loop to acknowledge the ping, and treat it as stalled
+		// if it hasn't within the threshold
+		const uint64_t ping = ++last_ping;
+		const auto sent = clock::now();
+		agi::dispatch::Main().Async([ping] { last_pong = ping; });
+		if (!Sleep(lock, std::chrono::milliseconds(threshold_ms))) break;
+		if (last_pong >= ping) continue;
+
+		// Record what the other threads are doing during the stall, unless
+		// someone is already recording a trace
+		const bool traced = agi::trace::IsAvailable() && !agi::trace::IsRecording();
+		if (traced)
+			agi::trace::Start();
+
+		std::vector<std::vector<void *>> samples;
+		while (last_pong < ping && samples.size() < max_samples) {
+			samples.push_back(crash_writer::SampleMainThread());
+			if (!Sleep(lock, sample_interval)) break;
+		}
+		const bool recovered = last_pong >= ping;
+		const auto duration = clock::now() - sent;
+		if (traced)
+			agi::trace::Stop();
+
+		lock.unlock();
+		Report(samples, duration, recovered, traced);
+		lock.lock();
+
+		// Don't report a stall which outlasted max_samples a second time
+		while (!exit && last_pong < ping)
+			Sleep(lock, sample_interval);
+	}
+}
+
+void Watchdog::Report(std::vector<std::vector<void *>> const& samples, clock::duration duration, bool recovered, bool traced) {
+	// Look up each address just once, as symbolizing is slow
+	std::set<void *> addresses;
+	for (auto const& sample : samples)
+		addresses.insert(begin(sample), end(sample));
+	std::vector<void *> address_list(begin(addresses), end(addresses));
+	auto names = crash_writer::Symbolize(address_list);
+	std::map<void *, std::string> name_of;
+	for (size_t i = 0; i < names.size(); ++i)
+		name_of[address_list[i]] = std::move(names[i]);
+
+	// Group the samples by the functions on the stack, and count how many
+	// samples each function appears anywhere in
+	std::map<std::vector<std::string>, size_t> stacks;
+	std::map<std::string, size_t> functions;
+	size_t sampled = 0;
+	for (auto const& sample : samples) {
+		if (sample.empty()) continue;
+		++sampled;
+		std::vector<std::string> stack;
+		for (auto address : sample)
+			stack.push_back(name_of[address]);
+		for (auto const& name : std::set<std::string>(begin(stack), end(stack)))
+			++functions[name];
+		++stacks[std::move(stack)];
+	}
+
+	const auto now = agi::util::strftime("%Y%m%d-%H%M%S");
+	const auto base = directory/("stall-" + now);
+	auto percent = [&](size_t count) { return static_cast<int>(count * 100 / std::max<size_t>(1, sampled)); };
+
+	try {
+		{
+			agi::io::Save file(base.string() + ".txt");
+			auto& out = file.Get();
+			out << "Aegisub stall report\n";
+			agi::format(out, "Version: %s\n", GetAegisubLongVersionString());
+			out << agi::util::strftime("Time: %Y-%m-%d %H:%M:%S\n");
+			if (recovered)
+				agi::format(out, "The main thread didn't respond for %d ms\n", ms(duration));
+			else
+				agi::format(out, "The main thread still hadn't responded after %d ms\n", ms(duration));
+			agi::format(out, "Stack samples: %d, taken every %d ms\n", sampled, ms(sample_interval));
+
+			if (!sampled)
+				out << "\nThe main thread's stack could not be sampled on this platform\n";
+			else {
+				std::vector<std::pair<size_t, std::string const*>> by_count;
+				for (auto const& function : functions)
+					by_count.emplace_back(function.second, &function.first);
+				sort(begin(by_count), end(by_count), [](auto const& a, auto const& b) { return a.first > b.first; });
+
+				out << "\nFunctions on the stack in the most samples:\n";
+				for (size_t i = 0; i < std::min(reported_functions, by_count.size()); ++i)
+					agi::format(out, "%3d%%  %s\n", percent(by_count[i].first), *by_count[i].second);
+
+				std::vector<std::pair<size_t, std::vector<std::string> const*>> stack_counts;
+				for (auto const& stack : stacks)
+					stack_counts.emplace_back(stack.second, &stack.first);
+				sort(begin(stack_counts), end(stack_counts), [](auto const& a, auto const& b) { return a.first > b.first; });
+
+				agi::format(out, "\nMost common of %d distinct stacks, innermost call first:\n", stack_counts.size());
+				for (size_t i = 0; i < std::min(reported_stacks, stack_counts.size()); ++i) {
+					auto const& stack = *stack_counts[i].second;
+					agi::format(out, "\n%d samples (%d%%):\n", stack_counts[i].first, percent(stack_counts[i].first));
+					for (size_t j = 0; j < std::min(reported_depth, stack.size()); ++j)
+						agi::format(out, "  %s\n", stack[j]);
+					if (stack.size() > reported_depth)
+						agi::format(out, "  ... %d more\n", stack.size() - reported_depth);
+				}
+			}
+
+			if (traced)
+				agi::format(out, "\nA trace of every thread during the stall is in %s.json\n", base.filename().string());
+		}
+
+		if (traced)
+			agi::trace::Write(agi::io::Save(base.string() + ".json").Get());
+
+		LOG_W("stall_watchdog") << "The main thread stalled for " << ms(duration) << " ms; wrote " << base << ".txt";
+	}
+	catch (agi::Exception const& e) {
+		LOG_E("stall_watchdog") << "Could not write stall report: " << e.GetMessage();
+	}
+}
+
+std::unique_ptr<Watchdog> watchdog;
+}
+
+namespace stall_watchdog {
+void Start(agi::fs::path const& directory) {
+	if (watchdog) return;
+	try {
+		agi::fs::CreateDirectory(directory);
+		CleanCache(directory, "stall-*", 50, 40);
+	}
+	catch (agi::Exception const& e) {
+		LOG_E("stall_watchdog") << "Could not create " << directory << ": " << e.GetMessage();
+	}
+	watchdog = agi::make_unique<Watchdog>(directory);
+}
+
+void Stop() {
+	watchdog.reset();
+}
+}
@@ -0,0 +1,33 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+/// @file stall_watchdog.h
+/// @brief Detection and reporting of the main loop being blocked
+/// @ingroup main
+
+#pragma once
+
+#include <libaegisub/fs_fwd.h>
+
+namespace stall_watchdog {
+	/// Start checking from a background thread that the main loop keeps
+	/// handling events. Whenever it goes longer than App/Stall Report
+	/// Threshold without doing so, the main thread's stack is sampled until
+	/// it recovers and a report is written to directory.
+	void Start(agi::fs::path const& directory);
+
+	/// Stop the watchdog thread; must be called before the main loop and
+	/// crash_writer are torn down
+	void Stop();
+}
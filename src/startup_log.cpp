@@ -0,0 +1,39 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include "startup_log.h"
+
+#include <libaegisub/log.h>
+
+#include <chrono>
+
+namespace {
+using clock = std::chrono::steady_clock;
+
+clock::time_point start = clock::now();
+clock::time_point last = start;
+
+long long ms(clock::duration d) {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+}
+}
+
+namespace startup_log {
+void Phase(const char *section, const char *phase) {
+	auto now = clock::now();
+	LOG_I(section) << "[" << ms(now - start) << " ms, previous step " << ms(now - last) << " ms] " << phase;
+	last = now;
+}
+}
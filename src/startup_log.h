@@ -1,4 +1,4 @@
-// Copyright (c) 2015, Thomas Goyne <plorkyeran@aegisub.org>
+// Copyright (c) 2026
 //
 // Permission to use, copy, modify, and distribute this software for any
 // purpose with or without fee is hereby granted, provided that the above
@@ -11,18 +11,18 @@
 // WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
 // ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
 // OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
-//
-// Aegisub Project http://www.aegisub.org/
 
-#pragma once
 
-#include <boost/flyweight.hpp>
+/// @file startup_log.h
+/// @brief Timing of the phases of application startup
+/// @ingroup main
+
+#pragma once
 
-namespace std {
-	template <typename T>
-	struct hash<boost::flyweight<T>> {
-		size_t operator()(boost::flyweight<T> const& ss) const {
-			return hash<const void*>()(&ss.get());
-		}
-	};
+namespace startup_log {
+	/// Log that a startup phase has begun, along with the time since the
+	/// process started and how long the previous phase took
+	/// @param section Log section to write the entry to
+	/// @param phase Description of the phase which is beginning
+	void Phase(const char *section, const char *phase);
 }
@@ -20,6 +20,7 @@
 #include "ass_dialogue.h"
 #include "ass_file.h"
 #include "ass_info.h"
+#include "ass_snapshot.h"
 #include "ass_style.h"
 #include "compat.h"
 #include "command/command.h"
@@ -36,9 +37,15 @@
 #include <libaegisub/dispatch.h>
 #include <libaegisub/format_path.h>
 #include <libaegisub/fs.h>
+#include <libaegisub/log.h>
+#include <libaegisub/make_unique.h>
 #include <libaegisub/path.h>
+#include <libaegisub/trace.h>
 #include <libaegisub/util.h>
 
+#include <boost/algorithm/string/predicate.hpp>
+#include <cstring>
+#include <unordered_map>
 #include <wx/msgdlg.h>
 
 namespace {
@@ -49,106 +56,421 @@ namespace {
 		else
 			timer->Stop();
 	}
+
+	const char autosave_suffix[] = ".AUTOSAVE.ass";
+	/// Length of the timestamp autosaves are named with
+	const size_t autosave_timestamp_length = sizeof("YYYY-MM-DD-HH-MM-SS") - 1;
+
+	/// Delete all but the newest keep autosaves of the named file
+	void remove_old_autosaves(agi::fs::path const& directory, std::string const& name, size_t keep) {
+		// Match by hand rather than with the filter, as names often contain
+		// brackets which would be treated as a pattern
+		std::vector<std::string> autosaves;
+		for (auto const& file : agi::fs::DirectoryIterator(directory, std::string("*") + autosave_suffix)) {
+			if (file.size() == name.size() + 1 + autosave_timestamp_length + strlen(autosave_suffix)
+				&& boost::starts_with(file, name + "."))
+				autosaves.push_back(file);
+		}
+		if (autosaves.size() <= keep) return;
+
+		// The timestamps sort chronologically
+		sort(begin(autosaves), end(autosaves));
+		for (size_t i = 0; i + keep < autosaves.size(); ++i) {
+			try {
+				agi::fs::Remove(directory / autosaves[i]);
+			}
+			catch (agi::fs::FileSystemError const& err) {
+				LOG_W("subs_controller/autosave") << err.GetMessage();
+			}
+		}
+	}
 }
 
-struct SubsController::UndoInfo {
-	wxString undo_description;
-	int commit_id;
+namespace {
+	bool SameStyles(std::vector<AssStyle> const& copies, EntryList<AssStyle> const& styles) {
+		auto it = copies.begin();
+		for (auto const& style : styles) {
+			if (it == copies.end() || it->GetEntryData() != style.GetEntryData())
+				return false;
+			++it;
+		}
+		return it == copies.end();
+	}
 
-	std::vector<std::pair<std::string, std::string>> script_info;
-	std::vector<AssStyle> styles;
+	bool SameExtradata(ExtradataEntry const& a, ExtradataEntry const& b) {
+		return a.id == b.id && a.key == b.key && a.value == b.value;
+	}
+
+	using ScriptInfo = std::vector<std::pair<std::string, std::string>>;
+
+	ScriptInfo CopyScriptInfo(AssFile const& file) {
+		ScriptInfo ret;
+		ret.reserve(file.Info.size());
+		for (auto const& info : file.Info)
+			ret.emplace_back(info.Key(), info.Value());
+		return ret;
+	}
+}
+
+/// The file as of the most recent undoable commit, which each commit is
+/// compared against to find what changed
+struct SubsController::CommittedState {
 	std::vector<AssDialogueBase> events;
+	/// Index in events of each line Id
+	std::unordered_map<int, size_t> index;
+	ScriptInfo script_info;
+	std::vector<AssStyle> styles;
 	std::vector<AssAttachment> attachments;
 	std::vector<ExtradataEntry> extradata;
 
-	mutable std::vector<int> selection;
-	int active_line_id = 0;
-	int pos = 0, sel_start = 0, sel_end = 0;
+	void CopyEvents(AssFile const& file) {
+		events.assign(file.Events.begin(), file.Events.end());
+		index.clear();
+		index.reserve(events.size());
+		for (size_t i = 0; i < events.size(); ++i)
+			index[events[i].Id] = i;
+	}
+
+	void Reset(AssFile const& file) {
+		CopyEvents(file);
+		script_info = CopyScriptInfo(file);
+		styles.assign(file.Styles.begin(), file.Styles.end());
+		attachments = file.Attachments;
+		extradata = file.Extradata;
+	}
+};
+
+/// @brief The changes made by a single undoable commit
+///
+/// Only what differs from the previous state is stored, and it's stored in
+/// both directions so that undo and redo can be applied to the live file in
+/// place rather than rebuilding it from a snapshot.
+struct SubsController::UndoInfo {
+	wxString undo_description;
+	int commit_id;
+
+	/// A dialogue line which was added, removed or modified
+	struct LineChange {
+		int id;
+		bool existed_before;
+		bool exists_after;
+		AssDialogueBase before;
+		AssDialogueBase after;
+	};
+	std::vector<LineChange> lines;
+
+	/// Line Ids in file order before and after, if lines were added, removed
+	/// or moved
+	std::vector<int> order_before, order_after;
+
+	/// A whole section which changed
+	template<typename T>
+	struct SectionChange {
+		bool changed = false;
+		T before, after;
+
+		void Record(T& current, T new_value) {
+			if (!changed)
+				before = current;
+			changed = true;
+			after = new_value;
+			current = std::move(new_value);
+		}
+	};
+	SectionChange<ScriptInfo> script_info;
+	SectionChange<std::vector<AssStyle>> styles;
+	SectionChange<std::vector<AssAttachment>> attachments;
+	SectionChange<std::vector<ExtradataEntry>> extradata;
+
+	/// Selection and cursor position to restore when returning to this state
+	struct CursorState {
+		std::vector<int> selection;
+		int active_line_id = 0;
+		int pos = 0, sel_start = 0, sel_end = 0;
+	} cursor;
+
+	/// Estimated size of this step in bytes, updated by Record()
+	size_t memory = 0;
+
+	/// Estimate the size of this step
+	///
+	/// The text of changed lines is counted even though it may be shared
+	/// with the file or other steps, as the old versions usually aren't.
+	size_t EstimateSize() const {
+		size_t size = sizeof(*this) + lines.capacity() * sizeof(LineChange)
+			+ (order_before.capacity() + order_after.capacity() + cursor.selection.capacity()) * sizeof(int);
+		for (auto const& change : lines)
+			size += change.before.Text.get().size() + change.after.Text.get().size();
+		if (script_info.changed) {
+			for (auto const& info : script_info.before)
+				size += sizeof(info) + info.first.size() + info.second.size();
+			for (auto const& info : script_info.after)
+				size += sizeof(info) + info.first.size() + info.second.size();
+		}
+		if (styles.changed)
+			size += (styles.before.size() + styles.after.size()) * sizeof(AssStyle);
+		if (attachments.changed)
+			size += (attachments.before.size() + attachments.after.size()) * sizeof(AssAttachment);
+		if (extradata.changed) {
+			for (auto const& entry : extradata.before)
+				size += sizeof(entry) + entry.key.size() + entry.value.size();
+			for (auto const& entry : extradata.after)
+				size += sizeof(entry) + entry.key.size() + entry.value.size();
+		}
+		return size;
+	}
 
 	UndoInfo(const agi::Context *c, wxString const& d, int commit_id)
 	: undo_description(d)
 	, commit_id(commit_id)
-	, attachments(c->ass->Attachments)
-	, extradata(c->ass->Extradata)
 	{
-		script_info.reserve(c->ass->Info.size());
-		for (auto const& info : c->ass->Info)
-			script_info.emplace_back(info.Key(), info.Value());
-
-		styles.reserve(c->ass->Styles.size());
-		styles.assign(c->ass->Styles.begin(), c->ass->Styles.end());
-
-		events.reserve(c->ass->Events.size());
-		events.assign(c->ass->Events.begin(), c->ass->Events.end());
-
 		UpdateActiveLine(c);
 		UpdateSelection(c);
 		UpdateTextSelection(c);
 	}
 
-	void Apply(agi::Context *c) const {
-		// Keep old dialogue lines alive until after the commit is complete
+	/// Record the differences between the file and state, and update state
+	/// to match the file
+	///
+	/// This may be called more than once to fold several commits into one
+	/// undo step.
+	void Record(AssFile const& file, CommittedState& state, int type, const AssDialogue *single_line) {
+		// Lines changed by earlier commits folded into this one
+		LineIndex previous;
+		previous.reserve(lines.size());
+		for (size_t i = 0; i < lines.size(); ++i)
+			previous[lines[i].id] = i;
+
+		const bool reorder = type == AssFile::COMMIT_NEW || (type & (AssFile::COMMIT_ORDER | AssFile::COMMIT_DIAG_ADDREM));
+		if (single_line && !reorder && state.index.count(single_line->Id))
+			RecordLine(state, *single_line, previous);
+		else if (reorder || (type & (AssFile::COMMIT_DIAG_FULL | AssFile::COMMIT_EXTRADATA)))
+			RecordEvents(file, state, previous);
+
+		// Everything else is small enough to just compare, except for the
+		// attachments which are only touched by commits which say so
+		if (!std::equal(state.script_info.begin(), state.script_info.end(), file.Info.begin(), file.Info.end(),
+			[](std::pair<std::string, std::string> const& a, AssInfo const& b) {
+				return a.first == b.Key() && a.second == b.Value();
+			}))
+			script_info.Record(state.script_info, CopyScriptInfo(file));
+		if (!SameStyles(state.styles, file.Styles))
+			styles.Record(state.styles, std::vector<AssStyle>(file.Styles.begin(), file.Styles.end()));
+		if (type == AssFile::COMMIT_NEW || (type & AssFile::COMMIT_ATTACHMENT))
+			attachments.Record(state.attachments, file.Attachments);
+		if (!std::equal(state.extradata.begin(), state.extradata.end(), file.Extradata.begin(), file.Extradata.end(), SameExtradata))
+			extradata.Record(state.extradata, file.Extradata);
+
+		memory = EstimateSize();
+	}
+
+	/// Apply the changes to the file, in reverse if undoing
+	void Apply(agi::Context *c, CommittedState& state, bool redo) const {
+		auto& file = *c->ass;
+		int type = 0;
+
+		// Keep removed dialogue lines alive until after the commit is complete
 		// since a bunch of stuff holds references to them
 		AssFile old;
-		old.Events.swap(c->ass->Events);
-		c->ass->Info.clear();
-		c->ass->Attachments.clear();
-		c->ass->Styles.clear();
-		c->ass->Extradata.clear();
 
-		sort(begin(selection), end(selection));
+		auto const& order = redo ? order_after : order_before;
+		if (!lines.empty() || !order.empty()) {
+			std::unordered_map<int, AssDialogue *> by_id;
+			by_id.reserve(file.Events.size());
+			for (auto& line : file.Events)
+				by_id[line.Id] = &line;
+
+			for (auto const& change : lines) {
+				if (!(redo ? change.exists_after : change.existed_before)) continue;
+				auto const& target = redo ? change.after : change.before;
+				auto it = by_id.find(change.id);
+				if (it != by_id.end()) {
+					int row = it->second->Row;
+					static_cast<AssDialogueBase&>(*it->second) = target;
+					it->second->Row = row;
+				}
+				else if (!order.empty())
+					by_id[change.id] = new AssDialogue(target);
+			}
+			type |= AssFile::COMMIT_DIAG_FULL | AssFile::COMMIT_EXTRADATA;
+
+			if (!order.empty()) {
+				file.Events.clear();
+				for (int id : order) {
+					auto it = by_id.find(id);
+					if (it == by_id.end()) continue;
+					file.Events.push_back(*it->second);
+					by_id.erase(it);
+				}
+				for (auto const& line : by_id)
+					old.Events.push_back(*line.second);
+				type |= AssFile::COMMIT_DIAG_ADDREM | AssFile::COMMIT_ORDER;
+			}
+		}
+
+		if (script_info.changed) {
+			file.Info.clear();
+			for (auto const& info : redo ? script_info.after : script_info.before)
+				file.Info.emplace_back(info.first, info.second);
+			type |= AssFile::COMMIT_SCRIPTINFO;
+		}
+		if (styles.changed) {
+			old.Styles.swap(file.Styles);
+			for (auto const& style : redo ? styles.after : styles.before)
+				file.Styles.push_back(*new AssStyle(style));
+			type |= AssFile::COMMIT_STYLES;
+		}
+		if (attachments.changed) {
+			file.Attachments = redo ? attachments.after : attachments.before;
+			type |= AssFile::COMMIT_ATTACHMENT;
+		}
+		if (extradata.changed) {
+			file.Extradata = redo ? extradata.after : extradata.before;
+			type |= AssFile::COMMIT_EXTRADATA;
+		}
+
+		// Bring the committed state up to date with the file
+		if (!order.empty())
+			state.CopyEvents(file);
+		else {
+			for (auto const& change : lines) {
+				auto it = state.index.find(change.id);
+				if (it != state.index.end() && (redo ? change.exists_after : change.existed_before))
+					state.events[it->second] = redo ? change.after : change.before;
+			}
+		}
+		if (script_info.changed)
+			state.script_info = redo ? script_info.after : script_info.before;
+		if (styles.changed)
+			state.styles = redo ? styles.after : styles.before;
+		if (attachments.changed)
+			state.attachments = redo ? attachments.after : attachments.before;
+		if (extradata.changed)
+			state.extradata = redo ? extradata.after : extradata.before;
+
+		if (type)
+			file.Commit("", type);
+	}
+
+	/// Restore the selection and cursor position of a state
+	static void Restore(agi::Context *c, CursorState cursor) {
+		sort(begin(cursor.selection), end(cursor.selection));
 
 		AssDialogue *active_line = nullptr;
 		Selection new_sel;
-
-		for (auto const& info : script_info)
-			c->ass->Info.push_back(*new AssInfo(info.first, info.second));
-		for (auto const& style : styles)
-			c->ass->Styles.push_back(*new AssStyle(style));
-		c->ass->Attachments = attachments;
-		for (auto const& event : events) {
-			auto copy = new AssDialogue(event);
-			c->ass->Events.push_back(*copy);
-			if (copy->Id == active_line_id)
-				active_line = copy;
-			if (binary_search(begin(selection), end(selection), copy->Id))
-				new_sel.insert(copy);
+		for (auto& line : c->ass->Events) {
+			if (line.Id == cursor.active_line_id)
+				active_line = &line;
+			if (binary_search(begin(cursor.selection), end(cursor.selection), line.Id))
+				new_sel.insert(&line);
 		}
-		c->ass->Extradata = extradata;
 
-		c->ass->Commit("", AssFile::COMMIT_NEW);
 		c->selectionController->SetSelectionAndActive(std::move(new_sel), active_line);
-
-		c->textSelectionController->SetInsertionPoint(pos);
-		c->textSelectionController->SetSelection(sel_start, sel_end);
+		c->textSelectionController->SetInsertionPoint(cursor.pos);
+		c->textSelectionController->SetSelection(cursor.sel_start, cursor.sel_end);
 	}
 
 	void UpdateActiveLine(const agi::Context *c) {
 		auto line = c->selectionController->GetActiveLine();
 		if (line)
-			active_line_id = line->Id;
+			cursor.active_line_id = line->Id;
 	}
 
 	void UpdateSelection(const agi::Context *c) {
 		auto const& sel = c->selectionController->GetSelectedSet();
-		selection.clear();
-		selection.reserve(sel.size());
+		cursor.selection.clear();
+		cursor.selection.reserve(sel.size());
 		for (const auto diag : sel)
-			selection.push_back(diag->Id);
+			cursor.selection.push_back(diag->Id);
 	}
 
 	void UpdateTextSelection(const agi::Context *c) {
-		pos = c->textSelectionController->GetInsertionPoint();
-		sel_start = c->textSelectionController->GetSelectionStart();
-		sel_end = c->textSelectionController->GetSelectionEnd();
+		cursor.pos = c->textSelectionController->GetInsertionPoint();
+		cursor.sel_start = c->textSelectionController->GetSelectionStart();
+		cursor.sel_end = c->textSelectionController->GetSelectionEnd();
+	}
+
+private:
+	using LineIndex = std::unordered_map<int, size_t>;
+
+	void AddLineChange(LineIndex const& previous, int id, AssDialogueBase const *before, AssDialogueBase const *after) {
+		auto it = previous.find(id);
+		if (it != previous.end()) {
+			auto& change = lines[it->second];
+			change.exists_after = !!after;
+			change.after = after ? *after : AssDialogueBase();
+			return;
+		}
+		lines.push_back({id, !!before, !!after,
+			before ? *before : AssDialogueBase(), after ? *after : AssDialogueBase()});
+	}
+
+	void RecordLine(CommittedState& state, AssDialogueBase const& line, LineIndex const& previous) {
+		auto& old = state.events[state.index[line.Id]];
+		if (SameContents(old, line)) return;
+		AddLineChange(previous, line.Id, &old, &line);
+		old = line;
+	}
+
+	void RecordEvents(AssFile const& file, CommittedState& state, LineIndex const& previous) {
+		std::vector<int> order;
+		order.reserve(file.Events.size());
+		std::vector<bool> seen(state.events.size());
+		size_t seen_count = 0;
+		bool reordered = false;
+		std::vector<std::pair<size_t, AssDialogueBase const *>> modified;
+
+		for (auto const& line : file.Events) {
+			auto it = state.index.find(line.Id);
+			if (it == state.index.end()) {
+				AddLineChange(previous, line.Id, nullptr, &line);
+				reordered = true;
+			}
+			else {
+				if (it->second != order.size())
+					reordered = true;
+				seen[it->second] = true;
+				++seen_count;
+				auto const& old = state.events[it->second];
+				if (!SameContents(old, line)) {
+					AddLineChange(previous, line.Id, &old, &line);
+					modified.emplace_back(it->second, &line);
+				}
+			}
+			order.push_back(line.Id);
+		}
+
+		if (seen_count != state.events.size()) {
+			reordered = true;
+			for (size_t i = 0; i < seen.size(); ++i) {
+				if (!seen[i])
+					AddLineChange(previous, state.events[i].Id, &state.events[i], nullptr);
+			}
+		}
+
+		if (reordered) {
+			if (order_after.empty()) {
+				order_before.reserve(state.events.size());
+				for (auto const& line : state.events)
+					order_before.push_back(line.Id);
+			}
+			order_after = std::move(order);
+			state.CopyEvents(file);
+		}
+		else {
+			for (auto const& line : modified)
+				state.events[line.first] = *line.second;
+		}
 	}
 };
 
 SubsController::SubsController(agi::Context *context)
 : context(context)
+, committed(agi::make_unique<CommittedState>())
 , undo_connection(context->ass->AddUndoManager(&SubsController::OnCommit, this))
 , text_selection_connection(context->textSelectionController->AddSelectionListener(&SubsController::OnTextSelectionChanged, this))
-, autosave_queue(agi::dispatch::Create())
+, autosave_queue(agi::dispatch::Create(agi::dispatch::Priority::Bulk))
+, save_queue(agi::dispatch::Create())
 {
 	autosave_timer_changed(&autosave_timer);
 	OPT_SUB("App/Auto/Save", [=] { autosave_timer_changed(&autosave_timer); });
@@ -157,7 +479,8 @@ SubsController::SubsController(agi::Context *context)
 }
 
 SubsController::~SubsController() {
-	// Make sure there are no autosaves in progress
+	// Make sure there are no saves or autosaves in progress
+	save_queue->Sync([]{ });
 	autosave_queue->Sync([]{ });
 }
 
@@ -203,6 +526,9 @@ void SubsController::Save(agi::fs::path const& filename, std::string const& enco
 	if (!writer)
 		throw agi::InvalidInputException("Unknown file type.");
 
+	// Don't let a pending background save overwrite this one
+	save_queue->Sync([]{ });
+
 	int old_autosaved_commit_id = autosaved_commit_id, old_saved_commit_id = saved_commit_id;
 	try {
 		autosaved_commit_id = saved_commit_id = commit_id;
@@ -258,6 +584,12 @@ void SubsController::AutoSave() {
 	if (commit_id == autosaved_commit_id)
 		return;
 
+	// On slow storage queueing another autosave behind one which is still
+	// being written would just make every later one later too, so try again
+	// next time instead
+	if (autosave_running)
+		return;
+
 	auto directory = context->path->Decode(OPT_GET("Path/Auto/Save")->GetString());
 	if (directory.empty())
 		directory = filename.parent_path();
@@ -267,18 +599,23 @@ void SubsController::AutoSave() {
 		name = "Untitled";
 
 	autosaved_commit_id = commit_id;
+	autosave_running = true;
 	auto frame = context->frame;
-	auto subs_copy = new AssFile(*context->ass);
-	autosave_queue->Async([subs_copy, name, directory, frame] {
+	auto subs_snapshot = Snapshot();
+	auto keep = static_cast<size_t>(std::max<int64_t>(0, OPT_GET("App/Auto/Save Keep Count")->GetInt()));
+	autosave_queue->Async([this, subs_snapshot, name, directory, frame, keep] {
 		wxString msg;
-		std::unique_ptr<AssFile> subs(subs_copy);
 
 		try {
+			auto subs = subs_snapshot->ToFile();
 			agi::fs::CreateDirectory(directory);
-			auto path = directory /  agi::format("%s.%s.AUTOSAVE.ass", name.string(),
-			                                     agi::util::strftime("%Y-%m-%d-%H-%M-%S"));
+			auto path = directory /  agi::format("%s.%s%s", name.string(),
+			                                     agi::util::strftime("%Y-%m-%d-%H-%M-%S"), autosave_suffix);
 			SubtitleFormat::GetWriter(path)->WriteFile(subs.get(), path, 0);
 			msg = fmt_tl("File backup saved as \"%s\".", path);
+
+			if (keep > 0)
+				remove_old_autosaves(directory, name.string(), keep);
 		}
 		catch (const agi::Exception& err) {
 			msg = to_wx("Exception when attempting to autosave file: " + err.GetMessage());
@@ -287,12 +624,60 @@ void SubsController::AutoSave() {
 			msg = "Unhandled exception when attempting to autosave file.";
 		}
 
+		autosave_running = false;
 		agi::dispatch::Main().Async([frame, msg] {
 			frame->StatusTimeout(msg);
 		});
 	});
 }
 
+void SubsController::SaveInBackground() {
+	const SubtitleFormat *writer = SubtitleFormat::GetWriter(filename);
+
+	UpdateProperties();
+	auto props = context->ass->Properties;
+	auto subs_snapshot = Snapshot();
+	auto path = filename;
+	auto frame = context->frame;
+	int id = commit_id;
+	autosaved_commit_id = saved_commit_id = commit_id;
+	FileSave();
+
+	save_queue->Async([=] {
+		wxString msg;
+		try {
+			auto subs = subs_snapshot->ToFile();
+			subs->Properties = props;
+			subs->CleanExtradata();
+			writer->WriteFile(subs.get(), path, 0);
+			return;
+		}
+		catch (const agi::Exception& err) {
+			msg = to_wx("Exception when attempting to save file: " + err.GetMessage());
+		}
+		catch (...) {
+			msg = "Unhandled exception when attempting to save file.";
+		}
+
+		agi::dispatch::Main().Async([=] {
+			// Mark the file as modified again unless it's been saved since
+			if (saved_commit_id == id) {
+				saved_commit_id = 0;
+				FileSave();
+			}
+			frame->StatusTimeout(msg);
+		});
+	});
+}
+
+std::shared_ptr<const AssSnapshot> SubsController::Snapshot() {
+	if (snapshot_stale) {
+		snapshot = AssSnapshot::Create(*context->ass, snapshot.get());
+		snapshot_stale = false;
+	}
+	return snapshot;
+}
+
 bool SubsController::CanSave() const {
 	try {
 		return SubtitleFormat::GetWriter(filename)->CanSave(context->ass.get());
@@ -311,27 +696,10 @@ void SubsController::SetFileName(agi::fs::path const& path) {
 }
 
 void SubsController::OnCommit(AssFileCommit c) {
+	AGI_TRACE_ZONE("commit", "SubsController");
+	snapshot_stale = true;
 	if (c.message.empty() && !undo_stack.empty()) return;
 
-	commit_id = next_commit_id++;
-	// Allow coalescing only if it's the last change and the file has not been
-	// saved since the last change
-	if (commit_id == *c.commit_id+1 && redo_stack.empty() && saved_commit_id+1 != commit_id) {
-		// If only one line changed just modify it instead of copying the file
-		if (c.single_line && c.single_line->Group() == AssEntryGroup::DIALOGUE) {
-			for (auto& diag : undo_stack.back().events) {
-				if (diag.Id == c.single_line->Id) {
-					diag = *c.single_line;
-					break;
-				}
-			}
-			*c.commit_id = commit_id;
-			return;
-		}
-
-		undo_stack.pop_back();
-	}
-
 	// Make sure the file has at least one style and one dialogue line
 	if (context->ass->Styles.empty())
 		context->ass->Styles.push_back(*new AssStyle);
@@ -340,20 +708,74 @@ void SubsController::OnCommit(AssFileCommit c) {
 		context->ass->Events.back().Row = 0;
 	}
 
+	commit_id = next_commit_id++;
+
+	if (undo_stack.empty()) {
+		// The file was just opened or closed, so this is the base everything
+		// after it is relative to
+		committed->Reset(*context->ass);
+		undo_stack.emplace_back(context, c.message, commit_id);
+		*c.commit_id = commit_id;
+		UpdateMemoryUsage(true);
+		return;
+	}
+
+	// Allow coalescing only if it's the last change and the file has not been
+	// saved since the last change
+	if (commit_id == *c.commit_id+1 && redo_stack.empty() && saved_commit_id+1 != commit_id && undo_stack.size() > 1) {
+		auto& last = undo_stack.back();
+		last.Record(*context->ass, *committed, c.type, c.single_line);
+		last.undo_description = c.message;
+		last.commit_id = commit_id;
+		*c.commit_id = commit_id;
+		UpdateMemoryUsage(c.type & AssFile::COMMIT_ATTACHMENT);
+		return;
+	}
+
 	redo_stack.clear();
 
 	undo_stack.emplace_back(context, c.message, commit_id);
+	undo_stack.back().Record(*context->ass, *committed, c.type, c.single_line);
 
 	int depth = std::max<int>(OPT_GET("Limits/Undo Levels")->GetInt(), 2);
 	while ((int)undo_stack.size() > depth)
 		undo_stack.pop_front();
+	UpdateMemoryUsage(c.type == AssFile::COMMIT_NEW || (c.type & AssFile::COMMIT_ATTACHMENT));
 
 	if (undo_stack.size() > 1 && OPT_GET("App/Auto/Save on Every Change")->GetBool() && !filename.empty() && CanSave())
-		Save(filename);
+		SaveInBackground();
 
 	*c.commit_id = commit_id;
 }
 
+void SubsController::UpdateMemoryUsage(bool attachments_changed) {
+	size_t undo_size = 0;
+	for (auto const& step : undo_stack)
+		undo_size += step.memory;
+	for (auto const& step : redo_stack)
+		undo_size += step.memory;
+	undo_memory.Set(undo_size);
+
+	if (attachments_changed) {
+		size_t attachment_size = 0;
+		for (auto const& attachment : context->ass->Attachments)
+			attachment_size += attachment.GetEntryData().size();
+		attachment_memory.Set(attachment_size);
+	}
+}
+
+void SubsController::TrimUndo(agi::memory::Pressure pressure) {
+	// The oldest entry is the base the rest are relative to, and at least
+	// one step is always kept like with Limits/Undo Levels
+	const bool all = pressure == agi::memory::Pressure::Critical;
+	const size_t keep = all ? 2 : std::max<size_t>(2, undo_stack.size() / 2);
+	while (undo_stack.size() > keep)
+		undo_stack.pop_front();
+	if (all)
+		redo_stack.clear();
+	UpdateMemoryUsage(false);
+}
+
 void SubsController::OnActiveLineChanged() {
 	if (!undo_stack.empty())
 		undo_stack.back().UpdateActiveLine(context);
@@ -379,9 +801,14 @@ void SubsController::Undo() {
 	bool was_playing = had_video && context->videoController->IsPlaying();
 	int frame_to_restore = context->videoController->GetFrameN();
 
+	// Committing the reverted changes can change the selection, which would
+	// otherwise overwrite the saved selection being restored
+	auto cursor = undo_stack.back().cursor;
 	text_selection_connection.Block();
-	undo_stack.back().Apply(context);
+	redo_stack.back().Apply(context, *committed, false);
+	UndoInfo::Restore(context, std::move(cursor));
 	text_selection_connection.Unblock();
+	UpdateMemoryUsage(true);
 
 	// If undo was triggered during active playback and playback survived Apply(),
 	// avoid JumpToFrame to prevent a stop/restart "bump" in playback.
@@ -400,9 +827,12 @@ void SubsController::Redo() {
 	bool was_playing = had_video && context->videoController->IsPlaying();
 	int frame_to_restore = context->videoController->GetFrameN();
 
+	auto cursor = undo_stack.back().cursor;
 	text_selection_connection.Block();
-	undo_stack.back().Apply(context);
+	undo_stack.back().Apply(context, *committed, true);
+	UndoInfo::Restore(context, std::move(cursor));
 	text_selection_connection.Unblock();
+	UpdateMemoryUsage(true);
 
 	if (had_video && context->project->VideoProvider()
 		&& !(was_playing && context->videoController->IsPlaying()))
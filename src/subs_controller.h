@@ -15,12 +15,15 @@
 // Aegisub Project http://www.aegisub.org/
 
 #include <libaegisub/fs_fwd.h>
+#include <libaegisub/memory_usage.h>
 #include <libaegisub/signal.h>
 
+#include <atomic>
 #include <boost/container/list.hpp>
 #include <boost/filesystem/path.hpp>
 #include <wx/timer.h>
 
+class AssSnapshot;
 class SelectionController;
 namespace agi {
 	namespace dispatch {
@@ -42,6 +45,23 @@ class SubsController {
 	boost::container::list<UndoInfo> undo_stack;
 	boost::container::list<UndoInfo> redo_stack;
 
+	/// The file as of the last undoable commit, which undo steps are relative to
+	struct CommittedState;
+	std::unique_ptr<CommittedState> committed;
+
+	/// Estimated size of the undo and redo steps
+	agi::memory::Counter undo_memory{"Undo history"};
+	/// Size of the attachments in the file
+	agi::memory::Counter attachment_memory{"Attachments"};
+	/// Drops old undo steps when memory is short, after everything which
+	/// can be remade has been given back
+	agi::memory::Trimmer undo_trimmer{90, [this](agi::memory::Pressure pressure) { TrimUndo(pressure); }};
+
+	/// Snapshot of the file as of the last time one was requested
+	std::shared_ptr<const AssSnapshot> snapshot;
+	/// Has the file been committed since snapshot was made?
+	bool snapshot_stale = true;
+
 	/// Revision counter for undo coalescing and modified state tracking
 	int commit_id = 0;
 	/// Last saved version of this file
@@ -58,6 +78,10 @@ class SubsController {
 
 	/// Queue which autosaves are performed on
 	std::unique_ptr<agi::dispatch::Queue> autosave_queue;
+	/// Is an autosave currently queued or being written?
+	std::atomic<bool> autosave_running{false};
+	/// Queue which saves triggered by Save on Every Change are performed on
+	std::unique_ptr<agi::dispatch::Queue> save_queue;
 
 	/// A new file has been opened (filename)
 	agi::signal::Signal<agi::fs::path> FileOpen;
@@ -73,7 +97,15 @@ class SubsController {
 	/// Autosave the file if there have been any chances since the last autosave
 	void AutoSave();
 
+	/// Save the current state of the file to its filename in the background
+	void SaveInBackground();
+
 	void OnCommit(AssFileCommit c);
+	/// Report the sizes of the undo history and attachments
+	void UpdateMemoryUsage(bool attachments_changed);
+	/// Drop the older half of the undo steps, or under critical pressure
+	/// everything but the last step and the redo steps
+	void TrimUndo(agi::memory::Pressure pressure);
 	void OnActiveLineChanged();
 	void OnSelectionChanged();
 	void OnTextSelectionChanged();
@@ -115,6 +147,10 @@ public:
 	/// Can the file be saved in its current format?
 	bool CanSave() const;
 
+	/// Get a read-only copy of the file as of the last commit which can be
+	/// kept and read from other threads
+	std::shared_ptr<const AssSnapshot> Snapshot();
+
 	/// The file is about to be saved
 	/// This signal is intended for adding metadata which is awkward or
 	/// expensive to always keep up to date
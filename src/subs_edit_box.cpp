@@ -36,6 +36,7 @@
 
 // [actor_MRU] BEGIN
 #include "actor_MRU.h"
+#include "actor_index.h"
 // [actor_MRU] END
 
 #include "ass_dialogue.h"
@@ -44,7 +45,7 @@
 #include "command/command.h"
 #include "compat.h"
 #include "dialog_style_editor.h"
-#include "flyweight_hash.h"
+#include "field_index.h"
 #include "include/aegisub/context.h"
 #include "include/aegisub/hotkey.h"
 #include "initial_line_state.h"
@@ -61,14 +62,15 @@
 #include "validators.h"
 
 #include <libaegisub/character_count.h>
+#include <libaegisub/interned.h>
 #include <libaegisub/make_unique.h>
+#include <libaegisub/trace.h>
 #include <libaegisub/util.h>
 
 #include <algorithm>
 #include <iterator>
 #include <functional>
 #include <set>
-#include <unordered_set>
 #include <vector>
 
 #include <wx/arrstr.h>
@@ -129,6 +131,35 @@ struct CaseInsensitiveLess {
 	}
 };
 
+struct CaseSensitiveLess {
+	bool operator()(wxString const& lhs, wxString const& rhs) const {
+		return lhs.Cmp(rhs) < 0;
+	}
+};
+
+/// Make a combo box's items match a sorted list by inserting and deleting
+/// just the items which differ, rather than refilling the whole list
+template<typename Less>
+void update_items(wxComboBox *combo, wxArrayString const& items, Less less) {
+	if (combo->IsListEmpty()) {
+		combo->Set(items);
+		return;
+	}
+
+	unsigned int i = 0;
+	size_t j = 0;
+	while (i < combo->GetCount() || j < items.size()) {
+		if (j == items.size() || (i < combo->GetCount() && less(combo->GetString(i), items[j])))
+			combo->Delete(i);
+		else if (i == combo->GetCount() || less(items[j], combo->GetString(i)))
+			combo->Insert(items[j++], i++);
+		else {
+			++i;
+			++j;
+		}
+	}
+}
+
 // Japanese bracket options for the toolbar popup
 struct BracketPair {
 	wxString left;
@@ -563,20 +594,24 @@ wxRadioButton *SubsEditBox::MakeRadio(wxString const& text, bool start, wxString
 }
 
 void SubsEditBox::OnCommit(int type) {
+	AGI_TRACE_ZONE("commit", "SubsEditBox");
 	wxEventBlocker blocker(this);
 
 	initial_times.clear();
 
 	if (type == AssFile::COMMIT_NEW || type & AssFile::COMMIT_STYLES) {
-		wxString style = style_box->GetValue();
-		style_box->Clear();
-		style_box->Append(to_wx(c->ass->GetStyles()));
-		style_box->Select(style_box->FindString(style));
+		// Most style commits don't add, remove or rename any styles
+		auto styles = to_wx(c->ass->GetStyles());
+		if (styles != style_box->GetStrings()) {
+			wxString style = style_box->GetValue();
+			style_box->Set(styles);
+			style_box->Select(style_box->FindString(style));
+		}
 		active_style = line ? c->ass->GetStyle(line->Style) : nullptr;
 	}
 
 	if (type == AssFile::COMMIT_NEW) {
-		PopulateList(effect_box, AssDialogue_Effect);
+		PopulateEffectList();
 		PopulateActorList();
 		return;
 	}
@@ -623,7 +658,7 @@ void SubsEditBox::UpdateFields(int type, bool repopulate_lists) {
 		active_style = line ? c->ass->GetStyle(line->Style) : nullptr;
 		style_edit_button->Enable(active_style != nullptr);
 
-		if (repopulate_lists) PopulateList(effect_box, AssDialogue_Effect);
+		if (repopulate_lists) PopulateEffectList();
 		effect_box->ChangeValue(to_wx(line->Effect));
 		effect_box->SetStringSelection(to_wx(line->Effect));
 		effect_text_amend_ = false;
@@ -643,35 +678,30 @@ void SubsEditBox::UpdateFields(int type, bool repopulate_lists) {
 	UpdateJoinButtons();
 }
 
-void SubsEditBox::PopulateList(wxComboBox *combo, boost::flyweight<std::string> AssDialogue::*field) {
-	wxEventBlocker blocker(this);
-
-	std::unordered_set<boost::flyweight<std::string>> values;
-	for (auto const& line : c->ass->Events) {
-		auto const& value = line.*field;
-		if (!value.get().empty())
-			values.insert(value);
-	}
+void SubsEditBox::PopulateEffectList() {
+	if (effect_list_version == c->effects->Version()) return;
+	effect_list_version = c->effects->Version();
 
-	wxArrayString arrstr;
-	arrstr.reserve(values.size());
-	transform(values.begin(), values.end(), std::back_inserter(arrstr),
-		(wxString (*)(std::string const&))to_wx);
+	wxEventBlocker blocker(this);
 
+	wxArrayString arrstr = to_wx(c->effects->Values());
 	arrstr.Sort();
 
-	combo->Freeze();
-	long pos = combo->GetInsertionPoint();
-	wxString value = combo->GetValue();
+	effect_box->Freeze();
+	long pos = effect_box->GetInsertionPoint();
+	wxString value = effect_box->GetValue();
 
-	combo->Set(arrstr);
-	combo->ChangeValue(value);
-	combo->SetStringSelection(value);
-	combo->SetInsertionPoint(pos);
-	combo->Thaw();
+	update_items(effect_box, arrstr, CaseSensitiveLess());
+	effect_box->ChangeValue(value);
+	effect_box->SetStringSelection(value);
+	effect_box->SetInsertionPoint(pos);
+	effect_box->Thaw();
 }
 
 void SubsEditBox::PopulateActorList() {
+	if (actor_list_version == c->actors->Version()) return;
+	actor_list_version = c->actors->Version();
+
 	wxEventBlocker blocker(this);
 
 	long sel_start = 0;
@@ -681,15 +711,8 @@ void SubsEditBox::PopulateActorList() {
 	bool had_pending = actor_has_pending_selection_;
 
 	std::set<wxString, CaseInsensitiveLess> unique;
-	for (auto const& entry : c->ass->Events) {
-		if (entry.Comment) continue;
-
-		wxString actor = to_wx(entry.Actor);
-		actor.Trim(true);
-		actor.Trim(false);
-		if (!actor.empty())
-			unique.insert(actor);
-	}
+	for (auto const& actor : c->actors->Names())
+		unique.insert(to_wx(actor));
 
 	actor_values_.assign(unique.begin(), unique.end());
 
@@ -706,7 +729,7 @@ void SubsEditBox::PopulateActorList() {
 	bool removed_leading = trimmed_leading.length() != value.length();
 	wxString trimmed_value = trimmed_leading;
 
-	actor_box->Set(arr);
+	update_items(actor_box, arr, CaseInsensitiveLess());
 	actor_box->ChangeValue(value);
 	if (!actor_box->SetStringSelection(value) && removed_leading)
 		actor_box->SetStringSelection(trimmed_value);
@@ -1006,7 +1029,7 @@ void SubsEditBox::CommitActorToCurrentLine(wxString const& name) {
 		return;
 
 	wxString previous = to_wx(target->Actor);
-	auto fly_value = boost::flyweight<std::string>(from_wx(name));
+	auto fly_value = agi::Interned<std::string>(from_wx(name));
 	target->Actor = fly_value;
 
 	LOG_D("actor/MRU") << "CommitActorToCurrentLine line_row=" << (line ? line->Row : -1)
@@ -1016,8 +1039,8 @@ void SubsEditBox::CommitActorToCurrentLine(wxString const& name) {
 	// [actor_MRU] Ensure MRU choices update the active line before advancing.
 	Commit(_("actor change"), AssFile::COMMIT_DIAG_META, false, target);
 
-	if (actor_mru_manager_ && c && c->ass)
-		actor_mru_manager_->OnActorCommitted(name, previous, c->ass.get());
+	if (actor_mru_manager_ && c && c->actors)
+		actor_mru_manager_->OnActorCommitted(name, previous, c->actors.get());
 
 	actor_line_initial_value_ = name;
 }
@@ -1041,8 +1064,8 @@ void SubsEditBox::FinalizeFastActiveFromActor(bool add_to_recent) {
 		fast_has_active_name_ = true;
 	}
 	// [actor_MRU] BEGIN
-	if (add_to_recent && actor_mru_manager_ && c && c->ass)
-		actor_mru_manager_->OnActorCommitted(value, actor_line_initial_value_, c->ass.get());
+	if (add_to_recent && actor_mru_manager_ && c && c->actors)
+		actor_mru_manager_->OnActorCommitted(value, actor_line_initial_value_, c->actors.get());
 	// [actor_MRU] END
 }
 
@@ -1078,7 +1101,7 @@ void SubsEditBox::ApplyFastActiveToCurrentLine() {
 	actor_selection_start_ = 0;
 	actor_selection_end_ = value.length();
 
-	auto fly_value = boost::flyweight<std::string>(from_wx(value));
+	auto fly_value = agi::Interned<std::string>(from_wx(value));
 	SetSelectedRows([&, fly_value](AssDialogue *d) {
 		if (d == line)
 			d->Actor = fly_value;
@@ -1234,7 +1257,7 @@ void SubsEditBox::SetSelectedRows(T AssDialogueBase::*field, T value, wxString c
 
 template<class T>
 void SubsEditBox::SetSelectedRows(T AssDialogueBase::*field, wxString const& value, wxString const& desc, int type, bool amend) {
-	boost::flyweight<std::string> conv_value(from_wx(value));
+	agi::Interned<std::string> conv_value(from_wx(value));
 	SetSelectedRows([&](AssDialogue *d) { d->*field = conv_value; }, desc, type, amend);
 }
 
@@ -1251,7 +1274,7 @@ void SubsEditBox::CommitText(wxString const& desc) {
 		normalized_text = control_text;
 	}
 	// Satoshi: \N visual newline support (end)
-	SetSelectedRows(&AssDialogue::Text, boost::flyweight<std::string>(normalized_text), desc, AssFile::COMMIT_DIAG_TEXT, true);
+	SetSelectedRows(&AssDialogue::Text, agi::Interned<std::string>(normalized_text), desc, AssFile::COMMIT_DIAG_TEXT, true);
 }
 
 void SubsEditBox::CommitTimes(TimeField field) {
@@ -1583,7 +1606,7 @@ void SubsEditBox::OnEffectChange(wxCommandEvent &evt) {
 	bool amend = is_text && effect_text_amend_;
 	effect_text_amend_ = is_text;
 	SetSelectedRows(AssDialogue_Effect, new_value(effect_box, evt), _("effect change"), AssFile::COMMIT_DIAG_META, amend);
-	PopulateList(effect_box, AssDialogue_Effect);
+	PopulateEffectList();
 }
 
 void SubsEditBox::OnCommentChange(wxCommandEvent &evt) {
@@ -31,7 +31,6 @@
 #include <memory>
 #include <string>
 #include <boost/container/map.hpp>
-#include <boost/flyweight/flyweight_fwd.hpp>
 #include <vector>
 
 #include <wx/bmpbuttn.h>
@@ -42,6 +41,7 @@
 #include <libaegisub/signal.h>
 
 namespace agi { namespace vfr { class Framerate; } }
+namespace agi { template<typename T> class Interned; }
 namespace agi { struct Context; }
 namespace agi { class Time; }
 class AssDialogue;
@@ -122,6 +122,10 @@ class SubsEditBox final : public wxPanel {
 
 	std::unique_ptr<RetinaHelper> retina_helper;
 	std::vector<wxString> actor_values_;
+	/// Versions of the effect and actor indices the dropdowns were last
+	/// filled from
+	size_t effect_list_version = -1;
+	size_t actor_list_version = -1;
 	bool actor_autofill_guard = false;
 	bool actor_should_autofill_ = false;
 	bool actor_has_pending_selection_ = false;
@@ -238,8 +242,10 @@ class SubsEditBox final : public wxPanel {
 
 	void UpdateFields(int type, bool repopulate_lists);
 
-	/// Regenerate a dropdown list with the unique values of a dialogue field
-	void PopulateList(wxComboBox *combo, boost::flyweight<std::string> AssDialogue::*field);
+	/// Update the effect dropdown from the effect index, if any effects
+	/// have started or stopped being used since it was last updated
+	void PopulateEffectList();
+	/// Update the actor dropdown from the actor index, if it has changed
 	void PopulateActorList();
 	void AutoFillActor();
 	void OnActorKeyDown(wxKeyEvent &evt);
@@ -50,6 +50,7 @@
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <algorithm>
+#include <chrono>
 #include <functional>
 
 #include <wx/clipbrd.h>
@@ -148,6 +149,7 @@ SubsTextEditCtrl::SubsTextEditCtrl(wxWindow* parent, wxSize wsize, long style, a
 , spellchecker(SpellCheckerFactory::GetSpellChecker())
 , thesaurus(agi::make_unique<Thesaurus>())
 , context(context)
+, word_splits(agi::make_unique<agi::ass::WordSplitCache>())
 {
 	osx::ime::inject(this);
 
@@ -186,7 +188,7 @@ SubsTextEditCtrl::SubsTextEditCtrl(wxWindow* parent, wxSize wsize, long style, a
 	}
 
 	Bind(wxEVT_CONTEXT_MENU, &SubsTextEditCtrl::OnContextMenu, this);
-	Bind(wxEVT_IDLE, std::bind(&SubsTextEditCtrl::UpdateCallTip, this));
+	Bind(wxEVT_IDLE, &SubsTextEditCtrl::OnIdle, this);
 	Bind(wxEVT_STC_DOUBLECLICK, &SubsTextEditCtrl::OnDoubleClick, this);
 	Bind(wxEVT_STC_STYLENEEDED, [=](wxStyledTextEvent&) {
 		{
@@ -218,16 +220,18 @@ SubsTextEditCtrl::SubsTextEditCtrl(wxWindow* parent, wxSize wsize, long style, a
 	OPT_SUB("Colour/Subtitle/Background", &SubsTextEditCtrl::SetStyles, this);
 	OPT_SUB("Subtitle/Highlight/Syntax", &SubsTextEditCtrl::UpdateStyle, this);
 	OPT_SUB("App/Call Tips", &SubsTextEditCtrl::UpdateCallTip, this);
+	OPT_SUB("Tool/Spell Checker/Language", &SubsTextEditCtrl::ResetSpelling, this);
+	OPT_SUB("Path/Dictionary", &SubsTextEditCtrl::ResetSpelling, this);
 
 	Bind(wxEVT_MENU, [=](wxCommandEvent&) {
 		if (spellchecker) spellchecker->AddWord(currentWord);
-		UpdateStyle();
+		ResetSpelling();
 		SetFocus();
 	}, EDIT_MENU_ADD_TO_DICT);
 
 	Bind(wxEVT_MENU, [=](wxCommandEvent&) {
 		if (spellchecker) spellchecker->RemoveWord(currentWord);
-		UpdateStyle();
+		ResetSpelling();
 		SetFocus();
 	}, EDIT_MENU_REMOVE_FROM_DICT);
 }
@@ -337,37 +341,131 @@ void SubsTextEditCtrl::UpdateStyle() {
 	bool template_line = diag && diag->Comment && (boost::istarts_with(diag->Effect.get(), "template") || boost::istarts_with(diag->Effect.get(), "mixin"));
 
 	tokenized_line = agi::ass::TokenizeDialogueBody(line_text, template_line);
-	agi::ass::SplitWords(line_text, tokenized_line);
+	agi::ass::SplitWords(line_text, tokenized_line, word_splits.get());
 
 	cursor_pos = -1;
 	UpdateCallTip();
 
+	auto start_styling = [&](size_t pos) {
 #if wxVERSION_NUMBER >= 3100
-	StartStyling(0);
+		StartStyling(pos);
 #else
-	StartStyling(0, 255);
+		StartStyling(pos, 255);
 #endif
+	};
 
 	if (!OPT_GET("Subtitle/Highlight/Syntax")->GetBool()) {
+		start_styling(0);
 		SetStyling(line_text.size(), 0);
+		styled_text = line_text;
+		styled.assign(line_text.size(), 0);
+		spelling_pending = false;
 		return;
 	}
 
-	if (line_text.empty()) return;
+	std::vector<char> styles;
+	styles.reserve(line_text.size());
+	for (auto const& style_range : agi::ass::SyntaxHighlight(line_text, tokenized_line, nullptr))
+		styles.insert(styles.end(), style_range.length, static_cast<char>(style_range.type));
+
+	// Scintilla keeps the styling of the unchanged text on either side of an
+	// edit, so only the bytes whose style differs from that need restyling
+	const size_t prefix = std::mismatch(line_text.begin(), line_text.begin() + std::min(line_text.size(), styled_text.size()), styled_text.begin()).first - line_text.begin();
+	size_t suffix = 0;
+	while (suffix < std::min(line_text.size(), styled_text.size()) - prefix && line_text[line_text.size() - suffix - 1] == styled_text[styled_text.size() - suffix - 1])
+		++suffix;
+
+	auto differs = [&](size_t i) {
+		if (i < prefix)
+			return styles[i] != styled[i];
+		if (i >= line_text.size() - suffix)
+			return styles[i] != styled[i + styled_text.size() - line_text.size()];
+		return true;
+	};
+
+	size_t begin = 0, end = styles.size();
+	while (begin < end && !differs(begin)) ++begin;
+	while (end > begin && !differs(end - 1)) --end;
+
+	if (begin < end) {
+		start_styling(begin);
+		for (size_t i = begin; i < end; ) {
+			size_t run_end = i + 1;
+			while (run_end < end && styles[run_end] == styles[i]) ++run_end;
+			SetStyling(run_end - i, styles[i]);
+			i = run_end;
+		}
+	}
+	// Flag the rest of the text as styled as it already has the right styles
+	start_styling(line_text.size());
+
+	styled_text = line_text;
+	styled = std::move(styles);
+
+	// Looking up words in the dictionary is slow, so words which haven't been
+	// seen recently are checked when there's nothing else to do
+	if (spellchecker) {
+		spelling_pending = true;
+		if (CheckSpelling(0))
+			ApplySpelling();
+	}
+}
+
+bool SubsTextEditCtrl::CheckSpelling(int time_limit) {
+	using namespace std::chrono;
+	const auto deadline = steady_clock::now() + milliseconds(time_limit);
 
-	SetIndicatorCurrent(0);
 	size_t pos = 0;
-	for (auto const& style_range : agi::ass::SyntaxHighlight(line_text, tokenized_line, spellchecker.get())) {
-		if (style_range.type == agi::ass::SyntaxStyle::SPELLING) {
-			SetStyling(style_range.length, agi::ass::SyntaxStyle::NORMAL);
-			IndicatorFillRange(pos, style_range.length);
+	for (auto const& tok : tokenized_line) {
+		if (tok.type == agi::ass::DialogueTokenType::WORD) {
+			std::string word = line_text.substr(pos, tok.length);
+			if (!spelling.count(word)) {
+				if (steady_clock::now() >= deadline)
+					return false;
+				bool correct = spellchecker->CheckWord(word);
+				spelling.emplace(std::move(word), correct);
+			}
 		}
-		else {
-			SetStyling(style_range.length, style_range.type);
-			IndicatorClearRange(pos, style_range.length);
+		pos += tok.length;
+	}
+	return true;
+}
+
+void SubsTextEditCtrl::ApplySpelling() {
+	spelling_pending = false;
+
+	SetIndicatorCurrent(0);
+	IndicatorClearRange(0, line_text.size());
+
+	size_t pos = 0;
+	for (auto const& tok : tokenized_line) {
+		if (tok.type == agi::ass::DialogueTokenType::WORD) {
+			auto it = spelling.find(line_text.substr(pos, tok.length));
+			if (it != spelling.end() && !it->second)
+				IndicatorFillRange(pos, tok.length);
 		}
-		pos += style_range.length;
+		pos += tok.length;
 	}
+
+	// Remember the results across lines, but not without bound
+	if (spelling.size() > 10000)
+		spelling.clear();
+}
+
+void SubsTextEditCtrl::ResetSpelling() {
+	spelling.clear();
+	if (spellchecker && OPT_GET("Subtitle/Highlight/Syntax")->GetBool())
+		spelling_pending = true;
+}
+
+void SubsTextEditCtrl::OnIdle(wxIdleEvent &event) {
+	UpdateCallTip();
+
+	if (!spelling_pending) return;
+	if (CheckSpelling(10))
+		ApplySpelling();
+	else
+		event.RequestMore();
 }
 
 void SubsTextEditCtrl::UpdateCallTip() {
@@ -408,6 +506,8 @@ void SubsTextEditCtrl::SetTextTo(std::string const& text) {
 		line_text = GetTextRaw().data();
 	auto old_pos = agi::CharacterCount(line_text.begin(), line_text.begin() + insertion_point, 0);
 	line_text.clear();
+	// Replacing all of the text discards its styling
+	styled_text.clear();
 
 	if (context) {
 		context->textSelectionController->SetSelection(0, 0);
@@ -635,6 +735,7 @@ void SubsTextEditCtrl::OnUseSuggestion(wxCommandEvent &event) {
 	// line_text needs to get cleared before SetTextRaw to ensure it gets reparsed
 	std::string new_text;
 	swap(line_text, new_text);
+	styled_text.clear();
 	SetTextRaw(new_text.replace(currentWordPos.first, currentWordPos.second, suggestion).c_str());
 
 	SetSelection(currentWordPos.first, currentWordPos.first + suggestion.size());
@@ -29,6 +29,7 @@
 
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <wx/stc/stc.h>
 
@@ -36,7 +37,7 @@ class Thesaurus;
 namespace agi {
 	class SpellChecker;
 	struct Context;
-	namespace ass { struct DialogueToken; }
+	namespace ass { struct DialogueToken; class WordSplitCache; }
 }
 
 /// @class SubsTextEditCtrl
@@ -80,6 +81,23 @@ class SubsTextEditCtrl final : public wxStyledTextCtrl {
 	/// Tokenized version of line_text
 	std::vector<agi::ass::DialogueToken> tokenized_line;
 
+	/// Word splits of the text in recent versions of the line, so that
+	/// retokenizing after an edit only has to split the edited text
+	std::unique_ptr<agi::ass::WordSplitCache> word_splits;
+
+	/// The text which the syntax highlighting was last applied to
+	std::string styled_text;
+
+	/// The syntax style of each byte of styled_text
+	std::vector<char> styled;
+
+	/// Whether or not each recently seen word is spelled correctly
+	std::unordered_map<std::string, bool> spelling;
+
+	/// Do the spelling error indicators need to be updated once all of the
+	/// words in the line have been checked?
+	bool spelling_pending = false;
+
 	void OnContextMenu(wxContextMenuEvent &);
 	void OnDoubleClick(wxStyledTextEvent&);
 	void OnUseSuggestion(wxCommandEvent &event);
@@ -87,6 +105,7 @@ class SubsTextEditCtrl final : public wxStyledTextCtrl {
 	void OnSetThesLanguage(wxCommandEvent &event);
 	void OnLoseFocus(wxFocusEvent &event);
 	void OnKeyDown(wxKeyEvent &event);
+	void OnIdle(wxIdleEvent &event);
 
 	void SetSyntaxStyle(int id, wxFont &font, std::string const& name, wxColor const& default_background);
 	void Subscribe(std::string const& name);
@@ -97,6 +116,17 @@ class SubsTextEditCtrl final : public wxStyledTextCtrl {
 
 	void UpdateStyle();
 
+	/// Spellcheck the words in the line which haven't been checked yet
+	/// @param time_limit Milliseconds to spend checking words before giving up
+	/// @return Have all of the words been checked?
+	bool CheckSpelling(int time_limit);
+
+	/// Mark the misspelled words in the line
+	void ApplySpelling();
+
+	/// Forget the spellchecking results after the dictionary changes
+	void ResetSpelling();
+
 	/// Add the thesaurus suggestions to a menu
 	void AddThesaurusEntries(wxMenu &menu);
 
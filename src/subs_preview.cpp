@@ -34,6 +34,7 @@
 
 #include "ass_dialogue.h"
 #include "ass_file.h"
+#include "ass_snapshot.h"
 #include "ass_style.h"
 #include "dialog_progress.h"
 #include "subs_preview.h"
@@ -41,18 +42,69 @@
 #include "video_frame.h"
 #include "video_provider_dummy.h"
 
+#include <libaegisub/dispatch.h>
+#include <libaegisub/format.h>
 #include <libaegisub/make_unique.h>
 
+#include <atomic>
+#include <deque>
+
 #include <wx/dcclient.h>
 #include <wx/msgdlg.h>
 
+namespace {
+/// Number of rendered previews kept for reuse
+const size_t max_cached_previews = 32;
+
+/// Recently rendered previews by everything that went into them, newest
+/// first. Only used from the main thread.
+std::deque<std::pair<std::string, wxBitmap>>& preview_cache() {
+	static std::deque<std::pair<std::string, wxBitmap>> cache;
+	return cache;
+}
+
+const wxBitmap *find_cached(std::string const& key) {
+	auto& cache = preview_cache();
+	for (auto it = cache.begin(); it != cache.end(); ++it) {
+		if (it->first != key) continue;
+		if (it != cache.begin()) {
+			auto entry = std::move(*it);
+			cache.erase(it);
+			cache.push_front(std::move(entry));
+		}
+		return &cache.front().second;
+	}
+	return nullptr;
+}
+
+void add_cached(std::string const& key, wxBitmap const& bmp) {
+	auto& cache = preview_cache();
+	cache.emplace_front(key, bmp);
+	if (cache.size() > max_cached_previews)
+		cache.pop_back();
+}
+}
+
+struct SubtitlesPreview::State {
+	/// Subtitle provider used only by the jobs on the worker queue
+	std::unique_ptr<SubtitlesProvider> provider;
+	/// Set to null when the preview is destroyed
+	SubtitlesPreview *preview = nullptr;
+	/// Incremented for each render so that the ones which have been replaced
+	/// by a newer one before starting can be skipped
+	std::atomic<size_t> generation{0};
+};
+
 SubtitlesPreview::SubtitlesPreview(wxWindow *parent, wxSize size, int winStyle, agi::Color col)
 : wxWindow(parent, -1, wxDefaultPosition, size, winStyle)
+, state(std::make_shared<State>())
+, queue(agi::dispatch::Create())
 , style(new AssStyle)
 , back_color(col)
 , sub_file(agi::make_unique<AssFile>())
 , line(new AssDialogue)
 {
+	state->preview = this;
 	line->Text = "{\\q2}preview";
 
 	SetStyle(*style);
@@ -71,11 +123,20 @@ SubtitlesPreview::SubtitlesPreview(wxWindow *parent, wxSize size, int winStyle,
 }
 
 SubtitlesPreview::~SubtitlesPreview() {
+	// Jobs which are still queued hold a reference to the state and check
+	// these before doing anything
+	state->preview = nullptr;
+	++state->generation;
+	queue->Sync([]{});
 }
 
 void SubtitlesPreview::SetStyle(AssStyle const& new_style) {
-	if (provider && style->font != new_style.font)
-		provider->Reinitialize();
+	if (style->font != new_style.font) {
+		auto s = state;
+		queue->Async([=]{
+			if (s->provider) s->provider->Reinitialize();
+		});
+	}
 
 	*style = new_style;
 	style->name = "Default";
@@ -104,19 +165,47 @@ void SubtitlesPreview::SetColour(agi::Color col) {
 void SubtitlesPreview::UpdateBitmap() {
 	if (!vid) return;
 
-	VideoFrame frame;
-	vid->GetFrame(0, frame);
+	const size_t generation = ++state->generation;
+	const std::string key = agi::format("%dx%d %s\n%s\n%s", bmp->GetWidth(), bmp->GetHeight(),
+		back_color.GetHexFormatted(), style->GetEntryData(), line->Text.get());
+	if (auto cached = find_cached(key)) {
+		*bmp = *cached;
+		Refresh();
+		return;
+	}
 
-	if (provider) {
-		try {
-			provider->LoadSubtitles(sub_file.get());
-			provider->DrawSubtitles(frame, 0.1);
+	auto frame = std::make_shared<VideoFrame>();
+	vid->GetFrame(0, *frame);
+	std::shared_ptr<const AssSnapshot> subs = AssSnapshot::Create(*sub_file);
+
+	auto s = state;
+	queue->Async([=]{
+		if (s->generation != generation) return;
+		// Renders without a provider aren't worth keeping
+		std::string cache_key;
+		if (s->provider) {
+			try {
+				s->provider->LoadSubtitles(*subs);
+				s->provider->DrawSubtitles(*frame, 0.1);
+				cache_key = key;
+			}
+			catch (...) { }
 		}
-		catch (...) { }
-	}
 
+		agi::dispatch::Main().Async([=]{
+			if (s->preview) s->preview->RenderDone(generation, cache_key, *frame);
+		});
+	});
+}
+
+void SubtitlesPreview::RenderDone(size_t generation, std::string const& key, VideoFrame const& frame) {
 	// Convert frame to bitmap
-	*bmp = static_cast<wxBitmap>(GetImage(frame));
+	wxBitmap rendered(GetImage(frame));
+	if (!key.empty())
+		add_cached(key, rendered);
+	if (generation != state->generation) return;
+
+	*bmp = rendered;
 	Refresh();
 }
 
@@ -130,13 +219,20 @@ void SubtitlesPreview::OnSize(wxSizeEvent &evt) {
 	int w = evt.GetSize().GetWidth();
 	int h = evt.GetSize().GetHeight();
 
-	bmp = agi::make_unique<wxBitmap>(w, h, -1);
 	vid = agi::make_unique<DummyVideoProvider>(0.0, 10, w, h, back_color, true);
+	// Show just the background until the subtitles have been rendered
+	VideoFrame frame;
+	vid->GetFrame(0, frame);
+	bmp = agi::make_unique<wxBitmap>(GetImage(frame));
 	try {
 		if (!progress)
 			progress = agi::make_unique<DialogProgress>(this);
-		if (!provider)
-			provider = SubtitlesProviderFactory::GetProvider(progress.get());
+		// The provider is only ever set from here, so it can be checked
+		// without waiting for the worker
+		if (!state->provider) {
+			auto new_provider = SubtitlesProviderFactory::GetProvider(progress.get());
+			queue->Sync([&]{ state->provider = std::move(new_provider); });
+		}
 	}
 	catch (...) {
 		wxMessageBox(
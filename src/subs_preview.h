@@ -33,6 +33,7 @@
 ///
 
 #include <memory>
+#include <string>
 #include <wx/window.h>
 #include <wx/bitmap.h>
 
@@ -41,12 +42,25 @@ class AssStyle;
 class DialogProgress;
 class SubtitlesProvider;
 class VideoProvider;
+struct VideoFrame;
+namespace agi { namespace dispatch { class Queue; } }
 
 /// Preview window to show a short string with a given ass style
+///
+/// Rendering is done on a worker queue, with the last rendered bitmap shown
+/// until the new one is ready. Only the newest of the renders queued while
+/// one is running is actually done, so that dragging a spin control doesn't
+/// queue up a render for every value passed through. Recently rendered
+/// previews are kept for all preview windows, so that opening the editors
+/// of styles which have been looked at already doesn't render them again.
 class SubtitlesPreview final : public wxWindow {
-	/// The subtitle provider used to render the string
-	std::unique_ptr<SubtitlesProvider> provider;
-	/// Bitmap to render into
+	/// State shared with the jobs on the worker queue, which holds the
+	/// subtitle provider used to render the string
+	struct State;
+	std::shared_ptr<State> state;
+	/// Queue the renders are done on
+	std::unique_ptr<agi::dispatch::Queue> queue;
+	/// Last rendered bitmap
 	std::unique_ptr<wxBitmap> bmp;
 	/// The currently display style
 	AssStyle* style;
@@ -63,6 +77,8 @@ class SubtitlesPreview final : public wxWindow {
 
 	/// Regenerate the bitmap
 	void UpdateBitmap();
+	/// Show a finished render if it's still the newest one
+	void RenderDone(size_t generation, std::string const& key, VideoFrame const& frame);
 	/// Resize event handler
 	void OnSize(wxSizeEvent &event);
 	/// Paint event handler
@@ -83,7 +83,7 @@ bool SubtitleFormat::CanSave(const AssFile *subs) const {
 	if (!subs->Attachments.empty())
 		return false;
 
-	auto def = boost::flyweight<std::string>("Default");
+	auto def = agi::Interned<std::string>("Default");
 	for (auto const& line : subs->Events) {
 		if (line.Style != def || line.GetStrippedText() != line.Text)
 			return false;
@@ -22,6 +22,7 @@
 #include "ass_file.h"
 #include "ass_style.h"
 #include "ass_parser.h"
+#include "ass_sidecar.h"
 #include "options.h"
 #include "string_codec.h"
 #include "text_file_reader.h"
@@ -29,6 +30,7 @@
 #include "version.h"
 
 #include <libaegisub/ass/uuencode.h>
+#include <libaegisub/dispatch.h>
 #include <libaegisub/fs.h>
 
 DEFINE_EXCEPTION(AssParseError, SubtitleFormatParseError);
@@ -36,10 +38,17 @@ DEFINE_EXCEPTION(AssParseError, SubtitleFormatParseError);
 void AssSubtitleFormat::ReadFile(AssFile *target, agi::fs::path const& filename, agi::vfr::Framerate const& fps, std::string const& encoding) const {
 	int version = !agi::fs::HasExtension(filename, "ssa");
 
+	AssSidecar sidecar(filename, encoding, version);
+	if (sidecar.Load(target))
+		return;
+
 	TextFileReader file(filename, encoding);
 	AssParser parser(target, version);
 	while (file.HasMoreLines())
 		parser.AddLine(file.ReadLineFromFile());
+	parser.Finish();
+
+	sidecar.Store(*target);
 }
 
 #ifdef _WIN32
@@ -57,39 +66,83 @@ const char *format(AssEntryGroup group) {
 	return nullptr;
 }
 
+/// Number of events formatted by a worker at a time
+const size_t event_chunk_size = 4096;
+
+/// Formats the whole file into memory, then converts and writes it at once
 struct Writer {
 	TextFileWriter file;
+	std::string out;
 	AssEntryGroup group = AssEntryGroup::INFO;
 
 	Writer(agi::fs::path const& filename, std::string const& encoding)
 	: file(filename, encoding)
 	{
-		file.WriteLineToFile("[Script Info]");
-		file.WriteLineToFile(std::string("; Script generated by Aegisub ") + GetAegisubLongVersionString());
-		file.WriteLineToFile("; http://www.aegisub.org/");
+		Line("[Script Info]");
+		Line(std::string("; Script generated by Aegisub ") + GetAegisubLongVersionString());
+		Line("; http://www.aegisub.org/");
+	}
+
+	void Line(std::string const& str) {
+		out += str;
+		out += LINEBREAK;
+	}
+
+	void StartGroup(AssEntryGroup new_group, std::string const& header) {
+		// Add a blank line between each group
+		Line("");
+		Line(header);
+		if (const char *str = format(new_group))
+			out += str;
+		group = new_group;
 	}
 
 	template<typename T>
 	void Write(T const& list) {
 		for (auto const& line : list) {
-			if (line.Group() != group) {
-				// Add a blank line between each group
-				file.WriteLineToFile("");
-
-				file.WriteLineToFile(line.GroupHeader());
-				if (const char *str = format(line.Group()))
-					file.WriteLineToFile(str, false);
+			if (line.Group() != group)
+				StartGroup(line.Group(), line.GroupHeader());
+			Line(line.GetEntryData());
+		}
+	}
 
-				group = line.Group();
+	/// Events make up nearly all of a large file, so format them on several
+	/// threads and then stitch the chunks together
+	void Write(EntryList<AssDialogue> const& events) {
+		if (events.empty()) return;
+		if (group != AssEntryGroup::DIALOGUE)
+			StartGroup(AssEntryGroup::DIALOGUE, events.front().GroupHeader());
+
+		std::vector<const AssDialogue *> lines;
+		for (auto const& line : events)
+			lines.push_back(&line);
+
+		std::vector<std::string> chunks((lines.size() + event_chunk_size - 1) / event_chunk_size);
+		agi::dispatch::Parallel(chunks.size(), [&](size_t i) {
+			const size_t end = std::min(lines.size(), (i + 1) * event_chunk_size);
+			for (size_t j = i * event_chunk_size; j < end; ++j) {
+				chunks[i] += lines[j]->GetEntryData();
+				chunks[i] += LINEBREAK;
 			}
+		});
+
+		size_t size = out.size();
+		for (auto const& chunk : chunks)
+			size += chunk.size();
+		out.reserve(size);
+		for (auto const& chunk : chunks)
+			out += chunk;
+	}
 
-			file.WriteLineToFile(line.GetEntryData());
-		}
+	/// Convert and write everything formatted so far
+	void Finish() {
+		file.WriteLineToFile(out, false);
+		out.clear();
 	}
 
 	void Write(ProjectProperties const& properties) {
-		file.WriteLineToFile("");
-		file.WriteLineToFile("[Aegisub Project Garbage]");
+		Line("");
+		Line("[Aegisub Project Garbage]");
 
 		WriteIfNotEmpty("Automation Scripts: ", properties.automation_scripts);
 		WriteIfNotEmpty("Export Filters: ", properties.export_filters);
@@ -102,6 +155,7 @@ struct Writer {
 
 		WriteIfNotZero("Video AR Mode: ", properties.ar_mode);
 		WriteIfNotZero("Video AR Value: ", properties.ar_value);
+		WriteIfNotZero("Disable Hardware Decoding: ", properties.disable_hw_decoding);
 
 		if (OPT_GET("App/Save UI State")->GetBool()) {
 			WriteIfNotZero("Video Zoom Percent: ", properties.video_zoom);
@@ -113,13 +167,13 @@ struct Writer {
 
 	void WriteIfNotEmpty(const char *key, std::string const& value) {
 		if (!value.empty())
-			file.WriteLineToFile(key + value);
+			Line(key + value);
 	}
 
 	template<typename Number>
 	void WriteIfNotZero(const char *key, Number n) {
 		if (n != Number{})
-			file.WriteLineToFile(key + std::to_string(n));
+			Line(key + std::to_string(n));
 	}
 
 	void WriteExtradata(std::vector<ExtradataEntry> const& extradata) {
@@ -127,8 +181,8 @@ struct Writer {
 			return;
 
 		group = AssEntryGroup::EXTRADATA;
-		file.WriteLineToFile("");
-		file.WriteLineToFile("[Aegisub Extradata]");
+		Line("");
+		Line("[Aegisub Extradata]");
 		for (auto const& edi : extradata) {
 			std::string line = "Data: ";
 			line += std::to_string(edi.id);
@@ -145,7 +199,7 @@ struct Writer {
 				line += "e"; // marker for inline_string encoding (escaping)
 				line += encoded_data;
 			}
-			file.WriteLineToFile(line);
+			Line(line);
 		}
 	}
 };
@@ -159,6 +213,7 @@ void AssSubtitleFormat::WriteFile(const AssFile *src, agi::fs::path const& filen
 	writer.Write(src->Attachments);
 	writer.Write(src->Events);
 	writer.WriteExtradata(src->Extradata);
+	writer.Finish();
 }
 
 void AssSubtitleFormat::ExportFile(const AssFile *src, agi::fs::path const& filename, agi::vfr::Framerate const& fps, std::string const& encoding) const {
@@ -167,4 +222,5 @@ void AssSubtitleFormat::ExportFile(const AssFile *src, agi::fs::path const& file
 	writer.Write(src->Styles);
 	writer.Write(src->Attachments);
 	writer.Write(src->Events);
+	writer.Finish();
 }
@@ -42,13 +42,13 @@
 #include "text_file_writer.h"
 
 #include <libaegisub/format.h>
-#include <libaegisub/of_type_adaptor.h>
 
+#include <algorithm>
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/trim.hpp>
-#include <boost/regex.hpp>
+#include <cstring>
 
 DEFINE_EXCEPTION(SRTParseError, SubtitleFormatParseError);
 
@@ -93,6 +93,139 @@ TagType type_from_name(std::string const& tag) {
 	}
 }
 
+bool is_space(char c) {
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+bool is_digit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+/// Find the first position after pos at which a line within str starts, or
+/// npos. Lines read from the file can still contain lone CRs and form feeds,
+/// and the regexes these parsers replaced matched at the start of each of
+/// those lines as well.
+size_t next_line_start(std::string const& str, size_t pos) {
+	for (size_t i = pos + 1; i < str.size(); ++i) {
+		char prev = str[i - 1];
+		if (prev == '\n' || prev == '\f' || (prev == '\r' && str[i] != '\n'))
+			return i;
+	}
+	return std::string::npos;
+}
+
+/// Does str have word (lowercase ASCII) at pos, ignoring case?
+bool has_word_at(std::string const& str, size_t pos, const char *word) {
+	for (; *word; ++word, ++pos) {
+		if (pos >= str.size() || (str[pos] | 0x20) != *word)
+			return false;
+	}
+	return true;
+}
+
+/// Length of the supported tag name at pos (optionally a '/' followed by
+/// b, i, u, s or font, in any case), or 0 if there isn't one
+size_t tag_name_length(std::string const& str, size_t pos) {
+	size_t len = pos < str.size() && str[pos] == '/';
+	if (pos + len >= str.size()) return 0;
+	switch (str[pos + len] | 0x20) {
+		case 'b': case 'i': case 'u': case 's':
+			return len + 1;
+		case 'f':
+			return has_word_at(str, pos + len, "font") ? len + 4 : 0;
+		default:
+			return 0;
+	}
+}
+
+/// Read the face, size or color attribute of a font tag at pos, which must
+/// be preceded by whitespace. The name is lowercased and quotes around the
+/// value are removed.
+bool read_font_attrib_at(std::string const& attrs, size_t &pos, std::string &name, std::string &value) {
+	size_t cur = pos;
+	while (cur < attrs.size() && is_space(attrs[cur])) ++cur;
+	if (cur == pos) return false;
+
+	const char *names[] = {"face", "size", "color"};
+	auto found = std::find_if(std::begin(names), std::end(names), [&](const char *n) {
+		return has_word_at(attrs, cur, n) && cur + strlen(n) < attrs.size() && attrs[cur + strlen(n)] == '=';
+	});
+	if (found == std::end(names)) return false;
+	name = *found;
+	cur += name.size() + 1;
+	if (cur >= attrs.size()) return false;
+
+	if (attrs[cur] == '\'' || attrs[cur] == '"') {
+		size_t close = attrs.find(attrs[cur], cur + 1);
+		if (close != std::string::npos) {
+			value = attrs.substr(cur + 1, close - cur - 1);
+			pos = close + 1;
+			return true;
+		}
+	}
+
+	size_t end = cur;
+	while (end < attrs.size() && !is_space(attrs[end])) ++end;
+	if (end == cur) return false;
+	value = attrs.substr(cur, end - cur);
+	pos = end;
+	return true;
+}
+
+/// Read the next font tag attribute at or after pos
+bool next_font_attrib(std::string const& attrs, size_t &pos, std::string &name, std::string &value) {
+	for (size_t start = pos; start != std::string::npos; start = next_line_start(attrs, start)) {
+		pos = start;
+		if (read_font_attrib_at(attrs, pos, name, value))
+			return true;
+	}
+	return false;
+}
+
+/// Length of the "h:m:s,ms" time at pos, where h, m and s are one or two
+/// digits and ms is any number of them, or 0 if there isn't one
+size_t srt_time_length(std::string const& str, size_t pos) {
+	size_t cur = pos;
+	for (char sep : {':', ':', ','}) {
+		size_t digits = 0;
+		while (cur + digits < str.size() && is_digit(str[cur + digits])) ++digits;
+		if (digits == 0 || digits > 2) return 0;
+		cur += digits;
+		if (cur >= str.size() || str[cur] != sep) return 0;
+		++cur;
+	}
+
+	size_t digits = 0;
+	while (cur + digits < str.size() && is_digit(str[cur + digits])) ++digits;
+	return digits ? cur + digits - pos : 0;
+}
+
+/// Read a "hh:mm:ss,fff --> hh:mm:ss,fff" pair (e.g. "00:00:04,070 --> 00:00:10,04")
+/// at pos
+bool read_timestamps_at(std::string const& line, size_t pos, std::string &start, std::string &end) {
+	static const char arrow[] = " --> ";
+	const size_t start_len = srt_time_length(line, pos);
+	if (!start_len || line.compare(pos + start_len, sizeof(arrow) - 1, arrow) != 0)
+		return false;
+	const size_t end_pos = pos + start_len + sizeof(arrow) - 1;
+	const size_t end_len = srt_time_length(line, end_pos);
+	if (!end_len)
+		return false;
+
+	start = line.substr(pos, start_len);
+	end = line.substr(end_pos, end_len);
+	return true;
+}
+
+/// Read the timestamp pair at the start of a line
+bool read_timestamps(std::string const& line, std::string &start, std::string &end) {
+	for (size_t pos = 0; pos != std::string::npos; pos = next_line_start(line, pos)) {
+		if (read_timestamps_at(line, pos, start, end))
+			return true;
+	}
+	return false;
+}
+
 struct ToggleTag {
 	char tag;
 	int level = 0;
@@ -126,19 +259,8 @@ class SrtTagParser {
 		std::string color;
 	};
 
-	const boost::regex tag_matcher;
-	const boost::regex attrib_matcher;
-	const boost::regex is_quoted;
-
 public:
-	SrtTagParser()
-	: tag_matcher("^(.*?)<(/?b|/?i|/?u|/?s|/?font)([^>]*)>(.*)$", boost::regex::icase)
-	, attrib_matcher(R"(^[[:space:]]+(face|size|color)=('[^']*'|"[^"]*"|[^[:space:]]+))", boost::regex::icase)
-	, is_quoted(R"(^(['"]).*\1$)")
-	{
-	}
-
-	std::string ToAss(std::string srt)
+	std::string ToAss(std::string const& srt)
 	{
 		ToggleTag bold('b');
 		ToggleTag italic('i');
@@ -147,27 +269,29 @@ public:
 		std::vector<FontAttribs> font_stack;
 
 		std::string ass; // result to be built
+		ass.reserve(srt.size());
 
-		while (!srt.empty())
+		size_t text_start = 0;
+		for (size_t tag_start = srt.find('<'); tag_start != std::string::npos; tag_start = srt.find('<', tag_start + 1))
 		{
-			boost::smatch result;
-			if (!regex_match(srt, result, tag_matcher))
-			{
-				// no more tags could be matched, end of string
-				ass.append(srt);
+			size_t name_len = tag_name_length(srt, tag_start + 1);
+			if (!name_len)
+				continue;
+			size_t name_end = tag_start + 1 + name_len;
+			size_t tag_end = srt.find('>', name_end);
+			// no later tag can be closed either
+			if (tag_end == std::string::npos)
 				break;
-			}
 
 			// we found a tag, translate it
-			std::string pre_text  = result.str(1);
-			std::string tag_name  = result.str(2);
-			std::string tag_attrs = result.str(3);
-			std::string post_text = result.str(4);
+			std::string tag_name  = srt.substr(tag_start + 1, name_len);
+			std::string tag_attrs = srt.substr(name_end, tag_end - name_end);
 
 			// the text before the tag goes through unchanged
-			ass.append(pre_text);
-			// the text after the tag is the input for next iteration
-			srt = post_text;
+			ass.append(srt, text_start, tag_start - text_start);
+			// and the text after the tag is searched for the next one
+			text_start = tag_end + 1;
+			tag_start = tag_end;
 
 			boost::to_lower(tag_name);
 			switch (type_from_name(tag_name))
@@ -190,18 +314,10 @@ public:
 						old_attribs = font_stack.back();
 					new_attribs = old_attribs;
 					// now find all attributes on this font tag
-					boost::smatch result;
-					while (regex_search(tag_attrs, result, attrib_matcher))
+					size_t attr_pos = 0;
+					std::string attr_name, attr_value;
+					while (next_font_attrib(tag_attrs, attr_pos, attr_name, attr_value))
 					{
-						// get attribute name and values
-						std::string attr_name = result.str(1);
-						std::string attr_value = result.str(2);
-
-						// clean them
-						boost::to_lower(attr_name);
-						if (regex_match(attr_value, is_quoted))
-							attr_value = attr_value.substr(1, attr_value.size() - 2);
-
 						// handle the attributes
 						if (attr_name == "face")
 							new_attribs.face = agi::format("{\\fn%s}", attr_value);
@@ -209,9 +325,6 @@ public:
 							new_attribs.size = agi::format("{\\fs%s}", attr_value);
 						else if (attr_name == "color")
 							new_attribs.color = agi::format("{\\c%s}", agi::Color(attr_value).GetAssOverrideFormatted());
-
-						// remove this attribute to prepare for the next
-						tag_attrs = result.suffix().str();
 					}
 
 					// the attributes changed from old are then written out
@@ -269,6 +382,7 @@ public:
 				break;
 			}
 		}
+		ass.append(srt, text_start, std::string::npos);
 
 		// make it a little prettier, join tag groups
 		boost::replace_all(ass, "}{", "");
@@ -313,9 +427,6 @@ void SRTSubtitleFormat::ReadFile(AssFile *target, agi::fs::path const& filename,
 
 	// See parsing algorithm at <http://devel.aegisub.org/wiki/SubtitleFormats/SRT>
 
-	// "hh:mm:ss,fff --> hh:mm:ss,fff" (e.g. "00:00:04,070 --> 00:00:10,04")
-	const boost::regex timestamp_regex("^([0-9]{1,2}:[0-9]{1,2}:[0-9]{1,2},[0-9]{1,}) --> ([0-9]{1,2}:[0-9]{1,2}:[0-9]{1,2},[0-9]{1,})");
-
 	SrtTagParser tag_parser;
 
 	ParseState state = ParseState::INITIAL;
@@ -328,7 +439,7 @@ void SRTSubtitleFormat::ReadFile(AssFile *target, agi::fs::path const& filename,
 		++line_num;
 		boost::trim(text_line);
 
-		boost::smatch timestamp_match;
+		std::string start_time, end_time;
 		bool found_timestamps = false;
 		switch (state) {
 			case ParseState::INITIAL:
@@ -339,7 +450,7 @@ void SRTSubtitleFormat::ReadFile(AssFile *target, agi::fs::path const& filename,
 					state = ParseState::TIMESTAMP;
 					break;
 				}
-				if (regex_search(text_line, timestamp_match, timestamp_regex)) {
+				if (read_timestamps(text_line, start_time, end_time)) {
 					found_timestamps = true;
 					break;
 				}
@@ -347,7 +458,7 @@ void SRTSubtitleFormat::ReadFile(AssFile *target, agi::fs::path const& filename,
 				throw SRTParseError(agi::format("Parsing SRT: Expected subtitle index at line %d", line_num));
 
 			case ParseState::TIMESTAMP:
-				if (!regex_search(text_line, timestamp_match, timestamp_regex))
+				if (!read_timestamps(text_line, start_time, end_time))
 					throw SRTParseError(agi::format("Parsing SRT: Expected timestamp pair at line %d", line_num));
 
 				found_timestamps = true;
@@ -387,7 +498,7 @@ void SRTSubtitleFormat::ReadFile(AssFile *target, agi::fs::path const& filename,
 					state = ParseState::TIMESTAMP;
 					break;
 				}
-				if (regex_search(text_line, timestamp_match, timestamp_regex)) {
+				if (read_timestamps(text_line, start_time, end_time)) {
 					found_timestamps = true;
 					break;
 				}
@@ -409,8 +520,8 @@ void SRTSubtitleFormat::ReadFile(AssFile *target, agi::fs::path const& filename,
 
 			// create new subtitle
 			line = new AssDialogue;
-			line->Start = timestamp_match.str(1);
-			line->End = timestamp_match.str(2);
+			line->Start = start_time;
+			line->End = end_time;
 			// store pointer to subtitle, we'll continue working on it
 			target->Events.push_back(*line);
 			// next we're reading the text
@@ -454,15 +565,15 @@ bool SRTSubtitleFormat::CanSave(const AssFile *file) const {
 	if (!file->Attachments.empty())
 		return false;
 
-	auto def = boost::flyweight<std::string>("Default");
+	auto def = agi::Interned<std::string>("Default");
 	for (auto const& line : file->Events) {
 		if (line.Style != def)
 			return false;
 
-		auto blocks = line.ParseTags();
-		for (auto ovr : blocks | agi::of_type<AssDialogueBlockOverride>()) {
+		auto const& parsed = line.Parsed();
+		for (auto const& block : parsed.Blocks()) {
 			// Verify that all overrides used are supported
-			for (auto const& tag : ovr->Tags) {
+			for (auto const& tag : parsed.Tags(block)) {
 				if (tag.Name.size() != 2)
 					return false;
 				if (!strchr("bisu", tag.Name[1]))
@@ -484,10 +595,11 @@ std::string SRTSubtitleFormat::ConvertTags(const AssDialogue *diag) const {
 	};
 
 	std::string final;
-	for (auto& block : diag->ParseTags()) {
-		switch (block->GetType()) {
+	auto const& parsed = diag->Parsed();
+	for (auto const& block : parsed.Blocks()) {
+		switch (block.type) {
 		case AssBlockType::OVERRIDE:
-			for (auto const& tag : static_cast<AssDialogueBlockOverride&>(*block).Tags) {
+			for (auto const& tag : parsed.Tags(block)) {
 				if (!tag.IsValid() || tag.Name.size() != 2)
 					continue;
 				for (auto& state : tag_states) {
@@ -503,7 +615,7 @@ std::string SRTSubtitleFormat::ConvertTags(const AssDialogue *diag) const {
 			}
 			break;
 		case AssBlockType::PLAIN:
-			final += block->GetText();
+			final += block.text;
 			break;
 		case AssBlockType::DRAWING:
 		case AssBlockType::COMMENT:
@@ -148,7 +148,7 @@ void TXTSubtitleFormat::WriteFile(const AssFile *src, agi::fs::path const& filen
 		if (write_actors)
 			out_line += dia.Actor.get() + ": ";
 
-		std::string out_text = strip_formatting ? dia.GetStrippedText() : dia.Text;
+		std::string out_text = strip_formatting ? dia.GetStrippedText() : dia.Text.get();
 		out_line += out_text;
 
 		if (!out_text.empty())
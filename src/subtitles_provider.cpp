@@ -20,6 +20,7 @@
 #include "ass_attachment.h"
 #include "ass_file.h"
 #include "ass_info.h"
+#include "ass_snapshot.h"
 #include "ass_style.h"
 #include "compat.h"
 #include "factory_manager.h"
@@ -28,8 +29,12 @@
 #include "subtitles_provider_libass.h"
 #include "subtitles_provider_libassmod.h"
 
+#include <libaegisub/dispatch.h>
 #include <libaegisub/log.h>
+#include <libaegisub/trace.h>
 
+#include <algorithm>
+#include <boost/algorithm/string/predicate.hpp>
 #include <mutex>
 
 #include <wx/log.h>
@@ -61,22 +66,42 @@ namespace {
 	}
 
 	std::vector<factory> const& factories() {
-		static std::vector<factory> factories;
-		if (factories.size()) return factories;
+		// Probing the CSRI renderers and libassmod loads libraries, so this
+		// can be slow; the static initialization is safe to race with
+		// Preload()'s background thread
+		static const std::vector<factory> factories = [] {
+			std::vector<factory> factories;
 #ifdef WITH_CSRI
-		for (auto const& subtype : csri::List())
-			factories.push_back(factory{"CSRI/" + subtype, subtype, csri::Create, false});
+			for (auto const& subtype : csri::List())
+				factories.push_back(factory{"CSRI/" + subtype, subtype, csri::Create, false});
 #endif
-		factories.push_back(factory{"libass", "", libass::Create, false});
-		std::string libassmod_error;
-		if (libassmod::IsAvailable(&libassmod_error))
-			factories.push_back(factory{"libassmod", "", libassmod::Create, false});
-		else
-			LOG_D("subtitle/provider") << "libassmod provider hidden: " << libassmod_error;
+			factories.push_back(factory{"libass", "", libass::Create, false});
+			std::string libassmod_error;
+			if (libassmod::IsAvailable(&libassmod_error))
+				factories.push_back(factory{"libassmod", "", libassmod::Create, false});
+			else
+				LOG_D("subtitle/provider") << "libassmod provider hidden: " << libassmod_error;
+			return factories;
+		}();
 		return factories;
 	}
 }
 
+void SubtitlesProviderFactory::Preload() {
+	agi::dispatch::Background(agi::dispatch::Priority::Prefetch).Async([] { factories(); });
+}
+
+bool SubtitlesProviderFactory::WhenFontsReady(std::function<void ()> callback) {
+	// Deliberately not checking if libassmod is available, as that waits on
+	// it to be loaded on the font cache thread
+	auto preferred = OPT_GET("Subtitle/Provider")->GetString();
+	if (preferred == "libassmod")
+		return libassmod::WhenFontsCached(std::move(callback));
+	if (preferred == "libass")
+		return libass::WhenFontsCached(std::move(callback));
+	return false;
+}
+
 std::vector<std::string> SubtitlesProviderFactory::GetClasses() {
 	return ::GetClasses(factories());
 }
@@ -106,8 +131,37 @@ std::unique_ptr<SubtitlesProvider> SubtitlesProviderFactory::GetProvider(agi::Ba
 	throw error;
 }
 
-void SubtitlesProvider::LoadSubtitles(AssFile *subs, int time) {
+bool SubtitlesProvider::IsKnownStyle(AssSnapshot const& subs, agi::Interned<std::string> const& style) {
+	// Every snapshot of an edit has a new header, but the styles themselves
+	// rarely change, so only start over if their names have
+	if (styles_header != subs.header) {
+		styles_header = subs.header;
+		auto const& styles = subs.header->Styles;
+		bool same = styles.size() == style_names.size() && equal(begin(styles), end(styles), begin(style_names),
+			[](AssStyle const& style, std::string const& name) { return style.name == name; });
+		if (!same) {
+			style_names.clear();
+			for (auto const& style : styles)
+				style_names.push_back(style.name);
+			known_styles.clear();
+		}
+	}
+
+	auto it = known_styles.find(style);
+	if (it != known_styles.end())
+		return it->second;
+
+	bool known = any_of(begin(style_names), end(style_names), [&](std::string const& name) {
+		return boost::iequals(name, style.get());
+	});
+	known_styles.emplace(style, known);
+	return known;
+}
+
+void SubtitlesProvider::LoadSubtitles(AssSnapshot const& subs, int time) {
+	AGI_TRACE_ZONE("subtitles", "LoadSubtitles");
 	PrepareSubtitles(subs, time);
+	auto const& header = *subs.header;
 	buffer.clear();
 
 	auto push_header = [&](const char *str) {
@@ -119,29 +173,63 @@ void SubtitlesProvider::LoadSubtitles(AssFile *subs, int time) {
 	};
 
 	push_header("\xEF\xBB\xBF[Script Info]\n");
-	for (auto const& line : subs->Info)
+	for (auto const& line : header.Info)
 		push_line(line.GetEntryData());
 
 	push_header("[V4+ Styles]\n");
-	for (auto const& line : subs->Styles)
+	for (auto const& line : header.Styles)
 		push_line(line.GetEntryData());
 
-	if (!subs->Attachments.empty()) {
+	// Reparsing embedded fonts is by far the slowest part of loading for
+	// providers which keep them anyway, so only send them when they change
+	bool send_fonts = true;
+	std::vector<agi::Interned<std::string>> fonts;
+	if (KeepsEmbeddedFonts()) {
+		for (auto const& attachment : header.Attachments) {
+			if (attachment.Group() == AssEntryGroup::FONT)
+				fonts.push_back(attachment.GetSharedEntryData());
+		}
+		send_fonts = fonts != loaded_fonts;
+	}
+
+	if (send_fonts && !header.Attachments.empty()) {
 		// TODO: some scripts may have a lot of attachments,
 		// so ideally we'd want to write only those actually used on the requested video frame,
 		// but this would require some pre-parsing of the attached font files with FreeType,
 		// which isn't probably trivial.
-		push_header("[Fonts]\n");
-		for (auto const& attachment : subs->Attachments)
-			if (attachment.Group() == AssEntryGroup::FONT)
-				push_line(attachment.GetEntryData());
+		bool fonts_header = false;
+		for (auto const& attachment : header.Attachments) {
+			if (attachment.Group() != AssEntryGroup::FONT || AddEmbeddedFont(attachment))
+				continue;
+			if (!fonts_header) {
+				push_header("[Fonts]\n");
+				fonts_header = true;
+			}
+			push_line(attachment.GetEntryData());
+		}
 	}
 
 	push_header("[Events]\n");
-	for (auto const& line : subs->Events) {
-		if (!line.Comment && (time < 0 || !(line.Start > time || line.End <= time)))
-			push_line(line.GetEntryData());
+	for (auto const& line : subs.events) {
+		if (line->Comment) continue;
+		if (time < 0) {
+			push_line(line->GetEntryData());
+			continue;
+		}
+		if (line->Start > time || line->End <= time) continue;
+
+		// Only the visible lines are sent when loading a single frame, so
+		// lines with styles which don't exist have to be fixed up here to
+		// render the same as they would with the whole file loaded
+		if (IsKnownStyle(subs, line->Style))
+			push_line(line->GetEntryData());
+		else {
+			AssDialogue fixed(*line);
+			fixed.Style = "Default";
+			push_line(fixed.GetEntryData());
+		}
 	}
 
 	LoadSubtitles(&buffer[0], buffer.size());
+	loaded_fonts = std::move(fonts);
 }
@@ -34,10 +34,13 @@
 
 #include "subtitles_provider_libass.h"
 
+#include "ass_attachment.h"
+#include "ass_dialogue.h"
 #include "compat.h"
 #include "include/aegisub/subtitles_provider.h"
 #include "video_frame.h"
 
+#include <libaegisub/alpha_blend.h>
 #include <libaegisub/background_runner.h>
 #include <libaegisub/dispatch.h>
 #include <libaegisub/exception.h>
@@ -46,9 +49,15 @@
 #include <libaegisub/util.h>
 
 #include <atomic>
-#include <boost/gil.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <set>
+#include <tuple>
+#include <vector>
 
 #include <wx/intl.h>
 #include <wx/thread.h>
@@ -76,18 +85,90 @@ void msg_callback(int level, const char *fmt, va_list args, void *) {
 		LOG_D("subtitle/provider/libass") << buf;
 }
 
+/// Renderers which have had their fonts set up but aren't being used by a
+/// provider. Setting up the fonts means having fontconfig scan them, so the
+/// renderer made at startup and those of destroyed providers are kept for
+/// the next provider rather than being thrown away.
+std::mutex idle_mutex;
+std::vector<ASS_Renderer *> idle_renderers;
+const size_t max_idle_renderers = 2;
+
+std::mutex fonts_cached_mutex;
+bool fonts_cached = false;
+std::vector<std::function<void ()>> fonts_cached_callbacks;
+
+ASS_Renderer *new_renderer() {
+	auto ass_renderer = ass_renderer_init(library);
+	if (ass_renderer) {
+		ass_set_font_scale(ass_renderer, 1.);
+		ass_set_fonts(ass_renderer, nullptr, "Sans", 1, nullptr, true);
+	}
+	return ass_renderer;
+}
+
+ASS_Renderer *take_idle_renderer() {
+	std::lock_guard<std::mutex> lock(idle_mutex);
+	if (idle_renderers.empty()) return nullptr;
+	auto ass_renderer = idle_renderers.back();
+	idle_renderers.pop_back();
+	return ass_renderer;
+}
+
+void release_renderer(ASS_Renderer *ass_renderer) {
+	{
+		std::lock_guard<std::mutex> lock(idle_mutex);
+		if (idle_renderers.size() < max_idle_renderers) {
+			idle_renderers.push_back(ass_renderer);
+			return;
+		}
+	}
+	ass_renderer_done(ass_renderer);
+}
+
+void set_fonts_cached() {
+	std::vector<std::function<void ()>> callbacks;
+	{
+		std::lock_guard<std::mutex> lock(fonts_cached_mutex);
+		fonts_cached = true;
+		callbacks.swap(fonts_cached_callbacks);
+	}
+	for (auto& callback : callbacks)
+		agi::dispatch::Main().Async(std::move(callback));
+}
+
+/// Embedded fonts which have already been added to the library, which keeps
+/// them for as long as it exists, identified by their entry data
+std::mutex added_fonts_mutex;
+std::set<std::tuple<size_t, size_t, std::string>> added_fonts;
+
+bool add_embedded_font(AssAttachment const& font) {
+	auto const& data = font.GetSharedEntryData();
+	auto key = std::make_tuple(data.hash(), data.get().size(), font.GetFileName(true));
+	{
+		std::lock_guard<std::mutex> lock(added_fonts_mutex);
+		if (!added_fonts.insert(key).second) return true;
+	}
+
+	std::vector<char> decoded;
+	font.Decode(decoded);
+	ass_add_font(library, const_cast<char *>(std::get<2>(key).c_str()), decoded.data(), static_cast<int>(decoded.size()));
+	return true;
+}
+
 // Stuff used on the cache thread, owned by a shared_ptr in case the provider
 // gets deleted before the cache finishing updating
 struct cache_thread_shared {
 	ASS_Renderer *renderer = nullptr;
 	std::atomic<bool> ready{false};
-	~cache_thread_shared() { if (renderer) ass_renderer_done(renderer); }
+	~cache_thread_shared() { if (renderer) release_renderer(renderer); }
 };
 
 class LibassSubtitlesProvider final : public SubtitlesProvider {
 	agi::BackgroundRunner *br;
 	std::shared_ptr<cache_thread_shared> shared;
 	ASS_Track* ass_track = nullptr;
+	/// Was the last frame rendered with DrawOverlay()?
+	bool overlay_current = false;
 
 	ASS_Renderer *renderer() {
 		if (shared->ready)
@@ -115,6 +196,10 @@ class LibassSubtitlesProvider final : public SubtitlesProvider {
 		return shared->renderer;
 	}
 
+	// Fonts are added to the ASS_Library, not the track
+	bool KeepsEmbeddedFonts() const override { return true; }
+	bool AddEmbeddedFont(AssAttachment const& font) override { return add_embedded_font(font); }
+
 public:
 	LibassSubtitlesProvider(agi::BackgroundRunner *br);
 	~LibassSubtitlesProvider();
@@ -126,6 +211,9 @@ public:
 	}
 
 	void DrawSubtitles(VideoFrame &dst, double time) override;
+	bool UpdateEvent(size_t index, AssDialogue const& line) override;
+	bool CanDrawOverlay() const override { return true; }
+	bool DrawOverlay(SubtitlesOverlay &dst, int width, int height, double time) override;
 
 	void Reinitialize() override {
 		// No need to reinit if we're not even done with the initial init
@@ -133,9 +221,14 @@ public:
 			return;
 
 		ass_renderer_done(shared->renderer);
-		shared->renderer = ass_renderer_init(library);
-		ass_set_font_scale(shared->renderer, 1.);
-		ass_set_fonts(shared->renderer, nullptr, "Sans", 1, nullptr, true);
+		shared->renderer = new_renderer();
+		overlay_current = false;
+	}
+
+	void SetProfiling(bool profiling) override {
+		// libass trims its caches down to the limits after each frame, and
+		// zero means the default limits
+		ass_set_cache_limits(renderer(), profiling ? 1 : 0, profiling ? 1 : 0);
 	}
 };
 
@@ -143,14 +236,18 @@ LibassSubtitlesProvider::LibassSubtitlesProvider(agi::BackgroundRunner *br)
 : br(br)
 , shared(std::make_shared<cache_thread_shared>())
 {
+	if (auto ass_renderer = take_idle_renderer()) {
+		shared->renderer = ass_renderer;
+		shared->ready = true;
+		return;
+	}
+
+	// The startup renderer may still be being set up on the cache thread, in
+	// which case it'll be available once this runs
 	auto state = shared;
 	cache_queue->Async([state] {
-		auto ass_renderer = ass_renderer_init(library);
-		if (ass_renderer) {
-			ass_set_font_scale(ass_renderer, 1.);
-			ass_set_fonts(ass_renderer, nullptr, "Sans", 1, nullptr, true);
-		}
-		state->renderer = ass_renderer;
+		auto ass_renderer = take_idle_renderer();
+		state->renderer = ass_renderer ? ass_renderer : new_renderer();
 		state->ready = true;
 	});
 }
@@ -159,12 +256,70 @@ LibassSubtitlesProvider::~LibassSubtitlesProvider() {
 	if (ass_track) ass_free_track(ass_track);
 }
 
-#define _r(c) ((c)>>24)
-#define _g(c) (((c)>>16)&0xFF)
-#define _b(c) (((c)>>8)&0xFF)
-#define _a(c) ((c)&0xFF)
+std::vector<agi::BlendImage> ToBlendImages(ASS_Image *img) {
+	std::vector<agi::BlendImage> images;
+	for (; img; img = img->next)
+		images.push_back({agi::BlendImage::Mask, img->bitmap, img->stride, img->dst_x, img->dst_y, img->w, img->h, img->color});
+	return images;
+}
+
+/// Trim a field the same way libass's parser does
+std::string trim_field(std::string const& str, size_t begin, size_t end) {
+	while (begin < end && (str[begin] == ' ' || str[begin] == '\t')) ++begin;
+	while (end > begin && (str[end - 1] == ' ' || str[end - 1] == '\t')) --end;
+	return str.substr(begin, end - begin);
+}
+
+/// Find a style by name the same way libass's parser does
+int lookup_style(ASS_Track *track, std::string const& name) {
+	size_t start = name.find_first_not_of('*');
+	std::string stripped = start == std::string::npos ? "" : name.substr(start);
+	if (boost::iequals(stripped, "Default"))
+		stripped = "Default";
+	for (int i = track->n_styles - 1; i >= 0; --i) {
+		if (stripped == track->styles[i].Name)
+			return i;
+	}
+	return track->default_style;
+}
+
+bool LibassSubtitlesProvider::UpdateEvent(size_t index, AssDialogue const& line) {
+	if (!ass_track || index >= static_cast<size_t>(ass_track->n_events))
+		return false;
+
+	// Split the serialized line rather than using the fields directly so
+	// that the result is exactly what reloading the file would produce
+	std::string data = line.GetEntryData();
+	std::vector<std::pair<size_t, size_t>> fields;
+	size_t pos = data.find(':') + 1;
+	for (int i = 0; i < 9; ++i) {
+		size_t comma = data.find(',', pos);
+		if (comma == std::string::npos) return false;
+		fields.emplace_back(pos, comma);
+		pos = comma + 1;
+	}
+
+	auto replace = [](char *&dst, std::string const& value) {
+		free(dst);
+		dst = strdup(value.c_str());
+	};
+
+	ASS_Event &event = ass_track->events[index];
+	event.Layer = line.Layer;
+	event.Start = int(line.Start);
+	event.Duration = int(line.End) - int(line.Start);
+	event.Style = lookup_style(ass_track, trim_field(data, fields[3].first, fields[3].second));
+	event.MarginL = line.Margin[0];
+	event.MarginR = line.Margin[1];
+	event.MarginV = line.Margin[2];
+	replace(event.Name, trim_field(data, fields[4].first, fields[4].second));
+	replace(event.Effect, trim_field(data, fields[8].first, fields[8].second));
+	replace(event.Text, data.substr(pos));
+	return true;
+}
 
 void LibassSubtitlesProvider::DrawSubtitles(VideoFrame &frame,double time) {
+	overlay_current = false;
 	ass_set_frame_size(renderer(), frame.width, frame.height);
 	// Note: this relies on Aegisub always rendering at video storage res
 	ass_set_storage_size(renderer(), frame.width, frame.height);
@@ -174,33 +329,22 @@ void LibassSubtitlesProvider::DrawSubtitles(VideoFrame &frame,double time) {
 	// libass actually returns several alpha-masked monochrome images.
 	// Here, we loop through their linked list, get the colour of the current, and blend into the frame.
 	// This is repeated for all of them.
+	agi::BlendImages(frame.PixelAt(0, 0), frame.RowStep(), frame.height, ToBlendImages(img), false);
+}
 
-	using namespace boost::gil;
-	auto dst = interleaved_view(frame.width, frame.height, (bgra8_pixel_t*)frame.data.data(), frame.width * 4);
-	if (frame.flipped)
-		dst = flipped_up_down_view(dst);
-
-	for (; img; img = img->next) {
-		unsigned int opacity = 255 - ((unsigned int)_a(img->color));
-		unsigned int r = (unsigned int)_r(img->color);
-		unsigned int g = (unsigned int)_g(img->color);
-		unsigned int b = (unsigned int)_b(img->color);
-
-		auto srcview = interleaved_view(img->w, img->h, (gray8_pixel_t*)img->bitmap, img->stride);
-		auto dstview = subimage_view(dst, img->dst_x, img->dst_y, img->w, img->h);
-
-		transform_pixels(dstview, srcview, dstview, [=](const bgra8_pixel_t frame, const gray8_pixel_t src) -> bgra8_pixel_t {
-			unsigned int k = ((unsigned)src) * opacity / 255;
-			unsigned int ck = 255 - k;
-
-			bgra8_pixel_t ret;
-			ret[0] = (k * b + ck * frame[0]) / 255;
-			ret[1] = (k * g + ck * frame[1]) / 255;
-			ret[2] = (k * r + ck * frame[2]) / 255;
-			ret[3] = 0;
-			return ret;
-		});
-	}
+bool LibassSubtitlesProvider::DrawOverlay(SubtitlesOverlay &dst, int width, int height, double time) {
+	ass_set_frame_size(renderer(), width, height);
+	ass_set_storage_size(renderer(), width, height);
+
+	int detect_change = 0;
+	ASS_Image* img = ass_render_frame(renderer(), ass_track, int(time * 1000), &detect_change);
+	// libass compares against whatever it rendered last, which is only
+	// the overlay the caller has if nothing else was drawn in between
+	if (!detect_change && overlay_current) return false;
+	overlay_current = true;
+
+	dst.Render(ToBlendImages(img));
+	return true;
 }
 }
 
@@ -211,17 +355,25 @@ std::unique_ptr<SubtitlesProvider> Create(std::string const&, agi::BackgroundRun
 
 void CacheFonts() {
 	// Initialize the cache worker thread
-	cache_queue = agi::dispatch::Create();
+	cache_queue = agi::dispatch::Create(agi::dispatch::Priority::Prefetch);
 
 	// Initialize libass
 	library = ass_library_init();
 	ass_set_message_cb(library, msg_callback, nullptr);
 
-	// Initialize a renderer to force fontconfig to update its cache
+	// Initialize a renderer to force fontconfig to update its cache, and
+	// keep it for the first provider
 	cache_queue->Async([] {
-		auto ass_renderer = ass_renderer_init(library);
-		ass_set_fonts(ass_renderer, nullptr, "Sans", 1, nullptr, true);
-		ass_renderer_done(ass_renderer);
+		if (auto ass_renderer = new_renderer())
+			release_renderer(ass_renderer);
+		set_fonts_cached();
 	});
 }
+
+bool WhenFontsCached(std::function<void ()> callback) {
+	std::lock_guard<std::mutex> lock(fonts_cached_mutex);
+	if (fonts_cached || !cache_queue) return false;
+	fonts_cached_callbacks.push_back(std::move(callback));
+	return true;
+}
 }
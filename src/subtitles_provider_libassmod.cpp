@@ -23,31 +23,39 @@
 
 #include "ass_attachment.h"
 #include "ass_file.h"
+#include "ass_snapshot.h"
 #include "compat.h"
 #include "include/aegisub/subtitles_provider.h"
 #include "video_frame.h"
 
+#include <libaegisub/alpha_blend.h>
 #include <libaegisub/ass/uuencode.h>
 #include <libaegisub/background_runner.h>
 #include <libaegisub/dispatch.h>
 #include <libaegisub/exception.h>
 #include <libaegisub/log.h>
 #include <libaegisub/make_unique.h>
+#include <libaegisub/memory_usage.h>
 #include <libaegisub/util.h>
 
 #include <atomic>
 #include <algorithm>
-#include <boost/gil.hpp>
 #include <cctype>
 #include <cstdint>
+#include <functional>
+#include <list>
 #include <memory>
 #include <mutex>
+#include <set>
 #include <string>
+#include <tuple>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include <wx/dir.h>
+#include <wx/filefn.h>
 #include <wx/image.h>
 #include <wx/filename.h>
 #include <wx/imagpng.h>
@@ -122,6 +130,7 @@ using AssSetFrameSizeFunc = void (*)(ASS_Renderer *, int, int);
 using AssSetStorageSizeFunc = void (*)(ASS_Renderer *, int, int);
 using AssRenderFrameAutoFunc = ASS_RenderResult (*)(ASS_Renderer *, ASS_Track *, long long, int *);
 using AssFreeImagesRGBAFunc = void (*)(ASS_ImageRGBA *);
+using AssAddFontFunc = void (*)(ASS_Library *, char *, char *, int);
 #ifdef LIBASSMOD_FEATURE_TAG_IMAGE
 using AssClearTagImagesFunc = void (*)(ASS_Renderer *);
 using AssSetTagImageRGBAFunc = int (*)(ASS_Renderer *, const char *, ASS_TagImageFormat, int, int, int, const unsigned char *);
@@ -142,6 +151,7 @@ struct LibassModApi {
 	AssSetStorageSizeFunc ass_set_storage_size = nullptr;
 	AssRenderFrameAutoFunc ass_render_frame_auto = nullptr;
 	AssFreeImagesRGBAFunc ass_free_images_rgba = nullptr;
+	AssAddFontFunc ass_add_font = nullptr;
 #ifdef LIBASSMOD_FEATURE_TAG_IMAGE
 	AssClearTagImagesFunc ass_clear_tag_images = nullptr;
 	AssSetTagImageRGBAFunc ass_set_tag_image_rgba = nullptr;
@@ -255,6 +265,7 @@ bool LoadLibassModApi(std::string &error) {
 		CloseLibassModHandle();
 		return false;
 	}
+	LoadOptionalSymbol(api.handle, "ass_add_font", api.ass_add_font);
 #ifdef LIBASSMOD_FEATURE_TAG_IMAGE
 	LoadOptionalSymbol(api.handle, "ass_clear_tag_images", api.ass_clear_tag_images);
 	LoadOptionalSymbol(api.handle, "ass_set_tag_image_rgba", api.ass_set_tag_image_rgba);
@@ -282,21 +293,76 @@ bool EnsureLibassMod(std::string *error) {
 
 void EnsureCacheQueue() {
 	std::call_once(cache_queue_once, [] {
-		cache_queue = agi::dispatch::Create();
+		cache_queue = agi::dispatch::Create(agi::dispatch::Priority::Prefetch);
 	});
 }
 
 #ifdef LIBASSMOD_FEATURE_TAG_IMAGE
-struct TagImage {
-	std::string key;
-	std::string basename_lower;
-	ASS_TagImageFormat format = ASS_TAG_IMAGE_FORMAT_PNG;
+/// Decoded pixels of an image used by \\img tags
+struct TagImagePixels {
 	int width = 0;
 	int height = 0;
 	int stride = 0;
 	std::vector<unsigned char> rgba;
 };
 
+struct TagImage {
+	std::string key;
+	std::string basename_lower;
+	ASS_TagImageFormat format = ASS_TAG_IMAGE_FORMAT_PNG;
+	std::shared_ptr<const TagImagePixels> pixels;
+};
+
+/// Decoded images shared by every provider, so that reloading the script or
+/// opening a new provider for it doesn't decode them again. Attachments are
+/// keyed by their contents and files by their path and modification time.
+std::mutex tag_image_cache_mutex;
+std::list<std::pair<std::string, std::shared_ptr<const TagImagePixels>>> tag_image_cache;
+std::unordered_map<std::string, decltype(tag_image_cache)::iterator> tag_image_cache_index;
+size_t tag_image_cache_bytes = 0;
+/// Size at which the least recently used images are dropped from the cache;
+/// providers keep the images they're using regardless
+const size_t tag_image_cache_limit = 256 << 20;
+agi::memory::Counter tag_image_memory{"Subtitle tag images", tag_image_cache_limit};
+
+/// Drop the least recently used images until the cache is no bigger than keep
+void shrink_tag_image_cache(size_t keep) {
+	while (tag_image_cache_bytes > keep && !tag_image_cache.empty()) {
+		auto const& oldest = tag_image_cache.back();
+		tag_image_cache_bytes -= oldest.second->rgba.size();
+		tag_image_cache_index.erase(oldest.first);
+		tag_image_cache.pop_back();
+	}
+	tag_image_memory.Set(tag_image_cache_bytes);
+}
+
+agi::memory::Trimmer tag_image_trimmer{20, [](agi::memory::Pressure pressure) {
+	std::lock_guard<std::mutex> lock(tag_image_cache_mutex);
+	shrink_tag_image_cache(pressure == agi::memory::Pressure::Critical ? 0 : tag_image_cache_bytes / 2);
+}};
+
+std::shared_ptr<const TagImagePixels> cached_tag_image(std::string const& key) {
+	std::lock_guard<std::mutex> lock(tag_image_cache_mutex);
+	auto it = tag_image_cache_index.find(key);
+	if (it == tag_image_cache_index.end())
+		return nullptr;
+	tag_image_cache.splice(tag_image_cache.begin(), tag_image_cache, it->second); // Move to front
+	return it->second->second;
+}
+
+void add_cached_tag_image(std::string const& key, std::shared_ptr<const TagImagePixels> pixels) {
+	std::lock_guard<std::mutex> lock(tag_image_cache_mutex);
+	if (tag_image_cache_index.count(key))
+		return;
+
+	tag_image_cache_bytes += pixels->rgba.size();
+	tag_image_cache.emplace_front(key, std::move(pixels));
+	tag_image_cache_index[key] = tag_image_cache.begin();
+
+	// The newest image is kept even if it's bigger than the whole limit
+	shrink_tag_image_cache(std::max(tag_image_cache_limit, tag_image_cache.front().second->rgba.size()));
+}
+
 std::string trim_copy(std::string str) {
 	auto not_space = [](unsigned char c) { return !std::isspace(c); };
 	auto begin = std::find_if(str.begin(), str.end(), not_space);
@@ -353,22 +419,6 @@ std::string wx_to_utf8_copy(wxString const& value) {
 	return std::string(value.utf8_str());
 }
 
-static inline char img_ascii_tolower(char c) {
-	if (c >= 'A' && c <= 'Z')
-		return static_cast<char>(c - 'A' + 'a');
-	return c;
-}
-
-bool img_starts_with_icase(const char *text, size_t len, const char *prefix) {
-	for (size_t i = 0; prefix[i]; ++i) {
-		if (i >= len)
-			return false;
-		if (img_ascii_tolower(text[i]) != prefix[i])
-			return false;
-	}
-	return true;
-}
-
 bool path_is_absolute(std::string const& path) {
 	std::vector<wxString> bases;
 	append_unique_candidate(&bases, wxString::FromUTF8(path.c_str()));
@@ -437,20 +487,21 @@ void ensure_image_handlers() {
 	});
 }
 
-bool decode_image_to_rgba(wxImage &image, TagImage *out) {
+std::shared_ptr<const TagImagePixels> decode_image_to_rgba(wxImage &image) {
 	if (!image.IsOk())
-		return false;
+		return nullptr;
 
 	int width = image.GetWidth();
 	int height = image.GetHeight();
 	if (width <= 0 || height <= 0)
-		return false;
+		return nullptr;
 
 	unsigned char *rgb = image.GetData();
 	unsigned char *alpha = image.HasAlpha() ? image.GetAlpha() : nullptr;
 	if (!rgb)
-		return false;
+		return nullptr;
 
+	auto out = std::make_shared<TagImagePixels>();
 	out->width = width;
 	out->height = height;
 	out->stride = width * 4;
@@ -463,10 +514,40 @@ bool decode_image_to_rgba(wxImage &image, TagImage *out) {
 		out->rgba[i * 4 + 3] = alpha ? alpha[i] : 255;
 	}
 
-	return true;
+	return out;
 }
 
-bool decode_attachment_image(AssAttachment const& attachment, TagImage *out) {
+/// Look up each image in the shared cache, and decode the ones which aren't
+/// there in parallel
+/// @param keys Cache key of each image
+/// @param decode Decoder for the image with the given index
+std::vector<std::shared_ptr<const TagImagePixels>> load_tag_images(std::vector<std::string> const& keys,
+	std::function<std::shared_ptr<const TagImagePixels> (size_t)> const& decode) {
+	std::vector<std::shared_ptr<const TagImagePixels>> images(keys.size());
+	std::vector<size_t> missing;
+	for (size_t i = 0; i < keys.size(); ++i) {
+		images[i] = cached_tag_image(keys[i]);
+		if (!images[i])
+			missing.push_back(i);
+	}
+	if (missing.empty())
+		return images;
+
+	ensure_image_handlers();
+	agi::dispatch::Parallel(missing.size(), [&](size_t i) {
+		images[missing[i]] = decode(missing[i]);
+	});
+
+	for (size_t i : missing) {
+		if (images[i])
+			add_cached_tag_image(keys[i], images[i]);
+	}
+	return images;
+}
+
+/// Read the name and format of an image attachment
+/// @return false if the attachment isn't something which can be drawn with \img
+bool attachment_image_info(AssAttachment const& attachment, TagImage *out) {
 	std::string const& entry = attachment.GetEntryData();
 	size_t header_end = entry.find('\n');
 	if (header_end == std::string::npos)
@@ -482,53 +563,44 @@ bool decode_attachment_image(AssAttachment const& attachment, TagImage *out) {
 	if (!parse_tag_image_format(filename, &out->format))
 		return false;
 
+	out->key = filename;
+	out->basename_lower = to_lower_copy(path_basename(filename));
+	return true;
+}
+
+std::string attachment_image_cache_key(AssAttachment const& attachment) {
+	auto const& data = attachment.GetSharedEntryData();
+	return "attachment:" + std::to_string(data.hash()) + ":" + std::to_string(data.get().size());
+}
+
+std::shared_ptr<const TagImagePixels> decode_attachment_image(AssAttachment const& attachment) {
+	std::string const& entry = attachment.GetEntryData();
+	size_t header_end = entry.find('\n');
+	if (header_end == std::string::npos)
+		return nullptr;
+
 	auto decoded = agi::ass::UUDecode(entry.c_str() + header_end + 1,
 		entry.c_str() + entry.size());
 	if (decoded.empty())
-		return false;
+		return nullptr;
 
-	ensure_image_handlers();
 	wxMemoryInputStream stream(decoded.data(), decoded.size());
 	wxImage image;
 	{
 		wxLogNull suppress;
 		if (!image.LoadFile(stream, wxBITMAP_TYPE_ANY))
-			return false;
+			return nullptr;
 	}
-	if (!decode_image_to_rgba(image, out))
-		return false;
-
-	out->key = filename;
-	out->basename_lower = to_lower_copy(path_basename(filename));
-	return true;
+	return decode_image_to_rgba(image);
 }
 
-bool decode_file_image(std::string const& path, wxString const& script_dir,
-	TagImage *out, std::string *resolved_path) {
-	if (!parse_tag_image_format(path, &out->format))
-		return false;
-	if (resolved_path)
-		resolved_path->clear();
-
-	ensure_image_handlers();
+/// Find the file an \img path refers to, trying it relative to the script
+/// and then a case-insensitive match for its name in the script's directory
+/// @return The full path of the file, or an empty string if there isn't one
+wxString resolve_file_image(std::string const& path, wxString const& script_dir) {
 	for (auto const& candidate : file_image_candidates(path, script_dir)) {
-		if (!wxFileName::FileExists(candidate))
-			continue;
-
-		wxImage image;
-		{
-			wxLogNull suppress;
-			if (!image.LoadFile(candidate, wxBITMAP_TYPE_ANY))
-				continue;
-		}
-		if (!decode_image_to_rgba(image, out))
-			return false;
-
-		out->key = path;
-		out->basename_lower = to_lower_copy(path_basename(path));
-		if (resolved_path)
-			*resolved_path = wx_to_utf8_copy(candidate);
-		return true;
+		if (wxFileName::FileExists(candidate))
+			return candidate;
 	}
 
 	std::string basename_lower = to_lower_copy(path_basename(path));
@@ -538,31 +610,28 @@ bool decode_file_image(std::string const& path, wxString const& script_dir,
 			wxString entry;
 			bool more = dir.GetFirst(&entry, wxEmptyString, wxDIR_FILES);
 			while (more) {
-				if (to_lower_copy(wx_to_utf8_copy(entry)) == basename_lower) {
-					wxString candidate = wxFileName(script_dir, entry).GetFullPath();
-					wxImage image;
-					{
-						wxLogNull suppress;
-						if (!image.LoadFile(candidate, wxBITMAP_TYPE_ANY)) {
-							more = dir.GetNext(&entry);
-							continue;
-						}
-					}
-					if (!decode_image_to_rgba(image, out))
-						return false;
-
-					out->key = path;
-					out->basename_lower = basename_lower;
-					if (resolved_path)
-						*resolved_path = wx_to_utf8_copy(candidate);
-					return true;
-				}
+				if (to_lower_copy(wx_to_utf8_copy(entry)) == basename_lower)
+					return wxFileName(script_dir, entry).GetFullPath();
 				more = dir.GetNext(&entry);
 			}
 		}
 	}
 
-	return false;
+	return wxString();
+}
+
+std::string file_image_cache_key(wxString const& filename) {
+	return "file:" + wx_to_utf8_copy(filename) + ":" + std::to_string(static_cast<long long>(wxFileModificationTime(filename)));
+}
+
+std::shared_ptr<const TagImagePixels> decode_file_image(wxString const& filename) {
+	wxImage image;
+	{
+		wxLogNull suppress;
+		if (!image.LoadFile(filename, wxBITMAP_TYPE_ANY))
+			return nullptr;
+	}
+	return decode_image_to_rgba(image);
 }
 
 void collect_img_paths_from_span(const char *data, size_t len,
@@ -614,57 +683,81 @@ void collect_img_paths_from_span(const char *data, size_t len,
 			paths->push_back(path);
 	}
 }
+#endif
 
-std::vector<std::string> collect_img_paths(const char *data, size_t len) {
-	std::vector<std::string> paths;
-	std::unordered_set<std::string> seen;
-	bool saw_section = false;
-	bool in_events = true;
+/// Renderers which have had their fonts set up but aren't being used by a
+/// provider, kept for the next provider as setting up the fonts is slow
+std::mutex idle_mutex;
+std::vector<ASS_Renderer *> idle_renderers;
+const size_t max_idle_renderers = 2;
 
-	size_t line_start = 0;
-	for (size_t i = 0; i <= len; ++i) {
-		if (i < len && data[i] != '\n')
-			continue;
+std::mutex fonts_cached_mutex;
+bool fonts_cached = false;
+std::vector<std::function<void ()>> fonts_cached_callbacks;
 
-		size_t start = line_start;
-		size_t end = i;
-		line_start = i + 1;
+ASS_Renderer *new_renderer() {
+	auto ass_renderer = api.ass_renderer_init(library);
+	if (ass_renderer) {
+		api.ass_set_font_scale(ass_renderer, 1.);
+		api.ass_set_fonts(ass_renderer, nullptr, "Sans", 1, nullptr, true);
+	}
+	return ass_renderer;
+}
 
-		if (end > start && data[end - 1] == '\r')
-			--end;
-		while (start < end && (data[start] == ' ' || data[start] == '\t'))
-			++start;
-		while (end > start && (data[end - 1] == ' ' || data[end - 1] == '\t'))
-			--end;
-		if (end <= start)
-			continue;
+ASS_Renderer *take_idle_renderer() {
+	std::lock_guard<std::mutex> lock(idle_mutex);
+	if (idle_renderers.empty()) return nullptr;
+	auto ass_renderer = idle_renderers.back();
+	idle_renderers.pop_back();
+	return ass_renderer;
+}
 
-		const char *line = data + start;
-		size_t line_len = end - start;
-		if (line[0] == '[' && line[line_len - 1] == ']') {
-			saw_section = true;
-			size_t sec_start = 1;
-			size_t sec_end = line_len - 1;
-			while (sec_start < sec_end && (line[sec_start] == ' ' || line[sec_start] == '\t'))
-				++sec_start;
-			while (sec_end > sec_start && (line[sec_end - 1] == ' ' || line[sec_end - 1] == '\t'))
-				--sec_end;
-			in_events = (sec_end - sec_start == 6)
-				&& img_starts_with_icase(line + sec_start, sec_end - sec_start, "events");
-			continue;
+void release_renderer(ASS_Renderer *ass_renderer) {
+#ifdef LIBASSMOD_FEATURE_TAG_IMAGE
+	if (api.ass_clear_tag_images)
+		api.ass_clear_tag_images(ass_renderer);
+#endif
+	{
+		std::lock_guard<std::mutex> lock(idle_mutex);
+		if (idle_renderers.size() < max_idle_renderers) {
+			idle_renderers.push_back(ass_renderer);
+			return;
 		}
+	}
+	api.ass_renderer_done(ass_renderer);
+}
 
-		if (saw_section && !in_events)
-			continue;
-		if (!img_starts_with_icase(line, line_len, "dialogue:"))
-			continue;
+void set_fonts_cached() {
+	std::vector<std::function<void ()>> callbacks;
+	{
+		std::lock_guard<std::mutex> lock(fonts_cached_mutex);
+		fonts_cached = true;
+		callbacks.swap(fonts_cached_callbacks);
+	}
+	for (auto& callback : callbacks)
+		agi::dispatch::Main().Async(std::move(callback));
+}
+
+/// Embedded fonts which have already been added to the library, which keeps
+/// them for as long as it exists, identified by their entry data
+std::mutex added_fonts_mutex;
+std::set<std::tuple<size_t, size_t, std::string>> added_fonts;
 
-		collect_img_paths_from_span(line, line_len, &paths, &seen);
+bool add_embedded_font(AssAttachment const& font) {
+	if (!api.ass_add_font) return false;
+
+	auto const& data = font.GetSharedEntryData();
+	auto key = std::make_tuple(data.hash(), data.get().size(), font.GetFileName(true));
+	{
+		std::lock_guard<std::mutex> lock(added_fonts_mutex);
+		if (!added_fonts.insert(key).second) return true;
 	}
 
-	return paths;
+	std::vector<char> decoded;
+	font.Decode(decoded);
+	api.ass_add_font(library, const_cast<char *>(std::get<2>(key).c_str()), decoded.data(), static_cast<int>(decoded.size()));
+	return true;
 }
-#endif
 
 // Stuff used on the cache thread, owned by a shared_ptr in case the provider
 // gets deleted before the cache finishing updating
@@ -673,7 +766,7 @@ struct cache_thread_shared {
 	std::atomic<bool> ready{false};
 	~cache_thread_shared() {
 		if (renderer && api.ass_renderer_done)
-			api.ass_renderer_done(renderer);
+			release_renderer(renderer);
 	}
 };
 
@@ -681,30 +774,91 @@ class LibassModSubtitlesProvider final : public SubtitlesProvider {
 	agi::BackgroundRunner *br;
 	std::shared_ptr<cache_thread_shared> shared;
 	ASS_Track *ass_track = nullptr;
+	/// Was the last frame rendered with DrawOverlay()?
+	bool overlay_current = false;
 
 #ifdef LIBASSMOD_FEATURE_TAG_IMAGE
 	std::vector<TagImage> attachment_tag_images;
-	std::unordered_map<std::string, TagImage> file_tag_image_cache;
+	/// Cache keys of attachment_tag_images, to tell when they've changed
+	std::vector<std::string> attachment_tag_image_keys;
 	std::vector<std::string> tag_image_paths;
+	/// \img paths found in each line's text, so that only lines which have
+	/// changed since the last load have to be scanned for them
+	std::unordered_map<agi::Interned<std::string>, std::vector<std::string>> line_img_paths;
 	wxString tag_image_script_dir;
 	bool tag_images_dirty = false;
 
-	void PrepareSubtitles(AssFile *subs, int) override {
+	void PrepareSubtitles(AssSnapshot const& subs, int time) override {
+		auto const& header = *subs.header;
 		wxString script_dir;
-		if (!subs->Filename.empty())
-			script_dir = wxString(subs->Filename.parent_path().wstring().c_str());
+		if (!header.Filename.empty())
+			script_dir = wxString(header.Filename.parent_path().wstring().c_str());
 		if (script_dir != tag_image_script_dir)
-			file_tag_image_cache.clear();
+			tag_images_dirty = true;
 		tag_image_script_dir = script_dir;
 
-		attachment_tag_images.clear();
-		for (auto const& attachment : subs->Attachments) {
+		std::vector<TagImage> attachments;
+		std::vector<AssAttachment const*> sources;
+		std::vector<std::string> keys;
+		for (auto const& attachment : header.Attachments) {
 			if (attachment.Group() != AssEntryGroup::GRAPHIC)
 				continue;
 
 			TagImage image;
-			if (decode_attachment_image(attachment, &image))
-				attachment_tag_images.push_back(std::move(image));
+			if (!attachment_image_info(attachment, &image))
+				continue;
+			attachments.push_back(std::move(image));
+			sources.push_back(&attachment);
+			keys.push_back(attachment_image_cache_key(attachment));
+		}
+
+		if (keys != attachment_tag_image_keys) {
+			auto pixels = load_tag_images(keys, [&](size_t i) {
+				return decode_attachment_image(*sources[i]);
+			});
+			attachment_tag_images.clear();
+			for (size_t i = 0; i < attachments.size(); ++i) {
+				if (!pixels[i])
+					continue;
+				attachments[i].pixels = std::move(pixels[i]);
+				attachment_tag_images.push_back(std::move(attachments[i]));
+			}
+			attachment_tag_image_keys = std::move(keys);
+			tag_images_dirty = true;
+		}
+
+		// Collect the paths from the same lines LoadSubtitles sends
+		std::vector<std::string> paths;
+		std::unordered_set<std::string> seen;
+		decltype(line_img_paths) line_paths;
+		for (auto const& line : subs.events) {
+			if (line->Comment) continue;
+			if (time >= 0 && (line->Start > time || line->End <= time)) continue;
+
+			auto it = line_paths.find(line->Text);
+			if (it == line_paths.end()) {
+				auto old = line_img_paths.find(line->Text);
+				if (old != line_img_paths.end())
+					it = line_paths.emplace(line->Text, std::move(old->second)).first;
+				else {
+					std::vector<std::string> found;
+					std::unordered_set<std::string> line_seen;
+					auto const& text = line->Text.get();
+					collect_img_paths_from_span(text.data(), text.size(), &found, &line_seen);
+					it = line_paths.emplace(line->Text, std::move(found)).first;
+				}
+			}
+
+			for (auto const& path : it->second) {
+				if (seen.insert(path).second)
+					paths.push_back(path);
+			}
+		}
+		line_img_paths = std::move(line_paths);
+
+		if (paths != tag_image_paths) {
+			tag_image_paths = std::move(paths);
+			tag_images_dirty = true;
 		}
 	}
 
@@ -728,79 +882,81 @@ class LibassModSubtitlesProvider final : public SubtitlesProvider {
 		api.ass_clear_tag_images(ass_renderer);
 
 		std::unordered_set<std::string> registered_paths;
-		auto register_key = [&](std::string const& key, ASS_TagImageFormat format,
-			int width, int height, int stride, const unsigned char *rgba) {
+		auto register_key = [&](std::string const& key, TagImage const& image) {
 			if (key.empty())
 				return;
 			if (registered_paths.find(key) != registered_paths.end())
 				return;
-			if (api.ass_set_tag_image_rgba(ass_renderer, key.c_str(), format,
-				width, height, stride, rgba) >= 0) {
+			auto const& pixels = *image.pixels;
+			if (api.ass_set_tag_image_rgba(ass_renderer, key.c_str(), image.format,
+				pixels.width, pixels.height, pixels.stride, pixels.rgba.data()) >= 0) {
 				registered_paths.insert(key);
 			}
 		};
-		auto register_path_variants = [&](std::string const& key, ASS_TagImageFormat format,
-			int width, int height, int stride, const unsigned char *rgba) {
+		auto register_path_variants = [&](std::string const& key, TagImage const& image) {
 			std::string clean = strip_matching_quotes(key);
 			if (clean.empty())
 				return;
-			register_key(clean, format, width, height, stride, rgba);
-			register_key(add_double_quotes(clean), format, width, height, stride, rgba);
+			register_key(clean, image);
+			register_key(add_double_quotes(clean), image);
 		};
 
 		std::unordered_map<std::string, const TagImage *> attachment_by_name;
 		for (auto const& image : attachment_tag_images) {
 			attachment_by_name.emplace(image.basename_lower, &image);
-			register_path_variants(image.key, image.format,
-				image.width, image.height, image.stride, image.rgba.data());
+			register_path_variants(image.key, image);
 		}
 
+		// Find the files which exist first so that the ones which aren't in
+		// the cache can all be decoded at once
+		std::vector<std::string> paths;
+		std::vector<TagImage> files;
+		std::vector<wxString> filenames;
+		std::vector<std::string> keys;
 		for (auto const& raw_path : tag_image_paths) {
 			std::string path = strip_matching_quotes(raw_path);
 			if (path.empty())
 				continue;
 
-			ASS_TagImageFormat format;
-			if (!parse_tag_image_format(path, &format))
+			TagImage file;
+			if (!parse_tag_image_format(path, &file.format))
 				continue;
 
-			bool absolute_path = path_is_absolute(path);
-
-			auto file_it = file_tag_image_cache.find(path);
-			if (file_it == file_tag_image_cache.end()) {
-				TagImage file_image;
-				std::string resolved_file_path;
-				if (decode_file_image(path, tag_image_script_dir, &file_image, &resolved_file_path)) {
-					file_image.key = resolved_file_path.empty() ? path : resolved_file_path;
-					file_it = file_tag_image_cache.emplace(path, std::move(file_image)).first;
-				}
+			wxString filename = resolve_file_image(path, tag_image_script_dir);
+			if (!filename.empty()) {
+				file.key = wx_to_utf8_copy(filename);
+				file.basename_lower = to_lower_copy(path_basename(path));
+				keys.push_back(file_image_cache_key(filename));
+				filenames.push_back(filename);
 			}
-			if (file_it != file_tag_image_cache.end()) {
-				auto const& image = file_it->second;
-				if (image.format == format) {
-					register_path_variants(path, image.format,
-						image.width, image.height, image.stride, image.rgba.data());
-					register_path_variants(image.key, image.format,
-						image.width, image.height, image.stride, image.rgba.data());
-					continue;
-				}
+			paths.push_back(std::move(path));
+			files.push_back(std::move(file));
+		}
+
+		auto pixels = load_tag_images(keys, [&](size_t i) {
+			return decode_file_image(filenames[i]);
+		});
+		for (size_t i = 0, j = 0; i < files.size(); ++i) {
+			auto& file = files[i];
+			if (!file.key.empty() && (file.pixels = std::move(pixels[j++]))) {
+				register_path_variants(paths[i], file);
+				register_path_variants(file.key, file);
+				continue;
 			}
 
-			if (absolute_path)
+			if (path_is_absolute(paths[i]))
 				continue;
 
-			std::string base = to_lower_copy(path_basename(path));
+			std::string base = to_lower_copy(path_basename(paths[i]));
 			auto attachment_it = attachment_by_name.find(base);
 			if (attachment_it == attachment_by_name.end())
 				continue;
 
 			auto const& image = *attachment_it->second;
-			if (image.format != format)
+			if (image.format != file.format)
 				continue;
-			register_path_variants(path, image.format,
-				image.width, image.height, image.stride, image.rgba.data());
-			register_path_variants(image.key, image.format,
-				image.width, image.height, image.stride, image.rgba.data());
+			register_path_variants(paths[i], image);
+			register_path_variants(image.key, image);
 		}
 
 		tag_images_dirty = false;
@@ -833,6 +989,10 @@ class LibassModSubtitlesProvider final : public SubtitlesProvider {
 		return shared->renderer;
 	}
 
+	// Fonts are added to the ASS_Library, not the track
+	bool KeepsEmbeddedFonts() const override { return true; }
+	bool AddEmbeddedFont(AssAttachment const& font) override { return add_embedded_font(font); }
+
 public:
 	LibassModSubtitlesProvider(agi::BackgroundRunner *br);
 	~LibassModSubtitlesProvider();
@@ -841,13 +1001,11 @@ public:
 		if (ass_track) api.ass_free_track(ass_track);
 		ass_track = api.ass_read_memory(library, const_cast<char *>(data), len, nullptr);
 		if (!ass_track) throw agi::InternalError("libassmod failed to load subtitles.");
-#ifdef LIBASSMOD_FEATURE_TAG_IMAGE
-		tag_image_paths = collect_img_paths(data, len);
-		tag_images_dirty = true;
-#endif
 	}
 
 	void DrawSubtitles(VideoFrame &dst, double time) override;
+	bool CanDrawOverlay() const override { return true; }
+	bool DrawOverlay(SubtitlesOverlay &dst, int width, int height, double time) override;
 
 	void Reinitialize() override {
 		// No need to reinit if we're not even done with the initial init
@@ -855,9 +1013,8 @@ public:
 			return;
 
 		api.ass_renderer_done(shared->renderer);
-		shared->renderer = api.ass_renderer_init(library);
-		api.ass_set_font_scale(shared->renderer, 1.);
-		api.ass_set_fonts(shared->renderer, nullptr, "Sans", 1, nullptr, true);
+		shared->renderer = new_renderer();
+		overlay_current = false;
 #ifdef LIBASSMOD_FEATURE_TAG_IMAGE
 		tag_images_dirty = true;
 #endif
@@ -872,15 +1029,17 @@ LibassModSubtitlesProvider::LibassModSubtitlesProvider(agi::BackgroundRunner *br
 	if (!EnsureLibassMod(&error))
 		throw agi::InternalError("libassmod unavailable: " + error);
 
+	if (auto ass_renderer = take_idle_renderer()) {
+		shared->renderer = ass_renderer;
+		shared->ready = true;
+		return;
+	}
+
 	EnsureCacheQueue();
 	auto state = shared;
 	cache_queue->Async([state] {
-		auto ass_renderer = api.ass_renderer_init(library);
-		if (ass_renderer) {
-			api.ass_set_font_scale(ass_renderer, 1.);
-			api.ass_set_fonts(ass_renderer, nullptr, "Sans", 1, nullptr, true);
-		}
-		state->renderer = ass_renderer;
+		auto ass_renderer = take_idle_renderer();
+		state->renderer = ass_renderer ? ass_renderer : new_renderer();
 		state->ready = true;
 	});
 }
@@ -889,15 +1048,24 @@ LibassModSubtitlesProvider::~LibassModSubtitlesProvider() {
 	if (ass_track) api.ass_free_track(ass_track);
 }
 
-#define _r(c) ((c)>>24)
-#define _g(c) (((c)>>16)&0xFF)
-#define _b(c) (((c)>>8)&0xFF)
-#define _a(c) ((c)&0xFF)
+std::vector<agi::BlendImage> ToBlendImages(ASS_RenderResult const& result) {
+	std::vector<agi::BlendImage> images;
+	if (result.use_rgba && result.imgs_rgba) {
+		for (ASS_ImageRGBA *img = result.imgs_rgba; img; img = img->next)
+			images.push_back({agi::BlendImage::PremultipliedRGBA, img->rgba, img->stride, img->dst_x, img->dst_y, img->w, img->h, 0});
+	}
+	else {
+		for (ASS_Image *img = result.imgs; img; img = img->next)
+			images.push_back({agi::BlendImage::Mask, img->bitmap, img->stride, img->dst_x, img->dst_y, img->w, img->h, img->color});
+	}
+	return images;
+}
 
 void LibassModSubtitlesProvider::DrawSubtitles(VideoFrame &frame, double time) {
 	ASS_Renderer *ass_renderer = renderer();
 	if (!ass_renderer || !ass_track)
 		return;
+	overlay_current = false;
 #ifdef LIBASSMOD_FEATURE_TAG_IMAGE
 	RegisterTagImages();
 #endif
@@ -911,56 +1079,43 @@ void LibassModSubtitlesProvider::DrawSubtitles(VideoFrame &frame, double time) {
 
 	// libassmod returns either premultiplied RGBA images or the legacy alpha-masked monochrome list.
 	// Blend whichever list is preferred by the renderer into the frame.
+	agi::BlendImages(frame.PixelAt(0, 0), frame.RowStep(), frame.height, ToBlendImages(render_result), false);
 
-	using namespace boost::gil;
-	auto dst = interleaved_view(frame.width, frame.height, (bgra8_pixel_t*)frame.data.data(), frame.width * 4);
-	if (frame.flipped)
-		dst = flipped_up_down_view(dst);
-
-	if (render_result.use_rgba && render_result.imgs_rgba) {
-		for (ASS_ImageRGBA *img = render_result.imgs_rgba; img; img = img->next) {
-			auto srcview = interleaved_view(img->w, img->h, (rgba8_pixel_t*)img->rgba, img->stride);
-			auto dstview = subimage_view(dst, img->dst_x, img->dst_y, img->w, img->h);
-
-			transform_pixels(dstview, srcview, dstview, [](const bgra8_pixel_t frame_px, const rgba8_pixel_t src_px) -> bgra8_pixel_t {
-				unsigned int alpha = src_px[3];
-				unsigned int inv_alpha = 255 - alpha;
-
-				bgra8_pixel_t ret;
-				ret[0] = static_cast<unsigned char>(src_px[2] + (frame_px[0] * inv_alpha) / 255);
-				ret[1] = static_cast<unsigned char>(src_px[1] + (frame_px[1] * inv_alpha) / 255);
-				ret[2] = static_cast<unsigned char>(src_px[0] + (frame_px[2] * inv_alpha) / 255);
-				ret[3] = 0;
-				return ret;
-			});
-		}
-	}
-	else {
-		for (ASS_Image *img = render_result.imgs; img; img = img->next) {
-			unsigned int opacity = 255 - ((unsigned int)_a(img->color));
-			unsigned int r = (unsigned int)_r(img->color);
-			unsigned int g = (unsigned int)_g(img->color);
-			unsigned int b = (unsigned int)_b(img->color);
-
-			auto srcview = interleaved_view(img->w, img->h, (gray8_pixel_t*)img->bitmap, img->stride);
-			auto dstview = subimage_view(dst, img->dst_x, img->dst_y, img->w, img->h);
-
-			transform_pixels(dstview, srcview, dstview, [=](const bgra8_pixel_t frame_px, const gray8_pixel_t src_px) -> bgra8_pixel_t {
-				unsigned int k = ((unsigned)src_px) * opacity / 255;
-				unsigned int ck = 255 - k;
-
-				bgra8_pixel_t ret;
-				ret[0] = (k * b + ck * frame_px[0]) / 255;
-				ret[1] = (k * g + ck * frame_px[1]) / 255;
-				ret[2] = (k * r + ck * frame_px[2]) / 255;
-				ret[3] = 0;
-				return ret;
-			});
-		}
+	if (render_result.imgs_rgba)
+		api.ass_free_images_rgba(render_result.imgs_rgba);
+}
+
+bool LibassModSubtitlesProvider::DrawOverlay(SubtitlesOverlay &dst, int width, int height, double time) {
+	ASS_Renderer *ass_renderer = renderer();
+	if (!ass_renderer || !ass_track) {
+		dst.Reset(0, 0, 0, 0);
+		overlay_current = false;
+		return true;
 	}
+#ifdef LIBASSMOD_FEATURE_TAG_IMAGE
+	// Registering images invalidates libassmod's idea of the last frame
+	if (tag_images_dirty)
+		overlay_current = false;
+	RegisterTagImages();
+#endif
+
+	api.ass_set_frame_size(ass_renderer, width, height);
+	api.ass_set_storage_size(ass_renderer, width, height);
+
+	int detect_change = 0;
+	ASS_RenderResult render_result = api.ass_render_frame_auto(ass_renderer, ass_track, int(time * 1000), &detect_change);
+
+	// libassmod compares against whatever it rendered last, which is only
+	// the overlay the caller has if nothing else was drawn in between
+	const bool changed = detect_change || !overlay_current;
+	overlay_current = true;
+
+	if (changed)
+		dst.Render(ToBlendImages(render_result));
 
 	if (render_result.imgs_rgba)
 		api.ass_free_images_rgba(render_result.imgs_rgba);
+	return changed;
 }
 }
 
@@ -984,20 +1139,31 @@ std::string PrimaryLibraryName() {
 }
 
 void CacheFonts() {
-	std::string error;
-	if (!EnsureLibassMod(&error)) {
-		LOG_I("subtitle/provider/libassmod") << "libassmod unavailable: " << error;
-		return;
-	}
-
 	EnsureCacheQueue();
 
+	// Loading the library is done on the cache thread too so that startup
+	// doesn't wait on it; anything which needs it blocks in EnsureLibassMod
+	// until it's finished
 	cache_queue->Async([] {
-		auto ass_renderer = api.ass_renderer_init(library);
-		if (!ass_renderer)
+		std::string error;
+		if (!EnsureLibassMod(&error)) {
+			LOG_I("subtitle/provider/libassmod") << "libassmod unavailable: " << error;
+			set_fonts_cached();
 			return;
-		api.ass_set_fonts(ass_renderer, nullptr, "Sans", 1, nullptr, true);
-		api.ass_renderer_done(ass_renderer);
+		}
+
+		// Keep the renderer used to warm up the font cache for the first
+		// provider
+		if (auto ass_renderer = new_renderer())
+			release_renderer(ass_renderer);
+		set_fonts_cached();
 	});
 }
+
+bool WhenFontsCached(std::function<void ()> callback) {
+	std::lock_guard<std::mutex> lock(fonts_cached_mutex);
+	if (fonts_cached || !cache_queue) return false;
+	fonts_cached_callbacks.push_back(std::move(callback));
+	return true;
+}
 }
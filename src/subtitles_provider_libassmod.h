@@ -14,6 +14,7 @@
 //
 // Aegisub Project http://www.aegisub.org/
 
+#include <functional>
 #include <memory>
 #include <string>
 
@@ -23,6 +24,9 @@ namespace agi { class BackgroundRunner; }
 namespace libassmod {
 	std::unique_ptr<SubtitlesProvider> Create(std::string const&, agi::BackgroundRunner *br);
 	void CacheFonts();
+	/// Call a function on the main thread once CacheFonts() has finished
+	/// @return false without calling it if the fonts are already cached
+	bool WhenFontsCached(std::function<void ()> callback);
 	bool IsAvailable(std::string *error = nullptr);
 	std::string PrimaryLibraryName();
 }
@@ -19,27 +19,65 @@
 #include <libaegisub/file_mapping.h>
 #include <libaegisub/make_unique.h>
 
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/predicate.hpp>
-#include <boost/algorithm/string/trim.hpp>
 #include <boost/interprocess/streams/bufferstream.hpp>
+#include <cstring>
 
 TextFileReader::TextFileReader(agi::fs::path const& filename, std::string encoding, bool trim)
 : file(agi::make_unique<agi::read_file_mapping>(filename))
-, stream(agi::make_unique<boost::interprocess::ibufferstream>(file->read(), file->size()))
 , trim(trim)
-, iter(agi::line_iterator<std::string>(*stream, encoding))
 {
+	boost::to_lower(encoding);
+	// ASCII is a subset of UTF-8, so neither needs converting and the lines
+	// can be handed out straight from the mapped file
+	direct = encoding == "utf-8" || encoding == "ascii" || encoding == "us-ascii";
+	if (direct) {
+		direct_more = true;
+		cur = file->size() ? file->read() : nullptr;
+		end = cur + file->size();
+	}
+	else {
+		stream = agi::make_unique<boost::interprocess::ibufferstream>(file->read(), file->size());
+		iter = agi::line_iterator<std::string>(*stream, encoding);
+	}
 }
 
 TextFileReader::~TextFileReader() {
 }
 
-std::string TextFileReader::ReadLineFromFile() {
-	std::string str = *iter;
-	++iter;
-	if (trim)
-		boost::trim(str);
+std::string_view TextFileReader::ReadLineView() {
+	std::string_view str;
+	if (direct) {
+		// Split the same way as std::getline does for the converting reader,
+		// including yielding an empty final line after a trailing newline
+		auto newline = cur != end ? static_cast<const char *>(memchr(cur, '\n', end - cur)) : nullptr;
+		if (newline) {
+			str = std::string_view(cur, newline - cur);
+			cur = newline + 1;
+		}
+		else {
+			str = std::string_view(cur, end - cur);
+			direct_more = false;
+		}
+		if (!str.empty() && str.back() == '\r')
+			str.remove_suffix(1);
+	}
+	else {
+		line_buffer = *iter;
+		++iter;
+		str = line_buffer;
+	}
+
+	if (trim) {
+		auto is_space = boost::is_space();
+		while (!str.empty() && is_space(str.front()))
+			str.remove_prefix(1);
+		while (!str.empty() && is_space(str.back()))
+			str.remove_suffix(1);
+	}
 	if (boost::starts_with(str, "\xEF\xBB\xBF"))
-		str.erase(0, 3);
+		str.remove_prefix(3);
 	return str;
 }
@@ -17,6 +17,7 @@
 #include <iosfwd>
 #include <memory>
 #include <string>
+#include <string_view>
 
 #include <libaegisub/fs_fwd.h>
 #include <libaegisub/line_iterator.h>
@@ -31,6 +32,17 @@ class TextFileReader {
 	bool trim;
 	agi::line_iterator<std::string> iter;
 
+	/// Is the file UTF-8, so lines can be read directly from the mapping?
+	bool direct = false;
+	/// Are there any more lines to read from the mapping?
+	bool direct_more = false;
+	/// Start of the next line in the mapping
+	const char *cur = nullptr;
+	/// End of the mapping
+	const char *end = nullptr;
+	/// Converted line from iter which ReadLineView()'s result points into
+	std::string line_buffer;
+
 public:
 	/// @brief Constructor
 	/// @param filename File to open
@@ -42,7 +54,11 @@ public:
 
 	/// @brief Read a line from the file
 	/// @return The line, possibly trimmed
-	std::string ReadLineFromFile();
+	std::string ReadLineFromFile() { return std::string(ReadLineView()); }
+	/// @brief Read a line from the file without copying it
+	/// @return The line, possibly trimmed, which is valid until the next line
+	///         is read or the reader is destroyed
+	std::string_view ReadLineView();
 	/// @brief Check if there are any more lines to read
-	bool HasMoreLines() const { return iter != agi::line_iterator<std::string>(); }
+	bool HasMoreLines() const { return direct ? direct_more : iter != agi::line_iterator<std::string>(); }
 };
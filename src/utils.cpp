@@ -37,10 +37,12 @@
 #include <libaegisub/dispatch.h>
 #include <libaegisub/fs.h>
 #include <libaegisub/log.h>
+#include <libaegisub/path.h>
 
 #ifdef __UNIX__
 #include <unistd.h>
 #endif
+#include <boost/crc.hpp>
 #include <boost/filesystem/path.hpp>
 #include <map>
 #include <unicode/locid.h>
@@ -156,10 +158,17 @@ void SetClipboard(wxBitmap const& new_data) {
 	}
 }
 
+agi::fs::path GetVideoCacheFilename(agi::fs::path const& video, std::string const& extension) {
+	boost::crc_32_type hash;
+	hash.process_bytes(video.string().c_str(), video.string().size());
+
+	return config::path->Decode("?local/ffms2cache/" + std::to_string(hash.checksum()) + "_" + std::to_string(agi::fs::Size(video)) + "_" + std::to_string(agi::fs::ModifiedTime(video)) + extension);
+}
+
 void CleanCache(agi::fs::path const& directory, std::string const& file_type, uint64_t max_size, uint64_t max_files) {
 	static std::unique_ptr<agi::dispatch::Queue> queue;
 	if (!queue)
-		queue = agi::dispatch::Create();
+		queue = agi::dispatch::Create(agi::dispatch::Priority::Bulk);
 
 	max_size <<= 20;
 	if (max_files == 0)
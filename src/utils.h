@@ -70,6 +70,12 @@ void SetFloatOnParent(wxWindow *window);
 /// @return Should the calling code process the event?
 bool ForwardMouseWheelEvent(wxWindow *source, wxMouseEvent &evt);
 
+/// Get the name of a file in the video cache directory for data derived from
+/// the given video, which changes whenever the video itself does
+/// @param video Path to the video
+/// @param extension Extension for the cache file, including the dot
+agi::fs::path GetVideoCacheFilename(agi::fs::path const& video, std::string const& extension);
+
 /// Clean up the given cache directory, limiting the size to max_size
 /// @param directory Directory to clean
 /// @param file_type Wildcard pattern for files to clean up
@@ -0,0 +1,131 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include "video_benchmark.h"
+
+#include "include/aegisub/video_provider.h"
+#include "video_frame.h"
+#include "video_provider_manager.h"
+
+#include <libaegisub/background_runner.h>
+#include <libaegisub/cajun/elements.h>
+#include <libaegisub/cajun/writer.h>
+#include <libaegisub/format.h>
+#include <libaegisub/frame_access.h>
+#include <libaegisub/log.h>
+#include <libaegisub/vfr.h>
+
+#include <boost/filesystem/path.hpp>
+#include <chrono>
+
+namespace {
+/// Number of frames requested for each pattern
+const size_t frames_per_pattern = 200;
+
+using steady_clock = std::chrono::steady_clock;
+
+double MillisecondsSince(steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(steady_clock::now() - start).count();
+}
+
+json::Object StatsToJson(agi::frame_access::LatencyStats const& stats) {
+	json::Object obj;
+	obj["frames"] = static_cast<json::Integer>(stats.count);
+	obj["total_ms"] = stats.total_ms;
+	obj["mean_ms"] = stats.mean_ms;
+	obj["p50_ms"] = stats.p50_ms;
+	obj["p90_ms"] = stats.p90_ms;
+	obj["p99_ms"] = stats.p99_ms;
+	obj["max_ms"] = stats.max_ms;
+	obj["fps"] = stats.fps;
+	return obj;
+}
+
+json::Object Benchmark(std::string const& name, agi::fs::path const& video, agi::BackgroundRunner *br) {
+	json::Object result;
+	result["provider"] = name;
+
+	std::unique_ptr<VideoProvider> provider;
+	try {
+		auto start = steady_clock::now();
+		provider = VideoProviderFactory::CreateProvider(name, video, "", true, br);
+		result["open_ms"] = MillisecondsSince(start);
+	}
+	catch (VideoProviderError const& e) {
+		result["error"] = e.GetMessage();
+		return result;
+	}
+	catch (agi::vfr::Error const& e) {
+		result["error"] = e.GetMessage();
+		return result;
+	}
+	if (!provider) {
+		result["error"] = std::string("No such provider");
+		return result;
+	}
+
+	result["decoder"] = provider->GetDecoderName();
+	result["frame_count"] = static_cast<json::Integer>(provider->GetFrameCount());
+	result["width"] = static_cast<json::Integer>(provider->GetWidth());
+	result["height"] = static_cast<json::Integer>(provider->GetHeight());
+
+	json::Object patterns;
+	br->Run([&](agi::ProgressSink *ps) {
+		ps->SetTitle(agi::format("Benchmarking %s", name));
+		const auto keyframes = provider->GetKeyFrames();
+		VideoFrame frame;
+		int done = 0;
+
+		for (auto pattern : agi::frame_access::AllPatterns) {
+			ps->SetMessage(agi::frame_access::PatternName(pattern));
+			auto frames = agi::frame_access::Generate(pattern, provider->GetFrameCount(), keyframes, frames_per_pattern);
+
+			std::vector<double> latencies;
+			latencies.reserve(frames.size());
+			try {
+				for (int n : frames) {
+					if (ps->IsCancelled()) return;
+					auto start = steady_clock::now();
+					provider->GetFrame(n, frame);
+					latencies.push_back(MillisecondsSince(start));
+				}
+				patterns[agi::frame_access::PatternName(pattern)] = StatsToJson(agi::frame_access::Summarize(latencies));
+			}
+			catch (VideoProviderError const& e) {
+				json::Object error;
+				error["error"] = e.GetMessage();
+				patterns[agi::frame_access::PatternName(pattern)] = std::move(error);
+			}
+			ps->SetProgress(++done, std::size(agi::frame_access::AllPatterns));
+		}
+	});
+	result["patterns"] = std::move(patterns);
+
+	LOG_I("video/benchmark") << name << ": finished " << video;
+	return result;
+}
+}
+
+void BenchmarkVideoProviders(agi::fs::path const& video, std::vector<std::string> const& providers, std::ostream& out, agi::BackgroundRunner *br) {
+	json::Array results;
+	for (auto const& name : providers)
+		results.push_back(Benchmark(name, video, br));
+
+	json::Object root;
+	root["file"] = video.string();
+	root["frames_per_pattern"] = static_cast<json::Integer>(frames_per_pattern);
+	root["providers"] = std::move(results);
+	agi::JsonWriter::Write(root, out);
+}
@@ -0,0 +1,39 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file video_benchmark.h
+/// @brief Timing of video providers with standard access patterns
+
+#pragma once
+
+#include <libaegisub/fs_fwd.h>
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace agi { class BackgroundRunner; }
+
+/// @brief Time how quickly each of the given providers can serve frames from a file
+/// @param video     File to open
+/// @param providers Names of the video providers to try
+/// @param out       Stream to write the results to as JSON
+/// @param br        Used to show progress, both while opening the file and
+///                  while timing
+///
+/// Each provider opens the file itself, without the frame cache, and is
+/// run through each of the patterns in agi::frame_access. Providers which
+/// can't open the file are listed in the results with the error.
+void BenchmarkVideoProviders(agi::fs::path const& video, std::vector<std::string> const& providers, std::ostream& out, agi::BackgroundRunner *br);
@@ -33,20 +33,30 @@
 #include "ass_file.h"
 #include "audio_controller.h"
 #include "compat.h"
+#include "dialog_progress.h"
 #include "include/aegisub/context.h"
 #include "options.h"
 #include "project.h"
 #include "selection_controller.h"
+#include "subs_controller.h"
 #include "time_range.h"
 #include "async_video_provider.h"
 #include "utils.h"
 #include "video_frame.h"
 
 #include <libaegisub/ass/time.h>
+#include <libaegisub/log.h>
+#include <libaegisub/trace.h>
 
+#include <algorithm>
 #include <cmath>
 #include <wx/log.h>
 
+namespace {
+/// Longest range to prerender without showing a progress dialog
+const size_t prerender_progress_frames = 24;
+}
+
 VideoController::VideoController(agi::Context *c)
 : context(c)
 , playAudioOnStep(OPT_GET("Audio/Plays When Stepping Video"))
@@ -67,9 +77,15 @@ void VideoController::OnNewVideoProvider(AsyncVideoProvider *new_provider) {
 	Stop();
 	provider = new_provider;
 	color_matrix = provider ? provider->GetColorSpace() : "";
+	seek_latency = VideoSeekLatency();
+	// New providers always start out decoding full size frames
+	proxy_divisor = 1;
+	subtitle_divisor = 1;
+	UpdateProxy();
 }
 
 void VideoController::OnSubtitlesCommit(int type, const AssDialogue *changed) {
+	AGI_TRACE_ZONE("commit", "VideoController");
 	if (!provider) return;
 
 	if ((type & AssFile::COMMIT_SCRIPTINFO) || type == AssFile::COMMIT_NEW) {
@@ -81,23 +97,29 @@ void VideoController::OnSubtitlesCommit(int type, const AssDialogue *changed) {
 	}
 
 	if (!changed)
-		provider->LoadSubtitles(context->ass.get());
+		provider->LoadSubtitles(context->subsController->Snapshot());
 	else
-		provider->UpdateSubtitles(context->ass.get(), changed);
+		provider->UpdateSubtitles(changed);
 }
 
 void VideoController::OnActiveLineChanged(AssDialogue *line) {
 	if (line && provider && OPT_GET("Video/Subtitle Sync")->GetBool()) {
 		Stop();
 		JumpToTime(line->Start);
+		PrefetchLineAfter(line);
 	}
 }
 
 void VideoController::RequestFrame() {
+	last_request_time = std::chrono::steady_clock::now();
 	context->ass->Properties.video_position = frame_n;
 	provider->RequestFrame(frame_n, TimeAtFrame(frame_n));
 }
 
+bool VideoController::IsBusy() const {
+	return IsPlaying() || std::chrono::steady_clock::now() - last_request_time < std::chrono::seconds(1);
+}
+
 void VideoController::JumpToFrame(int n) {
 	if (!provider) return;
 
@@ -125,8 +147,7 @@ void VideoController::JumpToFrame(int n) {
 		audio_playback_end_ms = previous_audio_end_ms;
 		context->audioController->PlayRange(TimeRange(start_ms, audio_playback_end_ms), playback_speed);
 
-		playback_start_time = std::chrono::steady_clock::now();
-		playback.Start(10);
+		StartPlayback();
 		return;
 	}
 
@@ -137,6 +158,16 @@ void VideoController::JumpToTime(int ms, agi::vfr::Time end) {
 	JumpToFrame(FrameAtTime(ms, end));
 }
 
+void VideoController::PrefetchLineAfter(AssDialogue *line) {
+	if (!provider || !line) return;
+
+	auto next = context->ass->iterator_to(*line);
+	if (++next == context->ass->Events.end()) return;
+
+	const int frame = mid(0, FrameAtTime(next->Start, agi::vfr::START), provider->GetFrameCount() - 1);
+	provider->PrefetchFrame(frame, TimeAtFrame(frame));
+}
+
 void VideoController::NextFrame() {
 	if (!provider || IsPlaying() || frame_n == provider->GetFrameCount())
 		return;
@@ -155,6 +186,33 @@ void VideoController::PrevFrame() {
 		context->audioController->PlayRange(TimeRange(TimeAtFrame(frame_n), TimeAtFrame(frame_n + 1)));
 }
 
+void VideoController::SetScrubbing(bool value) {
+	if (value == scrubbing) return;
+	scrubbing = value;
+	UpdateProxy();
+}
+
+void VideoController::UpdateProxy() {
+	if (!provider) return;
+
+	int divisor = 1;
+	if (OPT_GET("Video/Scrub Proxy/Enabled")->GetBool() && (scrubbing || (IsPlaying() && playback_speed > 1.0)))
+		divisor = OPT_GET("Video/Scrub Proxy/Divisor")->GetInt();
+	// Only a preview trade-off, so stepping and pausing are always full quality
+	const int subs_divisor = IsPlaying() && OPT_GET("Video/Reduced Playback Subtitles")->GetBool() ? 2 : 1;
+	if (divisor == proxy_divisor && subs_divisor == subtitle_divisor) return;
+
+	if (divisor != proxy_divisor)
+		provider->SetProxyScale(divisor);
+	if (subs_divisor != subtitle_divisor)
+		provider->SetSubtitleScale(subs_divisor);
+	proxy_divisor = divisor;
+	subtitle_divisor = subs_divisor;
+	// Replace the last proxy frame with a full size one
+	if (divisor == 1 && subs_divisor == 1 && !IsPlaying())
+		RequestFrame();
+}
+
 void VideoController::Play() {
 	if (IsPlaying()) {
 		Stop();
@@ -169,8 +227,8 @@ void VideoController::Play() {
 	audio_playback_mode = AudioPlaybackMode::ToEnd;
 	context->audioController->PlayToEnd(start_ms, playback_speed);
 
-	playback_start_time = std::chrono::steady_clock::now();
-	playback.Start(10);
+	StartPlayback();
+	UpdateProxy();
 }
 
 void VideoController::PlayLine() {
@@ -184,42 +242,122 @@ void VideoController::PlayLine() {
 	start_ms = TimeAtFrame(startFrame);
 	end_frame = FrameAtTime(context->selectionController->GetActiveLine()->End, agi::vfr::END) + 1;
 
+	if (provider && OPT_GET("Video/Prerender Play Line")->GetBool() && !PrerenderRange(startFrame, end_frame))
+		return;
+
 	audio_playback_mode = AudioPlaybackMode::Range;
 	audio_playback_end_ms = curline->End;
 	context->audioController->PlayRange(TimeRange(start_ms, curline->End), playback_speed);
 
 	JumpToFrame(startFrame);
 
-	playback_start_time = std::chrono::steady_clock::now();
-	playback.Start(10);
+	StartPlayback();
+	UpdateProxy();
+}
+
+bool VideoController::PrerenderRange(int first, int end) {
+	std::vector<AsyncVideoProvider::PrerenderFrame> frames;
+	for (int frame = first; frame < end; ++frame)
+		frames.emplace_back(frame, TimeAtFrame(frame));
+	if (provider->IsPrerendered(frames))
+		return true;
+
+	// Short ranges are usually done before a dialog could even be read
+	if (frames.size() <= prerender_progress_frames)
+		return provider->Prerender(frames, nullptr);
+
+	bool finished = false;
+	try {
+		DialogProgress progress(context->parent, _("Play line"), _("Rendering the line's frames before playing it"));
+		progress.Run([&](agi::ProgressSink *ps) {
+			finished = provider->Prerender(frames, ps);
+		});
+	}
+	catch (agi::UserCancelException const&) {
+		return false;
+	}
+	return finished;
+}
+
+void VideoController::StartPlayback() {
+	double speed = playback_speed;
+	if (!std::isfinite(speed) || speed <= 0.0)
+		speed = 1.0;
+
+	play_clock = agi::PlaybackClock(start_ms, speed, std::chrono::steady_clock::now());
+	play_stats = agi::PlaybackStats();
+	playing = true;
+	SchedulePlayTimer();
+}
+
+void VideoController::SchedulePlayTimer() {
+	using namespace std::chrono;
+	auto due = play_clock.WallTime(TimeAtFrame(frame_n));
+	auto delay = duration_cast<milliseconds>(due - steady_clock::now()).count();
+	playback.Start(std::max<int>(1, static_cast<int>(delay)), wxTIMER_ONE_SHOT);
 }
 
 void VideoController::Stop() {
 	if (IsPlaying()) {
+		playing = false;
 		playback.Stop();
+		LOG_D("video/playback") << "Presented " << play_stats.presented << " frames; "
+			<< play_stats.dropped << " dropped, " << play_stats.late << " late";
 		audio_playback_mode = AudioPlaybackMode::NoAudio;
 		context->audioController->Stop();
+		UpdateProxy();
 	}
 }
 
 void VideoController::OnPlayTimer(wxTimerEvent &) {
-	using namespace std::chrono;
-	double speed = playback_speed;
-	if (!std::isfinite(speed) || speed <= 0.0)
-		speed = 1.0;
+	if (!playing) return;
 
-	auto elapsed_ms = duration_cast<milliseconds>(steady_clock::now() - playback_start_time).count();
-	auto target_ms = static_cast<int64_t>(start_ms) + static_cast<int64_t>(std::llround(elapsed_ms * speed));
-	int next_frame = FrameAtTime(static_cast<int>(target_ms));
-	if (next_frame == frame_n) return;
+	// The timer fires when the last requested frame becomes due, and the one
+	// after it is requested now so that it has a full frame to be decoded
+	const auto now = std::chrono::steady_clock::now();
+	const int due_frame = FrameAtTime(static_cast<int>(play_clock.MediaTime(now)));
+	const int next_frame = std::max(due_frame, frame_n) + 1;
 
-	if (next_frame >= end_frame)
+	if (next_frame >= end_frame) {
 		Stop();
-	else {
-		frame_n = next_frame;
-		RequestFrame();
-		Seek(frame_n);
+		return;
 	}
+
+	// Anything between what was last requested and what's wanted now will
+	// never be shown because decoding fell behind
+	if (next_frame > frame_n + 1)
+		play_stats.dropped += next_frame - frame_n - 1;
+
+	frame_n = next_frame;
+	RequestFrame();
+	Seek(frame_n);
+	SchedulePlayTimer();
+}
+
+int VideoController::TimeUntilPresentation(double time) const {
+	if (!playing) return 0;
+	using namespace std::chrono;
+	auto due = play_clock.WallTime(static_cast<int64_t>(time));
+	return std::max<int>(0, static_cast<int>(duration_cast<milliseconds>(due - steady_clock::now()).count()));
+}
+
+void VideoController::FramePresented(double time, std::chrono::steady_clock::time_point requested) {
+	if (!playing) {
+		// Seeking and scrubbing, where each frame is shown as soon as it's
+		// ready and every bit of this is waiting on the decoder
+		using namespace std::chrono;
+		const double ms = duration<double, std::milli>(steady_clock::now() - requested).count();
+		++seek_latency.frames;
+		seek_latency.total_ms += ms;
+		seek_latency.max_ms = std::max(seek_latency.max_ms, ms);
+		return;
+	}
+	++play_stats.presented;
+
+	// Late means the next frame should already be showing
+	const int frame = FrameAtTime(static_cast<int>(time));
+	if (std::chrono::steady_clock::now() > play_clock.WallTime(TimeAtFrame(frame + 1)))
+		++play_stats.late;
 }
 
 void VideoController::OnPlaybackSpeedChanged(double new_speed) {
@@ -232,15 +370,11 @@ void VideoController::OnPlaybackSpeedChanged(double new_speed) {
 		return;
 	}
 
-	using namespace std::chrono;
-	auto now = steady_clock::now();
-	auto elapsed_ms = duration_cast<milliseconds>(now - playback_start_time).count();
-	auto cur_ms = static_cast<int64_t>(start_ms) + static_cast<int64_t>(std::llround(elapsed_ms * playback_speed));
-
-	start_ms = static_cast<int>(cur_ms);
-	playback_start_time = now;
+	play_clock.SetSpeed(new_speed, std::chrono::steady_clock::now());
+	start_ms = static_cast<int>(play_clock.MediaTime(std::chrono::steady_clock::now()));
 	playback_speed = new_speed;
 	PlaybackSpeedChanged(new_speed);
+	UpdateProxy();
 
 	switch (audio_playback_mode) {
 		case AudioPlaybackMode::NoAudio:
@@ -300,7 +434,7 @@ int VideoController::FrameAtTime(int time, agi::vfr::Time type) const {
 	return context->project->Timecodes().FrameAtTime(time, type);
 }
 
-std::shared_ptr<VideoFrame> VideoController::GetFrame(int frame, bool raw) const {
+std::shared_ptr<const VideoFrame> VideoController::GetFrame(int frame, bool raw) const {
 	double timestamp = TimeAtFrame(frame, agi::vfr::EXACT);
 	return provider->GetFrame(frame, timestamp, raw);
 }
@@ -27,6 +27,7 @@
 //
 // Aegisub Project http://www.aegisub.org/
 
+#include <libaegisub/playback_clock.h>
 #include <libaegisub/signal.h>
 #include <libaegisub/vfr.h>
 
@@ -54,6 +55,13 @@ enum class AspectRatio {
 	Custom
 };
 
+/// Time between requesting frames and showing them
+struct VideoSeekLatency {
+	uint64_t frames = 0;
+	double total_ms = 0;
+	double max_ms = 0;
+};
+
 /// Manage stuff related to video playback
 class VideoController final : public wxEvtHandler {
 	/// Current frame number changed (new frame number)
@@ -72,12 +80,26 @@ class VideoController final : public wxEvtHandler {
 	/// Last seen script color matrix
 	std::string color_matrix;
 
-	/// Playback timer used to periodically check if we should go to the next
-	/// frame while playing video
+	/// One-shot timer which fires when each frame is due while playing
 	wxTimer playback;
-
-	/// Time when playback was last started
-	std::chrono::steady_clock::time_point playback_start_time;
+	/// Is video currently playing?
+	bool playing = false;
+
+	/// Media time being played at each wall clock time while playing
+	agi::PlaybackClock play_clock;
+	/// Presentation counts for the current or last playback
+	agi::PlaybackStats play_stats;
+	VideoSeekLatency seek_latency;
+	/// Schedule the next playback tick for when frame_n becomes due
+	void SchedulePlayTimer();
+	/// Start the playback timer from frame_n at start_ms
+	void StartPlayback();
+	/// @brief Render the frames in [first, end) before playing them
+	/// @return false if the user cancelled
+	bool PrerenderRange(int first, int end);
+
+	/// Time when a frame was last requested from the video provider
+	std::chrono::steady_clock::time_point last_request_time;
 
 	/// The start time of the first frame of the current playback; undefined if
 	/// video is not currently playing
@@ -112,6 +134,15 @@ class VideoController final : public wxEvtHandler {
 	/// Cached option for audio playing when frame stepping
 	const agi::OptionValue* playAudioOnStep;
 
+	/// Is the user dragging the video slider?
+	bool scrubbing = false;
+	/// Divisor the provider was last told to decode at
+	int proxy_divisor = 1;
+	/// Divisor the provider was last told to render subtitles at
+	int subtitle_divisor = 1;
+	/// Switch the provider to or from reduced size frames and subtitles if needed
+	void UpdateProxy();
+
 	std::vector<agi::signal::Connection> connections;
 
 	void OnPlayTimer(wxTimerEvent &event);
@@ -130,7 +161,39 @@ public:
 	VideoController(agi::Context *context);
 
 	/// Is the video currently playing?
-	bool IsPlaying() const { return playback.IsRunning(); }
+	bool IsPlaying() const { return playing; }
+
+	/// @brief Get how long to hold a frame before showing it
+	/// @param time Time of the frame, as reported by the frame ready event
+	/// @return Milliseconds until the frame is due, or 0 to show it now
+	///
+	/// Frames are requested one frame early while playing so that decoding
+	/// has a full frame's worth of time, and should be held until they're due.
+	int TimeUntilPresentation(double time) const;
+
+	/// @brief Record that a frame has been shown
+	/// @param time      Time of the frame, as reported by the frame ready event
+	/// @param requested When the request which produced the frame was made
+	void FramePresented(double time, std::chrono::steady_clock::time_point requested);
+
+	/// Get the presentation counts for the current or last playback
+	agi::PlaybackStats const& GetPlaybackStats() const { return play_stats; }
+
+	/// Get the time from requesting a frame to showing it, for the frames
+	/// shown while not playing since the video was opened
+	VideoSeekLatency const& GetSeekLatency() const { return seek_latency; }
+
+	/// @brief Is the user currently making use of the video?
+	///
+	/// True while playing and for a short while after each seek, so that
+	/// background work on the video provider can stay out of the way.
+	bool IsBusy() const;
+
+	/// @brief Set whether the user is scrubbing through the video
+	///
+	/// Frames are decoded at a reduced size while scrubbing if enabled, and
+	/// the current frame is decoded again at full size once it's done.
+	void SetScrubbing(bool scrubbing);
 
 	/// Get the current frame number
 	int GetFrameN() const { return frame_n; }
@@ -159,6 +222,12 @@ public:
 	/// @param end Type of time
 	void JumpToTime(int ms, agi::vfr::Time end = agi::vfr::START);
 
+	/// @brief Decode and render the frame the line after a line starts on
+	///
+	/// For workflows which step through the lines one at a time, so that
+	/// jumping to the next line doesn't have to wait for it
+	void PrefetchLineAfter(AssDialogue *line);
+
 	/// Starting playing the video
 	void Play();
 	/// Play the next frame then stop
@@ -176,7 +245,7 @@ public:
 
 	int TimeAtFrame(int frame, agi::vfr::Time type = agi::vfr::EXACT) const;
 	int FrameAtTime(int time, agi::vfr::Time type = agi::vfr::EXACT) const;
-	std::shared_ptr<VideoFrame> GetFrame(int frame, bool raw) const;
+	std::shared_ptr<const VideoFrame> GetFrame(int frame, bool raw) const;
 
 	double GetPlaybackSpeed() const { return playback_speed; }
 	void SetPlaybackSpeed(double speed);
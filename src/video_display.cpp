@@ -49,9 +49,11 @@
 #include "utils.h"
 #include "video_out_gl.h"
 #include "video_controller.h"
+#include "video_frame.h"
 #include "visual_tool.h"
 
 #include <libaegisub/make_unique.h>
+#include <libaegisub/trace.h>
 
 #include <algorithm>
 #include <wx/combobox.h>
@@ -78,6 +80,25 @@ public:
 
 #define E(cmd) cmd; if (GLenum err = glGetError()) throw OpenGlException(#cmd, err)
 
+struct VideoDisplay::SharedOutput {
+	/// Context used with every display; they all have the same pixel format
+	std::unique_ptr<wxGLContext> context;
+	std::unique_ptr<VideoOutGL> videoOut;
+	/// Frame currently uploaded to videoOut, if it is exactly the frame
+	/// which was received
+	std::shared_ptr<const VideoFrame> uploaded_frame;
+};
+
+std::shared_ptr<VideoDisplay::SharedOutput> VideoDisplay::GetSharedOutput() {
+	static std::weak_ptr<SharedOutput> shared;
+	auto output = shared.lock();
+	if (!output) {
+		output = std::make_shared<SharedOutput>();
+		shared = output;
+	}
+	return output;
+}
+
 VideoDisplay::VideoDisplay(wxToolBar *toolbar, bool freeSize, wxComboBox *zoomBox, wxWindow *parent, agi::Context *c)
 : wxGLCanvas(parent, -1, attribList)
 , autohideTools(OPT_GET("Tool/Visual/Autohide"))
@@ -89,6 +110,7 @@ VideoDisplay::VideoDisplay(wxToolBar *toolbar, bool freeSize, wxComboBox *zoomBo
 , freeSize(freeSize)
 , retina_helper(agi::make_unique<RetinaHelper>(this))
 , scale_factor(retina_helper->GetScaleFactor())
+, output(GetSharedOutput())
 , scale_factor_connection(retina_helper->AddScaleFactorListener([=](int new_scale_factor) {
 	double new_zoom = windowZoomValue * new_scale_factor / scale_factor;
 	scale_factor = new_scale_factor;
@@ -106,6 +128,7 @@ VideoDisplay::VideoDisplay(wxToolBar *toolbar, bool freeSize, wxComboBox *zoomBo
 	});
 
 	Bind(wxEVT_PAINT, std::bind(&VideoDisplay::Render, this));
+	present_timer.Bind(wxEVT_TIMER, std::bind(&VideoDisplay::PresentHeldFrame, this));
 	Bind(wxEVT_SIZE, &VideoDisplay::OnSizeEvent, this);
 	Bind(wxEVT_CONTEXT_MENU, &VideoDisplay::OnContextMenu, this);
 	Bind(wxEVT_ENTER_WINDOW, &VideoDisplay::OnMouseEvent, this);
@@ -130,6 +153,11 @@ VideoDisplay::VideoDisplay(wxToolBar *toolbar, bool freeSize, wxComboBox *zoomBo
 
 VideoDisplay::~VideoDisplay () {
 	Unload();
+	// The textures have to be deleted with the context current
+	if (output.use_count() == 1 && output->context) {
+		SetCurrent(*output->context);
+		output->videoOut.reset();
+	}
 	con->videoController->Unbind(EVT_FRAME_READY, &VideoDisplay::UploadFrameData, this);
 }
 
@@ -142,22 +170,45 @@ bool VideoDisplay::InitContext() {
 	if (GetClientSize() == wxSize(0, 0))
 		return false;
 
-	if (!glContext)
-		glContext = agi::make_unique<wxGLContext>(this);
+	if (!output->context)
+		output->context = agi::make_unique<wxGLContext>(this);
 
-	SetCurrent(*glContext);
+	SetCurrent(*output->context);
 	return true;
 }
 
 void VideoDisplay::UploadFrameData(FrameReadyEvent &evt) {
-	pending_frame = evt.frame;
+	held_frame = evt.frame;
+	held_overlay = evt.overlay;
+	held_time = evt.time;
+	held_requested = evt.requested;
+
+	// Frames are requested ahead of time while playing, so hold on to them
+	// until they're due rather than showing them as soon as they're decoded
+	int delay = con->videoController->TimeUntilPresentation(evt.time);
+	if (delay > 0)
+		present_timer.StartOnce(delay);
+	else {
+		present_timer.Stop();
+		PresentHeldFrame();
+	}
+}
+
+void VideoDisplay::PresentHeldFrame() {
+	if (!held_frame) return;
+	pending_frame = std::move(held_frame);
+	pending_overlay = std::move(held_overlay);
 	Render();
+	con->videoController->FramePresented(held_time, held_requested);
 }
 
 void VideoDisplay::Render() try {
-	if (!con->project->VideoProvider() || !InitContext() || (!videoOut && !pending_frame))
+	AGI_TRACE_ZONE("video", "Display render");
+	if (!con->project->VideoProvider() || !InitContext() || (!output->videoOut && !pending_frame))
 		return;
 
+	auto& videoOut = output->videoOut;
+	auto& uploaded_frame = output->uploaded_frame;
 	if (!videoOut)
 		videoOut = agi::make_unique<VideoOutGL>();
 
@@ -166,8 +217,26 @@ void VideoDisplay::Render() try {
 
 	try {
 		if (pending_frame) {
-			videoOut->UploadFrameData(*pending_frame);
+			// Overlay-only changes reuse the frame which is already uploaded
+			if (pending_frame != uploaded_frame) {
+				uploaded_frame.reset();
+				videoOut->UploadFrameData(*pending_frame);
+				uploaded_frame = pending_frame;
+			}
+			if (!videoOut->UploadOverlay(pending_overlay)) {
+				// Too large for the graphics card, so fall back to drawing
+				// it onto a copy of the frame
+				VideoFrame composited;
+				if (pending_frame->format == VideoFrame::Format::BGRA)
+					composited = *pending_frame;
+				else
+					ConvertToBGRA(*pending_frame, composited);
+				pending_overlay->Composite(composited);
+				uploaded_frame.reset();
+				videoOut->UploadFrameData(composited);
+			}
 			pending_frame.reset();
+			pending_overlay.reset();
 		}
 	}
 	catch (const VideoOutInitException& err) {
@@ -180,6 +249,7 @@ void VideoDisplay::Render() try {
 		return;
 	}
 	catch (const VideoOutRenderException& err) {
+		uploaded_frame.reset();
 		wxLogError(
 			"Could not upload video frame to graphics card.\n"
 			"Error message reported: %s",
@@ -193,6 +263,7 @@ void VideoDisplay::Render() try {
 	if (!viewport_height || !viewport_width)
 		PositionVideo();
 
+	videoOut->SetPixelatedZoom(OPT_GET("Video/Pixelated Zoom")->GetBool());
 	videoOut->Render(viewport_left, viewport_bottom, viewport_width, viewport_height);
 
 	int client_w, client_h;
@@ -320,14 +391,20 @@ void VideoDisplay::PositionVideo() {
 	Render();
 }
 
+wxSize VideoDisplay::WindowZoomedSize() const {
+	auto provider = con->project->VideoProvider();
+	wxSize size(provider->GetWidth(), provider->GetHeight());
+	size *= windowZoomValue;
+	if (con->videoController->GetAspectRatioType() != AspectRatio::Default)
+		size.SetWidth(size.GetHeight() * con->videoController->GetAspectRatioValue());
+	return size;
+}
+
 void VideoDisplay::UpdateSize() {
 	auto provider = con->project->VideoProvider();
 	if (!provider || !IsShownOnScreen()) return;
 
-	videoSize.Set(provider->GetWidth(), provider->GetHeight());
-	videoSize *= windowZoomValue;
-	if (con->videoController->GetAspectRatioType() != AspectRatio::Default)
-		videoSize.SetWidth(videoSize.GetHeight() * con->videoController->GetAspectRatioValue());
+	videoSize = WindowZoomedSize();
 
 	wxEventBlocker blocker(this);
 	if (freeSize) {
@@ -488,7 +565,12 @@ void VideoDisplay::SetVideoZoom(int step) {
 	pan_y -= pixelChangeH * (mp.Y() / videoSize.GetHeight());
 
 	videoZoomValue = newVideoZoom;
-	UpdateSize();
+
+	// Zooming the video doesn't change the size of the window, so this only
+	// has to change how the frame which is already uploaded gets drawn
+	if (!IsShownOnScreen()) return;
+	videoSize = WindowZoomedSize() * videoZoomValue;
+	PositionVideo();
 }
 
 void VideoDisplay::SetZoomFromBox(wxCommandEvent &) {
@@ -539,11 +621,14 @@ Vector2D VideoDisplay::GetMousePosition() const {
 }
 
 void VideoDisplay::Unload() {
-	if (glContext) {
-		SetCurrent(*glContext);
-	}
-	videoOut.reset();
+	// The shared output is kept so that the display replacing this one
+	// can show what's already uploaded
+	if (output->context)
+		SetCurrent(*output->context);
 	tool.reset();
-	glContext.reset();
+	present_timer.Stop();
+	held_frame.reset();
+	held_overlay.reset();
 	pending_frame.reset();
+	pending_overlay.reset();
 }
@@ -37,10 +37,12 @@
 #include "vector2d.h"
 #include "visual_tool_vector_clip.h"
 
+#include <chrono>
 #include <memory>
 #include <typeinfo>
 #include <vector>
 #include <wx/glcanvas.h>
+#include <wx/timer.h>
 
 // Prototypes
 class RetinaHelper;
@@ -51,6 +53,7 @@ class wxComboBox;
 class wxTextCtrl;
 class wxToolBar;
 struct FrameReadyEvent;
+struct SubtitlesOverlay;
 struct VideoFrame;
 
 namespace agi {
@@ -99,17 +102,20 @@ class VideoDisplay final : public wxGLCanvas {
 	/// The current video pan offset height
 	int pan_y = 0;
 
-	/// The video renderer
-	std::unique_ptr<VideoOutGL> videoOut;
+	/// The OpenGL context, the video renderer and the frame uploaded to it,
+	/// which are shared by every display so that a frame is only uploaded
+	/// once and nothing has to be set up again when the video is detached
+	/// or docked
+	struct SharedOutput;
+	std::shared_ptr<SharedOutput> output;
+	/// Get the output of the displays which currently exist, or a new one
+	static std::shared_ptr<SharedOutput> GetSharedOutput();
 
 	/// The active visual typesetting tool
 	std::unique_ptr<VisualToolBase> tool;
 	/// The toolbar used by individual typesetting tools
 	wxToolBar* toolBar;
 
-	/// The OpenGL context for this display
-	std::unique_ptr<wxGLContext> glContext;
-
 	/// The dropdown box for selecting zoom levels
 	wxComboBox *zoomBox;
 
@@ -117,7 +123,19 @@ class VideoDisplay final : public wxGLCanvas {
 	bool freeSize;
 
 	/// Frame which will replace the currently visible frame on the next render
-	std::shared_ptr<VideoFrame> pending_frame;
+	std::shared_ptr<const VideoFrame> pending_frame;
+	/// Subtitles to draw over pending_frame, if they aren't already drawn onto it
+	std::shared_ptr<SubtitlesOverlay> pending_overlay;
+	/// Frame which arrived before it was due to be shown during playback
+	std::shared_ptr<const VideoFrame> held_frame;
+	/// Subtitles to draw over held_frame
+	std::shared_ptr<SubtitlesOverlay> held_overlay;
+	/// Time of held_frame
+	double held_time = 0;
+	/// When held_frame was requested
+	std::chrono::steady_clock::time_point held_requested;
+	/// Timer which shows held_frame when it becomes due
+	wxTimer present_timer;
 
 	std::unique_ptr<RetinaHelper> retina_helper;
 	int scale_factor;
@@ -130,11 +148,15 @@ class VideoDisplay final : public wxGLCanvas {
 
 	/// Upload the image for the current frame to the video card
 	void UploadFrameData(FrameReadyEvent&);
+	/// Render the held frame, if any
+	void PresentHeldFrame();
 
 	/// @brief Initialize the gl context and set the active context to this one
 	/// @return Could the context be set?
 	bool InitContext();
 
+	/// Size of the video at the current window zoom, ignoring the video zoom
+	wxSize WindowZoomedSize() const;
 	/// @brief Set the size of the display based on the current zoom and video resolution
 	void UpdateSize();
 	void PositionVideo();
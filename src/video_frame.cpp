@@ -16,45 +16,305 @@
 
 #include "video_frame.h"
 
-#include <boost/gil.hpp>
+#include <libaegisub/alpha_blend.h>
+#include <libaegisub/dispatch.h>
+#include <libaegisub/util.h>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
 #include <wx/image.h>
 
 namespace {
-	// We actually have bgr_, not bgra, so we need a custom converter which ignores the alpha channel
-	struct color_converter {
-		template <typename P1, typename P2>
-		void operator()(P1 const& src, P2& dst) const {
-			using namespace boost::gil;
-			dst = rgb8_pixel_t(
-				get_color(src, red_t()),
-				get_color(src, green_t()),
-				get_color(src, blue_t()));
-		}
+	/// Number of rows each worker copies at a time in CopyToImage()
+	const size_t rows_per_copy_chunk = 64;
+
+	/// Copy a frame into a wxImage's RGB and, if not null, alpha buffers,
+	/// with rows in parallel and unflipped
+	void CopyToImage(VideoFrame const& frame, unsigned char *rgb, unsigned char *alpha) {
+		const size_t chunks = (frame.height + rows_per_copy_chunk - 1) / rows_per_copy_chunk;
+		agi::dispatch::Parallel(chunks, [&](size_t chunk) {
+			const size_t last = std::min(frame.height, (chunk + 1) * rows_per_copy_chunk);
+			for (size_t y = chunk * rows_per_copy_chunk; y < last; ++y) {
+				const unsigned char *src = &frame.data[(frame.flipped ? frame.height - 1 - y : y) * frame.pitch];
+				unsigned char *dst = rgb + y * frame.width * 3;
+				for (size_t x = 0; x < frame.width; ++x) {
+					dst[x * 3] = src[x * 4 + 2];
+					dst[x * 3 + 1] = src[x * 4 + 1];
+					dst[x * 3 + 2] = src[x * 4];
+				}
+				if (alpha) {
+					unsigned char *dst_alpha = alpha + y * frame.width;
+					for (size_t x = 0; x < frame.width; ++x)
+						dst_alpha[x] = src[x * 4 + 3];
+				}
+			}
+		});
+	}
+}
+
+YuvToRgb::YuvToRgb(int colorspace, int color_range) {
+	// AGI_CS_* constants
+	float kr = .2126f, kb = .0722f;
+	switch (colorspace) {
+		case 4: kr = .30f; kb = .11f; break;
+		case 5: case 6: kr = .299f; kb = .114f; break;
+		case 7: kr = .212f; kb = .087f; break;
+		case 9: case 10: kr = .2627f; kb = .0593f; break;
+	}
+	const float kg = 1.f - kr - kb;
+
+	// The samples are 16-bit, so limited range is the 8-bit range scaled up
+	float y_scale = 1.f, c_scale = 1.f;
+	offset[0] = 0.f;
+	offset[1] = offset[2] = 32768.f / 65535.f;
+	if (color_range != 2) { // AGI_CR_JPEG
+		offset[0] = 16.f * 256 / 65535;
+		offset[1] = offset[2] = 128.f * 256 / 65535;
+		y_scale = 65535.f / (219 * 256);
+		c_scale = 65535.f / (224 * 256);
+	}
+
+	const float m[9] = {
+		1.f, 0.f, 2.f * (1.f - kr),
+		1.f, -2.f * kb * (1.f - kb) / kg, -2.f * kr * (1.f - kr) / kg,
+		1.f, 2.f * (1.f - kb), 0.f,
 	};
+	for (int row = 0; row < 3; ++row) {
+		matrix[row * 3] = m[row * 3] * y_scale;
+		matrix[row * 3 + 1] = m[row * 3 + 1] * c_scale;
+		matrix[row * 3 + 2] = m[row * 3 + 2] * c_scale;
+	}
+}
+
+namespace {
+/// PQ or HLG signal to linear light relative to SDR white
+float ToLinear(float e, int transfer) {
+	e = std::max(e, 0.f);
+	if (transfer == AGI_TRC_SMPTE2084) {
+		const float p = std::pow(e, 1.f / 78.84375f);
+		return std::pow(std::max(p - .8359375f, 0.f) / (18.8515625f - 18.6875f * p), 1.f / .1593017578125f) * 10000.f / hdr_sdr_white;
+	}
+	// HLG's inverse OETF; the OOTF is applied once all three are known
+	const float a = .17883277f, b = .28466892f, c = .55991073f;
+	return e <= .5f ? e * e / 3.f : (std::exp((e - c) / a) + b) / 12.f;
+}
+
+/// Compress linear light relative to SDR white into 0-1
+float ToneMap(float x) {
+	const float white = hdr_peak / hdr_sdr_white;
+	return x * (1.f + x / (white * white)) / (1.f + x);
+}
+
+uint8_t ToByte(float x) {
+	return static_cast<uint8_t>(std::min(std::max(x, 0.f), 1.f) * 255.f + .5f);
+}
+}
+
+void ConvertToBGRA(VideoFrame const& src, VideoFrame &dst) {
+	const size_t cw = (src.width + 1) / 2, ch = (src.height + 1) / 2;
+	auto y_plane = reinterpret_cast<const uint16_t *>(src.data.data());
+	auto u_plane = y_plane + src.pitch / 2 * src.height;
+	auto v_plane = u_plane + cw * ch;
+
+	dst.width = src.width;
+	dst.height = src.height;
+	dst.pitch = src.width * 4;
+	dst.flipped = src.flipped;
+	dst.format = VideoFrame::Format::BGRA;
+	dst.data.resize(dst.pitch * dst.height);
+
+	const YuvToRgb conv(src.colorspace, src.color_range);
+	const float *m = conv.matrix;
+	const bool hdr = IsHDR(src);
+	const bool bt2020 = src.colorspace == 9 || src.colorspace == 10;
+	for (size_t y = 0; y < src.height; ++y) {
+		unsigned char *out = &dst.data[y * dst.pitch];
+		for (size_t x = 0; x < src.width; ++x, out += 4) {
+			const float yuv[3] = {
+				y_plane[y * src.pitch / 2 + x] / 65535.f - conv.offset[0],
+				u_plane[y / 2 * cw + x / 2] / 65535.f - conv.offset[1],
+				v_plane[y / 2 * cw + x / 2] / 65535.f - conv.offset[2],
+			};
+			float rgb[3];
+			for (int i = 0; i < 3; ++i)
+				rgb[i] = m[i * 3] * yuv[0] + m[i * 3 + 1] * yuv[1] + m[i * 3 + 2] * yuv[2];
+
+			if (hdr) {
+				for (float& c : rgb)
+					c = ToLinear(c, src.transfer);
+				if (src.transfer == AGI_TRC_ARIB_B67) {
+					// HLG's OOTF for a display with the peak brightness
+					const float lum = .2627f * rgb[0] + .678f * rgb[1] + .0593f * rgb[2];
+					const float gain = std::pow(std::max(lum, 1e-6f), .2f) * hdr_peak / hdr_sdr_white;
+					for (float& c : rgb) c *= gain;
+				}
+				if (bt2020) {
+					const float r = rgb[0], g = rgb[1], b = rgb[2];
+					rgb[0] = 1.6605f * r - .5876f * g - .0728f * b;
+					rgb[1] = -.1246f * r + 1.1329f * g - .0083f * b;
+					rgb[2] = -.0182f * r - .1006f * g + 1.1187f * b;
+				}
+				for (float& c : rgb)
+					c = std::pow(ToneMap(std::max(c, 0.f)), 1.f / 2.2f);
+			}
+
+			out[0] = ToByte(rgb[2]);
+			out[1] = ToByte(rgb[1]);
+			out[2] = ToByte(rgb[0]);
+			out[3] = 255;
+		}
+	}
 }
 
 wxImage GetImage(VideoFrame const& frame) {
-	using namespace boost::gil;
-
-	wxImage img(frame.width, frame.height);
-	auto src = interleaved_view(frame.width, frame.height, (bgra8_pixel_t*)frame.data.data(), frame.pitch);
-	auto dst = interleaved_view(frame.width, frame.height, (rgb8_pixel_t*)img.GetData(), 3 * frame.width);
-	if (frame.flipped)
-		src = flipped_up_down_view(src);
-	copy_and_convert_pixels(src, dst, color_converter());
+	wxImage img(frame.width, frame.height, false);
+	CopyToImage(frame, img.GetData(), nullptr);
 	return img;
 }
 
 wxImage GetImageWithAlpha(VideoFrame const &frame) {
-	wxImage img = GetImage(frame);
-	img.InitAlpha();
-	uint8_t *dst = img.GetAlpha();
-	const uint8_t *src = frame.data.data() + 3;
-	for (int y = 0; y < frame.height; y++) {
-		for (int x = 0; x < frame.width; x++) {
-			*(dst++) = *src;
-			src += 4;
+	wxImage img(frame.width, frame.height, false);
+	img.SetAlpha();
+	CopyToImage(frame, img.GetData(), img.GetAlpha());
+	return img;
+}
+
+void SubtitlesOverlay::Reset(int new_x, int new_y, int new_width, int new_height) {
+	x = new_x;
+	y = new_y;
+	width = new_width;
+	height = new_height;
+	data.assign(static_cast<size_t>(width) * height * 4, 0);
+}
+
+void SubtitlesOverlay::Render(std::vector<agi::BlendImage> images) {
+	if (images.empty()) {
+		Reset(0, 0, 0, 0);
+		return;
+	}
+
+	int x1 = INT_MAX, y1 = INT_MAX, x2 = 0, y2 = 0;
+	for (auto const& img : images) {
+		x1 = std::min(x1, img.x);
+		y1 = std::min(y1, img.y);
+		x2 = std::max(x2, img.x + img.width);
+		y2 = std::max(y2, img.y + img.height);
+	}
+
+	Reset(x1, y1, x2 - x1, y2 - y1);
+	for (auto& img : images) {
+		img.x -= x;
+		img.y -= y;
+	}
+	agi::BlendImages(data.data(), width * 4, height, images, true);
+}
+
+void SubtitlesOverlay::Composite(VideoFrame &frame) const {
+	if (empty()) return;
+	if (!scaled()) {
+		agi::BlendPremultiplied(frame.PixelAt(x, y), frame.RowStep(), data.data(), width * 4, width, height, false, false);
+		return;
+	}
+
+	// Scale up to the part of the frame covered with nearest neighbour
+	// sampling, then blend that as usual
+	const int x1 = std::max(0, static_cast<int>(std::floor(x * scale_x)));
+	const int y1 = std::max(0, static_cast<int>(std::floor(y * scale_y)));
+	const int x2 = std::min<int>(frame.width, static_cast<int>(std::ceil((x + width) * scale_x)));
+	const int y2 = std::min<int>(frame.height, static_cast<int>(std::ceil((y + height) * scale_y)));
+	if (x1 >= x2 || y1 >= y2) return;
+
+	std::vector<int> columns(x2 - x1);
+	for (int col = x1; col < x2; ++col)
+		columns[col - x1] = agi::util::mid(0, static_cast<int>(col / scale_x) - x, width - 1);
+
+	std::vector<uint32_t> scaled_data(static_cast<size_t>(x2 - x1) * (y2 - y1));
+	const uint32_t *src = reinterpret_cast<const uint32_t *>(data.data());
+	for (int row = y1; row < y2; ++row) {
+		const uint32_t *src_row = src + static_cast<size_t>(agi::util::mid(0, static_cast<int>(row / scale_y) - y, height - 1)) * width;
+		uint32_t *dst = &scaled_data[static_cast<size_t>(row - y1) * (x2 - x1)];
+		for (int col : columns)
+			*dst++ = src_row[col];
+	}
+
+	agi::BlendPremultiplied(frame.PixelAt(x1, y1), frame.RowStep(),
+		reinterpret_cast<const uint8_t *>(scaled_data.data()), (x2 - x1) * 4, x2 - x1, y2 - y1, false, false);
+}
+
+void SubtitlesOverlay::Composite(VideoFrame &frame, FrameRect const& area) const {
+	const int x1 = std::max(x, area.x), y1 = std::max(y, area.y);
+	const int x2 = std::min(x + width, area.x + area.width);
+	const int y2 = std::min(y + height, area.y + area.height);
+	if (x1 >= x2 || y1 >= y2) return;
+
+	agi::BlendPremultiplied(frame.PixelAt(x1, y1), frame.RowStep(),
+		&data[(static_cast<size_t>(y1 - y) * width + (x1 - x)) * 4], width * 4,
+		x2 - x1, y2 - y1, false, false);
+}
+
+FrameRect SubtitlesOverlay::ChangedArea(SubtitlesOverlay const& previous) const {
+	FrameRect changed;
+	if (empty() && previous.empty()) return changed;
+
+	// With different bounding boxes something at the edge has moved, and
+	// everything either of them covers has to be treated as changed
+	if (x != previous.x || y != previous.y || width != previous.width || height != previous.height) {
+		if (empty()) return FrameRect{previous.x, previous.y, previous.width, previous.height};
+		if (previous.empty()) return FrameRect{x, y, width, height};
+		changed.x = std::min(x, previous.x);
+		changed.y = std::min(y, previous.y);
+		changed.width = std::max(x + width, previous.x + previous.width) - changed.x;
+		changed.height = std::max(y + height, previous.y + previous.height) - changed.y;
+		return changed;
+	}
+
+	const size_t row_bytes = static_cast<size_t>(width) * 4;
+	int first_row = -1, last_row = -1;
+	size_t first_byte = row_bytes, last_byte = 0;
+	for (int row = 0; row < height; ++row) {
+		const uint8_t *a = &data[row * row_bytes];
+		const uint8_t *b = &previous.data[row * row_bytes];
+		if (memcmp(a, b, row_bytes) == 0) continue;
+
+		if (first_row < 0) first_row = row;
+		last_row = row;
+
+		// Narrow down the columns from both ends of the row
+		size_t start = 0;
+		while (start < first_byte && a[start] == b[start]) ++start;
+		first_byte = std::min(first_byte, start);
+		size_t end = row_bytes;
+		while (end > last_byte + 1 && a[end - 1] == b[end - 1]) --end;
+		last_byte = std::max(last_byte, end - 1);
+	}
+	if (first_row < 0) return changed;
+
+	changed.x = x + static_cast<int>(first_byte / 4);
+	changed.y = y + first_row;
+	changed.width = static_cast<int>(last_byte / 4) + 1 - static_cast<int>(first_byte / 4);
+	changed.height = last_row - first_row + 1;
+	return changed;
+}
+
+void SubtitlesOverlay::CopyUnpremultiplied(VideoFrame &frame) const {
+	const int x1 = std::max(x, 0), y1 = std::max(y, 0);
+	const int x2 = std::min<int>(x + width, frame.width), y2 = std::min<int>(y + height, frame.height);
+
+	for (int row = y1; row < y2; ++row) {
+		const uint8_t *src = &data[((row - y) * width + (x1 - x)) * 4];
+		uint8_t *dst = frame.PixelAt(x1, row);
+		for (int col = x1; col < x2; ++col, src += 4, dst += 4) {
+			const unsigned a = src[3];
+			if (a == 0) continue;
+			if (a == 255) {
+				memcpy(dst, src, 4);
+				continue;
+			}
+			for (int c = 0; c < 3; ++c)
+				dst[c] = static_cast<uint8_t>(std::min(255u, (src[c] * 255u + a / 2) / a));
+			dst[3] = static_cast<uint8_t>(a);
 		}
 	}
-	return img;
 }
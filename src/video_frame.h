@@ -16,17 +16,145 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 
 class wxImage;
+namespace agi { struct BlendImage; }
+
+/// Transfer characteristics of a frame, with the values used by H.273
+enum AGI_TransferCharacteristics {
+	AGI_TRC_UNSPECIFIED = 2,
+	AGI_TRC_SMPTE2084 = 16, ///< PQ
+	AGI_TRC_ARIB_B67 = 18   ///< HLG
+};
 
 struct VideoFrame {
+	/// Layout of data
+	enum class Format {
+		/// Packed 8-bit BGRA
+		BGRA,
+		/// 16-bit little-endian Y, U and V planes one after another with no
+		/// padding, with the chroma planes at half the width and height
+		/// rounded up. pitch is the size in bytes of a row of the Y plane.
+		/// Only made for the video display, which converts it to RGB itself.
+		YUV420P16
+	};
+
 	std::vector<unsigned char> data;
 	size_t width;
 	size_t height;
 	size_t pitch;
 	bool flipped;
+	Format format = Format::BGRA;
+	/// For YUV frames, the color matrix and range (AGI_CS_* and AGI_CR_*)
+	/// and the transfer function (AGI_TRC_*) of the samples
+	int colorspace = -1;
+	int color_range = -1;
+	int transfer = AGI_TRC_UNSPECIFIED;
+
+	/// Get a pointer to a pixel, with rows counted from the top of the image
+	unsigned char *PixelAt(size_t x, size_t y) {
+		return &data[(flipped ? height - 1 - y : y) * pitch + x * 4];
+	}
+	const unsigned char *PixelAt(size_t x, size_t y) const {
+		return &data[(flipped ? height - 1 - y : y) * pitch + x * 4];
+	}
+	/// Distance in bytes from one row to the row below it in the image
+	ptrdiff_t RowStep() const { return flipped ? -ptrdiff_t(pitch) : ptrdiff_t(pitch); }
+};
+
+/// A frame in a video provider's native pixel format, which is only
+/// meaningful to the provider which decoded it
+struct PlanarFrame {
+	/// The planes packed together with no padding
+	std::vector<unsigned char> data;
+	int width = 0;
+	int height = 0;
+	/// Provider-specific pixel format
+	int format = -1;
+	/// Color matrix and range which the frame was tagged with
+	int colorspace = -1;
+	int color_range = -1;
+};
+
+/// A rectangle of a frame, in pixels from the top left corner
+struct FrameRect {
+	int x = 0;
+	int y = 0;
+	int width = 0;
+	int height = 0;
+
+	bool empty() const { return width <= 0 || height <= 0; }
+};
+
+/// Subtitles rendered onto a transparent background, stored as premultiplied
+/// BGRA covering just the bounding box of the rendered images
+struct SubtitlesOverlay {
+	std::vector<unsigned char> data;
+	int x = 0;
+	int y = 0;
+	int width = 0;
+	int height = 0;
+	/// Size in frame pixels of each overlay pixel, for overlays rendered at
+	/// a reduced size to be scaled up when drawn. The position and size of
+	/// the overlay are in overlay pixels.
+	float scale_x = 1.f;
+	float scale_y = 1.f;
+
+	/// Clear the overlay and resize it to the given bounding box
+	void Reset(int x, int y, int width, int height);
+
+	/// Replace the overlay with the given images, blended in order
+	/// @param images Images in frame coordinates
+	void Render(std::vector<agi::BlendImage> images);
+
+	/// Draw the overlay onto a frame
+	void Composite(VideoFrame &frame) const;
+
+	/// Draw just the part of the overlay inside a rectangle onto a frame
+	void Composite(VideoFrame &frame, FrameRect const& area) const;
+
+	/// @brief Get the part of the frame where this overlay looks different from another
+	/// @param previous Overlay to compare with
+	/// @return A rectangle containing every pixel which differs, which may
+	///         be larger than needed when the bounding boxes don't match
+	FrameRect ChangedArea(SubtitlesOverlay const& previous) const;
+
+	/// Copy the overlay into a transparent frame as straight rather than
+	/// premultiplied alpha, such as for saving just the subtitles to a file
+	void CopyUnpremultiplied(VideoFrame &frame) const;
+
+	bool empty() const { return width == 0 || height == 0; }
+	bool scaled() const { return scale_x != 1.f || scale_y != 1.f; }
+	size_t size() const { return data.size(); }
 };
 
+/// Coefficients for turning YUV samples normalized to 0-1 into nonlinear
+/// RGB, as rgb = matrix * (yuv - offset) with matrix in row-major order
+struct YuvToRgb {
+	float matrix[9];
+	float offset[3];
+
+	YuvToRgb(int colorspace, int color_range);
+};
+
+/// Brightness in nits which SDR white is shown at when tone mapping HDR
+/// frames, and the brightness which is mapped to full white
+const float hdr_sdr_white = 203.f;
+const float hdr_peak = 1000.f;
+
+/// Does the frame's transfer function need tone mapping to be shown?
+inline bool IsHDR(VideoFrame const& frame) {
+	return frame.transfer == AGI_TRC_SMPTE2084 || frame.transfer == AGI_TRC_ARIB_B67;
+}
+
+/// @brief Convert a YUV frame to BGRA on the CPU
+///
+/// Does the same conversion and tone mapping as the video display's shader,
+/// for when the graphics card can't.
+void ConvertToBGRA(VideoFrame const& src, VideoFrame &dst);
+
 wxImage GetImage(VideoFrame const& frame);
 wxImage GetImageWithAlpha(VideoFrame const& frame);
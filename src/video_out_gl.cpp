@@ -20,18 +20,37 @@
 ///
 
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <utility>
 
 #include <libaegisub/log.h>
+#include <libaegisub/make_unique.h>
 
 // These must be included before local headers.
 #ifdef HAVE_OPENGL_GL_H
 #include <OpenGL/gl.h>
 #else
 #include <GL/gl.h>
+#include "gl/glext.h"
+#endif
+
+#ifdef __WIN32__
+#define glGetProc(a) wglGetProcAddress(a)
+#elif !defined(__APPLE__)
+#include <GL/glx.h>
+#define glGetProc(a) glXGetProcAddress((const GLubyte *)(a))
+#endif
+
+// From GL_ARB_buffer_storage, which is newer than our copy of glext.h
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC) (GLenum target, GLsizeiptr size, const GLvoid *data, GLbitfield flags);
 #endif
 
 #include "video_out_gl.h"
+#include "gl_wrap.h"
 #include "utils.h"
 #include "video_frame.h"
 
@@ -61,6 +80,411 @@ struct VideoOutGL::TextureInfo {
 	int sourceW = 0;
 };
 
+#ifdef glGetProc
+/// @brief A ring of pixel buffer objects which frames are copied into before
+///        being uploaded to the textures
+///
+/// Uploading from a buffer object lets glTexSubImage2D return without waiting
+/// for the transfer to the graphics card, and using several of them lets the
+/// next frame be copied in while the previous one is still being transferred.
+struct VideoOutGL::PixelBuffers {
+	PFNGLGENBUFFERSPROC glGenBuffers = nullptr;
+	PFNGLDELETEBUFFERSPROC glDeleteBuffers = nullptr;
+	PFNGLBINDBUFFERPROC glBindBuffer = nullptr;
+	PFNGLBUFFERDATAPROC glBufferData = nullptr;
+	PFNGLMAPBUFFERPROC glMapBuffer = nullptr;
+	PFNGLUNMAPBUFFERPROC glUnmapBuffer = nullptr;
+	// Only used when the buffers can be persistently mapped
+	PFNGLBUFFERSTORAGEPROC glBufferStorage = nullptr;
+	PFNGLMAPBUFFERRANGEPROC glMapBufferRange = nullptr;
+	PFNGLFENCESYNCPROC glFenceSync = nullptr;
+	PFNGLCLIENTWAITSYNCPROC glClientWaitSync = nullptr;
+	PFNGLDELETESYNCPROC glDeleteSync = nullptr;
+
+	static const int Count = 3;
+	GLuint buffers[Count] = {};
+	/// Persistent mappings of each of the buffers
+	void *mapped[Count] = {};
+	/// Fences for the most recent upload from each persistent buffer
+	GLsync fences[Count] = {};
+	/// Size of a frame in bytes
+	size_t size = 0;
+	/// Index of the buffer most recently copied into
+	int current = 0;
+	/// Whether the buffers are mapped once and kept mapped, rather than
+	/// reallocated and mapped for each frame
+	bool persistent = false;
+
+	template<typename Func>
+	static bool Load(Func& func, const char *name) {
+		func = reinterpret_cast<Func>(glGetProc(name));
+		return !!func;
+	}
+
+	/// Get pixel buffers for the current context, or nullptr if unsupported
+	static std::unique_ptr<PixelBuffers> Create() {
+		if (!OpenGLWrapper::IsExtensionSupported("GL_ARB_pixel_buffer_object"))
+			return nullptr;
+
+		auto pb = agi::make_unique<PixelBuffers>();
+		if (!Load(pb->glGenBuffers, "glGenBuffers") ||
+			!Load(pb->glDeleteBuffers, "glDeleteBuffers") ||
+			!Load(pb->glBindBuffer, "glBindBuffer") ||
+			!Load(pb->glBufferData, "glBufferData") ||
+			!Load(pb->glMapBuffer, "glMapBuffer") ||
+			!Load(pb->glUnmapBuffer, "glUnmapBuffer"))
+			return nullptr;
+
+		pb->persistent =
+			OpenGLWrapper::IsExtensionSupported("GL_ARB_buffer_storage") &&
+			OpenGLWrapper::IsExtensionSupported("GL_ARB_sync") &&
+			Load(pb->glBufferStorage, "glBufferStorage") &&
+			Load(pb->glMapBufferRange, "glMapBufferRange") &&
+			Load(pb->glFenceSync, "glFenceSync") &&
+			Load(pb->glClientWaitSync, "glClientWaitSync") &&
+			Load(pb->glDeleteSync, "glDeleteSync");
+
+		pb->glGenBuffers(Count, pb->buffers);
+		return pb;
+	}
+
+	~PixelBuffers() {
+		DeleteFences();
+		glDeleteBuffers(Count, buffers);
+	}
+
+	void DeleteFences() {
+		for (auto& fence : fences) {
+			if (fence) glDeleteSync(fence);
+			fence = nullptr;
+		}
+	}
+
+	/// Resize the buffers for frames of the given size
+	void Allocate(size_t new_size) {
+		size = new_size;
+		// Streaming buffers are reallocated for every frame anyway
+		if (!persistent) return;
+
+		// Persistent buffers have immutable storage, so they have to be
+		// replaced entirely
+		DeleteFences();
+		glDeleteBuffers(Count, buffers);
+		glGenBuffers(Count, buffers);
+
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		bool ok = true;
+		for (int i = 0; i < Count && ok; ++i) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[i]);
+			glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+			mapped[i] = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+			ok = mapped[i] && !glGetError();
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		if (ok) return;
+
+		LOG_I("video/out/gl") << "Could not map pixel buffers persistently; remapping them for each frame instead";
+		while (glGetError()) { }
+		persistent = false;
+		glDeleteBuffers(Count, buffers);
+		glGenBuffers(Count, buffers);
+	}
+
+	/// @brief Copy a frame into the next buffer and leave it bound for uploading
+	/// @return false if the frame could not be copied and must be uploaded directly
+	bool Upload(const unsigned char *data, size_t len) {
+		if (len != size) Allocate(len);
+
+		current = (current + 1) % Count;
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[current]);
+
+		if (persistent) {
+			// Wait for the transfer from when this buffer was last used,
+			// which has almost always already finished
+			if (fences[current]) {
+				glClientWaitSync(fences[current], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+				glDeleteSync(fences[current]);
+				fences[current] = nullptr;
+			}
+			memcpy(mapped[current], data, len);
+			return true;
+		}
+
+		// Orphan the old storage so that mapping doesn't have to wait for
+		// the transfer from it
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, len, nullptr, GL_STREAM_DRAW);
+		if (void *dst = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY)) {
+			memcpy(dst, data, len);
+			if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER))
+				return true;
+		}
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		while (glGetError()) { }
+		return false;
+	}
+
+	/// Unbind the buffer after the textures have been uploaded from it
+	void Finish() {
+		if (persistent)
+			fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+};
+
+/// Converts the planes of a YUV frame to RGB as it draws them, tone mapping
+/// HDR frames. The same conversion as ConvertToBGRA().
+static const char yuv_fragment_shader[] = R"(
+#version 110
+uniform sampler2D y_plane;
+uniform sampler2D u_plane;
+uniform sampler2D v_plane;
+uniform mat3 yuv_matrix;
+uniform vec3 yuv_offset;
+uniform int transfer;
+uniform bool bt2020;
+uniform float sdr_white;
+uniform float peak;
+
+vec3 pq_to_linear(vec3 e) {
+	vec3 p = pow(max(e, 0.0), vec3(1.0 / 78.84375));
+	return pow(max(p - 0.8359375, 0.0) / (18.8515625 - 18.6875 * p), vec3(1.0 / 0.1593017578125)) * 10000.0 / sdr_white;
+}
+
+vec3 hlg_to_linear(vec3 e) {
+	e = max(e, 0.0);
+	vec3 low = e * e / 3.0;
+	vec3 high = (exp((e - 0.55991073) / 0.17883277) + 0.28466892) / 12.0;
+	vec3 scene = mix(low, high, step(0.5, e));
+	float lum = dot(scene, vec3(0.2627, 0.678, 0.0593));
+	return scene * pow(max(lum, 1e-6), 0.2) * peak / sdr_white;
+}
+
+void main() {
+	vec2 pos = gl_TexCoord[0].st;
+	vec3 yuv = vec3(texture2D(y_plane, pos).r, texture2D(u_plane, pos).r, texture2D(v_plane, pos).r);
+	vec3 rgb = yuv_matrix * (yuv - yuv_offset);
+
+	if (transfer == 16 || transfer == 18) {
+		rgb = transfer == 16 ? pq_to_linear(rgb) : hlg_to_linear(rgb);
+		if (bt2020)
+			rgb = mat3(1.6605, -0.1246, -0.0182, -0.5876, 1.1329, -0.1006, -0.0728, -0.0083, 1.1187) * rgb;
+		float white = peak / sdr_white;
+		rgb = max(rgb, 0.0);
+		rgb = pow(rgb * (1.0 + rgb / (white * white)) / (1.0 + rgb), vec3(1.0 / 2.2));
+	}
+	gl_FragColor = vec4(clamp(rgb, 0.0, 1.0), 1.0);
+}
+)";
+
+/// @brief Textures for the planes of a YUV frame and the shader which draws them
+struct VideoOutGL::YuvShader {
+	PFNGLCREATESHADERPROC glCreateShader = nullptr;
+	PFNGLSHADERSOURCEPROC glShaderSource = nullptr;
+	PFNGLCOMPILESHADERPROC glCompileShader = nullptr;
+	PFNGLGETSHADERIVPROC glGetShaderiv = nullptr;
+	PFNGLGETSHADERINFOLOGPROC glGetShaderInfoLog = nullptr;
+	PFNGLDELETESHADERPROC glDeleteShader = nullptr;
+	PFNGLCREATEPROGRAMPROC glCreateProgram = nullptr;
+	PFNGLATTACHSHADERPROC glAttachShader = nullptr;
+	PFNGLLINKPROGRAMPROC glLinkProgram = nullptr;
+	PFNGLGETPROGRAMIVPROC glGetProgramiv = nullptr;
+	PFNGLDELETEPROGRAMPROC glDeleteProgram = nullptr;
+	PFNGLUSEPROGRAMPROC glUseProgram = nullptr;
+	PFNGLGETUNIFORMLOCATIONPROC glGetUniformLocation = nullptr;
+	PFNGLUNIFORM1IPROC glUniform1i = nullptr;
+	PFNGLUNIFORM1FPROC glUniform1f = nullptr;
+	PFNGLUNIFORM3FVPROC glUniform3fv = nullptr;
+	PFNGLUNIFORMMATRIX3FVPROC glUniformMatrix3fv = nullptr;
+	PFNGLACTIVETEXTUREPROC glActiveTexture = nullptr;
+
+	GLuint program = 0;
+	/// Y, U and V plane textures
+	GLuint textures[3] = {};
+	/// Size of the frame the textures were created for
+	int width = 0;
+	int height = 0;
+	bool flipped = false;
+
+	template<typename Func>
+	static bool Load(Func& func, const char *name) {
+		func = reinterpret_cast<Func>(glGetProc(name));
+		return !!func;
+	}
+
+	/// Compile the shader for the current context, or return nullptr if
+	/// shaders aren't supported
+	static std::unique_ptr<YuvShader> Create() {
+		if (!OpenGLWrapper::IsExtensionSupported("GL_ARB_fragment_shader") &&
+			!OpenGLWrapper::IsExtensionSupported("GL_ARB_shading_language_100"))
+			return nullptr;
+
+		auto ys = agi::make_unique<YuvShader>();
+		if (!Load(ys->glCreateShader, "glCreateShader") ||
+			!Load(ys->glShaderSource, "glShaderSource") ||
+			!Load(ys->glCompileShader, "glCompileShader") ||
+			!Load(ys->glGetShaderiv, "glGetShaderiv") ||
+			!Load(ys->glGetShaderInfoLog, "glGetShaderInfoLog") ||
+			!Load(ys->glDeleteShader, "glDeleteShader") ||
+			!Load(ys->glCreateProgram, "glCreateProgram") ||
+			!Load(ys->glAttachShader, "glAttachShader") ||
+			!Load(ys->glLinkProgram, "glLinkProgram") ||
+			!Load(ys->glGetProgramiv, "glGetProgramiv") ||
+			!Load(ys->glDeleteProgram, "glDeleteProgram") ||
+			!Load(ys->glUseProgram, "glUseProgram") ||
+			!Load(ys->glGetUniformLocation, "glGetUniformLocation") ||
+			!Load(ys->glUniform1i, "glUniform1i") ||
+			!Load(ys->glUniform1f, "glUniform1f") ||
+			!Load(ys->glUniform3fv, "glUniform3fv") ||
+			!Load(ys->glUniformMatrix3fv, "glUniformMatrix3fv") ||
+			!Load(ys->glActiveTexture, "glActiveTexture"))
+			return nullptr;
+
+		GLuint shader = ys->glCreateShader(GL_FRAGMENT_SHADER);
+		const char *src = yuv_fragment_shader;
+		ys->glShaderSource(shader, 1, &src, nullptr);
+		ys->glCompileShader(shader);
+		GLint ok = 0;
+		ys->glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+		if (!ok) {
+			char log[1024] = {};
+			ys->glGetShaderInfoLog(shader, sizeof(log) - 1, nullptr, log);
+			LOG_E("video/out/gl") << "Could not compile the YUV shader: " << log;
+			ys->glDeleteShader(shader);
+			while (glGetError()) { }
+			return nullptr;
+		}
+
+		ys->program = ys->glCreateProgram();
+		ys->glAttachShader(ys->program, shader);
+		ys->glLinkProgram(ys->program);
+		// The program keeps it until the program is deleted
+		ys->glDeleteShader(shader);
+		ys->glGetProgramiv(ys->program, GL_LINK_STATUS, &ok);
+		if (!ok) {
+			LOG_E("video/out/gl") << "Could not link the YUV shader";
+			while (glGetError()) { }
+			return nullptr;
+		}
+
+		glGenTextures(3, ys->textures);
+		if (glGetError()) return nullptr;
+		return ys;
+	}
+
+	~YuvShader() {
+		if (program) glDeleteProgram(program);
+		if (textures[0]) glDeleteTextures(3, textures);
+	}
+
+	/// Recreate the textures if the frame size has changed
+	void InitTextures(int new_width, int new_height, GLint magFilter) {
+		if (new_width == width && new_height == height) return;
+		width = new_width;
+		height = new_height;
+		for (int i = 0; i < 3; ++i) {
+			const int w = i ? (width + 1) / 2 : width;
+			const int h = i ? (height + 1) / 2 : height;
+			CHECK_INIT_ERROR(glBindTexture(GL_TEXTURE_2D, textures[i]));
+			CHECK_INIT_ERROR(glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE16, w, h, 0, GL_LUMINANCE, GL_UNSIGNED_SHORT, nullptr));
+			CHECK_INIT_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+			CHECK_INIT_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, i ? GL_LINEAR : magFilter));
+			CHECK_INIT_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+			CHECK_INIT_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+		}
+	}
+
+	void Upload(VideoFrame const& frame, GLint magFilter) {
+		InitTextures(frame.width, frame.height, magFilter);
+		flipped = frame.flipped;
+
+		const size_t cw = (frame.width + 1) / 2, ch = (frame.height + 1) / 2;
+		const unsigned char *planes[3] = {
+			frame.data.data(),
+			frame.data.data() + frame.pitch * frame.height,
+			frame.data.data() + frame.pitch * frame.height + cw * ch * 2,
+		};
+		CHECK_ERROR(glPixelStorei(GL_UNPACK_ALIGNMENT, 2));
+		for (int i = 0; i < 3; ++i) {
+			CHECK_ERROR(glPixelStorei(GL_UNPACK_ROW_LENGTH, i ? cw : frame.pitch / 2));
+			CHECK_ERROR(glBindTexture(GL_TEXTURE_2D, textures[i]));
+			CHECK_ERROR(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, i ? cw : frame.width, i ? ch : frame.height,
+				GL_LUMINANCE, GL_UNSIGNED_SHORT, planes[i]));
+		}
+		CHECK_ERROR(glPixelStorei(GL_UNPACK_ROW_LENGTH, 0));
+		CHECK_ERROR(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+
+		const YuvToRgb conv(frame.colorspace, frame.color_range);
+		CHECK_ERROR(glUseProgram(program));
+		CHECK_ERROR(glUniform1i(glGetUniformLocation(program, "y_plane"), 0));
+		CHECK_ERROR(glUniform1i(glGetUniformLocation(program, "u_plane"), 1));
+		CHECK_ERROR(glUniform1i(glGetUniformLocation(program, "v_plane"), 2));
+		CHECK_ERROR(glUniformMatrix3fv(glGetUniformLocation(program, "yuv_matrix"), 1, GL_TRUE, conv.matrix));
+		CHECK_ERROR(glUniform3fv(glGetUniformLocation(program, "yuv_offset"), 1, conv.offset));
+		CHECK_ERROR(glUniform1i(glGetUniformLocation(program, "transfer"), frame.transfer));
+		CHECK_ERROR(glUniform1i(glGetUniformLocation(program, "bt2020"), frame.colorspace == 9 || frame.colorspace == 10));
+		CHECK_ERROR(glUniform1f(glGetUniformLocation(program, "sdr_white"), hdr_sdr_white));
+		CHECK_ERROR(glUniform1f(glGetUniformLocation(program, "peak"), hdr_peak));
+		CHECK_ERROR(glUseProgram(0));
+	}
+
+	void SetMagFilter(GLint magFilter) {
+		if (!width) return;
+		CHECK_ERROR(glBindTexture(GL_TEXTURE_2D, textures[0]));
+		CHECK_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter));
+	}
+
+	/// Clear the viewport and draw the frame over all of it
+	void Draw() {
+		CHECK_ERROR(glClearColor(0,0,0,0));
+		CHECK_ERROR(glClearStencil(0));
+		CHECK_ERROR(glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT));
+		CHECK_ERROR(glDisable(GL_BLEND));
+
+		CHECK_ERROR(glMatrixMode(GL_PROJECTION));
+		CHECK_ERROR(glLoadIdentity());
+		if (flipped) {
+			CHECK_ERROR(glOrtho(0.0f, width, 0.0f, height, -1000.0f, 1000.0f));
+		}
+		else {
+			CHECK_ERROR(glOrtho(0.0f, width, height, 0.0f, -1000.0f, 1000.0f));
+		}
+
+		for (int i = 2; i >= 0; --i) {
+			CHECK_ERROR(glActiveTexture(GL_TEXTURE0 + i));
+			CHECK_ERROR(glBindTexture(GL_TEXTURE_2D, textures[i]));
+		}
+		CHECK_ERROR(glUseProgram(program));
+		glBegin(GL_QUADS);
+			glTexCoord2f(0, 0); glVertex2f(0, 0);
+			glTexCoord2f(1, 0); glVertex2f(width, 0);
+			glTexCoord2f(1, 1); glVertex2f(width, height);
+			glTexCoord2f(0, 1); glVertex2f(0, height);
+		glEnd();
+		if (GLenum err = glGetError()) throw VideoOutRenderException("GL_QUADS", err);
+		CHECK_ERROR(glUseProgram(0));
+	}
+};
+#else
+// The buffer functions aren't looked up on OS X, so always upload directly
+struct VideoOutGL::PixelBuffers {
+	bool persistent = false;
+	static std::unique_ptr<PixelBuffers> Create() { return nullptr; }
+	bool Upload(const unsigned char *, size_t) { return false; }
+	void Finish() { }
+};
+
+// Nor are the shader functions, so YUV frames are converted on the CPU
+struct VideoOutGL::YuvShader {
+	int width = 0;
+	int height = 0;
+	static std::unique_ptr<YuvShader> Create() { return nullptr; }
+	void Upload(VideoFrame const&, GLint) { }
+	void SetMagFilter(GLint) { }
+	void Draw() { }
+};
+#endif
+
 /// @brief Test if a texture can be created
 /// @param width The width of the texture
 /// @param height The height of the texture
@@ -93,6 +517,14 @@ void VideoOutGL::DetectOpenGLCapabilities() {
 
 	// Test for rectangular texture support
 	supportsRectangularTextures = TestTexture(maxTextureSize, maxTextureSize >> 1, internalFormat);
+
+	pixelBuffers = PixelBuffers::Create();
+	if (!pixelBuffers)
+		LOG_I("video/out/gl") << "Pixel buffer objects are not supported; uploading frames directly";
+	else if (pixelBuffers->persistent)
+		LOG_I("video/out/gl") << "Uploading frames through persistently mapped pixel buffer objects";
+	else
+		LOG_I("video/out/gl") << "Uploading frames through pixel buffer objects";
 }
 
 /// @brief If needed, create the grid of textures for displaying frames of the given format
@@ -244,7 +676,7 @@ void VideoOutGL::InitTextures(int width, int height, GLenum format, int bpp, boo
 		CHECK_INIT_ERROR(glBindTexture(GL_TEXTURE_2D, textureIdList[i]));
 		CHECK_INIT_ERROR(glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, textureSizes[i].first, textureSizes[i].second, 0, format, GL_UNSIGNED_BYTE, nullptr));
 		CHECK_INIT_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
-		CHECK_INIT_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+		CHECK_INIT_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter));
 		CHECK_INIT_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP));
 		CHECK_INIT_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP));
 	}
@@ -253,23 +685,204 @@ void VideoOutGL::InitTextures(int width, int height, GLenum format, int bpp, boo
 void VideoOutGL::UploadFrameData(VideoFrame const& frame) {
 	if (frame.height == 0 || frame.width == 0) return;
 
+	if (frame.format != VideoFrame::Format::BGRA) {
+		DetectOpenGLCapabilities();
+		if (!yuvShaderTried) {
+			yuvShaderTried = true;
+			yuvShader = YuvShader::Create();
+			LOG_I("video/out/gl") << (yuvShader ? "Converting YUV frames with a shader" : "Shaders are not supported; converting YUV frames on the CPU");
+		}
+
+		// There's no tiling for the planes, so frames larger than the maximum
+		// texture size go through the CPU too
+		if (yuvShader && static_cast<int>(std::max(frame.width, frame.height)) <= maxTextureSize) {
+			yuvShader->Upload(frame, magFilter);
+			yuvFrame = true;
+			return;
+		}
+
+		VideoFrame converted;
+		ConvertToBGRA(frame, converted);
+		UploadFrameData(converted);
+		return;
+	}
+	yuvFrame = false;
+
 	InitTextures(frame.width, frame.height, GL_BGRA_EXT, 4, frame.flipped);
 
 	// Set the row length, needed to be able to upload partial rows
 	CHECK_ERROR(glPixelStorei(GL_UNPACK_ROW_LENGTH, frame.pitch / 4));
 
-	for (auto& ti : textureList) {
-		CHECK_ERROR(glBindTexture(GL_TEXTURE_2D, ti.textureID));
-		CHECK_ERROR(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, ti.sourceW,
-			ti.sourceH, GL_BGRA_EXT, GL_UNSIGNED_BYTE, &frame.data[ti.dataOffset]));
+	// With a pixel buffer bound the data pointers are offsets into the buffer
+	const bool buffered = pixelBuffers && pixelBuffers->Upload(frame.data.data(), frame.data.size());
+
+	try {
+		for (auto& ti : textureList) {
+			const void *src = buffered
+				? reinterpret_cast<const void *>(static_cast<uintptr_t>(ti.dataOffset))
+				: &frame.data[ti.dataOffset];
+			CHECK_ERROR(glBindTexture(GL_TEXTURE_2D, ti.textureID));
+			CHECK_ERROR(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, ti.sourceW,
+				ti.sourceH, GL_BGRA_EXT, GL_UNSIGNED_BYTE, src));
+		}
+	}
+	catch (...) {
+		if (buffered) pixelBuffers->Finish();
+		throw;
 	}
+	if (buffered) pixelBuffers->Finish();
 
 	CHECK_ERROR(glPixelStorei(GL_UNPACK_ROW_LENGTH, 0));
 }
 
+bool VideoOutGL::UploadOverlay(std::shared_ptr<const SubtitlesOverlay> overlay) {
+	auto previous = std::move(uploadedOverlay);
+	overlayWidth = overlayHeight = 0;
+	if (!overlay || overlay->empty()) return true;
+
+	DetectOpenGLCapabilities();
+	if (overlay->width > maxTextureSize || overlay->height > maxTextureSize)
+		return false;
+
+	if (overlay->width > overlayTextureWidth || overlay->height > overlayTextureHeight) {
+		int width = std::max(overlayTextureWidth, SmallestPowerOf2(overlay->width));
+		int height = std::max(overlayTextureHeight, SmallestPowerOf2(overlay->height));
+		if (!supportsRectangularTextures)
+			width = height = std::max(width, height);
+
+		if (!overlayTexture)
+			CHECK_INIT_ERROR(glGenTextures(1, &overlayTexture));
+		CHECK_INIT_ERROR(glBindTexture(GL_TEXTURE_2D, overlayTexture));
+		// Start out fully transparent so that the unused part of the texture
+		// can't bleed into the edges of the overlay when filtering
+		std::vector<unsigned char> blank(static_cast<size_t>(width) * height * 4, 0);
+		CHECK_INIT_ERROR(glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, GL_BGRA_EXT, GL_UNSIGNED_BYTE, blank.data()));
+		CHECK_INIT_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+		CHECK_INIT_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter));
+		CHECK_INIT_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP));
+		CHECK_INIT_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP));
+		overlayTextureWidth = width;
+		overlayTextureHeight = height;
+		previous.reset();
+	}
+
+	CHECK_ERROR(glBindTexture(GL_TEXTURE_2D, overlayTexture));
+
+	// If the texture holds an overlay with the same bounding box, which is
+	// the usual case when editing one of several lines on a frame, only the
+	// part which differs has to be uploaded
+	const bool same_box = previous && !previous->empty() &&
+		previous->x == overlay->x && previous->y == overlay->y &&
+		previous->width == overlay->width && previous->height == overlay->height &&
+		previous->scale_x == overlay->scale_x && previous->scale_y == overlay->scale_y;
+	if (same_box) {
+		if (previous != overlay) {
+			const FrameRect area = overlay->ChangedArea(*previous);
+			if (!area.empty()) {
+				const int left = area.x - overlay->x, top = area.y - overlay->y;
+				CHECK_ERROR(glPixelStorei(GL_UNPACK_ROW_LENGTH, overlay->width));
+				CHECK_ERROR(glTexSubImage2D(GL_TEXTURE_2D, 0, left, top, area.width, area.height,
+					GL_BGRA_EXT, GL_UNSIGNED_BYTE, &overlay->data[(static_cast<size_t>(top) * overlay->width + left) * 4]));
+				CHECK_ERROR(glPixelStorei(GL_UNPACK_ROW_LENGTH, 0));
+			}
+		}
+	}
+	else {
+		CHECK_ERROR(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, overlay->width, overlay->height,
+			GL_BGRA_EXT, GL_UNSIGNED_BYTE, overlay->data.data()));
+
+		// Clear the row and column just past the overlay, which may hold part of
+		// a previous larger overlay
+		std::vector<unsigned char> blank((std::max(overlay->width, overlay->height) + 1) * 4, 0);
+		if (overlay->width < overlayTextureWidth)
+			CHECK_ERROR(glTexSubImage2D(GL_TEXTURE_2D, 0, overlay->width, 0, 1,
+				std::min(overlay->height + 1, overlayTextureHeight), GL_BGRA_EXT, GL_UNSIGNED_BYTE, blank.data()));
+		if (overlay->height < overlayTextureHeight)
+			CHECK_ERROR(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, overlay->height,
+				overlay->width, 1, GL_BGRA_EXT, GL_UNSIGNED_BYTE, blank.data()));
+	}
+
+	overlayX = overlay->x;
+	overlayY = overlay->y;
+	overlayWidth = overlay->width;
+	overlayHeight = overlay->height;
+	overlayScaleX = overlay->scale_x;
+	overlayScaleY = overlay->scale_y;
+	uploadedOverlay = std::move(overlay);
+	return true;
+}
+
+/// @brief Blend the subtitles overlay over the frame drawn by the display list
+/// @param width Width of the frame
+/// @param height Height of the frame
+void VideoOutGL::DrawOverlay(int width, int height) {
+	// The overlay is always top-down, even for flipped frames
+	CHECK_ERROR(glMatrixMode(GL_PROJECTION));
+	CHECK_ERROR(glLoadIdentity());
+	CHECK_ERROR(glOrtho(0.0f, width, height, 0.0f, -1000.0f, 1000.0f));
+
+	CHECK_ERROR(glEnable(GL_TEXTURE_2D));
+	CHECK_ERROR(glEnable(GL_BLEND));
+	// The overlay's colors are premultiplied by its alpha
+	CHECK_ERROR(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
+	CHECK_ERROR(glBindTexture(GL_TEXTURE_2D, overlayTexture));
+	CHECK_ERROR(glColor4f(1.0f, 1.0f, 1.0f, 1.0f));
+
+	// Overlays rendered at a reduced size are stretched back over the
+	// frame, and smoothed by the texture's filtering
+	float x1 = overlayX * overlayScaleX;
+	float y1 = overlayY * overlayScaleY;
+	float x2 = (overlayX + overlayWidth) * overlayScaleX;
+	float y2 = (overlayY + overlayHeight) * overlayScaleY;
+	float right = float(overlayWidth) / overlayTextureWidth;
+	float bottom = float(overlayHeight) / overlayTextureHeight;
+
+	glBegin(GL_QUADS);
+		glTexCoord2f(0,     0);      glVertex2f(x1, y1);
+		glTexCoord2f(right, 0);      glVertex2f(x2, y1);
+		glTexCoord2f(right, bottom); glVertex2f(x2, y2);
+		glTexCoord2f(0,     bottom); glVertex2f(x1, y2);
+	glEnd();
+	if (GLenum err = glGetError()) throw VideoOutRenderException("GL_QUADS", err);
+
+	CHECK_ERROR(glDisable(GL_BLEND));
+	CHECK_ERROR(glDisable(GL_TEXTURE_2D));
+	CHECK_ERROR(glLoadIdentity());
+}
+
+void VideoOutGL::SetPixelatedZoom(bool pixelated) {
+	GLint filter = pixelated ? GL_NEAREST : GL_LINEAR;
+	if (filter == magFilter) return;
+	magFilter = filter;
+
+	// Only the filter used when drawing changes, so the existing textures
+	// can be kept as they are
+	for (GLuint tex : textureIdList) {
+		CHECK_ERROR(glBindTexture(GL_TEXTURE_2D, tex));
+		CHECK_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter));
+	}
+	if (overlayTexture) {
+		CHECK_ERROR(glBindTexture(GL_TEXTURE_2D, overlayTexture));
+		CHECK_ERROR(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter));
+	}
+	if (yuvShader)
+		yuvShader->SetMagFilter(magFilter);
+}
+
 void VideoOutGL::Render(int dx1, int dy1, int dx2, int dy2) {
 	CHECK_ERROR(glViewport(dx1, dy1, dx2, dy2));
-	CHECK_ERROR(glCallList(dl));
+	// The overlay is drawn after the frame is converted to RGB, and so
+	// after any tone mapping
+	if (yuvFrame) {
+		yuvShader->Draw();
+		if (overlayWidth > 0)
+			DrawOverlay(yuvShader->width, yuvShader->height);
+	}
+	else {
+		CHECK_ERROR(glCallList(dl));
+		if (overlayWidth > 0 && frameWidth > 0)
+			DrawOverlay(frameWidth, frameHeight);
+	}
 	CHECK_ERROR(glMatrixMode(GL_MODELVIEW));
 	CHECK_ERROR(glLoadIdentity());
 
@@ -280,4 +893,6 @@ VideoOutGL::~VideoOutGL() {
 		glDeleteTextures(textureIdList.size(), &textureIdList[0]);
 		glDeleteLists(dl, 1);
 	}
+	if (overlayTexture)
+		glDeleteTextures(1, &overlayTexture);
 }
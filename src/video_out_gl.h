@@ -21,14 +21,18 @@
 
 #include <libaegisub/exception.h>
 
+#include <memory>
 #include <vector>
 
+struct SubtitlesOverlay;
 struct VideoFrame;
 
 /// @class VideoOutGL
 /// @brief OpenGL based video renderer
 class VideoOutGL {
+	struct PixelBuffers;
 	struct TextureInfo;
+	struct YuvShader;
 
 	/// The maximum texture size supported by the user's graphics card
 	int maxTextureSize = 0;
@@ -36,6 +40,14 @@ class VideoOutGL {
 	bool supportsRectangularTextures = false;
 	/// The internalformat to use
 	int internalFormat = 0;
+	/// Pixel buffer objects to upload frames through, if supported
+	std::unique_ptr<PixelBuffers> pixelBuffers;
+	/// Shader for drawing YUV frames, if supported
+	std::unique_ptr<YuvShader> yuvShader;
+	bool yuvShaderTried = false;
+	/// Whether the current frame is in yuvShader's textures rather than
+	/// the texture grid
+	bool yuvFrame = false;
 
 	/// The frame height which the texture grid has been set up for
 	int frameWidth = 0;
@@ -58,16 +70,53 @@ class VideoOutGL {
 	/// The number of columns of textures
 	int textureCols = 0;
 
+	/// Texture holding the subtitles overlay
+	GLuint overlayTexture = 0;
+	/// The allocated width of the overlay texture
+	int overlayTextureWidth = 0;
+	/// The allocated height of the overlay texture
+	int overlayTextureHeight = 0;
+	/// Overlay coordinates of the top left corner of the overlay
+	int overlayX = 0;
+	int overlayY = 0;
+	/// Size of the overlay in pixels, or zero if there is no overlay to draw
+	int overlayWidth = 0;
+	int overlayHeight = 0;
+	/// Size of an overlay pixel in frame pixels, if it was rendered at a
+	/// reduced size
+	float overlayScaleX = 1.f;
+	float overlayScaleY = 1.f;
+	/// The overlay currently in the overlay texture, which later overlays
+	/// are compared with to upload only what changed
+	std::shared_ptr<const SubtitlesOverlay> uploadedOverlay;
+
+	/// Filter used when the video is drawn larger than its actual size
+	GLint magFilter = GL_LINEAR;
+
 	void DetectOpenGLCapabilities();
 	void InitTextures(int width, int height, GLenum format, int bpp, bool flipped);
+	void DrawOverlay(int width, int height);
 
 	VideoOutGL(const VideoOutGL &) = delete;
 	VideoOutGL& operator=(const VideoOutGL&) = delete;
 public:
 	/// @brief Set the frame to be displayed when Render() is called
 	/// @param frame The frame to be displayed
+	///
+	/// YUV frames are converted to RGB by a shader when drawn if possible,
+	/// and on the CPU otherwise.
 	void UploadFrameData(VideoFrame const& frame);
 
+	/// @brief Set the subtitles to draw over the frame when Render() is called
+	/// @param overlay Premultiplied overlay in the uploaded frame's coordinates, or nullptr for none
+	/// @return false if the overlay is too large to be drawn as a single texture,
+	///         in which case it has to be drawn onto the frame before uploading it
+	bool UploadOverlay(std::shared_ptr<const SubtitlesOverlay> overlay);
+
+	/// @brief Set how the frame is filtered when drawn larger than its size
+	/// @param pixelated Show individual pixels rather than interpolating
+	void SetPixelatedZoom(bool pixelated);
+
 	/// @brief Render a frame
 	/// @param x Bottom left x coordinate
 	/// @param y Bottom left y coordinate
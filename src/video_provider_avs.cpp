@@ -68,6 +68,8 @@ class AvisynthVideoProvider: public VideoProvider {
 	VideoInfo vi;
 
 	AVSValue Open(agi::fs::path const& filename);
+	/// Let AviSynth+ render frames on several threads, if enabled
+	void Prefetch();
 	void Init(std::string const& matrix);
 
 public:
@@ -174,6 +176,7 @@ file_exit:
 
 	try {
 		source_clip = Open(filename);
+		Prefetch();
 		Init(colormatrix);
 	}
 	catch (AvisynthError const& err) {
@@ -211,6 +214,23 @@ void AvisynthVideoProvider::Init(std::string const& colormatrix) {
 	fps = (double)vi.fps_numerator / vi.fps_denominator;
 }
 
+void AvisynthVideoProvider::Prefetch() {
+	const int threads = OPT_GET("Provider/Avisynth/Prefetch Threads")->GetInt();
+	IScriptEnvironment *env = avs.GetEnv();
+	if (threads <= 0 || !env->FunctionExists("Prefetch")) return;
+
+	// Only AviSynth+ has Prefetch, and it refuses to be called twice on the
+	// same script, so this is done once on the source rather than in Init()
+	try {
+		AVSValue args[2] = { source_clip, threads };
+		source_clip = env->Invoke("Prefetch", AVSValue(args, 2));
+		LOG_I("avisynth/video") << "Prefetching with " << threads << " threads";
+	}
+	catch (AvisynthError const& err) {
+		LOG_E("avisynth/video") << "Failed to enable prefetching: " << err.msg;
+	}
+}
+
 AVSValue AvisynthVideoProvider::Open(agi::fs::path const& filename) {
 	IScriptEnvironment *env = avs.GetEnv();
 	char *videoFilename = env->SaveString(agi::fs::ShortName(filename).c_str());
@@ -323,7 +343,7 @@ void AvisynthVideoProvider::GetFrame(int n, VideoFrame &out) {
 }
 
 namespace agi { class BackgroundRunner; }
-std::unique_ptr<VideoProvider> CreateAvisynthVideoProvider(agi::fs::path const& path, std::string const& colormatrix, agi::BackgroundRunner *) {
+std::unique_ptr<VideoProvider> CreateAvisynthVideoProvider(agi::fs::path const& path, std::string const& colormatrix, bool, agi::BackgroundRunner *) {
 	return agi::make_unique<AvisynthVideoProvider>(path, colormatrix);
 }
 #endif // HAVE_AVISYNTH
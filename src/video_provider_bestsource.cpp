@@ -67,15 +67,28 @@ class BSVideoProvider final : public VideoProvider {
 
 	bool is_linear = false;
 
+	/// Size in bytes of BestSource's cache of decoded frames
+	size_t internal_cache_size = 0;
+
 	agi::scoped_holder<SwsContext *> sws_context;
+	/// Size sws_context scales to
+	int out_width = 0;
+	int out_height = 0;
+
+	void CreateScaler(int width, int height);
 
 public:
-	BSVideoProvider(agi::fs::path const& filename, std::string const& colormatrix, agi::BackgroundRunner *br);
+	BSVideoProvider(agi::fs::path const& filename, std::string const& colormatrix, bool hw_decode, agi::BackgroundRunner *br);
 
 	void GetFrame(int n, VideoFrame &out) override;
 
 	void SetColorSpace(std::string const& matrix) override { colorspace = matrix; }
 
+	bool SetProxyScale(int divisor) override {
+		CreateScaler(ProxyDimension(properties.Width, divisor), ProxyDimension(properties.Height, divisor));
+		return true;
+	}
+
 	int GetFrameCount() const override { return properties.NumFrames; };
 
 	int GetWidth() const override { return properties.Width; };
@@ -93,11 +106,16 @@ public:
 	};
 	std::vector<int> GetKeyFrames() const override { return Keyframes; };
 	std::string GetDecoderName() const override { return "BestSource"; };
-	bool WantsCaching() const override { return false; };
+	bool WantsCaching() const override { return true; };
+	size_t GetInternalCacheSize() const override { return internal_cache_size; }
+	void SetInternalCacheSize(size_t bytes) override {
+		internal_cache_size = bytes;
+		bs->SetMaxCacheSize(bytes);
+	}
 	bool HasAudio() const override { return has_audio; };
 };
 
-BSVideoProvider::BSVideoProvider(agi::fs::path const& filename, std::string const& colormatrix, agi::BackgroundRunner *br) try
+BSVideoProvider::BSVideoProvider(agi::fs::path const& filename, std::string const& colormatrix, bool hw_decode, agi::BackgroundRunner *br) try
 : apply_rff(OPT_GET("Provider/Video/BestSource/Apply RFF"))
 , sws_context(nullptr, sws_freeContext)
 {
@@ -111,15 +129,32 @@ BSVideoProvider::BSVideoProvider(agi::fs::path const& filename, std::string cons
 	else if (track_info.first == provider_bs::TrackSelection::None)
 		throw agi::UserCancelException("video loading cancelled by user");
 
+	std::string hw_device = hw_decode ? OPT_GET("Provider/Video/BestSource/Hardware Device")->GetString() : "";
+	if (hw_device == "none")
+		hw_device.clear();
+
 	bool cancelled = false;
 	br->Run([&](agi::ProgressSink *ps) {
 		ps->SetTitle(from_wx(_("Indexing")));
 		ps->SetMessage(from_wx(_("Decoding the full track to ensure perfect frame accuracy. This will take a while!")));
-		try {
-			bs = agi::make_unique<BestVideoSource>(filename.string(), "", 0, static_cast<int>(track_info.first), false, OPT_GET("Provider/Video/BestSource/Threads")->GetInt(), 1, provider_bs::GetCacheFile(filename), &bsopts, [=](int Track, int64_t Current, int64_t Total) {
+		auto open = [&](std::string const& device) {
+			bs = agi::make_unique<BestVideoSource>(filename.string(), device, 0, static_cast<int>(track_info.first), false, OPT_GET("Provider/Video/BestSource/Threads")->GetInt(), 1, provider_bs::GetCacheFile(filename), &bsopts, [=](int Track, int64_t Current, int64_t Total) {
 				ps->SetProgress(Current, Total);
 				return !ps->IsCancelled();
 			});
+		};
+
+		try {
+			try {
+				open(hw_device);
+			} catch (BestSourceException const& err) {
+				// Not every source can be decoded by every device, so fall
+				// back to decoding on the CPU rather than failing to open
+				if (hw_device.empty() || std::string(err.what()) == "Indexing canceled by user")
+					throw;
+				LOG_W("bestsource/video") << "Hardware decoding with " << hw_device << " failed, using software decoding: " << err.what();
+				open("");
+			}
 		} catch (BestSourceException const& err) {
 			if (std::string(err.what()) == "Indexing canceled by user")
 				cancelled = true;
@@ -130,7 +165,7 @@ BSVideoProvider::BSVideoProvider(agi::fs::path const& filename, std::string cons
 	if (cancelled)
 		throw agi::UserCancelException("video loading cancelled by user");
 
-	bs->SetMaxCacheSize(OPT_GET("Provider/Video/BestSource/Max Cache Size")->GetInt() << 20);
+	SetInternalCacheSize(OPT_GET("Provider/Video/BestSource/Max Cache Size")->GetInt() << 20);
 	bs->SetSeekPreRoll(OPT_GET("Provider/Video/BestSource/Seek Preroll")->GetInt());
 
 	properties = bs->GetVideoProperties();
@@ -170,19 +205,31 @@ BSVideoProvider::BSVideoProvider(agi::fs::path const& filename, std::string cons
 	ColorMatrix::guess_colorspace(video_cs, video_cr, properties.Width, properties.Height);
 	pixfmt = (AVPixelFormat) avframe->format;
 
+	CreateScaler(properties.Width, properties.Height);
+
+	SetColorSpace(colormatrix);
+}
+catch (BestSourceException const& err) {
+	throw VideoOpenError(agi::format("Failed to create BestVideoSource: %s",  + err.what()));
+}
+
+void BSVideoProvider::CreateScaler(int width, int height) {
+	if (sws_context && width == out_width && height == out_height) return;
+
+	// Proxy frames are only for scrubbing, so favor speed over quality
+	const int flags = width == properties.Width
+		? SWS_FULL_CHR_H_INT | SWS_FULL_CHR_H_INP | SWS_ACCURATE_RND | SWS_BICUBIC
+		: SWS_FAST_BILINEAR;
 	sws_context = sws_getContext(
 			properties.Width, properties.Height, pixfmt,
-			properties.Width, properties.Height, AV_PIX_FMT_BGR0,
-			SWS_FULL_CHR_H_INT | SWS_FULL_CHR_H_INP | SWS_ACCURATE_RND | SWS_BICUBIC, nullptr, nullptr, nullptr);
+			width, height, AV_PIX_FMT_BGR0,
+			flags, nullptr, nullptr, nullptr);
 
 	if (sws_context == nullptr) {
 		throw VideoDecodeError("Cannot convert frame to RGB!");
 	}
-
-	SetColorSpace(colormatrix);
-}
-catch (BestSourceException const& err) {
-	throw VideoOpenError(agi::format("Failed to create BestVideoSource: %s",  + err.what()));
+	out_width = width;
+	out_height = height;
 }
 
 void BSVideoProvider::GetFrame(int n, VideoFrame &out) {
@@ -214,21 +261,21 @@ void BSVideoProvider::GetFrame(int n, VideoFrame &out) {
 		coefficients, cr == AVCOL_RANGE_JPEG,
 		0, 1 << 16, 1 << 16);
 
-	out.data.resize(frame->width * frame->height * 4);
+	out.data.resize(out_width * out_height * 4);
 	uint8_t *data[1] = {&out.data[0]};
-	int stride[1] = {frame->width * 4};
+	int stride[1] = {out_width * 4};
 	sws_scale(sws_context, frame->data, frame->linesize, 0, frame->height, data, stride);
 
-	out.width = frame->width;
-	out.height = frame->height;
+	out.width = out_width;
+	out.height = out_height;
 	out.pitch = stride[0];
 	out.flipped = false; 		// TODO figure out flipped
 }
 
 }
 
-std::unique_ptr<VideoProvider> CreateBSVideoProvider(agi::fs::path const& path, std::string const& colormatrix, agi::BackgroundRunner *br) {
-	return agi::make_unique<BSVideoProvider>(path, colormatrix, br);
+std::unique_ptr<VideoProvider> CreateBSVideoProvider(agi::fs::path const& path, std::string const& colormatrix, bool hw_decode, agi::BackgroundRunner *br) {
+	return agi::make_unique<BSVideoProvider>(path, colormatrix, hw_decode, br);
 }
 
 #endif /* WITH_BESTSOURCE */
@@ -20,19 +20,27 @@
 #include "video_frame.h"
 
 #include <libaegisub/make_unique.h>
+#include <libaegisub/memory_usage.h>
 
 #include <list>
+#include <unordered_map>
 
 namespace {
 /// A video frame and its frame number
 struct CachedFrame {
-	VideoFrame frame;
+	/// The frame, which is shared with callers of GetSharedFrame() and so
+	/// is never modified while anyone else holds a reference to it
+	std::shared_ptr<VideoFrame> frame = std::make_shared<VideoFrame>();
+	/// The frame before conversion to BGRA, used instead of frame if the
+	/// provider supports it
+	PlanarFrame planar;
 	int frame_number;
 
-	CachedFrame(VideoFrame const& frame, int frame_number)
-	: frame(frame), frame_number(frame_number) { }
+	CachedFrame(int frame_number) : frame_number(frame_number) { }
 
 	CachedFrame(CachedFrame const&) = delete;
+
+	size_t size() const { return frame->data.size() + planar.data.size(); }
 };
 
 /// @class VideoProviderCache
@@ -49,17 +57,109 @@ class VideoProviderCache final : public VideoProvider {
 
 	/// Cache of video frames with the most recently used ones at the front
 	std::list<CachedFrame> cache;
+	/// Frame number to position in the cache
+	std::unordered_map<int, std::list<CachedFrame>::iterator> index;
+	/// Total size of the frame data in the cache in bytes
+	size_t total_size = 0;
+
+	/// The cache for the other frame size, which is kept while proxy frames
+	/// are being decoded so that switching back is instant
+	std::list<CachedFrame> parked_cache;
+	std::unordered_map<int, std::list<CachedFrame>::iterator> parked_index;
+	size_t parked_size = 0;
+	/// Current proxy divisor, where the proxy cache gets a share of the
+	/// space proportional to its frame size
+	int proxy_divisor = 1;
+
+	/// Whether to cache frames before they're converted to BGRA, which is
+	/// turned off if the provider turns out not to support it
+	bool planar = OPT_GET("Provider/Video/Cache/Planar")->GetBool();
+
+	VideoFrameCacheStats stats;
+
+	agi::memory::Counter memory{"Video frame cache", max_cache_size};
+
+	void UpdateMemoryUsage() {
+		memory.Set(total_size + parked_size);
+	}
+
+	void Clear() {
+		cache.clear();
+		index.clear();
+		total_size = 0;
+		UpdateMemoryUsage();
+	}
+
+	/// Size limit of the cache for the current frame size
+	size_t CacheLimit() const {
+		return max_cache_size / (size_t(proxy_divisor) * proxy_divisor);
+	}
+
+	/// Get a buffer at the front of the cache for frame n, reusing the least
+	/// recently used frame's buffer if the cache is full
+	CachedFrame &Allocate(int n);
+
+	/// Decode frame n into a new entry at the front of the cache
+	CachedFrame &Insert(int n);
+
+	/// Copy or convert a cached frame into a frame for the caller
+	void Output(CachedFrame const& entry, VideoFrame &out);
 
 public:
 	VideoProviderCache(std::unique_ptr<VideoProvider> master) : master(std::move(master)) { }
 
 	void GetFrame(int n, VideoFrame &frame) override;
+	std::shared_ptr<const VideoFrame> GetSharedFrame(int n, std::shared_ptr<VideoFrame> buffer) override;
+	void GetFrameUncached(int n, VideoFrame &frame) override;
+	void PrefetchFrame(int n) override;
+
+	std::unique_ptr<VideoProvider> OpenSeekDecoder() override { return master->OpenSeekDecoder(); }
+	bool GetHighDepthFrame(int n, VideoFrame &frame) override { return master->GetHighDepthFrame(n, frame); }
+	void SetInterruptCheck(std::function<bool ()> interrupted) override { master->SetInterruptCheck(std::move(interrupted)); }
+	void TrimCache(bool all) override;
+
+	int GetCachedFrameLimit() const override {
+		const size_t frame_size = cache.empty()
+			? size_t(master->GetWidth()) * master->GetHeight() * 4
+			: total_size / cache.size();
+		return frame_size ? static_cast<int>(CacheLimit() / frame_size) : 0;
+	}
+
+	bool SetProxyScale(int divisor) override {
+		if (divisor == proxy_divisor) return true;
+		if (!master->SetProxyScale(divisor)) return false;
+
+		// Going from one proxy size to another can't reuse anything
+		if (divisor != 1 && proxy_divisor != 1)
+			Clear();
+		else {
+			std::swap(cache, parked_cache);
+			std::swap(index, parked_index);
+			std::swap(total_size, parked_size);
+		}
+		proxy_divisor = divisor;
+		return true;
+	}
 
 	void SetColorSpace(std::string const& m) override {
-		cache.clear();
+		// Planar frames are converted on the way out, so they stay valid
+		if (!planar) {
+			Clear();
+			parked_cache.clear();
+			parked_index.clear();
+			parked_size = 0;
+			UpdateMemoryUsage();
+		}
 		return master->SetColorSpace(m);
 	}
 
+	VideoFrameCacheStats GetCacheStats() const override {
+		auto ret = stats;
+		ret.frames = cache.size();
+		ret.bytes = total_size;
+		return ret;
+	}
+
 	int GetFrameCount() const override             { return master->GetFrameCount(); }
 	int GetWidth() const override                  { return master->GetWidth(); }
 	int GetHeight() const override                 { return master->GetHeight(); }
@@ -75,27 +175,117 @@ public:
 };
 
 void VideoProviderCache::GetFrame(int n, VideoFrame &out) {
-	size_t total_size = 0;
+	auto it = index.find(n);
+	if (it != index.end()) {
+		++stats.hits;
+		cache.splice(cache.begin(), cache, it->second); // Move to front
+		Output(cache.front(), out);
+		return;
+	}
 
-	for (auto cur = cache.begin(); cur != cache.end(); ++cur) {
-		if (cur->frame_number == n) {
-			cache.splice(cache.begin(), cache, cur); // Move to front
-			out = cache.front().frame;
-			return;
-		}
+	++stats.misses;
+	Output(Insert(n), out);
+}
+
+std::shared_ptr<const VideoFrame> VideoProviderCache::GetSharedFrame(int n, std::shared_ptr<VideoFrame> buffer) {
+	auto it = index.find(n);
+	if (it != index.end()) {
+		++stats.hits;
+		cache.splice(cache.begin(), cache, it->second); // Move to front
+	}
+	else {
+		++stats.misses;
+		Insert(n);
+	}
+
+	auto& entry = cache.front();
+	if (entry.planar.data.empty())
+		return entry.frame;
+
+	master->ConvertFrame(entry.planar, *buffer);
+	return buffer;
+}
+
+void VideoProviderCache::GetFrameUncached(int n, VideoFrame &out) {
+	auto it = index.find(n);
+	if (it != index.end())
+		Output(*it->second, out);
+	else
+		master->GetFrame(n, out);
+}
 
-		total_size += cur->frame.data.size();
+void VideoProviderCache::PrefetchFrame(int n) {
+	if (!index.count(n))
+		Insert(n);
+}
+
+void VideoProviderCache::TrimCache(bool all) {
+	// The other frame size's cache is never the one being looked at
+	parked_cache.clear();
+	parked_index.clear();
+	parked_size = 0;
+
+	const size_t keep = all ? 0 : total_size / 2;
+	while (total_size > keep && !cache.empty()) {
+		total_size -= cache.back().size();
+		index.erase(cache.back().frame_number);
+		cache.pop_back();
+		++stats.evictions;
 	}
+	UpdateMemoryUsage();
+	master->TrimCache(all);
+}
 
-	master->GetFrame(n, out);
+void VideoProviderCache::Output(CachedFrame const& entry, VideoFrame &out) {
+	if (!entry.planar.data.empty()) {
+		master->ConvertFrame(entry.planar, out);
+		return;
+	}
+
+	// The caller draws subtitles onto the frame, so it has to get a copy.
+	// The buffers it passes in are recycled, so this doesn't allocate.
+	out = *entry.frame;
+}
 
-	if (total_size >= max_cache_size) {
+CachedFrame &VideoProviderCache::Insert(int n) {
+	auto& entry = Allocate(n);
+	try {
+		// Providers which can't produce planar frames say so on the first one
+		if (!planar || !master->GetPlanarFrame(n, entry.planar)) {
+			planar = false;
+			entry.planar.data.clear();
+			master->GetFrame(n, *entry.frame);
+		}
+	}
+	catch (...) {
+		index.erase(n);
+		cache.pop_front();
+		UpdateMemoryUsage();
+		throw;
+	}
+	total_size += entry.size();
+	UpdateMemoryUsage();
+	return entry;
+}
+
+CachedFrame &VideoProviderCache::Allocate(int n) {
+	// Stop growing if everything together is over the memory budget
+	if ((total_size >= CacheLimit() || agi::memory::OverBudget()) && !cache.empty()) {
+		++stats.evictions;
+		auto& oldest = cache.back();
+		index.erase(oldest.frame_number);
+		total_size -= oldest.size();
 		cache.splice(cache.begin(), cache, --cache.end()); // Move last to front
 		cache.front().frame_number = n;
-		cache.front().frame = out;
+		// Reuse the frame's allocation unless a caller still has it
+		if (cache.front().frame.use_count() > 1)
+			cache.front().frame = std::make_shared<VideoFrame>();
 	}
 	else
-		cache.emplace_front(out, n);
+		cache.emplace_front(n);
+
+	index[n] = cache.begin();
+	return cache.front();
 }
 }
 
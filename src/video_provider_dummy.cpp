@@ -130,7 +130,7 @@ void DummyVideoProvider::GetFrame(int, VideoFrame &frame) {
 }
 
 namespace agi { class BackgroundRunner; }
-std::unique_ptr<VideoProvider> CreateDummyVideoProvider(agi::fs::path const& filename, std::string const&, agi::BackgroundRunner *) {
+std::unique_ptr<VideoProvider> CreateDummyVideoProvider(agi::fs::path const& filename, std::string const&, bool, agi::BackgroundRunner *) {
 	// Use filename.generic_string here so forward slashes stay as they are
 	if (!boost::starts_with(filename.generic_string(), "?dummy"))
 		return {};
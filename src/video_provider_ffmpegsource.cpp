@@ -43,6 +43,8 @@
 #include <libaegisub/fs.h>
 #include <libaegisub/make_unique.h>
 
+#include <cstring>
+
 namespace {
 /// @class FFmpegSourceVideoProvider
 /// @brief Implements video loading through the FFMS library.
@@ -53,8 +55,14 @@ class FFmpegSourceVideoProvider final : public VideoProvider, FFmpegSourceProvid
 
 	int Width = -1;                 ///< width in pixels
 	int Height = -1;                ///< height in pixels
+	int OutWidth = -1;              ///< width of the frames output, before rotation
+	int OutHeight = -1;             ///< height of the frames output, before rotation
+	bool OutHighDepth = false;      ///< whether frames are output as 16-bit YUV
+	bool HighDepth = false;         ///< whether the video has more than 8 bits per sample
 	int VideoCS = -1;               ///< Reported colorspace of first frame (or guessed if unspecified)
 	int VideoCR = -1;               ///< Reported colorrange of first frame (or guessed if unspecified)
+	int OutCS = -1;                 ///< Colorspace the video is being converted from
+	int OutCR = -1;                 ///< Colorrange the video is being converted from
 	double DAR;                     ///< display aspect ratio
 	std::vector<int> KeyFramesList; ///< list of keyframes
 	agi::vfr::Framerate Timecodes;  ///< vfr object
@@ -64,12 +72,29 @@ class FFmpegSourceVideoProvider final : public VideoProvider, FFmpegSourceProvid
 	FFMS_ErrorInfo ErrInfo;         ///< FFMS error codes/messages
 	bool has_audio = false;
 
+	agi::fs::path Filename;         ///< file the video was opened from
+	agi::fs::path CacheName;        ///< index file for the video
+	int TrackNumber = -1;           ///< track being decoded
+	int Threads = -1;               ///< number of decoding threads
+	int SeekMode = FFMS_SEEK_NORMAL; ///< seeking mode to open it with
+
+	/// Open another decoder for the same track as src
+	FFmpegSourceVideoProvider(FFmpegSourceVideoProvider const& src, FFMS_Index *Index);
+
 	void LoadVideo(agi::fs::path const& filename, std::string const& colormatrix);
+	void SetOutputSize(int width, int height, bool high_depth);
 
 public:
 	FFmpegSourceVideoProvider(agi::fs::path const& filename, std::string const& colormatrix, agi::BackgroundRunner *br);
 
 	void GetFrame(int n, VideoFrame &out) override;
+	bool GetHighDepthFrame(int n, VideoFrame &out) override;
+	std::unique_ptr<VideoProvider> OpenSeekDecoder() override;
+
+	bool SetProxyScale(int divisor) override {
+		SetOutputSize(ProxyDimension(Width, divisor), ProxyDimension(Height, divisor), OutHighDepth);
+		return true;
+	}
 
 	void SetColorSpace(std::string const& matrix) override {
 		if (matrix == ColorSpace) return;
@@ -82,6 +107,8 @@ public:
 			throw VideoOpenError(std::string("Failed to set input format: ") + ErrInfo.Buffer);
 
 		ColorSpace = matrix;
+		OutCS = CS;
+		OutCR = CR;
 	}
 
 	int GetFrameCount() const override             { return VideoInfo->NumFrames; }
@@ -128,7 +155,50 @@ catch (agi::EnvironmentError const& err) {
 	throw VideoOpenError(err.GetMessage());
 }
 
+FFmpegSourceVideoProvider::FFmpegSourceVideoProvider(FFmpegSourceVideoProvider const& src, FFMS_Index *Index)
+: FFmpegSourceProvider(nullptr)
+, VideoSource(nullptr, FFMS_DestroyVideoSource)
+, Width(src.Width)
+, Height(src.Height)
+, VideoCS(src.VideoCS)
+, VideoCR(src.VideoCR)
+, DAR(src.DAR)
+, KeyFramesList(src.KeyFramesList)
+, Timecodes(src.Timecodes)
+, has_audio(src.has_audio)
+, Filename(src.Filename)
+, CacheName(src.CacheName)
+, TrackNumber(src.TrackNumber)
+, Threads(src.Threads)
+, SeekMode(src.SeekMode)
+{
+	ErrInfo.Buffer		= FFMSErrMsg;
+	ErrInfo.BufferSize	= sizeof(FFMSErrMsg);
+	ErrInfo.ErrorType	= FFMS_ERROR_SUCCESS;
+	ErrInfo.SubType		= FFMS_ERROR_SUCCESS;
+
+	VideoSource = FFMS_CreateVideoSource(Filename.string().c_str(), TrackNumber, Index, Threads, SeekMode, &ErrInfo);
+	if (!VideoSource)
+		throw VideoOpenError(std::string("Failed to open video track: ") + ErrInfo.Buffer);
+	VideoInfo = FFMS_GetVideoProperties(VideoSource);
+
+	HighDepth = src.HighDepth;
+	SetColorSpace(src.ColorSpace);
+	SetOutputSize(src.OutWidth, src.OutHeight, false);
+}
+
+std::unique_ptr<VideoProvider> FFmpegSourceVideoProvider::OpenSeekDecoder() {
+	// The index was written when this decoder was opened, so it only has to
+	// be read back rather than built again
+	agi::scoped_holder<FFMS_Index*, void (FFMS_CC*)(FFMS_Index*)>
+		Index(FFMS_ReadIndex(CacheName.string().c_str(), &ErrInfo), FFMS_DestroyIndex);
+	if (!Index)
+		return nullptr;
+	return std::unique_ptr<VideoProvider>(new FFmpegSourceVideoProvider(*this, Index));
+}
+
 void FFmpegSourceVideoProvider::LoadVideo(agi::fs::path const& filename, std::string const& colormatrix) {
+	Filename = filename;
 	FFMS_Indexer *Indexer = FFMS_CreateIndexer(filename.string().c_str(), &ErrInfo);
 	if (!Indexer) {
 		if (ErrInfo.SubType == FFMS_ERROR_FILE_READ)
@@ -141,7 +211,7 @@ void FFmpegSourceVideoProvider::LoadVideo(agi::fs::path const& filename, std::st
 	if (TrackList.size() <= 0)
 		throw VideoNotSupported("no video tracks found");
 
-	int TrackNumber = -1;
+	TrackNumber = -1;
 	if (TrackList.size() > 1) {
 		auto Selection = AskForTrackSelection(TrackList, FFMS_TYPE_VIDEO);
 		if (Selection == TrackSelection::None)
@@ -150,7 +220,7 @@ void FFmpegSourceVideoProvider::LoadVideo(agi::fs::path const& filename, std::st
 	}
 
 	// generate a name for the cache file
-	auto CacheName = GetCacheFilename(filename);
+	CacheName = GetCacheFilename(filename);
 
 	// try to read index
 	agi::scoped_holder<FFMS_Index*, void (FFMS_CC*)(FFMS_Index*)>
@@ -197,7 +267,7 @@ void FFmpegSourceVideoProvider::LoadVideo(agi::fs::path const& filename, std::st
 	has_audio = FFMS_GetFirstTrackOfType(Index, FFMS_TYPE_AUDIO, nullptr) != -1;
 
 	// set thread count
-	int Threads = OPT_GET("Provider/Video/FFmpegSource/Decoding Threads")->GetInt();
+	Threads = OPT_GET("Provider/Video/FFmpegSource/Decoding Threads")->GetInt();
 #if FFMS_VERSION < ((2 << 24) | (30 << 16) | (0 << 8) | 0)
 	if (FFMS_GetVersion() < ((2 << 24) | (17 << 16) | (2 << 8) | 1) && FFMS_GetSourceType(Index) == FFMS_SOURCE_LAVF)
 		Threads = 1;
@@ -205,7 +275,6 @@ void FFmpegSourceVideoProvider::LoadVideo(agi::fs::path const& filename, std::st
 
 	// set seekmode
 	// TODO: give this its own option?
-	int SeekMode;
 	if (OPT_GET("Provider/Video/FFmpegSource/Unsafe Seeking")->GetBool())
 		SeekMode = FFMS_SEEK_UNSAFE;
 	else
@@ -233,11 +302,15 @@ void FFmpegSourceVideoProvider::LoadVideo(agi::fs::path const& filename, std::st
 	VideoCR = TempFrame->ColorRange;
 	ColorMatrix::guess_colorspace(VideoCS, VideoCR, Width, Height);
 
+	for (const char *fmt : {"yuv420p10le", "yuv420p12le", "yuv420p16le", "p010le", "p016le",
+		"yuv422p10le", "yuv422p12le", "yuv444p10le", "yuv444p12le", "yuv444p16le"}) {
+		if (TempFrame->EncodedPixelFormat == FFMS_GetPixFmt(fmt))
+			HighDepth = true;
+	}
+
 	SetColorSpace(colormatrix);
 
-	const int TargetFormat[] = { FFMS_GetPixFmt("bgra"), -1 };
-	if (FFMS_SetOutputFormatV2(VideoSource, TargetFormat, Width, Height, FFMS_RESIZER_BICUBIC, &ErrInfo))
-		throw VideoOpenError(std::string("Failed to set output format: ") + ErrInfo.Buffer);
+	SetOutputSize(Width, Height, false);
 
 	// get frame info data
 	FFMS_Track *FrameData = FFMS_GetTrackFromVideo(VideoSource);
@@ -268,70 +341,123 @@ void FFmpegSourceVideoProvider::LoadVideo(agi::fs::path const& filename, std::st
 		Timecodes = agi::vfr::Framerate(TimecodesVector);
 }
 
+void FFmpegSourceVideoProvider::SetOutputSize(int width, int height, bool high_depth) {
+	if (width == OutWidth && height == OutHeight && high_depth == OutHighDepth) return;
+
+	// Proxy frames are only for scrubbing, so favor speed over quality
+	const int TargetFormat[] = { FFMS_GetPixFmt(high_depth ? "yuv420p16le" : "bgra"), -1 };
+	const int Resizer = width == Width ? FFMS_RESIZER_BICUBIC : FFMS_RESIZER_FAST_BILINEAR;
+	if (FFMS_SetOutputFormatV2(VideoSource, TargetFormat, width, height, Resizer, &ErrInfo))
+		throw VideoOpenError(std::string("Failed to set output format: ") + ErrInfo.Buffer);
+	OutWidth = width;
+	OutHeight = height;
+	OutHighDepth = high_depth;
+}
+
+bool FFmpegSourceVideoProvider::GetHighDepthFrame(int n, VideoFrame &out) {
+	if (!HighDepth) return false;
+	// Flipping and rotating are only done for BGRA frames
+#if FFMS_VERSION >= ((2 << 24) | (24 << 16) | (0 << 8) | 0)
+	if (VideoInfo->Rotation % 360 != 0) return false;
+#endif
+#if FFMS_VERSION >= ((2 << 24) | (31 << 16) | (0 << 8) | 0)
+	if (VideoInfo->Flip != 0) return false;
+#endif
+
+	n = mid(0, n, GetFrameCount() - 1);
+	SetOutputSize(OutWidth, OutHeight, true);
+
+	auto frame = FFMS_GetFrame(VideoSource, n, &ErrInfo);
+	if (!frame)
+		throw VideoDecodeError(std::string("Failed to retrieve frame: ") +  ErrInfo.Buffer);
+
+	const int cw = (OutWidth + 1) / 2, ch = (OutHeight + 1) / 2;
+	out.data.resize((static_cast<size_t>(OutWidth) * OutHeight + 2 * cw * ch) * 2);
+	unsigned char *dst = out.data.data();
+	for (int plane = 0; plane < 3; ++plane) {
+		const int row_size = (plane ? cw : OutWidth) * 2;
+		const int rows = plane ? ch : OutHeight;
+		for (int y = 0; y < rows; ++y, dst += row_size)
+			memcpy(dst, frame->Data[plane] + y * frame->Linesize[plane], row_size);
+	}
+
+	out.width = OutWidth;
+	out.height = OutHeight;
+	out.pitch = OutWidth * 2;
+	out.flipped = false;
+	out.format = VideoFrame::Format::YUV420P16;
+	out.colorspace = OutCS >= 0 ? OutCS : VideoCS;
+	out.color_range = OutCR >= 0 ? OutCR : VideoCR;
+	out.transfer = frame->TransferCharateristics;
+	return true;
+}
+
 void FFmpegSourceVideoProvider::GetFrame(int n, VideoFrame &out) {
 	n = mid(0, n, GetFrameCount() - 1);
+	SetOutputSize(OutWidth, OutHeight, false);
 
 	auto frame = FFMS_GetFrame(VideoSource, n, &ErrInfo);
 	if (!frame)
 		throw VideoDecodeError(std::string("Failed to retrieve frame: ") +  ErrInfo.Buffer);
 
-	out.data.assign(frame->Data[0], frame->Data[0] + frame->Linesize[0] * Height);
+	out.data.assign(frame->Data[0], frame->Data[0] + frame->Linesize[0] * OutHeight);
 	out.flipped = false;
-	out.width = Width;
-	out.height = Height;
+	out.format = VideoFrame::Format::BGRA;
+	out.width = OutWidth;
+	out.height = OutHeight;
 	out.pitch = frame->Linesize[0];
 #if FFMS_VERSION >= ((2 << 24) | (31 << 16) | (0 << 8) | 0)
 	// Handle flip
 	if (VideoInfo->Flip > 0)
-		for (int x = 0; x < Height; ++x)
-			for (int y = 0; y < Width / 2; ++y)
+		for (int x = 0; x < OutHeight; ++x)
+			for (int y = 0; y < OutWidth / 2; ++y)
 				for (int ch = 0; ch < 4; ++ch)
-					std::swap(out.data[frame->Linesize[0] * x + 4 * y + ch], out.data[frame->Linesize[0] * x + 4 * (Width - 1 - y) + ch]);
+					std::swap(out.data[frame->Linesize[0] * x + 4 * y + ch], out.data[frame->Linesize[0] * x + 4 * (OutWidth - 1 - y) + ch]);
 
 	else if (VideoInfo->Flip < 0)
-		for (int x = 0; x < Height / 2; ++x)
-			for (int y = 0; y < Width; ++y)
+		for (int x = 0; x < OutHeight / 2; ++x)
+			for (int y = 0; y < OutWidth; ++y)
 				for (int ch = 0; ch < 4; ++ch)
-					std::swap(out.data[frame->Linesize[0] * x + 4 * y + ch], out.data[frame->Linesize[0] * (Height - 1 - x) + 4 * y + ch]);
+					std::swap(out.data[frame->Linesize[0] * x + 4 * y + ch], out.data[frame->Linesize[0] * (OutHeight - 1 - x) + 4 * y + ch]);
 #endif
 #if FFMS_VERSION >= ((2 << 24) | (24 << 16) | (0 << 8) | 0)
 	// Handle rotation
 	if (VideoInfo->Rotation % 360 == 180 || VideoInfo->Rotation % 360 == -180) {
 		std::vector<unsigned char> data(std::move(out.data));
-		out.data.resize(Width * Height * 4);
-		for (int x = 0; x < Height; ++x)
-			for (int y = 0; y < Width; ++y)
+		out.data.resize(OutWidth * OutHeight * 4);
+		for (int x = 0; x < OutHeight; ++x)
+			for (int y = 0; y < OutWidth; ++y)
 				for (int ch = 0; ch < 4; ++ch)
-					out.data[4 * (Width * x + y) + ch] = data[frame->Linesize[0] * (Height - 1 - x) + 4 * (Width - 1 - y) + ch];
-		out.pitch = 4 * Width;
+					out.data[4 * (OutWidth * x + y) + ch] = data[frame->Linesize[0] * (OutHeight - 1 - x) + 4 * (OutWidth - 1 - y) + ch];
+		out.pitch = 4 * OutWidth;
 	}
 	else if (VideoInfo->Rotation % 180 == 90 || VideoInfo->Rotation % 360 == -270) {
 		std::vector<unsigned char> data(std::move(out.data));
-		out.data.resize(Width * Height * 4);
-		for (int x = 0; x < Width; ++x)
-			for (int y = 0; y < Height; ++y)
+		out.data.resize(OutWidth * OutHeight * 4);
+		for (int x = 0; x < OutWidth; ++x)
+			for (int y = 0; y < OutHeight; ++y)
 				for (int ch = 0; ch < 4; ++ch)
-					out.data[4 * (Height * x + y) + ch] = data[frame->Linesize[0] * y + 4 * (Width - 1 - x) + ch];
-		out.width = Height;
-		out.height = Width;
-		out.pitch = 4 * Height;
+					out.data[4 * (OutHeight * x + y) + ch] = data[frame->Linesize[0] * y + 4 * (OutWidth - 1 - x) + ch];
+		out.width = OutHeight;
+		out.height = OutWidth;
+		out.pitch = 4 * OutHeight;
 	}
 	else if (VideoInfo->Rotation % 180 == 270 || VideoInfo->Rotation % 360 == -90) {
 		std::vector<unsigned char> data(std::move(out.data));
-		out.data.resize(Width * Height * 4);
-		for (int x = 0; x < Width; ++x)
-			for (int y = 0; y < Height; ++y)
+		out.data.resize(OutWidth * OutHeight * 4);
+		for (int x = 0; x < OutWidth; ++x)
+			for (int y = 0; y < OutHeight; ++y)
 				for (int ch = 0; ch < 4; ++ch)
-					out.data[4 * (Height * x + y) + ch] = data[frame->Linesize[0] * (Height - 1 - y) + 4 * x + ch];
-		out.width = Height;
-		out.height = Width;
-		out.pitch = 4 * Height;
+					out.data[4 * (OutHeight * x + y) + ch] = data[frame->Linesize[0] * (OutHeight - 1 - y) + 4 * x + ch];
+		out.width = OutHeight;
+		out.height = OutWidth;
+		out.pitch = 4 * OutHeight;
 	}
 #endif
 }
 }
 
-std::unique_ptr<VideoProvider> CreateFFmpegSourceVideoProvider(agi::fs::path const& path, std::string const& colormatrix, agi::BackgroundRunner *br) {
+std::unique_ptr<VideoProvider> CreateFFmpegSourceVideoProvider(agi::fs::path const& path, std::string const& colormatrix, bool, agi::BackgroundRunner *br) {
 	return agi::make_unique<FFmpegSourceVideoProvider>(path, colormatrix, br);
 }
 
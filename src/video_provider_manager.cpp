@@ -25,19 +25,29 @@
 #include <libaegisub/format.h>
 #include <libaegisub/split.h>
 
+#include <algorithm>
 #include <boost/range/iterator_range.hpp>
 
 #include <wx/choicdlg.h>
 
-std::unique_ptr<VideoProvider> CreateDummyVideoProvider(agi::fs::path const&, std::string const&, agi::BackgroundRunner *);
-std::unique_ptr<VideoProvider> CreateYUV4MPEGVideoProvider(agi::fs::path const&, std::string const&, agi::BackgroundRunner *);
-std::unique_ptr<VideoProvider> CreateFFmpegSourceVideoProvider(agi::fs::path const&, std::string const&, agi::BackgroundRunner *);
-std::unique_ptr<VideoProvider> CreateAvisynthVideoProvider(agi::fs::path const&, std::string const&, agi::BackgroundRunner *);
-std::unique_ptr<VideoProvider> CreateBSVideoProvider(agi::fs::path const&, std::string const&, agi::BackgroundRunner *);
-std::unique_ptr<VideoProvider> CreateVapourSynthVideoProvider(agi::fs::path const&, std::string const&, agi::BackgroundRunner *);
+std::unique_ptr<VideoProvider> CreateDummyVideoProvider(agi::fs::path const&, std::string const&, bool, agi::BackgroundRunner *);
+std::unique_ptr<VideoProvider> CreateYUV4MPEGVideoProvider(agi::fs::path const&, std::string const&, bool, agi::BackgroundRunner *);
+std::unique_ptr<VideoProvider> CreateFFmpegSourceVideoProvider(agi::fs::path const&, std::string const&, bool, agi::BackgroundRunner *);
+std::unique_ptr<VideoProvider> CreateAvisynthVideoProvider(agi::fs::path const&, std::string const&, bool, agi::BackgroundRunner *);
+std::unique_ptr<VideoProvider> CreateBSVideoProvider(agi::fs::path const&, std::string const&, bool, agi::BackgroundRunner *);
+std::unique_ptr<VideoProvider> CreateVapourSynthVideoProvider(agi::fs::path const&, std::string const&, bool, agi::BackgroundRunner *);
 
 std::unique_ptr<VideoProvider> CreateCacheVideoProvider(std::unique_ptr<VideoProvider>);
 
+std::unique_ptr<VideoIndexJob> CreateFFmpegSourceIndexJob(agi::fs::path const&, std::function<void (int)>, std::function<void (std::string const&)>);
+
+namespace {
+/// Smallest cache of decoded frames to leave a provider with when the frame
+/// cache takes its share, so that it can still hold the frames decoded while
+/// seeking to one
+const size_t min_internal_cache_size = 128 << 20;
+}
+
 namespace ColorMatrix {
 
 std::string colormatrix_description(int cs, int cr) {
@@ -109,7 +119,7 @@ void override_colormatrix(int &CS, int &CR, std::string matrix, int Width, int H
 namespace {
 	struct factory {
 		const char *name;
-		std::unique_ptr<VideoProvider> (*create)(agi::fs::path const&, std::string const&, agi::BackgroundRunner *);
+		std::unique_ptr<VideoProvider> (*create)(agi::fs::path const&, std::string const&, bool, agi::BackgroundRunner *);
 		bool hidden;
 		std::function<bool(agi::fs::path const&)> wants_to_open = [](auto p) { return false; };
 	};
@@ -136,7 +146,15 @@ std::vector<std::string> VideoProviderFactory::GetClasses() {
 	return ::GetClasses(boost::make_iterator_range(std::begin(providers), std::end(providers)));
 }
 
-std::unique_ptr<VideoProvider> VideoProviderFactory::GetProvider(agi::fs::path const& filename, std::string const& colormatrix, agi::BackgroundRunner *br) {
+std::unique_ptr<VideoProvider> VideoProviderFactory::CreateProvider(std::string const& name, agi::fs::path const& filename, std::string const& colormatrix, bool hw_decode, agi::BackgroundRunner *br) {
+	for (auto const& provider : providers) {
+		if (provider.name == name)
+			return provider.create(filename, colormatrix, hw_decode, br);
+	}
+	return nullptr;
+}
+
+std::unique_ptr<VideoProvider> VideoProviderFactory::GetProvider(agi::fs::path const& filename, std::string const& colormatrix, bool hw_decode, agi::BackgroundRunner *br) {
 	auto preferred = OPT_GET("Video/Provider")->GetString();
 
 	if (!std::any_of(std::begin(providers), std::end(providers), [&](factory provider) { return provider.name == preferred; })) {
@@ -155,14 +173,23 @@ std::unique_ptr<VideoProvider> VideoProviderFactory::GetProvider(agi::fs::path c
 	auto tried_providers = sorted.begin();
 
 	auto finalize_provider = [&](std::unique_ptr<VideoProvider> provider) {
-		return provider->WantsCaching() ? CreateCacheVideoProvider(std::move(provider)) : std::move(provider);
+		if (!provider->WantsCaching()) return provider;
+
+		// Providers which cache decoded frames themselves share their budget
+		// with the frame cache, which holds the frames after conversion
+		if (size_t internal = provider->GetInternalCacheSize()) {
+			const size_t frame_cache = OPT_GET("Provider/Video/Cache/Size")->GetInt() << 20;
+			const size_t remaining = internal > frame_cache ? internal - frame_cache : 0;
+			provider->SetInternalCacheSize(std::min(internal, std::max(remaining, min_internal_cache_size)));
+		}
+		return CreateCacheVideoProvider(std::move(provider));
 	};
 
 	for (; tried_providers < sorted.end(); tried_providers++) {
 		auto factory = *tried_providers;
 		std::string err;
 		try {
-			auto provider = factory->create(filename, colormatrix, br);
+			auto provider = factory->create(filename, colormatrix, hw_decode, br);
 			if (!provider) {
 				err = "Failed to create provider."; 	// Some generic error message here
 			} else {
@@ -214,7 +241,7 @@ std::unique_ptr<VideoProvider> VideoProviderFactory::GetProvider(agi::fs::path c
 
 	try {
 		auto factory = remaining_providers[choice];
-		auto provider = factory->create(filename, colormatrix, br);
+		auto provider = factory->create(filename, colormatrix, hw_decode, br);
 		if (!provider)
 			throw VideoNotSupported("Video provider returned null pointer");
 		LOG_I("manager/video/provider") << factory->name << ": opened " << filename;
@@ -223,3 +250,11 @@ std::unique_ptr<VideoProvider> VideoProviderFactory::GetProvider(agi::fs::path c
 		throw VideoOpenError(ex.GetMessage());
 	}
 }
+
+std::unique_ptr<VideoIndexJob> VideoProviderFactory::IndexInBackground(agi::fs::path const& filename, std::function<void (int)> progress, std::function<void (std::string const&)> done) {
+#ifdef WITH_FFMS2
+	if (OPT_GET("Provider/FFmpegSource/Background Indexing")->GetBool() && OPT_GET("Video/Provider")->GetString() == "FFmpegSource")
+		return CreateFFmpegSourceIndexJob(filename, std::move(progress), std::move(done));
+#endif
+	return nullptr;
+}
@@ -16,6 +16,7 @@
 
 #include <libaegisub/fs_fwd.h>
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -23,7 +24,26 @@
 class VideoProvider;
 namespace agi { class BackgroundRunner; }
 
+/// An index being built in the background; destroying it cancels it
+struct VideoIndexJob {
+	virtual ~VideoIndexJob() = default;
+};
+
 struct VideoProviderFactory {
 	static std::vector<std::string> GetClasses();
-	static std::unique_ptr<VideoProvider> GetProvider(agi::fs::path const& video_file, std::string const& colormatrix, agi::BackgroundRunner *br);
+	/// @param hw_decode Let providers which support it decode on the GPU if
+	///                  enabled in the options
+	static std::unique_ptr<VideoProvider> GetProvider(agi::fs::path const& video_file, std::string const& colormatrix, bool hw_decode, agi::BackgroundRunner *br);
+
+	/// @brief Open a file with a specific provider, without caching or falling back to others
+	/// @return The provider, or null if there is no provider with that name
+	static std::unique_ptr<VideoProvider> CreateProvider(std::string const& name, agi::fs::path const& video_file, std::string const& colormatrix, bool hw_decode, agi::BackgroundRunner *br);
+
+	/// @brief Build the index the preferred provider needs for a file without blocking
+	/// @param progress Called on the main thread with the percentage done
+	/// @param done     Called on the main thread when finished, with an error
+	///                 message or an empty string if the file can now be opened
+	/// @return The job, or null if the file can be opened without indexing
+	///         or background indexing isn't supported or is disabled
+	static std::unique_ptr<VideoIndexJob> IndexInBackground(agi::fs::path const& video_file, std::function<void (int)> progress, std::function<void (std::string const&)> done);
 };
@@ -30,6 +30,10 @@
 #include <libaegisub/path.h>
 #include <libaegisub/scoped_ptr.h>
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
 #include <mutex>
 
 #include "vapoursynth_wrap.h"
@@ -57,16 +61,55 @@ class VapourSynthVideoProvider: public VideoProvider {
 	int video_cs = -1;		// Reported or guessed color matrix of first frame
 	int video_cr = -1;		// Reported or guessed color range of first frame
 	bool has_audio = false;
-
-	agi::scoped_holder<const VSFrame *, void (*)(const VSFrame *) noexcept> GetVSFrame(VSNode *node, int n);
+	/// Divisor prepared_node scales by
+	int proxy_divisor = 1;
+
+	/// A frame of prepared_node which was requested ahead of time
+	struct PrefetchedFrame {
+		/// The frame, or null if it hasn't arrived yet or failed
+		const VSFrame *frame = nullptr;
+		std::string error;
+		bool done = false;
+		/// Set if whoever was waiting for it gave up, so that it's freed as
+		/// soon as it arrives
+		bool abandoned = false;
+	};
+	/// Number of frames after the current one to request asynchronously, so
+	/// that VapourSynth can work on several of them in parallel
+	int prefetch_window;
+	std::mutex prefetch_mutex;
+	std::condition_variable prefetch_done;
+	std::map<int, PrefetchedFrame> prefetched;
+	/// Says whether the frame being waited for is still wanted, if set
+	std::function<bool ()> interrupted;
+
+	static void VS_CC OnFrameDone(void *user_data, const VSFrame *f, int n, VSNode *node, const char *error);
+	/// Request the frames in the window after n which haven't been yet, and
+	/// drop the finished ones outside of it
+	void Prefetch(int n);
+	/// Wait for all outstanding requests and free their frames
+	void DrainPrefetch();
+
+	using FrameHolder = agi::scoped_holder<const VSFrame *, void (*)(const VSFrame *) noexcept>;
+	FrameHolder GetVSFrame(VSNode *node, int n);
+	/// Get a frame of prepared_node, waiting for it if it was prefetched
+	FrameHolder GetPreparedFrame(int n);
+	/// Create prepared_node for the given matrix and proxy divisor
+	void PrepareNode(std::string const& matrix, int divisor);
 	void SetResizeArg(VSMap *args, const VSMap *props, const char *arg_name, const char *prop_name, int64_t deflt, int64_t unspecified = -1);
 
 public:
 	VapourSynthVideoProvider(agi::fs::path const& filename, std::string const& colormatrix, agi::BackgroundRunner *br);
+	~VapourSynthVideoProvider();
 
 	void GetFrame(int n, VideoFrame &frame) override;
+	void SetInterruptCheck(std::function<bool ()> check) override { interrupted = std::move(check); }
 
-	void SetColorSpace(std::string const& matrix) override;
+	void SetColorSpace(std::string const& matrix) override { PrepareNode(matrix, proxy_divisor); }
+	bool SetProxyScale(int divisor) override {
+		PrepareNode(colorspace, divisor);
+		return true;
+	}
 
 	int GetFrameCount() const override             { return vi->numFrames; }
 	agi::vfr::Framerate GetFPS() const override    { return fps; }
@@ -92,7 +135,8 @@ VapourSynthVideoProvider::VapourSynthVideoProvider(agi::fs::path const& filename
 : vs()
 , script(nullptr, vs.GetScriptAPI()->freeScript)
 , source_node(nullptr, vs.GetAPI()->freeNode)
-, prepared_node(nullptr, vs.GetAPI()->freeNode) {
+, prepared_node(nullptr, vs.GetAPI()->freeNode)
+, prefetch_window(std::max<int>(0, OPT_GET("Provider/Video/VapourSynth/Prefetch Frames")->GetInt())) {
 	std::lock_guard<std::mutex> lock(vs.GetMutex());
 
 	VSCleanCache();
@@ -244,11 +288,21 @@ catch (VapourSynthError const& err) {
 	throw VideoOpenError(err.GetMessage());
 }
 
-void VapourSynthVideoProvider::SetColorSpace(std::string const& matrix) {
-	if (vi->format.colorFamily != cfRGB || vi->format.bitsPerSample != 8) {
-		if (matrix == colorspace && prepared_node != nullptr) {
-			return;
-		}
+VapourSynthVideoProvider::~VapourSynthVideoProvider() {
+	// The requests refer to both this and the node, so they have to be done
+	// before either goes away
+	DrainPrefetch();
+}
+
+void VapourSynthVideoProvider::PrepareNode(std::string const& matrix, int divisor) {
+	if (matrix == colorspace && divisor == proxy_divisor && prepared_node != nullptr) {
+		return;
+	}
+
+	// Frames requested from the old node would be in the wrong format
+	DrainPrefetch();
+
+	if (vi->format.colorFamily != cfRGB || vi->format.bitsPerSample != 8 || divisor > 1) {
 
 		agi::scoped_holder<VSNode *> intermediary(vs.GetAPI()->addNodeRef(source_node), vs.GetAPI()->freeNode);
 
@@ -297,6 +351,10 @@ void VapourSynthVideoProvider::SetColorSpace(std::string const& matrix) {
 		vs.GetAPI()->mapSetInt(args, "matrix_in", video_cs, maAppend);
 		vs.GetAPI()->mapSetInt(args, "range_in", video_cr == AGI_CR_JPEG, maAppend);
 		vs.GetAPI()->mapSetInt(args, "chromaloc_in", VSC_CHROMA_LEFT, maAppend);
+		if (divisor > 1) {
+			vs.GetAPI()->mapSetInt(args, "width", ProxyDimension(vi->width, divisor), maAppend);
+			vs.GetAPI()->mapSetInt(args, "height", ProxyDimension(vi->height, divisor), maAppend);
+		}
 
 		VSMap *result = vs.GetAPI()->invoke(resize, "Bicubic", args);
 		const char *error = vs.GetAPI()->mapGetError(result);
@@ -310,14 +368,16 @@ void VapourSynthVideoProvider::SetColorSpace(std::string const& matrix) {
 		}
 
 		// Finally, try to get the first frame again, so if the filter does crash, it happens before loading finishes
-		GetVSFrame(prepared_node, 0);
+		if (divisor == 1)
+			GetVSFrame(prepared_node, 0);
 	} else {
 		prepared_node = vs.GetAPI()->addNodeRef(source_node);
 	}
 	colorspace = matrix;
+	proxy_divisor = divisor;
 }
 
-agi::scoped_holder<const VSFrame *, void (*)(const VSFrame *) noexcept> VapourSynthVideoProvider::GetVSFrame(VSNode *node, int n) {
+VapourSynthVideoProvider::FrameHolder VapourSynthVideoProvider::GetVSFrame(VSNode *node, int n) {
 	char errorMsg[1024];
 	const VSFrame *frame = vs.GetAPI()->getFrame(n, node, errorMsg, sizeof(errorMsg));
 	if (frame == nullptr) {
@@ -326,10 +386,99 @@ agi::scoped_holder<const VSFrame *, void (*)(const VSFrame *) noexcept> VapourSy
 	return agi::scoped_holder(frame, vs.GetAPI()->freeFrame);
 }
 
+void VS_CC VapourSynthVideoProvider::OnFrameDone(void *user_data, const VSFrame *f, int n, VSNode *, const char *error) {
+	auto self = static_cast<VapourSynthVideoProvider *>(user_data);
+	{
+		std::lock_guard<std::mutex> lock(self->prefetch_mutex);
+		auto& entry = self->prefetched[n];
+		if (entry.abandoned) {
+			if (f)
+				self->vs.GetAPI()->freeFrame(f);
+			self->prefetched.erase(n);
+			return;
+		}
+		entry.frame = f;
+		if (!f)
+			entry.error = error ? error : "Unknown error";
+		entry.done = true;
+	}
+	self->prefetch_done.notify_all();
+}
+
+void VapourSynthVideoProvider::Prefetch(int n) {
+	const int last = std::min(n + prefetch_window, vi->numFrames - 1);
+
+	std::lock_guard<std::mutex> lock(prefetch_mutex);
+	for (auto it = prefetched.begin(); it != prefetched.end(); ) {
+		if (it->second.done && (it->first < n || it->first > last)) {
+			if (it->second.frame)
+				vs.GetAPI()->freeFrame(it->second.frame);
+			it = prefetched.erase(it);
+		}
+		else
+			++it;
+	}
+
+	for (int i = n; i <= last; ++i) {
+		if (!prefetched.emplace(i, PrefetchedFrame{}).second) continue;
+		vs.GetAPI()->getFrameAsync(i, prepared_node, OnFrameDone, this);
+	}
+}
+
+void VapourSynthVideoProvider::DrainPrefetch() {
+	std::unique_lock<std::mutex> lock(prefetch_mutex);
+	prefetch_done.wait(lock, [&] {
+		for (auto const& entry : prefetched) {
+			if (!entry.second.done) return false;
+		}
+		return true;
+	});
+
+	for (auto const& entry : prefetched) {
+		if (entry.second.frame)
+			vs.GetAPI()->freeFrame(entry.second.frame);
+	}
+	prefetched.clear();
+}
+
+VapourSynthVideoProvider::FrameHolder VapourSynthVideoProvider::GetPreparedFrame(int n) {
+	{
+		std::unique_lock<std::mutex> lock(prefetch_mutex);
+		auto it = prefetched.find(n);
+		// Frames which may stop being wanted are requested asynchronously
+		// too, so that waiting for them can be given up on
+		if (it == prefetched.end() && interrupted) {
+			it = prefetched.emplace(n, PrefetchedFrame{}).first;
+			vs.GetAPI()->getFrameAsync(n, prepared_node, OnFrameDone, this);
+		}
+		if (it != prefetched.end()) {
+			it->second.abandoned = false;
+			while (!it->second.done) {
+				if (interrupted && interrupted()) {
+					it->second.abandoned = true;
+					throw VideoDecodeCancelled("Frame " + std::to_string(n) + " is no longer wanted");
+				}
+				prefetch_done.wait_for(lock, std::chrono::milliseconds(5));
+			}
+			const VSFrame *frame = it->second.frame;
+			std::string error = std::move(it->second.error);
+			prefetched.erase(it);
+			if (!frame)
+				throw VapourSynthError(agi::format("Error getting frame: %s", error));
+			return FrameHolder(frame, vs.GetAPI()->freeFrame);
+		}
+	}
+	return GetVSFrame(prepared_node, n);
+}
+
 void VapourSynthVideoProvider::GetFrame(int n, VideoFrame &out) {
 	std::lock_guard<std::mutex> lock(vs.GetMutex());
 
-	auto frame = GetVSFrame(prepared_node, n);
+	auto frame = GetPreparedFrame(n);
+	// Queue up the frames after this one so that they're decoded while this
+	// one is being converted and displayed
+	if (prefetch_window > 0)
+		Prefetch(n + 1);
 
 	const VSVideoFormat *format = vs.GetAPI()->getVideoFrameFormat(frame);
 	if (format->colorFamily != cfRGB || format->numPlanes != 3 || format->bitsPerSample != 8 || format->subSamplingH != 0 || format->subSamplingW != 0) {
@@ -366,7 +515,7 @@ void VapourSynthVideoProvider::GetFrame(int n, VideoFrame &out) {
 }
 
 namespace agi { class BackgroundRunner; }
-std::unique_ptr<VideoProvider> CreateVapourSynthVideoProvider(agi::fs::path const& path, std::string const& colormatrix, agi::BackgroundRunner *br) {
+std::unique_ptr<VideoProvider> CreateVapourSynthVideoProvider(agi::fs::path const& path, std::string const& colormatrix, bool, agi::BackgroundRunner *br) {
 	return agi::make_unique<VapourSynthVideoProvider>(path, colormatrix, br);
 }
 #endif // WITH_VAPOURSYNTH
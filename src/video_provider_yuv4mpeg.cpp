@@ -37,13 +37,17 @@
 #include "utils.h"
 #include "video_frame.h"
 
+#include <libaegisub/dispatch.h>
 #include <libaegisub/file_mapping.h>
+#include <libaegisub/fs.h>
 #include <libaegisub/log.h>
 #include <libaegisub/make_unique.h>
 #include <libaegisub/util.h>
 #include <libaegisub/ycbcr_conv.h>
 
+#include <atomic>
 #include <boost/algorithm/string/case_conv.hpp>
+#include <cmath>
 #include <memory>
 #include <vector>
 
@@ -51,6 +55,13 @@
 #define YUV4MPEG_HEADER_MAXLEN 128
 
 namespace {
+/// Frame header with no parameters, which is what nearly everything writes
+const char plain_frame_header[] = "FRAME\n";
+const size_t plain_frame_header_len = sizeof(plain_frame_header) - 1;
+/// Number of frames whose headers each worker checks when indexing
+const size_t frames_per_index_chunk = 4096;
+/// Number of rows each worker converts at a time
+const int rows_per_convert_chunk = 64;
 
 /// @class YUV4MPEGVideoProvider
 /// @brief Implements reading of YUV4MPEG uncompressed video files
@@ -110,6 +121,7 @@ class YUV4MPEGVideoProvider final : public VideoProvider {
 		Y4M_FFLAG_C_UNKNOWN = 0x0800	/// unknown (only allowed for non-4:2:0 sampling)
 	};
 
+	agi::fs::path filename;
 	agi::read_file_mapping file;
 	bool inited = false;	/// initialization state
 
@@ -129,6 +141,10 @@ class YUV4MPEGVideoProvider final : public VideoProvider {
 	agi::vfr::Framerate fps;
 
 	agi::ycbcr_converter conv{agi::ycbcr_matrix::bt601, agi::ycbcr_range::tv};
+	/// conv as 16.16 fixed point lookup tables, where the value of channel c
+	/// of a pixel is the sum of rgb_table[c][i][component i]
+	int32_t rgb_table[3][3][256];
+	void BuildRgbTable();
 
 	/// a list of byte positions detailing where in the file
 	/// each frame header can be found
@@ -138,11 +154,15 @@ class YUV4MPEGVideoProvider final : public VideoProvider {
 	Y4M_FrameFlags ParseFrameHeader(const std::vector<std::string>& tags);
 	std::vector<std::string> ReadHeader(uint64_t &startpos);
 	int IndexFile(uint64_t pos);
+	bool IndexPlainFrames(uint64_t pos);
+	void ConvertPlanes(const unsigned char *src_y, VideoFrame &frame) const;
 
 public:
 	YUV4MPEGVideoProvider(agi::fs::path const& filename);
 
 	void GetFrame(int n, VideoFrame &frame) override;
+	bool GetPlanarFrame(int n, PlanarFrame &frame) override;
+	void ConvertFrame(PlanarFrame const& src, VideoFrame &dst) override;
 	void SetColorSpace(std::string const&) override { }
 
 	int GetFrameCount() const override             { return num_frames; }
@@ -159,7 +179,8 @@ public:
 /// @brief Constructor
 /// @param filename The filename to open
 YUV4MPEGVideoProvider::YUV4MPEGVideoProvider(agi::fs::path const& filename)
-: file(filename)
+: filename(filename)
+, file(filename)
 {
 	if (file.size() < 10)
 		throw VideoNotSupported("File is not a YUV4MPEG file (too small)");
@@ -196,6 +217,19 @@ YUV4MPEGVideoProvider::YUV4MPEGVideoProvider(agi::fs::path const& filename)
 	num_frames = IndexFile(pos);
 	if (num_frames <= 0 || seek_table.empty())
 		throw VideoOpenError("Unable to determine file length");
+
+	BuildRgbTable();
+}
+
+void YUV4MPEGVideoProvider::BuildRgbTable() {
+	auto const& matrix = conv.ycbcr_to_rgb_matrix();
+	auto const& shift = conv.ycbcr_to_rgb_shift();
+	for (int c = 0; c < 3; ++c) {
+		for (int i = 0; i < 3; ++i) {
+			for (int value = 0; value < 256; ++value)
+				rgb_table[c][i][value] = static_cast<int32_t>(std::lround(matrix[c * 3 + i] * (value + shift[i]) * 65536));
+		}
+	}
 }
 
 /// @brief Read a frame or file header at a given file position
@@ -356,6 +390,9 @@ YUV4MPEGVideoProvider::Y4M_FrameFlags YUV4MPEGVideoProvider::ParseFrameHeader(co
 /// and creates a seek table that lists the byte positions of all frames so seeking
 /// can easily be done.
 int YUV4MPEGVideoProvider::IndexFile(uint64_t pos) {
+	if (IndexPlainFrames(pos))
+		return static_cast<int>(seek_table.size());
+
 	int framecount = 0;
 
 	// the ParseFileHeader() call in LoadVideo() will already have read
@@ -387,37 +424,94 @@ int YUV4MPEGVideoProvider::IndexFile(uint64_t pos) {
 	return framecount;
 }
 
+/// @brief Index a file where every frame has a header with no parameters
+/// @return false if the file isn't like that, in which case nothing is indexed
+///
+/// Frames are then all the same distance apart, so this only has to check
+/// that each header is where it should be, which is done in parallel with a
+/// mapping of the file for each worker.
+bool YUV4MPEGVideoProvider::IndexPlainFrames(uint64_t pos) {
+	const uint64_t stride = plain_frame_header_len + frame_sz;
+	if (pos >= file.size() || (file.size() - pos) % stride)
+		return false;
+
+	const size_t count = (file.size() - pos) / stride;
+	std::atomic<bool> plain{true};
+	agi::dispatch::Parallel((count + frames_per_index_chunk - 1) / frames_per_index_chunk, [&](size_t chunk) {
+		agi::read_file_mapping chunk_file(filename);
+		const size_t end = std::min(count, (chunk + 1) * frames_per_index_chunk);
+		for (size_t i = chunk * frames_per_index_chunk; i < end && plain; ++i) {
+			if (memcmp(chunk_file.read(pos + i * stride, plain_frame_header_len), plain_frame_header, plain_frame_header_len))
+				plain = false;
+		}
+	});
+	if (!plain)
+		return false;
+
+	seek_table.resize(count);
+	for (size_t i = 0; i < count; ++i)
+		seek_table[i] = pos + i * stride + plain_frame_header_len;
+	return true;
+}
+
 void YUV4MPEGVideoProvider::GetFrame(int n, VideoFrame &frame) {
 	n = mid(0, n, num_frames - 1);
+	ConvertPlanes(reinterpret_cast<const unsigned char *>(file.read(seek_table[n], frame_sz)), frame);
+}
 
-	int uv_width = w / 2;
+bool YUV4MPEGVideoProvider::GetPlanarFrame(int n, PlanarFrame &frame) {
+	n = mid(0, n, num_frames - 1);
+	auto src = reinterpret_cast<const unsigned char *>(file.read(seek_table[n], frame_sz));
+	frame.data.assign(src, src + frame_sz);
+	frame.width = w;
+	frame.height = h;
+	frame.format = pixfmt;
+	return true;
+}
 
-	auto src_y = reinterpret_cast<const unsigned char *>(file.read(seek_table[n], luma_sz + chroma_sz * 2));
-	auto src_u = src_y + luma_sz;
-	auto src_v = src_u + chroma_sz;
+void YUV4MPEGVideoProvider::ConvertFrame(PlanarFrame const& src, VideoFrame &dst) {
+	ConvertPlanes(src.data.data(), dst);
+}
+
+void YUV4MPEGVideoProvider::ConvertPlanes(const unsigned char *src_y, VideoFrame &frame) const {
+	const int uv_width = w / 2;
+	const auto src_u = src_y + luma_sz;
+	const auto src_v = src_u + chroma_sz;
 	frame.data.resize(w * h * 4);
-	unsigned char *dst = &frame.data[0];
-
-	for (int py = 0; py < h; ++py) {
-		for (int px = 0; px < w / 2; ++px) {
-			const uint8_t u = *src_u++;
-			const uint8_t v = *src_v++;
-			for (unsigned int i = 0; i < 2; ++i) {
-				const uint8_t y = *src_y++;
-				auto rgb = conv.ycbcr_to_rgb({{y, u, v}});
-				*dst++ = rgb[2];
-				*dst++ = rgb[1];
-				*dst++ = rgb[0];
-				*dst++ = 0;
+	unsigned char *const dst = &frame.data[0];
+
+	auto clamp = [](int32_t v) -> unsigned char {
+		v = (v + 32768) >> 16;
+		return v < 0 ? 0 : v > 255 ? 255 : v;
+	};
+
+	// Each chroma sample covers two pixels of two rows, so its contributions
+	// to each channel are looked up once and shared by all four
+	agi::dispatch::Parallel((h + rows_per_convert_chunk - 1) / rows_per_convert_chunk, [&](size_t chunk) {
+		const int first = static_cast<int>(chunk) * rows_per_convert_chunk;
+		const int last = std::min(h, first + rows_per_convert_chunk);
+		std::vector<int32_t> chroma(uv_width * 3);
+		for (int py = first; py < last; ++py) {
+			if (py == first || !(py & 1)) {
+				auto u = src_u + (py / 2) * uv_width;
+				auto v = src_v + (py / 2) * uv_width;
+				for (int px = 0; px < uv_width; ++px) {
+					for (int c = 0; c < 3; ++c)
+						chroma[px * 3 + c] = rgb_table[c][1][u[px]] + rgb_table[c][2][v[px]];
+				}
 			}
-		}
 
-		// Roll back u/v on even lines
-		if (!(py & 1)) {
-			src_u -= uv_width;
-			src_v -= uv_width;
+			auto y = src_y + py * w;
+			auto out = dst + py * w * 4;
+			for (int px = 0; px < uv_width * 2; ++px, out += 4) {
+				const int32_t *uv = &chroma[(px / 2) * 3];
+				out[0] = clamp(rgb_table[2][0][y[px]] + uv[2]);
+				out[1] = clamp(rgb_table[1][0][y[px]] + uv[1]);
+				out[2] = clamp(rgb_table[0][0][y[px]] + uv[0]);
+				out[3] = 0;
+			}
 		}
-	}
+	});
 
 	frame.flipped = false;
 	frame.width = w;
@@ -427,6 +521,6 @@ void YUV4MPEGVideoProvider::GetFrame(int n, VideoFrame &frame) {
 }
 
 namespace agi { class BackgroundRunner; }
-std::unique_ptr<VideoProvider> CreateYUV4MPEGVideoProvider(agi::fs::path const& path, std::string const&, agi::BackgroundRunner *) {
+std::unique_ptr<VideoProvider> CreateYUV4MPEGVideoProvider(agi::fs::path const& path, std::string const&, bool, agi::BackgroundRunner *) {
 	return agi::make_unique<YUV4MPEGVideoProvider>(path);
 }
@@ -43,15 +43,51 @@
 #include "project.h"
 #include "utils.h"
 #include "video_controller.h"
+#include "video_thumbnails.h"
+
+#include <libaegisub/make_unique.h>
 
 #include <wx/dcbuffer.h>
+#include <wx/popupwin.h>
 #include <wx/settings.h>
 
+/// @class VideoThumbnailPopup
+/// @brief Borderless window which shows a single thumbnail above the slider
+class VideoThumbnailPopup final : public wxPopupWindow {
+	wxBitmap bitmap;
+
+public:
+	VideoThumbnailPopup(wxWindow *parent)
+	: wxPopupWindow(parent, wxBORDER_SIMPLE)
+	{
+		SetBackgroundStyle(wxBG_STYLE_PAINT);
+		Bind(wxEVT_PAINT, [=](wxPaintEvent&) {
+			wxPaintDC dc(this);
+			if (bitmap.IsOk())
+				dc.DrawBitmap(bitmap, 0, 0);
+		});
+	}
+
+	void SetThumbnail(VideoThumbnails::Thumbnail const& thumb) {
+		// wxImage wants to own its data, so the pixels have to be copied
+		auto data = static_cast<unsigned char *>(malloc(thumb.rgb.size()));
+		memcpy(data, thumb.rgb.data(), thumb.rgb.size());
+		bitmap = wxBitmap(wxImage(thumb.width, thumb.height, data));
+		SetClientSize(thumb.width, thumb.height);
+		Refresh(false);
+	}
+};
+
 VideoSlider::VideoSlider (wxWindow* parent, agi::Context *c)
 : wxWindow(parent, -1, wxDefaultPosition, wxDefaultSize, wxWANTS_CHARS | wxFULL_REPAINT_ON_RESIZE)
 , c(c)
 , connections(agi::signal::make_vector({
 	OPT_SUB("Video/Slider/Show Keyframes", [=] { Refresh(false); }),
+	OPT_SUB("Video/Slider/Show Thumbnails", [=] {
+		HidePreview();
+		thumbnails.reset();
+		UpdateThumbnails();
+	}),
 	c->videoController->AddSeekListener(&VideoSlider::SetValue, this),
 	c->project->AddVideoProviderListener(&VideoSlider::VideoOpened, this),
 	c->project->AddKeyframesListener(&VideoSlider::KeyframesChanged, this),
@@ -63,8 +99,11 @@ VideoSlider::VideoSlider (wxWindow* parent, agi::Context *c)
 
 	c->videoSlider = this;
 	VideoOpened(c->project->VideoProvider());
+	UpdateThumbnails();
 }
 
+VideoSlider::~VideoSlider() { }
+
 void VideoSlider::SetValue(int value) {
 	if (val == value) return;
 	value = mid(0, value, max);
@@ -74,6 +113,11 @@ void VideoSlider::SetValue(int value) {
 }
 
 void VideoSlider::VideoOpened(AsyncVideoProvider *provider) {
+	// The thumbnails read from the old provider, so they have to go now.
+	// New ones are started once the keyframes for the new video are known.
+	HidePreview();
+	thumbnails.reset();
+
 	if (provider) {
 		max = provider->GetFrameCount() - 1;
 		Refresh(false);
@@ -82,9 +126,43 @@ void VideoSlider::VideoOpened(AsyncVideoProvider *provider) {
 
 void VideoSlider::KeyframesChanged(std::vector<int> const& newKeyframes) {
 	keyframes = newKeyframes;
+	if (thumbnails)
+		thumbnails->SetKeyframes(keyframes);
+	else
+		UpdateThumbnails();
 	Refresh(false);
 }
 
+void VideoSlider::UpdateThumbnails() {
+	auto provider = c->project->VideoProvider();
+	if (thumbnails || !provider || !OPT_GET("Video/Slider/Show Thumbnails")->GetBool())
+		return;
+	thumbnails = agi::make_unique<VideoThumbnails>(c, provider, c->project->VideoName());
+	if (!keyframes.empty())
+		thumbnails->SetKeyframes(keyframes);
+}
+
+void VideoSlider::ShowPreview(int x) {
+	auto thumb = thumbnails ? thumbnails->Get(mid(0, GetValueAtX(x), max)) : nullptr;
+	if (!thumb) {
+		HidePreview();
+		return;
+	}
+
+	if (!preview)
+		preview = new VideoThumbnailPopup(this);
+	preview->SetThumbnail(*thumb);
+
+	wxSize size = preview->GetSize();
+	preview->Move(ClientToScreen(wxPoint(x - size.GetWidth() / 2, -size.GetHeight() - 4)));
+	preview->Show();
+}
+
+void VideoSlider::HidePreview() {
+	if (preview)
+		preview->Hide();
+}
+
 int VideoSlider::GetValueAtX(int x) {
 	int w = GetClientSize().GetWidth();
 	// Special case
@@ -110,6 +188,17 @@ BEGIN_EVENT_TABLE(VideoSlider, wxWindow)
 END_EVENT_TABLE()
 
 void VideoSlider::OnMouse(wxMouseEvent &event) {
+	// Frames are decoded at a reduced size while dragging, if enabled
+	if (event.Dragging() && event.LeftIsDown())
+		c->videoController->SetScrubbing(true);
+	else if (event.LeftUp() || event.Leaving())
+		c->videoController->SetScrubbing(false);
+
+	if (event.Leaving() || event.LeftIsDown())
+		HidePreview();
+	else if (event.Moving())
+		ShowPreview(event.GetX());
+
 	bool had_focus = HasFocus();
 	if (event.ButtonDown())
 		SetFocus();
@@ -29,6 +29,7 @@
 
 #include <libaegisub/signal.h>
 
+#include <memory>
 #include <vector>
 #include <wx/window.h>
 
@@ -36,6 +37,8 @@ namespace agi { struct Context; }
 
 class VideoController;
 class AsyncVideoProvider;
+class VideoThumbnails;
+class VideoThumbnailPopup;
 
 /// @class VideoSlider
 /// @brief Slider for displaying and adjusting the video position
@@ -47,6 +50,15 @@ class VideoSlider: public wxWindow {
 	int val = 0; ///< Current frame number
 	int max = 1; ///< Last frame number
 
+	std::unique_ptr<VideoThumbnails> thumbnails; ///< Thumbnails shown when hovering
+	VideoThumbnailPopup *preview = nullptr; ///< Window the thumbnails are shown in
+
+	/// Start making thumbnails if they're enabled and not already being made
+	void UpdateThumbnails();
+	/// Show the thumbnail for the given x coordinate, if there is one
+	void ShowPreview(int x);
+	void HidePreview();
+
 	/// Get the frame number for the given x coordinate
 	int GetValueAtX(int x);
 	/// Get the x-coordinate for a frame number
@@ -67,6 +79,7 @@ class VideoSlider: public wxWindow {
 
 public:
 	VideoSlider(wxWindow* parent, agi::Context *c);
+	~VideoSlider();
 
 	DECLARE_EVENT_TABLE()
 };
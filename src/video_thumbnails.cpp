@@ -0,0 +1,277 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include "video_thumbnails.h"
+
+#include "async_video_provider.h"
+#include "include/aegisub/context.h"
+#include "options.h"
+#include "utils.h"
+#include "video_controller.h"
+#include "video_frame.h"
+
+#include <libaegisub/dispatch.h>
+#include <libaegisub/fs.h>
+#include <libaegisub/io.h>
+#include <libaegisub/log.h>
+
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <sstream>
+
+namespace {
+/// How often to check whether the video is idle
+const int poll_interval = 250;
+/// Milliseconds to read for before giving the worker a chance to do other work
+const int chunk_budget = 100;
+/// Number of frames to hand to the worker at once
+const size_t chunk_size = 8;
+/// Maximum number of thumbnails to make
+const size_t max_thumbnails = 300;
+/// Width of each thumbnail in pixels
+const int thumbnail_width = 160;
+
+const char cache_magic[8] = {'A', 'G', 'I', 'T', 'H', 'M', 'B', '1'};
+
+/// Box filter a frame down to a thumbnail
+VideoThumbnails::Thumbnail Downscale(VideoFrame const& img, int width, int height) {
+	VideoThumbnails::Thumbnail thumb;
+	thumb.width = width;
+	thumb.height = height;
+	thumb.rgb.resize(width * height * 3);
+
+	const int src_w = static_cast<int>(img.width);
+	const int src_h = static_cast<int>(img.height);
+	const uint8_t *top = img.data.data() + (img.flipped ? (img.height - 1) * img.pitch : 0);
+	const ptrdiff_t step = img.RowStep();
+
+	uint8_t *out = thumb.rgb.data();
+	for (int y = 0; y < height; ++y) {
+		const int y0 = y * src_h / height;
+		const int y1 = std::max(y0 + 1, (y + 1) * src_h / height);
+		for (int x = 0; x < width; ++x) {
+			const int x0 = x * src_w / width;
+			const int x1 = std::max(x0 + 1, (x + 1) * src_w / width);
+
+			uint32_t b = 0, g = 0, r = 0;
+			for (int sy = y0; sy < y1; ++sy) {
+				const uint8_t *px = top + sy * step + x0 * 4;
+				for (int sx = x0; sx < x1; ++sx, px += 4) {
+					b += px[0];
+					g += px[1];
+					r += px[2];
+				}
+			}
+
+			const uint32_t n = (y1 - y0) * (x1 - x0);
+			*out++ = static_cast<uint8_t>(r / n);
+			*out++ = static_cast<uint8_t>(g / n);
+			*out++ = static_cast<uint8_t>(b / n);
+		}
+	}
+	return thumb;
+}
+
+template<typename T>
+void Write(std::ostream& out, T value) {
+	out.write(reinterpret_cast<const char *>(&value), sizeof value);
+}
+
+template<typename T>
+T Read(std::istream& in) {
+	T value{};
+	in.read(reinterpret_cast<char *>(&value), sizeof value);
+	return value;
+}
+}
+
+struct VideoThumbnails::State {
+	/// Owner of this state, or null once it's been destroyed
+	VideoThumbnails *owner;
+	explicit State(VideoThumbnails *owner) : owner(owner) { }
+};
+
+VideoThumbnails::VideoThumbnails(agi::Context *c, AsyncVideoProvider *provider, agi::fs::path const& video)
+: state(std::make_shared<State>(this))
+, context(c)
+, provider(provider)
+, thumb_width(thumbnail_width)
+{
+	double dar = provider->GetDAR();
+	if (dar <= 0)
+		dar = double(provider->GetWidth()) / provider->GetHeight();
+	thumb_height = std::max(2, static_cast<int>(thumb_width / dar + .5));
+
+	try {
+		LoadCache(video);
+	}
+	catch (agi::Exception const& e) {
+		LOG_E("video/thumbnails") << "Failed to read cached thumbnails: " << e.GetMessage();
+		thumbs.clear();
+	}
+
+	timer.Bind(wxEVT_TIMER, [=](wxTimerEvent&) { Step(); });
+	SetTargets(provider->GetKeyFrames());
+}
+
+VideoThumbnails::~VideoThumbnails() {
+	// Jobs which are still queued hold a reference to the state and check
+	// this before calling back
+	state->owner = nullptr;
+}
+
+void VideoThumbnails::SetKeyframes(std::vector<int> const& keyframes) {
+	SetTargets(keyframes);
+}
+
+void VideoThumbnails::SetTargets(std::vector<int> const& keyframes) {
+	const int frame_count = provider->GetFrameCount();
+	targets.clear();
+
+	if (keyframes.empty()) {
+		const size_t count = std::min<size_t>(max_thumbnails, std::max(frame_count, 0));
+		for (size_t i = 0; i < count; ++i)
+			targets.push_back(static_cast<int>(i * frame_count / count));
+	}
+	else if (keyframes.size() <= max_thumbnails)
+		targets = keyframes;
+	else {
+		for (size_t i = 0; i < max_thumbnails; ++i)
+			targets.push_back(keyframes[i * keyframes.size() / max_thumbnails]);
+	}
+
+	targets.erase(std::remove_if(begin(targets), end(targets),
+		[=](int frame) { return frame < 0 || frame >= frame_count; }), end(targets));
+
+	next_target = 0;
+	if (!timer.IsRunning())
+		timer.Start(poll_interval);
+}
+
+void VideoThumbnails::Step() {
+	if (reading || context->videoController->IsBusy()) return;
+
+	while (next_target < targets.size() && thumbs.count(targets[next_target]))
+		++next_target;
+
+	if (next_target == targets.size()) {
+		timer.Stop();
+		SaveCache();
+		return;
+	}
+
+	std::vector<int> frames;
+	for (size_t i = next_target; i < targets.size() && frames.size() < chunk_size; ++i) {
+		if (!thumbs.count(targets[i]))
+			frames.push_back(targets[i]);
+	}
+
+	reading = true;
+	auto s = state;
+	auto chunk = std::make_shared<std::vector<std::pair<int, Thumbnail>>>();
+	const int width = thumb_width, height = thumb_height;
+	provider->ReadFrames(frames, chunk_budget,
+		[=](int i, VideoFrame const& img) {
+			chunk->emplace_back(frames[i], Downscale(img, width, height));
+		},
+		[=](int next) {
+			agi::dispatch::Main().Async([=] {
+				if (s->owner) s->owner->ChunkDone(next < 0, *chunk);
+			});
+		});
+}
+
+void VideoThumbnails::ChunkDone(bool failed, std::vector<std::pair<int, Thumbnail>>& chunk) {
+	reading = false;
+	for (auto& thumb : chunk)
+		thumbs[thumb.first] = std::move(thumb.second);
+	dirty = dirty || !chunk.empty();
+
+	if (failed) {
+		LOG_E("video/thumbnails") << "Decoding failed; giving up on making thumbnails";
+		timer.Stop();
+		return;
+	}
+
+	// Keep going right away unless something else wants the video
+	Step();
+}
+
+VideoThumbnails::Thumbnail const* VideoThumbnails::Get(int frame) const {
+	auto it = thumbs.upper_bound(frame);
+	if (it == thumbs.begin()) return nullptr;
+	return &(--it)->second;
+}
+
+void VideoThumbnails::LoadCache(agi::fs::path const& video) {
+	cache_key.source = agi::SourceIdentity::Of(video);
+	cache_key.type = "thumbnails";
+	cache_key.params = std::to_string(thumb_width) + "x" + std::to_string(thumb_height);
+
+	std::string data;
+	if (config::derived->Get(cache_key, data)) {
+		std::istringstream in(data);
+		ReadCache(in);
+		return;
+	}
+
+	// Older versions cached the thumbnails next to the FFMS2 indexes
+	auto legacy_file = GetVideoCacheFilename(video, ".thumbnails");
+	if (agi::fs::FileExists(legacy_file)) {
+		ReadCache(*agi::io::Open(legacy_file, true));
+		agi::fs::Remove(legacy_file);
+		dirty = !thumbs.empty();
+	}
+}
+
+void VideoThumbnails::ReadCache(std::istream &in) {
+	char magic[sizeof cache_magic];
+	in.read(magic, sizeof magic);
+	const auto width = Read<int32_t>(in);
+	const auto height = Read<int32_t>(in);
+	const auto count = Read<int32_t>(in);
+	if (!in || memcmp(magic, cache_magic, sizeof magic) || width != thumb_width || height != thumb_height)
+		return;
+
+	for (int32_t i = 0; i < count; ++i) {
+		Thumbnail thumb;
+		thumb.width = width;
+		thumb.height = height;
+		thumb.rgb.resize(width * height * 3);
+		const auto frame = Read<int32_t>(in);
+		in.read(reinterpret_cast<char *>(thumb.rgb.data()), thumb.rgb.size());
+		if (!in) break;
+		thumbs[frame] = std::move(thumb);
+	}
+}
+
+void VideoThumbnails::SaveCache() {
+	if (!dirty || cache_key.type.empty()) return;
+	dirty = false;
+
+	std::ostringstream out(std::ios::binary);
+	out.write(cache_magic, sizeof cache_magic);
+	Write<int32_t>(out, thumb_width);
+	Write<int32_t>(out, thumb_height);
+	Write<int32_t>(out, static_cast<int32_t>(thumbs.size()));
+	for (auto const& thumb : thumbs) {
+		Write<int32_t>(out, thumb.first);
+		out.write(reinterpret_cast<const char *>(thumb.second.rgb.data()), thumb.second.rgb.size());
+	}
+
+	config::derived->Put(cache_key, out.str());
+}
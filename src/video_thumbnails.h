@@ -0,0 +1,100 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file video_thumbnails.h
+/// @brief Background generation of thumbnails for the video slider
+
+#pragma once
+
+#include <libaegisub/derived_store.h>
+#include <libaegisub/fs_fwd.h>
+
+#include <boost/filesystem/path.hpp>
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <vector>
+#include <wx/timer.h>
+
+class AsyncVideoProvider;
+namespace agi { struct Context; }
+
+/// @class VideoThumbnails
+/// @brief Small pictures of a sample of the frames of the open video
+///
+/// Frames are read on the video provider's worker whenever the video is idle,
+/// in the same way as SceneIndex does, preferring keyframes so that each one
+/// is cheap to decode. The thumbnails are kept in the derived data store.
+class VideoThumbnails {
+public:
+	struct Thumbnail {
+		int width = 0;
+		int height = 0;
+		/// Packed 24-bit RGB, top row first
+		std::vector<uint8_t> rgb;
+	};
+
+private:
+	/// State shared with the jobs on the video worker
+	struct State;
+	std::shared_ptr<State> state;
+
+	agi::Context *context;
+	AsyncVideoProvider *provider;
+	/// Key of the thumbnails in the derived data store, with an empty type
+	/// if the video's identity couldn't be determined
+	agi::ArtifactKey cache_key;
+
+	int thumb_width;
+	int thumb_height;
+
+	/// Frames which should have thumbnails, in order
+	std::vector<int> targets;
+	/// First entry in targets which might not have a thumbnail yet
+	size_t next_target = 0;
+	std::map<int, Thumbnail> thumbs;
+	/// Have thumbnails been added since the cache was last written?
+	bool dirty = false;
+
+	wxTimer timer;
+	/// Is a chunk currently being read?
+	bool reading = false;
+
+	/// Pick which frames to make thumbnails of
+	void SetTargets(std::vector<int> const& keyframes);
+	/// Read the next chunk of frames if nothing else is going on
+	void Step();
+	/// Handle a chunk having been read
+	void ChunkDone(bool failed, std::vector<std::pair<int, Thumbnail>>& chunk);
+
+	void LoadCache(agi::fs::path const& video);
+	void ReadCache(std::istream &in);
+	void SaveCache();
+
+public:
+	/// @param c        Project context, used to check if the video is in use
+	/// @param provider Video to read
+	/// @param video    Filename of the video, used to name the cache file
+	VideoThumbnails(agi::Context *c, AsyncVideoProvider *provider, agi::fs::path const& video);
+	~VideoThumbnails();
+
+	/// Sample the given keyframes rather than evenly spaced frames
+	void SetKeyframes(std::vector<int> const& keyframes);
+
+	/// Get the thumbnail of the last sampled frame at or before the given
+	/// frame, or nullptr if there isn't one yet
+	Thumbnail const* Get(int frame) const;
+};
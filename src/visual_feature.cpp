@@ -36,6 +36,32 @@
 #include "options.h"
 #include "visual_feature.h"
 
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+namespace {
+/// Width and height in pixels of each cell of VisualFeatureIndex's grid
+const float index_cell_size = 32.f;
+
+/// Furthest from its position a feature can be hit on either axis
+float feature_reach(DraggableFeatureType type, int size) {
+	switch (type) {
+		case DRAG_BIG_SQUARE:
+		case DRAG_BIG_CIRCLE:
+			return 6.f;
+		case DRAG_BIG_TRIANGLE:
+			return 10.f;
+		case DRAG_SMALL_SQUARE:
+			return static_cast<float>(size);
+		case DRAG_SMALL_CIRCLE:
+			return std::sqrt(3.f * std::max(size, 0));
+		default:
+			return 0.f;
+	}
+}
+}
+
 VisualDraggableFeature::VisualDraggableFeature()
 : size(OPT_GET("Tool/Visual/Shape Handle Size")->GetInt())
 {}
@@ -118,3 +144,77 @@ void VisualDraggableFeature::UpdateDrag(Vector2D d, bool single_axis) {
 bool VisualDraggableFeature::HasMoved() const {
 	return pos != start;
 }
+
+int VisualFeatureIndex::CellCoord(float v) {
+	float cell = std::floor(v / index_cell_size);
+	if (!(cell > INT_MIN / 2)) return INT_MIN / 2;
+	if (cell > INT_MAX / 2) return INT_MAX / 2;
+	return static_cast<int>(cell);
+}
+
+uint64_t VisualFeatureIndex::Cell(int x, int y) {
+	// Offset so that cells sort by row and then column as unsigned
+	return (static_cast<uint64_t>(static_cast<uint32_t>(y) ^ 0x80000000u) << 32) | (static_cast<uint32_t>(x) ^ 0x80000000u);
+}
+
+void VisualFeatureIndex::Build() {
+	entries.clear();
+	entries.reserve(indexed.size());
+	reach = 0.f;
+	for (size_t i = 0; i < indexed.size(); ++i) {
+		auto const& f = indexed[i];
+		entries.push_back(Entry{Cell(CellCoord(f.pos.X()), CellCoord(f.pos.Y())), i, f.feature});
+		reach = std::max(reach, feature_reach(f.type, f.size));
+	}
+	sort(begin(entries), end(entries));
+}
+
+void VisualFeatureIndex::Collect(int x1, int y1, int x2, int y2, std::vector<Entry const*> &out) const {
+	// Checking every entry is quicker than searching a lot of empty rows
+	if (static_cast<int64_t>(y2) - y1 >= static_cast<int64_t>(entries.size())) {
+		for (auto const& entry : entries) {
+			int x = static_cast<int>(static_cast<uint32_t>(entry.cell) ^ 0x80000000u);
+			int y = static_cast<int>(static_cast<uint32_t>(entry.cell >> 32) ^ 0x80000000u);
+			if (x >= x1 && x <= x2 && y >= y1 && y <= y2)
+				out.push_back(&entry);
+		}
+		return;
+	}
+
+	// Within a row the cells are contiguous, so each row is a single range
+	for (int y = y1; y <= y2; ++y) {
+		auto it = lower_bound(begin(entries), end(entries), Entry{Cell(x1, y), 0, nullptr});
+		const uint64_t last = Cell(x2, y);
+		for (; it != end(entries) && it->cell <= last; ++it)
+			out.push_back(&*it);
+	}
+}
+
+std::vector<VisualDraggableFeature *> VisualFeatureIndex::At(Vector2D point) const {
+	std::vector<Entry const*> found;
+	Collect(CellCoord(point.X() - reach), CellCoord(point.Y() - reach),
+		CellCoord(point.X() + reach), CellCoord(point.Y() + reach), found);
+	sort(begin(found), end(found), [](Entry const* a, Entry const* b) { return a->order < b->order; });
+
+	std::vector<VisualDraggableFeature *> ret;
+	ret.reserve(found.size());
+	for (auto entry : found)
+		ret.push_back(entry->feature);
+	return ret;
+}
+
+std::vector<VisualDraggableFeature *> VisualFeatureIndex::InBox(Vector2D top_left, Vector2D bottom_right) const {
+	std::vector<Entry const*> found;
+	Collect(CellCoord(top_left.X()), CellCoord(top_left.Y()),
+		CellCoord(bottom_right.X()), CellCoord(bottom_right.Y()), found);
+	sort(begin(found), end(found), [](Entry const* a, Entry const* b) { return a->order < b->order; });
+
+	std::vector<VisualDraggableFeature *> ret;
+	for (auto entry : found) {
+		auto const& pos = indexed[entry->order].pos;
+		if (pos.X() >= top_left.X() && pos.X() <= bottom_right.X()
+			&& pos.Y() >= top_left.Y() && pos.Y() <= bottom_right.Y())
+			ret.push_back(entry->feature);
+	}
+	return ret;
+}
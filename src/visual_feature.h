@@ -37,6 +37,8 @@
 #include "vector2d.h"
 
 #include <boost/intrusive/list_hook.hpp>
+#include <cstdint>
+#include <vector>
 
 class OpenGLWrapper;
 class AssDialogue;
@@ -87,3 +89,78 @@ public:
 	/// Has this feature actually moved since a drag was last started?
 	bool HasMoved() const;
 };
+
+/// @class VisualFeatureIndex
+/// @brief Uniform grid over the positions of a list of features
+///
+/// The vector clip tool has a feature for every control point of the clip,
+/// so rather than hit-testing all of them on every mouse move, the features
+/// near the mouse are looked up here. The index is brought up to date with
+/// Update() whenever the features are drawn, so queries are answered for
+/// where the features were last shown.
+class VisualFeatureIndex {
+	struct Entry {
+		uint64_t cell;
+		size_t order; ///< Position in the feature list
+		VisualDraggableFeature *feature;
+
+		bool operator<(Entry const& rgt) const {
+			return cell < rgt.cell || (cell == rgt.cell && order < rgt.order);
+		}
+	};
+
+	/// What each feature looked like when the index was built, in list
+	/// order, to detect when it has to be rebuilt
+	struct Indexed {
+		VisualDraggableFeature *feature;
+		Vector2D pos;
+		DraggableFeatureType type;
+		int size;
+	};
+
+	std::vector<Entry> entries; ///< Sorted by cell then list order
+	std::vector<Indexed> indexed;
+	/// Furthest a point can be from a feature's position on either axis and
+	/// still be over it
+	float reach = 0.f;
+
+	static uint64_t Cell(int x, int y);
+	static int CellCoord(float v);
+	/// Append the features with positions in the given range of cells, in
+	/// no particular order
+	void Collect(int x1, int y1, int x2, int y2, std::vector<Entry const*> &out) const;
+	void Build();
+
+public:
+	/// @brief Bring the index up to date with the features
+	/// @param features Features in the order they're hit-tested in
+	template<class Range>
+	void Update(Range &features) {
+		if (Current(features)) return;
+		indexed.clear();
+		for (auto& feature : features)
+			indexed.push_back(Indexed{&feature, feature.pos, feature.type, feature.size});
+		Build();
+	}
+
+	/// Does the index match the features exactly?
+	template<class Range>
+	bool Current(Range &features) const {
+		size_t i = 0;
+		for (auto& feature : features) {
+			if (i == indexed.size()) return false;
+			auto const& old = indexed[i++];
+			if (old.feature != &feature || old.pos != feature.pos || old.type != feature.type || old.size != feature.size)
+				return false;
+		}
+		return i == indexed.size();
+	}
+
+	size_t size() const { return indexed.size(); }
+
+	/// Features which might be under the point, in list order
+	std::vector<VisualDraggableFeature *> At(Vector2D point) const;
+
+	/// Features with positions inside the box, edges included, in list order
+	std::vector<VisualDraggableFeature *> InBox(Vector2D top_left, Vector2D bottom_right) const;
+};
@@ -23,10 +23,12 @@
 #include "ass_dialogue.h"
 #include "ass_file.h"
 #include "ass_style.h"
+#include "async_video_provider.h"
 #include "auto4_base.h"
 #include "compat.h"
 #include "include/aegisub/context.h"
 #include "options.h"
+#include "project.h"
 #include "selection_controller.h"
 #include "video_controller.h"
 #include "video_display.h"
@@ -39,8 +41,8 @@
 #include <libaegisub/format.h>
 #include <libaegisub/of_type_adaptor.h>
 #include <libaegisub/split.h>
+#include <libaegisub/trace.h>
 
-#include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/algorithm/string/trim.hpp>
@@ -65,6 +67,35 @@ VisualToolBase::VisualToolBase(VideoDisplay *parent, agi::Context *context)
 	parent->Bind(wxEVT_MOUSE_CAPTURE_LOST, &VisualToolBase::OnMouseCaptureLost, this);
 }
 
+VisualToolBase::~VisualToolBase() {
+	if (previewing) {
+		if (auto provider = c->project->VideoProvider())
+			provider->EndPreview();
+	}
+}
+
+void VisualToolBase::UpdatePreview() {
+	const bool preview = (dragging || holding) && OPT_GET("Video/Drag Preview")->GetBool();
+	if (preview == previewing) return;
+
+	auto provider = c->project->VideoProvider();
+	previewing = preview && provider;
+	if (!provider) return;
+	if (!preview) {
+		provider->EndPreview();
+		return;
+	}
+
+	// The tools edit the selected lines, along with the active line which
+	// may not be selected
+	std::vector<size_t> rows;
+	for (auto line : c->selectionController->GetSelectedSet())
+		rows.push_back(line->Row);
+	if (active_line)
+		rows.push_back(active_line->Row);
+	provider->BeginPreview(std::move(rows));
+}
+
 void VisualToolBase::SetResolutions() {
 	int script_w, script_h, layout_w, layout_h;
 	c->ass->GetResolution(script_w, script_h);
@@ -74,8 +105,10 @@ void VisualToolBase::SetResolutions() {
 }
 
 void VisualToolBase::OnCommit(int type) {
+	AGI_TRACE_ZONE("commit", "VisualToolBase");
 	holding = false;
 	dragging = false;
+	UpdatePreview();
 
 	if (type == AssFile::COMMIT_NEW || type & AssFile::COMMIT_SCRIPTINFO) {
 		SetResolutions();
@@ -97,6 +130,7 @@ void VisualToolBase::OnSeek(int new_frame) {
 	AssDialogue *new_line = GetActiveDialogueLine();
 	if (new_line != active_line) {
 		dragging = false;
+		UpdatePreview();
 		active_line = new_line;
 		OnLineChanged();
 	}
@@ -105,6 +139,7 @@ void VisualToolBase::OnSeek(int new_frame) {
 void VisualToolBase::OnMouseCaptureLost(wxMouseCaptureLostEvent &) {
 	holding = false;
 	dragging = false;
+	UpdatePreview();
 }
 
 void VisualToolBase::OnActiveLineChanged(AssDialogue *new_line) {
@@ -113,6 +148,7 @@ void VisualToolBase::OnActiveLineChanged(AssDialogue *new_line) {
 
 	holding = false;
 	dragging = false;
+	UpdatePreview();
 	if (new_line != active_line) {
 		active_line = new_line;
 		OnLineChanged();
@@ -165,6 +201,7 @@ void VisualToolBase::SetDisplayArea(int x, int y, int w, int h) {
 
 	holding = false;
 	dragging = false;
+	UpdatePreview();
 	if (parent->HasCapture())
 		parent->ReleaseMouse();
 	OnCoordinateSystemsChanged();
@@ -203,10 +240,10 @@ void VisualTool<FeatureType>::OnMouseEvent(wxMouseEvent &event) {
 	if (!dragging) {
 		int max_layer = INT_MIN;
 		active_feature = nullptr;
-		for (auto& feature : features) {
-			if (feature.IsMouseOver(mouse_pos) && feature.layer >= max_layer) {
-				active_feature = &feature;
-				max_layer = feature.layer;
+		for (auto feature : FeaturesAt(mouse_pos)) {
+			if (feature->IsMouseOver(mouse_pos) && feature->layer >= max_layer) {
+				active_feature = feature;
+				max_layer = feature->layer;
 			}
 		}
 	}
@@ -293,6 +330,7 @@ void VisualTool<FeatureType>::OnMouseEvent(wxMouseEvent &event) {
 	if (active_line && left_double)
 		OnDoubleClick();
 
+	UpdatePreview();
 	parent->Render();
 
 	// Only coalesce the changes made in a single drag
@@ -300,6 +338,24 @@ void VisualTool<FeatureType>::OnMouseEvent(wxMouseEvent &event) {
 		commit_id = -1;
 }
 
+template<class FeatureType>
+std::vector<FeatureType *> VisualTool<FeatureType>::FeaturesAt(Vector2D point) {
+	feature_index.Update(features);
+	std::vector<FeatureType *> ret;
+	for (auto feature : feature_index.At(point))
+		ret.push_back(static_cast<FeatureType *>(feature));
+	return ret;
+}
+
+template<class FeatureType>
+std::vector<FeatureType *> VisualTool<FeatureType>::FeaturesInBox(Vector2D top_left, Vector2D bottom_right) {
+	feature_index.Update(features);
+	std::vector<FeatureType *> ret;
+	for (auto feature : feature_index.InBox(top_left, bottom_right))
+		ret.push_back(static_cast<FeatureType *>(feature));
+	return ret;
+}
+
 template<class FeatureType>
 void VisualTool<FeatureType>::DrawAllFeatures() {
 	wxColour grid_color = to_wx(line_color_secondary_opt->GetColor());
@@ -307,6 +363,7 @@ void VisualTool<FeatureType>::DrawAllFeatures() {
 	wxColour base_fill = to_wx(highlight_color_primary_opt->GetColor());
 	wxColour active_fill = to_wx(highlight_color_secondary_opt->GetColor());
 	wxColour alt_fill = to_wx(line_color_primary_opt->GetColor());
+	gl.BeginBatch();
 	for (auto& feature : features) {
 		wxColour fill = base_fill;
 		if (&feature == active_feature)
@@ -316,6 +373,7 @@ void VisualTool<FeatureType>::DrawAllFeatures() {
 		gl.SetFillColour(fill, 0.3f);
 		feature.Draw(gl);
 	}
+	gl.EndBatch();
 }
 
 template<class FeatureType>
@@ -359,14 +417,9 @@ void VisualTool<FeatureType>::RemoveSelection(FeatureType *feat) {
 typedef const std::vector<AssOverrideParameter> * param_vec;
 
 // Find a tag's parameters in a line or return nullptr if it's not found
-static param_vec find_tag(std::vector<std::unique_ptr<AssDialogueBlock>>& blocks, std::string const& tag_name) {
-	for (auto ovr : blocks | agi::of_type<AssDialogueBlockOverride>()) {
-		for (auto const& tag : ovr->Tags) {
-			if (tag.Name == tag_name)
-				return &tag.Params;
-		}
-	}
-
+static param_vec find_tag(AssParsedText const& blocks, std::string const& tag_name) {
+	if (auto tag = blocks.FindTag(tag_name))
+		return &tag->Params;
 	return nullptr;
 }
 
@@ -382,7 +435,7 @@ static Vector2D vec_or_bad(param_vec tag, size_t x_idx, size_t y_idx) {
 }
 
 Vector2D VisualToolBase::GetLinePosition(AssDialogue *diag) {
-	auto blocks = diag->ParseTags();
+	auto const& blocks = diag->Parsed();
 
 	if (Vector2D ret = vec_or_bad(find_tag(blocks, "\\pos"), 0, 1)) return ret;
 	if (Vector2D ret = vec_or_bad(find_tag(blocks, "\\move"), 0, 1)) return ret;
@@ -433,12 +486,12 @@ Vector2D VisualToolBase::GetLinePosition(AssDialogue *diag) {
 }
 
 Vector2D VisualToolBase::GetLineOrigin(AssDialogue *diag) {
-	auto blocks = diag->ParseTags();
+	auto const& blocks = diag->Parsed();
 	return vec_or_bad(find_tag(blocks, "\\org"), 0, 1);
 }
 
 bool VisualToolBase::GetLineMove(AssDialogue *diag, Vector2D &p1, Vector2D &p2, int &t1, int &t2) {
-	auto blocks = diag->ParseTags();
+	auto const& blocks = diag->Parsed();
 
 	param_vec tag = find_tag(blocks, "\\move");
 	if (!tag)
@@ -459,7 +512,7 @@ void VisualToolBase::GetLineRotation(AssDialogue *diag, float &rx, float &ry, fl
 	if (AssStyle *style = c->ass->GetStyle(diag->Style))
 		rz = style->angle;
 
-	auto blocks = diag->ParseTags();
+	auto const& blocks = diag->Parsed();
 
 	if (param_vec tag = find_tag(blocks, "\\frx"))
 		rx = tag->front().Get(rx);
@@ -474,7 +527,7 @@ void VisualToolBase::GetLineRotation(AssDialogue *diag, float &rx, float &ry, fl
 void VisualToolBase::GetLineShear(AssDialogue *diag, float& fax, float& fay) {
 	fax = fay = 0.f;
 
-	auto blocks = diag->ParseTags();
+	auto const& blocks = diag->Parsed();
 
 	if (param_vec tag = find_tag(blocks, "\\fax"))
 		fax = tag->front().Get(fax);
@@ -490,7 +543,7 @@ void VisualToolBase::GetLineScale(AssDialogue *diag, Vector2D &scale) {
 		y = style->scaley;
 	}
 
-	auto blocks = diag->ParseTags();
+	auto const& blocks = diag->Parsed();
 
 	if (param_vec tag = find_tag(blocks, "\\fscx"))
 		x = tag->front().Get(x);
@@ -508,7 +561,7 @@ void VisualToolBase::GetLineOutline(AssDialogue *diag, Vector2D &outline) {
 		y = style->outline_w;
 	}
 
-	auto blocks = diag->ParseTags();
+	auto const& blocks = diag->Parsed();
 
 	if (param_vec tag = find_tag(blocks, "\\bord")) {
 		x = tag->front().Get(x);
@@ -530,7 +583,7 @@ void VisualToolBase::GetLineShadow(AssDialogue *diag, Vector2D &shadow) {
 		y = style->shadow_w;
 	}
 
-	auto blocks = diag->ParseTags();
+	auto const& blocks = diag->Parsed();
 
 	if (param_vec tag = find_tag(blocks, "\\shad")) {
 		x = tag->front().Get(x);
@@ -549,7 +602,7 @@ int VisualToolBase::GetLineAlignment(AssDialogue *diag) {
 
 	if (AssStyle *style = c->ass->GetStyle(diag->Style))
 		an = style->alignment;
-	auto blocks = diag->ParseTags();
+	auto const& blocks = diag->Parsed();
 	if (param_vec tag = find_tag(blocks, "\\an"))
 		an = tag->front().Get(an);
 
@@ -567,13 +620,17 @@ std::pair<Vector2D, Vector2D> VisualToolBase::GetLineBaseExtents(AssDialogue *di
 		style.scaley = 100.;
 	}
 
-	auto blocks = diag->ParseTags();
+	auto const& blocks = diag->Parsed();
 	param_vec ptag = find_tag(blocks, "\\p");
 
 	if (ptag && ptag->front().Get(0)) {		// A drawing
 		Spline spline;
 		spline.SetScale(ptag->front().Get(1));
-		std::string drawing_text = join(blocks | agi::of_type<AssDialogueBlockDrawing>() | boost::adaptors::transformed([&](AssDialogueBlock *d) { return d->GetText(); }), "");
+		std::string drawing_text;
+		for (auto const& block : blocks.Blocks()) {
+			if (block.type == AssBlockType::DRAWING)
+				drawing_text += block.text;
+		}
 		spline.DecodeFromAss(drawing_text);
 
 		if (!spline.size())
@@ -625,7 +682,7 @@ std::pair<Vector2D, Vector2D> VisualToolBase::GetLineBaseExtents(AssDialogue *di
 void VisualToolBase::GetLineClip(AssDialogue *diag, Vector2D &p1, Vector2D &p2, bool &inverse) {
 	inverse = false;
 
-	auto blocks = diag->ParseTags();
+	auto const& blocks = diag->Parsed();
 	param_vec tag = find_tag(blocks, "\\iclip");
 	if (tag)
 		inverse = true;
@@ -643,7 +700,7 @@ void VisualToolBase::GetLineClip(AssDialogue *diag, Vector2D &p1, Vector2D &p2,
 }
 
 std::string VisualToolBase::GetLineVectorClip(AssDialogue *diag, int &scale, bool &inverse) {
-	auto blocks = diag->ParseTags();
+	auto const& blocks = diag->Parsed();
 
 	scale = 1;
 	inverse = false;
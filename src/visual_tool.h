@@ -22,12 +22,14 @@
 
 #include "gl_wrap.h"
 #include "vector2d.h"
+#include "visual_feature.h"
 #include "options.h"
 
 #include <libaegisub/owning_intrusive_list.h>
 #include <libaegisub/signal.h>
 
 #include <set>
+#include <vector>
 
 class AssDialogue;
 class VideoDisplay;
@@ -93,6 +95,12 @@ protected:
 	bool holding = false; ///< Is a hold currently in progress?
 	AssDialogue *active_line = nullptr; ///< Active dialogue line; nullptr if it is not visible on the current frame
 	bool dragging = false; ///< Is a drag currently in progress?
+	/// Has the video provider been told to render the edited lines on their own?
+	bool previewing = false;
+
+	/// Start or stop rendering the edited lines on their own to match whether
+	/// a drag or hold is in progress
+	void UpdatePreview();
 
 	int frame_number; ///< Current frame number
 
@@ -172,7 +180,7 @@ public:
 	virtual void SetToolbar(wxToolBar *) { }
 	virtual void SetSubTool(int subtool) { }
 	virtual int GetSubTool() { return 0; }
-	virtual ~VisualToolBase() = default;
+	virtual ~VisualToolBase();
 };
 
 /// Visual tool base class containing all common feature-related functionality
@@ -213,6 +221,14 @@ protected:
 	/// List is used here for the iterator invalidation properties
 	feature_list features;
 
+	/// Index of the features' positions for hit-testing
+	VisualFeatureIndex feature_index;
+
+	/// Features which might be under the point, in list order
+	std::vector<FeatureType *> FeaturesAt(Vector2D point);
+	/// Features with positions inside the box, in list order
+	std::vector<FeatureType *> FeaturesInBox(Vector2D top_left, Vector2D bottom_right);
+
 	/// Draw all of the features in the list
 	void DrawAllFeatures();
 
@@ -137,14 +137,17 @@ void VisualToolVectorClip::Draw() {
 
 	// Draw lines connecting the bicubic features
 	gl.SetLineColour(line_color, 0.9f, 1);
+	gl.BeginBatch();
 	for (auto const& curve : spline) {
 		if (curve.type == SplineCurve::BICUBIC) {
 			gl.DrawDashedLine(curve.p1, curve.p2, 6);
 			gl.DrawDashedLine(curve.p3, curve.p4, 6);
 		}
 	}
+	gl.EndBatch();
 
 	// Draw features
+	gl.BeginBatch();
 	for (auto& feature : features) {
 		wxColour feature_color = line_color;
 		if (&feature == active_feature)
@@ -162,6 +165,7 @@ void VisualToolVectorClip::Draw() {
 			gl.DrawCircle(feature.pos, featureSize * 2.f / 3.f);
 		}
 	}
+	gl.EndBatch();
 
 	// Draw preview of inserted line
 	if (mode == VCLIP_LINE || mode == VCLIP_BICUBIC) {
@@ -370,23 +374,13 @@ bool VisualToolVectorClip::InitializeHold() {
 	return false;
 }
 
-static bool in_box(Vector2D top_left, Vector2D bottom_right, Vector2D p) {
-	return p.X() >= top_left.X()
-		&& p.X() <= bottom_right.X()
-		&& p.Y() >= top_left.Y()
-		&& p.Y() <= bottom_right.Y();
-}
-
 void VisualToolVectorClip::UpdateHold() {
 	// Box selection
 	if (mode == VCLIP_DRAG) {
-		std::set<Feature *> boxed_features;
 		Vector2D p1 = drag_start.Min(mouse_pos);
 		Vector2D p2 = drag_start.Max(mouse_pos);
-		for (auto& feature : features) {
-			if (in_box(p1, p2, feature.pos))
-				boxed_features.insert(&feature);
-		}
+		auto in_box = FeaturesInBox(p1, p2);
+		std::set<Feature *> boxed_features(begin(in_box), end(in_box));
 
 		// Keep track of which features were selected by the box selection so
 		// that only those are deselected if the user is holding ctrl
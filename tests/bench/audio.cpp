@@ -0,0 +1,130 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file audio.cpp
+/// @brief Benchmarks of audio conversion and the waveform and spectrum kernels
+
+#include "bench.h"
+
+#include <fft.h>
+
+#include <libaegisub/audio/peak_pyramid.h>
+#include <libaegisub/audio/provider.h>
+#include <libaegisub/make_unique.h>
+
+#include <cmath>
+#include <vector>
+
+namespace {
+/// Ten minutes of a stereo float sine sweep, generated on demand
+struct SweepAudioProvider : agi::AudioProvider {
+	SweepAudioProvider() {
+		channels = 2;
+		sample_rate = 48000;
+		num_samples = 10 * 60 * sample_rate;
+		decoded_samples = num_samples;
+		bytes_per_sample = sizeof(float);
+		float_samples = true;
+	}
+
+	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
+		auto out = static_cast<float *>(buf);
+		for (int64_t end = start + count; start < end; ++start) {
+			const float sample = 0.5f * std::sin(start * (start % 4800) * 1e-6f);
+			*out++ = sample;
+			*out++ = -sample;
+		}
+	}
+};
+
+/// Samples already in the format the audio display reads
+struct Int16AudioProvider : agi::AudioProvider {
+	Int16AudioProvider() {
+		channels = 1;
+		sample_rate = 48000;
+		num_samples = 10 * 60 * sample_rate;
+		decoded_samples = num_samples;
+		bytes_per_sample = 2;
+		float_samples = false;
+	}
+
+	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
+		auto out = static_cast<int16_t *>(buf);
+		for (int64_t end = start + count; start < end; ++start)
+			*out++ = static_cast<int16_t>(start * 37 % 65536 - 32768);
+	}
+};
+
+const int64_t block_samples = 1 << 16;
+}
+
+AGI_BENCHMARK(audio_convert_float_stereo_to_int16_mono) {
+	auto provider = agi::CreateConvertAudioProvider(agi::make_unique<SweepAudioProvider>());
+	std::vector<int16_t> samples(block_samples);
+	int64_t start = 0;
+	while (state.KeepRunning()) {
+		provider->GetInt16MonoAudio(samples.data(), start, block_samples);
+		bench::DoNotOptimize(samples[0]);
+		start = (start + block_samples) % (provider->GetNumSamples() - block_samples);
+	}
+	state.SetItemsPerIteration(block_samples);
+	state.SetBytesPerIteration(block_samples * 2 * sizeof(float));
+}
+
+AGI_BENCHMARK(waveform_peak_pyramid_update) {
+	Int16AudioProvider provider;
+	const int64_t length = 60 * provider.GetSampleRate();
+	while (state.KeepRunning()) {
+		agi::AudioPeakPyramid pyramid(length);
+		for (int64_t start = 0; start < length; start += block_samples)
+			pyramid.Update(provider, start, std::min(length, start + block_samples));
+		bench::DoNotOptimize(pyramid);
+	}
+	state.SetItemsPerIteration(length);
+}
+
+AGI_BENCHMARK(waveform_peak_pyramid_get) {
+	Int16AudioProvider provider;
+	const int64_t length = provider.GetNumSamples();
+	agi::AudioPeakPyramid pyramid(length);
+	pyramid.Update(provider, 0, length);
+
+	// One column per 512 samples, as at a typical zoom level
+	const int64_t columns = length / 512;
+	while (state.KeepRunning()) {
+		int sum = 0;
+		agi::AudioPeak peak;
+		for (int64_t x = 0; x < columns; ++x) {
+			if (pyramid.Get(x * 512, (x + 1) * 512, &peak))
+				sum += peak.max;
+		}
+		bench::DoNotOptimize(sum);
+	}
+	state.SetItemsPerIteration(columns);
+}
+
+AGI_BENCHMARK(spectrum_fft_2048) {
+	const size_t n = 2048;
+	std::vector<float> input(n), output_r(n / 2), output_i(n / 2);
+	for (size_t i = 0; i < n; ++i)
+		input[i] = std::sin(i * 0.05f) + 0.25f * std::sin(i * 0.71f);
+
+	FFT fft;
+	while (state.KeepRunning()) {
+		fft.TransformReal(n, input.data(), output_r.data(), output_i.data());
+		bench::DoNotOptimize(output_r[1]);
+	}
+	state.SetItemsPerIteration(n);
+}
@@ -0,0 +1,87 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file bench.h
+/// @brief Minimal harness for timing hot paths
+///
+/// Benchmarks are registered with AGI_BENCHMARK and run by bench/main.cpp,
+/// which prints a table and optionally writes the results as JSON so that
+/// they can be compared between builds.
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+namespace bench {
+/// Passed to each benchmark to time its iterations
+///
+/// The benchmark does any setup, then runs the code being measured in a
+/// `while (state.KeepRunning())` loop. Each iteration is timed separately.
+class State {
+	using clock = std::chrono::steady_clock;
+
+	double min_time_ms;
+	size_t max_iterations;
+	clock::time_point started;
+	clock::time_point iteration_start;
+	bool running = false;
+
+	std::vector<double> samples_ns;
+	double items = 0;
+	double bytes = 0;
+
+public:
+	State(double min_time_ms, size_t max_iterations)
+	: min_time_ms(min_time_ms), max_iterations(max_iterations) { }
+
+	/// Finish timing the previous iteration and decide whether to run another
+	bool KeepRunning();
+
+	/// Number of items each iteration processes, for reporting throughput
+	void SetItemsPerIteration(double count) { items = count; }
+	/// Number of bytes each iteration processes, for reporting throughput
+	void SetBytesPerIteration(double count) { bytes = count; }
+
+	std::vector<double> const& Samples() const { return samples_ns; }
+	double ItemsPerIteration() const { return items; }
+	double BytesPerIteration() const { return bytes; }
+};
+
+typedef void (*Function)(State&);
+
+/// Adds a benchmark to the list run by main()
+struct Registration {
+	Registration(const char *name, Function fn);
+};
+
+/// Keep the compiler from discarding a value which is otherwise unused
+template<typename T>
+inline void DoNotOptimize(T const& value) {
+#if defined(__GNUC__) || defined(__clang__)
+	asm volatile("" : : "r,m"(value) : "memory");
+#else
+	static volatile const void *sink;
+	sink = &value;
+#endif
+}
+}
+
+/// Define a benchmark; the body receives a bench::State& named `state`
+#define AGI_BENCHMARK(name) \
+	static void bench_##name(bench::State& state); \
+	static bench::Registration bench_registration_##name(#name, bench_##name); \
+	static void bench_##name(bench::State& state)
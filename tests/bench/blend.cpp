@@ -0,0 +1,80 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file blend.cpp
+/// @brief Benchmarks of compositing rendered subtitles onto frames
+
+#include "bench.h"
+
+#include <libaegisub/alpha_blend.h>
+
+#include <vector>
+
+namespace {
+const int width = 1920;
+const int height = 1080;
+}
+
+AGI_BENCHMARK(blend_mask_full_frame) {
+	std::vector<uint8_t> frame(width * height * 4, 64);
+	std::vector<uint8_t> mask(width * height);
+	for (size_t i = 0; i < mask.size(); ++i)
+		mask[i] = static_cast<uint8_t>(i * 7);
+
+	while (state.KeepRunning()) {
+		agi::BlendMask(frame.data(), width * 4, mask.data(), width, width, height, 0xFFFFFF40, false);
+		bench::DoNotOptimize(frame[0]);
+	}
+	state.SetItemsPerIteration(width * height);
+}
+
+AGI_BENCHMARK(blend_premultiplied_full_frame) {
+	std::vector<uint8_t> frame(width * height * 4, 64);
+	std::vector<uint8_t> overlay(width * height * 4);
+	for (size_t i = 0; i < overlay.size(); i += 4) {
+		const uint8_t alpha = static_cast<uint8_t>(i / 4 * 13);
+		overlay[i] = overlay[i + 1] = overlay[i + 2] = alpha / 2;
+		overlay[i + 3] = alpha;
+	}
+
+	while (state.KeepRunning()) {
+		agi::BlendPremultiplied(frame.data(), width * 4, overlay.data(), width * 4, width, height, false, false);
+		bench::DoNotOptimize(frame[0]);
+	}
+	state.SetItemsPerIteration(width * height);
+}
+
+AGI_BENCHMARK(blend_images_typesetting) {
+	// A few hundred small glyph masks scattered over the frame, as for a
+	// heavily typeset sign
+	const int glyph = 48;
+	std::vector<uint8_t> mask(glyph * glyph);
+	for (size_t i = 0; i < mask.size(); ++i)
+		mask[i] = static_cast<uint8_t>(i * 5);
+
+	std::vector<agi::BlendImage> images;
+	for (int i = 0; i < 400; ++i) {
+		int x = (i * 97) % (width - glyph);
+		int y = (i * 61) % (height - glyph);
+		images.push_back({agi::BlendImage::Mask, mask.data(), glyph, x, y, glyph, glyph, 0x20C0FF00u + (uint32_t)i});
+	}
+
+	std::vector<uint8_t> frame(width * height * 4, 64);
+	while (state.KeepRunning()) {
+		agi::BlendImages(frame.data(), width * 4, height, images, false);
+		bench::DoNotOptimize(frame[0]);
+	}
+	state.SetItemsPerIteration(images.size());
+}
@@ -0,0 +1,256 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+/// @file large_files.cpp
+/// @brief Benchmarks of whole-file operations on large synthetic fixtures
+///
+/// These use the generators from support/fixtures.h and mirror what the
+/// application does with a file, with the wx-dependent layers above
+/// AssDialogue left out: opening a script is parsing its lines and decoding
+/// its attachments, undo is diffing and restoring line contents, and so on.
+/// Run just these with `aegisub-bench --filter=large_`.
+
+#include "bench.h"
+
+#include <ass_dialogue.h>
+#include <fixtures.h>
+
+#include <libaegisub/ass/uuencode.h>
+#include <libaegisub/audio/peak_pyramid.h>
+#include <libaegisub/audio/provider.h>
+#include <libaegisub/parallel_sort.h>
+#include <libaegisub/util.h>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+const size_t large_script_lines = 50000;
+
+/// A script split into the parts the parser cares about
+struct LoadedScript {
+	std::vector<std::unique_ptr<AssDialogue>> events;
+	std::vector<std::vector<char>> attachments;
+	size_t bytes = 0;
+};
+
+/// Parse a script's events and decode its attachments
+LoadedScript load(std::string const& script) {
+	LoadedScript loaded;
+	loaded.bytes = script.size();
+
+	std::string attachment;
+	auto finish_attachment = [&] {
+		if (attachment.empty()) return;
+		loaded.attachments.push_back(agi::ass::UUDecode(attachment.data(), attachment.data() + attachment.size()));
+		attachment.clear();
+	};
+
+	bool in_fonts = false;
+	size_t pos = 0;
+	while (pos < script.size()) {
+		size_t end = script.find('\n', pos);
+		if (end == std::string::npos) end = script.size();
+		std::string line(script, pos, end - pos);
+		pos = end + 1;
+
+		if (boost::starts_with(line, "Dialogue:") || boost::starts_with(line, "Comment:"))
+			loaded.events.push_back(std::unique_ptr<AssDialogue>(new AssDialogue(line)));
+		else if (boost::starts_with(line, "fontname:")) {
+			finish_attachment();
+			in_fonts = true;
+		}
+		else if (line.empty() || line[0] == '[') {
+			finish_attachment();
+			in_fonts = false;
+		}
+		else if (in_fonts)
+			attachment += line;
+	}
+	finish_attachment();
+	return loaded;
+}
+
+fixtures::ScriptOptions large_script(fixtures::ScriptShape shape) {
+	fixtures::ScriptOptions options;
+	options.lines = large_script_lines;
+	options.shape = shape;
+	options.styles = 40;
+	return options;
+}
+
+void bench_load(bench::State& state, fixtures::ScriptOptions const& options) {
+	const auto script = fixtures::GenerateScript(options);
+	while (state.KeepRunning()) {
+		auto loaded = load(script);
+		bench::DoNotOptimize(loaded.events.back()->Layer);
+	}
+	state.SetItemsPerIteration(options.lines);
+	state.SetBytesPerIteration(script.size());
+}
+}
+
+AGI_BENCHMARK(large_load_dialogue_50k) {
+	bench_load(state, large_script(fixtures::ScriptShape::Dialogue));
+}
+
+AGI_BENCHMARK(large_load_karaoke_50k) {
+	bench_load(state, large_script(fixtures::ScriptShape::Karaoke));
+}
+
+AGI_BENCHMARK(large_load_typesetting_50k) {
+	bench_load(state, large_script(fixtures::ScriptShape::Typesetting));
+}
+
+AGI_BENCHMARK(large_load_attachments_20x1mb) {
+	fixtures::ScriptOptions options;
+	options.lines = 100;
+	options.attachments = 20;
+	options.attachment_size = 1 << 20;
+	const auto script = fixtures::GenerateScript(options);
+
+	while (state.KeepRunning()) {
+		auto loaded = load(script);
+		bench::DoNotOptimize(loaded.attachments.back()[0]);
+	}
+	state.SetItemsPerIteration(options.attachments);
+	state.SetBytesPerIteration(script.size());
+}
+
+AGI_BENCHMARK(large_edit_undo_50k) {
+	auto loaded = load(fixtures::GenerateScript(large_script(fixtures::ScriptShape::Mixed)));
+	auto& events = loaded.events;
+
+	// The committed state which undo information is recorded against
+	std::vector<AssDialogueBase> committed;
+	committed.reserve(events.size());
+	for (auto const& line : events)
+		committed.push_back(*line);
+
+	struct LineChange {
+		size_t index;
+		AssDialogueBase before;
+	};
+
+	while (state.KeepRunning()) {
+		// Edit every tenth line, as a find and replace or a style change would
+		for (size_t i = 0; i < events.size(); i += 10) {
+			events[i]->Text = events[i]->Text.get() + " (edited)";
+			events[i]->Start = events[i]->Start + 10;
+		}
+
+		// Commit: find the changed lines and record them
+		std::vector<LineChange> changes;
+		for (size_t i = 0; i < events.size(); ++i) {
+			if (!SameContents(committed[i], *events[i])) {
+				changes.push_back({i, committed[i]});
+				committed[i] = *events[i];
+			}
+		}
+
+		// Undo: put the lines back
+		for (auto const& change : changes) {
+			static_cast<AssDialogueBase&>(*events[change.index]) = change.before;
+			committed[change.index] = change.before;
+		}
+		bench::DoNotOptimize(changes.size());
+	}
+	state.SetItemsPerIteration(events.size());
+}
+
+AGI_BENCHMARK(large_sort_by_time_50k) {
+	auto options = large_script(fixtures::ScriptShape::Mixed);
+	options.shuffled = true;
+	auto loaded = load(fixtures::GenerateScript(options));
+
+	std::vector<AssDialogue *> unsorted;
+	for (auto const& line : loaded.events)
+		unsorted.push_back(line.get());
+
+	while (state.KeepRunning()) {
+		auto lines = unsorted;
+		agi::ParallelStableSort(lines.begin(), lines.end(), [](const AssDialogue *a, const AssDialogue *b) {
+			return a->Start < b->Start;
+		});
+		bench::DoNotOptimize(lines[0]);
+	}
+	state.SetItemsPerIteration(unsorted.size());
+}
+
+AGI_BENCHMARK(large_search_50k) {
+	auto loaded = load(fixtures::GenerateScript(large_script(fixtures::ScriptShape::Mixed)));
+
+	while (state.KeepRunning()) {
+		size_t matches = 0;
+		for (auto const& line : loaded.events) {
+			if (agi::util::ifind(line->Text.get(), "Station").first != std::string::npos)
+				++matches;
+		}
+		bench::DoNotOptimize(matches);
+	}
+	state.SetItemsPerIteration(loaded.events.size());
+}
+
+AGI_BENCHMARK(large_export_50k) {
+	auto options = large_script(fixtures::ScriptShape::Mixed);
+	options.attachments = 4;
+	options.attachment_size = 256 * 1024;
+	auto loaded = load(fixtures::GenerateScript(options));
+
+	while (state.KeepRunning()) {
+		std::ostringstream out;
+		out << "[Events]\n";
+		for (auto const& line : loaded.events) {
+			// Copying just the fields drops the cached serialization, so
+			// this times writing a file whose lines have all been edited
+			AssDialogue copy(static_cast<AssDialogueBase const&>(*line));
+			out << copy.GetEntryData() << '\n';
+		}
+		out << "\n[Fonts]\n";
+		for (auto const& attachment : loaded.attachments)
+			out << agi::ass::UUEncode(attachment.data(), attachment.data() + attachment.size()) << '\n';
+		bench::DoNotOptimize(out.tellp());
+	}
+	state.SetItemsPerIteration(loaded.events.size());
+}
+
+AGI_BENCHMARK(large_waveform_10min) {
+	fixtures::PCMOptions options;
+	options.seconds = 600;
+	auto path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("aegisub-bench-%%%%%%%%.wav");
+	{
+		auto wav = fixtures::GenerateWav(options);
+		boost::filesystem::ofstream file(path, std::ios::binary);
+		file.write(wav.data(), wav.size());
+	}
+
+	const int64_t block_samples = 1 << 16;
+	while (state.KeepRunning()) {
+		auto provider = agi::CreateConvertAudioProvider(agi::CreatePCMAudioProvider(path, nullptr));
+		const int64_t length = provider->GetNumSamples();
+		agi::AudioPeakPyramid pyramid(length);
+		for (int64_t start = 0; start < length; start += block_samples)
+			pyramid.Update(*provider, start, std::min(length, start + block_samples));
+		bench::DoNotOptimize(pyramid);
+	}
+	state.SetItemsPerIteration(options.seconds * options.sample_rate);
+
+	boost::filesystem::remove(path);
+}
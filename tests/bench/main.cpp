@@ -0,0 +1,248 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file main.cpp
+/// @brief Runner for the benchmarks
+///
+/// Usage: aegisub-bench [--filter=SUBSTRING] [--min-time=MS] [--json=FILE]
+///                      [--baseline=FILE] [--tolerance=PERCENT] [--check] [--list]
+///
+/// With --baseline, each median is compared to the one recorded in FILE, a
+/// file written by an earlier run's --json, and those slower than that by
+/// more than the tolerance (default 15%) are flagged. With --check as well,
+/// the run then fails if any were.
+
+#include "bench.h"
+
+#include <libaegisub/cajun/elements.h>
+#include <libaegisub/cajun/writer.h>
+#include <libaegisub/dispatch.h>
+#include <libaegisub/json.h>
+#include <libaegisub/log.h>
+
+#include <boost/locale/generator.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+
+namespace {
+std::vector<std::pair<const char *, bench::Function>>& registry() {
+	static std::vector<std::pair<const char *, bench::Function>> benchmarks;
+	return benchmarks;
+}
+
+struct Result {
+	size_t iterations = 0;
+	double mean_ns = 0;
+	double median_ns = 0;
+	double min_ns = 0;
+	double p90_ns = 0;
+	double items_per_second = 0;
+	double bytes_per_second = 0;
+};
+
+Result Summarize(bench::State const& state) {
+	Result result;
+	auto samples = state.Samples();
+	if (samples.empty()) return result;
+
+	sort(begin(samples), end(samples));
+	double total = 0;
+	for (double s : samples) total += s;
+
+	result.iterations = samples.size();
+	result.mean_ns = total / samples.size();
+	result.median_ns = samples[samples.size() / 2];
+	result.min_ns = samples.front();
+	result.p90_ns = samples[std::min(samples.size() - 1, samples.size() * 9 / 10)];
+	if (result.median_ns > 0) {
+		result.items_per_second = state.ItemsPerIteration() * 1e9 / result.median_ns;
+		result.bytes_per_second = state.BytesPerIteration() * 1e9 / result.median_ns;
+	}
+	return result;
+}
+
+double to_double(json::UnknownElement const& value) {
+	try {
+		return static_cast<json::Double const&>(value);
+	}
+	catch (json::Exception const&) {
+		return static_cast<double>(static_cast<json::Integer const&>(value));
+	}
+}
+
+/// Read the median of each benchmark from an earlier run's JSON output
+std::map<std::string, double> read_baseline(std::string const& file) {
+	std::map<std::string, double> baseline;
+	std::ifstream in(file);
+	if (!in) {
+		fprintf(stderr, "Could not open baseline %s\n", file.c_str());
+		return baseline;
+	}
+
+	try {
+		auto root = agi::json_util::parse(in);
+		auto const& benchmarks = static_cast<json::Array const&>(static_cast<json::Object const&>(root).at("benchmarks"));
+		for (auto const& entry : benchmarks) {
+			auto const& obj = static_cast<json::Object const&>(entry);
+			baseline[static_cast<json::String const&>(obj.at("name"))] = to_double(obj.at("median_ns"));
+		}
+	}
+	catch (std::exception const& e) {
+		fprintf(stderr, "Could not read baseline %s: %s\n", file.c_str(), e.what());
+		baseline.clear();
+	}
+	return baseline;
+}
+
+bool starts_with(const char *arg, const char *prefix, const char **value) {
+	size_t len = strlen(prefix);
+	if (strncmp(arg, prefix, len) != 0) return false;
+	*value = arg + len;
+	return true;
+}
+}
+
+namespace bench {
+bool State::KeepRunning() {
+	const auto now = clock::now();
+	if (!running) {
+		running = true;
+		started = now;
+	}
+	else
+		samples_ns.push_back(std::chrono::duration<double, std::nano>(now - iteration_start).count());
+
+	// Always run a few iterations so that the median means something
+	if (samples_ns.size() >= max_iterations) return false;
+	if (samples_ns.size() >= 5 && std::chrono::duration<double, std::milli>(now - started).count() >= min_time_ms)
+		return false;
+
+	iteration_start = clock::now();
+	return true;
+}
+
+Registration::Registration(const char *name, Function fn) {
+	registry().emplace_back(name, fn);
+}
+}
+
+int main(int argc, char **argv) {
+	std::string filter;
+	std::string json_file;
+	std::string baseline_file;
+	double min_time_ms = 500;
+	double tolerance = 15;
+	bool check = false;
+	bool list = false;
+
+	for (int i = 1; i < argc; ++i) {
+		const char *value;
+		if (starts_with(argv[i], "--filter=", &value))
+			filter = value;
+		else if (starts_with(argv[i], "--json=", &value))
+			json_file = value;
+		else if (starts_with(argv[i], "--min-time=", &value))
+			min_time_ms = atof(value);
+		else if (starts_with(argv[i], "--baseline=", &value))
+			baseline_file = value;
+		else if (starts_with(argv[i], "--tolerance=", &value))
+			tolerance = atof(value);
+		else if (strcmp(argv[i], "--check") == 0)
+			check = true;
+		else if (strcmp(argv[i], "--list") == 0)
+			list = true;
+		else {
+			fprintf(stderr, "Usage: %s [--filter=SUBSTRING] [--min-time=MS] [--json=FILE] [--baseline=FILE] [--tolerance=PERCENT] [--check] [--list]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	agi::dispatch::Init([](agi::dispatch::Thunk f) { f(); });
+	std::locale::global(boost::locale::generator().generate(""));
+	agi::log::log = new agi::log::LogSink;
+
+	auto benchmarks = registry();
+	sort(begin(benchmarks), end(benchmarks), [](std::pair<const char *, bench::Function> const& a, std::pair<const char *, bench::Function> const& b) {
+		return strcmp(a.first, b.first) < 0;
+	});
+
+	std::map<std::string, double> baseline;
+	if (!baseline_file.empty())
+		baseline = read_baseline(baseline_file);
+	size_t regressions = 0;
+
+	json::Array results;
+	printf("%-40s %10s %14s %14s %14s %10s\n", "benchmark", "iterations", "median (ns)", "min (ns)", "items/s", "baseline");
+	for (auto const& benchmark : benchmarks) {
+		if (!filter.empty() && !strstr(benchmark.first, filter.c_str())) continue;
+		if (list) {
+			printf("%s\n", benchmark.first);
+			continue;
+		}
+
+		bench::State state(min_time_ms, 1000000);
+		benchmark.second(state);
+		auto result = Summarize(state);
+		printf("%-40s %10zu %14.0f %14.0f %14.4g", benchmark.first, result.iterations,
+			result.median_ns, result.min_ns, result.items_per_second);
+
+		auto recorded = baseline.find(benchmark.first);
+		if (recorded != baseline.end() && recorded->second > 0) {
+			const double change = (result.median_ns / recorded->second - 1) * 100;
+			const bool regressed = change > tolerance;
+			if (regressed) ++regressions;
+			printf(" %+9.1f%%%s", change, regressed ? "  REGRESSED" : "");
+		}
+		printf("\n");
+		fflush(stdout);
+
+		json::Object obj;
+		obj["name"] = std::string(benchmark.first);
+		obj["iterations"] = static_cast<json::Integer>(result.iterations);
+		obj["mean_ns"] = result.mean_ns;
+		obj["median_ns"] = result.median_ns;
+		obj["min_ns"] = result.min_ns;
+		obj["p90_ns"] = result.p90_ns;
+		if (state.ItemsPerIteration() > 0)
+			obj["items_per_second"] = result.items_per_second;
+		if (state.BytesPerIteration() > 0)
+			obj["bytes_per_second"] = result.bytes_per_second;
+		if (recorded != baseline.end())
+			obj["baseline_median_ns"] = recorded->second;
+		results.push_back(std::move(obj));
+	}
+
+	if (!json_file.empty()) {
+		json::Object root;
+		root["benchmarks"] = std::move(results);
+		std::ofstream out(json_file);
+		agi::JsonWriter::Write(root, out);
+	}
+
+	delete agi::log::log;
+
+	if (regressions) {
+		printf("%zu benchmark(s) more than %g%% slower than the baseline\n", regressions, tolerance);
+		if (check) return 2;
+	}
+	return 0;
+}
@@ -0,0 +1,131 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file subtitles.cpp
+/// @brief Benchmarks of parsing and tokenizing subtitle lines
+
+#include "bench.h"
+
+#include <ass_dialogue.h>
+
+#include <libaegisub/ass/dialogue_parser.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+const char *sample_lines[] = {
+	"Dialogue: 0,0:00:01.00,0:00:03.50,Default,,0,0,0,,Just a plain line of dialogue",
+	"Dialogue: 0,0:00:04.00,0:00:06.00,Default,Actor,0,0,0,,{\\an8\\pos(640,50)\\fad(200,200)}Positioned {\\i1}italic{\\i0} text",
+	"Dialogue: 1,0:00:06.00,0:00:09.00,Sign,,0,0,0,,{\\blur3\\bord2\\3c&H202020&\\t(0,500,\\fscx120\\fscy120)}A sign\\Nover two lines",
+	"Dialogue: 0,0:00:09.00,0:00:12.00,Karaoke,,0,0,0,,{\\k20}ka{\\k30}ra{\\k25}o{\\k40}ke {\\k35}syl{\\k30}la{\\k45}bles",
+	"Comment: 0,0:00:12.00,0:00:14.00,Default,,0,0,0,,{a comment override block} with text after it",
+};
+const size_t sample_count = sizeof(sample_lines) / sizeof(sample_lines[0]);
+
+/// Lines for a script of the given size, cycling through the samples
+std::vector<std::string> make_script(size_t lines) {
+	std::vector<std::string> script;
+	script.reserve(lines);
+	for (size_t i = 0; i < lines; ++i)
+		script.emplace_back(sample_lines[i % sample_count]);
+	return script;
+}
+}
+
+AGI_BENCHMARK(dialogue_parse_line) {
+	size_t i = 0;
+	while (state.KeepRunning()) {
+		AssDialogue line(sample_lines[i++ % sample_count]);
+		bench::DoNotOptimize(line.Layer);
+	}
+	state.SetItemsPerIteration(1);
+}
+
+AGI_BENCHMARK(dialogue_parse_100k_lines) {
+	auto script = make_script(100000);
+	size_t bytes = 0;
+	for (auto const& line : script) bytes += line.size();
+
+	while (state.KeepRunning()) {
+		std::vector<AssDialogue> events;
+		events.reserve(script.size());
+		for (auto const& line : script)
+			events.emplace_back(line);
+		bench::DoNotOptimize(events.back().Layer);
+	}
+	state.SetItemsPerIteration(script.size());
+	state.SetBytesPerIteration(bytes);
+}
+
+AGI_BENCHMARK(dialogue_entry_data_100k_lines) {
+	auto script = make_script(100000);
+	std::vector<AssDialogue> events;
+	events.reserve(script.size());
+	for (auto const& line : script)
+		events.emplace_back(line);
+
+	while (state.KeepRunning()) {
+		size_t bytes = 0;
+		for (auto const& line : events)
+			bytes += line.GetEntryData().size();
+		bench::DoNotOptimize(bytes);
+	}
+	state.SetItemsPerIteration(events.size());
+}
+
+AGI_BENCHMARK(dialogue_parse_tags) {
+	std::vector<AssDialogue> events;
+	for (auto line : sample_lines)
+		events.emplace_back(line);
+
+	while (state.KeepRunning()) {
+		for (auto const& line : events) {
+			auto blocks = line.ParseTags();
+			bench::DoNotOptimize(blocks.size());
+		}
+	}
+	state.SetItemsPerIteration(events.size());
+}
+
+AGI_BENCHMARK(tokenize_dialogue_body) {
+	std::vector<std::string> bodies;
+	for (auto line : sample_lines)
+		bodies.push_back(AssDialogue(line).Text.get());
+
+	while (state.KeepRunning()) {
+		for (auto const& body : bodies) {
+			auto tokens = agi::ass::TokenizeDialogueBody(body);
+			bench::DoNotOptimize(tokens.size());
+		}
+	}
+	state.SetItemsPerIteration(bodies.size());
+}
+
+AGI_BENCHMARK(split_words_and_highlight) {
+	std::vector<std::string> bodies;
+	for (auto line : sample_lines)
+		bodies.push_back(AssDialogue(line).Text.get());
+
+	while (state.KeepRunning()) {
+		for (auto const& body : bodies) {
+			auto tokens = agi::ass::TokenizeDialogueBody(body);
+			agi::ass::SplitWords(body, tokens);
+			auto styles = agi::ass::SyntaxHighlight(body, tokens, nullptr);
+			bench::DoNotOptimize(styles.size());
+		}
+	}
+	state.SetItemsPerIteration(bodies.size());
+}
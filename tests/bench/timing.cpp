@@ -0,0 +1,86 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+/// @file timing.cpp
+/// @brief Benchmarks of frame and time conversions
+
+#include "bench.h"
+
+#include <libaegisub/vfr.h>
+
+#include <vector>
+
+namespace {
+/// Timecodes for an hour of video alternating between 24 and 30 fps sections
+std::vector<int> vfr_timecodes() {
+	std::vector<int> timecodes;
+	double time = 0;
+	for (int section = 0; time < 3600000; ++section) {
+		const double frame_duration = section % 2 ? 1000.0 / 30 : 1001.0 / 24;
+		for (int i = 0; i < 500; ++i) {
+			timecodes.push_back(static_cast<int>(time));
+			time += frame_duration;
+		}
+	}
+	return timecodes;
+}
+}
+
+AGI_BENCHMARK(vfr_frame_at_time_cfr) {
+	agi::vfr::Framerate fps(24000, 1001);
+	while (state.KeepRunning()) {
+		int sum = 0;
+		for (int ms = 0; ms < 3600000; ms += 997)
+			sum += fps.FrameAtTime(ms, agi::vfr::START);
+		bench::DoNotOptimize(sum);
+	}
+	state.SetItemsPerIteration(3600000 / 997 + 1);
+}
+
+AGI_BENCHMARK(vfr_frame_at_time) {
+	agi::vfr::Framerate fps(vfr_timecodes());
+	while (state.KeepRunning()) {
+		int sum = 0;
+		for (int ms = 0; ms < 3600000; ms += 997)
+			sum += fps.FrameAtTime(ms, agi::vfr::START);
+		bench::DoNotOptimize(sum);
+	}
+	state.SetItemsPerIteration(3600000 / 997 + 1);
+}
+
+AGI_BENCHMARK(vfr_time_at_frame) {
+	agi::vfr::Framerate fps(vfr_timecodes());
+	const int frames = fps.FrameAtTime(3600000);
+	while (state.KeepRunning()) {
+		int sum = 0;
+		for (int frame = 0; frame < frames; frame += 7)
+			sum += fps.TimeAtFrame(frame, agi::vfr::END);
+		bench::DoNotOptimize(sum);
+	}
+	state.SetItemsPerIteration(frames / 7 + 1);
+}
+
+AGI_BENCHMARK(vfr_frames_at_times) {
+	agi::vfr::Framerate fps(vfr_timecodes());
+	std::vector<int> times;
+	for (int ms = 0; ms < 3600000; ms += 997)
+		times.push_back(ms);
+
+	while (state.KeepRunning()) {
+		auto frames = fps.FramesAtTimes(times, agi::vfr::START);
+		bench::DoNotOptimize(frames.back());
+	}
+	state.SetItemsPerIteration(times.size());
+}
@@ -0,0 +1,253 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+/// @file fixtures.cpp
+/// @brief Generators for large synthetic subtitle and audio files
+
+#include "fixtures.h"
+
+#include <libaegisub/ass/time.h>
+#include <libaegisub/ass/uuencode.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+const char *words[] = {
+	"the", "a", "quick", "brown", "fox", "jumps", "over", "lazy", "dog",
+	"we", "should", "probably", "go", "back", "before", "anyone", "notices",
+	"what", "did", "you", "just", "say", "to", "me", "never", "mind",
+	"tomorrow", "morning", "station", "really", "think", "that's", "enough",
+};
+const size_t word_count = sizeof(words) / sizeof(words[0]);
+
+const char *syllables[] = {
+	"ka", "ra", "o", "ke", "na", "mi", "da", "ko", "ko", "ro", "ga",
+	"su", "ki", "yo", "ru", "no", "so", "ra", "wa", "ta", "shi",
+};
+const size_t syllable_count = sizeof(syllables) / sizeof(syllables[0]);
+
+class Generator {
+	fixtures::ScriptOptions const& opt;
+	std::mt19937 rng;
+
+	int Random(int min, int max) {
+		return std::uniform_int_distribution<int>(min, max)(rng);
+	}
+
+	std::string Word() {
+		return words[Random(0, word_count - 1)];
+	}
+
+	std::string StyleName(size_t i) const {
+		if (opt.styles <= 1 || i % opt.styles == 0) return "Default";
+		return "Style " + std::to_string(i % opt.styles);
+	}
+
+	std::string Event(const char *type, int layer, int start, int end, std::string const& style, const char *effect, std::string const& text) {
+		return std::string(type) + ": " + std::to_string(layer) + ","
+			+ agi::Time(start).GetAssFormatted() + ","
+			+ agi::Time(end).GetAssFormatted() + ","
+			+ style + ",,0,0,0," + effect + "," + text;
+	}
+
+	std::string DialogueText() {
+		std::string text;
+		const int count = Random(4, 12);
+		for (int i = 0; i < count; ++i) {
+			if (i) text += i == count / 2 && Random(0, 19) == 0 ? "\\N" : " ";
+			if (Random(0, 9) == 0)
+				text += "{\\i1}" + Word() + "{\\i0}";
+			else
+				text += Word();
+		}
+		return text;
+	}
+
+	std::string KaraokeText(int duration) {
+		std::string text;
+		const int count = Random(4, 16);
+		const int length = std::max(1, duration / 10 / count);
+		for (int i = 0; i < count; ++i) {
+			text += "{\\k" + std::to_string(length) + "}" + syllables[Random(0, syllable_count - 1)];
+			if (Random(0, 3) == 0) text += " ";
+		}
+		return text;
+	}
+
+	std::string TypesettingText() {
+		const int x = Random(0, 1800), y = Random(0, 1000);
+		const int w = Random(50, 400), h = Random(20, 200);
+		std::string text = "{\\an7\\pos(" + std::to_string(x) + "," + std::to_string(y) + ")";
+		text += "\\clip(m " + std::to_string(x) + " " + std::to_string(y)
+			+ " l " + std::to_string(x + w) + " " + std::to_string(y)
+			+ " " + std::to_string(x + w) + " " + std::to_string(y + h)
+			+ " " + std::to_string(x) + " " + std::to_string(y + h) + ")";
+		text += "\\t(0," + std::to_string(Random(100, 1000)) + ",\\frz" + std::to_string(Random(-30, 30))
+			+ "\\fscx" + std::to_string(Random(80, 150)) + ")";
+		text += "\\blur" + std::to_string(Random(0, 5)) + "\\3c&H" + std::to_string(Random(100000, 999999)) + "&}";
+		return text + Word() + " " + Word();
+	}
+
+public:
+	Generator(fixtures::ScriptOptions const& opt) : opt(opt), rng(opt.seed) { }
+
+	std::string Header() {
+		std::string header =
+			"[Script Info]\n"
+			"; Synthetic script generated for benchmarks\n"
+			"ScriptType: v4.00+\n"
+			"WrapStyle: 0\n"
+			"PlayResX: 1920\n"
+			"PlayResY: 1080\n"
+			"\n"
+			"[V4+ Styles]\n"
+			"Format: Name, Fontname, Fontsize, PrimaryColour, SecondaryColour, OutlineColour, BackColour, Bold, Italic, Underline, StrikeOut, ScaleX, ScaleY, Spacing, Angle, BorderStyle, Outline, Shadow, Alignment, MarginL, MarginR, MarginV, Encoding\n";
+		for (size_t i = 0; i < std::max<size_t>(1, opt.styles); ++i) {
+			header += "Style: " + StyleName(i) + ",Font " + std::to_string(i % 7) + ","
+				+ std::to_string(Random(30, 90))
+				+ ",&H00FFFFFF,&H000000FF,&H00000000,&H80000000,"
+				+ (i % 3 == 1 ? "-1" : "0") + ",0,0,0,100,100,0,0,1,2,1,"
+				+ std::to_string(i % 9 + 1) + ",20,20,20,1\n";
+		}
+		return header + "\n";
+	}
+
+	std::string Fonts() {
+		if (!opt.attachments) return "";
+
+		std::string fonts = "[Fonts]\n";
+		std::vector<char> data(opt.attachment_size);
+		for (size_t i = 0; i < opt.attachments; ++i) {
+			for (auto& c : data)
+				c = static_cast<char>(rng());
+			fonts += "fontname: font" + std::to_string(i) + "_0.ttf\n";
+			fonts += agi::ass::UUEncode(data.data(), data.data() + data.size());
+			fonts += "\n";
+		}
+		return fonts + "\n";
+	}
+
+	std::string Events() {
+		std::vector<std::string> events;
+		events.reserve(opt.lines);
+
+		int time = 0;
+		for (size_t i = 0; i < opt.lines; ++i) {
+			auto shape = opt.shape;
+			if (shape == fixtures::ScriptShape::Mixed)
+				shape = static_cast<fixtures::ScriptShape>(i % 3);
+
+			time += Random(200, 2500);
+			const int duration = Random(1000, 4000);
+			const auto style = StyleName(i);
+
+			switch (shape) {
+				case fixtures::ScriptShape::Karaoke:
+					if (i % 500 == 0)
+						events.push_back(Event("Comment", 0, 0, 0, style, "template syl",
+							"{\\pos($x,$y)\\t($start,$end,\\fscx120\\fscy120)\\fad(100,100)}"));
+					events.push_back(Event("Dialogue", 0, time, time + duration, style, "karaoke", KaraokeText(duration)));
+					break;
+				case fixtures::ScriptShape::Typesetting:
+					events.push_back(Event("Dialogue", Random(0, 3), time, time + duration, style, "", TypesettingText()));
+					break;
+				default:
+					events.push_back(Event("Dialogue", 0, time, time + duration, style, "", DialogueText()));
+					break;
+			}
+		}
+
+		if (opt.shuffled)
+			std::shuffle(events.begin(), events.end(), rng);
+
+		std::string text =
+			"[Events]\n"
+			"Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n";
+		for (auto const& event : events) {
+			text += event;
+			text += '\n';
+		}
+		return text;
+	}
+};
+
+void write_le(std::string& out, uint32_t value, int bytes) {
+	for (int i = 0; i < bytes; ++i)
+		out += static_cast<char>((value >> (8 * i)) & 0xFF);
+}
+}
+
+namespace fixtures {
+std::string GenerateScript(ScriptOptions const& options) {
+	Generator generator(options);
+	auto script = generator.Header();
+	script += generator.Fonts();
+	script += generator.Events();
+	return script;
+}
+
+std::string GenerateWav(PCMOptions const& options) {
+	const int channels = std::max(1, options.channels);
+	const uint32_t samples = static_cast<uint32_t>(options.seconds * options.sample_rate);
+	const uint32_t data_size = samples * channels * 2;
+
+	std::string wav;
+	wav.reserve(44 + data_size);
+	wav += "RIFF";
+	write_le(wav, 36 + data_size, 4);
+	wav += "WAVEfmt ";
+	write_le(wav, 16, 4);
+	write_le(wav, 1, 2); // PCM
+	write_le(wav, channels, 2);
+	write_le(wav, options.sample_rate, 4);
+	write_le(wav, options.sample_rate * channels * 2, 4);
+	write_le(wav, channels * 2, 2);
+	write_le(wav, 16, 2);
+	wav += "data";
+	write_le(wav, data_size, 4);
+
+	std::mt19937 rng(options.seed);
+	std::uniform_real_distribution<double> noise(-1, 1);
+	std::uniform_real_distribution<double> burst_length(0.3, 2.0);
+	std::uniform_real_distribution<double> gap_length(0.1, 0.8);
+	std::uniform_real_distribution<double> pitch(100, 400);
+
+	const double pi = 3.14159265358979323846;
+	uint32_t sample = 0;
+	while (sample < samples) {
+		// A burst of a voice-like tone with harmonics and some noise...
+		const uint32_t burst = std::min(samples - sample, static_cast<uint32_t>(burst_length(rng) * options.sample_rate));
+		const double freq = pitch(rng);
+		for (uint32_t i = 0; i < burst; ++i, ++sample) {
+			const double t = double(sample) / options.sample_rate;
+			const double envelope = std::sin(pi * i / burst);
+			const double value = envelope * (0.5 * std::sin(2 * pi * freq * t)
+				+ 0.2 * std::sin(4 * pi * freq * t) + 0.05 * noise(rng));
+			for (int c = 0; c < channels; ++c)
+				write_le(wav, static_cast<uint16_t>(static_cast<int16_t>(value * 32767)), 2);
+		}
+
+		// ...followed by near silence
+		const uint32_t gap = std::min(samples - sample, static_cast<uint32_t>(gap_length(rng) * options.sample_rate));
+		for (uint32_t i = 0; i < gap; ++i, ++sample) {
+			for (int c = 0; c < channels; ++c)
+				write_le(wav, static_cast<uint16_t>(static_cast<int16_t>(noise(rng) * 30)), 2);
+		}
+	}
+	return wav;
+}
+}
@@ -0,0 +1,71 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+/// @file fixtures.h
+/// @brief Generators for large synthetic subtitle and audio files
+///
+/// Everything generated is a deterministic function of the options, so
+/// timings taken on different builds are of the same input.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace fixtures {
+/// What the events of a generated script look like
+enum class ScriptShape {
+	/// Plain lines of dialogue with the occasional italic
+	Dialogue,
+	/// Karaoke timed lines, plus a few karaoke template comments
+	Karaoke,
+	/// Signs with \pos, vector \clip and \t animations on several layers
+	Typesetting,
+	/// An even mix of the other shapes
+	Mixed
+};
+
+struct ScriptOptions {
+	/// Number of events
+	size_t lines = 10000;
+	ScriptShape shape = ScriptShape::Dialogue;
+	/// Number of styles, which the events cycle through
+	size_t styles = 1;
+	/// Number of attached fonts
+	size_t attachments = 0;
+	/// Size in bytes of each attached font before encoding
+	size_t attachment_size = 64 * 1024;
+	/// Write the events in random rather than time order
+	bool shuffled = false;
+	/// Seed for the random parts of the script
+	uint32_t seed = 1;
+};
+
+/// Generate an ASS script
+std::string GenerateScript(ScriptOptions const& options);
+
+struct PCMOptions {
+	int sample_rate = 48000;
+	int channels = 2;
+	/// Length of the audio in seconds
+	double seconds = 60;
+	/// Seed for the noise mixed into the signal
+	uint32_t seed = 1;
+};
+
+/// Generate a 16-bit RIFF WAV file of speech-like bursts of tones and
+/// noise separated by silence
+std::string GenerateWav(PCMOptions const& options);
+}
@@ -0,0 +1,163 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <libaegisub/alpha_blend.h>
+
+#include <main.h>
+
+#include <random>
+#include <vector>
+
+class lagi_alpha_blend : public libagi { };
+
+namespace {
+// The per-pixel blends the subtitle providers used before the shared kernels
+
+void ReferenceMask(std::vector<uint8_t>& dst, int pitch, std::vector<uint8_t> const& mask, int width, int height, uint32_t color, bool with_alpha) {
+	unsigned int opacity = 255 - (color & 0xFF);
+	unsigned int r = color >> 24, g = (color >> 16) & 0xFF, b = (color >> 8) & 0xFF;
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			uint8_t *px = &dst[y * pitch + x * 4];
+			unsigned int k = (unsigned)mask[y * width + x] * opacity / 255;
+			unsigned int ck = 255 - k;
+			px[0] = (k * b + ck * px[0]) / 255;
+			px[1] = (k * g + ck * px[1]) / 255;
+			px[2] = (k * r + ck * px[2]) / 255;
+			px[3] = with_alpha ? k + ck * px[3] / 255 : 0;
+		}
+	}
+}
+
+void ReferencePremultiplied(std::vector<uint8_t>& dst, int pitch, std::vector<uint8_t> const& src, int width, int height, bool rgba, bool with_alpha) {
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			uint8_t *px = &dst[y * pitch + x * 4];
+			const uint8_t *s = &src[(y * width + x) * 4];
+			unsigned int inv_alpha = 255 - s[3];
+			px[0] = static_cast<uint8_t>(s[rgba ? 2 : 0] + (px[0] * inv_alpha) / 255);
+			px[1] = static_cast<uint8_t>(s[1] + (px[1] * inv_alpha) / 255);
+			px[2] = static_cast<uint8_t>(s[rgba ? 0 : 2] + (px[2] * inv_alpha) / 255);
+			px[3] = with_alpha ? static_cast<uint8_t>(s[3] + (px[3] * inv_alpha) / 255) : 0;
+		}
+	}
+}
+
+std::vector<uint8_t> RandomBytes(std::mt19937& rng, size_t count) {
+	std::uniform_int_distribution<int> dist(0, 255);
+	std::vector<uint8_t> ret(count);
+	for (auto& b : ret) b = dist(rng);
+	// Make sure the extremes are covered
+	if (count > 2) {
+		ret[0] = 0;
+		ret[1] = 255;
+	}
+	return ret;
+}
+}
+
+TEST(lagi_alpha_blend, mask_matches_reference) {
+	std::mt19937 rng(1234);
+	for (int width : {1, 3, 4, 7, 16, 33}) {
+		for (bool with_alpha : {false, true}) {
+			for (uint32_t transparency : {0u, 0x40u, 0xFFu}) {
+				const int height = 5, pitch = width * 4 + 8;
+				auto dst = RandomBytes(rng, pitch * height);
+				auto mask = RandomBytes(rng, width * height);
+				uint32_t color = (uint32_t)rng() & 0xFFFFFF00 | transparency;
+
+				auto expected = dst;
+				ReferenceMask(expected, pitch, mask, width, height, color, with_alpha);
+				agi::BlendMask(dst.data(), pitch, mask.data(), width, width, height, color, with_alpha);
+				ASSERT_EQ(expected, dst) << "width " << width << " alpha " << with_alpha << " color " << color;
+			}
+		}
+	}
+}
+
+TEST(lagi_alpha_blend, premultiplied_matches_reference) {
+	std::mt19937 rng(5678);
+	for (int width : {1, 3, 4, 7, 16, 33}) {
+		for (bool rgba : {false, true}) {
+			for (bool with_alpha : {false, true}) {
+				const int height = 5, pitch = width * 4 + 8;
+				auto dst = RandomBytes(rng, pitch * height);
+				// Not premultiplied, so that the wraparound is exercised too
+				auto src = RandomBytes(rng, width * height * 4);
+
+				auto expected = dst;
+				ReferencePremultiplied(expected, pitch, src, width, height, rgba, with_alpha);
+				agi::BlendPremultiplied(dst.data(), pitch, src.data(), width * 4, width, height, rgba, with_alpha);
+				ASSERT_EQ(expected, dst) << "width " << width << " rgba " << rgba << " alpha " << with_alpha;
+			}
+		}
+	}
+}
+
+TEST(lagi_alpha_blend, negative_pitch) {
+	std::mt19937 rng(42);
+	const int width = 9, height = 4, pitch = width * 4;
+	auto dst = RandomBytes(rng, pitch * height);
+	auto mask = RandomBytes(rng, width * height);
+
+	// Blending bottom-up with a negative pitch is the same as blending a
+	// vertically flipped mask top-down
+	std::vector<uint8_t> flipped(mask.size());
+	for (int y = 0; y < height; ++y)
+		std::copy(&mask[y * width], &mask[y * width] + width, &flipped[(height - 1 - y) * width]);
+
+	auto expected = dst;
+	ReferenceMask(expected, pitch, flipped, width, height, 0x11223300, false);
+	agi::BlendMask(&dst[(height - 1) * pitch], -pitch, mask.data(), width, width, height, 0x11223300, false);
+	EXPECT_EQ(expected, dst);
+}
+
+TEST(lagi_alpha_blend, tiled_matches_sequential) {
+	std::mt19937 rng(99);
+	const int width = 1024, height = 700, pitch = width * 4;
+	auto dst = RandomBytes(rng, pitch * height);
+
+	// Large overlapping images, some crossing several tile boundaries, so
+	// that z-order within each tile matters
+	std::vector<std::vector<uint8_t>> data;
+	std::vector<agi::BlendImage> images;
+	for (int i = 0; i < 40; ++i) {
+		agi::BlendImage img;
+		img.type = i % 3 ? agi::BlendImage::Mask : agi::BlendImage::PremultipliedRGBA;
+		img.width = 1 + rng() % 400;
+		img.height = 1 + rng() % 300;
+		img.x = rng() % (width - img.width);
+		img.y = rng() % (height - img.height);
+		img.stride = img.width * (img.type == agi::BlendImage::Mask ? 1 : 4) + 3;
+		img.color = (uint32_t)rng() & 0xFFFFFF7F;
+		data.push_back(RandomBytes(rng, img.stride * img.height));
+		img.data = data.back().data();
+		images.push_back(img);
+	}
+
+	for (bool with_alpha : {false, true}) {
+		auto expected = dst;
+		for (auto const& img : images) {
+			uint8_t *out = &expected[img.y * pitch + img.x * 4];
+			if (img.type == agi::BlendImage::Mask)
+				agi::BlendMask(out, pitch, img.data, img.stride, img.width, img.height, img.color, with_alpha);
+			else
+				agi::BlendPremultiplied(out, pitch, img.data, img.stride, img.width, img.height, true, with_alpha);
+		}
+
+		auto actual = dst;
+		agi::BlendImages(actual.data(), pitch, height, images, with_alpha);
+		ASSERT_EQ(expected, actual);
+	}
+}
@@ -16,13 +16,22 @@
 
 #include <main.h>
 
+#include <libaegisub/audio/analysis_stream.h>
+#include <libaegisub/audio/clip_export.h>
+#include <libaegisub/audio/peak_pyramid.h>
+#include <libaegisub/audio/playback_buffer.h>
 #include <libaegisub/audio/provider.h>
+#include <libaegisub/audio/speech_detector.h>
+#include <libaegisub/background_runner.h>
 #include <libaegisub/fs.h>
 #include <libaegisub/make_unique.h>
 #include <libaegisub/path.h>
 #include <libaegisub/util.h>
 
 #include <boost/filesystem/fstream.hpp>
+#include <cmath>
+#include <mutex>
+#include <random>
 
 namespace bfs = boost::filesystem;
 
@@ -170,6 +179,61 @@ TEST(lagi_audio, save_audio_clip_out_of_audio_range) {
 	agi::fs::Remove(path);
 }
 
+struct CancellingProgressSink final : agi::ProgressSink {
+	int64_t progress = 0;
+	int64_t cancel_after;
+
+	CancellingProgressSink(int64_t cancel_after) : cancel_after(cancel_after) { }
+
+	void SetIndeterminate() override { }
+	void SetTitle(std::string const&) override { }
+	void SetMessage(std::string const&) override { }
+	void SetProgress(int64_t cur, int64_t) override { progress = std::max(progress, cur); }
+	void Log(std::string const&) override { }
+	void SetStayOpen(bool) override { }
+	bool IsCancelled() override { return progress >= cancel_after; }
+};
+
+TEST(lagi_audio, save_audio_clips) {
+	TestAudioProvider<> provider;
+	std::vector<agi::AudioClip> clips;
+	for (int i = 0; i < 20; ++i)
+		clips.push_back({agi::Path().Decode("?temp/save_clips_" + std::to_string(i)), i * 1000, i * 1000 + 10 + i});
+
+	CancellingProgressSink ps(1000);
+	agi::SaveAudioClips(provider, clips, &ps);
+	EXPECT_EQ(20, ps.progress);
+
+	for (int i = 0; i < 20; ++i) {
+		bfs::ifstream s(clips[i].path, std::ios_base::binary);
+		ASSERT_TRUE(s.good());
+		s.seekg(0, std::ios::end);
+		EXPECT_EQ((10 + i) * 48 * 2 + 44, s.tellg());
+
+		// The test provider's samples are their own index
+		uint16_t first;
+		s.seekg(44);
+		s.read(reinterpret_cast<char *>(&first), sizeof(first));
+		EXPECT_EQ(static_cast<uint16_t>(i * 48000), first);
+		s.close();
+		agi::fs::Remove(clips[i].path);
+	}
+}
+
+TEST(lagi_audio, save_audio_clips_cancelled) {
+	TestAudioProvider<> provider;
+	std::vector<agi::AudioClip> clips;
+	for (int i = 0; i < 200; ++i)
+		clips.push_back({agi::Path().Decode("?temp/save_clips_" + std::to_string(i)), 0, 10});
+
+	CancellingProgressSink ps(5);
+	EXPECT_THROW(agi::SaveAudioClips(provider, clips, &ps), agi::UserCancelException);
+	EXPECT_GT(200, ps.progress);
+
+	for (auto const& clip : clips)
+		agi::fs::Remove(clip.path);
+}
+
 TEST(lagi_audio, get_with_volume) {
 	TestAudioProvider<> provider;
 	int16_t buff[4];
@@ -228,6 +292,609 @@ TEST(lagi_audio, hd_cache) {
 		ASSERT_EQ(static_cast<uint16_t>((1 << 22) - 256 + i), buff[i]);
 }
 
+TEST(lagi_audio, ram_cache_spans) {
+	auto provider = agi::CreateRAMAudioProvider(agi::make_unique<TestAudioProvider<>>());
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+
+	auto span = provider->GetAudioSpan(100, 50);
+	ASSERT_TRUE(span);
+	EXPECT_EQ(50, span.count);
+	for (int i = 0; i < 50; ++i)
+		ASSERT_EQ(static_cast<uint16_t>(100 + i), static_cast<const uint16_t *>(span.data)[i]);
+
+	// Stops at the end of the cache block
+	const int64_t block = (1 << 22) / 2;
+	EXPECT_EQ(10, provider->GetAudioSpan(block - 10, 20).count);
+	EXPECT_EQ(5, provider->GetAudioSpan(provider->GetNumSamples() - 5, 20).count);
+	EXPECT_FALSE(provider->GetAudioSpan(provider->GetNumSamples(), 20));
+}
+
+TEST(lagi_audio, hd_cache_spans) {
+	auto provider = agi::CreateHDAudioProvider(agi::make_unique<TestAudioProvider<>>(), agi::Path().Decode("?temp"));
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+
+	{
+		auto span = provider->GetAudioSpan(65536 - 20, 50);
+		ASSERT_TRUE(span);
+		EXPECT_EQ(20, span.count);
+		for (int i = 0; i < 20; ++i)
+			ASSERT_EQ(static_cast<uint16_t>(65536 - 20 + i), static_cast<const uint16_t *>(span.data)[i]);
+	}
+
+	// Reading again once the span is gone doesn't deadlock
+	uint16_t buff[16];
+	provider->GetAudio(buff, 0, 16);
+	EXPECT_EQ(15, buff[15]);
+}
+
+TEST(lagi_audio, cache_converts_to_int16_mono_in_place) {
+	auto src = agi::make_unique<TestAudioProvider<uint8_t>>();
+	src->bias = 128;
+	std::vector<int16_t> expected(1000), actual(1000);
+	src->GetInt16MonoAudio(expected.data(), (1 << 22) - 500, expected.size());
+
+	auto provider = agi::CreateRAMAudioProvider(std::move(src));
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+	ASSERT_TRUE(provider->GetAudioSpan(0, 1));
+	provider->GetInt16MonoAudio(actual.data(), (1 << 22) - 500, actual.size());
+	EXPECT_EQ(expected, actual);
+}
+
+TEST(lagi_audio, on_demand_cache_spans) {
+	auto provider = agi::CreateOnDemandAudioProvider(agi::make_unique<TestAudioProvider<>>(), 64 << 20);
+	EXPECT_FALSE(provider->GetAudioSpan(100, 10));
+
+	uint16_t buff[16];
+	provider->GetAudio(buff, 100, 16);
+	auto span = provider->GetAudioSpan(100, 10);
+	ASSERT_TRUE(span);
+	EXPECT_EQ(10, span.count);
+	EXPECT_EQ(100, static_cast<const uint16_t *>(span.data)[0]);
+}
+
+TEST(lagi_audio, peak_pyramid) {
+	TestAudioProvider<int16_t> provider(2);
+	provider.bias = -30000;
+
+	agi::AudioPeakPyramid peaks(provider.GetNumSamples());
+	agi::AudioPeak peak;
+	EXPECT_FALSE(peaks.Get(0, 256, &peak));
+
+	peaks.Update(provider, 0, provider.GetNumSamples());
+
+	auto check_range = [&](int64_t start, int64_t end) {
+		std::vector<int16_t> samples(end - start);
+		provider.GetInt16MonoAudio(samples.data(), start, end - start);
+
+		agi::AudioPeak expected;
+		for (auto sample : samples) {
+			if (sample > 0) {
+				expected.max = std::max(expected.max, sample);
+				expected.pos_sum += sample;
+			}
+			else {
+				expected.min = std::min(expected.min, sample);
+				expected.neg_sum += sample;
+			}
+		}
+
+		agi::AudioPeak actual;
+		ASSERT_TRUE(peaks.Get(start, end, &actual));
+		EXPECT_EQ(expected.min, actual.min);
+		EXPECT_EQ(expected.max, actual.max);
+		EXPECT_EQ(expected.pos_sum, actual.pos_sum);
+		EXPECT_EQ(expected.neg_sum, actual.neg_sum);
+	};
+
+	check_range(0, 256);
+	check_range(256 * 3, 256 * 17);
+	check_range(65536 - 4096 - 256, 65536 * 3 + 4096 + 512);
+	check_range(256 * 101, provider.GetNumSamples());
+}
+
+TEST(lagi_audio, peak_pyramid_out_of_order) {
+	struct PartialProvider : TestAudioProvider<int16_t> {
+		int64_t decoded_start = 0;
+		PartialProvider() : TestAudioProvider<int16_t>(2) { }
+		bool IsRangeDecoded(int64_t start, int64_t count) const override {
+			return start >= decoded_start;
+		}
+	} provider;
+
+	agi::AudioPeakPyramid peaks(provider.GetNumSamples());
+
+	// The bucket straddling the start isn't complete yet, so it's skipped
+	provider.decoded_start = 70000;
+	peaks.Update(provider, 70000, provider.GetNumSamples());
+
+	agi::AudioPeak peak;
+	EXPECT_TRUE(peaks.Get(70144, provider.GetNumSamples(), &peak));
+	EXPECT_FALSE(peaks.Get(69888, provider.GetNumSamples(), &peak));
+	EXPECT_FALSE(peaks.Get(0, 65536, &peak));
+
+	provider.decoded_start = 0;
+	peaks.Update(provider, 0, 70000);
+	EXPECT_TRUE(peaks.Get(0, provider.GetNumSamples(), &peak));
+	EXPECT_EQ(32767, peak.max);
+}
+
+struct HalfLoudProvider : TestAudioProvider<int16_t> {
+	int64_t decoded_start = 0;
+	HalfLoudProvider() : TestAudioProvider<int16_t>(2) { }
+	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
+		auto out = static_cast<int16_t *>(buf);
+		for (int64_t end = start + count; start < end; ++start)
+			*out++ = start >= num_samples / 2 ? 0 : start % 2 ? 16384 : -16384;
+	}
+	bool IsRangeDecoded(int64_t start, int64_t count) const override {
+		return start >= decoded_start;
+	}
+};
+
+TEST(lagi_audio, loudness_overview) {
+	HalfLoudProvider provider;
+	agi::AudioPeakPyramid peaks(provider.GetNumSamples());
+	peaks.Update(provider, 0, provider.GetNumSamples());
+
+	agi::AudioLoudnessOverview overview(provider.GetNumSamples(), 100);
+	ASSERT_EQ(100u, overview.size());
+	EXPECT_TRUE(overview.Update(peaks));
+	EXPECT_TRUE(overview.IsComplete());
+	EXPECT_FALSE(overview.Update(peaks));
+
+	// 16384 is 6 dB below full scale
+	const int loud = 1 + (int)std::lround((agi::AudioLoudnessOverview::Floor + 20 * std::log10(0.5)) / agi::AudioLoudnessOverview::Floor * 254);
+	// Slices are widened out to whole buckets, so the two in the middle
+	// each pick up a little of the other half
+	for (size_t i = 0; i < 49; ++i)
+		EXPECT_EQ(loud, overview[i]) << i;
+	EXPECT_GT(loud, overview[49]);
+	EXPECT_LT(1, overview[50]);
+	for (size_t i = 51; i < 100; ++i)
+		EXPECT_EQ(1, overview[i]) << i;
+}
+
+TEST(lagi_audio, loudness_overview_fills_in_as_audio_decodes) {
+	HalfLoudProvider provider;
+	agi::AudioPeakPyramid peaks(provider.GetNumSamples());
+	agi::AudioLoudnessOverview overview(provider.GetNumSamples(), 10);
+	EXPECT_FALSE(overview.Update(peaks));
+	EXPECT_EQ(0, overview[0]);
+
+	provider.decoded_start = provider.GetNumSamples() / 2;
+	peaks.Update(provider, provider.decoded_start, provider.GetNumSamples());
+	EXPECT_TRUE(overview.Update(peaks));
+	EXPECT_FALSE(overview.IsComplete());
+	EXPECT_EQ(0, overview[4]);
+	// The bucket straddling the start of the decoded half isn't summarized
+	// yet, and the first slice of the half includes it
+	EXPECT_EQ(0, overview[5]);
+	EXPECT_EQ(1, overview[6]);
+
+	provider.decoded_start = 0;
+	peaks.Update(provider, 0, provider.GetNumSamples() / 2);
+	EXPECT_TRUE(overview.Update(peaks));
+	EXPECT_TRUE(overview.IsComplete());
+	EXPECT_LT(1, overview[4]);
+}
+
+TEST(lagi_audio, loudness_overview_wider_than_audio) {
+	TestAudioProvider<int16_t> provider(1);
+	agi::AudioPeakPyramid peaks(provider.GetNumSamples());
+	peaks.Update(provider, 0, provider.GetNumSamples());
+
+	// Many more slices than buckets
+	agi::AudioLoudnessOverview overview(provider.GetNumSamples(), 1000);
+	overview.Update(peaks);
+	EXPECT_TRUE(overview.IsComplete());
+	EXPECT_LT(1, overview[999]);
+
+	agi::AudioLoudnessOverview empty(0, 100);
+	EXPECT_EQ(0u, empty.size());
+	EXPECT_TRUE(empty.IsComplete());
+}
+
+TEST(lagi_audio, ram_cache_builds_peaks) {
+	auto provider = agi::CreateRAMAudioProvider(agi::make_unique<TestAudioProvider<>>());
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+
+	auto peaks = provider->GetPeaks();
+	ASSERT_NE(nullptr, peaks);
+
+	agi::AudioPeak peak;
+	ASSERT_TRUE(peaks->Get(0, 256, &peak));
+	EXPECT_EQ(255, peak.max);
+	EXPECT_EQ(0, peak.min);
+	EXPECT_EQ(255 * 256 / 2, peak.pos_sum);
+}
+
+/// Ten seconds of quiet noise with some tones standing in for speech and a
+/// stretch of louder hiss
+struct SpeechAudioProvider : agi::AudioProvider {
+	SpeechAudioProvider() {
+		channels = 1;
+		num_samples = 10 * 48000;
+		decoded_samples = num_samples;
+		sample_rate = 48000;
+		bytes_per_sample = 2;
+		float_samples = false;
+	}
+
+	static int16_t Noise(int64_t i, int amplitude) {
+		uint32_t h = static_cast<uint32_t>(i) * 2654435761u;
+		h ^= h >> 15;
+		h *= 2246822519u;
+		h ^= h >> 13;
+		return static_cast<int16_t>(static_cast<int>(h % (2 * amplitude + 1)) - amplitude);
+	}
+
+	static bool IsSpeech(int64_t ms) {
+		return (ms >= 1000 && ms < 2500) || (ms >= 3000 && ms < 3100)
+			|| (ms >= 5000 && ms < 5050) // Too short to count
+			|| (ms >= 6000 && ms < 6500) || (ms >= 6600 && ms < 7000); // Short enough gap to bridge
+	}
+
+	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
+		auto out = static_cast<int16_t *>(buf);
+		for (int64_t i = start; i < start + count; ++i) {
+			const int64_t ms = i / 48;
+			if (IsSpeech(ms))
+				*out++ = static_cast<int16_t>(8000 * std::sin(i * 2 * 3.14159265358979 * 200 / 48000));
+			else if (ms >= 8000 && ms < 9000)
+				*out++ = Noise(i, 300);
+			else
+				*out++ = Noise(i, 50);
+		}
+	}
+};
+
+TEST(lagi_audio, speech_detector) {
+	SpeechAudioProvider provider;
+	agi::AudioSpeechDetector speech(provider.GetNumSamples(), provider.GetSampleRate());
+
+	std::vector<agi::SpeechSegment> segments;
+	EXPECT_FALSE(speech.GetSegments(0, 10000, agi::SpeechDetectionSettings(), segments));
+	EXPECT_TRUE(segments.empty());
+
+	speech.Update(provider, 0, provider.GetNumSamples());
+	EXPECT_NEAR(-61, speech.NoiseFloor(), 2);
+
+	ASSERT_TRUE(speech.GetSegments(0, 10000, agi::SpeechDetectionSettings(), segments));
+	ASSERT_EQ(3u, segments.size());
+	EXPECT_EQ(1000, segments[0].start);
+	EXPECT_EQ(2500, segments[0].end);
+	EXPECT_EQ(3000, segments[1].start);
+	EXPECT_EQ(3100, segments[1].end);
+	EXPECT_EQ(6000, segments[2].start);
+	EXPECT_EQ(7000, segments[2].end);
+
+	// Segments overlapping the range are returned whole
+	segments.clear();
+	ASSERT_TRUE(speech.GetSegments(2000, 2100, agi::SpeechDetectionSettings(), segments));
+	ASSERT_EQ(1u, segments.size());
+	EXPECT_EQ(1000, segments[0].start);
+	EXPECT_EQ(2500, segments[0].end);
+
+	segments.clear();
+	agi::SpeechDetectionSettings no_bridging;
+	no_bridging.min_gap = 50;
+	speech.GetSegments(5500, 7500, no_bridging, segments);
+	ASSERT_EQ(2u, segments.size());
+	EXPECT_EQ(6500, segments[0].end);
+	EXPECT_EQ(6600, segments[1].start);
+}
+
+TEST(lagi_audio, speech_detector_out_of_order) {
+	struct PartialProvider : SpeechAudioProvider {
+		int64_t decoded_start = 0;
+		bool IsRangeDecoded(int64_t start, int64_t count) const override {
+			return start >= decoded_start;
+		}
+	} provider;
+
+	agi::AudioSpeechDetector speech(provider.GetNumSamples(), provider.GetSampleRate());
+
+	provider.decoded_start = 5 * 48000 + 100;
+	speech.Update(provider, provider.decoded_start, provider.GetNumSamples());
+
+	std::vector<agi::SpeechSegment> segments;
+	EXPECT_FALSE(speech.GetSegments(0, 10000, agi::SpeechDetectionSettings(), segments));
+	ASSERT_EQ(1u, segments.size());
+	EXPECT_EQ(6000, segments[0].start);
+
+	provider.decoded_start = 0;
+	speech.Update(provider, 0, 5 * 48000 + 100);
+	segments.clear();
+	EXPECT_TRUE(speech.GetSegments(0, 10000, agi::SpeechDetectionSettings(), segments));
+	EXPECT_EQ(3u, segments.size());
+}
+
+TEST(lagi_audio, ram_cache_detects_speech) {
+	auto provider = agi::CreateRAMAudioProvider(agi::make_unique<SpeechAudioProvider>());
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+
+	auto speech = provider->GetSpeech();
+	ASSERT_NE(nullptr, speech);
+
+	std::vector<agi::SpeechSegment> segments;
+	EXPECT_TRUE(speech->GetSegments(0, 10000, agi::SpeechDetectionSettings(), segments));
+	EXPECT_EQ(3u, segments.size());
+}
+
+struct RecordingAudioProvider : TestAudioProvider<> {
+	bool concurrent = false;
+	mutable std::mutex mutex;
+	mutable std::vector<int64_t> reads;
+
+	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			reads.push_back(start);
+		}
+		agi::util::sleep_for(5);
+		TestAudioProvider<>::FillBuffer(buf, start, count);
+	}
+
+	bool SupportsConcurrentReads() const override { return concurrent; }
+};
+
+TEST(lagi_audio, hd_cache_prioritized_decoding) {
+	auto src = agi::make_unique<RecordingAudioProvider>();
+	auto recorder = src.get();
+	auto provider = agi::CreateHDAudioProvider(std::move(src), agi::Path().Decode("?temp"));
+
+	const int64_t target = provider->GetNumSamples() - 65536 * 3;
+	EXPECT_FALSE(provider->IsRangeDecoded(target, 100));
+	provider->PrioritizeDecoding(target);
+	while (!provider->IsRangeDecoded(target, 100)) agi::util::sleep_for(0);
+
+	{
+		std::lock_guard<std::mutex> lock(recorder->mutex);
+		// Only blocks claimed before the priority change come first
+		auto it = std::find(recorder->reads.begin(), recorder->reads.end(), target / 65536 * 65536);
+		ASSERT_NE(recorder->reads.end(), it);
+		EXPECT_GE(2, it - recorder->reads.begin());
+	}
+
+	uint16_t buff[512];
+	provider->GetAudio(buff, target, 512);
+	for (size_t i = 0; i < 512; ++i)
+		ASSERT_EQ(static_cast<uint16_t>(target + i), buff[i]);
+}
+
+TEST(lagi_audio, ram_cache_concurrent_decoding) {
+	auto src = agi::make_unique<RecordingAudioProvider>();
+	src->concurrent = true;
+	auto provider = agi::CreateRAMAudioProvider(std::move(src));
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+	EXPECT_TRUE(provider->IsRangeDecoded(0, provider->GetNumSamples()));
+
+	std::vector<uint16_t> buff(provider->GetNumSamples());
+	provider->GetAudio(buff.data(), 0, buff.size());
+	for (size_t i = 0; i < buff.size(); ++i)
+		ASSERT_EQ(static_cast<uint16_t>(i), buff[i]);
+}
+
+/// Number of samples in each of the on-demand cache's blocks for a 16-bit mono
+/// source
+const int64_t on_demand_block = (1 << 20) / 2;
+
+size_t count_reads(RecordingAudioProvider const& recorder, int64_t start) {
+	std::lock_guard<std::mutex> lock(recorder.mutex);
+	return std::count(recorder.reads.begin(), recorder.reads.end(), start);
+}
+
+TEST(lagi_audio, on_demand_cache) {
+	auto provider = agi::CreateOnDemandAudioProvider(agi::make_unique<TestAudioProvider<>>(), 64 << 20);
+	EXPECT_TRUE(provider->IsRangeDecoded(0, provider->GetNumSamples()));
+
+	// Spans the boundary between the first two blocks
+	std::vector<uint16_t> buff(1000);
+	provider->GetAudio(buff.data(), on_demand_block - 500, buff.size());
+	for (size_t i = 0; i < buff.size(); ++i)
+		ASSERT_EQ(static_cast<uint16_t>(on_demand_block - 500 + i), buff[i]);
+
+	// Runs off the end of the audio
+	const int64_t end = provider->GetNumSamples();
+	provider->GetAudio(buff.data(), end - 500, buff.size());
+	for (size_t i = 0; i < 500; ++i)
+		ASSERT_EQ(static_cast<uint16_t>(end - 500 + i), buff[i]);
+	for (size_t i = 500; i < buff.size(); ++i)
+		ASSERT_EQ(0, buff[i]);
+}
+
+TEST(lagi_audio, on_demand_cache_reuses_blocks) {
+	auto src = agi::make_unique<RecordingAudioProvider>();
+	auto recorder = src.get();
+	auto provider = agi::CreateOnDemandAudioProvider(std::move(src), 64 << 20);
+
+	// The last block, so that nothing after it is prefetched
+	const int64_t start = provider->GetNumSamples() / on_demand_block * on_demand_block;
+	uint16_t buff[512];
+	provider->GetAudio(buff, start + 10, 512);
+	provider->GetAudio(buff, start + 100, 512);
+	EXPECT_EQ(1u, count_reads(*recorder, start));
+	for (size_t i = 0; i < 512; ++i)
+		ASSERT_EQ(static_cast<uint16_t>(start + 100 + i), buff[i]);
+}
+
+TEST(lagi_audio, on_demand_cache_evicts_least_recently_used) {
+	auto src = agi::make_unique<RecordingAudioProvider>();
+	auto recorder = src.get();
+	// Rounded up to the minimum of four blocks
+	auto provider = agi::CreateOnDemandAudioProvider(std::move(src), 0);
+
+	// Read backwards so that the blocks prefetched are always already cached
+	const int64_t last = provider->GetNumSamples() / on_demand_block;
+	uint16_t buff[16];
+	for (int64_t block = last; block >= last - 4; --block)
+		provider->GetAudio(buff, block * on_demand_block, 16);
+	for (int64_t block = last; block >= last - 4; --block)
+		EXPECT_EQ(1u, count_reads(*recorder, block * on_demand_block));
+
+	// The most recent four are still cached, but the first was evicted
+	provider->GetAudio(buff, (last - 1) * on_demand_block, 16);
+	EXPECT_EQ(1u, count_reads(*recorder, (last - 1) * on_demand_block));
+	provider->GetAudio(buff, last * on_demand_block, 16);
+	EXPECT_EQ(2u, count_reads(*recorder, last * on_demand_block));
+	for (size_t i = 0; i < 16; ++i)
+		ASSERT_EQ(static_cast<uint16_t>(last * on_demand_block + i), buff[i]);
+}
+
+TEST(lagi_audio, on_demand_cache_prefetches_prioritized_audio) {
+	auto src = agi::make_unique<RecordingAudioProvider>();
+	auto recorder = src.get();
+	auto provider = agi::CreateOnDemandAudioProvider(std::move(src), 64 << 20);
+
+	const int64_t target = on_demand_block * 3;
+	provider->PrioritizeDecoding(target + 100);
+	while (!count_reads(*recorder, target)) agi::util::sleep_for(0);
+
+	uint16_t buff[512];
+	provider->GetAudio(buff, target, 512);
+	EXPECT_EQ(1u, count_reads(*recorder, target));
+	for (size_t i = 0; i < 512; ++i)
+		ASSERT_EQ(static_cast<uint16_t>(target + i), buff[i]);
+}
+
+struct SineAudioProvider : TestAudioProvider<int16_t> {
+	double frequency;
+
+	SineAudioProvider(double frequency) : TestAudioProvider<int16_t>(10), frequency(frequency) { }
+
+	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
+		auto out = static_cast<int16_t *>(buf);
+		for (int64_t i = 0; i < count; ++i)
+			out[i] = (int16_t)(16000 * std::sin(2 * M_PI * frequency * (start + i) / sample_rate));
+	}
+
+	void SetDecoded(int64_t samples) { decoded_samples = samples; }
+};
+
+int16_t peak_amplitude(std::vector<int16_t> const& audio) {
+	int peak = 0;
+	for (auto sample : audio)
+		peak = std::max(peak, std::abs((int)sample));
+	return (int16_t)peak;
+}
+
+TEST(lagi_audio, analysis_stream_rate) {
+	TestAudioProvider<> provider;
+	agi::AudioAnalysisStream stream(provider, 16000, false);
+	EXPECT_EQ(3, stream.GetFactor());
+	EXPECT_EQ(16000, stream.GetSampleRate());
+	EXPECT_EQ(provider.GetNumSamples() / 3, stream.GetNumSamples());
+	EXPECT_FALSE(stream.IsPassthrough());
+
+	// 44.1 kHz can't be divided by three exactly
+	TestAudioProvider<> cd_provider(90, 44100);
+	EXPECT_EQ(2, agi::AudioAnalysisStream(cd_provider, 16000, false).GetFactor());
+
+	agi::AudioAnalysisStream full_rate(provider, 48000, false);
+	EXPECT_EQ(1, full_rate.GetFactor());
+	EXPECT_TRUE(full_rate.IsPassthrough());
+
+	// Still has to be converted to int16
+	TestAudioProvider<uint8_t> provider_8bit;
+	EXPECT_FALSE(agi::AudioAnalysisStream(provider_8bit, 48000, false).IsPassthrough());
+}
+
+TEST(lagi_audio, analysis_stream_full_rate_matches_source) {
+	TestAudioProvider<> provider;
+	agi::AudioAnalysisStream stream(provider, 48000, true);
+
+	std::vector<int16_t> expected(1000), actual(1000);
+	provider.GetInt16MonoAudio(expected.data(), 12345, 1000);
+	stream.GetAudio(actual.data(), 12345, 1000);
+	EXPECT_EQ(expected, actual);
+}
+
+TEST(lagi_audio, analysis_stream_filters_before_decimating) {
+	std::vector<int16_t> audio(4000);
+
+	// Well inside the 8 kHz Nyquist frequency of the output
+	SineAudioProvider low(1000);
+	agi::AudioAnalysisStream low_stream(low, 16000, false);
+	low_stream.GetAudio(audio.data(), 2000, audio.size());
+	EXPECT_NEAR(16000, peak_amplitude(audio), 300);
+
+	// Would alias to 4 kHz if simply decimated
+	SineAudioProvider high(12000);
+	agi::AudioAnalysisStream high_stream(high, 16000, false);
+	high_stream.GetAudio(audio.data(), 2000, audio.size());
+	EXPECT_GT(200, peak_amplitude(audio));
+}
+
+TEST(lagi_audio, analysis_stream_caches_only_decoded_audio) {
+	SineAudioProvider provider(1000);
+	provider.SetDecoded(0);
+	agi::AudioAnalysisStream stream(provider, 16000, true);
+
+	std::vector<int16_t> before(500), after(500);
+	stream.GetAudio(before.data(), 100, before.size());
+
+	// Audio which wasn't decoded before isn't served from the cache later
+	provider.SetDecoded(provider.GetNumSamples());
+	agi::AudioAnalysisStream fresh(provider, 16000, false);
+	fresh.GetAudio(after.data(), 100, after.size());
+	stream.GetAudio(before.data(), 100, before.size());
+	EXPECT_EQ(after, before);
+
+	for (auto const& usage : agi::memory::Snapshot()) {
+		if (usage.name == "Audio analysis stream")
+			EXPECT_EQ(sizeof(int16_t) * agi::AudioAnalysisStream::ChunkSamples, usage.bytes);
+	}
+}
+
+TEST(lagi_audio, persistent_cache_reused) {
+	auto cache_file = agi::Path().Decode("?temp") / "lagi_audio_persistent.pcmcache";
+	agi::fs::Remove(cache_file);
+
+	{
+		auto provider = agi::CreatePersistentAudioProvider(agi::make_unique<RecordingAudioProvider>(), cache_file);
+		while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+	}
+	ASSERT_TRUE(agi::fs::FileExists(cache_file));
+
+	auto src = agi::make_unique<RecordingAudioProvider>();
+	auto recorder = src.get();
+	auto provider = agi::CreatePersistentAudioProvider(std::move(src), cache_file);
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+	EXPECT_TRUE(recorder->reads.empty());
+
+	std::vector<uint16_t> buff(provider->GetNumSamples());
+	provider->GetAudio(buff.data(), 0, buff.size());
+	for (size_t i = 0; i < buff.size(); ++i)
+		ASSERT_EQ(static_cast<uint16_t>(i), buff[i]);
+
+	agi::AudioPeak peak;
+	while (!provider->GetPeaks()->Get(0, provider->GetNumSamples(), &peak)) agi::util::sleep_for(0);
+
+	provider.reset();
+	agi::fs::Remove(cache_file);
+}
+
+TEST(lagi_audio, persistent_cache_ignores_mismatched_file) {
+	auto cache_file = agi::Path().Decode("?temp") / "lagi_audio_persistent_format.pcmcache";
+	agi::fs::Remove(cache_file);
+
+	{
+		auto provider = agi::CreatePersistentAudioProvider(agi::make_unique<RecordingAudioProvider>(), cache_file);
+		while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+	}
+
+	// Same format but a different length, so the old file must not be used
+	auto provider = agi::CreatePersistentAudioProvider(agi::CreateConvertAudioProvider(agi::make_unique<TestAudioProvider<uint8_t>>(30)), cache_file);
+	while (provider->GetDecodedSamples() != provider->GetNumSamples()) agi::util::sleep_for(0);
+	int16_t data[256];
+	provider->GetInt16MonoAudio(data, 0, 256);
+	for (int i = 0; i < 256; ++i)
+		ASSERT_EQ((i - 128) * 256, data[i]);
+	provider.reset();
+
+	agi::fs::Remove(cache_file);
+}
+
 TEST(lagi_audio, convert_8bit) {
 	auto provider = agi::CreateConvertAudioProvider(agi::make_unique<TestAudioProvider<uint8_t>>());
 
@@ -358,6 +1025,196 @@ TEST(lagi_audio, double_conversion) {
 		ASSERT_EQ(i + SHRT_MIN, samples[i]);
 }
 
+struct RawAudioProvider : agi::AudioProvider {
+	std::vector<char> data;
+
+	RawAudioProvider(int channels, int bytes_per_sample, bool float_samples, int64_t num_samples) {
+		this->channels = channels;
+		this->num_samples = num_samples;
+		decoded_samples = num_samples;
+		sample_rate = 48000;
+		this->bytes_per_sample = bytes_per_sample;
+		this->float_samples = float_samples;
+		data.resize(num_samples * channels * bytes_per_sample);
+	}
+
+	void FillBuffer(void *buf, int64_t start, int64_t count) const override {
+		const size_t frame = channels * bytes_per_sample;
+		memcpy(buf, &data[start * frame], count * frame);
+	}
+
+	/// The int16 value of a sample, as documented for each format
+	int Reference(size_t idx) const {
+		const char *p = &data[idx * bytes_per_sample];
+		if (float_samples) {
+			double expanded = bytes_per_sample == 4 ? (double)(*reinterpret_cast<const float *>(p) * 32768) : *reinterpret_cast<const double *>(p) * 32768;
+			return expanded < -32768 ? -32768 : expanded > 32767 ? 32767 : (int16_t)expanded;
+		}
+		if (bytes_per_sample == 1)
+			return ((uint8_t)*p - 128) << 8;
+		int16_t high;
+		memcpy(&high, p + bytes_per_sample - 2, 2);
+		return high;
+	}
+};
+
+TEST(lagi_audio, int16_mono_conversion_matches_reference) {
+	std::mt19937 rng(1234);
+	const struct { int bytes; bool is_float; } formats[] = {
+		{1, false}, {2, false}, {3, false}, {4, false}, {4, true}, {8, true},
+	};
+
+	for (auto format : formats) {
+		for (int channels : {1, 2, 3, 6}) {
+			// Odd length so that the vector paths have a tail to finish
+			RawAudioProvider provider(channels, format.bytes, format.is_float, 1001);
+			if (format.is_float) {
+				// Slightly beyond full scale to exercise the clamping
+				std::uniform_real_distribution<double> dist(-1.1, 1.1);
+				for (size_t i = 0; i < provider.data.size() / format.bytes; ++i) {
+					if (format.bytes == 4) {
+						float f = (float)dist(rng);
+						memcpy(&provider.data[i * 4], &f, 4);
+					}
+					else {
+						double d = dist(rng);
+						memcpy(&provider.data[i * 8], &d, 8);
+					}
+				}
+			}
+			else {
+				for (auto& c : provider.data)
+					c = (char)rng();
+			}
+
+			std::vector<int16_t> out(provider.GetNumSamples());
+			provider.GetInt16MonoAudio(out.data(), 0, out.size());
+			for (size_t i = 0; i < out.size(); ++i) {
+				int sum = 0;
+				for (int c = 0; c < channels; ++c)
+					sum += provider.Reference(i * channels + c);
+				ASSERT_EQ(sum / channels, out[i]) << format.bytes << " bytes, float " << format.is_float << ", " << channels << " channels, sample " << i;
+			}
+		}
+	}
+}
+
+TEST(lagi_audio, compact_float) {
+	auto provider = agi::CreateCompactAudioProvider(agi::make_unique<FloatAudioProvider<float>>());
+	EXPECT_FALSE(provider->AreSamplesFloat());
+	EXPECT_EQ(2, provider->GetBytesPerSample());
+	EXPECT_EQ(1, provider->GetChannels());
+
+	int16_t samples[1 << 16];
+	provider->GetAudio(samples, 0, 1 << 16);
+	for (int i = 0; i < (1 << 16); ++i)
+		ASSERT_EQ(i + SHRT_MIN, samples[i]);
+}
+
+TEST(lagi_audio, compact_surround_to_stereo) {
+	struct AudioProvider : agi::AudioProvider {
+		AudioProvider() {
+			channels = 6;
+			num_samples = 90 * 48000;
+			decoded_samples = num_samples;
+			sample_rate = 48000;
+			bytes_per_sample = 4;
+			float_samples = false;
+		}
+
+		void FillBuffer(void *buf, int64_t start, int64_t count) const override {
+			auto out = static_cast<int32_t *>(buf);
+			for (int64_t end = start + count; start < end; ++start) {
+				*out++ = 500 << 16;
+				*out++ = -500 << 16;
+				for (int i = 0; i < 4; ++i)
+					*out++ = (int32_t)(start % 100) << 16;
+			}
+		}
+	};
+
+	auto provider = agi::CreateCompactAudioProvider(agi::make_unique<AudioProvider>());
+	EXPECT_EQ(2, provider->GetChannels());
+	EXPECT_EQ(2, provider->GetBytesPerSample());
+
+	int16_t samples[200];
+	provider->GetAudio(samples, 0, 100);
+	for (int i = 0; i < 100; ++i) {
+		ASSERT_EQ((500 + 4 * i) / 5, samples[i * 2]);
+		ASSERT_EQ((-500 + 4 * i) / 5, samples[i * 2 + 1]);
+	}
+}
+
+TEST(lagi_audio, compact_leaves_int16_stereo_alone) {
+	auto src = agi::make_unique<TestAudioProvider<>>();
+	auto raw = src.get();
+	auto provider = agi::CreateCompactAudioProvider(std::move(src));
+	EXPECT_EQ(raw, provider.get());
+}
+
+TEST(lagi_audio, playback_buffer_prefills) {
+	TestAudioProvider<> provider;
+	agi::AudioPlaybackBuffer buffer(&provider, false, 100);
+	buffer.Start(1000, 100000);
+
+	// The first 100ms are read before Start returns
+	uint16_t samples[480];
+	for (int i = 0; i < 10; ++i) {
+		ASSERT_EQ(480u, buffer.Read(samples, 480));
+		for (int j = 0; j < 480; ++j)
+			ASSERT_EQ(1000 + i * 480 + j, samples[j]);
+	}
+	EXPECT_EQ(1000 + 4800, buffer.GetPosition());
+	EXPECT_EQ(0u, buffer.GetUnderruns());
+}
+
+TEST(lagi_audio, playback_buffer_stops_at_end) {
+	TestAudioProvider<> provider;
+	agi::AudioPlaybackBuffer buffer(&provider, false, 100);
+	buffer.Start(1000, 100000);
+	buffer.SetEnd(1100);
+
+	uint16_t samples[480];
+	ASSERT_EQ(100u, buffer.Read(samples, 480));
+	EXPECT_EQ(1099, samples[99]);
+	EXPECT_EQ(0, samples[100]);
+	EXPECT_EQ(0, samples[479]);
+	EXPECT_TRUE(buffer.AtEnd());
+	EXPECT_EQ(0u, buffer.GetUnderruns());
+}
+
+TEST(lagi_audio, playback_buffer_counts_underruns) {
+	TestAudioProvider<> provider;
+	agi::AudioPlaybackBuffer buffer(&provider, false, 100);
+	buffer.Start(0, 100000);
+
+	// Nothing past the target latency can have been buffered before the
+	// first read
+	std::vector<uint16_t> samples(9600);
+	EXPECT_EQ(4800u, buffer.Read(samples.data(), samples.size()));
+	EXPECT_EQ(4799, samples[4799]);
+	EXPECT_EQ(0, samples[9599]);
+	EXPECT_EQ(1u, buffer.GetUnderruns());
+	EXPECT_EQ(4800u, buffer.GetUnderrunFrames());
+
+	// Playback carries on from where the device is rather than where the
+	// audio ran out
+	EXPECT_EQ(9600, buffer.GetPosition());
+	buffer.Stop();
+}
+
+TEST(lagi_audio, playback_buffer_int16_mono) {
+	TestAudioProvider<uint8_t> provider;
+	agi::AudioPlaybackBuffer buffer(&provider, true, 100);
+	EXPECT_EQ(sizeof(int16_t), buffer.GetFrameSize());
+	buffer.Start(0, 10);
+
+	int16_t samples[20];
+	ASSERT_EQ(10u, buffer.Read(samples, 20));
+	EXPECT_EQ(-128 * 256, samples[0]);
+	EXPECT_EQ(0, samples[19]);
+}
+
 TEST(lagi_audio, pcm_simple) {
 	auto path = agi::Path().Decode("?temp/pcm_simple");
 	{
@@ -178,6 +178,15 @@ TEST(lagi_cajun, Read) {
 	EXPECT_NO_THROW(static_cast<json::Null>(obj["Null"]));
 }
 
+TEST(lagi_cajun, ReadFromBuffer) {
+	static const char doc[] = "{\"Int\" : -12, \"Double\" : 1e2}";
+	json::UnknownElement root;
+	ASSERT_NO_THROW(json::Reader::Read(root, doc, sizeof(doc) - 1));
+	json::Object& obj = root;
+	EXPECT_EQ(-12, static_cast<json::Integer>(obj["Int"]));
+	EXPECT_EQ(100.0, static_cast<json::Double>(obj["Double"]));
+}
+
 TEST(lagi_cajun, Write) {
 	json::Object obj;
 	obj["Boolean"] = true;
@@ -31,6 +31,33 @@ TEST(lagi_character_count, zalgo) {
 	EXPECT_EQ(5, agi::CharacterCount("\xe1\xb8\xa9\x65\xcc\x94\xcc\x8b\xcd\xad\xcc\x80\xcd\x86\xcd\x97\xcc\x84\x6c\xcc\xb6\xcc\x88\xcc\x81\x6c\xcc\xab\xcc\x9c\xcd\x94\xcc\xac\xcc\x96\xcc\x9f\xcc\xb2\xcd\xa8\xcd\xae\xcc\x8b\xcc\x93\x6f\xcc\xad\xcd\x88\xcc\x9f\xcc\x9c\xcd\x94\xcc\xab\xcc\xb0\xcd\x8a\xcd\x97", agi::IGNORE_NONE));
 }
 
+TEST(lagi_character_count, latin) {
+	EXPECT_EQ(5, agi::CharacterCount("h\xc3\xa9llo", agi::IGNORE_NONE));
+	EXPECT_EQ(5, agi::CharacterCount("\xc3\xa9\xc3\xa9\xc4\x9b\xc4\x9b\xc8\x99", agi::IGNORE_NONE));
+}
+
+TEST(lagi_character_count, crlf) {
+	EXPECT_EQ(3, agi::CharacterCount("a\r\nb", agi::IGNORE_NONE));
+	EXPECT_EQ(4, agi::CharacterCount("a\n\rb", agi::IGNORE_NONE));
+	EXPECT_EQ(30, agi::CharacterCount("abcdefghijklmnopqrstuvwxyz\r\nabc", agi::IGNORE_NONE));
+}
+
+TEST(lagi_character_count, long_ascii) {
+	std::string str(1000, 'a');
+	EXPECT_EQ(1000, agi::CharacterCount(str, agi::IGNORE_NONE));
+	str[500] = '\r';
+	str[501] = '\n';
+	EXPECT_EQ(999, agi::CharacterCount(str, agi::IGNORE_NONE));
+	str[900] = ' ';
+	EXPECT_EQ(998, agi::CharacterCount(str, agi::IGNORE_WHITESPACE));
+}
+
+TEST(lagi_character_count, combining_after_ascii) {
+	// e followed by a combining acute accent is a single character
+	EXPECT_EQ(17, agi::CharacterCount("abcdefghijklmnope\xcc\x81", agi::IGNORE_NONE));
+	EXPECT_EQ(1, agi::CharacterCount("e\xcc\x81.", agi::IGNORE_PUNCTUATION));
+}
+
 TEST(lagi_character_count, ignore_blocks) {
 	EXPECT_EQ(11, agi::CharacterCount("{asdf}hello", agi::IGNORE_NONE));
 	EXPECT_EQ(10, agi::CharacterCount("{asdfhello", agi::IGNORE_NONE));
@@ -47,6 +74,14 @@ TEST(lagi_character_count, ignore_whitespace) {
 	EXPECT_EQ(5, agi::CharacterCount("h e l l o ", agi::IGNORE_WHITESPACE));
 }
 
+TEST(lagi_character_count, ignore_whitespace_escapes) {
+	EXPECT_EQ(11, agi::CharacterCount("hello\\hasdf", agi::IGNORE_NONE));
+	EXPECT_EQ(9, agi::CharacterCount("hello\\hasdf", agi::IGNORE_WHITESPACE));
+	EXPECT_EQ(9, agi::CharacterCount("hello\\hasdf", agi::IGNORE_WHITESPACE | agi::IGNORE_PUNCTUATION));
+	EXPECT_EQ(9, agi::CharacterCount("h\xc3\xa9llo\\Nasdf", agi::IGNORE_WHITESPACE | agi::IGNORE_PUNCTUATION));
+	EXPECT_EQ(8, agi::CharacterCount("\xe3\x83\x89llo\\Nasdf", agi::IGNORE_WHITESPACE | agi::IGNORE_PUNCTUATION));
+}
+
 TEST(lagi_character_count, ignore_blocks_and_punctuation) {
 	EXPECT_EQ(5, agi::CharacterCount("{asdf}hello.", agi::IGNORE_PUNCTUATION | agi::IGNORE_BLOCKS));
 }
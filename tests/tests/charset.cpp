@@ -0,0 +1,80 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <main.h>
+
+#include <libaegisub/charset.h>
+
+#include <fstream>
+
+using agi::charset::Detect;
+
+namespace {
+void write_file(const char *filename, std::string const& contents) {
+	std::ofstream(filename, std::ios::binary) << contents;
+}
+}
+
+TEST(lagi_charset, byte_order_marks) {
+	write_file("data/charset_bom8", "\xef\xbb\xbf" "abc");
+	EXPECT_EQ("utf-8", Detect("data/charset_bom8"));
+	write_file("data/charset_bom16le", std::string("\xff\xfe" "a\0b\0", 6));
+	EXPECT_EQ("utf-16le", Detect("data/charset_bom16le"));
+	write_file("data/charset_bom16be", std::string("\xfe\xff" "\0a\0b", 6));
+	EXPECT_EQ("utf-16be", Detect("data/charset_bom16be"));
+}
+
+TEST(lagi_charset, matroska_is_binary) {
+	write_file("data/charset_mkv", "\x1a\x45\xdf\xa3 more data");
+	EXPECT_EQ("binary", Detect("data/charset_mkv"));
+}
+
+TEST(lagi_charset, control_characters_are_binary) {
+	write_file("data/charset_zeros", std::string(1000, '\0'));
+	EXPECT_EQ("binary", Detect("data/charset_zeros"));
+}
+
+TEST(lagi_charset, valid_utf8) {
+	write_file("data/charset_utf8", "Dialogue: 0,0:00:00.00,0:00:05.00,Default,,0,0,0,,\xe3\x81\x82\xf0\x9f\x98\x80\r\n\ttab");
+	EXPECT_EQ("utf-8", Detect("data/charset_utf8"));
+	write_file("data/charset_ascii", "plain text\r\n");
+	EXPECT_EQ("utf-8", Detect("data/charset_ascii"));
+}
+
+TEST(lagi_charset, sequences_split_between_samples) {
+	// Three byte characters never line up with the sampled chunks here
+	std::string text;
+	for (int i = 0; i < 200000; ++i)
+		text += "\xe3\x81\x82";
+	text += "x";
+	write_file("data/charset_sampled", text);
+	EXPECT_EQ("utf-8", Detect("data/charset_sampled", 1000));
+	EXPECT_EQ("utf-8", Detect("data/charset_sampled", 1024 * 1024 + 1));
+}
+
+TEST(lagi_charset, binary_past_the_prefix_is_sampled) {
+	std::string data(8 * 1024, 'a');
+	data += std::string(4 * 1024 * 1024, '\0');
+	write_file("data/charset_binary_tail", data);
+	EXPECT_EQ("binary", Detect("data/charset_binary_tail", 8 * 1024));
+}
+
+TEST(lagi_charset, result_is_cached_until_modified) {
+	write_file("data/charset_cached", "abc");
+	EXPECT_EQ("utf-8", Detect("data/charset_cached"));
+	// Same size and probably the same modification time, but the size is
+	// part of the key so a change in length is always noticed
+	write_file("data/charset_cached", std::string(100, '\0'));
+	EXPECT_EQ("binary", Detect("data/charset_cached"));
+}
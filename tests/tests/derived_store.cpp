@@ -0,0 +1,134 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <libaegisub/derived_store.h>
+
+#include <libaegisub/fs.h>
+#include <libaegisub/io.h>
+
+#include <main.h>
+
+namespace {
+const char store_dir[] = "data/derived_store";
+
+agi::ArtifactKey make_key(std::string const& type, std::string const& path, time_t modified = 100, std::string const& params = "") {
+	agi::ArtifactKey key;
+	key.type = type;
+	key.source.path = path;
+	key.source.size = 1000;
+	key.source.modified = modified;
+	key.params = params;
+	return key;
+}
+
+struct lagi_derived_store : public ::testing::Test {
+	void SetUp() override {
+		for (auto const& file : agi::fs::DirectoryIterator(store_dir, ""))
+			agi::fs::Remove(agi::fs::path(store_dir)/file);
+	}
+};
+}
+
+TEST_F(lagi_derived_store, round_trip) {
+	agi::DerivedStore store(store_dir, 1 << 20);
+	std::string data;
+	EXPECT_FALSE(store.Get(make_key("keyframes", "video.mkv"), data));
+
+	store.Put(make_key("keyframes", "video.mkv"), std::string("a\0b", 3));
+	ASSERT_TRUE(store.Get(make_key("keyframes", "video.mkv"), data));
+	EXPECT_EQ(std::string("a\0b", 3), data);
+
+	// Any difference in the key is a miss
+	EXPECT_FALSE(store.Get(make_key("thumbnails", "video.mkv"), data));
+	EXPECT_FALSE(store.Get(make_key("keyframes", "other.mkv"), data));
+	EXPECT_FALSE(store.Get(make_key("keyframes", "video.mkv", 100, "min=5"), data));
+	auto newer_version = make_key("keyframes", "video.mkv");
+	newer_version.version = 2;
+	EXPECT_FALSE(store.Get(newer_version, data));
+}
+
+TEST_F(lagi_derived_store, params_are_kept_separately) {
+	agi::DerivedStore store(store_dir, 1 << 20);
+	store.Put(make_key("keyframes", "video.mkv", 100, "min=5"), "five");
+	store.Put(make_key("keyframes", "video.mkv", 100, "min=10"), "ten");
+
+	std::string data;
+	ASSERT_TRUE(store.Get(make_key("keyframes", "video.mkv", 100, "min=5"), data));
+	EXPECT_EQ("five", data);
+	ASSERT_TRUE(store.Get(make_key("keyframes", "video.mkv", 100, "min=10"), data));
+	EXPECT_EQ("ten", data);
+}
+
+TEST_F(lagi_derived_store, modified_source_replaces_old_artifacts) {
+	agi::DerivedStore store(store_dir, 1 << 20);
+	store.Put(make_key("keyframes", "video.mkv", 100), "old");
+	store.Put(make_key("thumbnails", "video.mkv", 100), "thumbs");
+	auto old_file = store.PathFor(make_key("keyframes", "video.mkv", 100));
+	EXPECT_TRUE(agi::fs::FileExists(old_file));
+
+	store.Put(make_key("keyframes", "video.mkv", 200), "new");
+	EXPECT_FALSE(agi::fs::FileExists(old_file));
+
+	std::string data;
+	ASSERT_TRUE(store.Get(make_key("keyframes", "video.mkv", 200), data));
+	EXPECT_EQ("new", data);
+	// Only artifacts of the type stored are replaced
+	EXPECT_TRUE(store.Get(make_key("thumbnails", "video.mkv", 100), data));
+}
+
+TEST_F(lagi_derived_store, invalidate) {
+	agi::DerivedStore store(store_dir, 1 << 20);
+	store.Put(make_key("keyframes", "video.mkv"), "a");
+	store.Put(make_key("thumbnails", "video.mkv"), "b");
+	store.Put(make_key("keyframes", "other.mkv"), "c");
+
+	store.Invalidate("video.mkv");
+	std::string data;
+	EXPECT_FALSE(store.Get(make_key("keyframes", "video.mkv"), data));
+	EXPECT_FALSE(store.Get(make_key("thumbnails", "video.mkv"), data));
+	EXPECT_TRUE(store.Get(make_key("keyframes", "other.mkv"), data));
+}
+
+TEST_F(lagi_derived_store, size_limit) {
+	agi::DerivedStore store(store_dir, 10000);
+	const std::string blob(3000, 'x');
+	for (int i = 0; i < 5; ++i)
+		store.Put(make_key("thumbnails", "video" + std::to_string(i) + ".mkv"), blob);
+	EXPECT_LE(store.Size(), 10000u);
+
+	// The most recent one is always kept
+	std::string data;
+	EXPECT_TRUE(store.Get(make_key("thumbnails", "video4.mkv"), data));
+
+	store.SetMaxSize(0);
+	EXPECT_EQ(0u, store.Size());
+}
+
+TEST_F(lagi_derived_store, corrupt_file_is_a_miss) {
+	agi::DerivedStore store(store_dir, 1 << 20);
+	auto key = make_key("keyframes", "video.mkv");
+	store.Put(key, "data");
+	agi::io::Save(store.PathFor(key), true).Get() << "garbage";
+
+	std::string data;
+	EXPECT_FALSE(store.Get(key, data));
+}
+
+TEST(lagi_source_identity, of) {
+	auto id = agi::SourceIdentity::Of("data/file");
+	EXPECT_EQ("data/file", id.path);
+	EXPECT_EQ(agi::fs::Size("data/file"), id.size);
+	EXPECT_EQ(agi::fs::ModifiedTime("data/file"), id.modified);
+	EXPECT_THROW(agi::SourceIdentity::Of("data/nonexistent"), agi::fs::FileNotFound);
+}
@@ -359,3 +359,30 @@ TEST(lagi_dialogue_lexer, templater_expression) {
 		expect_tok(ARG, 1u);
 	);
 }
+
+TEST(lagi_dialogue_lexer, long_text) {
+	tok_str("a plain line which is long enough to span several blocks", false,
+		expect_tok(TEXT, 56u);
+	);
+
+	tok_str("this line has a line break\\Nwell after the start of it\\n", false,
+		expect_tok(TEXT, 26u);
+		expect_tok(LINE_BREAK, 2u);
+		expect_tok(TEXT, 26u);
+		expect_tok(LINE_BREAK, 2u);
+	);
+
+	tok_str("backslashes \\which are not\\ line breaks \\x and then{\\b1}", false,
+		expect_tok(TEXT, 51u);
+		expect_tok(OVR_BEGIN, 1u);
+		expect_tok(TAG_START, 1u);
+		expect_tok(TAG_NAME, 1u);
+		expect_tok(ARG, 1u);
+		expect_tok(OVR_END, 1u);
+	);
+
+	tok_str("exclamation marks! and dollars $ in template lines $syl", true,
+		expect_tok(TEXT, 51u);
+		expect_tok(KARAOKE_VARIABLE, 4u);
+	);
+}
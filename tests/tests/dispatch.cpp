@@ -0,0 +1,160 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include <libaegisub/dispatch.h>
+
+#include <main.h>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+TEST(lagi_dispatch, parallel_runs_every_index_once) {
+	std::vector<std::atomic<int>> calls(1000);
+	agi::dispatch::Parallel(calls.size(), [&](size_t i) { ++calls[i]; });
+	for (auto const& c : calls)
+		EXPECT_EQ(1, c);
+}
+
+TEST(lagi_dispatch, parallel_with_no_work) {
+	bool called = false;
+	agi::dispatch::Parallel(0, [&](size_t) { called = true; });
+	EXPECT_FALSE(called);
+}
+
+TEST(lagi_dispatch, parallel_rethrows_lowest_index) {
+	std::atomic<int> calls{0};
+	try {
+		agi::dispatch::Parallel(100, [&](size_t i) {
+			++calls;
+			if (i == 10 || i == 50)
+				throw std::runtime_error(std::to_string(i));
+		});
+		FAIL() << "Parallel() should have thrown";
+	}
+	catch (std::runtime_error const& e) {
+		EXPECT_STREQ("10", e.what());
+	}
+	EXPECT_EQ(100, calls);
+}
+
+TEST(lagi_dispatch, serial_queue_runs_in_order) {
+	auto queue = agi::dispatch::Create(agi::dispatch::Priority::Bulk);
+	std::vector<int> order;
+	for (int i = 0; i < 100; ++i)
+		queue->Async([&, i] { order.push_back(i); });
+	queue->Sync([] { });
+
+	ASSERT_EQ(100u, order.size());
+	for (int i = 0; i < 100; ++i)
+		EXPECT_EQ(i, order[i]);
+}
+
+TEST(lagi_dispatch, sync_rethrows) {
+	EXPECT_THROW(agi::dispatch::Background().Sync([] { throw std::runtime_error("error"); }), std::runtime_error);
+}
+
+TEST(lagi_dispatch, cancelled_thunks_do_not_run) {
+	auto queue = agi::dispatch::Create();
+	agi::dispatch::CancellationToken token;
+	std::atomic<bool> ran{false};
+
+	// Hold the queue so that the cancellation happens before the thunk starts
+	std::atomic<bool> release{false};
+	queue->Async([&] { while (!release) std::this_thread::yield(); });
+	queue->Async([&] { ran = true; }, token);
+	token.Cancel();
+	release = true;
+	queue->Sync([] { });
+
+	EXPECT_FALSE(ran);
+	EXPECT_TRUE(token.IsCancelled());
+}
+
+TEST(lagi_dispatch, task_group_waits_for_every_thunk) {
+	std::atomic<int> calls{0};
+	agi::dispatch::TaskGroup group(agi::dispatch::Priority::Prefetch);
+	for (int i = 0; i < 1000; ++i)
+		group.Run([&] { ++calls; });
+	group.Wait();
+	EXPECT_EQ(1000, calls);
+}
+
+TEST(lagi_dispatch, task_group_rethrows) {
+	std::atomic<int> calls{0};
+	agi::dispatch::TaskGroup group;
+	for (int i = 0; i < 10; ++i) {
+		group.Run([&, i] {
+			++calls;
+			if (i == 5) throw std::runtime_error("error");
+		});
+	}
+	EXPECT_THROW(group.Wait(), std::runtime_error);
+	EXPECT_EQ(10, calls);
+
+	// The error is only reported once
+	EXPECT_NO_THROW(group.Wait());
+}
+
+TEST(lagi_dispatch, task_group_cancel_skips_unstarted_thunks) {
+	std::atomic<int> calls{0};
+	agi::dispatch::TaskGroup group;
+	group.Cancel();
+	for (int i = 0; i < 10; ++i)
+		group.Run([&] { ++calls; });
+	group.Wait();
+	EXPECT_EQ(0, calls);
+}
+
+TEST(lagi_dispatch, task_group_wait_from_background_thread) {
+	// Waiting on a worker runs the group's thunks inline rather than
+	// waiting for another worker to be free
+	std::atomic<int> calls{0};
+	agi::dispatch::Parallel(64, [&](size_t) {
+		agi::dispatch::TaskGroup group;
+		for (int i = 0; i < 10; ++i)
+			group.Run([&] { ++calls; });
+		group.Wait();
+	});
+	EXPECT_EQ(640, calls);
+}
+
+TEST(lagi_dispatch, bulk_work_does_not_starve_interactive_work) {
+	const size_t workers = std::max<unsigned>(4, std::thread::hardware_concurrency());
+
+	// Occupy as many workers as bulk work is allowed to use, and then some
+	std::atomic<bool> release{false};
+	std::atomic<size_t> bulk_started{0};
+	agi::dispatch::TaskGroup bulk(agi::dispatch::Priority::Bulk);
+	for (size_t i = 0; i < workers * 2; ++i) {
+		bulk.Run([&] {
+			++bulk_started;
+			while (!release) std::this_thread::yield();
+		});
+	}
+
+	std::atomic<bool> ran{false};
+	agi::dispatch::Background(agi::dispatch::Priority::Interactive).Async([&] { ran = true; });
+	for (int i = 0; i < 5000 && !ran; ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	EXPECT_TRUE(ran);
+	EXPECT_LT(bulk_started, workers);
+
+	release = true;
+	bulk.Wait();
+	EXPECT_EQ(workers * 2, bulk_started);
+}
@@ -0,0 +1,64 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <main.h>
+
+#include <libaegisub/file_mapping.h>
+#include <libaegisub/fs.h>
+
+#include <boost/filesystem/path.hpp>
+#include <fstream>
+
+using agi::file_open_scope;
+using agi::read_file_mapping;
+
+namespace {
+void write_file(const char *filename, const char *contents) {
+	std::ofstream(filename, std::ios::binary) << contents;
+}
+}
+
+TEST(lagi_file_mapping, read) {
+	write_file("data/mapped", "abcdef");
+	read_file_mapping file("data/mapped");
+	ASSERT_EQ(6u, file.size());
+	EXPECT_EQ(0, memcmp(file.read(2, 3), "cde", 3));
+	EXPECT_EQ(0, memcmp(file.read(), "abcdef", 6));
+}
+
+TEST(lagi_file_mapping, scope_shares_open_file) {
+	write_file("data/mapped", "abcdef");
+	{
+		file_open_scope scope("data/mapped");
+		agi::fs::Remove("data/mapped");
+
+		// Only works if the mapping uses the handle opened by the scope
+		read_file_mapping file("data/mapped");
+		ASSERT_EQ(6u, file.size());
+		EXPECT_EQ(0, memcmp(file.read(), "abcdef", 6));
+
+		file_open_scope nested("data/mapped");
+		EXPECT_EQ(6u, read_file_mapping("data/mapped").size());
+	}
+	EXPECT_THROW(read_file_mapping("data/mapped"), agi::fs::FileNotFound);
+}
+
+TEST(lagi_file_mapping, scope_ignores_other_files) {
+	write_file("data/mapped", "abcdef");
+	write_file("data/mapped2", "xyz");
+	file_open_scope scope("data/mapped");
+	EXPECT_EQ(3u, read_file_mapping("data/mapped2").size());
+	agi::fs::Remove("data/mapped2");
+	EXPECT_THROW(read_file_mapping("data/mapped2"), agi::fs::FileNotFound);
+}
@@ -0,0 +1,99 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <fixtures.h>
+
+#include <libaegisub/audio/provider.h>
+#include <libaegisub/fs.h>
+#include <libaegisub/path.h>
+
+#include <main.h>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <sstream>
+
+namespace {
+size_t count_prefix(std::string const& script, const char *prefix) {
+	std::istringstream in(script);
+	size_t count = 0;
+	for (std::string line; std::getline(in, line); )
+		count += boost::starts_with(line, prefix);
+	return count;
+}
+}
+
+TEST(lagi_fixtures, script_has_requested_contents) {
+	fixtures::ScriptOptions options;
+	options.lines = 1000;
+	options.shape = fixtures::ScriptShape::Typesetting;
+	options.styles = 12;
+	options.attachments = 3;
+	options.attachment_size = 1000;
+	auto script = fixtures::GenerateScript(options);
+
+	EXPECT_EQ(1000u, count_prefix(script, "Dialogue: "));
+	EXPECT_EQ(12u, count_prefix(script, "Style: "));
+	EXPECT_EQ(3u, count_prefix(script, "fontname: "));
+	EXPECT_NE(std::string::npos, script.find("\\clip(m "));
+	EXPECT_NE(std::string::npos, script.find("\\t(0,"));
+}
+
+TEST(lagi_fixtures, karaoke_script_has_templates) {
+	fixtures::ScriptOptions options;
+	options.lines = 100;
+	options.shape = fixtures::ScriptShape::Karaoke;
+	auto script = fixtures::GenerateScript(options);
+
+	EXPECT_EQ(100u, count_prefix(script, "Dialogue: "));
+	EXPECT_EQ(1u, count_prefix(script, "Comment: "));
+	EXPECT_NE(std::string::npos, script.find("template syl"));
+	EXPECT_NE(std::string::npos, script.find("{\\k"));
+}
+
+TEST(lagi_fixtures, script_is_deterministic) {
+	fixtures::ScriptOptions options;
+	options.lines = 200;
+	options.shape = fixtures::ScriptShape::Mixed;
+	options.shuffled = true;
+	EXPECT_EQ(fixtures::GenerateScript(options), fixtures::GenerateScript(options));
+
+	auto other = options;
+	other.seed = 2;
+	EXPECT_NE(fixtures::GenerateScript(options), fixtures::GenerateScript(other));
+}
+
+TEST(lagi_fixtures, wav_is_readable) {
+	fixtures::PCMOptions options;
+	options.sample_rate = 8000;
+	options.channels = 2;
+	options.seconds = 3;
+	auto wav = fixtures::GenerateWav(options);
+
+	auto path = agi::Path().Decode("?temp/fixture.wav");
+	{
+		boost::filesystem::ofstream file(path, std::ios::binary);
+		file.write(wav.data(), wav.size());
+	}
+
+	{
+		auto provider = agi::CreatePCMAudioProvider(path, nullptr);
+		EXPECT_EQ(8000, provider->GetSampleRate());
+		EXPECT_EQ(2, provider->GetChannels());
+		EXPECT_EQ(24000, provider->GetNumSamples());
+		EXPECT_EQ(2, provider->GetBytesPerSample());
+	}
+
+	agi::fs::Remove(path);
+}
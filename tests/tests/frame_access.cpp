@@ -0,0 +1,94 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include <libaegisub/frame_access.h>
+
+#include <main.h>
+
+using namespace agi::frame_access;
+
+class lagi_frame_access : public libagi { };
+
+TEST(lagi_frame_access, sequential) {
+	EXPECT_EQ((std::vector<int>{0, 1, 2, 3}), Generate(Pattern::Sequential, 100, {}, 4));
+	EXPECT_EQ((std::vector<int>{0, 1, 2}), Generate(Pattern::Sequential, 3, {}, 10));
+}
+
+TEST(lagi_frame_access, backward_step) {
+	EXPECT_EQ((std::vector<int>{3, 2, 1, 0}), Generate(Pattern::BackwardStep, 100, {}, 4));
+	EXPECT_EQ((std::vector<int>{2, 1, 0}), Generate(Pattern::BackwardStep, 3, {}, 10));
+}
+
+TEST(lagi_frame_access, random_seek) {
+	auto frames = Generate(Pattern::RandomSeek, 50, {}, 200, 5);
+	ASSERT_EQ(200u, frames.size());
+	for (int frame : frames) {
+		EXPECT_LE(0, frame);
+		EXPECT_GT(50, frame);
+	}
+
+	EXPECT_EQ(frames, Generate(Pattern::RandomSeek, 50, {}, 200, 5));
+	EXPECT_NE(frames, Generate(Pattern::RandomSeek, 50, {}, 200, 6));
+}
+
+TEST(lagi_frame_access, keyframe_jump) {
+	EXPECT_EQ((std::vector<int>{0, 10, 20}), Generate(Pattern::KeyframeJump, 100, {0, 10, 20, 30}, 3));
+	EXPECT_EQ((std::vector<int>{0, 10}), Generate(Pattern::KeyframeJump, 15, {0, 10, 20}, 10));
+}
+
+TEST(lagi_frame_access, keyframe_jump_without_keyframes) {
+	EXPECT_EQ((std::vector<int>{0, 25, 50, 75}), Generate(Pattern::KeyframeJump, 100, {}, 4));
+}
+
+TEST(lagi_frame_access, empty_video) {
+	for (auto pattern : AllPatterns)
+		EXPECT_TRUE(Generate(pattern, 0, {}, 10).empty());
+}
+
+TEST(lagi_frame_access, pattern_names) {
+	EXPECT_STREQ("sequential", PatternName(Pattern::Sequential));
+	EXPECT_STREQ("random_seek", PatternName(Pattern::RandomSeek));
+	EXPECT_STREQ("backward_step", PatternName(Pattern::BackwardStep));
+	EXPECT_STREQ("keyframe_jump", PatternName(Pattern::KeyframeJump));
+}
+
+TEST(lagi_frame_access, summarize) {
+	std::vector<double> latencies;
+	for (int i = 100; i > 0; --i)
+		latencies.push_back(i);
+
+	auto stats = Summarize(latencies);
+	EXPECT_EQ(100u, stats.count);
+	EXPECT_DOUBLE_EQ(5050, stats.total_ms);
+	EXPECT_DOUBLE_EQ(50.5, stats.mean_ms);
+	EXPECT_DOUBLE_EQ(50, stats.p50_ms);
+	EXPECT_DOUBLE_EQ(90, stats.p90_ms);
+	EXPECT_DOUBLE_EQ(99, stats.p99_ms);
+	EXPECT_DOUBLE_EQ(100, stats.max_ms);
+	EXPECT_NEAR(100000. / 5050, stats.fps, 1e-9);
+}
+
+TEST(lagi_frame_access, summarize_single) {
+	auto stats = Summarize({4});
+	EXPECT_DOUBLE_EQ(4, stats.p50_ms);
+	EXPECT_DOUBLE_EQ(4, stats.p99_ms);
+	EXPECT_DOUBLE_EQ(250, stats.fps);
+}
+
+TEST(lagi_frame_access, summarize_empty) {
+	auto stats = Summarize({});
+	EXPECT_EQ(0u, stats.count);
+	EXPECT_DOUBLE_EQ(0, stats.fps);
+}
@@ -133,6 +133,11 @@ TEST(lagi_fs, copy_overwrites) {
 TEST(lagi_fs, copy_creates_path) {
 }
 
+TEST(lagi_fs, is_network_path) {
+	EXPECT_FALSE(IsNetworkPath("data"));
+	EXPECT_FALSE(IsNetworkPath("data/nonexistent"));
+}
+
 TEST(lagi_fs, has_extension) {
 	EXPECT_TRUE(HasExtension("foo.txt", "txt"));
 	EXPECT_TRUE(HasExtension("foo.TXT", "txt"));
@@ -75,6 +75,15 @@ TEST(lagi_ifind, correct_index_with_shrunk_character_before_match) {
 	EXPECT_IFIND(" \xEF\xAC\x80 a ", "a", 5, 6);
 }
 
+TEST(lagi_ifind, ascii) {
+	EXPECT_IFIND("Hello World", "WORLD", 6, 11);
+	EXPECT_IFIND("{\\b1}Hello", "\\B1", 1, 4);
+	EXPECT_IFIND("abc", "", 0, 0);
+	EXPECT_NO_MATCH("abc", "abcd");
+	EXPECT_NO_MATCH("a[c", "A{C");
+	EXPECT_NO_MATCH("a@c", "A`C");
+}
+
 TEST(lagi_skip_tags, tag_stripping) {
 	agi::util::tagless_find_helper helper;
 
@@ -0,0 +1,133 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include <libaegisub/interned.h>
+
+#include <main.h>
+
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+using agi::Interned;
+
+TEST(lagi_interned, default_is_empty) {
+	Interned<std::string> a;
+	Interned<std::string> b("");
+	EXPECT_EQ("", a.get());
+	EXPECT_TRUE(a == b);
+	EXPECT_EQ(a.hash(), b.hash());
+}
+
+TEST(lagi_interned, equal_values_are_shared) {
+	Interned<std::string> a("lagi_interned shared");
+	Interned<std::string> b(std::string("lagi_interned shared"));
+	EXPECT_TRUE(a == b);
+	EXPECT_EQ(&a.get(), &b.get());
+	EXPECT_EQ(a.hash(), b.hash());
+
+	Interned<std::string> c("lagi_interned other");
+	EXPECT_TRUE(a != c);
+	EXPECT_NE(&a.get(), &c.get());
+}
+
+TEST(lagi_interned, compare_with_values) {
+	Interned<std::string> a("b");
+	EXPECT_TRUE(a == "b");
+	EXPECT_TRUE("b" == a);
+	EXPECT_TRUE(a != std::string("c"));
+	EXPECT_TRUE(Interned<std::string>("a") < a);
+	EXPECT_TRUE(a < Interned<std::string>("c"));
+}
+
+TEST(lagi_interned, from_key) {
+	std::string str("lagi_interned from key");
+	Interned<std::string> a(str);
+	auto b = Interned<std::string>::FromKey(std::string_view(str));
+	EXPECT_TRUE(a == b);
+	EXPECT_EQ(&a.get(), &b.get());
+	EXPECT_EQ(a.hash(), b.hash());
+
+	auto c = Interned<std::string>::FromKey(std::string_view(str).substr(0, 13));
+	EXPECT_EQ("lagi_interned", c.get());
+	EXPECT_TRUE(c == Interned<std::string>("lagi_interned"));
+
+	EXPECT_TRUE(Interned<std::string>::FromKey(std::string_view()) == Interned<std::string>());
+}
+
+TEST(lagi_interned, assignment) {
+	Interned<std::string> a("lagi_interned assign 1");
+	Interned<std::string> b = a;
+	EXPECT_TRUE(a == b);
+	b = "lagi_interned assign 2";
+	EXPECT_EQ("lagi_interned assign 1", a.get());
+	EXPECT_EQ("lagi_interned assign 2", b.get());
+	a = std::move(b);
+	EXPECT_EQ("lagi_interned assign 2", a.get());
+	a = a;
+	EXPECT_EQ("lagi_interned assign 2", a.get());
+}
+
+TEST(lagi_interned, values_are_freed) {
+	const size_t before = Interned<std::string>::LiveCount();
+	{
+		Interned<std::string> a("lagi_interned freed");
+		Interned<std::string> b = a;
+		EXPECT_EQ(before + 1, Interned<std::string>::LiveCount());
+	}
+	EXPECT_EQ(before, Interned<std::string>::LiveCount());
+}
+
+TEST(lagi_interned, vectors) {
+	Interned<std::vector<uint32_t>> a(std::vector<uint32_t>{1, 2, 3});
+	Interned<std::vector<uint32_t>> b(std::vector<uint32_t>{1, 2, 3});
+	Interned<std::vector<uint32_t>> c;
+	EXPECT_TRUE(a == b);
+	EXPECT_TRUE(c.get().empty());
+	EXPECT_TRUE(a != c);
+}
+
+TEST(lagi_interned, hash_map_key) {
+	std::unordered_set<Interned<std::string>> set;
+	set.insert(Interned<std::string>("a"));
+	set.insert(Interned<std::string>("b"));
+	set.insert(Interned<std::string>("a"));
+	EXPECT_EQ(2u, set.size());
+	EXPECT_EQ(1u, set.count(Interned<std::string>("b")));
+}
+
+TEST(lagi_interned, concurrent_use) {
+	const size_t before = Interned<std::string>::LiveCount();
+	{
+		Interned<std::string> shared("lagi_interned concurrent");
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 4; ++t) {
+			threads.emplace_back([&, t] {
+				for (int i = 0; i < 10000; ++i) {
+					Interned<std::string> copy = shared;
+					Interned<std::string> value(std::to_string(i % 100));
+					Interned<std::string> again(std::to_string(i % 100));
+					EXPECT_TRUE(value == again);
+					EXPECT_TRUE(copy == shared);
+				}
+			});
+		}
+		for (auto& thread : threads)
+			thread.join();
+	}
+	EXPECT_EQ(before, Interned<std::string>::LiveCount());
+}
@@ -0,0 +1,114 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <libaegisub/interval_index.h>
+
+#include <main.h>
+
+#include <algorithm>
+#include <random>
+
+using agi::IntervalIndex;
+
+namespace {
+std::vector<int> sorted(std::vector<int> v) {
+	std::sort(v.begin(), v.end());
+	return v;
+}
+}
+
+TEST(lagi_interval_index, empty) {
+	IntervalIndex<int> index;
+	EXPECT_TRUE(index.empty());
+	EXPECT_TRUE(index.At(0).empty());
+	EXPECT_TRUE(index.Overlapping(-100, 100).empty());
+}
+
+TEST(lagi_interval_index, half_open) {
+	IntervalIndex<int> index;
+	index.Add(1, 100, 200);
+	EXPECT_TRUE(index.At(99).empty());
+	EXPECT_EQ(std::vector<int>{1}, index.At(100));
+	EXPECT_EQ(std::vector<int>{1}, index.At(199));
+	EXPECT_TRUE(index.At(200).empty());
+	EXPECT_TRUE(index.Overlapping(200, 300).empty());
+	EXPECT_TRUE(index.Overlapping(0, 100).empty());
+	EXPECT_EQ(std::vector<int>{1}, index.Overlapping(0, 101));
+}
+
+TEST(lagi_interval_index, zero_length_never_matches) {
+	IntervalIndex<int> index;
+	index.Add(1, 100, 100);
+	EXPECT_TRUE(index.At(100).empty());
+	EXPECT_TRUE(index.Overlapping(0, 1000).empty());
+}
+
+TEST(lagi_interval_index, results_in_start_order) {
+	IntervalIndex<int> index;
+	index.Assign({{300, 1000, 3}, {100, 1000, 1}, {200, 1000, 2}});
+	EXPECT_EQ((std::vector<int>{1, 2, 3}), index.At(500));
+}
+
+TEST(lagi_interval_index, update_moves_interval) {
+	IntervalIndex<int> index;
+	index.Assign({{0, 100, 1}, {50, 150, 2}});
+	index.Update(1, 1000, 2000);
+	EXPECT_EQ(std::vector<int>{2}, index.At(60));
+	EXPECT_EQ(std::vector<int>{1}, index.At(1500));
+	EXPECT_EQ(2u, index.size());
+}
+
+TEST(lagi_interval_index, remove) {
+	IntervalIndex<int> index;
+	index.Assign({{0, 100, 1}, {0, 100, 2}});
+	EXPECT_TRUE(index.Remove(1));
+	EXPECT_FALSE(index.Remove(1));
+	EXPECT_EQ(std::vector<int>{2}, index.At(50));
+}
+
+TEST(lagi_interval_index, matches_linear_scan) {
+	std::mt19937 rng(12345);
+	std::uniform_int_distribution<int> start_dist(0, 100000);
+	std::uniform_int_distribution<int> length_dist(0, 5000);
+
+	std::vector<IntervalIndex<int>::Entry> entries;
+	for (int i = 0; i < 2000; ++i) {
+		int start = start_dist(rng);
+		entries.push_back({start, start + length_dist(rng), i});
+	}
+
+	IntervalIndex<int> index;
+	index.Assign(entries);
+
+	// Move some of the intervals around incrementally as well
+	for (int i = 0; i < 200; ++i) {
+		auto& e = entries[i * 7];
+		e.start = start_dist(rng);
+		e.end = e.start + length_dist(rng);
+		index.Update(e.value, e.start, e.end);
+	}
+
+	for (int i = 0; i < 200; ++i) {
+		int start = start_dist(rng);
+		int end = start + length_dist(rng) / 4;
+
+		std::vector<int> expected;
+		for (auto const& e : entries) {
+			if (e.start < end && e.end > start && e.start < e.end)
+				expected.push_back(e.value);
+		}
+
+		EXPECT_EQ(sorted(expected), sorted(index.Overlapping(start, end)));
+	}
+}
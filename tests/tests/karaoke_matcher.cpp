@@ -12,6 +12,7 @@
 // ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
 // OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
+#include <libaegisub/kana_table.h>
 #include <libaegisub/karaoke_matcher.h>
 
 #include <main.h>
@@ -195,3 +196,54 @@ TEST(lagi_karaoke_matcher, lookahead_is_case_insensitive) {
 	EXPECT_EQ((karaoke_match_result{1, 3}),
 	          auto_match_karaoke({"Oh... ", "Nan", "ka ", "ta", "ri", "nai"}, "Oh…なんか足りない"));
 }
+
+TEST(lagi_karaoke_matcher, long_syllables_are_matched_a_character_at_a_time) {
+	std::string syl, dst;
+	for (int i = 0; i < 500; ++i) {
+		syl += "a\xC3\xA4";
+		dst += i % 2 ? "a\xC3\xA4" : "A\xC3\xA4";
+	}
+	EXPECT_EQ((karaoke_match_result{1, 1000}),
+	          auto_match_karaoke({syl, "b"}, dst + "b"));
+}
+
+TEST(lagi_karaoke_matcher, lookahead_with_many_syllables) {
+	std::vector<std::string> src{"xyz", " ", "ko", "", "ko", "ka"};
+	std::string dst = "\xE6\xBC\xA2\xE3\x81\x8B";
+	for (int i = 0; i < 1000; ++i) {
+		src.push_back("ka");
+		dst += "\xE3\x81\x8B";
+	}
+	EXPECT_EQ((karaoke_match_result{3, 1}), auto_match_karaoke(src, dst));
+}
+
+TEST(lagi_karaoke_matcher, kana_to_romaji) {
+	ASSERT_EQ(1u, agi::kana_to_romaji("\xE3\x81\x8D").size());
+	EXPECT_STREQ("ki", agi::kana_to_romaji("\xE3\x81\x8D")[0]);
+	ASSERT_EQ(1u, agi::kana_to_romaji("\xE3\x81\x8D\xE3\x82\x83").size());
+	EXPECT_STREQ("kya", agi::kana_to_romaji("\xE3\x81\x8D\xE3\x82\x83")[0]);
+
+	auto ha = agi::kana_to_romaji("\xE3\x81\xAF");
+	ASSERT_EQ(2u, ha.size());
+	EXPECT_STREQ("ha", ha[0]);
+	EXPECT_STREQ("wa", ha[1]);
+
+	EXPECT_TRUE(agi::kana_to_romaji("").empty());
+	EXPECT_TRUE(agi::kana_to_romaji("a").empty());
+	EXPECT_TRUE(agi::kana_to_romaji("\xE3\x81\x8D\xE3\x81\x8D\xE3\x81\x8D").empty());
+}
+
+TEST(lagi_karaoke_matcher, romaji_to_kana_uses_longest_prefix) {
+	auto kya = agi::romaji_to_kana("kyaaa");
+	ASSERT_EQ(2, kya.size());
+	EXPECT_STREQ("\xE3\x81\x8D\xE3\x82\x83", kya.begin()->kana);
+	EXPECT_STREQ("kya", kya.begin()->romaji);
+
+	auto k = agi::romaji_to_kana("kq");
+	ASSERT_FALSE(k.empty());
+	for (auto const& kp : k)
+		EXPECT_STREQ("k", kp.romaji);
+
+	EXPECT_TRUE(agi::romaji_to_kana("").empty());
+	EXPECT_TRUE(agi::romaji_to_kana("q").empty());
+}
@@ -140,3 +140,64 @@ TEST(lagi_keyframe, aegi) {
 
 	EXPECT_TRUE(expected == res);
 }
+
+TEST(lagi_keyframe, wwxd) {
+	{
+		std::ofstream file("data/keyframe/wwxd.txt", std::ios::binary);
+		file << "# WWXD log file, using qpfile format\r\n"
+		     << "# Please do not edit\r\n"
+		     << "0 I -1\r\n"
+		     << "25 P -1\r\n"
+		     << "\r\n"
+		     << "  80 I\r\n"
+		     << "123 I";
+	}
+
+	std::vector<int> res;
+	ASSERT_NO_THROW(res = Load("data/keyframe/wwxd.txt"));
+	EXPECT_EQ((std::vector<int>{0, 80, 123}), res);
+
+	{
+		std::ofstream file("data/keyframe/wwxd.txt", std::ios::binary);
+		file << "# WWXD log file, using qpfile format\n"
+		     << "0 I\n"
+		     << "25\n";
+	}
+	EXPECT_THROW(Load("data/keyframe/wwxd.txt"), KeyframeFormatParseError);
+}
+
+TEST(lagi_keyframe, divx) {
+	{
+		std::ofstream file("data/keyframe/divx.txt", std::ios::binary);
+		file << "##map version 2\n"
+		     << "I 1 2 3\n"
+		     << "b 3 4 P 5\n"
+		     << "\n"
+		     << "x I y\n"
+		     << "B\n"
+		     << "zzz P\n"
+		     << "I\n";
+	}
+
+	std::vector<int> res;
+	ASSERT_NO_THROW(res = Load("data/keyframe/divx.txt"));
+	EXPECT_EQ((std::vector<int>{0, 2, 5}), res);
+}
+
+TEST(lagi_keyframe, aegi_ignores_bad_lines) {
+	{
+		std::ofstream file("data/keyframe/aegi_bad.txt", std::ios::binary);
+		file << "# keyframe format v1\n"
+		     << "fps 23.976\n"
+		     << "10\r\n"
+		     << "garbage\n"
+		     << "99999999999\n"
+		     << " 20 trailing\n"
+		     << "-5\n"
+		     << "30";
+	}
+
+	std::vector<int> res;
+	ASSERT_NO_THROW(res = Load("data/keyframe/aegi_bad.txt"));
+	EXPECT_EQ((std::vector<int>{10, 20, -5, 30}), res);
+}
@@ -0,0 +1,99 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include <libaegisub/log.h>
+#include <libaegisub/make_unique.h>
+
+#include <main.h>
+
+#include <string>
+
+using agi::log::SinkMessage;
+
+namespace {
+SinkMessage make_message(int line, int64_t time, std::string const& text) {
+	SinkMessage sm;
+	sm.message = text;
+	sm.time = time;
+	sm.section = "test";
+	sm.file = __FILE__;
+	sm.func = "test";
+	sm.severity = agi::log::Debug;
+	sm.line = line;
+	return sm;
+}
+
+struct CountingEmitter final : agi::log::Emitter {
+	int *count;
+	CountingEmitter(int *count) : count(count) { }
+	void log(SinkMessage const&) override { ++*count; }
+};
+}
+
+TEST(lagi_log, messages_are_stored_in_order) {
+	agi::log::LogSink sink;
+	for (int i = 0; i < 100; ++i)
+		sink.Log(make_message(i, 0, std::to_string(i)));
+
+	auto messages = sink.GetMessages();
+	ASSERT_EQ(100u, messages.size());
+	for (int i = 0; i < 100; ++i)
+		EXPECT_EQ(std::to_string(i), messages[i].message);
+}
+
+TEST(lagi_log, only_recent_messages_are_kept) {
+	agi::log::LogSink sink;
+	for (int i = 0; i < 1000; ++i)
+		sink.Log(make_message(i, 0, std::to_string(i)));
+
+	auto messages = sink.GetMessages();
+	ASSERT_EQ(250u, messages.size());
+	EXPECT_EQ("750", messages.front().message);
+	EXPECT_EQ("999", messages.back().message);
+}
+
+TEST(lagi_log, emitters_see_every_message) {
+	int count = 0;
+	agi::log::LogSink sink;
+	sink.Subscribe(agi::make_unique<CountingEmitter>(&count));
+	for (int i = 0; i < 500; ++i)
+		sink.Log(make_message(i, 0, "message"));
+	sink.GetMessages();
+	EXPECT_EQ(500, count);
+}
+
+TEST(lagi_log, repeated_messages_are_rate_limited) {
+	agi::log::LogSink sink;
+	for (int i = 0; i < 100; ++i)
+		sink.Log(make_message(1, i, "spam"));
+	EXPECT_EQ(20u, sink.GetMessages().size());
+
+	// The next message after the window reports how many were dropped
+	sink.Log(make_message(1, 2000000000, "later"));
+	auto messages = sink.GetMessages();
+	ASSERT_EQ(22u, messages.size());
+	EXPECT_EQ("80 similar messages were suppressed", messages[20].message);
+	EXPECT_EQ("later", messages[21].message);
+}
+
+TEST(lagi_log, exceptions_are_not_rate_limited) {
+	agi::log::LogSink sink;
+	for (int i = 0; i < 100; ++i) {
+		auto sm = make_message(1, i, "error");
+		sm.severity = agi::log::Exception;
+		sink.Log(sm);
+	}
+	EXPECT_EQ(100u, sink.GetMessages().size());
+}
@@ -0,0 +1,120 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include <libaegisub/memory_usage.h>
+
+#include <main.h>
+
+#include <algorithm>
+#include <memory>
+
+namespace {
+agi::memory::Usage find(const char *name) {
+	auto usage = agi::memory::Snapshot();
+	auto it = std::find_if(begin(usage), end(usage), [&](agi::memory::Usage const& u) { return u.name == name; });
+	return it == end(usage) ? agi::memory::Usage{} : *it;
+}
+}
+
+TEST(lagi_memory_usage, counters_are_reported_while_alive) {
+	{
+		agi::memory::Counter counter("test counter", 100);
+		counter.Set(10);
+		counter.Add(5);
+		counter.Remove(3);
+
+		auto usage = find("test counter");
+		EXPECT_EQ(1u, usage.instances);
+		EXPECT_EQ(12u, usage.bytes);
+		EXPECT_EQ(100u, usage.limit);
+	}
+	EXPECT_EQ(0u, find("test counter").instances);
+}
+
+TEST(lagi_memory_usage, counters_with_the_same_name_are_merged) {
+	agi::memory::Counter a("test merged", 100), b("test merged", 50);
+	a.Set(1);
+	b.Set(2);
+
+	auto usage = find("test merged");
+	EXPECT_EQ(2u, usage.instances);
+	EXPECT_EQ(3u, usage.bytes);
+	EXPECT_EQ(150u, usage.limit);
+
+	agi::memory::Counter c("test merged");
+	EXPECT_EQ(0u, find("test merged").limit);
+}
+
+TEST(lagi_memory_usage, snapshot_is_sorted) {
+	agi::memory::Counter b("test b"), a("test a");
+	auto usage = agi::memory::Snapshot();
+	EXPECT_TRUE(std::is_sorted(begin(usage), end(usage),
+		[](agi::memory::Usage const& l, agi::memory::Usage const& r) { return l.name < r.name; }));
+}
+
+TEST(lagi_memory_usage, budget) {
+	agi::memory::Counter counter("test budget");
+	counter.Set(agi::memory::TotalBytes() + 1000);
+
+	agi::memory::SetBudget(0);
+	EXPECT_FALSE(agi::memory::OverBudget());
+
+	agi::memory::SetBudget(counter.GetBytes() / 2);
+	EXPECT_TRUE(agi::memory::OverBudget());
+
+	counter.Set(0);
+	agi::memory::SetBudget(agi::memory::TotalBytes() + 1);
+	EXPECT_FALSE(agi::memory::OverBudget());
+
+	agi::memory::SetBudget(0);
+}
+
+TEST(lagi_memory_usage, trimmers_are_called_in_priority_order) {
+	std::vector<int> calls;
+	agi::memory::Trimmer late(20, [&](agi::memory::Pressure) { calls.push_back(20); });
+	agi::memory::Trimmer early(10, [&](agi::memory::Pressure) { calls.push_back(10); });
+
+	EXPECT_EQ(0u, agi::memory::Trim(agi::memory::Pressure::None));
+	EXPECT_TRUE(calls.empty());
+
+	EXPECT_EQ(2u, agi::memory::Trim(agi::memory::Pressure::Critical));
+	EXPECT_EQ((std::vector<int>{10, 20}), calls);
+}
+
+TEST(lagi_memory_usage, moderate_trim_stops_once_enough_is_freed) {
+	agi::memory::Counter counter("test trim");
+	counter.Set(agi::memory::TotalBytes() * 4 + 1000);
+
+	std::vector<int> calls;
+	agi::memory::Trimmer first(10, [&](agi::memory::Pressure) { calls.push_back(10); counter.Set(0); });
+	agi::memory::Trimmer second(20, [&](agi::memory::Pressure) { calls.push_back(20); });
+
+	EXPECT_EQ(1u, agi::memory::Trim(agi::memory::Pressure::Moderate));
+	EXPECT_EQ(std::vector<int>{10}, calls);
+
+	calls.clear();
+	EXPECT_EQ(2u, agi::memory::Trim(agi::memory::Pressure::Critical));
+	EXPECT_EQ((std::vector<int>{10, 20}), calls);
+}
+
+TEST(lagi_memory_usage, trimmers_destroyed_while_trimming_are_skipped) {
+	std::vector<int> calls;
+	std::unique_ptr<agi::memory::Trimmer> second;
+	agi::memory::Trimmer first(10, [&](agi::memory::Pressure) { calls.push_back(10); second.reset(); });
+	second.reset(new agi::memory::Trimmer(20, [&](agi::memory::Pressure) { calls.push_back(20); }));
+
+	EXPECT_EQ(1u, agi::memory::Trim(agi::memory::Pressure::Critical));
+	EXPECT_EQ(std::vector<int>{10}, calls);
+}
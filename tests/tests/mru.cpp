@@ -60,6 +60,20 @@ TEST(lagi_mru, remove_entry) {
 	EXPECT_STRNE("/path/to/file", mru.Get("Video")->front().string().c_str());
 }
 
+TEST(lagi_mru, changes_are_saved) {
+	agi::fs::Remove("data/mru_tmp");
+	{
+		agi::MRUManager mru("data/mru_tmp", default_mru);
+		mru.Add("Video", "/file/1");
+		mru.Add("Video", "/file/2");
+	}
+
+	agi::MRUManager mru("data/mru_tmp", default_mru);
+	ASSERT_EQ(2u, mru.Get("Video")->size());
+	EXPECT_STREQ("/file/2", mru.GetEntry("Video", 0).string().c_str());
+	EXPECT_STREQ("/file/1", mru.GetEntry("Video", 1).string().c_str());
+}
+
 TEST(lagi_mru, invalid_mru_key_throws) {
 	agi::fs::Copy("data/mru_ok.json", "data/mru_tmp");
 	agi::MRUManager mru("data/mru_tmp", default_mru);
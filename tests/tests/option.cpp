@@ -170,6 +170,33 @@ TEST_F(lagi_option, flush_roundtrip) {
 	}
 }
 
+TEST_F(lagi_option, unchanged_options_are_not_rewritten) {
+	agi::fs::Copy("data/options/string.json", "data/options/tmp");
+	{
+		agi::Options opt("data/options/tmp", default_opt);
+		opt.ConfigUser();
+		opt.Get("Valid")->GetString();
+		opt.FlushDeferred();
+	}
+	EXPECT_TRUE(util::compare("data/options/string.json", "data/options/tmp"));
+}
+
+TEST_F(lagi_option, flush_deferred) {
+	agi::fs::Remove("data/options/tmp");
+
+	{
+		agi::Options opt("data/options/tmp", all_types, agi::Options::FLUSH_SKIP);
+		opt.Get("Integer")->SetInt(1);
+		opt.FlushDeferred();
+		opt.Get("Integer")->SetInt(2);
+		opt.FlushDeferred();
+	}
+
+	agi::Options opt("data/options/tmp", all_types, agi::Options::FLUSH_SKIP);
+	ASSERT_NO_THROW(opt.ConfigUser());
+	EXPECT_EQ(2, opt.Get("Integer")->GetInt());
+}
+
 TEST_F(lagi_option, mixed_valid_and_invalid_in_user_conf_loads_all_valid) {
 	const char def[] = "{\"1\" : false, \"2\" : 1, \"3\" : false }";
 	agi::Options opt("data/options/all_bool.json", def, agi::Options::FLUSH_SKIP);
@@ -0,0 +1,57 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include <libaegisub/parallel_sort.h>
+
+#include <main.h>
+
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+/// Pairs of (key, original position) with only a few distinct keys, so that
+/// instability would show up as out of order positions
+std::vector<std::pair<int, int>> make_input(int count) {
+	std::mt19937 rng(count);
+	std::uniform_int_distribution<int> key(0, 9);
+	std::vector<std::pair<int, int>> v;
+	for (int i = 0; i < count; ++i)
+		v.emplace_back(key(rng), i);
+	return v;
+}
+
+bool by_key(std::pair<int, int> const& a, std::pair<int, int> const& b) {
+	return a.first < b.first;
+}
+}
+
+TEST(lagi_parallel_sort, matches_stable_sort) {
+	for (size_t chunks : {0, 1, 2, 3, 7, 16}) {
+		for (int count : {0, 1, 5, 100, 10007}) {
+			auto expected = make_input(count);
+			auto actual = expected;
+			std::stable_sort(expected.begin(), expected.end(), by_key);
+			agi::ParallelStableSort(actual.begin(), actual.end(), by_key, chunks);
+			EXPECT_EQ(expected, actual) << "chunks " << chunks << ", count " << count;
+		}
+	}
+}
+
+TEST(lagi_parallel_sort, more_chunks_than_elements) {
+	std::vector<int> v{3, 1, 2};
+	agi::ParallelStableSort(v.begin(), v.end(), [](int a, int b) { return a < b; }, 10);
+	EXPECT_EQ((std::vector<int>{1, 2, 3}), v);
+}
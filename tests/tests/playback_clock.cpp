@@ -0,0 +1,68 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include <libaegisub/playback_clock.h>
+
+#include <main.h>
+
+using agi::PlaybackClock;
+using namespace std::chrono;
+
+class lagi_playback_clock : public libagi { };
+
+namespace {
+const PlaybackClock::clock::time_point t0{};
+}
+
+TEST(lagi_playback_clock, normal_speed) {
+	PlaybackClock clock(1000, 1.0, t0);
+	EXPECT_EQ(1000, clock.MediaTime(t0));
+	EXPECT_EQ(1500, clock.MediaTime(t0 + milliseconds(500)));
+	EXPECT_EQ(t0 + milliseconds(500), clock.WallTime(1500));
+}
+
+TEST(lagi_playback_clock, double_speed) {
+	PlaybackClock clock(0, 2.0, t0);
+	EXPECT_EQ(1000, clock.MediaTime(t0 + milliseconds(500)));
+	EXPECT_EQ(t0 + milliseconds(250), clock.WallTime(500));
+}
+
+TEST(lagi_playback_clock, half_speed) {
+	PlaybackClock clock(0, 0.5, t0);
+	EXPECT_EQ(250, clock.MediaTime(t0 + milliseconds(500)));
+	EXPECT_EQ(t0 + milliseconds(1000), clock.WallTime(500));
+}
+
+TEST(lagi_playback_clock, rounds_down) {
+	PlaybackClock clock(0, 1.0, t0);
+	// The frame which starts at 42ms isn't playing until 42ms have passed
+	EXPECT_EQ(41, clock.MediaTime(t0 + microseconds(41999)));
+	EXPECT_EQ(42, clock.MediaTime(t0 + milliseconds(42)));
+}
+
+TEST(lagi_playback_clock, change_speed) {
+	PlaybackClock clock(0, 1.0, t0);
+	clock.SetSpeed(2.0, t0 + milliseconds(100));
+	EXPECT_EQ(2.0, clock.GetSpeed());
+	EXPECT_EQ(100, clock.MediaTime(t0 + milliseconds(100)));
+	EXPECT_EQ(300, clock.MediaTime(t0 + milliseconds(200)));
+	EXPECT_EQ(t0 + milliseconds(200), clock.WallTime(300));
+}
+
+TEST(lagi_playback_clock, round_trip) {
+	PlaybackClock clock(12345, 1.5, t0 + seconds(3));
+	for (int64_t ms : {12345, 20000, 99999})
+		EXPECT_EQ(ms, clock.MediaTime(clock.WallTime(ms)));
+}
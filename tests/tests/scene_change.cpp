@@ -0,0 +1,120 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include <libaegisub/scene_change.h>
+
+#include <main.h>
+
+#include <vector>
+
+class lagi_scene_change : public libagi { };
+
+namespace {
+struct Frame {
+	int width, height;
+	std::vector<uint8_t> pixels;
+
+	Frame(int width = 64, int height = 48)
+	: width(width), height(height), pixels(width * height * 4, 0) { }
+
+	/// Fill with a horizontal gradient, shifted right by offset pixels
+	Frame& Gradient(int offset = 0) {
+		for (int y = 0; y < height; ++y) {
+			for (int x = 0; x < width; ++x) {
+				uint8_t v = static_cast<uint8_t>(((x + offset) % width) * 255 / width);
+				uint8_t *px = &pixels[(y * width + x) * 4];
+				px[0] = px[1] = px[2] = v;
+			}
+		}
+		return *this;
+	}
+
+	/// Fill with a checkerboard of blocks of the given size
+	Frame& Checkerboard(int block) {
+		for (int y = 0; y < height; ++y) {
+			for (int x = 0; x < width; ++x) {
+				uint8_t v = ((x / block + y / block) % 2) ? 255 : 0;
+				uint8_t *px = &pixels[(y * width + x) * 4];
+				px[0] = px[1] = px[2] = v;
+			}
+		}
+		return *this;
+	}
+
+	bool AddTo(agi::SceneChangeDetector& detector) const {
+		return detector.AddFrame(pixels.data(), width * 4, width, height);
+	}
+};
+}
+
+TEST(lagi_scene_change, first_frame_is_change) {
+	agi::SceneChangeDetector detector;
+	EXPECT_TRUE(Frame().Gradient().AddTo(detector));
+}
+
+TEST(lagi_scene_change, identical_frames) {
+	agi::SceneChangeDetector detector;
+	Frame frame;
+	frame.Gradient();
+	EXPECT_TRUE(frame.AddTo(detector));
+	for (int i = 0; i < 20; ++i)
+		EXPECT_FALSE(frame.AddTo(detector));
+}
+
+TEST(lagi_scene_change, hard_cut) {
+	agi::SceneChangeDetector detector;
+	Frame a, b;
+	a.Gradient();
+	b.Checkerboard(8);
+	for (int i = 0; i < 10; ++i)
+		a.AddTo(detector);
+	EXPECT_TRUE(b.AddTo(detector));
+	EXPECT_FALSE(b.AddTo(detector));
+}
+
+TEST(lagi_scene_change, slow_pan) {
+	agi::SceneChangeDetector detector;
+	Frame frame;
+	EXPECT_TRUE(frame.Gradient().AddTo(detector));
+	for (int i = 1; i < 20; ++i)
+		EXPECT_FALSE(frame.Gradient(i).AddTo(detector));
+}
+
+TEST(lagi_scene_change, min_scene_length) {
+	agi::SceneChangeDetector detector(5);
+	Frame a, b;
+	a.Gradient();
+	b.Checkerboard(8);
+	EXPECT_TRUE(a.AddTo(detector));
+	EXPECT_FALSE(b.AddTo(detector));
+	EXPECT_FALSE(a.AddTo(detector));
+	for (int i = 0; i < 3; ++i)
+		a.AddTo(detector);
+	EXPECT_TRUE(b.AddTo(detector));
+}
+
+TEST(lagi_scene_change, bottom_up_rows) {
+	agi::SceneChangeDetector detector;
+	Frame a, b;
+	a.Gradient();
+	b.Checkerboard(8);
+	auto add = [&](Frame const& f) {
+		return detector.AddFrame(f.pixels.data() + (f.height - 1) * f.width * 4, -f.width * 4, f.width, f.height);
+	};
+	EXPECT_TRUE(add(a));
+	for (int i = 0; i < 10; ++i)
+		EXPECT_FALSE(add(a));
+	EXPECT_TRUE(add(b));
+}
@@ -0,0 +1,77 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <libaegisub/session_log.h>
+
+#include <main.h>
+
+#include <sstream>
+
+TEST(lagi_session_log, round_trip) {
+	std::stringstream stream;
+	agi::WriteSessionHeader(stream, {"subs.ass", "video.mkv"});
+
+	agi::SessionEvent first;
+	first.time = 15;
+	first.command = "time/shift";
+	first.active_row = 3;
+	first.selection = {1, 2, 3, 7, 9, 10};
+	first.video_frame = 120;
+	agi::WriteSessionEvent(stream, first);
+
+	agi::SessionEvent second;
+	second.time = 900;
+	second.command = "video/frame/next";
+	agi::WriteSessionEvent(stream, second);
+
+	auto log = agi::ReadSessionLog(stream);
+	EXPECT_EQ("subs.ass", log.header.subtitles);
+	EXPECT_EQ("video.mkv", log.header.video);
+	ASSERT_EQ(2u, log.events.size());
+
+	EXPECT_EQ(15, log.events[0].time);
+	EXPECT_EQ("time/shift", log.events[0].command);
+	EXPECT_EQ(3, log.events[0].active_row);
+	EXPECT_EQ(first.selection, log.events[0].selection);
+	EXPECT_EQ(120, log.events[0].video_frame);
+
+	EXPECT_EQ(900, log.events[1].time);
+	EXPECT_EQ(-1, log.events[1].active_row);
+	EXPECT_TRUE(log.events[1].selection.empty());
+	EXPECT_EQ(-1, log.events[1].video_frame);
+}
+
+TEST(lagi_session_log, truncated_final_line_is_skipped) {
+	std::stringstream stream;
+	agi::WriteSessionHeader(stream, {"", ""});
+	agi::SessionEvent event;
+	event.command = "edit/line/copy";
+	agi::WriteSessionEvent(stream, event);
+	stream << "{\"t\":12,\"cmd\":\"edit/li";
+
+	auto log = agi::ReadSessionLog(stream);
+	ASSERT_EQ(1u, log.events.size());
+	EXPECT_EQ("edit/line/copy", log.events[0].command);
+}
+
+TEST(lagi_session_log, bad_header) {
+	std::istringstream empty("");
+	EXPECT_THROW(agi::ReadSessionLog(empty), agi::SessionLogError);
+
+	std::istringstream not_json("hello world\n");
+	EXPECT_THROW(agi::ReadSessionLog(not_json), agi::SessionLogError);
+
+	std::istringstream future("{\"aegisub_session\":99,\"subtitles\":\"\",\"video\":\"\"}\n");
+	EXPECT_THROW(agi::ReadSessionLog(future), agi::SessionLogError);
+}
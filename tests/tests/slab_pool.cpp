@@ -0,0 +1,111 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <libaegisub/slab_pool.h>
+
+#include <main.h>
+
+#include <cstdint>
+#include <set>
+#include <thread>
+#include <vector>
+
+using agi::SlabPool;
+
+TEST(lagi_slab_pool, allocations_are_distinct_and_aligned) {
+	SlabPool pool(24, 4);
+	std::set<void *> seen;
+	for (int i = 0; i < 100; ++i) {
+		void *p = pool.Allocate();
+		EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(p) % alignof(std::max_align_t));
+		EXPECT_TRUE(seen.insert(p).second);
+	}
+	EXPECT_EQ(100u, pool.Live());
+	for (void *p : seen)
+		pool.Free(p);
+	EXPECT_EQ(0u, pool.Live());
+}
+
+TEST(lagi_slab_pool, freed_memory_is_reused) {
+	SlabPool pool(16, 4);
+	void *a = pool.Allocate();
+	void *b = pool.Allocate();
+	pool.Free(a);
+	EXPECT_EQ(a, pool.Allocate());
+	pool.Free(b);
+	pool.Free(a);
+}
+
+TEST(lagi_slab_pool, grows_by_slabs) {
+	SlabPool pool(8, 4);
+	std::vector<void *> ptrs;
+	for (int i = 0; i < 4; ++i)
+		ptrs.push_back(pool.Allocate());
+	EXPECT_EQ(1u, pool.SlabCount());
+	ptrs.push_back(pool.Allocate());
+	EXPECT_EQ(2u, pool.SlabCount());
+	// The second slab is twice the size of the first
+	for (int i = 0; i < 7; ++i)
+		ptrs.push_back(pool.Allocate());
+	EXPECT_EQ(2u, pool.SlabCount());
+	ptrs.push_back(pool.Allocate());
+	EXPECT_EQ(3u, pool.SlabCount());
+	for (void *p : ptrs)
+		pool.Free(p);
+}
+
+TEST(lagi_slab_pool, releases_slabs_when_empty) {
+	SlabPool pool(8, 4);
+	std::vector<void *> ptrs;
+	for (int i = 0; i < 100; ++i)
+		ptrs.push_back(pool.Allocate());
+	EXPECT_LT(1u, pool.SlabCount());
+	for (void *p : ptrs)
+		pool.Free(p);
+	EXPECT_EQ(1u, pool.SlabCount());
+
+	// And can still be used afterwards
+	for (auto& p : ptrs)
+		p = pool.Allocate();
+	for (void *p : ptrs)
+		pool.Free(p);
+}
+
+TEST(lagi_slab_pool, free_null_is_noop) {
+	SlabPool pool(8);
+	pool.Free(nullptr);
+	EXPECT_EQ(0u, pool.Live());
+}
+
+TEST(lagi_slab_pool, concurrent_use) {
+	SlabPool pool(32, 16);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t) {
+		threads.emplace_back([&pool, t] {
+			std::vector<int *> ptrs;
+			for (int i = 0; i < 1000; ++i) {
+				auto p = static_cast<int *>(pool.Allocate());
+				*p = t * 1000 + i;
+				ptrs.push_back(p);
+			}
+			for (int i = 0; i < 1000; ++i) {
+				EXPECT_EQ(t * 1000 + i, *ptrs[i]);
+				pool.Free(ptrs[i]);
+			}
+		});
+	}
+	for (auto& thread : threads)
+		thread.join();
+	EXPECT_EQ(0u, pool.Live());
+}
@@ -0,0 +1,87 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include <libaegisub/spelling_cache.h>
+
+#include <main.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using agi::SpellingCache;
+
+namespace {
+bool no_q(std::string const& word) { return word.find('q') == std::string::npos; }
+}
+
+TEST(lagi_spelling_cache, checks_each_word_once) {
+	SpellingCache cache;
+	int calls = 0;
+	auto check = [&](std::string const& word) { ++calls; return no_q(word); };
+
+	EXPECT_TRUE(cache.Check("word", check));
+	EXPECT_FALSE(cache.Check("qword", check));
+	EXPECT_TRUE(cache.Check("word", check));
+	EXPECT_FALSE(cache.Check("qword", check));
+	EXPECT_EQ(2, calls);
+	EXPECT_EQ(2u, cache.size());
+}
+
+TEST(lagi_spelling_cache, clear) {
+	SpellingCache cache;
+	int calls = 0;
+	cache.Check("word", [&](std::string const&) { ++calls; return false; });
+	cache.Clear();
+	EXPECT_EQ(0u, cache.size());
+	EXPECT_TRUE(cache.Check("word", [&](std::string const&) { ++calls; return true; }));
+	EXPECT_EQ(2, calls);
+}
+
+TEST(lagi_spelling_cache, clear_during_check_discards_result) {
+	SpellingCache cache;
+	EXPECT_FALSE(cache.Check("word", [&](std::string const&) {
+		cache.Clear();
+		return false;
+	}));
+	EXPECT_EQ(0u, cache.size());
+	EXPECT_TRUE(cache.Check("word", [](std::string const&) { return true; }));
+}
+
+TEST(lagi_spelling_cache, capacity_is_bounded) {
+	SpellingCache cache(64);
+	for (int i = 0; i < 1000; ++i)
+		cache.Check(std::to_string(i), no_q);
+	EXPECT_GE(64u + 16u, cache.size());
+}
+
+TEST(lagi_spelling_cache, concurrent_checks) {
+	SpellingCache cache;
+	std::atomic<int> wrong{0};
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t) {
+		threads.emplace_back([&] {
+			for (int i = 0; i < 2000; ++i) {
+				auto word = (i % 3 ? "q" : "w") + std::to_string(i % 500);
+				if (cache.Check(word, no_q) != no_q(word))
+					++wrong;
+			}
+		});
+	}
+	for (auto& thread : threads)
+		thread.join();
+	EXPECT_EQ(0, wrong);
+	EXPECT_GE(1000u, cache.size());
+}
@@ -0,0 +1,134 @@
+// Copyright (c) 2026
+//
+// Permission to use, copy, modify, and distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+// ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+// ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+// OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+
+#include <libaegisub/trace.h>
+
+#include <libaegisub/cajun/elements.h>
+#include <libaegisub/cajun/reader.h>
+
+#include <main.h>
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace {
+json::Array write_events() {
+	std::stringstream out;
+	agi::trace::Write(out);
+
+	json::UnknownElement root;
+	json::Reader::Read(root, out);
+	json::Object& obj = root;
+	return std::move(static_cast<json::Array&>(obj["traceEvents"]));
+}
+
+size_t count_zones(json::Array const& events, std::string const& name) {
+	size_t count = 0;
+	for (json::Object const& event : events) {
+		if (static_cast<std::string const&>(event.at("ph")) == "X" && static_cast<std::string const&>(event.at("name")) == name)
+			++count;
+	}
+	return count;
+}
+}
+
+TEST(lagi_trace, zones_are_only_recorded_while_recording) {
+	{ AGI_TRACE_ZONE("test", "before"); }
+	agi::trace::Start();
+	{ AGI_TRACE_ZONE("test", "during"); }
+	{ AGI_TRACE_ZONE("test", "during"); }
+	agi::trace::Stop();
+	{ AGI_TRACE_ZONE("test", "after"); }
+
+	auto events = write_events();
+	EXPECT_EQ(0u, count_zones(events, "before"));
+	EXPECT_EQ(2u, count_zones(events, "during"));
+	EXPECT_EQ(0u, count_zones(events, "after"));
+}
+
+TEST(lagi_trace, start_discards_previous_recording) {
+	agi::trace::Start();
+	{ AGI_TRACE_ZONE("test", "first"); }
+	agi::trace::Stop();
+
+	agi::trace::Start();
+	{ AGI_TRACE_ZONE("test", "second"); }
+	agi::trace::Stop();
+
+	auto events = write_events();
+	EXPECT_EQ(0u, count_zones(events, "first"));
+	EXPECT_EQ(1u, count_zones(events, "second"));
+}
+
+TEST(lagi_trace, nested_zones_have_nested_times) {
+	agi::trace::Start();
+	{
+		AGI_TRACE_ZONE("test", "outer");
+		{ AGI_TRACE_ZONE("test", "inner"); }
+	}
+	agi::trace::Stop();
+
+	double outer_start = -1, outer_end = -1, inner_start = -1, inner_end = -1;
+	for (json::Object const& event : write_events()) {
+		if (static_cast<std::string const&>(event.at("ph")) != "X") continue;
+		auto start = static_cast<double>(event.at("ts"));
+		auto end = start + static_cast<double>(event.at("dur"));
+		if (static_cast<std::string const&>(event.at("name")) == "outer") {
+			outer_start = start;
+			outer_end = end;
+		}
+		else {
+			inner_start = start;
+			inner_end = end;
+		}
+	}
+	ASSERT_GE(outer_start, 0);
+	ASSERT_GE(inner_start, 0);
+	EXPECT_LE(outer_start, inner_start);
+	EXPECT_GE(outer_end, inner_end);
+}
+
+TEST(lagi_trace, threads_are_recorded_separately) {
+	agi::trace::Start();
+	std::thread thread([] {
+		agi::trace::SetThreadName("worker");
+		for (int i = 0; i < 10; ++i) {
+			AGI_TRACE_ZONE("test", "thread");
+		}
+	});
+	thread.join();
+	{ AGI_TRACE_ZONE("test", "main"); }
+	agi::trace::Stop();
+
+	auto events = write_events();
+	EXPECT_EQ(10u, count_zones(events, "thread"));
+	EXPECT_EQ(1u, count_zones(events, "main"));
+
+	json::Integer thread_tid = -1, main_tid = -1;
+	bool named = false;
+	for (json::Object const& event : events) {
+		auto const& name = static_cast<std::string const&>(event.at("name"));
+		if (name == "thread") thread_tid = event.at("tid");
+		else if (name == "main") main_tid = event.at("tid");
+		else if (name == "thread_name") {
+			json::Object const& args = event.at("args");
+			named = named || static_cast<std::string const&>(args.at("name")) == "worker";
+		}
+	}
+	EXPECT_NE(thread_tid, main_tid);
+	EXPECT_TRUE(named);
+}
@@ -55,3 +55,45 @@ TEST(lagi_uuencode, random_blobs_roundtrip) {
 		data.push_back(rand());
 	}
 }
+
+TEST(lagi_uuencode, long_blobs_wrap_lines) {
+	for (size_t len : {59, 60, 61, 119, 120, 121, 1000}) {
+		std::vector<char> data(len, 'x');
+		auto encoded = UUEncode(data.data(), data.data() + data.size());
+
+		size_t line_start = 0;
+		for (size_t pos = encoded.find("\r\n"); pos != std::string::npos; pos = encoded.find("\r\n", line_start)) {
+			EXPECT_EQ(80u, pos - line_start);
+			line_start = pos + 2;
+		}
+		EXPECT_GT(encoded.size(), line_start);
+		EXPECT_GE(80u, encoded.size() - line_start);
+
+		EXPECT_EQ(data, UUDecode(encoded.data(), encoded.data() + encoded.size()));
+
+		auto unwrapped = UUEncode(data.data(), data.data() + data.size(), false);
+		boost::replace_all(encoded, "\r\n", "");
+		EXPECT_EQ(unwrapped, encoded);
+	}
+}
+
+TEST(lagi_uuencode, decode_ignores_line_breaks_anywhere) {
+	std::vector<char> data;
+	for (int i = 0; i < 100; ++i)
+		data.push_back(static_cast<char>(i * 7));
+	auto encoded = UUEncode(data.data(), data.data() + data.size(), false);
+
+	for (size_t step = 1; step < 9; ++step) {
+		std::string wrapped;
+		for (size_t i = 0; i < encoded.size(); i += step)
+			wrapped += encoded.substr(i, step) + (step % 2 ? "\n" : "\r\n");
+		EXPECT_EQ(data, UUDecode(wrapped.data(), wrapped.data() + wrapped.size()));
+	}
+}
+
+TEST(lagi_uuencode, decode_into_existing_buffer) {
+	std::vector<char> out(500, 'a');
+	const char *str = "?(F[";
+	UUDecode(str, str + 4, out);
+	EXPECT_EQ((std::vector<char>{120, 121, 122}), out);
+}
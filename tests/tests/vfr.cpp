@@ -767,3 +767,60 @@ TEST(lagi_vfr, from_smpte_ntsc_nodrop) {
 		++f;
 	}
 }
+
+TEST(lagi_vfr, frames_at_times_matches_frame_at_time) {
+	// Irregular frame times with a run of duplicates
+	std::vector<int> timecodes;
+	for (int i = 0, time = 10; i < 2000; ++i) {
+		timecodes.push_back(time);
+		if (i < 500 || i > 510)
+			time += 17 + (i * 7919) % 50;
+	}
+	Framerate fps(timecodes);
+
+	std::vector<int> sorted;
+	for (int ms = -100; ms < timecodes.back() + 1000; ms += 13)
+		sorted.push_back(ms);
+	std::vector<int> shuffled = sorted;
+	std::reverse(shuffled.begin(), shuffled.end());
+	std::rotate(shuffled.begin(), shuffled.begin() + shuffled.size() / 3, shuffled.end());
+
+	for (auto const& rate : {fps, Framerate(24000, 1001)}) {
+		for (auto type : {EXACT, START, END}) {
+			for (auto const& times : {sorted, shuffled}) {
+				auto frames = rate.FramesAtTimes(times, type);
+				ASSERT_EQ(times.size(), frames.size());
+				for (size_t i = 0; i < times.size(); ++i)
+					ASSERT_EQ(rate.FrameAtTime(times[i], type), frames[i]) << times[i];
+			}
+		}
+	}
+
+	EXPECT_TRUE(fps.FramesAtTimes({}).empty());
+}
+
+TEST(lagi_vfr, mixed_frame_durations_round_trip) {
+	// Stretches of constant durations, irregular durations, held frames and
+	// gaps of several minutes, at lengths which don't line up with anything
+	std::vector<int> timecodes;
+	int time = 0;
+	for (int i = 0; i < 150; ++i) timecodes.push_back(time += 40);
+	for (int i = 0; i < 300; ++i) timecodes.push_back(time += 41 + (i % 3 == 0));
+	for (int i = 0; i < 70; ++i) timecodes.push_back(time);
+	for (int i = 0; i < 90; ++i) timecodes.push_back(time += i % 10 ? 17 : 200000);
+	for (int i = 0; i < 100; ++i) timecodes.push_back(time += 8 + (i % 7 == 0));
+	Framerate fps(timecodes);
+
+	for (size_t i = 0; i < timecodes.size(); ++i)
+		ASSERT_EQ(timecodes[i], fps.TimeAtFrame(i)) << i;
+
+	for (int ms = timecodes.front(); ms <= timecodes.back(); ms += ms < 1000000 ? 3 : 997) {
+		const int expected = int(std::upper_bound(timecodes.begin(), timecodes.end(), ms) - timecodes.begin()) - 1;
+		ASSERT_EQ(expected, fps.FrameAtTime(ms)) << ms;
+	}
+
+	// Copies share the timecodes but behave identically
+	Framerate copy = fps;
+	EXPECT_EQ(fps.FrameAtTime(123456), copy.FrameAtTime(123456));
+	EXPECT_EQ(fps.TimeAtFrame(600), copy.TimeAtFrame(600));
+}
@@ -160,3 +160,49 @@ TEST(lagi_word_split, several_words) {
 	EXPECT_EQ(1, tokens[8].length);
 }
 
+
+static void expect_same_split(std::string const& text, WordSplitCache &cache) {
+	auto expected = TokenizeDialogueBody(text);
+	SplitWords(text, expected);
+
+	auto actual = TokenizeDialogueBody(text);
+	SplitWords(text, actual, &cache);
+
+	ASSERT_EQ(expected.size(), actual.size()) << text;
+	for (size_t i = 0; i < expected.size(); ++i) {
+		EXPECT_EQ(expected[i].type, actual[i].type) << text << " " << i;
+		EXPECT_EQ(expected[i].length, actual[i].length) << text << " " << i;
+	}
+}
+
+TEST(lagi_word_split, cache) {
+	WordSplitCache cache;
+	expect_same_split("", cache);
+	expect_same_split("abc def", cache);
+	expect_same_split("abc def", cache);
+	expect_same_split("{\\b1}abc def{\\b0}ghi", cache);
+	expect_same_split("{\\b1}abc deff{\\b0}ghi", cache);
+	expect_same_split("{\\b1}abc deff{\\b0}ghi{\\p1}m 0 0 l 10 10{\\p0}abc def", cache);
+	expect_same_split("abc def{", cache);
+	expect_same_split("abc def", cache);
+}
+
+TEST(lagi_word_split, cache_reuses_runs) {
+	WordSplitCache cache;
+	std::string text = "{\\b1}abc def{\\b0}ghi";
+	auto tokens = TokenizeDialogueBody(text);
+	SplitWords(text, tokens, &cache);
+
+	ASSERT_NE(nullptr, cache.Find("abc def"));
+	EXPECT_EQ(3u, cache.Find("abc def")->size());
+	ASSERT_NE(nullptr, cache.Find("ghi"));
+
+	// Runs which aren't in the newest version of the line are dropped
+	text = "{\\b1}abc def{\\b0}jkl";
+	tokens = TokenizeDialogueBody(text);
+	SplitWords(text, tokens, &cache);
+	cache.NextLine();
+	EXPECT_EQ(nullptr, cache.Find("ghi"));
+	EXPECT_NE(nullptr, cache.Find("abc def"));
+	EXPECT_NE(nullptr, cache.Find("jkl"));
+}